@@ -10,10 +10,14 @@ TEMPLATE     = aux
 TARGET       = man
 
 MAN_SRC      = qdirstat.1                 \
-               qdirstat-cache-writer.1
+               qdirstat-cache-writer.1    \
+               qdirstat-query.1           \
+               qdirstat-daemon.1
 
 MAN_TARGET   = qdirstat.1.gz              \
-               qdirstat-cache-writer.1.gz
+               qdirstat-cache-writer.1.gz \
+               qdirstat-query.1.gz        \
+               qdirstat-daemon.1.gz
 
 MAN_PATH     = $$INSTALL_PREFIX/share/man/man1
 
@@ -18,7 +18,14 @@
 TEMPLATE = subdirs
 CONFIG  += ordered
 
-SUBDIRS  = src scripts doc doc/stats man
+SUBDIRS  = src src/cache-writer src/query src/daemon scripts doc doc/stats man
+
+# Optional: The benchmarks in test/benchmark, test/treemap-benchmark and
+# test/micro-benchmark with
+#
+#     qmake CONFIG+=benchmark
+
+benchmark:SUBDIRS += test/benchmark test/treemap-benchmark test/micro-benchmark
 
 macx {
     # FIXME: Prevent build failure because of missing main() (issue #131)
@@ -6,7 +6,6 @@ TEMPLATE       = app
 TARGET         = $(nothing)
 QMAKE_STRIP    = /bin/true # prevent stripping the script(s)
 
-scripts.files  = qdirstat-cache-writer
-scripts.path   = $$INSTALL_PREFIX/bin
-
-INSTALLS      += scripts
+# The qdirstat-cache-writer Perl script is no longer installed: It is
+# replaced by the native program of the same name from src/cache-writer.
+# The script is still here for servers that don't have the Qt libraries.
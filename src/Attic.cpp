@@ -20,15 +20,16 @@ Attic::Attic( DirTree * tree,
 	      DirInfo * parent )
     : DirInfo( tree, parent )
 {
+    _nodeKind  = AtticNode;
     _name      = atticName();
     _isIgnored = true;
 
     if ( parent )
     {
-	_device = parent->device();
-	_mode	= parent->mode();
-	_uid	= parent->uid();
-	_gid	= parent->gid();
+	_mode = parent->mode();
+	setDevice( parent->device() );
+	setUid	 ( parent->uid()    );
+	setGid	 ( parent->gid()    );
 	_mtime	= 0;
     }
 }
@@ -55,9 +56,9 @@ bool Attic::hasChildren() const
 }
 
 
-void Attic::checkIgnored()
+bool Attic::updateIgnored()
 {
-    // NOP
+    return false;
 }
 
 
@@ -79,11 +79,11 @@ namespace QDirStat
 
 	/**
 	 * Check the 'ignored' state of this item and set the '_isIgnored' flag
-	 * accordingly.
+	 * accordingly. An attic never changes it.
 	 *
 	 * Reimplemented - inherited from DirInfo.
 	 **/
-	virtual void checkIgnored() Q_DECL_OVERRIDE;
+	virtual bool updateIgnored() Q_DECL_OVERRIDE;
 
 	/**
 	 * Locate a child somewhere in this subtree whose URL (i.e. complete
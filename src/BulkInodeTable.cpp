@@ -0,0 +1,185 @@
+/*
+ *   File name: BulkInodeTable.cpp
+ *   Summary:	Stat data of all inodes of a filesystem read in bulk
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>	// memset()
+#include <algorithm>	// std::lower_bound(), std::sort()
+
+#include <QElapsedTimer>
+
+#include "BulkInodeTable.h"
+#include "Logger.h"
+#include "Exception.h"
+
+#if HAVE_XFS_BULKSTAT
+#  include <sys/ioctl.h>
+#  include <xfs/xfs.h>
+#endif
+
+
+// Number of inodes for each XFS_IOC_FSBULKSTAT call
+#define XFS_BULKSTAT_BATCH	4096
+
+
+using namespace QDirStat;
+
+
+BulkInodeTable::BulkInodeTable( dev_t device ):
+    _device( device )
+{
+    // NOP
+}
+
+
+bool BulkInodeTable::isSupported( const QString & filesystemType )
+{
+#if HAVE_XFS_BULKSTAT
+    return filesystemType == "xfs";
+#else
+    Q_UNUSED( filesystemType );
+    return false;
+#endif
+}
+
+
+BulkInodeTablePtr BulkInodeTable::read( const QString & mountPath,
+					const QString & filesystemType )
+{
+    if ( ! isSupported( filesystemType ) )
+    {
+	logInfo() << "No bulk inode reading for " << filesystemType
+		  << " at " << mountPath << endl;
+	return BulkInodeTablePtr();
+    }
+
+    int fd = ::open( mountPath.toUtf8().constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+    struct stat statInfo;
+
+    if ( fd < 0 || fstat( fd, &statInfo ) != 0 )
+    {
+	logWarning() << "Can't open " << mountPath << ": " << formatErrno() << endl;
+
+	if ( fd >= 0 )
+	    ::close( fd );
+
+	return BulkInodeTablePtr();
+    }
+
+    BulkInodeTable * table = new BulkInodeTable( statInfo.st_dev );
+    CHECK_NEW( table );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool ok = table->readXfs( fd );
+    ::close( fd );
+
+    if ( ! ok )
+    {
+	delete table;
+	return BulkInodeTablePtr();
+    }
+
+    logInfo() << "Read " << table->size() << " inodes of " << mountPath
+	      << " in bulk in " << timer.elapsed() << " millisec" << endl;
+
+    return BulkInodeTablePtr( table );
+}
+
+
+bool BulkInodeTable::readXfs( int fd )
+{
+#if HAVE_XFS_BULKSTAT
+    QVector<struct xfs_bstat> buffer( XFS_BULKSTAT_BATCH );
+    __u64 lastIno = 0;
+    __s32 count	  = 0;
+
+    struct xfs_fsop_bulkreq request;
+    request.lastip  = &lastIno;
+    request.icount  = buffer.size();
+    request.ubuffer = buffer.data();
+    request.ocount  = &count;
+
+    forever
+    {
+	if ( ioctl( fd, XFS_IOC_FSBULKSTAT, &request ) != 0 )
+	{
+	    if ( errno == EINTR )
+		continue;
+
+	    // EPERM without CAP_SYS_ADMIN
+
+	    logWarning() << "XFS_IOC_FSBULKSTAT failed: " << formatErrno() << endl;
+	    _inodes.clear();
+
+	    return false;
+	}
+
+	if ( count == 0 )	// no more inodes
+	    break;
+
+	for ( int i = 0; i < count; ++i )
+	{
+	    const struct xfs_bstat & bstat = buffer.at( i );
+
+	    Inode inode;
+	    inode.ino	 = bstat.bs_ino;
+	    inode.size	 = bstat.bs_size;
+	    inode.blocks = (qint64) bstat.bs_blocks * bstat.bs_blksize / 512;
+	    inode.mtime	 = bstat.bs_mtime.tv_sec;
+	    inode.mode	 = bstat.bs_mode;
+	    inode.links	 = bstat.bs_nlink;
+	    inode.uid	 = bstat.bs_uid;
+	    inode.gid	 = bstat.bs_gid;
+
+	    _inodes << inode;
+	}
+    }
+
+    // The kernel returns them in inode order, but don't rely on it
+
+    if ( ! std::is_sorted( _inodes.begin(), _inodes.end(), inoLessThan ) )
+	std::sort( _inodes.begin(), _inodes.end(), inoLessThan );
+
+    _inodes.squeeze();
+
+    return true;
+#else
+    Q_UNUSED( fd );
+    return false;
+#endif
+}
+
+
+bool BulkInodeTable::lookup( ino_t ino, struct stat & stat_ret ) const
+{
+    Inode key;
+    key.ino = ino;
+
+    QVector<Inode>::const_iterator it =
+	std::lower_bound( _inodes.constBegin(), _inodes.constEnd(), key, inoLessThan );
+
+    if ( it == _inodes.constEnd() || it->ino != (quint64) ino )
+	return false;
+
+    memset( &stat_ret, 0, sizeof( stat_ret ) );
+    stat_ret.st_dev    = _device;
+    stat_ret.st_ino    = ino;
+    stat_ret.st_mode   = it->mode;
+    stat_ret.st_nlink  = it->links;
+    stat_ret.st_uid    = it->uid;
+    stat_ret.st_gid    = it->gid;
+    stat_ret.st_size   = it->size;
+    stat_ret.st_blocks = it->blocks;
+    stat_ret.st_mtime  = it->mtime;
+
+    return true;
+}
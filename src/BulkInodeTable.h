@@ -0,0 +1,138 @@
+/*
+ *   File name: BulkInodeTable.h
+ *   Summary:	Stat data of all inodes of a filesystem read in bulk
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef BulkInodeTable_h
+#define BulkInodeTable_h
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <QVector>
+#include <QSharedPointer>
+#include <QString>
+
+
+// XFS_IOC_FSBULKSTAT needs the XFS headers (xfsprogs-devel / xfslibs-dev)
+
+#define HAVE_XFS_BULKSTAT	0
+
+#if defined( __linux__ ) && defined( __has_include )
+#  if __has_include( <xfs/xfs.h> )
+#    undef  HAVE_XFS_BULKSTAT
+#    define HAVE_XFS_BULKSTAT	1
+#  endif
+#endif
+
+
+namespace QDirStat
+{
+    class BulkInodeTable;
+
+    typedef QSharedPointer<const BulkInodeTable> BulkInodeTablePtr;
+
+
+    /**
+     * The stat data of all inodes of one filesystem, read in bulk in inode
+     * order with a filesystem-specific interface rather than with one
+     * statx() call for each directory entry. For reading a complete
+     * filesystem, this replaces nearly all statx() calls with a lookup by
+     * the inode number that getdents64() returns anyway (see
+     * LocalDirReadJob::readEntries()).
+     *
+     * Supported are:
+     *
+     *	 - XFS with XFS_IOC_FSBULKSTAT; this needs CAP_SYS_ADMIN.
+     *
+     * The table is a snapshot: Inodes that are created after it was read
+     * are not in it, and inodes that changed in the meantime have the old
+     * data. The caller has to stat() what is not found, and directories
+     * should always be stat()ed since a mount point has a different inode
+     * than the directory it is mounted on.
+     *
+     * After it is read, the table does not change any more, so it can be
+     * used by several threads at the same time.
+     **/
+    class BulkInodeTable
+    {
+    public:
+
+	/**
+	 * Read the inodes of the filesystem that is mounted at 'mountPath'
+	 * with type 'filesystemType'. Return 0 if that filesystem is not
+	 * supported or if reading failed, e.g. because of missing
+	 * privileges.
+	 **/
+	static BulkInodeTablePtr read( const QString & mountPath,
+				       const QString & filesystemType );
+
+	/**
+	 * Return 'true' if bulk reading is possible at all for filesystem
+	 * type 'filesystemType' in this build.
+	 **/
+	static bool isSupported( const QString & filesystemType );
+
+	/**
+	 * Return the device of the filesystem.
+	 **/
+	dev_t device() const { return _device; }
+
+	/**
+	 * Return the number of inodes in the table.
+	 **/
+	int size() const { return _inodes.size(); }
+
+	/**
+	 * Look up inode 'ino' and fill 'stat_ret' with its data. Return
+	 * 'false' if it is not in the table.
+	 **/
+	bool lookup( ino_t ino, struct stat & stat_ret ) const;
+
+
+    protected:
+
+	/**
+	 * Constructor. Use read() instead.
+	 **/
+	BulkInodeTable( dev_t device );
+
+	/**
+	 * Read all inodes of XFS filesystem 'fd'. Return 'false' on error.
+	 **/
+	bool readXfs( int fd );
+
+
+	struct Inode
+	{
+	    quint64 ino;
+	    qint64  size;
+	    qint64  blocks;	// 512 byte units like st_blocks
+	    qint64  mtime;
+	    quint32 mode;
+	    quint32 links;
+	    quint32 uid;
+	    quint32 gid;
+	};
+
+	static bool inoLessThan( const Inode & a, const Inode & b )
+	    { return a.ino < b.ino; }
+
+
+	//
+	// Data members
+	//
+
+	dev_t		_device;
+	QVector<Inode>	_inodes;	// sorted by inode number
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// BulkInodeTable_h
@@ -0,0 +1,388 @@
+/*
+ *   File name: CacheReadPipeline.cpp
+ *   Summary:	Multithreaded parsing of QDirStat cache files
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <string.h>
+
+#include <QMutexLocker>
+#include <QMetaObject>
+
+#include "CacheReadPipeline.h"
+#include "ZstdFile.h"
+#include "ReadTrace.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+// Size of the blocks that the input thread reads
+#define BLOCK_SIZE		( 256 * 1024 )
+
+// Blocks per parser thread that may be underway between the input thread
+// and the GUI thread
+#define BLOCKS_PER_PARSER	4
+
+// Parsing is cheaper than inserting into the tree, so more parser threads
+// than this don't help anymore
+#define MAX_PARSER_THREADS	8
+
+
+using namespace QDirStat;
+
+
+void CacheInputThread::run()
+{
+    _pipeline->readInput();
+}
+
+
+void CacheParserThread::run()
+{
+    _pipeline->parseBlocks();
+}
+
+
+
+
+CacheReadPipeline::CacheReadPipeline( gzFile	   gzCache,
+				      ZstdReader * zstdCache,
+				      int	   parserCount ):
+    _gzCache( gzCache ),
+    _zstdCache( zstdCache ),
+    _parserCount( qMax( parserCount, 1 ) ),
+    _readCount( 0 ),
+    _takenCount( 0 ),
+    _waiter( 0 ),
+    _inputDone( false ),
+    _readError( false ),
+    _shutdown( false )
+{
+
+}
+
+
+CacheReadPipeline::~CacheReadPipeline()
+{
+    stop();
+
+    qDeleteAll( _rawBlocks );
+    qDeleteAll( _parsedBlocks );
+}
+
+
+void CacheReadPipeline::start()
+{
+    if ( ! _threads.isEmpty() )
+	return;
+
+    logDebug() << "Reading cache with " << _parserCount << " parser threads" << endl;
+
+    QThread * thread = new CacheInputThread( this );
+    CHECK_NEW( thread );
+    _threads << thread;
+
+    for ( int i = 0; i < _parserCount; ++i )
+    {
+	thread = new CacheParserThread( this );
+	CHECK_NEW( thread );
+	_threads << thread;
+    }
+
+    foreach ( QThread * newThread, _threads )
+	newThread->start();
+}
+
+
+void CacheReadPipeline::stop()
+{
+    if ( _threads.isEmpty() )
+	return;
+
+    {
+	QMutexLocker locker( &_mutex );
+	_shutdown = true;
+	_roomAvailable.wakeAll();
+	_rawAvailable.wakeAll();
+	_parsedAvailable.wakeAll();
+    }
+
+    foreach ( QThread * thread, _threads )
+	thread->wait();
+
+    qDeleteAll( _threads );
+    _threads.clear();
+}
+
+
+int CacheReadPipeline::defaultParserCount()
+{
+    int cores = QThread::idealThreadCount();
+
+    if ( cores < 2 )
+	return 0;
+
+    // One core is busy with the GUI thread inserting into the tree
+
+    return qMin( cores - 1, MAX_PARSER_THREADS );
+}
+
+
+CacheBlock * CacheReadPipeline::takeBlock()
+{
+    QMutexLocker locker( &_mutex );
+
+    while ( ! _shutdown )
+    {
+	CacheBlock * block = _parsedBlocks.take( _takenCount );
+
+	if ( block )
+	{
+	    ++_takenCount;
+	    _roomAvailable.wakeOne();
+
+	    return block;
+	}
+
+	if ( _inputDone && _takenCount == _readCount )
+	    break;
+
+	_parsedAvailable.wait( &_mutex );
+    }
+
+    return 0;
+}
+
+
+CacheBlock * CacheReadPipeline::tryTakeBlock( QObject * notify )
+{
+    QMutexLocker locker( &_mutex );
+
+    CacheBlock * block = _parsedBlocks.take( _takenCount );
+
+    if ( block )
+    {
+	++_takenCount;
+	_roomAvailable.wakeOne();
+
+	return block;
+    }
+
+    if ( ! _shutdown && ! ( _inputDone && _takenCount == _readCount ) )
+	_waiter = notify;
+
+    return 0;
+}
+
+
+void CacheReadPipeline::notifyWaiter()
+{
+    if ( _waiter )
+    {
+	QMetaObject::invokeMethod( _waiter, "blockAvailable", Qt::QueuedConnection );
+	_waiter = 0;
+    }
+}
+
+
+bool CacheReadPipeline::atEnd()
+{
+    QMutexLocker locker( &_mutex );
+
+    return _inputDone && _takenCount == _readCount;
+}
+
+
+bool CacheReadPipeline::readError()
+{
+    QMutexLocker locker( &_mutex );
+
+    return _readError;
+}
+
+
+int CacheReadPipeline::readRaw( char * buf, int len )
+{
+    if ( _zstdCache )
+	return _zstdCache->read( buf, len );
+    else
+	return gzread( _gzCache, buf, len );
+}
+
+
+void CacheReadPipeline::readInput()
+{
+    QByteArray rest;	// incomplete last line of the previous block
+    bool ok = true;
+
+    while ( ok )
+    {
+	QByteArray data = rest;
+	int	   start = data.size();
+
+	data.resize( start + BLOCK_SIZE );
+	int len;
+
+	{
+	    READ_TRACE_SCOPE( "cache read block", QString() );
+	    len = readRaw( data.data() + start, BLOCK_SIZE );
+	}
+
+	if ( len < 0 )
+	{
+	    setInputDone( true );
+	    return;
+	}
+
+	if ( len == 0 )
+	{
+	    // The last line might not have a newline
+
+	    if ( ! rest.isEmpty() )
+		addRawBlock( rest );
+
+	    break;
+	}
+
+	data.resize( start + len );
+
+	const char * lastNewline = (const char *) memrchr( data.constData(), '\n', data.size() );
+
+	if ( ! lastNewline )
+	{
+	    // No complete line yet: A huge line or a huge file without any
+	    // newlines (not a cache file anyway). Keep on reading.
+
+	    rest = data;
+	    continue;
+	}
+
+	int blockSize = lastNewline - data.constData() + 1;
+	rest = data.mid( blockSize );
+	data.truncate( blockSize );
+
+	ok = addRawBlock( data );
+    }
+
+    setInputDone( false );
+}
+
+
+void CacheReadPipeline::setInputDone( bool readError )
+{
+    QMutexLocker locker( &_mutex );
+
+    if ( readError )
+	_readError = true;
+
+    _inputDone = true;
+    _rawAvailable.wakeAll();
+    _parsedAvailable.wakeAll();
+    notifyWaiter();
+}
+
+
+bool CacheReadPipeline::addRawBlock( const QByteArray & data )
+{
+    CacheBlock * block = new CacheBlock;
+    CHECK_NEW( block );
+
+    block->data	     = data;
+    block->lineCount = 0;
+
+    QMutexLocker locker( &_mutex );
+
+    while ( ! _shutdown && _readCount - _takenCount >= _parserCount * BLOCKS_PER_PARSER )
+	_roomAvailable.wait( &_mutex );
+
+    if ( _shutdown )
+    {
+	delete block;
+	return false;
+    }
+
+    block->seq = _readCount++;
+    _rawBlocks.enqueue( block );
+    _rawAvailable.wakeOne();
+
+    return true;
+}
+
+
+void CacheReadPipeline::parseBlocks()
+{
+    while ( true )
+    {
+	CacheBlock * block = 0;
+
+	{
+	    QMutexLocker locker( &_mutex );
+
+	    while ( ! _shutdown && _rawBlocks.isEmpty() && ! _inputDone )
+		_rawAvailable.wait( &_mutex );
+
+	    if ( _shutdown || _rawBlocks.isEmpty() )
+		return;
+
+	    block = _rawBlocks.dequeue();
+	}
+
+	parseBlock( block );
+
+	QMutexLocker locker( &_mutex );
+	_parsedBlocks.insert( block->seq, block );
+
+	// Several parser threads might be waiting for different blocks
+	// that can't be taken before this one, so wake up the GUI thread
+	// only if it can take this block now.
+
+	if ( block->seq == _takenCount )
+	{
+	    _parsedAvailable.wakeAll();
+	    notifyWaiter();
+	}
+    }
+}
+
+
+void CacheReadPipeline::parseBlock( CacheBlock * block )
+{
+    char * fields[ MAX_FIELDS_PER_LINE ];
+    char * pos = block->data.data();	// detach: the lines are split in place
+    char * end = pos + block->data.size();
+
+    READ_TRACE_SCOPE( "cache parse block", QString::number( block->seq ) );
+    block->items.reserve( block->data.size() / 64 );
+
+    while ( pos < end )
+    {
+	char * newline = (char *) memchr( pos, '\n', end - pos );
+	char * next    = newline ? newline + 1 : end;
+
+	// A last line without a newline ends with the 0 byte that QByteArray
+	// always keeps after its data.
+
+	if ( newline )
+	    *newline = 0;
+
+	++block->lineCount;
+	char * line = CacheReader::skipWhiteSpace( pos );
+
+	if ( *line != 0 && *line != '#' )	// skip empty and comment lines
+	{
+	    CacheItem item;
+	    item.lineNo = block->lineCount;
+
+	    int fieldsCount = CacheReader::splitFields( line, fields );
+	    CacheReader::parseItem( fields, fieldsCount, item );
+	    block->items.append( item );
+	}
+
+	pos = next;
+    }
+
+    block->data.clear();	// not needed anymore
+}
@@ -0,0 +1,259 @@
+/*
+ *   File name: CacheReadPipeline.h
+ *   Summary:	Multithreaded parsing of QDirStat cache files
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef CacheReadPipeline_h
+#define CacheReadPipeline_h
+
+
+#include <zlib.h>
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+
+#include "DirTreeCache.h"
+
+
+namespace QDirStat
+{
+    class CacheReadPipeline;
+    class ZstdReader;
+
+
+    /**
+     * A block of complete lines of a text cache file and, after it was
+     * parsed, the items of those lines.
+     **/
+    struct CacheBlock
+    {
+	int		   seq;		// position of this block in the file
+	QByteArray	   data;	// raw (uncompressed) lines
+	int		   lineCount;	// including empty and comment lines
+	QVector<CacheItem> items;	// CacheItem::lineNo is relative to this block
+    };
+
+
+    /**
+     * Thread of a CacheReadPipeline that reads (and decompresses) the cache
+     * file and cuts it into blocks of complete lines.
+     **/
+    class CacheInputThread: public QThread
+    {
+    public:
+
+	CacheInputThread( CacheReadPipeline * pipeline ):
+	    QThread(),
+	    _pipeline( pipeline )
+	    {}
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	CacheReadPipeline * _pipeline;
+    };
+
+
+    /**
+     * Thread of a CacheReadPipeline that splits blocks into lines and
+     * fields and parses them into CacheItems.
+     **/
+    class CacheParserThread: public QThread
+    {
+    public:
+
+	CacheParserThread( CacheReadPipeline * pipeline ):
+	    QThread(),
+	    _pipeline( pipeline )
+	    {}
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	CacheReadPipeline * _pipeline;
+    };
+
+
+    /**
+     * Pipeline for reading a text cache file with several threads:
+     *
+     * - One input thread reads (and decompresses) the file and cuts it into
+     *	 blocks of complete lines.
+     *
+     * - Several parser threads take those blocks and split them into lines
+     *	 and fields, parse the numbers and unescape the paths. This is where
+     *	 most of the CPU time of reading a cache file goes, and the blocks
+     *	 are independent of each other, so this scales with the number of
+     *	 cores.
+     *
+     * - The GUI thread takes the parsed blocks with takeBlock() in the
+     *	 order of the file and inserts the items into the tree (see
+     *	 CacheReader). The tree is never touched by any other thread.
+     *
+     * The number of blocks between the input thread and the GUI thread is
+     * limited, so memory usage stays bounded even if inserting into the
+     * tree is slower than reading and parsing.
+     *
+     * While a pipeline exists, it owns the input file, i.e. nobody else may
+     * read from it.
+     **/
+    class CacheReadPipeline
+    {
+    public:
+
+	/**
+	 * Constructor. Exactly one of 'gzCache' and 'zstdCache' is used:
+	 * 'zstdCache' if it is non-null, 'gzCache' otherwise. Reading
+	 * starts at the current position of the file.
+	 *
+	 * 'parserCount' is the number of parser threads.
+	 **/
+	CacheReadPipeline( gzFile	gzCache,
+			   ZstdReader * zstdCache,
+			   int		parserCount );
+
+	/**
+	 * Destructor. This stops all threads and waits for them.
+	 **/
+	virtual ~CacheReadPipeline();
+
+	/**
+	 * Start the threads.
+	 **/
+	void start();
+
+	/**
+	 * Return the next parsed block in file order. Wait until it is
+	 * available if necessary. The caller takes over ownership.
+	 *
+	 * Return 0 if there are no more blocks; check readError() to find
+	 * out if that was because of an error.
+	 *
+	 * This is called in the GUI thread.
+	 **/
+	CacheBlock * takeBlock();
+
+	/**
+	 * Return the next parsed block in file order like takeBlock(), but
+	 * don't wait for it: Return 0 if it is not parsed yet or if there
+	 * are no more blocks (check atEnd() for that). If it is not parsed
+	 * yet, the blockAvailable() signal of 'notify' is invoked with a
+	 * queued call when it is, or when the input ends.
+	 *
+	 * This is called in the GUI thread.
+	 **/
+	CacheBlock * tryTakeBlock( QObject * notify );
+
+	/**
+	 * Return 'true' if the whole file was read and all blocks are taken.
+	 **/
+	bool atEnd();
+
+	/**
+	 * Return 'true' if there was a read error.
+	 **/
+	bool readError();
+
+	/**
+	 * Return the number of parser threads that a pipeline should use on
+	 * this machine or 0 if using a pipeline does not make sense since
+	 * there is only one core.
+	 **/
+	static int defaultParserCount();
+
+
+	// Callbacks for the threads
+
+	/**
+	 * The loop of the input thread. Derived classes that read something
+	 * else than a cache file reimplement this and add the blocks with
+	 * addRawBlock().
+	 **/
+	virtual void readInput();
+
+	/**
+	 * The loop of a parser thread.
+	 **/
+	void parseBlocks();
+
+
+    protected:
+
+	/**
+	 * Read up to 'len' bytes from the input file. Return the number of
+	 * bytes read, 0 at the end of the file, -1 on error.
+	 **/
+	int readRaw( char * buf, int len );
+
+	/**
+	 * Add a block that was read to the queue of blocks to parse.
+	 * Return 'false' if the pipeline is shutting down.
+	 **/
+	bool addRawBlock( const QByteArray & data );
+
+	/**
+	 * Notification from the input thread that there are no more blocks,
+	 * optionally because of a read error.
+	 **/
+	void setInputDone( bool readError );
+
+	/**
+	 * Split the data of 'block' into lines and parse them into
+	 * block->items.
+	 **/
+	virtual void parseBlock( CacheBlock * block );
+
+	/**
+	 * Invoke the blockAvailable() signal of the object that waits in
+	 * tryTakeBlock(), if any. The caller has to lock the mutex.
+	 **/
+	void notifyWaiter();
+
+	/**
+	 * Stop all threads and wait for them. A derived class has to call
+	 * this in its destructor since the threads call its methods.
+	 **/
+	void stop();
+
+
+	gzFile			   _gzCache;
+	ZstdReader *		   _zstdCache;
+	int			   _parserCount;
+	QList<QThread *>	   _threads;
+
+	QMutex			   _mutex;	// for everything below
+	QWaitCondition		   _roomAvailable;	// for the input thread
+	QWaitCondition		   _rawAvailable;	// for the parser threads
+	QWaitCondition		   _parsedAvailable;	// for the GUI thread
+	QQueue<CacheBlock *>	   _rawBlocks;
+	QHash<int, CacheBlock *>   _parsedBlocks;	// by seq
+	int			   _readCount;		// blocks read so far
+	int			   _takenCount;		// blocks taken so far
+	QObject *		   _waiter;		// see tryTakeBlock()
+	bool			   _inputDone;
+	bool			   _readError;
+	bool			   _shutdown;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef CacheReadPipeline_h
@@ -17,6 +17,7 @@
 #include "DirInfo.h"
 #include "OutputWindow.h"
 #include "Process.h"
+#include "SpawnedProcess.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -44,6 +45,8 @@ Cleanup::Cleanup( QString   command,
     _outputWindowPolicy	   = ShowAfterTimeout;
     _outputWindowTimeout   = 500;
     _outputWindowAutoClose = false;
+    _maxParallel	   = 1;
+    _failFast		   = false;
 
     QAction::setEnabled( true );
 }
@@ -125,6 +128,12 @@ void Cleanup::executeRecursive( FileInfo *item, OutputWindow * outputWindow )
 }
 
 
+bool Cleanup::isPlainDelete() const
+{
+    return _command.simplified() == "rm -rf %p" && ! _recurse;
+}
+
+
 const QString Cleanup::itemDir( const FileInfo *item ) const
 {
     QString dir = item->path();
@@ -159,12 +168,7 @@ QString Cleanup::expandVariables( const FileInfo * item,
 				  const QString	 & unexpanded ) const
 {
     QString expanded = expandDesktopSpecificApps( unexpanded );
-    QString dirName = "";
-
-    if ( item->isDir() )
-	dirName = item->path();
-    else if ( item->parent() )
-	dirName = item->parent()->path();
+    QString dirName  = variableDirName( item );
 
     expanded.replace( "%p", quoted( escaped( item->path() ) ) );
     expanded.replace( "%n", quoted( escaped( item->name() ) ) );
@@ -177,6 +181,50 @@ QString Cleanup::expandVariables( const FileInfo * item,
 }
 
 
+QString Cleanup::variableDirName( const FileInfo * item ) const
+{
+    if ( item->isDir() )
+	return item->path();
+    else if ( item->parent() )
+	return item->parent()->path();
+
+    return "";
+}
+
+
+QStringList Cleanup::directCommand( const FileInfo * item,
+				    const QString  & unexpanded ) const
+{
+    QString command = expandDesktopSpecificApps( unexpanded );
+
+    if ( SpawnedProcess::needsShell( command ) )
+	return QStringList();
+
+    QStringList args = command.split( QRegExp( "\\s+" ), QString::SkipEmptyParts );
+
+    // Shell builtins and aliases still need the shell
+
+    if ( SpawnedProcess::findExecutable( args.first() ).isEmpty() )
+	return QStringList();
+
+    // Without a shell, the variables are expanded without quotes: Each
+    // word is exactly one argument.
+
+    QString dirName = variableDirName( item );
+
+    for ( int i = 0; i < args.size(); ++i )
+    {
+	args[ i ].replace( "%p", item->path() );
+	args[ i ].replace( "%n", item->name() );
+
+	if ( ! dirName.isEmpty() )
+	    args[ i ].replace( "%d", dirName );
+    }
+
+    return args;
+}
+
+
 QString Cleanup::quoted( const QString & unquoted) const
 {
     return "'" + unquoted + "'";
@@ -246,22 +294,36 @@ void Cleanup::runCommand( const FileInfo * item,
 			  const QString	 & command,
 			  OutputWindow	 * outputWindow ) const
 {
-    QString shell = chooseShell( outputWindow );
+    // Starting a shell for each item doubles the cost of each process if
+    // the command is only a program with some arguments
 
-    if ( shell.isEmpty() )
+    QStringList args = directCommand( item, command );
+    QString	program;
+
+    if ( ! args.isEmpty() )
     {
-	outputWindow->show(); // Regardless of user settings
-	outputWindow->addStderr( tr( "No usable shell - aborting cleanup action" ) );
-	logError() << "ERROR: No usable shell" << endl;
-	return;
+	program = args.takeFirst();
+    }
+    else
+    {
+	program = chooseShell( outputWindow );
+
+	if ( program.isEmpty() )
+	{
+	    outputWindow->show(); // Regardless of user settings
+	    outputWindow->addStderr( tr( "No usable shell - aborting cleanup action" ) );
+	    logError() << "ERROR: No usable shell" << endl;
+	    return;
+	}
+
+	args << "-c" << expandVariables( item, command );
     }
 
-    QString cleanupCommand( expandVariables( item, command ));
     Process * process = new Process( parent() );
     CHECK_NEW( process );
 
-    process->setProgram( shell );
-    process->setArguments( QStringList() << "-c" << cleanupCommand );
+    process->setProgram( program );
+    process->setArguments( args );
     process->setWorkingDirectory( itemDir( item ) );
     // logDebug() << "New process \"" << process << endl;
 
@@ -131,6 +131,14 @@ namespace QDirStat
 	 **/
 	bool askForConfirmation() const { return _askForConfirmation; }
 
+	/**
+	 * Return 'true' if this cleanup does nothing else than deleting the
+	 * selected items with all their contents ("rm -rf %p"). This can be
+	 * done in-process by a DeleteEngine rather than by starting a shell
+	 * and an "rm" process for each item.
+	 **/
+	bool isPlainDelete() const;
+
 	/**
 	 * Return the shell to use to invoke the command of this cleanup.
 	 * If this is is empty, use defaultShells().first().
@@ -184,16 +192,12 @@ namespace QDirStat
 	 * refresh the entire tree.
 	 *
 	 * AssumeDeleted: Do not actually refresh the DirTree.	Instead,
-	 * blindly assume the cleanup action has deleted the item that was
-	 * passed to Cleanup::execute() and delete the corresponding subtree
-	 * in the DirTree accordingly. This will work well for most deleting
-	 * actions as long as they can be performed without problems. If there
-	 * are any problems, however, the DirTree might easily run out of sync
-	 * with the directory tree: The DirTree will show the subtree as
-	 * deleted (i.e. it will not show it any more), but it still exists on
-	 * disk. This is the tradeoff to a very quick response. On the other
-	 * hand, the user can easily at any time hit one of the explicit
-	 * refresh buttons and everything will be back into sync again.
+	 * assume the cleanup action has deleted the item that was passed to
+	 * Cleanup::execute() and delete the corresponding subtree in the
+	 * DirTree accordingly when the cleanup is finished. This is checked
+	 * with a cheap lstat() for each item: If an item still exists, its
+	 * parent is refreshed. This is much faster than RefreshParent for
+	 * parents with many entries.
 	 **/
 	enum RefreshPolicy refreshPolicy() const { return _refreshPolicy; }
 
@@ -250,6 +254,21 @@ namespace QDirStat
 	 **/
 	bool outputWindowAutoClose() const { return _outputWindowAutoClose; }
 
+	/**
+	 * Return the maximum number of processes of this cleanup that run in
+	 * parallel if it is started for several items. The default is 1,
+	 * i.e. one item after another. The output of each process is still
+	 * shown in the order of the items.
+	 **/
+	int maxParallel() const { return _maxParallel; }
+
+	/**
+	 * Return 'true' if no more processes of this cleanup are started
+	 * after one of them failed, i.e. returned a non-zero exit code,
+	 * crashed or could not be started at all.
+	 **/
+	bool failFast() const { return _failFast; }
+
 	/**
 	 * Return a mapping from RefreshPolicy to string.
 	 **/
@@ -311,6 +330,8 @@ namespace QDirStat
 	void setOutputWindowPolicy   ( OutputWindowPolicy policy ) { _outputWindowPolicy    = policy;	 }
 	void setOutputWindowTimeout  ( int timeoutMillisec )	   { _outputWindowTimeout   = timeoutMillisec; }
 	void setOutputWindowAutoClose( bool autoClose )		   { _outputWindowAutoClose = autoClose; }
+	void setMaxParallel	     ( int maxParallel )	   { _maxParallel	    = qMax( 1, maxParallel ); }
+	void setFailFast	     ( bool failFast )		   { _failFast		    = failFast;	 }
 
 
     public slots:
@@ -392,6 +413,21 @@ namespace QDirStat
 	 **/
 	QString expandDesktopSpecificApps( const QString & unexpanded ) const;
 
+	/**
+	 * Return the directory that %d expands to for 'item' or an empty
+	 * string if there is none.
+	 **/
+	QString variableDirName( const FileInfo * item ) const;
+
+	/**
+	 * Return the program and the arguments to run 'unexpanded' for
+	 * 'item' directly without a shell, or an empty list if it needs a
+	 * shell: If it has any shell syntax like quotes, pipes or
+	 * redirections, or if the command is not a program in $PATH.
+	 **/
+	QStringList directCommand( const FileInfo * item,
+				   const QString  & unexpanded ) const;
+
 	/**
 	 * Return a string with all occurrences of a single quote escaped with
 	 * backslash.
@@ -429,6 +465,8 @@ namespace QDirStat
 	OutputWindowPolicy _outputWindowPolicy;
 	int		   _outputWindowTimeout;
 	bool		   _outputWindowAutoClose;
+	int		   _maxParallel;
+	bool		   _failFast;
     };
 
 
@@ -20,6 +20,8 @@
 #include "SelectionModel.h"
 #include "OutputWindow.h"
 #include "Refresher.h"
+#include "TreePatcher.h"
+#include "DeleteEngine.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -254,6 +256,8 @@ void CleanupCollection::execute()
     OutputWindow * outputWindow = new OutputWindow( qApp->activeWindow() );
     CHECK_NEW( outputWindow );
     outputWindow->setAutoClose( cleanup->outputWindowAutoClose() );
+    outputWindow->setMaxParallel( cleanup->maxParallel() );
+    outputWindow->setFailFast( cleanup->failFast() );
 
     switch ( cleanup->outputWindowPolicy() )
     {
@@ -273,6 +277,15 @@ void CleanupCollection::execute()
 	    break;
     }
 
+    connect( outputWindow, SIGNAL( lastProcessFinished( int ) ),
+	     this,	   SIGNAL( cleanupFinished    ( int ) ) );
+
+    if ( cleanup->isPlainDelete() )
+    {
+	executePlainDelete( cleanup, selection, outputWindow );
+	return;
+    }
+
     if ( cleanup->refreshPolicy() == Cleanup::RefreshThis ||
 	 cleanup->refreshPolicy() == Cleanup::RefreshParent )
     {
@@ -287,9 +300,17 @@ void CleanupCollection::execute()
 	connect( outputWindow, SIGNAL( lastProcessFinished( int ) ),
 		 refresher,    SLOT  ( refresh()		) );
     }
+    else if ( cleanup->refreshPolicy() == Cleanup::AssumeDeleted )
+    {
+	// It is important to use the normalized FileInfoSet here: Removing
+	// an item from the tree also removes all its descendants.
 
-    connect( outputWindow, SIGNAL( lastProcessFinished( int ) ),
-	     this,	   SIGNAL( cleanupFinished    ( int ) ) );
+	TreePatcher * treePatcher = new TreePatcher( selection.invalidRemoved().normalized(), this );
+	CHECK_NEW( treePatcher );
+
+	connect( outputWindow, SIGNAL( lastProcessFinished( int ) ),
+		 treePatcher,  SLOT  ( patch()			) );
+    }
 
 
     // Intentionally not using the normalized FileInfoSet here: If a user
@@ -310,25 +331,38 @@ void CleanupCollection::execute()
 	}
     }
 
-    if ( cleanup->refreshPolicy() == Cleanup::AssumeDeleted )
+    outputWindow->noMoreProcesses();
+}
+
+
+void CleanupCollection::executePlainDelete( Cleanup *		cleanup,
+					     const FileInfoSet & selection,
+					     OutputWindow *	outputWindow )
+{
+    // Deleting an item also deletes everything below it, so only the
+    // normalized set is needed here. The DeleteEngine takes care of the
+    // tree: It removes what was deleted instead of reading it again.
+
+    FileInfoSet items;
+
+    foreach ( FileInfo * item, selection.invalidRemoved().normalized() )
     {
-        // It is important to use the normalized FileInfoSet here to avoid a
-        // segfault because we are iterating over items whose ancestors we just
-        // deleted (thus invalidating pointers to it). Normalizing removes
-        // items from the set that also have any ancestors in the set.
-
-        foreach ( FileInfo * item, selection.invalidRemoved().normalized() )
-        {
-            DirTree * tree = item->tree();
-
-            if ( tree->isBusy() )
-                logWarning() << "Ignoring AssumeDeleted: DirTree is being read" << endl;
-            else
-                tree->deleteSubtree( item );
-        }
+	if ( cleanup->worksFor( item ) )
+	    items << item;
+	else
+	{
+	    logWarning() << "Cleanup " << cleanup
+			 << " does not work for " << item << endl;
+	}
     }
 
-    outputWindow->noMoreProcesses();
+    DeleteEngine * engine = new DeleteEngine( items, outputWindow, this );
+    CHECK_NEW( engine );
+
+    // This calls outputWindow->noMoreProcesses() when it is done and then
+    // deletes itself.
+
+    engine->start();
 }
 
 
@@ -515,6 +549,8 @@ void CleanupCollection::readSettings()
 	    bool askForConfirmation    = settings.value( "AskForConfirmation"	, false ).toBool();
 	    bool outputWindowAutoClose = settings.value( "OutputWindowAutoClose", false ).toBool();
 	    int	 outputWindowTimeout   = settings.value( "OutputWindowTimeout"	, 0	).toInt();
+	    int	 maxParallel	       = settings.value( "MaxParallelProcesses" , 1	).toInt();
+	    bool failFast	       = settings.value( "FailFast"		, false ).toBool();
 
 	    int refreshPolicy	    = readEnumEntry( settings, "RefreshPolicy",
 						     Cleanup::NoRefresh,
@@ -539,6 +575,8 @@ void CleanupCollection::readSettings()
 		cleanup->setAskForConfirmation	 ( askForConfirmation	 );
 		cleanup->setOutputWindowAutoClose( outputWindowAutoClose );
 		cleanup->setOutputWindowTimeout	 ( outputWindowTimeout	 );
+		cleanup->setMaxParallel		 ( maxParallel		 );
+		cleanup->setFailFast		 ( failFast		 );
 		cleanup->setRefreshPolicy     ( static_cast<Cleanup::RefreshPolicy>( refreshPolicy ) );
 		cleanup->setOutputWindowPolicy( static_cast<Cleanup::OutputWindowPolicy>( outputWindowPolicy ) );
 
@@ -597,6 +635,8 @@ void CleanupCollection::writeSettings()
 	settings.setValue( "Recurse"		  , cleanup->recurse()		     );
 	settings.setValue( "AskForConfirmation"	  , cleanup->askForConfirmation()    );
 	settings.setValue( "OutputWindowAutoClose", cleanup->outputWindowAutoClose() );
+	settings.setValue( "MaxParallelProcesses" , cleanup->maxParallel()	     );
+	settings.setValue( "FailFast"		  , cleanup->failFast()		     );
 
 	if ( cleanup->outputWindowTimeout() > 0 )
 	    settings.setValue( "OutputWindowTimeout"  , cleanup->outputWindowTimeout()	 );
@@ -20,6 +20,7 @@
 
 class QMenu;
 class QToolBar;
+class OutputWindow;
 
 
 namespace QDirStat
@@ -192,6 +193,14 @@ namespace QDirStat
 	 **/
 	bool confirmation( Cleanup * cleanup, const FileInfoSet & items );
 
+	/**
+	 * Execute a cleanup that only deletes the selected items with a
+	 * DeleteEngine instead of starting a process for each of them.
+	 **/
+	void executePlainDelete( Cleanup *	     cleanup,
+				 const FileInfoSet & selection,
+				 OutputWindow *	     outputWindow );
+
 	/**
 	 * Return the URLs for the selected item types in 'items':
 	 * Directories, non-directories, or both.
@@ -154,6 +154,8 @@ void CleanupConfigPage::save( void * value )
     cleanup->setOutputWindowTimeout( timeout );
 
     cleanup->setOutputWindowAutoClose( _ui->outputWindowAutoCloseCheckBox->isChecked() );
+    cleanup->setMaxParallel( _ui->maxParallelSpinBox->value() );
+    cleanup->setFailFast( _ui->failFastCheckBox->isChecked() );
 
     policy = _ui->refreshPolicyComboBox->currentIndex();
     cleanup->setRefreshPolicy( static_cast<Cleanup::RefreshPolicy>( policy ) );
@@ -192,6 +194,8 @@ void CleanupConfigPage::load( void * value )
 
     _ui->outputWindowTimeoutSpinBox->setValue( timeout / 1000.0 );
     _ui->outputWindowAutoCloseCheckBox->setChecked( cleanup->outputWindowAutoClose() );
+    _ui->maxParallelSpinBox->setValue( cleanup->maxParallel() );
+    _ui->failFastCheckBox->setChecked( cleanup->failFast() );
 
     _ui->refreshPolicyComboBox->setCurrentIndex( cleanup->refreshPolicy() );
 }
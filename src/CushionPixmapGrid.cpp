@@ -0,0 +1,111 @@
+/*
+ *   File name: CushionPixmapGrid.cpp
+ *   Summary:	Rendered treemap cushions as a grid of pixmaps
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QPainter>
+
+#include "CushionPixmapGrid.h"
+#include "CushionRenderer.h"
+
+
+using namespace QDirStat;
+
+
+CushionPixmapGrid::CushionPixmapGrid():
+    _columns( 0 ),
+    _rows( 0 ),
+    _pending( 0 )
+{
+    // NOP
+}
+
+
+void CushionPixmapGrid::clear()
+{
+    _image   = QImage();
+    _size    = QSize();
+    _columns = 0;
+    _rows    = 0;
+    _pending = 0;
+    _blocks.clear();
+}
+
+
+void CushionPixmapGrid::setImage( const QImage & framebuffer )
+{
+    clear();
+
+    if ( framebuffer.isNull() )
+	return;
+
+    _image   = framebuffer;
+    _size    = framebuffer.size();
+    _columns = ( _size.width()	+ CUSHION_BLOCK_SIZE - 1 ) / CUSHION_BLOCK_SIZE;
+    _rows    = ( _size.height() + CUSHION_BLOCK_SIZE - 1 ) / CUSHION_BLOCK_SIZE;
+    _pending = _columns * _rows;
+    _blocks.resize( _pending );
+}
+
+
+QRect CushionPixmapGrid::blockRect( int index ) const
+{
+    QRect rect( ( index % _columns ) * CUSHION_BLOCK_SIZE,
+		( index / _columns ) * CUSHION_BLOCK_SIZE,
+		CUSHION_BLOCK_SIZE,
+		CUSHION_BLOCK_SIZE );
+
+    return rect & QRect( QPoint( 0, 0 ), _size );
+}
+
+
+const QPixmap & CushionPixmapGrid::block( int index )
+{
+    QPixmap & pixmap = _blocks[ index ];
+
+    if ( pixmap.isNull() && ! _image.isNull() )
+    {
+	pixmap = QPixmap::fromImage( _image.copy( blockRect( index ) ) );
+
+	if ( --_pending == 0 )
+	    _image = QImage();	// Everything is in the pixmaps now
+    }
+
+    return pixmap;
+}
+
+
+void CushionPixmapGrid::draw( QPainter *	 painter,
+			      const QRect &	 sourceRect,
+			      const QRectF &	 exposedRect )
+{
+    if ( isNull() )
+	return;
+
+    QRect rect = sourceRect & exposedRect.toAlignedRect() & QRect( QPoint( 0, 0 ), _size );
+
+    if ( rect.isEmpty() )
+	return;
+
+    int firstColumn = rect.left()   / CUSHION_BLOCK_SIZE;
+    int lastColumn  = rect.right()  / CUSHION_BLOCK_SIZE;
+    int firstRow    = rect.top()    / CUSHION_BLOCK_SIZE;
+    int lastRow	    = rect.bottom() / CUSHION_BLOCK_SIZE;
+
+    for ( int row = firstRow; row <= lastRow; ++row )
+    {
+	for ( int col = firstColumn; col <= lastColumn; ++col )
+	{
+	    int	  index = row * _columns + col;
+	    QRect part	= blockRect( index ) & rect;
+
+	    painter->drawPixmap( part.topLeft(),
+				 block( index ),
+				 part.translated( -blockRect( index ).topLeft() ) );
+	}
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ *   File name: CushionPixmapGrid.h
+ *   Summary:	Rendered treemap cushions as a grid of pixmaps
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef CushionPixmapGrid_h
+#define CushionPixmapGrid_h
+
+
+#include <QImage>
+#include <QPixmap>
+#include <QVector>
+#include <QRect>
+
+class QPainter;
+
+
+namespace QDirStat
+{
+    /**
+     * The framebuffer with the rendered cushions of a treemap, split into
+     * square blocks (see CUSHION_BLOCK_SIZE) that are converted to pixmaps
+     * only when they are painted for the first time. Painting only draws
+     * the blocks in the exposed part of the view, so a small repaint like
+     * for the hover highlight doesn't copy the whole framebuffer, and a
+     * huge framebuffer on a high resolution screen never needs one pixmap
+     * of its full size.
+     *
+     * When all blocks are converted, the framebuffer image is released, so
+     * there is only one copy of the pixels.
+     **/
+    class CushionPixmapGrid
+    {
+    public:
+
+	/**
+	 * Constructor. The grid is empty until setImage() is called.
+	 **/
+	CushionPixmapGrid();
+
+	/**
+	 * Use 'framebuffer' from now on. The QImage is implicitly shared,
+	 * so this doesn't copy it.
+	 **/
+	void setImage( const QImage & framebuffer );
+
+	/**
+	 * Drop everything.
+	 **/
+	void clear();
+
+	/**
+	 * Return 'true' if there is nothing to paint.
+	 **/
+	bool isNull() const { return _size.isEmpty(); }
+
+	/**
+	 * Return the size of the framebuffer.
+	 **/
+	QSize size() const { return _size; }
+
+	/**
+	 * Paint the part 'sourceRect' of the framebuffer at the same
+	 * coordinates, but only as much of it as is in 'exposedRect'.
+	 **/
+	void draw( QPainter *	   painter,
+		   const QRect &   sourceRect,
+		   const QRectF &  exposedRect );
+
+
+    protected:
+
+	/**
+	 * Return the pixmap of block 'index'; convert it first if needed.
+	 **/
+	const QPixmap & block( int index );
+
+	/**
+	 * Return the framebuffer rectangle of block 'index'.
+	 **/
+	QRect blockRect( int index ) const;
+
+
+	QImage		  _image;
+	QSize		  _size;
+	int		  _columns;
+	int		  _rows;
+	int		  _pending;	// number of blocks not converted yet
+	QVector<QPixmap>  _blocks;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef CushionPixmapGrid_h
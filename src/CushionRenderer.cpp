@@ -0,0 +1,187 @@
+/*
+ *   File name: CushionRenderer.cpp
+ *   Summary:	Render all treemap cushions with several threads
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QThread>
+#include <QList>
+#include <QAtomicInt>
+
+#include "CushionRenderer.h"
+#include "Exception.h"
+#include "Logger.h"
+
+// Framebuffers with fewer pixels than this are rendered in the calling thread
+#define MIN_PIXELS_FOR_THREADS	(256 * 256)
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Render the part of the cushion of 'job' that is in 'clipRect' into
+     * the framebuffer starting at 'bits'.
+     *
+     * This gets the raw framebuffer memory rather than the QImage because
+     * the non-const QImage accessors may detach, which is not thread-safe.
+     **/
+    void renderJob( uchar *			 bits,
+		    int				 bytesPerLine,
+		    const CushionRenderer::Job & job,
+		    const QRect &		 clipRect )
+    {
+	QRect rect = job.rect & clipRect;
+
+	if ( rect.isEmpty() )
+	    return;
+
+	// Compute the start of each row in double to avoid cancellation
+	// for tiles far away from the origin
+
+	double nx0    = 2.0 * job.xx2 * rect.left() + job.xx1;
+	double nxStep = 2.0 * job.xx2;
+
+	for ( int y = rect.top(); y <= rect.bottom(); ++y )
+	{
+	    double ny	= 2.0 * job.yy2 * y + job.yy1;
+	    QRgb * line = (QRgb *) ( bits + (qptrdiff) y * bytesPerLine ) + rect.left();
+
+	    CushionShader::shadeRow( line, rect.width(),
+				     nx0, nxStep, ny, job.params );
+	}
+    }
+
+
+    /**
+     * Thread to render blocks of the framebuffer: It takes the next block
+     * that nobody took yet from 'nextBlock' until there are no more.
+     **/
+    class CushionRenderThread: public QThread
+    {
+    public:
+
+	CushionRenderThread( uchar *				 bits,
+			     int				 bytesPerLine,
+			     const QVector<CushionRenderer::Job> & jobs,
+			     const QVector<QRect> &		 blockRects,
+			     const QVector<QVector<int> > &	 blockJobs,
+			     QAtomicInt &			 nextBlock ):
+	    _bits( bits ),
+	    _bytesPerLine( bytesPerLine ),
+	    _jobs( jobs ),
+	    _blockRects( blockRects ),
+	    _blockJobs( blockJobs ),
+	    _nextBlock( nextBlock )
+	    {}
+
+    protected:
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    int block;
+
+	    while ( ( block = _nextBlock.fetchAndAddOrdered( 1 ) ) < _blockRects.size() )
+	    {
+		foreach ( int job, _blockJobs.at( block ) )
+		    renderJob( _bits, _bytesPerLine, _jobs.at( job ), _blockRects.at( block ) );
+	    }
+	}
+
+	uchar *					_bits;
+	int					_bytesPerLine;
+	const QVector<CushionRenderer::Job> &	_jobs;
+	const QVector<QRect> &			_blockRects;
+	const QVector<QVector<int> > &		_blockJobs;
+	QAtomicInt &				_nextBlock;
+    };
+
+}	// namespace
+
+
+void CushionRenderer::render( QImage & framebuffer, const QVector<Job> & jobs )
+{
+    if ( framebuffer.isNull() || jobs.isEmpty() )
+	return;
+
+    // Clip all jobs to the framebuffer so the threads don't need to care
+
+    QRect	 imageRect = framebuffer.rect();
+    QVector<Job> clippedJobs;
+    clippedJobs.reserve( jobs.size() );
+
+    foreach ( const Job & job, jobs )
+    {
+	Job clipped = job;
+	clipped.rect &= imageRect;
+
+	if ( ! clipped.rect.isEmpty() )
+	    clippedJobs << clipped;
+    }
+
+    // Detach the framebuffer (if necessary) here, in the calling thread
+
+    uchar * bits	 = framebuffer.bits();
+    int	    bytesPerLine = framebuffer.bytesPerLine();
+    int	    columns	 = ( framebuffer.width()  + CUSHION_BLOCK_SIZE - 1 ) / CUSHION_BLOCK_SIZE;
+    int	    rows	 = ( framebuffer.height() + CUSHION_BLOCK_SIZE - 1 ) / CUSHION_BLOCK_SIZE;
+    int	    threadCount	 = qMin( QThread::idealThreadCount(), columns * rows );
+
+    if ( threadCount < 2 || (qint64) framebuffer.width() * framebuffer.height() < MIN_PIXELS_FOR_THREADS )
+    {
+	foreach ( const Job & job, clippedJobs )
+	    renderJob( bits, bytesPerLine, job, imageRect );
+
+	return;
+    }
+
+    // Sort the jobs into the blocks they touch, keeping their order
+
+    QVector<QRect>	   blockRects( columns * rows );
+    QVector<QVector<int> > blockJobs ( columns * rows );
+
+    for ( int i = 0; i < blockRects.size(); ++i )
+    {
+	blockRects[ i ] = QRect( ( i % columns ) * CUSHION_BLOCK_SIZE,
+				 ( i / columns ) * CUSHION_BLOCK_SIZE,
+				 CUSHION_BLOCK_SIZE,
+				 CUSHION_BLOCK_SIZE ) & imageRect;
+    }
+
+    for ( int i = 0; i < clippedJobs.size(); ++i )
+    {
+	const QRect & rect = clippedJobs.at( i ).rect;
+
+	for ( int row = rect.top() / CUSHION_BLOCK_SIZE; row <= rect.bottom() / CUSHION_BLOCK_SIZE; ++row )
+	{
+	    for ( int col = rect.left() / CUSHION_BLOCK_SIZE; col <= rect.right() / CUSHION_BLOCK_SIZE; ++col )
+		blockJobs[ row * columns + col ] << i;
+	}
+    }
+
+    // logDebug() << "Rendering " << clippedJobs.size() << " cushions in "
+    //		  << blockRects.size() << " blocks with " << threadCount << " threads" << endl;
+
+    QAtomicInt	     nextBlock( 0 );
+    QList<QThread *> threads;
+
+    for ( int i = 0; i < threadCount; ++i )
+    {
+	QThread * thread = new CushionRenderThread( bits, bytesPerLine, clippedJobs,
+						    blockRects, blockJobs, nextBlock );
+	CHECK_NEW( thread );
+
+	threads << thread;
+	thread->start();
+    }
+
+    foreach ( QThread * thread, threads )
+	thread->wait();
+
+    qDeleteAll( threads );
+}
@@ -0,0 +1,75 @@
+/*
+ *   File name: CushionRenderer.h
+ *   Summary:	Render all treemap cushions with several threads
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef CushionRenderer_h
+#define CushionRenderer_h
+
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+#include "CushionShader.h"
+
+// Width and height of the blocks of the framebuffer that are rendered and
+// painted separately (see also CushionPixmapGrid)
+#define CUSHION_BLOCK_SIZE	256
+
+
+namespace QDirStat
+{
+    /**
+     * Renderer for the cushions of all tiles of a treemap into one
+     * framebuffer image with the size of the scene.
+     *
+     * The cushion of a tile depends only on its rectangle, its cushion
+     * surface and its color, so all that is collected (in the GUI thread)
+     * in one Job for each tile first. The framebuffer is then split into
+     * square blocks of CUSHION_BLOCK_SIZE pixels, and a few threads take
+     * one block after another and render the parts of all tiles in that
+     * block, so a region with many small tiles doesn't keep one thread
+     * busy while the others are idle. The threads never write to the same
+     * pixel, even where neighbouring tiles overlap by one pixel because of
+     * rounding; in that case the later tile wins like when painting.
+     **/
+    class CushionRenderer
+    {
+    public:
+
+	/**
+	 * Everything needed to render the cushion of one tile.
+	 *
+	 * The normal vector of the cushion surface at pixel ( x, y ) of the
+	 * framebuffer is ( 2 * xx2 * x + xx1, 2 * yy2 * y + yy1, 1 ).
+	 **/
+	struct Job
+	{
+	    QRect		  rect;		// in framebuffer pixels
+	    double		  xx1;
+	    double		  xx2;
+	    double		  yy1;
+	    double		  yy2;
+	    CushionShader::Params params;
+	};
+
+	/**
+	 * Render the cushions of 'jobs' into 'framebuffer' in that order and
+	 * return when all of them are rendered. 'framebuffer' must have
+	 * format QImage::Format_RGB32.
+	 *
+	 * Small framebuffers are rendered in the calling thread.
+	 **/
+	static void render( QImage & framebuffer, const QVector<Job> & jobs );
+
+    };	// class CushionRenderer
+
+}	// namespace QDirStat
+
+
+#endif // ifndef CushionRenderer_h
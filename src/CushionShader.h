@@ -0,0 +1,192 @@
+/*
+ *   File name: CushionShader.h
+ *   Summary:	Fast per-row shading of treemap cushions
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef CushionShader_h
+#define CushionShader_h
+
+
+#include <math.h>
+
+#include <QRgb>
+
+#if defined( __SSE2__ )
+#  include <emmintrin.h>
+#  define CUSHION_SHADER_SSE2	1
+#elif defined( __aarch64__ ) && defined( __ARM_NEON )
+#  include <arm_neon.h>
+#  define CUSHION_SHADER_NEON	1
+#endif
+
+
+namespace QDirStat
+{
+    /**
+     * The inner loop of rendering a cushion treemap tile: The brightness
+     * of each pixel is the cosine between the light source and the normal
+     * vector of the cushion surface at that pixel, which needs a square
+     * root and a division for each pixel.
+     *
+     * Within one row, the y component of the normal vector is constant and
+     * the x component grows linearly, so a row is shaded 4 pixels at a time
+     * with SSE2 (which every x86_64 CPU has) or NEON on aarch64, and with a
+     * plain loop on other platforms. AVX would need a runtime CPU check.
+     *
+     * This uses float rather than double, which is more than precise
+     * enough for 8 bit color components.
+     **/
+    namespace CushionShader
+    {
+	/**
+	 * The parameters that are the same for all pixels of a tile.
+	 **/
+	struct Params
+	{
+	    float lightX;
+	    float lightY;
+	    float lightZ;
+	    float maxRed;	// color component minus the ambient light
+	    float maxGreen;
+	    float maxBlue;
+	    int	  ambientLight;
+	};
+
+
+	/**
+	 * Return the shaded color of one pixel with the cushion normal
+	 * vector ( 'nx', 'ny', 1 ).
+	 **/
+	inline QRgb shadePixel( float nx, float ny, const Params & params )
+	{
+	    float cosa = ( nx * params.lightX + ny * params.lightY + params.lightZ ) /
+		sqrtf( nx * nx + ny * ny + 1.0f );
+
+	    int red   = (int) ( params.maxRed   * cosa + 0.5f );
+	    int green = (int) ( params.maxGreen * cosa + 0.5f );
+	    int blue  = (int) ( params.maxBlue  * cosa + 0.5f );
+
+	    if ( red   < 0 )	red   = 0;
+	    if ( green < 0 )	green = 0;
+	    if ( blue  < 0 )	blue  = 0;
+
+	    return qRgb( red   + params.ambientLight,
+			 green + params.ambientLight,
+			 blue  + params.ambientLight );
+	}
+
+
+	/**
+	 * Shade 'width' pixels of one row into 'line': The normal vector of
+	 * pixel i is ( nx0 + i * nxStep, 'ny', 1 ).
+	 **/
+	inline void shadeRow( QRgb *	     line,
+			      int	     width,
+			      float	     nx0,
+			      float	     nxStep,
+			      float	     ny,
+			      const Params & params )
+	{
+	    int x = 0;
+
+#if CUSHION_SHADER_SSE2
+
+	    const __m128  lightX    = _mm_set1_ps( params.lightX );
+	    const __m128  lightYZ   = _mm_set1_ps( ny * params.lightY + params.lightZ );
+	    const __m128  nyNy1	    = _mm_set1_ps( ny * ny + 1.0f );
+	    const __m128  maxRed    = _mm_set1_ps( params.maxRed   );
+	    const __m128  maxGreen  = _mm_set1_ps( params.maxGreen );
+	    const __m128  maxBlue   = _mm_set1_ps( params.maxBlue  );
+	    const __m128  half	    = _mm_set1_ps( 0.5f );
+	    const __m128i zero	    = _mm_setzero_si128();
+	    const __m128i ambient   = _mm_set1_epi32( params.ambientLight );
+	    const __m128i byteMask  = _mm_set1_epi32( 0xFF );
+	    const __m128i alpha	    = _mm_set1_epi32( (int) 0xFF000000 );
+	    const __m128  step4	    = _mm_set1_ps( 4.0f * nxStep );
+	    __m128	  nx	    = _mm_add_ps( _mm_set1_ps( nx0 ),
+						  _mm_mul_ps( _mm_set1_ps( nxStep ),
+							      _mm_set_ps( 3.0f, 2.0f, 1.0f, 0.0f ) ) );
+
+	    for ( ; x + 4 <= width; x += 4 )
+	    {
+		__m128 cosa = _mm_div_ps( _mm_add_ps( _mm_mul_ps( nx, lightX ), lightYZ ),
+					  _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( nx, nx ), nyNy1 ) ) );
+
+		// Truncate like the (int) cast, then clamp negative values to 0
+
+		__m128i red   = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( maxRed,   cosa ), half ) );
+		__m128i green = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( maxGreen, cosa ), half ) );
+		__m128i blue  = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( maxBlue,  cosa ), half ) );
+
+		red   = _mm_and_si128( red,   _mm_cmpgt_epi32( red,   zero ) );
+		green = _mm_and_si128( green, _mm_cmpgt_epi32( green, zero ) );
+		blue  = _mm_and_si128( blue,  _mm_cmpgt_epi32( blue,  zero ) );
+
+		red   = _mm_and_si128( _mm_add_epi32( red,   ambient ), byteMask );
+		green = _mm_and_si128( _mm_add_epi32( green, ambient ), byteMask );
+		blue  = _mm_and_si128( _mm_add_epi32( blue,  ambient ), byteMask );
+
+		__m128i pixels = _mm_or_si128( _mm_or_si128( alpha, _mm_slli_epi32( red, 16 ) ),
+					       _mm_or_si128( _mm_slli_epi32( green, 8 ), blue ) );
+
+		_mm_storeu_si128( (__m128i *) ( line + x ), pixels );
+		nx = _mm_add_ps( nx, step4 );
+	    }
+
+#elif CUSHION_SHADER_NEON
+
+	    const float32x4_t lightX   = vdupq_n_f32( params.lightX );
+	    const float32x4_t lightYZ  = vdupq_n_f32( ny * params.lightY + params.lightZ );
+	    const float32x4_t nyNy1    = vdupq_n_f32( ny * ny + 1.0f );
+	    const float32x4_t maxRed   = vdupq_n_f32( params.maxRed   );
+	    const float32x4_t maxGreen = vdupq_n_f32( params.maxGreen );
+	    const float32x4_t maxBlue  = vdupq_n_f32( params.maxBlue  );
+	    const float32x4_t half     = vdupq_n_f32( 0.5f );
+	    const int32x4_t   zero     = vdupq_n_s32( 0 );
+	    const int32x4_t   ambient  = vdupq_n_s32( params.ambientLight );
+	    const uint32x4_t  byteMask = vdupq_n_u32( 0xFF );
+	    const uint32x4_t  alpha    = vdupq_n_u32( 0xFF000000 );
+	    const float32x4_t step4    = vdupq_n_f32( 4.0f * nxStep );
+	    const float	      offsets[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+	    float32x4_t	      nx       = vmlaq_n_f32( vdupq_n_f32( nx0 ), vld1q_f32( offsets ), nxStep );
+
+	    for ( ; x + 4 <= width; x += 4 )
+	    {
+		float32x4_t cosa = vdivq_f32( vmlaq_f32( lightYZ, nx, lightX ),
+					      vsqrtq_f32( vmlaq_f32( nyNy1, nx, nx ) ) );
+
+		// vcvtq_s32_f32() truncates like the (int) cast
+
+		int32x4_t red	= vmaxq_s32( vcvtq_s32_f32( vmlaq_f32( half, maxRed,	cosa ) ), zero );
+		int32x4_t green = vmaxq_s32( vcvtq_s32_f32( vmlaq_f32( half, maxGreen, cosa ) ), zero );
+		int32x4_t blue	= vmaxq_s32( vcvtq_s32_f32( vmlaq_f32( half, maxBlue,	cosa ) ), zero );
+
+		uint32x4_t r = vandq_u32( vreinterpretq_u32_s32( vaddq_s32( red,   ambient ) ), byteMask );
+		uint32x4_t g = vandq_u32( vreinterpretq_u32_s32( vaddq_s32( green, ambient ) ), byteMask );
+		uint32x4_t b = vandq_u32( vreinterpretq_u32_s32( vaddq_s32( blue,  ambient ) ), byteMask );
+
+		uint32x4_t pixels = vorrq_u32( vorrq_u32( alpha, vshlq_n_u32( r, 16 ) ),
+					       vorrq_u32( vshlq_n_u32( g, 8 ), b ) );
+
+		vst1q_u32( (uint32_t *) ( line + x ), pixels );
+		nx = vaddq_f32( nx, step4 );
+	    }
+
+#endif
+
+	    // The remaining pixels (or all of them without SIMD)
+
+	    for ( ; x < width; ++x )
+		line[ x ] = shadePixel( nx0 + x * nxStep, ny, params );
+	}
+
+    }	// namespace CushionShader
+
+}	// namespace QDirStat
+
+
+#endif // ifndef CushionShader_h
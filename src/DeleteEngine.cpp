@@ -0,0 +1,396 @@
+/*
+ *   File name: DeleteEngine.cpp
+ *   Summary:	Delete files and directories without starting any processes
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>	// strcmp()
+
+#include "DeleteEngine.h"
+#include "OutputWindow.h"
+#include "DirTree.h"
+#include "FileInfo.h"
+#include "QDirStatApp.h"	// SelectionModel
+#include "SelectionModel.h"
+#include "Refresher.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+#define MAX_DELETE_THREADS	4
+#define PROGRESS_INTERVAL	10000	// Report progress every n deleted files
+
+
+using namespace QDirStat;
+
+
+DeleteWorker::DeleteWorker( DeleteEngine * engine ):
+    QThread(),
+    _engine( engine )
+{
+    // NOP
+}
+
+
+void DeleteWorker::run()
+{
+    DeleteTask * task;
+
+    while ( ( task = _engine->takeTask() ) != 0 )
+    {
+	if ( task->parent )
+	    deleteDirEntries( task );
+	else
+	    deleteTarget( task );
+    }
+}
+
+
+void DeleteWorker::deleteTarget( DeleteTask * task )
+{
+    struct stat statInfo;
+    QByteArray path = task->path.toUtf8();
+
+    if ( lstat( path, &statInfo ) == 0 && S_ISDIR( statInfo.st_mode ) )
+    {
+	deleteDirEntries( task );
+	return;
+    }
+
+    // No directory, so finishTask() must not try to remove one.
+    // Like "rm -f", don't complain if it is already gone.
+
+    bool success = true;
+
+    if ( unlink( path ) == 0 )
+	_engine->fileDeleted();
+    else if ( errno != ENOENT )
+    {
+	reportError( task->path );
+	success = false;
+    }
+
+    _engine->targetFinished( task->target, success );
+    delete task;
+}
+
+
+void DeleteWorker::deleteDirEntries( DeleteTask * task )
+{
+    int dirFd = open( task->path.toUtf8(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC );
+    DIR * dir = dirFd < 0 ? 0 : fdopendir( dirFd );
+
+    if ( ! dir )
+    {
+	reportError( task->path );
+	task->failed.storeRelease( 1 );
+
+	if ( dirFd >= 0 )
+	    close( dirFd );
+
+	finishTask( task );
+	return;
+    }
+
+    struct dirent * entry;
+
+    while ( ( entry = readdir( dir ) ) != 0 )
+    {
+	if ( strcmp( entry->d_name, "." ) == 0 || strcmp( entry->d_name, ".." ) == 0 )
+	    continue;
+
+	bool isDir = entry->d_type == DT_DIR;
+
+	if ( entry->d_type == DT_UNKNOWN )
+	{
+	    struct stat statInfo;
+
+	    if ( fstatat( dirFd, entry->d_name, &statInfo, AT_SYMLINK_NOFOLLOW ) == 0 )
+		isDir = S_ISDIR( statInfo.st_mode );
+	}
+
+	QString entryPath = task->path + "/" + QString::fromUtf8( entry->d_name );
+
+	if ( isDir )
+	{
+	    // Another worker can take this subdirectory while this one goes
+	    // on with the files here.
+
+	    task->pending.ref();
+	    _engine->addTask( new DeleteTask( entryPath, task, -1 ) );
+	}
+	else if ( unlinkat( dirFd, entry->d_name, 0 ) == 0 )
+	{
+	    _engine->fileDeleted();
+	}
+	else if ( errno != ENOENT )
+	{
+	    reportError( entryPath );
+	    task->failed.storeRelease( 1 );
+	}
+    }
+
+    closedir( dir ); // This also closes dirFd
+    finishTask( task );
+}
+
+
+void DeleteWorker::finishTask( DeleteTask * task )
+{
+    while ( task && ! task->pending.deref() )
+    {
+	// All entries of this directory are finished now. If any of them
+	// could not be deleted, removing the directory would only fail again
+	// with "Directory not empty"; that error was already reported.
+
+	if ( ! task->failed.loadAcquire() )
+	{
+	    if ( rmdir( task->path.toUtf8() ) == 0 )
+		_engine->dirDeleted();
+	    else if ( errno != ENOENT )
+	    {
+		reportError( task->path );
+		task->failed.storeRelease( 1 );
+	    }
+	}
+
+	DeleteTask * parent = task->parent;
+
+	if ( parent )
+	{
+	    if ( task->failed.loadAcquire() )
+		parent->failed.storeRelease( 1 );
+	}
+	else
+	{
+	    _engine->targetFinished( task->target, ! task->failed.loadAcquire() );
+	}
+
+	delete task;
+	task = parent;
+    }
+}
+
+
+void DeleteWorker::reportError( const QString & path )
+{
+    QString msg = QObject::tr( "Cannot delete %1: %2" ).arg( path ).arg( formatErrno() );
+
+    emit _engine->error( msg );
+}
+
+
+
+
+DeleteEngine::DeleteEngine( const FileInfoSet & items,
+			    OutputWindow *	outputWindow,
+			    QObject *		parent ):
+    QObject( parent ),
+    _tree( 0 ),
+    _outputWindow( outputWindow ),
+    _pendingTargets( 0 ),
+    _deletedFiles( 0 ),
+    _deletedDirs( 0 ),
+    _runningWorkers( 0 )
+{
+    // Like Refresher, store the tree right away: By the time it is needed,
+    // the items are gone.
+
+    if ( ! items.isEmpty() )
+	_tree = items.first()->tree();
+
+    foreach ( FileInfo * item, items )
+    {
+	_paths << item->path();
+	_urls  << item->url();
+    }
+
+    _success.fill( false, _paths.size() );
+
+    if ( _outputWindow )
+    {
+	connect( this,		SIGNAL( progress ( QString ) ),
+		 _outputWindow, SLOT  ( addStdout( QString ) ) );
+
+	connect( this,		SIGNAL( error	 ( QString ) ),
+		 _outputWindow, SLOT  ( addStderr( QString ) ) );
+    }
+}
+
+
+DeleteEngine::~DeleteEngine()
+{
+    foreach ( DeleteWorker * worker, _workers )
+	worker->wait();
+
+    qDeleteAll( _workers );
+
+    // Only left over if the workers were never started
+    qDeleteAll( _queue );
+}
+
+
+void DeleteEngine::start()
+{
+    int threadCount = qBound( 1, QThread::idealThreadCount(), MAX_DELETE_THREADS );
+
+    if ( _outputWindow )
+	_outputWindow->addCommandLine( tr( "Deleting %1 items" ).arg( _paths.size() ) );
+
+    logInfo() << "Deleting " << _paths.size() << " items in " << threadCount << " threads" << endl;
+
+    {
+	QMutexLocker locker( &_mutex );
+
+	for ( int i = 0; i < _paths.size(); ++i )
+	    _queue << new DeleteTask( _paths.at( i ), 0, i );
+
+	_pendingTargets = _paths.size();
+    }
+
+    if ( _paths.isEmpty() )
+    {
+	workerFinished(); // Nothing to do; this finishes immediately
+	return;
+    }
+
+    for ( int i = 0; i < threadCount; ++i )
+    {
+	DeleteWorker * worker = new DeleteWorker( this );
+	CHECK_NEW( worker );
+
+	connect( worker, SIGNAL( finished()	  ),
+		 this,	 SLOT  ( workerFinished() ) );
+
+	_workers << worker;
+	++_runningWorkers;
+	worker->start();
+    }
+}
+
+
+DeleteTask * DeleteEngine::takeTask()
+{
+    QMutexLocker locker( &_mutex );
+
+    while ( _queue.isEmpty() && _pendingTargets > 0 )
+	_taskAvailable.wait( &_mutex );
+
+    if ( _queue.isEmpty() )
+	return 0;
+
+    // Taking the newest task first deletes depth-first, so the queue
+    // remains small.
+
+    return _queue.takeLast();
+}
+
+
+void DeleteEngine::addTask( DeleteTask * task )
+{
+    QMutexLocker locker( &_mutex );
+
+    _queue << task;
+    _taskAvailable.wakeOne();
+}
+
+
+void DeleteEngine::targetFinished( int target, bool success )
+{
+    QMutexLocker locker( &_mutex );
+
+    _success[ target ] = success;
+
+    if ( --_pendingTargets == 0 )
+	_taskAvailable.wakeAll(); // Let all workers finish
+}
+
+
+void DeleteEngine::fileDeleted()
+{
+    int count = _deletedFiles.fetchAndAddOrdered( 1 ) + 1;
+
+    if ( count % PROGRESS_INTERVAL == 0 )
+	emit progress( tr( "%1 files deleted..." ).arg( count ) );
+}
+
+
+void DeleteEngine::workerFinished()
+{
+    if ( _runningWorkers > 0 && --_runningWorkers > 0 )
+	return;
+
+    int files = _deletedFiles.loadAcquire();
+    int dirs  = _deletedDirs.loadAcquire();
+
+    logInfo() << "Deleted " << files << " files and " << dirs << " directories" << endl;
+
+    if ( _outputWindow )
+	_outputWindow->addStdout( tr( "Deleted %1 files and %2 directories." ).arg( files ).arg( dirs ) );
+
+    updateTree();
+
+    if ( _outputWindow )
+	_outputWindow->noMoreProcesses();
+
+    deleteLater();
+}
+
+
+void DeleteEngine::updateTree()
+{
+    if ( ! _tree )
+	return;
+
+    if ( _tree->isBusy() )
+    {
+	logWarning() << "Not updating the tree: DirTree is being read" << endl;
+	return;
+    }
+
+    // Locate each item only now: The tree might have changed in the
+    // meantime, so no FileInfo pointers are kept.
+
+    for ( int i = 0; i < _urls.size(); ++i )
+    {
+	if ( _success.at( i ) )
+	{
+	    FileInfo * item = _tree->locate( _urls.at( i ) );
+
+	    if ( item )
+		_tree->deleteSubtree( item );
+	}
+    }
+
+    FileInfoSet failed;
+
+    for ( int i = 0; i < _urls.size(); ++i )
+    {
+	if ( ! _success.at( i ) )
+	{
+	    FileInfo * item = _tree->locate( _urls.at( i ) );
+
+	    if ( item )
+		failed << item;
+	}
+    }
+
+    if ( ! failed.isEmpty() )
+    {
+	// Some of those items might be deleted partially
+
+	FileInfoSet refreshSet = Refresher::parents( failed );
+
+	app()->selectionModel()->prepareRefresh( refreshSet );
+	_tree->refresh( refreshSet );
+    }
+}
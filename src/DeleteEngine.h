@@ -0,0 +1,228 @@
+/*
+ *   File name: DeleteEngine.h
+ *   Summary:	Delete files and directories without starting any processes
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DeleteEngine_h
+#define DeleteEngine_h
+
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QPointer>
+#include <QVector>
+#include <QList>
+#include <QString>
+
+#include "FileInfoSet.h"
+
+
+class OutputWindow;
+
+
+namespace QDirStat
+{
+    class DeleteEngine;
+    class DirTree;
+
+
+    /**
+     * One file or directory to delete. A directory is only removed when all
+     * of its entries are deleted; 'pending' counts the subdirectories that
+     * are not finished yet plus one for reading the directory itself.
+     **/
+    struct DeleteTask
+    {
+	DeleteTask( const QString & path, DeleteTask * parent, int target ):
+	    path( path ),
+	    parent( parent ),
+	    pending( 1 ),
+	    failed( 0 ),
+	    target( target )
+	    {}
+
+	QString	     path;
+	DeleteTask * parent;
+	QAtomicInt   pending;
+	QAtomicInt   failed;
+	int	     target;	// Index of the target for toplevel tasks, -1 otherwise
+    };
+
+
+    /**
+     * Worker thread of a DeleteEngine: Take the next task from the engine
+     * and delete it until there are no more tasks.
+     **/
+    class DeleteWorker: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	DeleteWorker( DeleteEngine * engine );
+
+    protected:
+
+	/**
+	 * The worker loop. This is called in the new thread.
+	 *
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	/**
+	 * Delete the file or the directory of a toplevel task.
+	 **/
+	void deleteTarget( DeleteTask * task );
+
+	/**
+	 * Delete all non-directory entries of the directory of 'task' with
+	 * unlinkat() on the directory's file descriptor, and hand each
+	 * subdirectory to the engine as a new task.
+	 **/
+	void deleteDirEntries( DeleteTask * task );
+
+	/**
+	 * Notification that one part of 'task' is finished. If that was the
+	 * last one, remove the directory and go on with its parent.
+	 **/
+	void finishTask( DeleteTask * task );
+
+	/**
+	 * Report an error for 'path' with the current 'errno'.
+	 **/
+	void reportError( const QString & path );
+
+
+	DeleteEngine * _engine;
+    };
+
+
+    /**
+     * Engine to delete a number of files and directories with all their
+     * contents ("rm -rf") in-process and in several threads, rather than
+     * starting a shell and an "rm" process for each of them.
+     *
+     * Subdirectories are deleted in parallel, each by whatever worker thread
+     * is free; a directory itself is removed when all of its subdirectories
+     * are gone.
+     *
+     * Progress and errors are reported to an OutputWindow. When everything
+     * is done, the deleted items are removed from the DirTree directly; the
+     * parents of items that could not be deleted completely are read
+     * again. Then OutputWindow::noMoreProcesses() is called, and this object
+     * deletes itself.
+     **/
+    class DeleteEngine: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor. 'items' should be normalized, i.e. not contain any
+	 * item together with one of its ancestors. Call start() to start the
+	 * worker threads.
+	 **/
+	DeleteEngine( const FileInfoSet & items,
+		      OutputWindow *	  outputWindow,
+		      QObject *		  parent = 0 );
+
+	/**
+	 * Destructor. This waits for the worker threads.
+	 **/
+	virtual ~DeleteEngine();
+
+	/**
+	 * Start the worker threads.
+	 **/
+	void start();
+
+
+	// For the worker threads
+
+	/**
+	 * Return the next task in the queue. If the queue is empty, wait
+	 * until there is one. Return 0 when everything is done.
+	 **/
+	DeleteTask * takeTask();
+
+	/**
+	 * Add a task to the queue.
+	 **/
+	void addTask( DeleteTask * task );
+
+	/**
+	 * Notification that the toplevel task for target no. 'target' is
+	 * finished; 'success' is 'true' if it was deleted completely.
+	 **/
+	void targetFinished( int target, bool success );
+
+	/**
+	 * Notification that a file (or any other non-directory) was deleted.
+	 **/
+	void fileDeleted();
+
+	/**
+	 * Notification that a directory was deleted.
+	 **/
+	void dirDeleted() { _deletedDirs.ref(); }
+
+
+    signals:
+
+	/**
+	 * Emitted (from the worker threads) for progress messages.
+	 **/
+	void progress( const QString & msg );
+
+	/**
+	 * Emitted (from the worker threads) for error messages.
+	 **/
+	void error( const QString & msg );
+
+
+    protected slots:
+
+	/**
+	 * Notification that a worker thread is finished.
+	 **/
+	void workerFinished();
+
+
+    protected:
+
+	/**
+	 * Remove the deleted items from the tree and refresh the parents of
+	 * the items that could not be deleted.
+	 **/
+	void updateTree();
+
+
+	DirTree *		_tree;
+	QPointer<OutputWindow>	_outputWindow;
+	QStringList		_paths;
+	QStringList		_urls;
+	QVector<bool>		_success;
+	QList<DeleteTask *>	_queue;
+	int			_pendingTargets;
+	QMutex			_mutex;
+	QWaitCondition		_taskAvailable;
+	QAtomicInt		_deletedFiles;
+	QAtomicInt		_deletedDirs;
+	QList<DeleteWorker *>	_workers;
+	int			_runningWorkers;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// DeleteEngine_h
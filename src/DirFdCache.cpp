@@ -0,0 +1,135 @@
+/*
+ *   File name: DirFdCache.cpp
+ *   Summary:	Open directory file descriptors for fd-relative reading
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <unistd.h>
+
+#include <QMutexLocker>
+
+#include "DirFdCache.h"
+
+// Maximum number of open directories in the cache. This should be well
+// below the usual limit of 1024 open files per process; one directory of
+// each level of the worker threads' current paths is enough.
+
+#define DIR_FD_CACHE_SIZE	256
+
+
+using namespace QDirStat;
+
+
+QMutex				DirFdCache::_mutex;
+QHash<DirFdCache::Key, DirFdCache::Entry> DirFdCache::_entries;
+quint64				DirFdCache::_clock = 0;
+
+
+int DirFdCache::acquire( dev_t device, ino_t inode )
+{
+    QMutexLocker locker( &_mutex );
+
+    QHash<Key, Entry>::iterator it = _entries.find( Key( device, inode ) );
+
+    if ( it == _entries.end() )
+	return -1;
+
+    it->users++;
+    it->lastUse = ++_clock;
+
+    return it->fd;
+}
+
+
+void DirFdCache::release( dev_t device, ino_t inode )
+{
+    QMutexLocker locker( &_mutex );
+
+    QHash<Key, Entry>::iterator it = _entries.find( Key( device, inode ) );
+
+    if ( it == _entries.end() )
+	return;
+
+    if ( --it->users == 0 && it->obsolete )
+    {
+	::close( it->fd );
+	_entries.erase( it );
+    }
+}
+
+
+void DirFdCache::insert( dev_t device, ino_t inode, int fd )
+{
+    if ( fd < 0 )
+	return;
+
+    QMutexLocker locker( &_mutex );
+
+    Key key( device, inode );
+    QHash<Key, Entry>::iterator it = _entries.find( key );
+
+    if ( it != _entries.end() )
+    {
+	// Read again (e.g. refreshed): Keep the one that is already there
+
+	::close( fd );
+	it->lastUse = ++_clock;
+
+	return;
+    }
+
+    Entry entry;
+    entry.fd	   = fd;
+    entry.users	   = 0;
+    entry.lastUse  = ++_clock;
+    entry.obsolete = false;
+
+    _entries.insert( key, entry );
+    evict();
+}
+
+
+void DirFdCache::evict()
+{
+    while ( _entries.size() > DIR_FD_CACHE_SIZE )
+    {
+	QHash<Key, Entry>::iterator oldest = _entries.end();
+
+	for ( QHash<Key, Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it )
+	{
+	    if ( it->users == 0 && ( oldest == _entries.end() || it->lastUse < oldest->lastUse ) )
+		oldest = it;
+	}
+
+	if ( oldest == _entries.end() )	// all of them in use
+	    return;
+
+	::close( oldest->fd );
+	_entries.erase( oldest );
+    }
+}
+
+
+void DirFdCache::clear()
+{
+    QMutexLocker locker( &_mutex );
+
+    QHash<Key, Entry>::iterator it = _entries.begin();
+
+    while ( it != _entries.end() )
+    {
+	if ( it->users == 0 )
+	{
+	    ::close( it->fd );
+	    it = _entries.erase( it );
+	}
+	else
+	{
+	    it->obsolete = true;
+	    ++it;
+	}
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ *   File name: DirFdCache.h
+ *   Summary:	Open directory file descriptors for fd-relative reading
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DirFdCache_h
+#define DirFdCache_h
+
+
+#include <sys/types.h>
+
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+
+
+namespace QDirStat
+{
+    /**
+     * A bounded cache of open file descriptors of directories that were
+     * just read, so their subdirectories can be opened with openat()
+     * relative to them: The kernel then only has to look up one name
+     * instead of resolving the complete path from the root directory
+     * again for each directory.
+     *
+     * The directories are identified by device and i-number, not by path,
+     * so a directory that was renamed in the meantime is still found. If
+     * there are more than DIR_FD_CACHE_SIZE directories, the one that was
+     * used least recently is closed.
+     *
+     * All methods are static and thread-safe; they are used by the worker
+     * threads that read directories.
+     **/
+    class DirFdCache
+    {
+    public:
+
+	/**
+	 * Return the file descriptor of directory 'device' / 'inode' or -1
+	 * if it is not in the cache. The descriptor stays open until
+	 * release() is called for it.
+	 **/
+	static int acquire( dev_t device, ino_t inode );
+
+	/**
+	 * Release a file descriptor that was obtained with acquire().
+	 **/
+	static void release( dev_t device, ino_t inode );
+
+	/**
+	 * Add the file descriptor 'fd' of directory 'device' / 'inode' to
+	 * the cache. This takes ownership of 'fd': It is closed when it is
+	 * no longer needed.
+	 **/
+	static void insert( dev_t device, ino_t inode, int fd );
+
+	/**
+	 * Close all file descriptors that are not in use. Those that are
+	 * still in use are closed when they are released.
+	 *
+	 * This is called when reading a tree is finished so no directories
+	 * are kept open (which would make unmounting fail).
+	 **/
+	static void clear();
+
+
+    protected:
+
+	typedef QPair<dev_t, ino_t> Key;
+
+	struct Entry
+	{
+	    int	    fd;
+	    int	    users;
+	    quint64 lastUse;
+	    bool    obsolete;	// close it when it is no longer in use
+	};
+
+	/**
+	 * Close the least recently used file descriptors that are not in use
+	 * until there are no more than DIR_FD_CACHE_SIZE left.
+	 * The mutex has to be locked.
+	 **/
+	static void evict();
+
+
+	static QMutex		  _mutex;
+	static QHash<Key, Entry>  _entries;
+	static quint64		  _clock;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// DirFdCache_h
@@ -8,19 +8,37 @@
 
 
 #include <algorithm>
+#include <limits.h>	// INT_MAX
 
 #include "DirInfo.h"
 #include "DirTree.h"
+#include "DirTreeCache.h"
 #include "DotEntry.h"
 #include "Attic.h"
 #include "FileInfoIterator.h"
 #include "FileInfoSorter.h"
+#include "FileColumns.h"
+#include "FileAgeStats.h"
+#include "OwnerStats.h"
 #include "ExcludeRules.h"
 #include "Exception.h"
+#include "SubtreeFinalizer.h"
 #include "DebugHelpers.h"
 
 #define DIRECT_CHILDREN_COUNT_SANITY_CHECK 0
 
+// Below this number of children, searching the sorted children list is
+// cheaper than building and keeping an index for it
+#define MIN_SORTED_ROWS_INDEX	32
+
+// Number of largest children that each directory keeps track of: Enough
+// for the first screen of a tree view sorted by size
+#define LARGEST_CHILDREN_COUNT	32
+
+// Directories with at least this many children find their largest children
+// when they are finalized; smaller ones only when they are needed
+#define MIN_LARGEST_CHILDREN_ITEMS	1000
+
 using namespace QDirStat;
 
 
@@ -43,9 +61,6 @@ DirInfo::DirInfo( const QString & filenameWithoutPath,
 		parent )
 {
     init();
-    ensureDotEntry();
-
-    _directChildrenCount++;	// One for the newly created dot entry
 }
 
 
@@ -63,14 +78,12 @@ DirInfo::DirInfo( DirTree *	  tree,
 		mtime )
 {
     init();
-    ensureDotEntry();
-
-    _directChildrenCount++;	// One for the newly created dot entry
 }
 
 
 void DirInfo::init()
 {
+    _nodeKind		 = DirNode;
     _dotEntry		 = 0;
     _attic		 = 0;
     _isMountPoint	 = false;
@@ -79,11 +92,18 @@ void DirInfo::init()
     _deletingAll	 = false;
     _locked		 = false;
     _touched		 = false;
+    _isCachePlaceholder	 = false;
+    _isEstimated	 = false;
+    _isQuotaPlaceholder	 = false;
+    _isOverBudget	 = false;
+    _labelGeneration	 = 0;
+    _preOrder		 = 0;
+    _lastPreOrder	 = 0;
     _pendingReadJobs	 = 0;
     _dotEntry		 = 0;
     _firstChild		 = 0;
     _totalSize		 = _size;
-    _totalAllocatedSize	 = _allocatedSize;
+    _totalAllocatedSize	 = rawAllocatedSize();
     _totalBlocks	 = _blocks;
     _totalItems		 = 0;
     _totalSubDirs	 = 0;
@@ -94,22 +114,133 @@ void DirInfo::init()
     _errSubDirCount	 = 0;
     _latestMtime	 = _mtime;
     _oldestFileMtime	 = 0;
+    _fileAgeSummary	 = 0;
+    _ownerSummary	 = 0;
     _readState		 = DirQueued;
+    _childVector	 = 0;
+    _fileColumns	 = 0;
     _sortedChildren	 = 0;
+    _sortedChildrenRows	 = 0;
+    _unsortedChildren	 = 0;
     _lastSortCol	 = UndefinedCol;
     _lastSortOrder	 = Qt::AscendingOrder;
+    _lastIncludeAttic	 = false;
+    _largestChildren	 = 0;
 }
 
 
 DirInfo::~DirInfo()
 {
-    clear();
+    // The ancestors already subtracted this complete subtree when it was
+    // deleted (see deletingChild()), so there is no need to notify them
+    // about each child again.
+    //
+    // The same goes for the file age and owner summaries; deleting this
+    // one first keeps deleteChildren() from dropping those of the
+    // ancestors.
+
+    if ( _fileAgeSummary )
+    {
+	delete _fileAgeSummary;
+	_fileAgeSummary = 0;
+    }
+
+    if ( _ownerSummary )
+    {
+	delete _ownerSummary;
+	_ownerSummary = 0;
+    }
+
+    if ( readError() && _tree && ! _tree->beingDestroyed() )
+	_tree->forgetErrorDir( this );
+
+    deleteChildren( false );
+}
+
+
+qint64 DirInfo::auxMemory() const
+{
+    qint64 bytes = 0;
+
+    if ( _childVector )
+	bytes += sizeof( FileInfoList ) + _childVector->size() * sizeof( FileInfo * );
+
+    if ( _fileColumns )
+	bytes += _fileColumns->memory();
+
+    if ( _sortedChildren )
+	bytes += sizeof( FileInfoList ) + _sortedChildren->size() * sizeof( FileInfo * );
+
+    if ( _sortedChildrenRows )
+    {
+	// Key, value and the next pointer per node, and the bucket array
+
+	bytes += sizeof( QHash<FileInfo *, int> ) +
+	    _sortedChildrenRows->size() * ( 2 * sizeof( void * ) + 2 * sizeof( int ) ) +
+	    _sortedChildrenRows->capacity() * sizeof( void * );
+    }
+
+    if ( _largestChildren )
+	bytes += sizeof( LargestChildren ) + _largestChildren->items.size() * sizeof( FileInfo * );
+
+    if ( _fileAgeSummary )
+    {
+	bytes += sizeof( FileAgeSummary ) +
+	    _fileAgeSummary->entries().capacity() * sizeof( FileAgeSummary::Entry );
+    }
+
+    if ( _ownerSummary )
+	bytes += sizeof( OwnerSummary ) + _ownerSummary->entriesMemory();
+
+    return bytes;
 }
 
 
 void DirInfo::clear()
+{
+    deleteChildren( true );
+}
+
+
+DirInfo * DirInfo::detachChildren()
+{
+    DirInfo * holder = new DirInfo( _tree, 0 );
+    CHECK_NEW( holder );
+
+    dropChildVector();
+    dropLargestChildren();
+
+    holder->_firstChild = _firstChild;
+    holder->_dotEntry	= _dotEntry;
+    holder->_attic	= _attic;
+
+    // The labels of the children would still say that they are in this
+    // subtree
+
+    if ( _tree && ( _firstChild || _dotEntry || _attic ) )
+	_tree->invalidateSubtreeLabels();
+
+    for ( FileInfo * child = _firstChild; child; child = child->next() )
+	child->setParent( holder );
+
+    if ( _dotEntry )
+	_dotEntry->setParent( holder );
+
+    if ( _attic )
+	_attic->setParent( holder );
+
+    _firstChild = 0;
+    _dotEntry	= 0;
+    _attic	= 0;
+
+    return holder;
+}
+
+
+void DirInfo::deleteChildren( bool notifyParent )
 {
     _deletingAll = true;
+    dropChildVector();
 
     // Recursively delete all children.
 
@@ -117,7 +248,7 @@ void DirInfo::clear()
     {
 	FileInfo * nextChild = _firstChild->next();
 
-	if ( _parent )
+	if ( _parent && notifyParent )
 	    _parent->deletingChild( _firstChild );
 
 	delete _firstChild;
@@ -129,12 +260,18 @@ void DirInfo::clear()
 
     if ( _dotEntry )
     {
+	if ( _parent && notifyParent )
+	    _parent->deletingChild( _dotEntry );
+
 	delete _dotEntry;
 	_dotEntry = 0;
     }
 
     if ( _attic )
     {
+	if ( _parent && notifyParent )
+	    _parent->deletingChild( _attic );
+
 	delete _attic;
 	_attic = 0;
     }
@@ -142,28 +279,132 @@ void DirInfo::clear()
     _summaryDirty = true;
     _deletingAll  = false;
     dropSortCache();
+    dropLargestChildren();
+    dropFileAgeSummaries();
+    dropOwnerSummaries();
 }
 
 
 void DirInfo::reset()
 {
+    if ( _isCachePlaceholder )
+    {
+	// The summaries of the parents include the summary of the placeholder
+
+	_isCachePlaceholder = false;
+
+	if ( _parent )
+	    _parent->markSummaryDirty();
+    }
+
+    if ( _isEstimated || _isQuotaPlaceholder )
+    {
+	_isEstimated	    = false;
+	_isQuotaPlaceholder = false;
+
+	if ( _parent )
+	    _parent->markSummaryDirty();
+    }
+
+    _isOverBudget = false;
+
     if ( _firstChild || _dotEntry || _attic )
 	clear();
 
-    _readState	     = DirQueued;
+    setReadState( DirQueued );
     _pendingReadJobs = 0;
     _summaryDirty    = true;
 
-    ensureDotEntry();
-
-    if ( _tree )
-	_tree->childAddedNotify( _dotEntry );
-
     recalc();
     dropSortCache();
 }
 
 
+void DirInfo::markSummaryDirty()
+{
+    for ( DirInfo * dir = this; dir; dir = dir->parent() )
+    {
+	dir->_summaryDirty = true;
+	dir->dropLargestChildren();
+    }
+}
+
+
+const FileAgeSummary * DirInfo::fileAgeSummary()
+{
+    if ( ! _fileAgeSummary )
+    {
+	_fileAgeSummary = new FileAgeSummary();
+	CHECK_NEW( _fileAgeSummary );
+
+	FileInfoIterator it( this );
+
+	while ( *it )
+	{
+	    FileInfo * item = *it;
+
+	    if ( item->isDirInfo() )
+		_fileAgeSummary->add( *item->toDirInfo()->fileAgeSummary() );
+	    else if ( item->isFile() )
+		_fileAgeSummary->addFile( item );
+
+	    ++it;
+	}
+    }
+
+    return _fileAgeSummary;
+}
+
+
+void DirInfo::dropFileAgeSummaries()
+{
+    for ( DirInfo * dir = this; dir && dir->_fileAgeSummary; dir = dir->parent() )
+    {
+	delete dir->_fileAgeSummary;
+	dir->_fileAgeSummary = 0;
+    }
+}
+
+
+const OwnerSummary * DirInfo::ownerSummary()
+{
+    if ( ! _ownerSummary )
+    {
+	_ownerSummary = new OwnerSummary();
+	CHECK_NEW( _ownerSummary );
+
+	if ( ! isPseudoDir() )
+	    _ownerSummary->addItem( this );
+
+	FileInfoIterator it( this );
+
+	while ( *it )
+	{
+	    FileInfo * item = *it;
+
+	    if ( item->isDirInfo() )
+		_ownerSummary->add( *item->toDirInfo()->ownerSummary() );
+	    else
+		_ownerSummary->addItem( item );
+
+	    ++it;
+	}
+    }
+
+    return _ownerSummary;
+}
+
+
+void DirInfo::dropOwnerSummaries()
+{
+    for ( DirInfo * dir = this; dir && dir->_ownerSummary; dir = dir->parent() )
+    {
+	delete dir->_ownerSummary;
+	dir->_ownerSummary = 0;
+    }
+}
+
+
 DotEntry * DirInfo::ensureDotEntry()
 {
     if ( ! _dotEntry )
@@ -172,6 +413,11 @@ DotEntry * DirInfo::ensureDotEntry()
 
 	_dotEntry = new DotEntry( _tree, this );
 	CHECK_NEW( _dotEntry );
+	dropSortCache();
+	dropLargestChildren();
+
+	if ( _tree )
+	    _tree->unlabeledDirAdded();
     }
 
     return _dotEntry;
@@ -180,10 +426,15 @@ DotEntry * DirInfo::ensureDotEntry()
 
 void DirInfo::deleteEmptyDotEntry()
 {
-    if ( ! _dotEntry->firstChild() && ! _dotEntry->hasAtticChildren() )
+    if ( ! _dotEntry->firstChild() && ! _dotEntry->hasAtticChildren() &&
+	 ! _dotEntry->isCachePlaceholder() )	// spilled files
     {
+	if ( _largestChildren )
+	    _largestChildren->items.removeOne( _dotEntry );
+
 	delete _dotEntry;
 	_dotEntry = 0;
+	dropSortCache();
 
 	countDirectChildren();
     }
@@ -198,6 +449,12 @@ Attic * DirInfo::ensureAttic()
 
 	_attic = new Attic( _tree, this );
 	CHECK_NEW( _attic );
+
+	if ( _tree )
+	    _tree->unlabeledDirAdded();
+
+	if ( _lastIncludeAttic )
+	    dropSortCache();
     }
 
     return _attic;
@@ -224,8 +481,17 @@ void DirInfo::recalc()
 {
     // logDebug() << this << endl;
 
+    if ( _isCachePlaceholder || _isEstimated || _isQuotaPlaceholder )
+    {
+	// Keep the summary from the cache index, the estimate or the quota:
+	// There are no children yet
+
+	_summaryDirty = false;
+	return;
+    }
+
     _totalSize		 = _size;
-    _totalAllocatedSize	 = _allocatedSize;
+    _totalAllocatedSize	 = rawAllocatedSize();
     _totalBlocks	 = _blocks;
     _totalItems		 = 0;
     _totalSubDirs	 = 0;
@@ -237,57 +503,61 @@ void DirInfo::recalc()
     _latestMtime	 = _mtime;
     _oldestFileMtime	 = 0;
 
-    FileInfoIterator it( this );
+    const FileColumns * columns = _dotEntry ? 0 : fileColumns();
 
-    while ( *it )
+    if ( columns )
     {
-	_directChildrenCount++;
-	_totalSize	     += (*it)->totalSize();
-	_totalAllocatedSize  += (*it)->totalAllocatedSize();
-	_totalBlocks	     += (*it)->totalBlocks();
-	_totalItems	     += (*it)->totalItems() + 1;
-	_totalSubDirs	     += (*it)->totalSubDirs();
-	_errSubDirCount	     += (*it)->errSubDirCount();
-	_totalFiles	     += (*it)->totalFiles();
-	_totalIgnoredItems   += (*it)->totalIgnoredItems();
-	_totalUnignoredItems += (*it)->totalUnignoredItems();
-
-	if ( (*it)->isDir() )
-	{
-	    _totalSubDirs++;
-
-	    if ( (*it)->readError() )
-		_errSubDirCount++;
-	}
-
-	if ( (*it)->isFile() )
-	    _totalFiles++;
+	// The same as below for children that are all files, but from the
+	// contiguous columns
+
+	int count	      = columns->count();
+	time_t latestMtime    = columns->latestMtime();
+
+	_directChildrenCount  = count;
+	_totalSize	     += columns->totalSize();
+	_totalAllocatedSize  += columns->totalAllocatedSize();
+	_totalBlocks	     += columns->totalBlocks();
+	_totalItems	      = count;
+	_totalFiles	      = columns->fileCount();
+	_totalIgnoredItems    = columns->ignoredCount();
+	_totalUnignoredItems  = count - columns->ignoredCount();
+	_oldestFileMtime      = columns->oldestFileMtime();
+
+	if ( latestMtime > _latestMtime )
+	    _latestMtime = latestMtime;
+    }
+    else
+    {
+	FileInfoIterator it( this );
 
-	if ( ! (*it)->isDir() )
+	while ( *it )
 	{
-	    if ( (*it)->isIgnored() )
-		_totalIgnoredItems++;
-	    else
-		_totalUnignoredItems++;
-	}
+	    _directChildrenCount++;
+	    addChildTotals( *it, 1 );
 
-	time_t childLatestMtime = (*it)->latestMtime();
+	    time_t childLatestMtime = (*it)->latestMtime();
 
-	if ( childLatestMtime > _latestMtime )
-	    _latestMtime = childLatestMtime;
+	    if ( childLatestMtime > _latestMtime )
+		_latestMtime = childLatestMtime;
 
-	time_t childOldestFileMTime = (*it)->oldestFileMtime();
+	    time_t childOldestFileMTime = (*it)->oldestFileMtime();
 
-	if ( childOldestFileMTime > 0 )
-	{
-	    if ( _oldestFileMtime == 0 ||
-		 childOldestFileMTime < _oldestFileMtime )
+	    if ( childOldestFileMTime > 0 )
 	    {
-		_oldestFileMtime = childOldestFileMTime;
+		if ( _oldestFileMtime == 0 ||
+		     childOldestFileMTime < _oldestFileMtime )
+		{
+		    _oldestFileMtime = childOldestFileMTime;
+		}
 	    }
+
+	    ++it;
 	}
 
-	++it;
+	// The columns are out of date (see FileColumns::isValid())
+
+	if ( _fileColumns )
+	    buildFileColumns();
     }
 
     if ( _attic )
@@ -300,6 +570,156 @@ void DirInfo::recalc()
 }
 
 
+void DirInfo::addChildTotals( FileInfo * child, int sign )
+{
+    _totalSize		 += sign * child->totalSize();
+    _totalAllocatedSize	 += sign * child->totalAllocatedSize();
+    _totalBlocks	 += sign * child->totalBlocks();
+    _totalItems		 += sign * ( child->totalItems() + 1 );
+    _totalSubDirs	 += sign * child->totalSubDirs();
+    _errSubDirCount	 += sign * child->errSubDirCount();
+    _totalFiles		 += sign * child->totalFiles();
+    _totalIgnoredItems	 += sign * child->totalIgnoredItems();
+    _totalUnignoredItems += sign * child->totalUnignoredItems();
+
+    if ( child->isDir() )
+    {
+	_totalSubDirs += sign;
+
+	if ( child->readError() )
+	    _errSubDirCount += sign;
+    }
+
+    if ( child->isFile() )
+	_totalFiles += sign;
+
+    if ( ! child->isDir() )
+    {
+	if ( child->isIgnored() )
+	    _totalIgnoredItems += sign;
+	else
+	    _totalUnignoredItems += sign;
+    }
+}
+
+
+void DirInfo::spillChildren()
+{
+    if ( _summaryDirty )
+	recalc();
+
+    _deletingAll = true;
+    dropChildVector();
+
+    while ( _firstChild )
+    {
+	FileInfo * nextChild = _firstChild->next();
+	delete _firstChild;
+	_firstChild = nextChild;
+    }
+
+    _deletingAll	 = false;
+    _isCachePlaceholder	 = true;
+    _directChildrenCount = 0;
+    dropSortCache();
+    dropLargestChildren();
+}
+
+
+void DirInfo::unspill()
+{
+    _isCachePlaceholder = false;
+
+    // Recalculate from the children that are added now. The totals don't
+    // change, but the summaries of the ancestors are only updated
+    // incrementally if they are dirty.
+
+    markSummaryDirty();
+}
+
+
+void DirInfo::setCachePlaceholder( const CacheBlockInfo & block )
+{
+    _isCachePlaceholder	 = true;
+    _totalSize		 = block.totalSize;
+    _totalAllocatedSize	 = block.totalAllocatedSize;
+    _totalBlocks	 = block.totalBlocks;
+    _totalItems		 = block.totalItems;
+    _totalSubDirs	 = block.totalSubDirs;
+    _totalFiles		 = block.totalFiles;
+    _totalIgnoredItems	 = 0;
+    _totalUnignoredItems = block.totalItems - block.totalSubDirs;
+    _directChildrenCount = 0;
+    _errSubDirCount	 = 0;
+    _latestMtime	 = block.latestMtime;
+    _oldestFileMtime	 = 0;
+    _summaryDirty	 = false;
+
+    // So far, the parents only added the size of this directory itself
+
+    if ( _parent )
+	_parent->markSummaryDirty();
+}
+
+
+void DirInfo::setEstimate( FileSize totalSize,
+			   FileSize totalAllocatedSize,
+			   FileSize totalBlocks,
+			   int	    totalItems,
+			   int	    totalSubDirs,
+			   int	    totalFiles )
+{
+    _isEstimated	 = true;
+    _totalSize		 = totalSize;
+    _totalAllocatedSize	 = totalAllocatedSize;
+    _totalBlocks	 = totalBlocks;
+    _totalItems		 = totalItems;
+    _totalSubDirs	 = totalSubDirs;
+    _totalFiles		 = totalFiles;
+    _totalIgnoredItems	 = 0;
+    _totalUnignoredItems = totalItems - totalSubDirs;
+    _summaryDirty	 = false;
+
+    if ( _parent )
+	_parent->markSummaryDirty();
+}
+
+
+void DirInfo::setQuotaPlaceholder( FileSize usedBytes, qint64 usedInodes )
+{
+    // The quota counts the directory itself, too
+
+    _isQuotaPlaceholder	 = true;
+    _totalSize		 = usedBytes;
+    _totalAllocatedSize	 = usedBytes;
+    _totalBlocks	 = usedBytes / STD_BLOCK_SIZE;
+    _totalItems		 = usedInodes > 0 ? (int) qMin( usedInodes - 1, (qint64) INT_MAX ) : 0;
+    _totalSubDirs	 = 0;
+    _totalFiles		 = _totalItems;
+    _totalIgnoredItems	 = 0;
+    _totalUnignoredItems = _totalItems;
+    _summaryDirty	 = false;
+
+    if ( _parent )
+	_parent->markSummaryDirty();
+}
+
+
+bool DirInfo::hasSubtreeLabels() const
+{
+    return _labelGeneration != 0 && _tree &&
+	_labelGeneration == _tree->subtreeLabelGeneration();
+}
+
+
+void DirInfo::setSubtreeLabels( int generation, int preOrder, int lastPreOrder )
+{
+    _labelGeneration = generation;
+    _preOrder	     = preOrder;
+    _lastPreOrder    = lastPreOrder;
+}
+
+
 void DirInfo::setMountPoint( bool isMountPoint )
 {
     _isMountPoint = isMountPoint;
@@ -470,7 +890,11 @@ void DirInfo::setReadState( DirReadState newReadState )
     if ( _readState == DirAborted && newReadState == DirFinished )
 	return;
 
+    bool hadReadError = readError();
     _readState = newReadState;
+
+    if ( readError() != hadReadError && _tree )
+	_tree->updateErrorDirs( this );
 }
 
 
@@ -491,6 +915,14 @@ void DirInfo::insertChild( FileInfo * newChild )
 {
     CHECK_PTR( newChild );
 
+    if ( newChild->isDir() && ! _dotEntry && _firstChild && ! _firstChild->isDir() &&
+	 ! isPseudoDirNode() )
+    {
+	// The first subdirectory: Only now the files need a dot entry
+
+	moveFilesToDotEntry();
+    }
+
     if ( newChild->isDir() || ! _dotEntry )
     {
 	/**
@@ -508,9 +940,23 @@ void DirInfo::insertChild( FileInfo * newChild )
 	 * none of our business; the corresponding "view" object for this tree
 	 * will take care of such niceties.
 	 **/
+	if ( newChild->parent() != this && newChild->isDirInfo() )
+	    newChild->toDirInfo()->dropPathCache();
+
+	if ( newChild->isDirNode() && _tree )
+	{
+	    // A directory with a label is moved here from somewhere else
+
+	    if ( newChild->nodeDirInfo()->hasSubtreeLabels() )
+		_tree->invalidateSubtreeLabels();
+	    else
+		_tree->unlabeledDirAdded();
+	}
+
 	newChild->setNext( _firstChild );
 	_firstChild = newChild;
 	newChild->setParent( this );	// make sure the parent pointer is correct
+	dropChildVector();
 
 	childAdded( newChild );		// update summaries
     }
@@ -625,35 +1071,66 @@ void DirInfo::childAdded( FileInfo * newChild )
 	}
     }
 
-    if ( _lastSortCol != ReadJobsCol )
+    dropLargestChildren();
+
+    if ( newChild->parent() == this )
+    {
+	addToSortCache( newChild );
+    }
+    else if ( _lastSortCol != ReadJobsCol && _lastSortCol != NameCol )
+    {
+	// The sort order by name does not change when grandchildren are
+	// added, but the order by any totals does.
+
 	dropSortCache();
+    }
+
+    if ( _fileAgeSummary )
+	dropFileAgeSummaries();
+
+    if ( _ownerSummary )
+	dropOwnerSummaries();
 
     if ( _parent )
 	_parent->childAdded( newChild );
 }
 
 
-void DirInfo::deletingChild( FileInfo * child )
+void DirInfo::addToSortCache( FileInfo * newChild )
 {
-    /**
-     * When children are deleted, things go downhill: Marking the summary
-     * fields as dirty (i.e. outdated) is the only thing that can be done here.
-     *
-     * The accumulated sizes could be updated (by subtracting this deleted
-     * child's values from them), but the latest mtime definitely has to be
-     * recalculated: The child now being deleted might just be the one with the
-     * latest mtime, and figuring out the second-latest cannot easily be
-     * done. So we merely mark the summary as dirty and wait until a recalc()
-     * will be triggered from outside - which might as well never happen if
-     * nobody wants to know some summary field anyway.
-     **/
+    if ( ! _sortedChildren || _lastSortCol == ReadJobsCol )
+	return;
 
-    _summaryDirty = true;
+    if ( _lastSortCol != NameCol )
+    {
+	dropSortCache();
+	return;
+    }
 
-    if ( _parent )
-	_parent->deletingChild( child );
+    // Sorting by name: Keep the sorted children and merge the new ones in
+    // when the sorted list is needed the next time. While reading a large
+    // directory, this is much cheaper than sorting everything again.
 
-    if ( child->parent() == this )
+    if ( _lastIncludeAttic && _attic )
+	_sortedChildren->insert( _sortedChildren->size() - 1, newChild );
+    else
+	_sortedChildren->append( newChild );
+
+    ++_unsortedChildren;
+
+    if ( _sortedChildrenRows )
+    {
+	delete _sortedChildrenRows;
+	_sortedChildrenRows = 0;
+    }
+}
+
+
+void DirInfo::deletingChild( FileInfo * child )
+{
+    subtractChild( child );
+
+    if ( child->parent() == this )
     {
 	if ( ! _deletingAll )
 	{
@@ -662,9 +1139,22 @@ void DirInfo::deletingChild( FileInfo * child )
 	     * doesn't happen recursively for all children of this object: No
 	     * use bothering about the validity of the children's list if this
 	     * will all be history anyway in a moment.
+	     *
+	     * The summary was already updated, so unlinkChild() must not mark
+	     * it as dirty.
 	     **/
 
+	    bool summaryDirty = _summaryDirty;
+	    FileAgeSummary * fileAgeSummary = _fileAgeSummary;
+	    OwnerSummary   * ownerSummary   = _ownerSummary;
+	    _fileAgeSummary = 0;
+	    _ownerSummary   = 0;
+
 	    unlinkChild( child );
+
+	    _summaryDirty   = summaryDirty;
+	    _fileAgeSummary = fileAgeSummary;
+	    _ownerSummary   = ownerSummary;
 	}
 	else
 	{
@@ -674,6 +1164,125 @@ void DirInfo::deletingChild( FileInfo * child )
 }
 
 
+void DirInfo::subtractChild( FileInfo * child )
+{
+    /**
+     * Subtract the totals of the deleted subtree from this directory and
+     * all its ancestors: That is O(depth) instead of a recalc() of each
+     * ancestor with all its direct children.
+     *
+     * The latest and the oldest mtime cannot be updated like that: If the
+     * child might be the one with the latest or the oldest mtime, the
+     * second-latest cannot easily be figured out, so the summary is marked
+     * as dirty and will be recalculated when anybody wants to know. The
+     * same goes for ignored items and attics: Above an attic, only its
+     * ignored items are counted.
+     **/
+
+    time_t childLatestMtime = child->latestMtime();
+    time_t childOldestMtime = child->oldestFileMtime();
+    bool   exact		= ! child->isIgnored() && ! child->isAttic();
+
+    // The child of each directory on the way up that shrinks
+
+    FileInfo * shrunk = child;
+
+    while ( shrunk && shrunk->parent() != this )
+	shrunk = shrunk->parent();
+
+    for ( DirInfo * dir = this; dir; dir = dir->parent() )
+    {
+	if ( shrunk != child )	// the child itself is removed with unlinkChild()
+	    dir->largestChildShrunk( shrunk );
+
+	shrunk = dir;
+
+	if ( dir->_summaryDirty )
+	{
+	    // Nothing to do here; the ancestors might still be up to date
+	}
+	else if ( exact &&
+		  childLatestMtime < dir->_latestMtime &&
+		  ( childOldestMtime == 0 || childOldestMtime > dir->_oldestFileMtime ) )
+	{
+	    dir->addChildTotals( child, -1 );
+
+	    if ( child->parent() == dir && dir->_directChildrenCount > 0 )
+		dir->_directChildrenCount--;
+	}
+	else
+	{
+	    dir->_summaryDirty = true;
+	}
+
+	if ( dir->isAttic() )
+	    exact = false;
+    }
+
+    subtractFileAgeSummary( child );
+    subtractOwnerSummary( child );
+}
+
+
+void DirInfo::subtractFileAgeSummary( FileInfo * child )
+{
+    // Ignored items and attics are not in the file age summaries, but there
+    // might be ignored items outside an attic; just recalculate then.
+
+    if ( ! _fileAgeSummary )
+	return;
+
+    if ( child->isIgnored() || child->isAttic() || isAttic() )
+    {
+	dropFileAgeSummaries();
+	return;
+    }
+
+    FileAgeSummary childSummary;
+
+    if ( child->isDirInfo() )
+	childSummary = *child->toDirInfo()->fileAgeSummary();
+    else if ( child->isFile() )
+	childSummary.addFile( child );
+
+    for ( DirInfo * dir = this; dir && dir->_fileAgeSummary; dir = dir->parent() )
+    {
+	dir->_fileAgeSummary->add( childSummary, -1 );
+
+	if ( dir->isAttic() )	// not in the summary of its parent
+	    break;
+    }
+}
+
+
+void DirInfo::subtractOwnerSummary( FileInfo * child )
+{
+    if ( ! _ownerSummary )
+	return;
+
+    if ( child->isIgnored() || child->isAttic() || isAttic() )
+    {
+	dropOwnerSummaries();
+	return;
+    }
+
+    OwnerSummary childSummary;
+
+    if ( child->isDirInfo() )
+	childSummary = *child->toDirInfo()->ownerSummary();
+    else
+	childSummary.addItem( child );
+
+    for ( DirInfo * dir = this; dir && dir->_ownerSummary; dir = dir->parent() )
+    {
+	dir->_ownerSummary->add( childSummary, -1 );
+
+	if ( dir->isAttic() )	// not in the summary of its parent
+	    break;
+    }
+}
+
+
 void DirInfo::unlinkChild( FileInfo * deletedChild )
 {
     if ( deletedChild->parent() != this )
@@ -684,8 +1293,16 @@ void DirInfo::unlinkChild( FileInfo * deletedChild )
     }
 
     dropSortCache();
+    dropChildVector();
+    dropFileAgeSummaries();
+    dropOwnerSummaries();
     _summaryDirty = true;
 
+    // The others are still the largest children in the same order
+
+    if ( _largestChildren )
+	_largestChildren->items.removeOne( deletedChild );
+
     if ( deletedChild == _firstChild )
     {
 	// logDebug() << "Unlinking first child " << deletedChild << endl;
@@ -742,13 +1359,61 @@ void DirInfo::readJobFinished( DirInfo * dir )
 
 void DirInfo::readJobAborted( DirInfo * dir )
 {
-    _readState = DirAborted;
+    setReadState( DirAborted );
 
     if ( _parent )
 	_parent->readJobAborted( dir );
 }
 
 
+QString DirInfo::url() const
+{
+    if ( _cachedUrl.isEmpty() )
+	_cachedUrl = FileInfo::url();
+
+    return _cachedUrl;
+}
+
+
+QString DirInfo::path() const
+{
+    if ( _cachedPath.isEmpty() )
+	_cachedPath = FileInfo::path();
+
+    return _cachedPath;
+}
+
+
+void DirInfo::dropPathCache()
+{
+    // Optimization: The children use the parent's url() and path() to
+    // build their own, so if there is nothing cached here, there can't
+    // be anything cached in the subtree, either.
+
+    if ( _cachedUrl.isEmpty() && _cachedPath.isEmpty() )
+	return;
+
+    _cachedUrl.clear();
+    _cachedPath.clear();
+
+    FileInfo * child = _firstChild;
+
+    while ( child )
+    {
+	if ( child->isDirInfo() )
+	    child->toDirInfo()->dropPathCache();
+
+	child = child->next();
+    }
+
+    if ( _dotEntry )
+	_dotEntry->dropPathCache();
+
+    if ( _attic )
+	_attic->dropPathCache();
+}
+
+
 DirReadState DirInfo::readState() const
 {
     return _readState;
@@ -784,9 +1449,14 @@ QString DirInfo::sizePrefix() const
     {
 	case DirQueued:
 	case DirReading:
-	case DirOnRequestOnly:
 	    return "";
 
+	case DirOnRequestOnly:
+	    if ( _isOverBudget )
+		return ">";
+
+	    return _isEstimated || _isQuotaPlaceholder ? "~" : "";
+
 	case DirError:
 	case DirAborted:
 	case DirPermissionDenied:
@@ -794,7 +1464,10 @@ QString DirInfo::sizePrefix() const
 
 	case DirFinished:
 	case DirCached:
-	    return _errSubDirCount > 0 ? ">" : "";
+	    if ( _errSubDirCount > 0 )
+		return ">";
+
+	    return _tree && _tree->sizeEstimator()->isEstimate( this ) ? "~" : "";
 
 	// No 'default' branch so the compiler can catch unhandled enum values
     }
@@ -807,36 +1480,154 @@ void DirInfo::finalizeLocal()
 {
     // logDebug() << this << endl;
 
+    bool ignoredChanged = finalizeContents();
+
+    // Ignored items are sorted last, also after others of the same size
+
+    if ( ignoredChanged && _parent )
+    {
+	_parent->dropSortCache();
+	_parent->dropLargestChildren();
+    }
+
+    if ( ! isPseudoDir() && _parent )
+	_parent->checkIgnored();
+}
+
+
+bool DirInfo::finalizeContents()
+{
     cleanupDotEntries();
     cleanupAttics();
-    checkIgnored();
+    bool ignoredChanged = updateIgnored();
+
+    if ( _tree && _tree->contiguousChildren() )
+    {
+	buildChildVector();
+
+	if ( _dotEntry )
+	    _dotEntry->buildChildVector();
+    }
+
+    if ( _tree && _tree->fileColumns() )
+    {
+	buildFileColumns();
+
+	if ( _dotEntry )
+	    _dotEntry->buildFileColumns();
+    }
+
+    if ( directChildrenCount() >= MIN_LARGEST_CHILDREN_ITEMS )
+	buildLargestChildren();
+    else
+	dropLargestChildren();
+
+    if ( _dotEntry && _dotEntry->directChildrenCount() >= MIN_LARGEST_CHILDREN_ITEMS )
+	_dotEntry->buildLargestChildren();
+
+    return ignoredChanged;
+}
+
+
+void DirInfo::buildChildVector()
+{
+    if ( ! _childVector )
+    {
+	_childVector = new FileInfoList();
+	CHECK_NEW( _childVector );
+    }
+
+    _childVector->clear();
+    _childVector->reserve( _directChildrenCount > 0 ? _directChildrenCount : 0 );
+
+    for ( FileInfo * child = _firstChild; child; child = child->next() )
+	_childVector->append( child );
+}
+
+
+const FileColumns * DirInfo::fileColumns() const
+{
+    return _fileColumns && _fileColumns->isValid() ? _fileColumns : 0;
+}
+
+
+void DirInfo::buildFileColumns()
+{
+    dropFileColumns();
+    _fileColumns = FileColumns::create( this );
+}
+
+
+void DirInfo::dropFileColumns()
+{
+    if ( _fileColumns )
+    {
+	delete _fileColumns;
+	_fileColumns = 0;
+    }
 }
 
 
 void DirInfo::finalizeAll()
 {
-    FileInfo * child = firstChild();
+    bool ignoredChanged = SubtreeFinalizer::finalize( this );
 
-    while ( child )
+    // Cascade the 'ignored' status up the tree only once for the whole
+    // subtree: Within it, each directory was checked after its children.
+
+    if ( ignoredChanged && _parent )
+    {
+	_parent->dropSortCache();
+	_parent->dropLargestChildren();
+    }
+
+    if ( ! isPseudoDir() && _parent )
+	_parent->checkIgnored();
+}
+
+
+bool DirInfo::finalizeSubtree()
+{
+    bool childIgnoredChanged = false;
+
+    for ( FileInfo * child = firstChild(); child; child = child->next() )
     {
 	if ( child->isDirInfo() && ! child->isDotEntry() )
 	{
-	    child->toDirInfo()->finalizeAll();
+	    if ( child->toDirInfo()->finalizeSubtree() )
+		childIgnoredChanged = true;
 	}
+    }
 
-	child = child->next();
+    if ( childIgnoredChanged )
+    {
+	dropSortCache();
+	dropLargestChildren();
     }
 
-    // Optimization: As long as this directory is not finalized yet, it does
-    // (very likely) have a dot entry and thus all direct children are
-    // subdirectories, not plain files, so we don't need to bother checking
-    // plain file children as well - so do finalizeLocal() only after all
-    // children are processed. If this step were the first, for directories
-    // that don't have any subdirectories finalizeLocal() would immediately
-    // get all their plain file children reparented to themselves, so they
-    // would need to be processed in the loop, too.
+    // Do finalizeContents() only after all children are processed: If this
+    // step were the first, for directories with a dot entry that just lost
+    // their last subdirectory, it would get all their plain file children
+    // reparented to themselves, so they would need to be processed in the
+    // loop, too.
 
-    finalizeLocal();
+    return finalizeContents();
+}
+
+
+void DirInfo::moveFilesToDotEntry()
+{
+    ensureDotEntry();
+    _dotEntry->takeAllChildren( this );
+
+    // takeAllChildren() recalculated this directory while the dot entry
+    // did not have its totals yet. The totals of this directory don't
+    // change, so the parents don't need to be marked dirty.
+
+    _summaryDirty = true;
+
+    if ( _tree )
+	_tree->childAddedNotify( _dotEntry );
 }
 
 
@@ -897,21 +1688,33 @@ void DirInfo::cleanupAttics()
 
 void DirInfo::checkIgnored()
 {
-    if ( _dotEntry )
-	_dotEntry->checkIgnored();
+    // Ignored items are sorted last
+
+    if ( updateIgnored() && _parent )
+	_parent->dropSortCache();
+
+    // Cascade the 'ignored' status up the tree
+
+    if ( ! isPseudoDir() && _parent )
+	_parent->checkIgnored();
+}
+
+
+bool DirInfo::updateIgnored()
+{
+    if ( _dotEntry && _dotEntry->updateIgnored() )
+	dropSortCache();
 
-    // Cascade the 'ignored' status up the tree:
-    //
     // Display all directories as ignored that have any ignored items, but no
     // items that are not ignored.
 
+    bool wasIgnored = _isIgnored;
     _isIgnored = ( totalIgnoredItems() > 0 && totalUnignoredItems() == 0 );
 
     if ( _isIgnored )
 	ignoreEmptySubDirs();
 
-    if ( ! isPseudoDir() && _parent )
-	_parent->checkIgnored();
+    return _isIgnored != wasIgnored;
 }
 
 
@@ -928,6 +1731,7 @@ void DirInfo::ignoreEmptySubDirs()
 		// logDebug() << "Ignoring empty subdir " << (*it) << endl;
 		(*it)->setIgnored( true );
 		_summaryDirty = true;
+		dropSortCache();
 	    }
 	}
 
@@ -949,17 +1753,17 @@ void DirInfo::clearTouched( bool recursive )
 	    while ( child )
 	    {
 		if ( child->isDirInfo() )
-		    child->toDirInfo()->clearTouched();
+		    child->toDirInfo()->clearTouched( true );
 
 		child = child->next();
 	    }
 
 	    if ( _dotEntry )
-		_dotEntry->clearTouched();
+		_dotEntry->clearTouched( true );
 	}
 
 	if ( _attic )
-	    _attic->clearTouched();
+	    _attic->clearTouched( true );
     }
 }
 
@@ -973,13 +1777,21 @@ const FileInfoList & DirInfo::sortedChildren( DataColumn    sortCol,
 	 sortOrder    == _lastSortOrder	   &&
 	 includeAttic == _lastIncludeAttic    )
     {
+	if ( _unsortedChildren > 0 )
+	    mergeUnsortedChildren();
+
+	if ( _tree )
+	    _tree->sortCacheUsed( this, _sortedChildren->size() );
+
 	return *_sortedChildren;
     }
 
 
-    // Clean old sorted children list and create a new one
+    // Clean old sorted children list and create a new one. The lists of
+    // the subdirectories are not touched: They are dropped when they are
+    // used least recently (see DirTree::sortCacheUsed()).
 
-    dropSortCache( true ); // recursive
+    dropSortCache();
     _sortedChildren = new FileInfoList();
     CHECK_NEW( _sortedChildren );
 
@@ -1002,21 +1814,10 @@ const FileInfoList & DirInfo::sortedChildren( DataColumn    sortCol,
 
     // logDebug() << "Sorting children of " << this << " by " << sortCol << endl;
 
-    if ( sortCol != NameCol )
-    {
-	// Do secondary sorting by NameCol (always in ascending order)
-
-	std::stable_sort( _sortedChildren->begin(),
-			  _sortedChildren->end(),
-			  FileInfoSorter( NameCol, Qt::AscendingOrder ) );
-    }
-
+    // Primary sorting by sortCol ascending or descending (as specified in
+    // sortOrder), secondary sorting by NameCol (always in ascending order)
 
-    // Primary sorting by sortCol ascending or descending (as specified in sortOrder)
-
-    std::stable_sort( _sortedChildren->begin(),
-		      _sortedChildren->end(),
-		      FileInfoSorter( sortCol, sortOrder ) );
+    FileInfoSorter::sort( *_sortedChildren, sortCol, sortOrder );
 
     if ( includeAttic && _attic )
 	_sortedChildren->append( _attic );
@@ -1025,6 +1826,9 @@ const FileInfoList & DirInfo::sortedChildren( DataColumn    sortCol,
     _lastSortOrder    = sortOrder;
     _lastIncludeAttic = includeAttic;
 
+    if ( _tree )
+	_tree->sortCacheUsed( this, _sortedChildren->size() );
+
 
 #if DIRECT_CHILDREN_COUNT_SANITY_CHECK
 
@@ -1043,8 +1847,59 @@ const FileInfoList & DirInfo::sortedChildren( DataColumn    sortCol,
 }
 
 
+int DirInfo::sortedChildRow( FileInfo *	   child,
+			     DataColumn	   sortCol,
+			     Qt::SortOrder sortOrder,
+			     bool	   includeAttic )
+{
+    const FileInfoList & children = sortedChildren( sortCol, sortOrder, includeAttic );
+
+    if ( children.size() < MIN_SORTED_ROWS_INDEX )
+	return children.indexOf( child );
+
+    if ( ! _sortedChildrenRows )
+    {
+	// Build the index on demand only: Many sorted lists are only used
+	// for iterating over the children.
+
+	_sortedChildrenRows = new QHash<FileInfo *, int>();
+	CHECK_NEW( _sortedChildrenRows );
+	_sortedChildrenRows->reserve( children.size() );
+
+	for ( int row = 0; row < children.size(); ++row )
+	    _sortedChildrenRows->insert( children.at( row ), row );
+    }
+
+    return _sortedChildrenRows->value( child, -1 );
+}
+
+
+void DirInfo::mergeUnsortedChildren()
+{
+    // The new children are at the end of the list, only the attic might
+    // come after them.
+
+    FileInfoList::iterator end = _sortedChildren->end();
+
+    if ( _lastIncludeAttic && _attic )
+	--end;
+
+    FileInfoList::iterator middle = end - _unsortedChildren;
+    FileInfoSorter sorter( _lastSortCol, _lastSortOrder );
+
+    // logDebug() << "Merging " << _unsortedChildren << " new children of " << this << endl;
+
+    std::stable_sort( middle, end, sorter );
+    std::inplace_merge( _sortedChildren->begin(), middle, end, sorter );
+
+    _unsortedChildren = 0;
+}
+
+
 void DirInfo::dropSortCache( bool recursive )
 {
+    _unsortedChildren = 0;
+
     if ( _sortedChildren )
     {
 	// logDebug() << "Dropping sort cache for " << this << endl;
@@ -1062,6 +1917,15 @@ void DirInfo::dropSortCache( bool recursive )
 	delete _sortedChildren;
 	_sortedChildren = 0;
 
+	if ( _sortedChildrenRows )
+	{
+	    delete _sortedChildrenRows;
+	    _sortedChildrenRows = 0;
+	}
+
+	if ( _tree )
+	    _tree->sortCacheDropped( this );
+
 	// Optimization: If this dir didn't have any sort cache, there won't be
 	// any in the subtree, either. And dot entries don't have dir children
 	// that could have a sort cache.
@@ -1091,6 +1955,205 @@ void DirInfo::dropSortCache( bool recursive )
 }
 
 
+/**
+ * Return 'true' if 'a' comes before 'b' in the children sorted by size in
+ * descending order: Like in FileInfoSorter::sort(), children of the same
+ * size are sorted by name.
+ **/
+static bool largerThan( FileInfo * a, FileInfo * b )
+{
+    FileSize aSize = a->totalSize();
+    FileSize bSize = b->totalSize();
+
+    if ( aSize != bSize )
+	return aSize > bSize;
+
+    return FileInfoSorter( NameCol, Qt::AscendingOrder )( a, b );
+}
+
+
+const FileInfoList & DirInfo::largestChildren()
+{
+    // Rebuild it if all of them were deleted, but there are others
+
+    if ( ! _largestChildren ||
+	 ( _largestChildren->items.isEmpty() && _largestChildren->nextSize >= 0 ) )
+    {
+	buildLargestChildren();
+    }
+
+    return _largestChildren->items;
+}
+
+
+FileInfo * DirInfo::largestChild()
+{
+    const FileInfoList & items = largestChildren();
+
+    return items.isEmpty() ? 0 : items.first();
+}
+
+
+void DirInfo::buildLargestChildren()
+{
+    if ( ! _largestChildren )
+    {
+	_largestChildren = new LargestChildren();
+	CHECK_NEW( _largestChildren );
+    }
+
+    _largestChildren->items.clear();
+    _largestChildren->nextSize = -1;
+
+    for ( FileInfo * child = _firstChild; child; child = child->next() )
+	addToLargestChildren( child );
+
+    if ( _dotEntry )
+	addToLargestChildren( _dotEntry );
+}
+
+
+void DirInfo::addToLargestChildren( FileInfo * child )
+{
+    FileInfoList & items = _largestChildren->items;
+
+    // Most children are not larger than the smallest one so far
+
+    if ( items.size() >= LARGEST_CHILDREN_COUNT && ! largerThan( child, items.last() ) )
+    {
+	_largestChildren->nextSize = qMax( _largestChildren->nextSize, child->totalSize() );
+	return;
+    }
+
+    int pos = items.size();
+
+    while ( pos > 0 && largerThan( child, items.at( pos - 1 ) ) )
+	--pos;
+
+    items.insert( pos, child );
+
+    if ( items.size() > LARGEST_CHILDREN_COUNT )
+    {
+	_largestChildren->nextSize = qMax( _largestChildren->nextSize, items.last()->totalSize() );
+	items.removeLast();
+    }
+}
+
+
+void DirInfo::largestChildShrunk( FileInfo * child )
+{
+    if ( ! _largestChildren )
+	return;
+
+    FileInfoList & items = _largestChildren->items;
+    int pos = items.indexOf( child );
+
+    if ( pos < 0 )	// it was not one of them and it still isn't
+	return;
+
+    // The ones before it are still the largest ones in the same order, but
+    // without the sizes of the others, it is not known which one comes
+    // next. None of the others is larger than the last one that is left.
+
+    _largestChildren->nextSize = pos > 0 ? items.at( pos - 1 )->totalSize() : 0;
+    items.erase( items.begin() + pos, items.end() );
+}
+
+
+void DirInfo::dropLargestChildren()
+{
+    if ( _largestChildren )
+    {
+	delete _largestChildren;
+	_largestChildren = 0;
+    }
+}
+
+
+int DirInfo::largestSortedRows( DataColumn sortCol, Qt::SortOrder sortOrder )
+{
+    if ( sortOrder != Qt::DescendingOrder )
+	return 0;
+
+    if ( sortCol == SizeCol )
+	return largestChildren().size();
+
+    if ( sortCol != PercentNumCol && sortCol != PercentBarCol )
+	return 0;
+
+    // Without a total size, all children have the same percentage
+    // (see FileInfo::subtreePercent()), so they are sorted by name.
+
+    if ( _pendingReadJobs > 0 || totalSize() == 0 )
+	return 0;
+
+    // A percentage only has the precision of a float: Children with
+    // different sizes might have the same percentage, and those are sorted
+    // by name. So a child is only in the same row as when sorting by size
+    // if it has a higher percentage than the next smaller child after it.
+    // Going backwards, 'bound' is the percentage of that child.
+
+    const FileInfoList & items = largestChildren();
+    FileSize total	 = totalSize();
+    FileSize nextSize	 = _largestChildren->nextSize;
+    bool     boundKnown	 = nextSize < 0;	// nothing after the last one
+    float    bound	 = -1.0;
+    int	     rows	 = items.size();
+
+    for ( int i = items.size() - 1; i >= 0; --i )
+    {
+	FileInfo * item = items.at( i );
+	FileSize   size = item->totalSize();
+
+	if ( nextSize >= 0 && nextSize < size )
+	{
+	    bound      = ( 100.0 * nextSize ) / (float) total;
+	    boundKnown = true;
+	}
+
+	float percent = ( 100.0 * size ) / (float) total;
+
+	// Excluded children have no percentage, so they are sorted last
+
+	if ( ! boundKnown || percent <= bound || item->isExcluded() )
+	    rows = i;
+
+	nextSize = size;
+    }
+
+    return rows;
+}
+
+
+FileInfo * DirInfo::largestSortedChild( int	      row,
+					DataColumn    sortCol,
+					Qt::SortOrder sortOrder )
+{
+    if ( row < 0 || row >= LARGEST_CHILDREN_COUNT )
+	return 0;
+
+    if ( row >= largestSortedRows( sortCol, sortOrder ) )
+	return 0;
+
+    return _largestChildren->items.at( row );
+}
+
+
+int DirInfo::largestSortedChildRow( FileInfo *	  child,
+				    DataColumn	  sortCol,
+				    Qt::SortOrder sortOrder )
+{
+    int rows = largestSortedRows( sortCol, sortOrder );
+
+    if ( rows == 0 )
+	return -1;
+
+    int row = _largestChildren->items.indexOf( child );
+
+    return row < rows ? row : -1;
+}
+
+
 const DirInfo * DirInfo::findNearestMountPoint() const
 {
     const DirInfo * dir = this;
@@ -1112,17 +2175,32 @@ void DirInfo::takeAllChildren( DirInfo * oldParent )
 
 	FileInfo * oldFirstChild = _firstChild;
 	_firstChild = child;
+	dropChildVector();
 	FileInfo * lastChild = child;
 
 	oldParent->setFirstChild( 0 );
+	oldParent->dropSortCache();
 	oldParent->recalc();
+	dropSortCache();
+	dropLargestChildren();
 
 	_directChildrenCount = -1;
 	_summaryDirty	     = true;
+	oldParent->dropFileAgeSummaries();
+	oldParent->dropOwnerSummaries();
 
 	while ( child )
 	{
 	    child->setParent( this );
+
+	    if ( child->isDirInfo() )
+	    {
+		child->toDirInfo()->dropPathCache();
+
+		if ( _tree && child->toDirInfo()->hasSubtreeLabels() )
+		    _tree->invalidateSubtreeLabels();
+	    }
+
 	    lastChild = child;
 	    child = child->next();
 	}
@@ -11,6 +11,8 @@
 #define DirInfo_h
 
 
+#include <QHash>
+
 #include "FileInfo.h"
 #include "DataColumns.h"
 
@@ -20,6 +22,10 @@ namespace QDirStat
     // Forward declarations
     class DirTree;
     class DotEntry;
+    class FileAgeSummary;
+    class FileColumns;
+    class OwnerSummary;
+    struct CacheBlockInfo;
 
     /**
      * A more specialized version of FileInfo: This class can actually manage
@@ -31,6 +37,13 @@ namespace QDirStat
      **/
     class DirInfo: public FileInfo
     {
+	// For the inline node accessors
+	friend class FileInfo;
+
+	// For finalizeSubtree() and finalizeContents()
+	friend class SubtreeFinalizer;
+	friend class SubtreeFinalizerThread;
+
     public:
 
 	/**
@@ -55,9 +68,9 @@ namespace QDirStat
 	/**
 	 * Default constructor.
 	 *
-	 * This is the only constructor that will not create a dot entry
-	 * immediately. If that is desired, you can always use ensureDotEntry()
-	 * later.
+	 * None of the constructors creates a dot entry: That only happens
+	 * when a directory gets both files and subdirectories (see
+	 * insertChild()) or with ensureDotEntry().
 	 **/
 	DirInfo( DirTree * tree,
 		 DirInfo * parent = 0 );
@@ -192,6 +205,136 @@ namespace QDirStat
 	virtual void setExcluded( bool excl =true ) Q_DECL_OVERRIDE
 	    { _isExcluded = excl; }
 
+	/**
+	 * Returns 'true' if this is a cache placeholder: A directory from a
+	 * cache file whose content was not read yet, only its summary (see
+	 * DirTree::lazyCacheLoading()). reset() makes it a normal directory
+	 * again.
+	 **/
+	bool isCachePlaceholder() const { return _isCachePlaceholder; }
+
+	/**
+	 * Make this (still empty) directory a cache placeholder with the
+	 * summary from 'block'.
+	 **/
+	void setCachePlaceholder( const CacheBlockInfo & block );
+
+	/**
+	 * Delete all children of this directory after they were written to
+	 * the tree's FileSpillStore, but keep the summary: This becomes a
+	 * cache placeholder that stands in for them. All children have to be
+	 * files (or other non-directories), and the caller has to notify the
+	 * views (DirTree::clearingSubtree()).
+	 **/
+	void spillChildren();
+
+	/**
+	 * Make this cache placeholder a normal directory again before the
+	 * spilled children are added back. Unlike reset(), this keeps the
+	 * read state.
+	 **/
+	void unspill();
+
+	/**
+	 * Returns 'true' if this directory was not read in estimate mode, and
+	 * its totals are the average of its sampled siblings (see
+	 * SizeEstimator). reset() makes it a normal directory again.
+	 **/
+	bool isEstimated() const { return _isEstimated; }
+
+	/**
+	 * Mark this (still empty) directory as estimated. The totals are set
+	 * later with setEstimate().
+	 **/
+	void setEstimated() { _isEstimated = true; }
+
+	/**
+	 * Set the estimated totals of this directory.
+	 **/
+	void setEstimate( FileSize totalSize,
+			  FileSize totalAllocatedSize,
+			  FileSize totalBlocks,
+			  int	   totalItems,
+			  int	   totalSubDirs,
+			  int	   totalFiles );
+
+	/**
+	 * Returns 'true' if this directory was not read because the
+	 * filesystem already knows its totals (see QuotaUsage and
+	 * DirTree::quotaMode()). reset() makes it a normal directory again.
+	 **/
+	bool isQuotaPlaceholder() const { return _isQuotaPlaceholder; }
+
+	/**
+	 * Make this (still empty) directory a quota placeholder with the
+	 * totals of the filesystem. 'usedInodes' is -1 if not known.
+	 **/
+	void setQuotaPlaceholder( FileSize usedBytes, qint64 usedInodes );
+
+	/**
+	 * Returns 'true' if this directory was not read because the program
+	 * already used up its memory budget (see MemoryBudget). reset()
+	 * makes it a normal directory again.
+	 **/
+	bool isOverBudget() const { return _isOverBudget; }
+
+	/**
+	 * Mark this (still empty) directory as not read because of the
+	 * memory budget.
+	 **/
+	void setOverBudget() { _isOverBudget = true; }
+
+	/**
+	 * Return 'true' if this directory has a pre-order label of the current
+	 * generation of the tree (see DirTree::updateSubtreeLabels()). Then
+	 * an item is in its subtree if the label of the item (or of its
+	 * nearest labeled ancestor) is between preOrder() and lastPreOrder().
+	 **/
+	bool hasSubtreeLabels() const;
+
+	/**
+	 * Return the pre-order label of this directory.
+	 **/
+	int preOrder() const { return _preOrder; }
+
+	/**
+	 * Return the highest pre-order label in the subtree of this
+	 * directory.
+	 **/
+	int lastPreOrder() const { return _lastPreOrder; }
+
+	/**
+	 * Set the pre-order labels of 'generation'. This is only for
+	 * DirTree::updateSubtreeLabels().
+	 **/
+	void setSubtreeLabels( int generation, int preOrder, int lastPreOrder );
+
+	/**
+	 * Mark the summary of this directory and of all its ancestors as
+	 * dirty, e.g. after its own size changed.
+	 **/
+	void markSummaryDirty();
+
+	/**
+	 * Return the modification years and months of the files in this
+	 * subtree (without the attic). It is calculated from the summaries of
+	 * the subdirectories the first time and then cached until anything
+	 * in the subtree changes; deleting a subtree just subtracts its
+	 * summary.
+	 *
+	 * This is only used if DirTree::cacheFileAgeSummaries() is enabled.
+	 **/
+	const FileAgeSummary * fileAgeSummary();
+
+	/**
+	 * Return the number and the total size of the items in this subtree
+	 * (without the attic) for each user and each group that owns any of
+	 * them. Like the file age summary, this is calculated from the
+	 * summaries of the subdirectories the first time and then kept up to
+	 * date, so asking again for any directory in the subtree is instant.
+	 **/
+	const OwnerSummary * ownerSummary();
+
 	/**
 	 * Returns whether or not this is a mount point.
 	 *
@@ -255,11 +398,71 @@ namespace QDirStat
 	 * Reimplemented - inherited from FileInfo.
 	 **/
 	virtual void setFirstChild( FileInfo * newfirstChild ) Q_DECL_OVERRIDE
-	    { _firstChild = newfirstChild; }
+	    { _firstChild = newfirstChild; dropChildVector(); dropLargestChildren(); }
+
+	/**
+	 * Return a contiguous vector of the direct children (without the dot
+	 * entry and the attic) in the same order as the linked list from
+	 * firstChild() or 0 if there is none.
+	 *
+	 * This is only available if the tree has contiguousChildren() and
+	 * the directory was finalized, and only until children are added or
+	 * removed. It is faster to iterate over, and it can be split into
+	 * index ranges for processing the children in several threads.
+	 **/
+	const FileInfoList * childVector() const { return _childVector; }
+
+	/**
+	 * Build the child vector from the linked list of children.
+	 * See childVector() for details.
+	 **/
+	void buildChildVector();
+
+	/**
+	 * Drop the child vector and the file columns. This needs to be called
+	 * whenever the linked list of children changes.
+	 **/
+	void dropChildVector()
+	{
+	    if ( _childVector ) { delete _childVector; _childVector = 0; }
+	    if ( _fileColumns ) dropFileColumns();
+	}
+
+	/**
+	 * Return the file columns of this directory (see FileColumns) or 0
+	 * if there are none or if they are no longer valid.
+	 *
+	 * This is only available if the tree has fileColumns() and the
+	 * directory was finalized, and only until children are added or
+	 * removed.
+	 **/
+	const FileColumns * fileColumns() const;
+
+	/**
+	 * Build the file columns from the children if this directory has
+	 * only files.
+	 **/
+	void buildFileColumns();
+
+	/**
+	 * Drop the file columns.
+	 **/
+	void dropFileColumns();
+
+	/**
+	 * Return the approximate number of bytes on the heap that this
+	 * directory uses in addition to the node itself and its name: The
+	 * child vector, the sorted children and the file age summary.
+	 **/
+	qint64 auxMemory() const;
 
 	/**
 	 * Insert a child into the children list.
 	 *
+	 * As long as a directory has only files (or other non-directories),
+	 * they are stored directly in it. Only when it gets its first
+	 * subdirectory, a dot entry is created and the files are moved there.
+	 *
 	 * The order of children in this list is absolutely undefined;
 	 * don't rely on any implementation-specific order.
 	 **/
@@ -384,10 +587,38 @@ namespace QDirStat
 
 	/**
 	 * Recursively finalize all directories from here on -
-	 * call finalizeLocal() recursively.
+	 * call finalizeLocal() recursively. Large trees are finalized with
+	 * several threads (see SubtreeFinalizer).
 	 **/
 	virtual void finalizeAll();
 
+	/**
+	 * Returns the full URL of this directory.
+	 *
+	 * Reimplemented - inherited from FileInfo.
+	 *
+	 * The result is cached, so the children of this directory only need
+	 * to append their own name to it instead of recursing up to the top
+	 * of the tree. Notice that this cache is not thread-safe: Call this
+	 * from the main thread only.
+	 **/
+	virtual QString url() const Q_DECL_OVERRIDE;
+
+	/**
+	 * Returns the full path of this directory. This is cached just like
+	 * url().
+	 *
+	 * Reimplemented - inherited from FileInfo.
+	 **/
+	virtual QString path() const Q_DECL_OVERRIDE;
+
+	/**
+	 * Drop the cached url() and path() of this directory and of all
+	 * directories below it. Use this when this subtree is moved to a
+	 * different parent.
+	 **/
+	void dropPathCache();
+
 	/**
 	 * Get the current state of the directory reading process:
 	 *
@@ -414,8 +645,8 @@ namespace QDirStat
 	/**
 	 * Return a prefix for the total size (and similar accumulated fields)
 	 * of this item: ">" if there might be more, i.e. if a subdirectory
-	 * could not be read or if reading was aborted, an empty string
-	 * otherwise.
+	 * could not be read or if reading was aborted, "~" if the totals
+	 * include estimates (see SizeEstimator), an empty string otherwise.
 	 *
 	 * Notice that this implementation also returns an empty string as long
 	 * as this subtree is busy, i.e. reading is not finished: The ">"
@@ -446,11 +677,70 @@ namespace QDirStat
 					     Qt::SortOrder sortOrder,
 					     bool	   includeAttic = false );
 
+	/**
+	 * Return the row of 'child' in sortedChildren() with the same
+	 * parameters or -1 if it is not a child of this directory.
+	 *
+	 * For large directories, this uses an index of the sorted children
+	 * that is built along with the sort cache, so this is constant time
+	 * instead of linear in the number of children.
+	 **/
+	int sortedChildRow( FileInfo *	  child,
+			    DataColumn	  sortCol,
+			    Qt::SortOrder sortOrder,
+			    bool	  includeAttic = false );
+
 	/**
 	 * Drop all cached information about children sorting.
 	 **/
 	void dropSortCache( bool recursive = false );
 
+	/**
+	 * Return up to LARGEST_CHILDREN_COUNT children (including the dot
+	 * entry, but not the attic) with the largest total size, the largest
+	 * first. They are in the same order as in sortedChildren() by
+	 * SizeCol in descending order. After some of them were deleted,
+	 * there may be fewer, but they are still the first ones in that
+	 * order.
+	 *
+	 * This does not need to sort the children: Large directories keep
+	 * this list up to date from finalizeLocal() on; otherwise, it is
+	 * found with one pass over the children.
+	 **/
+	const FileInfoList & largestChildren();
+
+	/**
+	 * Return the child with the largest total size (which might be the
+	 * dot entry) or 0 if there is none.
+	 **/
+	FileInfo * largestChild();
+
+	/**
+	 * Return the child in row 'row' of sortedChildren() by 'sortCol' and
+	 * 'sortOrder' if that row is known without sorting, 0 otherwise:
+	 * When sorting by size or by percent in descending order, the first
+	 * rows are the largestChildren().
+	 **/
+	FileInfo * largestSortedChild( int	     row,
+				       DataColumn    sortCol,
+				       Qt::SortOrder sortOrder );
+
+	/**
+	 * Return the row of 'child' in sortedChildren() by 'sortCol' and
+	 * 'sortOrder' if it is known without sorting like in
+	 * largestSortedChild(), -1 otherwise.
+	 **/
+	int largestSortedChildRow( FileInfo *	 child,
+				   DataColumn	 sortCol,
+				   Qt::SortOrder sortOrder );
+
+	/**
+	 * Drop the list of the largest children. This needs to be called
+	 * whenever children are added or the size of any of them might have
+	 * grown.
+	 **/
+	void dropLargestChildren();
+
 	/**
 	 * Check if this directory is locked. This is purely a user lock
 	 * that can be used by the application. The DirInfo does not care
@@ -473,13 +763,23 @@ namespace QDirStat
 	 **/
 	void clear();
 
+	/**
+	 * Move all children, the dot entry and the attic to a new DirInfo
+	 * that is not part of the tree and return it, so the caller can
+	 * delete the whole subtree later, e.g. in another thread. This
+	 * directory has no children afterwards, but its summaries are not
+	 * updated; call clear() for that.
+	 **/
+	DirInfo * detachChildren();
+
 	/**
 	 * Reset to the same status like just after construction in preparation
 	 * of refreshing the tree from this point on:
 	 *
 	 * Delete all children if there are any, delete the dot entry's
 	 * children if there are any, restore the dot entry if it was removed
-	 * (e.g. in finalizeLocal()), set the read state to DirQueued.
+	 * (e.g. in finalizeLocal()), set the read state to DirQueued. A cache
+	 * placeholder becomes a normal directory.
 	 **/
 	virtual void reset();
 
@@ -525,10 +825,16 @@ namespace QDirStat
 
 	/**
 	 * Check the 'ignored' state of this item and set the '_isIgnored' flag
-	 * accordingly.
+	 * accordingly, and cascade it up the tree.
 	 **/
 	virtual void checkIgnored();
 
+	/**
+	 * Check the 'ignored' state of this item and of its dot entry, but
+	 * don't touch the parent. Return 'true' if it changed.
+	 **/
+	virtual bool updateIgnored();
+
 	/**
 	 * Set any empty subdir children to ignored. This affects only direct
 	 * children.
@@ -545,12 +851,73 @@ namespace QDirStat
 	 *
 	 * This is a _very_ expensive operation since the entire subtree may
 	 * recursively be traversed.
+	 *
+	 * Deleting a child does not make the summary dirty in most cases:
+	 * See subtractChild().
 	 **/
 	void recalc();
 
 
     protected:
 
+	/**
+	 * Add the totals of 'child' to the summary fields of this directory
+	 * if 'sign' is 1 or subtract them if it is -1. This does not touch
+	 * the mtimes and the direct children count.
+	 **/
+	void addChildTotals( FileInfo * child, int sign );
+
+	/**
+	 * Subtract the totals of 'child' (which is about to be deleted) from
+	 * the summary of this directory and all its ancestors, or mark them
+	 * as dirty if that is not possible.
+	 **/
+	void subtractChild( FileInfo * child );
+
+	/**
+	 * Subtract the file age summary of 'child' from the cached summaries
+	 * of this directory and its ancestors.
+	 **/
+	void subtractFileAgeSummary( FileInfo * child );
+
+	/**
+	 * Subtract the owner summary of 'child' from the cached summaries of
+	 * this directory and its ancestors.
+	 **/
+	void subtractOwnerSummary( FileInfo * child );
+
+	/**
+	 * Add 'newChild' to the sort cache if there is one and it is sorted
+	 * by name; otherwise drop it.
+	 **/
+	void addToSortCache( FileInfo * newChild );
+
+	/**
+	 * Sort the children that were added to the sort cache since it was
+	 * last sorted and merge them into the sorted children.
+	 **/
+	void mergeUnsortedChildren();
+
+	/**
+	 * Delete all children, the dot entry and the attic. If
+	 * 'notifyParent' is 'true', the ancestors are notified with
+	 * deletingChild() so they can update their summaries.
+	 **/
+	void deleteChildren( bool notifyParent );
+
+	/**
+	 * Delete the cached file age summary of this directory and of its
+	 * ancestors. A directory only has a summary if all its subdirectories
+	 * have one, so this can stop at the first ancestor without one.
+	 **/
+	void dropFileAgeSummaries();
+
+	/**
+	 * Delete the cached owner summary of this directory and of its
+	 * ancestors, just like dropFileAgeSummaries().
+	 **/
+	void dropOwnerSummaries();
+
 	/**
 	 * Clean up unneeded / undesired dot entries:
 	 * Delete dot entries that don't have any children,
@@ -559,12 +926,58 @@ namespace QDirStat
 	 **/
 	virtual void cleanupDotEntries();
 
+	/**
+	 * Create the dot entry and move all direct children there. This is
+	 * for a directory that has only had files so far and is just getting
+	 * its first subdirectory.
+	 **/
+	void moveFilesToDotEntry();
+
 	/**
 	 * Clean up unneeded attics: Delete attic entries that don't have any
 	 * children.
 	 **/
 	virtual void cleanupAttics();
 
+	/**
+	 * The part of finalizeLocal() that only touches this directory and
+	 * its children. Return 'true' if the 'ignored' status changed.
+	 **/
+	bool finalizeContents();
+
+	/**
+	 * Find the largest children with one pass over the children.
+	 * See largestChildren() for details.
+	 **/
+	void buildLargestChildren();
+
+	/**
+	 * Add 'child' to the largest children if it is larger than the
+	 * smallest of them or if there are not enough of them yet.
+	 **/
+	void addToLargestChildren( FileInfo * child );
+
+	/**
+	 * Return the number of rows at the start of sortedChildren() by
+	 * 'sortCol' and 'sortOrder' that are the largestChildren().
+	 **/
+	int largestSortedRows( DataColumn sortCol, Qt::SortOrder sortOrder );
+
+	/**
+	 * Notification that the total size of 'child' shrank: It might no
+	 * longer belong to the largest children, and the ones after it
+	 * might be in a different order now.
+	 **/
+	void largestChildShrunk( FileInfo * child );
+
+	/**
+	 * Finalize all directories of this subtree bottom-up without touching
+	 * anything outside of it, so this can run in a separate thread for
+	 * each of several disjoint subtrees (see SubtreeFinalizer). Return
+	 * 'true' if the 'ignored' status of this directory changed.
+	 **/
+	bool finalizeSubtree();
+
 
 	//
 	// Data members
@@ -576,7 +989,25 @@ namespace QDirStat
 	bool		_deletingAll:1;		// Deleting complete children tree?
 	bool		_locked:1;		// App lock
 	bool		_touched:1;		// App 'touch' flag
+	bool		_isCachePlaceholder:1;	// Flag: content not read from the cache yet
+	bool		_isEstimated:1;		// Flag: not read, totals from samples
+	bool		_isQuotaPlaceholder:1;	// Flag: not read, totals from quota
+	bool		_isOverBudget:1;	// Flag: not read, over memory budget
 	int		_pendingReadJobs;	// number of open directories in this subtree
+	int		_labelGeneration;	// of _preOrder and _lastPreOrder
+	int		_preOrder;		// label for isInSubtree()
+	int		_lastPreOrder;		// highest label in this subtree
+
+	/**
+	 * The largest children (see largestChildren()) and the largest total
+	 * size of any other child (or an upper limit for it) or -1 if there
+	 * is no other child.
+	 **/
+	struct LargestChildren
+	{
+	    FileInfoList items;
+	    FileSize	 nextSize;
+	};
 
 	// Children management
 
@@ -598,11 +1029,21 @@ namespace QDirStat
 	int		_errSubDirCount;
 	time_t		_latestMtime;
 	time_t		_oldestFileMtime;
+	FileAgeSummary * _fileAgeSummary;
+	OwnerSummary *	_ownerSummary;
 
+	FileInfoList *	_childVector;
+	FileColumns *	_fileColumns;
 	FileInfoList *	_sortedChildren;
+	QHash<FileInfo *, int> * _sortedChildrenRows;	// row by child
+	int		_unsortedChildren;	// new children at the end of _sortedChildren
 	DataColumn	_lastSortCol;
 	Qt::SortOrder	_lastSortOrder;
 	bool		_lastIncludeAttic;
+	LargestChildren * _largestChildren;
+
+	mutable QString _cachedUrl;		// cached url(), empty if not set yet
+	mutable QString _cachedPath;		// cached path(), empty if not set yet
 
 	DirReadState	_readState;
 
@@ -613,6 +1054,72 @@ namespace QDirStat
 
     };	// class DirInfo
 
+
+
+    //
+    // The non-virtual node accessors of FileInfo; see FileInfo.h.
+    //
+    // Like their virtual dotEntry() and attic(), a DotEntry never has a dot
+    // entry and an Attic never has an attic.
+    //
+
+    inline DirInfo * FileInfo::nodeDirInfo()
+    {
+	return isDirNode() ? static_cast<DirInfo *>( this ) : 0;
+    }
+
+    inline FileInfo * FileInfo::nodeFirstChild() const
+    {
+	return isDirNode() ? static_cast<const DirInfo *>( this )->_firstChild : 0;
+    }
+
+    inline DotEntry * FileInfo::nodeDotEntry() const
+    {
+	if ( ! isDirNode() || isDotEntryNode() )
+	    return 0;
+
+	return static_cast<const DirInfo *>( this )->_dotEntry;
+    }
+
+    inline Attic * FileInfo::nodeAttic() const
+    {
+	if ( ! isDirNode() || isAtticNode() )
+	    return 0;
+
+	return static_cast<const DirInfo *>( this )->_attic;
+    }
+
+    inline bool FileInfo::nodeHasChildren() const
+    {
+	return nodeFirstChild() || nodeDotEntry();
+    }
+
+    inline FileSize FileInfo::nodeTotalSize()
+    {
+	if ( ! isDirNode() )
+	    return size();
+
+	DirInfo * dir = static_cast<DirInfo *>( this );
+
+	if ( dir->_summaryDirty )
+	    dir->recalc();
+
+	return dir->_totalSize;
+    }
+
+    inline FileSize FileInfo::nodeTotalAllocatedSize()
+    {
+	if ( ! isDirNode() )
+	    return allocatedSize();
+
+	DirInfo * dir = static_cast<DirInfo *>( this );
+
+	if ( dir->_summaryDirty )
+	    dir->recalc();
+
+	return dir->_totalAllocatedSize;
+    }
+
 }	// namespace QDirStat
 
 
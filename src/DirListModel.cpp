@@ -0,0 +1,489 @@
+/*
+ *   File name: DirListModel.cpp
+ *   Summary:	Flat list model for the children of one directory
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QHash>
+#include <QIcon>
+
+#include "DirListModel.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "DotEntry.h"
+#include "FileInfoSorter.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Below this number of items, sorting is done right away without a thread
+#define MIN_SORT_THREAD_ITEMS	50000
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    // The data columns of the view columns
+
+    const DataColumn listColumns[] =
+    {
+	NameCol,
+	SizeCol,
+	LatestMTimeCol,
+	UserCol,
+	GroupCol,
+	PermissionsCol
+    };
+
+    const int listColumnCount = sizeof( listColumns ) / sizeof( listColumns[0] );
+
+}	// namespace
+
+
+DirListModel::DirListModel( QObject * parent ):
+    QAbstractTableModel( parent ),
+    _tree( 0 ),
+    _dir( 0 ),
+    _sortCol( SizeCol ),
+    _sortOrder( Qt::DescendingOrder ),
+    _sorter( 0 ),
+    _sortPending( false )
+{
+
+}
+
+
+DirListModel::~DirListModel()
+{
+    cancelSorting();
+}
+
+
+DataColumn DirListModel::dataColumn( int col )
+{
+    if ( col < 0 || col >= listColumnCount )
+	return UndefinedCol;
+
+    return listColumns[ col ];
+}
+
+
+bool DirListModel::isSorting() const
+{
+    return _sorter != 0;
+}
+
+
+void DirListModel::setDir( DirInfo * dir )
+{
+    cancelSorting();
+    beginResetModel();
+
+    if ( _tree )
+	disconnect( _tree, 0, this, 0 );
+
+    _dir   = dir;
+    _tree  = dir ? dir->tree() : 0;
+    _items.clear();
+
+    if ( _tree )
+    {
+	connect( _tree, SIGNAL( childrenAdded  ( FileInfoList ) ),
+		 this,	SLOT  ( childrenAdded  ( FileInfoList ) ) );
+
+	connect( _tree, SIGNAL( deletingChild  ( FileInfo * ) ),
+		 this,	SLOT  ( deletingChild  ( FileInfo * ) ) );
+
+	connect( _tree, SIGNAL( clearingSubtree( DirInfo * ) ),
+		 this,	SLOT  ( clearingSubtree( DirInfo * ) ) );
+
+	connect( _tree, SIGNAL( clearing() ),
+		 this,	SLOT  ( clearing() ) );
+    }
+
+    fetchItems();
+    endResetModel();
+
+    startSorting();
+}
+
+
+void DirListModel::fetchItems()
+{
+    if ( ! _dir )
+	return;
+
+    _items.reserve( _dir->directChildrenCount() );
+
+    for ( FileInfo * child = _dir->firstChild(); child; child = child->next() )
+	_items << child;
+
+    if ( _dir->dotEntry() )
+    {
+	for ( FileInfo * child = _dir->dotEntry()->firstChild(); child; child = child->next() )
+	    _items << child;
+    }
+
+    logDebug() << _items.size() << " items in " << _dir << endl;
+}
+
+
+bool DirListModel::isListItem( FileInfo * item ) const
+{
+    if ( ! _dir || ! item || ! item->parent() )
+	return false;
+
+    return item->parent() == _dir || item->parent() == _dir->dotEntry();
+}
+
+
+FileInfo * DirListModel::itemAt( int row ) const
+{
+    if ( row < 0 || row >= _items.size() )
+	return 0;
+
+    return _items.at( row );
+}
+
+
+int DirListModel::rowCount( const QModelIndex & parent ) const
+{
+    return parent.isValid() ? 0 : _items.size();
+}
+
+
+int DirListModel::columnCount( const QModelIndex & parent ) const
+{
+    return parent.isValid() ? 0 : listColumnCount;
+}
+
+
+QVariant DirListModel::data( const QModelIndex & index, int role ) const
+{
+    if ( ! index.isValid() )
+	return QVariant();
+
+    FileInfo * item = itemAt( index.row() );
+
+    if ( ! item )
+	return QVariant();
+
+    DataColumn col = dataColumn( index.column() );
+
+    switch ( role )
+    {
+	case Qt::DisplayRole:
+	    return columnText( item, col );
+
+	case Qt::DecorationRole:
+	    {
+		if ( col != NameCol )
+		    return QVariant();
+
+		static QIcon dirIcon ( QPixmap( ":/icons/tree-medium/dir.png"  ) );
+		static QIcon fileIcon( QPixmap( ":/icons/tree-medium/file.png" ) );
+
+		return item->isDir() ? dirIcon : fileIcon;
+	    }
+
+	case Qt::TextAlignmentRole:
+	    {
+		int alignment = Qt::AlignVCenter;
+
+		switch ( col )
+		{
+		    case SizeCol:	 alignment |= Qt::AlignRight;	break;
+		    case PermissionsCol: alignment |= Qt::AlignHCenter; break;
+		    default:		 alignment |= Qt::AlignLeft;	break;
+		}
+
+		return alignment;
+	    }
+
+	default:
+	    return QVariant();
+    }
+}
+
+
+QVariant DirListModel::columnText( FileInfo * item, DataColumn col ) const
+{
+    switch ( col )
+    {
+	case NameCol:
+	    return item->name();
+
+	case SizeCol:
+	    if ( item->isDevice() )
+		return QVariant();
+
+	    if ( item->isDirInfo() )
+		return item->sizePrefix() + formatSize( item->totalAllocatedSize() );
+
+	    return formatSize( item->size() );
+
+	case LatestMTimeCol:	return formatTime( item->latestMtime() );
+	case UserCol:		return item->userName();
+	case GroupCol:		return item->groupName();
+	case PermissionsCol:	return item->symbolicPermissions();
+
+	default:
+	    return QVariant();
+    }
+}
+
+
+QVariant DirListModel::headerData( int		   section,
+				   Qt::Orientation orientation,
+				   int		   role ) const
+{
+    if ( orientation != Qt::Horizontal )
+	return QVariant();
+
+    switch ( role )
+    {
+	case Qt::DisplayRole:
+	    switch ( dataColumn( section ) )
+	    {
+		case NameCol:		  return tr( "Name"	     );
+		case SizeCol:		  return tr( "Size"	     );
+		case LatestMTimeCol:	  return tr( "Last Modified" );
+		case UserCol:		  return tr( "User"	     );
+		case GroupCol:		  return tr( "Group"	     );
+		case PermissionsCol:	  return tr( "Permissions"   );
+		default:		  return QVariant();
+	    }
+
+	case Qt::TextAlignmentRole:
+	    return dataColumn( section ) == NameCol ? Qt::AlignLeft : Qt::AlignHCenter;
+
+	default:
+	    return QVariant();
+    }
+}
+
+
+void DirListModel::sort( int column, Qt::SortOrder order )
+{
+    DataColumn sortCol = dataColumn( column );
+
+    if ( sortCol == UndefinedCol )
+	return;
+
+    _sortCol   = sortCol;
+    _sortOrder = order;
+
+    if ( _sorter )
+    {
+	// Sort again with the new sort column and order as soon as the
+	// running sort thread is finished
+
+	_sortPending = true;
+	return;
+    }
+
+    startSorting();
+}
+
+
+void DirListModel::startSorting()
+{
+    if ( _items.size() < MIN_SORT_THREAD_ITEMS )
+    {
+	FileInfoList sortedItems = _items;
+	FileInfoSorter::sort( sortedItems, _sortCol, _sortOrder );
+	applySortedItems( sortedItems );
+
+	return;
+    }
+
+    logDebug() << "Sorting " << _items.size() << " items in a separate thread" << endl;
+
+    _sortPending = false;
+    _sorter	 = new DirListSorter( _items, _sortCol, _sortOrder );
+    CHECK_NEW( _sorter );
+
+    connect( _sorter, SIGNAL( finished()	   ),
+	     this,    SLOT  ( sortThreadFinished() ) );
+
+    _sorter->start();
+    emit sortingStarted();
+}
+
+
+void DirListModel::sortThreadFinished()
+{
+    if ( ! _sorter || sender() != _sorter )
+    {
+	// This is a late signal from a sort thread that was cancelled, and
+	// there might be a new one running already.
+
+	return;
+    }
+
+    _sorter->wait();
+    FileInfoList sortedItems = _sorter->items();
+
+    delete _sorter;
+    _sorter = 0;
+
+    applySortedItems( sortedItems );
+
+    if ( _sortPending )
+	startSorting();
+    else
+	emit sortingFinished();
+}
+
+
+void DirListModel::applySortedItems( const FileInfoList & sortedItems )
+{
+    emit layoutAboutToBeChanged();
+
+    QModelIndexList oldIndexes = persistentIndexList();
+    FileInfoList    oldItems   = _items;
+    _items = sortedItems;
+
+    if ( ! oldIndexes.isEmpty() )
+    {
+	QHash<FileInfo *, int> rows;
+	rows.reserve( _items.size() );
+
+	for ( int row = 0; row < _items.size(); ++row )
+	    rows.insert( _items.at( row ), row );
+
+	foreach ( const QModelIndex & oldIndex, oldIndexes )
+	{
+	    int row = rows.value( oldItems.value( oldIndex.row() ), -1 );
+
+	    changePersistentIndex( oldIndex,
+				   row < 0 ? QModelIndex() : index( row, oldIndex.column() ) );
+	}
+    }
+
+    emit layoutChanged();
+}
+
+
+void DirListModel::cancelSorting()
+{
+    if ( ! _sorter )
+	return;
+
+    logDebug() << "Waiting for the sort thread" << endl;
+
+    _sorter->wait();
+    delete _sorter;
+    _sorter = 0;
+
+    _sortPending = false;
+    emit sortingFinished();
+}
+
+
+void DirListModel::childrenAdded( const FileInfoList & newChildren )
+{
+    FileInfoList items;
+
+    foreach ( FileInfo * newChild, newChildren )
+    {
+	if ( isListItem( newChild ) && ! newChild->isDotEntry() )
+	    items << newChild;
+    }
+
+    if ( items.isEmpty() )
+	return;
+
+    bool wasSorting = isSorting();
+    cancelSorting();
+
+    // Append the new children at the end; they will get their correct
+    // position when the list is sorted again.
+
+    beginInsertRows( QModelIndex(), _items.size(), _items.size() + items.size() - 1 );
+    _items << items;
+    endInsertRows();
+
+    if ( wasSorting )
+	startSorting();
+}
+
+
+void DirListModel::deletingChild( FileInfo * child )
+{
+    if ( ! _dir )
+	return;
+
+    if ( _dir->isInSubtree( child ) )
+    {
+	clearing();
+	return;
+    }
+
+    if ( child->isDotEntry() && child->parent() == _dir )
+    {
+	// Remove all the files of the dot entry
+
+	FileInfoList items;
+
+	foreach ( FileInfo * item, _items )
+	{
+	    if ( item->parent() != child )
+		items << item;
+	}
+
+	cancelSorting();
+	beginResetModel();
+	_items = items;
+	endResetModel();
+
+	return;
+    }
+
+    if ( ! isListItem( child ) )
+	return;
+
+    int row = _items.indexOf( child );
+
+    if ( row < 0 )
+	return;
+
+    bool wasSorting = isSorting();
+    cancelSorting();
+
+    beginRemoveRows( QModelIndex(), row, row );
+    _items.removeAt( row );
+    endRemoveRows();
+
+    if ( wasSorting )
+	startSorting();
+}
+
+
+void DirListModel::clearingSubtree( DirInfo * subtree )
+{
+    // The children of 'subtree' are about to be deleted or replaced, so
+    // this model would hold dangling pointers if 'subtree' is this
+    // directory or any of its ancestors.
+
+    if ( _dir && _dir->isInSubtree( subtree ) )
+	clearing();
+}
+
+
+void DirListModel::clearing()
+{
+    logDebug() << "Forgetting " << _dir << endl;
+    setDir( 0 );
+}
+
+
+void DirListSorter::run()
+{
+    FileInfoSorter::sort( _items, _sortCol, _sortOrder );
+}
@@ -0,0 +1,221 @@
+/*
+ *   File name: DirListModel.h
+ *   Summary:	Flat list model for the children of one directory
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DirListModel_h
+#define DirListModel_h
+
+
+#include <QAbstractTableModel>
+#include <QThread>
+
+#include "DataColumns.h"
+#include "FileInfo.h"
+
+
+namespace QDirStat
+{
+    class DirInfo;
+    class DirTree;
+    class DirListSorter;
+
+
+    /**
+     * Flat table model for the direct children of one directory (including
+     * the files of its dot entry).
+     *
+     * Unlike the DirTreeModel, this does not need to walk the tree for
+     * finding a row: The children are kept in one array of FileInfo
+     * pointers, so any row can be accessed in constant time, and a view
+     * with uniform row heights only ever asks for the rows that are
+     * currently visible. This is meant for directories with a very large
+     * number of entries (mail spools, object stores) that are painful to
+     * handle in the DirTreeView.
+     *
+     * Sorting a large list is done in a separate thread; until it is
+     * finished, the view keeps showing the old order.
+     **/
+    class DirListModel: public QAbstractTableModel
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	DirListModel( QObject * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~DirListModel();
+
+	/**
+	 * Set the directory to display and fetch its children.
+	 * 0 clears the model.
+	 **/
+	void setDir( DirInfo * dir );
+
+	/**
+	 * Return the directory that is displayed or 0 if there is none.
+	 **/
+	DirInfo * dir() const { return _dir; }
+
+	/**
+	 * Return the item in row 'row' or 0 if there is no such row.
+	 **/
+	FileInfo * itemAt( int row ) const;
+
+	/**
+	 * Return the data column for (view) column 'col'.
+	 **/
+	static DataColumn dataColumn( int col );
+
+	/**
+	 * Return 'true' if a sort thread is currently running.
+	 **/
+	bool isSorting() const;
+
+
+	// Mandatory methods inherited from QAbstractItemModel
+
+	virtual int rowCount   ( const QModelIndex & parent = QModelIndex() ) const Q_DECL_OVERRIDE;
+	virtual int columnCount( const QModelIndex & parent = QModelIndex() ) const Q_DECL_OVERRIDE;
+
+	virtual QVariant data( const QModelIndex & index, int role ) const Q_DECL_OVERRIDE;
+
+	virtual QVariant headerData( int	     section,
+				     Qt::Orientation orientation,
+				     int	     role ) const Q_DECL_OVERRIDE;
+
+	/**
+	 * Sort the model. For large lists, this only starts a sort thread;
+	 * the new order is applied when it is finished.
+	 **/
+	virtual void sort( int column, Qt::SortOrder order = Qt::AscendingOrder ) Q_DECL_OVERRIDE;
+
+
+    signals:
+
+	/**
+	 * Emitted when sorting in a separate thread starts.
+	 **/
+	void sortingStarted();
+
+	/**
+	 * Emitted when the new sort order is applied.
+	 **/
+	void sortingFinished();
+
+
+    protected slots:
+
+	/**
+	 * Apply the result of the sort thread.
+	 **/
+	void sortThreadFinished();
+
+	/**
+	 * Notifications from the DirTree.
+	 **/
+	void childrenAdded( const FileInfoList & newChildren );
+	void deletingChild( FileInfo * child );
+	void clearingSubtree( DirInfo * subtree );
+	void clearing();
+
+
+    protected:
+
+	/**
+	 * Fetch the children of _dir into _items.
+	 **/
+	void fetchItems();
+
+	/**
+	 * Return 'true' if 'item' is a direct child of _dir or of its dot
+	 * entry.
+	 **/
+	bool isListItem( FileInfo * item ) const;
+
+	/**
+	 * Start sorting _items by _sortCol and _sortOrder.
+	 **/
+	void startSorting();
+
+	/**
+	 * Replace _items with 'sortedItems' and move the persistent indexes
+	 * (current item, selection) along.
+	 **/
+	void applySortedItems( const FileInfoList & sortedItems );
+
+	/**
+	 * Wait until the sort thread is finished and discard its result.
+	 * This is necessary before any change to the items: The sort thread
+	 * accesses them.
+	 **/
+	void cancelSorting();
+
+	/**
+	 * Return the display text for 'item' in data column 'col'.
+	 **/
+	QVariant columnText( FileInfo * item, DataColumn col ) const;
+
+
+	//
+	// Data members
+	//
+
+	DirTree *	_tree;
+	DirInfo *	_dir;
+	FileInfoList	_items;
+	DataColumn	_sortCol;
+	Qt::SortOrder	_sortOrder;
+	DirListSorter * _sorter;
+	bool		_sortPending;	// sort() was called while sorting
+
+    };	// class DirListModel
+
+
+    /**
+     * Thread to sort a copy of a DirListModel's items.
+     **/
+    class DirListSorter: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	DirListSorter( const FileInfoList & items,
+		       DataColumn	    sortCol,
+		       Qt::SortOrder	    sortOrder ):
+	    _items( items ),
+	    _sortCol( sortCol ),
+	    _sortOrder( sortOrder )
+	    {}
+
+	/**
+	 * Return the sorted items. Use this only after the thread is
+	 * finished.
+	 **/
+	const FileInfoList & items() const { return _items; }
+
+    protected:
+
+	virtual void run() Q_DECL_OVERRIDE;
+
+	FileInfoList  _items;
+	DataColumn    _sortCol;
+	Qt::SortOrder _sortOrder;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// DirListModel_h
@@ -0,0 +1,139 @@
+/*
+ *   File name: DirListWindow.cpp
+ *   Summary:	QDirStat flat directory list window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "DirListWindow.h"
+#include "DirListModel.h"
+#include "DirInfo.h"
+#include "QDirStatApp.h"        // SelectionModel
+#include "SelectionModel.h"
+#include "SettingsHelpers.h"
+#include "HeaderTweaker.h"
+#include "Logger.h"
+#include "Exception.h"
+
+using namespace QDirStat;
+
+
+QPointer<DirListWindow> DirListWindow::_sharedInstance = 0;
+
+
+DirListWindow::DirListWindow( QWidget * parent ):
+    QDialog( parent ),
+    _ui( new Ui::DirListWindow ),
+    _model( 0 )
+{
+    // logDebug() << "init" << endl;
+
+    CHECK_NEW( _ui );
+    _ui->setupUi( this );
+
+    _model = new DirListModel( this );
+    CHECK_NEW( _model );
+
+    initWidgets();
+    readWindowSettings( this, "DirListWindow" );
+
+    connect( _ui->treeView->selectionModel(), SIGNAL( currentChanged( QModelIndex, QModelIndex ) ),
+	     this,				SLOT  ( selectResult  ( QModelIndex ) ) );
+
+    connect( _model, SIGNAL( sortingStarted() ),
+	     this,   SLOT  ( updateLabels()   ) );
+
+    connect( _model, SIGNAL( sortingFinished() ),
+	     this,   SLOT  ( updateLabels()    ) );
+
+    connect( _model, SIGNAL( modelReset()   ),
+	     this,   SLOT  ( updateLabels() ) );
+}
+
+
+DirListWindow::~DirListWindow()
+{
+    // logDebug() << "destroying" << endl;
+    writeWindowSettings( this, "DirListWindow" );
+    delete _ui;
+}
+
+
+DirListWindow * DirListWindow::sharedInstance()
+{
+    if ( ! _sharedInstance )
+    {
+	_sharedInstance = new DirListWindow( app()->findMainWindow() );
+	CHECK_NEW( _sharedInstance );
+    }
+
+    return _sharedInstance;
+}
+
+
+void DirListWindow::initWidgets()
+{
+    _ui->treeView->setModel( _model );
+    _ui->treeView->sortByColumn( 1, Qt::DescendingOrder ); // Size
+    _ui->treeView->header()->setStretchLastSection( false );
+    HeaderTweaker::resizeToContents( _ui->treeView->header() );
+    _ui->sortingLabel->hide();
+}
+
+
+void DirListWindow::reject()
+{
+    deleteLater();
+}
+
+
+void DirListWindow::populateSharedInstance( FileInfo * dir )
+{
+    if ( ! dir )
+	return;
+
+    sharedInstance()->populate( dir );
+    sharedInstance()->show();
+}
+
+
+void DirListWindow::closeSharedInstance()
+{
+    if ( _sharedInstance )
+	_sharedInstance->deleteLater();
+
+    // The QPointer will automatically reset itself
+}
+
+
+void DirListWindow::populate( FileInfo * dir )
+{
+    if ( dir && ! dir->isDirInfo() )
+	dir = dir->parent();
+
+    if ( dir && dir->isDotEntry() )
+	dir = dir->parent();
+
+    _model->setDir( dir ? dir->toDirInfo() : 0 );
+    _ui->heading->setText( dir ? dir->url() : QString() );
+    updateLabels();
+}
+
+
+void DirListWindow::updateLabels()
+{
+    _ui->totalLabel->setText( tr( "Total: %1" ).arg( _model->rowCount() ) );
+    _ui->sortingLabel->setVisible( _model->isSorting() );
+}
+
+
+void DirListWindow::selectResult( const QModelIndex & current )
+{
+    FileInfo * item = _model->itemAt( current.row() );
+
+    if ( item )
+	app()->selectionModel()->setCurrentItem( item,
+						 true ); // select
+}
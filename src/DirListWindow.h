@@ -0,0 +1,137 @@
+/*
+ *   File name: DirListWindow.h
+ *   Summary:	QDirStat flat directory list window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DirListWindow_h
+#define DirListWindow_h
+
+#include <QDialog>
+#include <QModelIndex>
+#include <QPointer>
+
+#include "ui_dir-list-window.h"
+
+
+namespace QDirStat
+{
+    class DirInfo;
+    class DirListModel;
+    class FileInfo;
+
+
+    /**
+     * Modeless dialog to display the direct children of one directory as a
+     * flat list.
+     *
+     * This is meant for directories with a huge number of entries: The
+     * list is backed by a DirListModel which keeps the children in one
+     * array, so scrolling only ever touches the visible rows, and sorting
+     * happens in a separate thread.
+     *
+     * Upon click, the item is located in the main window, i.e. it is
+     * selected in the main window's tree view and in the tree map.
+     **/
+    class DirListWindow: public QDialog
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 *
+	 * Notice that this widget will destroy itself upon window close.
+	 *
+	 * It is advised to use a QPointer for storing a pointer to an instance
+	 * of this class. The QPointer will keep track of this window
+	 * auto-deleting itself when closed.
+	 **/
+	DirListWindow( QWidget * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~DirListWindow();
+
+	/**
+	 * Static method for using one shared instance of this class between
+	 * multiple parts of the application. This will create a new instance
+	 * if there is none yet (or anymore).
+	 *
+	 * Do not hold on to this pointer; the instance destroys itself when
+	 * the user closes the window, and then the pointer becomes invalid.
+	 **/
+	static DirListWindow * sharedInstance();
+
+	/**
+	 * Convenience function for creating, populating and showing the shared
+	 * instance.
+	 **/
+	static void populateSharedInstance( FileInfo * dir );
+
+	/**
+	 * Convenience function for closing and deleting the shared instance
+	 * if it is open.
+	 **/
+	static void closeSharedInstance();
+
+
+    public slots:
+
+	/**
+	 * Populate the window with the children of 'dir'. If 'dir' is not a
+	 * directory, its parent is used.
+	 **/
+	void populate( FileInfo * dir );
+
+	/**
+	 * Reject the dialog contents, i.e. the user clicked the "Cancel" or
+	 * WM_CLOSE button. This not only closes the dialog, it also deletes
+	 * it.
+	 *
+	 * Reimplemented from QDialog.
+	 **/
+	virtual void reject() Q_DECL_OVERRIDE;
+
+
+    protected slots:
+
+	/**
+	 * Select the item of 'current' in the main window's tree and treemap
+	 * widgets via their SelectionModel.
+	 **/
+	void selectResult( const QModelIndex & current );
+
+	/**
+	 * Update the labels below the list.
+	 **/
+	void updateLabels();
+
+
+    protected:
+
+	/**
+	 * One-time initialization of the widgets in this window.
+	 **/
+	void initWidgets();
+
+
+	//
+	// Data members
+	//
+
+	Ui::DirListWindow * _ui;
+	DirListModel *	    _model;
+
+	static QPointer<DirListWindow> _sharedInstance;
+    };
+
+} // namespace QDirStat
+
+
+#endif // DirListWindow_h
@@ -0,0 +1,202 @@
+/*
+ *   File name: DirListingCache.cpp
+ *   Summary:	Asynchronous, cached directory checks for dialogs
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QDir>
+#include <QFileInfo>
+
+#include "DirListingCache.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+void DirListingThread::run()
+{
+    _exists = QFileInfo( _path ).isDir();
+
+    if ( _exists && _listSubDirs )
+	_subDirs = QDir( _path ).entryList( QDir::Dirs | QDir::NoDotAndDotDot );
+}
+
+
+
+
+DirListingCache::DirListingCache():
+    QObject(),
+    _cache( DIR_LISTING_CACHE_SIZE )
+{
+    _timeoutTimer.setInterval( DIR_LISTING_TIMEOUT_MILLISEC / 4 );
+
+    connect( &_timeoutTimer, SIGNAL( timeout()	     ),
+	     this,	     SLOT  ( checkTimeouts() ) );
+}
+
+
+DirListingCache * DirListingCache::instance()
+{
+    static DirListingCache * cache = 0;
+
+    if ( ! cache )
+    {
+	// Never deleted: A thread might still hang in a syscall at exit
+
+	cache = new DirListingCache();
+	CHECK_NEW( cache );
+    }
+
+    return cache;
+}
+
+
+bool DirListingCache::lookupDir( const QString & path, bool & exists_ret )
+{
+    Entry * entry = _cache.object( path );
+
+    if ( entry && entry->age.elapsed() < DIR_LISTING_MAX_AGE_MILLISEC )
+    {
+	exists_ret = entry->exists;
+	return true;
+    }
+
+    startThread( path, false );
+
+    return false;
+}
+
+
+bool DirListingCache::lookupSubDirs( const QString & path, QStringList & subDirs_ret )
+{
+    Entry * entry = _cache.object( path );
+
+    if ( entry && entry->age.elapsed() < DIR_LISTING_MAX_AGE_MILLISEC &&
+	 ( entry->listed || ! entry->exists ) )
+    {
+	subDirs_ret = entry->subDirs;
+	return true;
+    }
+
+    startThread( path, true );
+
+    return false;
+}
+
+
+void DirListingCache::startThread( const QString & path, bool listSubDirs )
+{
+    foreach ( DirListingThread * thread, _pending.keys() )
+    {
+	if ( thread->path() == path && ( thread->listSubDirs() || ! listSubDirs ) )
+	    return;
+    }
+
+    if ( _pending.size() >= DIR_LISTING_MAX_THREADS )
+    {
+	// Most likely all of them hang on the same dead server; try again
+	// with the next lookup
+
+	logWarning() << "Too many pending directory checks; not checking " << path << endl;
+	return;
+    }
+
+    DirListingThread * thread = new DirListingThread( path, listSubDirs );
+    CHECK_NEW( thread );
+
+    connect( thread, SIGNAL( finished()	      ),
+	     this,   SLOT  ( threadFinished() ) );
+
+    PendingThread pending;
+    pending.started.start();
+    pending.timedOut = false;
+    _pending.insert( thread, pending );
+
+    thread->start();
+
+    if ( ! _timeoutTimer.isActive() )
+	_timeoutTimer.start();
+}
+
+
+void DirListingCache::threadFinished()
+{
+    DirListingThread * thread = dynamic_cast<DirListingThread *>( sender() );
+
+    if ( ! thread || ! _pending.contains( thread ) )
+	return;
+
+    _pending.remove( thread );
+
+    if ( _pending.isEmpty() )
+	_timeoutTimer.stop();
+
+    storeResult( thread->path(), thread->listSubDirs(), thread->exists(), thread->subDirs() );
+    thread->deleteLater();
+}
+
+
+void DirListingCache::checkTimeouts()
+{
+    QMutableHashIterator<DirListingThread *, PendingThread> it( _pending );
+
+    while ( it.hasNext() )
+    {
+	it.next();
+	PendingThread & pending = it.value();
+
+	if ( ! pending.timedOut && pending.started.elapsed() > DIR_LISTING_TIMEOUT_MILLISEC )
+	{
+	    // Keep the thread: It can't be stopped while it hangs in a
+	    // syscall, and when it is done, its result is still useful.
+
+	    pending.timedOut = true;
+	    DirListingThread * thread = it.key();
+
+	    logWarning() << "Timeout checking " << thread->path() << endl;
+
+	    if ( thread->listSubDirs() )
+		emit dirListed( thread->path(), QStringList() );
+
+	    emit dirChecked( thread->path(), false );
+	}
+    }
+}
+
+
+void DirListingCache::storeResult( const QString     & path,
+				   bool		       listed,
+				   bool		       exists,
+				   const QStringList & subDirs )
+{
+    Entry * oldEntry = _cache.object( path );
+
+    if ( ! listed && exists && oldEntry && oldEntry->listed && oldEntry->exists &&
+	 oldEntry->age.elapsed() < DIR_LISTING_MAX_AGE_MILLISEC )
+    {
+	// Don't replace a listing that is still good with a plain check
+
+	emit dirChecked( path, exists );
+	return;
+    }
+
+    Entry * entry = new Entry;
+    CHECK_NEW( entry );
+
+    entry->exists  = exists;
+    entry->listed  = listed;
+    entry->subDirs = subDirs;
+    entry->age.start();
+
+    _cache.insert( path, entry );
+
+    if ( listed )
+	emit dirListed( path, subDirs );
+
+    emit dirChecked( path, exists );
+}
@@ -0,0 +1,187 @@
+/*
+ *   File name: DirListingCache.h
+ *   Summary:	Asynchronous, cached directory checks for dialogs
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DirListingCache_h
+#define DirListingCache_h
+
+
+#include <QObject>
+#include <QThread>
+#include <QCache>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTimer>
+
+
+// Results older than this are checked again
+#define DIR_LISTING_MAX_AGE_MILLISEC	10000
+
+// A check that takes longer than this counts as failed for the time being
+#define DIR_LISTING_TIMEOUT_MILLISEC	2000
+
+// Number of directories in the cache
+#define DIR_LISTING_CACHE_SIZE		256
+
+// Maximum number of checks at the same time
+#define DIR_LISTING_MAX_THREADS		8
+
+
+namespace QDirStat
+{
+    /**
+     * Thread that checks if a directory exists and optionally lists its
+     * subdirectories.
+     **/
+    class DirListingThread: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	DirListingThread( const QString & path, bool listSubDirs ):
+	    QThread(),
+	    _path( path ),
+	    _listSubDirs( listSubDirs ),
+	    _exists( false )
+	    {}
+
+	const QString &	    path()	  const { return _path;	       }
+	bool		    listSubDirs() const { return _listSubDirs; }
+	bool		    exists()	  const { return _exists;      }
+	const QStringList & subDirs()	  const { return _subDirs;     }
+
+    protected:
+
+	/**
+	 * Check and list the directory. This is called in the new thread.
+	 *
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+
+	QString	    _path;
+	bool	    _listSubDirs;
+	bool	    _exists;
+	QStringList _subDirs;
+    };
+
+
+    /**
+     * Cache for checking if directories exist and for their subdirectories
+     * for the ExistingDirValidator and the ExistingDirCompleter.
+     *
+     * Anything that is not in the cache is checked in a separate thread, so
+     * a path on an automounter or on a hung NFS server does not freeze the
+     * dialog: The lookup functions return 'false' in that case, and the
+     * result is announced with dirChecked() or dirListed() when it is
+     * there. If that takes longer than DIR_LISTING_TIMEOUT_MILLISEC, the
+     * directory counts as not existing until the thread is finally done.
+     *
+     * This is a singleton. It is only used from the GUI thread.
+     **/
+    class DirListingCache: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Return the singleton instance.
+	 **/
+	static DirListingCache * instance();
+
+	/**
+	 * Return 'true' if it is known if directory 'path' exists and
+	 * return that in 'exists_ret'. Otherwise start checking it and
+	 * return 'false'.
+	 **/
+	bool lookupDir( const QString & path, bool & exists_ret );
+
+	/**
+	 * Return 'true' if the subdirectories of 'path' are known and return
+	 * their names in 'subDirs_ret'. Otherwise start listing them and
+	 * return 'false'.
+	 **/
+	bool lookupSubDirs( const QString & path, QStringList & subDirs_ret );
+
+
+    signals:
+
+	/**
+	 * Emitted when it is known if directory 'path' exists.
+	 **/
+	void dirChecked( const QString & path, bool exists );
+
+	/**
+	 * Emitted when the subdirectories of 'path' are known.
+	 **/
+	void dirListed( const QString & path, const QStringList & subDirs );
+
+
+    protected slots:
+
+	/**
+	 * Take over the result of a finished thread.
+	 **/
+	void threadFinished();
+
+	/**
+	 * Give up waiting for threads that take too long.
+	 **/
+	void checkTimeouts();
+
+
+    protected:
+
+	/**
+	 * Constructor. Use instance() instead.
+	 **/
+	DirListingCache();
+
+	/**
+	 * Start a thread for 'path' unless there already is one that does
+	 * the same.
+	 **/
+	void startThread( const QString & path, bool listSubDirs );
+
+	/**
+	 * Store a result and announce it.
+	 **/
+	void storeResult( const QString	    & path,
+			  bool		      listed,
+			  bool		      exists,
+			  const QStringList & subDirs );
+
+
+	struct Entry
+	{
+	    bool	  exists;
+	    bool	  listed;
+	    QStringList	  subDirs;
+	    QElapsedTimer age;
+	};
+
+	struct PendingThread
+	{
+	    QElapsedTimer started;
+	    bool	  timedOut;
+	};
+
+	QCache<QString, Entry>			  _cache;
+	QHash<DirListingThread *, PendingThread>  _pending;
+	QTimer					  _timeoutTimer;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// DirListingCache_h
@@ -12,21 +12,99 @@
 #include <fcntl.h>	// AT_ constants (fstatat() flags)
 #include <unistd.h>
 #include <stdio.h>
+#include <string.h>	// strcmp(), strerror()
+#include <errno.h>
+#include <algorithm>
+
+#ifdef __linux__
+#  include <sys/syscall.h>	// SYS_getdents64
+#  include <sys/sysmacros.h>	// makedev()
+#endif
 
 #include <QMutableListIterator>
 #include <QMultiMap>
+#include <QHash>
+#include <QAtomicInt>
+#include <QThreadStorage>
+#include <QThread>
+#include <QSet>
+#include <QFileInfo>
+#include <QDir>
 
 #include "DirReadJob.h"
 #include "DirTree.h"
 #include "DirTreeCache.h"
+#include "ListingReadPipeline.h"
+#include "DirReadWorkerPool.h"
+#include "DirReadStats.h"
+#include "DirFdCache.h"
+#include "ReadThrottle.h"
+#include "ReadTrace.h"
+#include "IoUring.h"
+#include "BulkInodeTable.h"
 #include "Attic.h"
 #include "ExcludeRules.h"
 #include "MountPoints.h"
+#include "ScanCoordinator.h"
+#include "SizeEstimator.h"
+#include "StallWatchdog.h"
 #include "Exception.h"
 
 #define DONT_TRUST_NTFS_HARD_LINKS      1
 #define VERBOSE_NTFS_HARD_LINKS         0
 
+// Use getdents64() and statx() directly if the system has them
+#if defined( __linux__ ) && defined( SYS_getdents64 ) && defined( STATX_BASIC_STATS )
+#  define USE_GETDENTS_STATX		1
+#else
+#  define USE_GETDENTS_STATX		0
+#endif
+
+// The program that RemoteReadJob starts on the remote host; it has to be in
+// the $PATH there
+#define REMOTE_CACHE_WRITER		"qdirstat-cache-writer"
+
+#define REMOTE_URL_PREFIX		"ssh://"
+
+// The program that RemoteReadJob starts for a snapshot from a local
+// qdirstat-daemon
+#define DAEMON_CLIENT			"qdirstat-daemon"
+
+#define DAEMON_URL_PREFIX		"daemon:"
+
+// Number of cache files that MergedCacheReadJob decompresses and parses in
+// the background besides the one that is being added to the tree. Each of
+// them has its own CacheReadPipeline with its own threads.
+#define MAX_MERGE_READ_AHEAD		3
+
+// Number of cache read jobs in the queue, e.g. for cache files that were
+// found in subdirectories while scanning, that decompress and parse their
+// cache file in the background while other jobs are running.
+#define MAX_CACHE_READ_AHEAD		3
+
+// Time budget of one time slice of the job queue in the GUI thread:
+// Long enough that the event loop overhead does not matter for many tiny
+// directories, short enough that the user interface remains responsive.
+
+#define READ_TIME_SLICE_MILLISEC	10
+
+// Number of directory entries to process between checks of that budget
+
+#define ENTRIES_PER_TIME_CHECK		256
+
+// Buffer size for one getdents64() call: Large enough for several hundred
+// typical directory entries, so most directories are read with one or two
+// syscalls rather than with one readdir() libc buffer refill every 32 kB.
+#define GETDENTS_BUF_SIZE		( 256 * 1024 )
+
+// Directories with at least this many entries (e.g. flat object stores) are
+// stat()ed by several threads at the same time, each with a contiguous range
+// of at least PARALLEL_STAT_MIN_RANGE entries, and by at most
+// PARALLEL_STAT_MAX_THREADS threads.
+#define PARALLEL_STAT_MIN_ENTRIES	20000
+#define PARALLEL_STAT_MIN_RANGE		5000
+#define PARALLEL_STAT_MAX_THREADS	8
+
 using namespace QDirStat;
 
 
@@ -34,7 +112,9 @@ DirReadJob::DirReadJob( DirTree * tree,
 			DirInfo * dir  ):
     _tree( tree ),
     _dir( dir ),
-    _queue( 0 )
+    _queue( 0 ),
+    _prioritized( false ),
+    _suspended( false )
 {
     _started = false;
 
@@ -85,6 +165,22 @@ void DirReadJob::setDir( DirInfo * dir )
 }
 
 
+void DirReadJob::suspend()
+{
+    if ( _queue )
+	_queue->suspend( this );
+    else
+	logError() << "No job queue for " << _dir << endl;
+}
+
+
+void DirReadJob::resume()
+{
+    if ( _suspended )
+	_tree->unblock( this );
+}
+
+
 void DirReadJob::finished()
 {
     if ( _queue )
@@ -151,13 +247,40 @@ bool DirReadJob::crossingFilesystems( DirInfo * parent, DirInfo * child )
 }
 
 
+MountPoint * DirReadJob::mountPoint( const DirInfo * dir ) const
+{
+    if ( ! dir )
+	return 0;
+
+    // Most filesystems are mounted only once, so the device number is
+    // enough. Only for bind mounts and filesystems that are mounted several
+    // times, the path has to tell which mount point this is.
+
+    dev_t	 deviceId   = dir->device();
+    MountPoint * mountPoint = MountPoints::findByDeviceId( deviceId );
+
+    if ( ! mountPoint || MountPoints::hasMultipleMounts( deviceId ) )
+	mountPoint = MountPoints::findByPath( dir->url() );
+
+    return mountPoint;
+}
+
+
 QString DirReadJob::device( const DirInfo * dir ) const
 {
     QString device;
 
     if ( dir )
     {
-	MountPoint * mountPoint = MountPoints::findByPath( dir->url() );
+	MountPoint * mountPoint = this->mountPoint( dir );
+
+	if ( ! mountPoint )
+	{
+	    // The path might be different from the one in the mount table,
+	    // e.g. with a symlink somewhere above it.
+
+	    mountPoint = MountPoints::findByDeviceId( dir->device() );
+	}
 
 	if ( mountPoint )
 	    device = mountPoint->device();
@@ -169,7 +292,13 @@ QString DirReadJob::device( const DirInfo * dir ) const
 
 bool DirReadJob::shouldCrossIntoFilesystem( const DirInfo * dir ) const
 {
-    MountPoint * mountPoint = MountPoints::findByPath( dir->url() );
+    MountPoint * mountPoint = this->mountPoint( dir );
+
+    if ( ! mountPoint )
+    {
+	logWarning() << "No mount point for " << dir << "; not reading it" << endl;
+	return false;
+    }
 
     bool doCross =
 	! mountPoint->isSystemMount()  &&	//  /dev, /proc, /sys, ...
@@ -193,341 +322,1221 @@ LocalDirReadJob::LocalDirReadJob( DirTree * tree,
 				  DirInfo * dir ):
     DirReadJob( tree, dir ),
     _applyFileChildExcludeRules( false ),
+    _matchedFileChildExcludeRule( false ),
     _checkedForNtfs( false ),
-    _isNtfs( false )
+    _isNtfs( false ),
+    _prefetched( false ),
+    _prefetchedReadState( DirQueued ),
+    _prefetchWorker( -1 ),
+    _inode( 0 ),
+    _nextEntry( 0 ),
+    _checkFileChildren( false ),
+    _sampleSubDirs( false )
 {
     if ( _dir )
+    {
 	_dirName = _dir->url();
+
+	DirInfo * parent = _dir->parent();
+
+	if ( parent && ! parent->isPseudoDir() )
+	{
+	    _location.device	   = _dir->device();
+	    _location.inode	   = _dir->inode();
+	    _location.parentDevice = parent->device();
+	    _location.parentInode  = parent->inode();
+	    _location.name	   = _dir->name().toUtf8();
+	}
+    }
 }
 
 
 LocalDirReadJob::~LocalDirReadJob()
 {
-    // NOP
+    // The worker pool is owned by the tree, so it might already be gone if
+    // the tree is being destroyed.
+
+    if ( ! _tree->beingDestroyed() )
+    {
+	foreach ( DirReadWorkerPool * pool, _tree->readWorkerPools() )
+	    pool->cancel( this );
+    }
 }
 
 
 void LocalDirReadJob::startReading()
 {
-    struct dirent * entry;
-    struct stat	    statInfo;
-    QString	    defaultCacheName = DEFAULT_CACHE_NAME;
-    DIR *	    diskDir;
-
     // logDebug() << _dir << endl;
 
-    bool ok = true;
+    LocalDirEntryList entries;
+    DirReadState      readState;
+
+    if ( _prefetched )
+    {
+	// A worker thread already did all the syscalls for this directory
+	readState = _prefetchedReadState;
+	entries	  = _prefetchedEntries;
+	_prefetchedEntries.clear();
+    }
+    else
+    {
+	readState = readEntries( _dirName, entries, false, tree()->readStats(), tree()->readThrottle(),
+				 tree()->bulkInodeTable().data(), &_location );
+    }
+
+    processReadResult( readState, entries );
+    // Don't add anything after this since this deletes this job!
+}
+
 
-    if ( access( _dirName.toUtf8(), X_OK | R_OK ) != 0 )
+void LocalDirReadJob::processReadResult( DirReadState		   readState,
+					 const LocalDirEntryList & entries )
+{
+    if ( readState == DirPermissionDenied )
     {
-	ok = false;
 	logWarning() << "No permission to read directory " << _dirName << endl;
 	finishReading( _dir, DirPermissionDenied );
     }
-
-    if ( ok )
+    else if ( readState == DirError )
     {
-	diskDir = ::opendir( _dirName.toUtf8() );
-
-	if ( ! diskDir )
-	{
-	    logWarning() << "opendir(" << _dirName << ") failed" << endl;
-	    ok = false;
-	    // opendir() doesn't set 'errno' according to POSIX	 :-(
-	    finishReading( _dir, DirError );
-	}
+	logWarning() << "opendir(" << _dirName << ") failed" << endl;
+	// opendir() doesn't set 'errno' according to POSIX	 :-(
+	finishReading( _dir, DirError );
     }
-
-    if ( ok )
+    else
     {
 	_dir->setReadState( DirReading );
-	int dirFd = dirfd( diskDir );
-	int flags = AT_SYMLINK_NOFOLLOW;
+	processEntries( entries );
+	processPendingEntries();
+	// Don't add anything after this since this might delete this job!
 
-#ifdef AT_NO_AUTOMOUNT
-	flags |= AT_NO_AUTOMOUNT;
-#endif
+	return;
+    }
+
+    finished();
+    // Don't add anything after finished() since this deletes this job!
+}
 
-	QMultiMap<ino_t, QString> entryMap;
 
-	while ( ( entry = readdir( diskDir ) ) )
-	{
-	    QString entryName = QString::fromUtf8( entry->d_name );
+void LocalDirReadJob::read()
+{
+    if ( _started )
+	processPendingEntries();
+    else
+	DirReadJob::read();
 
-	    if ( entryName != "."  &&
-		 entryName != ".."   )
-	    {
-		entryMap.insert( entry->d_ino, entryName );
-	    }
+    // Don't add anything after this since this might delete this job!
+}
+
+
+void LocalDirReadJob::processPendingEntries()
+{
+    QString defaultCacheName	   = DEFAULT_CACHE_NAME;
+    QString defaultBinaryCacheName = DEFAULT_BINARY_CACHE_NAME;
+    ExcludeRules * excludeRules	   = ExcludeRules::instance();
+
+    while ( _nextEntry < _pendingEntries.size() )
+    {
+	// A huge directory is processed in several time slices, so it does
+	// not block the user interface for seconds. The job stays at the
+	// head of the queue, so the next time slice continues here.
+
+	if ( _nextEntry > 0 && _nextEntry % ENTRIES_PER_TIME_CHECK == 0 &&
+	     _queue && _queue->timeSliceUsedUp() )
+	{
+	    return;
 	}
 
-	// QMultiMap (just like QMap) guarantees sort order by keys, so we are
-	// now iterating over the directory entries by i-number order. Most
-	// filesystems will benefit from that since they store i-nodes sorted
-	// by i-number on disk, so (at least with rotational disks) seek times
-	// are minimized by this strategy.
-	//
-	// Notice that we need a QMultiMap, not just a map: If a file has
-	// multiple hard links in the same directory, a QMap would store only
-	// one of them, all others would go missing in the DirTree.
+	LocalDirEntry entry = _pendingEntries.at( _nextEntry++ );
+	const QString & entryName = entry.name;
+	struct stat   & statInfo  = entry.statInfo;
 
-	foreach ( QString entryName, entryMap )
+	if ( entry.statErrno == 0 )	// lstat() OK?
 	{
-	    if ( fstatat( dirFd, entryName.toUtf8(), &statInfo, flags ) == 0 )	// OK?
+	    if ( S_ISDIR( statInfo.st_mode ) )	// directory child?
 	    {
-		if ( S_ISDIR( statInfo.st_mode ) )	// directory child?
-		{
-		    DirInfo *subDir = new DirInfo( entryName, &statInfo, _tree, _dir );
-		    CHECK_NEW( subDir );
+		DirInfo *subDir = new DirInfo( entryName, &statInfo, _tree, _dir );
+		CHECK_NEW( subDir );
 
-		    processSubDir( entryName, subDir );
+		processSubDir( entryName, subDir, statInfo.st_ino );
 
-		}
-		else  // non-directory child
+	    }
+	    else  // non-directory child
+	    {
+		if ( entryName == defaultCacheName ||		// .qdirstat.cache.gz found?
+		     entryName == defaultBinaryCacheName )	// .qdirstat.cache.bin found?
 		{
-		    if ( entryName == defaultCacheName )	// .qdirstat.cache.gz found?
-		    {
-			logDebug() << "Found cache file " << defaultCacheName << endl;
+		    logDebug() << "Found cache file " << entryName << endl;
 
-			// Try to read the cache file. If that was successful and the toplevel
-			// path in that cache file matches the path of the directory we are
-			// reading right now, the directory is finished reading, the read job
-			// (this object) was just deleted, and we may no longer access any
-			// member variables; just return.
+		    // Try to read the cache file. If that was successful and the toplevel
+		    // path in that cache file matches the path of the directory we are
+		    // reading right now, the directory is finished reading, the read job
+		    // (this object) was just deleted, and we may no longer access any
+		    // member variables; just return.
 
-			if ( readCacheFile( entryName ) )
-			    return;
-		    }
+		    if ( readCacheFile( entryName ) )
+			return;
+		}
 
 #if DONT_TRUST_NTFS_HARD_LINKS
 
-                    if ( statInfo.st_nlink > 1 && isNtfs() )
-                    {
-                        // NTFS seems to return bogus hard link counts; use 1 instead.
-                        // See  https://github.com/shundhammer/qdirstat/issues/88
+		if ( statInfo.st_nlink > 1 && isNtfs() )
+		{
+		    // NTFS seems to return bogus hard link counts; use 1 instead.
+		    // See  https://github.com/shundhammer/qdirstat/issues/88
 
 #if ! VERBOSE_NTFS_HARD_LINKS
-                        if ( ! _warnedAboutNtfsHardLinks )
+		    if ( ! _warnedAboutNtfsHardLinks )
 #endif
-                        {
-                            logWarning() << "Not trusting NTFS with hard links: \""
-                                         << _dir->url() << "/" << entryName
-                                         << "\" links: " << statInfo.st_nlink
-                                         << " -> resetting to 1"
-                                         << endl;
-                            _warnedAboutNtfsHardLinks = true;
-                        }
-
-                        statInfo.st_nlink = 1;
-                    }
+		    {
+			logWarning() << "Not trusting NTFS with hard links: \""
+				     << _dir->url() << "/" << entryName
+				     << "\" links: " << statInfo.st_nlink
+				     << " -> resetting to 1"
+				     << endl;
+			_warnedAboutNtfsHardLinks = true;
+		    }
+
+		    statInfo.st_nlink = 1;
+		}
 #endif
-		    FileInfo * child = new FileInfo( entryName, &statInfo, _tree, _dir );
-		    CHECK_NEW( child );
+		FileInfo * child = new FileInfo( entryName, &statInfo, _tree, _dir );
+		CHECK_NEW( child );
+
+		if ( checkIgnoreFilters( entryName ) )
+		{
+		    // logDebug() << "Ignoring " << child << endl;
+		    _dir->addToAttic( child );
+		}
+		else
+		{
+		    _dir->insertChild( child );
 
-		    if ( checkIgnoreFilters( entryName ) )
+		    if ( _checkFileChildren && excludeRules->matchFileChild( entryName ) )
 		    {
-			// logDebug() << "Ignoring " << child << endl;
-			_dir->addToAttic( child );
+			logDebug() << _dir << " matches " << excludeRules->lastMatchingRule() << endl;
+			_matchedFileChildExcludeRule = true;
+			_checkFileChildren = false;
 		    }
-		    else
-			_dir->insertChild( child );
-
-		    childAdded( child );
 		}
+
+		childAdded( child );
 	    }
-	    else  // lstat() error
-	    {
-		handleLstatError( entryName );
-	    }
 	}
+	else  // lstat() error
+	{
+	    handleLstatError( entryName, entry.statErrno );
+	}
+    }
 
-	closedir( diskDir );
-	DirReadState readState = DirFinished;
+    _pendingEntries.clear();
+    _nextEntry = 0;
+    queueSampledSubDirs();
 
-	//
-	// Check all entries against exclude rules that match against any
-	// direct non-directory entry.
-	//
-	// Doing this now is a performance optimization: This could also be
-	// done immediately after each entry is read, but that would mean
-	// iterating over all exclude rules for every single directory entry,
-	// even if there are no exclude rules that match against any
-	// files, so it would be a general performance penalty.
-	//
-	// Doing this after all entries are read means more cleanup if any
-	// exclude rule does match, but that is the exceptional case; if there
-	// are no such rules to begin with, the match function returns 'false'
-	// immediately, so the performance impact is minimal.
-	//
-	// Also intentionally not also checking the DirTree specific exclude
-	// rules here: They are meant strictly for directory exclude rules.
+    DirReadState readState = DirFinished;
 
-	if ( _applyFileChildExcludeRules &&
-	     ExcludeRules::instance()->matchDirectChildren( _dir ) )
-	{
-	    excludeDirLate();
-	    readState = DirOnRequestOnly;
-	}
+    // Each non-directory entry was checked against the exclude rules that
+    // match against any direct non-directory entry, which is only a hash
+    // lookup for fixed file names like "CACHEDIR.TAG". If any of them
+    // matched, the directory is excluded now, which means some cleanup, but
+    // that is the exceptional case.
+    //
+    // Also intentionally not also checking the DirTree specific exclude
+    // rules here: They are meant strictly for directory exclude rules.
 
-	finishReading( _dir, readState );
+    if ( _matchedFileChildExcludeRule )
+    {
+	excludeDirLate();
+	readState = DirOnRequestOnly;
     }
 
+    finishReading( _dir, readState );
     finished();
     // Don't add anything after finished() since this deletes this job!
 }
 
 
-void LocalDirReadJob::finishReading( DirInfo * dir, DirReadState readState )
+DirReadState LocalDirReadJob::readEntries( const QString	       & dirName,
+					   LocalDirEntryList   & entries_ret,
+					   bool			 useIoUring,
+					   DirReadStats	       * stats,
+					   ReadThrottle	       * throttle,
+					   const BulkInodeTable * bulkTable,
+					   const LocalDirLocation * location )
 {
-    // logDebug() << dir << endl;
-    CHECK_PTR( dir );
+    struct dirent * entry;
+    QVector<float>  statNanosec;
+    QVector<float> * latencies = stats ? &statNanosec : 0;
+    bool	     tracing   = ReadTrace::isEnabled();
 
-    dir->setReadState( readState );
-    dir->finalizeLocal();
-    _tree->sendReadJobFinished( dir );
-}
+    READ_TRACE_SCOPE( "read dir", dirName );
+    entries_ret.clear();
 
+    int dirFd = openDir( dirName, location );
 
-void LocalDirReadJob::processSubDir( const QString & entryName, DirInfo * subDir )
-{
-    _dir->insertChild( subDir );
-    childAdded( subDir );
+    if ( dirFd < 0 )
+	return errno == EACCES ? DirPermissionDenied : DirError;
 
-    if ( matchesExcludeRule( entryName ) )
+    // Like access() on the path, but without resolving it again
+
+    if ( faccessat( dirFd, ".", X_OK | R_OK, 0 ) != 0 )
     {
-	subDir->setExcluded();
-	finishReading( subDir, DirOnRequestOnly );
+	::close( dirFd );
+	return DirPermissionDenied;
     }
-    else // No exclude rule matched
+
+#if USE_GETDENTS_STATX
+    DirReadState readState;
+
+    if ( readEntriesFast( dirFd, entries_ret, readState, useIoUring,
+			  latencies, throttle, bulkTable ) )
     {
-	if ( ! crossingFilesystems(_dir, subDir ) ) // normal case
-	{
-	    LocalDirReadJob * job = new LocalDirReadJob( _tree, subDir );
-	    CHECK_NEW( job );
-	    job->setApplyFileChildExcludeRules( true );
-	    _tree->addJob( job );
-	}
-	else	    // The subdirectory we just found is a mount point.
-	{
-	    subDir->setMountPoint();
+	if ( stats && readState == DirFinished )
+	    stats->addDir( entries_ret.size(), statNanosec );
 
-	    if ( _tree->crossFilesystems() && shouldCrossIntoFilesystem( subDir ) )
-	    {
-		LocalDirReadJob * job = new LocalDirReadJob( _tree, subDir );
-		CHECK_NEW( job );
-		job->setApplyFileChildExcludeRules( true );
-		_tree->addJob( job );
-	    }
-	    else
-	    {
-		finishReading( subDir, DirOnRequestOnly );
-	    }
-	}
+	closeDir( dirFd, location, entries_ret );
+
+	return readState;
     }
-}
+#else
+    Q_UNUSED( useIoUring );
+    Q_UNUSED( bulkTable );
+#endif
 
+    // closedir() closes the descriptor that fdopendir() uses, but 'dirFd'
+    // might be kept open for the subdirectories
 
-bool LocalDirReadJob::matchesExcludeRule( const QString & entryName ) const
-{
-    QString full = fullName( entryName );
+    DIR * diskDir = 0;
+    int	  readFd  = dup( dirFd );
 
-    if ( ExcludeRules::instance()->match( full, entryName ) )
-	return true;
+    if ( readFd >= 0 )
+    {
+	diskDir = fdopendir( readFd );
 
-    if ( ! _tree->excludeRules() )
-	return false;
+	if ( ! diskDir )
+	    ::close( readFd );
+    }
 
-    return _tree->excludeRules()->match( full, entryName );
-}
+    if ( ! diskDir )
+    {
+	::close( dirFd );
+	return DirError;
+    }
 
+    // The fast path might have read some of it already
 
-bool LocalDirReadJob::checkIgnoreFilters( const QString & entryName ) const
-{
-    if ( ! _tree->hasFilters() )
-	return false;
+    rewinddir( diskDir );
 
-    return _tree->checkIgnoreFilters( fullName( entryName ) );
-}
+    int flags = AT_SYMLINK_NOFOLLOW;
 
+#ifdef AT_NO_AUTOMOUNT
+    flags |= AT_NO_AUTOMOUNT;
+#endif
 
-bool LocalDirReadJob::readCacheFile( const QString & cacheFileName )
-{
-    QString cacheFullName = fullName( cacheFileName );
-    CacheReadJob * cacheReadJob = new CacheReadJob( _tree, _dir->parent(), cacheFullName );
-    CHECK_NEW( cacheReadJob );
-    QString firstDirInCache = cacheReadJob->reader()->firstDir();
+    QMultiMap<ino_t, QByteArray> entryMap;
 
-    if ( firstDirInCache == _dirName )	 // Does this cache file match this directory?
     {
-	logDebug() << "Using cache file " << cacheFullName << " for " << _dirName << endl;
-
-	DirTree * tree = _tree;	 // Copy data members to local variables:
-	DirInfo * dir  = _dir;	 // This object might be deleted soon by killAll()
+	READ_TRACE_SCOPE( "readdir", QString() );
 
-	if ( _tree->isTopLevel( _dir ) )
+	while ( ( entry = readdir( diskDir ) ) )
 	{
-	    logDebug() << "Clearing complete tree" << endl;
+	    const char * name = entry->d_name;
 
-	    _tree->clearAndReadCache( cacheFullName );
+	    if ( strcmp( name, "." ) != 0 && strcmp( name, ".." ) != 0 )
+		entryMap.insert( entry->d_ino, QByteArray( name ) );
+	}
+    }
 
-	    // Since this clears the tree and thus the job queue and thus
-	    // deletes this read job, it is important not to do anything after
-	    // this point that might access any member variables or even just
-	    // uses any virtual method.
+    // QMultiMap (just like QMap) guarantees sort order by keys, so we are
+    // now iterating over the directory entries by i-number order. Most
+    // filesystems will benefit from that since they store i-nodes sorted
+    // by i-number on disk, so (at least with rotational disks) seek times
+    // are minimized by this strategy.
+    //
+    // Notice that we need a QMultiMap, not just a map: If a file has
+    // multiple hard links in the same directory, a QMap would store only
+    // one of them, all others would go missing in the DirTree.
 
-	    return true;
-	}
-	else
-	{
-	    cacheReadJob->reader()->rewind();  // Read offset was moved by firstDir()
-	    _tree->addJob( cacheReadJob );     // The job queue will assume ownership of cacheReadJob
+    entries_ret.reserve( entryMap.size() );
 
-	    if ( _dir->parent() )
-		_dir->parent()->setReadState( DirReading );
+    if ( latencies )
+	latencies->reserve( entryMap.size() );
 
-	    //
-	    // Clean up partially read directory content
-	    //
+    foreach ( const QByteArray & name, entryMap )
+    {
+	LocalDirEntry dirEntry;
+	dirEntry.name	   = QString::fromUtf8( name );
+	dirEntry.statErrno = 0;
 
-	    _queue->killAll( _dir, cacheReadJob );	// Will delete this job as well!
-	    // All data members of this object are invalid from here on!
+	if ( throttle )
+	    throttle->acquire();
 
-	    logDebug() << "Deleting subtree " << dir << endl;
-	    tree->deleteSubtree( dir );
-	}
+	qint64 startTime = latencies || tracing ? ReadTrace::nanosecNow() : 0;
 
-	return true;
-    }
-    else
-    {
-	logWarning() << "NOT using cache file " << cacheFullName
-		     << " with dir " << firstDirInCache
-		     << " for " << _dirName
-		     << endl;
+	if ( fstatat( dirFd, name.constData(), &dirEntry.statInfo, flags ) != 0 )
+	    dirEntry.statErrno = errno;
 
-	delete cacheReadJob;
+	if ( latencies )
+	    *latencies << ReadTrace::nanosecNow() - startTime;
 
-	return false;
+	if ( tracing )
+	    ReadTrace::complete( "fstatat", startTime, dirEntry.name );
+
+	entries_ret << dirEntry;
     }
+
+    closedir( diskDir );
+    closeDir( dirFd, location, entries_ret );
+
+    if ( stats )
+	stats->addDir( entries_ret.size(), statNanosec );
+
+    return DirFinished;
 }
 
 
-void LocalDirReadJob::excludeDirLate()
+int LocalDirReadJob::openDir( const QString	      & dirName,
+			      const LocalDirLocation * location )
 {
-    logDebug() << "Excluding dir " << _dir << endl;
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
 
-    // Kill all queued jobs for this dir except this one
-    _queue->killAll( _dir, this );
+    if ( location && location->isValid() )
+    {
+	int parentFd = DirFdCache::acquire( location->parentDevice, location->parentInode );
 
-    _tree->clearSubtree( _dir );
-    _dir->setExcluded();
+	if ( parentFd >= 0 )
+	{
+	    int dirFd;
+
+	    {
+		READ_TRACE_SCOPE( "openat", QString() );
+		dirFd = ::openat( parentFd, location->name.constData(), flags | O_NOFOLLOW );
+	    }
+
+	    DirFdCache::release( location->parentDevice, location->parentInode );
+
+	    if ( dirFd >= 0 )
+		return dirFd;
+
+	    // Renamed or replaced by a symlink in the meantime: Resolve the
+	    // path like before
+	}
+    }
+
+    READ_TRACE_SCOPE( "opendir", QString() );
+
+    return ::open( dirName.toUtf8().constData(), flags );
 }
 
 
-void LocalDirReadJob::handleLstatError( const QString & entryName )
+void LocalDirReadJob::closeDir( int			    dirFd,
+				const LocalDirLocation	  * location,
+				const LocalDirEntryList	  & entries )
 {
-    logWarning() << "lstat(" << fullName( entryName ) << ") failed: "
-		 << formatErrno() << endl;
+    if ( location && location->inode != 0 )
+    {
+	foreach ( const LocalDirEntry & entry, entries )
+	{
+	    if ( entry.statErrno == 0 && S_ISDIR( entry.statInfo.st_mode ) )
+	    {
+		DirFdCache::insert( location->device, location->inode, dirFd );
+		return;
+	    }
+	}
+    }
+
+    ::close( dirFd );
+}
+
+
+#if USE_GETDENTS_STATX
+
+// Cleared when the kernel does not support getdents64() or statx();
+// accessed from the worker threads.
+static QAtomicInt useGetdentsStatx( 1 );
+
+
+struct RawDirEntry
+{
+    ino_t	  ino;
+    unsigned char type;	// d_type; DT_UNKNOWN on some filesystems
+    const char *  name;	// points into the getdents64() buffer
+};
+
+
+static bool inoLessThan( const RawDirEntry & a, const RawDirEntry & b )
+{
+    return a.ino < b.ino;
+}
+
+
+/**
+ * The record format of the getdents64() syscall. glibc does not export
+ * this, so it has to be defined here (see man getdents64).
+ **/
+struct LinuxDirent64
+{
+    ino64_t	   d_ino;
+    off64_t	   d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char	   d_name[];
+};
+
+
+static void statxToStat( const struct statx & stx, struct stat & st )
+{
+    memset( &st, 0, sizeof( st ) );
+
+    st.st_dev	 = makedev( stx.stx_dev_major, stx.stx_dev_minor );
+    st.st_ino	 = stx.stx_ino;
+    st.st_mode	 = stx.stx_mode;
+    st.st_nlink	 = stx.stx_nlink;
+    st.st_uid	 = stx.stx_uid;
+    st.st_gid	 = stx.stx_gid;
+    st.st_size	 = stx.stx_size;
+    st.st_blocks = stx.stx_blocks;
+    st.st_mtime	 = stx.stx_mtime.tv_sec;
+}
+
+
+/**
+ * stat() 'count' entries from 'rawEntries' in directory 'dirFd' with
+ * statx() and store the results in 'entries' and the duration of each call
+ * in 'statNanosec' if that is non-null.
+ *
+ * Return 'false' if the kernel does not support statx(); this is known
+ * after the first call.
+ **/
+static bool statxEntries( int		    dirFd,
+			  const RawDirEntry * rawEntries,
+			  int		    count,
+			  int		    flags,
+			  unsigned	    mask,
+			  LocalDirEntry *   entries,
+			  float *	    statNanosec,
+			  ReadThrottle *    throttle )
+{
+    bool tracing = ReadTrace::isEnabled();
+
+    for ( int i = 0; i < count; ++i )
+    {
+	const RawDirEntry & rawEntry = rawEntries[ i ];
+	LocalDirEntry	  & dirEntry = entries[ i ];
+	struct statx stx;
+
+	dirEntry.name	   = QString::fromUtf8( rawEntry.name );
+	dirEntry.statErrno = 0;
+
+	if ( throttle )
+	    throttle->acquire();
+
+	qint64 startTime = statNanosec || tracing ? ReadTrace::nanosecNow() : 0;
+	int    result	 = statx( dirFd, rawEntry.name, flags, mask, &stx );
+	int    statErrno = result == 0 ? 0 : errno;
+
+	if ( statNanosec )
+	    statNanosec[ i ] = ReadTrace::nanosecNow() - startTime;
+
+	if ( tracing )
+	    ReadTrace::complete( "statx", startTime, dirEntry.name );
+
+	if ( result == 0 )
+	{
+	    statxToStat( stx, dirEntry.statInfo );
+	}
+	else
+	{
+	    dirEntry.statErrno = statErrno;
+
+	    if ( statErrno == ENOSYS && i == 0 )
+		return false;	// The C library has statx(), but the kernel doesn't
+	}
+    }
+
+    return true;
+}
+
+
+/**
+ * Thread to stat() one contiguous range of the entries of a huge directory
+ * while other threads do the same with the other ranges. The ranges are in
+ * i-number order, so each thread still benefits from that.
+ **/
+class ParallelStatThread: public QThread
+{
+public:
+
+    ParallelStatThread( int		    dirFd,
+			const RawDirEntry * rawEntries,
+			int		    count,
+			int		    flags,
+			unsigned	    mask,
+			LocalDirEntry *	    entries,
+			float *		    statNanosec,
+			ReadThrottle *	    throttle ):
+	QThread(),
+	_dirFd( dirFd ),
+	_rawEntries( rawEntries ),
+	_count( count ),
+	_flags( flags ),
+	_mask( mask ),
+	_entries( entries ),
+	_statNanosec( statNanosec ),
+	_throttle( throttle ),
+	_ok( true )
+	{}
+
+    bool ok() const { return _ok; }
+
+protected:
+
+    virtual void run() Q_DECL_OVERRIDE
+    {
+	_ok = statxEntries( _dirFd, _rawEntries, _count, _flags, _mask,
+			    _entries, _statNanosec, _throttle );
+    }
+
+    int			_dirFd;
+    const RawDirEntry * _rawEntries;
+    int			_count;
+    int			_flags;
+    unsigned		_mask;
+    LocalDirEntry *	_entries;
+    float *		_statNanosec;
+    ReadThrottle *	_throttle;
+    bool		_ok;
+};
+
+
+/**
+ * stat() the entries of a huge directory with several threads and return
+ * the results in the same order. Return 'false' if the kernel does not
+ * support statx().
+ **/
+static bool statxEntriesParallel( int				 dirFd,
+				  const QVector<RawDirEntry> & rawEntries,
+				  int				 flags,
+				  unsigned			 mask,
+				  LocalDirEntryList &		 entries_ret,
+				  QVector<float> *		 statNanosec,
+				  ReadThrottle *		 throttle )
+{
+    int count	= rawEntries.size();
+    int threads = qMin( count / PARALLEL_STAT_MIN_RANGE,
+			qMin( QThread::idealThreadCount(), PARALLEL_STAT_MAX_THREADS ) );
+    int range	= ( count + threads - 1 ) / threads;
+
+    QVector<LocalDirEntry> entries( count );
+    float * nanosec = 0;
+
+    if ( statNanosec )
+    {
+	statNanosec->resize( count );
+	nanosec = statNanosec->data();
+    }
+
+    // The calling thread takes the first range itself
+
+    QList<ParallelStatThread *> statThreads;
+
+    for ( int start = range; start < count; start += range )
+    {
+	ParallelStatThread * thread =
+	    new ParallelStatThread( dirFd,
+				    rawEntries.constData() + start,
+				    qMin( range, count - start ),
+				    flags, mask,
+				    entries.data() + start,
+				    nanosec ? nanosec + start : 0,
+				    throttle );
+	CHECK_NEW( thread );
+
+	statThreads << thread;
+	thread->start();
+    }
+
+    bool ok = statxEntries( dirFd, rawEntries.constData(), qMin( range, count ), flags, mask,
+			    entries.data(), nanosec, throttle );
+
+    foreach ( ParallelStatThread * thread, statThreads )
+    {
+	thread->wait();
+	ok = ok && thread->ok();
+    }
+
+    qDeleteAll( statThreads );
+
+    if ( ! ok )
+	return false;
+
+    for ( int i = 0; i < count; ++i )
+	entries_ret << entries.at( i );
+
+    return true;
+}
+
+
+#if HAVE_IO_URING
+
+/**
+ * Return the io_uring of the current thread. Each worker thread gets its own
+ * since an io_uring can't be shared between threads without locking.
+ * QThreadStorage deletes it when the thread terminates.
+ **/
+static IoUring * threadIoUring()
+{
+    static QThreadStorage<IoUring *> ioUrings;
+
+    if ( ! ioUrings.hasLocalData() )
+	ioUrings.setLocalData( new IoUring() );
+
+    return ioUrings.localData();
+}
+
+#endif
+
+
+/**
+ * Move the entries of 'rawEntries' that don't need a stat() call because
+ * they are in 'bulkTable' to 'entries_ret'. Directories always stay in
+ * 'rawEntries': A mount point has the inode of the root directory of the
+ * mounted filesystem, not the one that getdents64() returns.
+ **/
+static void takeBulkEntries( int		     dirFd,
+			     const BulkInodeTable *  bulkTable,
+			     QVector<RawDirEntry>  & rawEntries,
+			     LocalDirEntryList	   & entries_ret )
+{
+    struct stat dirInfo;
+
+    if ( fstat( dirFd, &dirInfo ) != 0 || dirInfo.st_dev != bulkTable->device() )
+	return;
+
+    QVector<RawDirEntry> misses;
+
+    foreach ( const RawDirEntry & rawEntry, rawEntries )
+    {
+	LocalDirEntry dirEntry;
+
+	if ( rawEntry.type != DT_DIR &&
+	     bulkTable->lookup( rawEntry.ino, dirEntry.statInfo ) &&
+	     ( rawEntry.type == DT_UNKNOWN ||
+	       IFTODT( dirEntry.statInfo.st_mode ) == rawEntry.type ) )
+	{
+	    dirEntry.name      = QString::fromUtf8( rawEntry.name );
+	    dirEntry.statErrno = 0;
+	    entries_ret << dirEntry;
+	}
+	else
+	{
+	    // Not in the table, a directory, or the inode was reused for
+	    // something else after the table was read
+
+	    misses << rawEntry;
+	}
+    }
+
+    rawEntries = misses;
+}
+
+
+bool LocalDirReadJob::readEntriesFast( int			       dirFd,
+				       LocalDirEntryList     & entries_ret,
+				       DirReadState	     & readState_ret,
+				       bool		       useIoUring,
+				       QVector<float>	     * statNanosec,
+				       ReadThrottle	     * throttle,
+				       const BulkInodeTable  * bulkTable )
+{
+    if ( ! useGetdentsStatx.load() )
+	return false;
+
+    // Read all entry names into one buffer that grows as needed. The entries
+    // point into that buffer, so it is only reallocated between
+    // getdents64() calls, and the entry pointers are set up afterwards.
+
+    QByteArray buffer;
+    int	       used = 0;
+
+    forever
+    {
+	if ( buffer.size() - used < GETDENTS_BUF_SIZE )
+	    buffer.resize( used + GETDENTS_BUF_SIZE );
+
+	long bytes;
+
+	{
+	    READ_TRACE_SCOPE( "getdents64", QString() );
+	    bytes = syscall( SYS_getdents64, dirFd, buffer.data() + used, GETDENTS_BUF_SIZE );
+	}
+
+	if ( bytes < 0 )
+	{
+	    if ( errno == ENOSYS )
+	    {
+		useGetdentsStatx.store( 0 );
+		return false;
+	    }
+
+	    readState_ret = DirError;
+	    return true;
+	}
+
+	if ( bytes == 0 )	// end of directory
+	    break;
+
+	used += bytes;
+    }
+
+    QVector<RawDirEntry> rawEntries;
+    const char * pos = buffer.constData();
+    const char * end = pos + used;
+
+    while ( pos < end )
+    {
+	const LinuxDirent64 * dirent = (const LinuxDirent64 *) pos;
+	const char * name = dirent->d_name;
+
+	if ( ! ( name[0] == '.' && ( name[1] == 0 || ( name[1] == '.' && name[2] == 0 ) ) ) )
+	{
+	    RawDirEntry rawEntry;
+	    rawEntry.ino  = dirent->d_ino;
+	    rawEntry.type = dirent->d_type;
+	    rawEntry.name = name;
+	    rawEntries << rawEntry;
+	}
+
+	pos += dirent->d_reclen;
+    }
+
+    // Stat in i-number order; see the comment in readEntries().
+    // A stable sort keeps multiple hard links in the same directory apart.
+
+    std::stable_sort( rawEntries.begin(), rawEntries.end(), inoLessThan );
+
+    if ( bulkTable )
+    {
+	takeBulkEntries( dirFd, bulkTable, rawEntries, entries_ret );
+
+	if ( rawEntries.isEmpty() )
+	{
+	    readState_ret = DirFinished;
+
+	    return true;
+	}
+    }
+
+    // Request only the fields that FileInfo and DirInfo actually use, and
+    // don't make network filesystems synchronize with the server just for
+    // this: Cached attributes are good enough for disk usage.
+
+    unsigned mask  = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID |
+		     STATX_MTIME | STATX_SIZE | STATX_BLOCKS;
+    int	     flags = AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC;
+
+#ifdef AT_NO_AUTOMOUNT
+    flags |= AT_NO_AUTOMOUNT;
+#endif
+
+    entries_ret.reserve( rawEntries.size() );
+
+#if HAVE_IO_URING
+
+    IoUring * ioUring = useIoUring && rawEntries.size() > 1 ? threadIoUring() : 0;
+
+    if ( ioUring && ioUring->ok() )
+    {
+	// Submit the statx() calls for all entries at once and let the kernel
+	// execute them concurrently
+
+	bool tracing = ReadTrace::isEnabled();
+	int  count   = rawEntries.size();
+	QVector<const char *>	names( count );
+	QVector<struct statx>	results( count );
+	QVector<int>		errors( count );
+
+	for ( int i = 0; i < count; ++i )
+	    names[ i ] = rawEntries.at( i ).name;
+
+	if ( throttle )
+	    throttle->acquire( count );
+
+	qint64 startTime = statNanosec || tracing ? ReadTrace::nanosecNow() : 0;
+
+	if ( ioUring->statxBatch( dirFd, names.constData(), count, flags, mask,
+				  results.data(), errors.data() ) )
+	{
+	    if ( tracing )
+		ReadTrace::complete( "statx batch", startTime, QString::number( count ) );
+
+	    if ( statNanosec )
+	    {
+		// The kernel executes them concurrently, so only the average
+		// duration of the calls in this batch is known
+
+		float average = float( ReadTrace::nanosecNow() - startTime ) / count;
+		statNanosec->fill( average, count );
+	    }
+
+	    for ( int i = 0; i < count; ++i )
+	    {
+		LocalDirEntry dirEntry;
+		dirEntry.name	   = QString::fromUtf8( names.at( i ) );
+		dirEntry.statErrno = errors.at( i );
+
+		if ( dirEntry.statErrno == 0 )
+		    statxToStat( results.at( i ), dirEntry.statInfo );
+
+		entries_ret << dirEntry;
+	    }
+
+	    readState_ret = DirFinished;
+
+	    return true;
+	}
+
+	// The io_uring failed; use synchronous statx() calls
+    }
+#else
+    Q_UNUSED( useIoUring );
+#endif
+
+    bool statxOk;
+
+    if ( rawEntries.size() >= PARALLEL_STAT_MIN_ENTRIES &&
+	 qMin( QThread::idealThreadCount(), PARALLEL_STAT_MAX_THREADS ) > 1 )
+    {
+	// A huge directory: One thread would wait for one inode after the
+	// other, but the filesystem can do several at the same time.
+
+	READ_TRACE_SCOPE( "parallel statx", QString::number( rawEntries.size() ) );
+	statxOk = statxEntriesParallel( dirFd, rawEntries, flags, mask,
+					entries_ret, statNanosec, throttle );
+    }
+    else
+    {
+	QVector<LocalDirEntry> entries( rawEntries.size() );
+
+	if ( statNanosec )
+	    statNanosec->resize( rawEntries.size() );
+
+	statxOk = statxEntries( dirFd, rawEntries.constData(), rawEntries.size(), flags, mask,
+				entries.data(), statNanosec ? statNanosec->data() : 0, throttle );
+
+	if ( statxOk )
+	{
+	    for ( int i = 0; i < entries.size(); ++i )
+		entries_ret << entries.at( i );
+	}
+    }
+
+    if ( ! statxOk )
+    {
+	useGetdentsStatx.store( 0 );
+	entries_ret.clear();
+
+	if ( statNanosec )
+	    statNanosec->clear();
+
+	return false;
+    }
+
+    readState_ret = DirFinished;
+
+    return true;
+}
+
+#endif // USE_GETDENTS_STATX
+
+
+void LocalDirReadJob::setPrefetched( DirReadState		 readState,
+				     const LocalDirEntryList &	 entries,
+				     int			 workerNo )
+{
+    _prefetched		 = true;
+    _prefetchedReadState = readState;
+    _prefetchedEntries	 = entries;
+    _prefetchWorker	 = workerNo;
+}
+
+
+void LocalDirReadJob::processEntries( const LocalDirEntryList & entries )
+{
+    _pendingEntries = entries;
+    _nextEntry	    = 0;
+
+    _checkFileChildren = _applyFileChildExcludeRules && ExcludeRules::instance()->hasFileChildRules();
+    _matchedFileChildExcludeRule = false;
+    _sampleSubDirs = _tree->sizeEstimator()->isSampling( _dir );
+}
+
+
+void LocalDirReadJob::finishReading( DirInfo * dir, DirReadState readState )
+{
+    // logDebug() << dir << endl;
+    CHECK_PTR( dir );
+
+    dir->setReadState( readState );
+
+    READ_TRACE_SCOPE( "finalizeLocal", dir->url() );
+    dir->finalizeLocal();
+    _tree->spillFiles( dir );
+    _tree->sendReadJobFinished( dir );
+}
+
+
+void LocalDirReadJob::processSubDir( const QString & entryName,
+				     DirInfo	   * subDir,
+				     ino_t	     inode )
+{
+    _dir->insertChild( subDir );
+    childAdded( subDir );
+
+    if ( matchesExcludeRule( entryName ) )
+    {
+	subDir->setExcluded();
+	finishReading( subDir, DirOnRequestOnly );
+    }
+    else if ( _tree->overMemoryBudget() )
+    {
+	// Reading more would get the program killed; the user can still
+	// read it later with "Refresh Selected"
+
+	subDir->setOverBudget();
+	finishReading( subDir, DirOnRequestOnly );
+    }
+    else // No exclude rule matched
+    {
+	if ( ! crossingFilesystems(_dir, subDir ) ) // normal case
+	{
+	    ScanCoordinator * coordinator = _tree->scanCoordinator();
+
+	    if ( _tree->readQuotaTotals( subDir ) )
+	    {
+		// The filesystem already knows its totals
+
+		finishReading( subDir, DirOnRequestOnly );
+	    }
+	    else if ( coordinator && _dir == _tree->firstToplevel() )
+	    {
+		// Distributed scan: Read it on another host
+
+		coordinator->addSubtree( subDir );
+	    }
+	    else if ( _sampleSubDirs )
+	    {
+		// Estimate mode: Which ones to read is decided when all of
+		// them are known
+
+		_sampleCandidates << subDir;
+		_sampleInodes	  << inode;
+	    }
+	    else
+	    {
+		LocalDirReadJob * job = new LocalDirReadJob( _tree, subDir );
+		CHECK_NEW( job );
+		job->setApplyFileChildExcludeRules( true );
+		job->setInode( inode );
+		queueSubDirJob( job );
+	    }
+	}
+	else	    // The subdirectory we just found is a mount point.
+	{
+	    subDir->setMountPoint();
+
+	    if ( _tree->readQuotaTotals( subDir ) )
+	    {
+		finishReading( subDir, DirOnRequestOnly );
+	    }
+	    else if ( _tree->crossFilesystems() && shouldCrossIntoFilesystem( subDir ) )
+	    {
+		LocalDirReadJob * job = new LocalDirReadJob( _tree, subDir );
+		CHECK_NEW( job );
+		job->setApplyFileChildExcludeRules( true );
+		job->setInode( inode );
+		queueSubDirJob( job );
+	    }
+	    else
+	    {
+		finishReading( subDir, DirOnRequestOnly );
+	    }
+	}
+    }
+}
+
+
+void LocalDirReadJob::queueSubDirJob( LocalDirReadJob * job )
+{
+    DirReadWorkerPool * workerPool = _tree->readWorkerPool( job->dir() );
+
+    if ( workerPool )
+    {
+	// The job waits in the blocked jobs list until a worker thread has
+	// read the directory; the pool will then unblock it.
+	//
+	// Prefer the worker that read this directory: It will continue
+	// depth-first in this subtree while idle workers steal from the other
+	// end of its task list.
+
+	// A mount point is read by the pool of its own filesystem where the
+	// worker numbers have a different meaning.
+
+	bool sameDevice = job->dir()->device() == _dir->device();
+
+	_tree->addBlockedJob( job );
+	workerPool->submit( job, sameDevice ? _prefetchWorker : -1 );
+    }
+    else
+    {
+	_tree->addJob( job );
+    }
+}
+
+
+void LocalDirReadJob::queueSampledSubDirs()
+{
+    if ( _sampleCandidates.isEmpty() )
+	return;
+
+    SizeEstimator * estimator = _tree->sizeEstimator();
+    QVector<bool> sampled = estimator->selectSample( _sampleCandidates.size() );
+
+    for ( int i = 0; i < _sampleCandidates.size(); ++i )
+    {
+	DirInfo * subDir = _sampleCandidates.at( i );
+
+	if ( sampled.at( i ) )
+	{
+	    LocalDirReadJob * job = new LocalDirReadJob( _tree, subDir );
+	    CHECK_NEW( job );
+	    job->setApplyFileChildExcludeRules( true );
+	    job->setInode( _sampleInodes.at( i ) );
+	    queueSubDirJob( job );
+	}
+	else
+	{
+	    estimator->markEstimated( subDir );
+	    finishReading( subDir, DirOnRequestOnly );
+	}
+    }
+
+    _sampleCandidates.clear();
+    _sampleInodes.clear();
+}
+
+
+bool LocalDirReadJob::matchesExcludeRule( const QString & entryName ) const
+{
+    ExcludeRules * treeRules = _tree->excludeRules();
+
+    // Only build the full path if any rule needs it
+
+    QString full;
+
+    if ( ExcludeRules::instance()->hasFullPathRules() ||
+	 ( treeRules && treeRules->hasFullPathRules() ) )
+    {
+	full = fullName( entryName );
+    }
+
+    if ( ExcludeRules::instance()->match( full, entryName ) )
+	return true;
+
+    if ( ! treeRules )
+	return false;
+
+    return treeRules->match( full, entryName );
+}
+
+
+bool LocalDirReadJob::checkIgnoreFilters( const QString & entryName ) const
+{
+    if ( ! _tree->hasFilters() )
+	return false;
+
+    return _tree->checkIgnoreFilters( _dirName, entryName );
+}
+
+
+bool LocalDirReadJob::readCacheFile( const QString & cacheFileName )
+{
+    QString cacheFullName = fullName( cacheFileName );
+    CacheReadJob * cacheReadJob = new CacheReadJob( _tree, _dir->parent(), cacheFullName );
+    CHECK_NEW( cacheReadJob );
+    QString firstDirInCache = cacheReadJob->reader()->firstDir();
+
+    if ( firstDirInCache == _dirName )	 // Does this cache file match this directory?
+    {
+	logDebug() << "Using cache file " << cacheFullName << " for " << _dirName << endl;
+
+	DirTree * tree = _tree;	 // Copy data members to local variables:
+	DirInfo * dir  = _dir;	 // This object might be deleted soon by killAll()
+
+	if ( _tree->isTopLevel( _dir ) )
+	{
+	    logDebug() << "Clearing complete tree" << endl;
+
+	    _tree->clearAndReadCache( cacheFullName );
+
+	    // Since this clears the tree and thus the job queue and thus
+	    // deletes this read job, it is important not to do anything after
+	    // this point that might access any member variables or even just
+	    // uses any virtual method.
+
+	    return true;
+	}
+	else
+	{
+	    cacheReadJob->reader()->rewind();  // Read offset was moved by firstDir()
+	    _tree->addJob( cacheReadJob );     // The job queue will assume ownership of cacheReadJob
+
+	    if ( _dir->parent() )
+		_dir->parent()->setReadState( DirReading );
+
+	    //
+	    // Clean up partially read directory content
+	    //
+
+	    _queue->killAll( _dir, cacheReadJob );	// Will delete this job as well!
+	    // All data members of this object are invalid from here on!
+
+	    logDebug() << "Deleting subtree " << dir << endl;
+	    tree->deleteSubtree( dir );
+	}
+
+	return true;
+    }
+    else
+    {
+	logWarning() << "NOT using cache file " << cacheFullName
+		     << " with dir " << firstDirInCache
+		     << " for " << _dirName
+		     << endl;
+
+	delete cacheReadJob;
+
+	return false;
+    }
+}
+
+
+void LocalDirReadJob::excludeDirLate()
+{
+    logDebug() << "Excluding dir " << _dir << endl;
+
+    // Kill all queued jobs for this dir except this one
+    _queue->killAll( _dir, this );
+
+    _tree->clearSubtree( _dir );
+    _dir->setExcluded();
+}
+
+
+void LocalDirReadJob::handleLstatError( const QString & entryName, int errorNo )
+{
+    logWarning() << "lstat(" << fullName( entryName ) << ") failed: "
+		 << QString::fromUtf8( strerror( errorNo ) ) << endl;
 
     /*
      * Not much we can do when lstat() didn't work; let's at
@@ -607,26 +1616,181 @@ FileInfo * LocalDirReadJob::stat( const QString & url,
 	if ( doThrow )
 	    THROW( SysCallFailedException( "lstat", url ) );
 
-	return 0;
+	return 0;
+    }
+}
+
+
+bool LocalDirReadJob::isNtfs()
+{
+    if ( ! _checkedForNtfs )
+    {
+        _isNtfs         = false;
+        _checkedForNtfs = true;
+
+        if ( ! _dirName.isEmpty() )
+        {
+            // All mounts of the same device have the same filesystem type,
+            // so the device number is enough.
+
+            MountPoint * mountPoint = MountPoints::findByDeviceId( _dir->device() );
+
+            if ( ! mountPoint )
+                mountPoint = MountPoints::findNearestMountPoint( _dirName );
+
+            _isNtfs = mountPoint && mountPoint->isNtfs();
+        }
+    }
+
+    return _isNtfs;
+}
+
+
+
+
+
+
+IncrementalDirReadJob::IncrementalDirReadJob( DirTree * tree,
+					      DirInfo * dir ):
+    LocalDirReadJob( tree, dir ),
+    _oldReadState( dir ? dir->readState() : DirQueued )
+{
+
+}
+
+
+IncrementalDirReadJob::~IncrementalDirReadJob()
+{
+
+}
+
+
+bool IncrementalDirReadJob::canRefresh( DirInfo * dir )
+{
+    if ( ! dir || dir->isPseudoDir() || dir->isExcluded() || dir->isCachePlaceholder() )
+	return false;
+
+    return dir->readState() == DirFinished || dir->readState() == DirCached;
+}
+
+
+void IncrementalDirReadJob::startReading()
+{
+    struct stat statInfo;
+
+    if ( lstat( _dirName.toUtf8(), &statInfo ) == 0 && S_ISDIR( statInfo.st_mode ) )
+    {
+	if ( statInfo.st_mtime == _dir->mtime() )
+	{
+	    // No entries were added, removed or renamed: Keep the content and
+	    // check only the subdirectories.
+
+	    queueIncrementalJobs();
+	    finishReading( _dir, _oldReadState );
+	    finished();
+	    // Don't add anything after finished() since this deletes this job!
+
+	    return;
+	}
+
+	_dir->updateStat( &statInfo );
+	_dir->markSummaryDirty();
+    }
+
+    LocalDirEntryList entries;
+    DirReadState readState = readEntries( _dirName, entries, false, tree()->readStats(), tree()->readThrottle(),
+					     0, &_location );
+
+    if ( readState != DirFinished )
+	clearDir();
+
+    processReadResult( readState, entries );
+    // Don't add anything after this since this deletes this job!
+}
+
+
+void IncrementalDirReadJob::processEntries( const LocalDirEntryList & entries )
+{
+    QHash<QString, DirInfo *> oldSubDirs;
+
+    for ( FileInfo * child = _dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() && canRefresh( child->toDirInfo() ) )
+	    oldSubDirs.insert( child->name(), child->toDirInfo() );
+    }
+
+    // Keep the subdirectories that are still there; everything else is
+    // created again from the new entries.
+
+    LocalDirEntryList newEntries;
+    QList<DirInfo *>  keptSubDirs;
+
+    foreach ( const LocalDirEntry & entry, entries )
+    {
+	DirInfo * subDir = 0;
+
+	if ( entry.statErrno == 0 && S_ISDIR( entry.statInfo.st_mode ) )
+	    subDir = oldSubDirs.take( entry.name );
+
+	if ( subDir )
+	    keptSubDirs << subDir;
+	else
+	    newEntries << entry;
+    }
+
+    foreach ( DirInfo * subDir, keptSubDirs )
+	_dir->unlinkChild( subDir );
+
+    clearDir();
+
+    foreach ( DirInfo * subDir, keptSubDirs )
+    {
+	_dir->insertChild( subDir );
+	queueIncrementalJob( subDir );
+    }
+
+    LocalDirReadJob::processEntries( newEntries );
+}
+
+
+void IncrementalDirReadJob::queueIncrementalJobs()
+{
+    for ( FileInfo * child = _dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() && canRefresh( child->toDirInfo() ) )
+	    queueIncrementalJob( child->toDirInfo() );
     }
 }
 
 
-bool LocalDirReadJob::isNtfs()
+void IncrementalDirReadJob::queueIncrementalJob( DirInfo * subDir )
 {
-    if ( ! _checkedForNtfs )
-    {
-        _isNtfs         = false;
-        _checkedForNtfs = true;
+    IncrementalDirReadJob * job = new IncrementalDirReadJob( _tree, subDir );
+    CHECK_NEW( job );
+    job->setApplyFileChildExcludeRules( true );
 
-        if ( ! _dirName.isEmpty() )
-        {
-            MountPoint * mountPoint = MountPoints::findNearestMountPoint( _dirName );
-            _isNtfs = mountPoint && mountPoint->isNtfs();
-        }
-    }
+    // Just like a new subdirectory, the views show its children only
+    // when it is finished.
 
-    return _isNtfs;
+    subDir->setReadState( DirQueued );
+    _tree->addJob( job );
+}
+
+
+void IncrementalDirReadJob::clearDir()
+{
+    // Not using DirTree::clearSubtree() with its signals: The views
+    // already forgot the content of this directory (see DirTree::refresh()).
+
+    _tree->markCacheDirty( _dir );
+
+    for ( FileInfo * child = _dir->firstChild(); child; child = child->next() )
+	_tree->forgetCachePlaceholders( child );
+
+    _tree->forgetLocateIndex( _dir );
+    _tree->sendChildrenAdded();
+    _dir->clear();
+    _dir->markSummaryDirty();
 }
 
 
@@ -667,6 +1831,13 @@ void CacheReadJob::init()
 	{
 	    connect( _reader,	SIGNAL( childAdded    ( FileInfo * ) ),
 		     this,	SLOT  ( slotChildAdded( FileInfo * ) ) );
+
+	    // Let the other jobs run while the next block is parsed
+
+	    connect( _reader,	SIGNAL( blockAvailable() ),
+		     this,	SLOT  ( slotResume()	 ) );
+
+	    _reader->setWaitForBlocks( false );
 	}
 	else
 	{
@@ -693,9 +1864,13 @@ CacheReadJob::read()
      */
 
     if ( ! _reader )
+    {
 	finished();
+	return;
+    }
 
     // logDebug() << "Reading 1000 cache lines" << endl;
+    StallOperation operation( "Cache read slice" );
     _reader->read( 1000 );
 
     if ( _reader->eof() || ! _reader->ok() )
@@ -703,6 +1878,337 @@ CacheReadJob::read()
 	// logDebug() << "Cache reading finished - ok: " << _reader->ok() << endl;
 	finished();
     }
+    else if ( _reader->blockPending() )
+    {
+	suspend();	// until blockAvailable()
+    }
+}
+
+
+
+
+
+MergedCacheReadJob::MergedCacheReadJob( DirTree	      * tree,
+					DirInfo		      * parent,
+					const QStringList     & cacheFileNames )
+    : CacheReadJob( tree, parent, (CacheReader *) 0 )
+    , _errorCount( 0 )
+{
+    // Make the labels unique: Cache files from different directories
+    // often have the same name.
+
+    QSet<QString> usedLabels;
+
+    foreach ( const QString & fileName, cacheFileNames )
+    {
+	QString label = mergeLabel( fileName );
+	QString uniqueLabel = label;
+
+	for ( int i = 2; usedLabels.contains( uniqueLabel ); ++i )
+	    uniqueLabel = QString( "%1-%2" ).arg( label ).arg( i );
+
+	usedLabels.insert( uniqueLabel );
+	_pendingFiles  << fileName;
+	_pendingLabels << uniqueLabel;
+    }
+
+    openReaders();
+}
+
+
+MergedCacheReadJob::~MergedCacheReadJob()
+{
+    qDeleteAll( _readers );
+}
+
+
+QString MergedCacheReadJob::mergeLabel( const QString & cacheFileName )
+{
+    QFileInfo fileInfo( cacheFileName );
+    QString label = fileInfo.fileName();
+
+    QStringList suffixes;
+    suffixes << ".gz" << ZSTD_CACHE_SUFFIX << BINARY_CACHE_SUFFIX << ".cache";
+
+    foreach ( const QString & suffix, suffixes )
+    {
+	if ( label.endsWith( suffix ) )
+	    label.chop( suffix.size() );
+    }
+
+    // The default cache file name says nothing; use the directory instead
+
+    if ( label.isEmpty() || label == ".qdirstat" )
+	label = fileInfo.absoluteDir().dirName();
+
+    return label;
+}
+
+
+void MergedCacheReadJob::openReaders()
+{
+    while ( _readers.size() < MAX_MERGE_READ_AHEAD && ! _pendingFiles.isEmpty() )
+    {
+	QString fileName = _pendingFiles.takeFirst();
+	QString label	 = _pendingLabels.takeFirst();
+
+	CacheReader * reader = new CacheReader( fileName, tree(), 0 );
+	CHECK_NEW( reader );
+
+	if ( ! reader->ok() )
+	{
+	    logError() << "Can't read cache file " << fileName << endl;
+	    delete reader;
+	    ++_errorCount;
+	    continue;
+	}
+
+	reader->mergeInto( dir(), label );
+	reader->readAhead();
+	_readers << reader;
+    }
+}
+
+
+void MergedCacheReadJob::read()
+{
+    StallOperation operation( "Cache read slice" );
+
+    if ( ! _reader )
+    {
+	openReaders();
+
+	if ( _readers.isEmpty() )
+	{
+	    // All cache files are done
+
+	    DirInfo * merged = dir();
+	    merged->setReadState( _errorCount > 0 ? DirError : DirCached );
+	    merged->finalizeLocal();
+	    tree()->sendReadJobFinished( merged );
+	    finished();
+
+	    return;
+	}
+
+	_reader = _readers.takeFirst();
+
+	connect( _reader,	SIGNAL( childAdded    ( FileInfo * ) ),
+		 this,		SLOT  ( slotChildAdded( FileInfo * ) ) );
+
+	connect( _reader,	SIGNAL( blockAvailable() ),
+		 this,		SLOT  ( slotResume()	 ) );
+
+	_reader->setWaitForBlocks( false );
+    }
+
+    _reader->read( 1000 );
+
+    if ( _reader->eof() || ! _reader->ok() )
+    {
+	if ( ! _reader->ok() )
+	    ++_errorCount;
+
+	delete _reader;	// This finalizes the toplevel of that cache file
+	_reader = 0;
+    }
+    else if ( _reader->blockPending() )
+    {
+	suspend();	// until blockAvailable()
+    }
+}
+
+
+
+
+
+ListingReadJob::ListingReadJob( DirTree * tree, const QString & fileName )
+    : CacheReadJob( tree, 0, (CacheReader *) 0 )
+{
+    ListingReadPipeline * pipeline =
+	new ListingReadPipeline( fileName, qMax( CacheReadPipeline::defaultParserCount(), 1 ) );
+    CHECK_NEW( pipeline );
+
+    if ( pipeline->ok() )
+    {
+	logInfo() << "Reading listing " << fileName << endl;
+
+	_reader = new CacheReader( pipeline, fileName, tree );
+	CHECK_NEW( _reader );
+	init();
+    }
+    else
+    {
+	delete pipeline;
+    }
+}
+
+
+ListingReadJob::~ListingReadJob()
+{
+    // NOP
+}
+
+
+bool ListingReadJob::isListing( const QString & fileName )
+{
+    return ListingReadPipeline::detectFormat( fileName ) != NoListing;
+}
+
+
+
+
+
+RemoteReadJob::RemoteReadJob( DirTree	    * tree,
+			      const QString & host,
+			      const QString & path,
+			      DirInfo	    * dir )
+    : CacheReadJob( tree, dir, (CacheReader *) 0 )
+    , _url( host.isEmpty() ? DAEMON_URL_PREFIX + path : REMOTE_URL_PREFIX + host + path )
+    , _remoteFinished( false )
+{
+    _process = new QProcess( this );
+    CHECK_NEW( _process );
+
+    _reader = new CacheReader( _process, _url, tree, dir );
+    CHECK_NEW( _reader );
+    init();
+
+    connect( _process, SIGNAL( readyReadStandardOutput() ),
+	     this,     SLOT  ( readRemoteData()		 ) );
+
+    connect( _process, SIGNAL( finished	      ( int, QProcess::ExitStatus ) ),
+	     this,     SLOT  ( processFinished( int, QProcess::ExitStatus ) ) );
+
+    connect( _process, SIGNAL( error	   ( QProcess::ProcessError ) ),
+	     this,     SLOT  ( processError( QProcess::ProcessError ) ) );
+
+    if ( host.isEmpty() )
+    {
+	// A snapshot of a tree that a local qdirstat-daemon keeps up to date
+
+	QStringList args;
+	args << "-q" << "snapshot" << path;
+
+	logInfo() << "Starting " << DAEMON_CLIENT << " " << args.join( " " ) << endl;
+	_process->start( DAEMON_CLIENT, args );
+
+	return;
+    }
+
+    // ssh hands the command to the remote shell as one string, so the path
+    // needs quoting: 'it'\''s'
+
+    QString quotedPath = "'" + QString( path ).replace( "'", "'\\''" ) + "'";
+
+    QStringList args;
+    args << "-o" << "BatchMode=yes"
+	 << host
+	 << QString( "%1 -s %2" ).arg( REMOTE_CACHE_WRITER ).arg( quotedPath );
+
+    logInfo() << "Starting ssh " << args.join( " " ) << endl;
+    _process->start( "ssh", args );
+}
+
+
+RemoteReadJob::~RemoteReadJob()
+{
+    _process->disconnect( this );
+
+    if ( _process->state() != QProcess::NotRunning )
+    {
+	logInfo() << "Killing remote scan " << _url << endl;
+	_process->kill();
+	_process->waitForFinished( 1000 );
+    }
+}
+
+
+bool RemoteReadJob::isRemoteUrl( const QString & url )
+{
+    return url.startsWith( REMOTE_URL_PREFIX ) || url.startsWith( DAEMON_URL_PREFIX );
+}
+
+
+bool RemoteReadJob::splitRemoteUrl( const QString & url,
+				    QString	  & host_ret,
+				    QString	  & path_ret )
+{
+    if ( ! isRemoteUrl( url ) )
+	return false;
+
+    if ( url.startsWith( DAEMON_URL_PREFIX ) )
+    {
+	host_ret.clear();
+	path_ret = url.mid( QString( DAEMON_URL_PREFIX ).size() );
+
+	return path_ret.startsWith( "/" );
+    }
+
+    QString rest  = url.mid( QString( REMOTE_URL_PREFIX ).size() );
+    int	    slash = rest.indexOf( '/' );
+
+    if ( slash <= 0 )
+	return false;
+
+    host_ret = rest.left( slash );
+    path_ret = rest.mid( slash );
+
+    return true;
+}
+
+
+void RemoteReadJob::readRemoteData()
+{
+    if ( _reader )
+	_reader->read( 0 );	// all complete lines that are available
+}
+
+
+void RemoteReadJob::processFinished( int exitCode, QProcess::ExitStatus exitStatus )
+{
+    if ( exitStatus != QProcess::NormalExit || exitCode != 0 )
+    {
+	logError() << "Remote scan " << _url << " failed with exit code "
+		   << exitCode << endl;
+    }
+
+    finishRemote();
+}
+
+
+void RemoteReadJob::processError( QProcess::ProcessError error )
+{
+    if ( error == QProcess::FailedToStart )
+    {
+	// There will be no finished() signal
+
+	logError() << "Can't start the remote scan " << _url << ": "
+		   << _process->errorString() << endl;
+	finishRemote();
+    }
+}
+
+
+void RemoteReadJob::finishRemote()
+{
+    if ( _remoteFinished )
+	return;
+
+    _remoteFinished = true;
+    readRemoteData();
+
+    QString errors = QString::fromUtf8( _process->readAllStandardError() ).trimmed();
+
+    if ( ! errors.isEmpty() )
+	logWarning() << _url << ": " << errors << endl;
+
+    if ( _reader )
+	_reader->finishStream();
+
+    // Let the queue call read() which will finish this job
+
+    resume();
 }
 
 
@@ -727,8 +2233,31 @@ void DirReadJobQueue::enqueue( DirReadJob * job )
 {
     if ( job )
     {
-	_queue.append( job );
+	READ_TRACE_INSTANT( "enqueue", job->dir() ? job->dir()->url() : QString() );
+	job->setPrioritized( job->dir() && job->tree()->isPrioritized( job->dir() ) );
+
+	if ( job->isPrioritized() )
+	{
+	    // After the other prioritized jobs, so the visible subtree is
+	    // still read breadth-first
+
+	    int pos = 0;
+
+	    while ( pos < _queue.size() && _queue.at( pos )->isPrioritized() )
+		++pos;
+
+	    _queue.insert( pos, job );
+	}
+	else
+	{
+	    _queue.append( job );
+	}
+
 	job->setQueue( this );
+	READ_TRACE_COUNTER( "queued jobs", _queue.size() );
+
+	if ( dynamic_cast<CacheReadJob *>( job ) )
+	    readAheadCaches();
 
 	if ( ! _timer.isActive() )
 	{
@@ -778,11 +2307,39 @@ void DirReadJobQueue::abort()
 }
 
 
+void DirReadJobQueue::prioritize( DirInfo * subtree )
+{
+    QList<DirReadJob *> prioritized;
+    QList<DirReadJob *> others;
+
+    if ( subtree && subtree->tree() )
+	subtree->tree()->updateSubtreeLabels( _queue.size() );
+
+    foreach ( DirReadJob * job, _queue )
+    {
+	job->setPrioritized( subtree && job->dir() && job->dir()->isInSubtree( subtree ) );
+
+	if ( job->isPrioritized() )
+	    prioritized << job;
+	else
+	    others << job;
+    }
+
+    if ( ! prioritized.isEmpty() )
+	logDebug() << "Reading " << prioritized.size() << " jobs in " << subtree << " first" << endl;
+
+    _queue = prioritized + others;
+}
+
+
 void DirReadJobQueue::killAll( DirInfo * subtree, DirReadJob * exceptJob )
 {
     if ( ! subtree )
 	return;
 
+    if ( subtree->tree() )
+	subtree->tree()->updateSubtreeLabels( _queue.size() + _blocked.size() );
+
     QMutableListIterator<DirReadJob *> it( _queue );
     int count = 0;
 
@@ -832,8 +2389,27 @@ void DirReadJobQueue::killAll( DirInfo * subtree, DirReadJob * exceptJob )
 
 void DirReadJobQueue::timeSlicedRead()
 {
-    if ( ! _queue.isEmpty() )
-	_queue.first()->read();
+    _timeSlice.start();
+
+    while ( ! _queue.isEmpty() )
+    {
+	DirReadJob * job = _queue.first();
+
+	{
+	    READ_TRACE_SCOPE( "read job", job->dir() ? job->dir()->url() : QString() );
+	    job->read();
+	    // The job might be deleted now
+	}
+
+	if ( timeSliceUsedUp() )
+	    break;
+    }
+}
+
+
+bool DirReadJobQueue::timeSliceUsedUp() const
+{
+    return _timeSlice.isValid() && _timeSlice.elapsed() >= READ_TIME_SLICE_MILLISEC;
 }
 
 
@@ -843,8 +2419,14 @@ void DirReadJobQueue::jobFinishedNotify( DirReadJob *job )
     {
 	// Get rid of the old (finished) job.
 
+	bool cacheJob = dynamic_cast<CacheReadJob *>( job );
+
 	_queue.removeOne( job );
 	delete job;
+	READ_TRACE_COUNTER( "queued jobs", _queue.size() );
+
+	if ( cacheJob )	// Its pipeline is free now
+	    readAheadCaches();
     }
 
     // The timer will start a new job when it fires.
@@ -860,6 +2442,27 @@ void DirReadJobQueue::jobFinishedNotify( DirReadJob *job )
 }
 
 
+void DirReadJobQueue::readAheadCaches()
+{
+    int readingAhead = 0;
+
+    foreach ( DirReadJob * job, _queue )
+    {
+	CacheReadJob * cacheJob = dynamic_cast<CacheReadJob *>( job );
+	CacheReader  * reader	= cacheJob ? cacheJob->reader() : 0;
+
+	if ( ! reader )
+	    continue;
+
+	if ( ! reader->isReadingAhead() )
+	    reader->readAhead();	// does nothing e.g. for binary caches
+
+	if ( reader->isReadingAhead() && ++readingAhead >= MAX_CACHE_READ_AHEAD )
+	    break;
+    }
+}
+
+
 void DirReadJobQueue::deletingChildNotify( FileInfo * child )
 {
     if ( child && child->isDirInfo() )
@@ -872,15 +2475,33 @@ void DirReadJobQueue::deletingChildNotify( FileInfo * child )
 
 void DirReadJobQueue::addBlocked( DirReadJob * job )
 {
+    READ_TRACE_INSTANT( "block", job->dir() ? job->dir()->url() : QString() );
+    job->setSuspended( true );
     _blocked.append( job );
 }
 
 
 void DirReadJobQueue::unblock( DirReadJob * job )
 {
+    READ_TRACE_INSTANT( "unblock", job->dir() ? job->dir()->url() : QString() );
+    job->setSuspended( false );
     _blocked.removeAll( job );
     enqueue( job );
 
     if ( _blocked.isEmpty() )
 	logDebug() << "No more jobs waiting for external processes" << endl;
 }
+
+
+void DirReadJobQueue::suspend( DirReadJob * job )
+{
+    _queue.removeOne( job );
+    addBlocked( job );
+    READ_TRACE_COUNTER( "queued jobs", _queue.size() );
+
+    // Don't spin the timer while all jobs are waiting; unblock() starts
+    // it again.
+
+    if ( _queue.isEmpty() )
+	_timer.stop();
+}
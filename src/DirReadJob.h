@@ -13,6 +13,8 @@
 
 #include <dirent.h>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QProcess>
 
 #include "FileInfo.h"
 #include "Logger.h"
@@ -25,7 +27,51 @@ namespace QDirStat
     class DirTree;
     class CacheReader;
     class DirReadJobQueue;
+    class DirReadStats;
+    class ReadThrottle;
     class MountPoint;
+    class BulkInodeTable;
+
+
+    /**
+     * One entry of a local directory as obtained by
+     * LocalDirReadJob::readEntries(): The entry name and the result of the
+     * fstatat() call for it.
+     **/
+    struct LocalDirEntry
+    {
+	QString	    name;
+	struct stat statInfo;
+	int	    statErrno;	// 0 if fstatat() was successful
+    };
+
+    typedef QList<LocalDirEntry> LocalDirEntryList;
+
+
+    /**
+     * Where a local directory is as seen from its parent directory: Its
+     * device and i-number, those of its parent and its name in the parent.
+     * This lets LocalDirReadJob::readEntries() open it with openat()
+     * relative to the parent if that is still open in the DirFdCache.
+     **/
+    struct LocalDirLocation
+    {
+	dev_t	   device;
+	ino_t	   inode;
+	dev_t	   parentDevice;
+	ino_t	   parentInode;
+	QByteArray name;	// UTF-8
+
+	LocalDirLocation():
+	    device( 0 ),
+	    inode( 0 ),
+	    parentDevice( 0 ),
+	    parentInode( 0 )
+	    {}
+
+	bool isValid() const
+	    { return inode != 0 && parentInode != 0 && ! name.isEmpty(); }
+    };
 
 
     /**
@@ -100,6 +146,39 @@ namespace QDirStat
 	 **/
 	void setQueue( DirReadJobQueue * queue ) { _queue = queue; }
 
+	/**
+	 * Return 'true' if this job is in the part of the tree the user is
+	 * looking at, so it should be read before all other jobs.
+	 **/
+	bool isPrioritized() const { return _prioritized; }
+
+	/**
+	 * Set the priority flag of this job.
+	 **/
+	void setPrioritized( bool prioritized ) { _prioritized = prioritized; }
+
+	/**
+	 * Return 'true' if this job is suspended: It waits outside of the
+	 * job queue for something that happens without it, like the output
+	 * of a process, a worker thread, or a cache block that is parsed in
+	 * the background, so the other jobs can run in the meantime.
+	 **/
+	bool isSuspended() const { return _suspended; }
+
+	/**
+	 * Set the suspended flag. This is only for DirReadJobQueue.
+	 **/
+	void setSuspended( bool suspended ) { _suspended = suspended; }
+
+	/**
+	 * Resume this job after suspend() or after it was added to the tree
+	 * with DirTree::addBlockedJob(): Add it to the job queue again, so
+	 * its read() is called when its turn comes. This does nothing if the
+	 * job is not suspended, so it is safe to call this from the
+	 * notification of whatever the job waits for.
+	 **/
+	void resume();
+
 
     protected:
 
@@ -110,6 +189,15 @@ namespace QDirStat
 	 **/
 	virtual void startReading() {}
 
+	/**
+	 * Suspend this job until resume() is called: Take it out of the job
+	 * queue, so it does not hold up the others while it waits for
+	 * something. Call this from read() and return right after it;
+	 * read() is called again after resume() and has to continue where
+	 * it left off.
+	 **/
+	void suspend();
+
 	/**
 	 * Notification that a new child has been added.
 	 *
@@ -143,9 +231,16 @@ namespace QDirStat
 	 **/
 	bool crossingFilesystems( DirInfo * parent, DirInfo * child );
 
+	/**
+	 * Return the mount point of 'dir' if it is one or 0 if not. This looks
+	 * it up by the device number of 'dir' and only uses its path if that
+	 * filesystem is mounted more than once.
+	 **/
+	MountPoint * mountPoint( const DirInfo * dir ) const;
+
 	/**
 	 * Return the device name where 'dir' is on if it's a mount point.
-	 * This uses MountPoints which reads /proc/mounts.
+	 * This uses MountPoints which reads /proc/self/mountinfo.
 	 **/
 	QString device( const DirInfo * dir ) const;
 
@@ -161,6 +256,8 @@ namespace QDirStat
 	DirInfo *	   _dir;
 	DirReadJobQueue *  _queue;
 	bool		   _started;
+	bool		   _prioritized;
+	bool		   _suspended;
 
     };	// class DirReadJob
 
@@ -184,6 +281,7 @@ namespace QDirStat
 	void slotChildAdded   ( FileInfo *child ) { childAdded( child ); }
 	void slotDeletingChild( FileInfo *child ) { deletingChild( child ); }
 	void slotFinished()			  { finished(); }
+	void slotResume()			  { resume(); }
 
     };	// ObjDirReadJob
 
@@ -246,6 +344,106 @@ namespace QDirStat
 	void setApplyFileChildExcludeRules( bool val )
 	    { _applyFileChildExcludeRules = val; }
 
+	/**
+	 * Return the full path of the directory this job reads.
+	 **/
+	const QString & dirName() const { return _dirName; }
+
+	/**
+	 * Return the location of the directory this job reads relative to
+	 * its parent.
+	 **/
+	const LocalDirLocation & location() const { return _location; }
+
+	/**
+	 * Read all entries of directory 'dirName' and lstat() each of them.
+	 * The entries are returned in 'entries_ret' sorted by i-number.
+	 *
+	 * Return DirFinished if reading the directory was successful,
+	 * DirPermissionDenied or DirError otherwise. Failing to lstat()
+	 * individual entries is not an error from this point of view; check
+	 * LocalDirEntry::statErrno for that.
+	 *
+	 * If 'useIoUring' is 'true' and the system supports it, the entries
+	 * are stat()ed with one batch of asynchronous statx() calls through
+	 * an io_uring. This is mostly useful for network filesystems.
+	 * Otherwise, the entries of huge directories are stat()ed by several
+	 * threads at the same time.
+	 *
+	 * If 'stats' is non-null, the directory, its number of entries and
+	 * the duration of each stat() call are added to it.
+	 *
+	 * If 'throttle' is non-null, each stat() call waits for it, so this
+	 * might take much longer than the syscalls themselves.
+	 *
+	 * If 'bulkTable' is non-null and the directory is on its filesystem,
+	 * the entries that are not directories are taken from it without
+	 * any stat() call if they are found there. Those come first in
+	 * 'entries_ret', followed by the others, each part in i-number order.
+	 *
+	 * If 'location' is non-null and valid and its parent directory is
+	 * still open in the DirFdCache, the directory is opened relative to
+	 * that with openat() so the kernel does not have to resolve the
+	 * complete path again. Otherwise 'dirName' is used. If the directory
+	 * has any subdirectories, it is kept open in the DirFdCache for them.
+	 *
+	 * This function does not touch any tree or log anything, so it is
+	 * safe to call it from a non-GUI thread.
+	 **/
+	static DirReadState readEntries( const QString	       & dirName,
+					 LocalDirEntryList     & entries_ret,
+					 bool			 useIoUring = false,
+					 DirReadStats	       * stats	    = 0,
+					 ReadThrottle	       * throttle   = 0,
+					 const BulkInodeTable  * bulkTable  = 0,
+					 const LocalDirLocation * location  = 0 );
+
+	/**
+	 * Set the result of readEntries() that was obtained outside of this
+	 * job, typically by a worker thread of a DirReadWorkerPool. When this
+	 * job is scheduled, it will use those entries and not read the
+	 * directory again.
+	 *
+	 * 'workerNo' is the number of the worker thread that read the
+	 * directory; read jobs for its subdirectories will preferably be
+	 * handed to the same worker.
+	 **/
+	void setPrefetched( DirReadState		readState,
+			    const LocalDirEntryList &	entries,
+			    int				workerNo = -1 );
+
+	/**
+	 * Return the number of the worker thread that read this directory or
+	 * -1 if unknown.
+	 **/
+	int prefetchWorker() const { return _prefetchWorker; }
+
+	/**
+	 * Return 'true' if the directory content was already read outside of
+	 * this job with setPrefetched().
+	 **/
+	bool isPrefetched() const { return _prefetched; }
+
+	/**
+	 * Return the inode number of this job's directory or 0 if unknown.
+	 * A DirReadWorkerPool in inode order mode uses this to read the
+	 * directories in inode order.
+	 **/
+	ino_t inode() const { return _inode; }
+
+	/**
+	 * Set the inode number of this job's directory.
+	 **/
+	void setInode( ino_t inode ) { _inode = inode; }
+
+	/**
+	 * Read the directory or, if that was done already, continue
+	 * processing its entries.
+	 *
+	 * Reimplemented from DirReadJob.
+	 **/
+	virtual void read() Q_DECL_OVERRIDE;
+
     protected:
 
 	/**
@@ -255,6 +453,17 @@ namespace QDirStat
 	 **/
 	virtual void startReading();
 
+	/**
+	 * Process the result of reading the directory: Insert the 'entries'
+	 * into the tree if 'readState' is DirFinished, then finish reading
+	 * the directory and this job.
+	 *
+	 * This job might be deleted when this returns, so the caller must
+	 * return immediately without accessing any data members.
+	 **/
+	void processReadResult( DirReadState		  readState,
+				const LocalDirEntryList & entries );
+
 	/**
 	 * Finish reading the directory: Set the specified read state, send
 	 * signals and finalize the directory (clean up dot entries etc.).
@@ -262,10 +471,91 @@ namespace QDirStat
 	void finishReading( DirInfo * dir, DirReadState readState );
 
 	/**
-	 * Process one subdirectory entry.
+	 * Open directory 'dirName' for reading, relative to its parent if
+	 * 'location' allows that. Return the file descriptor or -1 and errno
+	 * on error.
+	 **/
+	static int openDir( const QString	   & dirName,
+			    const LocalDirLocation * location );
+
+	/**
+	 * Close directory 'dirFd' after reading 'entries' from it, or keep
+	 * it open in the DirFdCache if there are any subdirectories among
+	 * them that will be opened relative to it.
+	 **/
+	static void closeDir( int			  dirFd,
+			      const LocalDirLocation  * location,
+			      const LocalDirEntryList & entries );
+
+	/**
+	 * Linux-specific fast path for readEntries(): Read the directory with
+	 * large getdents64() buffers and get the entries' information with a
+	 * statx() call that requests only the fields that are really needed.
+	 *
+	 * 'dirFd' is the open directory; it is not closed here.
+	 *
+	 * Return 'false' if this is not supported on this system; the
+	 * portable readdir() / fstatat() method has to be used then.
+	 * Otherwise return 'true' and the result in 'readState_ret'.
+	 *
+	 * If 'statNanosec' is non-null, the duration of each stat() call is
+	 * added to it. If 'throttle' is non-null, each stat() call waits for
+	 * it. Entries that are found in 'bulkTable' (if non-null) are not
+	 * stat()ed at all.
+	 **/
+	static bool readEntriesFast( int			      dirFd,
+				     LocalDirEntryList	    & entries_ret,
+				     DirReadState	    & readState_ret,
+				     bool		      useIoUring,
+				     QVector<float>	    * statNanosec,
+				     ReadThrottle	    * throttle,
+				     const BulkInodeTable   * bulkTable );
+
+	/**
+	 * Set up 'entries' as the entries of this directory that
+	 * processPendingEntries() inserts into the tree.
+	 **/
+	virtual void processEntries( const LocalDirEntryList & entries );
+
+	/**
+	 * Create FileInfo / DirInfo nodes for the pending entries of this
+	 * directory and insert them into the tree. If
+	 * applyFileChildExcludeRules() is set, this also checks the names of
+	 * non-directory entries against the exclude rules for any file child.
+	 *
+	 * If the time slice of the job queue is used up, this returns, and the
+	 * next read() call continues with the next entry. When all entries
+	 * are processed, this finishes reading the directory and this job.
+	 *
+	 * If a cache file was found and used instead of the directory
+	 * content, this job is finished as well.
+	 *
+	 * In both cases, this job was already deleted (!), so the caller must
+	 * return immediately without accessing any data members.
+	 **/
+	void processPendingEntries();
+
+	/**
+	 * Process one subdirectory entry. 'inode' is its inode number.
 	 **/
 	void processSubDir( const QString & entryName,
-			    DirInfo	  * subDir    );
+			    DirInfo	  * subDir,
+			    ino_t	    inode = 0 );
+
+	/**
+	 * Queue a read job for a subdirectory: If the tree has a worker pool
+	 * for parallel reading, the job becomes a blocked job that is
+	 * unblocked when a worker thread has read the directory content;
+	 * otherwise it is simply added to the job queue.
+	 **/
+	void queueSubDirJob( LocalDirReadJob * job );
+
+	/**
+	 * In estimate mode, queue read jobs for a sample of the
+	 * subdirectories that processSubDir() collected and mark the others
+	 * as estimated (see SizeEstimator).
+	 **/
+	void queueSampledSubDirs();
 
 	/**
 	 * Return 'true' if 'entryName' matches an exclude rule of the
@@ -297,8 +587,9 @@ namespace QDirStat
 
 	/**
 	 * Handle an error during lstat() of a directory entry.
+	 * 'errorNo' is the 'errno' value of the failed syscall.
 	 **/
-	void handleLstatError( const QString & entryName );
+	void handleLstatError( const QString & entryName, int errorNo );
 
 	/**
 	 * Exclude the directory of this read job after it is almost completely
@@ -325,10 +616,23 @@ namespace QDirStat
 	// Data members
 	//
 
-	QString _dirName;
-	bool	_applyFileChildExcludeRules;
-	bool	_checkedForNtfs;
-	bool	_isNtfs;
+	QString			_dirName;
+	LocalDirLocation	_location;
+	bool			_applyFileChildExcludeRules;
+	bool			_matchedFileChildExcludeRule;
+	bool			_checkedForNtfs;
+	bool			_isNtfs;
+	bool			_prefetched;
+	DirReadState		_prefetchedReadState;
+	LocalDirEntryList	_prefetchedEntries;
+	int			_prefetchWorker;
+	ino_t			_inode;
+	LocalDirEntryList	_pendingEntries;
+	int			_nextEntry;
+	bool			_checkFileChildren;
+	bool			_sampleSubDirs;
+	QList<DirInfo *>	_sampleCandidates;
+	QList<ino_t>		_sampleInodes;
 
 	static bool _warnedAboutNtfsHardLinks;
 
@@ -336,6 +640,82 @@ namespace QDirStat
 
 
 
+    /**
+     * Read job for refreshing a directory that was read before without
+     * throwing its subtree away:
+     *
+     * If the mtime of the directory did not change, no entries were added,
+     * removed or renamed, so its content is kept; only its subdirectories
+     * are checked the same way. Otherwise the directory is read again, but
+     * the subtrees of the subdirectories that are still there are kept and
+     * checked recursively.
+     *
+     * A file that is modified in place does not change the mtime of its
+     * directory, so its new size is not noticed.
+     **/
+    class IncrementalDirReadJob: public LocalDirReadJob
+    {
+    public:
+
+	/**
+	 * Constructor. 'dir' needs to be a directory that can be refreshed
+	 * incrementally (see canRefresh()).
+	 **/
+	IncrementalDirReadJob( DirTree * tree, DirInfo * dir );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~IncrementalDirReadJob();
+
+	/**
+	 * Return 'true' if 'dir' can be refreshed incrementally, i.e. if it
+	 * was read completely from disk or from a cache file before.
+	 **/
+	static bool canRefresh( DirInfo * dir );
+
+
+    protected:
+
+	/**
+	 * Check the directory and either keep its content or read it
+	 * again.
+	 *
+	 * Reimplemented from LocalDirReadJob.
+	 **/
+	virtual void startReading() Q_DECL_OVERRIDE;
+
+	/**
+	 * Replace the content of the directory with 'entries', but keep the
+	 * subtrees of the subdirectories that are still there.
+	 *
+	 * Reimplemented from LocalDirReadJob.
+	 **/
+	virtual void processEntries( const LocalDirEntryList & entries ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Queue incremental read jobs for all subdirectories of the
+	 * directory that can be refreshed incrementally.
+	 **/
+	void queueIncrementalJobs();
+
+	/**
+	 * Queue an incremental read job for 'subDir'.
+	 **/
+	void queueIncrementalJob( DirInfo * subDir );
+
+	/**
+	 * Delete the content of the directory.
+	 **/
+	void clearDir();
+
+
+	DirReadState _oldReadState;
+
+    };	// IncrementalDirReadJob
+
+
+
     class CacheReadJob: public ObjDirReadJob
     {
 	Q_OBJECT
@@ -398,6 +778,205 @@ namespace QDirStat
 
 
 
+    /**
+     * Read job that reads several cache files into one tree: The toplevel
+     * directory of each cache file becomes a child of the job's directory,
+     * named after the cache file and the directory's path, e.g.
+     * "server1:/var" (see CacheReader::mergeInto()).
+     *
+     * The cache files are added to the tree one after another in the main
+     * thread, but decompressing and parsing the next few of them already
+     * runs in the background (see CacheReader::readAhead()) while the
+     * current one is added.
+     **/
+    class MergedCacheReadJob: public CacheReadJob
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor: Read the cache files 'cacheFileNames' into 'parent'
+	 * which has to be in state DirReading. When all of them are read,
+	 * 'parent' is set to DirCached and finalized.
+	 **/
+	MergedCacheReadJob( DirTree	      * tree,
+			    DirInfo	      * parent,
+			    const QStringList & cacheFileNames );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~MergedCacheReadJob();
+
+	/**
+	 * Read the next lines from the current cache file.
+	 *
+	 * Reimplemented from CacheReadJob.
+	 **/
+	virtual void read() Q_DECL_OVERRIDE;
+
+	/**
+	 * Return the label for the toplevel directory of 'cacheFileName' in
+	 * a merged tree: The file name without directory and without
+	 * ".cache", ".gz", ".zst" or ".bin", or the name of the directory
+	 * of the file for the default cache file name.
+	 **/
+	static QString mergeLabel( const QString & cacheFileName );
+
+
+    protected:
+
+	/**
+	 * Open the next cache files and start reading them in the
+	 * background until there are MAX_MERGE_READ_AHEAD of them.
+	 **/
+	void openReaders();
+
+
+	QStringList	     _pendingFiles;	// not opened yet
+	QStringList	     _pendingLabels;
+	QList<CacheReader *> _readers;		// reading ahead
+	int		     _errorCount;
+
+    };	// class MergedCacheReadJob
+
+
+
+    /**
+     * Read job that builds the tree from a file listing that was made
+     * without QDirStat: The output of "find", optionally with
+     * "-printf", or an mlocate or plocate database (see
+     * ListingReadPipeline). The listing is parsed by several threads while
+     * the items are added to the tree like those of a cache file, and the
+     * directories end up in state DirCached.
+     **/
+    class ListingReadJob: public CacheReadJob
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor: Read listing 'fileName' into the tree. The content
+	 * of the listing will replace all current tree items.
+	 **/
+	ListingReadJob( DirTree * tree, const QString & fileName );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~ListingReadJob();
+
+	/**
+	 * Return 'true' if 'fileName' is a listing that this job can
+	 * read rather than a cache file.
+	 **/
+	static bool isListing( const QString & fileName );
+
+    };	// class ListingReadJob
+
+
+
+
+    /**
+     * Read job that scans a directory on a remote host: It starts
+     * qdirstat-cache-writer over ssh on that host and adds the cache data
+     * to the tree while they arrive (see CacheStreamWriter), so the tree is
+     * read with the speed of a local scan on the server.
+     *
+     * This job stays in the blocked jobs of the queue while the remote
+     * process is running and adds the data directly when they arrive; it is
+     * only scheduled to be finished when the process is finished.
+     *
+     * ssh is started in batch mode, so authentication has to work without
+     * a password prompt, e.g. with an ssh agent.
+     *
+     * Without a host, this gets a snapshot of a tree that a local
+     * qdirstat-daemon keeps up to date ("daemon:/some/path"), which takes
+     * only as long as transferring it.
+     **/
+    class RemoteReadJob: public CacheReadJob
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor: Start reading directory 'path' on host 'host'.
+	 * 'host' may include a user name like "user@host". If 'host' is
+	 * empty, get 'path' from the local qdirstat-daemon instead.
+	 *
+	 * If 'dir' is specified, it is the directory 'path' which is already
+	 * in the tree; the remote data are read into it (see
+	 * ScanCoordinator). Otherwise the tree has to be empty.
+	 *
+	 * Add this job with DirTree::addBlockedJob().
+	 **/
+	RemoteReadJob( DirTree	     * tree,
+		       const QString & host,
+		       const QString & path,
+		       DirInfo	     * dir = 0 );
+
+	/**
+	 * Destructor. This kills the remote process if it is still
+	 * running.
+	 **/
+	virtual ~RemoteReadJob();
+
+	/**
+	 * Return 'true' if 'url' is a remote URL like
+	 * "ssh://user@host/some/path" or a daemon URL like
+	 * "daemon:/some/path".
+	 **/
+	static bool isRemoteUrl( const QString & url );
+
+	/**
+	 * Split remote URL 'url' into its host (including the user name, if
+	 * any) and its absolute path. The host of a daemon URL is empty.
+	 * Return 'false' if it isn't a valid remote URL.
+	 **/
+	static bool splitRemoteUrl( const QString & url,
+				    QString	  & host_ret,
+				    QString	  & path_ret );
+
+
+    protected slots:
+
+	/**
+	 * Add the data that arrived from the remote process to the tree.
+	 **/
+	void readRemoteData();
+
+	/**
+	 * Notification that the remote process is finished.
+	 **/
+	void processFinished( int exitCode, QProcess::ExitStatus exitStatus );
+
+	/**
+	 * Notification that the remote process could not be started or
+	 * crashed.
+	 **/
+	void processError( QProcess::ProcessError error );
+
+
+    protected:
+
+	/**
+	 * Log the error output of the remote process and let the queue
+	 * finish this job.
+	 **/
+	void finishRemote();
+
+
+	QProcess * _process;
+	QString	   _url;
+	bool	   _remoteFinished;
+
+    };	// class RemoteReadJob
+
+
+
     /**
      * Queue for read jobs
      *
@@ -420,8 +999,10 @@ namespace QDirStat
 	virtual ~DirReadJobQueue();
 
 	/**
-	 * Add a job to the end of the queue. Begin time-sliced reading if not
-	 * in progress yet.
+	 * Add a job to the end of the queue or, if its directory is in the
+	 * prioritized subtree of the tree, after the other prioritized jobs at
+	 * the start of the queue. Begin time-sliced reading if not in progress
+	 * yet.
 	 **/
 	void enqueue( DirReadJob * job );
 
@@ -445,6 +1026,11 @@ namespace QDirStat
 	 **/
 	bool isEmpty() const { return _queue.isEmpty() && _blocked.isEmpty(); }
 
+	/**
+	 * Count the number of blocked jobs.
+	 **/
+	int blockedCount() const { return _blocked.count(); }
+
 	/**
 	 * Add a job to the list of blocked jobs: Jobs that are not yet ready
 	 * yet, e.g. because they are waiting for results from an external
@@ -459,6 +1045,12 @@ namespace QDirStat
 	 **/
 	void unblock( DirReadJob * job );
 
+	/**
+	 * Move 'job' from the queue to the blocked jobs (see
+	 * DirReadJob::suspend()).
+	 **/
+	void suspend( DirReadJob * job );
+
 	/**
 	 * Clear the queue: Remove all pending jobs from the queue and destroy
 	 * them.
@@ -470,6 +1062,14 @@ namespace QDirStat
 	 **/
 	void abort();
 
+	/**
+	 * Move all jobs for 'subtree' to the start of the queue, keeping
+	 * their order, and mark them as prioritized. Jobs that were
+	 * prioritized for another subtree are no longer prioritized.
+	 * 'subtree' may be 0 to remove all priorities.
+	 **/
+	void prioritize( DirInfo * subtree );
+
 	/**
 	 * Delete all jobs for a subtree except 'exceptJob'.
 	 **/
@@ -482,6 +1082,21 @@ namespace QDirStat
 	 **/
 	void jobFinishedNotify( DirReadJob *job );
 
+	/**
+	 * Return 'true' if the current time slice is used up, so a job that
+	 * can be interrupted should return and continue in the next one.
+	 **/
+	bool timeSliceUsedUp() const;
+
+	/**
+	 * Start decompressing and parsing the cache files of the first
+	 * MAX_CACHE_READ_AHEAD cache read jobs in the queue in the background
+	 * (see CacheReader::readAhead()), so they are only added to the tree
+	 * when their turn comes. This is called when a cache read job is
+	 * added or finished.
+	 **/
+	void readAheadCaches();
+
 
     signals:
 
@@ -513,9 +1128,9 @@ namespace QDirStat
 
 	/**
 	 * Time-sliced work procedure to be performed while the application is
-	 * in the main loop: Read some directory entries, but relinquish
-	 * control back to the application so it can maintain some
-	 * responsiveness. This method uses a timer of minimal duration to
+	 * in the main loop: Run jobs until the time slice is used up, but
+	 * then relinquish control back to the application so it can maintain
+	 * some responsiveness. This method uses a timer of minimal duration to
 	 * activate itself as soon as there are no more user events to
 	 * process. Call this only once directly after inserting a read job
 	 * into the job queue.
@@ -528,6 +1143,7 @@ namespace QDirStat
 	QList<DirReadJob *>  _queue;
 	QList<DirReadJob *>  _blocked;
 	QTimer		     _timer;
+	QElapsedTimer	     _timeSlice;
     };
 
 
@@ -0,0 +1,196 @@
+/*
+ *   File name: DirReadStats.cpp
+ *   Summary:	Performance counters for reading directory trees
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <unistd.h>	// sysconf()
+
+#include <QMutexLocker>
+#include <QFile>
+
+#include "DirReadStats.h"
+#include "NodeAllocator.h"
+#include "FormatUtil.h"
+
+
+using namespace QDirStat;
+
+
+DirReadStats::DirReadStats():
+    _elapsed( 0 ),
+    _running( false ),
+    _dirs( 0 ),
+    _entries( 0 ),
+    _peakQueued( 0 ),
+    _peakBlocked( 0 )
+{
+    // NOP
+}
+
+
+void DirReadStats::start()
+{
+    QMutexLocker locker( &_mutex );
+
+    _timer.start();
+    _elapsed	 = 0;
+    _running	 = true;
+    _dirs	 = 0;
+    _entries	 = 0;
+    _peakQueued	 = 0;
+    _peakBlocked = 0;
+    _statLatency.clear();
+}
+
+
+void DirReadStats::stop()
+{
+    QMutexLocker locker( &_mutex );
+
+    if ( _running )
+    {
+	_elapsed = _timer.elapsed();
+	_running = false;
+    }
+}
+
+
+void DirReadStats::addDir( int entries, const QVector<float> & statNanosec )
+{
+    QMutexLocker locker( &_mutex );
+
+    ++_dirs;
+    _entries += entries;
+
+    for ( int i = 0; i < statNanosec.size(); ++i )
+	_statLatency.add( statNanosec.at( i ) );
+}
+
+
+void DirReadStats::updateQueueDepth( int queued, int blocked )
+{
+    _peakQueued	 = qMax( _peakQueued,  queued  );
+    _peakBlocked = qMax( _peakBlocked, blocked );
+}
+
+
+qint64 DirReadStats::dirs() const
+{
+    QMutexLocker locker( &_mutex );
+
+    return _dirs;
+}
+
+
+qint64 DirReadStats::entries() const
+{
+    QMutexLocker locker( &_mutex );
+
+    return _entries;
+}
+
+
+qint64 DirReadStats::elapsedMillisec() const
+{
+    QMutexLocker locker( &_mutex );
+
+    if ( _running )
+	return _timer.elapsed();
+
+    return _elapsed;
+}
+
+
+qreal DirReadStats::statLatency( qreal percentile ) const
+{
+    QMutexLocker locker( &_mutex );
+
+    if ( _statLatency.count() == 0 )
+	return -1.0;
+
+    return _statLatency.valueAt( percentile / 100.0 * ( _statLatency.count() - 1 ) );
+}
+
+
+qreal DirReadStats::maxStatLatency() const
+{
+    QMutexLocker locker( &_mutex );
+
+    if ( _statLatency.count() == 0 )
+	return -1.0;
+
+    return _statLatency.max();
+}
+
+
+QString DirReadStats::summary() const
+{
+    qint64 millisec = elapsedMillisec();
+    qint64 dirCount = dirs();
+    qint64 entryCount = entries();
+    qreal  sec = millisec / 1000.0;
+
+    QString text = QString( "Read %1 dirs with %2 entries in %3" )
+	.arg( dirCount ).arg( entryCount ).arg( formatMillisec( millisec ) );
+
+    if ( sec > 0.0 )
+    {
+	text += QString( " (%1 dirs/s, %2 entries/s)" )
+	    .arg( qRound64( dirCount / sec ) ).arg( qRound64( entryCount / sec ) );
+    }
+
+    if ( statLatency( 50 ) >= 0.0 )
+    {
+	text += QString( "; stat() latency p50 %1 p90 %2 p99 %3 max %4" )
+	    .arg( formatLatency( statLatency( 50 ) ) )
+	    .arg( formatLatency( statLatency( 90 ) ) )
+	    .arg( formatLatency( statLatency( 99 ) ) )
+	    .arg( formatLatency( maxStatLatency()  ) );
+    }
+
+    text += QString( "; peak queue %1 jobs, %2 blocked" ).arg( _peakQueued ).arg( _peakBlocked );
+    text += QString( "; tree nodes %1" ).arg( formatSize( NodeAllocator::allocatedBytes() ) );
+
+    qint64 rss = residentBytes();
+
+    if ( rss >= 0 )
+	text += QString( ", resident %1" ).arg( formatSize( rss ) );
+
+    return text;
+}
+
+
+qint64 DirReadStats::residentBytes()
+{
+    // The second field of /proc/self/statm is the resident set size in pages
+
+    QFile file( "/proc/self/statm" );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+	return -1;
+
+    QList<QByteArray> fields = file.readAll().split( ' ' );
+    bool ok = fields.size() > 1;
+    qint64 pages = ok ? fields.at( 1 ).toLongLong( &ok ) : 0;
+
+    return ok ? pages * sysconf( _SC_PAGESIZE ) : -1;
+}
+
+
+QString DirReadStats::formatLatency( qreal nanosec )
+{
+    if ( nanosec < 0.0 )
+	return "--";
+
+    if ( nanosec < 1000.0 )
+	return QString( "%1 ns" ).arg( qRound( nanosec ) );
+
+    if ( nanosec < 1000000.0 )
+	return QString( "%1 %2s" ).arg( nanosec / 1000.0, 0, 'f', 1 ).arg( QChar( 0xB5 ) );
+
+    return QString( "%1 ms" ).arg( nanosec / 1000000.0, 0, 'f', 1 );
+}
@@ -0,0 +1,138 @@
+/*
+ *   File name: DirReadStats.h
+ *   Summary:	Performance counters for reading directory trees
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DirReadStats_h
+#define DirReadStats_h
+
+
+#include <QMutex>
+#include <QVector>
+#include <QElapsedTimer>
+
+#include "QuantileSketch.h"
+
+
+namespace QDirStat
+{
+    /**
+     * Performance counters for reading a directory tree: The number of
+     * directories and entries read, the latency of the stat() calls for the
+     * entries, and the peak depth of the read job queue.
+     *
+     * The read worker threads add their results with addDir(), so that is
+     * thread-safe; everything else is only called from the GUI thread.
+     * Reading the counters while the tree is being read is also safe.
+     **/
+    class DirReadStats
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	DirReadStats();
+
+	/**
+	 * Clear all counters and start the clock.
+	 **/
+	void start();
+
+	/**
+	 * Stop the clock.
+	 **/
+	void stop();
+
+	/**
+	 * Return 'true' if start() was called, but not stop() yet.
+	 **/
+	bool isRunning() const { return _running; }
+
+	/**
+	 * Add the results of reading one directory with 'entries' entries.
+	 * 'statNanosec' contains the duration of each stat() call.
+	 *
+	 * This may be called from any thread.
+	 **/
+	void addDir( int entries, const QVector<float> & statNanosec );
+
+	/**
+	 * Notification about the current depth of the read job queue:
+	 * 'queued' jobs including 'blocked' ones that are waiting for
+	 * something else.
+	 **/
+	void updateQueueDepth( int queued, int blocked );
+
+	/**
+	 * Return the number of directories read so far.
+	 **/
+	qint64 dirs() const;
+
+	/**
+	 * Return the number of directory entries read so far.
+	 **/
+	qint64 entries() const;
+
+	/**
+	 * Return the time since start() until now or until stop().
+	 **/
+	qint64 elapsedMillisec() const;
+
+	/**
+	 * Return the stat() latency in nanoseconds at 'percentile' (0..100)
+	 * or -1 if there are no stat() calls yet.
+	 **/
+	qreal statLatency( qreal percentile ) const;
+
+	/**
+	 * Return the longest stat() latency in nanoseconds or -1 if there
+	 * are no stat() calls yet.
+	 **/
+	qreal maxStatLatency() const;
+
+	/**
+	 * Return the peak number of queued and blocked read jobs.
+	 **/
+	int peakQueued()  const { return _peakQueued;  }
+	int peakBlocked() const { return _peakBlocked; }
+
+	/**
+	 * Return a one-line summary of all counters for the log.
+	 **/
+	QString summary() const;
+
+	/**
+	 * Return the resident memory of this process in bytes or -1 if it
+	 * can't be obtained.
+	 **/
+	static qint64 residentBytes();
+
+	/**
+	 * Format a latency in nanoseconds in a human readable way.
+	 **/
+	static QString formatLatency( qreal nanosec );
+
+
+    protected:
+
+	mutable QMutex	_mutex;
+	QElapsedTimer	_timer;
+	qint64		_elapsed;	// millisec; valid after stop()
+	bool		_running;
+	qint64		_dirs;
+	qint64		_entries;
+	QuantileSketch	_statLatency;	// nanosec
+	int		_peakQueued;
+	int		_peakBlocked;
+
+    };	// class DirReadStats
+
+}	// namespace QDirStat
+
+
+#endif // ifndef DirReadStats_h
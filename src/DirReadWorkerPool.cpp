@@ -0,0 +1,710 @@
+/*
+ *   File name: DirReadWorkerPool.cpp
+ *   Summary:	Worker threads for parallel directory reading
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QMutexLocker>
+#include <QMetaObject>
+#include <QSet>
+
+#include "DirReadWorkerPool.h"
+#include "DirTree.h"
+#include "IoUring.h"
+#include "ReadTrace.h"
+#include "SysUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+DirReadWorker::DirReadWorker( DirReadScheduler * scheduler, int workerNo ):
+    QThread(),
+    _scheduler( scheduler ),
+    _workerNo( workerNo )
+{
+
+}
+
+
+void DirReadWorker::run()
+{
+    DirReadTask		task;
+    DirReadWorkerPool * pool = 0;
+    bool idleIoPriority	     = false;
+    bool ioPrioritySet	     = false;
+    int	 topologyGeneration  = 0;
+
+    while ( _scheduler->nextTask( _workerNo, task, pool ) )
+    {
+	// Move to the CPUs of this worker's NUMA node before reading, so the
+	// memory for the result is allocated there
+
+	int generation = _scheduler->topologyGeneration();
+
+	if ( generation != topologyGeneration )
+	{
+	    SysUtil::setThreadCpus( _scheduler->workerCpus( _workerNo ) );
+	    topologyGeneration = generation;
+	}
+
+	// This thread serves the pools of all trees, and only some of them
+	// might want the idle I/O priority: Switch whenever that changes.
+
+	if ( ! ioPrioritySet || task.idleIoPriority != idleIoPriority )
+	{
+	    SysUtil::setIdleIoPriority( task.idleIoPriority );
+	    idleIoPriority = task.idleIoPriority;
+	    ioPrioritySet  = true;
+	}
+
+	DirReadResult result;
+	result.jobId	 = task.jobId;
+	result.workerNo	 = task.lane;
+	result.readState = LocalDirReadJob::readEntries( task.dirName,
+							 result.entries,
+							 task.useIoUring,
+							 pool->readStats(),
+							 pool->readThrottle(),
+							 task.bulkTable.data(),
+							 &task.location );
+
+	pool->taskFinished( result );
+    }
+}
+
+
+
+
+DirReadScheduler::DirReadScheduler():
+    _topology( TopologyIgnore ),
+    _localNode( -1 ),
+    _topologyGeneration( 0 ),
+    _nextPool( 0 ),
+    _spreadNodes( 0 ),
+    _shutdown( false )
+{
+
+}
+
+
+DirReadScheduler::~DirReadScheduler()
+{
+    stopWorkers();
+}
+
+
+DirReadScheduler * DirReadScheduler::instance()
+{
+    static DirReadScheduler scheduler;
+
+    return &scheduler;
+}
+
+
+void DirReadScheduler::addPool( DirReadWorkerPool * pool )
+{
+    QMutexLocker locker( &_mutex );
+    _pools << pool;
+}
+
+
+void DirReadScheduler::removePool( DirReadWorkerPool * pool )
+{
+    bool lastPool = false;
+
+    {
+	QMutexLocker locker( &_mutex );
+	_pools.removeAll( pool );
+
+	// The workers must be done with the pool before it can be deleted
+
+	while ( pool->runningCount() > 0 )
+	    _taskDone.wait( &_mutex );
+
+	lastPool = _pools.isEmpty();
+    }
+
+    if ( lastPool )
+	stopWorkers();
+}
+
+
+void DirReadScheduler::updateThreadCount()
+{
+    int threadCount = 0;
+
+    {
+	QMutexLocker locker( &_mutex );
+
+	foreach ( DirReadWorkerPool * pool, _pools )
+	    threadCount = qMax( threadCount, pool->threadCount() );
+    }
+
+    if ( threadCount <= _workers.size() )
+	return;
+
+    logDebug() << "Starting " << threadCount - _workers.size()
+	       << " more threads for reading directories" << endl;
+
+    while ( _workers.size() < threadCount )
+    {
+	DirReadWorker * worker = new DirReadWorker( this, _workers.size() );
+	CHECK_NEW( worker );
+	_workers << worker;
+	worker->start();
+    }
+}
+
+
+void DirReadScheduler::stopWorkers()
+{
+    if ( _workers.isEmpty() )
+	return;
+
+    {
+	QMutexLocker locker( &_mutex );
+	_shutdown = true;
+	_workAvailable.wakeAll();
+    }
+
+    foreach ( DirReadWorker * worker, _workers )
+	worker->wait();
+
+    qDeleteAll( _workers );
+    _workers.clear();
+
+    QMutexLocker locker( &_mutex );
+    _shutdown = false;
+}
+
+
+bool DirReadScheduler::nextTask( int		      workerNo,
+				 DirReadTask &	      task_ret,
+				 DirReadWorkerPool *& pool_ret )
+{
+    QMutexLocker locker( &_mutex );
+
+    while ( ! _shutdown )
+    {
+	for ( int i = 0; i < _pools.size(); ++i )
+	{
+	    int poolNo = ( _nextPool + i ) % _pools.size();
+
+	    if ( _pools.at( poolNo )->takeTask( task_ret, nodeOf( workerNo ) ) )
+	    {
+		pool_ret  = _pools.at( poolNo );
+		_nextPool = ( poolNo + 1 ) % _pools.size();
+
+		return true;
+	    }
+	}
+
+	_workAvailable.wait( &_mutex );
+    }
+
+    return false;
+}
+
+
+void DirReadScheduler::setTopology( ReadTopology topology )
+{
+    if ( topology == _topology )
+	return;
+
+    QMutexLocker locker( &_mutex );
+
+    if ( _processCpus.isEmpty() )
+    {
+	// Only the CPUs that this process may use at all (taskset, cgroups)
+
+	_processCpus = SysUtil::threadCpus();
+
+	foreach ( QList<int> cpus, SysUtil::numaNodeCpus() )
+	{
+	    QMutableListIterator<int> it( cpus );
+
+	    while ( it.hasNext() )
+	    {
+		if ( ! _processCpus.contains( it.next() ) )
+		    it.remove();
+	    }
+
+	    if ( ! cpus.isEmpty() )
+		_nodeCpus << cpus;
+	}
+    }
+
+    _topology	 = topology;
+    _localNode	 = topology == TopologyLocal ? SysUtil::currentNumaNode( _nodeCpus ) : -1;
+    _spreadNodes = topology == TopologySpread && _nodeCpus.size() > 1 ? _nodeCpus.size() : 0;
+
+    if ( _nodeCpus.size() > 1 )
+    {
+	logInfo() << "Placing the read threads on " << _nodeCpus.size() << " NUMA nodes: "
+		  << topologyMapping().value( topology ) << endl;
+    }
+    else
+    {
+	logInfo() << "Not a NUMA machine; not placing the read threads" << endl;
+    }
+
+    _topologyGeneration.fetchAndAddOrdered( 1 );
+}
+
+
+QList<int> DirReadScheduler::workerCpus( int workerNo )
+{
+    QMutexLocker locker( &_mutex );
+
+    if ( _spreadNodes > 1 )
+	return _nodeCpus.at( nodeOf( workerNo ) );
+
+    if ( _localNode >= 0 && _nodeCpus.size() > 1 )
+	return _nodeCpus.at( _localNode );
+
+    return _processCpus;
+}
+
+
+QMap<int, QString> DirReadScheduler::topologyMapping()
+{
+    QMap<int, QString> mapping;
+
+    mapping[ TopologyIgnore ] = "Ignore";
+    mapping[ TopologySpread ] = "Spread";
+    mapping[ TopologyLocal  ] = "Local";
+
+    return mapping;
+}
+
+
+void DirReadScheduler::taskFinished()
+{
+    // A lane of that pool is free again, so one of its tasks might be able
+    // to run now
+
+    _workAvailable.wakeOne();
+    _taskDone.wakeAll();
+}
+
+
+
+
+DirReadWorkerPool::DirReadWorkerPool( DirTree * tree, int threadCount ):
+    QObject(),
+    _tree( tree ),
+    _scheduler( DirReadScheduler::instance() ),
+    _threadCount( 0 ),
+    _nextJobId( 1 ),
+    _nextWorker( 0 ),
+    _useIoUring( false ),
+    _inodeOrder( false ),
+    _idleIoPriority( false ),
+    _running( 0 ),
+    _sweepInode( 0 ),
+    _deliveryPending( false ),
+    _stealCount( 0 ),
+    _remoteStealCount( 0 )
+{
+    _scheduler->addPool( this );
+    setThreadCount( threadCount );
+}
+
+
+DirReadWorkerPool::~DirReadWorkerPool()
+{
+    clear();
+    _scheduler->removePool( this );
+
+    if ( _stealCount > 0 )
+    {
+	logDebug() << _stealCount << " tasks stolen by idle workers, "
+		   << _remoteStealCount << " of them from another NUMA node" << endl;
+    }
+}
+
+
+void DirReadWorkerPool::setThreadCount( int threadCount )
+{
+    if ( threadCount < 1 )
+	threadCount = 1;
+
+    if ( threadCount == _threadCount )
+	return;
+
+    logInfo() << "Using " << threadCount << " threads for reading directories" << endl;
+
+    {
+	// Redistribute any pending tasks among the new task lists. Tasks
+	// that are running in a lane that is gone just finish.
+
+	QMutexLocker locker( _scheduler->mutex() );
+	QList<DirReadTask> pending;
+
+	for ( int i = 0; i < _tasks.size(); ++i )
+	    pending << _tasks[ i ];
+
+	_tasks.clear();
+	_tasks.resize( threadCount );
+	_busyLanes.resize( threadCount );
+
+	for ( int i = 0; i < pending.size(); ++i )
+	    _tasks[ i % threadCount ] << pending.at( i );
+
+	_threadCount = threadCount;
+	_nextWorker  = 0;
+    }
+
+    _scheduler->updateThreadCount();
+}
+
+
+DirReadStats * DirReadWorkerPool::readStats() const
+{
+    return _tree->readStats();
+}
+
+
+ReadThrottle * DirReadWorkerPool::readThrottle() const
+{
+    return _tree->readThrottle();
+}
+
+
+void DirReadWorkerPool::setUseIoUring( bool use )
+{
+#if HAVE_IO_URING
+    if ( use && ! IoUring::isSupported() )
+    {
+	logInfo() << "No io_uring with statx() support in this kernel" << endl;
+	use = false;
+    }
+#else
+    use = false;
+#endif
+
+    if ( use != _useIoUring )
+	logInfo() << "Using io_uring for stat() calls: " << use << endl;
+
+    _useIoUring = use;
+}
+
+
+void DirReadWorkerPool::setInodeOrder( bool inodeOrder )
+{
+    if ( inodeOrder == _inodeOrder )
+	return;
+
+    logInfo() << "Reading directories in inode order: " << inodeOrder << endl;
+
+    QMutexLocker locker( _scheduler->mutex() );
+    _inodeOrder = inodeOrder;
+
+    if ( inodeOrder )
+    {
+	for ( int i = 0; i < _tasks.size(); ++i )
+	{
+	    foreach ( const DirReadTask & task, _tasks[ i ] )
+		_inodeTasks.insert( task.inode, task );
+
+	    _tasks[ i ].clear();
+	}
+
+	_sweepInode = 0;
+    }
+    else
+    {
+	int i = 0;
+
+	foreach ( const DirReadTask & task, _inodeTasks )
+	    _tasks[ i++ % _tasks.size() ] << task;
+
+	_inodeTasks.clear();
+    }
+}
+
+
+void DirReadWorkerPool::submit( LocalDirReadJob * job, int preferredWorker )
+{
+    CHECK_PTR( job );
+
+    quint64 jobId = _nextJobId++;
+    _pendingJobs.insert( jobId, job );
+    _jobIds.insert( job, jobId );
+
+    DirReadTask task;
+    task.jobId		= jobId;
+    task.dirName	= job->dirName();
+    task.location	= job->location();
+    task.useIoUring	= _useIoUring;
+    task.idleIoPriority = _idleIoPriority;
+    task.inode		= job->inode();
+    task.bulkTable	= _tree->bulkInodeTable();
+
+    // Evaluate this here in the GUI thread: The workers must not touch the
+    // tree.
+
+    bool urgent = job->dir() && _tree->isPrioritized( job->dir() );
+
+    QMutexLocker locker( _scheduler->mutex() );
+
+    if ( urgent )
+    {
+	_urgentTasks << task;
+	_scheduler->wakeOne();
+
+	return;
+    }
+
+    if ( _inodeOrder )
+    {
+	_inodeTasks.insert( task.inode, task );
+	_scheduler->wakeOne();
+
+	return;
+    }
+
+    int workerNo = preferredWorker;
+
+    if ( workerNo < 0 || workerNo >= _tasks.size() )
+    {
+	workerNo    = _nextWorker;
+	_nextWorker = ( _nextWorker + 1 ) % _tasks.size();
+    }
+
+    _tasks[ workerNo ] << task;
+
+    // If that lane is busy, any idle lane that gets a worker will steal
+    // tasks
+
+    _scheduler->wakeOne();
+}
+
+
+bool DirReadWorkerPool::takeTask( DirReadTask & task_ret, int node )
+{
+    if ( _running >= _threadCount )
+	return false;
+
+    // An idle lane, preferably one on the worker's node and then one with
+    // tasks of its own
+
+    int lane	  = -1;
+    int bestScore = -1;
+
+    for ( int i = 0; i < _busyLanes.size() && bestScore < 3; ++i )
+    {
+	if ( ! _busyLanes.at( i ) )
+	{
+	    int score = 0;
+
+	    if ( node < 0 || _scheduler->nodeOf( i ) == node )
+		score += 2;
+
+	    if ( ! _tasks.at( i ).isEmpty() )
+		score += 1;
+
+	    if ( score > bestScore )
+	    {
+		lane	  = i;
+		bestScore = score;
+	    }
+	}
+    }
+
+    if ( lane < 0 )
+	return false;
+
+    if ( ! _urgentTasks.isEmpty() )
+    {
+	task_ret = _urgentTasks.takeFirst();
+    }
+    else if ( ! _inodeTasks.isEmpty() )
+    {
+	// Elevator: The next inode after the last one in this sweep or, at
+	// the end, start the next sweep at the lowest inode
+
+	QMultiMap<ino_t, DirReadTask>::iterator it = _inodeTasks.lowerBound( _sweepInode );
+
+	if ( it == _inodeTasks.end() )
+	    it = _inodeTasks.begin();
+
+	_sweepInode = it.key();
+	task_ret    = it.value();
+	_inodeTasks.erase( it );
+    }
+    else if ( ! _tasks.at( lane ).isEmpty() )
+    {
+	// Depth-first: The newest task, i.e. a subdirectory of the directory
+	// this lane read last
+
+	task_ret = _tasks[ lane ].takeLast();
+    }
+    else
+    {
+	// The busiest lane on the same node or, if they are all empty, on
+	// any node
+
+	int laneNode = _scheduler->nodeOf( lane );
+	int victim   = -1;
+	int maxTasks = 0;
+
+	for ( int pass = 0; pass < 2 && victim < 0; ++pass )
+	{
+	    for ( int i = 0; i < _tasks.size(); ++i )
+	    {
+		if ( pass == 0 && _scheduler->nodeOf( i ) != laneNode )
+		    continue;
+
+		if ( _tasks.at( i ).size() > maxTasks )
+		{
+		    victim   = i;
+		    maxTasks = _tasks.at( i ).size();
+		}
+	    }
+	}
+
+	if ( victim < 0 )
+	    return false;
+
+	// Breadth-first: The oldest task of the busiest lane, i.e. the top
+	// of the largest subtree that is still waiting to be read
+
+	task_ret = _tasks[ victim ].takeFirst();
+	++_stealCount;
+
+	if ( _scheduler->nodeOf( victim ) != laneNode )
+	    ++_remoteStealCount;
+    }
+
+    task_ret.lane	= lane;
+    _busyLanes[ lane ]	= true;
+    ++_running;
+
+    return true;
+}
+
+
+void DirReadWorkerPool::prioritize()
+{
+    QSet<quint64> jobIds;
+
+    for ( QHash<quint64, LocalDirReadJob *>::const_iterator it = _pendingJobs.constBegin();
+	  it != _pendingJobs.constEnd();
+	  ++it )
+    {
+	if ( it.value()->dir() && _tree->isPrioritized( it.value()->dir() ) )
+	    jobIds.insert( it.key() );
+    }
+
+    if ( jobIds.isEmpty() )
+	return;
+
+    QMutexLocker locker( _scheduler->mutex() );
+
+    for ( int i = 0; i < _tasks.size(); ++i )
+    {
+	QMutableListIterator<DirReadTask> it( _tasks[ i ] );
+
+	while ( it.hasNext() )
+	{
+	    if ( jobIds.contains( it.next().jobId ) )
+	    {
+		_urgentTasks << it.value();
+		it.remove();
+	    }
+	}
+    }
+
+    QMutableMapIterator<ino_t, DirReadTask> it( _inodeTasks );
+
+    while ( it.hasNext() )
+    {
+	if ( jobIds.contains( it.next().value().jobId ) )
+	{
+	    _urgentTasks << it.value();
+	    it.remove();
+	}
+    }
+}
+
+
+void DirReadWorkerPool::cancel( LocalDirReadJob * job )
+{
+    if ( _jobIds.contains( job ) )
+    {
+	quint64 jobId = _jobIds.take( job );
+	_pendingJobs.remove( jobId );
+    }
+}
+
+
+void DirReadWorkerPool::clear()
+{
+    _pendingJobs.clear();
+    _jobIds.clear();
+
+    QMutexLocker locker( _scheduler->mutex() );
+
+    for ( int i = 0; i < _tasks.size(); ++i )
+	_tasks[ i ].clear();
+
+    _inodeTasks.clear();
+    _urgentTasks.clear();
+    _results.clear();
+}
+
+
+void DirReadWorkerPool::taskFinished( const DirReadResult & result )
+{
+    QMutexLocker locker( _scheduler->mutex() );
+    _results << result;
+
+    if ( result.workerNo < _busyLanes.size() )
+	_busyLanes[ result.workerNo ] = false;
+
+    --_running;
+    _scheduler->taskFinished();
+
+    // Deliver results in batches: Only one delivery call is pending in the
+    // GUI thread's event queue at any time, no matter how many results
+    // arrive in the meantime.
+
+    if ( ! _deliveryPending )
+    {
+	_deliveryPending = true;
+	QMetaObject::invokeMethod( this, "deliverResults", Qt::QueuedConnection );
+    }
+}
+
+
+void DirReadWorkerPool::deliverResults()
+{
+    QList<DirReadResult> results;
+
+    {
+	QMutexLocker locker( _scheduler->mutex() );
+	results.swap( _results );
+	_deliveryPending = false;
+    }
+
+    READ_TRACE_SCOPE( "deliver results", QString::number( results.size() ) );
+
+    foreach ( const DirReadResult & result, results )
+    {
+	LocalDirReadJob * job = _pendingJobs.take( result.jobId );
+
+	if ( job )  // Not cancelled in the meantime?
+	{
+	    _jobIds.remove( job );
+	    job->setPrefetched( result.readState, result.entries, result.workerNo );
+	    job->resume();
+	}
+    }
+}
@@ -0,0 +1,516 @@
+/*
+ *   File name: DirReadWorkerPool.h
+ *   Summary:	Worker threads for parallel directory reading
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DirReadWorkerPool_h
+#define DirReadWorkerPool_h
+
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QVector>
+#include <QAtomicInt>
+
+#include "DirReadJob.h"
+#include "BulkInodeTable.h"
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class DirReadStats;
+    class ReadThrottle;
+    class DirReadWorkerPool;
+    class DirReadScheduler;
+
+
+    /**
+     * How the worker threads are placed on the CPUs of a NUMA machine
+     * (several sockets, each with its own memory).
+     **/
+    enum ReadTopology
+    {
+	TopologyIgnore,		// let the kernel place them anywhere
+	TopologySpread,		// each worker on one node, round-robin
+	TopologyLocal		// all workers on the node of the main thread
+    };
+
+
+    /**
+     * One directory to be read by a worker thread.
+     **/
+    struct DirReadTask
+    {
+	quint64 jobId;
+	QString dirName;
+	LocalDirLocation location;
+	bool	useIoUring;
+	bool	idleIoPriority;
+	ino_t	inode;
+	int	lane;		// set by DirReadWorkerPool::takeTask()
+	BulkInodeTablePtr bulkTable;	// null if not read in bulk
+    };
+
+
+    /**
+     * The result of reading one directory in a worker thread.
+     **/
+    struct DirReadResult
+    {
+	quint64			jobId;
+	int			workerNo;	// the lane in the pool
+	DirReadState		readState;
+	LocalDirEntryList	entries;
+    };
+
+
+    /**
+     * Worker thread of the DirReadScheduler: Fetch the next task of any
+     * DirReadWorkerPool, read that directory with
+     * LocalDirReadJob::readEntries() and report the result back to that
+     * pool until the scheduler shuts down.
+     *
+     * This does not touch the DirTree in any way; it only does the syscalls
+     * (opendir(), readdir(), fstatat()) that make up most of the time of
+     * reading a directory on a high-latency filesystem.
+     **/
+    class DirReadWorker: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	DirReadWorker( DirReadScheduler * scheduler, int workerNo );
+
+	/**
+	 * Return the number of this worker in the scheduler.
+	 **/
+	int workerNo() const { return _workerNo; }
+
+    protected:
+
+	/**
+	 * The worker loop. This is called in the new thread.
+	 *
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+
+	DirReadScheduler * _scheduler;
+	int		   _workerNo;
+    };
+
+
+    /**
+     * The worker threads that serve all DirReadWorkerPools in the process,
+     * no matter which DirTree they belong to: With several trees in one
+     * process (a second tree for comparing, a second window), they don't
+     * each start their own set of threads that compete for the CPU and the
+     * disk.
+     *
+     * An idle worker takes the next task from the pools in round-robin
+     * order, starting after the pool that got the last task, so every pool
+     * (i.e. every tree and every filesystem within a tree) gets its fair
+     * share of the workers no matter how many tasks the others have queued.
+     * Each pool runs at most as many tasks at the same time as its thread
+     * count; there are as many workers as the biggest pool needs.
+     *
+     * The task lists of all pools are protected by the mutex of the
+     * scheduler.
+     *
+     * On a NUMA machine, the workers can be pinned to the CPUs of the
+     * nodes (see setTopology()). With TopologySpread, worker n is on node
+     * (n % nodes), and so is lane n of each pool: A worker prefers the
+     * lanes of its own node, and an idle lane steals from the lanes of its
+     * own node first, so the data of a subtree mostly stay in the caches
+     * and the memory of one node. With TopologyLocal, all workers are on
+     * the node of the main thread that builds the tree from their results.
+     *
+     * This is a singleton. It is only used from the GUI thread except for
+     * nextTask(), nodeOf(), workerCpus() and mutex().
+     **/
+    class DirReadScheduler
+    {
+    public:
+
+	/**
+	 * Return the singleton instance.
+	 **/
+	static DirReadScheduler * instance();
+
+	/**
+	 * Destructor. This waits for all worker threads to finish.
+	 **/
+	~DirReadScheduler();
+
+	/**
+	 * Add 'pool' to the pools that the workers take tasks from.
+	 **/
+	void addPool( DirReadWorkerPool * pool );
+
+	/**
+	 * Remove 'pool' and wait until its running tasks are finished.
+	 * When the last pool is removed, the worker threads are stopped.
+	 **/
+	void removePool( DirReadWorkerPool * pool );
+
+	/**
+	 * Start more worker threads if a pool needs more than there are.
+	 * Idle workers are never stopped while there is any pool.
+	 **/
+	void updateThreadCount();
+
+	/**
+	 * Return the number of worker threads.
+	 **/
+	int threadCount() const { return _workers.size(); }
+
+	/**
+	 * Return the next task of the next pool in round-robin order that
+	 * has one and that is below its thread count. Wait if there is none.
+	 *
+	 * Return 'false' if the scheduler is shutting down and the worker
+	 * should terminate.
+	 *
+	 * This is called from a worker thread.
+	 **/
+	bool nextTask( int		     workerNo,
+		       DirReadTask &	     task_ret,
+		       DirReadWorkerPool *& pool_ret );
+
+	/**
+	 * Return how the workers are placed on the NUMA nodes.
+	 **/
+	ReadTopology topology() const { return _topology; }
+
+	/**
+	 * Set how the workers are placed on the NUMA nodes. The workers move
+	 * before their next task. On a machine with only one node, this
+	 * does nothing.
+	 **/
+	void setTopology( ReadTopology topology );
+
+	/**
+	 * Return the NUMA node of worker or pool lane 'no' or -1 if the
+	 * workers are not spread over the nodes. The mutex has to be locked.
+	 **/
+	int nodeOf( int no ) const
+	    { return _spreadNodes > 1 ? no % _spreadNodes : -1; }
+
+	/**
+	 * Return the CPUs that worker 'workerNo' should run on. This is
+	 * called from that worker thread.
+	 **/
+	QList<int> workerCpus( int workerNo );
+
+	/**
+	 * Return a number that changes whenever the workers have to move to
+	 * other CPUs.
+	 **/
+	int topologyGeneration() const { return _topologyGeneration.loadAcquire(); }
+
+	/**
+	 * Return the enum mapping for ReadTopology.
+	 **/
+	static QMap<int, QString> topologyMapping();
+
+	/**
+	 * Return the mutex that protects the task lists of all pools.
+	 **/
+	QMutex * mutex() { return &_mutex; }
+
+	/**
+	 * Wake up one idle worker. The mutex has to be locked.
+	 **/
+	void wakeOne() { _workAvailable.wakeOne(); }
+
+	/**
+	 * Notification that a task was finished. The mutex has to be
+	 * locked.
+	 **/
+	void taskFinished();
+
+
+    protected:
+
+	/**
+	 * Constructor. Use instance() instead.
+	 **/
+	DirReadScheduler();
+
+	/**
+	 * Stop all worker threads and wait until they are terminated.
+	 **/
+	void stopWorkers();
+
+
+	QList<DirReadWorker *>	    _workers;
+	ReadTopology		    _topology;
+	QList<int>		    _processCpus;	// the CPUs we may use at all
+	QList<QList<int> >	    _nodeCpus;		// only those of them
+	int			    _localNode;
+	QAtomicInt		    _topologyGeneration;
+
+	// Protected by _mutex: Accessed from the worker threads
+
+	QMutex			    _mutex;
+	QWaitCondition		    _workAvailable;
+	QWaitCondition		    _taskDone;
+	QList<DirReadWorkerPool *>  _pools;
+	int			    _nextPool;
+	int			    _spreadNodes;	// 0 if not spread
+	bool			    _shutdown;
+    };
+
+
+    /**
+     * Pool of worker threads that read local directories in parallel. The
+     * threads themselves belong to the DirReadScheduler and are shared
+     * with all other pools in the process; the thread count of a pool is
+     * the number of its tasks that may run at the same time.
+     *
+     * When a LocalDirReadJob finds a subdirectory while there is a worker
+     * pool, the new read job for that subdirectory is added to the tree's
+     * job queue as a blocked job, and a task for it is submitted to this
+     * pool. When a worker thread has read the directory, the result is
+     * handed back to the GUI thread where it is stored in the read job, and
+     * the job is unblocked. The job then only has to create the FileInfo /
+     * DirInfo nodes and insert them into the tree without doing any more
+     * syscalls.
+     *
+     * This way, all tree operations still happen in the GUI thread (so no
+     * locking is needed for the tree or any of its views), but the
+     * filesystem latency of many directories is overlapped. This gives a
+     * dramatic speedup for network filesystems and for large trees on fast
+     * SSDs.
+     *
+     * Scheduling uses work stealing: Each worker (i.e. each lane of
+     * concurrently running tasks) has its own task list.
+     * Subdirectories of a directory are (preferably) added to the list of
+     * the worker that read that directory, and a worker always takes the
+     * newest task from its own list, so it proceeds depth-first in "its"
+     * subtree and keeps working on directory data that are still hot in the
+     * kernel's caches. A worker whose list is empty steals the oldest task
+     * from the worker with the most tasks, i.e. it takes over a whole
+     * subtree breadth-first. This way, a single huge subtree
+     * (node_modules, a Maildir) does not leave the other workers idle,
+     * which would happen with a plain FIFO.
+     *
+     * Tasks for directories in the subtree the user is looking at (see
+     * DirTree::prioritize()) go to a separate list that all workers empty
+     * first, oldest task first, so that subtree is finished before
+     * everything else.
+     *
+     * On a rotational disk, the seek time dominates everything else, and
+     * the seek distance depends on the order of the reads. In inode order
+     * mode (see setInodeOrder()), all non-urgent tasks go into one list
+     * sorted by the inode number of the directory, and the workers take
+     * them in one elevator sweep through that list (wrapping around at the
+     * end). On most Linux filesystems, the inode number corresponds to
+     * the position of the inode on the disk, so the disk head moves mostly
+     * in one direction.
+     *
+     * All task lists of all pools share the mutex of the scheduler: Compared
+     * to the syscalls of reading a directory, the time spent in that lock is
+     * negligible.
+     **/
+    class DirReadWorkerPool: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	DirReadWorkerPool( DirTree * tree, int threadCount );
+
+	/**
+	 * Destructor. This waits for the running tasks of this pool to
+	 * finish.
+	 **/
+	virtual ~DirReadWorkerPool();
+
+	/**
+	 * Return the number of worker threads, i.e. how many tasks of this
+	 * pool may run at the same time.
+	 **/
+	int threadCount() const { return _threadCount; }
+
+	/**
+	 * Set the number of worker threads. Pending tasks are distributed
+	 * among the new workers.
+	 **/
+	void setThreadCount( int threadCount );
+
+	/**
+	 * Submit a read job: Read its directory in a worker thread. When that
+	 * is done, the result is stored in the job with
+	 * LocalDirReadJob::setPrefetched(), and the job is unblocked in the
+	 * tree's job queue.
+	 *
+	 * 'preferredWorker' is the number of the worker that should get this
+	 * task; if this is -1, the tasks are distributed round-robin.
+	 *
+	 * The job has to be added to the tree's blocked jobs before this is
+	 * called.
+	 **/
+	void submit( LocalDirReadJob * job, int preferredWorker = -1 );
+
+	/**
+	 * Move the pending tasks for the prioritized subtree of the tree (see
+	 * DirTree::prioritize()) to the list of urgent tasks that all workers
+	 * take first.
+	 **/
+	void prioritize();
+
+	/**
+	 * Notification that a job is about to be destroyed. Any pending
+	 * result for that job will be discarded.
+	 **/
+	void cancel( LocalDirReadJob * job );
+
+	/**
+	 * Cancel all pending tasks. Tasks that are already running will
+	 * still finish, but their results will be discarded.
+	 **/
+	void clear();
+
+	/**
+	 * Return the number of submitted jobs that are not delivered yet.
+	 **/
+	int pendingCount() const { return _pendingJobs.size(); }
+
+	/**
+	 * Return the read statistics of the tree. The workers add to them.
+	 **/
+	DirReadStats * readStats() const;
+
+	/**
+	 * Return 'true' if the workers stat the directory entries with
+	 * batched asynchronous statx() calls through io_uring.
+	 **/
+	bool useIoUring() const { return _useIoUring; }
+
+	/**
+	 * Enable or disable io_uring for tasks that are submitted from now on.
+	 * This has no effect if the kernel does not support io_uring with
+	 * statx().
+	 **/
+	void setUseIoUring( bool use );
+
+	/**
+	 * Return 'true' if the tasks are taken in inode order (see
+	 * setInodeOrder()).
+	 **/
+	bool inodeOrder() const { return _inodeOrder; }
+
+	/**
+	 * Enable or disable inode order mode: Take the tasks in the order of
+	 * the inode numbers of their directories rather than depth-first per
+	 * worker. This minimizes the seeks on a rotational disk, but it does
+	 * not keep the workers in their own subtrees. Pending tasks are moved
+	 * to the new lists.
+	 **/
+	void setInodeOrder( bool inodeOrder );
+
+	/**
+	 * Return 'true' if the workers use the idle I/O scheduling class.
+	 **/
+	bool idleIoPriority() const { return _idleIoPriority; }
+
+	/**
+	 * Make the workers switch to the idle I/O scheduling class for tasks
+	 * that are submitted from now on. They don't switch back.
+	 **/
+	void setIdleIoPriority( bool idle ) { _idleIoPriority = idle; }
+
+	/**
+	 * Return the rate limit of the tree or 0 if there is none.
+	 * This is called from the worker threads.
+	 **/
+	ReadThrottle * readThrottle() const;
+
+	/**
+	 * Return the next task in 'task_ret' for an idle lane, preferably
+	 * one on NUMA node 'node' and one that has tasks of its own: The
+	 * oldest urgent task, the newest one of the lane's own task list or,
+	 * if that is empty, the oldest one of the busiest other lane on the
+	 * same node or, if there is none, on any node. In inode order mode,
+	 * the next one in inode order instead of the lane's own or stolen
+	 * tasks.
+	 *
+	 * 'node' is the node of the worker that asks or -1 for any node.
+	 *
+	 * Return 'false' if there is no task or if all lanes are busy.
+	 *
+	 * This is called from a worker thread with the scheduler's mutex
+	 * locked.
+	 **/
+	bool takeTask( DirReadTask & task_ret, int node = -1 );
+
+	/**
+	 * Return the number of running tasks. The scheduler's mutex has to
+	 * be locked.
+	 **/
+	int runningCount() const { return _running; }
+
+	/**
+	 * Report the result of a task. This is called from a worker thread.
+	 **/
+	void taskFinished( const DirReadResult & result );
+
+
+    protected slots:
+
+	/**
+	 * Deliver the results of all finished tasks to their read jobs. This
+	 * is called in the GUI thread.
+	 **/
+	void deliverResults();
+
+
+    protected:
+
+	DirTree *			   _tree;
+	DirReadScheduler *		   _scheduler;
+	int				   _threadCount;
+	QHash<quint64, LocalDirReadJob *>  _pendingJobs;
+	QHash<LocalDirReadJob *, quint64>  _jobIds;
+	quint64				   _nextJobId;
+	int				   _nextWorker;
+	bool				   _useIoUring;
+	bool				   _inodeOrder;
+	bool				   _idleIoPriority;
+
+	// Protected by the scheduler's mutex: Accessed from the worker threads
+
+	QVector<QList<DirReadTask> >	   _tasks;	// one list per lane
+	QVector<bool>			   _busyLanes;
+	int				   _running;
+	QList<DirReadTask>		   _urgentTasks;
+	QMultiMap<ino_t, DirReadTask>	   _inodeTasks;	// in inode order mode
+	ino_t				   _sweepInode;
+	QList<DirReadResult>		   _results;
+	bool				   _deliveryPending;
+	int				   _stealCount;
+	int				   _remoteStealCount;	// from another node
+
+    };	// class DirReadWorkerPool
+
+}	// namespace QDirStat
+
+
+#endif // ifndef DirReadWorkerPool_h
@@ -7,52 +7,180 @@
  */
 
 
+#include <algorithm>
+
 #include <QDir>
 #include <QFileInfo>
+#include <QThread>
 
 #include "DirTree.h"
 #include "DirTreeCache.h"
+#include "DirFdCache.h"
 #include "DirTreeFilter.h"
+#include "DirTreeFilterChain.h"
+#include "DirTreePkgFilter.h"
+#include "DirReadWorkerPool.h"
+#include "DirTreeWatcher.h"
 #include "DotEntry.h"
 #include "Attic.h"
 #include "FileInfoIterator.h"
 #include "FileInfoSet.h"
+#include "FileSpillStore.h"
 #include "ExcludeRules.h"
 #include "PkgReader.h"
 #include "MountPoints.h"
+#include "ScanCoordinator.h"
+#include "SharedCacheImage.h"
+#include "StallWatchdog.h"
 #include "FormatUtil.h"
+#include "MimeCategorizer.h"
+#include "NodeAllocator.h"
+#include "ReadTrace.h"
+#include "RuleStats.h"
+#include "SysUtil.h"
 #include "Logger.h"
 #include "Exception.h"
 
 #define VERBOSE_EXCLUDE_RULES	1
 
+// Number of entries in the cache for sharedName(); this must be a power of 2
+#define NAME_CACHE_SIZE		8192
+
+// Maximum number of children for one childrenAdded() signal
+#define CHILDREN_ADDED_BATCH_SIZE	1000
+
+// Interval for writeProgress() signals
+#define WRITE_PROGRESS_MILLISEC	250
+
+// Average number of parent chain steps of FileInfo::isInSubtree() without
+// pre-order labels; see updateSubtreeLabels()
+#define SUBTREE_CHECK_STEPS	8
+
+// Maximum number of entries in the sorted children lists of all directories
+// together; beyond that, the least recently used ones are dropped
+#define SORT_CACHE_MAX_ENTRIES	2000000
+
+// Number of directory levels below the toplevel that are checked for project
+// quotas and btrfs subvolumes; that costs an open() and an ioctl() for each
+// directory
+#define QUOTA_MAX_LEVELS	4
+
+// Interval for checking the memory budget
+#define MEMORY_BUDGET_CHECK_MILLISEC	1000
+
 using namespace QDirStat;
 
 
+namespace
+{
+    /**
+     * Thread to delete a subtree that is no longer part of any tree.
+     **/
+    class DestroyerThread: public QThread
+    {
+    public:
+
+	DestroyerThread( DirInfo * subtree ):
+	    QThread(),
+	    _subtree( subtree )
+	    {}
+
+    protected:
+
+	virtual void run() Q_DECL_OVERRIDE
+	    { delete _subtree; }
+
+	DirInfo * _subtree;
+    };
+
+}	// namespace
+
+
 DirTree::DirTree():
     QObject(),
     _excludeRules( 0 ),
+    _filterChain( 0 ),
     _beingDestroyed( false ),
     _haveClusterSize( false ),
-    _blocksPerCluster( 0 )
+    _blocksPerCluster( 0 ),
+    _readThreads( 0 ),
+    _networkReadThreads( 0 ),
+    _useIoUring( true ),
+    _inodeOrderOnRotational( true ),
+    _incrementalRefresh( false ),
+    _readWorkerPool( 0 ),
+    _watcher( 0 ),
+    _watchUpdateMillisec( 2000 ),
+    _scanCoordinator( 0 ),
+    _cacheAllDirty( true ),
+    _lazyCacheLoading( false ),
+    _shareCacheImages( false ),
+    _compactCachePaths( false ),
+    _contiguousChildren( false ),
+    _fileColumns( false ),
+    _cacheCategories( false ),
+    _cacheFileAgeSummaries( false ),
+    _categoryGeneration( -1 ),
+    _spillFiles( false ),
+    _freezeColdFiles( false ),
+    _spillStore( 0 ),
+    _spillUnderPressure( false ),
+    _useLocateIndex( true ),
+    _generation( 0 ),
+    _labeledDirs( 0 ),
+    _lastSubtreeLabelGeneration( 0 ),
+    _estimateMode( false ),
+    _quotaMode( QuotaIgnore ),
+    _idleIoPriority( false ),
+    _readTopology( TopologyIgnore ),
+    _bulkStat( false ),
+    _prioritizedSubtree( 0 ),
+    _writerThread( 0 ),
+    _sortCacheEntries( 0 ),
+    _sortCacheClock( 0 )
 {
     _isBusy	      = false;
     _crossFilesystems = false;
     _root = new DirInfo( this );
     CHECK_NEW( _root );
+    newGeneration();
 
     connect( & _jobQueue, SIGNAL( finished()	 ),
 	     this,	  SLOT	( slotFinished() ) );
 
     connect( this,	  SIGNAL( deletingChild	     ( FileInfo * ) ),
 	     & _jobQueue, SLOT	( deletingChildNotify( FileInfo * ) ) );
+
+    connect( & _checkpointTimer, SIGNAL( timeout()	   ),
+	     this,		 SLOT  ( writeCheckpoint() ) );
+
+    _writerTimer.setInterval( WRITE_PROGRESS_MILLISEC );
+
+    connect( & _writerTimer, SIGNAL( timeout()		   ),
+	     this,		  SLOT	( sendWriteProgress() ) );
+
+    _memoryBudgetTimer.setInterval( MEMORY_BUDGET_CHECK_MILLISEC );
+
+    connect( & _memoryBudgetTimer, SIGNAL( timeout()		 ),
+	     this,		   SLOT	 ( checkMemoryBudget() ) );
 }
 
 
 DirTree::~DirTree()
 {
+    abortWriting();
+    waitForDestroyers();
     _beingDestroyed = true;
 
+    if ( _watcher )
+	delete _watcher;
+
+    if ( _scanCoordinator )
+	delete _scanCoordinator;
+
+    clearCachePlaceholders();
+    _locateIndex.clear();
+
     if ( _root )
 	delete _root;
 
@@ -60,11 +188,22 @@ DirTree::~DirTree()
 	delete _excludeRules;
 
     clearFilters();
+
+    // Pending read jobs are deleted later along with _jobQueue, but they
+    // know that the tree is being destroyed, so they won't try to access
+    // the worker pool any more.
+
+    if ( _readWorkerPool )
+	delete _readWorkerPool;
+
+    qDeleteAll( _deviceReadWorkerPools );
 }
 
 
 void DirTree::setRoot( DirInfo *newRoot )
 {
+    abortWriting();
+
     if ( _root )
     {
 	emit deletingChild( _root );
@@ -73,6 +212,10 @@ void DirTree::setRoot( DirInfo *newRoot )
     }
 
     _root = newRoot;
+    markCacheAllDirty();
+    clearCachePlaceholders();
+    _locateIndex.clear();
+    _hardLinkTable.clear();
 
     FileInfo * realRoot = firstToplevel();
     _url = realRoot ? realRoot->url() : "";
@@ -99,11 +242,36 @@ QString DirTree::url() const
 
 void DirTree::clear()
 {
+    abortWriting();
+
+    foreach ( DirReadWorkerPool * pool, readWorkerPools() )
+	pool->clear();
+
+    if ( _scanCoordinator )
+	_scanCoordinator->clear();
+
     _jobQueue.clear();
+    deleteDeviceReadWorkerPools();
+    _bulkInodeTable.clear();
+    _rescanUrl.clear();
+    _prioritizedSubtree = 0;
+    _addedChildren.clear();	// They are deleted now
+
+    _errorDirs.clear();
 
     if ( _root )
     {
 	emit clearing();
+
+	// The destroyer thread must not find any sort caches: Dropping them
+	// would access _sortCaches from that thread.
+
+	dropSortCaches();
+
+	// Deleting millions of items takes a while; don't keep the user
+	// waiting for that before the new tree can be read.
+
+	destroyInBackground( _root->detachChildren() );
 	_root->clear();
     }
 
@@ -111,12 +279,24 @@ void DirTree::clear()
     _haveClusterSize  = false;
     _blocksPerCluster = 0;
     _device.clear();
+    markCacheAllDirty();
+    clearCachePlaceholders();
+    _locateIndex.clear();
+    _hardLinkTable.clear();
+    _sizeEstimator.clear();
+    _quotaTotals.clear();
+    invalidateSubtreeLabels();
+    _unlabeledDirs.storeRelease( 0 );
+    _labeledDirs = 0;
+    _spillUnderPressure = false;
+    _scanProgress.clear();
 }
 
 
 void DirTree::reset()
 {
     clear();
+    _estimateMode = false;
     clearExcludeRules();
     clearFilters();
 }
@@ -135,9 +315,33 @@ void DirTree::startReading( const QString & rawUrl )
     if ( _root->hasChildren() )
 	clear();
 
+    setupReadWorkerPool( mountPoint && mountPoint->isNetworkMount() );
+
+    _bulkInodeTable.clear();
+
+    if ( _bulkStat && mountPoint && mountPoint->path() == _url )
+    {
+	StallOperation operation( "Bulk inode read" );
+	_bulkInodeTable = BulkInodeTable::read( _url, mountPoint->filesystemType() );
+    }
+
+    _sizeEstimator.setActive( _estimateMode );
+
+    if ( _estimateMode )
+    {
+	logInfo() << "Estimate mode: Reading " << _sizeEstimator.fullLevels()
+		  << " levels completely, then " << _sizeEstimator.samplePercent()
+		  << "% of the subdirectories" << endl;
+    }
+
+    _scanProgress.start( _url, _crossFilesystems );
     _isBusy = true;
+    _readStats.start();
     emit startingReading();
 
+    if ( ! _checkpointFile.isEmpty() )
+	_checkpointTimer.start();
+
     FileInfo * item = LocalDirReadJob::stat( _url, this, _root );
     CHECK_PTR( item );
 
@@ -169,21 +373,58 @@ void DirTree::startReading( const QString & rawUrl )
 
 void DirTree::refresh( const FileInfoSet & refreshSet )
 {
-    FileInfoSet items = refreshSet.invalidRemoved().normalized();
+    // Refresh the directories of the items, not the items themselves:
+    // Several files in one directory or a file and its parent directory
+    // would otherwise read the same subtree again and again, and a later
+    // refresh would clear a subtree that an earlier one is still reading.
+
+    if ( ! _root )
+	return;
 
-    foreach ( FileInfo * item, items )
+    FileInfoSet dirs;
+
+    foreach ( FileInfo * item, refreshSet.invalidRemoved() )
     {
-	// Need to check the magic number here again because a previous
-	// iteration step might have made the item invalid already
+	FileInfo * dir = item->isDirInfo() ? item : item->parent();
 
-	if ( item && item->checkMagicNumber() )
-	{
-	    if ( item->isDirInfo() )
-		refresh( item->toDirInfo() );
-	    else if ( item->parent() )
-		refresh( item->parent() );
-	}
+	if ( dir && dir->isPseudoDir() )	// dot entry or attic
+	    dir = dir->parent();
+
+	if ( dir )
+	    dirs << dir;
+    }
+
+    dirs = dirs.normalized();
+
+    if ( dirs.size() <= 1 )
+    {
+	// One subtree or the whole tree: The root takes over all others in
+	// the normalized set
+
+	if ( ! dirs.isEmpty() )
+	    refresh( dirs.first()->toDirInfo() );
+
+	return;
+    }
+
+    logDebug() << "Refreshing " << dirs.size() << " disjoint subtrees" << endl;
+
+    // Clear all subtrees first and then read them with one job queue, so
+    // the worker threads read them at the same time, and the views get
+    // only one startingReading() and one finished() signal for all of
+    // them.
+
+    foreach ( FileInfo * item, dirs )
+    {
+	DirInfo * dir = item->toDirInfo();
+
+	if ( _incrementalRefresh && IncrementalDirReadJob::canRefresh( dir ) )
+	    queueIncrementalRefresh( dir );
+	else
+	    queueRefresh( dir );
     }
+
+    startRefreshing();
 }
 
 
@@ -206,6 +447,20 @@ void DirTree::refresh( DirInfo * subtree )
     if ( subtree->isDotEntry() )
 	subtree = subtree->parent();
 
+    if ( _incrementalRefresh )
+    {
+	DirInfo * dir = subtree;
+
+	if ( ! dir || ! dir->parent() )
+	    dir = firstToplevel() ? firstToplevel()->toDirInfo() : 0;
+
+	if ( dir && IncrementalDirReadJob::canRefresh( dir ) )
+	{
+	    refreshIncremental( dir );
+	    return;
+	}
+    }
+
     if ( ! subtree || ! subtree->parent() )	// Refresh all (from first toplevel)
     {
 	try
@@ -219,247 +474,1523 @@ void DirTree::refresh( DirInfo * subtree )
     }
     else	// Refresh subtree
     {
-	// logDebug() << "Refreshing subtree " << subtree << endl;
+	queueRefresh( subtree );
+	startRefreshing();
+    }
+}
 
-	clearSubtree( subtree );
 
-	subtree->reset();
-	subtree->setExcluded( false );
+bool DirTree::verify()
+{
+    DirInfo * dir = firstToplevel() ? firstToplevel()->toDirInfo() : 0;
 
-	_isBusy = true;
-	subtree->setReadState( DirReading );
-	emit startingReading();
-	addJob( new LocalDirReadJob( this, subtree ) );
-    }
+    if ( _isBusy || ! dir || ! IncrementalDirReadJob::canRefresh( dir ) )
+	return false;
+
+    logInfo() << "Checking " << dir->url() << " for changes" << endl;
+    refreshIncremental( dir );
+
+    return true;
 }
 
 
-void DirTree::abortReading()
+void DirTree::queueRefresh( DirInfo * subtree )
 {
-    if ( _jobQueue.isEmpty() )
-	return;
+    // logDebug() << "Refreshing subtree " << subtree << endl;
 
-    _jobQueue.abort();
+    markCacheDirty( subtree );
+    forgetCachePlaceholders( subtree );
+    clearSubtree( subtree );
 
-    _isBusy = false;
-    emit aborted();
+    subtree->reset();
+    subtree->setExcluded( false );
+
+    _sizeEstimator.setActive( false );	// Read refreshed subtrees completely
+    _isBusy = true;
+    subtree->setReadState( DirReading );
+    addJob( new LocalDirReadJob( this, subtree ) );
 }
 
 
-void DirTree::finalizeTree()
+void DirTree::startRefreshing()
 {
-    if ( _root && hasFilters() )
-    {
-	recalc( _root );
-	ignoreEmptyDirs( _root );
-	recalc( _root );
-	moveIgnoredToAttic( _root );
-	recalc( _root );
-    }
+    _scanProgress.clear();	// Only part of the tree is read again
+    _readStats.start();
+    emit startingReading();
 }
 
 
-void DirTree::slotFinished()
+void DirTree::refreshIncremental( DirInfo * subtree )
 {
-    finalizeTree();
-    _isBusy = false;
-    emit finished();
+    queueIncrementalRefresh( subtree );
+    startRefreshing();
 }
 
 
-void DirTree::childAddedNotify( FileInfo * newChild )
+void DirTree::queueIncrementalRefresh( DirInfo * subtree )
 {
-    if ( ! _haveClusterSize )
-        detectClusterSize( newChild );
+    // logDebug() << "Refreshing subtree " << subtree << " incrementally" << endl;
 
-    emit childAdded( newChild );
+    thawFiles( subtree );	// The job compares the files with the disk
+    _sizeEstimator.setActive( false );
 
-    if ( newChild->dotEntry() )
-	emit childAdded( newChild->dotEntry() );
-}
+    IncrementalDirReadJob * job = new IncrementalDirReadJob( this, subtree );
+    CHECK_NEW( job );
 
+    // Keep the subtree, but make the views forget its content: They get
+    // it again along with readJobFinished() like for a new directory.
 
-void DirTree::deletingChildNotify( FileInfo * deletedChild )
-{
-    logDebug() << "Deleting child " << deletedChild << endl;
-    emit deletingChild( deletedChild );
+    bool hasChildren = subtree->hasChildren();
+    bool touched     = subtree->isTouched();
 
-    if ( deletedChild == _root )
-	_root = 0;
-}
+    if ( hasChildren )
+    {
+	sendChildrenAdded();
+	emit clearingSubtree( subtree );
+    }
 
+    subtree->clearTouched( true );
 
-void DirTree::childDeletedNotify()
-{
-    emit childDeleted();
-}
+    if ( touched )
+	subtree->touch();
 
+    _isBusy = true;
+    subtree->setReadState( DirReading );
 
-void DirTree::deleteSubtree( FileInfo *subtree )
-{
-    // logDebug() << "Deleting subtree " << subtree << endl;
-    DirInfo * parent = subtree->parent();
+    if ( hasChildren )
+	emit subtreeCleared( subtree );
 
-    // Send notification to anybody interested (e.g., to attached views)
-    deletingChildNotify( subtree );
+    addJob( job );
+}
 
-    if ( parent )
-    {
-	if ( parent->isDotEntry() && ! parent->hasChildren() )
-	    // This was the last child of a dot entry
-	{
-	    // Get rid of that now empty and useless dot entry
 
-	    if ( parent->parent() )
-	    {
-		if ( parent->parent()->isFinished() )
-		{
-		    // logDebug() << "Removing empty dot entry " << parent << endl;
+void DirTree::abortReading()
+{
+    if ( _jobQueue.isEmpty() )
+	return;
 
-		    deletingChildNotify( parent );
-		    parent->parent()->deleteEmptyDotEntry();
+    foreach ( DirReadWorkerPool * pool, readWorkerPools() )
+	pool->clear();
 
-		    delete parent;
-		    parent = 0;
-		}
-	    }
-	    else	// no parent - this should never happen (?)
-	    {
-		logError() << "Internal error: Killing dot entry without parent " << parent << endl;
+    if ( _scanCoordinator )
+	_scanCoordinator->clear();
 
-		// Better leave that dot entry alone - we shouldn't have come
-		// here in the first place. Who knows what will happen if this
-		// thing is deleted now?!
-		//
-		// Intentionally NOT calling:
-		//     delete parent;
-	    }
-	}
-    }
+    _jobQueue.abort();
 
-    if ( parent )
+    if ( _readStats.isRunning() )
     {
-	// Give the parent of the child to be deleted a chance to unlink the
-	// child from its children list and take care of internal summary
-	// fields
-	parent->deletingChild( subtree );
+	_readStats.stop();
+	logInfo() << "Aborted. " << _readStats.summary() << endl;
     }
 
-    delete subtree;
-
-    if ( subtree == _root )
+    if ( _checkpointTimer.isActive() )
     {
-	_root = 0;
+	_checkpointTimer.stop();
+	CacheCheckpoint::write( _checkpointFile, this );
     }
 
-    emit childDeleted();
+    _resumeDirs.clear();
+    _rescanUrl.clear();
+
+    _isBusy = false;
+    emit aborted();
 }
 
 
-void DirTree::clearSubtree( DirInfo * subtree )
+void DirTree::finalizeTree()
 {
-    if ( subtree->hasChildren() )
+    READ_TRACE_SCOPE( "finalizeTree", QString() );
+    newGeneration();
+
+    if ( _readStats.isRunning() )
     {
-	emit clearingSubtree( subtree );
-	subtree->clear();
-	emit subtreeCleared( subtree );
-    }
-}
+	_readStats.stop();
+	logInfo() << _readStats.summary() << endl;
 
+	if ( _scanProgress.isValid() )
+	{
+	    logInfo() << "Read " << _readStats.entries() << " entries of "
+		      << _scanProgress.totalInodes() << " used inodes" << endl;
+	}
+    }
 
-void DirTree::addJob( DirReadJob * job )
-{
-    _jobQueue.enqueue( job );
+    if ( _root && hasFilters() )
+	moveIgnoredToAttic( _root );
 }
 
 
-void DirTree::addBlockedJob( DirReadJob * job )
+void DirTree::slotFinished()
 {
-    _jobQueue.addBlocked( job );
-}
+    // After reading a checkpoint, continue with its unfinished directories
 
+    if ( ! _resumeDirs.isEmpty() && readResumeDirs() )
+	return;
 
-void DirTree::unblock( DirReadJob * job )
-{
-    _jobQueue.unblock( job );
-}
+    // After reading the cache file of rescanWithCache(), read what changed
 
+    if ( ! _rescanUrl.isEmpty() )
+    {
+	rescanAfterCache();
 
-void DirTree::sendStartingReading()
-{
-    emit startingReading();
-}
+	if ( _isBusy )
+	    return;
+    }
 
+    if ( _checkpointTimer.isActive() )
+    {
+	_checkpointTimer.stop();
+	CacheCheckpoint::remove( _checkpointFile );
+    }
 
-void DirTree::sendFinished()
-{
+    sendChildrenAdded();
     finalizeTree();
+
+    if ( _root )
+	_sizeEstimator.extrapolate( _root );
+
+    _sizeEstimator.setActive( false );
+
     _isBusy = false;
+    _prioritizedSubtree = 0;
+    _bulkInodeTable.clear();	// Refreshes stat() what changed
+
+    if ( _root )
+	freezeColdFiles( _root );
+
     emit finished();
 }
 
 
-void DirTree::sendAborted()
+void DirTree::prioritize( FileInfo * item )
 {
-    _isBusy = false;
-    emit aborted();
-}
+    if ( ! _isBusy || ! item )
+	return;
 
+    DirInfo * dir = item->isDirInfo() ? item->toDirInfo() : item->parent();
 
-void DirTree::sendStartingReading( DirInfo * dir )
-{
-    emit startingReading( dir );
-}
+    if ( dir && dir->isPseudoDir() )
+	dir = dir->parent();
 
+    if ( ! dir || dir == _prioritizedSubtree || dir->isFinished() )
+	return;
 
-void DirTree::sendReadJobFinished( DirInfo * dir )
-{
-    // logDebug() << dir << endl;
-    emit readJobFinished( dir );
+    _prioritizedSubtree = dir;
+    _jobQueue.prioritize( dir );
+
+    foreach ( DirReadWorkerPool * pool, readWorkerPools() )
+	pool->prioritize();
 }
 
 
-FileInfo * DirTree::locate( QString url, bool findPseudoDirs )
+QList<DirInfo *> DirTree::errorDirs( FileInfo * subtree ) const
 {
-    if ( ! _root )
-	return 0;
-
-    FileInfo * topItem = _root->firstChild();
+    QList<DirInfo *> result;
 
-    if ( topItem	      &&
-	 topItem->isPkgInfo() &&
-	 topItem->url() == url	)
+    foreach ( DirInfo * dir, _errorDirs )
     {
-	return topItem;
+	if ( dir->readError() && ( ! subtree || dir->isInSubtree( subtree ) ) )
+	    result << dir;
     }
 
-    return _root->locate( url, findPseudoDirs );
+    return result;
 }
 
 
-bool DirTree::writeCache( const QString & cacheFileName )
+void DirTree::forgetErrorDir( DirInfo * dir )
 {
-    CacheWriter writer( cacheFileName.toUtf8(), this );
-    return writer.ok();
+    // The items of a discarded tree are deleted in a separate thread, but
+    // clear() already forgot all of them.
+
+    if ( QThread::currentThread() == thread() )
+	_errorDirs.remove( dir );
 }
 
 
-void DirTree::readCache( const QString & cacheFileName )
+void DirTree::updateErrorDirs( DirInfo * dir )
 {
-    _isBusy = true;
-    emit startingReading();
-    addJob( new CacheReadJob( this, 0, cacheFileName ) );
+    if ( dir->readError() )
+	_errorDirs.insert( dir );
+    else
+	_errorDirs.remove( dir );
 }
 
 
-void DirTree::clearAndReadCache( const QString & cacheFileName )
+bool DirTree::isPrioritized( const DirInfo * dir ) const
 {
-    clear();
-    readCache( cacheFileName );
+    return _prioritizedSubtree && dir && dir->isInSubtree( _prioritizedSubtree );
 }
 
 
-void DirTree::readPkg( const PkgFilter & pkgFilter )
+void DirTree::setCheckpoint( const QString & fileName, int intervalSec )
+{
+    _checkpointFile = fileName;
+    _checkpointTimer.setInterval( qMax( 1, intervalSec ) * 1000 );
+
+    if ( fileName.isEmpty() )
+	_checkpointTimer.stop();
+}
+
+
+void DirTree::writeCheckpoint()
+{
+    if ( _isBusy && ! _checkpointFile.isEmpty() )
+	CacheCheckpoint::write( _checkpointFile, this );
+}
+
+
+void DirTree::setMemoryBudget( qint64 bytes )
+{
+    _memoryBudget.setLimit( bytes );
+
+    if ( _memoryBudget.isEnabled() )
+    {
+	logInfo() << "Memory budget: " << formatSize( bytes ) << endl;
+	_memoryBudgetTimer.start();
+    }
+    else
+    {
+	_memoryBudgetTimer.stop();
+	_spillUnderPressure = false;
+    }
+
+    emit memoryBudgetChecked();
+}
+
+
+void DirTree::checkMemoryBudget()
+{
+    MemoryBudget::Level previous = _memoryBudget.level();
+    MemoryBudget::Level level	 = _memoryBudget.check();
+
+    if ( level > previous )
+    {
+	logWarning() << "Using " << formatSize( _memoryBudget.usedBytes() )
+		     << " of a memory budget of " << formatSize( _memoryBudget.limit() ) << endl;
+
+	if ( level >= MemoryBudget::DropCaches )
+	{
+	    dropSortCaches();
+	    emit memoryPressure();
+	}
+
+	if ( level >= MemoryBudget::Shrink )
+	{
+	    logInfo() << "Freezing cold files; spilling the files of new directories" << endl;
+	    _spillUnderPressure = true;
+
+	    if ( _root && ! _writerThread )
+		freezeColdFilesNow( _root );
+	}
+
+	if ( level >= MemoryBudget::Exhausted && _isBusy )
+	    logWarning() << "Not reading any more subdirectories" << endl;
+    }
+
+    emit memoryBudgetChecked();
+}
+
+
+bool DirTree::resumeReading( const QString & fileName )
+{
+    QStringList pending;
+
+    if ( ! CacheCheckpoint::readPending( fileName, pending ) )
+	return false;
+
+    logInfo() << "Resuming reading from checkpoint " << fileName << endl;
+
+    _resumeDirs = pending;
+    readCache( fileName );
+
+    return true;
+}
+
+
+void DirTree::rescanWithCache( const QString & url, const QString & cacheFileName )
+{
+    logInfo() << "Rescanning " << url << " with cache file " << cacheFileName << endl;
+
+    if ( _root->hasChildren() )
+	clear();
+
+    _rescanUrl	     = QDir::cleanPath( QFileInfo( url ).absoluteFilePath() );
+    _rescanCacheFile = cacheFileName;
+    readCache( cacheFileName );
+}
+
+
+void DirTree::rescanAfterCache()
+{
+    QString url	      = _rescanUrl;
+    QString cacheFile = _rescanCacheFile;
+    _rescanUrl.clear();
+    _rescanCacheFile.clear();
+
+    loadCachePlaceholders();	// Their mtimes are needed, too
+
+    FileInfo * toplevel = firstToplevel();
+    DirInfo  * dir	= toplevel ? toplevel->toDirInfo() : 0;
+
+    if ( dir && dir->url() == url && IncrementalDirReadJob::canRefresh( dir ) )
+    {
+	_url = url;
+	MountPoint * mountPoint = MountPoints::findNearestMountPoint( _url );
+	_device = mountPoint ? mountPoint->device() : "";
+	setupReadWorkerPool( mountPoint && mountPoint->isNetworkMount() );
+
+	setCacheClean( cacheFile );
+	refreshIncremental( dir );
+
+	return;
+    }
+
+    logWarning() << "Cache file " << cacheFile << " is not usable for " << url
+		 << "; reading everything" << endl;
+
+    try
+    {
+	startReading( url );
+    }
+    catch ( const SysCallFailedException & ex )
+    {
+	CAUGHT( ex );
+    }
+}
+
+
+bool DirTree::readResumeDirs()
+{
+    QStringList urls = _resumeDirs;
+    _resumeDirs.clear();
+
+    FileInfo * toplevel = firstToplevel();
+
+    if ( ! toplevel )
+	return false;
+
+    loadCachePlaceholders();	// locate() needs the complete tree
+
+    _url = toplevel->url();
+    MountPoint * mountPoint = MountPoints::findNearestMountPoint( _url );
+    _device = mountPoint ? mountPoint->device() : "";
+    setupReadWorkerPool( mountPoint && mountPoint->isNetworkMount() );
+
+    int count = 0;
+
+    foreach ( const QString & url, urls )
+    {
+	FileInfo * item = locate( url );
+	DirInfo  * dir	= item ? item->toDirInfo() : 0;
+
+	if ( ! dir || dir->isPseudoDir() )
+	{
+	    logWarning() << "Unfinished directory " << url << " not in the checkpoint" << endl;
+	    continue;
+	}
+
+	// Like refreshing a subtree
+
+	clearSubtree( dir );
+	dir->reset();
+	dir->setReadState( DirReading );
+	addJob( new LocalDirReadJob( this, dir ) );
+	++count;
+    }
+
+    logInfo() << "Reading " << count << " unfinished directories" << endl;
+
+    if ( count == 0 )
+	return false;
+
+    _scanProgress.clear();
+    _readStats.start();
+
+    if ( ! _checkpointFile.isEmpty() )
+	_checkpointTimer.start();
+
+    return true;
+}
+
+
+void DirTree::childAddedNotify( FileInfo * newChild )
+{
+    if ( ! _haveClusterSize )
+        detectClusterSize( newChild );
+
+    markCacheDirty( newChild );
+
+    if ( _cacheCategories && newChild->isFile() )
+	MimeCategorizer::instance()->category( newChild );
+
+    if ( receivers( SIGNAL( childAdded( FileInfo * ) ) ) > 0 )
+    {
+	emit childAdded( newChild );
+
+	if ( newChild->dotEntry() )
+	    emit childAdded( newChild->dotEntry() );
+    }
+
+    if ( receivers( SIGNAL( childrenAdded( FileInfoList ) ) ) > 0 )
+    {
+	if ( _addedChildren.isEmpty() )
+	    QTimer::singleShot( 0, this, SLOT( sendChildrenAdded() ) );
+
+	_addedChildren << newChild;
+
+	if ( newChild->dotEntry() )
+	    _addedChildren << newChild->dotEntry();
+
+	if ( _addedChildren.size() >= CHILDREN_ADDED_BATCH_SIZE )
+	    sendChildrenAdded();
+    }
+}
+
+
+void DirTree::sendChildrenAdded()
+{
+    if ( _addedChildren.isEmpty() )
+	return;
+
+    FileInfoList children;
+    children.swap( _addedChildren );
+    emit childrenAdded( children );
+}
+
+
+void DirTree::deletingChildNotify( FileInfo * deletedChild )
+{
+    logDebug() << "Deleting child " << deletedChild << endl;
+    sendChildrenAdded();
+    markCacheDirty( deletedChild );
+    forgetCachePlaceholders( deletedChild );
+    forgetLocateIndex( deletedChild );
+    _sizeEstimator.forget( deletedChild );
+    forgetQuotaTotals( deletedChild );
+
+    if ( _prioritizedSubtree && _prioritizedSubtree->isInSubtree( deletedChild ) )
+	_prioritizedSubtree = 0;
+
+    emit deletingChild( deletedChild );
+
+    if ( deletedChild == _root )
+	_root = 0;
+}
+
+
+void DirTree::childDeletedNotify()
+{
+    emit childDeleted();
+}
+
+
+void DirTree::deleteSubtree( FileInfo *subtree )
+{
+    // logDebug() << "Deleting subtree " << subtree << endl;
+    DirInfo * parent = subtree->parent();
+
+    // Send notification to anybody interested (e.g., to attached views)
+    deletingChildNotify( subtree );
+
+    if ( parent )
+    {
+	if ( parent->isDotEntry() && ! parent->hasChildren() )
+	    // This was the last child of a dot entry
+	{
+	    // Get rid of that now empty and useless dot entry
+
+	    if ( parent->parent() )
+	    {
+		if ( parent->parent()->isFinished() )
+		{
+		    // logDebug() << "Removing empty dot entry " << parent << endl;
+
+		    deletingChildNotify( parent );
+		    parent->parent()->deleteEmptyDotEntry();
+
+		    delete parent;
+		    parent = 0;
+		}
+	    }
+	    else	// no parent - this should never happen (?)
+	    {
+		logError() << "Internal error: Killing dot entry without parent " << parent << endl;
+
+		// Better leave that dot entry alone - we shouldn't have come
+		// here in the first place. Who knows what will happen if this
+		// thing is deleted now?!
+		//
+		// Intentionally NOT calling:
+		//     delete parent;
+	    }
+	}
+    }
+
+    if ( parent )
+    {
+	// Give the parent of the child to be deleted a chance to unlink the
+	// child from its children list and take care of internal summary
+	// fields
+	parent->deletingChild( subtree );
+    }
+
+    delete subtree;
+
+    if ( subtree == _root )
+    {
+	_root = 0;
+    }
+
+    emit childDeleted();
+}
+
+
+void DirTree::clearSubtree( DirInfo * subtree )
+{
+    if ( subtree->hasChildren() )
+    {
+	markCacheDirty( subtree );
+
+	// Keep the quota totals of 'subtree' itself to show them while it
+	// is read again
+
+	for ( FileInfo * child = subtree->firstChild(); child; child = child->next() )
+	{
+	    forgetCachePlaceholders( child );
+	    forgetQuotaTotals( child );
+	}
+
+	forgetLocateIndex( subtree );
+	_sizeEstimator.forget( subtree );
+	sendChildrenAdded();
+	emit clearingSubtree( subtree );
+	subtree->clear();
+	emit subtreeCleared( subtree );
+    }
+}
+
+
+void DirTree::addJob( DirReadJob * job )
+{
+    _jobQueue.enqueue( job );
+    _readStats.updateQueueDepth( _jobQueue.count(), _jobQueue.blockedCount() );
+}
+
+
+void DirTree::addBlockedJob( DirReadJob * job )
+{
+    _jobQueue.addBlocked( job );
+    _readStats.updateQueueDepth( _jobQueue.count(), _jobQueue.blockedCount() );
+}
+
+
+void DirTree::unblock( DirReadJob * job )
+{
+    _jobQueue.unblock( job );
+}
+
+
+void DirTree::sendStartingReading()
+{
+    resetRuleStats();
+    emit startingReading();
+}
+
+
+void DirTree::sendFinished()
+{
+    finalizeTree();
+    DirFdCache::clear();	// don't keep any directories open
+    logRuleStats();
+
+    if ( ! _pendingCacheImage.isEmpty() )
+    {
+	QString cacheFileName = _pendingCacheImage;
+	_pendingCacheImage.clear();
+
+	SharedCacheImage::create( cacheFileName, this );
+    }
+
+    _isBusy = false;
+    emit finished();
+}
+
+
+void DirTree::sendStartingUpdate()
+{
+    emit startingUpdate();
+}
+
+
+void DirTree::sendUpdateFinished()
+{
+    emit updateFinished();
+}
+
+
+void DirTree::sendAborted()
+{
+    DirFdCache::clear();
+    _pendingCacheImage.clear();
+    _isBusy = false;
+    emit aborted();
+}
+
+
+void DirTree::sendStartingReading( DirInfo * dir )
+{
+    emit startingReading( dir );
+}
+
+
+void DirTree::sendReadJobFinished( DirInfo * dir )
+{
+    // logDebug() << dir << endl;
+    newGeneration();	// The read state and the summaries changed
+    emit readJobFinished( dir );
+}
+
+
+FileInfo * DirTree::locate( QString url, bool findPseudoDirs )
+{
+    if ( ! _root )
+	return 0;
+
+    FileInfo * topItem = _root->firstChild();
+
+    if ( topItem	      &&
+	 topItem->isPkgInfo() &&
+	 topItem->url() == url	)
+    {
+	return topItem;
+    }
+
+    FileInfo * result = 0;
+
+    if ( ! locateIndexed( url, findPseudoDirs, result ) )
+	result = _root->locate( url, findPseudoDirs );
+
+    if ( result && _useLocateIndex )
+	addToLocateIndex( result->isDirInfo() ? result->toDirInfo() : result->parent() );
+
+    return result;
+}
+
+
+bool DirTree::locateIndexed( const QString & url,
+			     bool	     findPseudoDirs,
+			     FileInfo *&     result )
+{
+    result = 0;
+
+    if ( _locateIndex.isEmpty() )
+	return false;
+
+    DirInfo * dir = _locateIndex.value( url, 0 );
+
+    if ( dir )
+    {
+	result = dir;
+	return true;
+    }
+
+    // Try the parent directories from the bottom up and search only the
+    // subtree of the first one that is in the index
+
+    int pos = url.length();
+
+    while ( ( pos = url.lastIndexOf( '/', pos - 1 ) ) >= 0 )
+    {
+	QString dirUrl = url.left( pos > 0 ? pos : 1 ); // keep "/" for the root directory
+	dir = _locateIndex.value( dirUrl, 0 );
+
+	if ( dir )
+	{
+	    // FileInfo::locate() expects the URL relative to the parent
+	    // directory, i.e. starting with the name of 'dir'.
+
+	    result = dir->locate( dir->name() + url.mid( dirUrl.length() ), findPseudoDirs );
+	    return true;
+	}
+
+	if ( pos == 0 )
+	    break;
+    }
+
+    return false;
+}
+
+
+void DirTree::addToLocateIndex( DirInfo * dir )
+{
+    // Dot entries and attics have the same URL as their parent
+
+    while ( dir && dir->isPseudoDir() )
+	dir = dir->parent();
+
+    if ( dir && dir != _root && ! dir->isPkgInfo() )
+	_locateIndex.insert( dir->url(), dir );
+}
+
+
+bool DirTree::readQuotaTotals( DirInfo * dir )
+{
+    if ( _quotaMode == QuotaIgnore || ! dir )
+	return false;
+
+    QuotaTotals totals;
+
+    if ( dir->isMountPoint() )
+    {
+	// statfs() of a network mount might hang, and that of a system mount
+	// is meaningless
+
+	MountPoint * mountPoint = MountPoints::findByPath( dir->url() );
+
+	if ( ! mountPoint || mountPoint->isNetworkMount() || mountPoint->isSystemMount() ||
+	     ! mountPoint->hasSizeInfo() || mountPoint->usedSize() < 0 )
+	{
+	    return false;
+	}
+
+	totals.usedBytes = mountPoint->usedSize();
+	totals.source	 = "filesystem";
+    }
+    else
+    {
+	int level = 0;
+
+	for ( const FileInfo * item = dir; item && item != firstToplevel(); item = item->parent() )
+	{
+	    if ( ++level > QUOTA_MAX_LEVELS )
+		return false;
+	}
+
+	MountPoint * mountPoint = MountPoints::findNearestMountPoint( dir->url() );
+
+	if ( ! mountPoint || ! QuotaUsage::isSupported( mountPoint->filesystemType() ) )
+	    return false;
+
+	if ( ! QuotaUsage::subtreeUsage( dir->url(), mountPoint->device(),
+					 mountPoint->filesystemType(), totals ) )
+	{
+	    return false;
+	}
+    }
+
+    _quotaTotals.insert( dir, totals );
+
+    if ( _quotaMode == QuotaSkip )
+    {
+	dir->setQuotaPlaceholder( totals.usedBytes, totals.usedInodes );
+	return true;
+    }
+
+    return false;
+}
+
+
+void DirTree::forgetQuotaTotals( FileInfo * subtree )
+{
+    if ( _quotaTotals.isEmpty() || ! subtree )
+	return;
+
+    QMutableHashIterator<const DirInfo *, QuotaTotals> it( _quotaTotals );
+
+    while ( it.hasNext() )
+    {
+	it.next();
+
+	if ( it.key()->isInSubtree( subtree ) )
+	    it.remove();
+    }
+}
+
+
+void DirTree::forgetLocateIndex( FileInfo * subtree )
+{
+    if ( _locateIndex.isEmpty() || ! subtree || ! subtree->isDirInfo() )
+	return;
+
+    DirInfo * dir = subtree->toDirInfo();
+
+    if ( ! dir->isPseudoDir() )
+    {
+	QHash<QString, DirInfo *>::iterator it = _locateIndex.find( dir->url() );
+
+	if ( it != _locateIndex.end() && it.value() == dir )
+	    _locateIndex.erase( it );
+    }
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+	forgetLocateIndex( child );
+
+    // The dot entry only contains files, but the attic may contain
+    // directories.
+
+    if ( dir->attic() )
+	forgetLocateIndex( dir->attic() );
+}
+
+
+void DirTree::setUseLocateIndex( bool use )
+{
+    _useLocateIndex = use;
+
+    if ( ! use )
+	_locateIndex.clear();
+}
+
+
+bool DirTree::writeCache( const QString & cacheFileName )
+{
+    finishWriting();
+
+    CacheWriter writer( cacheFileName.toUtf8(), this );
+    return writer.ok();
+}
+
+
+bool DirTree::startWritingCache( const QString & cacheFileName )
+{
+    if ( _isBusy || _writerThread )
+	return false;
+
+    CacheWriterThread * thread = new CacheWriterThread( cacheFileName, this );
+    CHECK_NEW( thread );
+
+    return startWriting( thread );
+}
+
+
+bool DirTree::startWriting( TreeWriterThread * thread )
+{
+    if ( _isBusy || _writerThread )
+    {
+	delete thread;
+	return false;
+    }
+
+    logInfo() << "Writing " << thread->fileName() << " in the background" << endl;
+
+    _writerThread = thread;
+
+    connect( _writerThread, SIGNAL( finished()		   ),
+	     this,	    SLOT  ( writerThreadFinished() ) );
+
+    _writerThread->start();
+    _writerTimer.start();
+
+    return true;
+}
+
+
+void DirTree::finishWriting()
+{
+    if ( ! _writerThread )
+	return;
+
+    _writerThread->wait();
+    writerThreadFinished();
+}
+
+
+void DirTree::abortWriting()
+{
+    if ( ! _writerThread )
+	return;
+
+    _writerThread->abort();
+    finishWriting();
+}
+
+
+void DirTree::writerThreadFinished()
+{
+    // The finished() signal of a thread might still be pending after
+    // finishWriting() took care of it.
+
+    if ( ! _writerThread || ( sender() && sender() != _writerThread ) )
+	return;
+
+    TreeWriterThread * thread = _writerThread;
+    _writerThread = 0;
+    _writerTimer.stop();
+
+    thread->wait();
+    thread->updateTree( this );
+
+    QString fileName = thread->fileName();
+    bool    ok	     = thread->ok();
+
+    logInfo() << ( ok ? "Wrote " : "Could not write " ) << fileName
+	      << " with " << thread->itemsWritten() << " items" << endl;
+
+    delete thread;
+    emit treeWritten( fileName, ok );
+}
+
+
+void DirTree::sendWriteProgress()
+{
+    if ( _writerThread )
+	emit writeProgress( _writerThread->itemsWritten() );
+}
+
+
+void DirTree::markCacheDirty( FileInfo * item )
+{
+    // Everything that changes the tree ends up here, so this is the place
+    // to wait for a cache writer thread that still needs it unchanged.
+
+    finishWriting();
+    newGeneration();
+
+    if ( _cacheAllDirty )	// the normal case while reading
+	return;
+
+    FileInfo * toplevel = firstToplevel();
+    FileInfo * ancestor = item;
+
+    while ( ancestor && ancestor->parent() != toplevel )
+	ancestor = ancestor->parent();
+
+    if ( ! toplevel || ! ancestor )
+    {
+	markCacheAllDirty();
+	return;
+    }
+
+    // Non-directory children of the toplevel (directly or in its dot entry
+    // or attic) are in the toplevel block.
+
+    if ( ancestor->isDirInfo() && ! ancestor->isPseudoDir() )
+	_dirtyCacheBlocks.insert( ancestor->name() );
+    else
+	_dirtyCacheBlocks.insert( QString() );
+}
+
+
+void DirTree::updateSubtreeLabels( int checks )
+{
+    if ( ! _root || subtreeLabelsComplete() )
+	return;
+
+    // Labeling takes one step for each directory, each check without
+    // labels about one for each directory level
+
+    qint64 dirs = (qint64) _labeledDirs + _unlabeledDirs.loadAcquire();
+
+    if ( (qint64) checks * SUBTREE_CHECK_STEPS < dirs )
+	return;
+
+    if ( ++_lastSubtreeLabelGeneration <= 0 )
+	_lastSubtreeLabelGeneration = 1;
+
+    int generation = _lastSubtreeLabelGeneration;
+    _labeledDirs = labelSubtree( _root, generation, 1 ) - 1;
+    _unlabeledDirs.storeRelease( 0 );
+    _subtreeLabelGeneration.storeRelease( generation );
+
+    logDebug() << "Labeled " << _labeledDirs << " directories for " << checks
+	       << " subtree checks" << endl;
+}
+
+
+int DirTree::labelSubtree( DirInfo * dir, int generation, int next )
+{
+    int preOrder = next++;
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() )
+	    next = labelSubtree( child->toDirInfo(), generation, next );
+    }
+
+    if ( dir->dotEntry() )
+	next = labelSubtree( dir->dotEntry(), generation, next );
+
+    if ( dir->attic() )
+	next = labelSubtree( dir->attic(), generation, next );
+
+    dir->setSubtreeLabels( generation, preOrder, next - 1 );
+
+    return next;
+}
+
+
+void DirTree::newGeneration()
+{
+    // Shared by all trees so a new tree never starts with a generation
+    // that another one (maybe at the same address) already had
+
+    static qint64 lastGeneration = 0;
+    _generation = ++lastGeneration;
+}
+
+
+void DirTree::markCacheAllDirty()
+{
+    newGeneration();
+    _cacheAllDirty = true;
+    _dirtyCacheBlocks.clear();
+    _cleanCacheFile.clear();
+}
+
+
+bool DirTree::isCacheBlockClean( const QString & cacheFileName,
+				 const QString & blockName ) const
+{
+    return ! _cacheAllDirty &&
+	cacheFileName == _cleanCacheFile &&
+	! _dirtyCacheBlocks.contains( blockName );
+}
+
+
+void DirTree::setCacheClean( const QString & cacheFileName )
+{
+    _cacheAllDirty  = false;
+    _cleanCacheFile = cacheFileName;
+    _dirtyCacheBlocks.clear();
+}
+
+
+void DirTree::readCache( const QString & cacheFileName )
+{
+    _isBusy = true;
+    emit startingReading();
+
+    if ( ListingReadJob::isListing( cacheFileName ) )
+    {
+	addJob( new ListingReadJob( this, cacheFileName ) );
+	return;
+    }
+
+    QString fileName = cacheFileName;
+    _pendingCacheImage.clear();
+
+    if ( _shareCacheImages && ! CacheWriter::isBinaryCacheFile( cacheFileName ) )
+    {
+	QString image = SharedCacheImage::find( cacheFileName );
+
+	if ( ! image.isEmpty() )
+	{
+	    logInfo() << "Reading the shared image " << image << " of " << cacheFileName << endl;
+	    fileName = image;
+	}
+	else if ( ! SharedCacheImage::imagePath( cacheFileName ).isEmpty() )
+	{
+	    _pendingCacheImage = cacheFileName;	 // see sendFinished()
+	}
+    }
+
+    addJob( new CacheReadJob( this, 0, fileName ) );
+}
+
+
+void DirTree::readCaches( const QStringList & cacheFileNames )
+{
+    if ( cacheFileNames.size() == 1 )
+    {
+	readCache( cacheFileNames.first() );
+	return;
+    }
+
+    if ( _root->hasChildren() )
+	clear();
+
+    _isBusy = true;
+    emit startingReading();
+
+    DirInfo * merged = new DirInfo( this, _root, MERGED_CACHES_URL,
+				    S_IFDIR | 0755, 0, 0 );
+    CHECK_NEW( merged );
+
+    merged->setReadState( DirReading );
+    _root->insertChild( merged );
+    childAddedNotify( merged );
+
+    addJob( new MergedCacheReadJob( this, merged, cacheFileNames ) );
+    emit readJobFinished( _root );
+}
+
+
+void DirTree::readRemote( const QString & host, const QString & path )
+{
+    _isBusy = true;
+    emit startingReading();
+
+    RemoteReadJob * job = new RemoteReadJob( this, host, path );
+    CHECK_NEW( job );
+
+    addBlockedJob( job );
+}
+
+
+void DirTree::addCachePlaceholder( DirInfo		* dir,
+				   const QString	& cacheFileName,
+				   const CacheBlockInfo & block )
+{
+    _lazyCacheFile = QFileInfo( cacheFileName ).absoluteFilePath();
+
+    CacheBlockInfo * newBlock = new CacheBlockInfo( block );
+    CHECK_NEW( newBlock );
+
+    delete _cachePlaceholders.value( dir, 0 );
+    _cachePlaceholders.insert( dir, newBlock );
+}
+
+
+bool DirTree::cachePlaceholderBlock( DirInfo * dir, CacheBlockInfo & block ) const
+{
+    CacheBlockInfo * found = _cachePlaceholders.value( dir, 0 );
+
+    if ( found )
+	block = *found;
+
+    return found != 0;
+}
+
+
+void DirTree::readCachePlaceholder( DirInfo * dir )
+{
+    if ( isSpilled( dir ) )
+    {
+	// Fast enough to do it right away
+
+	loadSpilledFiles( dir );
+	return;
+    }
+
+    CacheBlockInfo * block = _cachePlaceholders.take( dir );
+
+    if ( ! block )
+	return;
+
+    CacheReader * reader = new CacheReader( _lazyCacheFile, this, dir, *block );
+    CHECK_NEW( reader );
+    delete block;
+
+    _isBusy = true;
+    dir->setReadState( DirReading );
+    emit startingReading();
+    addJob( new CacheReadJob( this, dir, reader ) );
+}
+
+
+void DirTree::loadCachePlaceholder( DirInfo * dir )
+{
+    finishWriting();	// This adds children to 'dir'
+
+    if ( isSpilled( dir ) )
+    {
+	loadSpilledFiles( dir );
+	return;
+    }
+
+    CacheBlockInfo * block = _cachePlaceholders.take( dir );
+
+    if ( ! block )
+	return;
+
+    CacheReader reader( _lazyCacheFile, this, dir, *block );
+    delete block;
+
+    if ( reader.ok() )
+	reader.read();	// everything
+
+    // The reader finalizes the subtree when it is destroyed
+}
+
+
+void DirTree::loadCachePlaceholders()
+{
+    foreach ( DirInfo * dir, _cachePlaceholders.keys() )
+	loadCachePlaceholder( dir );
+
+    loadSpilledFiles();
+}
+
+
+void DirTree::spillFiles( DirInfo * dir )
+{
+    if ( ! ( _spillFiles || _spillUnderPressure ) || ! dir )
+	return;
+
+    moveFilesToStore( filesDir( dir ), false );
+}
+
+
+DirInfo * DirTree::filesDir( DirInfo * dir ) const
+{
+    DirInfo * target = dir->dotEntry();
+
+    if ( ! target )
+    {
+	for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+	{
+	    if ( child->isDirInfo() )
+		return 0;
+	}
+
+	target = dir;
+    }
+
+    if ( target->isCachePlaceholder() || target->directChildrenCount() < SPILL_MIN_FILES )
+	return 0;
+
+    return target;
+}
+
+
+bool DirTree::moveFilesToStore( DirInfo * target, bool inMemory )
+{
+    if ( ! target )
+	return false;
+
+    if ( ! _spillStore )
+    {
+	_spillStore = new FileSpillStore( inMemory ? FileSpillStore::InMemory : FileSpillStore::TempFile,
+					  _spillDir );
+	CHECK_NEW( _spillStore );
+    }
+
+    if ( ! _spillStore->spill( target ) )
+	return false;
+
+    // Make sure nobody still has pointers to the files
+
+    sendChildrenAdded();
+    emit clearingSubtree( target );
+    target->spillChildren();
+    emit subtreeCleared( target );
+
+    return true;
+}
+
+
+void DirTree::freezeColdFiles( DirInfo * subtree )
+{
+    if ( _freezeColdFiles )
+	freezeColdFilesNow( subtree );
+}
+
+
+void DirTree::freezeColdFilesNow( DirInfo * subtree )
+{
+    if ( ! subtree || _writerThread )
+	return;
+
+    int count = freezeColdFilesRecursive( subtree );
+
+    if ( count > 0 && _spillStore )
+    {
+	_spillStore->squeeze();
+	logInfo() << "Froze the files of " << count << " directories in " << subtree
+		  << "; " << formatSize( _spillStore->fileSize() ) << " packed" << endl;
+
+	if ( _spillStore->sharedCount() > 0 )
+	{
+	    logInfo() << _spillStore->sharedCount() << " directories share the files of an identical one; "
+		      << formatSize( _spillStore->sharedSize() ) << " saved" << endl;
+	}
+    }
+}
+
+
+int DirTree::freezeColdFilesRecursive( DirInfo * dir )
+{
+    if ( dir->isCachePlaceholder() )
+	return 0;
+
+    int count = 0;
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() && ! child->isDotEntry() )
+	    count += freezeColdFilesRecursive( child->toDirInfo() );
+    }
+
+    // The views never showed anything of an untouched directory. Under
+    // memory pressure, this may happen while reading; leave alone what is
+    // still being read.
+
+    if ( dir->pendingReadJobs() > 0 )
+	return count;
+
+    DirInfo * target = filesDir( dir );
+
+    if ( target && ! target->isTouched() &&
+	 moveFilesToStore( target, true ) )
+    {
+	++count;
+    }
+
+    return count;
+}
+
+
+void DirTree::thawFiles( FileInfo * subtree )
+{
+    if ( ! _spillStore || _spillStore->count() == 0 || ! subtree )
+	return;
+
+    foreach ( DirInfo * dir, _spillStore->dirs() )
+    {
+	if ( dir->isInSubtree( subtree ) )
+	    loadSpilledFiles( dir );
+    }
+}
+
+
+bool DirTree::isSpilled( DirInfo * dir ) const
+{
+    return _spillStore && _spillStore->contains( dir );
+}
+
+
+void DirTree::loadSpilledFiles( DirInfo * dir )
+{
+    if ( ! isSpilled( dir ) )
+	return;
+
+    finishWriting();
+    dir->unspill();
+    _spillStore->load( dir );
+
+    if ( _contiguousChildren )
+	dir->buildChildVector();
+
+    if ( _fileColumns )
+	dir->buildFileColumns();
+
+    newGeneration();	// The tree changed
+    emit readJobFinished( dir );
+}
+
+
+void DirTree::loadSpilledFiles()
+{
+    if ( ! _spillStore || _spillStore->count() == 0 )
+	return;
+
+    logInfo() << "Loading " << _spillStore->count() << " spilled directories" << endl;
+
+    foreach ( DirInfo * dir, _spillStore->dirs() )
+	loadSpilledFiles( dir );
+}
+
+
+void DirTree::updateCachePlaceholders( const QList<CacheBlockInfo> & blocks )
+{
+    foreach ( CacheBlockInfo * placeholderBlock, _cachePlaceholders )
+    {
+	foreach ( const CacheBlockInfo & block, blocks )
+	{
+	    if ( block.name == placeholderBlock->name )
+	    {
+		placeholderBlock->offset = block.offset;
+		placeholderBlock->size	 = block.size;
+		break;
+	    }
+	}
+    }
+}
+
+
+void DirTree::forgetCachePlaceholders( FileInfo * subtree )
+{
+    if ( _spillStore )
+	_spillStore->forget( subtree );
+
+    if ( _cachePlaceholders.isEmpty() )
+	return;
+
+    QMutableHashIterator<DirInfo *, CacheBlockInfo *> it( _cachePlaceholders );
+
+    while ( it.hasNext() )
+    {
+	it.next();
+
+	if ( it.key()->isInSubtree( subtree ) )
+	{
+	    delete it.value();
+	    it.remove();
+	}
+    }
+}
+
+
+void DirTree::clearCachePlaceholders()
+{
+    qDeleteAll( _cachePlaceholders );
+    _cachePlaceholders.clear();
+
+    if ( _spillStore )
+    {
+	delete _spillStore;
+	_spillStore = 0;
+    }
+}
+
+
+void DirTree::destroyInBackground( DirInfo * subtree )
+{
+    if ( ! subtree )
+	return;
+
+    if ( ! subtree->firstChild() && ! subtree->dotEntry() && ! subtree->attic() )
+    {
+	delete subtree;
+	return;
+    }
+
+    QThread * destroyer = new DestroyerThread( subtree );
+    CHECK_NEW( destroyer );
+
+    connect( destroyer, SIGNAL( finished()	    ),
+	     this,	SLOT  ( destroyerFinished() ) );
+
+    _destroyers << destroyer;
+    NodeAllocator::addConcurrentUser();
+    destroyer->start( QThread::LowPriority );
+}
+
+
+void DirTree::destroyerFinished()
+{
+    QThread * destroyer = qobject_cast<QThread *>( sender() );
+
+    if ( ! destroyer || ! _destroyers.contains( destroyer ) )
+	return;
+
+    destroyer->wait();
+    _destroyers.removeAll( destroyer );
+    NodeAllocator::removeConcurrentUser();
+    delete destroyer;
+}
+
+
+void DirTree::waitForDestroyers()
+{
+    foreach ( QThread * destroyer, _destroyers )
+    {
+	destroyer->wait();
+	NodeAllocator::removeConcurrentUser();
+	delete destroyer;
+    }
+
+    _destroyers.clear();
+}
+
+
+void DirTree::clearAndReadCache( const QString & cacheFileName )
+{
+    clear();
+    readCache( cacheFileName );
+}
+
+
+void DirTree::readPkg( const PkgFilter & pkgFilter )
 {
     clear();
     _isBusy = true;
@@ -472,54 +2003,187 @@ void DirTree::readPkg( const PkgFilter & pkgFilter )
 }
 
 
-void DirTree::setExcludeRules( ExcludeRules * newRules )
+void DirTree::setExcludeRules( ExcludeRules * newRules )
+{
+    if ( _excludeRules )
+	delete _excludeRules;
+
+#if VERBOSE_EXCLUDE_RULES
+    if ( newRules )
+    {
+	logDebug() << "New tmp exclude rules:" << endl;
+
+	for ( ExcludeRuleListIterator it = newRules->begin(); it != newRules->end(); ++it )
+	{
+	    logDebug() << *it << endl;
+	}
+    }
+    else
+    {
+	logDebug() << "Clearing tmp exclude rules" << endl;
+    }
+#endif
+
+    _excludeRules = newRules;
+}
+
+
+void DirTree::addFilter( DirTreeFilter * filter )
+{
+    if ( filter )
+    {
+	_filters << filter;
+
+	delete _filterChain;	// build it again with the next check
+	_filterChain = 0;
+    }
+}
+
+
+DirTreePkgFilter * DirTree::pkgFilter() const
+{
+    foreach ( DirTreeFilter * filter, _filters )
+    {
+	DirTreePkgFilter * pkgFilter = dynamic_cast<DirTreePkgFilter *>( filter );
+
+	if ( pkgFilter )
+	    return pkgFilter;
+    }
+
+    return 0;
+}
+
+
+PkgFileListCache * DirTree::pkgFileListCache() const
+{
+    DirTreePkgFilter * filter = pkgFilter();
+
+    return filter ? filter->fileListCache() : 0;
+}
+
+
+void DirTree::ignoreFilteredItems( const DirTreeFilter * filter )
+{
+    if ( ! _root || ! filter )
+	return;
+
+    sendStartingUpdate();
+    thawFiles( _root );		// The filter has to see those files, too
+    moveFilteredToAttic( _root, filter );
+
+    // While reading, finalizeTree() takes care of the directories that are
+    // left without unignored items; afterwards, that has to be done here.
+
+    if ( _isBusy )
+	recalc( _root );
+    else
+	moveIgnoredToAttic( _root );
+
+    sendUpdateFinished();
+}
+
+
+void DirTree::moveFilteredToAttic( DirInfo * dir, const DirTreeFilter * filter )
+{
+    // The non-directory children are in the dot entry if there is one
+
+    DirInfo *	 filesDir = dir->dotEntry() ? dir->dotEntry() : dir;
+    FileInfoList ignoredChildren;
+    QString	 dirPath;
+
+    for ( FileInfo * child = filesDir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() )
+	    continue;
+
+	if ( dirPath.isEmpty() )
+	    dirPath = dir->url();
+
+	if ( filter->ignore( dirPath, child->name() ) )
+	    ignoredChildren << child;
+    }
+
+    foreach ( FileInfo * child, ignoredChildren )
+	filesDir->moveToAttic( child );
+
+    if ( ! ignoredChildren.isEmpty() )
+	markCacheDirty( dir );
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() && ! child->isDotEntry() )
+	    moveFilteredToAttic( child->toDirInfo(), filter );
+    }
+}
+
+
+void DirTree::clearFilters()
+{
+    delete _filterChain;
+    _filterChain = 0;
+
+    qDeleteAll( _filters );
+    _filters.clear();
+}
+
+
+DirTreeFilterChain * DirTree::filterChain()
 {
-    if ( _excludeRules )
-	delete _excludeRules;
-
-#if VERBOSE_EXCLUDE_RULES
-    if ( newRules )
-    {
-	logDebug() << "New tmp exclude rules:" << endl;
-
-	for ( ExcludeRuleListIterator it = newRules->begin(); it != newRules->end(); ++it )
-	{
-	    logDebug() << *it << endl;
-	}
-    }
-    else
+    if ( ! _filterChain )
     {
-	logDebug() << "Clearing tmp exclude rules" << endl;
+	_filterChain = new DirTreeFilterChain( _filters );
+	CHECK_NEW( _filterChain );
     }
-#endif
 
-    _excludeRules = newRules;
+    return _filterChain;
 }
 
 
-void DirTree::addFilter( DirTreeFilter * filter )
+void DirTree::resetRuleStats()
 {
-    if ( filter )
-	_filters << filter;
+    if ( ! RuleStats::enabled() )
+	return;
+
+    ExcludeRules::instance()->resetStats();
+
+    if ( _excludeRules )
+	_excludeRules->resetStats();
+
+    if ( ! _filters.isEmpty() )
+	filterChain()->resetStats();
 }
 
 
-void DirTree::clearFilters()
+void DirTree::logRuleStats()
 {
-    qDeleteAll( _filters );
-    _filters.clear();
+    if ( ! RuleStats::enabled() )
+	return;
+
+    ExcludeRules::instance()->logStats( "Exclude rules:" );
+
+    if ( _excludeRules )
+	_excludeRules->logStats( "Exclude rules of this tree:" );
+
+    if ( ! _filters.isEmpty() )
+	filterChain()->logStats();
 }
 
 
 bool DirTree::checkIgnoreFilters( const QString & path )
 {
-    foreach ( DirTreeFilter * filter, _filters )
-    {
-	if ( filter->ignore( path ) )
-	    return true;
-    }
+    if ( _filters.isEmpty() )
+	return false;
 
-    return false;
+    return filterChain()->ignore( path );
+}
+
+
+bool DirTree::checkIgnoreFilters( const QString & dirPath, const QString & name )
+{
+    if ( _filters.isEmpty() )
+	return false;
+
+    return filterChain()->ignore( dirPath, name );
 }
 
 
@@ -527,35 +2191,57 @@ void DirTree::moveIgnoredToAttic( DirInfo * dir )
 {
     CHECK_PTR( dir );
 
-    if ( dir->totalIgnoredItems() == 0 && dir->totalUnignoredItems() > 0 )
+    // Files that were ignored during reading are already in the attics, so
+    // all that is left is the directories. This is one bottom-up pass that
+    // visits each directory once: The sums of the subdirectories are up to
+    // date when their parent decides what to move.
+
+    FileInfo * child = dir->firstChild();
+
+    while ( child )
+    {
+	if ( child->isDirInfo() )
+	    moveIgnoredToAttic( child->toDirInfo() );
+
+	child = child->next();
+    }
+
+    if ( dir->dotEntry() )
+	recalc( dir->dotEntry() );
+
+    if ( dir->attic() )
+	recalc( dir->attic() );
+
+    dir->recalc();
+
+    // If nothing in this subtree is left unignored, the parent moves all of
+    // it to its attic, so there is no need to move anything here.
+
+    if ( dir->parent() && dir->totalUnignoredItems() == 0 )
 	return;
 
     // Not using FileInfoIterator because we don't want to iterate over the dot
     // entry as well, just the normal children.
 
-    FileInfo * child = dir->firstChild();
     FileInfoList ignoredChildren;
 
-    while ( child )
+    for ( child = dir->firstChild(); child; child = child->next() )
     {
-	if ( child->isIgnored() )
+	// Ignore empty dirs (i.e. dirs without any unignored non-directory
+	// child), too
+
+	if ( child->isIgnored() ||
+	     ( child->isDirInfo() && child->totalUnignoredItems() == 0 ) )
 	{
 	    // Don't move the child right here, otherwise the iteration breaks
 	    ignoredChildren << child;
 	}
-	else
-	{
-	    if ( child->isDirInfo() )
-		moveIgnoredToAttic( child->toDirInfo() );
-	}
-
-	child = child->next();
     }
 
-
     foreach ( FileInfo * child, ignoredChildren )
     {
 	// logDebug() << "Moving ignored " << child << " to attic" << endl;
+	child->setIgnored( true );
 	dir->moveToAttic( child );
 
 	if ( child->isDirInfo() )
@@ -564,6 +2250,7 @@ void DirTree::moveIgnoredToAttic( DirInfo * dir )
 
     if ( ! ignoredChildren.isEmpty() )
     {
+	markCacheDirty( dir );
 	dir->recalc();
 
 	if ( dir->attic() )
@@ -572,36 +2259,6 @@ void DirTree::moveIgnoredToAttic( DirInfo * dir )
 }
 
 
-void DirTree::ignoreEmptyDirs( DirInfo * dir )
-{
-    CHECK_PTR( dir );
-
-    FileInfo * child = dir->firstChild();
-    FileInfoList ignoredChildren;
-
-    while ( child )
-    {
-	if ( ! child->isIgnored() && child->isDirInfo() )
-	{
-	    DirInfo * subDir = child->toDirInfo();
-
-	    if ( subDir->totalUnignoredItems() == 0 )
-		// && ! subDir->isMountPoint()
-	    {
-		// logDebug() << "Ignoring empty subdir " << subDir << endl;
-		subDir->setIgnored( true );
-	    }
-	    else
-	    {
-		ignoreEmptyDirs( subDir );
-	    }
-	}
-
-	child = child->next();
-    }
-}
-
-
 void DirTree::unatticAll( DirInfo * dir )
 {
     CHECK_PTR( dir );
@@ -609,6 +2266,7 @@ void DirTree::unatticAll( DirInfo * dir )
     if ( dir->attic() )
     {
 	// logDebug() << "Moving all attic children to the normal children list for " << dir << endl;
+	markCacheDirty( dir );
 	dir->takeAllChildren( dir->attic() );
 	dir->deleteEmptyAttic();
 	dir->recalc();
@@ -650,6 +2308,111 @@ void DirTree::recalc( DirInfo * dir )
 }
 
 
+void DirTree::clearCategoryIds( int generation )
+{
+    _categoryGeneration = generation;
+    clearCategoryIds( _root );
+}
+
+
+void DirTree::clearCategoryIds( DirInfo * dir )
+{
+    CHECK_PTR( dir );
+
+    FileInfo * child = dir->firstChild();
+
+    while ( child )
+    {
+	if ( child->isDirInfo() )
+	    clearCategoryIds( child->toDirInfo() );
+	else
+	    child->setCategoryId( UnknownCategoryId );
+
+	child = child->next();
+    }
+
+    if ( dir->dotEntry() )
+	clearCategoryIds( dir->dotEntry() );
+
+    if ( dir->attic() )
+	clearCategoryIds( dir->attic() );
+}
+
+
+void DirTree::sortCacheUsed( DirInfo * dir, int entries )
+{
+    if ( _beingDestroyed )
+	return;
+
+    SortCacheUse & use = _sortCaches[ dir ];
+    _sortCacheEntries += entries - use.entries;
+    use.entries = entries;
+    use.lastUse = ++_sortCacheClock;
+
+    if ( _sortCacheEntries > SORT_CACHE_MAX_ENTRIES )
+	evictSortCaches( dir );
+}
+
+
+void DirTree::sortCacheDropped( DirInfo * dir )
+{
+    if ( _beingDestroyed )
+	return;
+
+    QHash<DirInfo *, SortCacheUse>::iterator it = _sortCaches.find( dir );
+
+    if ( it != _sortCaches.end() )
+    {
+	_sortCacheEntries -= it.value().entries;
+	_sortCaches.erase( it );
+    }
+}
+
+
+void DirTree::dropSortCaches()
+{
+    foreach ( DirInfo * dir, _sortCaches.keys() )
+	dir->dropSortCache();
+
+    _sortCaches.clear();
+    _sortCacheEntries = 0;
+}
+
+
+void DirTree::evictSortCaches( DirInfo * keep )
+{
+    QVector<QPair<quint64, DirInfo *> > byAge;
+    byAge.reserve( _sortCaches.size() );
+
+    for ( QHash<DirInfo *, SortCacheUse>::const_iterator it = _sortCaches.constBegin();
+	  it != _sortCaches.constEnd();
+	  ++it )
+    {
+	byAge << qMakePair( it.value().lastUse, it.key() );
+    }
+
+    std::sort( byAge.begin(), byAge.end() );
+
+    // Drop a good part at once so this doesn't happen again with the next
+    // directory that the view opens
+
+    qint64 target  = SORT_CACHE_MAX_ENTRIES / 4 * 3;
+    int	   dropped = 0;
+
+    for ( int i = 0; i < byAge.size() && _sortCacheEntries > target; ++i )
+    {
+	if ( byAge.at( i ).second != keep )
+	{
+	    byAge.at( i ).second->dropSortCache();
+	    ++dropped;
+	}
+    }
+
+    logDebug() << "Dropped " << dropped << " sort caches; "
+	       << _sortCacheEntries << " entries left" << endl;
+}
+
+
 void DirTree::detectClusterSize( FileInfo * item )
 {
     if ( item &&
@@ -667,3 +2430,199 @@ void DirTree::detectClusterSize( FileInfo * item )
                    << endl;
     }
 }
+
+
+QString DirTree::sharedName( const QString & name )
+{
+    if ( name.isEmpty() )
+	return name;
+
+    // This is only used from the GUI thread
+
+    static QVector<QString> nameCache( NAME_CACHE_SIZE );
+
+    QString & cached = nameCache[ qHash( name ) & ( NAME_CACHE_SIZE - 1 ) ];
+
+    if ( cached != name )	// Not in the cache: Replace that cache entry
+	cached = name;
+
+    return cached;
+}
+
+
+int DirTree::readThreadCount( bool networkMount ) const
+{
+    int threads = networkMount ? _networkReadThreads : _readThreads;
+
+    if ( threads == 0 )		// automatic
+    {
+	threads = QThread::idealThreadCount();
+
+	if ( networkMount )
+	    threads *= 4;
+    }
+
+    // With a rate limit, the stat() calls wait most of the time. Let them
+    // wait in a worker thread, not in the GUI thread.
+
+    if ( _readThrottle.isActive() )
+	threads = qMax( threads, 2 );
+
+    return threads;
+}
+
+
+void DirTree::setupReadWorkerPool( bool networkMount )
+{
+    int threads = readThreadCount( networkMount );
+
+    if ( _idleIoPriority )	// for the directories read in this thread
+	SysUtil::setIdleIoPriority();
+
+    if ( threads > 1 )
+    {
+	if ( _readWorkerPool )
+	    _readWorkerPool->setThreadCount( threads );
+	else
+	{
+	    _readWorkerPool = new DirReadWorkerPool( this, threads );
+	    CHECK_NEW( _readWorkerPool );
+	}
+
+	_readWorkerPool->setUseIoUring( networkMount && _useIoUring );
+	_readWorkerPool->setInodeOrder( ! networkMount && useInodeOrder() );
+	_readWorkerPool->setIdleIoPriority( _idleIoPriority );
+
+	DirReadScheduler::instance()->setTopology( _readTopology );
+    }
+    else if ( _readWorkerPool )
+    {
+	logInfo() << "Reading directories only in the main thread" << endl;
+
+	delete _readWorkerPool;
+	_readWorkerPool = 0;
+    }
+}
+
+
+DirReadWorkerPool * DirTree::readWorkerPool( FileInfo * dir )
+{
+    FileInfo * toplevel = firstToplevel();
+
+    if ( ! dir || ! toplevel || dir->device() == toplevel->device() )
+	return _readWorkerPool;
+
+    dev_t device = dir->device();
+
+    QHash<dev_t, DirReadWorkerPool *>::const_iterator it =
+	_deviceReadWorkerPools.constFind( device );
+
+    if ( it != _deviceReadWorkerPools.constEnd() )
+	return it.value();
+
+    // The first directory on another filesystem, i.e. its mount point
+
+    MountPoint * mountPoint = MountPoints::findByDeviceId( device );
+
+    if ( ! mountPoint )
+	mountPoint = MountPoints::findNearestMountPoint( dir->url() );
+
+    bool networkMount = mountPoint && mountPoint->isNetworkMount();
+    int  threads      = readThreadCount( networkMount );
+    DirReadWorkerPool * pool = 0;
+
+    if ( threads > 1 )
+    {
+	logInfo() << "Reading " << dir->url() << " with " << threads << " threads" << endl;
+
+	pool = new DirReadWorkerPool( this, threads );
+	CHECK_NEW( pool );
+
+	pool->setUseIoUring( networkMount && _useIoUring );
+	pool->setInodeOrder( ! networkMount && _inodeOrderOnRotational &&
+			     SysUtil::isOnRotationalDisk( dir->url() ) );
+	pool->setIdleIoPriority( _idleIoPriority );
+    }
+
+    _deviceReadWorkerPools.insert( device, pool );	// 0: GUI thread only
+
+    return pool;
+}
+
+
+QList<DirReadWorkerPool *> DirTree::readWorkerPools() const
+{
+    QList<DirReadWorkerPool *> pools;
+
+    if ( _readWorkerPool )
+	pools << _readWorkerPool;
+
+    foreach ( DirReadWorkerPool * pool, _deviceReadWorkerPools )
+    {
+	if ( pool )
+	    pools << pool;
+    }
+
+    return pools;
+}
+
+
+void DirTree::deleteDeviceReadWorkerPools()
+{
+    qDeleteAll( _deviceReadWorkerPools );
+    _deviceReadWorkerPools.clear();
+}
+
+
+bool DirTree::useInodeOrder() const
+{
+    return _inodeOrderOnRotational && SysUtil::isOnRotationalDisk( _url );
+}
+
+
+void DirTree::setWatchTree( bool watch )
+{
+    if ( watch == watchTree() )
+	return;
+
+    if ( watch )
+    {
+	_watcher = new DirTreeWatcher( this );
+	CHECK_NEW( _watcher );
+
+	_watcher->setUpdateInterval( _watchUpdateMillisec );
+
+	if ( ! _isBusy )	// otherwise it starts when reading is finished
+	    _watcher->start();
+    }
+    else
+    {
+	delete _watcher;
+	_watcher = 0;
+    }
+}
+
+
+void DirTree::setWatchUpdateMillisec( int millisec )
+{
+    _watchUpdateMillisec = millisec;
+
+    if ( _watcher )
+	_watcher->setUpdateInterval( millisec );
+}
+
+
+void DirTree::setScanHosts( const QStringList & hosts )
+{
+    if ( _scanCoordinator )
+    {
+	delete _scanCoordinator;
+	_scanCoordinator = 0;
+    }
+
+    if ( ! hosts.isEmpty() )
+    {
+	_scanCoordinator = new ScanCoordinator( this, hosts );
+	CHECK_NEW( _scanCoordinator );
+    }
+}
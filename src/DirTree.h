@@ -17,9 +17,25 @@
 #include <stdlib.h>
 
 #include <QList>
+#include <QVector>
+#include <QSet>
+#include <QHash>
+#include <QAtomicInt>
+#include <QTimer>
+#include <QThread>
+#include <QStringList>
 
 #include "DirReadJob.h"
+#include "DirReadWorkerPool.h"
+#include "BulkInodeTable.h"
 #include "PkgFilter.h"
+#include "HardLinkTable.h"
+#include "DirReadStats.h"
+#include "ReadThrottle.h"
+#include "SizeEstimator.h"
+#include "QuotaUsage.h"
+#include "MemoryBudget.h"
+#include "ScanProgress.h"
 
 
 namespace QDirStat
@@ -29,6 +45,15 @@ namespace QDirStat
     class FileInfoSet;
     class ExcludeRules;
     class DirTreeFilter;
+    class DirTreeFilterChain;
+    class DirTreePkgFilter;
+    class PkgFileListCache;
+    class DirReadWorkerPool;
+    class DirTreeWatcher;
+    class ScanCoordinator;
+    class TreeWriterThread;
+    struct CacheBlockInfo;
+    class FileSpillStore;
 
 
     /**
@@ -81,6 +106,13 @@ namespace QDirStat
 	 **/
 	void abortReading();
 
+	/**
+	 * Emit childrenAdded() for the children that were added since the
+	 * last time. Call this before deleting any children without
+	 * deletingChildNotify() or clearSubtree().
+	 **/
+	void sendChildrenAdded();
+
 	/**
 	 * Refresh a subtree, i.e. read its contents from disk again.
 	 *
@@ -89,16 +121,33 @@ namespace QDirStat
 	 * become invalid (a subtreeDeleted() signal will be emitted to notify
 	 * about that fact).
 	 *
+	 * With incrementalRefresh(), only the directories that changed are
+	 * rebuilt. The views are notified with clearingSubtree() and
+	 * subtreeCleared() just the same.
+	 *
 	 * When 0 is passed, the entire tree will be refreshed, i.e. from the
 	 * first toplevel element on.
 	 **/
 	void refresh( DirInfo * subtree = 0 );
 
 	/**
-	 * Refresh a number of subtrees.
+	 * Refresh a number of subtrees: The directories of the items in
+	 * 'refreshSet' (a file stands for its parent directory) are reduced
+	 * to a set of disjoint subtrees that are all read at the same time,
+	 * with one startingReading() and one finished() signal.
 	 **/
 	void refresh( const FileInfoSet & refreshSet );
 
+	/**
+	 * Check the whole tree against the filesystem like an incremental
+	 * refresh, no matter if incrementalRefresh() is set: Only the
+	 * directories whose mtime changed are read again. This is for a
+	 * tree that was just read from a cache file of the same directory,
+	 * e.g. a SessionSnapshot. Return 'false' if the tree can't be
+	 * checked like that.
+	 **/
+	bool verify();
+
 	/**
 	 * Delete a subtree.
 	 **/
@@ -158,7 +207,8 @@ namespace QDirStat
 	void clear();
 
 	/**
-	 * Clear all items, exclude rules and filters of this tree.
+	 * Clear all items, exclude rules and filters of this tree and switch
+	 * off estimate mode.
 	 **/
 	void reset();
 
@@ -166,8 +216,11 @@ namespace QDirStat
 	 * Locate a child somewhere in the tree whose URL (i.e. complete path)
 	 * matches the URL passed. Returns 0 if there is no such child.
 	 *
-	 * Notice: This is a very expensive operation since the entire tree is
-	 * searched recursively.
+	 * Unless the locate index is disabled (see useLocateIndex()), this
+	 * first looks up the URL and then its parent directories in the
+	 * index, so only the part of the tree below the nearest indexed
+	 * directory is searched. Otherwise this is a very expensive
+	 * operation since the entire tree is searched recursively.
 	 *
 	 * 'findPseudoDirs' specifies if locating pseudo directories like "dot
 	 * entries" (".../<Files>") or "attics" (".../<Ignored>") is desired.
@@ -207,6 +260,370 @@ namespace QDirStat
 	void setCrossFilesystems( bool doCross )
 	    { _crossFilesystems = doCross; }
 
+	/**
+	 * Return the number of worker threads for reading local directories
+	 * in parallel. 0 means "automatic", i.e. one thread for each CPU core;
+	 * 1 means no parallel reading; everything is read in the GUI thread
+	 * (in time slices) like in classic QDirStat.
+	 **/
+	int readThreads() const { return _readThreads; }
+
+	/**
+	 * Set the number of worker threads for reading local directories.
+	 * See readThreads() for details. This takes effect with the next
+	 * startReading().
+	 **/
+	void setReadThreads( int threads ) { _readThreads = threads; }
+
+	/**
+	 * Return the number of worker threads for reading directories on a
+	 * network filesystem (NFS, Samba). Since reading there is mostly
+	 * waiting for the server, this should be considerably more than the
+	 * number of CPU cores. 0 means "automatic", i.e. 4 threads for each
+	 * CPU core.
+	 **/
+	int networkReadThreads() const { return _networkReadThreads; }
+
+	/**
+	 * Set the number of worker threads for network filesystems.
+	 * See networkReadThreads() for details.
+	 **/
+	void setNetworkReadThreads( int threads )
+	    { _networkReadThreads = threads; }
+
+	/**
+	 * Return 'true' if directories on a network filesystem should be
+	 * read with batched asynchronous statx() calls through io_uring if
+	 * the kernel supports that (Linux 5.6 and later).
+	 **/
+	bool useIoUring() const { return _useIoUring; }
+
+	/**
+	 * Enable or disable io_uring for network filesystems.
+	 * See useIoUring() for details.
+	 **/
+	void setUseIoUring( bool use ) { _useIoUring = use; }
+
+	/**
+	 * Return 'true' if the directories on a rotational disk should be
+	 * read in inode order (see DirReadWorkerPool::setInodeOrder()) to
+	 * minimize the seeks.
+	 **/
+	bool inodeOrderOnRotational() const { return _inodeOrderOnRotational; }
+
+	/**
+	 * Enable or disable reading in inode order on rotational disks.
+	 * See inodeOrderOnRotational() for details.
+	 **/
+	void setInodeOrderOnRotational( bool enable )
+	    { _inodeOrderOnRotational = enable; }
+
+	/**
+	 * Return the maximum number of stat() calls per second while reading
+	 * local directories (in all threads together) or 0 for no limit.
+	 * This is for scanning busy production servers.
+	 **/
+	int statRateLimit() const { return _readThrottle.rate(); }
+
+	/**
+	 * Set the maximum number of stat() calls per second.
+	 * See statRateLimit() for details.
+	 **/
+	void setStatRateLimit( int rate ) { _readThrottle.setRate( rate ); }
+
+	/**
+	 * Return 'true' if directories are read with the "idle" I/O
+	 * scheduling class (see ionice(1)), i.e. only when no other process
+	 * needs the disk.
+	 **/
+	bool idleIoPriority() const { return _idleIoPriority; }
+
+	/**
+	 * Enable or disable the idle I/O scheduling class for reading
+	 * directories. Once it is enabled, it stays in effect for the threads
+	 * that already used it until the program exits.
+	 **/
+	void setIdleIoPriority( bool idle ) { _idleIoPriority = idle; }
+
+	/**
+	 * Return how the threads for reading directories are placed on the
+	 * NUMA nodes of the machine (see DirReadScheduler::setTopology()).
+	 **/
+	ReadTopology readTopology() const { return _readTopology; }
+
+	/**
+	 * Set how the threads for reading directories are placed on the
+	 * NUMA nodes. This takes effect with the next read. Since all trees
+	 * share the same threads, the last tree that starts reading wins.
+	 **/
+	void setReadTopology( ReadTopology topology ) { _readTopology = topology; }
+
+	/**
+	 * Return 'true' if the stat data of all inodes are read in bulk
+	 * before reading a complete filesystem, i.e. if the URL of
+	 * startReading() is a mount point of a filesystem that supports that
+	 * (see BulkInodeTable).
+	 **/
+	bool bulkStat() const { return _bulkStat; }
+
+	/**
+	 * Enable or disable reading the inodes in bulk.
+	 * See bulkStat() for details.
+	 **/
+	void setBulkStat( bool enable ) { _bulkStat = enable; }
+
+	/**
+	 * Return the inodes that were read in bulk for the current read or
+	 * a null pointer if there are none. The worker threads keep a
+	 * reference while they use it.
+	 **/
+	BulkInodeTablePtr bulkInodeTable() const { return _bulkInodeTable; }
+
+	/**
+	 * Return 'true' if refresh() keeps the subtree and only reads the
+	 * directories again whose mtime changed (see IncrementalDirReadJob).
+	 * This is much faster for a large tree with only a few changes, but
+	 * a file that was modified in place does not change the mtime of its
+	 * directory, so its new size is not noticed.
+	 **/
+	bool incrementalRefresh() const { return _incrementalRefresh; }
+
+	/**
+	 * Enable or disable incremental refresh.
+	 * See incrementalRefresh() for details.
+	 **/
+	void setIncrementalRefresh( bool incremental ) { _incrementalRefresh = incremental; }
+
+	/**
+	 * Return 'true' if locate() uses an index of the directory URLs.
+	 *
+	 * The index is filled with the directories that locate() finds, and
+	 * their entries are removed when they are deleted or cleared. So
+	 * repeated lookups of the same directory or of items in it, like
+	 * those of the cache reader or when refreshing many items, are only
+	 * a hash lookup.
+	 **/
+	bool useLocateIndex() const { return _useLocateIndex; }
+
+	/**
+	 * Enable or disable the locate index.
+	 * See useLocateIndex() for details.
+	 **/
+	void setUseLocateIndex( bool use );
+
+	/**
+	 * Return the table of the hard-linked inodes found while reading
+	 * this tree. This is only used if the size of hard links is counted
+	 * only once (see FileInfo::setCountHardLinksOnce()). It is cleared
+	 * along with the tree.
+	 **/
+	HardLinkTable * hardLinkTable() { return &_hardLinkTable; }
+
+	/**
+	 * Return 'true' if the tree is kept up to date with the changes in
+	 * the filesystem after it was read (see DirTreeWatcher).
+	 **/
+	bool watchTree() const { return _watcher != 0; }
+
+	/**
+	 * Enable or disable watching the tree for changes.
+	 * See watchTree() for details.
+	 **/
+	void setWatchTree( bool watch );
+
+	/**
+	 * Return the minimum time in milliseconds between two updates of a
+	 * watched tree.
+	 **/
+	int watchUpdateMillisec() const { return _watchUpdateMillisec; }
+
+	/**
+	 * Set the minimum time in milliseconds between two updates of a
+	 * watched tree.
+	 **/
+	void setWatchUpdateMillisec( int millisec );
+
+	/**
+	 * Distribute reading the subdirectories of the toplevel directory
+	 * over the hosts 'hosts' (see ScanCoordinator). An empty list reads
+	 * everything locally again.
+	 **/
+	void setScanHosts( const QStringList & hosts );
+
+	/**
+	 * Return the coordinator for a distributed scan or 0 if everything is
+	 * read locally.
+	 **/
+	ScanCoordinator * scanCoordinator() const { return _scanCoordinator; }
+
+	/**
+	 * Return the worker pool for parallel reading or 0 if directories are
+	 * read only in the GUI thread.
+	 **/
+	DirReadWorkerPool * readWorkerPool() const { return _readWorkerPool; }
+
+	/**
+	 * Return the worker pool for reading directory 'dir' or 0 if it is
+	 * read only in the GUI thread.
+	 *
+	 * With crossFilesystems(), each filesystem other than the one of the
+	 * toplevel directory gets a pool of its own, with the number of
+	 * threads for its filesystem type (see readThreads() and
+	 * networkReadThreads()). That pool is created the first time a
+	 * directory on that filesystem is read. This way, a slow network
+	 * mount does not hold up reading a local disk and vice versa.
+	 **/
+	DirReadWorkerPool * readWorkerPool( FileInfo * dir );
+
+	/**
+	 * Return all worker pools for parallel reading.
+	 **/
+	QList<DirReadWorkerPool *> readWorkerPools() const;
+
+	/**
+	 * Return the performance counters of reading this tree: Throughput,
+	 * stat() latencies, queue depth. They are cleared whenever reading
+	 * starts, and a summary is logged when it is finished.
+	 **/
+	DirReadStats * readStats() { return &_readStats; }
+
+	/**
+	 * Return the progress of reading compared with the used inodes of
+	 * the filesystems. This is only valid while reading a directory
+	 * tree from the start; it is not updated automatically, call
+	 * updateScanProgress() first.
+	 **/
+	const ScanProgress & scanProgress() const { return _scanProgress; }
+
+	/**
+	 * Update the scan progress from the read statistics.
+	 **/
+	void updateScanProgress() { _scanProgress.update( _readStats ); }
+
+	/**
+	 * Return the rate limit for reading this tree or 0 if there is
+	 * none. This may be called from any thread.
+	 **/
+	ReadThrottle * readThrottle()
+	    { return _readThrottle.isActive() ? &_readThrottle : 0; }
+
+	/**
+	 * Return the estimator for estimate mode (see SizeEstimator).
+	 **/
+	SizeEstimator * sizeEstimator() { return &_sizeEstimator; }
+
+	/**
+	 * Return 'true' if startReading() only reads a sample of the deeper
+	 * levels and estimates the rest.
+	 **/
+	bool estimateMode() const { return _estimateMode; }
+
+	/**
+	 * Enable or disable estimate mode for the next startReading().
+	 * Refreshing a subtree always reads it completely.
+	 **/
+	void setEstimateMode( bool estimate ) { _estimateMode = estimate; }
+
+	/**
+	 * Return what to do with the subtree totals that the filesystem keeps
+	 * track of anyway (see QuotaUsage): The usage of a mounted filesystem
+	 * and of project quotas and btrfs qgroups.
+	 **/
+	QuotaMode quotaMode() const { return _quotaMode; }
+
+	/**
+	 * Set what to do with those subtree totals.
+	 **/
+	void setQuotaMode( QuotaMode mode ) { _quotaMode = mode; }
+
+	/**
+	 * Return the totals of 'dir' according to the filesystem or 0 if
+	 * there are none.
+	 **/
+	const QuotaTotals * quotaTotals( const DirInfo * dir ) const
+	    {
+		QHash<const DirInfo *, QuotaTotals>::const_iterator it = _quotaTotals.constFind( dir );
+		return it == _quotaTotals.constEnd() ? 0 : &it.value();
+	    }
+
+	/**
+	 * Query the filesystem for the totals of the new subdirectory 'dir'
+	 * if it is a mount point or the top of a project or a subvolume.
+	 * Return 'true' if it should not be read because it became a quota
+	 * placeholder with those totals.
+	 **/
+	bool readQuotaTotals( DirInfo * dir );
+
+	/**
+	 * Return the number of pending read jobs including the blocked ones.
+	 **/
+	int queuedReadJobs() const { return _jobQueue.count(); }
+
+	/**
+	 * Return the number of read jobs that are blocked, e.g. waiting for
+	 * an external process.
+	 **/
+	int blockedReadJobs() const { return _jobQueue.blockedCount(); }
+
+	/**
+	 * Hint from a view that the user is looking at 'item', e.g. because
+	 * it was expanded or selected: While reading, read the directory of
+	 * 'item' and everything below it before all other directories, so
+	 * the part of the tree the user is looking at is complete first.
+	 *
+	 * This only changes the order of the pending read jobs, both in the
+	 * job queue and in the worker pool. A new hint replaces the previous
+	 * one.
+	 **/
+	void prioritize( FileInfo * item );
+
+	/**
+	 * Return all directories with a read error in 'subtree' or, if
+	 * 'subtree' is 0, in the complete tree.
+	 *
+	 * The tree keeps an index of those directories, so this does not
+	 * have to traverse the tree.
+	 **/
+	QList<DirInfo *> errorDirs( FileInfo * subtree = 0 ) const;
+
+	/**
+	 * Notification that the read error status of 'dir' changed: Add it
+	 * to the index of directories with a read error or remove it.
+	 *
+	 * DirInfo::setReadState() calls this.
+	 **/
+	void updateErrorDirs( DirInfo * dir );
+
+	/**
+	 * Notification that 'dir' with a read error is about to be deleted.
+	 **/
+	void forgetErrorDir( DirInfo * dir );
+
+	/**
+	 * Return the subtree that is read first or 0 if there is none.
+	 **/
+	DirInfo * prioritizedSubtree() const { return _prioritizedSubtree; }
+
+	/**
+	 * Return 'true' if 'dir' is in the subtree that is read first.
+	 **/
+	bool isPrioritized( const DirInfo * dir ) const;
+
+	/**
+	 * Return a string with the same content as 'name' that shares its
+	 * data with the names of other nodes if possible: Names like
+	 * "index.js", "__init__.py", ".git", "LICENSE" occur thousands of
+	 * times in a typical tree, and a QString for each of them would need
+	 * its own heap buffer.
+	 *
+	 * This uses a fixed-size cache of recently used names, so the
+	 * frequent names stay in the cache while the (many more) unique ones
+	 * come and go without using any additional memory. All trees in the
+	 * process share that cache, so two trees of similar directories also
+	 * share the names with each other.
+	 **/
+	QString sharedName( const QString & name );
+
 	/**
 	 * Notification that a child has been added.
 	 *
@@ -258,6 +675,16 @@ namespace QDirStat
 	 **/
 	void sendReadJobFinished( DirInfo * dir );
 
+	/**
+	 * Send a startingUpdate() signal.
+	 **/
+	void sendStartingUpdate();
+
+	/**
+	 * Send an updateFinished() signal.
+	 **/
+	void sendUpdateFinished();
+
 	/**
 	 * Returns 'true' if directory reading is in progress in this tree.
 	 **/
@@ -271,10 +698,513 @@ namespace QDirStat
 	bool writeCache( const QString & cacheFileName );
 
 	/**
-	 * Read a cache file.
+	 * Write the complete tree to a cache file in a background thread
+	 * (see CacheWriterThread) with startWriting().
+	 *
+	 * Returns false if the tree is being read or written.
+	 **/
+	bool startWritingCache( const QString & cacheFileName );
+
+	/**
+	 * Start 'thread' to write the complete tree in the background (e.g.
+	 * a CacheWriterThread or a TreeExporterThread) and send
+	 * writeProgress() signals while it is running and a treeWritten()
+	 * signal when it's done. This takes ownership of the thread.
+	 *
+	 * The tree must not change while it is being written: Anything that
+	 * would change it first waits until writing is finished; clear()
+	 * aborts writing.
+	 *
+	 * Returns false (and deletes the thread) if the tree is being read or
+	 * written.
+	 **/
+	bool startWriting( TreeWriterThread * thread );
+
+	/**
+	 * Return 'true' if the tree is being written in the background.
+	 **/
+	bool isWriting() const { return _writerThread != 0; }
+
+	/**
+	 * Wait until writing the tree in the background is finished.
+	 **/
+	void finishWriting();
+
+	/**
+	 * Abort writing the tree in the background and wait for that.
+	 **/
+	void abortWriting();
+
+	/**
+	 * Read a cache file. This can also be a file listing like the output
+	 * of "find" or a locate database (see ListingReadJob).
 	 **/
 	void readCache( const QString & cacheFileName );
 
+	/**
+	 * Read several cache files into one tree: The toplevel directory of
+	 * each of them becomes a child of a common toplevel directory
+	 * MERGED_CACHES_URL (see MergedCacheReadJob). With only one cache
+	 * file, this is the same as readCache().
+	 **/
+	void readCaches( const QStringList & cacheFileNames );
+
+	/**
+	 * Write a checkpoint (see CacheCheckpoint) to cache file 'fileName'
+	 * every 'intervalSec' seconds while reading directories, so reading
+	 * can be resumed with resumeReading() after a crash. The checkpoint is
+	 * removed when reading is finished; it is written once more when
+	 * reading is aborted. An empty 'fileName' disables checkpoints.
+	 **/
+	void setCheckpoint( const QString & fileName, int intervalSec );
+
+	/**
+	 * Read checkpoint 'fileName' and then read all the directories that
+	 * were not finished when it was written. Return 'false' if there is
+	 * no valid checkpoint.
+	 **/
+	bool resumeReading( const QString & fileName );
+
+	/**
+	 * Read directory 'url' with cache file 'cacheFileName' as a hint:
+	 * Read the cache file, then refresh the tree incrementally (see
+	 * IncrementalDirReadJob), i.e. read only the directories again whose
+	 * mtime changed since the cache file was written. For the others, the
+	 * content is taken from the cache without calling stat() for each
+	 * file.
+	 *
+	 * The tree is marked as clean for that cache file, so writing it
+	 * there again only writes the blocks that changed.
+	 *
+	 * If the cache file can't be read or is for another directory,
+	 * 'url' is read normally.
+	 **/
+	void rescanWithCache( const QString & url, const QString & cacheFileName );
+
+	/**
+	 * Read directory 'path' on host 'host' with qdirstat-cache-writer
+	 * over ssh or, if 'host' is empty, from the local qdirstat-daemon
+	 * (see RemoteReadJob).
+	 **/
+	void readRemote( const QString & host, const QString & path );
+
+	/**
+	 * Mark the cache block that contains 'item' as changed since the last
+	 * time the tree was written to a cache file. A cache block is the
+	 * subtree of one directory directly below the first toplevel item;
+	 * everything else (the toplevel item itself and its non-directory
+	 * children) is in the toplevel block. If 'item' is not in any block,
+	 * the whole tree is marked as changed.
+	 *
+	 * This is done automatically for all changes of the tree.
+	 **/
+	void markCacheDirty( FileInfo * item );
+
+	/**
+	 * Mark the whole tree as changed since the last cache file was
+	 * written.
+	 **/
+	void markCacheAllDirty();
+
+	/**
+	 * Return the generation of this tree: A number that changes whenever
+	 * anything in the tree changes and that is never used again, not even
+	 * by another tree. See also TreeSnapshot.
+	 **/
+	qint64 generation() const { return _generation; }
+
+	/**
+	 * Give the tree a new generation number.
+	 **/
+	void newGeneration();
+
+	/**
+	 * Give all directories pre-order labels if that is cheaper than about
+	 * 'checks' calls of FileInfo::isInSubtree() without them: With the
+	 * labels, each check is a comparison of two numbers instead of a walk
+	 * up the parent chain. Labeling takes one pass over all directories,
+	 * so this is for callers that are about to do many of those checks,
+	 * e.g. when killing the read jobs of a subtree.
+	 *
+	 * Adding a directory leaves the labels of all others valid (the new
+	 * one just has none yet, so the checks walk up to its nearest labeled
+	 * ancestor), but moving one to another parent invalidates all of them.
+	 *
+	 * Call this only in the GUI thread.
+	 **/
+	void updateSubtreeLabels( int checks );
+
+	/**
+	 * Return the generation of the current pre-order labels or 0 if
+	 * there are no valid ones. This may be called from any thread.
+	 **/
+	int subtreeLabelGeneration() const
+	    { return _subtreeLabelGeneration.loadAcquire(); }
+
+	/**
+	 * Return 'true' if all directories have valid pre-order labels.
+	 **/
+	bool subtreeLabelsComplete() const
+	    { return subtreeLabelGeneration() != 0 && _unlabeledDirs.loadAcquire() == 0; }
+
+	/**
+	 * Notification that a directory was moved to another parent: The
+	 * pre-order labels are no longer valid. This may be called from any
+	 * thread.
+	 **/
+	void invalidateSubtreeLabels() { _subtreeLabelGeneration.storeRelease( 0 ); }
+
+	/**
+	 * Notification that a directory was added that does not have a
+	 * pre-order label yet. This may be called from any thread.
+	 **/
+	void unlabeledDirAdded() { _unlabeledDirs.ref(); }
+
+	/**
+	 * Return 'true' if the cache block 'blockName' (the name of a
+	 * directory directly below the first toplevel item or an empty
+	 * string for the toplevel block) did not change since the tree was
+	 * written to 'cacheFileName'.
+	 **/
+	bool isCacheBlockClean( const QString & cacheFileName,
+				const QString & blockName ) const;
+
+	/**
+	 * Notification that the tree was just written to 'cacheFileName'
+	 * completely: All cache blocks are clean now.
+	 **/
+	void setCacheClean( const QString & cacheFileName );
+
+	/**
+	 * Return 'true' if reading a cache file only reads the toplevel
+	 * block (see markCacheDirty()) if the cache file has an index. The
+	 * directories of all other blocks become cache placeholders that
+	 * only have the summary from the index (total size, number of items
+	 * etc.) until they are needed, e.g. when they are expanded in the tree
+	 * view.
+	 *
+	 * A binary cache file needs no index: Only the toplevel directory and
+	 * its direct children are created, and each subdirectory is a
+	 * placeholder with the summary of its range of items in the
+	 * memory-mapped file. Reading a placeholder creates the next level
+	 * the same way.
+	 *
+	 * Anything that walks the tree sees only what was read so far, so
+	 * this is off by default.
+	 **/
+	bool lazyCacheLoading() const { return _lazyCacheLoading; }
+
+	/**
+	 * Enable or disable lazy loading of cache files.
+	 * See lazyCacheLoading() for details.
+	 **/
+	void setLazyCacheLoading( bool lazy ) { _lazyCacheLoading = lazy; }
+
+	/**
+	 * Return 'true' if text cache files are shared with other instances
+	 * on this host through a binary image in shared memory (see
+	 * SharedCacheImage): readCache() reads the image lazily if there is
+	 * one; otherwise it reads the cache file and writes the image when
+	 * it is finished.
+	 **/
+	bool shareCacheImages() const { return _shareCacheImages; }
+
+	/**
+	 * Enable or disable sharing cache files through binary images.
+	 * See shareCacheImages() for details.
+	 **/
+	void setShareCacheImages( bool share ) { _shareCacheImages = share; }
+
+	/**
+	 * Return 'true' if text cache files are written with delta-encoded
+	 * paths: Each full path only has the part that differs from the one
+	 * before it (see doc/cache-file-format.txt). This makes cache files
+	 * of deep trees much smaller and faster to read and write, but older
+	 * versions of QDirStat can't read them.
+	 **/
+	bool compactCachePaths() const { return _compactCachePaths; }
+
+	/**
+	 * Enable or disable delta-encoded paths in text cache files.
+	 * See compactCachePaths() for details.
+	 **/
+	void setCompactCachePaths( bool compact ) { _compactCachePaths = compact; }
+
+	/**
+	 * Return 'true' if the files (and other non-directories) of each
+	 * directory are moved out of memory to a temporary file (see
+	 * FileSpillStore) as soon as the directory is read, so only the
+	 * directories and their summaries stay in memory. The spilled
+	 * directories become cache placeholders that are loaded again when
+	 * they are needed, e.g. when they are expanded in the tree view. This
+	 * is for trees with so many files that they don't fit into memory.
+	 *
+	 * Like with lazyCacheLoading(), anything that walks the tree only sees
+	 * what is loaded, so this is off by default.
+	 **/
+	bool spillFiles() const { return _spillFiles; }
+
+	/**
+	 * Enable or disable spilling files for directories that are read
+	 * from now on. See spillFiles() for details.
+	 **/
+	void setSpillFiles( bool spill ) { _spillFiles = spill; }
+
+	/**
+	 * Return the directory for the spill file. If this is empty, the
+	 * default directory for temporary files is used; that might be a
+	 * tmpfs which uses memory, too.
+	 **/
+	const QString & spillDir() const { return _spillDir; }
+
+	/**
+	 * Set the directory for the spill file.
+	 **/
+	void setSpillDir( const QString & dir ) { _spillDir = dir; }
+
+	/**
+	 * Move the files of 'dir' (which was just read) to the spill file if
+	 * spillFiles() is enabled: Those of its dot entry or, if it has no
+	 * subdirectories, its own. That directory becomes a cache
+	 * placeholder.
+	 **/
+	void spillFiles( DirInfo * dir );
+
+	/**
+	 * Return 'true' if the files of directories that the views never
+	 * showed are frozen when reading is finished: They are moved to a
+	 * compact read-only buffer in memory (see FileSpillStore), and the
+	 * directories become cache placeholders that are thawed again when
+	 * they are needed, e.g. when they are expanded in the tree view or
+	 * refreshed incrementally. Most of a big tree is never opened, so this
+	 * saves a lot of memory.
+	 *
+	 * Like with spillFiles(), anything that walks the tree only sees the
+	 * files that are not frozen, so this is off by default.
+	 **/
+	bool freezeColdFiles() const { return _freezeColdFiles; }
+
+	/**
+	 * Enable or disable freezing files. See freezeColdFiles() for
+	 * details.
+	 **/
+	void setFreezeColdFiles( bool freeze ) { _freezeColdFiles = freeze; }
+
+	/**
+	 * Freeze the files of all directories in 'subtree' that the views
+	 * never showed if freezeColdFiles() is enabled.
+	 **/
+	void freezeColdFiles( DirInfo * subtree );
+
+	/**
+	 * Return the memory budget. See setMemoryBudget().
+	 **/
+	const MemoryBudget & memoryBudget() const { return _memoryBudget; }
+
+	/**
+	 * Set an upper limit for the resident memory of the program in
+	 * bytes; 0 means no limit. The memory is checked every second; the
+	 * closer it gets to the limit, the more caches are dropped and files
+	 * are frozen or spilled, and finally no more subdirectories are read
+	 * (see MemoryBudget).
+	 **/
+	void setMemoryBudget( qint64 bytes );
+
+	/**
+	 * Return 'true' if the memory budget is used up so no more
+	 * subdirectories should be read.
+	 **/
+	bool overMemoryBudget() const
+	    { return _memoryBudget.level() == MemoryBudget::Exhausted; }
+
+	/**
+	 * Load all spilled or frozen files in 'subtree' again.
+	 **/
+	void thawFiles( FileInfo * subtree );
+
+	/**
+	 * Return 'true' if the files of 'dir' are in the spill file or
+	 * frozen.
+	 **/
+	bool isSpilled( DirInfo * dir ) const;
+
+	/**
+	 * Load the spilled or frozen files of 'dir' again.
+	 **/
+	void loadSpilledFiles( DirInfo * dir );
+
+	/**
+	 * Load all spilled files again, e.g. before writing a cache file.
+	 **/
+	void loadSpilledFiles();
+
+	/**
+	 * Return 'true' if each directory keeps a contiguous vector of its
+	 * children after it is finalized (see DirInfo::childVector()), so
+	 * iterating over the children (FileInfoIterator) does not need to
+	 * follow the linked list of siblings. This needs 8 more bytes for
+	 * each item, so this is off by default.
+	 **/
+	bool contiguousChildren() const { return _contiguousChildren; }
+
+	/**
+	 * Enable or disable contiguous child vectors for directories that are
+	 * finalized from now on. See contiguousChildren() for details.
+	 **/
+	void setContiguousChildren( bool contiguous ) { _contiguousChildren = contiguous; }
+
+	/**
+	 * Return 'true' if each directory that has only files (like a dot
+	 * entry) keeps the sizes and mtimes of its files in contiguous arrays
+	 * after it is finalized (see FileColumns), so recalculating the
+	 * summaries and collecting statistics don't need to visit each file.
+	 * This needs 32 more bytes for each file, so this is off by default.
+	 **/
+	bool fileColumns() const { return _fileColumns; }
+
+	/**
+	 * Enable or disable file columns for directories that are finalized
+	 * from now on. See fileColumns() for details.
+	 **/
+	void setFileColumns( bool columns ) { _fileColumns = columns; }
+
+	/**
+	 * Return 'true' if the MIME category of each file is looked up right
+	 * when it is added to the tree while reading (from the file system
+	 * or from a cache file) and cached in the FileInfo, so the treemap
+	 * and the statistics don't need to do that later. This is off by
+	 * default; the categories are then cached when they are first
+	 * needed.
+	 **/
+	bool cacheCategories() const { return _cacheCategories; }
+
+	/**
+	 * Enable or disable looking up MIME categories while reading.
+	 * See cacheCategories() for details.
+	 **/
+	void setCacheCategories( bool cache ) { _cacheCategories = cache; }
+
+	/**
+	 * Return 'true' if the file age statistics use a summary of the
+	 * modification years and months that is cached in each directory
+	 * (see DirInfo::fileAgeSummary()), so only the first statistics for
+	 * any subtree need to traverse it. This needs some memory for each
+	 * directory, so this is off by default.
+	 **/
+	bool cacheFileAgeSummaries() const { return _cacheFileAgeSummaries; }
+
+	/**
+	 * Enable or disable cached file age summaries.
+	 * See cacheFileAgeSummaries() for details.
+	 **/
+	void setCacheFileAgeSummaries( bool cache ) { _cacheFileAgeSummaries = cache; }
+
+	/**
+	 * Return the MimeCategorizer generation that the category IDs cached
+	 * in the items of this tree belong to.
+	 **/
+	int categoryGeneration() const { return _categoryGeneration; }
+
+	/**
+	 * Discard the cached category IDs of all items because the MIME
+	 * categories changed, and start caching them for 'generation'.
+	 **/
+	void clearCategoryIds( int generation );
+
+	/**
+	 * Notification that the sorted children list of 'dir' (see
+	 * DirInfo::sortedChildren()) with 'entries' entries was just created
+	 * or used. If all those lists together have more than
+	 * SORT_CACHE_MAX_ENTRIES entries, the least recently used ones are
+	 * dropped (except the one of 'dir').
+	 **/
+	void sortCacheUsed( DirInfo * dir, int entries );
+
+	/**
+	 * Notification that the sorted children list of 'dir' was dropped.
+	 **/
+	void sortCacheDropped( DirInfo * dir );
+
+	/**
+	 * Drop the sorted children lists of all directories. This takes only
+	 * as long as there are such lists, no matter how large the tree is.
+	 **/
+	void dropSortCaches();
+
+	/**
+	 * Register the cache placeholder 'dir' whose content is block 'block'
+	 * of cache file 'cacheFileName'.
+	 **/
+	void addCachePlaceholder( DirInfo		* dir,
+				  const QString		& cacheFileName,
+				  const CacheBlockInfo	& block );
+
+	/**
+	 * Return 'true' if there are any cache placeholders in this tree
+	 * whose content was not read yet.
+	 **/
+	bool hasCachePlaceholders() const { return ! _cachePlaceholders.isEmpty(); }
+
+	/**
+	 * Return the absolute path of the cache file that the cache
+	 * placeholders belong to.
+	 **/
+	const QString & lazyCacheFile() const { return _lazyCacheFile; }
+
+	/**
+	 * Store the block of the cache placeholder 'dir' in 'block'. Return
+	 * 'false' if 'dir' is not a (registered) cache placeholder.
+	 **/
+	bool cachePlaceholderBlock( DirInfo * dir, CacheBlockInfo & block ) const;
+
+	/**
+	 * Start reading the content of the cache placeholder 'dir' with a
+	 * read job. This does nothing if 'dir' is not a cache placeholder or
+	 * if it is already being read.
+	 **/
+	void readCachePlaceholder( DirInfo * dir );
+
+	/**
+	 * Read the content of the cache placeholder 'dir' immediately.
+	 **/
+	void loadCachePlaceholder( DirInfo * dir );
+
+	/**
+	 * Read the content of all cache placeholders immediately, including
+	 * spilled files.
+	 **/
+	void loadCachePlaceholders();
+
+	/**
+	 * Forget all cache placeholders in 'subtree' (including 'subtree'
+	 * itself), e.g. because it is about to be deleted.
+	 **/
+	void forgetCachePlaceholders( FileInfo * subtree );
+
+	/**
+	 * Remove all directories in 'subtree' (including 'subtree' itself)
+	 * from the locate index, e.g. because it is about to be deleted.
+	 **/
+	void forgetLocateIndex( FileInfo * subtree );
+
+	/**
+	 * Give 'dir' and all directories below it the pre-order labels of
+	 * 'generation', starting with 'next'. Return the next unused label.
+	 **/
+	int labelSubtree( DirInfo * dir, int generation, int next );
+
+	/**
+	 * Forget the quota totals of all directories in 'subtree' (including
+	 * 'subtree' itself), e.g. because it is about to be deleted.
+	 **/
+	void forgetQuotaTotals( FileInfo * subtree );
+
+	/**
+	 * Notification that the lazy cache file was rewritten with the blocks
+	 * 'blocks': Update the offsets of the cache placeholders.
+	 **/
+	void updateCachePlaceholders( const QList<CacheBlockInfo> & blocks );
+
 	/**
 	 * Clear the tree and read a cache file.
 	 **/
@@ -324,17 +1254,48 @@ namespace QDirStat
 	void clearFilters();
 
 	/**
-	 * Iterate over all filters and return 'true' if any of them wants a
-	 * filesystem object to be ignored during directory reading, 'false'
-	 * if not.
+	 * Return 'true' if any filter wants a filesystem object to be ignored
+	 * during directory reading, 'false' if not.
+	 *
+	 * This uses a DirTreeFilterChain that combines all the filters.
 	 **/
 	bool checkIgnoreFilters( const QString & path );
 
+	/**
+	 * Return 'true' if any filter wants entry 'name' of directory
+	 * 'dirPath' to be ignored during directory reading, 'false' if not.
+	 *
+	 * This uses a DirTreeFilterChain that combines all the filters, so
+	 * the complete path of the entry is only needed for some patterns.
+	 **/
+	bool checkIgnoreFilters( const QString & dirPath, const QString & name );
+
 	/**
 	 * Return 'true' if there is any filter, 'false' if not.
 	 **/
 	bool hasFilters() const { return ! _filters.isEmpty(); }
 
+	/**
+	 * Move the items that were read before 'filter' (one of the filters
+	 * of this tree) could ignore anything to the attics, e.g. because the
+	 * file lists of a DirTreePkgFilter were not there yet when reading
+	 * started. This can be called while reading or afterwards; the views
+	 * are notified with startingUpdate() and updateFinished().
+	 **/
+	void ignoreFilteredItems( const DirTreeFilter * filter );
+
+	/**
+	 * Return the DirTreePkgFilter of this tree (i.e. in the unpackaged
+	 * files view) or 0 if there is none.
+	 **/
+	DirTreePkgFilter * pkgFilter() const;
+
+	/**
+	 * Return the file list cache of the packaged files if this tree has
+	 * a DirTreePkgFilter (i.e. in the unpackaged files view), 0 if not.
+	 **/
+	PkgFileListCache * pkgFileListCache() const;
+
 	/**
 	 * Return 'true' if this DirTree is in the process of being destroyed,
 	 * so any FileInfo / DirInfo pointers stored outside the tree might
@@ -364,9 +1325,23 @@ namespace QDirStat
 
 	/**
 	 * Emitted when a child has been added.
+	 *
+	 * This is only emitted if anything is connected to it. Prefer
+	 * childrenAdded(): Emitting a signal for every single item is a
+	 * significant part of the time of reading a large tree.
 	 **/
 	void childAdded( FileInfo * newChild );
 
+	/**
+	 * Emitted for a batch of children that were added: As soon as the
+	 * application is back in the event loop, when the batch is full, and
+	 * before any child is deleted, so a receiver never gets a child that
+	 * was already deleted. The children may have different parents.
+	 *
+	 * This is only emitted if anything is connected to it.
+	 **/
+	void childrenAdded( const FileInfoList & newChildren );
+
 	/**
 	 * Emitted when the tree is about to be cleared.
 	 **/
@@ -424,6 +1399,18 @@ namespace QDirStat
 	 **/
 	void readJobFinished( DirInfo * dir );
 
+	/**
+	 * Emitted when the tree is about to be updated from filesystem
+	 * events (see watchTree()): Children are added and deleted with the
+	 * usual signals until updateFinished() is emitted.
+	 **/
+	void startingUpdate();
+
+	/**
+	 * Emitted when updating the tree from filesystem events is finished.
+	 **/
+	void updateFinished();
+
 	/**
 	 * Single line progress information, emitted when the read status
 	 * changes - typically when a new directory is being read. Connect to a
@@ -431,6 +1418,29 @@ namespace QDirStat
 	 **/
 	void progressInfo( const QString & infoLine );
 
+	/**
+	 * Emitted from time to time while writing the tree in the
+	 * background (see startWriting()).
+	 **/
+	void writeProgress( int itemsWritten );
+
+	/**
+	 * Emitted when writing the tree in the background is finished or
+	 * aborted.
+	 **/
+	void treeWritten( const QString & fileName, bool ok );
+
+	/**
+	 * Emitted when the memory is getting close to the memory budget.
+	 * Receivers should drop whatever they can build again later.
+	 **/
+	void memoryPressure();
+
+	/**
+	 * Emitted after each check of the memory budget.
+	 **/
+	void memoryBudgetChecked();
+
 
     protected slots:
 
@@ -440,22 +1450,99 @@ namespace QDirStat
 	 **/
 	void slotFinished();
 
+	/**
+	 * Write a checkpoint if reading is still in progress.
+	 **/
+	void writeCheckpoint();
+
+	/**
+	 * Compare the memory of the program with the memory budget and get
+	 * rid of as much as necessary to stay below it.
+	 **/
+	void checkMemoryBudget();
+
+	/**
+	 * Notification that the writer thread is finished. This will
+	 * emit the treeWritten() signal.
+	 **/
+	void writerThreadFinished();
+
+	/**
+	 * Notification that a thread that destroyed a discarded tree is
+	 * finished.
+	 **/
+	void destroyerFinished();
+
+	/**
+	 * Send a writeProgress() signal.
+	 **/
+	void sendWriteProgress();
+
 
     protected:
 
 	/**
-	 * Recurse through the tree from 'dir' on and move any ignored items to
-	 * the attic on the same level.
+	 * Start reading the unfinished directories of a checkpoint after it
+	 * was read. Return 'false' if there are none.
 	 **/
+	bool readResumeDirs();
 
+	/**
+	 * Continue rescanWithCache() after the cache file was read.
+	 **/
+	void rescanAfterCache();
+
+	/**
+	 * Refresh 'subtree' with an IncrementalDirReadJob.
+	 **/
+	void refreshIncremental( DirInfo * subtree );
+
+	/**
+	 * Queue an IncrementalDirReadJob for 'subtree'. Call
+	 * startRefreshing() when all subtrees are queued.
+	 **/
+	void queueIncrementalRefresh( DirInfo * subtree );
+
+	/**
+	 * Clear 'subtree' and queue a read job for it. Call
+	 * startRefreshing() when all subtrees are queued.
+	 **/
+	void queueRefresh( DirInfo * subtree );
+
+	/**
+	 * Notify the views that the queued refresh jobs are starting.
+	 **/
+	void startRefreshing();
+
+	/**
+	 * Return the chain of all filters. Create it if it doesn't exist yet.
+	 **/
+	DirTreeFilterChain * filterChain();
+
+	/**
+	 * Set the counters of the exclude rules and filters back to zero
+	 * if RuleStats are enabled.
+	 **/
+	void resetRuleStats();
+
+	/**
+	 * Write the counters of the exclude rules and filters to the log if
+	 * RuleStats are enabled.
+	 **/
+	void logRuleStats();
+
+	/**
+	 * Recurse through the tree from 'dir' on, recalculate all sums and
+	 * move any ignored items and any directories without unignored items
+	 * to the attic on the same level.
+	 **/
 	void moveIgnoredToAttic( DirInfo * dir );
 
 	/**
-	 * Recurse through the tree from 'dir' on and ignore any empty dirs
-	 * (i.e. dirs without any unignored non-directory child) that are not
-	 * ignored yet.
+	 * Recurse through the tree from 'dir' on and move all non-directory
+	 * items that 'filter' ignores to the attics.
 	 **/
-	void ignoreEmptyDirs( DirInfo * dir );
+	void moveFilteredToAttic( DirInfo * dir, const DirTreeFilter * filter );
 
 	/**
 	 * Move all items from the attic to the normal children list.
@@ -467,11 +1554,106 @@ namespace QDirStat
 	 **/
 	void recalc( DirInfo * dir );
 
+	/**
+	 * Recursively reset the cached category IDs in 'dir' and below.
+	 **/
+	void clearCategoryIds( DirInfo * dir );
+
+	/**
+	 * Drop the least recently used sorted children lists until they are
+	 * well below the limit again, but never the one of 'keep'.
+	 **/
+	void evictSortCaches( DirInfo * keep );
+
         /**
          * Try to derive the cluster size from 'item'.
          **/
         void detectClusterSize( FileInfo * item );
 
+	/**
+	 * Forget all cache placeholders.
+	 **/
+	void clearCachePlaceholders();
+
+	/**
+	 * Delete 'subtree' in a separate thread. It must not be part of the
+	 * tree any more (see DirInfo::detachChildren()).
+	 **/
+	void destroyInBackground( DirInfo * subtree );
+
+	/**
+	 * Wait until all threads from destroyInBackground() are finished.
+	 **/
+	void waitForDestroyers();
+
+	/**
+	 * Return the directory with the files of 'dir' that can be spilled
+	 * or frozen: Its dot entry or, if it has no subdirectories, 'dir'
+	 * itself. Return 0 if there is none or if it has too few files.
+	 **/
+	DirInfo * filesDir( DirInfo * dir ) const;
+
+	/**
+	 * Move the files of 'target' (see filesDir()) to the spill store
+	 * and make it a cache placeholder. If there is no store yet, it is
+	 * created in memory if 'inMemory' is 'true', otherwise as a
+	 * temporary file. Return 'true' on success.
+	 **/
+	bool moveFilesToStore( DirInfo * target, bool inMemory );
+
+	/**
+	 * Freeze the files of all directories in 'subtree' that the views
+	 * never showed, no matter if freezeColdFiles() is enabled.
+	 **/
+	void freezeColdFilesNow( DirInfo * subtree );
+
+	/**
+	 * Freeze the files of 'dir' and (recursively) its subdirectories
+	 * that the views never showed and that are completely read. Return
+	 * the number of frozen directories.
+	 **/
+	int freezeColdFilesRecursive( DirInfo * dir );
+
+	/**
+	 * Add 'dir' to the locate index if it is a real directory.
+	 **/
+	void addToLocateIndex( DirInfo * dir );
+
+	/**
+	 * Look up 'url' in the locate index: If the item itself or one of its
+	 * parent directories is in the index, search only that subtree,
+	 * store the item (or 0 if there is no such item) in 'result' and
+	 * return 'true'. Return 'false' if none of them is in the index.
+	 **/
+	bool locateIndexed( const QString & url,
+			    bool	    findPseudoDirs,
+			    FileInfo *&	    result );
+
+	/**
+	 * Create, resize or delete the worker pool for parallel reading
+	 * according to the readThreads() or networkReadThreads() settings.
+	 **/
+	void setupReadWorkerPool( bool networkMount );
+
+	/**
+	 * Return the number of worker threads for reading a network or a
+	 * local filesystem according to the settings.
+	 **/
+	int readThreadCount( bool networkMount ) const;
+
+	/**
+	 * Delete the worker pools for filesystems other than the one of the
+	 * toplevel directory.
+	 **/
+	void deleteDeviceReadWorkerPools();
+
+	/**
+	 * Return 'true' if the tree's directories should be read in inode
+	 * order, i.e. if inodeOrderOnRotational() is set and _url is on a
+	 * rotational disk.
+	 **/
+	bool useInodeOrder() const;
+
 
 
 	// Data members
@@ -484,9 +1666,83 @@ namespace QDirStat
 	QString			_url;
 	ExcludeRules *		_excludeRules;
 	QList<DirTreeFilter *>	_filters;
+	DirTreeFilterChain *	_filterChain;
 	bool			_beingDestroyed;
         bool                    _haveClusterSize;
         int                     _blocksPerCluster;
+	int			_readThreads;
+	int			_networkReadThreads;
+	bool			_useIoUring;
+	bool			_inodeOrderOnRotational;
+	bool			_incrementalRefresh;
+	DirReadWorkerPool *	_readWorkerPool;
+	QHash<dev_t, DirReadWorkerPool *> _deviceReadWorkerPools;
+	DirTreeWatcher *	_watcher;
+	ScanCoordinator *	_scanCoordinator;
+	int			_watchUpdateMillisec;
+	bool			_cacheAllDirty;
+	QSet<QString>		_dirtyCacheBlocks;
+	QString			_cleanCacheFile;
+	bool			_lazyCacheLoading;
+	bool			_contiguousChildren;
+	bool			_fileColumns;
+	bool			_cacheCategories;
+	bool			_cacheFileAgeSummaries;
+	int			_categoryGeneration;
+	QString			_lazyCacheFile;
+	bool			_shareCacheImages;
+	bool			_compactCachePaths;
+	QString			_pendingCacheImage;	// cache file to write the image of
+	QHash<DirInfo *, CacheBlockInfo *> _cachePlaceholders;
+	bool			_spillFiles;
+	QString			_spillDir;
+	bool			_freezeColdFiles;
+	FileSpillStore *	_spillStore;
+	MemoryBudget		_memoryBudget;
+	QTimer			_memoryBudgetTimer;
+	bool			_spillUnderPressure;
+	bool			_useLocateIndex;
+	qint64			_generation;
+	QAtomicInt		_subtreeLabelGeneration;
+	QAtomicInt		_unlabeledDirs;
+	int			_labeledDirs;
+	int			_lastSubtreeLabelGeneration;
+	QHash<QString, DirInfo *> _locateIndex;	// directory by URL
+	HardLinkTable		_hardLinkTable;
+	DirReadStats		_readStats;
+	ScanProgress		_scanProgress;
+	ReadThrottle		_readThrottle;
+	SizeEstimator		_sizeEstimator;
+	bool			_estimateMode;
+	QuotaMode		_quotaMode;
+	QHash<const DirInfo *, QuotaTotals> _quotaTotals;
+	bool			_idleIoPriority;
+	ReadTopology		_readTopology;
+	bool			_bulkStat;
+	BulkInodeTablePtr	_bulkInodeTable;
+	QString			_checkpointFile;
+	QTimer			_checkpointTimer;
+	QStringList		_resumeDirs;
+	QString			_rescanUrl;
+	QString			_rescanCacheFile;
+	DirInfo *		_prioritizedSubtree;
+	FileInfoList		_addedChildren;
+	QSet<DirInfo *>		_errorDirs;
+	TreeWriterThread *	_writerThread;
+	QTimer			_writerTimer;
+	QList<QThread *>	_destroyers;
+
+	struct SortCacheUse
+	{
+	    SortCacheUse(): lastUse( 0 ), entries( 0 ) {}
+
+	    quint64 lastUse;
+	    int	    entries;
+	};
+
+	QHash<DirInfo *, SortCacheUse> _sortCaches;
+	qint64			_sortCacheEntries;
+	quint64			_sortCacheClock;
 
     };	// class DirTree
 
@@ -8,14 +8,29 @@
 
 
 #include <ctype.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
 #include <QUrl>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTextStream>
+#include <QIODevice>
 
 #include "DirTreeCache.h"
+#include "CacheReadPipeline.h"
+#include "ZstdFile.h"
 #include "DirInfo.h"
 #include "DirTree.h"
 #include "DotEntry.h"
 #include "ExcludeRules.h"
 #include "FormatUtil.h"
+#include "LineTokenizer.h"
+#include "ReadTrace.h"
+#include "SharedCacheImage.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -26,6 +41,16 @@
 
 #define MAX_ERROR_COUNT			1000
 
+// Buffer size for copying unchanged blocks from the old cache file
+#define COPY_BUF_SIZE			( 1024 * 1024 )
+
+// Delta-encode a path only if it has more than this many bytes in common
+// with the last one; "^<number>:" would not be shorter otherwise.
+#define COMPACT_PATH_MIN_PREFIX		4
+
+// Stream buffer size at which CacheSnapshotWriter writes to its file descriptor
+#define SNAPSHOT_FLUSH_SIZE		( 256 * 1024 )
+
 #define VERBOSE_READ			0
 #define VERBOSE_CACHE_DIRS		0
 #define VERBOSE_CACHE_FILE_INFOS	0
@@ -34,9 +59,58 @@
 using namespace QDirStat;
 
 
-CacheWriter::CacheWriter( const QString & fileName, DirTree *tree )
+CacheWriter::CacheWriter( const QString & fileName,
+			  DirTree *	  tree,
+			  bool		  longFormat ):
+    _longFormat( longFormat ),
+    _gzCache( 0 ),
+    _fd( -1 ),
+    _zstdCache( 0 ),
+    _blockStart( 0 ),
+    _compactPaths( false ),
+    _placeholdersMoved( false ),
+    _readOnlyTree( false )
+{
+    prepareTree( fileName, tree );
+
+    if ( isBinaryCacheName( fileName ) )
+	_ok = writeBinaryCache( fileName, tree );
+    else
+	_ok = writeCache( fileName, tree );
+
+    updateTree( tree );
+}
+
+
+CacheWriter::CacheWriter( int fd, bool longFormat ):
+    _ok( true ),
+    _longFormat( longFormat ),
+    _gzCache( 0 ),
+    _fd( fd ),
+    _zstdCache( 0 ),
+    _blockStart( 0 ),
+    _compactPaths( false ),
+    _placeholdersMoved( false ),
+    _readOnlyTree( false )
+{
+    // NOP
+}
+
+
+bool CacheWriter::isBinaryCacheName( const QString & fileName )
 {
-    _ok = writeCache( fileName, tree );
+    return fileName.endsWith( BINARY_CACHE_SUFFIX );
+}
+
+
+bool CacheWriter::isBinaryCacheFile( const QString & fileName )
+{
+    QFile file( fileName );
+    char  magic[ sizeof( BinaryCacheHeader().magic ) ];
+
+    return file.open( QIODevice::ReadOnly ) &&
+	file.read( magic, sizeof( magic ) ) == sizeof( magic ) &&
+	memcmp( magic, BINARY_CACHE_MAGIC, sizeof( magic ) ) == 0;
 }
 
 
@@ -46,478 +120,2871 @@ CacheWriter::~CacheWriter()
 }
 
 
-bool CacheWriter::writeCache( const QString & fileName, DirTree *tree )
+void CacheWriter::prepareTree( const QString & fileName, DirTree * tree )
 {
     if ( ! tree || ! tree->root() )
-	return false;
+	return;
 
-    gzFile cache = gzopen( (const char *) fileName.toUtf8(), "w" );
+    // Spilled files can't be read from the file in the writer thread since
+    // the tree must not change there
 
-    if ( cache == 0 )
+    tree->loadSpilledFiles();
+
+    if ( isBinaryCacheName( fileName ) )
     {
-	logError() << "Can't open " << fileName << ": " << formatErrno() << endl;
-	return false;
+	// The binary format has no blocks that could be copied
+
+	tree->loadCachePlaceholders();
     }
+    else if ( tree->hasCachePlaceholders() )
+    {
+	// The blocks of cache placeholders (subtrees that were not read from
+	// their cache file yet) are copied from that file, but only if it
+	// uses the same compression; otherwise they have to be read now.
 
-    gzprintf( cache, "[qdirstat %s cache file]\n", CACHE_FORMAT_VERSION );
-    gzprintf( cache,
-	     "# Do not edit!\n"
-	     "#\n"
-	     "# Type\tpath\t\tsize\tmtime\t\t<optional fields>\n"
-	     "\n" );
+	bool  zstd = fileName.endsWith( ZSTD_CACHE_SUFFIX );
+	QFile lazyFile( tree->lazyCacheFile() );
 
-    writeTree( cache, tree->root()->firstChild() );
-    gzclose( cache );
+	// A block with delta-encoded paths can't go into a file without
+	// them and vice versa.
 
-    return true;
+	QList<CacheBlockInfo> lazyBlocks;
+
+	if ( ZstdReader::isZstdFile( lazyFile.fileName() ) != zstd ||
+	     isBinaryCacheFile( lazyFile.fileName() ) ||
+	     ! readCacheIndex( lazyFile.fileName(), QString(), lazyBlocks ) ||
+	     lazyBlocks.first().compactPaths != tree->compactCachePaths() ||
+	     ! lazyFile.open( QIODevice::ReadOnly ) )
+	{
+	    tree->loadCachePlaceholders();
+	}
+    }
+
+    // The summaries and the URL of a directory are calculated on demand;
+    // do that now for the summaries and the toplevel URL, not while
+    // writing the blocks. The other URLs are not kept (see itemUrl()).
+
+    FileInfo * toplevel = tree->root()->firstChild();
+
+    if ( toplevel )
+    {
+	toplevel->totalSize();
+	toplevel->url();
+    }
 }
 
 
-void CacheWriter::writeTree( gzFile cache, FileInfo * item )
+QString CacheWriter::itemUrl( FileInfo * item ) const
 {
-    if ( ! item )
+    if ( ! _readOnlyTree )
+	return item->url();
+
+    // Like FileInfo::url(), but without DirInfo::url() which keeps the
+    // URL of each directory once it was calculated.
+
+    QString url = item->isPseudoDir() ? QString() : item->name();
+
+    for ( FileInfo * parent = item->parent(); parent; parent = parent->parent() )
+    {
+	if ( parent->isPseudoDir() )
+	    continue;
+
+	const QString & name = parent->name();
+
+	if ( ! name.endsWith( "/" ) && ! url.startsWith( "/" ) && ! url.isEmpty() )
+	    url.prepend( "/" );
+
+	url.prepend( name );
+    }
+
+    return url;
+}
+
+
+void CacheWriter::updateTree( DirTree * tree )
+{
+    if ( ! tree || ! _ok )
 	return;
 
-    //
-    // Write entry for this item
-    //
+    if ( _placeholdersMoved )
+	tree->updateCachePlaceholders( _blocks );
 
-    if ( ! item->isDotEntry() )
-	writeItem( cache, item );
+    if ( ! _cleanFile.isEmpty() )
+	tree->setCacheClean( _cleanFile );
+}
 
-    //
-    // Write file children
-    //
 
-    if ( item->dotEntry() )
-	writeTree( cache, item->dotEntry() );
+bool CacheWriter::writeCache( const QString & fileName, DirTree *tree )
+{
+    if ( ! tree || ! tree->root() )
+	return false;
 
-    //
-    // Recurse through subdirectories
-    //
+    FileInfo * toplevel = tree->root()->firstChild();
+    _ok = true;		// copyBlock() and writeRaw() may set this to 'false'
+    _compactPaths = tree->compactCachePaths();
+    _lastPath.clear();
 
-    FileInfo * child = item->firstChild();
+    // Each directory directly below the toplevel is written as a separate
+    // block (a gzip member or a zstd frame; concatenated, they are still a
+    // valid gzip or zstd file, so readers don't need to know about this).
+    // If the tree was written to this file before and a block did not
+    // change since then, it is copied from the old file without
+    // serializing and compressing it again. This matters for huge trees
+    // where only some subtrees were refreshed.
 
-    while ( child )
+    QList<CacheBlockInfo> oldBlocks;
+    QFile oldFile( fileName );
+    bool  incremental = toplevel &&
+	readCacheIndex( fileName, toplevel->url(), oldBlocks ) &&
+	oldBlocks.first().compactPaths == _compactPaths &&
+	oldFile.open( QIODevice::ReadOnly );
+
+    // The blocks of cache placeholders are copied from their cache file,
+    // too; prepareTree() already read those that can't be copied.
+
+    bool  zstd = fileName.endsWith( ZSTD_CACHE_SUFFIX );
+    QFile lazyFile( tree->lazyCacheFile() );
+
+    if ( tree->hasCachePlaceholders() )
+	lazyFile.open( QIODevice::ReadOnly );
+
+    // Don't overwrite a file that is still needed for copying blocks
+
+    bool    isLazyFile = lazyFile.isOpen() &&
+	QFileInfo( fileName ).absoluteFilePath() == lazyFile.fileName();
+    bool    replace    = incremental || isLazyFile;
+    QString outputName = replace ? fileName + ".new" : fileName;
+
+    if ( ! openOutput( outputName, zstd ) )
+	return false;
+
+    write( QString( "[qdirstat %1 cache file]\n" )
+	   .arg( _compactPaths ? COMPACT_CACHE_FORMAT_VERSION : CACHE_FORMAT_VERSION ).toUtf8() );
+    write( "# Do not edit!\n"
+	   "#\n"
+	   "# Type\tpath\t\tsize\tmtime\t\t<optional fields>\n"
+	   "\n" );
+
+    int reused = 0;
+    _sizeClasses.fill( 0, CACHE_SIZE_CLASSES );
+
+    if ( toplevel )
     {
-	writeTree( cache, child );
-	child = child->next();
+	// The toplevel block
+
+	writeItem( toplevel );
+
+	if ( toplevel->dotEntry() )
+	    writeTree( toplevel->dotEntry() );
+
+	for ( FileInfo * child = toplevel->firstChild(); child; child = child->next() )
+	{
+	    if ( ! child->isDirInfo() )
+		writeTree( child );
+	}
+
+	endBlock( QString() );
+	setSummary( _blocks.last(), toplevel );
+
+
+	// One block for each subdirectory
+
+	for ( FileInfo * child = toplevel->firstChild(); child; child = child->next() )
+	{
+	    if ( ! child->isDirInfo() )
+		continue;
+
+	    QString name = child->name();
+	    bool copied	 = false;
+
+	    if ( child->toDirInfo()->isCachePlaceholder() )
+	    {
+		copied = copyPlaceholder( lazyFile, child->toDirInfo() );
+
+		if ( ! copied && _readOnlyTree )
+		{
+		    logError() << "Can't copy the cache block of " << name << endl;
+		    _ok = false;
+		    break;
+		}
+
+		if ( ! copied )		// Read it now and write it the normal way
+		    tree->loadCachePlaceholder( child->toDirInfo() );
+	    }
+	    else if ( incremental && tree->isCacheBlockClean( fileName, name ) )
+	    {
+		foreach ( const CacheBlockInfo & block, oldBlocks )
+		{
+		    if ( block.name == name )
+		    {
+			copied = copyBlock( oldFile, block );
+			break;
+		    }
+		}
+	    }
+
+	    if ( copied )
+	    {
+		++reused;
+	    }
+	    else
+	    {
+		writeTree( child );
+		endBlock( name );
+	    }
+
+	    setSummary( _blocks.last(), child );
+	}
+
+	// The summary of the toplevel block is for the complete tree
+
+	CacheBlockInfo & top = _blocks.first();
+
+	for ( int i=1; i < _blocks.size() && ! top.sizeClasses.isEmpty(); ++i )
+	{
+	    const QVector<int> & sizeClasses = _blocks.at( i ).sizeClasses;
+
+	    if ( sizeClasses.isEmpty() )	// copied from an older index
+		top.sizeClasses.clear();
+
+	    for ( int j=0; j < sizeClasses.size() && ! top.sizeClasses.isEmpty(); ++j )
+		top.sizeClasses[ j ] += sizeClasses.at( j );
+	}
+    }
+
+    bool ok = closeOutput() && _ok;
+
+    if ( aborted() )
+    {
+	logInfo() << "Aborted writing " << fileName << endl;
+	QFile::remove( outputName );
+	ok = false;
+    }
+
+    if ( replace && ! aborted() )
+    {
+	logInfo() << "Reused " << reused << " of " << _blocks.size() - 1
+		  << " unchanged blocks from " << fileName << endl;
+
+	if ( ok && ::rename( outputName.toUtf8(), fileName.toUtf8() ) != 0 )
+	{
+	    logError() << "Can't rename " << outputName << " to " << fileName
+		       << ": " << formatErrno() << endl;
+	    ok = false;
+	}
+
+	if ( ! ok )
+	    QFile::remove( outputName );
+    }
+
+    // The placeholders' blocks have moved; see updateTree()
+
+    _placeholdersMoved = ok && isLazyFile;
+
+    for ( int i=0; i < _blocks.size(); ++i )
+	_blocks[ i ].compactPaths = _compactPaths;
+
+    if ( ok && toplevel )
+	ok = writeCacheIndex( fileName, toplevel->url() );
+
+    if ( ok )
+	_cleanFile = fileName;
+    else
+	QFile::remove( fileName + CACHE_INDEX_SUFFIX );	 // don't trust it anymore
+
+    return ok;
+}
+
+
+bool CacheWriter::openOutput( const QString & fileName, bool zstd )
+{
+    _blockStart = 0;
+    _blocks.clear();
+
+    if ( zstd )
+    {
+	_zstdCache = new ZstdWriter( fileName );
+	CHECK_NEW( _zstdCache );
+
+	return _zstdCache->ok();
+    }
+
+    // Using our own file descriptor for zlib to write unchanged blocks
+    // directly to the file
+
+    _fd = ::open( fileName.toUtf8(), O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+
+    if ( _fd >= 0 )
+	_gzCache = gzdopen( _fd, "w" );
+
+    if ( _gzCache == 0 )
+    {
+	logError() << "Can't open " << fileName << ": " << formatErrno() << endl;
+
+	if ( _fd >= 0 )
+	    ::close( _fd );
+
+	_fd = -1;
+	return false;
     }
+
+    return true;
 }
 
 
-void CacheWriter::writeItem( gzFile cache, FileInfo * item )
+bool CacheWriter::closeOutput()
 {
-    if ( ! item )
-	return;
+    bool ok = true;
 
-    // Write file type
+    if ( _zstdCache )
+    {
+	ok = _zstdCache->close();
+	delete _zstdCache;
+	_zstdCache = 0;
+    }
+    else if ( _gzCache )
+    {
+	ok = gzclose( _gzCache ) == Z_OK;	// This also closes _fd
+	_gzCache = 0;
+	_fd	 = -1;
+    }
 
-    const char * file_type = "";
-    if	    ( item->isFile()		)	file_type = "F";
-    else if ( item->isDir()		)	file_type = "D";
-    else if ( item->isSymLink()		)	file_type = "L";
-    else if ( item->isBlockDevice()	)	file_type = "BlockDev";
-    else if ( item->isCharDevice()	)	file_type = "CharDev";
-    else if ( item->isFifo()		)	file_type = "FIFO";
-    else if ( item->isSocket()		)	file_type = "Socket";
+    return ok;
+}
 
-    gzprintf( cache, "%s", file_type );
 
-    // Write name
+void CacheWriter::endBlock( const QString & name )
+{
+    qint64 end = -1;
 
-    if ( item->isDirInfo() && ! item->isDotEntry() )
+    if ( _zstdCache )
     {
-	// Use absolute path
+	_zstdCache->endFrame();
+	end = _zstdCache->offset();
+    }
+    else if ( _gzCache )
+    {
+	// This finishes the current gzip member; the next gzwrite() starts a
+	// new one.
 
-	gzprintf( cache, " %s", urlEncoded( item->url() ).data() );
+	gzflush( _gzCache, Z_FINISH );
+	end = lseek( _fd, 0, SEEK_CUR );
     }
-    else
+
+    CacheBlockInfo block;
+    block.name	 = name;
+    block.offset = _blockStart;
+    block.size	 = end - _blockStart;
+    block.sizeClasses = _sizeClasses;
+
+    _blocks << block;
+    _sizeClasses.fill( 0 );
+    _blockStart = end;
+
+    // Each block can be read on its own, so the first path in the next one
+    // has to be a full path
+
+    _lastPath.clear();
+}
+
+
+bool CacheWriter::copyBlock( QFile & oldFile, const CacheBlockInfo & block )
+{
+    if ( block.size <= 0 || ! oldFile.seek( block.offset ) )
+	return false;
+
+    qint64 remaining = block.size;
+
+    while ( remaining > 0 )
     {
-	// Use relative path
+	QByteArray data = oldFile.read( qMin( remaining, (qint64) COPY_BUF_SIZE ) );
+
+	if ( data.isEmpty() )
+	{
+	    // Nothing was written yet if this is the first chunk, so the
+	    // caller can still write the block the normal way.
+
+	    if ( remaining == block.size )
+		return false;
+
+	    logError() << "Error reading " << oldFile.fileName() << endl;
+	    _ok = false;
+	    return true;
+	}
 
-	gzprintf( cache, "\t%s", urlEncoded( item->name() ).data() );
+	if ( ! writeRaw( data ) )
+	    return true;
+
+	remaining -= data.size();
     }
 
+    CacheBlockInfo newBlock;
+    newBlock.name   = block.name;
+    newBlock.offset = _blockStart;
+    newBlock.size   = block.size;
+    newBlock.sizeClasses = block.sizeClasses;
 
-    // Write size
+    _blocks << newBlock;
+    _blockStart += block.size;
 
-    gzprintf( cache, "\t%s", formatSize( item->rawByteSize() ).toUtf8().data() );
+    return true;
+}
 
 
-    // Write mtime
+bool CacheWriter::copyPlaceholder( QFile & lazyFile, DirInfo * dir )
+{
+    CacheBlockInfo block;
 
-    gzprintf( cache, "\t0x%lx", (unsigned long) item->mtime() );
+    if ( ! lazyFile.isOpen() || ! dir->tree()->cachePlaceholderBlock( dir, block ) )
+	return false;
 
-    // Optional fields
+    return copyBlock( lazyFile, block );
+}
 
-    if ( item->isSparseFile() )
-	gzprintf( cache, "\tblocks: %lld", item->blocks() );
 
-    if ( item->isFile() && item->links() > 1 )
-	gzprintf( cache, "\tlinks: %u", (unsigned) item->links() );
+void CacheWriter::setSummary( CacheBlockInfo & block, FileInfo * dir )
+{
+    block.hasSummary	     = true;
+    block.dirSize	     = dir->size();
+    block.dirMtime	     = dir->mtime();
+    block.totalSize	     = dir->totalSize();
+    block.totalAllocatedSize = dir->totalAllocatedSize();
+    block.totalBlocks	     = dir->totalBlocks();
+    block.totalItems	     = dir->totalItems();
+    block.totalSubDirs	     = dir->totalSubDirs();
+    block.totalFiles	     = dir->totalFiles();
+    block.latestMtime	     = dir->latestMtime();
+}
+
+
+bool CacheWriter::writeRaw( const QByteArray & data )
+{
+    if ( _zstdCache )
+    {
+	_zstdCache->writeRaw( data );
+	return _zstdCache->ok();
+    }
+
+    const char * pos  = data.constData();
+    qint64	 left = data.size();
+
+    while ( left > 0 )
+    {
+	ssize_t written = ::write( _fd, pos, left );
+
+	if ( written < 0 )
+	{
+	    if ( errno == EINTR )
+		continue;
+
+	    logError() << "Write error: " << formatErrno() << endl;
+	    _ok = false;
+	    return false;
+	}
+
+	pos  += written;
+	left -= written;
+    }
 
-    gzputc( cache, '\n' );
+    return true;
 }
 
 
-QByteArray CacheWriter::urlEncoded( const QString & path )
+bool CacheWriter::writeCacheIndex( const QString & fileName, const QString & toplevelUrl )
 {
-    // Using a protocol ("scheme") part to avoid directory names with a colon
-    // ":" being cut off because it looks like a URL protocol.
-    QUrl url;
-    url.setScheme( "foo" );
-    url.setPath( path );
+    QFileInfo cacheInfo( fileName );
+    QFile     file( fileName + CACHE_INDEX_SUFFIX );
 
-    QByteArray encoded = url.toEncoded( QUrl::RemoveScheme );
+    if ( ! file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+	logError() << "Can't open " << file.fileName() << ": " << file.errorString() << endl;
+	return false;
+    }
 
-    if ( encoded.isEmpty() )
+    QTextStream str( &file );
+
+    str << "[qdirstat " << CACHE_FORMAT_VERSION << " cache index]\n"
+	<< "# Do not edit!\n"
+	<< "#\n"
+	<< "# block\toffset\tsize\tname\tsize\tmtime\ttotal size\tallocated\tblocks\titems\tsubdirs\tfiles\tlatest mtime\tsize classes\n"
+	<< "\n"
+	<< "toplevel\t" << urlEncoded( toplevelUrl ) << "\n"
+	<< "cache\t" << cacheInfo.size()
+	<< "\t" << cacheInfo.lastModified().toMSecsSinceEpoch() << "\n";
+
+    if ( _compactPaths )
+	str << "paths\tcompact\n";
+
+    foreach ( const CacheBlockInfo & block, _blocks )
     {
-        logError() << "Invalid file/dir name: " << path << endl;
+	str << "block\t" << block.offset << "\t" << block.size << "\t"
+	    << ( block.name.isEmpty() ? QByteArray( "/" ) : urlEncoded( block.name ) );
+
+	if ( block.hasSummary )
+	{
+	    str << "\t" << block.dirSize
+		<< "\t" << (qint64) block.dirMtime
+		<< "\t" << block.totalSize
+		<< "\t" << block.totalAllocatedSize
+		<< "\t" << block.totalBlocks
+		<< "\t" << block.totalItems
+		<< "\t" << block.totalSubDirs
+		<< "\t" << block.totalFiles
+		<< "\t" << (qint64) block.latestMtime;
+
+	    if ( ! block.sizeClasses.isEmpty() )
+		str << "\t" << sizeClassesField( block.sizeClasses );
+	}
+
+	str << "\n";
     }
 
-    return encoded;
+    str.flush();
 
+    return file.error() == QFile::NoError;
 }
 
 
-QString CacheWriter::formatSize( FileSize size )
+bool CacheWriter::readCacheIndex( const QString	      & fileName,
+				  const QString	      & toplevelUrl,
+				  QList<CacheBlockInfo> & blocks )
 {
-    if ( size >= TB && size % TB == 0 )
-        return QString( "%1T" ).arg( size / TB );
+    blocks.clear();
 
-    if ( size >= GB && size % GB == 0 )
-        return QString( "%1G" ).arg( size / GB );
+    QFile file( fileName + CACHE_INDEX_SUFFIX );
 
-    if ( size >= MB && size % MB == 0 )
-        return QString( "%1M" ).arg( size / MB );
+    if ( ! file.open( QIODevice::ReadOnly | QIODevice::Text ) )
+	return false;
 
-    if ( size >= KB && size % KB == 0 )
-        return QString( "%1K" ).arg( size / KB );
+    QFileInfo cacheInfo( fileName );
+    bool      cacheMatches = false;
+    bool      urlMatches   = false;
+    bool      compactPaths = false;
+
+    while ( ! file.atEnd() )
+    {
+	QList<QByteArray> fields = file.readLine().trimmed().split( '\t' );
+	const QByteArray & keyword = fields.first();
+
+	if ( keyword == "toplevel" && fields.size() == 2 )
+	{
+	    urlMatches = toplevelUrl.isEmpty() ||
+		QUrl::fromPercentEncoding( fields.at( 1 ) ) == toplevelUrl;
+	}
+	else if ( keyword == "cache" && fields.size() == 3 )
+	{
+	    cacheMatches = fields.at( 1 ).toLongLong() == cacheInfo.size() &&
+		fields.at( 2 ).toLongLong() == cacheInfo.lastModified().toMSecsSinceEpoch();
+	}
+	else if ( keyword == "paths" && fields.size() == 2 )
+	{
+	    compactPaths = fields.at( 1 ) == "compact";
+	}
+	else if ( keyword == "block" && ( fields.size() == 4 || fields.size() == 13 || fields.size() == 14 ) )
+	{
+	    CacheBlockInfo block;
+	    block.offset = fields.at( 1 ).toLongLong();
+	    block.size	 = fields.at( 2 ).toLongLong();
+	    block.name	 = fields.at( 3 ) == "/" ?
+		QString() : QUrl::fromPercentEncoding( fields.at( 3 ) );
+
+	    if ( fields.size() == 13 )	// with the summary of the directory
+	    {
+		block.hasSummary	 = true;
+		block.dirSize		 = fields.at(  4 ).toLongLong();
+		block.dirMtime		 = fields.at(  5 ).toLongLong();
+		block.totalSize		 = fields.at(  6 ).toLongLong();
+		block.totalAllocatedSize = fields.at(  7 ).toLongLong();
+		block.totalBlocks	 = fields.at(  8 ).toLongLong();
+		block.totalItems	 = fields.at(  9 ).toInt();
+		block.totalSubDirs	 = fields.at( 10 ).toInt();
+		block.totalFiles	 = fields.at( 11 ).toInt();
+		block.latestMtime	 = fields.at( 12 ).toLongLong();
+	    }
+
+	    if ( fields.size() == 14 )
+		block.sizeClasses = parseSizeClasses( fields.at( 13 ) );
+
+	    blocks << block;
+	}
+    }
+
+    if ( ! cacheMatches || ! urlMatches || blocks.isEmpty() )
+    {
+	blocks.clear();
+	return false;
+    }
+
+    for ( int i=0; i < blocks.size(); ++i )
+	blocks[ i ].compactPaths = compactPaths;
+
+    return true;
+}
+
+
+QByteArray CacheWriter::sizeClassesField( const QVector<int> & sizeClasses )
+{
+    // Leave out the empty classes at the end; most of them always are
+
+    int count = sizeClasses.size();
+
+    while ( count > 1 && sizeClasses.at( count - 1 ) == 0 )
+	--count;
+
+    QByteArray field;
+
+    for ( int i=0; i < count; ++i )
+    {
+	if ( i > 0 )
+	    field += ',';
+
+	field += QByteArray::number( sizeClasses.at( i ) );
+    }
+
+    return field;
+}
+
+
+QVector<int> CacheWriter::parseSizeClasses( const QByteArray & field )
+{
+    QList<QByteArray> counts = field.split( ',' );
+    QVector<int>      sizeClasses;
+
+    if ( counts.size() > CACHE_SIZE_CLASSES )
+	return sizeClasses;
+
+    sizeClasses.fill( 0, CACHE_SIZE_CLASSES );
+
+    for ( int i=0; i < counts.size(); ++i )
+    {
+	bool ok = false;
+	sizeClasses[ i ] = counts.at( i ).toInt( &ok );
+
+	if ( ! ok )
+	    return QVector<int>();
+    }
+
+    return sizeClasses;
+}
+
+
+void CacheWriter::write( const QByteArray & data )
+{
+    if ( _zstdCache )
+	_zstdCache->write( data );
+    else if ( _gzCache )
+	gzwrite( _gzCache, data.constData(), data.size() );
+    else if ( _fd >= 0 )
+	_streamBuffer += data;
+}
+
+
+bool CacheWriter::flushStream()
+{
+    if ( _streamBuffer.isEmpty() || ! _ok )
+	return _ok;
+
+    bool ok = writeRaw( _streamBuffer );
+    _streamBuffer.clear();
+
+    return ok;
+}
+
+
+void CacheWriter::writeTree( FileInfo * item )
+{
+    if ( ! item )
+	return;
+
+    //
+    // Write entry for this item
+    //
+
+    if ( ! item->isDotEntry() )
+	writeItem( item );
+
+    //
+    // Write file children
+    //
+
+    if ( item->dotEntry() )
+	writeTree( item->dotEntry() );
+
+    //
+    // Recurse through subdirectories
+    //
+
+    FileInfo * child = item->firstChild();
+
+    while ( child && ! aborted() )
+    {
+	writeTree( child );
+	child = child->next();
+    }
+}
+
+
+void CacheWriter::writeItem( FileInfo * item )
+{
+    if ( ! item )
+	return;
+
+    if ( item->isFile() && ! _sizeClasses.isEmpty() )
+	++_sizeClasses[ CacheBlockInfo::sizeClass( item->size() ) ];
+
+    // The line is assembled in _line, which keeps its buffer from one item
+    // to the next, so nothing is allocated for each item.
+
+    if ( _line.capacity() < MAX_CACHE_LINE_LEN )
+	_line.reserve( MAX_CACHE_LINE_LEN );
+
+    _line.resize( 0 );
+
+    // Write file type
+
+    const char * file_type = "";
+    if	    ( item->isFile()		)	file_type = "F";
+    else if ( item->isDir()		)	file_type = "D";
+    else if ( item->isSymLink()		)	file_type = "L";
+    else if ( item->isBlockDevice()	)	file_type = "BlockDev";
+    else if ( item->isCharDevice()	)	file_type = "CharDev";
+    else if ( item->isFifo()		)	file_type = "FIFO";
+    else if ( item->isSocket()		)	file_type = "Socket";
+
+    _line += file_type;
+
+    // Write name
+
+    if ( ( item->isDirInfo() && ! item->isDotEntry() ) || _longFormat )
+    {
+	// Use absolute path
+
+	_line += ' ';
+
+	if ( _compactPaths )
+	    appendCompactPath( _line, itemUrl( item ) );
+	else
+	    appendUrlEncoded( _line, itemUrl( item ) );
+    }
+    else
+    {
+	// Use relative path
+
+	_line += '\t';
+	appendUrlEncoded( _line, item->name() );
+    }
+
+
+    // Write size
+
+    _line += '\t';
+    appendSize( _line, item->rawByteSize() );
+
+
+    // Write mtime
+
+    _line += "\t0x";
+    appendNumber( _line, (qulonglong) item->mtime(), 16 );
+
+    // Optional fields
+
+    if ( item->isSparseFile() )
+    {
+	_line += "\tblocks: ";
+	appendNumber( _line, item->blocks() );
+    }
+
+    if ( item->isFile() && item->links() > 1 )
+    {
+	_line += "\tlinks: ";
+	appendNumber( _line, (uint) item->links() );
+    }
+
+    _line += '\n';
+    write( _line );
+    _itemsWritten.fetchAndAddRelaxed( 1 );
+}
+
+
+void CacheWriter::appendCompactPath( QByteArray & line, const QString & path )
+{
+    // _path and _lastPath keep their buffers from one path to the next
+
+    _path.resize( 0 );
+    appendUrlEncoded( _path, path );
+
+    const char * pos	= _path.constData();
+    const char * last	= _lastPath.constData();
+    int		 maxLen = qMin( _path.size(), _lastPath.size() );
+    int		 shared = 0;
+
+    while ( shared < maxLen && pos[ shared ] == last[ shared ] )
+	++shared;
+
+    // "^<shared>:" must be shorter than what it replaces
+
+    if ( shared > COMPACT_PATH_MIN_PREFIX )
+    {
+	line += '^';
+	appendNumber( line, shared );
+	line += ':';
+	line.append( pos + shared, _path.size() - shared );
+    }
+    else
+    {
+	line += _path;
+    }
+
+    qSwap( _path, _lastPath );
+}
+
+
+/**
+ * Round 'offset' up to the next multiple of 8.
+ **/
+static quint64 align8( quint64 offset )
+{
+    return ( offset + 7 ) & ~( (quint64) 7 );
+}
+
+
+/**
+ * Write the content of 'array' to 'file' at offset 'offset'.
+ **/
+template<typename T> static bool writeArray( QFile & file, quint64 offset, const QVector<T> & array )
+{
+    qint64 bytes = array.size() * sizeof( T );
+
+    return file.seek( offset ) &&
+	file.write( (const char *) array.constData(), bytes ) == bytes;
+}
+
+
+bool CacheWriter::writeBinaryCache( const QString & fileName, DirTree *tree )
+{
+    if ( ! tree || ! tree->root() )
+	return false;
+
+    // prepareTree() read all cache placeholders: The binary format has no
+    // blocks that could be copied
+
+    FileInfo * toplevel = tree->root()->firstChild();
+
+    if ( ! toplevel )
+	return false;
+
+    collectBinaryItems( toplevel, -1 );
+    _binNames << _binStrings.size();	// end of the last name
+
+    if ( aborted() )
+    {
+	logInfo() << "Aborted writing " << fileName << endl;
+	return false;
+    }
+
+    quint64 count = _binParents.size();
+
+    BinaryCacheHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, BINARY_CACHE_MAGIC, sizeof( header.magic ) );
+
+    header.byteOrder	     = BINARY_CACHE_BYTE_ORDER;
+    header.version	     = BINARY_CACHE_FORMAT_VERSION;
+    header.itemCount	     = count;
+    header.stringTableSize   = _binStrings.size();
+    header.parentsOffset     = align8( sizeof( header ) );
+    header.sizesOffset	     = align8( header.parentsOffset + count * sizeof( qint64 )	 );
+    header.blocksOffset	     = align8( header.sizesOffset   + count * sizeof( qint64 )	 );
+    header.mtimesOffset	     = align8( header.blocksOffset  + count * sizeof( qint64 )	 );
+    header.namesOffset	     = align8( header.mtimesOffset  + count * sizeof( qint64 )	 );
+    header.linksOffset	     = align8( header.namesOffset   + ( count + 1 ) * sizeof( quint64 ) );
+    header.modesOffset	     = align8( header.linksOffset   + count * sizeof( quint32 ) );
+    header.stringTableOffset = align8( header.modesOffset   + count * sizeof( quint32 ) );
+
+    QFile file( fileName );
+
+    if ( ! file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+	logError() << "Can't open " << fileName << ": " << file.errorString() << endl;
+	return false;
+    }
+
+    bool ok = file.write( (const char *) &header, sizeof( header ) ) == sizeof( header );
+
+    ok = ok && writeArray( file, header.parentsOffset, _binParents );
+    ok = ok && writeArray( file, header.sizesOffset,   _binSizes   );
+    ok = ok && writeArray( file, header.blocksOffset,  _binBlocks  );
+    ok = ok && writeArray( file, header.mtimesOffset,  _binMtimes  );
+    ok = ok && writeArray( file, header.namesOffset,   _binNames   );
+    ok = ok && writeArray( file, header.linksOffset,   _binLinks   );
+    ok = ok && writeArray( file, header.modesOffset,   _binModes   );
+    ok = ok && file.seek( header.stringTableOffset );
+    ok = ok && file.write( _binStrings ) == _binStrings.size();
+
+    if ( ! ok )
+	logError() << "Error writing " << fileName << ": " << file.errorString() << endl;
+
+    file.close();
+
+    return ok;
+}
+
+
+void CacheWriter::collectBinaryItems( FileInfo * item, qint64 parentIndex )
+{
+    if ( ! item )
+	return;
+
+    qint64 index = parentIndex;
+
+    if ( ! item->isDotEntry() )
+    {
+	// Like in the text format, the toplevel directory has its absolute
+	// path as its name, all others only their name; the content of dot
+	// entries belongs to their parent directory.
+
+	QByteArray name = parentIndex < 0 ? item->url().toUtf8() : item->name().toUtf8();
+
+	index = _binParents.size();
+	_binParents << parentIndex;
+	_binSizes   << item->rawByteSize();
+	_binBlocks  << ( item->isSparseFile() ? item->blocks() : -1 );
+	_binMtimes  << item->mtime();
+	_binNames   << _binStrings.size();
+	_binLinks   << (quint32) item->links();
+	_binModes   << (quint32) ( item->mode() & S_IFMT );
+	_binStrings += name;
+	_itemsWritten.fetchAndAddRelaxed( 1 );
+    }
+
+    if ( item->dotEntry() )
+	collectBinaryItems( item->dotEntry(), index );
+
+    FileInfo * child = item->firstChild();
+
+    while ( child && ! aborted() )
+    {
+	collectBinaryItems( child, index );
+	child = child->next();
+    }
+}
+
+
+QByteArray CacheWriter::urlEncoded( const QString & path )
+{
+    // Using a protocol ("scheme") part to avoid directory names with a colon
+    // ":" being cut off because it looks like a URL protocol.
+    QUrl url;
+    url.setScheme( "foo" );
+    url.setPath( path );
+
+    QByteArray encoded = url.toEncoded( QUrl::RemoveScheme );
+
+    if ( encoded.isEmpty() )
+    {
+        logError() << "Invalid file/dir name: " << path << endl;
+    }
+
+    return encoded;
+
+}
+
+
+QString CacheWriter::formatSize( FileSize size )
+{
+    if ( size >= TB && size % TB == 0 )
+        return QString( "%1T" ).arg( size / TB );
+
+    if ( size >= GB && size % GB == 0 )
+        return QString( "%1G" ).arg( size / GB );
+
+    if ( size >= MB && size % MB == 0 )
+        return QString( "%1M" ).arg( size / MB );
+
+    if ( size >= KB && size % KB == 0 )
+        return QString( "%1K" ).arg( size / KB );
+
+    return QString( "%1" ).arg( size );
+}
+
+
+void CacheWriter::appendUrlEncoded( QByteArray & line, const QString & path )
+{
+    // The same characters as in the path of a QUrl are left as they are;
+    // everything else is written in UTF-8 and percent-encoded.
+
+    static const char hexDigits[] = "0123456789ABCDEF";
+
+    if ( path.isEmpty() )
+    {
+	logError() << "Invalid file/dir name: " << path << endl;
+	return;
+    }
+
+    const QChar * pos = path.constData();
+    const QChar * end = pos + path.size();
+
+    for ( ; pos < end; ++pos )
+    {
+	uint  code = pos->unicode();
+	uchar utf8[ 4 ];
+	int   len;
+
+	if ( code < 0x80 )
+	{
+	    if ( ( code >= 'a' && code <= 'z' ) ||
+		 ( code >= 'A' && code <= 'Z' ) ||
+		 ( code >= '0' && code <= '9' ) ||
+		 ( code && strchr( "-._~/!$&'()*+,;=:@", code ) ) )
+	    {
+		line += (char) code;
+		continue;
+	    }
+
+	    utf8[ 0 ] = code;
+	    len = 1;
+	}
+	else if ( code < 0x800 )
+	{
+	    utf8[ 0 ] = 0xC0 | ( code >> 6 );
+	    utf8[ 1 ] = 0x80 | ( code & 0x3F );
+	    len = 2;
+	}
+	else if ( QChar::isHighSurrogate( code ) && pos + 1 < end && ( pos + 1 )->isLowSurrogate() )
+	{
+	    code = QChar::surrogateToUcs4( code, ( ++pos )->unicode() );
+
+	    utf8[ 0 ] = 0xF0 | ( code >> 18 );
+	    utf8[ 1 ] = 0x80 | ( ( code >> 12 ) & 0x3F );
+	    utf8[ 2 ] = 0x80 | ( ( code >> 6 ) & 0x3F );
+	    utf8[ 3 ] = 0x80 | ( code & 0x3F );
+	    len = 4;
+	}
+	else
+	{
+	    if ( pos->isSurrogate() )	// Like QString::toUtf8()
+		code = QChar::ReplacementCharacter;
+
+	    utf8[ 0 ] = 0xE0 | ( code >> 12 );
+	    utf8[ 1 ] = 0x80 | ( ( code >> 6 ) & 0x3F );
+	    utf8[ 2 ] = 0x80 | ( code & 0x3F );
+	    len = 3;
+	}
+
+	for ( int i = 0; i < len; ++i )
+	{
+	    line += '%';
+	    line += hexDigits[ utf8[ i ] >> 4 ];
+	    line += hexDigits[ utf8[ i ] & 0x0F ];
+	}
+    }
+}
+
+
+void CacheWriter::appendSize( QByteArray & line, FileSize size )
+{
+    if ( size < 0 )
+    {
+	line += '-';
+	size = -size;
+    }
+
+    if	    ( size >= TB && size % TB == 0 ) { appendNumber( line, size / TB ); line += 'T'; }
+    else if ( size >= GB && size % GB == 0 ) { appendNumber( line, size / GB ); line += 'G'; }
+    else if ( size >= MB && size % MB == 0 ) { appendNumber( line, size / MB ); line += 'M'; }
+    else if ( size >= KB && size % KB == 0 ) { appendNumber( line, size / KB ); line += 'K'; }
+    else appendNumber( line, size );
+}
+
+
+void CacheWriter::appendNumber( QByteArray & line, quint64 number, int base )
+{
+    char   digits[ 24 ];
+    char * end = digits + sizeof( digits );
+    char * pos = end;
+
+    do
+    {
+	*--pos = "0123456789abcdef"[ number % base ];
+	number /= base;
+    }
+    while ( number > 0 );
+
+    line.append( pos, end - pos );
+}
+
+
+
+
+
+
+CacheWriterThread::CacheWriterThread( const QString & fileName,
+				      DirTree *	      tree,
+				      bool	      longFormat ):
+    TreeWriterThread(),
+    CacheWriter( -1, longFormat ),
+    _fileName( fileName ),
+    _tree( tree )
+{
+    _readOnlyTree = true;
+    prepareTree( fileName, tree );
+}
+
+
+void CacheWriterThread::run()
+{
+    if ( isBinaryCacheName( _fileName ) )
+	_ok = writeBinaryCache( _fileName, _tree );
+    else
+	_ok = writeCache( _fileName, _tree );
+}
+
+
+
+
+
+
+
+CacheStreamWriter::CacheStreamWriter( int fd, DirTree * tree, bool longFormat ):
+    QObject(),
+    CacheWriter( fd, longFormat ),
+    _tree( tree )
+{
+    write( QString( "[qdirstat %1 cache file]\n" ).arg( CACHE_FORMAT_VERSION ).toUtf8() );
+    flushStream();
+
+    connect( _tree, SIGNAL( readJobFinished( DirInfo * ) ),
+	     this,  SLOT  ( readJobFinished( DirInfo * ) ) );
+}
+
+
+CacheStreamWriter::~CacheStreamWriter()
+{
+    flushStream();
+}
+
+
+void CacheStreamWriter::readJobFinished( DirInfo * dir )
+{
+    if ( ! dir || dir == _tree->root() || dir->isPseudoDir() )
+	return;
+
+    // Excluded directories and mount points are finished while their
+    // parent is still being read; they are written with the parent.
+
+    DirInfo * parent = dir->parent();
+
+    if ( parent && parent != _tree->root() &&
+	 ( parent->readState() == DirReading || parent->readState() == DirQueued ) )
+    {
+	return;
+    }
+
+    writeDir( dir );
+
+    if ( ! flushStream() )
+	_tree->abortReading();	// Nobody is listening anymore
+}
+
+
+void CacheStreamWriter::writeDir( DirInfo * dir )
+{
+    writeItem( dir );
+
+    if ( dir->dotEntry() )
+	writeTree( dir->dotEntry() );
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( ! child->isDirInfo() )
+	{
+	    writeItem( child );
+	}
+	else if ( child->readState() != DirQueued &&
+		  child->readState() != DirReading )
+	{
+	    // Not read by a job of its own
+
+	    writeTree( child );
+	}
+    }
+}
+
+
+
+
+
+
+
+CacheSnapshotWriter::CacheSnapshotWriter( int fd, FileInfo * subtree, bool longFormat ):
+    CacheWriter( fd, longFormat )
+{
+    write( QString( "[qdirstat %1 cache file]\n" ).arg( CACHE_FORMAT_VERSION ).toUtf8() );
+
+    if ( subtree )
+    {
+	// The first directory is the toplevel of the reading side, so a dot
+	// entry can't be the start; use its directory instead.
+
+	if ( subtree->isDotEntry() )
+	    subtree = subtree->parent();
+
+	if ( subtree )
+	    writeSubtree( subtree );
+    }
+
+    flushStream();
+}
+
+
+void CacheSnapshotWriter::writeSubtree( FileInfo * item )
+{
+    if ( ! item->isDotEntry() )
+	writeItem( item );
+
+    if ( _streamBuffer.size() > SNAPSHOT_FLUSH_SIZE && ! flushStream() )
+	return;	 // Nobody is listening anymore
+
+    if ( item->dotEntry() )
+	writeSubtree( item->dotEntry() );
+
+    for ( FileInfo * child = item->firstChild(); child && _ok; child = child->next() )
+	writeSubtree( child );
+}
+
+
+
+
+
+
+
+bool CacheCheckpoint::write( const QString & fileName, DirTree * tree )
+{
+    FileInfo * toplevel = tree ? tree->firstToplevel() : 0;
+
+    if ( ! toplevel )
+	return false;
+
+    QStringList pending;
+    collectPending( toplevel, pending );
+
+    // Unchanged blocks of the previous checkpoint are copied (see
+    // CacheWriter::writeCache()), so this gets cheaper for a huge tree
+    // where only a few toplevel subdirectories are still being read.
+
+    CacheWriter writer( fileName, tree );
+
+    if ( ! writer.ok() )
+    {
+	logError() << "Could not write checkpoint " << fileName << endl;
+	return false;
+    }
+
+    QByteArray data = CHECKPOINT_HEADER "\n";
+    data += "cache-size " + QByteArray::number( QFileInfo( fileName ).size() ) + "\n";
+
+    foreach ( const QString & url, pending )
+    {
+	QByteArray line = url.toUtf8();
+	line.replace( '%',  "%25" );
+	line.replace( '\n', "%0A" );
+	data += line + "\n";
+    }
+
+    QString pendingName = pendingFileName( fileName );
+    QString outputName	= pendingName + ".new";
+    QFile   file( outputName );
+
+    bool ok = file.open( QIODevice::WriteOnly | QIODevice::Truncate ) &&
+	file.write( data ) == data.size() &&
+	file.flush() &&
+	::fsync( file.handle() ) == 0;
+
+    file.close();
+
+    if ( ok && ::rename( outputName.toUtf8(), pendingName.toUtf8() ) != 0 )
+	ok = false;
+
+    if ( ! ok )
+    {
+	logError() << "Could not write " << pendingName << ": " << formatErrno() << endl;
+	QFile::remove( outputName );
+	return false;
+    }
+
+    logInfo() << "Checkpoint " << fileName << " with " << pending.size()
+	      << " unfinished directories" << endl;
+
+    return true;
+}
+
+
+void CacheCheckpoint::collectPending( FileInfo * item, QStringList & pending )
+{
+    if ( ! item->isDirInfo() || item->isPseudoDir() )
+	return;
+
+    switch ( item->readState() )
+    {
+	case DirQueued:
+	case DirReading:
+	case DirAborted:
+	    // Partially read directories are read again completely
+
+	    pending << item->url();
+	    return;
+
+	default:
+	    break;
+    }
+
+    for ( FileInfo * child = item->firstChild(); child; child = child->next() )
+	collectPending( child, pending );
+}
+
+
+bool CacheCheckpoint::readPending( const QString & fileName, QStringList & pending_ret )
+{
+    pending_ret.clear();
+    QFile file( pendingFileName( fileName ) );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+    {
+	logError() << "Can't open " << file.fileName() << ": " << file.errorString() << endl;
+	return false;
+    }
+
+    QByteArray header = file.readLine().trimmed();
+    QByteArray size   = file.readLine().trimmed();
+
+    if ( header != CHECKPOINT_HEADER || ! size.startsWith( "cache-size " ) )
+    {
+	logError() << file.fileName() << " is not a checkpoint" << endl;
+	return false;
+    }
+
+    if ( size.mid( 11 ).toLongLong() != QFileInfo( fileName ).size() )
+    {
+	logError() << fileName << " does not belong to " << file.fileName() << endl;
+	return false;
+    }
+
+    while ( ! file.atEnd() )
+    {
+	QByteArray line = file.readLine();
+
+	if ( line.endsWith( '\n' ) )
+	    line.chop( 1 );
+
+	if ( ! line.isEmpty() )
+	    pending_ret << QString::fromUtf8( QByteArray::fromPercentEncoding( line ) );
+    }
+
+    logInfo() << "Checkpoint " << fileName << " has " << pending_ret.size()
+	      << " unfinished directories" << endl;
+
+    return true;
+}
+
+
+void CacheCheckpoint::remove( const QString & fileName )
+{
+    QFile::remove( fileName );
+    QFile::remove( fileName + CACHE_INDEX_SUFFIX );
+    QFile::remove( pendingFileName( fileName ) );
+}
+
+
+
+
+
+
+CacheReader::CacheReader( const QString & fileName,
+			  DirTree *	  tree,
+			  DirInfo *	  parent ):
+    QObject()
+{
+    init( fileName, tree, parent );
+
+    if ( openBinary( fileName ) )
+    {
+	// A binary cache file needs no index for lazy loading. A shared
+	// image is always read lazily: Its pages are shared with the other
+	// instances, the directories that are created are not.
+
+	if ( ! parent && _tree &&
+	     ( _tree->lazyCacheLoading() || SharedCacheImage::isImage( fileName ) ) )
+	{
+	    startLazyBinary( 0, _binItemCount );
+	}
+	else
+	{
+	    checkBinaryItems();
+	}
+
+	return;
+    }
+
+    if ( ! openText( 0 ) )
+	return;
+
+    // logDebug() << "Opening " << fileName << " OK" << endl;
+
+    if ( ! checkHeader() )
+	return;
+
+    if ( ! parent && _tree && _tree->lazyCacheLoading() &&
+	 CacheWriter::readCacheIndex( fileName, QString(), _lazyBlocks ) )
+    {
+	// Read only the toplevel block now and the others when they are
+	// needed. This needs the summaries of the directories in the index.
+
+	_lazyBlocks.removeFirst();
+
+	foreach ( const CacheBlockInfo & block, _lazyBlocks )
+	{
+	    if ( ! block.hasSummary )
+	    {
+		_lazyBlocks.clear();
+		break;
+	    }
+	}
+
+	if ( ! _lazyBlocks.isEmpty() )
+	    logInfo() << "Lazy loading of " << _lazyBlocks.size() << " blocks of " << fileName << endl;
+    }
+}
+
+
+CacheReader::CacheReader( const QString	       & fileName,
+			  DirTree	       * tree,
+			  DirInfo	       * placeholder,
+			  const CacheBlockInfo & block ):
+    QObject()
+{
+    init( fileName, tree, placeholder );
+
+    _target	  = placeholder;
+    _targetPrefix = placeholder->url() + "/";
+    _startOffset  = block.offset;
+    _compactPaths = block.compactPaths;	// there is no header
+
+    logDebug() << "Reading " << placeholder << " from " << fileName << endl;
+
+    // In a binary cache file, the block is the range of items of the
+    // subtree
+
+    if ( openBinary( fileName ) )
+    {
+	startLazyBinary( block.offset, block.offset + block.size + 1 );
+	return;
+    }
+
+    // A block has no header; it starts with the line of its directory.
+
+    openText( block.offset );
+}
+
+
+CacheReader::CacheReader( QIODevice	* stream,
+			  const QString & name,
+			  DirTree	* tree,
+			  DirInfo	* target ):
+    QObject()
+{
+    init( name, tree, target );
+    _stream = stream;
+
+    if ( target )
+    {
+	_target	      = target;
+	_targetPrefix = target->url() + "/";
+    }
+
+    // The header is checked when it arrives
+}
+
+
+CacheReader::CacheReader( CacheReadPipeline * pipeline,
+			  const QString	    & name,
+			  DirTree	    * tree ):
+    QObject()
+{
+    init( name, tree, 0 );
+    _pipeline = pipeline;
+    _pipeline->start();
+}
+
+
+void CacheReader::init( const QString & fileName, DirTree * tree, DirInfo * parent )
+{
+    _fileName		= fileName;
+    _buffer[0]		= 0;
+    _line		= _buffer;
+    _lineNo		= 0;
+    _ok			= true;
+    _errorCount         = 0;
+    _tree		= tree;
+    _toplevel		= parent;
+    _lastDir		= 0;
+    _lastExcludedDir	= 0;
+    _filterDir		= 0;
+    _cache		= 0;
+    _zstdCache		= 0;
+    _startOffset	= 0;
+    _binary		= false;
+    _binaryFile		= 0;
+    _binItemCount	= 0;
+    _binNextItem	= 0;
+    _binEndItem		= 0;
+    _binStringsSize	= 0;
+    _binLazy		= false;
+    _binTop		= 0;
+    _binTopDir		= 0;
+    _binPendingDir	= 0;
+    _pipeline		= 0;
+    _waitForBlocks	= true;
+    _blockPending	= false;
+    _block		= 0;
+    _blockPos		= 0;
+    _blockStartLine	= 0;
+    _target		= 0;
+    _blockDone		= false;
+    _stream		= 0;
+    _streamFinished	= false;
+    _headerChecked	= false;
+    _compactPaths	= false;
+    _mergeParent	= 0;
+
+    if ( _tree )
+    {
+	connect( _tree, SIGNAL( deletingChild	    ( FileInfo * ) ),
+		 this,	SLOT  ( deletingChildNotify ( FileInfo * ) ) );
+
+	connect( _tree, SIGNAL( clearingSubtree	     ( DirInfo * ) ),
+		 this,	SLOT  ( clearingSubtreeNotify( DirInfo * ) ) );
+    }
+}
+
+
+bool CacheReader::openText( qint64 offset )
+{
+    if ( ZstdReader::isZstdFile( _fileName ) )
+    {
+	_zstdCache = new ZstdReader( _fileName );
+	CHECK_NEW( _zstdCache );
+
+	if ( offset > 0 && _zstdCache->ok() )
+	    _zstdCache->seek( offset );
+
+	if ( ! _zstdCache->ok() )
+	{
+	    _ok = false;
+	    emit error();
+	    return false;
+	}
+
+	return true;
+    }
+
+    if ( offset == 0 )
+    {
+	_cache = gzopen( _fileName.toUtf8(), "r" );
+    }
+    else
+    {
+	// zlib starts reading at the current position of the file descriptor
+
+	int fd = ::open( _fileName.toUtf8(), O_RDONLY );
+
+	if ( fd >= 0 )
+	{
+	    if ( lseek( fd, offset, SEEK_SET ) == offset )
+		_cache = gzdopen( fd, "r" );
+
+	    if ( ! _cache )
+		::close( fd );
+	}
+    }
+
+    if ( _cache == 0 )
+    {
+	logError() << "Can't open " << _fileName << ": " << formatErrno() << endl;
+	_ok = false;
+	emit error();
+	return false;
+    }
+
+    return true;
+}
+
+
+CacheReader::~CacheReader()
+{
+    stopPipeline();	// before closing the file the pipeline reads from
+
+    if ( _cache )
+	gzclose( _cache );
+
+    if ( _zstdCache )
+	delete _zstdCache;
+
+    if ( _binaryFile )
+	delete _binaryFile;	// This also unmaps the file
+
+    logDebug() << "Cache reading finished" << endl;
+
+    if ( _target && _target->isCachePlaceholder() )
+    {
+	logError() << _fileName << ": No data for " << _target << endl;
+	_target->reset();
+	_target->setReadState( DirError );
+    }
+
+    if ( _target && _stream && _target->readState() == DirQueued )
+    {
+	// Nothing arrived for it, so it is still waiting to be read in some
+	// other way
+
+	logError() << _fileName << ": No data for " << _target << endl;
+	_toplevel = 0;
+    }
+
+    if ( _toplevel )
+    {
+	// logDebug() << "Finalizing recursive for " << _toplevel << endl;
+	_toplevel->finalizeAll();
+	finalizeRecursive( _toplevel );
+    }
+
+    emit finished();
+}
+
+
+void CacheReader::deletingChildNotify( FileInfo * deletedChild )
+{
+    QMutableHashIterator<QString, DirInfo *> it( _dirsByPath );
+
+    while ( it.hasNext() )
+    {
+	it.next();
+
+	if ( it.value()->isInSubtree( deletedChild ) )
+	    it.remove();
+    }
+
+    if ( _lastDir && _lastDir->isInSubtree( deletedChild ) )
+	_lastDir = 0;
+
+    if ( _lastExcludedDir && _lastExcludedDir->isInSubtree( deletedChild ) )
+	_lastExcludedDir = 0;
+
+    if ( _filterDir && _filterDir->isInSubtree( deletedChild ) )
+	_filterDir = 0;
+
+    if ( _target && _target->isInSubtree( deletedChild ) )
+    {
+	_target	   = 0;
+	_toplevel  = 0;
+	_blockDone = true;
+    }
+
+    for ( int i = 0; i < _binDirs.size(); ++i )
+    {
+	if ( _binDirs.at( i ) && _binDirs.at( i )->isInSubtree( deletedChild ) )
+	{
+	    _binDirs[ i ] = 0;
+	    _binSkipChildren.setBit( i );
+	}
+    }
+
+    if ( _binPendingDir && _binPendingDir->isInSubtree( deletedChild ) )
+    {
+	_binPendingDir = 0;
+	_binDirStack.clear();
+    }
+
+    if ( _binTopDir && _binTopDir->isInSubtree( deletedChild ) )
+    {
+	_binTopDir   = 0;
+	_binNextItem = _binEndItem;	// Nothing left to add it to
+    }
+}
+
+
+void CacheReader::clearingSubtreeNotify( DirInfo * subtree )
+{
+    FileInfo * child = subtree->firstChild();
+
+    while ( child )
+    {
+	deletingChildNotify( child );
+	child = child->next();
+    }
+
+    if ( subtree->dotEntry() )
+	deletingChildNotify( subtree->dotEntry() );
+}
+
+
+void CacheReader::rewind()
+{
+    if ( _binary )
+    {
+	_binNextItem   = _binLazy ? _binTop : 0;
+	_lastDir       = 0;
+	_binPendingDir = 0;
+	_binDirStack.clear();
+	_binDirs.fill( 0 );
+	_binSkipChildren.fill( false );
+    }
+    else if ( _cache || _zstdCache )
+    {
+	stopPipeline();
+	_lineNo	   = 0;
+	_blockDone = false;
+
+	if ( _zstdCache )
+	    _zstdCache->seek( _startOffset );
+	else
+	    gzrewind( _cache );	// This goes back to the offset it was opened at
+
+	_lastRawPath.clear();
+
+	if ( ! _target )
+	    checkHeader();	// skip cache header
+    }
+}
+
+
+bool CacheReader::read( int maxLines )
+{
+    if ( _binary )
+	return readBinary( maxLines );
+
+    if ( _stream )
+	return readStream( maxLines );
+
+    readAhead();
+
+    if ( _pipeline )
+	return readPipeline( maxLines );
+
+    while ( ! eof() && ( maxLines == 0 || --maxLines > 0 ) )
+    {
+	if ( readLine() )
+	{
+	    splitLine();
+
+	    CacheItem item;
+	    item.lineNo = _lineNo;
+	    parseItem( _fields, _fieldsCount, item );
+	    addItem( item );
+	}
+    }
+
+    return _ok && ! eof();
+}
+
+
+void CacheReader::readAhead()
+{
+    // Not for the toplevel block of lazy loading: It is usually small, and
+    // the pipeline would read ahead much more than that.
+
+    if ( ! _pipeline && _ok && ( _cache || _zstdCache ) && ! eof() &&
+	 _lazyBlocks.isEmpty() && CacheReadPipeline::defaultParserCount() > 0 )
+    {
+	startPipeline();
+    }
+}
+
+
+void CacheReader::mergeInto( DirInfo * parent, const QString & label )
+{
+    _mergeParent = parent;
+    _mergeLabel	 = label;
+    _lazyBlocks.clear();	// No placeholders in a merged tree
+
+    if ( _binLazy && ! _target )
+    {
+	_binLazy = false;
+	checkBinaryItems();
+    }
+}
+
+
+void CacheReader::startPipeline()
+{
+    _pipeline = new CacheReadPipeline( _cache, _zstdCache,
+				       CacheReadPipeline::defaultParserCount() );
+    CHECK_NEW( _pipeline );
+
+    _block	    = 0;
+    _blockPos	    = 0;
+    _blockStartLine = _lineNo;	// the lines of the header
+
+    _pipeline->start();
+}
+
+
+void CacheReader::stopPipeline()
+{
+    if ( _block )
+	delete _block;
+
+    if ( _pipeline )
+	delete _pipeline;	// This stops and waits for the threads
+
+    _block    = 0;
+    _pipeline = 0;
+}
+
+
+bool CacheReader::readPipeline( int maxItems )
+{
+    _blockPending = false;
+
+    while ( _ok && ! _blockDone && ( maxItems == 0 || --maxItems > 0 ) )
+    {
+	while ( ! _block || _blockPos >= _block->items.size() )
+	{
+	    if ( _block )
+	    {
+		_blockStartLine += _block->lineCount;
+		delete _block;
+	    }
+
+	    {
+		READ_TRACE_SCOPE( "cache take block", QString() );
+		_block = _waitForBlocks ? _pipeline->takeBlock() : _pipeline->tryTakeBlock( this );
+	    }
+
+	    _blockPos = 0;
+
+	    if ( ! _block && ! _waitForBlocks && ! _pipeline->atEnd() )
+	    {
+		// Not parsed yet; blockAvailable() will be sent
+
+		_blockPending = true;
+		return true;
+	    }
+
+	    if ( ! _block )
+	    {
+		if ( _pipeline->readError() )
+		{
+		    _ok = false;
+		    logError() << _fileName << ":" << _blockStartLine << ": Read error" << endl;
+		    emit error();
+		}
+
+		return false;
+	    }
+	}
+
+	const CacheItem & item = _block->items.at( _blockPos++ );
+	_lineNo = _blockStartLine + item.lineNo;
+	addItem( item );
+    }
+
+    return _ok && ! eof();
+}
+
+
+bool CacheReader::readStream( int maxLines )
+{
+    while ( _ok && _stream->canReadLine() && ( maxLines == 0 || --maxLines > 0 ) )
+    {
+	if ( _stream->readLine( _buffer, MAX_CACHE_LINE_LEN ) < 0 )
+	{
+	    _ok = false;
+	    logError() << _fileName << ":" << _lineNo << ": Read error" << endl;
+	    emit error();
+	    break;
+	}
+
+	_lineNo++;
+	_line = skipWhiteSpace( _buffer );
+
+	if ( *_line == 0 || *_line == '#' )	// empty line or comment
+	    continue;
+
+	if ( ! _headerChecked )
+	{
+	    _headerChecked = true;
+
+	    if ( ! checkHeaderLine() )
+		break;
+
+	    continue;
+	}
+
+	splitLine();
+
+	CacheItem item;
+	item.lineNo = _lineNo;
+	parseItem( _fields, _fieldsCount, item );
+	addItem( item );
+    }
+
+    return _ok && ! eof();
+}
+
+
+void CacheReader::parseItem( char ** fields, int fieldsCount, CacheItem & item )
+{
+    item.fieldsCount = fieldsCount;
+
+    if ( fieldsCount < 4 )
+	return;
+
+    int n = 0;
+    char * type		= fields[ n++ ];
+    char * raw_path	= fields[ n++ ];
+    char * size_str	= fields[ n++ ];
+    char * mtime_str	= fields[ n++ ];
+    char * blocks_str	= 0;
+    char * links_str	= 0;
+
+    while ( fieldsCount > n+1 )
+    {
+	char * keyword	= fields[ n++ ];
+	char * val_str	= fields[ n++ ];
+
+	if ( strcasecmp( keyword, "blocks:" ) == 0 ) blocks_str = val_str;
+	if ( strcasecmp( keyword, "links:"  ) == 0 ) links_str	= val_str;
+    }
+
+
+    // Type
+
+    mode_t mode = S_IFREG;
+
+    if	    ( strcasecmp( type, "F"	   ) == 0 )	mode = S_IFREG;
+    else if ( strcasecmp( type, "D"	   ) == 0 )	mode = S_IFDIR;
+    else if ( strcasecmp( type, "L"	   ) == 0 )	mode = S_IFLNK;
+    else if ( strcasecmp( type, "BlockDev" ) == 0 )	mode = S_IFBLK;
+    else if ( strcasecmp( type, "CharDev"  ) == 0 )	mode = S_IFCHR;
+    else if ( strcasecmp( type, "FIFO"	   ) == 0 )	mode = S_IFIFO;
+    else if ( strcasecmp( type, "Socket"   ) == 0 )	mode = S_IFSOCK;
+
+    item.mode	    = mode;
+    item.isDir	    = strcasecmp( type, "D" ) == 0;
+    item.isAbsolute = *raw_path == '/';
+
+
+    // Size
+
+    const char * end = 0;
+    FileSize size = LineTokenizer::parseDecimal( size_str, &end );
+
+    switch ( *end )
+    {
+	case 'K':   size *= KB; break;
+	case 'M':   size *= MB; break;
+	case 'G':   size *= GB; break;
+	case 'T':   size *= TB; break;
+	default: break;
+    }
+
+    item.size = size;
+
+
+    // MTime
+
+    item.mtime = LineTokenizer::parseNumber( mtime_str );
+
+
+    // Blocks
+
+    item.blocks = blocks_str ? LineTokenizer::parseDecimal( blocks_str ) : -1;
+
+
+    // Links
+
+    item.links = links_str ? LineTokenizer::parseDecimal( links_str ) : 1;
+
+
+    // Path and name
+
+    item.sharedPrefix = -1;
+
+    if ( *raw_path == '^' && strchr( raw_path, ':' ) )
+    {
+	// Delta-encoded against the last full path. That is only known in
+	// file order, so this is resolved by resolvePath().
+
+	item.sharedPrefix = atoi( raw_path + 1 );
+	item.rawPath	  = raw_path;
+	item.isAbsolute	  = true;
+
+	return;
+    }
+
+    if ( item.isAbsolute )
+	item.rawPath = raw_path;	// for the next delta-encoded path
+
+    splitPath( unescapedPath( raw_path ), item.path, item.name );
+}
+
+
+const CacheItem & CacheReader::resolvePath( const CacheItem & item,
+					    CacheItem	    & resolved_ret )
+{
+    if ( item.fieldsCount < 4 )
+	return item;
+
+    if ( ! _compactPaths )
+    {
+	if ( item.sharedPrefix < 0 )
+	    return item;
+
+	// An old format file: This is just a name that starts with "^"
+
+	resolved_ret = item;
+	resolved_ret.isAbsolute = false;
+	splitPath( unescapedPath( QString::fromUtf8( item.rawPath ) ),
+		   resolved_ret.path, resolved_ret.name );
+
+	return resolved_ret;
+    }
+
+    if ( item.sharedPrefix < 0 )
+    {
+	if ( item.isAbsolute )
+	    _lastRawPath = item.rawPath;
+
+	return item;
+    }
+
+    resolved_ret = item;
+
+    if ( item.sharedPrefix > _lastRawPath.size() )
+    {
+	logError() << _fileName << ":" << _lineNo
+		   << ": Delta-encoded path without a matching full path before it" << endl;
+	resolved_ret.fieldsCount = 0;	// a syntax error for addItem()
+
+	return resolved_ret;
+    }
+
+    _lastRawPath.truncate( item.sharedPrefix );
+    _lastRawPath += item.rawPath.mid( item.rawPath.indexOf( ':' ) + 1 );
+
+    splitPath( unescapedPath( QString::fromUtf8( _lastRawPath ) ),
+	       resolved_ret.path, resolved_ret.name );
+
+    return resolved_ret;
+}
+
+
+void CacheReader::addItem( const CacheItem & rawItem )
+{
+    CacheItem	      resolvedItem;
+    const CacheItem & item = resolvePath( rawItem, resolvedItem );
+
+    if ( item.fieldsCount < 4 )
+    {
+	logError() << "Syntax error in " << _fileName << ":" << _lineNo
+		   << ": Expected at least 4 fields, saw only " << item.fieldsCount
+		   << endl;
+
+	setReadError( _lastDir );
+
+	if ( ++_errorCount > MAX_ERROR_COUNT )
+	{
+	    logError() << "Too many syntax errors. Giving up." << endl;
+	    _ok = false;
+	    emit error();
+	}
+
+	return;
+    }
+
+    if ( item.isAbsolute )
+	_lastDir = 0;
+
+    const QString & path = item.path;
+    const QString & name = item.name;
+
+    if ( item.isDir && ( _target || ! _lazyBlocks.isEmpty() ) )
+    {
+	QString url = buildPath( path, name );
+
+	if ( ! checkBlockEnd( url ) )
+	    return;
+
+	if ( _target && url == _target->url() &&
+	     ( _target->isCachePlaceholder() || _stream ) )
+	{
+	    // Read the content of the block into the placeholder itself or
+	    // the stream into the directory that is waiting for it
+
+	    if ( _target->isCachePlaceholder() )
+		_target->reset();
+
+	    _target->setReadState( DirReading );
+	    _dirsByPath.insert( url, _target );
+	    _lastDir = _target;
+
+	    return;
+	}
+    }
+
+    if ( _lastExcludedDir )
+    {
+	if ( path.startsWith( _lastExcludedDirUrl ) )
+	{
+	    // logDebug() << "Excluding " << path << "/" << name << endl;
+	    return;
+	}
+    }
+
+    // Find parent in tree
+
+    DirInfo * parent = _lastDir;
+
+    if ( ! parent && _tree->root() )
+    {
+	parent = locateParent( path, name );
+
+	if ( ! parent )
+	    return;	// Ignore this cache line completely
+    }
+
+    if ( item.isDir )
+	addDir( parent, path, name, item.mode, item.size, item.mtime );
+    else
+	addFile( parent, name, item.mode, item.size, item.mtime, item.blocks, item.links );
+}
+
+
+bool CacheReader::checkBlockEnd( const QString & url )
+{
+    if ( _target )
+    {
+	if ( url.startsWith( _targetPrefix ) || url == _target->url() )
+	    return true;
+    }
+    else
+    {
+	// Any directory after the toplevel is the start of the next block
+
+	if ( ! _toplevel || url == _toplevel->url() )
+	    return true;
+    }
+
+    _blockDone = true;
+
+    if ( ! _lazyBlocks.isEmpty() )
+	addPlaceholders();
+
+    return false;
+}
+
+
+void CacheReader::addPlaceholders()
+{
+    foreach ( const CacheBlockInfo & block, _lazyBlocks )
+    {
+	DirInfo * dir = new DirInfo( _tree, _toplevel, block.name,
+				     S_IFDIR, block.dirSize, block.dirMtime );
+	CHECK_NEW( dir );
+
+	_toplevel->insertChild( dir );
+	_tree->childAddedNotify( dir );
+
+	if ( ExcludeRules::instance()->match( dir->url(), dir->name() ) )
+	{
+	    logDebug() << "Excluding " << dir->name() << endl;
+	    dir->setExcluded();
+	    dir->setReadState( DirOnRequestOnly );
+	}
+	else
+	{
+	    dir->setCachePlaceholder( block );
+	    _tree->addCachePlaceholder( dir, _fileName, block );
+	}
+
+	dir->finalizeLocal();	// Remove the empty dot entry
+	_tree->sendReadJobFinished( dir );
+    }
+
+    _lazyBlocks.clear();
+}
+
+
+DirInfo * CacheReader::locateParent( const QString & path, const QString & name )
+{
+    DirInfo * parent = _dirsByPath.value( path, 0 );
+
+    if ( ! parent && _mergeParent && ! _toplevel )
+	return _mergeParent;
+
+    if ( ! parent && ! _tree->root()->hasChildren() )
+	parent = _tree->root();
+
+    // Try the easy way first - the starting point of this cache
+
+    if ( ! parent && _toplevel )
+    {
+	FileInfo * item = _toplevel->locate( path );
+	parent = item ? item->toDirInfo() : 0;
+    }
+
+#if DEBUG_LOCATE_PARENT
+    if ( parent )
+	logDebug() << "Using cache starting point as parent for " << path << "/" << name << endl;
+#endif
+
+
+    // Fallback: Search the entire tree
+
+    if ( ! parent )
+    {
+	FileInfo * item = _tree->locate( path );
+	parent = item ? item->toDirInfo() : 0;
+
+#if DEBUG_LOCATE_PARENT
+	if ( parent )
+	    logDebug() << "Located parent " << path << " in tree" << endl;
+#endif
+    }
+
+    if ( ! parent ) // Still nothing?
+    {
+	logError() << _fileName << ":" << _lineNo << ": "
+		   << "Could not locate parent \"" << path << "\" for "
+		   << name << endl;
+
+	if ( ++_errorCount > MAX_ERROR_COUNT )
+	{
+	    logError() << "Too many consistency errors. Giving up." << endl;
+	    _ok = false;
+	    emit error();
+	}
+
+#if DEBUG_LOCATE_PARENT
+	THROW( Exception( "Could not locate cache item parent" ) );
+#endif
+    }
+
+    return parent;
+}
+
+
+DirInfo * CacheReader::addDir( DirInfo	     * parent,
+			       const QString & path,
+			       const QString & name,
+			       mode_t	       mode,
+			       FileSize	       size,
+			       time_t	       mtime )
+{
+    QString url = ( parent == _tree->root() ) ? buildPath( path, name ) : name;
+
+    if ( parent && parent == _mergeParent )
+	url = _mergeLabel + ":" + buildPath( path, name );
+#if VERBOSE_CACHE_DIRS
+    logDebug() << "Creating DirInfo for " << url << " with parent " << parent << endl;
+#endif
+    DirInfo * dir = new DirInfo( _tree, parent, url,
+				 mode, size, mtime );
+    dir->setReadState( DirReading );
+    _lastDir = dir;
+
+    if ( ! _binary )	// binary cache files have parent indices instead
+	_dirsByPath.insert( buildPath( path, name ), dir );
+
+    if ( parent )
+	parent->insertChild( dir );
+
+    if ( ! _tree->root() )
+    {
+	_tree->setRoot( dir );
+	_toplevel = dir;
+    }
+
+    if ( ! _toplevel )
+	_toplevel = dir;
+
+    _tree->childAddedNotify( dir );
+
+    if ( dir != _toplevel )
+    {
+	ExcludeRules * excludeRules = ExcludeRules::instance();
+	QString url = excludeRules->hasFullPathRules() ? dir->url() : QString();
+
+	if ( excludeRules->match( url, dir->name() ) )
+	{
+	    logDebug() << "Excluding " << name << endl;
+	    dir->setExcluded();
+	    dir->setReadState( DirOnRequestOnly );
+	    dir->finalizeLocal();
+	    _tree->sendReadJobFinished( dir );
+
+	    _lastExcludedDir	= dir;
+	    _lastExcludedDirUrl = _lastExcludedDir->url();
+	    _lastDir		= 0;
+	}
+    }
+
+    return dir;
+}
+
+
+void CacheReader::addFile( DirInfo	 * parent,
+			   const QString & name,
+			   mode_t	   mode,
+			   FileSize	   size,
+			   time_t	   mtime,
+			   FileSize	   blocks,
+			   nlink_t	   links )
+{
+    if ( parent )
+    {
+#if VERBOSE_CACHE_FILE_INFOS
+	logDebug() << "Creating FileInfo for "
+		   << buildPath( parent->debugUrl(), name ) << endl;
+#endif
+
+	FileInfo * item = new FileInfo( _tree, parent, name,
+					mode, size, mtime,
+					blocks, links );
+	bool ignore = false;
+
+	if ( _tree->hasFilters() )
+	{
+	    // The files of one directory are in a row in the cache file
+
+	    if ( parent != _filterDir )
+	    {
+		_filterDir    = parent;
+		_filterDirUrl = parent->url();
+	    }
+
+	    ignore = _tree->checkIgnoreFilters( _filterDirUrl, name );
+	}
+
+	if ( ignore )
+	    parent->addToAttic( item );
+	else
+	    parent->insertChild( item );
+
+	_tree->childAddedNotify( item );
+    }
+    else
+    {
+	logError() << _fileName << ":" << _lineNo << ": "
+		   << "No parent for item " << name << endl;
+    }
+}
+
+
+bool CacheReader::openBinary( const QString & fileName )
+{
+    QFile * file = new QFile( fileName );
+    CHECK_NEW( file );
+
+    BinaryCacheHeader header;
+
+    if ( ! file->open( QIODevice::ReadOnly ) ||
+	 file->read( (char *) &header, sizeof( header ) ) != sizeof( header ) ||
+	 memcmp( header.magic, BINARY_CACHE_MAGIC, sizeof( header.magic ) ) != 0 )
+    {
+	// Not a binary cache file (or not even readable): Leave it to gzopen()
+
+	delete file;
+	return false;
+    }
+
+    _binary	= true;
+    _binaryFile = file;
+
+    if ( header.byteOrder != BINARY_CACHE_BYTE_ORDER )
+    {
+	logError() << _fileName << ": Binary cache file with different byte order" << endl;
+	_ok = false;
+	emit error();
+	return true;
+    }
+
+    if ( header.version != BINARY_CACHE_FORMAT_VERSION )
+    {
+	logError() << _fileName << ": Incompatible binary cache file version "
+		   << header.version << endl;
+	_ok = false;
+	emit error();
+	return true;
+    }
+
+
+    // Check that all arrays are completely inside the file
+
+    quint64 fileSize = file->size();
+    quint64 count    = header.itemCount;
+
+    _ok = count > 0 && count < fileSize;
+
+    _ok = _ok && header.parentsOffset	  + count * sizeof( qint64  ) <= fileSize;
+    _ok = _ok && header.sizesOffset	  + count * sizeof( qint64  ) <= fileSize;
+    _ok = _ok && header.blocksOffset	  + count * sizeof( qint64  ) <= fileSize;
+    _ok = _ok && header.mtimesOffset	  + count * sizeof( qint64  ) <= fileSize;
+    _ok = _ok && header.namesOffset	  + ( count + 1 ) * sizeof( quint64 ) <= fileSize;
+    _ok = _ok && header.linksOffset	  + count * sizeof( quint32 ) <= fileSize;
+    _ok = _ok && header.modesOffset	  + count * sizeof( quint32 ) <= fileSize;
+    _ok = _ok && header.stringTableOffset + header.stringTableSize <= fileSize;
+
+    _ok = _ok && ( ( header.parentsOffset | header.sizesOffset  | header.blocksOffset |
+		     header.mtimesOffset  | header.namesOffset  | header.linksOffset  |
+		     header.modesOffset ) & 7 ) == 0;
+
+    const uchar * map = _ok ? file->map( 0, fileSize ) : 0;
+
+    if ( ! map )
+    {
+	logError() << _fileName << ": Corrupt binary cache file" << endl;
+	_ok = false;
+	emit error();
+	return true;
+    }
 
-    return QString( "%1" ).arg( size );
+    _binItemCount   = count;
+    _binEndItem	    = count;
+    _binStringsSize = header.stringTableSize;
+    _binParents	  = (const qint64  *) ( map + header.parentsOffset     );
+    _binSizes	  = (const qint64  *) ( map + header.sizesOffset       );
+    _binBlocks	  = (const qint64  *) ( map + header.blocksOffset      );
+    _binMtimes	  = (const qint64  *) ( map + header.mtimesOffset      );
+    _binNames	  = (const quint64 *) ( map + header.namesOffset       );
+    _binLinks	  = (const quint32 *) ( map + header.linksOffset       );
+    _binModes	  = (const quint32 *) ( map + header.modesOffset       );
+    _binStrings	  = (const char	   *) ( map + header.stringTableOffset );
+
+    return true;
 }
 
 
+bool CacheReader::checkBinaryItem( quint64 index ) const
+{
+    return _binNames[ index ] <= _binNames[ index+1 ] &&
+	_binNames[ index+1 ] <= _binStringsSize &&
+	_binParents[ index ] < (qint64) index;	// A parent has to come before its children
+}
 
 
+void CacheReader::checkBinaryItems()
+{
+    for ( quint64 i = 0; i < _binItemCount && _ok; ++i )
+    {
+	if ( ! checkBinaryItem( i ) )
+	{
+	    logError() << _fileName << ": Corrupt binary cache file at item " << i << endl;
+	    _ok = false;
+	    emit error();
+	}
+    }
 
+    if ( _ok )
+    {
+	_binDirs.fill( 0, _binItemCount );
+	_binSkipChildren.fill( false, _binItemCount );
+    }
+}
 
 
-CacheReader::CacheReader( const QString & fileName,
-			  DirTree *	  tree,
-			  DirInfo *	  parent ):
-    QObject(),
-    _multiSlash( "//+" ) // cache regexp for multiple use
+void CacheReader::startLazyBinary( quint64 first, quint64 end )
 {
-    _fileName		= fileName;
-    _buffer[0]		= 0;
-    _line		= _buffer;
-    _lineNo		= 0;
-    _ok			= true;
-    _errorCount         = 0;
-    _tree		= tree;
-    _toplevel		= parent;
-    _lastDir		= 0;
-    _lastExcludedDir	= 0;
-
-    _cache = gzopen( fileName.toUtf8(), "r" );
+    if ( ! _ok )
+	return;
 
-    if ( _cache == 0 )
+    if ( first >= end || end > _binItemCount )
     {
-	logError() << "Can't open " << fileName << ": " << formatErrno() << endl;
+	logError() << _fileName << ": No items " << first << " to " << end
+		   << " in binary cache file" << endl;
 	_ok = false;
 	emit error();
 	return;
     }
 
-    // logDebug() << "Opening " << fileName << " OK" << endl;
-    checkHeader();
-}
+    // The items are checked while they are read: Only this range is
+    // needed, and the complete file might be huge.
 
+    _binLazy	 = true;
+    _binTop	 = first;
+    _binNextItem = first;
+    _binEndItem	 = end;
 
-CacheReader::~CacheReader()
-{
-    if ( _cache )
-	gzclose( _cache );
+    if ( ! _target )
+	logInfo() << "Lazy loading of " << _binItemCount << " items of " << _fileName << endl;
+}
 
-    logDebug() << "Cache reading finished" << endl;
 
-    if ( _toplevel )
+bool CacheReader::readBinary( int maxItems )
+{
+    while ( _binNextItem < _binEndItem
+	    && _ok
+	    && ( maxItems == 0 || --maxItems > 0 ) )
     {
-	// logDebug() << "Finalizing recursive for " << _toplevel << endl;
-	finalizeRecursive( _toplevel );
-	_toplevel->finalizeAll();
+	if ( _binLazy )
+	    addLazyBinaryItem( _binNextItem++ );
+	else
+	    addBinaryItem( _binNextItem++ );
     }
 
-    emit finished();
+    if ( _binLazy && _binNextItem >= _binEndItem )
+	finishBinaryPlaceholder( _binEndItem );
+
+    return _ok && _binNextItem < _binEndItem;
 }
 
 
-void CacheReader::rewind()
+QString CacheReader::binaryName( quint64 index ) const
 {
-    if ( _cache )
-    {
-	gzrewind( _cache );
-	checkHeader();		// skip cache header
-    }
+    quint64 start = _binNames[ index ];
+
+    return QString::fromUtf8( _binStrings + start, _binNames[ index+1 ] - start );
 }
 
 
-bool CacheReader::read( int maxLines )
+void CacheReader::addBinaryItem( quint64 index )
 {
-    while ( ! gzeof( _cache )
-	    && _ok
-	    && ( maxLines == 0 || --maxLines > 0 ) )
+    _lineNo = index + 1;	// for error messages
+
+    qint64   parentIndex = _binParents[ index ];
+    QString  name	 = binaryName( index );
+    QString  path;
+    mode_t   mode	 = _binModes[ index ] & S_IFMT;
+    DirInfo * parent	 = 0;
+
+    if ( mode == 0 )
+	mode = S_IFREG;
+
+    if ( parentIndex < 0 )
     {
-	if ( readLine() )
+	// A toplevel directory with its absolute path: The parent is
+	// somewhere in the tree (or the tree is still empty)
+
+	QString fullPath = name;
+	splitPath( fullPath, path, name );
+	_lastDir = 0;
+
+	if ( _tree->root() )
 	{
-	    splitLine();
-	    addItem();
+	    parent = locateParent( path, name );
+
+	    if ( ! parent )
+	    {
+		_binSkipChildren.setBit( index );
+		return;
+	    }
+	}
+    }
+    else
+    {
+	// The parent is just an array lookup - no locate() needed
+
+	if ( _binSkipChildren.testBit( parentIndex ) )
+	{
+	    _binSkipChildren.setBit( index );
+	    return;
+	}
+
+	parent = _binDirs.at( parentIndex );
+
+	if ( ! parent )
+	{
+	    logError() << _fileName << ": Parent of item " << index
+		       << " is not a directory" << endl;
+	    _binSkipChildren.setBit( index );
+	    return;
 	}
     }
 
-    return _ok && ! gzeof( _cache );
+    if ( S_ISDIR( mode ) )
+    {
+	DirInfo * dir = addDir( parent, path, name, mode,
+				_binSizes[ index ], _binMtimes[ index ] );
+	_binDirs[ index ] = dir;
+
+	if ( dir->isExcluded() )
+	    _binSkipChildren.setBit( index );
+    }
+    else
+    {
+	addFile( parent, name, mode,
+		 _binSizes[ index ], _binMtimes[ index ],
+		 _binBlocks[ index ], _binLinks[ index ] );
+    }
 }
 
 
-void CacheReader::addItem()
+void CacheReader::addLazyBinaryItem( quint64 index )
 {
-    if ( fieldsCount() < 4 )
-    {
-	logError() << "Syntax error in " << _fileName << ":" << _lineNo
-		   << ": Expected at least 4 fields, saw only " << fieldsCount()
-		   << endl;
+    _lineNo = index + 1;	// for error messages
 
-	setReadError( _lastDir );
+    if ( ! checkBinaryItem( index ) ||
+	 ( index > _binTop && _binParents[ index ] < (qint64) _binTop ) )
+    {
+	logError() << _fileName << ": Corrupt binary cache file at item " << index << endl;
+	_ok = false;
+	emit error();
+	return;
+    }
 
-	if ( ++_errorCount > MAX_ERROR_COUNT )
+    if ( index == _binTop )
+    {
+	if ( ! S_ISDIR( _binModes[ index ] ) )
 	{
-	    logError() << "Too many syntax errors. Giving up." << endl;
+	    logError() << _fileName << ": Item " << index << " is not a directory" << endl;
 	    _ok = false;
 	    emit error();
 	}
+	else if ( _target )
+	{
+	    if ( _target->isCachePlaceholder() && binaryName( index ) == _target->name() )
+	    {
+		// Read the direct children into the placeholder itself
+
+		_target->reset();
+		_target->setReadState( DirReading );
+		_binTopDir = _target;
+	    }
+	    else
+	    {
+		logError() << _fileName << ": Item " << index << " is not " << _target << endl;
+		_ok = false;
+		emit error();
+	    }
+	}
+	else
+	{
+	    _binTopDir = addLazyBinaryToplevel();
+	}
+
+	if ( ! _binTopDir )
+	    _binNextItem = _binEndItem;
 
 	return;
     }
 
-    int n = 0;
-    char * type		= field( n++ );
-    char * raw_path	= field( n++ );
-    char * size_str	= field( n++ );
-    char * mtime_str	= field( n++ );
-    char * blocks_str	= 0;
-    char * links_str	= 0;
-
-    while ( fieldsCount() > n+1 )
+    if ( _binParents[ index ] != (qint64) _binTop )
     {
-	char * keyword	= field( n++ );
-	char * val_str	= field( n++ );
-
-	if ( strcasecmp( keyword, "blocks:" ) == 0 ) blocks_str = val_str;
-	if ( strcasecmp( keyword, "links:"  ) == 0 ) links_str	= val_str;
-    }
+	// Somewhere in the subtree of a subdirectory
 
+	if ( _binPendingDir )
+	    sumBinaryItem( index );
 
-    // Type
+	return;
+    }
 
-    mode_t mode = S_IFREG;
+    finishBinaryPlaceholder( index );
 
-    if	    ( strcasecmp( type, "F"	   ) == 0 )	mode = S_IFREG;
-    else if ( strcasecmp( type, "D"	   ) == 0 )	mode = S_IFDIR;
-    else if ( strcasecmp( type, "L"	   ) == 0 )	mode = S_IFLNK;
-    else if ( strcasecmp( type, "BlockDev" ) == 0 )	mode = S_IFBLK;
-    else if ( strcasecmp( type, "CharDev"  ) == 0 )	mode = S_IFCHR;
-    else if ( strcasecmp( type, "FIFO"	   ) == 0 )	mode = S_IFIFO;
-    else if ( strcasecmp( type, "Socket"   ) == 0 )	mode = S_IFSOCK;
+    QString name = binaryName( index );
+    mode_t  mode = _binModes[ index ] & S_IFMT;
 
+    if ( mode == 0 )
+	mode = S_IFREG;
 
-    // Path
+    if ( S_ISDIR( mode ) )
+    {
+	DirInfo * dir = addDir( _binTopDir, QString(), name, mode,
+				_binSizes[ index ], _binMtimes[ index ] );
 
-    if ( *raw_path == '/' )
-	_lastDir = 0;
+	if ( ! dir->isExcluded() )
+	    startBinaryPlaceholder( dir, index );
+    }
+    else
+    {
+	addFile( _binTopDir, name, mode,
+		 _binSizes[ index ], _binMtimes[ index ],
+		 _binBlocks[ index ], _binLinks[ index ] );
+    }
+}
 
 
-    // Size
+DirInfo * CacheReader::addLazyBinaryToplevel()
+{
+    QString fullPath = binaryName( 0 );
+    QString path;
+    QString name;
+    DirInfo * parent = 0;
 
-    char * end = 0;
-    FileSize size = strtoll( size_str, &end, 10 );
+    splitPath( fullPath, path, name );
+    _lastDir = 0;
 
-    if ( end )
+    if ( _tree->root() )
     {
-	switch ( *end )
-	{
-	    case 'K':	size *= KB; break;
-	    case 'M':	size *= MB; break;
-	    case 'G':	size *= GB; break;
-	    case 'T':	size *= TB; break;
-	    default: break;
-	}
-    }
+	parent = locateParent( path, name );
 
+	if ( ! parent )
+	    return 0;
+    }
 
-    // MTime
+    return addDir( parent, path, name, S_IFDIR, _binSizes[ 0 ], _binMtimes[ 0 ] );
+}
 
-    time_t mtime = strtol( mtime_str, 0, 0 );
 
+void CacheReader::startBinaryPlaceholder( DirInfo * dir, quint64 index )
+{
+    CacheBlockInfo & block = _binPendingBlock;
+    block = CacheBlockInfo();
+
+    // The summary starts with the directory itself like in DirInfo::recalc()
+
+    block.name		     = dir->name();
+    block.offset	     = index;
+    block.hasSummary	     = true;
+    block.dirSize	     = dir->size();
+    block.dirMtime	     = dir->mtime();
+    block.totalSize	     = dir->size();
+    block.totalAllocatedSize = dir->rawAllocatedSize();
+    block.totalBlocks	     = dir->blocks();
+    block.latestMtime	     = dir->mtime();
+
+    BinaryDirState state;
+    state.index	   = index;
+    state.hasDirs  = false;
+    state.hasFiles = false;
+
+    _binPendingDir = dir;
+    _binDirStack.clear();
+    _binDirStack << state;
+}
 
-    // Blocks
 
-    FileSize blocks = blocks_str ? strtoll( blocks_str, 0, 10 ) : -1;
+void CacheReader::sumBinaryItem( quint64 index )
+{
+    qint64 parentIndex = _binParents[ index ];
 
+    while ( ! _binDirStack.isEmpty() && (qint64) _binDirStack.last().index != parentIndex )
+	popBinaryDir();
 
-    // Links
+    if ( _binDirStack.isEmpty() )	// not in this subtree after all
+	return;
 
-    int links = links_str ? atoi( links_str ) : 1;
+    mode_t mode = _binModes[ index ] & S_IFMT;
 
+    if ( mode == 0 )
+	mode = S_IFREG;
 
-    //
-    // Create a new item
-    //
+    // A temporary FileInfo calculates the sizes exactly like the one that
+    // is created when this placeholder is read.
 
-    QString fullPath = unescapedPath( raw_path );
-    QString path;
-    QString name;
-    splitPath( fullPath, path, name );
+    FileInfo item( 0, 0, QString(), mode,
+		   _binSizes[ index ], _binMtimes[ index ],
+		   _binBlocks[ index ], _binLinks[ index ] );
 
-    if ( _lastExcludedDir )
-    {
-	if ( path.startsWith( _lastExcludedDirUrl ) )
-	{
-	    // logDebug() << "Excluding " << path << "/" << name << endl;
-	    return;
-	}
-    }
+    CacheBlockInfo & block = _binPendingBlock;
 
-    // Find parent in tree
+    block.totalSize	     += item.size();
+    block.totalAllocatedSize += item.allocatedSize();
+    block.totalBlocks	     += item.blocks();
+    block.totalItems++;
 
-    DirInfo * parent = _lastDir;
+    if ( item.mtime() > block.latestMtime )
+	block.latestMtime = item.mtime();
 
-    if ( ! parent && _tree->root() )
+    if ( item.isDir() )
+    {
+	block.totalSubDirs++;
+	_binDirStack.last().hasDirs = true;
+
+	BinaryDirState state;
+	state.index    = index;
+	state.hasDirs  = false;
+	state.hasFiles = false;
+	_binDirStack << state;
+    }
+    else
     {
-	if ( ! _tree->root()->hasChildren() )
-	    parent = _tree->root();
+	if ( item.isFile() )
+	    block.totalFiles++;
 
-	// Try the easy way first - the starting point of this cache
+	_binDirStack.last().hasFiles = true;
+    }
+}
 
-	if ( ! parent && _toplevel )
-	    parent = dynamic_cast<DirInfo *> ( _toplevel->locate( path ) );
 
-#if DEBUG_LOCATE_PARENT
-	if ( parent )
-	    logDebug() << "Using cache starting point as parent for " << fullPath << endl;
-#endif
+void CacheReader::popBinaryDir()
+{
+    BinaryDirState state = _binDirStack.takeLast();
 
+    // A directory with both files and subdirectories gets a dot entry
+    // which counts as a subdirectory, too
 
-	// Fallback: Search the entire tree
+    if ( state.hasDirs && state.hasFiles )
+    {
+	_binPendingBlock.totalItems++;
+	_binPendingBlock.totalSubDirs++;
+    }
+}
 
-	if ( ! parent )
-	{
-	    parent = dynamic_cast<DirInfo *> ( _tree->locate( path ) );
 
-#if DEBUG_LOCATE_PARENT
-	    if ( parent )
-		logDebug() << "Located parent " << path << " in tree" << endl;
-#endif
-	}
+void CacheReader::finishBinaryPlaceholder( quint64 end )
+{
+    if ( ! _binPendingDir )
+	return;
 
-	if ( ! parent ) // Still nothing?
-	{
-	    logError() << _fileName << ":" << _lineNo << ": "
-		       << "Could not locate parent \"" << path << "\" for "
-		       << name << endl;
+    DirInfo * dir  = _binPendingDir;
+    _binPendingDir = 0;
 
-            if ( ++_errorCount > MAX_ERROR_COUNT )
-            {
-                logError() << "Too many consistency errors. Giving up." << endl;
-                _ok = false;
-                emit error();
-            }
+    while ( ! _binDirStack.isEmpty() )
+	popBinaryDir();
 
-#if DEBUG_LOCATE_PARENT
-	    THROW( Exception( "Could not locate cache item parent" ) );
-#endif
-	    return;	// Ignore this cache line completely
-	}
-    }
+    CacheBlockInfo & block = _binPendingBlock;
+    block.size = end - block.offset - 1;
 
-    if ( strcasecmp( type, "D" ) == 0 )
-    {
-	QString url = ( parent == _tree->root() ) ? buildPath( path, name ) : name;
-#if VERBOSE_CACHE_DIRS
-	logDebug() << "Creating DirInfo for " << url << " with parent " << parent << endl;
-#endif
-	DirInfo * dir = new DirInfo( _tree, parent, url,
-				     mode, size, mtime );
-	dir->setReadState( DirReading );
-	_lastDir = dir;
+    if ( block.size == 0 )	// An empty directory is complete as it is
+	return;
 
-	if ( parent )
-	    parent->insertChild( dir );
+    dir->setCachePlaceholder( block );
+    _tree->addCachePlaceholder( dir, _fileName, block );
+}
 
-	if ( ! _tree->root() )
-	{
-	    _tree->setRoot( dir );
-	    _toplevel = dir;
-	}
 
-	if ( ! _toplevel )
-	    _toplevel = dir;
+bool CacheReader::eof()
+{
+    if ( _binary )
+	return ! _ok || _binNextItem >= _binEndItem;
+
+    if ( _stream )
+	return ! _ok || ( _streamFinished && ! _stream->canReadLine() );
 
-	_tree->childAddedNotify( dir );
+    if ( ! _ok || _blockDone || ( ! _cache && ! _zstdCache && ! _pipeline ) )
+	return true;
 
-	if ( dir != _toplevel )
-	{
-	    if ( ExcludeRules::instance()->match( dir->url(), dir->name() ) )
-	    {
-		logDebug() << "Excluding " << name << endl;
-		dir->setExcluded();
-		dir->setReadState( DirOnRequestOnly );
-		dir->finalizeLocal();
-		_tree->sendReadJobFinished( dir );
-
-		_lastExcludedDir    = dir;
-		_lastExcludedDirUrl = _lastExcludedDir->url();
-		_lastDir	    = 0;
-	    }
-	}
-    }
-    else
+    if ( _pipeline )
     {
-	if ( parent )
-	{
-#if VERBOSE_CACHE_FILE_INFOS
-	    logDebug() << "Creating FileInfo for "
-		       << buildPath( parent->debugUrl(), name ) << endl;
-#endif
+	// The pipeline owns the input file while it exists
 
-	    FileInfo * item = new FileInfo( _tree, parent, name,
-					    mode, size, mtime,
-					    blocks, links );
-	    parent->insertChild( item );
-	    _tree->childAddedNotify( item );
-	}
-	else
-	{
-	    logError() << _fileName << ":" << _lineNo << ": "
-		       << "No parent for item " << name << endl;
-	}
+	return ( ! _block || _blockPos >= _block->items.size() ) && _pipeline->atEnd();
     }
+
+    return inputEof();
 }
 
 
-bool CacheReader::eof()
+bool CacheReader::inputEof()
 {
-    if ( ! _ok || ! _cache )
-	return true;
-
-    return gzeof( _cache );
+    return _zstdCache ? _zstdCache->eof() : gzeof( _cache );
 }
 
 
 QString CacheReader::firstDir()
 {
-    while ( ! gzeof( _cache ) && _ok )
+    if ( _binary )
+    {
+	if ( _ok && _binItemCount > 0 && S_ISDIR( _binModes[0] ) )
+	    return binaryName( 0 );
+
+	return "";
+    }
+
+    if ( _pipeline )
+	rewind();
+
+    while ( ! inputEof() && _ok )
     {
 	if ( ! readLine() )
 	    return "";
@@ -544,6 +3011,12 @@ bool CacheReader::checkHeader()
     if ( ! _ok || ! readLine() )
 	return false;
 
+    return checkHeaderLine();
+}
+
+
+bool CacheReader::checkHeaderLine()
+{
     // logDebug() << "Checking cache file header" << endl;
     QString line( _line );
     splitLine();
@@ -570,8 +3043,8 @@ bool CacheReader::checkHeader()
     {
 	QString version = field( 1 );
 
-	// currently not checking version number
-	// for future use
+	// Any other version is read like 1.0
+	_compactPaths = version == COMPACT_CACHE_FORMAT_VERSION;
 
 	if ( ! _ok )
 	    logError() << _fileName << ":" << _lineNo
@@ -589,7 +3062,7 @@ bool CacheReader::checkHeader()
 
 bool CacheReader::readLine()
 {
-    if ( ! _ok || ! _cache )
+    if ( ! _ok || ( ! _cache && ! _zstdCache ) )
 	return false;
 
     _fieldsCount = 0;
@@ -598,12 +3071,16 @@ bool CacheReader::readLine()
     {
 	_lineNo++;
 
-	if ( ! gzgets( _cache, _buffer, MAX_CACHE_LINE_LEN-1 ) )
+	char * line = _zstdCache ?
+	    _zstdCache->gets( _buffer, MAX_CACHE_LINE_LEN-1 ) :
+	    gzgets( _cache, _buffer, MAX_CACHE_LINE_LEN-1 );
+
+	if ( ! line )
 	{
 	    _buffer[0]	= 0;
 	    _line	= _buffer;
 
-	    if ( ! gzeof( _cache ) )
+	    if ( ! inputEof() )
 	    {
 		_ok = false;
 		logError() << _fileName << ":" << _lineNo << ": Read error" << endl;
@@ -613,12 +3090,14 @@ bool CacheReader::readLine()
 	    return false;
 	}
 
+	// No need to remove trailing whitespace (including the newline):
+	// splitLine() ignores it.
+
 	_line = skipWhiteSpace( _buffer );
-	killTrailingWhiteSpace( _line );
 
 	// logDebug() << "line[ " << _lineNo << "]: \"" << _line<< "\"" << endl;
 
-    } while ( ! gzeof( _cache ) &&
+    } while ( ! inputEof() &&
 	      ( *_line == 0   ||	// empty line
 		*_line == '#'	  ) );	// comment line
 
@@ -636,23 +3115,13 @@ void CacheReader::splitLine()
     if ( *_line == '#' )	// skip comment lines
 	*_line = 0;
 
-    char * current = _line;
-    char * end	   = _line + strlen( _line );
+    _fieldsCount = splitFields( _line, _fields );
+}
 
-    while ( current
-	    && current < end
-	    && *current
-	    && _fieldsCount < MAX_FIELDS_PER_LINE-1 )
-    {
-	_fields[ _fieldsCount++ ] = current;
-	current = findNextWhiteSpace( current );
 
-	if ( current && current < end )
-	{
-	    *current++ = 0;
-	    current = skipWhiteSpace( current );
-	}
-    }
+int CacheReader::splitFields( char * line, char ** fields )
+{
+    return LineTokenizer::splitFields( line, fields, MAX_FIELDS_PER_LINE-1 );
 }
 
 
@@ -670,10 +3139,7 @@ char * CacheReader::skipWhiteSpace( char * cptr )
     if ( cptr == 0 )
 	return 0;
 
-    while ( *cptr != 0 && isspace( *cptr ) )
-	cptr++;
-
-    return cptr;
+    return LineTokenizer::skipBlanks( cptr );
 }
 
 
@@ -682,8 +3148,7 @@ char * CacheReader::findNextWhiteSpace( char * cptr )
     if ( cptr == 0 )
 	return 0;
 
-    while ( *cptr != 0 && ! isspace( *cptr ) )
-	cptr++;
+    cptr = LineTokenizer::findBlank( cptr );
 
     return *cptr == 0 ? 0 : cptr;
 }
@@ -705,7 +3170,7 @@ void CacheReader::killTrailingWhiteSpace( char * cptr )
 
 void CacheReader::splitPath( const QString & fileNameWithPath,
 			     QString	   & path_ret,
-			     QString	   & name_ret ) const
+			     QString	   & name_ret )
 {
     bool absolutePath = fileNameWithPath.startsWith( "/" );
     QStringList components = fileNameWithPath.split( "/", QString::SkipEmptyParts );
@@ -738,7 +3203,7 @@ QString CacheReader::buildPath( const QString & path, const QString & name ) con
 }
 
 
-QString CacheReader::unescapedPath( const QString & rawPath ) const
+QString CacheReader::unescapedPath( const QString & rawPath )
 {
     // Using a protocol part to avoid directory names with a colon ":"
     // being cut off because it looks like a URL protocol.
@@ -749,10 +3214,27 @@ QString CacheReader::unescapedPath( const QString & rawPath ) const
 }
 
 
-QString CacheReader::cleanPath( const QString & rawPath ) const
+QString CacheReader::cleanPath( const QString & rawPath )
 {
-    QString clean = rawPath;
-    return clean.replace( _multiSlash, "/" );
+    // This is called in the parser threads of a CacheReadPipeline, so it
+    // can't use a shared QRegExp (which is not thread-safe), and compiling
+    // a new one for each line would be much too expensive.
+
+    if ( ! rawPath.contains( "//" ) )
+	return rawPath;
+
+    QString clean;
+    clean.reserve( rawPath.size() );
+
+    for ( int i = 0; i < rawPath.size(); ++i )
+    {
+	QChar c = rawPath.at( i );
+
+	if ( c != '/' || ! clean.endsWith( '/' ) )
+	    clean += c;
+    }
+
+    return clean;
 }
 
 
@@ -763,7 +3245,6 @@ void CacheReader::finalizeRecursive( DirInfo * dir )
 	if ( ! dir->readError() )
 	    dir->setReadState( DirCached );
 
-	dir->finalizeLocal();
 	_tree->sendReadJobFinished( dir );
     }
 
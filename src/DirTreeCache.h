@@ -13,26 +13,160 @@
 
 #include <stdio.h>
 #include <zlib.h>
+
+#include <QAtomicInt>
+#include <QBitArray>
+#include <QHash>
+#include <QList>
+#include <QVector>
+
 #include "DirTree.h"
+#include "TreeWriterThread.h"
+
+#define DEFAULT_CACHE_NAME		".qdirstat.cache.gz"
+#define DEFAULT_BINARY_CACHE_NAME	".qdirstat.cache.bin"
+#define BINARY_CACHE_SUFFIX		".bin"
+#define ZSTD_CACHE_SUFFIX		".zst"
+#define CACHE_INDEX_SUFFIX		".idx"
+#define CHECKPOINT_PENDING_SUFFIX	".pending"
+#define CHECKPOINT_HEADER		"[qdirstat checkpoint 1]"
+#define MERGED_CACHES_URL		"merged:/"
+#define CACHE_FORMAT_VERSION		"1.0"
+#define COMPACT_CACHE_FORMAT_VERSION	"1.1"	// with delta-encoded paths
+#define MAX_CACHE_LINE_LEN		1024
+#define MAX_FIELDS_PER_LINE		32
+#define CACHE_SIZE_CLASSES		64	// see CacheBlockInfo::sizeClass()
 
-#define DEFAULT_CACHE_NAME	".qdirstat.cache.gz"
-#define CACHE_FORMAT_VERSION	"1.0"
-#define MAX_CACHE_LINE_LEN	1024
-#define MAX_FIELDS_PER_LINE	32
+#define BINARY_CACHE_MAGIC		"QDSBCACH"
+#define BINARY_CACHE_BYTE_ORDER		0x01020304
+#define BINARY_CACHE_FORMAT_VERSION	1
+
+
+class QFile;
+class QIODevice;
 
 
 namespace QDirStat
 {
+    class DirInfo;
+    class ZstdReader;
+    class ZstdWriter;
+
+
+    /**
+     * Header of a binary cache file (see doc/cache-file-format.txt).
+     *
+     * All data are in the byte order of the machine that wrote the file;
+     * all offsets are from the start of the file and aligned to 8 bytes.
+     * Each array has one element for each item, in the order of a preorder
+     * traversal of the tree, so a parent always comes before its children.
+     **/
+    struct BinaryCacheHeader
+    {
+	char	magic[8];		// BINARY_CACHE_MAGIC without the 0 byte
+	quint32 byteOrder;		// BINARY_CACHE_BYTE_ORDER
+	quint32 version;		// BINARY_CACHE_FORMAT_VERSION
+	quint64 itemCount;
+	quint64 stringTableSize;
+	quint64 parentsOffset;		// qint64:  index of the parent or -1
+	quint64 sizesOffset;		// qint64:  size in bytes
+	quint64 blocksOffset;		// qint64:  blocks for sparse files, else -1
+	quint64 mtimesOffset;		// qint64:  mtime as time_t
+	quint64 namesOffset;		// quint64: name start in the string table;
+					//	    itemCount + 1 entries
+	quint64 linksOffset;		// quint32: number of hard links
+	quint64 modesOffset;		// quint32: file type (S_IFDIR etc.)
+	quint64 stringTableOffset;	// UTF-8 names without 0 bytes
+    };
+
+
+    /**
+     * One block of a text cache file: The lines of one directory directly
+     * below the toplevel directory and its subtree, compressed as a
+     * separate gzip member or zstd frame. The first block (with an empty
+     * name) contains the header, the toplevel directory and its
+     * non-directory children.
+     **/
+    struct CacheBlockInfo
+    {
+	QString	 name;		// name of the directory; empty for the toplevel
+	qint64	 offset;	// in the compressed file
+	qint64	 size;		// compressed size
+
+	// Summary of the directory, so it can be displayed without reading
+	// the block (see DirTree::lazyCacheLoading())
+
+	bool	 hasSummary;
+	FileSize dirSize;
+	time_t	 dirMtime;
+	FileSize totalSize;
+	FileSize totalAllocatedSize;
+	FileSize totalBlocks;
+	int	 totalItems;
+	int	 totalSubDirs;
+	int	 totalFiles;
+	time_t	 latestMtime;
+
+	// Number of files in each size class (see sizeClass()) in the
+	// subtree; empty if unknown because the index was written by an
+	// older version
+
+	QVector<int> sizeClasses;
+
+	// The cache file has delta-encoded paths (COMPACT_CACHE_FORMAT_VERSION)
+
+	bool	 compactPaths;
+
+	CacheBlockInfo():
+	    offset( 0 ),
+	    size( 0 ),
+	    hasSummary( false ),
+	    dirSize( 0 ),
+	    dirMtime( 0 ),
+	    totalSize( 0 ),
+	    totalAllocatedSize( 0 ),
+	    totalBlocks( 0 ),
+	    totalItems( 0 ),
+	    totalSubDirs( 0 ),
+	    totalFiles( 0 ),
+	    latestMtime( 0 ),
+	    compactPaths( false )
+	    {}
+
+	/**
+	 * Return the size class of a file of size 'size': 0 for empty
+	 * files, 1 + the index of the highest bit that is set otherwise, so
+	 * class n contains the sizes from 2^(n-1) to 2^n - 1.
+	 **/
+	static int sizeClass( FileSize size )
+	    { return size <= 0 ? 0 : 64 - __builtin_clzll( (quint64) size ); }
+
+	/**
+	 * Return a size that stands in for all files of size class 'index':
+	 * the middle of its range.
+	 **/
+	static FileSize sizeClassValue( int index )
+	    { return index <= 0 ? 0 : (FileSize) ( ( ( 3ULL << ( index - 1 ) ) - 1 ) / 2 ); }
+    };
+
+
     class CacheWriter
     {
     public:
 
 	/**
-	 * Write 'tree' to file 'fileName' in gzip format (using zlib).
+	 * Write 'tree' to file 'fileName' in gzip format (using zlib) or, if
+	 * 'fileName' ends with ZSTD_CACHE_SUFFIX, with zstd compression, or
+	 * if it ends with BINARY_CACHE_SUFFIX, in the binary format.
+	 *
+	 * If 'longFormat' is 'true', write the full path for each item in a
+	 * text cache file, not only for directories.
 	 *
 	 * Check CacheWriter::ok() to see if writing the cache file went OK.
 	 **/
-	CacheWriter( const QString & fileName, DirTree *tree );
+	CacheWriter( const QString & fileName,
+		     DirTree *	     tree,
+		     bool	     longFormat = false );
 
 	/**
 	 * Destructor
@@ -44,6 +178,31 @@ namespace QDirStat
 	 **/
 	bool ok() const { return _ok; }
 
+	/**
+	 * Return the number of items written so far. This may be called from
+	 * any thread.
+	 **/
+	int itemsWritten() const { return _itemsWritten.loadAcquire(); }
+
+	/**
+	 * Stop writing as soon as possible; the cache file is removed. This
+	 * may be called from any thread.
+	 **/
+	void abort() { _aborted.storeRelease( 1 ); }
+
+	/**
+	 * Make sure that writing 'tree' to cache file 'fileName' does not
+	 * change anything in the tree: Read the cache placeholders whose
+	 * blocks can't be copied to that file and calculate all summaries.
+	 **/
+	static void prepareTree( const QString & fileName, DirTree * tree );
+
+	/**
+	 * Tell 'tree' about the cache file that was just written: It is clean
+	 * now, and the cache placeholders might have moved to it.
+	 **/
+	void updateTree( DirTree * tree );
+
 	/**
 	 * Format a file size as string - with trailing "G", "M", "K" for
 	 * "Gigabytes", "Megabytes, "Kilobytes", respectively (provided there
@@ -51,26 +210,152 @@ namespace QDirStat
 	 **/
 	QString formatSize( FileSize size );
 
+	/**
+	 * Return 'true' if 'fileName' is the name of a binary cache file,
+	 * i.e. if it ends with BINARY_CACHE_SUFFIX.
+	 **/
+	static bool isBinaryCacheName( const QString & fileName );
+
+	/**
+	 * Return 'true' if file 'fileName' is a binary cache file, no matter
+	 * what its name is.
+	 **/
+	static bool isBinaryCacheFile( const QString & fileName );
+
+	/**
+	 * Read the index file of cache file 'fileName' into 'blocks'. Return
+	 * 'false' if there is no index or if it does not belong to the
+	 * current version of the cache file or to 'toplevelUrl'. If
+	 * 'toplevelUrl' is empty, any toplevel directory is accepted.
+	 **/
+	static bool readCacheIndex( const QString	      & fileName,
+				    const QString	      & toplevelUrl,
+				    QList<CacheBlockInfo> & blocks );
+
 
     protected:
 
 	/**
-	 * Write cache file in gzip format.
+	 * Return the index file field for 'sizeClasses': the counts
+	 * separated by commas, without the empty classes at the end.
+	 **/
+	static QByteArray sizeClassesField( const QVector<int> & sizeClasses );
+
+	/**
+	 * Parse an index file field from sizeClassesField(). Return an empty
+	 * vector if it is invalid.
+	 **/
+	static QVector<int> parseSizeClasses( const QByteArray & field );
+
+	/**
+	 * Constructor for writing uncompressed text cache data to file
+	 * descriptor 'fd' piece by piece (see CacheStreamWriter).
+	 **/
+	CacheWriter( int fd, bool longFormat );
+
+	/**
+	 * Write cache file in gzip or zstd format.
 	 * Returns 'true' if OK, 'false' upon error.
 	 **/
 	bool writeCache( const QString & fileName, DirTree *tree );
 
 	/**
-	 * Write 'item' recursively to cache file 'cache'.
-	 * Uses zlib to write gzip-compressed files.
+	 * Write cache file in the binary format.
+	 * Returns 'true' if OK, 'false' upon error.
+	 **/
+	bool writeBinaryCache( const QString & fileName, DirTree *tree );
+
+	/**
+	 * Add 'item' and (recursively) its children to the binary cache
+	 * arrays. 'parentIndex' is the index of the parent of 'item' or -1 if
+	 * this is the toplevel item.
+	 **/
+	void collectBinaryItems( FileInfo * item, qint64 parentIndex );
+
+	/**
+	 * Open 'fileName' for writing a text cache file with zstd or gzip
+	 * compression.
+	 **/
+	bool openOutput( const QString & fileName, bool zstd );
+
+	/**
+	 * Finish and close the output file.
+	 **/
+	bool closeOutput();
+
+	/**
+	 * Finish the current block of the output file and add it with name
+	 * 'name' to _blocks.
+	 **/
+	void endBlock( const QString & name );
+
+	/**
+	 * Copy the compressed block 'block' from 'oldFile' to the output file
+	 * and add it to _blocks. Return 'false' on error.
+	 **/
+	bool copyBlock( QFile & oldFile, const CacheBlockInfo & block );
+
+	/**
+	 * Write compressed data directly to the output file.
+	 **/
+	bool writeRaw( const QByteArray & data );
+
+	/**
+	 * Copy the block of the cache placeholder 'dir' from the cache file
+	 * it was read from ('lazyFile') to the output file. Return 'false' if
+	 * nothing could be copied.
+	 **/
+	bool copyPlaceholder( QFile & lazyFile, DirInfo * dir );
+
+	/**
+	 * Store the summary of 'dir' in 'block'.
+	 **/
+	static void setSummary( CacheBlockInfo & block, FileInfo * dir );
+
+	/**
+	 * Write the index file for cache file 'fileName' from _blocks.
+	 **/
+	bool writeCacheIndex( const QString & fileName, const QString & toplevelUrl );
+
+	/**
+	 * Write 'item' recursively to the cache file.
 	 **/
-	void writeTree( gzFile cache, FileInfo * item );
+	void writeTree( FileInfo * item );
 
 	/**
-	 * Write 'item' to cache file 'cache' without recursion.
-	 * Uses zlib to write gzip-compressed files.
+	 * Write 'item' to the cache file without recursion.
 	 **/
-	void writeItem( gzFile cache, FileInfo * item );
+	void writeItem( FileInfo * item );
+
+	/**
+	 * Append the URL-encoded full path 'path' to 'line', delta-encoded
+	 * against the last one if that makes it shorter: "^" followed by the
+	 * number of bytes that it has in common with the last path, ":" and
+	 * the rest of it.
+	 **/
+	void appendCompactPath( QByteArray & line, const QString & path );
+
+	/**
+	 * Return the URL of 'item'. For a tree that is written in another
+	 * thread, this does not change anything in the tree.
+	 **/
+	QString itemUrl( FileInfo * item ) const;
+
+	/**
+	 * Return 'true' if abort() was called.
+	 **/
+	bool aborted() const { return _aborted.loadAcquire() != 0; }
+
+	/**
+	 * Write 'data' to the cache file with zlib or zstd compression or,
+	 * for a stream, add it to the buffer for flushStream().
+	 **/
+	void write( const QByteArray & data );
+
+	/**
+	 * Write the buffered data of a stream to its file descriptor.
+	 **/
+	bool flushStream();
 
         /**
          * Return the 'path' in an URL-encoded form, i.e. with some special
@@ -78,15 +363,270 @@ namespace QDirStat
          **/
         QByteArray urlEncoded( const QString & path );
 
+	/**
+	 * Append 'path' URL-encoded to 'line'. Unlike urlEncoded(), this does
+	 * not allocate anything if 'line' is big enough.
+	 **/
+	static void appendUrlEncoded( QByteArray & line, const QString & path );
+
+	/**
+	 * Append 'size' to 'line' in the format of formatSize() and 'number'
+	 * as a decimal or hex number without allocating anything.
+	 **/
+	static void appendSize  ( QByteArray & line, FileSize size );
+	static void appendNumber( QByteArray & line, quint64 number, int base = 10 );
+
 	//
 	// Data members
 	//
 
-	bool _ok;
+	bool		_ok;
+	bool		_longFormat;
+	gzFile		_gzCache;
+	int		_fd;		// file descriptor of _gzCache
+	ZstdWriter *	_zstdCache;
+	qint64		_blockStart;
+	QList<CacheBlockInfo> _blocks;
+	QByteArray	_streamBuffer;
+	QByteArray	_line;		// reused for each line of writeItem()
+	bool		_compactPaths;	// see DirTree::compactCachePaths()
+	QByteArray	_path;		// reused by appendCompactPath()
+	QByteArray	_lastPath;	// the last full path; empty at block starts
+	QString		_cleanFile;	// for updateTree()
+	bool		_placeholdersMoved;
+	bool		_readOnlyTree;	// don't load placeholders while writing
+	QVector<int>	_sizeClasses;	// of the files of the current block
+	QAtomicInt	_aborted;
+	QAtomicInt	_itemsWritten;
+
+	// The columns of a binary cache file while it is being written
+
+	QVector<qint64>	 _binParents;
+	QVector<qint64>	 _binSizes;
+	QVector<qint64>	 _binBlocks;
+	QVector<qint64>	 _binMtimes;
+	QVector<quint64> _binNames;
+	QVector<quint32> _binLinks;
+	QVector<quint32> _binModes;
+	QByteArray	 _binStrings;
+    };
+
+
+
+    /**
+     * Thread for writing a cache file in the background, e.g. from the GUI
+     * (see DirTree::startWritingCache()):
+     *
+     * The constructor prepares the tree (see CacheWriter::prepareTree()), so
+     * the thread only reads it. That thread owns nothing in the tree, so the
+     * tree must not change until the thread is finished; then call
+     * updateTree() in the thread that owns the tree.
+     **/
+    class CacheWriterThread: public TreeWriterThread, public CacheWriter
+    {
+    public:
+
+	/**
+	 * Constructor. Call start() to write 'tree' to 'fileName'.
+	 **/
+	CacheWriterThread( const QString & fileName,
+			   DirTree *	   tree,
+			   bool		   longFormat = false );
+
+	//
+	// Reimplemented from TreeWriterThread
+	//
+
+	virtual QString fileName() const Q_DECL_OVERRIDE { return _fileName; }
+
+	virtual int itemsWritten() const Q_DECL_OVERRIDE
+	    { return CacheWriter::itemsWritten(); }
+
+	virtual void abort() Q_DECL_OVERRIDE { CacheWriter::abort(); }
+
+	virtual bool ok() const Q_DECL_OVERRIDE { return CacheWriter::ok(); }
+
+	virtual void updateTree( DirTree * tree ) Q_DECL_OVERRIDE
+	    { CacheWriter::updateTree( tree ); }
+
+    protected:
+
+	/**
+	 * Write the cache file. This is called in the new thread.
+	 *
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+
+	QString	  _fileName;
+	DirTree * _tree;
     };
 
 
 
+    /**
+     * Checkpoint of a directory tree that is still being read, for resuming
+     * reading after a crash or a reboot (see DirTree::setCheckpoint() and
+     * DirTree::resumeReading()):
+     *
+     * A checkpoint is a normal cache file with everything that was read so
+     * far and a small text file next to it (CHECKPOINT_PENDING_SUFFIX) with
+     * the URLs of the directories that are not finished yet. That file also
+     * has the size of the cache file, so a cache file that doesn't belong
+     * to it (e.g. after a crash between writing the two files) is detected.
+     **/
+    class CacheCheckpoint
+    {
+    public:
+
+	/**
+	 * Write a checkpoint of 'tree' to cache file 'fileName' and its
+	 * pending file. Return 'true' on success, 'false' on error.
+	 **/
+	static bool write( const QString & fileName, DirTree * tree );
+
+	/**
+	 * Read the unfinished directories of checkpoint 'fileName' into
+	 * 'pending_ret'. Return 'false' if there is no valid checkpoint.
+	 **/
+	static bool readPending( const QString & fileName, QStringList & pending_ret );
+
+	/**
+	 * Remove checkpoint 'fileName' with its pending and index files.
+	 **/
+	static void remove( const QString & fileName );
+
+	/**
+	 * Return the name of the pending file of checkpoint 'fileName'.
+	 **/
+	static QString pendingFileName( const QString & fileName )
+	    { return fileName + CHECKPOINT_PENDING_SUFFIX; }
+
+    protected:
+
+	/**
+	 * Add the URLs of all directories in 'item' that are not finished
+	 * yet to 'pending'.
+	 **/
+	static void collectPending( FileInfo * item, QStringList & pending );
+    };
+
+
+
+    /**
+     * Writer for an uncompressed text cache stream while a tree is still
+     * being read: Each directory is written as soon as its read job is
+     * finished, with its non-directory children. Subdirectories follow
+     * when they are finished, so a parent is always written before its
+     * children, just like CacheReader needs it.
+     *
+     * This is used by qdirstat-cache-writer for remote scans (see
+     * RemoteReadJob): A CacheReader on the other end of the pipe can build
+     * its tree while this one is still being read.
+     **/
+    class CacheStreamWriter: public QObject, public CacheWriter
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor: Write the cache header to file descriptor 'fd' and
+	 * then each directory of 'tree' when it is read.
+	 *
+	 * The file descriptor is not closed.
+	 **/
+	CacheStreamWriter( int fd, DirTree * tree, bool longFormat = false );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~CacheStreamWriter();
+
+
+    protected slots:
+
+	/**
+	 * Write directory 'dir' whose read job is finished.
+	 **/
+	void readJobFinished( DirInfo * dir );
+
+
+    protected:
+
+	/**
+	 * Write 'dir' and its children that are not written separately.
+	 **/
+	void writeDir( DirInfo * dir );
+
+
+	DirTree * _tree;
+    };
+
+
+
+    /**
+     * Writer for an uncompressed text cache stream of a subtree of a tree
+     * that is already read, e.g. for the snapshots of qdirstat-daemon: The
+     * data are written to the file descriptor in chunks of
+     * SNAPSHOT_FLUSH_SIZE, so even a huge subtree needs only that much
+     * memory.
+     *
+     * The subtree must not contain any cache placeholders or spilled files.
+     **/
+    class CacheSnapshotWriter: public CacheWriter
+    {
+    public:
+
+	/**
+	 * Constructor: Write the cache header and 'subtree' to file
+	 * descriptor 'fd'. Check ok() to see if that went OK.
+	 *
+	 * The file descriptor is not closed.
+	 **/
+	CacheSnapshotWriter( int fd, FileInfo * subtree, bool longFormat = false );
+
+    protected:
+
+	/**
+	 * Write 'item' recursively like writeTree() and flush the stream
+	 * whenever it gets too large.
+	 **/
+	void writeSubtree( FileInfo * item );
+    };
+
+
+
+    /**
+     * One item of a text cache file after parsing its line.
+     **/
+    struct CacheItem
+    {
+	QString	 path;
+	QString	 name;
+	mode_t	 mode;
+	FileSize size;
+	FileSize blocks;
+	time_t	 mtime;
+	int	 links;
+	int	 lineNo;
+	int	 fieldsCount;	// less than 4: syntax error
+	bool	 isDir;
+	bool	 isAbsolute;	// full path, not relative to the last dir
+	int	 sharedPrefix;	// delta-encoded path: bytes of the last one, else -1
+	QByteArray rawPath;	// the path field of a full or delta-encoded path
+
+	CacheItem():
+	    sharedPrefix( -1 )
+	    {}
+    };
+
+
+    class CacheReadPipeline;
+    struct CacheBlock;
+
+
     class CacheReader: public QObject
     {
 	Q_OBJECT
@@ -101,6 +641,45 @@ namespace QDirStat
 		     DirTree	   * tree,
 		     DirInfo	   * parent = 0 );
 
+	/**
+	 * Begin reading only block 'block' of cache file 'fileName' into the
+	 * cache placeholder 'placeholder' (see DirTree::lazyCacheLoading()).
+	 * The first directory of that block has to be 'placeholder'. For a
+	 * binary cache file, the block is the range of items of the subtree.
+	 **/
+	CacheReader( const QString	  & fileName,
+		     DirTree		  * tree,
+		     DirInfo		  * placeholder,
+		     const CacheBlockInfo & block );
+
+	/**
+	 * Begin reading uncompressed text cache data from 'stream' while it
+	 * is still being written, e.g. from a pipe of a QProcess (see
+	 * RemoteReadJob). 'name' is only used for log messages.
+	 *
+	 * read() adds all complete lines that are available and then
+	 * returns without waiting for more. eof() is 'true' only after
+	 * finishStream() and when all lines are read.
+	 *
+	 * If 'target' is specified, the stream is the subtree of that
+	 * directory which is already in the tree, but not read yet (see
+	 * ScanCoordinator); its first directory has to be 'target'.
+	 **/
+	CacheReader( QIODevice	   * stream,
+		     const QString & name,
+		     DirTree	   * tree,
+		     DirInfo	   * target = 0 );
+
+	/**
+	 * Begin reading the items that 'pipeline' parses from something
+	 * that is not a cache file, e.g. a file listing (see
+	 * ListingReadPipeline). The reader takes over ownership of the
+	 * pipeline and starts it. 'name' is only used for log messages.
+	 **/
+	CacheReader( CacheReadPipeline * pipeline,
+		     const QString     & name,
+		     DirTree	       * tree );
+
 	/**
 	 * Destructor
 	 **/
@@ -145,6 +724,52 @@ namespace QDirStat
 	 **/
 	QString firstDir();
 
+	/**
+	 * Notification that the stream of a stream reader is finished:
+	 * Nothing more will be added to it.
+	 **/
+	void finishStream() { _streamFinished = true; }
+
+	/**
+	 * Add the toplevel directory of this cache file as a child of
+	 * 'parent' rather than at its own path, named "label:/its/path" (see
+	 * DirTree::readCaches()). Other cache files may be merged into the
+	 * same parent. This disables lazy loading.
+	 *
+	 * Call this before the first read().
+	 **/
+	void mergeInto( DirInfo * parent, const QString & label );
+
+	/**
+	 * Start decompressing and parsing a text cache file in the background
+	 * now rather than with the first read(). This does nothing for binary
+	 * caches, streams, the toplevel block of lazy loading, or if the
+	 * reader was already started.
+	 *
+	 * Call this after the last rewind().
+	 **/
+	void readAhead();
+
+	/**
+	 * Return 'true' if the cache file is decompressed and parsed in the
+	 * background.
+	 **/
+	bool isReadingAhead() const { return _pipeline != 0; }
+
+	/**
+	 * Set if read() waits for the next block when the cache file is
+	 * parsed in the background and that block is not parsed yet
+	 * (default), or if it returns and sets blockPending(); then the
+	 * blockAvailable() signal is sent when it can continue.
+	 **/
+	void setWaitForBlocks( bool wait ) { _waitForBlocks = wait; }
+
+	/**
+	 * Return 'true' if the last read() returned early because the next
+	 * block is not parsed yet (see setWaitForBlocks()).
+	 **/
+	bool blockPending() const { return _blockPending; }
+
 	/**
 	 * Returns the tree associated with this reader.
 	 **/
@@ -172,6 +797,20 @@ namespace QDirStat
 	 **/
 	static void killTrailingWhiteSpace( char * cptr );
 
+	/**
+	 * Split 'line' into at most MAX_FIELDS_PER_LINE - 1 fields separated
+	 * by whitespace and store the start of each field in 'fields'. This
+	 * overwrites the whitespace after each field with a 0 byte. Return
+	 * the number of fields.
+	 **/
+	static int splitFields( char * line, char ** fields );
+
+	/**
+	 * Parse the fields of one cache line into 'item'. This does not
+	 * need a CacheReader, so it can be used in other threads.
+	 **/
+	static void parseItem( char ** fields, int fieldsCount, CacheItem & item );
+
 
     signals:
 
@@ -190,18 +829,226 @@ namespace QDirStat
 	 **/
 	void error();
 
+	/**
+	 * Emitted when the next block that read() returned early for is
+	 * parsed (see setWaitForBlocks()). This is invoked from a parser
+	 * thread with a queued call, so it arrives in the GUI thread.
+	 **/
+	void blockAvailable();
+
+
+    protected slots:
+
+	/**
+	 * Notification that a child is about to be deleted from the tree:
+	 * Forget it and any directory in its subtree.
+	 **/
+	void deletingChildNotify( FileInfo * deletedChild );
+
+	/**
+	 * Notification that all children of a subtree are about to be
+	 * deleted.
+	 **/
+	void clearingSubtreeNotify( DirInfo * subtree );
+
 
     protected:
 
+	/**
+	 * Initializations common for all constructors.
+	 **/
+	void init( const QString & fileName, DirTree * tree, DirInfo * parent );
+
+	/**
+	 * Open the text cache file _fileName with gzip or zstd and start
+	 * reading at compressed offset 'offset'. Return 'false' on error.
+	 **/
+	bool openText( qint64 offset );
+
 	/**
 	 * Check this cache's header (see if it is a QDirStat cache at all)
 	 **/
 	bool checkHeader();
 
 	/**
-	 * Use _fields to add one item to _tree.
+	 * Check if the current line _line is a valid cache header.
+	 **/
+	bool checkHeaderLine();
+
+	/**
+	 * Add at most 'maxLines' lines (or all if 0) that are completely
+	 * available in the stream to the tree. Returns true if OK and there
+	 * is more to read.
 	 **/
-	void addItem();
+	bool readStream( int maxLines );
+
+	/**
+	 * Check if a new directory 'url' from the cache file is still part of
+	 * the block that is being read. If it is not, set _blockDone and
+	 * return 'false'.
+	 **/
+	bool checkBlockEnd( const QString & url );
+
+	/**
+	 * Add a cache placeholder for each block in _lazyBlocks after the
+	 * toplevel block was read.
+	 **/
+	void addPlaceholders();
+
+	/**
+	 * Add one parsed item to _tree.
+	 **/
+	void addItem( const CacheItem & item );
+
+	/**
+	 * Return 'item' with a delta-encoded path resolved against the last
+	 * full path in 'resolved_ret', or 'item' itself if it has none, and
+	 * remember the full path for the next one. This has to be called for
+	 * the items in the order of the file.
+	 **/
+	const CacheItem & resolvePath( const CacheItem & item,
+				       CacheItem       & resolved_ret );
+
+	/**
+	 * Start a CacheReadPipeline to parse the rest of the file with
+	 * several threads.
+	 **/
+	void startPipeline();
+
+	/**
+	 * Stop and delete the CacheReadPipeline if there is one.
+	 **/
+	void stopPipeline();
+
+	/**
+	 * Add at most 'maxItems' items (or all if 0) from the pipeline to
+	 * the tree. Returns true if OK and there is more to read.
+	 **/
+	bool readPipeline( int maxItems );
+
+	/**
+	 * Find the parent for a new toplevel item with path 'path' in the
+	 * tree. Log an error and return 0 if there is none.
+	 *
+	 * This uses _dirsByPath first, so the parent of an item is usually
+	 * found without any tree search.
+	 **/
+	DirInfo * locateParent( const QString & path, const QString & name );
+
+	/**
+	 * Create a DirInfo for a directory from the cache and insert it into
+	 * 'parent'. Return the new directory. This also adds it to
+	 * _dirsByPath.
+	 **/
+	DirInfo * addDir( DirInfo	  * parent,
+			  const QString & path,
+			  const QString & name,
+			  mode_t	  mode,
+			  FileSize	  size,
+			  time_t	  mtime );
+
+	/**
+	 * Create a FileInfo for a non-directory item from the cache and insert
+	 * it into 'parent' or, if the tree has a filter that wants to ignore
+	 * it, directly into the attic of 'parent'.
+	 **/
+	void addFile( DirInfo	    * parent,
+		      const QString & name,
+		      mode_t	      mode,
+		      FileSize	      size,
+		      time_t	      mtime,
+		      FileSize	      blocks,
+		      nlink_t	      links );
+
+	/**
+	 * Open 'fileName' as a binary cache file if it is one. Return 'false'
+	 * if it is not a binary cache file, 'true' if it is (even if it could
+	 * not be opened successfully: Check _ok for that).
+	 *
+	 * This only checks the header; call checkBinaryItems() or
+	 * startLazyBinary() next.
+	 **/
+	bool openBinary( const QString & fileName );
+
+	/**
+	 * Check all items of a binary cache file before reading them
+	 * completely.
+	 **/
+	void checkBinaryItems();
+
+	/**
+	 * Return 'true' if item no. 'index' of a binary cache file is
+	 * consistent.
+	 **/
+	bool checkBinaryItem( quint64 index ) const;
+
+	/**
+	 * Read only the direct children of the directory with item no.
+	 * 'first' of a binary cache file, up to the end of its subtree
+	 * 'end': Its subdirectories become cache placeholders (see
+	 * DirTree::lazyCacheLoading()) with the summary of their subtree,
+	 * and reading a placeholder later does the same for the next level.
+	 * So no FileInfo is created for anything that is never opened.
+	 **/
+	void startLazyBinary( quint64 first, quint64 end );
+
+	/**
+	 * Read at most 'maxItems' items (or all if 0) from a binary cache
+	 * file. Returns true if OK and there is more to read.
+	 **/
+	bool readBinary( int maxItems );
+
+	/**
+	 * Add item no. 'index' of a binary cache file to the tree.
+	 **/
+	void addBinaryItem( quint64 index );
+
+	/**
+	 * Add item no. 'index' of a binary cache file to the tree if it is a
+	 * direct child of the directory that is read lazily, otherwise add
+	 * it to the summary of the placeholder it belongs to.
+	 **/
+	void addLazyBinaryItem( quint64 index );
+
+	/**
+	 * Add the toplevel directory (item no. 0) of a binary cache file
+	 * that is read lazily to the tree. Return 0 on error.
+	 **/
+	DirInfo * addLazyBinaryToplevel();
+
+	/**
+	 * Start summing up the subtree of 'dir' (item no. 'index') for its
+	 * placeholder.
+	 **/
+	void startBinaryPlaceholder( DirInfo * dir, quint64 index );
+
+	/**
+	 * Add item no. 'index' to the summary of the current placeholder.
+	 **/
+	void sumBinaryItem( quint64 index );
+
+	/**
+	 * Leave the innermost directory of the current placeholder's subtree
+	 * and count its dot entry if it will get one.
+	 **/
+	void popBinaryDir();
+
+	/**
+	 * Make the current directory a cache placeholder now that its subtree
+	 * ends at item no. 'end'.
+	 **/
+	void finishBinaryPlaceholder( quint64 end );
+
+	/**
+	 * Return the name of item no. 'index' of a binary cache file.
+	 **/
+	QString binaryName( quint64 index ) const;
+
+	/**
+	 * Return 'true' if the end of the (gzip or zstd) text cache file is
+	 * reached.
+	 **/
+	bool inputEof();
 
 	/**
 	 * Read the next line that is not empty or a comment and store it in
@@ -230,9 +1077,9 @@ namespace QDirStat
 	 *     "/some/dir/somewhere/myfile.obj"
 	 * ->  "/some/dir/somewhere", "myfile.obj"
 	 **/
-	void splitPath( const QString & fileNameWithPath,
-			QString	      & path_ret,
-			QString	      & name_ret ) const;
+	static void splitPath( const QString & fileNameWithPath,
+			       QString	     & path_ret,
+			       QString	     & name_ret );
 
 	/**
 	 * Build a full path from path + file name (without path).
@@ -242,13 +1089,13 @@ namespace QDirStat
 	/**
 	 * Return an unescaped version of 'rawPath'.
 	 **/
-	QString unescapedPath( const QString & rawPath ) const;
+	static QString unescapedPath( const QString & rawPath );
 
 	/**
 	 * Clean a path: Replace duplicate (or triplicate or more) slashes with
 	 * just one. QUrl doesn't seem to handle those well.
 	 **/
-	QString cleanPath( const QString & rawPath ) const;
+	static QString cleanPath( const QString & rawPath );
 
 	/**
 	 * Returns the number of fields in the current input line after
@@ -257,9 +1104,8 @@ namespace QDirStat
 	int fieldsCount() const { return _fieldsCount; }
 
 	/**
-	 * Recursively set the read status of all dirs from 'dir' on, send tree
-	 * signals and finalize local (i.e. clean up empty or unneeded dot
-	 * entries).
+	 * Recursively set the read status of all dirs from 'dir' on and send
+	 * tree signals. The dirs are already finalized with finalizeAll().
 	 **/
 	void finalizeRecursive( DirInfo * dir );
 
@@ -276,6 +1122,8 @@ namespace QDirStat
 
 	DirTree *	_tree;
 	gzFile		_cache;
+	ZstdReader *	_zstdCache;
+	qint64		_startOffset;	// compressed offset where reading starts
 	char		_buffer[ MAX_CACHE_LINE_LEN ];
 	char *		_line;
 	int		_lineNo;
@@ -288,7 +1136,76 @@ namespace QDirStat
 	DirInfo *	_lastDir;
 	DirInfo *	_lastExcludedDir;
 	QString		_lastExcludedDirUrl;
-        QRegExp         _multiSlash;
+	DirInfo *	_filterDir;	// last parent checked with the tree's filters
+	QString		_filterDirUrl;
+	QHash<QString, DirInfo *> _dirsByPath;	// all directories read so far
+
+	// Multithreaded parsing of text cache files
+
+	CacheReadPipeline * _pipeline;
+	bool		    _waitForBlocks;
+	bool		    _blockPending;
+	CacheBlock *	_block;		// block that is being added to the tree
+	int		_blockPos;	// next item in _block
+	int		_blockStartLine; // line number before the start of _block
+
+	// Streams that are still being written (see RemoteReadJob)
+
+	QIODevice *	_stream;
+	bool		_streamFinished;
+	bool		_headerChecked;
+
+	// Delta-encoded paths (COMPACT_CACHE_FORMAT_VERSION)
+
+	bool		_compactPaths;
+	QByteArray	_lastRawPath;	// the last full path, URL-encoded
+
+	// Several cache files merged into one tree (see mergeInto())
+
+	DirInfo *	_mergeParent;
+	QString		_mergeLabel;
+
+	// Lazy loading (see DirTree::lazyCacheLoading())
+
+	QList<CacheBlockInfo> _lazyBlocks;	// blocks to add placeholders for
+	DirInfo *	_target;	// placeholder that is being read
+	QString		_targetPrefix;	// URL of _target with trailing "/"
+	bool		_blockDone;	// end of the toplevel or _target block
+
+	// Binary cache files
+
+	bool		_binary;
+	QFile *		_binaryFile;
+	quint64		_binItemCount;
+	quint64		_binNextItem;
+	quint64		_binEndItem;
+	quint64		_binStringsSize;
+	const qint64 *	_binParents;
+	const qint64 *	_binSizes;
+	const qint64 *	_binBlocks;
+	const qint64 *	_binMtimes;
+	const quint64 * _binNames;
+	const quint32 * _binLinks;
+	const quint32 * _binModes;
+	const char *	_binStrings;
+	QVector<DirInfo *> _binDirs;	     // DirInfo for each directory item
+	QBitArray	   _binSkipChildren; // parent excluded or missing
+
+	// Lazy loading of binary cache files (see startLazyBinary())
+
+	struct BinaryDirState
+	{
+	    quint64 index;
+	    bool    hasDirs;
+	    bool    hasFiles;
+	};
+
+	bool		_binLazy;
+	quint64		_binTop;	  // the directory that is read
+	DirInfo *	_binTopDir;
+	DirInfo *	_binPendingDir;	  // placeholder that is summed up
+	CacheBlockInfo	_binPendingBlock;
+	QVector<BinaryDirState> _binDirStack; // open directories in its subtree
     };
 
 }	// namespace QDirStat
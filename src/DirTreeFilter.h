@@ -12,6 +12,8 @@
 
 #include <QString>
 
+#include "RuleStats.h"
+
 
 namespace QDirStat
 {
@@ -43,6 +45,33 @@ namespace QDirStat
 	 **/
 	virtual bool ignore( const QString & path ) const = 0;
 
+	/**
+	 * Return 'true' if entry 'name' of directory 'dirPath' should be
+	 * ignored, 'false' if not.
+	 *
+	 * Directory reading calls this for all entries of one directory in a
+	 * row, so derived classes can reimplement this to look up 'dirPath'
+	 * only once instead of the complete path of each entry. This default
+	 * implementation builds the complete path and calls ignore( path ).
+	 **/
+	virtual bool ignore( const QString & dirPath, const QString & name ) const
+	    { return ignore( ( dirPath == "/" ? QString() : dirPath ) + "/" + name ); }
+
+	/**
+	 * Return a short description of this filter for the log.
+	 **/
+	virtual QString description() const = 0;
+
+	/**
+	 * Return the counters of this filter (see RuleStats).
+	 **/
+	RuleStats & stats() { return _stats; }
+
+
+    protected:
+
+	RuleStats _stats;
+
     };	// class DirTreeFilter
 
 }	// namespace QDirStat
@@ -0,0 +1,280 @@
+/*
+ *   File name: DirTreeFilterChain.cpp
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QStringList>
+
+#include "DirTreeFilterChain.h"
+#include "DirTreePatternFilter.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+DirTreeFilterChain::DirTreeFilterChain( const QList<DirTreeFilter *> & filters ):
+    _haveNamePatterns( false ),
+    _havePathPatterns( false )
+{
+    QStringList nameRegExps;
+    QStringList pathRegExps;
+
+    foreach ( DirTreeFilter * filter, filters )
+    {
+	DirTreeSuffixFilter  * suffixFilter  = dynamic_cast<DirTreeSuffixFilter  *>( filter );
+	DirTreePatternFilter * patternFilter = dynamic_cast<DirTreePatternFilter *>( filter );
+
+	// Only a simple suffix like ".o" is always the part of the name
+	// from the last dot on
+
+	if ( suffixFilter &&
+	     suffixFilter->suffix().startsWith( "." ) &&
+	     suffixFilter->suffix().count( '.' ) == 1 )
+	{
+	    if ( ! _suffixes.contains( suffixFilter->suffix() ) )
+		_suffixes.insert( suffixFilter->suffix(), filter );
+
+	    _suffixFilters << filter;
+	}
+	else if ( patternFilter )
+	{
+	    QString regExp = wildcardToRegExp( patternFilter->pattern() );
+
+	    if ( patternFilter->pattern().contains( "/" ) )
+	    {
+		pathRegExps  << regExp;
+		_pathFilters << filter;
+	    }
+	    else
+	    {
+		nameRegExps  << regExp;
+		_nameFilters << filter;
+	    }
+	}
+	else if ( filter )
+	{
+	    _otherFilters << filter;
+	}
+    }
+
+    _haveNamePatterns = ! nameRegExps.isEmpty();
+    _havePathPatterns = ! pathRegExps.isEmpty();
+
+    if ( _haveNamePatterns )
+	_namePatterns = combined( nameRegExps );
+
+    if ( _havePathPatterns )
+	_pathPatterns = combined( pathRegExps );
+
+    logDebug() << _suffixes.size()     << " suffixes, "
+	       << nameRegExps.size()   << " name patterns, "
+	       << pathRegExps.size()   << " path patterns, "
+	       << _otherFilters.size() << " other filters"
+	       << endl;
+}
+
+
+QRegExp DirTreeFilterChain::combined( const QStringList & regExps )
+{
+    QString pattern = "(?:" + regExps.join( ")|(?:" ) + ")";
+
+    return QRegExp( pattern, Qt::CaseSensitive, QRegExp::RegExp );
+}
+
+
+QString DirTreeFilterChain::wildcardToRegExp( const QString & wildcard )
+{
+    QString regExp;
+    int len = wildcard.length();
+
+    for ( int i=0; i < len; ++i )
+    {
+	QChar ch = wildcard.at( i );
+
+	if ( ch == '*' )
+	{
+	    regExp += ".*";
+	}
+	else if ( ch == '?' )
+	{
+	    regExp += ".";
+	}
+	else if ( ch == '[' )
+	{
+	    // Character set: "[abc]", "[!abc]" or "[^abc]"; a "]" right
+	    // after the opening bracket is part of the set
+
+	    int pos = i + 1;
+
+	    if ( pos < len && ( wildcard.at( pos ) == '!' || wildcard.at( pos ) == '^' ) )
+		++pos;
+
+	    if ( pos < len && wildcard.at( pos ) == ']' )
+		++pos;
+
+	    int end = wildcard.indexOf( ']', pos );
+
+	    if ( end < 0 )	// no closing bracket: a literal "["
+	    {
+		regExp += "\\[";
+		continue;
+	    }
+
+	    QString set = wildcard.mid( i + 1, end - i - 1 );
+
+	    if ( set.startsWith( '!' ) )
+		set[0] = '^';
+
+	    set.replace( "\\", "\\\\" );
+	    regExp += "[" + set + "]";
+	    i = end;
+	}
+	else
+	{
+	    regExp += QRegExp::escape( QString( ch ) );
+	}
+    }
+
+    return regExp;
+}
+
+
+bool DirTreeFilterChain::ignore( const QString & dirPath, const QString & name ) const
+{
+    if ( ! _suffixes.isEmpty() )
+    {
+	RuleStatsTimer timer;
+	int dot = name.lastIndexOf( '.' );
+	DirTreeFilter * filter = dot >= 0 ? _suffixes.value( name.mid( dot ), 0 ) : 0;
+
+	if ( timer.add( &_suffixStats, filter != 0 ) )
+	{
+	    if ( RuleStats::enabled() )
+		filter->stats().addMatch();
+
+	    return true;
+	}
+    }
+
+    if ( _haveNamePatterns )
+    {
+	RuleStatsTimer timer;
+
+	if ( timer.add( &_nameStats, _namePatterns.exactMatch( name ) ) )
+	{
+	    if ( RuleStats::enabled() )
+		countMatch( _nameFilters, dirPath, name );
+
+	    return true;
+	}
+    }
+
+    if ( _havePathPatterns )
+    {
+	RuleStatsTimer timer;
+	QString path = ( dirPath == "/" ? QString() : dirPath ) + "/" + name;
+
+	if ( timer.add( &_pathStats, _pathPatterns.exactMatch( path ) ) )
+	{
+	    if ( RuleStats::enabled() )
+		countMatch( _pathFilters, dirPath, name );
+
+	    return true;
+	}
+    }
+
+    foreach ( DirTreeFilter * filter, _otherFilters )
+    {
+	RuleStatsTimer timer;
+
+	if ( timer.add( &filter->stats(), filter->ignore( dirPath, name ) ) )
+	    return true;
+    }
+
+    return false;
+}
+
+
+bool DirTreeFilterChain::ignore( const QString & path ) const
+{
+    int slash = path.lastIndexOf( '/' );
+
+    if ( slash < 0 )
+	return ignore( QString(), path );
+
+    QString dirPath = slash == 0 ? QString( "/" ) : path.left( slash );
+
+    return ignore( dirPath, path.mid( slash + 1 ) );
+}
+
+
+void DirTreeFilterChain::countMatch( const QList<DirTreeFilter *> & filters,
+				     const QString & dirPath,
+				     const QString & name )
+{
+    // Only done for a match of the combined patterns, so it doesn't matter
+    // that this checks the patterns one by one
+
+    foreach ( DirTreeFilter * filter, filters )
+    {
+	if ( filter->ignore( dirPath, name ) )
+	{
+	    filter->stats().addMatch();
+	    return;
+	}
+    }
+}
+
+
+void DirTreeFilterChain::resetStats()
+{
+    _suffixStats.reset();
+    _nameStats.reset();
+    _pathStats.reset();
+
+    QList<DirTreeFilter *> filters;
+    filters << _suffixFilters << _nameFilters << _pathFilters << _otherFilters;
+
+    foreach ( DirTreeFilter * filter, filters )
+	filter->stats().reset();
+}
+
+
+void DirTreeFilterChain::logStats() const
+{
+    logInfo() << "Filters:" << endl;
+
+    if ( ! _suffixFilters.isEmpty() )
+    {
+	logInfo() << "  " << _suffixFilters.size() << " suffixes: " << _suffixStats.toString() << endl;
+	logMatches( _suffixFilters );
+    }
+
+    if ( ! _nameFilters.isEmpty() )
+    {
+	logInfo() << "  " << _nameFilters.size() << " name patterns: " << _nameStats.toString() << endl;
+	logMatches( _nameFilters );
+    }
+
+    if ( ! _pathFilters.isEmpty() )
+    {
+	logInfo() << "  " << _pathFilters.size() << " path patterns: " << _pathStats.toString() << endl;
+	logMatches( _pathFilters );
+    }
+
+    foreach ( DirTreeFilter * filter, _otherFilters )
+	logInfo() << "  " << filter->description() << ": " << filter->stats().toString() << endl;
+}
+
+
+void DirTreeFilterChain::logMatches( const QList<DirTreeFilter *> & filters )
+{
+    foreach ( DirTreeFilter * filter, filters )
+	logInfo() << "    " << filter->description() << ": " << filter->stats().matches() << " matches" << endl;
+}
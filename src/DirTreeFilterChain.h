@@ -0,0 +1,131 @@
+/*
+ *   File name: DirTreeFilterChain.h
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DirTreeFilterChain_h
+#define DirTreeFilterChain_h
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QRegExp>
+
+#include "RuleStats.h"
+
+
+namespace QDirStat
+{
+    class DirTreeFilter;
+
+    /**
+     * All the DirTreeFilters of a DirTree combined so that checking one
+     * directory entry doesn't have to ask each filter in turn:
+     *
+     * - The suffixes of all DirTreeSuffixFilters are in one hash set, so
+     *	 they need only one lookup for the suffix of the entry name.
+     *
+     * - The patterns of all DirTreePatternFilters are combined into one
+     *	 regular expression for the entry name (patterns without a slash)
+     *	 and one for the complete path (patterns with a slash).
+     *
+     * - All other filters (e.g. DirTreePkgFilter) are asked one by one with
+     *	 the directory path and the entry name.
+     *
+     * Only patterns with a slash need the complete path of the entry, so it
+     * is only built if there are any.
+     *
+     * If RuleStats are enabled, each of these groups counts its own
+     * evaluations and time; a match is also counted for the filter of
+     * the group that matched. Filters that are asked one by one count
+     * everything themselves.
+     *
+     * This does not take over ownership of the filters; it only refers to
+     * the other filters. Create a new one whenever the filters change.
+     **/
+    class DirTreeFilterChain
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	DirTreeFilterChain( const QList<DirTreeFilter *> & filters );
+
+	/**
+	 * Return 'true' if entry 'name' of directory 'dirPath' should be
+	 * ignored, 'false' if not.
+	 **/
+	bool ignore( const QString & dirPath, const QString & name ) const;
+
+	/**
+	 * Return 'true' if the filesystem object specified by 'path' should
+	 * be ignored, 'false' if not.
+	 **/
+	bool ignore( const QString & path ) const;
+
+	/**
+	 * Return a regular expression (QRegExp::RegExp syntax) for wildcard
+	 * pattern 'wildcard' (QRegExp::Wildcard syntax).
+	 **/
+	static QString wildcardToRegExp( const QString & wildcard );
+
+	/**
+	 * Set the counters of the filter groups and of all filters back to
+	 * zero.
+	 **/
+	void resetStats();
+
+	/**
+	 * Write the counters of the filter groups and of all filters to the
+	 * log.
+	 **/
+	void logStats() const;
+
+
+    protected:
+
+	/**
+	 * Count a match for the first one of the pattern filters 'filters'
+	 * that matches entry 'name' of directory 'dirPath'.
+	 **/
+	static void countMatch( const QList<DirTreeFilter *> & filters,
+				const QString & dirPath,
+				const QString & name );
+
+	/**
+	 * Write the match counters of 'filters' to the log.
+	 **/
+	static void logMatches( const QList<DirTreeFilter *> & filters );
+
+	/**
+	 * Return a regular expression that matches any of 'regExps'.
+	 **/
+	static QRegExp combined( const QStringList & regExps );
+
+
+	// Data members
+
+	QHash<QString, DirTreeFilter *> _suffixes;
+	QRegExp			_namePatterns;
+	QRegExp			_pathPatterns;
+	bool			_haveNamePatterns;
+	bool			_havePathPatterns;
+	QList<DirTreeFilter *>	_suffixFilters;
+	QList<DirTreeFilter *>	_nameFilters;
+	QList<DirTreeFilter *>	_pathFilters;
+	QList<DirTreeFilter *>	_otherFilters;
+
+	mutable RuleStats	_suffixStats;
+	mutable RuleStats	_nameStats;
+	mutable RuleStats	_pathStats;
+
+    };	// class DirTreeFilterChain
+
+}	// namespace QDirStat
+
+#endif	// DirTreeFilterChain_h
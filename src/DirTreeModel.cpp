@@ -16,11 +16,14 @@
 #include "DirInfo.h"
 #include "FileInfoIterator.h"
 #include "DataColumns.h"
+#include "RuleStats.h"
 #include "SelectionModel.h"
 #include "Settings.h"
 #include "SettingsHelpers.h"
 #include "Logger.h"
 #include "FormatUtil.h"
+#include "ReadTrace.h"
+#include "StallWatchdog.h"
 #include "Exception.h"
 #include "DebugHelpers.h"
 
@@ -32,6 +35,15 @@
 // like (4k)
 #define SMALL_FILE_SHOW_ALLOC_THRESHOLD         75
 
+// Maximum number of rows in the text cache. When scrolling through a huge
+// directory, the cache is simply started over when it gets that large.
+#define MAX_TEXT_CACHE_ROWS	5000
+
+// Number of rows of a directory that are reported to the views at first and
+// with each fetchMore() call: A QTreeView sets up internal data for all rows
+// of a directory when it is opened, which takes a long time for millions.
+#define FETCH_MORE_CHUNK_SIZE	10000
+
 using namespace QDirStat;
 
 
@@ -45,7 +57,9 @@ DirTreeModel::DirTreeModel( QObject * parent ):
     _slowUpdate( false ),
     _sortCol( NameCol ),
     _sortOrder( Qt::AscendingOrder ),
-    _removingRows( false )
+    _removingRows( false ),
+    _updating( false ),
+    _changingLayout( false )
 {
     createTree();
     readSettings();
@@ -72,7 +86,38 @@ void DirTreeModel::readSettings()
     settings.beginGroup( "DirectoryTree" );
 
     _tree->setCrossFilesystems	( settings.value( "CrossFilesystems", false ).toBool() );
+    _tree->setReadThreads	( settings.value( "ReadThreads",	0 ).toInt()  );
+    _tree->setNetworkReadThreads( settings.value( "NetworkReadThreads", 0 ).toInt()  );
+    _tree->setUseIoUring	( settings.value( "UseIoUring",      true ).toBool() );
+    _tree->setInodeOrderOnRotational( settings.value( "InodeOrderOnRotational", true ).toBool() );
+    _tree->setStatRateLimit	( settings.value( "StatRateLimit",	0 ).toInt()  );
+    _tree->setIdleIoPriority	( settings.value( "IdleIoPriority",   false ).toBool() );
+    _tree->setReadTopology( (ReadTopology) readEnumEntry( settings, "ReadTopology", TopologyIgnore,
+							  DirReadScheduler::topologyMapping() ) );
+    _tree->setBulkStat		( settings.value( "BulkStat",	      false ).toBool() );
+    _tree->setQuotaMode( (QuotaMode) readEnumEntry( settings, "QuotaTotals", QuotaIgnore,
+						    QuotaUsage::quotaModeMapping() ) );
+    _tree->sizeEstimator()->setFullLevels   ( settings.value( "EstimateFullLevels",    2 ).toInt() );
+    _tree->sizeEstimator()->setSamplePercent( settings.value( "EstimateSamplePercent", 10 ).toInt() );
+    _tree->sizeEstimator()->setMinSamples   ( settings.value( "EstimateMinSamples",    3 ).toInt() );
+    _tree->setLazyCacheLoading	( settings.value( "LazyCacheLoading", false ).toBool() );
+    _tree->setShareCacheImages	( settings.value( "ShareCacheImages", false ).toBool() );
+    _tree->setCompactCachePaths ( settings.value( "CompactCachePaths", false ).toBool() );
+    _tree->setSpillFiles	( settings.value( "SpillFiles",	      false ).toBool() );
+    _tree->setSpillDir		( settings.value( "SpillDir",	      "" ).toString() );
+    _tree->setFreezeColdFiles	( settings.value( "FreezeColdFiles",  false ).toBool() );
+    _tree->setMemoryBudget	( settings.value( "MemoryBudgetMB",   0 ).toLongLong() * 1024 * 1024 );
+    _tree->setContiguousChildren( settings.value( "ContiguousChildren", false ).toBool() );
+    _tree->setFileColumns	( settings.value( "FileColumns",      false ).toBool() );
+    _tree->setCacheCategories	( settings.value( "CacheCategories",  false ).toBool() );
+    _tree->setCacheFileAgeSummaries( settings.value( "CacheFileAgeSummaries", false ).toBool() );
+    _tree->setIncrementalRefresh( settings.value( "IncrementalRefresh", false ).toBool() );
+    _tree->setUseLocateIndex	( settings.value( "LocateIndex",      true ).toBool() );
+    _tree->setWatchUpdateMillisec( settings.value( "WatchUpdateMillisec", 2000 ).toInt() );
+    _tree->setWatchTree		( settings.value( "WatchTree",	      false ).toBool() );
     FileInfo::setIgnoreHardLinks( settings.value( "IgnoreHardLinks",  false ).toBool() );
+    FileInfo::setCountHardLinksOnce( settings.value( "CountHardLinksOnce", false ).toBool() );
+    RuleStats::setEnabled	( settings.value( "RuleStatistics",   false ).toBool() );
     _treeIconDir	 = settings.value( "TreeIconDir" , ":/icons/tree-medium/" ).toString();
     _updateTimerMillisec = settings.value( "UpdateTimerMillisec", 333 ).toInt();
     _slowUpdateMillisec	 = settings.value( "SlowUpdateMillisec", 3000 ).toInt();
@@ -109,6 +154,35 @@ void DirTreeModel::writeSettings()
 
     settings.setDefaultValue( "CrossFilesystems",    _tree ? _tree->crossFilesystems() : false );
     settings.setDefaultValue( "IgnoreHardLinks",     FileInfo::ignoreHardLinks() );
+    settings.setDefaultValue( "CountHardLinksOnce",  FileInfo::countHardLinksOnce() );
+    settings.setDefaultValue( "RuleStatistics",	     RuleStats::enabled() );
+    settings.setDefaultValue( "ReadThreads",	     _tree ? _tree->readThreads()	 : 0 );
+    settings.setDefaultValue( "NetworkReadThreads",  _tree ? _tree->networkReadThreads() : 0 );
+    settings.setDefaultValue( "UseIoUring",	     _tree ? _tree->useIoUring()	 : true );
+    settings.setDefaultValue( "InodeOrderOnRotational", _tree ? _tree->inodeOrderOnRotational() : true );
+    settings.setDefaultValue( "StatRateLimit",	     _tree ? _tree->statRateLimit()	 : 0 );
+    settings.setDefaultValue( "IdleIoPriority",	     _tree ? _tree->idleIoPriority()	 : false );
+    settings.setDefaultValue( "ReadTopology",	     DirReadScheduler::topologyMapping().value( _tree ? _tree->readTopology() : TopologyIgnore ) );
+    settings.setDefaultValue( "BulkStat",	     _tree ? _tree->bulkStat()		 : false );
+    settings.setDefaultValue( "QuotaTotals",	     QuotaUsage::quotaModeMapping().value( _tree ? _tree->quotaMode() : QuotaIgnore ) );
+    settings.setDefaultValue( "EstimateFullLevels",    _tree ? _tree->sizeEstimator()->fullLevels()    : 2 );
+    settings.setDefaultValue( "EstimateSamplePercent", _tree ? _tree->sizeEstimator()->samplePercent() : 10 );
+    settings.setDefaultValue( "EstimateMinSamples",    _tree ? _tree->sizeEstimator()->minSamples()    : 3 );
+    settings.setDefaultValue( "LazyCacheLoading",    _tree ? _tree->lazyCacheLoading()	 : false );
+    settings.setDefaultValue( "ShareCacheImages",    _tree ? _tree->shareCacheImages()	 : false );
+    settings.setDefaultValue( "CompactCachePaths",   _tree ? _tree->compactCachePaths() : false );
+    settings.setDefaultValue( "SpillFiles",	     _tree ? _tree->spillFiles()	 : false );
+    settings.setDefaultValue( "SpillDir",	     _tree ? _tree->spillDir()		 : QString() );
+    settings.setDefaultValue( "FreezeColdFiles",     _tree ? _tree->freezeColdFiles()	 : false );
+    settings.setDefaultValue( "MemoryBudgetMB",	     _tree ? (int) ( _tree->memoryBudget().limit() / ( 1024 * 1024 ) ) : 0 );
+    settings.setDefaultValue( "ContiguousChildren",  _tree ? _tree->contiguousChildren() : false );
+    settings.setDefaultValue( "FileColumns",	     _tree ? _tree->fileColumns()	 : false );
+    settings.setDefaultValue( "CacheCategories",     _tree ? _tree->cacheCategories()	 : false );
+    settings.setDefaultValue( "CacheFileAgeSummaries", _tree ? _tree->cacheFileAgeSummaries() : false );
+    settings.setDefaultValue( "IncrementalRefresh",  _tree ? _tree->incrementalRefresh() : false );
+    settings.setDefaultValue( "LocateIndex",	     _tree ? _tree->useLocateIndex()	 : true );
+    settings.setDefaultValue( "WatchTree",	     _tree ? _tree->watchTree()		 : false );
+    settings.setDefaultValue( "WatchUpdateMillisec", _tree ? _tree->watchUpdateMillisec() : 2000 );
     settings.setDefaultValue( "TreeIconDir",	     _treeIconDir		 );
     settings.setDefaultValue( "UpdateTimerMillisec", _updateTimerMillisec	 );
 
@@ -170,6 +244,12 @@ void DirTreeModel::createTree()
 
     connect( _tree, SIGNAL( childDeleted() ),
 	     this,  SLOT  ( childDeleted() ) );
+
+    connect( _tree, SIGNAL( startingUpdate() ),
+	     this,  SLOT  ( startingUpdate() ) );
+
+    connect( _tree, SIGNAL( updateFinished() ),
+	     this,  SLOT  ( updateFinished() ) );
 }
 
 
@@ -177,6 +257,9 @@ void DirTreeModel::clear()
 {
     if ( _tree )
     {
+	_pendingInserts.clear();
+	_exposedRows.clear();
+	invalidateTextCache();
 	beginResetModel();
 
 	// logDebug() << "After beginResetModel()" << endl;
@@ -255,6 +338,13 @@ FileInfo * DirTreeModel::findChild( DirInfo * parent, int childNo ) const
 {
     CHECK_PTR( parent );
 
+    // The first rows when sorting by size don't need sorting all children
+
+    FileInfo * largest = parent->largestSortedChild( childNo, _sortCol, _sortOrder );
+
+    if ( largest )
+	return largest;
+
     const FileInfoList & childrenList =
 	parent->sortedChildren( _sortCol, _sortOrder,
 				true );	    // includeAttic
@@ -280,11 +370,13 @@ int DirTreeModel::rowNumber( FileInfo * child ) const
     if ( ! child->parent() )
 	return 0;
 
-    const FileInfoList & childrenList =
-	child->parent()->sortedChildren( _sortCol, _sortOrder,
-					 true ); // includeAttic
+    int row = child->parent()->largestSortedChildRow( child, _sortCol, _sortOrder );
+
+    if ( row >= 0 )
+	return row;
 
-    int row = childrenList.indexOf( child );
+    row = child->parent()->sortedChildRow( child, _sortCol, _sortOrder,
+					   true ); // includeAttic
 
     if ( row < 0 )
     {
@@ -345,6 +437,13 @@ int DirTreeModel::rowCount( const QModelIndex & parentIndex ) const
 	return 0;
     }
 
+    if ( _pendingInserts.contains( item->toDirInfo() ) )
+    {
+	// The view will get all rows at once with sendPendingInserts()
+
+	return 0;
+    }
+
     switch ( item->readState() )
     {
 	case DirQueued:
@@ -393,6 +492,9 @@ int DirTreeModel::rowCount( const QModelIndex & parentIndex ) const
 	// missing enum values
     }
 
+    if ( count > FETCH_MORE_CHUNK_SIZE )
+	count = exposedRowCount( item->toDirInfo(), count );
+
     // logDebug() << dirName << ": " << count << endl;
     return count;
 }
@@ -406,6 +508,156 @@ int DirTreeModel::columnCount( const QModelIndex & parent ) const
 }
 
 
+DirInfo * DirTreeModel::cachePlaceholder( const QModelIndex & index ) const
+{
+    if ( ! index.isValid() )
+	return 0;
+
+    FileInfo * item = static_cast<FileInfo *>( index.internalPointer() );
+    CHECK_MAGIC( item );
+
+    if ( item->isDirInfo() &&
+	 ( item->toDirInfo()->isCachePlaceholder() || item->toDirInfo()->isQuotaPlaceholder() ) )
+    {
+	return item->toDirInfo();
+    }
+
+    return 0;
+}
+
+
+bool DirTreeModel::hasChildren( const QModelIndex & parent ) const
+{
+    if ( cachePlaceholder( parent ) )
+	return true;
+
+    return QAbstractItemModel::hasChildren( parent );
+}
+
+
+bool DirTreeModel::canFetchMore( const QModelIndex & parent ) const
+{
+    DirInfo * dir = cachePlaceholder( parent );
+
+    if ( dir )
+	return dir->readState() != DirReading;
+
+    // A huge directory of which not all rows are reported yet
+
+    dir = dirFromIndex( parent );
+
+    if ( ! dir )
+	return false;
+
+    int rows = rowCount( parent );
+
+    return rows >= FETCH_MORE_CHUNK_SIZE && rows < directChildrenCount( dir );
+}
+
+
+void DirTreeModel::fetchMore( const QModelIndex & parent )
+{
+    DirInfo * dir = cachePlaceholder( parent );
+
+    if ( dir )
+    {
+	if ( _tree )
+	{
+	    // A quota placeholder was never read: Read it now
+
+	    if ( dir->isQuotaPlaceholder() )
+		_tree->refresh( dir );
+	    else
+		_tree->readCachePlaceholder( dir );
+	}
+
+	return;
+    }
+
+    if ( canFetchMore( parent ) )
+	exposeRows( dirFromIndex( parent ), rowCount( parent ) + FETCH_MORE_CHUNK_SIZE );
+}
+
+
+DirInfo * DirTreeModel::dirFromIndex( const QModelIndex & index ) const
+{
+    if ( ! _tree )
+	return 0;
+
+    FileInfo * item = _tree->root();
+
+    if ( index.isValid() )
+    {
+	item = static_cast<FileInfo *>( index.internalPointer() );
+	CHECK_MAGIC( item );
+    }
+
+    return item && item->isDirInfo() ? item->toDirInfo() : 0;
+}
+
+
+int DirTreeModel::exposedRowCount( DirInfo * dir, int count ) const
+{
+    if ( count <= FETCH_MORE_CHUNK_SIZE )
+	return count;
+
+    return qMin( count, _exposedRows.value( dir, FETCH_MORE_CHUNK_SIZE ) );
+}
+
+
+void DirTreeModel::exposeRows( DirInfo * dir, int rows )
+{
+    if ( ! dir )
+	return;
+
+    int count = directChildrenCount( dir );
+    int shown = exposedRowCount( dir, count );
+
+    if ( rows <= shown )
+	return;
+
+    // Round up to full chunks
+
+    rows = ( ( rows + FETCH_MORE_CHUNK_SIZE - 1 ) / FETCH_MORE_CHUNK_SIZE ) * FETCH_MORE_CHUNK_SIZE;
+    rows = qMin( rows, count );
+
+    QModelIndex index = modelIndex( dir );
+
+    // If the views don't know about any rows of this directory yet, or if
+    // the layout is changing right now, they get the new row count with
+    // the next rowCount() call anyway.
+
+    if ( _changingLayout || _updating || _removingRows || rowCount( index ) != shown )
+    {
+	_exposedRows[ dir ] = rows;
+	return;
+    }
+
+    // logDebug() << "Exposing rows " << shown << ".." << rows - 1 << " of " << dir << endl;
+
+    beginInsertRows( index, shown, rows - 1 );
+    _exposedRows[ dir ] = rows;
+    endInsertRows();
+}
+
+
+void DirTreeModel::forgetExposedRows( FileInfo * subtree )
+{
+    if ( _exposedRows.isEmpty() )
+	return;
+
+    QMutableHashIterator<DirInfo *, int> it( _exposedRows );
+
+    while ( it.hasNext() )
+    {
+	it.next();
+
+	if ( it.key()->isInSubtree( subtree ) )
+	    it.remove();
+    }
+}
+
+
 QVariant DirTreeModel::data( const QModelIndex & index, int role ) const
 {
     if ( ! index.isValid() )
@@ -419,7 +671,7 @@ QVariant DirTreeModel::data( const QModelIndex & index, int role ) const
     {
 	case Qt::DisplayRole:
 	    {
-		QVariant result = columnText( item, col );
+		QVariant result = cachedColumnText( item, col );
 
 		if ( item && item->isDirInfo() )
 		{
@@ -659,6 +911,8 @@ QModelIndex DirTreeModel::parent( const QModelIndex & index ) const
 
 void DirTreeModel::sort( int column, Qt::SortOrder order )
 {
+    StallOperation operation( "Sorting" );
+
     logDebug() << "Sorting by " << static_cast<DataColumn>( column )
 	       << ( order == Qt::AscendingOrder ? " ascending" : " descending" )
 	       << endl;
@@ -684,6 +938,7 @@ void DirTreeModel::sort( int column, Qt::SortOrder order )
 
 void DirTreeModel::busyDisplay()
 {
+    invalidateTextCache();
     emit layoutAboutToBeChanged();
 
     _sortCol = NameCol;
@@ -696,6 +951,7 @@ void DirTreeModel::busyDisplay()
 
 void DirTreeModel::idleDisplay()
 {
+    invalidateTextCache();
     emit layoutAboutToBeChanged();
 
     _sortCol = PercentNumCol;
@@ -717,12 +973,43 @@ QModelIndex DirTreeModel::modelIndex( FileInfo * item, int column ) const
     {
 	int row = rowNumber( item );
 	// logDebug() << item << " is row #" << row << " of " << item->parent() << endl;
+
+	if ( row >= FETCH_MORE_CHUNK_SIZE )
+	{
+	    // An item beyond the rows of a huge directory that are reported
+	    // so far, e.g. one that was selected in the treemap: Report all
+	    // rows up to that one.
+
+	    const_cast<DirTreeModel *>( this )->exposeRows( item->parent(), row + 1 );
+	}
+
 	return row < 0 ? QModelIndex() : createIndex( row, column, item );
     }
 }
 
 
 
+QVariant DirTreeModel::cachedColumnText( FileInfo * item, int col ) const
+{
+    if ( col < 0 || col >= DataColumnEnd )
+	return columnText( item, col );
+
+    if ( _textCache.size() >= MAX_TEXT_CACHE_ROWS && ! _textCache.contains( item ) )
+	_textCache.clear();
+
+    RowTexts & row = _textCache[ item ];
+    quint32    bit = 1 << col;
+
+    if ( ! ( row.cached & bit ) )
+    {
+	row.text[ col ] = columnText( item, col );
+	row.cached |= bit;
+    }
+
+    return row.text[ col ];
+}
+
+
 QVariant DirTreeModel::columnText( FileInfo * item, int col ) const
 {
     CHECK_PTR( item );
@@ -776,13 +1063,13 @@ QVariant DirTreeModel::columnText( FileInfo * item, int col ) const
 
 	switch ( col )
 	{
-	    case TotalItemsCol:	  return prefix + QString( "%1" ).arg( item->totalItems() );
-	    case TotalFilesCol:	  return prefix + QString( "%1" ).arg( item->totalFiles() );
+	    case TotalItemsCol:	  return prefix + QString::number( item->totalItems() );
+	    case TotalFilesCol:	  return prefix + QString::number( item->totalFiles() );
 	    case TotalSubDirsCol:
 		if ( item->isDotEntry() )
 		    return QVariant();
 		else
-		    return prefix + QString( "%1" ).arg( item->totalSubDirs() );
+		    return prefix + QString::number( item->totalSubDirs() );
 
 	    case OldestFileMTimeCol:  return QString( "	 " ) + formatTime( item->oldestFileMtime() );
 	}
@@ -917,10 +1204,34 @@ QVariant DirTreeModel::sizeColText( FileInfo * item ) const
     if ( item->isDevice() )
 	return QVariant();
 
-    QString leftMargin( 2, ' ' );
+    static const QString leftMargin( 2, ' ' );
 
     if ( item->isDirInfo() )
-	return leftMargin + item->sizePrefix() + formatSize( item->totalAllocatedSize() );
+    {
+	QString text = leftMargin + item->sizePrefix() + formatSize( item->totalAllocatedSize() );
+
+	// The 95% confidence interval in estimate mode
+
+	FileSize margin = _tree->sizeEstimator()->allocatedMargin( item->toDirInfo() );
+
+	if ( margin > 0 )
+	    text += QString( " %1%2" ).arg( QChar( 0x00B1 ) ).arg( formatSize( margin ) );
+
+	// What the filesystem says while the subtree is not read (yet)
+
+	DirInfo * dir = item->toDirInfo();
+	const QuotaTotals * quota = _tree->quotaTotals( dir );
+
+	if ( quota && ( dir->isBusy() || dir->readState() == DirOnRequestOnly ) )
+	{
+	    if ( dir->isQuotaPlaceholder() )
+		text += QString( " (%1)" ).arg( quota->source );
+	    else
+		text += QString( " (%1: %2)" ).arg( quota->source ).arg( formatSize( quota->usedBytes ) );
+	}
+
+	return text;
+    }
 
     QString text = sizeText( item );
 
@@ -976,6 +1287,8 @@ QVariant DirTreeModel::columnIcon( FileInfo * item, int col ) const
 
 void DirTreeModel::readJobFinished( DirInfo * dir )
 {
+    READ_TRACE_SCOPE( "model readJobFinished", dir ? dir->url() : QString() );
+    invalidateTextCache();
     // logDebug() << dir << endl;
     delayedUpdate( dir );
 
@@ -984,6 +1297,10 @@ void DirTreeModel::readJobFinished( DirInfo * dir )
 	if  ( dir && ! dir->isMountPoint() )
 	    logDebug() << "Ancestor busy - ignoring readJobFinished for " << dir << endl;
     }
+    else if ( dir && _updateTimer.isActive() )
+    {
+	_pendingInserts.insert( dir );
+    }
     else
     {
 	newChildrenNotify( dir );
@@ -991,6 +1308,57 @@ void DirTreeModel::readJobFinished( DirInfo * dir )
 }
 
 
+bool DirTreeModel::anyAncestorPending( DirInfo * dir ) const
+{
+    for ( DirInfo * parent = dir->parent(); parent; parent = parent->parent() )
+    {
+	if ( _pendingInserts.contains( parent ) )
+	    return true;
+    }
+
+    return false;
+}
+
+
+void DirTreeModel::sendPendingInserts()
+{
+    if ( _pendingInserts.isEmpty() )
+	return;
+
+    // logDebug() << "Sending inserts for " << _pendingInserts.size() << " dirs" << endl;
+
+    QSet<DirInfo *> pending = _pendingInserts;
+
+    foreach ( DirInfo * dir, pending )
+    {
+	if ( ! _pendingInserts.contains( dir ) ) // already sent for an ancestor
+	    continue;
+
+	if ( anyAncestorPending( dir ) )
+	{
+	    // newChildrenNotify() for the ancestor recurses into this one;
+	    // the view can't have any rows for this dir before it has the
+	    // ancestor's rows.
+
+	    continue;
+	}
+
+	if ( anyAncestorBusy( dir ) )
+	{
+	    // Like in readJobFinished(): This is sent when the busy ancestor
+	    // is finished.
+
+	    _pendingInserts.remove( dir );
+	    continue;
+	}
+
+	newChildrenNotify( dir );
+    }
+
+    _pendingInserts.clear();
+}
+
+
 bool DirTreeModel::anyAncestorBusy( FileInfo * item ) const
 {
     while ( item )
@@ -1018,6 +1386,8 @@ void DirTreeModel::newChildrenNotify( DirInfo * dir )
 	return;
     }
 
+    _pendingInserts.remove( dir );
+
     if ( ! dir->isTouched() && dir != _tree->root() && dir != _tree->firstToplevel() )
     {
 	// logDebug() << "Remaining silent about untouched dir " << dir << endl;
@@ -1025,7 +1395,7 @@ void DirTreeModel::newChildrenNotify( DirInfo * dir )
     }
 
     QModelIndex index = modelIndex( dir );
-    int count = directChildrenCount( dir );
+    int count = exposedRowCount( dir, directChildrenCount( dir ) );
     // Debug::dumpDirectChildren( dir );
 
     if ( count > 0 )
@@ -1070,6 +1440,10 @@ void DirTreeModel::delayedUpdate( DirInfo * dir )
 
 void DirTreeModel::sendPendingUpdates()
 {
+    READ_TRACE_SCOPE( "model updates", QString::number( _pendingUpdates.size() ) );
+    sendPendingInserts();
+    invalidateTextCache();
+
     // logDebug() << "Sending " << _pendingUpdates.size() << " updates" << endl;
 
     foreach ( DirInfo * dir, _pendingUpdates )
@@ -1146,27 +1520,57 @@ void DirTreeModel::dumpPersistentIndexList() const
 
 void DirTreeModel::updatePersistentIndexes()
 {
-    QModelIndexList persistentList = persistentIndexList();
-
-    for ( int i=0; i < persistentList.size(); ++i )
+    // There is one persistent index for each column of a selected row, and
+    // many of them keep their row anyway (e.g. all in directories with no
+    // more than one child); so look up the new row only once for each item
+    // (which uses the row index of the sorted children of large
+    // directories), and update only the indexes that actually moved, all
+    // at once.
+
+    QModelIndexList	   oldIndexes = persistentIndexList();
+    QModelIndexList	   from;
+    QModelIndexList	   to;
+    QHash<FileInfo *, int> newRows;
+    _changingLayout = true;
+
+    foreach ( const QModelIndex & oldIndex, oldIndexes )
     {
-	QModelIndex oldIndex = persistentList.at(i);
+	if ( ! oldIndex.isValid() )
+	    continue;
+
+	FileInfo * item = static_cast<FileInfo *>( oldIndex.internalPointer() );
+	QHash<FileInfo *, int>::const_iterator it = newRows.constFind( item );
+	int newRow;
 
-	if ( oldIndex.isValid() )
+	if ( it != newRows.constEnd() )
+	    newRow = it.value();
+	else
 	{
-	    FileInfo * item = static_cast<FileInfo *>( oldIndex.internalPointer() );
-	    QModelIndex newIndex = modelIndex( item, oldIndex.column() );
+	    QModelIndex newIndex = modelIndex( item, 0 );
+	    newRow = newIndex.isValid() ? newIndex.row() : -1;
+	    newRows.insert( item, newRow );
+	}
+
+	if ( newRow == oldIndex.row() )
+	    continue;
+
 #if 0
-	    logDebug() << "Updating #" << i
-		       << " " << item
-		       << " col " << oldIndex.column()
-		       << " row " << oldIndex.row()
-		       << " --> " << newIndex.row()
-		       << endl;
+	logDebug() << "Updating " << item
+		   << " col " << oldIndex.column()
+		   << " row " << oldIndex.row()
+		   << " --> " << newRow
+		   << endl;
 #endif
-	    changePersistentIndex( oldIndex, newIndex );
-	}
+	from << oldIndex;
+	to   << ( newRow < 0 ? QModelIndex() : createIndex( newRow, oldIndex.column(), item ) );
     }
+
+    if ( ! from.isEmpty() )
+	changePersistentIndexList( from, to );
+
+    // logDebug() << from.size() << " of " << oldIndexes.size() << " persistent indexes moved" << endl;
+
+    _changingLayout = false;
 }
 
 
@@ -1203,23 +1607,49 @@ void DirTreeModel::endRemoveRows()
 void DirTreeModel::deletingChild( FileInfo * child )
 {
     logDebug() << "Deleting child " << child << endl;
+    sendPendingInserts();
+    invalidateTextCache();
 
-    if ( child->parent() &&
+    if ( ! _updating && child->parent() &&
 	 ( child->parent() == _tree->root() ||
 	   child->parent()->isTouched()	 ) )
     {
 	QModelIndex parentIndex = modelIndex( child->parent(), 0 );
 	int row = rowNumber( child );
-	logDebug() << "beginRemoveRows for " << child << " row " << row << endl;
-	beginRemoveRows( parentIndex, row, row );
+
+	if ( row < exposedRowCount( child->parent(), directChildrenCount( child->parent() ) ) )
+	{
+	    logDebug() << "beginRemoveRows for " << child << " row " << row << endl;
+	    beginRemoveRows( parentIndex, row, row );
+	}
     }
 
     invalidatePersistent( child, true );
+    forgetExposedRows( child );
+}
+
+
+void DirTreeModel::startingUpdate()
+{
+    sendPendingInserts();
+    emit layoutAboutToBeChanged();
+    _updating = true;
+}
+
+
+void DirTreeModel::updateFinished()
+{
+    _updating = false;
+    invalidateTextCache();
+
+    updatePersistentIndexes();
+    emit layoutChanged();
 }
 
 
 void DirTreeModel::childDeleted()
 {
+    invalidateTextCache();
     endRemoveRows();
 }
 
@@ -1227,11 +1657,13 @@ void DirTreeModel::childDeleted()
 void DirTreeModel::clearingSubtree( DirInfo * subtree )
 {
     logDebug() << "Deleting all children of " << subtree << endl;
+    sendPendingInserts();
+    invalidateTextCache();
 
     if ( subtree == _tree->root() || subtree->isTouched() )
     {
 	QModelIndex subtreeIndex = modelIndex( subtree, 0 );
-	int count = directChildrenCount( subtree );
+	int count = exposedRowCount( subtree, directChildrenCount( subtree ) );
 
 	if ( count > 0 )
 	{
@@ -1241,6 +1673,7 @@ void DirTreeModel::clearingSubtree( DirInfo * subtree )
     }
 
     invalidatePersistent( subtree, false );
+    forgetExposedRows( subtree );
 }
 
 
@@ -1248,6 +1681,7 @@ void DirTreeModel::subtreeCleared( DirInfo * subtree )
 {
     Q_UNUSED( subtree );
 
+    invalidateTextCache();
     endRemoveRows();
 }
 
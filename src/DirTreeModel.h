@@ -12,6 +12,7 @@
 
 #include <QAbstractItemModel>
 #include <QColor>
+#include <QHash>
 #include <QIcon>
 #include <QSet>
 #include <QTimer>
@@ -264,6 +265,31 @@ namespace QDirStat
 	 **/
 	virtual int columnCount( const QModelIndex & parent ) const Q_DECL_OVERRIDE;
 
+	/**
+	 * Return 'true' if 'parent' has any children. Reimplemented for cache
+	 * placeholders which have children that are not read yet.
+	 **/
+	virtual bool hasChildren( const QModelIndex & parent = QModelIndex() ) const Q_DECL_OVERRIDE;
+
+	/**
+	 * Return 'true' if 'parent' is a cache placeholder whose children can
+	 * be read with fetchMore() or a huge directory of which not all rows
+	 * are reported yet.
+	 **/
+	virtual bool canFetchMore( const QModelIndex & parent ) const Q_DECL_OVERRIDE;
+
+	/**
+	 * Start reading the children of the cache or quota placeholder
+	 * 'parent' or report the next chunk of rows of a huge directory.
+	 **/
+	virtual void fetchMore( const QModelIndex & parent ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Return the cache or quota placeholder for 'index' or 0 if it is
+	 * none.
+	 **/
+	DirInfo * cachePlaceholder( const QModelIndex & index ) const;
+
 	/**
 	 * Return data to be displayed for the specified model index and role.
 	 **/
@@ -371,6 +397,32 @@ namespace QDirStat
 	 **/
 	void sendPendingUpdates();
 
+	/**
+	 * Notify the views about the new children of all directories in
+	 * _pendingInserts, one beginInsertRows() / endInsertRows() for each
+	 * directory, parents before their subdirectories.
+	 *
+	 * While the update timer is running, finished read jobs only add
+	 * their directory to _pendingInserts, so the views get the new rows
+	 * of a lot of small directories in one batch several times per
+	 * second rather than one by one. Directories that the views never
+	 * asked about (i.e. in collapsed branches) stay silent anyway.
+	 **/
+	void sendPendingInserts();
+
+	/**
+	 * Notification that the tree is about to be updated from filesystem
+	 * events: Rows are added and removed without row notifications
+	 * until updateFinished(), so this is a layout change for the views.
+	 **/
+	void startingUpdate();
+
+	/**
+	 * Notification that updating the tree from filesystem events is
+	 * finished.
+	 **/
+	void updateFinished();
+
 	/**
 	 * Notification that a subtree is about to be deleted.
 	 **/
@@ -417,6 +469,11 @@ namespace QDirStat
 	 **/
 	void newChildrenNotify( DirInfo * dir );
 
+	/**
+	 * Return 'true' if any ancestor of 'dir' is in _pendingInserts.
+	 **/
+	bool anyAncestorPending( DirInfo * dir ) const;
+
 	/**
 	 * Notify the view about changed data of 'dir'.
 	 **/
@@ -439,6 +496,20 @@ namespace QDirStat
 	 **/
 	QVariant columnText( FileInfo * item, int col ) const;
 
+	/**
+	 * Return the text for (model) column 'col' for 'item' from the text
+	 * cache if it is there; otherwise get it with columnText() and store
+	 * it in the cache.
+	 **/
+	QVariant cachedColumnText( FileInfo * item, int col ) const;
+
+	/**
+	 * Drop all cached texts. This is necessary whenever any displayed
+	 * values might have changed or items might have been deleted (their
+	 * addresses might be reused for new items).
+	 **/
+	void invalidateTextCache() { _textCache.clear(); }
+
 	/**
 	 * Return the icon for (model) column 'col' for 'item'.
 	 **/
@@ -450,6 +521,31 @@ namespace QDirStat
 	 **/
 	int directChildrenCount( FileInfo * subtree ) const;
 
+	/**
+	 * Return the DirInfo for 'index' (the root for an invalid index) or 0
+	 * if it is not a DirInfo.
+	 **/
+	DirInfo * dirFromIndex( const QModelIndex & index ) const;
+
+	/**
+	 * Return how many of the 'count' rows of 'dir' are reported to the
+	 * views: For huge directories, that starts with the first chunk (in
+	 * the current sort order), and more are added with fetchMore().
+	 **/
+	int exposedRowCount( DirInfo * dir, int count ) const;
+
+	/**
+	 * Report at least the first 'rows' rows of 'dir' to the views
+	 * (rounded up to full chunks).
+	 **/
+	void exposeRows( DirInfo * dir, int rows );
+
+	/**
+	 * Forget how many rows are reported for the directories in 'subtree'.
+	 * This is necessary before they are deleted.
+	 **/
+	void forgetExposedRows( FileInfo * subtree );
+
 	/**
 	 * Return the text for the size for 'item'
 	 **/
@@ -480,6 +576,20 @@ namespace QDirStat
 	void endRemoveRows();
 
 
+	/**
+	 * The formatted display texts of one row: Formatting sizes, numbers
+	 * and dates is expensive, and the views ask for them very often,
+	 * e.g. for each row again with each scroll step.
+	 **/
+	struct RowTexts
+	{
+	    RowTexts(): cached( 0 ) {}
+
+	    quint32  cached;		// Bit mask of the valid entries in 'text'
+	    QVariant text[ DataColumnEnd ];
+	};
+
+
 	//
 	// Data members
 	//
@@ -489,6 +599,8 @@ namespace QDirStat
 	QString		 _treeIconDir;
 	int		 _readJobsCol;
 	QSet<DirInfo *>	 _pendingUpdates;
+	QSet<DirInfo *>	 _pendingInserts;	// reported with 0 rows until sent
+	mutable QHash<FileInfo *, RowTexts> _textCache;
 	QTimer		 _updateTimer;
 	int		 _updateTimerMillisec;
 	int		 _slowUpdateMillisec;
@@ -496,6 +608,9 @@ namespace QDirStat
 	DataColumn	 _sortCol;
 	Qt::SortOrder	 _sortOrder;
 	bool		 _removingRows;
+	bool		 _updating;
+	bool		 _changingLayout;
+	QHash<DirInfo *, int> _exposedRows;	// only for huge dirs
 
 	// Colors
 
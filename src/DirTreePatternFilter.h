@@ -60,6 +60,14 @@ namespace QDirStat
 	 **/
 	QString pattern() const { return _pattern; }
 
+	/**
+	 * Return a short description of this filter for the log.
+	 *
+	 * Implemented from DirTreeFilter.
+	 **/
+	virtual QString description() const Q_DECL_OVERRIDE
+	    { return _pattern; }
+
 
     protected:
 
@@ -103,6 +111,14 @@ namespace QDirStat
 	 **/
 	QString suffix() const { return _suffix; }
 
+	/**
+	 * Return a short description of this filter for the log.
+	 *
+	 * Implemented from DirTreeFilter.
+	 **/
+	virtual QString description() const Q_DECL_OVERRIDE
+	    { return QString( "*" ) + _suffix; }
+
 
     protected:
 
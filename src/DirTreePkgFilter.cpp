@@ -17,22 +17,44 @@
 using namespace QDirStat;
 
 
-DirTreePkgFilter::DirTreePkgFilter( PkgManager * pkgManager )
+DirTreePkgFilter::DirTreePkgFilter( PkgManager * pkgManager ):
+    _lastDirNode( -1 )
 {
     CHECK_PTR( pkgManager );
 
     logInfo() << "Creating file list cache for " << pkgManager->name() << endl;
-    _fileListCache = pkgManager->createFileListCache( PkgFileListCache::LookupGlobal );
+    _fileListCache = PkgFileListCache::create( pkgManager, PkgFileListCache::LookupGlobal );
     logInfo() << "Done." << endl;
 }
 
 
+DirTreePkgFilter::DirTreePkgFilter( PkgFileListCache * fileListCache ):
+    _fileListCache( fileListCache ),
+    _lastDirNode( -1 )
+{
+
+}
+
+
 DirTreePkgFilter::~DirTreePkgFilter()
 {
     delete _fileListCache;
 }
 
 
+void DirTreePkgFilter::setFileListCache( PkgFileListCache * fileListCache )
+{
+    if ( fileListCache == _fileListCache )
+	return;
+
+    delete _fileListCache;
+    _fileListCache = fileListCache;
+
+    _lastDirPath.clear();
+    _lastDirNode = -1;
+}
+
+
 bool DirTreePkgFilter::ignore( const QString & path ) const
 {
     if ( ! _fileListCache )
@@ -40,3 +62,21 @@ bool DirTreePkgFilter::ignore( const QString & path ) const
 
     return _fileListCache->containsFile( path );
 }
+
+
+bool DirTreePkgFilter::ignore( const QString & dirPath,
+			       const QString & name ) const
+{
+    if ( ! _fileListCache )
+	return false;
+
+    const PathTrie & files = _fileListCache->files();
+
+    if ( dirPath != _lastDirPath || _lastDirPath.isEmpty() )
+    {
+	_lastDirPath = dirPath;
+	_lastDirNode = files.find( dirPath );
+    }
+
+    return files.isPath( files.child( _lastDirNode, name ) );
+}
@@ -31,6 +31,14 @@ namespace QDirStat
 	 **/
 	DirTreePkgFilter( PkgManager * pkgManager );
 
+	/**
+	 * Constructor for a file list cache that was already created with
+	 * lookup type LookupGlobal, e.g. by a PkgFileListCacheThread. This
+	 * takes over ownership of 'fileListCache'. It may be 0; nothing is
+	 * ignored then.
+	 **/
+	DirTreePkgFilter( PkgFileListCache * fileListCache );
+
 	/**
 	 * Destructor.
 	 **/
@@ -44,11 +52,46 @@ namespace QDirStat
 	 **/
 	virtual bool ignore( const QString & path ) const Q_DECL_OVERRIDE;
 
+	/**
+	 * Return 'true' if entry 'name' of directory 'dirPath' should be
+	 * ignored, 'false' if not. This looks up the path trie node of
+	 * 'dirPath' only when the directory changes.
+	 *
+	 * Reimplemented from DirTreeFilter.
+	 **/
+	virtual bool ignore( const QString & dirPath,
+			     const QString & name ) const Q_DECL_OVERRIDE;
+
+	/**
+	 * Return a short description of this filter for the log.
+	 *
+	 * Implemented from DirTreeFilter.
+	 **/
+	virtual QString description() const Q_DECL_OVERRIDE
+	    { return "installed packages"; }
+
+	/**
+	 * Return the file list cache of this filter. This may be 0.
+	 **/
+	PkgFileListCache * fileListCache() const { return _fileListCache; }
+
+	/**
+	 * Set the file list cache when it was created only after reading
+	 * started (see DirTree::ignoreFilteredItems()). This takes over
+	 * ownership of 'fileListCache' and deletes the old one.
+	 **/
+	void setFileListCache( PkgFileListCache * fileListCache );
+
 
     protected:
 
 	PkgFileListCache * _fileListCache;
 
+	// Trie node of the directory of the last ignore( dirPath, name ) call
+
+	mutable QString	   _lastDirPath;
+	mutable int	   _lastDirNode;
+
     };	// class DirTreeFilter
 
 }	// namespace QDirStat
@@ -50,6 +50,9 @@ DirTreeView::DirTreeView( QWidget * parent ):
 
     connect( this , SIGNAL( customContextMenuRequested( const QPoint & ) ),
 	     this,  SLOT  ( contextMenu		      ( const QPoint & ) ) );
+
+    connect( this , SIGNAL( expanded	     ( const QModelIndex & ) ),
+	     this,  SLOT  ( prioritizeReading( const QModelIndex & ) ) );
 }
 
 
@@ -65,6 +68,19 @@ void DirTreeView::currentChanged( const QModelIndex & current,
     // logDebug() << "Setting new current to " << current << endl;
     QTreeView::currentChanged( current, oldCurrent );
     scrollTo( current );
+    prioritizeReading( current );
+}
+
+
+void DirTreeView::prioritizeReading( const QModelIndex & index )
+{
+    if ( ! index.isValid() )
+	return;
+
+    FileInfo * item = static_cast<FileInfo *>( index.internalPointer() );
+
+    if ( item && item->checkMagicNumber() && item->tree() )
+	item->tree()->prioritize( item );
 }
 
 
@@ -100,6 +116,7 @@ void DirTreeView::actionContextMenu( const QPoint & pos )
 	    << "---"
 	    << "actionFileSizeStats"
 	    << "actionFileTypeStats"
+	    << "actionShowDirList"
 	    << "---"
 	    << "actionMoveToTrash"
 	;
@@ -105,6 +105,13 @@ namespace QDirStat
 	 **/
 	void contextMenu( const QPoint & pos );
 
+	/**
+	 * Tell the tree that the user is looking at the item with model index
+	 * 'index' (it was expanded or became the current item), so it will
+	 * read that part of the tree first if it is still reading.
+	 **/
+	void prioritizeReading( const QModelIndex & index );
+
 
     protected:
 
@@ -0,0 +1,840 @@
+/*
+ *   File name: DirTreeWatcher.cpp
+ *   Summary:	Live updates of a DirTree from filesystem change events
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>	// strerror()
+#include <errno.h>
+#include <limits.h>	// PATH_MAX
+#include <algorithm>
+
+#ifdef __linux__
+#  include <sys/inotify.h>
+#  include <sys/fanotify.h>
+#  include <sys/statfs.h>
+#endif
+
+#include <QSocketNotifier>
+#include <QStringList>
+
+#include "DirTreeWatcher.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "DotEntry.h"
+#include "DirReadJob.h"
+#include "ExcludeRules.h"
+#include "MountPoints.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+// fanotify with directory file handles and names needs Linux 5.9
+#if defined( __linux__ ) && defined( FAN_REPORT_DFID_NAME )
+#  define HAVE_FANOTIFY_DFID		1
+#else
+#  define HAVE_FANOTIFY_DFID		0
+#endif
+
+#define DEFAULT_UPDATE_INTERVAL		2000	// millisec
+
+// Buffer size for reading events: Each event is only a few dozen bytes
+#define EVENT_BUFFER_SIZE		( 64 * 1024 )
+
+// Upper limit for the cache of paths of fanotify file handles
+#define MAX_CACHED_HANDLES		10000
+
+#ifdef __linux__
+#  define INOTIFY_MASK	( IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | \
+			  IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK )
+#endif
+
+#if HAVE_FANOTIFY_DFID
+#  define FANOTIFY_MASK	( FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_MODIFY | \
+			  FAN_ONDIR )
+#endif
+
+
+using namespace QDirStat;
+
+
+/**
+ * Add the children of 'parent' that are not pseudo directories to
+ * 'children'.
+ **/
+static void addChildren( DirInfo * parent, QHash<QString, FileInfo *> & children )
+{
+    if ( ! parent )
+	return;
+
+    for ( FileInfo * child = parent->firstChild(); child; child = child->next() )
+    {
+	if ( ! child->isPseudoDir() )
+	    children.insert( child->name(), child );
+    }
+}
+
+
+/**
+ * Return 'true' if 'item' still matches 'statInfo' from a new lstat().
+ **/
+static bool isUnchanged( FileInfo * item, const struct stat & statInfo )
+{
+    if ( ( item->mode() & S_IFMT ) != ( statInfo.st_mode & S_IFMT ) )
+	return false;
+
+    // A subdirectory gets its own events for its content
+
+    if ( item->isDirInfo() || item->isSpecial() )
+	return true;
+
+    return item->rawByteSize() == (FileSize) statInfo.st_size &&
+	   item->mtime()       == statInfo.st_mtime;
+}
+
+
+
+
+DirTreeWatcher::DirTreeWatcher( DirTree * tree ):
+    QObject(),
+    _tree( tree ),
+    _fd( -1 ),
+    _fanotify( false ),
+    _notifier( 0 ),
+    _overflow( false ),
+    _watchLimitReached( false )
+{
+    CHECK_PTR( _tree );
+
+    _updateTimer.setSingleShot( true );
+    _updateTimer.setInterval( DEFAULT_UPDATE_INTERVAL );
+
+    connect( &_updateTimer, SIGNAL( timeout()	   ),
+	     this,	    SLOT  ( applyUpdates() ) );
+
+    connect( _tree, SIGNAL( finished()	      ),
+	     this,  SLOT  ( readingFinished() ) );
+
+    connect( _tree, SIGNAL( readJobFinished( DirInfo * ) ),
+	     this,  SLOT  ( readJobFinished( DirInfo * ) ) );
+
+    connect( _tree, SIGNAL( clearing() ),
+	     this,  SLOT  ( stop()     ) );
+}
+
+
+DirTreeWatcher::~DirTreeWatcher()
+{
+    stop();
+}
+
+
+bool DirTreeWatcher::start()
+{
+    if ( isWatching() )
+    {
+	FileInfo * toplevel = _tree->firstToplevel();
+
+	if ( ! _fanotify && toplevel && toplevel->isDirInfo() && toplevel->url() == _toplevel )
+	    addInotifyWatches( toplevel->toDirInfo(), _toplevel );
+
+	return true;
+    }
+
+    FileInfo * toplevel = _tree->firstToplevel();
+
+    if ( ! toplevel || ! toplevel->isDirInfo() || _tree->isBusy() )
+	return false;
+
+    _toplevel = toplevel->url();
+
+    if ( ! _toplevel.startsWith( "/" ) )	// not a local directory, e.g. packages
+    {
+	_toplevel.clear();
+	return false;
+    }
+
+    if ( ! startFanotify() && ! startInotify() )
+    {
+	logWarning() << "Can't watch " << _toplevel << " for changes" << endl;
+	stop();
+
+	return false;
+    }
+
+    _notifier = new QSocketNotifier( _fd, QSocketNotifier::Read, this );
+    CHECK_NEW( _notifier );
+
+    connect( _notifier, SIGNAL( activated ( int ) ),
+	     this,	SLOT  ( readEvents()	) );
+
+    logInfo() << "Watching " << _toplevel << " for changes with "
+	      << ( _fanotify ? "fanotify" : "inotify" )
+	      << " every " << updateInterval() << " millisec" << endl;
+
+    return true;
+}
+
+
+void DirTreeWatcher::stop()
+{
+    _updateTimer.stop();
+
+    if ( _notifier )
+    {
+	delete _notifier;
+	_notifier = 0;
+    }
+
+    if ( _fd >= 0 )
+    {
+	::close( _fd );
+	_fd = -1;
+    }
+
+    foreach ( int mountFd, _mountFds )
+	::close( mountFd );
+
+    _mountFds.clear();
+    _fsids.clear();
+    _handlePaths.clear();
+    _watchPaths.clear();
+    _watchedPaths.clear();
+    _changedDirs.clear();
+    _toplevel.clear();
+    _fanotify	       = false;
+    _overflow	       = false;
+    _watchLimitReached = false;
+}
+
+
+bool DirTreeWatcher::startFanotify()
+{
+#if HAVE_FANOTIFY_DFID
+
+    // This needs CAP_SYS_ADMIN; an ordinary user gets EPERM.
+
+    _fd = fanotify_init( FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_CLOEXEC | FAN_NONBLOCK,
+			 O_RDONLY | O_CLOEXEC );
+
+    if ( _fd < 0 )
+    {
+	logDebug() << "fanotify_init() failed: " << strerror( errno ) << endl;
+	return false;
+    }
+
+    _fanotify = true;
+
+    if ( ! addFanotifyMark( _toplevel ) )
+    {
+	::close( _fd );
+	_fd	  = -1;
+	_fanotify = false;
+
+	return false;
+    }
+
+    // Mounted filesystems that were read along with the tree
+
+    foreach ( MountPoint * mountPoint, MountPoints::normalMountPoints() )
+    {
+	QString path = mountPoint->path();
+
+	if ( path != _toplevel && isInTree( path ) )
+	{
+	    FileInfo * item = _tree->locate( path );
+
+	    if ( item && item->isDirInfo() && IncrementalDirReadJob::canRefresh( item->toDirInfo() ) )
+		addFanotifyMark( path );
+	}
+    }
+
+    return true;
+
+#else
+    return false;
+#endif
+}
+
+
+bool DirTreeWatcher::addFanotifyMark( const QString & path )
+{
+#if HAVE_FANOTIFY_DFID
+
+    QByteArray encodedPath = path.toUtf8();
+    int mountFd = ::open( encodedPath.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+    if ( mountFd < 0 )
+	return false;
+
+    struct statfs fsInfo;
+
+    if ( fstatfs( mountFd, &fsInfo ) != 0 )
+    {
+	::close( mountFd );
+	return false;
+    }
+
+    QByteArray fsid( (const char *) &fsInfo.f_fsid, sizeof( fsInfo.f_fsid ) );
+
+    if ( _fsids.contains( fsid ) )	// same filesystem as another mark
+    {
+	::close( mountFd );
+	return true;
+    }
+
+    // The events only contain file handles of the directories. Turning
+    // them into paths needs CAP_DAC_READ_SEARCH, so check that right now.
+
+    char buffer[ sizeof( struct file_handle ) + MAX_HANDLE_SZ ] __attribute__ (( aligned( 8 ) ));
+    struct file_handle * handle = (struct file_handle *) buffer;
+    int mountId;
+    handle->handle_bytes = MAX_HANDLE_SZ;
+
+    int fd = -1;
+
+    if ( name_to_handle_at( mountFd, "", handle, &mountId, AT_EMPTY_PATH ) == 0 )
+	fd = open_by_handle_at( mountFd, handle, O_PATH | O_CLOEXEC );
+
+    if ( fd < 0 )
+    {
+	logDebug() << "Can't use file handles on " << path << ": " << strerror( errno ) << endl;
+	::close( mountFd );
+
+	return false;
+    }
+
+    ::close( fd );
+
+    if ( fanotify_mark( _fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FANOTIFY_MASK,
+			AT_FDCWD, encodedPath.constData() ) != 0 )
+    {
+	logDebug() << "fanotify_mark() failed for " << path << ": " << strerror( errno ) << endl;
+	::close( mountFd );
+
+	return false;
+    }
+
+    _fsids    << fsid;
+    _mountFds << mountFd;
+
+    return true;
+
+#else
+    Q_UNUSED( path );
+    return false;
+#endif
+}
+
+
+bool DirTreeWatcher::startInotify()
+{
+#ifdef __linux__
+
+    _fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+
+    if ( _fd < 0 )
+    {
+	logWarning() << "inotify_init1() failed: " << strerror( errno ) << endl;
+	return false;
+    }
+
+    _fanotify = false;
+    addInotifyWatches( _tree->firstToplevel()->toDirInfo(), _toplevel );
+
+    if ( _watchPaths.isEmpty() )
+    {
+	::close( _fd );
+	_fd = -1;
+
+	return false;
+    }
+
+    return true;
+
+#else
+    return false;
+#endif
+}
+
+
+void DirTreeWatcher::addInotifyWatches( DirInfo * dir, const QString & path )
+{
+    if ( _watchLimitReached )
+	return;
+
+    if ( ! _watchedPaths.contains( path ) && ! addInotifyWatch( path ) )
+	return;
+
+    QString prefix = path == "/" ? path : path + "/";
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() && IncrementalDirReadJob::canRefresh( child->toDirInfo() ) )
+	    addInotifyWatches( child->toDirInfo(), prefix + child->name() );
+    }
+}
+
+
+bool DirTreeWatcher::addInotifyWatch( const QString & path )
+{
+#ifdef __linux__
+
+    int wd = inotify_add_watch( _fd, path.toUtf8().constData(), INOTIFY_MASK );
+
+    if ( wd < 0 )
+    {
+	if ( errno == ENOSPC )
+	{
+	    _watchLimitReached = true;
+
+	    logWarning() << "inotify watch limit reached after " << _watchPaths.size()
+			 << " directories; only part of " << _toplevel
+			 << " is watched (see fs.inotify.max_user_watches)" << endl;
+	}
+
+	return false;
+    }
+
+    // Watching the same directory again returns the same watch descriptor,
+    // e.g. if it was renamed.
+
+    _watchedPaths.remove( _watchPaths.value( wd ) );
+    _watchPaths.insert( wd, path );
+    _watchedPaths.insert( path );
+
+    return true;
+
+#else
+    Q_UNUSED( path );
+    return false;
+#endif
+}
+
+
+void DirTreeWatcher::readEvents()
+{
+    char buffer[ EVENT_BUFFER_SIZE ] __attribute__ (( aligned( 8 ) ));
+
+    while ( _fd >= 0 )
+    {
+	ssize_t len = ::read( _fd, buffer, sizeof( buffer ) );
+
+	if ( len <= 0 )		// EAGAIN: no more events
+	    break;
+
+	if ( _fanotify )
+	    processFanotifyEvents( buffer, len );
+	else
+	    processInotifyEvents( buffer, len );
+    }
+
+    // Collect more changes until the timer expires, so there is at most
+    // one update per interval
+
+    if ( ( _overflow || ! _changedDirs.isEmpty() ) && ! _updateTimer.isActive() )
+	_updateTimer.start();
+}
+
+
+void DirTreeWatcher::processFanotifyEvents( char * buffer, int len )
+{
+#if HAVE_FANOTIFY_DFID
+
+    struct fanotify_event_metadata * event = (struct fanotify_event_metadata *) buffer;
+
+    for ( ; FAN_EVENT_OK( event, len ); event = FAN_EVENT_NEXT( event, len ) )
+    {
+	if ( event->vers != FANOTIFY_METADATA_VERSION )
+	{
+	    logError() << "Unexpected fanotify metadata version " << event->vers << endl;
+	    stop();
+
+	    return;
+	}
+
+	if ( event->mask & FAN_Q_OVERFLOW )
+	{
+	    _overflow = true;
+	    continue;
+	}
+
+	if ( event->event_len < sizeof( *event ) + sizeof( struct fanotify_event_info_fid ) )
+	    continue;
+
+	struct fanotify_event_info_fid * info = (struct fanotify_event_info_fid *) ( event + 1 );
+
+	if ( info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME &&
+	     info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID )
+	{
+	    continue;
+	}
+
+	QByteArray fsid( (const char *) &info->fsid, sizeof( info->fsid ) );
+	QString	   path = handlePath( fsid, info->handle );
+
+	if ( isInTree( path ) )
+	    dirChanged( path );
+    }
+
+#else
+    Q_UNUSED( buffer );
+    Q_UNUSED( len );
+#endif
+}
+
+
+void DirTreeWatcher::processInotifyEvents( char * buffer, int len )
+{
+#ifdef __linux__
+
+    char * pos = buffer;
+    char * end = buffer + len;
+
+    while ( pos < end )
+    {
+	struct inotify_event * event = (struct inotify_event *) pos;
+	pos += sizeof( struct inotify_event ) + event->len;
+
+	if ( event->mask & IN_Q_OVERFLOW )
+	{
+	    _overflow = true;
+	}
+	else if ( event->mask & IN_IGNORED )	// directory deleted or unmounted
+	{
+	    _watchedPaths.remove( _watchPaths.take( event->wd ) );
+	}
+	else
+	{
+	    QString path = _watchPaths.value( event->wd );
+
+	    if ( ! path.isEmpty() )
+		dirChanged( path );
+	}
+    }
+
+#else
+    Q_UNUSED( buffer );
+    Q_UNUSED( len );
+#endif
+}
+
+
+QString DirTreeWatcher::handlePath( const QByteArray & fsid, const void * handle )
+{
+    QString path;
+
+#if HAVE_FANOTIFY_DFID
+
+    struct file_handle * fileHandle = (struct file_handle *) handle;
+    QByteArray key = fsid + QByteArray( (const char *) handle,
+					sizeof( struct file_handle ) + fileHandle->handle_bytes );
+
+    QHash<QByteArray, QString>::const_iterator it = _handlePaths.constFind( key );
+
+    if ( it != _handlePaths.constEnd() )
+	return it.value();
+
+    int index = _fsids.indexOf( fsid );
+
+    if ( index < 0 )	// another filesystem
+	return path;
+
+    // O_PATH does not even open the directory, it only resolves the handle
+
+    int fd = open_by_handle_at( _mountFds.at( index ), fileHandle, O_PATH | O_CLOEXEC );
+
+    if ( fd >= 0 )
+    {
+	char link[ 64 ];
+	char target[ PATH_MAX ];
+
+	snprintf( link, sizeof( link ), "/proc/self/fd/%d", fd );
+	ssize_t len = readlink( link, target, sizeof( target ) );
+
+	if ( len > 0 && len < (ssize_t) sizeof( target ) )
+	    path = QString::fromUtf8( target, len );
+
+	::close( fd );
+    }
+
+    if ( _handlePaths.size() >= MAX_CACHED_HANDLES )
+	_handlePaths.clear();
+
+    _handlePaths.insert( key, path );
+
+#else
+    Q_UNUSED( fsid );
+    Q_UNUSED( handle );
+#endif
+
+    return path;
+}
+
+
+bool DirTreeWatcher::isInTree( const QString & path ) const
+{
+    if ( path.isEmpty() || _toplevel.isEmpty() )
+	return false;
+
+    if ( _toplevel == "/" || path == _toplevel )
+	return path.startsWith( _toplevel );
+
+    return path.startsWith( _toplevel + "/" );
+}
+
+
+void DirTreeWatcher::dirChanged( const QString & path )
+{
+    _changedDirs.insert( path );
+}
+
+
+void DirTreeWatcher::readingFinished()
+{
+    start();
+}
+
+
+void DirTreeWatcher::readJobFinished( DirInfo * dir )
+{
+    // Watch directories that were read after watching started, e.g. new
+    // subdirectories or a refreshed subtree
+
+    if ( ! isWatching() || _fanotify || ! dir || ! IncrementalDirReadJob::canRefresh( dir ) )
+	return;
+
+    QString path = dir->url();
+
+    if ( isInTree( path ) )
+	addInotifyWatches( dir, path );
+}
+
+
+void DirTreeWatcher::applyUpdates()
+{
+    if ( ! isWatching() )
+	return;
+
+    if ( _tree->isBusy() || _tree->isWriting() )
+    {
+	// Try again later: Read jobs or the cache writer thread might still
+	// use the directories
+
+	_updateTimer.start();
+	return;
+    }
+
+    // A directory that was renamed still has the same file handle
+
+    _handlePaths.clear();
+
+    if ( _overflow )
+    {
+	logWarning() << "Lost filesystem events - refreshing " << _toplevel << endl;
+
+	_overflow = false;
+	_changedDirs.clear();
+
+	FileInfo * toplevel = _tree->firstToplevel();
+
+	if ( toplevel && toplevel->isDirInfo() )
+	    _tree->refresh( toplevel->toDirInfo() );
+
+	return;
+    }
+
+    // Parents before their subdirectories: Updating a parent might delete
+    // a subdirectory.
+
+    QStringList paths = _changedDirs.toList();
+    _changedDirs.clear();
+    std::sort( paths.begin(), paths.end() );
+
+    logDebug() << "Updating " << paths.size() << " changed directories" << endl;
+
+    QList<DirInfo *> newDirs;
+    _tree->sendStartingUpdate();
+
+    foreach ( const QString & path, paths )
+    {
+	FileInfo * item = _tree->locate( path );
+
+	if ( item && item->isDirInfo() && IncrementalDirReadJob::canRefresh( item->toDirInfo() ) )
+	    updateDir( item->toDirInfo(), newDirs );
+    }
+
+    _tree->sendUpdateFinished();
+
+    foreach ( DirInfo * dir, newDirs )
+	_tree->refresh( dir );
+}
+
+
+void DirTreeWatcher::updateDir( DirInfo * dir, QList<DirInfo *> & newDirs )
+{
+    QString	      dirPath = dir->url();
+    LocalDirEntryList entries;
+
+    if ( LocalDirReadJob::readEntries( dirPath, entries ) != DirFinished )
+	return;	  // The parent will get an event if it was deleted
+
+    // Compare with the real files, not with an empty spilled or frozen
+    // directory
+
+    _tree->loadSpilledFiles( dir );
+
+    if ( dir->dotEntry() )
+	_tree->loadSpilledFiles( dir->dotEntry() );
+
+    struct stat statInfo;
+
+    if ( lstat( dirPath.toUtf8().constData(), &statInfo ) == 0 )
+	dir->updateStat( &statInfo );
+
+    dir->markSummaryDirty();
+
+    // Not finished while it is updated, so deleting the last child of the
+    // dot entry does not delete the dot entry (and its attic) right away
+
+    DirReadState readState = dir->readState();
+    dir->setReadState( DirReading );
+
+    // New files go to the dot entry even if there were no subdirectories
+    // before; finalizeLocal() moves them back if there still are none.
+
+    bool	 newDotEntry = ! dir->dotEntry();
+    DotEntry * dotEntry	 = dir->ensureDotEntry();
+    FileInfo * child	 = dir->firstChild();
+
+    if ( newDotEntry )
+	_tree->childAddedNotify( dotEntry );
+
+    while ( child )
+    {
+	FileInfo * next = child->next();
+
+	if ( ! child->isDirInfo() )
+	{
+	    dir->unlinkChild( child );
+	    dotEntry->insertChild( child );
+	}
+
+	child = next;
+    }
+
+    QHash<QString, FileInfo *> oldChildren;
+
+    addChildren( dir,		     oldChildren );
+    addChildren( dir->attic(),	     oldChildren );
+    addChildren( dotEntry,	     oldChildren );
+    addChildren( dotEntry->attic(), oldChildren );
+
+    foreach ( const LocalDirEntry & entry, entries )
+    {
+	FileInfo * oldChild = oldChildren.take( entry.name );
+
+	if ( oldChild )
+	{
+	    if ( entry.statErrno == 0 && isUnchanged( oldChild, entry.statInfo ) )
+		continue;
+
+	    deleteChild( oldChild );
+	}
+
+	addChild( dir, dirPath, entry, newDirs );
+    }
+
+    foreach ( FileInfo * oldChild, oldChildren )	// vanished
+	deleteChild( oldChild );
+
+    // finalizeLocal() deletes an empty dot entry or attic and the dot entry
+    // if there are no more subdirectories; the views still know them.
+
+    dotEntry = dir->dotEntry();
+
+    if ( dotEntry &&
+	 ( ( ! dir->firstChild() && ! dir->hasAtticChildren() ) ||
+	   ( ! dotEntry->firstChild() && ! dotEntry->hasAtticChildren() ) ) )
+    {
+	_tree->deletingChildNotify( dotEntry );
+    }
+
+    if ( dir->attic() && ! dir->attic()->firstChild() && ! dir->attic()->dotEntry() )
+	_tree->deletingChildNotify( dir->attic() );
+
+    dir->finalizeLocal();
+    dir->setReadState( readState );
+    _tree->markCacheDirty( dir );
+}
+
+
+void DirTreeWatcher::deleteChild( FileInfo * child )
+{
+    _tree->forgetCachePlaceholders( child );
+    _tree->deleteSubtree( child );
+}
+
+
+void DirTreeWatcher::addChild( DirInfo		   * dir,
+			       const QString	   & dirPath,
+			       const LocalDirEntry & entry,
+			       QList<DirInfo *>	   & newDirs )
+{
+    if ( entry.statErrno != 0 )		// vanished again or no permission
+	return;
+
+    struct stat statInfo = entry.statInfo;
+    QString	path	 = ( dirPath == "/" ? dirPath : dirPath + "/" ) + entry.name;
+
+    if ( S_ISDIR( statInfo.st_mode ) )
+    {
+	DirInfo * subDir = new DirInfo( entry.name, &statInfo, _tree, dir );
+	CHECK_NEW( subDir );
+
+	dir->insertChild( subDir );
+	_tree->childAddedNotify( subDir );
+
+	bool excluded = ExcludeRules::instance()->match( path, entry.name ) ||
+	    ( _tree->excludeRules() && _tree->excludeRules()->match( path, entry.name ) );
+
+	// A directory from a cache file has no device number
+
+	bool mountPoint = dir->device() != 0 && subDir->device() != dir->device();
+
+	if ( excluded || mountPoint )
+	{
+	    if ( excluded )
+		subDir->setExcluded();
+	    else
+		subDir->setMountPoint();
+
+	    subDir->setReadState( DirOnRequestOnly );
+	    subDir->finalizeLocal();
+	}
+	else
+	{
+	    newDirs << subDir;	// read later with the normal read jobs
+	}
+    }
+    else
+    {
+	FileInfo * child = new FileInfo( entry.name, &statInfo, _tree, dir );
+	CHECK_NEW( child );
+
+	if ( _tree->hasFilters() && _tree->checkIgnoreFilters( path ) )
+	    dir->addToAttic( child );
+	else
+	    dir->insertChild( child );
+
+	_tree->childAddedNotify( child );
+    }
+}
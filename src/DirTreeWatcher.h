@@ -0,0 +1,243 @@
+/*
+ *   File name: DirTreeWatcher.h
+ *   Summary:	Live updates of a DirTree from filesystem change events
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DirTreeWatcher_h
+#define DirTreeWatcher_h
+
+
+#include <QObject>
+#include <QTimer>
+#include <QString>
+#include <QSet>
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+
+
+class QSocketNotifier;
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class DirInfo;
+    class FileInfo;
+    struct LocalDirEntry;
+
+
+    /**
+     * Watcher that keeps a DirTree up to date after it was read: It
+     * subscribes to the change events of the filesystem for the tree and
+     * applies them to the tree.
+     *
+     * If the process has the privileges for it (CAP_SYS_ADMIN), this uses
+     * one fanotify filesystem mark for each filesystem of the tree with
+     * FAN_REPORT_DFID_NAME, so the kernel reports the directory of each
+     * change. Otherwise it uses inotify with one watch for each directory;
+     * if the inotify watch limit (fs.inotify.max_user_watches) is reached,
+     * only part of the tree is watched.
+     *
+     * Events are only collected as the paths of the changed directories.
+     * They are applied at most once every updateInterval() milliseconds,
+     * and only when the tree is not busy reading: Each changed directory is
+     * read again (without its subdirectories), and its children are
+     * compared with the new directory entries. New items are added with
+     * DirTree::childAddedNotify(), vanished or changed items are deleted
+     * with DirTree::deleteSubtree(), and new subdirectories are read with
+     * DirTree::refresh(). All this happens between the DirTree's
+     * startingUpdate() and updateFinished() signals.
+     *
+     * If the kernel dropped events because there were too many, the
+     * complete tree is refreshed.
+     **/
+    class DirTreeWatcher: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor. This does not start watching yet.
+	 **/
+	DirTreeWatcher( DirTree * tree );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~DirTreeWatcher();
+
+	/**
+	 * Return the minimum time in milliseconds between two updates of
+	 * the tree.
+	 **/
+	int updateInterval() const { return _updateTimer.interval(); }
+
+	/**
+	 * Set the minimum time in milliseconds between two updates of the
+	 * tree.
+	 **/
+	void setUpdateInterval( int millisec ) { _updateTimer.setInterval( millisec ); }
+
+	/**
+	 * Return 'true' if the tree is being watched.
+	 **/
+	bool isWatching() const { return _fd >= 0; }
+
+	/**
+	 * Return 'true' if fanotify is used, 'false' if inotify is used.
+	 **/
+	bool usingFanotify() const { return _fanotify; }
+
+
+    public slots:
+
+	/**
+	 * Start watching the first toplevel of the tree. If it is already
+	 * being watched, only add inotify watches for directories that are
+	 * not watched yet.
+	 *
+	 * Return 'true' if successful.
+	 **/
+	bool start();
+
+	/**
+	 * Stop watching and forget all pending changes.
+	 **/
+	void stop();
+
+
+    protected slots:
+
+	/**
+	 * Read the pending events from the fanotify or inotify file
+	 * descriptor.
+	 **/
+	void readEvents();
+
+	/**
+	 * Apply the collected changes to the tree.
+	 **/
+	void applyUpdates();
+
+	/**
+	 * Notification that the tree finished reading.
+	 **/
+	void readingFinished();
+
+	/**
+	 * Notification that a directory was read.
+	 **/
+	void readJobFinished( DirInfo * dir );
+
+
+    protected:
+
+	/**
+	 * Try to watch the tree with fanotify. Return 'true' if successful.
+	 **/
+	bool startFanotify();
+
+	/**
+	 * Watch the tree with inotify. Return 'true' if successful.
+	 **/
+	bool startInotify();
+
+	/**
+	 * Add a fanotify filesystem mark for the filesystem of 'path'.
+	 * Return 'true' if successful.
+	 **/
+	bool addFanotifyMark( const QString & path );
+
+	/**
+	 * Recursively add inotify watches for 'dir' with path 'path' and
+	 * all its subdirectories that are not watched yet.
+	 **/
+	void addInotifyWatches( DirInfo * dir, const QString & path );
+
+	/**
+	 * Add an inotify watch for directory 'path'.
+	 * Return 'false' if the watch limit is reached.
+	 **/
+	bool addInotifyWatch( const QString & path );
+
+	/**
+	 * Process the events in 'buffer' with length 'len'.
+	 **/
+	void processFanotifyEvents( char * buffer, int len );
+	void processInotifyEvents ( char * buffer, int len );
+
+	/**
+	 * Return the path of the directory with the fanotify file handle
+	 * 'handle' on the filesystem 'fsid' (both from an event) or an empty
+	 * string if it can't be found.
+	 **/
+	QString handlePath( const QByteArray & fsid, const void * handle );
+
+	/**
+	 * Notification that the content of directory 'path' changed.
+	 **/
+	void dirChanged( const QString & path );
+
+	/**
+	 * Compare the children of 'dir' with the directory entries on disk
+	 * and update them. New subdirectories that still need to be read
+	 * are added to 'newDirs'.
+	 **/
+	void updateDir( DirInfo * dir, QList<DirInfo *> & newDirs );
+
+	/**
+	 * Create a new child of 'dir' from 'entry'.
+	 **/
+	void addChild( DirInfo		   * dir,
+		       const QString	   & dirPath,
+		       const LocalDirEntry & entry,
+		       QList<DirInfo *>	   & newDirs );
+
+	/**
+	 * Delete 'child' with its subtree.
+	 **/
+	void deleteChild( FileInfo * child );
+
+	/**
+	 * Return 'true' if 'path' is in the watched tree.
+	 **/
+	bool isInTree( const QString & path ) const;
+
+
+	//
+	// Data members
+	//
+
+	DirTree *		_tree;
+	int			_fd;		// fanotify or inotify fd, -1 if not watching
+	bool			_fanotify;
+	QSocketNotifier *	_notifier;
+	QTimer			_updateTimer;
+	QString			_toplevel;
+	QSet<QString>		_changedDirs;
+	bool			_overflow;
+	bool			_watchLimitReached;
+
+	// inotify
+
+	QHash<int, QString>	_watchPaths;	// by watch descriptor
+	QSet<QString>		_watchedPaths;
+
+	// fanotify
+
+	QList<QByteArray>	_fsids;		// of the marked filesystems
+	QList<int>		_mountFds;	// one for each fsid
+	QHash<QByteArray, QString> _handlePaths;
+
+    };	// class DirTreeWatcher
+
+}	// namespace QDirStat
+
+
+#endif // ifndef DirTreeWatcher_h
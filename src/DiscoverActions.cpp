@@ -7,9 +7,14 @@
  */
 
 
+#include <QInputDialog>
+#include <QMessageBox>
+
 #include "DiscoverActions.h"
 #include "TreeWalker.h"
+#include "FilePredicate.h"
 #include "LocateFilesWindow.h"
+#include "DuplicateFilesWindow.h"
 #include "BusyPopup.h"
 #include "QDirStatApp.h"
 #include "Logger.h"
@@ -82,6 +87,63 @@ void DiscoverActions::discoverSparseFiles()
 }
 
 
+void DiscoverActions::discoverDuplicateFiles()
+{
+    // This does not use a LocateFilesWindow: The duplicates are found in
+    // other threads, and they are grouped.
+
+    if ( ! _duplicateFilesWindow )
+    {
+	// This deletes itself when the user closes it. The associated QPointer
+	// keeps track of that and sets the pointer to 0 when it happens.
+
+	_duplicateFilesWindow = new DuplicateFilesWindow( app()->findMainWindow() ); // parent
+    }
+
+    FileInfo * sel = app()->selectedDirOrRoot();
+
+    if ( sel )
+    {
+        _duplicateFilesWindow->populate( sel );
+        _duplicateFilesWindow->show();
+    }
+}
+
+
+void DiscoverActions::discoverMatchingFiles()
+{
+    QWidget *	  parent     = app()->findMainWindow();
+    QString	  expression = _lastExpression;
+    FilePredicate predicate;
+
+    while ( true )
+    {
+	bool ok = false;
+	expression = QInputDialog::getText( parent,
+					    tr( "Find Files" ),
+					    tr( "Conditions, e.g. size > 1G and mtime < 2020 and category = Videos:" ),
+					    QLineEdit::Normal,
+					    expression,
+					    &ok );
+
+	if ( ! ok || expression.trimmed().isEmpty() )
+	    return;
+
+	if ( predicate.compile( expression ) )
+	    break;
+
+	QMessageBox::warning( parent, tr( "Error" ), predicate.errorString() );
+    }
+
+    _lastExpression = predicate.expression();
+
+    QString headingText = tr( "Files Matching \"%1\" in %2" ).arg( predicate.expression() ).arg( "%1" );
+
+    discoverFiles( new QDirStat::PredicateTreeWalker( predicate ), headingText );
+    _locateFilesWindow->sortByColumn( LocateListSizeCol, Qt::DescendingOrder );
+}
+
+
 void DiscoverActions::discoverFilesFromYear( const QString & path, short year )
 {
     QString headingText = tr( "Files from %1 in %2" ).arg( year ).arg( "%1");
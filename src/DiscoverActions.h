@@ -19,6 +19,7 @@ namespace QDirStat
 {
     class TreeWalker;
     class LocateFilesWindow;
+    class DuplicateFilesWindow;
 
     /**
      * Class to keep QDirStat's "discover" actions self-contained.
@@ -59,6 +60,13 @@ namespace QDirStat
         void discoverHardLinkedFiles();
         void discoverBrokenSymLinks();
         void discoverSparseFiles();
+        void discoverDuplicateFiles();
+
+        /**
+         * Ask the user for a FilePredicate expression like
+         * "size > 1G and mtime < 2020" and find the files that match it.
+         **/
+        void discoverMatchingFiles();
 
 
         //
@@ -87,7 +95,9 @@ namespace QDirStat
 
     protected:
 
-        QPointer<LocateFilesWindow> _locateFilesWindow;
+        QPointer<LocateFilesWindow>    _locateFilesWindow;
+        QPointer<DuplicateFilesWindow> _duplicateFilesWindow;
+        QString                        _lastExpression;
 
     };  // class DiscoverActions
 
@@ -20,16 +20,17 @@ DotEntry::DotEntry( DirTree * tree,
 		    DirInfo * parent )
     : DirInfo( tree, parent )
 {
+    _nodeKind	= DotEntryNode;
     _name	= dotEntryName();
     _dotEntry	= 0;
     _mtime	= 0;
 
     if ( parent )
     {
-	_device = parent->device();
-	_mode	= parent->mode();
-	_uid	= parent->uid();
-	_gid	= parent->gid();
+	_mode = parent->mode();
+	setDevice( parent->device() );
+	setUid	 ( parent->uid()    );
+	setGid	 ( parent->gid()    );
     }
 }
 
@@ -56,6 +57,7 @@ void DotEntry::insertChild( FileInfo * newChild )
     newChild->setNext( _firstChild );
     _firstChild = newChild;
     newChild->setParent( this );	// make sure the parent pointer is correct
+    dropChildVector();
 
     childAdded( newChild );		// update summaries
 }
@@ -0,0 +1,262 @@
+/*
+ *   File name: DpkgDatabase.cpp
+ *   Summary:	Direct access to the dpkg database for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <string.h>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+
+#include "DpkgDatabase.h"
+#include "PkgFileListCache.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+#define DPKG_DIR		"/var/lib/dpkg"
+#define DPKG_STATUS_FILE	DPKG_DIR "/status"
+#define DPKG_INFO_DIR		DPKG_DIR "/info"
+
+// Maximum number of threads for reading the list files
+#define MaxFileListThreads	8
+
+
+using namespace QDirStat;
+
+
+/**
+ * If the status file line 'line' with 'len' bytes is field 'field' (which
+ * includes the ':'), store its value in 'value_ret' and return 'true'.
+ **/
+static bool statusField( const char * line,
+			 int	      len,
+			 const char * field,
+			 QString    & value_ret )
+{
+    int fieldLen = strlen( field );
+
+    if ( len < fieldLen || strncmp( line, field, fieldLen ) != 0 )
+	return false;
+
+    value_ret = QString::fromUtf8( line + fieldLen, len - fieldLen ).trimmed();
+
+    return true;
+}
+
+
+bool DpkgDatabase::isAvailable()
+{
+    return QFileInfo( DPKG_STATUS_FILE ).isReadable();
+}
+
+
+bool DpkgDatabase::readStatus( QList<DpkgStatusEntry> & entries_ret )
+{
+    entries_ret.clear();
+    QFile file( DPKG_STATUS_FILE );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+    {
+	logWarning() << "Can't open " << DPKG_STATUS_FILE << endl;
+	return false;
+    }
+
+    qint64 size = file.size();
+    const char * data = size > 0 ? (const char *) file.map( 0, size ) : 0;
+
+    if ( ! data )
+    {
+	logWarning() << "Can't map " << DPKG_STATUS_FILE << endl;
+	return false;
+    }
+
+    // One paragraph for each package; continuation lines (e.g. of the
+    // description) start with whitespace and are skipped.
+
+    const char *    end  = data + size;
+    const char *    line = data;
+    DpkgStatusEntry entry;
+    QString	    status;
+
+    while ( line <= end )
+    {
+	const char * eol = line < end ? (const char *) memchr( line, '\n', end - line ) : 0;
+
+	if ( ! eol )
+	    eol = end;
+
+	int len = eol - line;
+
+	if ( len == 0 ) // End of paragraph
+	{
+	    if ( ! entry.name.isEmpty() && status == "install ok installed" )
+		entries_ret << entry;
+
+	    entry  = DpkgStatusEntry();
+	    status = QString();
+	}
+	else if ( *line != ' ' && *line != '\t' )
+	{
+	    statusField( line, len, "Package:",      entry.name    ) ||
+	    statusField( line, len, "Version:",      entry.version ) ||
+	    statusField( line, len, "Architecture:", entry.arch    ) ||
+	    statusField( line, len, "Status:",	     status	   );
+	}
+
+	line = eol + 1;
+    }
+
+    if ( entries_ret.isEmpty() )
+    {
+	logWarning() << "No installed packages in " << DPKG_STATUS_FILE << endl;
+	return false;
+    }
+
+    logDebug() << entries_ret.size() << " installed packages in " << DPKG_STATUS_FILE << endl;
+
+    return true;
+}
+
+
+QString DpkgDatabase::listFileName( const QString & listName )
+{
+    return QString( DPKG_INFO_DIR "/%1.list" ).arg( listName );
+}
+
+
+bool DpkgDatabase::readLines( const QString & fileName,
+			      QStringList   & lines_ret,
+			      bool	      isFileList )
+{
+    lines_ret.clear();
+    QFile file( fileName );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+	return false;
+
+    qint64 size = file.size();
+
+    if ( size == 0 )
+	return true;
+
+    const char * data = (const char *) file.map( 0, size );
+
+    if ( ! data )
+	return false;
+
+    const char * end  = data + size;
+    const char * line = data;
+
+    while ( line < end )
+    {
+	const char * eol = (const char *) memchr( line, '\n', end - line );
+
+	if ( ! eol )
+	    eol = end;
+
+	int len = eol - line;
+
+	if ( len > 0 && ! ( isFileList && len == 2 && line[0] == '/' && line[1] == '.' ) )
+	    lines_ret << QString::fromUtf8( line, len );
+
+	line = eol + 1;
+    }
+
+    return true;
+}
+
+
+bool DpkgDatabase::readFileList( const QString & listName,
+				 QStringList   & fileList_ret )
+{
+    return readLines( listFileName( listName ), fileList_ret, true );
+}
+
+
+bool DpkgDatabase::readAllFileLists( PkgFileListCache * cache )
+{
+    CHECK_PTR( cache );
+
+    QDir infoDir( DPKG_INFO_DIR );
+    QStringList listFiles = infoDir.entryList( QStringList() << "*.list", QDir::Files );
+
+    if ( listFiles.isEmpty() )
+    {
+	logWarning() << "No package file lists in " << DPKG_INFO_DIR << endl;
+	return false;
+    }
+
+    // Split the list files into one contiguous chunk for each thread
+
+    int threadCount = qBound( 1, QThread::idealThreadCount(), MaxFileListThreads );
+    int chunkSize   = ( listFiles.size() + threadCount - 1 ) / threadCount;
+    QList<DpkgFileListThread *> threads;
+
+    for ( int start = 0; start < listFiles.size(); start += chunkSize )
+    {
+	QStringList listNames;
+
+	foreach ( const QString & listFile, listFiles.mid( start, chunkSize ) )
+	    listNames << listFile.left( listFile.size() - 5 ); // without ".list"
+
+	DpkgFileListThread * thread = new DpkgFileListThread( listNames );
+	CHECK_NEW( thread );
+
+	threads << thread;
+	thread->start();
+    }
+
+    // Fill the cache in the calling thread; PkgFileListCache is not
+    // thread-safe.
+
+    bool ok = true;
+
+    foreach ( DpkgFileListThread * thread, threads )
+    {
+	thread->wait();
+
+	if ( ! thread->ok() )
+	    ok = false;
+
+	for ( int i = 0; ok && i < thread->listNames().size(); ++i )
+	{
+	    const QString & pkgName = thread->listNames().at( i );
+
+	    foreach ( const QString & path, thread->fileLists().at( i ) )
+		cache->add( pkgName, path );
+	}
+    }
+
+    qDeleteAll( threads );
+
+    if ( ! ok )
+    {
+	logWarning() << "Reading the package file lists in " << DPKG_INFO_DIR << " failed" << endl;
+	cache->clear();
+    }
+
+    return ok;
+}
+
+
+void DpkgFileListThread::run()
+{
+    foreach ( const QString & listName, _listNames )
+    {
+	QStringList fileList;
+
+	if ( ! DpkgDatabase::readFileList( listName, fileList ) )
+	{
+	    _ok = false;
+	    return;
+	}
+
+	_fileLists << fileList;
+    }
+}
@@ -0,0 +1,149 @@
+/*
+ *   File name: DpkgDatabase.h
+ *   Summary:	Direct access to the dpkg database for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DpkgDatabase_h
+#define DpkgDatabase_h
+
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QThread>
+
+
+namespace QDirStat
+{
+    class PkgFileListCache;
+
+
+    /**
+     * One installed package from the dpkg status file.
+     **/
+    struct DpkgStatusEntry
+    {
+	QString name;
+	QString version;
+	QString arch;
+    };
+
+
+    /**
+     * Reader for the dpkg database in /var/lib/dpkg without starting any
+     * dpkg or dpkg-query processes:
+     *
+     * The status file has one paragraph of "Field: value" lines for each
+     * package, separated by empty lines. The file list of each package is
+     * in info/<package>.list or, for "Multi-Arch: same" packages, in
+     * info/<package>:<arch>.list, one path per line.
+     *
+     * The files are memory-mapped, and the file lists for a file list cache
+     * are read in several threads in parallel.
+     *
+     * Every method returns 'false' if something unexpected happens; the
+     * DpkgPkgManager then falls back to the dpkg commands.
+     **/
+    class DpkgDatabase
+    {
+    public:
+
+	/**
+	 * Return 'true' if the dpkg status file is there and readable.
+	 **/
+	static bool isAvailable();
+
+	/**
+	 * Read all packages with status "install ok installed" from the
+	 * status file into 'entries_ret'.
+	 **/
+	static bool readStatus( QList<DpkgStatusEntry> & entries_ret );
+
+	/**
+	 * Read the file list of the package with 'listName' (the name of its
+	 * list file without ".list", i.e. the package name with or without
+	 * ":<arch>") into 'fileList_ret'.
+	 **/
+	static bool readFileList( const QString & listName,
+				  QStringList	& fileList_ret );
+
+	/**
+	 * Read the file lists of all packages into 'cache' with the names of
+	 * their list files as the package names, like "dpkg -S '*'" reports
+	 * them.
+	 **/
+	static bool readAllFileLists( PkgFileListCache * cache );
+
+
+    protected:
+
+	/**
+	 * Return the path of the list file for 'listName'.
+	 **/
+	static QString listFileName( const QString & listName );
+
+	/**
+	 * Read the lines of 'fileName' into 'lines_ret' by mapping it into
+	 * memory. Skip empty lines and the "/." that each list starts with
+	 * if 'isFileList' is 'true'.
+	 **/
+	static bool readLines( const QString & fileName,
+			       QStringList   & lines_ret,
+			       bool	       isFileList );
+
+    };	// class DpkgDatabase
+
+
+    /**
+     * Thread for reading some of the list files for
+     * DpkgDatabase::readAllFileLists().
+     **/
+    class DpkgFileListThread: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor for reading the list files for 'listNames'.
+	 **/
+	DpkgFileListThread( const QStringList & listNames ):
+	    QThread(),
+	    _listNames( listNames ),
+	    _ok( true )
+	    {}
+
+	/**
+	 * Return the names of the list files this thread reads.
+	 **/
+	const QStringList & listNames() const { return _listNames; }
+
+	/**
+	 * Return the file lists in the same order as listNames().
+	 * This is only valid when the thread is finished.
+	 **/
+	const QList<QStringList> & fileLists() const { return _fileLists; }
+
+	/**
+	 * Return 'false' if any list file could not be read.
+	 **/
+	bool ok() const { return _ok; }
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	QStringList	   _listNames;
+	QList<QStringList> _fileLists;
+	bool		   _ok;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef DpkgDatabase_h
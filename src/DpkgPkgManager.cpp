@@ -8,6 +8,7 @@
 
 
 #include "DpkgPkgManager.h"
+#include "DpkgDatabase.h"
 #include "PkgFileListCache.h"
 #include "Logger.h"
 #include "Exception.h"
@@ -24,6 +25,82 @@ using SysUtil::tryRunCommand;
 using SysUtil::haveCommand;
 
 
+namespace
+{
+    /**
+     * Parser for the output of "dpkg -S '*'" that adds each line to a file
+     * list cache while the command is still running.
+     *
+     * Sample output:
+     *
+     *	   zip: /usr/bin/zip
+     *	   zlib1g-dev:amd64: /usr/include/zlib.h
+     *	   zlib1g:i386, zlib1g:amd64: /usr/share/doc/zlib1g
+     **/
+    class DpkgSearchParser: public SysUtil::OutputLineHandler
+    {
+    public:
+
+	DpkgSearchParser( PkgFileListCache * cache ):
+	    _cache( cache ),
+	    _lineCount( 0 )
+	    {}
+
+	virtual void handleLine( const char * line, int len ) Q_DECL_OVERRIDE
+	{
+	    ++_lineCount;
+
+	    // Only a view of the line in the read buffer, not a copy
+	    QByteArray rawLine = QByteArray::fromRawData( line, len );
+
+	    if ( rawLine.isEmpty() || rawLine.startsWith( "diversion" ) )
+		return;
+
+	    int sep = rawLine.indexOf( ": " );
+
+	    if ( sep < 0 || rawLine.indexOf( ": ", sep + 2 ) >= 0 )
+	    {
+		logError() << "Unexpected file list line: \"" << QString::fromUtf8( line, len ) << "\"" << endl;
+		return;
+	    }
+
+	    // Consecutive lines often belong to the same packages: Reuse the
+	    // package names of the previous line.
+
+	    if ( sep != _lastPackages.size() || ! rawLine.startsWith( _lastPackages ) )
+	    {
+		_lastPackages = QByteArray( line, sep );
+		_pkgNames     = QString::fromUtf8( _lastPackages ).split( ", ", QString::SkipEmptyParts );
+	    }
+
+	    QString path = QString::fromUtf8( line + sep + 2, len - sep - 2 );
+
+	    if ( path != "/." && ! path.isEmpty() )
+	    {
+		foreach ( const QString & pkgName, _pkgNames )
+		    _cache->add( pkgName, path );
+	    }
+	}
+
+	int lineCount() const { return _lineCount; }
+
+    protected:
+
+	PkgFileListCache * _cache;
+	int		   _lineCount;
+	QByteArray	   _lastPackages;
+	QStringList	   _pkgNames;
+    };
+
+}	// namespace
+
+
+DpkgPkgManager::DpkgPkgManager():
+    _haveDatabase( DpkgDatabase::isAvailable() )
+{
+}
+
+
 bool DpkgPkgManager::isPrimaryPkgManager()
 {
     return tryRunCommand( "/usr/bin/dpkg -S /usr/bin/dpkg", QRegExp( "^dpkg:.*" ) );
@@ -87,8 +164,62 @@ QString DpkgPkgManager::owningPkg( const QString & path )
 }
 
 
+QMap<QString, QString> DpkgPkgManager::owningPkgs( const QStringList & paths )
+{
+    QMap<QString, QString> pkgs;
+
+    if ( paths.isEmpty() )
+	return pkgs;
+
+    // The exit code is 1 if any of the paths is not owned by any package
+
+    int exitCode = -1;
+    QString output = runCommand( "/usr/bin/dpkg", QStringList() << "-S" << paths, &exitCode,
+				 COMMAND_TIMEOUT_SEC, LOG_COMMANDS, LOG_OUTPUT,
+				 true ); // ignoreErrCode
+
+    // One line "pkg: path" for each owned path, the diversion lines (see
+    // owningPkg()) and error messages for the others:
+    //
+    //	 gdb: /usr/bin/gdb
+    //	 dpkg-query: no path found matching pattern /usr/bin/foo
+
+    foreach ( const QString & line, output.split( "\n" ) )
+    {
+	if ( line.startsWith( "diversion by"	 ) ||
+	     line.startsWith( "local diversion" ) ||
+	     line.startsWith( "dpkg-query:"	 )    )
+	    continue;
+
+	int pos = line.indexOf( ": /" );
+
+	if ( pos > 0 )
+	    pkgs.insert( line.mid( pos + 2 ), line.left( pos ) );
+    }
+
+    return pkgs;
+}
+
+
 PkgInfoList DpkgPkgManager::installedPkg()
 {
+    QList<DpkgStatusEntry> entries;
+
+    if ( _haveDatabase && DpkgDatabase::readStatus( entries ) )
+    {
+	PkgInfoList pkgList;
+
+	foreach ( const DpkgStatusEntry & entry, entries )
+	{
+	    PkgInfo * pkg = new PkgInfo( entry.name, entry.version, entry.arch, this );
+	    CHECK_NEW( pkg );
+
+	    pkgList << pkg;
+	}
+
+	return pkgList;
+    }
+
     int exitCode = -1;
     QString output = runCommand( "/usr/bin/dpkg-query",
 				 QStringList()
@@ -143,6 +274,28 @@ PkgInfoList DpkgPkgManager::parsePkgList( const QString & output )
 }
 
 
+QStringList DpkgPkgManager::fileList( PkgInfo * pkg )
+{
+    CHECK_PTR( pkg );
+
+    if ( _haveDatabase )
+    {
+	// The list file of a "Multi-Arch: same" package has the architecture
+	// in its name
+
+	QStringList fileList;
+
+	if ( DpkgDatabase::readFileList( pkg->baseName(), fileList ) ||
+	     DpkgDatabase::readFileList( queryName( pkg ), fileList ) )
+	{
+	    return fileList;
+	}
+    }
+
+    return PkgManager::fileList( pkg );
+}
+
+
 QString DpkgPkgManager::fileListCommand( PkgInfo * pkg )
 {
     return QString( "/usr/bin/dpkg-query --listfiles %1" ).arg( queryName( pkg ) );
@@ -185,54 +338,45 @@ QString DpkgPkgManager::queryName( PkgInfo * pkg )
 }
 
 
-PkgFileListCache * DpkgPkgManager::createFileListCache( PkgFileListCache::LookupType lookupType )
+PkgFileListCache * DpkgPkgManager::createNativeFileListCache( PkgFileListCache::LookupType lookupType )
 {
-    int exitCode = -1;
-    QString output = runCommand( "/usr/bin/dpkg", QStringList() << "-S" << "*", &exitCode );
+    PkgFileListCache * cache = new PkgFileListCache( this, lookupType );
+    CHECK_NEW( cache );
 
-    if ( exitCode != 0 )
+    if ( ! DpkgDatabase::readAllFileLists( cache ) )
+    {
+	delete cache;
 	return 0;
+    }
 
-    QStringList lines = output.split( "\n" );
-    output.clear(); // Free all that text ASAP
-    logDebug() << lines.size() << " output lines" << endl;
+    logDebug() << "file list cache finished." << endl;
 
-    PkgFileListCache * cache = new PkgFileListCache( this, lookupType );
-    CHECK_NEW( cache );
+    return cache;
+}
 
-    // Sample output:
-    //
-    //	   zip: /usr/bin/zip
-    //	   zlib1g-dev:amd64: /usr/include/zlib.h
-    //	   zlib1g:i386, zlib1g:amd64: /usr/share/doc/zlib1g
 
-    foreach ( const QString & line, lines )
+PkgFileListCache * DpkgPkgManager::createFileListCache( PkgFileListCache::LookupType lookupType )
+{
+    if ( _haveDatabase )
     {
-	if ( line.isEmpty() || line.startsWith( "diversion" ) )
-	    continue;
+	PkgFileListCache * cache = createNativeFileListCache( lookupType );
 
-	QStringList fields = line.split( ": " );
+	if ( cache )
+	    return cache;
+    }
 
-	if ( fields.size() != 2 )
-	{
-	    logError() << "Unexpected file list line: \"" << line << "\"" << endl;
-	}
-	else
-	{
-	    QString packages = fields.takeFirst();
-	    QString path     = fields.takeFirst();
+    PkgFileListCache * cache = new PkgFileListCache( this, lookupType );
+    CHECK_NEW( cache );
 
-	    if ( path != "/." && ! path.isEmpty() )
-	    {
-		foreach ( const QString & pkgName, packages.split( ", " ) )
-		{
-		    if ( ! pkgName.isEmpty() )
-			cache->add( pkgName, path );
-		}
-	    }
-	}
+    DpkgSearchParser parser( cache );
+
+    if ( ! SysUtil::runCommandLines( "/usr/bin/dpkg", QStringList() << "-S" << "*", &parser ) )
+    {
+	delete cache;
+	return 0;
     }
 
+    logDebug() << parser.lineCount() << " output lines" << endl;
     logDebug() << "file list cache finished." << endl;
 
     return cache;
@@ -27,7 +27,15 @@ namespace QDirStat
     {
     public:
 
-	DpkgPkgManager() {}
+	/**
+	 * Constructor. This checks if the dpkg database can be read directly
+	 * (see DpkgDatabase).
+	 **/
+	DpkgPkgManager();
+
+	/**
+	 * Destructor.
+	 **/
 	virtual ~DpkgPkgManager() {}
 
 	/**
@@ -64,6 +72,17 @@ namespace QDirStat
 	 **/
 	virtual QString owningPkg( const QString & path ) Q_DECL_OVERRIDE;
 
+	/**
+	 * Return the owning packages of several paths with one command.
+	 *
+	 * Reimplemented from PkgManager.
+	 *
+	 * This basically executes this command:
+	 *
+	 *   /usr/bin/dpkg -S ${path1} ${path2} ...
+	 **/
+	virtual QMap<QString, QString> owningPkgs( const QStringList & paths ) Q_DECL_OVERRIDE;
+
 
 	//-----------------------------------------------------------------
 	//		       Optional Features
@@ -83,10 +102,31 @@ namespace QDirStat
 	 *
 	 * Ownership of the list elements is transferred to the caller.
 	 *
+	 * This reads the dpkg status file directly if possible and uses
+	 * dpkg-query only as a fallback.
+	 *
 	 * Reimplemented from PkgManager.
 	 **/
 	virtual PkgInfoList installedPkg() Q_DECL_OVERRIDE;
 
+	/**
+	 * Return the list of files and directories owned by a package.
+	 *
+	 * This reads the package's list file in the dpkg database directly
+	 * if possible and starts the file list command only as a fallback.
+	 *
+	 * Reimplemented from PkgManager.
+	 **/
+	virtual QStringList fileList( PkgInfo * pkg ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Return 'true' if fileList() reads the dpkg database directly.
+	 *
+	 * Reimplemented from PkgManager.
+	 **/
+	virtual bool supportsNativeFileList() Q_DECL_OVERRIDE
+	    { return _haveDatabase; }
+
 	/**
 	 * Return 'true' if this package manager supports getting the file list
 	 * for a package.
@@ -131,10 +171,22 @@ namespace QDirStat
 	 * Ownership of the cache is transferred to the caller; make sure to
 	 * delete it when you are done with it.
 	 *
+	 * This reads all list files of the dpkg database directly if
+	 * possible and uses "dpkg -S '*'" only as a fallback.
+	 *
 	 * Reimplemented from PkgManager.
 	 **/
 	virtual PkgFileListCache * createFileListCache( PkgFileListCache::LookupType lookupType = PkgFileListCache::LookupByPkg ) Q_DECL_OVERRIDE;
 
+	/**
+	 * Return the files of the package database: dpkg rewrites its status
+	 * file for each change.
+	 *
+	 * Reimplemented from PkgManager.
+	 **/
+	virtual QStringList databaseFiles() Q_DECL_OVERRIDE
+	    { return QStringList() << "/var/lib/dpkg/status"; }
+
 	/**
 	 * Return a name suitable for a detailed queries for 'pkg'.
 	 *
@@ -153,6 +205,17 @@ namespace QDirStat
 	 **/
 	PkgInfoList parsePkgList( const QString & output );
 
+	/**
+	 * Create a file list cache from the file lists in the dpkg database.
+	 * Return 0 if that fails.
+	 **/
+	PkgFileListCache * createNativeFileListCache( PkgFileListCache::LookupType lookupType );
+
+
+	// Data members
+
+	bool _haveDatabase;
+
     };	// class DpkgPkgManager
 
 }	// namespace QDirStat
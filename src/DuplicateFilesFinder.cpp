@@ -0,0 +1,492 @@
+/*
+ *   File name: DuplicateFilesFinder.cpp
+ *   Summary:	Find files with identical content
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string.h>	// memcpy()
+
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+
+#include "DuplicateFilesFinder.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+#define HEAD_SIZE		4096		// Bytes to hash in the first pass
+#define READ_BUFFER_SIZE	( 128 * 1024 )
+#define MAX_HASH_THREADS	4		// More only makes the disk seek
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Streaming implementation of the xxHash64 algorithm by Yann Collet:
+     * A fast non-cryptographic hash with very good distribution.
+     *
+     * This reads the input in host byte order, so the hash values are
+     * only comparable on the same machine, which is all we need here.
+     **/
+    class XXHash64
+    {
+    public:
+
+	XXHash64( quint64 seed = 0 ):
+	    _totalLen( 0 ),
+	    _memSize( 0 )
+	{
+	    _v[0] = seed + Prime1 + Prime2;
+	    _v[1] = seed + Prime2;
+	    _v[2] = seed;
+	    _v[3] = seed - Prime1;
+	}
+
+	void add( const char * data, qint64 len )
+	{
+	    const unsigned char * p   = (const unsigned char *) data;
+	    const unsigned char * end = p + len;
+
+	    _totalLen += len;
+
+	    if ( _memSize + len < 32 )	// Not enough for a stripe yet
+	    {
+		memcpy( _mem + _memSize, p, len );
+		_memSize += len;
+		return;
+	    }
+
+	    if ( _memSize > 0 )	// Complete the stripe from the last call
+	    {
+		int fill = 32 - _memSize;
+		memcpy( _mem + _memSize, p, fill );
+		processStripe( _mem );
+		p += fill;
+		_memSize = 0;
+	    }
+
+	    while ( p + 32 <= end )
+	    {
+		processStripe( p );
+		p += 32;
+	    }
+
+	    _memSize = end - p;
+	    memcpy( _mem, p, _memSize );
+	}
+
+	quint64 result() const
+	{
+	    quint64 h;
+
+	    if ( _totalLen >= 32 )
+	    {
+		h = rotl( _v[0], 1 ) + rotl( _v[1], 7 ) + rotl( _v[2], 12 ) + rotl( _v[3], 18 );
+
+		for ( int i = 0; i < 4; ++i )
+		    h = mergeRound( h, _v[i] );
+	    }
+	    else
+	    {
+		h = _v[2] + Prime5;	// _v[2] is still the seed
+	    }
+
+	    h += _totalLen;
+
+	    const unsigned char * p   = _mem;
+	    const unsigned char * end = _mem + _memSize;
+
+	    for ( ; p + 8 <= end; p += 8 )
+	    {
+		h ^= round( 0, read64( p ) );
+		h  = rotl( h, 27 ) * Prime1 + Prime4;
+	    }
+
+	    if ( p + 4 <= end )
+	    {
+		h ^= (quint64) read32( p ) * Prime1;
+		h  = rotl( h, 23 ) * Prime2 + Prime3;
+		p += 4;
+	    }
+
+	    for ( ; p < end; ++p )
+	    {
+		h ^= *p * Prime5;
+		h  = rotl( h, 11 ) * Prime1;
+	    }
+
+	    h ^= h >> 33;
+	    h *= Prime2;
+	    h ^= h >> 29;
+	    h *= Prime3;
+	    h ^= h >> 32;
+
+	    return h;
+	}
+
+    private:
+
+	static const quint64 Prime1 = 11400714785074694791ULL;
+	static const quint64 Prime2 = 14029467366897019727ULL;
+	static const quint64 Prime3 =  1609587929392839161ULL;
+	static const quint64 Prime4 =  9650029242287828579ULL;
+	static const quint64 Prime5 =  2870177450012600261ULL;
+
+	static quint64 rotl( quint64 x, int bits )
+	    { return ( x << bits ) | ( x >> ( 64 - bits ) ); }
+
+	static quint64 read64( const unsigned char * p )
+	    { quint64 val; memcpy( &val, p, sizeof( val ) ); return val; }
+
+	static quint32 read32( const unsigned char * p )
+	    { quint32 val; memcpy( &val, p, sizeof( val ) ); return val; }
+
+	static quint64 round( quint64 acc, quint64 input )
+	{
+	    acc += input * Prime2;
+	    acc  = rotl( acc, 31 );
+	    return acc * Prime1;
+	}
+
+	static quint64 mergeRound( quint64 acc, quint64 val )
+	{
+	    acc ^= round( 0, val );
+	    return acc * Prime1 + Prime4;
+	}
+
+	void processStripe( const unsigned char * p )
+	{
+	    for ( int i = 0; i < 4; ++i )
+		_v[i] = round( _v[i], read64( p + 8 * i ) );
+	}
+
+
+	quint64		_v[4];
+	quint64		_totalLen;
+	unsigned char	_mem[32];
+	int		_memSize;
+    };
+
+}	// namespace
+
+
+
+DuplicateFilesWorker::DuplicateFilesWorker( DuplicateFilesFinder * finder ):
+    QThread(),
+    _finder( finder )
+{
+    // NOP
+}
+
+
+void DuplicateFilesWorker::run()
+{
+    DuplicateGroup sameSize;
+
+    while ( _finder->takeGroup( sameSize ) )
+    {
+	processGroup( sameSize );
+	_finder->groupProcessed();
+    }
+}
+
+
+void DuplicateFilesWorker::processGroup( const DuplicateGroup & sameSize )
+{
+    // Several hard links to the same inode are the same file, not
+    // duplicates: Keep only the first one.
+
+    DuplicateGroup candidates;
+    QSet<QPair<quint64, quint64> > inodes;
+
+    foreach ( const DuplicateCandidate & candidate, sameSize )
+    {
+	if ( candidate.links > 1 )
+	{
+	    struct stat statInfo;
+
+	    if ( lstat( candidate.path.toUtf8(), &statInfo ) != 0 )
+		continue;
+
+	    QPair<quint64, quint64> inode( statInfo.st_dev, statInfo.st_ino );
+
+	    if ( inodes.contains( inode ) )
+		continue;
+
+	    inodes.insert( inode );
+	}
+
+	candidates << candidate;
+    }
+
+    if ( candidates.size() < 2 || _finder->cancelled() )
+	return;
+
+    // Most files that differ at all already differ in their first block
+
+    foreach ( const DuplicateGroup & sameHead, splitByHash( candidates, HEAD_SIZE ) )
+    {
+	if ( sameHead.first().size <= HEAD_SIZE )
+	{
+	    // The first block was the complete content
+
+	    _finder->addResult( sameHead );
+	}
+	else
+	{
+	    foreach ( const DuplicateGroup & identical, splitByHash( sameHead, -1 ) )
+		_finder->addResult( identical );
+	}
+
+	if ( _finder->cancelled() )
+	    return;
+    }
+}
+
+
+QList<DuplicateGroup> DuplicateFilesWorker::splitByHash( const DuplicateGroup & group,
+							 qint64		        maxBytes )
+{
+    QHash<quint64, DuplicateGroup> byHash;
+    QList<quint64> hashes; // in the order they were found
+
+    foreach ( const DuplicateCandidate & candidate, group )
+    {
+	quint64 hash;
+
+	if ( ! hashFile( candidate.path, maxBytes, hash ) )
+	{
+	    if ( _finder->cancelled() )
+		return QList<DuplicateGroup>();
+
+	    continue;
+	}
+
+	DuplicateGroup & sameHash = byHash[ hash ];
+
+	if ( sameHash.isEmpty() )
+	    hashes << hash;
+
+	sameHash << candidate;
+    }
+
+    QList<DuplicateGroup> result;
+
+    foreach ( quint64 hash, hashes )
+    {
+	const DuplicateGroup & sameHash = byHash[ hash ];
+
+	if ( sameHash.size() > 1 )
+	    result << sameHash;
+    }
+
+    return result;
+}
+
+
+bool DuplicateFilesWorker::hashFile( const QString & path,
+				     qint64	     maxBytes,
+				     quint64	   & hash_ret )
+{
+    QFile file( path );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+    {
+	logDebug() << "Can't open " << path << ": " << file.errorString() << endl;
+	return false;
+    }
+
+    XXHash64 hash;
+    QByteArray buffer( READ_BUFFER_SIZE, 0 );
+    qint64 remaining = maxBytes < 0 ? file.size() : maxBytes;
+
+    while ( remaining > 0 )
+    {
+	if ( _finder->cancelled() )
+	    return false;
+
+	qint64 len = file.read( buffer.data(), qMin( remaining, (qint64) buffer.size() ) );
+
+	if ( len < 0 )
+	{
+	    logWarning() << "Can't read " << path << ": " << file.errorString() << endl;
+	    return false;
+	}
+
+	if ( len == 0 ) // The file was truncated in the meantime
+	    break;
+
+	hash.add( buffer.constData(), len );
+	remaining -= len;
+    }
+
+    hash_ret = hash.result();
+
+    return true;
+}
+
+
+
+
+DuplicateFilesFinder::DuplicateFilesFinder( const QList<DuplicateGroup> & sizeGroups,
+					    QObject *			  parent ):
+    QObject( parent ),
+    _sizeGroups( sizeGroups ),
+    _nextGroup( 0 ),
+    _totalGroups( sizeGroups.size() ),
+    _cancelled( 0 ),
+    _processedGroups( 0 ),
+    _runningWorkers( 0 )
+{
+    // The worker threads take the groups out of this list, so it must not
+    // share its data with the caller's list any more.
+
+    _sizeGroups.detach();
+}
+
+
+DuplicateFilesFinder::~DuplicateFilesFinder()
+{
+    cancel();
+
+    foreach ( DuplicateFilesWorker * worker, _workers )
+	worker->wait();
+
+    qDeleteAll( _workers );
+}
+
+
+QList<DuplicateGroup> DuplicateFilesFinder::sizeGroups( const FileInfoList & items )
+{
+    QHash<FileSize, FileInfoList> bySize;
+
+    foreach ( FileInfo * item, items )
+	bySize[ item->rawByteSize() ] << item;
+
+    QList<DuplicateGroup> groups;
+
+    for ( QHash<FileSize, FileInfoList>::const_iterator it = bySize.constBegin();
+	  it != bySize.constEnd();
+	  ++it )
+    {
+	if ( it.value().size() < 2 )
+	    continue;
+
+	DuplicateGroup group;
+
+	foreach ( FileInfo * item, it.value() )
+	{
+	    DuplicateCandidate candidate;
+	    candidate.url   = item->url();
+	    candidate.path  = item->path();
+	    candidate.size  = item->rawByteSize();
+	    candidate.links = item->links();
+
+	    group << candidate;
+	}
+
+	groups << group;
+    }
+
+    return groups;
+}
+
+
+void DuplicateFilesFinder::start()
+{
+    int threadCount = qBound( 1, QThread::idealThreadCount(), MAX_HASH_THREADS );
+    threadCount	    = qMin( threadCount, _sizeGroups.size() );
+
+    logInfo() << "Checking " << _sizeGroups.size() << " groups of files with the same size"
+	      << " in " << threadCount << " threads" << endl;
+
+    if ( threadCount == 0 )
+    {
+	emit finished();
+	return;
+    }
+
+    for ( int i = 0; i < threadCount; ++i )
+    {
+	DuplicateFilesWorker * worker = new DuplicateFilesWorker( this );
+	CHECK_NEW( worker );
+
+	connect( worker, SIGNAL( finished()	  ),
+		 this,	 SLOT  ( workerFinished() ) );
+
+	_workers << worker;
+	++_runningWorkers;
+	worker->start( QThread::LowPriority );
+    }
+}
+
+
+void DuplicateFilesFinder::cancel()
+{
+    _cancelled.storeRelease( 1 );
+}
+
+
+bool DuplicateFilesFinder::takeGroup( DuplicateGroup & group_ret )
+{
+    QMutexLocker locker( &_mutex );
+
+    if ( cancelled() || _nextGroup >= _sizeGroups.size() )
+	return false;
+
+    // Hand out the groups, not copies: The candidates are only needed once
+
+    group_ret.clear();
+    group_ret.swap( _sizeGroups[ _nextGroup++ ] );
+
+    return true;
+}
+
+
+void DuplicateFilesFinder::addResult( const DuplicateGroup & identical )
+{
+    bool notify;
+
+    {
+	QMutexLocker locker( &_mutex );
+
+	notify = _results.isEmpty(); // Only one notification until they are taken
+	_results << identical;
+    }
+
+    if ( notify )
+	emit resultsReady(); // This is queued since it is sent from a worker thread
+}
+
+
+QList<DuplicateGroup> DuplicateFilesFinder::takeResults()
+{
+    QMutexLocker locker( &_mutex );
+
+    QList<DuplicateGroup> results;
+    results.swap( _results );
+
+    return results;
+}
+
+
+void DuplicateFilesFinder::workerFinished()
+{
+    if ( --_runningWorkers == 0 )
+    {
+	logInfo() << "Checked " << processedGroups() << " groups of files with the same size"
+		  << ( cancelled() ? " (cancelled)" : "" ) << endl;
+
+	emit finished();
+    }
+}
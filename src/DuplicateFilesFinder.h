@@ -0,0 +1,241 @@
+/*
+ *   File name: DuplicateFilesFinder.h
+ *   Summary:	Find files with identical content
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DuplicateFilesFinder_h
+#define DuplicateFilesFinder_h
+
+
+#include <sys/types.h>
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QList>
+#include <QString>
+
+#include "FileInfo.h"
+
+
+namespace QDirStat
+{
+    class DuplicateFilesFinder;
+
+
+    /**
+     * A file that might have the same content as others. This holds
+     * everything that the worker threads need, so they never touch the
+     * DirTree. 'url' is for locating the file in the DirTree, 'path' for
+     * reading it; they only differ in package views.
+     **/
+    struct DuplicateCandidate
+    {
+	QString	 url;
+	QString	 path;
+	FileSize size;
+	nlink_t	 links;
+    };
+
+    /**
+     * A group of files of the same size, or of files with identical
+     * content.
+     **/
+    typedef QList<DuplicateCandidate> DuplicateGroup;
+
+
+    /**
+     * Worker thread of a DuplicateFilesFinder: Take the next group of files
+     * of the same size from the finder, find the files with identical
+     * content in that group and hand them back to the finder until there
+     * are no more groups.
+     **/
+    class DuplicateFilesWorker: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	DuplicateFilesWorker( DuplicateFilesFinder * finder );
+
+    protected:
+
+	/**
+	 * The worker loop. This is called in the new thread.
+	 *
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	/**
+	 * Find the files with identical content in 'sameSize' and add them
+	 * to the finder's results.
+	 **/
+	void processGroup( const DuplicateGroup & sameSize );
+
+	/**
+	 * Calculate the hash of the first 'maxBytes' bytes of the file
+	 * 'path' (or of the complete file if 'maxBytes' is negative) and
+	 * store it in 'hash_ret'. Return 'false' if the file could not be
+	 * read or the search was cancelled.
+	 **/
+	bool hashFile( const QString & path,
+		       qint64	       maxBytes,
+		       quint64	     & hash_ret );
+
+	/**
+	 * Split 'group' into groups of files with the same hash of their
+	 * first 'maxBytes' bytes (of the complete content if 'maxBytes' is
+	 * negative). Groups with only one file are dropped.
+	 **/
+	QList<DuplicateGroup> splitByHash( const DuplicateGroup & group,
+					   qint64		  maxBytes );
+
+
+	DuplicateFilesFinder * _finder;
+    };
+
+
+    /**
+     * Engine to find files with identical content.
+     *
+     * This gets groups of files of the same size that were collected from
+     * a DirTree (see sizeGroups()), so only files that can be duplicates
+     * are ever read. Several worker threads process one group at a time:
+     *
+     *	 - Of several hard links to the same inode, only the first one is
+     *	   kept; they are the same file, not duplicates.
+     *
+     *	 - The first block of each file is hashed, and the group is split by
+     *	   that hash. Files that differ at all usually already differ there.
+     *
+     *	 - The complete content of the remaining files is hashed with a fast
+     *	   non-cryptographic 64 bit hash (xxHash64), and the groups with more
+     *	   than one file are the results.
+     *
+     * The results are available as soon as each group is confirmed: Use
+     * takeResults() when resultsReady() is emitted.
+     **/
+    class DuplicateFilesFinder: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor. Call start() to start the worker threads.
+	 **/
+	DuplicateFilesFinder( const QList<DuplicateGroup> & sizeGroups,
+			      QObject *			    parent = 0 );
+
+	/**
+	 * Destructor. This cancels the search and waits for the worker
+	 * threads.
+	 **/
+	virtual ~DuplicateFilesFinder();
+
+	/**
+	 * Group the files in 'items' by size and return the groups with more
+	 * than one file. This has to be called in the thread that owns the
+	 * tree since it builds the path of each candidate.
+	 **/
+	static QList<DuplicateGroup> sizeGroups( const FileInfoList & items );
+
+	/**
+	 * Start the worker threads.
+	 **/
+	void start();
+
+	/**
+	 * Request the worker threads to stop as soon as possible.
+	 **/
+	void cancel();
+
+	/**
+	 * Return 'true' if cancel() was called.
+	 **/
+	bool cancelled() const { return _cancelled.loadAcquire() != 0; }
+
+	/**
+	 * Return 'true' if the search is finished or cancelled.
+	 **/
+	bool isFinished() const { return _runningWorkers == 0; }
+
+	/**
+	 * Return the groups of identical files that were found since the last
+	 * call and remove them from this finder.
+	 **/
+	QList<DuplicateGroup> takeResults();
+
+	/**
+	 * Return the number of size groups that were processed so far and the
+	 * total number of size groups.
+	 **/
+	int processedGroups() const { return _processedGroups.loadAcquire(); }
+	int totalGroups()     const { return _totalGroups; }
+
+
+	// For the worker threads
+
+	/**
+	 * Take the next group of files of the same size in 'group_ret'.
+	 * Return 'false' if there is none left or the search was cancelled.
+	 **/
+	bool takeGroup( DuplicateGroup & group_ret );
+
+	/**
+	 * Add a group of identical files.
+	 **/
+	void addResult( const DuplicateGroup & identical );
+
+	/**
+	 * Notification that a worker finished a group.
+	 **/
+	void groupProcessed() { _processedGroups.ref(); }
+
+
+    signals:
+
+	/**
+	 * Emitted when new results are available. Use takeResults() to get
+	 * them.
+	 **/
+	void resultsReady();
+
+	/**
+	 * Emitted when all worker threads are finished.
+	 **/
+	void finished();
+
+
+    protected slots:
+
+	/**
+	 * Notification that a worker thread is finished.
+	 **/
+	void workerFinished();
+
+
+    protected:
+
+	QList<DuplicateGroup>		_sizeGroups;
+	int				_nextGroup;
+	int				_totalGroups;
+	QList<DuplicateGroup>		_results;
+	QMutex				_mutex;
+	QAtomicInt			_cancelled;
+	QAtomicInt			_processedGroups;
+	QList<DuplicateFilesWorker *>	_workers;
+	int				_runningWorkers;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// DuplicateFilesFinder_h
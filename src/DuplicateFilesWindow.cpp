@@ -0,0 +1,418 @@
+/*
+ *   File name: DuplicateFilesWindow.cpp
+ *   Summary:	QDirStat "duplicate files" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <algorithm>
+
+#include "DuplicateFilesWindow.h"
+#include "QDirStatApp.h"        // SelectionModel
+#include "TreeWalker.h"
+#include "TreeWalkerRunner.h"
+#include "DirTree.h"
+#include "SelectionModel.h"
+#include "SettingsHelpers.h"
+#include "HeaderTweaker.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Comparison functor for sorting the files of a group by URL.
+     **/
+    bool urlLessThan( const DuplicateCandidate & a, const DuplicateCandidate & b )
+    {
+	return a.url < b.url;
+    }
+
+}	// namespace
+
+
+DuplicateFilesWindow::DuplicateFilesWindow( QWidget * parent ):
+    QDialog( parent ),
+    _ui( new Ui::DuplicateFilesWindow ),
+    _walker( new DuplicateCandidatesTreeWalker() ),
+    _runner( 0 ),
+    _finder( 0 ),
+    _tree( 0 ),
+    _groupCount( 0 ),
+    _wastedSize( 0 )
+{
+    // logDebug() << "init" << endl;
+
+    CHECK_NEW( _ui );
+    CHECK_NEW( _walker );
+    _ui->setupUi( this );
+    initWidgets();
+    readWindowSettings( this, "DuplicateFilesWindow" );
+
+    connect( _ui->refreshButton, SIGNAL( clicked() ),
+	     this,		 SLOT  ( refresh() ) );
+
+    connect( _ui->stopButton,	 SIGNAL( clicked() ),
+	     this,		 SLOT  ( cancelSearch() ) );
+
+    connect( _ui->treeWidget,	 SIGNAL( currentItemChanged( QTreeWidgetItem *,
+							     QTreeWidgetItem * ) ),
+	     this,		 SLOT  ( selectResult	   ( QTreeWidgetItem * ) ) );
+}
+
+
+DuplicateFilesWindow::~DuplicateFilesWindow()
+{
+    // logDebug() << "destroying" << endl;
+
+    cancelSearch();
+    writeWindowSettings( this, "DuplicateFilesWindow" );
+    delete _walker;
+    delete _ui;
+}
+
+
+void DuplicateFilesWindow::clear()
+{
+    _ui->treeWidget->clear();
+    _groupCount = 0;
+    _wastedSize = 0;
+    _ui->totalLabel->clear();
+}
+
+
+void DuplicateFilesWindow::refresh()
+{
+    populate( _subtree() );
+}
+
+
+void DuplicateFilesWindow::initWidgets()
+{
+    QFont font = _ui->heading->font();
+    font.setBold( true );
+    _ui->heading->setFont( font );
+
+    QStringList headerLabels;
+    headerLabels << tr( "Files" )
+		 << tr( "Size"	);
+
+    _ui->treeWidget->setColumnCount( headerLabels.size() );
+    _ui->treeWidget->setHeaderLabels( headerLabels );
+    _ui->treeWidget->setSortingEnabled( false );
+    _ui->treeWidget->header()->setStretchLastSection( false );
+    HeaderTweaker::resizeToContents( _ui->treeWidget->header() );
+    updateSearchStatus();
+}
+
+
+void DuplicateFilesWindow::reject()
+{
+    deleteLater();
+}
+
+
+void DuplicateFilesWindow::populate( FileInfo * newSubtree )
+{
+    cancelSearch();
+    clear();
+    _subtree = newSubtree;
+
+    FileInfo * subtree = _subtree();
+
+    if ( ! subtree )
+	return;
+
+    _ui->heading->setText( tr( "Duplicate Files in %1" ).arg( subtree->url() ) );
+    connectTree( _subtree.tree() );
+
+    // Make sure the summary fields are up to date: The search thread must
+    // never trigger recalculating them while the view might do the same.
+    subtree->totalFiles();
+
+    _runner = new TreeWalkerRunner( _walker, subtree );
+    CHECK_NEW( _runner );
+
+    connect( _runner, SIGNAL( finished() ),
+	     this,    SLOT  ( collectFinished() ) );
+
+    _runner->start();
+    updateSearchStatus();
+}
+
+
+void DuplicateFilesWindow::collectFinished()
+{
+    if ( ! _runner || sender() != _runner )
+	return; // Late signal from a search that was cancelled
+
+    bool cancelled = _runner->cancelled();
+    QList<DuplicateGroup> sizeGroups;
+
+    // Building the paths uses the tree, so this has to be done here in the
+    // GUI thread, not in the finder's threads.
+
+    if ( ! cancelled )
+	sizeGroups = DuplicateFilesFinder::sizeGroups( _runner->results() );
+
+    delete _runner;
+    _runner = 0;
+
+    if ( ! cancelled )
+    {
+	_finder = new DuplicateFilesFinder( sizeGroups );
+	CHECK_NEW( _finder );
+
+	connect( _finder, SIGNAL( resultsReady()  ),
+		 this,	  SLOT	( addResults()	  ) );
+
+	connect( _finder, SIGNAL( finished()	  ),
+		 this,	  SLOT	( searchFinished() ) );
+
+	_finder->start();
+    }
+
+    updateSearchStatus();
+}
+
+
+void DuplicateFilesWindow::addResults()
+{
+    if ( ! _finder || sender() != _finder )
+	return; // Late signal from a search that was cancelled
+
+    foreach ( DuplicateGroup group, _finder->takeResults() )
+    {
+	std::sort( group.begin(), group.end(), urlLessThan );
+
+	DuplicateGroupItem * groupItem = new DuplicateGroupItem( group );
+	CHECK_NEW( groupItem );
+
+	insertGroupItem( groupItem );
+
+	++_groupCount;
+	_wastedSize += groupItem->wastedSize();
+    }
+
+    if ( ! _ui->treeWidget->currentItem() && _ui->treeWidget->topLevelItemCount() > 0 )
+	_ui->treeWidget->setCurrentItem( _ui->treeWidget->topLevelItem( 0 )->child( 0 ) );
+
+    updateSearchStatus();
+}
+
+
+void DuplicateFilesWindow::insertGroupItem( DuplicateGroupItem * groupItem )
+{
+    // Binary search for the first group with less wasted size
+
+    int first = 0;
+    int last  = _ui->treeWidget->topLevelItemCount();
+
+    while ( first < last )
+    {
+	int mid = ( first + last ) / 2;
+
+	DuplicateGroupItem * item =
+	    dynamic_cast<DuplicateGroupItem *>( _ui->treeWidget->topLevelItem( mid ) );
+	CHECK_DYNAMIC_CAST( item, "DuplicateGroupItem" );
+
+	if ( item->wastedSize() >= groupItem->wastedSize() )
+	    first = mid + 1;
+	else
+	    last = mid;
+    }
+
+    _ui->treeWidget->insertTopLevelItem( first, groupItem );
+    groupItem->setExpanded( true );
+}
+
+
+void DuplicateFilesWindow::searchFinished()
+{
+    if ( ! _finder || sender() != _finder )
+	return; // Late signal from a search that was cancelled
+
+    addResults(); // Anything that is still pending
+
+    logDebug() << _groupCount << " groups of duplicate files" << endl;
+
+    _finder->deleteLater(); // We are in a slot called by its signal
+    _finder = 0;
+    updateSearchStatus();
+}
+
+
+void DuplicateFilesWindow::cancelSearch()
+{
+    if ( ! _runner && ! _finder )
+	return;
+
+    logDebug() << "Cancelling search" << endl;
+
+    // Deleting the runner or the finder cancels it and waits until it is
+    // stopped. Signals that might still be queued are ignored because of
+    // the sender() checks.
+
+    if ( _runner )
+    {
+	delete _runner;
+	_runner = 0;
+    }
+
+    if ( _finder )
+    {
+	delete _finder;
+	_finder = 0;
+    }
+
+    updateSearchStatus();
+}
+
+
+void DuplicateFilesWindow::cancelCollecting()
+{
+    if ( ! _runner )
+	return;
+
+    logDebug() << "Cancelling collecting the files" << endl;
+
+    delete _runner;
+    _runner = 0;
+    updateSearchStatus();
+}
+
+
+void DuplicateFilesWindow::connectTree( DirTree * tree )
+{
+    if ( tree == _tree )
+	return;
+
+    if ( _tree )
+	disconnect( _tree, 0, this, 0 );
+
+    _tree = tree;
+
+    if ( ! _tree )
+	return;
+
+    // The collecting thread must never see the tree while it changes. The
+    // finder's threads don't use the tree, so they can go on; the user
+    // might just have deleted one of the duplicates that were found.
+
+    connect( _tree, SIGNAL( deletingChild  ( FileInfo * ) ),
+	     this,  SLOT  ( cancelCollecting() ) );
+
+    connect( _tree, SIGNAL( clearingSubtree( DirInfo * ) ),
+	     this,  SLOT  ( cancelCollecting() ) );
+
+    connect( _tree, SIGNAL( clearing() ),
+	     this,  SLOT  ( cancelCollecting() ) );
+
+    connect( _tree, SIGNAL( startingReading() ),
+	     this,  SLOT  ( cancelCollecting() ) );
+}
+
+
+void DuplicateFilesWindow::updateSearchStatus()
+{
+    bool searching = _runner || _finder;
+
+    _ui->stopButton->setEnabled( searching );
+    _ui->refreshButton->setEnabled( ! searching );
+
+    QString text;
+
+    if ( _finder )
+    {
+	text = tr( "Checking %1 groups of files with the same size..." )
+	    .arg( _finder->totalGroups() );
+    }
+    else if ( _runner )
+    {
+	text = tr( "Collecting files..." );
+    }
+
+    if ( _groupCount > 0 || ! searching )
+    {
+	if ( ! text.isEmpty() )
+	    text += "  ";
+
+	text += tr( "Groups: %1  Wasted: %2" )
+	    .arg( _groupCount )
+	    .arg( formatSize( _wastedSize ) );
+    }
+
+    _ui->totalLabel->setText( text );
+
+    if ( searching )
+	setCursor( Qt::BusyCursor );
+    else
+	unsetCursor();
+}
+
+
+void DuplicateFilesWindow::selectResult( QTreeWidgetItem * item )
+{
+    DuplicateFileItem * fileItem = dynamic_cast<DuplicateFileItem *>( item );
+
+    if ( ! fileItem || ! _subtree.tree() )
+	return;
+
+    FileInfo * file = _subtree.tree()->locate( fileItem->url() );
+
+    // logDebug() << "Selecting " << fileItem->url() << ": " << file << endl;
+
+    if ( file )
+	app()->selectionModel()->setCurrentItem( file,
+						 true ); // select
+}
+
+
+
+
+
+
+DuplicateGroupItem::DuplicateGroupItem( const DuplicateGroup & group ):
+    QTreeWidgetItem( QTreeWidgetItem::UserType ),
+    _wastedSize( 0 )
+{
+    if ( group.isEmpty() )
+	return;
+
+    FileSize size = group.first().size;
+    _wastedSize	  = size * ( group.size() - 1 );
+
+    setText( 0, QObject::tr( "%1 identical files" ).arg( group.size() ) );
+    setText( 1, formatSize( size ) );
+    setTextAlignment( 1, Qt::AlignRight );
+
+    QFont boldFont = font( 0 );
+    boldFont.setBold( true );
+    setFont( 0, boldFont );
+
+    foreach ( const DuplicateCandidate & file, group )
+    {
+	DuplicateFileItem * fileItem = new DuplicateFileItem( file );
+	CHECK_NEW( fileItem );
+
+	addChild( fileItem );
+    }
+}
+
+
+
+
+DuplicateFileItem::DuplicateFileItem( const DuplicateCandidate & file ):
+    QTreeWidgetItem( QTreeWidgetItem::UserType ),
+    _url( file.url )
+{
+    setText( 0, file.url + "    " );
+    setText( 1, formatSize( file.size ) );
+    setTextAlignment( 1, Qt::AlignRight );
+}
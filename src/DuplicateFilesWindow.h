@@ -0,0 +1,235 @@
+/*
+ *   File name: DuplicateFilesWindow.h
+ *   Summary:	QDirStat "duplicate files" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef DuplicateFilesWindow_h
+#define DuplicateFilesWindow_h
+
+#include <QDialog>
+#include <QTreeWidgetItem>
+
+#include "ui_duplicate-files-window.h"
+#include "DuplicateFilesFinder.h"
+#include "FileInfo.h"
+#include "Subtree.h"
+
+
+namespace QDirStat
+{
+    class DuplicateCandidatesTreeWalker;
+    class DuplicateGroupItem;
+    class TreeWalkerRunner;
+    class DirTree;
+
+
+    /**
+     * Modeless dialog to display groups of files with identical content.
+     *
+     * Finding them is done in two steps, both in other threads so the user
+     * interface remains responsive: A TreeWalkerRunner collects all
+     * non-empty files in the subtree, then a DuplicateFilesFinder reads
+     * the files that have the same size as others. Each group of identical
+     * files is added to the list as soon as it is confirmed.
+     *
+     * When the user clicks on one of the files, it is located in the main
+     * window, so the user can start cleanup actions on it there.
+     *
+     * Collecting the files is cancelled before the tree changes in any
+     * way; reading the files goes on.
+     **/
+    class DuplicateFilesWindow: public QDialog
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 *
+	 * Notice that this widget will destroy itself upon window close.
+	 *
+	 * It is advised to use a QPointer for storing a pointer to an instance
+	 * of this class. The QPointer will keep track of this window
+	 * auto-deleting itself when closed.
+	 **/
+	DuplicateFilesWindow( QWidget * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~DuplicateFilesWindow();
+
+	/**
+	 * Obtain the subtree from the last used URL or 0 if none was found.
+	 **/
+	const Subtree & subtree() const { return _subtree; }
+
+
+    public slots:
+
+	/**
+	 * Populate the window: Find the duplicate files in 'subtree'.
+	 *
+	 * This clears the old search results first, then starts searching in
+	 * other threads.
+	 **/
+	void populate( FileInfo * subtree = 0 );
+
+	/**
+	 * Cancel a running search (if there is one) and wait until it is
+	 * stopped.
+	 **/
+	void cancelSearch();
+
+	/**
+	 * Cancel collecting the candidates from the tree (if that is still
+	 * running) and wait until it is stopped. This is called before the
+	 * tree changes.
+	 **/
+	void cancelCollecting();
+
+	/**
+	 * Refresh (reload) all data.
+	 **/
+	void refresh();
+
+	/**
+	 * Reject the dialog contents, i.e. the user clicked the "Cancel" or
+	 * WM_CLOSE button. This not only closes the dialog, it also deletes
+	 * it.
+	 *
+	 * Reimplemented from QDialog.
+	 **/
+	virtual void reject() Q_DECL_OVERRIDE;
+
+
+    protected slots:
+
+	/**
+	 * Notification that collecting the candidates is finished: Start
+	 * the DuplicateFilesFinder.
+	 **/
+	void collectFinished();
+
+	/**
+	 * Add the groups of identical files that the DuplicateFilesFinder
+	 * found since the last call.
+	 **/
+	void addResults();
+
+	/**
+	 * Notification that the DuplicateFilesFinder is finished.
+	 **/
+	void searchFinished();
+
+	/**
+	 * Select one of the search results in the main window's tree and
+	 * treemap widgets via their SelectionModel.
+	 **/
+	void selectResult( QTreeWidgetItem * item );
+
+
+    protected:
+
+	/**
+	 * Clear all data and widget contents.
+	 **/
+	void clear();
+
+	/**
+	 * One-time initialization of the widgets in this window.
+	 **/
+	void initWidgets();
+
+	/**
+	 * Connect to the tree's signals to cancel the search before anything
+	 * in the tree changes.
+	 **/
+	void connectTree( DirTree * tree );
+
+	/**
+	 * Update the widgets for a running or stopped search.
+	 **/
+	void updateSearchStatus();
+
+	/**
+	 * Insert 'groupItem' before the first group with less wasted size.
+	 **/
+	void insertGroupItem( DuplicateGroupItem * groupItem );
+
+
+	//
+	// Data members
+	//
+
+	Ui::DuplicateFilesWindow *	_ui;
+	DuplicateCandidatesTreeWalker * _walker;
+	TreeWalkerRunner *		_runner;
+	DuplicateFilesFinder *		_finder;
+	DirTree *			_tree;
+	Subtree				_subtree;
+	int				_groupCount;
+	FileSize			_wastedSize;
+    };
+
+
+    /**
+     * Item class for the top level items of the list: One group of files
+     * with identical content. Like UnreadableDirListItem, the items store
+     * the paths, not FileInfo pointers that might become invalid.
+     *
+     * The files are sorted by path, and the groups are sorted by the
+     * disk space that could be saved by keeping only one of the files.
+     **/
+    class DuplicateGroupItem: public QTreeWidgetItem
+    {
+    public:
+
+	/**
+	 * Constructor. This adds an item for each file of 'group' as a
+	 * child.
+	 **/
+	DuplicateGroupItem( const DuplicateGroup & group );
+
+	/**
+	 * Return the size that could be saved by keeping only one file.
+	 **/
+	FileSize wastedSize() const { return _wastedSize; }
+
+    protected:
+
+	FileSize _wastedSize;
+    };
+
+
+    /**
+     * Item class for one file of a DuplicateGroupItem.
+     **/
+    class DuplicateFileItem: public QTreeWidgetItem
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	DuplicateFileItem( const DuplicateCandidate & file );
+
+	/**
+	 * Return the URL of this file.
+	 **/
+	QString url() const { return _url; }
+
+    protected:
+
+	QString _url;
+    };
+
+} // namespace QDirStat
+
+
+#endif // DuplicateFilesWindow_h
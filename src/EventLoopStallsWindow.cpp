@@ -0,0 +1,128 @@
+/*
+ *   File name: EventLoopStallsWindow.cpp
+ *   Summary:	QDirStat "event loop stalls" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "EventLoopStallsWindow.h"
+#include "StallWatchdog.h"
+#include "SettingsHelpers.h"
+#include "HeaderTweaker.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+using namespace QDirStat;
+
+
+EventLoopStallsWindow::EventLoopStallsWindow( QWidget * parent ):
+    QDialog( parent ),
+    _ui( new Ui::EventLoopStallsWindow )
+{
+    // logDebug() << "init" << endl;
+
+    CHECK_NEW( _ui );
+    _ui->setupUi( this );
+    initWidgets();
+    readWindowSettings( this, "EventLoopStallsWindow" );
+
+    connect( _ui->clearButton,	      SIGNAL( clicked()	      ),
+	     this,		      SLOT  ( clearStalls()   ) );
+
+    connect( StallWatchdog::instance(), SIGNAL( stallDetected() ),
+	     this,		      SLOT  ( populate()      ) );
+}
+
+
+EventLoopStallsWindow::~EventLoopStallsWindow()
+{
+    // logDebug() << "destroying" << endl;
+
+    writeWindowSettings( this, "EventLoopStallsWindow" );
+    delete _ui;
+}
+
+
+void EventLoopStallsWindow::initWidgets()
+{
+    QFont font = _ui->heading->font();
+    font.setBold( true );
+    _ui->heading->setFont( font );
+
+    QStringList headerLabels;
+    headerLabels << tr( "Time"		 )
+		 << tr( "Blocked"	 )
+		 << tr( "Operation"	 )
+		 << tr( "Operation Time" );
+
+    _ui->treeWidget->setColumnCount( headerLabels.size() );
+    _ui->treeWidget->setHeaderLabels( headerLabels );
+    _ui->treeWidget->setRootIsDecorated( false );
+    _ui->treeWidget->header()->setStretchLastSection( false );
+    HeaderTweaker::resizeToContents( _ui->treeWidget->header() );
+
+    QTreeWidgetItem * headerItem = _ui->treeWidget->headerItem();
+    headerItem->setTextAlignment( ES_BlockedCol,       Qt::AlignHCenter );
+    headerItem->setTextAlignment( ES_OperationTimeCol, Qt::AlignHCenter );
+
+    headerItem->setToolTip( ES_BlockedCol,	 tr( "How long the program did not react" ) );
+    headerItem->setToolTip( ES_OperationCol,	 tr( "The longest operation that ran during that time" ) );
+    headerItem->setToolTip( ES_OperationTimeCol, tr( "How long that operation took" ) );
+}
+
+
+void EventLoopStallsWindow::reject()
+{
+    deleteLater();
+}
+
+
+void EventLoopStallsWindow::clearStalls()
+{
+    StallWatchdog::instance()->clearStalls();
+    populate();
+}
+
+
+void EventLoopStallsWindow::populate()
+{
+    _ui->treeWidget->clear();
+
+    StallWatchdog * watchdog = StallWatchdog::instance();
+    const EventLoopStallList & stalls = watchdog->stalls();
+    QString blanks = QString( 3, ' ' ); // Enforce left margin
+
+    // The latest stall first
+
+    for ( int i = stalls.size() - 1; i >= 0; --i )
+    {
+	const EventLoopStall & stall = stalls.at( i );
+
+	QTreeWidgetItem * item = new QTreeWidgetItem( _ui->treeWidget );
+	CHECK_NEW( item );
+
+	item->setText( ES_TimeCol,	stall.time.toString( "yyyy-MM-dd hh:mm:ss" ) + "    " );
+	item->setText( ES_BlockedCol,	blanks + formatMillisec( stall.millisec ) );
+	item->setText( ES_OperationCol, stall.operation.isEmpty() ? tr( "Unknown" ) : stall.operation );
+
+	if ( stall.operationMillisec > 0 )
+	    item->setText( ES_OperationTimeCol, blanks + formatMillisec( stall.operationMillisec ) );
+
+	item->setTextAlignment( ES_BlockedCol,	     Qt::AlignRight );
+	item->setTextAlignment( ES_OperationTimeCol, Qt::AlignRight );
+    }
+
+    if ( watchdog->isActive() )
+    {
+	_ui->summaryLabel->setText( tr( "%1 stalls over %2" )
+				    .arg( stalls.size() )
+				    .arg( formatMillisec( watchdog->threshold() ) ) );
+    }
+    else
+    {
+	_ui->summaryLabel->setText( tr( "The watchdog is disabled" ) );
+    }
+}
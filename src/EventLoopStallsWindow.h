@@ -0,0 +1,100 @@
+/*
+ *   File name: EventLoopStallsWindow.h
+ *   Summary:	QDirStat "event loop stalls" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef EventLoopStallsWindow_h
+#define EventLoopStallsWindow_h
+
+#include <QDialog>
+
+#include "ui_event-loop-stalls-window.h"
+
+
+namespace QDirStat
+{
+    /**
+     * Modeless dialog to display the latest stalls of the GUI event loop
+     * that the StallWatchdog detected: When, how long, and which operation
+     * was blocking it. This is updated whenever there is a new stall.
+     **/
+    class EventLoopStallsWindow: public QDialog
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 *
+	 * Notice that this widget will destroy itself upon window close.
+	 *
+	 * It is advised to use a QPointer for storing a pointer to an instance
+	 * of this class. The QPointer will keep track of this window
+	 * auto-deleting itself when closed.
+	 **/
+	EventLoopStallsWindow( QWidget * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~EventLoopStallsWindow();
+
+
+    public slots:
+
+	/**
+	 * Populate the window with the stalls of the StallWatchdog.
+	 **/
+	void populate();
+
+	/**
+	 * Forget all stalls so far.
+	 **/
+	void clearStalls();
+
+	/**
+	 * Reject the dialog contents, i.e. the user clicked the "Cancel" or
+	 * WM_CLOSE button. This not only closes the dialog, it also deletes
+	 * it.
+	 *
+	 * Reimplemented from QDialog.
+	 **/
+	virtual void reject() Q_DECL_OVERRIDE;
+
+
+    protected:
+
+	/**
+	 * One-time initialization of the widgets in this window.
+	 **/
+	void initWidgets();
+
+
+	//
+	// Data members
+	//
+
+	Ui::EventLoopStallsWindow * _ui;
+    };
+
+
+    /**
+     * Column numbers for the event loop stalls tree widget
+     **/
+    enum EventLoopStallsColumns
+    {
+	ES_TimeCol = 0,
+	ES_BlockedCol,
+	ES_OperationCol,
+	ES_OperationTimeCol
+    };
+
+} // namespace QDirStat
+
+
+#endif // EventLoopStallsWindow_h
@@ -63,7 +63,9 @@ bool ExcludeRule::match( const QString & fullPath, const QString & fileName )
     if ( _regexp.pattern().isEmpty() )
 	return false;
 
-    return _regexp.exactMatch( matchText );
+    RuleStatsTimer timer;
+
+    return timer.add( &_stats, _regexp.exactMatch( matchText ) );
 }
 
 
@@ -75,6 +77,7 @@ bool ExcludeRule::matchDirectChildren( DirInfo * dir )
     if ( _regexp.pattern().isEmpty() )
         return false;
 
+    RuleStatsTimer timer;
     FileInfoIterator it( dir->dotEntry() ? dir->dotEntry() : dir );
 
     while ( *it )
@@ -82,13 +85,13 @@ bool ExcludeRule::matchDirectChildren( DirInfo * dir )
         if ( ! (*it)->isDir() )
         {
             if ( _regexp.exactMatch( (*it)->name() ) )
-                return true;
+                return timer.add( &_stats, true );
         }
 
         ++it;
     }
 
-    return false;
+    return timer.add( &_stats, false );
 }
 
 
@@ -103,6 +106,7 @@ ExcludeRules::ExcludeRules():
 {
     _lastMatchingRule  = 0;
     _defaultRulesAdded = false;
+    _compiledDirty     = true;
 }
 
 
@@ -112,6 +116,7 @@ ExcludeRules::ExcludeRules( const QStringList & paths ):
 {
     _lastMatchingRule  = 0;
     _defaultRulesAdded = false;
+    _compiledDirty     = true;
 
     foreach ( const QString & path, paths )
     {
@@ -151,6 +156,7 @@ void ExcludeRules::clear()
     qDeleteAll( _rules );
     _rules.clear();
     _lastMatchingRule = 0;
+    _compiledDirty    = true;
 }
 
 
@@ -158,6 +164,7 @@ void ExcludeRules::add( ExcludeRule * rule )
 {
     CHECK_PTR( rule );
     _rules << rule;
+    _compiledDirty = true;
 }
 
 
@@ -186,51 +193,165 @@ void ExcludeRules::remove( ExcludeRule * rule )
 
     _rules.removeAll( rule );
     delete rule;
+
+    if ( _lastMatchingRule == rule )
+	_lastMatchingRule = 0;
+
+    _compiledDirty = true;
+}
+
+
+void ExcludeRules::compile()
+{
+    _nameMatcher.clear();
+    _pathMatcher.clear();
+    _fileChildMatcher.clear();
+    _nameRules.clear();
+    _pathRules.clear();
+    _fileChildRules.clear();
+    _nameStats.clear();
+    _pathStats.clear();
+    _fileChildStats.clear();
+
+    for ( int i=0; i < _rules.size(); ++i )
+    {
+	ExcludeRule * rule = _rules.at( i );
+
+	if ( rule->regexp().pattern().isEmpty() )
+	    continue;
+
+	if ( rule->checkAnyFileChild() )
+	{
+	    _fileChildMatcher.add( rule->regexp() );
+	    _fileChildRules << i;
+	    _fileChildStats << &rule->stats();
+	}
+	else if ( rule->useFullPath() )
+	{
+	    _pathMatcher.add( rule->regexp() );
+	    _pathRules << i;
+	    _pathStats << &rule->stats();
+	}
+	else
+	{
+	    _nameMatcher.add( rule->regexp() );
+	    _nameRules << i;
+	    _nameStats << &rule->stats();
+	}
+    }
+
+    _compiledDirty = false;
+}
+
+
+bool ExcludeRules::hasFullPathRules()
+{
+    if ( _compiledDirty )
+	compile();
+
+    return ! _pathRules.isEmpty();
+}
+
+
+ExcludeRule * ExcludeRules::findMatch( const QString & fullPath,
+				       const QString & fileName,
+				       bool	       countStats )
+{
+    if ( _compiledDirty )
+	compile();
+
+    QVector<RuleStats *> noStats;
+    int index  = _nameMatcher.firstMatch( fileName, countStats ? _nameStats : noStats );
+    int ruleNo = index >= 0 ? _nameRules.at( index ) : -1;
+
+    if ( ! fullPath.isEmpty() && ! _pathRules.isEmpty() )
+    {
+	index = _pathMatcher.firstMatch( fullPath, countStats ? _pathStats : noStats );
+
+	// If both match, the rule that comes first in the list wins
+
+	if ( index >= 0 && ( ruleNo < 0 || _pathRules.at( index ) < ruleNo ) )
+	    ruleNo = _pathRules.at( index );
+    }
+
+    return ruleNo >= 0 ? _rules.at( ruleNo ) : 0;
 }
 
 
 bool ExcludeRules::match( const QString & fullPath, const QString & fileName )
 {
     _lastMatchingRule = 0;
-    if ( fullPath.isEmpty() || fileName.isEmpty() )
+    if ( fileName.isEmpty() )
 	return false;
 
-    foreach ( ExcludeRule * rule, _rules )
+    ExcludeRule * rule = findMatch( fullPath, fileName );
+
+    if ( rule )
     {
-	if ( rule->match( fullPath, fileName ) )
-	{
-	    _lastMatchingRule = rule;
+	_lastMatchingRule = rule;
 #if VERBOSE_EXCLUDE_MATCHES
 
-	    logDebug() << fullPath << " matches " << rule << endl;
+	logDebug() << ( fullPath.isEmpty() ? fileName : fullPath ) << " matches " << rule << endl;
 
 #endif
-	    return true;
-	}
+	return true;
     }
 
     return false;
 }
 
 
+bool ExcludeRules::hasFileChildRules()
+{
+    if ( _compiledDirty )
+	compile();
+
+    return ! _fileChildRules.isEmpty();
+}
+
+
+bool ExcludeRules::matchFileChild( const QString & fileName )
+{
+    _lastMatchingRule = 0;
+
+    if ( _compiledDirty )
+	compile();
+
+    int index = _fileChildMatcher.firstMatch( fileName, _fileChildStats );
+
+    if ( index < 0 )
+	return false;
+
+    _lastMatchingRule = _rules.at( _fileChildRules.at( index ) );
+
+    return true;
+}
+
+
 bool ExcludeRules::matchDirectChildren( DirInfo * dir )
 {
     _lastMatchingRule = 0;
-    if ( ! dir )
+    if ( ! dir || ! hasFileChildRules() )
 	return false;
 
-    foreach ( ExcludeRule * rule, _rules )
+    // Check each child once against all rules rather than each rule
+    // against all children; the first matching child wins.
+
+    FileInfoIterator it( dir->dotEntry() ? dir->dotEntry() : dir );
+
+    while ( *it )
     {
-	if ( rule->matchDirectChildren( dir ) )
+	if ( ! (*it)->isDir() && matchFileChild( (*it)->name() ) )
 	{
-	    _lastMatchingRule = rule;
 #if VERBOSE_EXCLUDE_MATCHES
 
-	    logDebug() << dir << " matches " << rule << endl;
+	    logDebug() << dir << " matches " << _lastMatchingRule << endl;
 
 #endif
 	    return true;
 	}
+
+	++it;
     }
 
     return false;
@@ -243,37 +364,55 @@ const ExcludeRule * ExcludeRules::matchingRule( const QString & fullPath,
     if ( fullPath.isEmpty() || fileName.isEmpty() )
 	return 0;
 
+    return findMatch( fullPath, fileName,
+		      false ); // countStats
+}
+
+
+void ExcludeRules::resetStats()
+{
     foreach ( ExcludeRule * rule, _rules )
-    {
-	if ( rule->match( fullPath, fileName ) )
-	    return rule;
-    }
+	rule->stats().reset();
+}
+
 
-    return 0;
+void ExcludeRules::logStats( const QString & title )
+{
+    if ( _rules.isEmpty() )
+	return;
+
+    logInfo() << title << endl;
+
+    foreach ( ExcludeRule * rule, _rules )
+	logInfo() << "  " << rule << ": " << rule->stats().toString() << endl;
 }
 
 
 void ExcludeRules::moveUp( ExcludeRule * rule )
 {
     _listMover.moveUp( rule );
+    _compiledDirty = true;
 }
 
 
 void ExcludeRules::moveDown( ExcludeRule * rule )
 {
     _listMover.moveDown( rule );
+    _compiledDirty = true;
 }
 
 
 void ExcludeRules::moveToTop( ExcludeRule * rule )
 {
     _listMover.moveToTop( rule );
+    _compiledDirty = true;
 }
 
 
 void ExcludeRules::moveToBottom( ExcludeRule * rule )
 {
     _listMover.moveToBottom( rule );
+    _compiledDirty = true;
 }
 
 
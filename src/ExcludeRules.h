@@ -17,6 +17,8 @@
 #include <QTextStream>
 
 #include "ListMover.h"
+#include "MultiPatternMatcher.h"
+#include "RuleStats.h"
 
 
 namespace QDirStat
@@ -117,11 +119,19 @@ namespace QDirStat
          **/
         void setCheckAnyFileChild( bool check ) { _checkAnyFileChild = check; }
 
+	/**
+	 * Return the counters of how often this rule was evaluated and
+	 * matched and how long that took (if counting is enabled; see
+	 * RuleStats).
+	 **/
+	RuleStats & stats() { return _stats; }
+
     private:
 
 	QRegExp _regexp;
 	bool	_useFullPath;
         bool    _checkAnyFileChild;
+	RuleStats _stats;
     };
 
 
@@ -201,14 +211,27 @@ namespace QDirStat
 	 * Check a file name against the exclude rules. Each exclude rule
 	 * decides individually based on its configuration if it checks against
 	 * the full path or against the file name without path, so both have to
-	 * be provided here.
+	 * be provided here. If 'fullPath' is empty, only the rules that don't
+	 * use the full path are checked; see hasFullPathRules().
 	 *
 	 * This will return 'true' if the text matches any rule.
 	 *
-	 * Note that this operation will move current().
+	 * The rules are not tried one by one; see compile().
 	 **/
 	bool match( const QString & fullPath, const QString & fileName );
 
+	/**
+	 * Return 'true' if any rule uses the full path for matching. If not,
+	 * callers don't need to build the full path for match().
+	 **/
+	bool hasFullPathRules();
+
+	/**
+	 * Notification that a rule of this rule set was changed directly
+	 * (with ExcludeRule::setRegexp() etc.).
+	 **/
+	void rulesChanged() { _compiledDirty = true; }
+
         /**
          * Check the direct non-directory children of 'dir' against any rules
          * that have the 'checkAnyFileChild' flag set.
@@ -217,6 +240,23 @@ namespace QDirStat
          **/
         bool matchDirectChildren( DirInfo * dir );
 
+	/**
+	 * Check the name of one non-directory child of a directory against
+	 * the rules that have the 'checkAnyFileChild' flag set. This is
+	 * meant to be called for each entry while reading a directory, so
+	 * the directory doesn't need to be scanned again afterwards with
+	 * matchDirectChildren(). It is only a hash lookup for rules with a
+	 * fixed file name like "CACHEDIR.TAG" or ".nobackup".
+	 *
+	 * This will return 'true' if the name matches any rule.
+	 **/
+	bool matchFileChild( const QString & fileName );
+
+	/**
+	 * Return 'true' if any rule has the 'checkAnyFileChild' flag set.
+	 **/
+	bool hasFileChildRules();
+
 	/**
 	 * Find the exclude rule that matches 'text'.
 	 * Return 0 if there is no match.
@@ -253,6 +293,16 @@ namespace QDirStat
 	 **/
 	ExcludeRuleListIterator end()	{ return _rules.constEnd(); }
 
+	/**
+	 * Set the counters of all rules (see RuleStats) back to zero.
+	 **/
+	void resetStats();
+
+	/**
+	 * Write the counters of all rules to the log, 'title' first.
+	 **/
+	void logStats( const QString & title );
+
     public slots:
 
 	/**
@@ -293,12 +343,44 @@ namespace QDirStat
          **/
         void addDefaultRules();
 
+	/**
+	 * Put the patterns of all rules that match the name, the full path
+	 * or any file child into one MultiPatternMatcher for each, so
+	 * matching doesn't
+	 * need to try every rule: Literal patterns are just a hash lookup,
+	 * most wildcards are ruled out by their literal prefix or suffix,
+	 * and only the remaining candidates are tried with their QRegExp.
+	 *
+	 * This is done lazily with the next match after any change.
+	 **/
+	void compile();
+
+	/**
+	 * Return the first rule in the list that matches 'fullPath' or
+	 * 'fileName' or 0 if there is none. If 'countStats' is 'true', this
+	 * is counted in the statistics of the rules.
+	 **/
+	ExcludeRule * findMatch( const QString & fullPath,
+				 const QString & fileName,
+				 bool		 countStats = true );
+
     private:
 
 	ExcludeRuleList		 _rules;
 	ListMover<ExcludeRule *> _listMover;
 	ExcludeRule *		 _lastMatchingRule;
         bool                     _defaultRulesAdded;
+
+	bool			 _compiledDirty;
+	MultiPatternMatcher	 _nameMatcher;
+	MultiPatternMatcher	 _pathMatcher;
+	QVector<int>		 _nameRules;	// index in _rules for each name pattern
+	QVector<int>		 _pathRules;	// index in _rules for each path pattern
+	MultiPatternMatcher	 _fileChildMatcher;
+	QVector<int>		 _fileChildRules; // index in _rules for each file child pattern
+	QVector<RuleStats *>	 _nameStats;	// for each name pattern
+	QVector<RuleStats *>	 _pathStats;	// for each path pattern
+	QVector<RuleStats *>	 _fileChildStats; // for each file child pattern
     };
 
 
@@ -105,6 +105,7 @@ void ExcludeRulesConfigPage::patternChanged( const QString & newPattern )
 	QRegExp regexp = excludeRule->regexp();
 	regexp.setPattern( newPattern );
 	excludeRule->setRegexp( regexp );
+	ExcludeRules::instance()->rulesChanged();
 	currentItem->setText( excludeRule->regexp().pattern() );
     }
 }
@@ -138,6 +139,7 @@ void ExcludeRulesConfigPage::save( void * value )
     excludeRule->setRegexp( regexp );
     excludeRule->setUseFullPath( _ui->fullPathRadioButton->isChecked() );
     excludeRule->setCheckAnyFileChild( _ui->checkAnyFileChildRadioButton->isChecked() );
+    ExcludeRules::instance()->rulesChanged();
 }
 
 
@@ -153,6 +155,7 @@ void ExcludeRulesConfigPage::load( void * value )
     {
         enableEditRuleWidgets( false );
         _ui->patternLineEdit->setText( "" );
+	_ui->statsLabel->clear();
 
 	return;
     }
@@ -180,6 +183,11 @@ void ExcludeRulesConfigPage::load( void * value )
 
     if ( excludeRule->checkAnyFileChild() )
         _ui->checkAnyFileChildRadioButton->setChecked( true );
+
+    if ( RuleStats::enabled() )
+	_ui->statsLabel->setText( tr( "Last read: %1" ).arg( excludeRule->stats().toString() ) );
+    else
+	_ui->statsLabel->clear();
 }
 
 
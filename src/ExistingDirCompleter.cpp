@@ -7,9 +7,12 @@
  */
 
 
-#include <QFileSystemModel>
+#include <QStringListModel>
+#include <QMetaObject>
+#include <QWidget>
 
 #include "ExistingDirCompleter.h"
+#include "DirListingCache.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -20,14 +23,12 @@ using namespace QDirStat;
 ExistingDirCompleter::ExistingDirCompleter( QObject * parent ):
     QCompleter( parent )
 {
-    QFileSystemModel * model = new QFileSystemModel( this );
-    CHECK_NEW( model );
+    _model = new QStringListModel( this );
+    CHECK_NEW( _model );
+    setModel( _model );
 
-    model->setRootPath( "/" );
-    model->setFilter( QDir::Dirs );
-    model->setReadOnly( true );
-
-    setModel( model );
+    connect( DirListingCache::instance(), SIGNAL( dirListed( QString, QStringList ) ),
+             this,                        SLOT  ( dirListed( QString, QStringList ) ) );
 }
 
 
@@ -36,3 +37,56 @@ ExistingDirCompleter::~ExistingDirCompleter()
     // NOP
 }
 
+
+QStringList ExistingDirCompleter::splitPath( const QString & path ) const
+{
+    _prefix = path;
+    int slash = path.lastIndexOf( '/' );
+    QString dir = slash >= 0 ? path.left( slash + 1 ) : QString();
+
+    if ( dir != _typedDir )
+    {
+        // Don't change the model while it is being matched against
+
+        _typedDir = dir;
+        QMetaObject::invokeMethod( const_cast<ExistingDirCompleter *>( this ),
+                                   "updateDir", Qt::QueuedConnection );
+    }
+
+    return QCompleter::splitPath( path );
+}
+
+
+void ExistingDirCompleter::updateDir()
+{
+    if ( _typedDir == _dir )
+        return;
+
+    QStringList subDirs;
+
+    if ( _typedDir.isEmpty() )
+        dirListed( _typedDir, subDirs );
+    else if ( DirListingCache::instance()->lookupSubDirs( _typedDir, subDirs ) )
+        dirListed( _typedDir, subDirs );
+}
+
+
+void ExistingDirCompleter::dirListed( const QString & dir, const QStringList & subDirs )
+{
+    if ( dir != _typedDir )
+        return;
+
+    QStringList paths;
+
+    foreach ( const QString & subDir, subDirs )
+        paths << dir + subDir;
+
+    _dir = dir;
+    _model->setStringList( paths );
+
+    if ( widget() && widget()->hasFocus() && ! _prefix.isEmpty() )
+    {
+        setCompletionPrefix( _prefix );
+        complete();
+    }
+}
@@ -14,12 +14,20 @@
 #include <QCompleter>
 
 
+class QStringListModel;
+
+
 namespace QDirStat
 {
     /**
      * Completer class for QCombobox and related to complete names of existing
      * directories.
      *
+     * The subdirectories of the directory that is being typed are listed
+     * asynchronously with the DirListingCache, so a path on an automounter
+     * or a hung NFS server does not freeze the widget; the completions show
+     * up when the listing is there.
+     *
      * See ShowUnpkgFilesDialog for a usage example.
      **/
     class ExistingDirCompleter: public QCompleter
@@ -38,6 +46,37 @@ namespace QDirStat
          **/
         virtual ~ExistingDirCompleter();
 
+        /**
+         * Split 'path' for matching against the model. This also starts
+         * listing the directory of 'path' if that is a different one than
+         * before.
+         *
+         * Reimplemented from QCompleter.
+         **/
+        virtual QStringList splitPath( const QString & path ) const Q_DECL_OVERRIDE;
+
+
+    protected slots:
+
+        /**
+         * Use the subdirectories of 'dir' for completion if that is still
+         * the directory that is being typed.
+         **/
+        void dirListed( const QString & dir, const QStringList & subDirs );
+
+        /**
+         * Look up the directory that is being typed in the cache.
+         **/
+        void updateDir();
+
+
+    protected:
+
+        QStringListModel * _model;
+        QString            _dir;        // with trailing slash
+        mutable QString    _typedDir;
+        mutable QString    _prefix;
+
     };  // class ExistingDirCompleter
 
 }       // namespace QDirStat
@@ -7,9 +7,8 @@
  */
 
 
-#include <QDir>
-
 #include "ExistingDirValidator.h"
+#include "DirListingCache.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -20,6 +19,8 @@ using namespace QDirStat;
 ExistingDirValidator::ExistingDirValidator( QObject * parent ):
     QValidator( parent )
 {
+    connect( DirListingCache::instance(), SIGNAL( dirChecked( QString, bool ) ),
+	     this,			  SLOT	( dirChecked( QString, bool ) ) );
 }
 
 
@@ -34,7 +35,15 @@ ExistingDirValidator::validate( QString & input, int & pos) const
 {
     Q_UNUSED( pos );
 
-    bool ok = ! input.isEmpty() && QDir( input ).exists();
+    bool ok = false;
+    _pendingInput.clear();
+
+    if ( ! input.isEmpty() && ! DirListingCache::instance()->lookupDir( input, ok ) )
+    {
+	// Not known yet: dirChecked() will tell
+
+	_pendingInput = input;
+    }
 
     // This is a complex way to do
     //    emit isOk( ok );
@@ -50,3 +59,15 @@ ExistingDirValidator::validate( QString & input, int & pos) const
 
     return ok ? QValidator::Acceptable : QValidator::Intermediate;
 }
+
+
+void ExistingDirValidator::dirChecked( const QString & path, bool exists )
+{
+    if ( path == _pendingInput )
+    {
+	if ( exists )
+	    _pendingInput.clear();
+
+	emit isOk( exists );
+    }
+}
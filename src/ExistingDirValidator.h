@@ -19,6 +19,10 @@ namespace QDirStat
      * Validator class for QCombobox and related to validate names of existing
      * directories.
      *
+     * The directories are checked asynchronously with the DirListingCache:
+     * A directory that is not in the cache yet is 'Intermediate' at first,
+     * and isOk() is emitted again when the check is done.
+     *
      * See ShowUnpkgFilesDialog for a usage example.
      **/
     class ExistingDirValidator: public QValidator
@@ -47,6 +51,19 @@ namespace QDirStat
 
 	void isOk( bool ok );
 
+
+    protected slots:
+
+	/**
+	 * Notification that it is known if directory 'path' exists.
+	 **/
+	void dirChecked( const QString & path, bool exists );
+
+
+    protected:
+
+	mutable QString _pendingInput;
+
     };	// class ExistingDirValidator
 
 }	// namespace QDirStat
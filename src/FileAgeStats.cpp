@@ -8,9 +8,12 @@
 
 #include <algorithm>    // std::sort()
 #include <QDate>
+#include <QTimer>
 
 #include "FileAgeStats.h"
 #include "FileInfoIterator.h"
+#include "DirInfo.h"
+#include "DirTree.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -22,7 +25,14 @@ short FileAgeStats::_thisMonth = 0;
 short FileAgeStats::_lastYear  = 0;
 
 
-FileAgeStats::FileAgeStats( FileInfo * subtree )
+FileAgeStats::FileAgeStats( FileInfo * subtree, QObject * parent ):
+    QObject( parent ),
+    _subtree( 0 ),
+    _tree( 0 ),
+    _clearingDir( 0 ),
+    _clearingAncestor( false ),
+    _percentagesDirty( false ),
+    _changedPending( false )
 {
     clear();
 
@@ -39,14 +49,17 @@ FileAgeStats::~FileAgeStats()
 
 void FileAgeStats::clear()
 {
+    forgetSubtree();
+
     _yearStats.clear();
     _yearsList.clear();
 
     clearMonthStats( thisYear() );
     clearMonthStats( lastYear() );
 
-    _totalFilesCount = 0;
-    _totalFilesSize  = 0;
+    _totalFilesCount  = 0;
+    _totalFilesSize   = 0;
+    _percentagesDirty = false;
 }
 
 
@@ -54,7 +67,7 @@ void FileAgeStats::clearMonthStats( short year )
 {
     for ( int month = 1; month <= 12; month++ )
     {
-        YearStats * stats = monthStats( year, month );
+        YearStats * stats = rawMonthStats( year, month );
 
         if ( stats )
             *stats = YearStats( year, month );
@@ -65,49 +78,337 @@ void FileAgeStats::clearMonthStats( short year )
 void FileAgeStats::collect( FileInfo * subtree )
 {
     clear();
-    collectRecursive( subtree );
+
+    if ( subtree && subtree->isDirInfo() && subtree->tree() &&
+         subtree->tree()->cacheFileAgeSummaries() )
+    {
+        addSummary( subtree->toDirInfo()->fileAgeSummary() );
+    }
+    else
+    {
+        collectSubtree( subtree );
+    }
+
     calcPercentages();
     collectYears();
+
+    _subtree = subtree;
+    _tree    = subtree ? subtree->tree() : 0;
+
+    if ( _tree )
+    {
+        connect( _tree, SIGNAL( deletingChild   ( FileInfo * ) ),
+                 this,  SLOT  ( deletingChild   ( FileInfo * ) ) );
+
+        connect( _tree, SIGNAL( childrenAdded   ( FileInfoList ) ),
+                 this,  SLOT  ( childrenAdded   ( FileInfoList ) ) );
+
+        connect( _tree, SIGNAL( clearingSubtree ( DirInfo *  ) ),
+                 this,  SLOT  ( clearingSubtree ( DirInfo *  ) ) );
+
+        connect( _tree, SIGNAL( subtreeCleared  ( DirInfo *  ) ),
+                 this,  SLOT  ( subtreeCleared  ( DirInfo *  ) ) );
+
+        connect( _tree, SIGNAL( clearing()      ),
+                 this,  SLOT  ( forgetSubtree() ) );
+    }
+}
+
+
+void FileAgeStats::forgetSubtree()
+{
+    if ( _tree )
+        disconnect( _tree, 0, this, 0 );
+
+    _subtree     = 0;
+    _tree        = 0;
+    _clearingDir = 0;
+}
+
+
+void FileAgeStats::deletingChild( FileInfo * child )
+{
+    if ( ! _subtree )
+        return;
+
+    if ( _subtree->isInSubtree( child ) )
+    {
+        // The subtree itself is about to be deleted. Just keep the current
+        // data; they can't get any more current.
+
+        forgetSubtree();
+    }
+    else if ( isCollected( child ) )
+    {
+        addSubtree( child, -1 );
+    }
 }
 
 
-void FileAgeStats::collectRecursive( FileInfo * dir )
+void FileAgeStats::childrenAdded( const FileInfoList & newChildren )
 {
-    if ( ! dir )
-	return;
+    bool changed = false;
 
-    FileInfoIterator it( dir );
+    foreach ( FileInfo * newChild, newChildren )
+    {
+        if ( newChild->isFile() && isCollected( newChild ) )
+        {
+            addFile( newChild, 1 );
+            changed = true;
+        }
+    }
 
-    while ( *it )
+    if ( changed )
+        statsChanged();
+}
+
+
+void FileAgeStats::clearingSubtree( DirInfo * dir )
+{
+    // This is also sent for an incremental refresh that keeps the children
+    // (and then deletes or adds just the ones that changed), so only
+    // remember what would be removed and apply it in subtreeCleared() if
+    // the children are really gone.
+
+    _clearingDir      = 0;
+    _clearingAncestor = false;
+    _clearingSummary  = FileAgeSummary();
+
+    if ( ! _subtree )
+        return;
+
+    if ( dir != _subtree && _subtree->isInSubtree( dir ) )
+    {
+        _clearingDir      = dir;
+        _clearingAncestor = true;
+    }
+    else if ( isCollected( dir ) )
     {
-	FileInfo * item = *it;
+        _clearingDir = dir;
+        FileInfoIterator it( dir );
 
-        if ( item && item->isFile() )
+        while ( *it )
         {
-            short year  = item->mtimeYear();
-            short month = item->mtimeMonth();
+            summarize( *it, _clearingSummary );
+            ++it;
+        }
+    }
+}
+
+
+void FileAgeStats::subtreeCleared( DirInfo * dir )
+{
+    if ( ! dir || dir != _clearingDir )
+        return;
+
+    _clearingDir = 0;
+
+    if ( dir->hasChildren() )   // Incremental refresh
+        return;
+
+    if ( _clearingAncestor )
+    {
+        // The subtree was deleted along with the children of 'dir'
+
+        forgetSubtree();
+    }
+    else
+    {
+        // The children will be added again (along with childrenAdded()) when
+        // the directory is read again
+
+        addSummary( &_clearingSummary, -1 );
+        statsChanged();
+    }
+
+    _clearingSummary = FileAgeSummary();
+}
+
+
+bool FileAgeStats::isCollected( FileInfo * item ) const
+{
+    if ( ! _subtree )
+        return false;
+
+    for ( FileInfo * current = item; current; current = current->parent() )
+    {
+        if ( current == _subtree )
+            return true;
+
+        if ( current->isAttic() )
+            return false;
+    }
 
-            YearStats &yearStats = _yearStats[ year ];
+    return false;
+}
+
+
+void FileAgeStats::addSubtree( FileInfo * subtree, int sign )
+{
+    FileAgeSummary summary;
+    summarize( subtree, summary );
 
-            yearStats.year = year;
-            yearStats.filesCount++;
-            yearStats.size += item->size();
+    if ( ! summary.entries().isEmpty() )
+    {
+        addSummary( &summary, sign );
+        statsChanged();
+    }
+}
 
-            YearStats * monthStats = this->monthStats( year, month );
 
-            if ( monthStats )
-            {
-                monthStats->filesCount++;
-                monthStats->size += item->size();
-            }
+void FileAgeStats::summarize( FileInfo * subtree, FileAgeSummary & summary ) const
+{
+    if ( subtree->isFile() )
+    {
+        summary.addFile( subtree );
+    }
+    else if ( subtree->isAttic() )
+    {
+        return;
+    }
+    else if ( subtree->isDirInfo() && _tree && _tree->cacheFileAgeSummaries() )
+    {
+        summary.add( *subtree->toDirInfo()->fileAgeSummary() );
+    }
+    else
+    {
+        FileInfoIterator it( subtree );
+
+        while ( *it )
+        {
+            summarize( *it, summary );
+            ++it;
         }
+    }
+}
+
 
-	if ( item->hasChildren() )
-	{
-	    collectRecursive( item );
-	}
+void FileAgeStats::statsChanged()
+{
+    _percentagesDirty = true;
 
-        ++it;
+    if ( ! _changedPending )
+    {
+        _changedPending = true;
+        QTimer::singleShot( 0, this, SLOT( emitChanged() ) );
+    }
+}
+
+
+void FileAgeStats::emitChanged()
+{
+    _changedPending = false;
+    emit changed();
+}
+
+
+void FileAgeStats::updatePercentages()
+{
+    if ( _percentagesDirty )
+    {
+        _percentagesDirty = false;
+
+        // Remove the years that don't have any files left
+
+        YearStatsHash::iterator it = _yearStats.begin();
+
+        while ( it != _yearStats.end() )
+        {
+            if ( it.value().filesCount <= 0 )
+                it = _yearStats.erase( it );
+            else
+                ++it;
+        }
+
+        calcPercentages();
+        collectYears();
+    }
+}
+
+
+void FileAgeStats::addSummary( const FileAgeSummary * summary, int sign )
+{
+    if ( ! summary )
+        return;
+
+    foreach ( const FileAgeSummary::Entry & entry, summary->entries() )
+    {
+        YearStats * stats = 0;
+
+        if ( entry.month == 0 )
+        {
+            stats = &( _yearStats[ entry.year ] );
+            stats->year = entry.year;
+        }
+        else
+        {
+            stats = rawMonthStats( entry.year, entry.month );
+        }
+
+        if ( stats )
+        {
+            stats->filesCount += sign * entry.filesCount;
+            stats->size       += sign * entry.size;
+        }
+    }
+}
+
+
+SubtreeCollector * FileAgeStats::createPartial() const
+{
+    FileAgeStats * partial = new FileAgeStats();
+    CHECK_NEW( partial );
+
+    return partial;
+}
+
+
+void FileAgeStats::collectFile( FileInfo * file )
+{
+    addFile( file, 1 );
+}
+
+
+void FileAgeStats::addFile( FileInfo * file, int sign )
+{
+    short year  = file->mtimeYear();
+    short month = file->mtimeMonth();
+
+    YearStats &yearStats = _yearStats[ year ];
+
+    yearStats.year        = year;
+    yearStats.filesCount += sign;
+    yearStats.size       += sign * file->size();
+
+    YearStats * monthStats = rawMonthStats( year, month );
+
+    if ( monthStats )
+    {
+        monthStats->filesCount += sign;
+        monthStats->size       += sign * file->size();
+    }
+}
+
+
+void FileAgeStats::merge( SubtreeCollector * partial )
+{
+    FileAgeStats * other = static_cast<FileAgeStats *>( partial );
+
+    foreach ( const YearStats & otherStats, other->_yearStats )
+    {
+        YearStats & stats = _yearStats[ otherStats.year ];
+
+        stats.year        = otherStats.year;
+        stats.filesCount += otherStats.filesCount;
+        stats.size       += otherStats.size;
+    }
+
+    for ( int i=0; i < 12; ++i )
+    {
+        _thisYearMonthStats[ i ].filesCount += other->_thisYearMonthStats[ i ].filesCount;
+        _thisYearMonthStats[ i ].size       += other->_thisYearMonthStats[ i ].size;
+        _lastYearMonthStats[ i ].filesCount += other->_lastYearMonthStats[ i ].filesCount;
+        _lastYearMonthStats[ i ].size       += other->_lastYearMonthStats[ i ].size;
     }
 }
 
@@ -152,7 +453,7 @@ void FileAgeStats::calcMonthPercentages( short year )
 
     for ( int month = 1; month <= 12; month++ )
     {
-        YearStats * stats = monthStats( year, month );
+        YearStats * stats = rawMonthStats( year, month );
 
         if ( stats )
         {
@@ -173,8 +474,18 @@ void FileAgeStats::collectYears()
 }
 
 
+const YearsList & FileAgeStats::years()
+{
+    updatePercentages();
+
+    return _yearsList;
+}
+
+
 YearStats * FileAgeStats::yearStats( short year )
 {
+    updatePercentages();
+
     if ( _yearStats.contains( year ) )
         return &( _yearStats[ year ] );
     else
@@ -183,6 +494,14 @@ YearStats * FileAgeStats::yearStats( short year )
 
 
 YearStats * FileAgeStats::monthStats( short year, short month )
+{
+    updatePercentages();
+
+    return rawMonthStats( year, month );
+}
+
+
+YearStats * FileAgeStats::rawMonthStats( short year, short month )
 {
     YearStats * stats = 0;
 
@@ -229,3 +548,63 @@ short FileAgeStats::lastYear()
 
     return _lastYear;
 }
+
+
+
+void FileAgeSummary::addFile( FileInfo * file, int sign )
+{
+    short year  = file->mtimeYear();
+    short month = file->mtimeMonth();
+
+    add( year, 0,     sign, sign * file->size() );
+    add( year, month, sign, sign * file->size() );
+}
+
+
+void FileAgeSummary::add( const FileAgeSummary & other, int sign )
+{
+    foreach ( const Entry & entry, other._entries )
+        add( entry.year, entry.month, sign * entry.filesCount, sign * entry.size );
+}
+
+
+void FileAgeSummary::add( short year, short month, int filesCount, FileSize size )
+{
+    // Binary search for the entry; there are only a few dozen of them
+
+    int first = 0;
+    int last  = _entries.size();
+
+    while ( first < last )
+    {
+        int mid = ( first + last ) / 2;
+        const Entry & entry = _entries.at( mid );
+
+        if ( entry.year < year || ( entry.year == year && entry.month < month ) )
+            first = mid + 1;
+        else
+            last = mid;
+    }
+
+    if ( first < _entries.size() &&
+         _entries.at( first ).year  == year &&
+         _entries.at( first ).month == month )
+    {
+        Entry & entry = _entries[ first ];
+        entry.filesCount += filesCount;
+        entry.size       += size;
+
+        if ( entry.filesCount <= 0 )
+            _entries.remove( first );
+    }
+    else if ( filesCount > 0 )
+    {
+        Entry entry;
+        entry.year       = year;
+        entry.month      = month;
+        entry.filesCount = filesCount;
+        entry.size       = size;
+
+        _entries.insert( first, entry );
+    }
+}
@@ -10,14 +10,19 @@
 #ifndef FileAgeStats_h
 #define FileAgeStats_h
 
+#include <QObject>
 #include <QHash>
 #include <QList>
+#include <QVector>
 
 #include "FileInfo.h"
+#include "SubtreeCollector.h"
 
 
 namespace QDirStat
 {
+    class DirTree;
+    class DirInfo;
     class YearStats;
     typedef QHash<short, YearStats>     YearStatsHash;
     typedef QList<short>                YearsList;
@@ -49,19 +54,81 @@ namespace QDirStat
     };  // class YearStats
 
 
+    /**
+     * Compact summary of the modification years of the files in a
+     * directory subtree for DirInfo::fileAgeSummary(): The number and the
+     * total size of the files for each year and for each month. Only the
+     * years and months that have any files are stored.
+     *
+     * The months are kept for all years, not just for this year and the
+     * last year, so a summary is still valid when the year changes.
+     *
+     * The summary of a directory is the sum of the summaries of its
+     * subdirectories plus its own files, so it can be updated when files or
+     * subtrees are added or removed.
+     **/
+    class FileAgeSummary
+    {
+    public:
+
+        struct Entry
+        {
+            short       year;
+            short       month;          // 1-12 or 0 for the complete year
+            int         filesCount;
+            FileSize    size;
+        };
+
+        /**
+         * Add 'file' if 'sign' is 1 or subtract it if it is -1.
+         **/
+        void addFile( FileInfo * file, int sign = 1 );
+
+        /**
+         * Add all of 'other' if 'sign' is 1 or subtract it if it is -1.
+         **/
+        void add( const FileAgeSummary & other, int sign = 1 );
+
+        /**
+         * Return the entries sorted by year and month.
+         **/
+        const QVector<Entry> & entries() const { return _entries; }
+
+    protected:
+
+        /**
+         * Add 'filesCount' and 'size' to the entry for 'year' and 'month'.
+         * Entries that have no files left are removed.
+         **/
+        void add( short year, short month, int filesCount, FileSize size );
+
+        QVector<Entry>  _entries;
+
+    };  // class FileAgeSummary
+
+
     /**
      * Class for calculating and storing file age statistics, i.e. statistics
      * about the years of the last modification times of files in a subtree.
+     *
+     * After collecting, this keeps track of the changes of the subtree in
+     * the DirTree: Files that are deleted (e.g. by a cleanup) are
+     * subtracted and files that are added (e.g. when refreshing a
+     * directory) are added, so the statistics stay current without
+     * collecting everything again. The percentages are calculated again
+     * when they are needed.
      **/
-    class FileAgeStats
+    class FileAgeStats: public QObject, public SubtreeCollector
     {
+        Q_OBJECT
+
     public:
 
 	/**
 	 * Constructor. If 'subtree' is non-null, immediately collect data from
 	 * that subtree.
 	 **/
-        FileAgeStats( FileInfo * subtree = 0 );
+        FileAgeStats( FileInfo * subtree = 0, QObject * parent = 0 );
 
         /**
          * Destructor.
@@ -70,20 +137,34 @@ namespace QDirStat
 
         /**
          * Recurse through all file elements in the subtree and calculate the
-         * data for that subtree.
+         * data for that subtree. Large subtrees are collected in several
+         * threads.
+         *
+         * If the tree has cacheFileAgeSummaries(), this uses the summary of
+         * the subtree instead, which only needs a traversal the first time.
+         *
+         * From now on, changes in that subtree are applied to the
+         * statistics until the subtree or one of its ancestors is deleted
+         * or cleared.
          **/
     	void collect( FileInfo * subtree );
 
         /**
-         * Clear all internal data.
+         * Clear all internal data and stop keeping track of the subtree.
          **/
         void clear();
 
+        /**
+         * Return the subtree that the statistics are kept up to date for or
+         * 0 if there is none (any more).
+         **/
+        FileInfo * subtree() const { return _subtree; }
+
         /**
          * Return a sorted list of the years where files with that modification
          * year were found after collecting data.
          **/
-        const YearsList & years() { return _yearsList; }
+        const YearsList & years();
 
         /**
          * Return year statistics for the specified year or 0 if there are
@@ -123,6 +204,52 @@ namespace QDirStat
         static short lastYear();
 
 
+    signals:
+
+        /**
+         * Emitted some time after files in the subtree were deleted or
+         * added and the statistics were updated. Many changes in a row
+         * (e.g. from a cleanup with many files) are reported only once.
+         **/
+        void changed();
+
+
+    protected slots:
+
+        /**
+         * Subtract 'child' if it is in the subtree, or stop keeping track
+         * of the subtree if 'child' is the subtree itself or an ancestor.
+         **/
+        void deletingChild( FileInfo * child );
+
+        /**
+         * Add those of 'newChildren' that are files in the subtree.
+         **/
+        void childrenAdded( const FileInfoList & newChildren );
+
+        /**
+         * Prepare subtracting the children of 'dir' if it is in the subtree
+         * or forgetting the subtree if 'dir' is an ancestor.
+         **/
+        void clearingSubtree( DirInfo * dir );
+
+        /**
+         * Subtract the children of 'dir' or forget the subtree if the
+         * children of 'dir' were really deleted.
+         **/
+        void subtreeCleared( DirInfo * dir );
+
+        /**
+         * Stop keeping track of the subtree because the tree is cleared.
+         **/
+        void forgetSubtree();
+
+        /**
+         * Emit the changed() signal.
+         **/
+        void emitChanged();
+
+
     protected:
 
         /**
@@ -131,10 +258,72 @@ namespace QDirStat
         void clearMonthStats( short year );
 
         /**
-         * Recurse through all file elements in the subtree and calculate the
-         * data for that subtree.
+         * Add the years and months of 'summary' if 'sign' is 1 or subtract
+         * them if it is -1.
          **/
-    	void collectRecursive( FileInfo * subtree );
+        void addSummary( const FileAgeSummary * summary, int sign = 1 );
+
+        /**
+         * Add 'file' to the statistics of its year and month if 'sign' is 1
+         * or subtract it if it is -1.
+         **/
+        void addFile( FileInfo * file, int sign );
+
+        /**
+         * Add or subtract all files in 'subtree', not counting any attics.
+         **/
+        void addSubtree( FileInfo * subtree, int sign );
+
+        /**
+         * Add all files in 'subtree' to 'summary', not counting any attics.
+         **/
+        void summarize( FileInfo * subtree, FileAgeSummary & summary ) const;
+
+        /**
+         * Return 'true' if 'item' is in the collected subtree, not counting
+         * any attics.
+         **/
+        bool isCollected( FileInfo * item ) const;
+
+        /**
+         * Mark the percentages as outdated and schedule the changed()
+         * signal.
+         **/
+        void statsChanged();
+
+        /**
+         * Calculate the percentages and the list of years again if anything
+         * changed since the last time.
+         **/
+        void updatePercentages();
+
+        /**
+         * Return the month statistics for the specified year and month
+         * or 0 if there are none without calculating the percentages.
+         **/
+        YearStats * rawMonthStats( short year, short month );
+
+        /**
+         * Create an empty FileAgeStats object for collecting in another
+         * thread.
+         *
+         * Implemented from SubtreeCollector.
+         **/
+        virtual SubtreeCollector * createPartial() const Q_DECL_OVERRIDE;
+
+        /**
+         * Add 'file' to the statistics of its year and month.
+         *
+         * Implemented from SubtreeCollector.
+         **/
+        virtual void collectFile( FileInfo * file ) Q_DECL_OVERRIDE;
+
+        /**
+         * Add the year and month statistics of 'partial'.
+         *
+         * Implemented from SubtreeCollector.
+         **/
+        virtual void merge( SubtreeCollector * partial ) Q_DECL_OVERRIDE;
 
         /**
          * Sum up the totals over all years and calculate the percentages for
@@ -167,6 +356,14 @@ namespace QDirStat
         int             _totalFilesCount;
         FileSize        _totalFilesSize;
 
+        FileInfo *      _subtree;
+        DirTree *       _tree;
+        DirInfo *       _clearingDir;
+        bool            _clearingAncestor;
+        FileAgeSummary  _clearingSummary;
+        bool            _percentagesDirty;
+        bool            _changedPending;
+
         static short    _thisYear;
         static short    _thisMonth;
         static short    _lastYear;
@@ -13,6 +13,7 @@
 #include "SettingsHelpers.h"
 #include "HeaderTweaker.h"
 #include "FormatUtil.h"
+#include "StallWatchdog.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -125,6 +126,9 @@ void FileAgeStatsWindow::initWidgets()
 
     connect( _ui->locateButton,  SIGNAL( clicked()     ),
              this,               SLOT  ( locateFiles() ) );
+
+    connect( _stats,             SIGNAL( changed()      ),
+             this,               SLOT  ( statsChanged() ) );
 }
 
 
@@ -148,6 +152,8 @@ void FileAgeStatsWindow::populate( FileInfo * newSubtree )
 {
     // logDebug() << "populating with " << newSubtree << endl;
 
+    StallOperation operation( "File age statistics" );
+
     clear();
     _subtree = newSubtree;
 
@@ -167,6 +173,24 @@ void FileAgeStatsWindow::populate( FileInfo * newSubtree )
 }
 
 
+void FileAgeStatsWindow::statsChanged()
+{
+    QHeaderView * header    = _ui->treeWidget->header();
+    int           sortCol   = header->sortIndicatorSection();
+    Qt::SortOrder sortOrder = header->sortIndicatorOrder();
+
+    _ui->treeWidget->clear();
+    _ui->treeWidget->setSortingEnabled( false );
+
+    populateListWidget();
+
+    _ui->treeWidget->setSortingEnabled( true );
+    _ui->treeWidget->sortByColumn( sortCol, sortOrder );
+
+    enableActions();
+}
+
+
 void FileAgeStatsWindow::populateListWidget()
 {
     foreach ( short year, _stats->years() )
@@ -124,6 +124,13 @@ namespace QDirStat
          **/
         void enableActions();
 
+        /**
+         * Fill the years tree / list widget again from the current
+         * statistics after they changed because files in the subtree were
+         * deleted or added.
+         **/
+        void statsChanged();
+
 
     protected:
 
@@ -0,0 +1,160 @@
+/*
+ *   File name: FileColumns.cpp
+ *   Summary:	Columnar copy of the file attributes of a directory
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "FileColumns.h"
+#include "DirInfo.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+int FileColumns::_currentGeneration = 0;
+
+
+namespace
+{
+    /**
+     * Return the sum of 'count' values. Four independent partial sums
+     * don't depend on each other, so the compiler can put them into one
+     * SIMD register, and even without that the CPU can add them in
+     * parallel.
+     **/
+    template<typename T> T sumOf( const T * values, int count )
+    {
+	T sum0 = 0;
+	T sum1 = 0;
+	T sum2 = 0;
+	T sum3 = 0;
+	int i  = 0;
+
+	for ( ; i + 4 <= count; i += 4 )
+	{
+	    sum0 += values[ i	  ];
+	    sum1 += values[ i + 1 ];
+	    sum2 += values[ i + 2 ];
+	    sum3 += values[ i + 3 ];
+	}
+
+	for ( ; i < count; ++i )
+	    sum0 += values[ i ];
+
+	return sum0 + sum1 + sum2 + sum3;
+    }
+
+
+    /**
+     * Return the maximum of 'count' values or 0 if there are none.
+     **/
+    template<typename T> T maxOf( const T * values, int count )
+    {
+	T max0 = 0;
+	T max1 = 0;
+	int i  = 0;
+
+	for ( ; i + 2 <= count; i += 2 )
+	{
+	    max0 = values[ i	 ] > max0 ? values[ i	  ] : max0;
+	    max1 = values[ i + 1 ] > max1 ? values[ i + 1 ] : max1;
+	}
+
+	for ( ; i < count; ++i )
+	    max0 = values[ i ] > max0 ? values[ i ] : max0;
+
+	return max0 > max1 ? max0 : max1;
+    }
+
+}	// namespace
+
+
+FileColumns::FileColumns():
+    _fileCount( 0 ),
+    _ignoredCount( 0 ),
+    _oldestFileMtime( 0 ),
+    _generation( _currentGeneration )
+{
+    // NOP
+}
+
+
+FileColumns * FileColumns::create( DirInfo * dir )
+{
+    if ( ! dir || dir->directChildrenCount() < FILE_COLUMNS_MIN_CHILDREN )
+	return 0;
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() )
+	    return 0;
+    }
+
+    FileColumns * columns = new FileColumns();
+    CHECK_NEW( columns );
+
+    int count = dir->directChildrenCount();
+    columns->_sizes.reserve( count );
+    columns->_allocatedSizes.reserve( count );
+    columns->_blocks.reserve( count );
+    columns->_mtimes.reserve( count );
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	columns->_sizes		 << child->size();
+	columns->_allocatedSizes << child->allocatedSize();
+	columns->_blocks	 << child->blocks();
+	columns->_mtimes	 << child->mtime();
+
+	if ( child->isIgnored() )
+	    columns->_ignoredCount++;
+
+	if ( child->isFile() )
+	{
+	    columns->_fileCount++;
+
+	    time_t mtime = child->mtime();
+
+	    if ( mtime > 0 && ( columns->_oldestFileMtime == 0 || mtime < columns->_oldestFileMtime ) )
+		columns->_oldestFileMtime = mtime;
+	}
+    }
+
+    return columns;
+}
+
+
+FileSize FileColumns::totalSize() const
+{
+    return sumOf( _sizes.constData(), _sizes.size() );
+}
+
+
+FileSize FileColumns::totalAllocatedSize() const
+{
+    return sumOf( _allocatedSizes.constData(), _allocatedSizes.size() );
+}
+
+
+FileSize FileColumns::totalBlocks() const
+{
+    return sumOf( _blocks.constData(), _blocks.size() );
+}
+
+
+time_t FileColumns::latestMtime() const
+{
+    return maxOf( _mtimes.constData(), _mtimes.size() );
+}
+
+
+qint64 FileColumns::memory() const
+{
+    return sizeof( FileColumns ) +
+	( _sizes.capacity() + _allocatedSizes.capacity() + _blocks.capacity() ) * sizeof( FileSize ) +
+	_mtimes.capacity() * sizeof( qint64 );
+}
@@ -0,0 +1,138 @@
+/*
+ *   File name: FileColumns.h
+ *   Summary:	Columnar copy of the file attributes of a directory
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef FileColumns_h
+#define FileColumns_h
+
+
+#include <time.h>
+
+#include <QVector>
+
+#include "FileSize.h"
+
+
+// Directories with fewer files than this don't get file columns
+#define FILE_COLUMNS_MIN_CHILDREN	16
+
+
+namespace QDirStat
+{
+    class DirInfo;
+
+
+    /**
+     * The attributes of the direct children of a directory that has only
+     * files (or other non-directories) as children, i.e. of a dot entry or
+     * of a directory without subdirectories, in one contiguous array for
+     * each attribute: The sums and maxima that DirInfo::recalc() needs can
+     * then be calculated with tight loops that the compiler can vectorize
+     * instead of following one pointer for each file, and the statistics
+     * collectors can take all file sizes or mtimes of a directory at once.
+     *
+     * The sizes are those from FileInfo::size() and
+     * FileInfo::allocatedSize(), so they depend on how hard links are
+     * counted; changing that invalidates all file columns (see isValid()).
+     * The directory drops its file columns whenever its children change
+     * (see DirInfo::dropChildVector()).
+     **/
+    class FileColumns
+    {
+    public:
+
+	/**
+	 * Create the file columns for the children of 'dir'. Return 0 if
+	 * it has a directory child or fewer than FILE_COLUMNS_MIN_CHILDREN
+	 * children. The caller takes over ownership.
+	 **/
+	static FileColumns * create( DirInfo * dir );
+
+	/**
+	 * Return 'true' if the columns are still up to date, i.e. if the
+	 * way hard links are counted did not change since they were
+	 * created.
+	 **/
+	bool isValid() const { return _generation == _currentGeneration; }
+
+	/**
+	 * Invalidate all file columns, e.g. because the sizes of hard links
+	 * are calculated differently now.
+	 **/
+	static void invalidateAll() { ++_currentGeneration; }
+
+	/**
+	 * Return the number of children.
+	 **/
+	int count() const { return _sizes.size(); }
+
+	/**
+	 * Return the number of regular files among the children.
+	 **/
+	int fileCount() const { return _fileCount; }
+
+	/**
+	 * Return 'true' if all children are regular files.
+	 **/
+	bool allFiles() const { return _fileCount == count(); }
+
+	/**
+	 * Return the number of ignored children.
+	 **/
+	int ignoredCount() const { return _ignoredCount; }
+
+	/**
+	 * Return the oldest mtime of the regular files or 0 if there is none.
+	 **/
+	time_t oldestFileMtime() const { return _oldestFileMtime; }
+
+	/**
+	 * The sums and the maximum over all children.
+	 **/
+	FileSize totalSize()	      const;
+	FileSize totalAllocatedSize() const;
+	FileSize totalBlocks()	      const;
+	time_t	 latestMtime()	      const;
+
+	/**
+	 * The columns, in the same order as the children.
+	 **/
+	const QVector<FileSize> & sizes()  const { return _sizes;  }
+	const QVector<qint64>	& mtimes() const { return _mtimes; }
+
+	/**
+	 * Return the approximate number of bytes on the heap for this
+	 * object.
+	 **/
+	qint64 memory() const;
+
+
+    protected:
+
+	/**
+	 * Constructor. Use create() instead.
+	 **/
+	FileColumns();
+
+
+	QVector<FileSize> _sizes;
+	QVector<FileSize> _allocatedSizes;
+	QVector<FileSize> _blocks;
+	QVector<qint64>	  _mtimes;
+	int		  _fileCount;
+	int		  _ignoredCount;
+	time_t		  _oldestFileMtime;
+	int		  _generation;
+
+	static int	  _currentGeneration;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef FileColumns_h
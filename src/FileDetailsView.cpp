@@ -12,10 +12,14 @@
 #include "FileDetailsView.h"
 #include "AdaptiveTimer.h"
 #include "DirInfo.h"
+#include "DirTree.h"
 #include "DirTreeModel.h"
 #include "FileInfoSet.h"
+#include "MemoryUsage.h"
 #include "MimeCategorizer.h"
+#include "PkgInfo.h"
 #include "PkgQuery.h"
+#include "PkgFileListCache.h"
 #include "SystemFileChecker.h"
 #include "Settings.h"
 #include "SettingsHelpers.h"
@@ -25,6 +29,7 @@
 
 #define ALLOCATED_FAT_PERCENT	33
 #define MAX_SYMLINK_TARGET_LEN	25
+#define MAX_MEMORY_USAGE_ITEMS	100000	// Don't walk larger subtrees for each selection
 
 using namespace QDirStat;
 
@@ -33,10 +38,12 @@ FileDetailsView::FileDetailsView( QWidget * parent ):
     QStackedWidget( parent ),
     _ui( new Ui::FileDetailsView ),
     _pkgUpdateTimer( new AdaptiveTimer( this ) ),
+    _pkgQuery( new OwningPkgQuery( this ) ),
     _labelLimit( 40 )
 {
     CHECK_NEW( _ui );
     CHECK_NEW( _pkgUpdateTimer );
+    CHECK_NEW( _pkgQuery );
 
     _ui->setupUi( this );
     clear();
@@ -57,6 +64,9 @@ FileDetailsView::FileDetailsView( QWidget * parent ):
 
     connect( _pkgUpdateTimer, SIGNAL( deliverRequest( QVariant ) ),
 	     this,	      SLOT  ( updatePkgInfo ( QVariant ) ) );
+
+    connect( _pkgQuery,	      SIGNAL( result	  ( QString, QString ) ),
+	     this,	      SLOT  ( showPkgInfo ( QString, QString ) ) );
 }
 
 
@@ -80,6 +90,14 @@ void FileDetailsView::setCurrentPage( QWidget *page )
     // really need to be removed from the layout. They are still children of
     // the QStackedWidget, but no longer in the layout.
 
+    if ( page != _ui->fileDetailsPage )
+    {
+	// Nobody is interested in the package of the previous file anymore
+
+	_pkgQueryPath.clear();
+	_pkgQuery->cancel();
+    }
+
     while ( count() > 0 )
 	removeWidget( widget( 0 ) );
 
@@ -280,13 +298,25 @@ void FileDetailsView::showFilePkgInfo( FileInfo * file )
     {
 	setFilePkgBlockVisibility( isSystemFile );
 
+	    _pkgQueryPath.clear();
+	    _pkgQuery->cancel();
+
 	    if ( isSystemFile )
 	    {
+		QString pkg;
+
+		if ( knownOwningPkg( file, pkg ) )
+		{
+		    showPkgInfo( QString(), pkg );
+		    return;
+		}
+
 		QString delayHint = QString( _pkgUpdateTimer->delayStage(), '.' );
 		_ui->filePackageLabel->setText( delayHint );
 
 		_ui->filePackageCaption->setEnabled( true );
-		_pkgUpdateTimer->delayedRequest( file->url() );
+		_pkgQueryPath = file->url();
+		_pkgUpdateTimer->delayedRequest( _pkgQueryPath );
 	    }
     }
     else // No supported package manager found
@@ -299,14 +329,51 @@ void FileDetailsView::showFilePkgInfo( FileInfo * file )
 void FileDetailsView::updatePkgInfo( const QVariant & pathVariant )
 {
     QString path = pathVariant.toString();
+
+    if ( path != _pkgQueryPath ) // Another file is shown by now
+	return;
+
     // logDebug() << "Updating pkg info for " << path << endl;
+    _pkgQuery->request( path );
+}
+
+
+void FileDetailsView::showPkgInfo( const QString & path, const QString & pkg )
+{
+    if ( path != _pkgQueryPath )
+	return;
 
-    QString pkg = PkgQuery::owningPkg( path );
+    _pkgQueryPath.clear();
     _ui->filePackageLabel->setText( pkg );
     _ui->filePackageCaption->setEnabled( ! pkg.isEmpty() );
 }
 
 
+bool FileDetailsView::knownOwningPkg( FileInfo * file, QString & pkg_ret )
+{
+    PkgInfo * pkg = file->pkgInfoParent();
+
+    if ( pkg )
+    {
+	pkg_ret = pkg->name();
+	return true;
+    }
+
+    // The unpackaged files view only contains files that are not in the
+    // file lists of any package
+
+    PkgFileListCache * fileListCache = file->tree() ? file->tree()->pkgFileListCache() : 0;
+
+    if ( fileListCache && ! fileListCache->containsFile( file->url() ) )
+    {
+	pkg_ret = "";
+	return true;
+    }
+
+    return PkgQuery::cachedOwningPkg( file->url(), pkg_ret );
+}
+
+
 void FileDetailsView::setSystemFileWarningVisibility( bool visible )
 {
     _ui->fileSystemFileWarning->setVisible( visible );
@@ -363,7 +430,10 @@ void FileDetailsView::showSubtreeInfo( DirInfo * dir )
 	case DirQueued:
 	case DirReading:		msg = tr( "[Reading]"		); break;
 
-	case DirOnRequestOnly:		msg = tr( "[Not Read]"		); break;
+	case DirOnRequestOnly:
+	    msg = dir->isOverBudget() ? tr( "[Not Read: Over Memory Budget]" ) : tr( "[Not Read]" );
+	    break;
+
 	case DirPermissionDenied:	msg = tr( "[Permission Denied]" ); break;
 	case DirError:			msg = tr( "[Read Error]"	); break;
 
@@ -388,6 +458,7 @@ void FileDetailsView::showSubtreeInfo( DirInfo * dir )
 
 	suppressIfSameContent( _ui->dirTotalSizeLabel, _ui->dirAllocatedLabel, _ui->dirAllocatedCaption );
 	_ui->dirAllocatedLabel->setBold( dir->totalUsedPercent() < ALLOCATED_FAT_PERCENT );
+	showMemoryUsage( dir );
     }
     else  // Special msg -> show it and clear all summary fields
     {
@@ -397,7 +468,30 @@ void FileDetailsView::showSubtreeInfo( DirInfo * dir )
 	_ui->dirFileCountLabel->clear();
 	_ui->dirSubDirCountLabel->clear();
 	_ui->dirLatestMTimeLabel->clear();
+	_ui->dirMemoryLabel->clear();
+	_ui->dirMemoryLabel->setToolTip( QString() );
+    }
+}
+
+
+void FileDetailsView::showMemoryUsage( DirInfo * dir )
+{
+    if ( dir->totalItems() > MAX_MEMORY_USAGE_ITEMS )
+    {
+	_ui->dirMemoryLabel->setText( tr( "See View > Memory Usage" ) );
+	_ui->dirMemoryLabel->setToolTip( QString() );
+	return;
     }
+
+    MemoryUsageCounter counter;
+    MemoryUsage usage = counter.count( dir );
+
+    _ui->dirMemoryLabel->setText( formatSize( usage.totalBytes() ) );
+    _ui->dirMemoryLabel->setToolTip( tr( "%1 nodes: %2\nNames: %3\nChild lists: %4" )
+				     .arg( usage.nodes )
+				     .arg( formatSize( usage.nodeBytes ) )
+				     .arg( formatSize( usage.nameBytes ) )
+				     .arg( formatSize( usage.auxBytes  ) ) );
 }
 
 
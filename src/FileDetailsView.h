@@ -17,6 +17,7 @@
 namespace QDirStat
 {
     class AdaptiveTimer;
+    class OwningPkgQuery;
     class PkgInfo;
 
     /**
@@ -123,10 +124,16 @@ namespace QDirStat
     protected slots:
 
 	/**
-	 * Update package information via the AdaptiveTimer.
+	 * Update package information via the AdaptiveTimer: Start an
+	 * asynchronous lookup of the owning package.
 	 **/
 	void updatePkgInfo( const QVariant & path );
 
+	/**
+	 * Show the result of the owning package lookup for 'path'.
+	 **/
+	void showPkgInfo( const QString & path, const QString & pkg );
+
 
     protected:
 
@@ -191,6 +198,15 @@ namespace QDirStat
 	 **/
 	void setLabelColor( QLabel * label, const QColor & color );
 
+	/**
+	 * Find the owning package of 'file' without asking the package
+	 * manager: From the package in the package view, from the file list
+	 * cache of the unpackaged files view or from the cache of previous
+	 * queries. Return 'true' and set 'pkg_ret' if successful, 'false'
+	 * if not.
+	 **/
+	bool knownOwningPkg( FileInfo * file, QString & pkg_ret );
+
 
 	// Boilerplate widget setting methods
 
@@ -200,6 +216,7 @@ namespace QDirStat
 	void setFilePkgBlockVisibility( bool visible );
 
 	void showSubtreeInfo( DirInfo * dir );
+	void showMemoryUsage( DirInfo * dir );
 	void showDirNodeInfo( DirInfo * dir );
 	void setDirBlockVisibility( bool visible );
 
@@ -208,6 +225,8 @@ namespace QDirStat
 
 	Ui::FileDetailsView * _ui;
 	AdaptiveTimer *	      _pkgUpdateTimer;
+	OwningPkgQuery *      _pkgQuery;
+	QString		      _pkgQueryPath;	// file waiting for its package
 	int		      _labelLimit;
 	QColor		      _dirReadErrColor;
 	QColor		      _normalTextColor;
@@ -15,11 +15,14 @@
 #include <unistd.h>
 
 #include <QDateTime>
+#include <QHash>
+#include <QVector>
 
 #include "FileInfo.h"
 #include "DirInfo.h"
 #include "DotEntry.h"
 #include "Attic.h"
+#include "FileColumns.h"
 #include "DirTree.h"
 #include "PkgInfo.h"
 #include "FormatUtil.h"
@@ -39,6 +42,81 @@ using namespace QDirStat;
 
 
 bool FileInfo::_ignoreHardLinks = false;
+bool FileInfo::_countHardLinksOnce = false;
+
+
+namespace
+{
+    /**
+     * Table of the distinct values of a FileInfo field that has only few
+     * different values in a tree (device, UID, GID), so each FileInfo only
+     * needs to store a 16 bit index into this table.
+     *
+     * This is only used from the GUI thread.
+     **/
+    template<typename T> class InternTable
+    {
+    public:
+
+	InternTable() { intern( 0 ); }	// Make index 0 mean 0
+
+	/**
+	 * Return the index of 'value', adding it if it's not in the table
+	 * yet. If the table is full, this returns the index of 0.
+	 **/
+	quint16 intern( T value )
+	{
+	    typename QHash<T, quint16>::const_iterator it = _indices.constFind( value );
+
+	    if ( it != _indices.constEnd() )
+		return it.value();
+
+	    if ( _values.size() > 0xFFFF )
+	    {
+		logError() << "Too many distinct values; using 0 for " << (qulonglong) value << endl;
+		return 0;
+	    }
+
+	    quint16 index = _values.size();
+	    _values << value;
+	    _indices.insert( value, index );
+
+	    return index;
+	}
+
+	/**
+	 * Return the value for table index 'index'.
+	 **/
+	T value( quint16 index ) const { return _values.at( index ); }
+
+    private:
+
+	QVector<T>	   _values;
+	QHash<T, quint16>  _indices;
+    };
+
+
+    InternTable<dev_t> & deviceTable()
+    {
+	static InternTable<dev_t> table;
+	return table;
+    }
+
+
+    InternTable<uid_t> & uidTable()
+    {
+	static InternTable<uid_t> table;
+	return table;
+    }
+
+
+    InternTable<gid_t> & gidTable()
+    {
+	static InternTable<gid_t> table;
+	return table;
+    }
+
+}	// namespace
 
 
 FileInfo::FileInfo( DirTree    * tree,
@@ -52,22 +130,27 @@ FileInfo::FileInfo( DirTree    * tree,
      * Default constructor: All fields are initialized empty.
      **/
 
-    _isLocalFile   = true;
-    _isSparseFile  = false;
-    _isIgnored	   = false;
-    _name	   = name ? name : "";
-    _device	   = 0;
-    _mode	   = 0;
-    _links	   = 0;
-    _uid	   = 0;
-    _gid	   = 0;
-    _size	   = 0;
-    _blocks	   = 0;
-    _mtime	   = 0;
-    _mtimeYear     = -1;
-    _mtimeMonth    = -1;
-    _allocatedSize = 0;
-    _magic	   = FileInfoMagic;
+    _isLocalFile	 = true;
+    _isSparseFile	 = false;
+    _isIgnored		 = false;
+    _allocatedIsByteSize = false;
+    _hardLinkChecked	 = false;
+    _isHardLinkDuplicate = false;
+    _categoryId		 = UnknownCategoryId;
+    _name		 = name ? name : "";
+
+    if ( _tree )
+	_name = _tree->sharedName( _name );
+    _deviceNo		 = 0;
+    _mode		 = 0;
+    _links		 = 0;
+    _uidNo		 = 0;
+    _gidNo		 = 0;
+    _size		 = 0;
+    _blocks		 = 0;
+    _mtime		 = 0;
+    _magic		 = FileInfoMagic;
+    _nodeKind		 = FileNode;
 }
 
 
@@ -86,20 +169,37 @@ FileInfo::FileInfo( const QString & filenameWithoutPath,
 
     CHECK_PTR( statInfo );
 
-    _isLocalFile   = true;
-    _isIgnored	   = false;
-    _name	   = filenameWithoutPath;
-
-    _device	   = statInfo->st_dev;
-    _mode	   = statInfo->st_mode;
-    _links	   = statInfo->st_nlink;
-    _uid	   = statInfo->st_uid;
-    _gid	   = statInfo->st_gid;
-    _mtime	   = statInfo->st_mtime;
-    _mtimeYear     = -1;
-    _mtimeMonth    = -1;
-    _magic	   = FileInfoMagic;
-    _allocatedSize = 0;
+    _isLocalFile	 = true;
+    _isIgnored		 = false;
+    _hardLinkChecked	 = false;
+    _isHardLinkDuplicate = false;
+    _name		 = _tree ? _tree->sharedName( filenameWithoutPath ) : filenameWithoutPath;
+    _magic		 = FileInfoMagic;
+    _nodeKind		 = FileNode;
+
+    updateStat( statInfo );
+
+    if ( _countHardLinksOnce && _tree && _links > 1 && isFile() )
+    {
+	_hardLinkChecked     = true;
+	_isHardLinkDuplicate = ! _tree->hardLinkTable()->add( _deviceNo, statInfo->st_ino, _links );
+    }
+}
+
+
+void FileInfo::updateStat( const struct stat * statInfo )
+{
+    CHECK_PTR( statInfo );
+
+    _allocatedIsByteSize = false;
+    _categoryId		 = UnknownCategoryId;
+    _mode		 = statInfo->st_mode;
+    _links		 = statInfo->st_nlink;
+    _mtime		 = statInfo->st_mtime;
+
+    setDevice( statInfo->st_dev );
+    setUid   ( statInfo->st_uid );
+    setGid   ( statInfo->st_gid );
 
     if ( isSpecial() )
     {
@@ -116,30 +216,26 @@ FileInfo::FileInfo( const QString & filenameWithoutPath,
 	{
 	    if ( ! filesystemCanReportBlocks() )
 	    {
-		_allocatedSize = _size;
+		_allocatedIsByteSize = true;
 
 		// Do not make any assumptions about fragment handling: The
 		// last block of the file might be partially unused, or the
 		// filesystem might do clever fragment handling, or it's an
 		// exported kernel table like /dev, /proc, /sys. So let's
-		// simply use the size reported by stat() for _allocatedSize.
+		// simply use the size reported by stat() as the allocated size.
 	    }
 	}
-	else
-	{
-	    _allocatedSize = _blocks * STD_BLOCK_SIZE;
-	}
 
 	_isSparseFile	= isFile()
 	    && _blocks >= 0
-	    && _allocatedSize + FRAGMENT_SIZE < _size; // allow for intelligent fragment handling
+	    && rawAllocatedSize() + FRAGMENT_SIZE < _size; // allow for intelligent fragment handling
 
 #if 0
 	if ( _isSparseFile )
 	{
 	    logDebug() << "Found sparse file: " << this
 		       << "    Byte size: "     << formatSize( _size )
-		       << "  Allocated: "       << formatSize( _allocatedSize )
+		       << "  Allocated: "       << formatSize( rawAllocatedSize() )
 		       << " (" << (int) _blocks << " blocks)"
 		       << endl;
 	}
@@ -173,20 +269,22 @@ FileInfo::FileInfo( DirTree *	    tree,
      * for use from a cache file reader
      **/
 
-    _name	   = filenameWithoutPath;
-    _isLocalFile   = true;
-    _isIgnored	   = false;
-    _device	   = 0;
-    _mode	   = mode;
-    _size	   = size;
-    _mtime	   = mtime;
-    _mtimeYear     = -1;
-    _mtimeMonth    = -1;
-    _allocatedSize = 0;
-    _links	   = links;
-    _uid	   = 0;
-    _gid	   = 0;
-    _magic	   = FileInfoMagic;
+    _name		 = _tree ? _tree->sharedName( filenameWithoutPath ) : filenameWithoutPath;
+    _isLocalFile	 = true;
+    _isIgnored		 = false;
+    _allocatedIsByteSize = false;
+    _hardLinkChecked	 = false;
+    _isHardLinkDuplicate = false;
+    _categoryId		 = UnknownCategoryId;
+    _deviceNo		 = 0;
+    _mode		 = mode;
+    _size		 = size;
+    _mtime		 = mtime;
+    _links		 = links;
+    _uidNo		 = 0;
+    _gidNo		 = 0;
+    _magic		 = FileInfoMagic;
+    _nodeKind		 = FileNode;
 
     if ( blocks < 0 )
     {
@@ -198,12 +296,12 @@ FileInfo::FileInfo( DirTree *	    tree,
 
 	// Don't make any assumptions about the file's tail. We might use
 	//
-	//   _allocatedSize = _blocks * STD_BLOCK_SIZE;
+	//   allocated size = _blocks * STD_BLOCK_SIZE;
 	//
 	// but that might be wrong if the filesystem has intelligent fragment
 	// handling. Simply use the byte size instead.
 
-	_allocatedSize = _size;
+	_allocatedIsByteSize = true;
     }
     else // blocks >= 0
     {
@@ -212,7 +310,6 @@ FileInfo::FileInfo( DirTree *	    tree,
 
 	_isSparseFile	= true;
 	_blocks		= blocks;
-        _allocatedSize  = blocks * STD_BLOCK_SIZE;
     }
 
     // logDebug() << "Created FileInfo " << this << endl;
@@ -244,10 +341,18 @@ bool FileInfo::checkMagicNumber() const
 
 FileSize FileInfo::size() const
 {
-    FileSize sz = _isSparseFile ? _allocatedSize : _size;
+    FileSize sz = _isSparseFile ? rawAllocatedSize() : _size;
 
-    if ( _links > 1 && ! _ignoreHardLinks && isFile() )
-	sz /= _links;
+    if ( _links > 1 && isFile() )
+    {
+	if ( _countHardLinksOnce && _hardLinkChecked )
+	{
+	    if ( _isHardLinkDuplicate )
+		sz = 0;
+	}
+	else if ( ! _ignoreHardLinks )
+	    sz /= _links;
+    }
 
     return sz;
 }
@@ -255,10 +360,18 @@ FileSize FileInfo::size() const
 
 FileSize FileInfo::allocatedSize() const
 {
-    FileSize sz = _allocatedSize;
+    FileSize sz = rawAllocatedSize();
 
-    if ( _links > 1 && ! _ignoreHardLinks && isFile() )
-	sz /= _links;
+    if ( _links > 1 && isFile() )
+    {
+	if ( _countHardLinksOnce && _hardLinkChecked )
+	{
+	    if ( _isHardLinkDuplicate )
+		sz = 0;
+	}
+	else if ( ! _ignoreHardLinks )
+	    sz /= _links;
+    }
 
     return sz;
 }
@@ -268,7 +381,7 @@ int FileInfo::usedPercent() const
 {
     int percent = 100;
 
-    if ( _allocatedSize > 0 && _size > 0 )
+    if ( rawAllocatedSize() > 0 && _size > 0 )
     {
         percent = qRound( ( 100.0 * size() ) / allocatedSize() );
     }
@@ -369,6 +482,14 @@ bool FileInfo::hasChildren() const
 
 bool FileInfo::isInSubtree( const FileInfo *subtree ) const
 {
+    // With pre-order labels (see DirTree::updateSubtreeLabels()), walk up
+    // only as far as the nearest labeled directory and compare its label
+    // with the range of 'subtree'
+
+    const DirInfo * top = subtree && subtree->isDirNode() ?
+	static_cast<const DirInfo *>( subtree ) : 0;
+
+    bool labeled = top && top->hasSubtreeLabels();
     const FileInfo * ancestor = this;
 
     while ( ancestor )
@@ -376,6 +497,17 @@ bool FileInfo::isInSubtree( const FileInfo *subtree ) const
 	if ( ancestor == subtree )
 	    return true;
 
+	if ( labeled && ancestor->isDirNode() && ancestor->tree() == top->tree() )
+	{
+	    const DirInfo * dir = static_cast<const DirInfo *>( ancestor );
+
+	    if ( dir->hasSubtreeLabels() )
+	    {
+		return dir->preOrder() >= top->preOrder() &&
+		       dir->preOrder() <= top->lastPreOrder();
+	    }
+	}
+
 	ancestor = ancestor->parent();
     }
 
@@ -531,6 +663,42 @@ bool FileInfo::isCached() const
 }
 
 
+dev_t FileInfo::device() const
+{
+    return deviceTable().value( _deviceNo );
+}
+
+
+uid_t FileInfo::uid() const
+{
+    return uidTable().value( _uidNo );
+}
+
+
+gid_t FileInfo::gid() const
+{
+    return gidTable().value( _gidNo );
+}
+
+
+void FileInfo::setDevice( dev_t device )
+{
+    _deviceNo = deviceTable().intern( device );
+}
+
+
+void FileInfo::setUid( uid_t uid )
+{
+    _uidNo = uidTable().intern( uid );
+}
+
+
+void FileInfo::setGid( gid_t gid )
+{
+    _gidNo = gidTable().intern( gid );
+}
+
+
 bool FileInfo::hasUid() const
 {
     return ! isPkgInfo() && ! isCached();
@@ -595,39 +763,46 @@ void FileInfo::setIgnoreHardLinks( bool ignore )
     if ( ignore )
 	logInfo() << "Ignoring hard links" << endl;
 
+    if ( ignore != _ignoreHardLinks )
+	FileColumns::invalidateAll();
+
     _ignoreHardLinks = ignore;
 }
 
 
-DirInfo * FileInfo::toDirInfo()
+void FileInfo::setCountHardLinksOnce( bool once )
 {
-    DirInfo * dirInfo = dynamic_cast<DirInfo *>( this );
+    if ( once )
+	logInfo() << "Counting hard links only once" << endl;
+
+    if ( once != _countHardLinksOnce )
+	FileColumns::invalidateAll();
 
-    return dirInfo;
+    _countHardLinksOnce = once;
 }
 
 
-DotEntry * FileInfo::toDotEntry()
+DirInfo * FileInfo::toDirInfo()
 {
-    DotEntry * dotEntry = dynamic_cast<DotEntry *>( this );
+    return isDirNode() ? static_cast<DirInfo *>( this ) : 0;
+}
+
 
-    return dotEntry;
+DotEntry * FileInfo::toDotEntry()
+{
+    return isDotEntryNode() ? static_cast<DotEntry *>( this ) : 0;
 }
 
 
 Attic * FileInfo::toAttic()
 {
-    Attic * attic = dynamic_cast<Attic *>( this );
-
-    return attic;
+    return isAtticNode() ? static_cast<Attic *>( this ) : 0;
 }
 
 
 PkgInfo * FileInfo::toPkgInfo()
 {
-    PkgInfo * pkgInfo = dynamic_cast<PkgInfo *>( this );
-
-    return pkgInfo;
+    return _nodeKind == PkgNode ? static_cast<PkgInfo *>( this ) : 0;
 }
 
 
@@ -688,35 +863,55 @@ QString FileInfo::symLinkTarget()
 }
 
 
-short FileInfo::mtimeYear()
+/**
+ * Calculate the year and month (UTC) of a time_t like gmtime() does, but only
+ * with integer arithmetic on the number of days since the epoch (the civil
+ * calendar algorithm by Howard Hinnant).
+ **/
+static void utcYearMonth( time_t t, short & year_ret, short & month_ret )
 {
-    if ( _mtimeYear == -1 )
-        processMtime();
+    qint64 days = t / 86400;
+
+    if ( t % 86400 < 0 )	// round towards minus infinity
+	--days;
+
+    days += 719468;		// shift the epoch to 0000-03-01
 
-    return _mtimeYear;
+    qint64   era = ( days >= 0 ? days : days - 146096 ) / 146097;
+    unsigned doe = (unsigned) ( days - era * 146097 );			// day of era
+    unsigned yoe = ( doe - doe / 1460 + doe / 36524 - doe / 146096 ) / 365; // year of era
+    unsigned doy = doe - ( 365 * yoe + yoe / 4 - yoe / 100 );		// day of year
+    unsigned mp	 = ( 5 * doy + 2 ) / 153;				// month from March
+    unsigned m	 = mp < 10 ? mp + 3 : mp - 9;
+
+    year_ret  = (short) ( yoe + era * 400 + ( m <= 2 ? 1 : 0 ) );
+    month_ret = (short) m;
 }
 
 
-short FileInfo::mtimeMonth()
+short FileInfo::mtimeYear() const
 {
-    if ( _mtimeMonth == -1 )
-        processMtime();
+    if ( isPseudoDir() || isPkgInfo() )
+        return -1;
+
+    short year;
+    short month;
+    utcYearMonth( _mtime, year, month );
 
-    return _mtimeMonth;
+    return year;
 }
 
 
-void  FileInfo::processMtime()
+short FileInfo::mtimeMonth() const
 {
     if ( isPseudoDir() || isPkgInfo() )
-        return;
+        return -1;
 
-    // Using gmtime() which is standard C/C++
-    // unlike gmtime_r() which is not
-    struct tm * mtime_tm = gmtime( &_mtime );
+    short year;
+    short month;
+    utcYearMonth( _mtime, year, month );
 
-    _mtimeYear  = mtime_tm->tm_year + 1900;
-    _mtimeMonth = mtime_tm->tm_mon  + 1;
+    return month;
 }
 
 
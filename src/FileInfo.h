@@ -19,6 +19,7 @@
 #include <QList>
 
 #include "FileSize.h"
+#include "NodeAllocator.h"
 #include "Logger.h"
 
 // The size of a standard disk block.
@@ -32,7 +33,11 @@
 
 namespace QDirStat
 {
-#define FileInfoMagic 4242
+#define FileInfoMagic 0x42
+
+    // Special values for FileInfo::categoryId()
+#define UnknownCategoryId	0	// not looked up yet
+#define NoCategoryId		255	// no matching MIME category
 
     // Forward declarations
     class DirInfo;
@@ -58,6 +63,21 @@ namespace QDirStat
     };
 
 
+    /**
+     * The class of a node in the tree, stored in each node so the hot
+     * traversal loops can tell the classes apart without a virtual call or
+     * a dynamic_cast (see FileInfo::nodeKind()).
+     **/
+    enum NodeKind
+    {
+	FileNode = 0,		// FileInfo
+	DirNode,		// DirInfo
+	DotEntryNode,		// DotEntry
+	AtticNode,		// Attic
+	PkgNode			// PkgInfo
+    };
+
+
     /**
      * The most basic building block of a DirTree:
      *
@@ -76,6 +96,9 @@ namespace QDirStat
      **/
     class FileInfo
     {
+	// Saves and restores all data members of files
+	friend class FileSpillStore;
+
     public:
 	/**
 	 * Default constructor.
@@ -115,6 +138,17 @@ namespace QDirStat
 	 **/
 	virtual ~FileInfo();
 
+	/**
+	 * Allocate and free FileInfo objects and objects of all derived
+	 * classes with the NodeAllocator rather than with the general-purpose
+	 * heap.
+	 **/
+	static void * operator new( size_t size )
+	    { return NodeAllocator::allocate( size ); }
+
+	static void operator delete( void * ptr, size_t size )
+	    { NodeAllocator::deallocate( ptr, size ); }
+
 	/**
 	 * Check with the magic number if this object is valid.
 	 * Return 'true' if it is valid, 'false' if invalid.
@@ -185,7 +219,7 @@ namespace QDirStat
 	 * Returns the major and minor device numbers of the device this file
 	 * resides on or 0 if this is a remote file.
 	 **/
-	dev_t device() const { return _device; }
+	dev_t device() const;
 
 	/**
 	 * The file permissions and object type as returned by lstat().
@@ -194,7 +228,7 @@ namespace QDirStat
 	 *
 	 * See also symbolicPermissions(), octalPermissions()
 	 **/
-	mode_t mode() const { return _mode;   }
+	mode_t mode() const { return _mode; }
 
 	/**
 	 * The number of hard links to this file. Relevant for size summaries
@@ -208,7 +242,7 @@ namespace QDirStat
 	 * Notice that this might be undefined if this tree branch was read
 	 * from a cache file. Check that with hasUid().
 	 **/
-	uid_t uid() const { return _uid; }
+	uid_t uid() const;
 
 	/**
 	 * Return the user name of the owner.
@@ -232,7 +266,7 @@ namespace QDirStat
 	 * Notice that this might be undefined if this tree branch was read
 	 * from a cache file. Check that with hasGid().
 	 **/
-	gid_t gid() const { return _gid; }
+	gid_t gid() const;
 
 	/**
 	 * Return the group name of the owner.
@@ -265,8 +299,9 @@ namespace QDirStat
 	/**
 	 * The file size, taking into account multiple links for plain files or
 	 * the true allocated size for sparse files. For plain files with
-	 * multiple links this will be size/no_links, for sparse files it is
-	 * the number of bytes actually allocated.
+	 * multiple links this will be size/no_links (or the full size for the
+	 * first link and 0 for all others, see setCountHardLinksOnce()), for
+	 * sparse files it is the number of bytes actually allocated.
 	 **/
 	FileSize size() const;
 
@@ -308,7 +343,8 @@ namespace QDirStat
 	 * If the filesystem can properly report the number of disk blocks
 	 * used, this is the same as blocks() * 512.
 	 **/
-	FileSize rawAllocatedSize() const { return _allocatedSize; }
+	FileSize rawAllocatedSize() const
+	    { return _allocatedIsByteSize ? _size : _blocks * STD_BLOCK_SIZE; }
 
 	/**
 	 * The file size in 512 byte blocks.
@@ -321,22 +357,20 @@ namespace QDirStat
 	time_t mtime() const { return _mtime; }
 
         /**
-         * The year of the modification time of the file (1970-2037).
+         * The year of the modification time of the file (UTC) or -1 for
+         * pseudo directories and PkgInfo nodes.
          *
-         * The first call to this will calculate the value from _mtime and
-         * cache it (and the corresponding month); that's why this is not a
-         * const method.
+         * This is calculated from _mtime on each call; that is only a few
+         * integer operations, so it is not worthwhile to store it in each
+         * node.
          **/
-        short mtimeYear();
+        short mtimeYear() const;
 
         /**
-         * The month of the modification time of the file (1-12).
-         *
-         * The first call to this will calculate the value from _mtime and
-         * cache it (and the corresponding year); that's why this is not a
-         * const method.
+         * The month of the modification time of the file (UTC, 1-12) or -1
+         * for pseudo directories and PkgInfo nodes.
          **/
-        short mtimeMonth();
+        short mtimeMonth() const;
 
 	/**
 	 * Returns the total size in bytes of this subtree.
@@ -747,6 +781,42 @@ namespace QDirStat
 	 **/
 	virtual bool isPkgInfo() const { return false; }
 
+	/**
+	 * Return the class of this node. Unlike isDirInfo() etc., this is not
+	 * a virtual call.
+	 **/
+	NodeKind nodeKind() const { return (NodeKind) _nodeKind; }
+
+	/**
+	 * Non-virtual versions of isDirInfo(), isDotEntry(), isAttic() and
+	 * isPseudoDir() for hot loops.
+	 **/
+	bool isDirNode()       const { return _nodeKind != FileNode;	 }
+	bool isDotEntryNode()  const { return _nodeKind == DotEntryNode; }
+	bool isAtticNode()     const { return _nodeKind == AtticNode;	 }
+	bool isPseudoDirNode() const
+	    { return _nodeKind == DotEntryNode || _nodeKind == AtticNode; }
+
+	/**
+	 * Non-virtual, inline versions of the respective virtual functions
+	 * for hot traversal loops like FileInfoIterator: They use the node
+	 * kind to access the DirInfo fields directly.
+	 *
+	 * They are defined in DirInfo.h, so include that to use them.
+	 **/
+	inline FileInfo * nodeFirstChild()	   const;
+	inline DotEntry * nodeDotEntry()	   const;
+	inline Attic *	  nodeAttic()		   const;
+	inline bool	  nodeHasChildren()	   const;
+	inline FileSize	  nodeTotalSize();
+	inline FileSize	  nodeTotalAllocatedSize();
+
+	/**
+	 * Return this as a DirInfo without a dynamic_cast or 0 if this is
+	 * not a DirInfo. Defined in DirInfo.h.
+	 **/
+	inline DirInfo * nodeDirInfo();
+
 	/**
 	 * Try to convert this to a DirInfo pointer. This returns null if this
 	 * is not a DirInfo.
@@ -801,6 +871,27 @@ namespace QDirStat
 	 **/
 	void setIgnored( bool ignored ) { _isIgnored = ignored; }
 
+	/**
+	 * Return the cached MIME category of this item: The index of the
+	 * category in the MimeCategorizer plus 1, NoCategoryId if there is no
+	 * matching category or UnknownCategoryId if it was not looked up yet.
+	 *
+	 * This is only a cache for the MimeCategorizer; use
+	 * MimeCategorizer::category() to get the category.
+	 **/
+	quint8 categoryId() const { return _categoryId; }
+
+	/**
+	 * Set the cached MIME category. See categoryId().
+	 **/
+	void setCategoryId( quint8 id ) { _categoryId = id; }
+
+	/**
+	 * Update the mode, the sizes, the mtime etc. from a new lstat()
+	 * result. This does not update the summaries of the parents.
+	 **/
+	void updateStat( const struct stat * statInfo );
+
 	/**
 	 * Return the nearest PkgInfo parent or 0 if there is none.
 	 **/
@@ -915,43 +1006,87 @@ namespace QDirStat
 	 **/
 	static bool ignoreHardLinks() { return _ignoreHardLinks; }
 
+	/**
+	 * Set if the size of a file with multiple hard links is counted only
+	 * once: The first link that is found while reading the tree reports
+	 * the full size, all other links report 0. Unlike distributing the
+	 * size among the links, this is exact, and the total size of the
+	 * tree is the disk space that is really used. The size is attributed
+	 * to the subtree where the first link is, though, so another subtree
+	 * with only the other links of the same files looks empty.
+	 *
+	 * This is only possible for files that are read from the filesystem
+	 * after this flag was set since the inodes are needed; for all other
+	 * files (e.g. read from a cache file), the size is distributed among
+	 * the links as usual. It takes precedence over ignoreHardLinks().
+	 *
+	 * This flag will be read from the config file from the outside
+	 * (DirTree) and set from there using this function.
+	 **/
+	static void setCountHardLinksOnce( bool once );
+
+	/**
+	 * Return 'true' if the size of a file with multiple hard links is
+	 * counted only once. See setCountHardLinksOnce() for details.
+	 **/
+	static bool countHardLinksOnce() { return _countHardLinksOnce; }
+
+	/**
+	 * Return 'true' if this is a file with multiple hard links whose
+	 * size is not counted because another link of the same file was
+	 * found first. See setCountHardLinksOnce() for details.
+	 **/
+	bool isHardLinkDuplicate() const
+	    { return _hardLinkChecked && _isHardLinkDuplicate; }
+
 
     protected:
 
-        /**
-         * Calculate values that are dependent on _mtime, yet quite expensive
-         * to calculate, and cache them: _mtimeYear, _mtimeMonth
-         **/
-        void processMtime();
+	/**
+	 * Set the device, the UID and the GID. They are stored as indices
+	 * into tables of distinct values.
+	 **/
+	void setDevice( dev_t device );
+	void setUid( uid_t uid );
+	void setGid( gid_t gid );
 
 
 	// Data members.
 	//
 	// Keep this short in order to use as little memory as possible -
 	// there will be a _lot_ of entries of this kind!
-
-	short		_magic;			// magic number to detect if this object is valid
-	QString		_name;			// the file name (without path!)
+	//
+	// The members are ordered by size to avoid padding. Device, UID and
+	// GID are 16 bit indices into tables of the distinct values: A tree
+	// has only a handful of devices and owners, but millions of nodes.
+	// The allocated size is not stored; it is derived from _blocks or
+	// _size (see rawAllocatedSize()).
+
+	quint8		_magic;			// magic number to detect if this object is valid
+	quint8		_nodeKind;		// class of this object (see NodeKind)
 	bool		_isLocalFile  :1;	// flag: local or remote file?
 	bool		_isSparseFile :1;	// (cache) flag: sparse file (file with "holes")?
 	bool		_isIgnored    :1;	// flag: ignored by rule?
-	dev_t		_device;		// device this object resides on
-	mode_t		_mode;			// file permissions + object type
-	nlink_t		_links;			// number of links
-	uid_t		_uid;			// User ID of owner
-	gid_t		_gid;			// Group ID of owner
+	bool		_allocatedIsByteSize :1; // flag: allocated size is _size, not _blocks
+	bool		_hardLinkChecked :1;	// flag: checked in the DirTree's HardLinkTable?
+	bool		_isHardLinkDuplicate :1; // flag: another link was found first
+	quint8		_categoryId;		// cached MIME category (see categoryId())
+	quint16		_mode;			// file permissions + object type
+	quint16		_deviceNo;		// device this object resides on (table index)
+	quint16		_uidNo;			// User ID of owner (table index)
+	quint16		_gidNo;			// Group ID of owner (table index)
+	quint32		_links;			// number of links
+	QString		_name;			// the file name (without path!)
 	FileSize	_size;			// size in bytes
 	FileSize	_blocks;		// 512 bytes blocks
-	FileSize	_allocatedSize;		// allocated size in bytes
 	time_t		_mtime;			// modification time
-        short           _mtimeYear;             // year  of the modification time or -1
-        short           _mtimeMonth;            // month of the modification time or -1
 
 	DirInfo	 *	_parent;		// pointer to the parent entry
 	FileInfo *	_next;			// pointer to the next entry
 	DirTree	 *	_tree;			// pointer to the parent tree
 
 	static bool	_ignoreHardLinks;	// don't distribute size for multiple hard links
+	static bool	_countHardLinksOnce;	// count size only for the first hard link
 
     };	// class FileInfo
 
@@ -37,6 +37,13 @@ void FileInfoIterator::init( FileInfo * parent,
 {
     _parent  = parent;
     _current = 0;
+    _index   = -1;
+
+    // Iterate over the contiguous child vector if there is one: That is
+    // more cache friendly than following the linked list of siblings.
+
+    DirInfo * dir = parent ? parent->nodeDirInfo() : 0;
+    _children = dir ? dir->childVector() : 0;
 
     _directChildrenProcessed = false;
     _dotEntryProcessed	     = false;
@@ -52,7 +59,10 @@ void FileInfoIterator::next()
     {
 	// Process direct children
 
-	_current = _current ? _current->next() : _parent->firstChild();
+	if ( _children )
+	    _current = ++_index < _children->size() ? _children->at( _index ) : 0;
+	else
+	    _current = _current ? _current->next() : _parent->nodeFirstChild();
 
 	if ( ! _current )
 	{
@@ -66,7 +76,7 @@ void FileInfoIterator::next()
 	{
 	    // Process dot entry
 
-	    _current = _parent->dotEntry();
+	    _current = _parent->nodeDotEntry();
 	    _dotEntryProcessed = true;
 	}
 	else	// Dot entry already processed
@@ -83,18 +93,25 @@ int FileInfoIterator::count()
 
     // Count direct children
 
-    FileInfo * child = _parent->firstChild();
-
-    while ( child )
+    if ( _children )
     {
-	cnt++;
-	child = child->next();
+	cnt = _children->size();
+    }
+    else
+    {
+	FileInfo * child = _parent->nodeFirstChild();
+
+	while ( child )
+	{
+	    cnt++;
+	    child = child->next();
+	}
     }
 
 
     // Handle the dot entry
 
-    if ( _parent->dotEntry() )
+    if ( _parent->nodeDotEntry() )
 	cnt++;
 
     return cnt;
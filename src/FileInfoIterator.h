@@ -100,6 +100,8 @@ namespace QDirStat
 
 	FileInfo *	_parent;
 	FileInfo *	_current;
+	const FileInfoList * _children;		// contiguous child vector or 0
+	int		_index;			// in _children
 	bool		_directChildrenProcessed;
 	bool		_dotEntryProcessed;
 
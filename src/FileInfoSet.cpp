@@ -7,6 +7,11 @@
  */
 
 
+#include <algorithm>
+
+#include <QHash>
+#include <QVector>
+
 #include "FileInfoSet.h"
 #include "DirTree.h"
 #include "DirInfo.h"
@@ -16,6 +21,35 @@
 using namespace QDirStat;
 
 
+namespace
+{
+    /**
+     * An item with the pre-order label of itself (for a directory) or of
+     * its parent (for anything else) for FileInfoSet::normalizedByLabels().
+     **/
+    struct LabeledItem
+    {
+	int	   preOrder;
+	int	   lastPreOrder;	// -1 if not a directory
+	FileInfo * item;
+    };
+
+
+    /**
+     * Comparison function for sorting labeled items by label, and a
+     * directory before the files with the same label.
+     **/
+    bool labelLess( const LabeledItem & a, const LabeledItem & b )
+    {
+	if ( a.preOrder != b.preOrder )
+	    return a.preOrder < b.preOrder;
+
+	return a.lastPreOrder > b.lastPreOrder;
+    }
+
+}	// namespace
+
+
 bool FileInfoSet::containsAncestorOf( FileInfo * item ) const
 {
     while ( item )
@@ -34,9 +68,57 @@ FileInfoSet FileInfoSet::normalized() const
 {
     FileInfoSet normalized;
 
+    FileInfo * firstItem = first();
+
+    if ( size() > 1 && firstItem && firstItem->checkMagicNumber() && firstItem->tree() )
+    {
+	firstItem->tree()->updateSubtreeLabels( size() );
+
+	if ( normalizedByLabels( normalized ) )
+	    return normalized;
+
+	normalized.clear();
+    }
+
+    // Calling containsAncestorOf() for each item would walk the complete
+    // parent chain of each item. Instead, remember for each ancestor that
+    // was already visited if it or one of its ancestors is in this set, so
+    // each of them is only visited once, no matter how many selected items
+    // share it.
+
+    QHash<FileInfo *, bool> covered;
+    QList<FileInfo *> path;
+
     foreach ( FileInfo * item, *this )
     {
-	if ( ! containsAncestorOf( item ) )
+	bool hasAncestor = false;
+	FileInfo * ancestor = item ? item->parent() : 0;
+	path.clear();
+
+	while ( ancestor )
+	{
+	    QHash<FileInfo *, bool>::const_iterator it = covered.constFind( ancestor );
+
+	    if ( it != covered.constEnd() )
+	    {
+		hasAncestor = it.value();
+		break;
+	    }
+
+	    if ( contains( ancestor ) )
+	    {
+		hasAncestor = true;
+		break;
+	    }
+
+	    path << ancestor;
+	    ancestor = ancestor->parent();
+	}
+
+	foreach ( FileInfo * dir, path )
+	    covered.insert( dir, hasAncestor );
+
+	if ( ! hasAncestor )
 	    normalized << item;
 #if 0
 	else
@@ -48,6 +130,60 @@ FileInfoSet FileInfoSet::normalized() const
 }
 
 
+bool FileInfoSet::normalizedByLabels( FileInfoSet & result ) const
+{
+    DirTree * tree = first()->tree();
+
+    if ( ! tree->subtreeLabelsComplete() )
+	return false;
+
+    QVector<LabeledItem> items;
+    items.reserve( size() );
+
+    foreach ( FileInfo * item, *this )
+    {
+	if ( ! item || item->tree() != tree )
+	    return false;
+
+	DirInfo * dir = item->isDirNode() ? item->nodeDirInfo() : item->parent();
+
+	if ( ! dir || ! dir->hasSubtreeLabels() )
+	    return false;
+
+	LabeledItem labeled;
+	labeled.preOrder     = dir->preOrder();
+	labeled.lastPreOrder = dir == item ? dir->lastPreOrder() : -1;
+	labeled.item	     = item;
+
+	items << labeled;
+    }
+
+    std::sort( items.begin(), items.end(), labelLess );
+
+    // The label ranges of the directories that are kept so far and that
+    // contain the current label; they are nested, so the innermost one is
+    // the last
+
+    QVector<int> rangeEnds;
+
+    foreach ( const LabeledItem & labeled, items )
+    {
+	while ( ! rangeEnds.isEmpty() && rangeEnds.last() < labeled.preOrder )
+	    rangeEnds.removeLast();
+
+	if ( ! rangeEnds.isEmpty() )
+	    continue;	// An ancestor is in the set
+
+	result << labeled.item;
+
+	if ( labeled.lastPreOrder >= 0 )
+	    rangeEnds << labeled.lastPreOrder;
+    }
+
+    return true;
+}
+
+
 FileInfoSet FileInfoSet::invalidRemoved() const
 {
     FileInfoSet result;
@@ -124,6 +124,16 @@ namespace QDirStat
 	 **/
 	FileInfoSet normalized() const;
 
+    protected:
+
+	/**
+	 * Do the work of normalized() with the pre-order labels of the
+	 * directories (see DirTree::updateSubtreeLabels()): Sort the items
+	 * by label and drop each one that is within the label range of a
+	 * directory before it. Return 'false' if not all items have labels.
+	 **/
+	bool normalizedByLabels( FileInfoSet & result ) const;
+
     };	// class FileInfoSet
 
 }	// namespace QDirStat
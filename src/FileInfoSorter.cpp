@@ -7,8 +7,23 @@
  */
 
 
+#include <string.h>	// memcpy()
 #include <algorithm>
+#include <limits>
+
+#include <QThread>
+#include <QVector>
+
 #include "FileInfoSorter.h"
+#include "Exception.h"
+
+
+// Below this number of items, sorting with FileInfoSorter directly is
+// cheaper than fetching the sort keys first
+#define MIN_SORT_KEYS_ITEMS	10000
+
+// Minimum number of items for each thread in a parallel sort
+#define MIN_ITEMS_PER_THREAD	50000
 
 using namespace QDirStat;
 
@@ -63,3 +78,275 @@ bool FileInfoSorter::operator() ( FileInfo * a, FileInfo * b )
 
     return false;
 }
+
+
+//---------------------------------------------------------------------------
+
+
+namespace
+{
+    /**
+     * Sort key for sorting by name: Like FileInfoSorter for NameCol,
+     * ignored items come last and the dot entry comes after all other
+     * items that are not ignored.
+     **/
+    struct NameSortKey
+    {
+	int	   group;
+	QString	   name;
+	FileInfo * item;
+    };
+
+
+    struct NameSortKeyLess
+    {
+	NameSortKeyLess( Qt::SortOrder sortOrder ):
+	    descending( sortOrder == Qt::DescendingOrder )
+	    {}
+
+	bool operator() ( const NameSortKey & a, const NameSortKey & b ) const
+	{
+	    if ( descending )
+		return less( b, a );
+	    else
+		return less( a, b );
+	}
+
+	static bool less( const NameSortKey & a, const NameSortKey & b )
+	{
+	    if ( a.group != b.group )
+		return a.group < b.group;
+
+	    return a.name < b.name;
+	}
+
+	bool descending;
+    };
+
+
+    /**
+     * Sort key for sorting by any other column: The value of the column
+     * and the position of the item in the order by name for items with
+     * the same value.
+     **/
+    struct ColumnSortKey
+    {
+	qint64	   key;
+	int	   nameRank;
+	FileInfo * item;
+    };
+
+
+    struct ColumnSortKeyLess
+    {
+	ColumnSortKeyLess( Qt::SortOrder sortOrder ):
+	    descending( sortOrder == Qt::DescendingOrder )
+	    {}
+
+	bool operator() ( const ColumnSortKey & a, const ColumnSortKey & b ) const
+	{
+	    if ( a.key != b.key )
+		return descending ? b.key < a.key : a.key < b.key;
+
+	    return a.nameRank < b.nameRank;	// always ascending
+	}
+
+	bool descending;
+    };
+
+
+    /**
+     * Thread to sort one part of an array.
+     **/
+    template<typename Key, typename Less> class SortThread: public QThread
+    {
+    public:
+
+	SortThread( Key * begin, Key * end, const Less & less ):
+	    _begin( begin ),
+	    _end( end ),
+	    _less( less )
+	    {}
+
+    protected:
+
+	virtual void run() Q_DECL_OVERRIDE
+	    { std::sort( _begin, _end, _less ); }
+
+	Key * _begin;
+	Key * _end;
+	Less  _less;
+    };
+
+
+    /**
+     * Sort 'keys' with several threads: Each thread sorts one part, then
+     * the sorted parts are merged.
+     **/
+    template<typename Key, typename Less> void parallelSort( QVector<Key> & keys, const Less & less )
+    {
+	int threadCount = qMin( QThread::idealThreadCount(), keys.size() / MIN_ITEMS_PER_THREAD );
+
+	if ( threadCount < 2 )
+	{
+	    std::sort( keys.begin(), keys.end(), less );
+	    return;
+	}
+
+	Key *	     data = keys.data();
+	QVector<int> bounds;
+
+	for ( int i = 0; i <= threadCount; ++i )
+	    bounds << (int) ( (qint64) keys.size() * i / threadCount );
+
+	QList<QThread *> threads;
+
+	for ( int i = 0; i < threadCount; ++i )
+	{
+	    QThread * thread = new SortThread<Key, Less>( data + bounds[i], data + bounds[i+1], less );
+	    CHECK_NEW( thread );
+
+	    threads << thread;
+	    thread->start();
+	}
+
+	foreach ( QThread * thread, threads )
+	    thread->wait();
+
+	qDeleteAll( threads );
+
+	// Merge neighbouring parts until there is only one left
+
+	for ( int step = 1; step < threadCount; step *= 2 )
+	{
+	    for ( int i = 0; i + step < threadCount; i += 2 * step )
+	    {
+		int end = bounds[ qMin( i + 2 * step, threadCount ) ];
+		std::inplace_merge( data + bounds[i], data + bounds[i + step], data + end, less );
+	    }
+	}
+    }
+
+
+    /**
+     * Return the sort key of 'item' for 'sortCol', mapped to a number so
+     * two keys compare like FileInfoSorter compares the items in
+     * ascending order.
+     **/
+    qint64 columnSortKey( FileInfo * item, DataColumn sortCol )
+    {
+	switch ( sortCol )
+	{
+	    case PercentBarCol:
+	    case PercentNumCol:
+		{
+		    // Map the float to an integer with the same order
+
+		    float  percent = item->subtreePercent();
+		    qint32 bits;
+		    memcpy( &bits, &percent, sizeof( bits ) );
+
+		    return bits < 0 ? (qint64) ( bits ^ 0x7FFFFFFF ) : (qint64) bits;
+		}
+
+	    case SizeCol:		return item->totalSize();
+	    case TotalItemsCol:		return item->totalItems();
+	    case TotalFilesCol:		return item->totalFiles();
+	    case TotalSubDirsCol:	return item->totalSubDirs();
+	    case LatestMTimeCol:	return item->latestMtime();
+	    case OldestFileMTimeCol:
+		{
+		    // Items without any files come last
+
+		    time_t mtime = item->oldestFileMtime();
+		    return mtime == 0 ? std::numeric_limits<qint64>::max() : (qint64) mtime;
+		}
+
+	    case UserCol:		return item->uid();
+	    case GroupCol:		return item->gid();
+	    case PermissionsCol:	return item->mode();
+	    case OctalPermissionsCol:	return item->mode();
+	    case ReadJobsCol:		return item->pendingReadJobs();
+	    case NameCol:
+	    case UndefinedCol:		return 0;
+		// Intentionally omitting the 'default' branch
+		// so the compiler can warn about unhandled enum values
+	}
+
+	return 0;
+    }
+
+
+    /**
+     * Sort 'list' by name in 'sortOrder' using sort keys.
+     **/
+    void sortByName( FileInfoList & list, Qt::SortOrder sortOrder )
+    {
+	QVector<NameSortKey> keys( list.size() );
+
+	for ( int i = 0; i < list.size(); ++i )
+	{
+	    FileInfo *	  item = list.at( i );
+	    NameSortKey & key  = keys[i];
+
+	    key.group = ( item->isIgnored() ? 2 : 0 ) + ( item->isDotEntry() ? 1 : 0 );
+	    key.name  = item->name();
+	    key.item  = item;
+	}
+
+	parallelSort( keys, NameSortKeyLess( sortOrder ) );
+
+	for ( int i = 0; i < keys.size(); ++i )
+	    list[i] = keys.at( i ).item;
+    }
+
+}	// namespace
+
+
+void FileInfoSorter::sort( FileInfoList & list,
+			   DataColumn	  sortCol,
+			   Qt::SortOrder  sortOrder )
+{
+    if ( list.size() < MIN_SORT_KEYS_ITEMS )
+    {
+	if ( sortCol != NameCol )
+	{
+	    // Do secondary sorting by NameCol (always in ascending order)
+
+	    std::stable_sort( list.begin(), list.end(),
+			      FileInfoSorter( NameCol, Qt::AscendingOrder ) );
+	}
+
+	// Primary sorting by sortCol ascending or descending (as specified in sortOrder)
+
+	std::stable_sort( list.begin(), list.end(),
+			  FileInfoSorter( sortCol, sortOrder ) );
+	return;
+    }
+
+    // logDebug() << "Sorting " << list.size() << " items by " << sortCol << endl;
+
+    if ( sortCol == NameCol )
+    {
+	sortByName( list, sortOrder );
+	return;
+    }
+
+    sortByName( list, Qt::AscendingOrder );
+    QVector<ColumnSortKey> keys( list.size() );
+
+    for ( int i = 0; i < list.size(); ++i )
+    {
+	FileInfo *	item = list.at( i );
+	ColumnSortKey & key  = keys[i];
+
+	key.key	     = columnSortKey( item, sortCol );
+	key.nameRank = i;
+	key.item     = item;
+    }
+
+    parallelSort( keys, ColumnSortKeyLess( sortOrder ) );
+
+    for ( int i = 0; i < keys.size(); ++i )
+	list[i] = keys.at( i ).item;
+}
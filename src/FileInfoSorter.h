@@ -53,6 +53,20 @@ namespace QDirStat
 	 **/
 	bool operator() ( FileInfo * a, FileInfo * b );
 
+	/**
+	 * Sort 'list' by 'sortCol' in 'sortOrder' and, for items that are
+	 * equal in that column, by name in ascending order. This is the same
+	 * as a std::stable_sort() by NameCol followed by a std::stable_sort()
+	 * with a FileInfoSorter for 'sortCol' and 'sortOrder'.
+	 *
+	 * For very large lists, this first fetches the sort key of each item
+	 * into a contiguous array, so each comparison does not need any
+	 * virtual calls, and sorts that array with several threads.
+	 **/
+	static void sort( FileInfoList & list,
+			  DataColumn	 sortCol,
+			  Qt::SortOrder	 sortOrder );
+
     private:
 	DataColumn    _sortCol;
 	Qt::SortOrder _sortOrder;
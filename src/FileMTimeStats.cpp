@@ -12,6 +12,7 @@
 
 #include "FileMTimeStats.h"
 #include "FileInfoIterator.h"
+#include "FileColumns.h"
 #include "DirTree.h"
 #include "Exception.h"
 
@@ -24,10 +25,7 @@ FileMTimeStats::FileMTimeStats( FileInfo * subtree ):
     PercentileStats()
 {
     if ( subtree )
-    {
         collect( subtree );
-        sort();
-    }
 }
 
 
@@ -35,28 +33,44 @@ void FileMTimeStats::collect( FileInfo * subtree )
 {
     Q_CHECK_PTR( subtree );
 
-    if ( _data.isEmpty() )
-        _data.reserve( subtree->totalFiles() );
+    if ( dataSize() == 0 )
+        reserve( subtree->totalFiles() );
+
+    collectSubtree( subtree );
+}
+
+
+SubtreeCollector * FileMTimeStats::createPartial() const
+{
+    FileMTimeStats * partial = new FileMTimeStats();
+    CHECK_NEW( partial );
+
+    partial->setSketchRelativeError( sketchRelativeError() );
+    partial->setSketchThreshold( sketchThreshold() );
+
+    return partial;
+}
 
-    if ( subtree->isFile() )
-        _data << subtree->mtime();
 
-    FileInfoIterator it( subtree );
+void FileMTimeStats::collectFile( FileInfo * file )
+{
+    append( file->mtime() );
+}
+
+
+bool FileMTimeStats::collectFileColumns( const FileColumns & columns )
+{
+    const qint64 * mtimes = columns.mtimes().constData();
+    int count = columns.count();
+
+    for ( int i = 0; i < count; ++i )
+	append( mtimes[ i ] );
 
-    while ( *it )
-    {
-	FileInfo * item = *it;
+    return true;
+}
 
-	if ( item->hasChildren() )
-	{
-	    collect( item );
-	}
-	else if ( item->isFile() )
-	{
-            _data << item->mtime();
-	}
-	// Disregard symlinks, block devices and other special files
 
-	++it;
-    }
+void FileMTimeStats::merge( SubtreeCollector * partial )
+{
+    PercentileStats::merge( *static_cast<FileMTimeStats *>( partial ) );
 }
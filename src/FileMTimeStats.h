@@ -11,6 +11,7 @@
 #define FileMTimeStats_h
 
 #include "PercentileStats.h"
+#include "SubtreeCollector.h"
 #include "FileInfo.h"
 #include "HistogramView.h"
 
@@ -25,12 +26,11 @@ namespace QDirStat
      * calculating a median or quantiles or histograms.
      *
      * Notice that one data item (one qreal, i.e. one 64 bit double) is
-     * stored for each file (or each matching file) in this object, so this is
-     * expensive in terms of memory usage. Also, since data usually need to be
-     * sorted for those calculations and sorting has at least logarithmic cost
-     * O( n * log(n) ), this also has heavy performance impact.
+     * stored for each file (or each matching file) in this object up to the
+     * sketch threshold of PercentileStats, so this is expensive in terms of
+     * memory usage.
      **/
-    class FileMTimeStats: public PercentileStats
+    class FileMTimeStats: public PercentileStats, public SubtreeCollector
     {
     public:
 
@@ -43,9 +43,41 @@ namespace QDirStat
 	/**
 	 * Recurse through all file elements in the subtree and append the
 	 * mtime for each file to the data collection. Notice that the data are
-	 * unsorted after this.
+	 * unsorted after this. Large subtrees are collected in several
+	 * threads.
 	 **/
 	void collect( FileInfo * subtree );
+
+    protected:
+
+	/**
+	 * Create an empty FileMTimeStats object with the same settings for
+	 * collecting in another thread.
+	 *
+	 * Implemented from SubtreeCollector.
+	 **/
+	virtual SubtreeCollector * createPartial() const Q_DECL_OVERRIDE;
+
+	/**
+	 * Append the mtime of 'file'.
+	 *
+	 * Implemented from SubtreeCollector.
+	 **/
+	virtual void collectFile( FileInfo * file ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Append all mtimes of 'columns'.
+	 *
+	 * Reimplemented from SubtreeCollector.
+	 **/
+	virtual bool collectFileColumns( const FileColumns & columns ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Append the data of 'partial'.
+	 *
+	 * Implemented from SubtreeCollector.
+	 **/
+	virtual void merge( SubtreeCollector * partial ) Q_DECL_OVERRIDE;
     };
 
 }	// namespace QDirStat
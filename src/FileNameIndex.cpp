@@ -0,0 +1,318 @@
+/*
+ *   File name: FileNameIndex.cpp
+ *   Summary:	Index for locating files by name in a DirTree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QElapsedTimer>
+
+#include "FileNameIndex.h"
+#include "SubtreeCollector.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Collector for the items of each distinct (lower case) name.
+     **/
+    class NameCollector: public SubtreeCollector
+    {
+    public:
+
+	NameCollector( const FileNameIndexBuilder * builder ):
+	    SubtreeCollector(),
+	    _builder( builder )
+	    {}
+
+	const QHash<QString, FileInfoList> & items() const { return _items; }
+
+    protected:
+
+	virtual SubtreeCollector * createPartial() const Q_DECL_OVERRIDE
+	    { return new NameCollector( _builder ); }
+
+	virtual void collectFile( FileInfo * file ) Q_DECL_OVERRIDE
+	    { _items[ file->name().toLower() ] << file; }
+
+	virtual void collectOther( FileInfo * item ) Q_DECL_OVERRIDE
+	    { _items[ item->name().toLower() ] << item; }
+
+	virtual bool cancelled() const Q_DECL_OVERRIDE
+	    { return _builder->cancelled(); }
+
+	virtual void merge( SubtreeCollector * rawPartial ) Q_DECL_OVERRIDE
+	{
+	    NameCollector * partial = dynamic_cast<NameCollector *>( rawPartial );
+	    CHECK_DYNAMIC_CAST( partial, "NameCollector" );
+
+	    QHash<QString, FileInfoList>::const_iterator it = partial->_items.constBegin();
+
+	    while ( it != partial->_items.constEnd() )
+	    {
+		_items[ it.key() ] << it.value();
+		++it;
+	    }
+	}
+
+	const FileNameIndexBuilder *  _builder;
+	QHash<QString, FileInfoList> _items;
+    };
+
+}	// namespace
+
+
+
+
+FileNameIndex::FileNameIndex( DirTree * tree, QObject * parent ):
+    QObject( parent ),
+    _tree( tree ),
+    _enabled( true ),
+    _ready( false ),
+    _builder( 0 )
+{
+    CHECK_PTR( _tree );
+    readSettings();
+
+    // Any change to the tree makes the index obsolete. All those signals
+    // are sent before the tree is changed, so the builder thread is
+    // stopped in time.
+
+    connect( _tree, SIGNAL( startingReading() ),
+	     this,  SLOT  ( invalidate()      ) );
+
+    connect( _tree, SIGNAL( clearing() ),
+	     this,  SLOT  ( invalidate() ) );
+
+    connect( _tree, SIGNAL( clearingSubtree( DirInfo * ) ),
+	     this,  SLOT  ( invalidate()		) );
+
+    connect( _tree, SIGNAL( deletingChild( FileInfo * ) ),
+	     this,  SLOT  ( invalidate()	      ) );
+
+    connect( _tree, SIGNAL( childrenAdded( FileInfoList ) ),
+	     this,  SLOT  ( invalidate()	      ) );
+
+    if ( _enabled )
+    {
+	connect( _tree, SIGNAL( finished() ),
+		 this,	SLOT  ( rebuild()  ) );
+    }
+}
+
+
+FileNameIndex::~FileNameIndex()
+{
+    delete _builder; // This cancels the thread and waits for it
+    writeSettings();
+}
+
+
+void FileNameIndex::invalidate()
+{
+    if ( _builder )
+    {
+	delete _builder;
+	_builder = 0;
+    }
+
+    if ( _ready )
+    {
+	logDebug() << "Dropping the file name index" << endl;
+
+	_ready = false;
+	_names.clear();
+	_items.clear();
+	_suffixes.clear();
+    }
+}
+
+
+void FileNameIndex::rebuild()
+{
+    invalidate();
+
+    if ( ! _tree->root() || ! _tree->root()->hasChildren() )
+	return;
+
+    _builder = new FileNameIndexBuilder( _tree->root() );
+    CHECK_NEW( _builder );
+
+    connect( _builder, SIGNAL( finished() ),
+	     this,     SLOT  ( builderFinished() ) );
+
+    _builder->start( QThread::LowPriority );
+}
+
+
+void FileNameIndex::builderFinished()
+{
+    if ( ! _builder || sender() != _builder )
+	return; // Late signal from a builder that was cancelled
+
+    if ( ! _builder->cancelled() )
+    {
+	_names.swap   ( _builder->_names    );
+	_items.swap   ( _builder->_items    );
+	_suffixes.swap( _builder->_suffixes );
+	_ready = true;
+    }
+
+    delete _builder;
+    _builder = 0;
+
+    if ( _ready )
+	emit ready();
+}
+
+
+FileInfoList FileNameIndex::filesWithSuffix( const QString & suffix,
+					     FileInfo	   * subtree ) const
+{
+    FileInfoList result;
+
+    if ( ! _ready )
+	return result;
+
+    foreach ( int nameId, _suffixes.value( suffix.toLower() ) )
+	addItems( nameId, subtree, true, result );
+
+    return result;
+}
+
+
+FileInfoList FileNameIndex::itemsWithNameContaining( const QString & text,
+						     FileInfo	   * subtree ) const
+{
+    FileInfoList result;
+
+    if ( ! _ready )
+	return result;
+
+    QString lowerText = text.toLower();
+
+    for ( int nameId = 0; nameId < _names.size(); ++nameId )
+    {
+	if ( _names.at( nameId ).contains( lowerText ) )
+	    addItems( nameId, subtree, false, result );
+    }
+
+    return result;
+}
+
+
+void FileNameIndex::addItems( int	     nameId,
+			      FileInfo	   * subtree,
+			      bool	     filesOnly,
+			      FileInfoList & result ) const
+{
+    if ( subtree == _tree->root() )
+	subtree = 0;
+
+    foreach ( FileInfo * item, _items.at( nameId ) )
+    {
+	if ( filesOnly && ! item->isFile() )
+	    continue;
+
+	if ( ! subtree || item->isInSubtree( subtree ) )
+	    result << item;
+    }
+}
+
+
+void FileNameIndex::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "FileNameIndex" );
+    _enabled = settings.value( "Enabled", true ).toBool();
+    settings.endGroup();
+}
+
+
+void FileNameIndex::writeSettings()
+{
+    Settings settings;
+    settings.beginGroup( "FileNameIndex" );
+
+    // Only set this if not already in the settings: The user might have
+    // changed it in the config file.
+    settings.setDefaultValue( "Enabled", _enabled );
+
+    settings.endGroup();
+}
+
+
+
+
+FileNameIndexBuilder::FileNameIndexBuilder( DirInfo * root ):
+    QThread(),
+    _root( root ),
+    _cancelled( 0 )
+{
+    CHECK_PTR( _root );
+}
+
+
+FileNameIndexBuilder::~FileNameIndexBuilder()
+{
+    cancel();
+    wait();
+}
+
+
+void FileNameIndexBuilder::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    NameCollector collector( this );
+    collector.collectSubtree( _root );
+
+    if ( cancelled() )
+	return;
+
+    const QHash<QString, FileInfoList> & items = collector.items();
+    _names.reserve( items.size() );
+    _items.reserve( items.size() );
+
+    QHash<QString, FileInfoList>::const_iterator it = items.constBegin();
+
+    while ( it != items.constEnd() && ! cancelled() )
+    {
+	int nameId = _names.size();
+	const QString & name = it.key();
+
+	_names << name;
+	_items << it.value();
+
+	// Add the name to each of its suffixes: "x.tar.gz" to ".tar.gz" and
+	// to ".gz". A dot at the very end doesn't make a suffix.
+
+	int pos = name.indexOf( '.' );
+
+	while ( pos >= 0 && pos < name.size() - 1 )
+	{
+	    _suffixes[ name.mid( pos ) ] << nameId;
+	    pos = name.indexOf( '.', pos + 1 );
+	}
+
+	++it;
+    }
+
+    if ( ! cancelled() )
+    {
+	logInfo() << "File name index with " << _names.size() << " names and "
+		  << _suffixes.size() << " suffixes built in "
+		  << timer.elapsed() / 1000.0 << " sec" << endl;
+    }
+}
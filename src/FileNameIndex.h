@@ -0,0 +1,216 @@
+/*
+ *   File name: FileNameIndex.h
+ *   Summary:	Index for locating files by name in a DirTree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef FileNameIndex_h
+#define FileNameIndex_h
+
+
+#include <QObject>
+#include <QThread>
+#include <QAtomicInt>
+#include <QHash>
+#include <QVector>
+#include <QString>
+
+#include "FileInfo.h"
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class DirInfo;
+    class FileNameIndexBuilder;
+
+
+    /**
+     * In-memory index of the names of all items without children (files,
+     * symlinks, ...) in a DirTree, so locating files by name or by suffix
+     * does not need to traverse the whole tree each time.
+     *
+     * Each distinct name (in lower case) is stored only once together with
+     * the items with that name. A suffix table maps each suffix (".gz",
+     * ".tar.gz", ...) to the names that end with it. Since there are
+     * usually a lot fewer distinct names than files, even a substring
+     * search over all names is fast.
+     *
+     * The index is built in a separate thread when reading the tree is
+     * finished. It is dropped as soon as the tree changes in any way; until
+     * it is rebuilt, isReady() returns 'false', and the callers have to
+     * fall back to traversing the tree.
+     *
+     * Building the index can be disabled with the "Enabled" setting in the
+     * "FileNameIndex" group of the config file.
+     **/
+    class FileNameIndex: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	FileNameIndex( DirTree * tree, QObject * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~FileNameIndex();
+
+	/**
+	 * Return 'true' if building the index is enabled.
+	 **/
+	bool enabled() const { return _enabled; }
+
+	/**
+	 * Return 'true' if the index is up to date and can be used.
+	 **/
+	bool isReady() const { return _ready; }
+
+	/**
+	 * Return all files in 'subtree' (or in the complete tree if
+	 * 'subtree' is 0) with a name that ends with 'suffix'
+	 * (case-insensitive). 'suffix' has to start with a '.'.
+	 *
+	 * This returns an empty list if the index is not ready.
+	 **/
+	FileInfoList filesWithSuffix( const QString & suffix,
+				      FileInfo	    * subtree = 0 ) const;
+
+	/**
+	 * Return all items in 'subtree' (or in the complete tree if
+	 * 'subtree' is 0) with a name that contains 'text'
+	 * (case-insensitive).
+	 *
+	 * This returns an empty list if the index is not ready.
+	 **/
+	FileInfoList itemsWithNameContaining( const QString & text,
+					      FileInfo	    * subtree = 0 ) const;
+
+	/**
+	 * Return the number of distinct names in the index.
+	 **/
+	int nameCount() const { return _names.size(); }
+
+
+    public slots:
+
+	/**
+	 * Drop the index and build it again in a separate thread.
+	 **/
+	void rebuild();
+
+	/**
+	 * Drop the index (and stop building it if that is in progress).
+	 **/
+	void invalidate();
+
+
+    signals:
+
+	/**
+	 * Emitted when the index is ready to be used.
+	 **/
+	void ready();
+
+
+    protected slots:
+
+	/**
+	 * Notification that the builder thread is finished.
+	 **/
+	void builderFinished();
+
+
+    protected:
+
+	/**
+	 * Add the items of the name with ID 'nameId' that are in 'subtree'
+	 * (and files, if 'filesOnly' is 'true') to 'result'.
+	 **/
+	void addItems( int	      nameId,
+		       FileInfo	    * subtree,
+		       bool	      filesOnly,
+		       FileInfoList & result ) const;
+
+	/**
+	 * Read and write the settings.
+	 **/
+	void readSettings();
+	void writeSettings();
+
+
+	//
+	// Data members
+	//
+
+	DirTree *		       _tree;
+	bool			       _enabled;
+	bool			       _ready;
+	FileNameIndexBuilder *	       _builder;
+
+	QVector<QString>	       _names;	  // by name ID
+	QVector<FileInfoList>	       _items;	  // by name ID
+	QHash<QString, QVector<int> >  _suffixes; // suffix -> name IDs
+
+    };	// class FileNameIndex
+
+
+
+    /**
+     * Thread to build the data of a FileNameIndex.
+     **/
+    class FileNameIndexBuilder: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	FileNameIndexBuilder( DirInfo * root );
+
+	/**
+	 * Destructor. This cancels the thread and waits for it.
+	 **/
+	virtual ~FileNameIndexBuilder();
+
+	/**
+	 * Request the thread to stop as soon as possible.
+	 **/
+	void cancel() { _cancelled.storeRelease( 1 ); }
+
+	/**
+	 * Return 'true' if cancel() was called.
+	 **/
+	bool cancelled() const { return _cancelled.loadAcquire() != 0; }
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	DirInfo *		      _root;
+	QAtomicInt		      _cancelled;
+
+	// The results. The FileNameIndex takes them over when this thread
+	// is finished and not cancelled.
+
+	QVector<QString>	      _names;
+	QVector<FileInfoList>	      _items;
+	QHash<QString, QVector<int> > _suffixes;
+
+	friend class FileNameIndex;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// FileNameIndex_h
@@ -0,0 +1,360 @@
+/*
+ *   File name: FilePredicate.cpp
+ *   Summary:	Compiled attribute filters like "size > 1G and mtime < 2020"
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <pwd.h>	// getpwnam()
+#include <grp.h>	// getgrnam()
+
+#include <QRegExp>
+#include <QStringList>
+#include <QDateTime>
+
+#include "FilePredicate.h"
+#include "FileInfo.h"
+#include "MimeCategorizer.h"
+#include "MimeCategory.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+FilePredicate::FilePredicate():
+    _categorizer( 0 )
+{
+    // NOP
+}
+
+
+bool FilePredicate::compile( const QString & expression )
+{
+    _expression.clear();
+    _errorString.clear();
+    _terms.clear();
+    _categorizer = 0;
+
+    QStringList termTexts = expression.trimmed().split( QRegExp( "\\s+and\\s+|\\s*&&\\s*",
+								 Qt::CaseInsensitive ) );
+    QVector<Term> terms;
+    QVector<Term> categoryTerms;
+
+    foreach ( const QString & text, termTexts )
+    {
+	Term term;
+
+	if ( ! parseTerm( text.trimmed(), term ) )
+	{
+	    _categorizer = 0;
+	    return false;
+	}
+
+	// Check the category last: Looking it up for the first time means
+	// matching the filename against the patterns of all categories,
+	// while everything else is just an integer comparison.
+
+	if ( term.field == CategoryField )
+	    categoryTerms << term;
+	else
+	    terms << term;
+    }
+
+    _terms	= terms + categoryTerms;
+    _expression = expression.trimmed();
+
+    logDebug() << "Compiled \"" << _expression << "\" to " << _terms.size() << " terms" << endl;
+
+    return true;
+}
+
+
+bool FilePredicate::parseTerm( const QString & text, Term & term )
+{
+    QRegExp termRegExp( "(\\w+)\\s*(<=|>=|!=|==|=|<|>)\\s*(.+)" );
+
+    if ( text.isEmpty() || ! termRegExp.exactMatch( text ) )
+    {
+	_errorString = QObject::tr( "Syntax error in \"%1\"" ).arg( text );
+	return false;
+    }
+
+    QString field = termRegExp.cap( 1 ).toLower();
+    QString op	  = termRegExp.cap( 2 );
+    QString value = termRegExp.cap( 3 ).trimmed();
+
+    if	    ( field == "size"	   ) term.field = SizeField;
+    else if ( field == "allocated" ) term.field = AllocatedField;
+    else if ( field == "mtime"	   ) term.field = MtimeField;
+    else if ( field == "uid"	   ) term.field = UidField;
+    else if ( field == "gid"	   ) term.field = GidField;
+    else if ( field == "links"	   ) term.field = LinksField;
+    else if ( field == "category"  ) term.field = CategoryField;
+    else
+    {
+	_errorString = QObject::tr( "Unknown field \"%1\"" ).arg( termRegExp.cap( 1 ) );
+	return false;
+    }
+
+    if	    ( op == "<"			) term.op = Less;
+    else if ( op == "<="		) term.op = LessOrEqual;
+    else if ( op == "=" || op == "==" ) term.op = Equal;
+    else if ( op == "!="		) term.op = NotEqual;
+    else if ( op == ">="		) term.op = GreaterOrEqual;
+    else				  term.op = Greater;
+
+    if ( term.field == CategoryField && term.op != Equal && term.op != NotEqual )
+    {
+	_errorString = QObject::tr( "Only = and != are possible for the category" );
+	return false;
+    }
+
+    if ( value.size() >= 2 &&
+	 ( ( value.startsWith( '"'  ) && value.endsWith( '"'  ) ) ||
+	   ( value.startsWith( '\'' ) && value.endsWith( '\'' ) )   ) )
+    {
+	value = value.mid( 1, value.size() - 2 );
+    }
+
+    term.value	  = 0;
+    term.category = 0;
+
+    if ( ! parseValue( value, term ) )
+    {
+	if ( _errorString.isEmpty() )
+	    _errorString = QObject::tr( "Invalid value \"%1\" for %2" ).arg( value ).arg( field );
+
+	return false;
+    }
+
+    return true;
+}
+
+
+bool FilePredicate::parseValue( const QString & text, Term & term )
+{
+    bool ok = false;
+
+    switch ( term.field )
+    {
+	case SizeField:
+	case AllocatedField:
+	    {
+		QRegExp sizeRegExp( "(\\d+(\\.\\d+)?)\\s*([kmgt]?)(i?b)?", Qt::CaseInsensitive );
+
+		if ( ! sizeRegExp.exactMatch( text ) )
+		    return false;
+
+		double size = sizeRegExp.cap( 1 ).toDouble( &ok );
+		QString unit = sizeRegExp.cap( 3 ).toLower();
+
+		if ( ! unit.isEmpty() )
+		    size *= 1024.0;
+
+		if ( unit == "m" || unit == "g" || unit == "t" )
+		    size *= 1024.0;
+
+		if ( unit == "g" || unit == "t" )
+		    size *= 1024.0;
+
+		if ( unit == "t" )
+		    size *= 1024.0;
+
+		term.value = (qint64) size;
+	    }
+	    break;
+
+	case MtimeField:
+	    {
+		QRegExp dateRegExp( "(\\d{4})(-(\\d{1,2})(-(\\d{1,2}))?)?" );
+
+		if ( ! dateRegExp.exactMatch( text ) )
+		    return false;
+
+		int year  = dateRegExp.cap( 1 ).toInt();
+		int month = dateRegExp.cap( 3 ).isEmpty() ? 1 : dateRegExp.cap( 3 ).toInt();
+		int day	  = dateRegExp.cap( 5 ).isEmpty() ? 1 : dateRegExp.cap( 5 ).toInt();
+		QDate date( year, month, day );
+
+		if ( ! date.isValid() )
+		    return false;
+
+		term.value = QDateTime( date, QTime( 0, 0 ) ).toMSecsSinceEpoch() / 1000;
+		ok = true;
+	    }
+	    break;
+
+	case UidField:
+	    term.value = text.toLongLong( &ok );
+
+	    if ( ! ok )
+	    {
+		struct passwd * pw = getpwnam( text.toUtf8().constData() );
+		ok = pw != 0;
+
+		if ( ok )
+		    term.value = pw->pw_uid;
+		else
+		    _errorString = QObject::tr( "Unknown user \"%1\"" ).arg( text );
+	    }
+	    break;
+
+	case GidField:
+	    term.value = text.toLongLong( &ok );
+
+	    if ( ! ok )
+	    {
+		struct group * grp = getgrnam( text.toUtf8().constData() );
+		ok = grp != 0;
+
+		if ( ok )
+		    term.value = grp->gr_gid;
+		else
+		    _errorString = QObject::tr( "Unknown group \"%1\"" ).arg( text );
+	    }
+	    break;
+
+	case LinksField:
+	    term.value = text.toLongLong( &ok );
+	    break;
+
+	case CategoryField:
+	    {
+		MimeCategorizer * categorizer = MimeCategorizer::instance();
+
+		foreach ( MimeCategory * category, categorizer->categories() )
+		{
+		    if ( category->name().compare( text, Qt::CaseInsensitive ) == 0 )
+		    {
+			term.category = category;
+			_categorizer  = categorizer;
+			ok = true;
+			break;
+		    }
+		}
+
+		if ( ! ok )
+		    _errorString = QObject::tr( "Unknown category \"%1\"" ).arg( text );
+	    }
+	    break;
+    }
+
+    return ok;
+}
+
+
+bool FilePredicate::compare( qint64 value, const Term & term )
+{
+    switch ( term.op )
+    {
+	case Less:		return value <	term.value;
+	case LessOrEqual:	return value <= term.value;
+	case Equal:		return value == term.value;
+	case NotEqual:		return value != term.value;
+	case GreaterOrEqual:	return value >= term.value;
+	case Greater:		return value >	term.value;
+    }
+
+    return false;
+}
+
+
+bool FilePredicate::matches( FileInfo * item ) const
+{
+    if ( ! item || ! item->isFile() )
+	return false;
+
+    for ( int i = 0; i < _terms.size(); ++i )
+    {
+	const Term & term = _terms.at( i );
+	bool match = false;
+
+	switch ( term.field )
+	{
+	    case SizeField:
+		match = compare( item->size(), term );
+		break;
+
+	    case AllocatedField:
+		match = compare( item->allocatedSize(), term );
+		break;
+
+	    case MtimeField:
+		match = compare( item->mtime(), term );
+		break;
+
+	    case UidField:
+		match = item->hasUid() && compare( item->uid(), term );
+		break;
+
+	    case GidField:
+		match = item->hasGid() && compare( item->gid(), term );
+		break;
+
+	    case LinksField:
+		match = compare( item->links(), term );
+		break;
+
+	    case CategoryField:
+		{
+		    bool sameCategory = _categorizer->category( item ) == term.category;
+		    match = term.op == Equal ? sameCategory : ! sameCategory;
+		}
+		break;
+	}
+
+	if ( ! match )
+	    return false;
+    }
+
+    return true;
+}
+
+
+bool FilePredicate::mayMatchBelow( FileInfo * dir ) const
+{
+    if ( ! dir )
+	return false;
+
+    if ( dir->totalFiles() == 0 )
+	return false;
+
+    // No file can be larger than the total size of the directory, and none
+    // can be newer than its latest mtime. Nothing similar is possible for
+    // "mtime <" since the oldest mtime ignores files with mtime 0.
+
+    for ( int i = 0; i < _terms.size(); ++i )
+    {
+	const Term & term = _terms.at( i );
+
+	if ( ! needsAtLeast( term.op ) )
+	    continue;
+
+	switch ( term.field )
+	{
+	    case SizeField:
+		if ( term.value > dir->totalSize() )
+		    return false;
+		break;
+
+	    case AllocatedField:
+		if ( term.value > dir->totalAllocatedSize() )
+		    return false;
+		break;
+
+	    case MtimeField:
+		if ( term.value > dir->latestMtime() )
+		    return false;
+		break;
+
+	    default:
+		break;
+	}
+    }
+
+    return true;
+}
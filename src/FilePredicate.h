@@ -0,0 +1,172 @@
+/*
+ *   File name: FilePredicate.h
+ *   Summary:	Compiled attribute filters like "size > 1G and mtime < 2020"
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef FilePredicate_h
+#define FilePredicate_h
+
+
+#include <QString>
+#include <QVector>
+
+
+namespace QDirStat
+{
+    class FileInfo;
+    class MimeCategory;
+    class MimeCategorizer;
+
+
+    /**
+     * Filter for files by their attributes, compiled from an expression
+     * like
+     *
+     *	   size > 1G and mtime < 2020 and uid = 1003 and category = "Videos"
+     *
+     * The expression is a list of terms "<field> <operator> <value>" joined
+     * with "and" (or "&&"). The operators are <, <=, =, ==, !=, >= and >.
+     * The fields are:
+     *
+     *	   size	       the size; the value may have a K, M, G or T suffix
+     *	   allocated   the allocated size, the same format as for size
+     *	   mtime       the modification time as YYYY, YYYY-MM or YYYY-MM-DD,
+     *		       i.e. the start of that year, month or day
+     *	   uid, gid    the owner and group as a number or a name
+     *	   links       the number of hard links
+     *	   category    the name of a MimeCategory; only = and !=
+     *
+     * Compiling parses all values once, so matching an item is just a loop
+     * over plain integer comparisons without any string handling; category
+     * terms are checked last since they are the most expensive ones.
+     *
+     * matches() and mayMatchBelow() don't change this object, so they can be
+     * used in several threads at the same time. For category terms,
+     * MimeCategorizer::generation() has to be called before that (see
+     * usesCategories()).
+     **/
+    class FilePredicate
+    {
+    public:
+
+	/**
+	 * Constructor. This creates an empty predicate that matches all
+	 * files.
+	 **/
+	FilePredicate();
+
+	/**
+	 * Compile 'expression'. Return 'true' on success. On failure, the
+	 * predicate is empty, and errorString() returns what was wrong.
+	 **/
+	bool compile( const QString & expression );
+
+	/**
+	 * Return the expression of the last successful compile().
+	 **/
+	const QString & expression() const { return _expression; }
+
+	/**
+	 * Return the error message of the last failed compile().
+	 **/
+	const QString & errorString() const { return _errorString; }
+
+	/**
+	 * Return 'true' if there are no terms.
+	 **/
+	bool isEmpty() const { return _terms.isEmpty(); }
+
+	/**
+	 * Return 'true' if any term checks the MimeCategory.
+	 **/
+	bool usesCategories() const { return _categorizer != 0; }
+
+	/**
+	 * Return 'true' if 'item' is a regular file that matches all terms.
+	 **/
+	bool matches( FileInfo * item ) const;
+
+	/**
+	 * Return 'true' if any file in the subtree of directory 'dir' might
+	 * match, 'false' if the summary values of 'dir' (total size, latest
+	 * mtime etc.) already rule that out, so the subtree does not need to
+	 * be walked at all.
+	 **/
+	bool mayMatchBelow( FileInfo * dir ) const;
+
+
+    protected:
+
+	enum Field
+	{
+	    SizeField,
+	    AllocatedField,
+	    MtimeField,
+	    UidField,
+	    GidField,
+	    LinksField,
+	    CategoryField
+	};
+
+	enum Operator
+	{
+	    Less,
+	    LessOrEqual,
+	    Equal,
+	    NotEqual,
+	    GreaterOrEqual,
+	    Greater
+	};
+
+	struct Term
+	{
+	    Field	   field;
+	    Operator	   op;
+	    qint64	   value;
+	    MimeCategory * category;
+	};
+
+	/**
+	 * Parse one term and store it in 'term'. Return 'false' and set the
+	 * error string if that fails.
+	 **/
+	bool parseTerm( const QString & text, Term & term );
+
+	/**
+	 * Parse the value of a term for 'field' and store it in 'term'.
+	 * Return 'false' if that fails.
+	 **/
+	bool parseValue( const QString & text, Term & term );
+
+	/**
+	 * Return 'true' if the value of a term matches 'term'.
+	 **/
+	static bool compare( qint64 value, const Term & term );
+
+	/**
+	 * Return 'true' if a term with operator 'op' can only match values
+	 * that are at least as large as its value.
+	 **/
+	static bool needsAtLeast( Operator op )
+	    { return op == Equal || op == GreaterOrEqual || op == Greater; }
+
+
+	//
+	// Data members
+	//
+
+	QString		  _expression;
+	QString		  _errorString;
+	QVector<Term>	  _terms;
+	MimeCategorizer * _categorizer;
+
+    };	// class FilePredicate
+
+}	// namespace QDirStat
+
+
+#endif	// FilePredicate_h
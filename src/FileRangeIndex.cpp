@@ -0,0 +1,472 @@
+/*
+ *   File name: FileRangeIndex.cpp
+ *   Summary:	Sorted indexes of the file sizes and mtimes in a DirTree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include "FileRangeIndex.h"
+#include "SubtreeCollector.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Sort order of the index entries: By key, the lowest first.
+     **/
+    bool lowerKey( const FileRangeIndexEntry & a, const FileRangeIndexEntry & b )
+    {
+	return a.key < b.key;
+    }
+
+
+    /**
+     * Collector for the index entries of all regular files.
+     **/
+    class RangeCollector: public SubtreeCollector
+    {
+    public:
+
+	RangeCollector( const FileRangeIndexBuilder * builder ):
+	    SubtreeCollector(),
+	    _builder( builder )
+	    {}
+
+	FileRangeIndexEntryList & bySize()  { return _bySize;  }
+	FileRangeIndexEntryList & byMtime() { return _byMtime; }
+
+    protected:
+
+	virtual SubtreeCollector * createPartial() const Q_DECL_OVERRIDE
+	    { return new RangeCollector( _builder ); }
+
+	virtual void collectFile( FileInfo * file ) Q_DECL_OVERRIDE
+	{
+	    FileRangeIndexEntry entry;
+	    entry.item = file;
+
+	    entry.key = file->size();
+	    _bySize << entry;
+
+	    entry.key = file->mtime();
+	    _byMtime << entry;
+	}
+
+	virtual bool cancelled() const Q_DECL_OVERRIDE
+	    { return _builder->cancelled(); }
+
+	virtual void merge( SubtreeCollector * rawPartial ) Q_DECL_OVERRIDE
+	{
+	    RangeCollector * partial = dynamic_cast<RangeCollector *>( rawPartial );
+	    CHECK_DYNAMIC_CAST( partial, "RangeCollector" );
+
+	    _bySize  += partial->_bySize;
+	    _byMtime += partial->_byMtime;
+	}
+
+	const FileRangeIndexBuilder * _builder;
+	FileRangeIndexEntryList	      _bySize;
+	FileRangeIndexEntryList	      _byMtime;
+    };
+
+
+    /**
+     * Thread to sort one list of index entries while the builder sorts the
+     * other one.
+     **/
+    class SortThread: public QThread
+    {
+    public:
+
+	SortThread( FileRangeIndexEntryList & entries ):
+	    QThread(),
+	    _entries( entries )
+	    {}
+
+    protected:
+
+	virtual void run() Q_DECL_OVERRIDE
+	    { std::sort( _entries.begin(), _entries.end(), lowerKey ); }
+
+	FileRangeIndexEntryList & _entries;
+    };
+
+}	// namespace
+
+
+
+
+FileRangeIndex::FileRangeIndex( DirTree * tree, QObject * parent ):
+    QObject( parent ),
+    _tree( tree ),
+    _enabled( true ),
+    _ready( false ),
+    _ignoreHardLinks( false ),
+    _countHardLinksOnce( false ),
+    _builder( 0 )
+{
+    CHECK_PTR( _tree );
+    readSettings();
+
+    // Any change to the tree except deleting items makes the indexes
+    // obsolete. All those signals are sent before the tree is changed, so
+    // the builder thread is stopped in time.
+
+    connect( _tree, SIGNAL( startingReading() ),
+	     this,  SLOT  ( invalidate()      ) );
+
+    connect( _tree, SIGNAL( clearing() ),
+	     this,  SLOT  ( invalidate() ) );
+
+    connect( _tree, SIGNAL( clearingSubtree( DirInfo * ) ),
+	     this,  SLOT  ( invalidate()		) );
+
+    connect( _tree, SIGNAL( deletingChild( FileInfo * ) ),
+	     this,  SLOT  ( deletingChild( FileInfo * ) ) );
+
+    connect( _tree, SIGNAL( childrenAdded( FileInfoList ) ),
+	     this,  SLOT  ( invalidate()	      ) );
+
+    if ( _enabled )
+    {
+	connect( _tree, SIGNAL( finished() ),
+		 this,	SLOT  ( rebuild()  ) );
+    }
+}
+
+
+FileRangeIndex::~FileRangeIndex()
+{
+    delete _builder; // This cancels the thread and waits for it
+    writeSettings();
+}
+
+
+bool FileRangeIndex::isReady() const
+{
+    return _ready &&
+	_ignoreHardLinks    == FileInfo::ignoreHardLinks() &&
+	_countHardLinksOnce == FileInfo::countHardLinksOnce();
+}
+
+
+bool FileRangeIndex::covers( FileInfo * subtree ) const
+{
+    if ( ! isReady() || ! subtree )
+	return false;
+
+    if ( subtree == _tree->root() )
+	return true;
+
+    return (qint64) subtree->totalFiles() * FILE_RANGE_INDEX_MIN_SHARE >= fileCount();
+}
+
+
+void FileRangeIndex::invalidate()
+{
+    if ( _builder )
+    {
+	delete _builder;
+	_builder = 0;
+    }
+
+    if ( _ready )
+    {
+	logDebug() << "Dropping the file range index" << endl;
+
+	_ready = false;
+	_bySize.clear();
+	_byMtime.clear();
+    }
+}
+
+
+void FileRangeIndex::rebuild()
+{
+    invalidate();
+
+    if ( ! _tree->root() || ! _tree->root()->hasChildren() || _tree->isBusy() )
+	return;
+
+    _builder = new FileRangeIndexBuilder( _tree->root() );
+    CHECK_NEW( _builder );
+
+    connect( _builder, SIGNAL( finished() ),
+	     this,     SLOT  ( builderFinished() ) );
+
+    _builder->start( QThread::LowPriority );
+}
+
+
+void FileRangeIndex::builderFinished()
+{
+    if ( ! _builder || sender() != _builder )
+	return; // Late signal from a builder that was cancelled
+
+    if ( ! _builder->cancelled() )
+    {
+	_bySize.swap ( _builder->_bySize  );
+	_byMtime.swap( _builder->_byMtime );
+	_ignoreHardLinks    = FileInfo::ignoreHardLinks();
+	_countHardLinksOnce = FileInfo::countHardLinksOnce();
+	_ready = true;
+    }
+
+    delete _builder;
+    _builder = 0;
+
+    if ( _ready )
+	emit ready();
+}
+
+
+void FileRangeIndex::deletingChild( FileInfo * child )
+{
+    if ( _builder )
+    {
+	// The builder thread must not see the tree while it changes. Start
+	// again when the child is gone.
+
+	invalidate();
+
+	if ( _enabled )
+	    QTimer::singleShot( 0, this, SLOT( rebuild() ) );
+
+	return;
+    }
+
+    if ( ! _ready || ! child )
+	return;
+
+    if ( child->hasChildren() )
+    {
+	removeSubtree( _bySize,	 child );
+	removeSubtree( _byMtime, child );
+    }
+    else if ( child->isFile() )
+    {
+	removeEntry( _bySize,  child->size(),  child );
+	removeEntry( _byMtime, child->mtime(), child );
+    }
+}
+
+
+int FileRangeIndex::lowerBound( const FileRangeIndexEntryList & entries, qint64 key )
+{
+    FileRangeIndexEntry entry;
+    entry.key  = key;
+    entry.item = 0;
+
+    return std::lower_bound( entries.constBegin(), entries.constEnd(), entry, lowerKey ) - entries.constBegin();
+}
+
+
+void FileRangeIndex::removeEntry( FileRangeIndexEntryList & entries,
+				  qint64		    key,
+				  FileInfo		  * item )
+{
+    for ( int i = lowerBound( entries, key ); i < entries.size() && entries.at( i ).key == key; ++i )
+    {
+	if ( entries.at( i ).item == item )
+	{
+	    entries.remove( i );
+	    return;
+	}
+    }
+
+    // The key might have changed since the index was built, e.g. the size
+    // of a hard link when another link to the same file was deleted
+
+    for ( int i = 0; i < entries.size(); ++i )
+    {
+	if ( entries.at( i ).item == item )
+	{
+	    entries.remove( i );
+	    return;
+	}
+    }
+}
+
+
+void FileRangeIndex::removeSubtree( FileRangeIndexEntryList & entries,
+				    FileInfo		    * subtree )
+{
+    int dest = 0;
+
+    for ( int i = 0; i < entries.size(); ++i )
+    {
+	if ( ! entries.at( i ).item->isInSubtree( subtree ) )
+	    entries[ dest++ ] = entries.at( i );
+    }
+
+    entries.resize( dest );
+}
+
+
+FileInfoList FileRangeIndex::items( const FileRangeIndexEntryList & entries,
+				    int				    begin,
+				    int				    end,
+				    FileInfo			  * subtree,
+				    bool			    reverse,
+				    int				    maxCount ) const
+{
+    FileInfoList result;
+
+    if ( subtree == _tree->root() )
+	subtree = 0;
+
+    if ( ! subtree && maxCount < 0 )
+	result.reserve( end - begin );
+
+    for ( int n = 0; n < end - begin; ++n )
+    {
+	if ( maxCount >= 0 && result.size() >= maxCount )
+	    break;
+
+	FileInfo * item = entries.at( reverse ? end - 1 - n : begin + n ).item;
+
+	if ( ! subtree || item->isInSubtree( subtree ) )
+	    result << item;
+    }
+
+    return result;
+}
+
+
+FileInfoList FileRangeIndex::largestFiles( int count, FileInfo * subtree ) const
+{
+    if ( ! isReady() )
+	return FileInfoList();
+
+    return items( _bySize, 0, _bySize.size(), subtree, true, count );
+}
+
+
+FileInfoList FileRangeIndex::newestFiles( int count, FileInfo * subtree ) const
+{
+    if ( ! isReady() )
+	return FileInfoList();
+
+    return items( _byMtime, 0, _byMtime.size(), subtree, true, count );
+}
+
+
+FileInfoList FileRangeIndex::oldestFiles( int count, FileInfo * subtree ) const
+{
+    if ( ! isReady() )
+	return FileInfoList();
+
+    return items( _byMtime, 0, _byMtime.size(), subtree, false, count );
+}
+
+
+FileInfoList FileRangeIndex::filesInSizeRange( FileSize	  minSize,
+					       FileSize	  maxSize,
+					       FileInfo * subtree ) const
+{
+    if ( ! isReady() || minSize >= maxSize )
+	return FileInfoList();
+
+    return items( _bySize,
+		  lowerBound( _bySize, minSize ),
+		  lowerBound( _bySize, maxSize ),
+		  subtree );
+}
+
+
+FileInfoList FileRangeIndex::filesInMtimeRange( time_t	   from,
+						time_t	   to,
+						FileInfo * subtree ) const
+{
+    if ( ! isReady() || from >= to )
+	return FileInfoList();
+
+    return items( _byMtime,
+		  lowerBound( _byMtime, from ),
+		  lowerBound( _byMtime, to ),
+		  subtree );
+}
+
+
+void FileRangeIndex::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "FileRangeIndex" );
+    _enabled = settings.value( "Enabled", true ).toBool();
+    settings.endGroup();
+}
+
+
+void FileRangeIndex::writeSettings()
+{
+    Settings settings;
+    settings.beginGroup( "FileRangeIndex" );
+
+    // Only set this if not already in the settings: The user might have
+    // changed it in the config file.
+    settings.setDefaultValue( "Enabled", _enabled );
+
+    settings.endGroup();
+}
+
+
+
+
+FileRangeIndexBuilder::FileRangeIndexBuilder( DirInfo * root ):
+    QThread(),
+    _root( root ),
+    _cancelled( 0 )
+{
+    CHECK_PTR( _root );
+}
+
+
+FileRangeIndexBuilder::~FileRangeIndexBuilder()
+{
+    cancel();
+    wait();
+}
+
+
+void FileRangeIndexBuilder::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    RangeCollector collector( this );
+    collector.collectSubtree( _root );
+
+    if ( cancelled() )
+	return;
+
+    _bySize.swap ( collector.bySize()  );
+    _byMtime.swap( collector.byMtime() );
+
+    // Sort both lists at the same time
+
+    SortThread mtimeSorter( _byMtime );
+    mtimeSorter.start();
+    std::sort( _bySize.begin(), _bySize.end(), lowerKey );
+    mtimeSorter.wait();
+
+    if ( ! cancelled() )
+    {
+	logInfo() << "File range index with " << _bySize.size() << " files built in "
+		  << timer.elapsed() / 1000.0 << " sec" << endl;
+    }
+}
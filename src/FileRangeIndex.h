@@ -0,0 +1,280 @@
+/*
+ *   File name: FileRangeIndex.h
+ *   Summary:	Sorted indexes of the file sizes and mtimes in a DirTree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef FileRangeIndex_h
+#define FileRangeIndex_h
+
+
+#include <limits>
+
+#include <QObject>
+#include <QThread>
+#include <QAtomicInt>
+#include <QVector>
+
+#include "FileInfo.h"
+
+
+// Subtrees with fewer files than 1/n of all files in the index are walked
+// instead: Filtering all index entries of a range for a small subtree would
+// take longer.
+#define FILE_RANGE_INDEX_MIN_SHARE	16
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class DirInfo;
+    class FileRangeIndexBuilder;
+
+
+    /**
+     * One entry of a FileRangeIndex: A file and its sort key.
+     **/
+    struct FileRangeIndexEntry
+    {
+	qint64	   key;
+	FileInfo * item;
+    };
+
+    typedef QVector<FileRangeIndexEntry> FileRangeIndexEntryList;
+
+
+    /**
+     * In-memory indexes of all regular files in a DirTree, sorted by size
+     * and by modification time, so range queries like "files larger than
+     * 1 GB" or "files modified in March 2019" and the largest, newest or
+     * oldest files can be found with a binary search instead of a
+     * traversal of the whole tree.
+     *
+     * The indexes are built in a separate thread when reading the tree is
+     * finished. Deleting items removes them from the indexes; any other
+     * change to the tree drops them until they are rebuilt. Until then,
+     * isReady() returns 'false', and the callers have to fall back to
+     * traversing the tree.
+     *
+     * Building the indexes can be disabled with the "Enabled" setting in
+     * the "FileRangeIndex" group of the config file.
+     **/
+    class FileRangeIndex: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	FileRangeIndex( DirTree * tree, QObject * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~FileRangeIndex();
+
+	/**
+	 * Return 'true' if building the indexes is enabled.
+	 **/
+	bool enabled() const { return _enabled; }
+
+	/**
+	 * Return 'true' if the indexes are up to date and can be used.
+	 *
+	 * The file sizes depend on how hard links are counted, so changing
+	 * that makes the indexes unusable, too.
+	 **/
+	bool isReady() const;
+
+	/**
+	 * Return 'true' if the indexes are ready and if using them for
+	 * 'subtree' is faster than walking it, i.e. if it is not a lot
+	 * smaller than the complete tree.
+	 **/
+	bool covers( FileInfo * subtree ) const;
+
+	/**
+	 * Return the number of files in the indexes.
+	 **/
+	int fileCount() const { return _bySize.size(); }
+
+	/**
+	 * Return the 'count' largest, newest or oldest files in 'subtree'
+	 * (or in the complete tree if 'subtree' is 0), the one with the
+	 * largest, newest or oldest one first.
+	 *
+	 * These return an empty list if the indexes are not ready.
+	 **/
+	FileInfoList largestFiles( int count, FileInfo * subtree = 0 ) const;
+	FileInfoList newestFiles ( int count, FileInfo * subtree = 0 ) const;
+	FileInfoList oldestFiles ( int count, FileInfo * subtree = 0 ) const;
+
+	/**
+	 * Return all files in 'subtree' (or in the complete tree if 'subtree'
+	 * is 0) with minSize <= size() < maxSize, the smallest first.
+	 *
+	 * This returns an empty list if the indexes are not ready.
+	 **/
+	FileInfoList filesInSizeRange( FileSize	  minSize,
+				       FileSize	  maxSize = std::numeric_limits<FileSize>::max(),
+				       FileInfo * subtree = 0 ) const;
+
+	/**
+	 * Return all files in 'subtree' (or in the complete tree if 'subtree'
+	 * is 0) with from <= mtime() < to, the oldest first.
+	 *
+	 * This returns an empty list if the indexes are not ready.
+	 **/
+	FileInfoList filesInMtimeRange( time_t	   from,
+					time_t	   to,
+					FileInfo * subtree = 0 ) const;
+
+
+    public slots:
+
+	/**
+	 * Drop the indexes and build them again in a separate thread.
+	 **/
+	void rebuild();
+
+	/**
+	 * Drop the indexes (and stop building them if that is in progress).
+	 **/
+	void invalidate();
+
+
+    signals:
+
+	/**
+	 * Emitted when the indexes are ready to be used.
+	 **/
+	void ready();
+
+
+    protected slots:
+
+	/**
+	 * Notification that the builder thread is finished.
+	 **/
+	void builderFinished();
+
+	/**
+	 * Remove 'child' and all files in its subtree from the indexes.
+	 * This is called before the child is deleted.
+	 **/
+	void deletingChild( FileInfo * child );
+
+
+    protected:
+
+	/**
+	 * Return the items of the entries from 'begin' to before 'end' that
+	 * are in 'subtree' (or all if 'subtree' is 0 or the root), in that
+	 * order, or in reverse order from 'end' down to 'begin' if 'reverse'
+	 * is 'true'. Stop after 'maxCount' items if that is not negative.
+	 **/
+	FileInfoList items( const FileRangeIndexEntryList & entries,
+			    int				    begin,
+			    int				    end,
+			    FileInfo			  * subtree,
+			    bool			    reverse  = false,
+			    int				    maxCount = -1 ) const;
+
+	/**
+	 * Return the index of the first entry with a key of at least 'key'.
+	 **/
+	static int lowerBound( const FileRangeIndexEntryList & entries, qint64 key );
+
+	/**
+	 * Remove the entry for 'item' with key 'key' from 'entries'.
+	 **/
+	static void removeEntry( FileRangeIndexEntryList & entries,
+				 qint64			   key,
+				 FileInfo		 * item );
+
+	/**
+	 * Remove the entries of all items in 'subtree' from 'entries'.
+	 **/
+	static void removeSubtree( FileRangeIndexEntryList & entries,
+				   FileInfo		   * subtree );
+
+	/**
+	 * Read and write the settings.
+	 **/
+	void readSettings();
+	void writeSettings();
+
+
+	//
+	// Data members
+	//
+
+	DirTree *		_tree;
+	bool			_enabled;
+	bool			_ready;
+	bool			_ignoreHardLinks;	// at the time of building
+	bool			_countHardLinksOnce;	// at the time of building
+	FileRangeIndexBuilder * _builder;
+
+	FileRangeIndexEntryList _bySize;
+	FileRangeIndexEntryList _byMtime;
+
+    };	// class FileRangeIndex
+
+
+
+    /**
+     * Thread to build the data of a FileRangeIndex.
+     **/
+    class FileRangeIndexBuilder: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	FileRangeIndexBuilder( DirInfo * root );
+
+	/**
+	 * Destructor. This cancels the thread and waits for it.
+	 **/
+	virtual ~FileRangeIndexBuilder();
+
+	/**
+	 * Request the thread to stop as soon as possible.
+	 **/
+	void cancel() { _cancelled.storeRelease( 1 ); }
+
+	/**
+	 * Return 'true' if cancel() was called.
+	 **/
+	bool cancelled() const { return _cancelled.loadAcquire() != 0; }
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	DirInfo *		_root;
+	QAtomicInt		_cancelled;
+
+	// The results. The FileRangeIndex takes them over when this thread
+	// is finished and not cancelled.
+
+	FileRangeIndexEntryList _bySize;
+	FileRangeIndexEntryList _byMtime;
+
+	friend class FileRangeIndex;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// FileRangeIndex_h
@@ -12,6 +12,9 @@
 
 #include "FileSizeStats.h"
 #include "FileInfoIterator.h"
+#include "FileColumns.h"
+#include "DirTreeCache.h"
+#include "DirInfo.h"
 #include "FormatUtil.h"
 #include "Exception.h"
 
@@ -21,13 +24,18 @@ using namespace QDirStat;
 
 
 FileSizeStats::FileSizeStats( FileInfo * subtree ):
-    PercentileStats()
+    PercentileStats(),
+    _approximatedFiles( 0 )
 {
     if ( subtree )
-    {
         collect( subtree );
-        sort();
-    }
+}
+
+
+void FileSizeStats::clear()
+{
+    PercentileStats::clear();
+    _approximatedFiles = 0;
 }
 
 
@@ -35,65 +43,103 @@ void FileSizeStats::collect( FileInfo * subtree )
 {
     Q_CHECK_PTR( subtree );
 
-    if ( _data.isEmpty() )
-        _data.reserve( subtree->totalFiles() );
+    if ( dataSize() == 0 )
+        reserve( subtree->totalFiles() );
 
-    if ( subtree->isFile() )
-        _data << subtree->size();
+    _suffix.clear();
 
-    FileInfoIterator it( subtree );
+    if ( subtree->isDirInfo() && subtree->toDirInfo()->isCachePlaceholder() )
+	collectOther( subtree );	// It has no children to recurse into
+    else
+	collectSubtree( subtree );
+}
 
-    while ( *it )
-    {
-	FileInfo * item = *it;
 
-	if ( item->hasChildren() )
-	{
-	    collect( item );
-	}
-	else if ( item->isFile() )
-	{
-            _data << item->size();
-	}
-	// Disregard symlinks, block devices and other special files
+void FileSizeStats::collect( FileInfo * subtree, const QString & suffix )
+{
+    Q_CHECK_PTR( subtree );
 
-	++it;
-    }
+    // Not reserving subtree->totalFiles() here: Typically only a few of
+    // them have that suffix, and that might needlessly switch to the sketch.
+
+    _suffix = suffix;
+    collectSubtree( subtree );
+    _suffix.clear();
 }
 
 
-void FileSizeStats::collect( FileInfo * subtree, const QString & suffix )
+SubtreeCollector * FileSizeStats::createPartial() const
 {
-    Q_CHECK_PTR( subtree );
+    FileSizeStats * partial = new FileSizeStats();
+    CHECK_NEW( partial );
+
+    partial->setSketchRelativeError( sketchRelativeError() );
+    partial->setSketchThreshold( sketchThreshold() );
+    partial->_suffix = _suffix;
+
+    return partial;
+}
+
+
+void FileSizeStats::collectFile( FileInfo * file )
+{
+    if ( _suffix.isEmpty() || file->name().toLower().endsWith( _suffix ) )
+        append( file->size() );
+}
+
+
+void FileSizeStats::collectOther( FileInfo * item )
+{
+    // Only the sizes are known, not the names of the files
 
-    if ( _data.isEmpty() )
-        _data.reserve( subtree->totalFiles() );
+    if ( ! _suffix.isEmpty() || ! item->isDirInfo() || ! item->toDirInfo()->isCachePlaceholder() )
+	return;
 
-    if ( subtree->isFile() && subtree->name().toLower().endsWith( suffix ) )
-        _data << subtree->size();
+    CacheBlockInfo block;
 
-    FileInfoIterator it( subtree );
+    if ( ! item->tree()->cachePlaceholderBlock( item->toDirInfo(), block ) ||
+	 block.sizeClasses.isEmpty() )
+    {
+	return;
+    }
 
-    while ( *it )
+    for ( int i=0; i < block.sizeClasses.size(); ++i )
     {
-	FileInfo * item = *it;
+	int count = block.sizeClasses.at( i );
 
-	if ( item->hasChildren() )
-	{
-	    collect( item, suffix );
-	}
-	else if ( item->isFile() )
+	if ( count > 0 )
 	{
-            if ( item->name().toLower().endsWith( suffix ) )
-                _data << item->size();
+	    append( CacheBlockInfo::sizeClassValue( i ), count );
+	    _approximatedFiles += count;
 	}
-	// Disregard symlinks, block devices and other special files
-
-	++it;
     }
 }
 
 
+bool FileSizeStats::collectFileColumns( const FileColumns & columns )
+{
+    if ( ! _suffix.isEmpty() )
+	return false;
+
+    const FileSize * sizes = columns.sizes().constData();
+    int count = columns.count();
+
+    for ( int i = 0; i < count; ++i )
+	append( sizes[ i ] );
+
+    return true;
+}
+
+
+void FileSizeStats::merge( SubtreeCollector * partial )
+{
+    FileSizeStats * stats = static_cast<FileSizeStats *>( partial );
+
+    PercentileStats::merge( *stats );
+    _approximatedFiles += stats->_approximatedFiles;
+}
+
+
 QRealList FileSizeStats::fillBuckets( int bucketCount,
                                       int startPercentile,
                                       int endPercentile )
@@ -113,13 +159,10 @@ QRealList FileSizeStats::fillBuckets( int bucketCount,
     for ( int i=0; i < bucketCount; ++i )
         buckets << 0.0;
 
-    if ( _data.isEmpty() )
+    if ( dataSize() == 0 )
         return buckets;
 
 
-    // The first call to percentile() or quantile() will cause the data to be
-    // sorted, so there is no need to sort them again here.
-
     qreal startVal = percentile( startPercentile );
     qreal endVal   = percentile( endPercentile );
     qreal bucketWidth = ( endVal - startVal ) / bucketCount;
@@ -133,19 +176,33 @@ QRealList FileSizeStats::fillBuckets( int bucketCount,
                << endl;
 #endif
 
+    if ( _useSketch )
+    {
+        // Approximate the number of data items in each bucket from the
+        // sketch; the last bucket includes 'endVal'.
+
+        qreal previousCount = _sketch.countBelow( startVal );
+
+        for ( int i=0; i < bucketCount; ++i )
+        {
+            qreal count = i == bucketCount - 1 && endVal >= _sketch.max() ?
+                _sketch.count() : _sketch.countBelow( startVal + ( i + 1 ) * bucketWidth );
+
+            buckets[ i ] = qRound64( count - previousCount );
+            previousCount = count;
+        }
+
+        return buckets;
+    }
+
     for ( int i=0; i < _data.size(); ++i )
     {
         qreal val = _data.at( i );
 
-        if ( val < startVal )
-            continue;
-
-        if ( val > endVal )
-            break;
+        // The data are not necessarily sorted, so check all of them
 
-        // TO DO: Optimize this by taking into account that the data are sorted
-        // already. We don't really need that many divisions; just when leaving
-        // the current bucket would be sufficient.
+        if ( val < startVal || val > endVal )
+            continue;
 
         int index = qMin( ( val - startVal ) / bucketWidth, bucketCount - 1.0 );
         ++buckets[ index ];
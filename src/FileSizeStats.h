@@ -11,6 +11,7 @@
 #define FileSizeStats_h
 
 #include "PercentileStats.h"
+#include "SubtreeCollector.h"
 #include "FileInfo.h"
 
 
@@ -23,12 +24,11 @@ namespace QDirStat
      * calculating a median or quantiles or histograms.
      *
      * Notice that one data item (one qreal, i.e. one 64 bit double) is
-     * stored for each file (or each matching file) in this object, so this is
-     * expensive in terms of memory usage. Also, since data usually need to be
-     * sorted for those calculations and sorting has at least logarithmic cost
-     * O( n * log(n) ), this also has heavy performance impact.
+     * stored for each file (or each matching file) in this object up to the
+     * sketch threshold of PercentileStats, so this is expensive in terms of
+     * memory usage.
      **/
-    class FileSizeStats: public PercentileStats
+    class FileSizeStats: public PercentileStats, public SubtreeCollector
     {
     public:
 
@@ -38,10 +38,16 @@ namespace QDirStat
 	 **/
 	FileSizeStats( FileInfo * subtree = 0 );
 
+	/**
+	 * Clear all data.
+	 **/
+	void clear();
+
 	/**
 	 * Recurse through all file elements in the subtree and append the own
 	 * size for each file to the data collection. Notice that the data are
-	 * unsorted after this.
+	 * unsorted after this. Large subtrees are collected in several
+	 * threads.
 	 **/
 	void collect( FileInfo * subtree );
 
@@ -61,6 +67,58 @@ namespace QDirStat
         QRealList fillBuckets( int bucketCount,
                                int startPercentile,
                                int endPercentile );
+
+	/**
+	 * Return the number of files that were not collected with their
+	 * own size, but with the size class histogram of a cache placeholder
+	 * (see DirTree::lazyCacheLoading()) whose block was not read yet.
+	 **/
+	qint64 approximatedFiles() const { return _approximatedFiles; }
+
+    protected:
+
+	/**
+	 * Create an empty FileSizeStats object with the same settings for
+	 * collecting in another thread.
+	 *
+	 * Implemented from SubtreeCollector.
+	 **/
+	virtual SubtreeCollector * createPartial() const Q_DECL_OVERRIDE;
+
+	/**
+	 * Append the size of 'file' if it has the suffix to collect.
+	 *
+	 * Implemented from SubtreeCollector.
+	 **/
+	virtual void collectFile( FileInfo * file ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Append the sizes of the files of 'item' if it is a cache
+	 * placeholder with a size class histogram: The middle of each size
+	 * class as often as there are files in it.
+	 *
+	 * Reimplemented from SubtreeCollector.
+	 **/
+	virtual void collectOther( FileInfo * item ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Append all sizes of 'columns' unless only files with a suffix are
+	 * collected.
+	 *
+	 * Reimplemented from SubtreeCollector.
+	 **/
+	virtual bool collectFileColumns( const FileColumns & columns ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Append the data of 'partial'.
+	 *
+	 * Implemented from SubtreeCollector.
+	 **/
+	virtual void merge( SubtreeCollector * partial ) Q_DECL_OVERRIDE;
+
+
+	QString _suffix;	// Only while collecting
+	qint64	_approximatedFiles;
     };
 
 }	// namespace QDirStat
@@ -19,10 +19,12 @@
 #include "BucketsTableModel.h"
 #include "DirTree.h"
 #include "MainWindow.h"
+#include "Settings.h"
 #include "SettingsHelpers.h"
 #include "HeaderTweaker.h"
 #include "QDirStatApp.h"
 #include "FormatUtil.h"
+#include "StallWatchdog.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -48,6 +50,7 @@ FileSizeStatsWindow::FileSizeStatsWindow( QWidget * parent ):
 
     _stats = new FileSizeStats();
     CHECK_NEW( _stats );
+    readSettings();
 
     _bucketsTableModel = new BucketsTableModel( this, _ui->histogramView );
     CHECK_NEW( _bucketsTableModel );
@@ -121,6 +124,31 @@ void FileSizeStatsWindow::initWidgets()
 }
 
 
+void FileSizeStatsWindow::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "FileSizeStatsWindow" );
+
+    // Above this number of files, use an approximation with this relative
+    // error instead of all file sizes
+
+    int	  sketchThreshold     = settings.value( "SketchThreshold",     _stats->sketchThreshold()     ).toInt();
+    qreal sketchRelativeError = settings.value( "SketchRelativeError", _stats->sketchRelativeError() ).toReal();
+
+    settings.setDefaultValue( "SketchThreshold",     sketchThreshold );
+    settings.setDefaultValue( "SketchRelativeError", QString::number( sketchRelativeError ) );
+
+    settings.endGroup();
+
+    _stats->setSketchThreshold( sketchThreshold );
+
+    if ( sketchRelativeError > 0.0 && sketchRelativeError < 1.0 )
+	_stats->setSketchRelativeError( sketchRelativeError );
+    else
+	logWarning() << "Ignoring invalid SketchRelativeError " << sketchRelativeError << endl;
+}
+
+
 void FileSizeStatsWindow::calc()
 {
     _stats->clear();
@@ -130,7 +158,19 @@ void FileSizeStatsWindow::calc()
     else
 	_stats->collect( _subtree, _suffix );
 
-    _stats->sort();
+    if ( _stats->usesSketch() )
+    {
+	_ui->heading->setText( _ui->heading->text() + " " +
+			       tr( "(approximated with %1% relative error)" )
+			       .arg( 100.0 * _stats->sketchRelativeError() ) );
+    }
+
+    if ( _stats->approximatedFiles() > 0 )
+    {
+	_ui->heading->setText( _ui->heading->text() + " " +
+			       tr( "(%1 files not read from the cache file yet counted by size class)" )
+			       .arg( _stats->approximatedFiles() ) );
+    }
 }
 
 
@@ -147,6 +187,8 @@ void FileSizeStatsWindow::populateSharedInstance( FileInfo *	  subtree,
 
 void FileSizeStatsWindow::populate( FileInfo * subtree, const QString & suffix )
 {
+    StallOperation operation( "File size statistics" );
+
     _subtree = subtree;
     _suffix  = suffix;
 
@@ -450,7 +492,7 @@ void FileSizeStatsWindow::applyOptions()
 	histogram->setEndPercentile  ( newEnd	);
 	fillBuckets();
 	histogram->autoLogHeightScale(); // FIXME
-	histogram->rebuild();
+	histogram->updateRange();
     }
 }
 
@@ -462,7 +504,7 @@ void FileSizeStatsWindow::autoPercentiles()
     updateOptions();
     fillBuckets();
     _ui->histogramView->autoLogHeightScale(); // FIXME
-    _ui->histogramView->rebuild();
+    _ui->histogramView->updateRange();
 }
 
 
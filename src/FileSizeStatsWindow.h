@@ -146,6 +146,12 @@ namespace QDirStat
 	 **/
 	void initWidgets();
 
+	/**
+	 * Read the settings for the statistics calculation from the config
+	 * file.
+	 **/
+	void readSettings();
+
         /**
          * Update the values for the option widgets from the current ones from
          * the histogram.
@@ -0,0 +1,365 @@
+/*
+ *   File name: FileSpillStore.cpp
+ *   Summary:	Packed store for the files of a huge directory tree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <string.h>	// memcpy(), memcmp()
+
+#include <QDir>
+
+#include "FileSpillStore.h"
+#include "DirInfo.h"
+#include "DirTree.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Round 'size' up to the next multiple of 8.
+     **/
+    int align8( int size )
+    {
+	return ( size + 7 ) & ~7;
+    }
+}
+
+
+FileSpillStore::FileSpillStore( Backing backing, const QString & dirName ):
+    _backing( backing ),
+    _ok( false ),
+    _fileSize( 0 ),
+    _map( 0 ),
+    _mapSize( 0 ),
+    _sharedCount( 0 ),
+    _sharedSize( 0 )
+{
+    if ( _backing == InMemory )
+    {
+	_ok = true;
+	return;
+    }
+
+    QString dir = dirName.isEmpty() ? QDir::tempPath() : dirName;
+    _file.setFileTemplate( dir + "/qdirstat-spill-XXXXXX" );
+    _ok = _file.open();
+
+    if ( _ok )
+	logInfo() << "Spilling files to " << _file.fileName() << endl;
+    else
+	logError() << "Can't create a spill file in " << dir << ": " << _file.errorString() << endl;
+}
+
+
+FileSpillStore::~FileSpillStore()
+{
+    if ( _map )
+	_file.unmap( _map );
+
+    if ( _ok && _backing == TempFile )
+    {
+	logDebug() << "Removing " << _file.fileName() << " with " << _segments.size()
+		   << " spilled directories" << endl;
+    }
+
+    // QTemporaryFile removes the file
+}
+
+
+bool FileSpillStore::spill( DirInfo * dir )
+{
+    if ( ! _ok || ! dir || _segments.contains( dir ) )
+	return false;
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() )
+	    return false;
+    }
+
+    // In memory, the records go directly to the end of the buffer
+
+    QByteArray   tempBuffer;
+    QByteArray & buffer = _backing == InMemory ? _buffer : tempBuffer;
+    int start = buffer.size();
+    int count = 0;
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	appendRecord( buffer, child );
+	++count;
+    }
+
+    const char * data = buffer.constData() + start;
+    qint64	 size = buffer.size() - start;
+    uint	 hash = qHash( QByteArray::fromRawData( data, size ) );
+    Segment	 segment;
+
+    if ( size > 0 && findIdentical( hash, data, size, count, segment ) )
+    {
+	// Share the records of an identical directory
+
+	if ( _backing == InMemory )
+	    buffer.resize( start );
+
+	++_sharedCount;
+	_sharedSize += size;
+    }
+    else
+    {
+	if ( _backing == TempFile && _file.write( buffer ) != buffer.size() )
+	{
+	    logError() << "Error writing " << _file.fileName() << ": " << _file.errorString() << endl;
+	    _ok = false;	// Keep everything in memory from now on
+
+	    return false;
+	}
+
+	segment.offset = _fileSize;
+	segment.size   = size;
+	segment.count  = count;
+	_fileSize += size;
+
+	if ( size > 0 )
+	    _identical.insert( hash, segment );
+    }
+
+    _segments.insert( dir, segment );
+
+    if ( size > 0 )
+	++_segmentRefs[ segment.offset ];
+
+    return true;
+}
+
+
+bool FileSpillStore::findIdentical( uint	 hash,
+				    const char * data,
+				    qint64	 size,
+				    int		 count,
+				    Segment &	 segment_ret )
+{
+    QMultiHash<uint, Segment>::const_iterator it = _identical.constFind( hash );
+
+    while ( it != _identical.constEnd() && it.key() == hash )
+    {
+	const Segment & candidate = it.value();
+
+	if ( candidate.size  == size  &&
+	     candidate.count == count &&
+	     ensureMapped( candidate.offset + candidate.size ) &&
+	     memcmp( records() + candidate.offset, data, size ) == 0 )
+	{
+	    segment_ret = candidate;
+	    return true;
+	}
+
+	++it;
+    }
+
+    return false;
+}
+
+
+void FileSpillStore::releaseSegment( const Segment & segment )
+{
+    if ( segment.size == 0 )
+	return;
+
+    QHash<qint64, int>::iterator it = _segmentRefs.find( segment.offset );
+
+    if ( it == _segmentRefs.end() )
+	return;
+
+    if ( it.value() > 1 )
+    {
+	--_sharedCount;
+	_sharedSize -= segment.size;
+    }
+
+    if ( --it.value() <= 0 )
+	_segmentRefs.erase( it );
+}
+
+
+int FileSpillStore::copies( DirInfo * dir ) const
+{
+    if ( ! _segments.contains( dir ) )
+	return 0;
+
+    const Segment & segment = _segments[ dir ];
+
+    return segment.size > 0 ? _segmentRefs.value( segment.offset, 1 ) : 1;
+}
+
+
+void FileSpillStore::appendRecord( QByteArray & buffer, FileInfo * item )
+{
+    QByteArray name = item->name().toUtf8();
+
+    SpillRecord record;
+    memset( &record, 0, sizeof( record ) );
+
+    record.size	      = item->_size;
+    record.blocks     = item->_blocks;
+    record.mtime      = item->_mtime;
+    record.links      = item->_links;
+    record.mode	      = item->_mode;
+    record.deviceNo   = item->_deviceNo;
+    record.uidNo      = item->_uidNo;
+    record.gidNo      = item->_gidNo;
+    record.categoryId = item->_categoryId;
+    record.nameLen    = name.size();
+
+    if ( item->_isLocalFile	    ) record.flags |= SpillLocalFile;
+    if ( item->_isSparseFile	    ) record.flags |= SpillSparseFile;
+    if ( item->_isIgnored	    ) record.flags |= SpillIgnored;
+    if ( item->_allocatedIsByteSize ) record.flags |= SpillAllocatedIsByteSize;
+    if ( item->_hardLinkChecked	    ) record.flags |= SpillHardLinkChecked;
+    if ( item->_isHardLinkDuplicate ) record.flags |= SpillHardLinkDuplicate;
+
+    int start = buffer.size();
+    buffer.resize( start + align8( sizeof( record ) + name.size() ) );
+
+    char * pos = buffer.data() + start;
+    memcpy( pos, &record, sizeof( record ) );
+    memcpy( pos + sizeof( record ), name.constData(), name.size() );
+}
+
+
+bool FileSpillStore::ensureMapped( qint64 size )
+{
+    if ( _backing == InMemory || size <= _mapSize )
+	return true;
+
+    if ( _map )
+    {
+	_file.unmap( _map );
+	_map	 = 0;
+	_mapSize = 0;
+    }
+
+    _file.flush();
+    _map = _file.map( 0, _fileSize );
+
+    if ( ! _map )
+    {
+	logError() << "Can't map " << _file.fileName() << ": " << _file.errorString() << endl;
+	return false;
+    }
+
+    _mapSize = _fileSize;
+
+    return true;
+}
+
+
+const uchar * FileSpillStore::records() const
+{
+    if ( _backing == InMemory )
+	return (const uchar *) _buffer.constData();
+    else
+	return _map;
+}
+
+
+bool FileSpillStore::load( DirInfo * dir )
+{
+    if ( ! _segments.contains( dir ) )
+	return false;
+
+    Segment segment = _segments.take( dir );
+    releaseSegment( segment );
+
+    if ( segment.count == 0 )
+	return true;
+
+    if ( ! ensureMapped( segment.offset + segment.size ) )
+	return false;
+
+    const uchar * pos = records() + segment.offset;
+    const uchar * end = pos + segment.size;
+
+    for ( int i = 0; i < segment.count && pos < end; ++i )
+    {
+	FileInfo * item = 0;
+	pos += createItem( pos, dir, item );
+	dir->insertChild( item );
+    }
+
+    if ( _backing == InMemory && _segments.isEmpty() )
+	clearBuffer();
+
+    return true;
+}
+
+
+int FileSpillStore::createItem( const uchar * pos, DirInfo * dir, FileInfo *& item_ret )
+{
+    SpillRecord record;
+    memcpy( &record, pos, sizeof( record ) );
+
+    QString name = QString::fromUtf8( (const char *) pos + sizeof( record ), record.nameLen );
+
+    FileInfo * item = new FileInfo( dir->tree(), dir, name,
+				    record.mode, record.size, record.mtime,
+				    record.blocks, record.links );
+    CHECK_NEW( item );
+
+    item->_deviceNo	       = record.deviceNo;
+    item->_uidNo	       = record.uidNo;
+    item->_gidNo	       = record.gidNo;
+    item->_categoryId	       = record.categoryId;
+    item->_isLocalFile	       = record.flags & SpillLocalFile;
+    item->_isSparseFile	       = record.flags & SpillSparseFile;
+    item->_isIgnored	       = record.flags & SpillIgnored;
+    item->_allocatedIsByteSize = record.flags & SpillAllocatedIsByteSize;
+    item->_hardLinkChecked     = record.flags & SpillHardLinkChecked;
+    item->_isHardLinkDuplicate = record.flags & SpillHardLinkDuplicate;
+
+    item_ret = item;
+
+    return align8( sizeof( record ) + record.nameLen );
+}
+
+
+void FileSpillStore::forget( FileInfo * subtree )
+{
+    if ( _segments.isEmpty() )
+	return;
+
+    QMutableHashIterator<DirInfo *, Segment> it( _segments );
+
+    while ( it.hasNext() )
+    {
+	if ( it.next().key()->isInSubtree( subtree ) )
+	{
+	    releaseSegment( it.value() );
+	    it.remove();
+	}
+    }
+
+    if ( _backing == InMemory && _segments.isEmpty() )
+	clearBuffer();
+}
+
+
+void FileSpillStore::clearBuffer()
+{
+    // Nothing refers to the buffer anymore, so it can start over
+
+    _buffer.clear();
+    _fileSize = 0;
+    _identical.clear();
+    _segmentRefs.clear();
+    _sharedCount = 0;
+    _sharedSize	 = 0;
+}
@@ -0,0 +1,260 @@
+/*
+ *   File name: FileSpillStore.h
+ *   Summary:	Packed store for the files of a huge directory tree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef FileSpillStore_h
+#define FileSpillStore_h
+
+
+#include <QByteArray>
+#include <QHash>
+#include <QTemporaryFile>
+
+
+// Directories with fewer files than this are not worth spilling
+#define SPILL_MIN_FILES		8
+
+
+namespace QDirStat
+{
+    class FileInfo;
+    class DirInfo;
+
+
+    /**
+     * One record of a spilled file. The UTF-8 name follows the record;
+     * the next record starts at the next multiple of 8 bytes.
+     **/
+    struct SpillRecord
+    {
+	qint64	size;
+	qint64	blocks;
+	qint64	mtime;
+	quint32 links;
+	quint16 mode;
+	quint16 deviceNo;	// the table indices of FileInfo
+	quint16 uidNo;
+	quint16 gidNo;
+	quint8	flags;		// SpillFlags
+	quint8	categoryId;
+	quint16 nameLen;	// bytes
+    };
+
+
+    /**
+     * Temporary file for the non-directory children of directories, so a
+     * tree with hundreds of millions of files does not need to keep them
+     * all in memory: Only the directories with their summaries stay in the
+     * tree.
+     *
+     * spill() appends the children of a directory (usually a dot entry) to
+     * the file; the caller then deletes them from the tree, and the
+     * directory becomes a cache placeholder (see
+     * DirInfo::spillChildren()). When it is needed again, e.g. when it is
+     * expanded in the tree view, load() creates the children again from
+     * the memory-mapped file. That is fast enough to do synchronously.
+     *
+     * The file is deleted when the store is destroyed. The space of
+     * directories that were loaded again or deleted is not reused.
+     *
+     * With InMemory, the records are kept in one buffer in memory instead
+     * of a file. That is still much more compact than the FileInfo objects
+     * (about 60 instead of more than 100 bytes per file), so this is used
+     * to freeze the files that are not needed after reading (see
+     * DirTree::freezeColdFiles()).
+     *
+     * Directories with identical files, e.g. the many copies of the same
+     * vendored packages that were extracted from the same archives, share
+     * one copy of the records: They are never changed, and load() creates
+     * new items from them for each directory anyway.
+     **/
+    class FileSpillStore
+    {
+    public:
+
+	enum Backing
+	{
+	    TempFile,
+	    InMemory
+	};
+
+	/**
+	 * Constructor. For TempFile, the file is created in directory
+	 * 'dirName' or, if that is empty, in the default directory for
+	 * temporary files.
+	 **/
+	FileSpillStore( Backing backing = TempFile, const QString & dirName = QString() );
+
+	/**
+	 * Destructor. This removes the file.
+	 **/
+	~FileSpillStore();
+
+	/**
+	 * Return 'true' if the file could be created.
+	 **/
+	bool ok() const { return _ok; }
+
+	/**
+	 * Return 'true' if the records are kept in memory.
+	 **/
+	bool inMemory() const { return _backing == InMemory; }
+
+	/**
+	 * Write all children of 'dir' to the file. They must not be
+	 * directories. Return 'true' on success.
+	 *
+	 * This does not change anything in the tree.
+	 **/
+	bool spill( DirInfo * dir );
+
+	/**
+	 * Return 'true' if 'dir' is spilled, i.e. spill() was called for it,
+	 * but not load() yet.
+	 **/
+	bool contains( DirInfo * dir ) const { return _segments.contains( dir ); }
+
+	/**
+	 * Return the number of spilled directories.
+	 **/
+	int count() const { return _segments.size(); }
+
+	/**
+	 * Return the directories that are spilled.
+	 **/
+	QList<DirInfo *> dirs() const { return _segments.keys(); }
+
+	/**
+	 * Create the children of 'dir' again from the file and add them to
+	 * 'dir'. 'dir' is no longer spilled after this. Return 'false' if it
+	 * was not spilled or on error.
+	 **/
+	bool load( DirInfo * dir );
+
+	/**
+	 * Forget all spilled directories in 'subtree' (including 'subtree'
+	 * itself), e.g. because it is about to be deleted.
+	 **/
+	void forget( FileInfo * subtree );
+
+	/**
+	 * Return the size of the file (or the buffer) in bytes.
+	 **/
+	qint64 fileSize() const { return _fileSize; }
+
+	/**
+	 * Return the number of spilled directories with exactly the same
+	 * files as 'dir' (including 'dir' itself) or 0 if 'dir' is not
+	 * spilled.
+	 **/
+	int copies( DirInfo * dir ) const;
+
+	/**
+	 * Return the number of spilled directories that share the records
+	 * of an identical one.
+	 **/
+	int sharedCount() const { return _sharedCount; }
+
+	/**
+	 * Return the number of bytes that sharing the records of identical
+	 * directories saves.
+	 **/
+	qint64 sharedSize() const { return _sharedSize; }
+
+	/**
+	 * Release the memory that the buffer reserved for more records.
+	 * This only does anything for InMemory.
+	 **/
+	void squeeze() { _buffer.squeeze(); }
+
+
+    protected:
+
+	enum SpillFlags
+	{
+	    SpillLocalFile	     = 0x01,
+	    SpillSparseFile	     = 0x02,
+	    SpillIgnored	     = 0x04,
+	    SpillAllocatedIsByteSize = 0x08,
+	    SpillHardLinkChecked     = 0x10,
+	    SpillHardLinkDuplicate   = 0x20
+	};
+
+	/**
+	 * The records of one directory in the file.
+	 **/
+	struct Segment
+	{
+	    qint64 offset;
+	    qint64 size;
+	    int	   count;
+	};
+
+	/**
+	 * Make sure the file is mapped up to at least 'size' bytes.
+	 * Return 'false' on error.
+	 **/
+	bool ensureMapped( qint64 size );
+
+	/**
+	 * Return the start of the records, i.e. the file mapping or the
+	 * buffer.
+	 **/
+	const uchar * records() const;
+
+	/**
+	 * Free the buffer when no directory refers to it anymore.
+	 **/
+	void clearBuffer();
+
+	/**
+	 * Find a segment with exactly the records 'data' of 'size' bytes for
+	 * 'count' files and return it in 'segment_ret'. Return 'false' if
+	 * there is none.
+	 **/
+	bool findIdentical( uint	   hash,
+			    const char *   data,
+			    qint64	   size,
+			    int		   count,
+			    Segment &	   segment_ret );
+
+	/**
+	 * Notification that a directory no longer uses 'segment'.
+	 **/
+	void releaseSegment( const Segment & segment );
+
+	/**
+	 * Append the record for 'item' to 'buffer'.
+	 **/
+	static void appendRecord( QByteArray & buffer, FileInfo * item );
+
+	/**
+	 * Create a FileInfo from the record at 'pos' for the tree and parent
+	 * of 'dir' and return the size of that record in the file.
+	 **/
+	static int createItem( const uchar * pos, DirInfo * dir, FileInfo *& item_ret );
+
+
+	Backing			  _backing;
+	QTemporaryFile		  _file;
+	QByteArray		  _buffer;
+	bool			  _ok;
+	qint64			  _fileSize;
+	uchar *			  _map;
+	qint64			  _mapSize;
+	QHash<DirInfo *, Segment> _segments;
+	QMultiHash<uint, Segment> _identical;	// by hash of the records
+	QHash<qint64, int>	  _segmentRefs;	// directories by offset
+	int			  _sharedCount;
+	qint64			  _sharedSize;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef FileSpillStore_h
@@ -39,6 +39,10 @@ FileTypeStats::~FileTypeStats()
 
 void FileTypeStats::clear()
 {
+    _suffixIds.clear();
+    _suffixNames.clear();
+    _suffixSums.clear();
+    _categorySums.clear();
     _suffixSum.clear();
     _suffixCount.clear();
     _categorySum.clear();
@@ -94,7 +98,12 @@ void FileTypeStats::calc( FileInfo * subtree )
 
     if ( subtree && subtree->checkMagicNumber() )
     {
-        collect( subtree );
+        // Build the categorizer's lookup maps before any other threads use
+        // it
+
+        _mimeCategorizer->generation();
+        collectSubtree( subtree );
+        buildResultMaps();
         _totalSize = subtree->totalSize();
         removeCruft();
         removeEmpty();
@@ -105,76 +114,141 @@ void FileTypeStats::calc( FileInfo * subtree )
 }
 
 
-void FileTypeStats::collect( FileInfo * dir )
+SubtreeCollector * FileTypeStats::createPartial() const
 {
-    if ( ! dir )
-	return;
+    FileTypeStats * partial = new FileTypeStats();
+    CHECK_NEW( partial );
+
+    return partial;
+}
 
-    FileInfoIterator it( dir );
 
-    while ( *it )
+void FileTypeStats::collectFile( FileInfo * file )
+{
+    QString suffix;
+
+    // First attempt: Try the MIME categorizer.
+    //
+    // If it knows the file's suffix, it can much easier find the
+    // correct one in case there are multiple to choose from, for
+    // example ".tar.bz2", not ".bz2" for a bzipped tarball. But on
+    // Linux systems, having multiple dots in filenames is very common,
+    // e.g. in .deb or .rpm packages, so the longest possible suffix is
+    // not always the useful one (because it might contain version
+    // numbers and all kinds of irrelevant information).
+    //
+    // The suffixes the MIME categorizer knows are carefully
+    // hand-crafted, so if it knows anything about a suffix, it's the
+    // best choice.
+
+    MimeCategory * category = _mimeCategorizer->category( file->name(), &suffix );
+
+    if ( ! category )
+	category = _otherCategory;
+
+    FileTypeSum & categorySum = _categorySums[ category ];
+    categorySum.sum += file->size();
+    ++categorySum.count;
+
+    if ( suffix.isEmpty() )
     {
-	FileInfo * item = *it;
+	const QString & name = file->name();
+	int dotPos = name.lastIndexOf( '.' );
 
-	if ( item->hasChildren() )
+	if ( dotPos > 0 && ! name.startsWith( '.' ) )
 	{
-	    collect( item );
+	    // Fall back to the last (i.e. the shortest) suffix if the
+	    // MIME categorizer didn't know it.
+	    //
+	    // The downside is that this would not find a ".tar.bz",
+	    // but just the ".bz" for a compressed tarball. But it's
+	    // much better than getting a ".eab7d88df-git.deb" rather
+	    // than a ".deb".
+
+	    suffix = name.mid( dotPos + 1 );
 	}
-	else if ( item->isFile() )
-	{
-	    QString suffix;
+    }
 
-	    // First attempt: Try the MIME categorizer.
-	    //
-	    // If it knows the file's suffix, it can much easier find the
-	    // correct one in case there are multiple to choose from, for
-	    // example ".tar.bz2", not ".bz2" for a bzipped tarball. But on
-	    // Linux systems, having multiple dots in filenames is very common,
-	    // e.g. in .deb or .rpm packages, so the longest possible suffix is
-	    // not always the useful one (because it might contain version
-	    // numbers and all kinds of irrelevant information).
-	    //
-	    // The suffixes the MIME categorizer knows are carefully
-	    // hand-crafted, so if it knows anything about a suffix, it's the
-	    // best choice.
-
-	    MimeCategory * category = _mimeCategorizer->category( item->name(), &suffix );
-
-	    if ( ! category )
-		category = _otherCategory;
-
-	    _categorySum[ category ] += item->size();
-	    ++_categoryCount[ category ];
-
-	    if ( suffix.isEmpty() )
-	    {
-		if ( item->name().contains( '.' ) && ! item->name().startsWith( '.' ) )
-		{
-		    // Fall back to the last (i.e. the shortest) suffix if the
-		    // MIME categorizer didn't know it: Use section -1 (the
-		    // last one, ignoring any trailing '.' separator).
-		    //
-		    // The downside is that this would not find a ".tar.bz",
-		    // but just the ".bz" for a compressed tarball. But it's
-		    // much better than getting a ".eab7d88df-git.deb" rather
-		    // than a ".deb".
-
-		    suffix = item->name().section( '.', -1 );
-		}
-	    }
-
-	    suffix = suffix.toLower();
-
-	    if ( suffix.isEmpty() )
-		suffix = NO_SUFFIX;
-
-	    _suffixSum[ suffix ] += item->size();
-	    ++_suffixCount[ suffix ];
+    addSuffix( suffix, file->size(), 1 );
+}
+
+
+void FileTypeStats::addSuffix( const QString & suffix, FileSize sum, int count )
+{
+    int id = _suffixIds.value( suffix, -1 );
+
+    if ( id < 0 )
+    {
+	// A suffix string that was not seen yet, but maybe the same suffix
+	// in another case
+
+	QString lowerSuffix = suffix.isEmpty() || suffix == NO_SUFFIX ?
+	    QString( NO_SUFFIX ) : suffix.toLower();
+
+	id = _suffixIds.value( lowerSuffix, -1 );
+
+	if ( id < 0 )
+	{
+	    id = _suffixSums.size();
+	    _suffixNames << lowerSuffix;
+	    _suffixSums	 << FileTypeSum();
+	    _suffixIds.insert( lowerSuffix, id );
 	}
-	// Disregard symlinks, block devices and other special files
 
-	++it;
+	_suffixIds.insert( suffix, id );
     }
+
+    FileTypeSum & suffixSum = _suffixSums[ id ];
+    suffixSum.sum   += sum;
+    suffixSum.count += count;
+}
+
+
+void FileTypeStats::merge( SubtreeCollector * partial )
+{
+    FileTypeStats * other = static_cast<FileTypeStats *>( partial );
+
+    for ( int i=0; i < other->_suffixSums.size(); ++i )
+    {
+	const FileTypeSum & otherSum = other->_suffixSums.at( i );
+	addSuffix( other->_suffixNames.at( i ), otherSum.sum, otherSum.count );
+    }
+
+    for ( QHash<MimeCategory *, FileTypeSum>::const_iterator it = other->_categorySums.constBegin();
+	  it != other->_categorySums.constEnd();
+	  ++it )
+    {
+	// Each FileTypeStats object has its own "Other" category
+
+	MimeCategory * category = it.key() == other->_otherCategory ? _otherCategory : it.key();
+	FileTypeSum & categorySum = _categorySums[ category ];
+
+	categorySum.sum	  += it.value().sum;
+	categorySum.count += it.value().count;
+    }
+}
+
+
+void FileTypeStats::buildResultMaps()
+{
+    for ( int i=0; i < _suffixSums.size(); ++i )
+    {
+	_suffixSum  [ _suffixNames.at( i ) ] = _suffixSums.at( i ).sum;
+	_suffixCount[ _suffixNames.at( i ) ] = _suffixSums.at( i ).count;
+    }
+
+    for ( QHash<MimeCategory *, FileTypeSum>::const_iterator it = _categorySums.constBegin();
+	  it != _categorySums.constEnd();
+	  ++it )
+    {
+	_categorySum  [ it.key() ] = it.value().sum;
+	_categoryCount[ it.key() ] = it.value().count;
+    }
+
+    _suffixIds.clear();
+    _suffixNames.clear();
+    _suffixSums.clear();
+    _categorySums.clear();
 }
 
 
@@ -12,9 +12,11 @@
 
 #include <QObject>
 #include <QMap>
+#include <QHash>
+#include <QVector>
 
-#include "ui_file-type-stats-window.h"
 #include "DirInfo.h"
+#include "SubtreeCollector.h"
 
 #define NO_SUFFIX "//<No Suffix>" // A slash is illegal in Linux/Unix filenames
 
@@ -34,12 +36,25 @@ namespace QDirStat
     typedef CategoryFileSizeMap::const_iterator CategoryFileSizeMapIterator;
 
 
+    /**
+     * Total size and number of files of one suffix or category while
+     * collecting.
+     **/
+    struct FileTypeSum
+    {
+	FileSize sum;
+	int	 count;
+
+	FileTypeSum(): sum( 0LL ), count( 0 ) {}
+    };
+
+
     /**
      * Class to calculate file type statistics for a subtree, such as how much
      * disk space is used for each kind of filename extension (*.jpg, *.mp4
      * etc.).
      **/
-    class FileTypeStats: public QObject
+    class FileTypeStats: public QObject, public SubtreeCollector
     {
 	Q_OBJECT
 
@@ -140,12 +155,39 @@ namespace QDirStat
     protected:
 
 	/**
-	 * Collect information from the associated widget tree:
+	 * Create an empty FileTypeStats object for collecting in another
+	 * thread.
 	 *
-	 * Recursively go through the tree and collect sizes for each file type
-	 * (filename extension).
+	 * Implemented from SubtreeCollector.
 	 **/
-	void collect( FileInfo * dir );
+	virtual SubtreeCollector * createPartial() const Q_DECL_OVERRIDE;
+
+	/**
+	 * Add the size of 'file' to its file type (filename extension) and
+	 * category.
+	 *
+	 * Implemented from SubtreeCollector.
+	 **/
+	virtual void collectFile( FileInfo * file ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Add the sums and counts of 'partial'.
+	 *
+	 * Implemented from SubtreeCollector.
+	 **/
+	virtual void merge( SubtreeCollector * partial ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Add 'sum' and 'count' to 'suffix' as it was found in the file
+	 * name, i.e. not yet converted to lower case.
+	 **/
+	void addSuffix( const QString & suffix, FileSize sum, int count );
+
+	/**
+	 * Move the sums and counts that were collected in the hashes to the
+	 * sorted maps for the results.
+	 **/
+	void buildResultMaps();
 
 	/**
 	 * Remove useless content from the maps. On a Linux system, there tend
@@ -184,6 +226,18 @@ namespace QDirStat
 	MimeCategory *		_otherCategory;
 	MimeCategorizer *	_mimeCategorizer;
 
+	// Collecting: Each distinct suffix string gets an ID, the index of
+	// its sum in _suffixSums. The suffixes are not converted to lower
+	// case for each file, only for each new suffix: "JPG" and "jpg" are
+	// both in _suffixIds with the same ID.
+
+	QHash<QString, int>	_suffixIds;
+	QVector<QString>	_suffixNames;	// lower case, by ID
+	QVector<FileTypeSum>	_suffixSums;	// by ID
+	QHash<MimeCategory *, FileTypeSum> _categorySums;
+
+	// Results
+
 	StringFileSizeMap	_suffixSum;
 	StringIntMap		_suffixCount;
 	CategoryFileSizeMap	_categorySum;
@@ -20,6 +20,7 @@
 #include "HeaderTweaker.h"
 #include "QDirStatApp.h"
 #include "FormatUtil.h"
+#include "StallWatchdog.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -138,6 +139,8 @@ void FileTypeStatsWindow::populateSharedInstance( FileInfo * subtree )
 
 void FileTypeStatsWindow::populate( FileInfo * newSubtree )
 {
+    StallOperation operation( "File type statistics" );
+
     clear();
     _subtree = newSubtree;
     _stats->calc( newSubtree ? newSubtree : _subtree() );
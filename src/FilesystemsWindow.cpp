@@ -47,7 +47,13 @@ void FilesystemsWindow::populate()
     QFileIconProvider iconProvider;
     clear();
 
-    foreach ( MountPoint * mountPoint, MountPoints::normalMountPoints() )
+    // Get all sizes at once: One hung network mount should not delay all
+    // the others.
+
+    QList<MountPoint *> mountPoints = MountPoints::normalMountPoints();
+    MountPoints::querySizes( mountPoints );
+
+    foreach ( MountPoint * mountPoint, mountPoints )
     {
 	CHECK_PTR( mountPoint);
 
@@ -189,7 +195,8 @@ FilesystemItem::FilesystemItem( MountPoint  * mountPoint,
     _reservedSize   ( mountPoint->reservedSize()    ),
     _freeSize	    ( mountPoint->freeSizeForUser() ),
     _isNetworkMount ( mountPoint->isNetworkMount()  ),
-    _isReadOnly	    ( mountPoint->isReadOnly()	    )
+    _isReadOnly	    ( mountPoint->isReadOnly()	    ),
+    _isResponsive   ( mountPoint->isResponsive()    )
 {
     QString blanks = QString( 4, ' ' );
     QString dev    = _device;
@@ -213,6 +220,13 @@ FilesystemItem::FilesystemItem( MountPoint  * mountPoint,
 
     setTextAlignment( FS_TypeCol, Qt::AlignHCenter );
 
+    if ( parent->columnCount() >= FS_TotalSizeCol && ! _isResponsive )
+    {
+	setText( FS_TotalSizeCol, QObject::tr( "not responding" ) );
+	setForeground( FS_TotalSizeCol, Qt::red );
+	setTextAlignment( FS_TotalSizeCol, Qt::AlignRight );
+    }
+
     if ( parent->columnCount() >= FS_TotalSizeCol && _totalSize >= 0 )
     {
 	blanks = QString( 3, ' ' ); // Enforce left margin
@@ -171,6 +171,7 @@ namespace QDirStat
 	FileSize freeSize()	  const { return _freeSize;	  }
 	bool	 isNetworkMount() const { return _isNetworkMount; }
 	bool	 isReadOnly()	  const { return _isReadOnly;	  }
+	bool	 isResponsive()   const { return _isResponsive;   }
 
 	/**
 	 * Less-than operator for sorting.
@@ -189,6 +190,7 @@ namespace QDirStat
 	FileSize _freeSize;
 	bool	 _isNetworkMount;
 	bool	 _isReadOnly;
+	bool	 _isResponsive;
     };
 
 }
@@ -31,21 +31,24 @@ QString QDirStat::formatSize( FileSize lSize, int precision )
 
     if ( units.isEmpty() )
     {
-	units << QObject::tr( "Bytes" )
-	      << QObject::tr( "kB" )
-	      << QObject::tr( "MB" )
-	      << QObject::tr( "GB" )
-	      << QObject::tr( "TB" )
-	      << QObject::tr( "PB" )
-	      << QObject::tr( "EB" )
-	      << QObject::tr( "ZB" )
-	      << QObject::tr( "YB" );
+	// Including the blank between the number and the unit, so this
+	// doesn't allocate yet another string for each call
+
+	units << " " + QObject::tr( "Bytes" )
+	      << " " + QObject::tr( "kB" )
+	      << " " + QObject::tr( "MB" )
+	      << " " + QObject::tr( "GB" )
+	      << " " + QObject::tr( "TB" )
+	      << " " + QObject::tr( "PB" )
+	      << " " + QObject::tr( "EB" )
+	      << " " + QObject::tr( "ZB" )
+	      << " " + QObject::tr( "YB" );
     }
 
     if ( lSize < 1024 )
     {
 	sizeString.setNum( lSize );
-	sizeString += " " + units.at( unitIndex );
+	sizeString += units.at( unitIndex );
     }
     else
     {
@@ -58,35 +61,33 @@ QString QDirStat::formatSize( FileSize lSize, int precision )
 	}
 
 	sizeString.setNum( size, 'f', precision );
-	sizeString += " " + units.at( unitIndex );
+	sizeString += units.at( unitIndex );
     }
 
     return sizeString;
 }
 
 
-QString QDirStat::formatByteSize( FileSize size )
+QString QDirStat::formatSizeDelta( FileSize delta )
 {
+    return delta < 0 ?
+	"-" + formatSize( -delta ) :
+	"+" + formatSize(  delta );
+}
 
-    QString bytesString;
-    bytesString.setNum( size );
-
-    QString sizeString;
 
-    while ( ! bytesString.isEmpty() )
-    {
-	QString digits = bytesString.right( 3 );
-	bytesString.chop( 3 );
+QString QDirStat::formatByteSize( FileSize size )
+{
 
-	if ( ! sizeString.isEmpty() )
-	    sizeString.prepend( " " ); // thousands separator
+    QString sizeString;
+    sizeString.setNum( size );
 
-	sizeString.prepend( digits );
-    }
+    // Insert the thousands separators in place from right to left
 
-    sizeString = QObject::tr( "%1 Bytes" ).arg( sizeString );
+    for ( int pos = sizeString.size() - 3; pos > ( size < 0 ? 1 : 0 ); pos -= 3 )
+	sizeString.insert( pos, QLatin1Char( ' ' ) );
 
-    return sizeString;
+    return QObject::tr( "%1 Bytes" ).arg( sizeString );
 }
 
 
@@ -97,7 +98,7 @@ QString QDirStat::formatPercent( float percent )
 
     QString text;
     text.setNum( percent, 'f', 1 );
-    text += "%";
+    text += QLatin1Char( '%' );
 
     return text;
 }
@@ -133,55 +134,58 @@ QString QDirStat::formatFilesystemObjectType( mode_t mode )
 
 QString QDirStat::formatOctal( int number )
 {
-    return QString( "0" ) + QString::number( number, 8 );
+    return QString::number( number, 8 ).prepend( QLatin1Char( '0' ) );
 }
 
 
 QString QDirStat::symbolicMode( mode_t mode, bool omitTypeForRegularFiles )
 {
-    QString result;
+    // Fill a plain char buffer and create the QString only once at the end
+
+    char result[ 11 ];
+    int	 len = 0;
 
     // Type
 
-    if	    ( S_ISDIR ( mode ) )	  result = "d";
-    else if ( S_ISCHR ( mode ) )	  result = "c";
-    else if ( S_ISBLK ( mode ) )	  result = "b";
-    else if ( S_ISFIFO( mode ) )	  result = "p";
-    else if ( S_ISLNK ( mode ) )	  result = "l";
-    else if ( S_ISSOCK( mode ) )	  result = "s";
-    else if ( ! omitTypeForRegularFiles ) result = "-";
+    if	    ( S_ISDIR ( mode ) )	  result[ len++ ] = 'd';
+    else if ( S_ISCHR ( mode ) )	  result[ len++ ] = 'c';
+    else if ( S_ISBLK ( mode ) )	  result[ len++ ] = 'b';
+    else if ( S_ISFIFO( mode ) )	  result[ len++ ] = 'p';
+    else if ( S_ISLNK ( mode ) )	  result[ len++ ] = 'l';
+    else if ( S_ISSOCK( mode ) )	  result[ len++ ] = 's';
+    else if ( ! omitTypeForRegularFiles ) result[ len++ ] = '-';
 
     // User
 
-    result += ( mode & S_IRUSR ) ? "r" : "-";
-    result += ( mode & S_IWUSR ) ? "w" : "-";
+    result[ len++ ] = ( mode & S_IRUSR ) ? 'r' : '-';
+    result[ len++ ] = ( mode & S_IWUSR ) ? 'w' : '-';
 
     if ( mode & S_ISUID )
-	result += "s";
+	result[ len++ ] = 's';
     else
-	result += ( mode & S_IXUSR ) ? "x" : "-";
+	result[ len++ ] = ( mode & S_IXUSR ) ? 'x' : '-';
 
     // Group
 
-    result += ( mode & S_IRGRP ) ? "r" : "-";
-    result += ( mode & S_IWGRP ) ? "w" : "-";
+    result[ len++ ] = ( mode & S_IRGRP ) ? 'r' : '-';
+    result[ len++ ] = ( mode & S_IWGRP ) ? 'w' : '-';
 
     if ( mode & S_ISGID )
-	result += "s";
+	result[ len++ ] = 's';
     else
-	result += ( mode & S_IXGRP ) ? "x" : "-";
+	result[ len++ ] = ( mode & S_IXGRP ) ? 'x' : '-';
 
     // Other
 
-    result += ( mode & S_IROTH ) ? "r" : "-";
-    result += ( mode & S_IWOTH ) ? "w" : "-";
+    result[ len++ ] = ( mode & S_IROTH ) ? 'r' : '-';
+    result[ len++ ] = ( mode & S_IWOTH ) ? 'w' : '-';
 
     if ( mode & S_ISVTX )
-	result += "t";
+	result[ len++ ] = 't';
     else
-	result += ( mode & S_IXOTH ) ? "x" : "-";
+	result[ len++ ] = ( mode & S_IXOTH ) ? 'x' : '-';
 
-    return result;
+    return QString::fromLatin1( result, len );
 }
 
 
@@ -36,6 +36,12 @@ namespace QDirStat
     // so we really need the above overloaded version.
     QString formatSize( FileSize size, int precision );
 
+    /**
+     * Format a change of a size in human readable form with a sign,
+     * i.e. "+1.2 MB" or "-300 Bytes".
+     **/
+    QString formatSizeDelta( FileSize delta );
+
     /**
      * Format a file / subtree size as bytes, but still human readable with a
      * space as a thousands separator, i.e. "12 345 678 Bytes".
@@ -0,0 +1,412 @@
+/*
+ *   File name: GLCushionRenderer.cpp
+ *   Summary:	Render treemap cushions with OpenGL
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <string.h>
+
+#include "GLCushionRenderer.h"
+#include "Exception.h"
+#include "Logger.h"
+
+#if HAVE_OPENGL
+#  include <QOffscreenSurface>
+#  include <QOpenGLContext>
+#  include <QOpenGLFunctions>
+#  include <QOpenGLShaderProgram>
+#  include <QOpenGLFramebufferObject>
+#  include <QOpenGLBuffer>
+#  include <QMatrix4x4>
+#endif
+
+// Maximum number of tiles for one draw call; this limits the size of the
+// vertex buffer
+#define MaxTilesPerBatch	16384
+
+// Vertices for each tile (two triangles) and floats for each vertex
+#define VerticesPerTile		6
+#define FloatsPerVertex		12
+
+
+using namespace QDirStat;
+
+
+#if HAVE_OPENGL
+
+namespace
+{
+    /**
+     * The vertex shader just passes the attributes of the tile on to the
+     * fragment shader: 'local' is the position relative to the top left of
+     * the tile in pixels, 'normal' is ( nx0, nxStep, ny0, nyStep ) for the
+     * normal vector of the cushion surface, 'color' is ( maxRed, maxGreen,
+     * maxBlue, ambientLight ) like in CushionShader::Params.
+     **/
+    const char * vertexShaderSource =
+	"attribute vec2 position;\n"
+	"attribute vec2 local;\n"
+	"attribute vec4 normal;\n"
+	"attribute vec4 color;\n"
+	"uniform mat4 matrix;\n"
+	"varying vec2 vLocal;\n"
+	"varying vec4 vNormal;\n"
+	"varying vec4 vColor;\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"    vLocal	 = local;\n"
+	"    vNormal	 = normal;\n"
+	"    vColor	 = color;\n"
+	"    gl_Position = matrix * vec4( position, 0.0, 1.0 );\n"
+	"}\n";
+
+    /**
+     * The same as CushionShader::shadePixel(). Fragments are sampled at
+     * pixel centers, so floor() gets the pixel offset in the tile that
+     * the CPU renderer uses.
+     **/
+    const char * fragmentShaderSource =
+	"#ifdef GL_ES\n"
+	"precision highp float;\n"
+	"#endif\n"
+	"uniform vec3 light;\n"
+	"varying vec2 vLocal;\n"
+	"varying vec4 vNormal;\n"
+	"varying vec4 vColor;\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"    vec2  pixel = floor( vLocal );\n"
+	"    float nx	 = vNormal.x + pixel.x * vNormal.y;\n"
+	"    float ny	 = vNormal.z + pixel.y * vNormal.w;\n"
+	"    float cosa	 = ( nx * light.x + ny * light.y + light.z ) / sqrt( nx * nx + ny * ny + 1.0 );\n"
+	"    vec3  rgb	 = max( floor( vColor.rgb * cosa + 0.5 ), 0.0 ) + vColor.a;\n"
+	"\n"
+	"    gl_FragColor = vec4( min( rgb, 255.0 ) / 255.0, 1.0 );\n"
+	"}\n";
+
+
+    /**
+     * Append one vertex of the quad of 'job' to 'vertices'.
+     **/
+    inline void addVertex( QVector<GLfloat>		  & vertices,
+			   const CushionRenderer::Job & job,
+			   int				localX,
+			   int				localY )
+    {
+	// Compute the normal vector at the top left of the tile in double
+	// like the CPU renderer to avoid cancellation for tiles far away
+	// from the origin
+
+	double nx0 = 2.0 * job.xx2 * job.rect.left() + job.xx1;
+	double ny0 = 2.0 * job.yy2 * job.rect.top()  + job.yy1;
+
+	vertices << job.rect.left() + localX << job.rect.top() + localY
+		 << localX << localY
+		 << nx0 << 2.0 * job.xx2 << ny0 << 2.0 * job.yy2
+		 << job.params.maxRed << job.params.maxGreen << job.params.maxBlue
+		 << job.params.ambientLight;
+    }
+
+}	// namespace
+
+#endif	// HAVE_OPENGL
+
+
+GLCushionRenderer::GLCushionRenderer():
+    _surface(0),
+    _context(0),
+    _program(0),
+    _fbo(0),
+    _vertexBuffer(0),
+    _initDone(false),
+    _failed(false)
+{
+}
+
+
+GLCushionRenderer::~GLCushionRenderer()
+{
+    cleanup();
+}
+
+
+bool GLCushionRenderer::isSupported()
+{
+#if HAVE_OPENGL
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+#if HAVE_OPENGL
+
+void GLCushionRenderer::cleanup()
+{
+    if ( _context && _surface && _context->makeCurrent( _surface ) )
+    {
+	delete _fbo;
+	delete _vertexBuffer;
+	delete _program;
+	_context->doneCurrent();
+    }
+
+    delete _context;
+    delete _surface;
+
+    _fbo	  = 0;
+    _vertexBuffer = 0;
+    _program	  = 0;
+    _context	  = 0;
+    _surface	  = 0;
+}
+
+
+bool GLCushionRenderer::init()
+{
+    if ( _initDone )
+	return ! _failed;
+
+    _initDone = true;
+    _failed   = true;
+
+    _context = new QOpenGLContext();
+    CHECK_NEW( _context );
+
+    if ( ! _context->create() )
+    {
+	logWarning() << "Can't create an OpenGL context; using the CPU for treemap cushions" << endl;
+	return false;
+    }
+
+    _surface = new QOffscreenSurface();
+    CHECK_NEW( _surface );
+
+    _surface->setFormat( _context->format() );
+    _surface->create();
+
+    if ( ! _surface->isValid() || ! _context->makeCurrent( _surface ) )
+    {
+	logWarning() << "Can't use an offscreen OpenGL surface; using the CPU for treemap cushions" << endl;
+	return false;
+    }
+
+    _program = new QOpenGLShaderProgram();
+    CHECK_NEW( _program );
+
+    if ( ! _program->addShaderFromSourceCode( QOpenGLShader::Vertex,   vertexShaderSource	) ||
+	 ! _program->addShaderFromSourceCode( QOpenGLShader::Fragment, fragmentShaderSource ) ||
+	 ! _program->link() )
+    {
+	logWarning() << "Can't build the OpenGL cushion shader: " << _program->log() << endl;
+	_context->doneCurrent();
+	return false;
+    }
+
+    _vertexBuffer = new QOpenGLBuffer( QOpenGLBuffer::VertexBuffer );
+    CHECK_NEW( _vertexBuffer );
+
+    _vertexBuffer->setUsagePattern( QOpenGLBuffer::StreamDraw );
+    _vertexBuffer->create();
+    _context->doneCurrent();
+
+    logInfo() << "Rendering treemap cushions with OpenGL" << endl;
+    _failed = false;
+
+    return true;
+}
+
+
+bool GLCushionRenderer::ensureFramebufferObject( const QSize & size )
+{
+    if ( _fbo && _fbo->size() == size )
+	return true;
+
+    delete _fbo;
+    _fbo = new QOpenGLFramebufferObject( size );
+    CHECK_NEW( _fbo );
+
+    if ( ! _fbo->isValid() )
+    {
+	logWarning() << "Can't create an OpenGL framebuffer object of size " << size << endl;
+	delete _fbo;
+	_fbo = 0;
+
+	return false;
+    }
+
+    return true;
+}
+
+
+void GLCushionRenderer::drawJobs( const QVector<CushionRenderer::Job> & jobs )
+{
+    QOpenGLFunctions * gl = _context->functions();
+
+    int position = _program->attributeLocation( "position" );
+    int local	 = _program->attributeLocation( "local"	   );
+    int normal	 = _program->attributeLocation( "normal"   );
+    int color	 = _program->attributeLocation( "color"	   );
+    int stride	 = FloatsPerVertex * sizeof( GLfloat );
+
+    _vertexBuffer->bind();
+    _program->enableAttributeArray( position );
+    _program->enableAttributeArray( local    );
+    _program->enableAttributeArray( normal   );
+    _program->enableAttributeArray( color    );
+
+    QVector<GLfloat> vertices;
+    vertices.reserve( qMin( jobs.size(), MaxTilesPerBatch ) * VerticesPerTile * FloatsPerVertex );
+
+    for ( int start = 0; start < jobs.size(); start += MaxTilesPerBatch )
+    {
+	int end = qMin( start + MaxTilesPerBatch, jobs.size() );
+	vertices.clear();
+
+	for ( int i = start; i < end; ++i )
+	{
+	    const CushionRenderer::Job & job = jobs.at( i );
+	    int width  = job.rect.width();
+	    int height = job.rect.height();
+
+	    addVertex( vertices, job, 0,     0	    );
+	    addVertex( vertices, job, width, 0	    );
+	    addVertex( vertices, job, 0,     height );
+
+	    addVertex( vertices, job, width, 0	    );
+	    addVertex( vertices, job, width, height );
+	    addVertex( vertices, job, 0,     height );
+	}
+
+	_vertexBuffer->allocate( vertices.constData(), vertices.size() * sizeof( GLfloat ) );
+
+	_program->setAttributeBuffer( position, GL_FLOAT, 0			  , 2, stride );
+	_program->setAttributeBuffer( local,	GL_FLOAT, 2 * sizeof( GLfloat ), 2, stride );
+	_program->setAttributeBuffer( normal,	GL_FLOAT, 4 * sizeof( GLfloat ), 4, stride );
+	_program->setAttributeBuffer( color,	GL_FLOAT, 8 * sizeof( GLfloat ), 4, stride );
+
+	gl->glDrawArrays( GL_TRIANGLES, 0, ( end - start ) * VerticesPerTile );
+    }
+
+    _program->disableAttributeArray( position );
+    _program->disableAttributeArray( local    );
+    _program->disableAttributeArray( normal   );
+    _program->disableAttributeArray( color    );
+    _vertexBuffer->release();
+}
+
+
+bool GLCushionRenderer::render( QImage				      & framebuffer,
+				const QVector<CushionRenderer::Job> & jobs,
+				bool				      keepBackground )
+{
+    if ( framebuffer.isNull() || jobs.isEmpty() )
+	return true;
+
+    if ( ! init() || ! _context->makeCurrent( _surface ) )
+	return false;
+
+    if ( ! ensureFramebufferObject( framebuffer.size() ) )
+    {
+	_context->doneCurrent();
+	return false;
+    }
+
+    QOpenGLFunctions * gl = _context->functions();
+    _fbo->bind();
+
+    gl->glViewport( 0, 0, framebuffer.width(), framebuffer.height() );
+    gl->glDisable( GL_DEPTH_TEST );
+    gl->glDisable( GL_BLEND );
+    gl->glClearColor( 0.0, 0.0, 0.0, 1.0 );
+    gl->glClear( GL_COLOR_BUFFER_BIT );
+
+    // Framebuffer pixel coordinates with the origin at the top left
+
+    QMatrix4x4 matrix;
+    matrix.ortho( 0.0, framebuffer.width(), framebuffer.height(), 0.0, -1.0, 1.0 );
+
+    _program->bind();
+    _program->setUniformValue( "matrix", matrix );
+    _program->setUniformValue( "light",
+			       (GLfloat) jobs.first().params.lightX,
+			       (GLfloat) jobs.first().params.lightY,
+			       (GLfloat) jobs.first().params.lightZ );
+    drawJobs( jobs );
+    _program->release();
+
+    // toImage() takes care of OpenGL's bottom-up rows
+
+    QImage result = _fbo->toImage().convertToFormat( QImage::Format_RGB32 );
+    _fbo->release();
+    _context->doneCurrent();
+
+    if ( result.size() != framebuffer.size() )
+	return false;
+
+    if ( ! keepBackground )
+    {
+	framebuffer = result;
+	return true;
+    }
+
+    // Copy only the tiles. Where they overlap, the result already has the
+    // pixels of the last one.
+
+    QRect imageRect = framebuffer.rect();
+
+    foreach ( const CushionRenderer::Job & job, jobs )
+    {
+	QRect rect = job.rect & imageRect;
+
+	for ( int y = rect.top(); y <= rect.bottom(); ++y )
+	{
+	    memcpy( framebuffer.scanLine( y ) + rect.left() * sizeof( QRgb ),
+		    result.constScanLine( y ) + rect.left() * sizeof( QRgb ),
+		    rect.width() * sizeof( QRgb ) );
+	}
+    }
+
+    return true;
+}
+
+
+#else	// ! HAVE_OPENGL
+
+
+void GLCushionRenderer::cleanup()
+{
+}
+
+
+bool GLCushionRenderer::init()
+{
+    return false;
+}
+
+
+bool GLCushionRenderer::ensureFramebufferObject( const QSize & )
+{
+    return false;
+}
+
+
+void GLCushionRenderer::drawJobs( const QVector<CushionRenderer::Job> & )
+{
+}
+
+
+bool GLCushionRenderer::render( QImage				      &,
+				const QVector<CushionRenderer::Job> &,
+				bool )
+{
+    return false;
+}
+
+#endif	// ! HAVE_OPENGL
@@ -0,0 +1,117 @@
+/*
+ *   File name: GLCushionRenderer.h
+ *   Summary:	Render treemap cushions with OpenGL
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef GLCushionRenderer_h
+#define GLCushionRenderer_h
+
+
+#include <QImage>
+#include <QVector>
+
+#include "CushionRenderer.h"
+
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QOpenGLShaderProgram;
+class QOpenGLFramebufferObject;
+class QOpenGLBuffer;
+
+
+namespace QDirStat
+{
+    /**
+     * Renderer for the cushions of all tiles of a treemap on the GPU: The
+     * shading of each pixel is done in a fragment shader from the cushion
+     * surface coefficients and the color of its tile, which are uploaded
+     * as vertex attributes of one quad for each tile.
+     *
+     * This renders into an offscreen framebuffer object and reads the
+     * result back into the same framebuffer image that CushionRenderer
+     * renders into, so everything else (ensuring contrast, the cushion
+     * grid, single image mode, highlighting) works the same with both.
+     *
+     * If QDirStat is built without OpenGL support or if there is no usable
+     * OpenGL implementation at runtime, render() simply returns 'false',
+     * and the caller should use the CushionRenderer instead.
+     **/
+    class GLCushionRenderer
+    {
+    public:
+
+	/**
+	 * Constructor. This does not create any OpenGL resources yet; that
+	 * happens upon the first render() call.
+	 **/
+	GLCushionRenderer();
+
+	/**
+	 * Destructor.
+	 **/
+	~GLCushionRenderer();
+
+	/**
+	 * Render the cushions of 'jobs' into 'framebuffer' in that order.
+	 * 'framebuffer' must have format QImage::Format_RGB32. Pixels that
+	 * are not in any job keep their old content if 'keepBackground' is
+	 * 'true'; otherwise they are undefined.
+	 *
+	 * This must be called from the GUI thread. Return 'false' if
+	 * OpenGL is not available; 'framebuffer' is unchanged then.
+	 **/
+	bool render( QImage					& framebuffer,
+		     const QVector<CushionRenderer::Job>	& jobs,
+		     bool					  keepBackground );
+
+	/**
+	 * Return 'true' if this was built with OpenGL support.
+	 **/
+	static bool isSupported();
+
+    protected:
+
+	/**
+	 * Create the OpenGL context and the shader program if that was not
+	 * tried yet. Return 'true' on success.
+	 **/
+	bool init();
+
+	/**
+	 * Make sure the framebuffer object has 'size'. Return 'true' on
+	 * success.
+	 **/
+	bool ensureFramebufferObject( const QSize & size );
+
+	/**
+	 * Draw the quads for 'jobs' into the current framebuffer object.
+	 **/
+	void drawJobs( const QVector<CushionRenderer::Job> & jobs );
+
+	/**
+	 * Release all OpenGL resources.
+	 **/
+	void cleanup();
+
+
+	// Data members
+
+	QOffscreenSurface	 * _surface;
+	QOpenGLContext		 * _context;
+	QOpenGLShaderProgram	 * _program;
+	QOpenGLFramebufferObject * _fbo;
+	QOpenGLBuffer		 * _vertexBuffer;
+	bool			   _initDone;
+	bool			   _failed;
+
+    };	// class GLCushionRenderer
+
+}	// namespace QDirStat
+
+
+#endif // ifndef GLCushionRenderer_h
@@ -0,0 +1,64 @@
+/*
+ *   File name: HardLinkTable.cpp
+ *   Summary:	Table of the hard-linked inodes seen while reading a DirTree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "HardLinkTable.h"
+
+
+using namespace QDirStat;
+
+
+HardLinkTable::HardLinkTable()
+{
+    // NOP
+}
+
+
+bool HardLinkTable::add( quint16 deviceNo, ino_t inode, nlink_t links )
+{
+    if ( links < 2 )
+	return true;
+
+    if ( deviceNo >= _inodes.size() )
+	_inodes.resize( deviceNo + 1 );
+
+    QHash<quint64, quint32> & inodes = _inodes[ deviceNo ];
+    QHash<quint64, quint32>::iterator it = inodes.find( (quint64) inode );
+
+    if ( it == inodes.end() )
+    {
+	inodes.insert( (quint64) inode, (quint32) links - 1 );
+
+	return true;
+    }
+
+    // Another link of this inode was found before. Once all of its links
+    // are found, there won't be any more, so forget this inode.
+
+    if ( --it.value() == 0 )
+	inodes.erase( it );
+
+    return false;
+}
+
+
+void HardLinkTable::clear()
+{
+    _inodes.clear();
+}
+
+
+int HardLinkTable::size() const
+{
+    int count = 0;
+
+    for ( int i = 0; i < _inodes.size(); ++i )
+	count += _inodes.at( i ).size();
+
+    return count;
+}
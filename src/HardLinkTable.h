@@ -0,0 +1,80 @@
+/*
+ *   File name: HardLinkTable.h
+ *   Summary:	Table of the hard-linked inodes seen while reading a DirTree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef HardLinkTable_h
+#define HardLinkTable_h
+
+
+#include <sys/types.h>
+
+#include <QHash>
+#include <QVector>
+
+
+namespace QDirStat
+{
+    /**
+     * Table of the inodes of the files with multiple hard links that were
+     * found while reading a DirTree, so the size of each of those inodes
+     * can be counted only once: for the first link that is found.
+     *
+     * Only files with more than one link are added, and an inode is
+     * removed again as soon as all its links were found. So in a tree
+     * where all links of a file are inside the tree (like in a series of
+     * backup snapshots with hard links between them), the table only holds
+     * the inodes whose remaining links were not read yet.
+     *
+     * The devices are identified by the device number index of FileInfo,
+     * so each inode only needs a 64 bit key and a 32 bit counter.
+     **/
+    class HardLinkTable
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	HardLinkTable();
+
+	/**
+	 * Add a link of inode 'inode' on device 'deviceNo' (the index into
+	 * the device table of FileInfo) that has 'links' links in total.
+	 *
+	 * Return 'true' if this is the first link of this inode, 'false' if
+	 * another link of it was added before.
+	 **/
+	bool add( quint16 deviceNo, ino_t inode, nlink_t links );
+
+	/**
+	 * Remove all inodes.
+	 **/
+	void clear();
+
+	/**
+	 * Return the number of inodes with links that were not found yet.
+	 **/
+	int size() const;
+
+	/**
+	 * Return 'true' if there are no inodes in this table.
+	 **/
+	bool isEmpty() const { return size() == 0; }
+
+    private:
+
+	// The number of links not found yet by inode for each device number
+
+	QVector<QHash<quint64, quint32> > _inodes;
+
+    };	// class HardLinkTable
+
+}	// namespace QDirStat
+
+
+#endif // ifndef HardLinkTable_h
@@ -7,8 +7,11 @@
  */
 
 
+#include <QApplication>
 #include <QMenu>
 #include <QAction>
+#include <QScrollBar>
+#include <QStyleOptionHeader>
 
 #include "Qt4Compat.h"
 
@@ -19,6 +22,13 @@
 #include "Exception.h"
 #include "SignalBlocker.h"
 
+// Delay for auto sizing columns after a change in millisec
+#define AUTO_SIZE_DELAY_MILLISEC	200
+
+// Maximum number of rows that are measured for auto sizing columns
+#define AUTO_SIZE_MAX_ROWS		200
+
+
 using namespace QDirStat;
 
 
@@ -27,10 +37,18 @@ HeaderTweaker::HeaderTweaker( QHeaderView * header, DirTreeView * parent ):
     _treeView( parent ),
     _header( header ),
     _currentSection( -1 ),
-    _currentLayout( 0 )
+    _currentLayout( 0 ),
+    _autoSizing( false ),
+    _connectedModel( 0 )
 {
     CHECK_PTR( _header );
 
+    _autoSizeTimer.setSingleShot( true );
+    _autoSizeTimer.setInterval( AUTO_SIZE_DELAY_MILLISEC );
+
+    connect( &_autoSizeTimer, SIGNAL( timeout()	       ),
+	     this,	      SLOT  ( autoSizeColumns() ) );
+
     _header->setSortIndicator( NameCol, Qt::AscendingOrder );
     _header->setStretchLastSection( false );
     _header->setContextMenuPolicy( Qt::CustomContextMenu );
@@ -44,6 +62,15 @@ HeaderTweaker::HeaderTweaker( QHeaderView * header, DirTreeView * parent ):
 
     connect( _header, SIGNAL( customContextMenuRequested( const QPoint & ) ),
 	     this,    SLOT  ( contextMenu		( const QPoint & ) ) );
+
+    connect( _header, SIGNAL( sectionResized( int, int, int ) ),
+	     this,    SLOT  ( sectionResized( int, int, int ) ) );
+
+    connect( _treeView->verticalScrollBar(), SIGNAL( valueChanged    ( int ) ),
+	     this,			     SLOT  ( scheduleAutoSize()	     ) );
+
+    connect( _treeView, SIGNAL( expanded	( const QModelIndex & ) ),
+	     this,	SLOT  ( scheduleAutoSize()			) );
 }
 
 
@@ -66,6 +93,31 @@ void HeaderTweaker::initHeader()
 
     // logDebug() << "Header count: " << _header->count() << endl;
     readSettings();
+    connectModel();
+    scheduleAutoSize();
+}
+
+
+void HeaderTweaker::connectModel()
+{
+    QAbstractItemModel * model = _treeView->model();
+
+    if ( ! model || model == _connectedModel )
+	return;
+
+    _connectedModel = model;
+
+    connect( model, SIGNAL( modelReset()	  ),
+	     this,  SLOT  ( resetAutoSizeWidths() ) );
+
+    connect( model, SIGNAL( layoutChanged()    ),
+	     this,  SLOT  ( scheduleAutoSize() ) );
+
+    connect( model, SIGNAL( rowsInserted    ( const QModelIndex &, int, int ) ),
+	     this,  SLOT  ( scheduleAutoSize()				      ) );
+
+    connect( model, SIGNAL( dataChanged     ( const QModelIndex &, const QModelIndex & ) ),
+	     this,  SLOT  ( scheduleAutoSize()						 ) );
 }
 
 
@@ -224,7 +276,151 @@ QString HeaderTweaker::colName( int section ) const
 
 bool HeaderTweaker::autoSizeCol( int section ) const
 {
-    return resizeMode( section ) == QHeaderView::ResizeToContents;
+    return _autoSizeWidths.contains( section );
+}
+
+
+void HeaderTweaker::setAutoSize( int section, bool autoSize )
+{
+    _header->setSectionResizeMode( section, QHeaderView::Interactive );
+
+    if ( autoSize )
+    {
+	if ( ! _autoSizeWidths.contains( section ) )
+	    _autoSizeWidths.insert( section, 0 );
+
+	scheduleAutoSize();
+    }
+    else
+    {
+	_autoSizeWidths.remove( section );
+    }
+}
+
+
+void HeaderTweaker::scheduleAutoSize()
+{
+    // Don't restart the timer if it is already running: While reading a
+    // tree, there is a constant stream of changes.
+
+    if ( ! _autoSizeWidths.isEmpty() && ! _autoSizeTimer.isActive() )
+	_autoSizeTimer.start();
+}
+
+
+void HeaderTweaker::resetAutoSizeWidths()
+{
+    QMutableMapIterator<int, int> it( _autoSizeWidths );
+
+    while ( it.hasNext() )
+    {
+	it.next();
+	it.setValue( 0 );
+    }
+
+    scheduleAutoSize();
+}
+
+
+void HeaderTweaker::autoSizeColumns()
+{
+    if ( _autoSizeWidths.isEmpty() || ! _treeView->model() )
+	return;
+
+    // Collect the rows that are visible right now and their depth in the
+    // tree. The number of rows in the model doesn't matter at all.
+
+    QModelIndexList rows;
+    QList<int>	    depths;
+    int		    bottom = _treeView->viewport()->height();
+    QModelIndex	    index  = _treeView->indexAt( QPoint( 0, 0 ) );
+
+    while ( index.isValid() && rows.size() < AUTO_SIZE_MAX_ROWS )
+    {
+	if ( _treeView->visualRect( index ).top() > bottom )
+	    break;
+
+	int depth = 0;
+
+	for ( QModelIndex parent = index.parent(); parent.isValid(); parent = parent.parent() )
+	    ++depth;
+
+	rows   << index;
+	depths << depth;
+	index = _treeView->indexBelow( index );
+    }
+
+    int treeSection = _header->logicalIndex( 0 );
+    _autoSizing = true;
+
+    QMutableMapIterator<int, int> it( _autoSizeWidths );
+
+    while ( it.hasNext() )
+    {
+	it.next();
+	int section = it.key();
+
+	if ( section >= _header->count() || _header->isSectionHidden( section ) )
+	    continue;
+
+	int width = qMax( it.value(), headerTextWidth( section ) );
+
+	for ( int i = 0; i < rows.size(); ++i )
+	{
+	    QModelIndex cell = rows.at( i ).sibling( rows.at( i ).row(), section );
+	    int cellWidth = _treeView->sizeHintForIndex( cell ).width();
+
+	    if ( section == treeSection )
+	    {
+		int level = depths.at( i ) + ( _treeView->rootIsDecorated() ? 1 : 0 );
+		cellWidth += level * _treeView->indentation();
+	    }
+
+	    width = qMax( width, cellWidth );
+	}
+
+	// The widths only ever grow, so the columns don't jump back and forth
+	// while scrolling.
+
+	it.setValue( width );
+
+	if ( _header->sectionSize( section ) != width )
+	    _header->resizeSection( section, width );
+    }
+
+    _autoSizing = false;
+}
+
+
+int HeaderTweaker::headerTextWidth( int section ) const
+{
+    QStyleOptionHeader opt;
+    opt.initFrom( _header );
+    opt.section = section;
+    opt.text	= _treeView->model()->headerData( section, Qt::Horizontal, Qt::DisplayRole ).toString();
+
+    int width = _header->style()->sizeFromContents( QStyle::CT_HeaderSection, &opt, QSize(), _header ).width();
+
+    if ( _header->isSortIndicatorShown() )
+	width += _header->style()->pixelMetric( QStyle::PM_HeaderMarkSize, 0, _header );
+
+    return width;
+}
+
+
+void HeaderTweaker::sectionResized( int section, int oldSize, int newSize )
+{
+    Q_UNUSED( oldSize );
+    Q_UNUSED( newSize );
+
+    if ( ! _autoSizing && autoSizeCol( section ) &&
+	 QApplication::mouseButtons() != Qt::NoButton )
+    {
+	// The user dragged the section border
+
+	logDebug() << "Switching off auto size for column \"" << colName( section ) << "\"" << endl;
+	setAutoSize( section, false );
+    }
 }
 
 
@@ -244,10 +440,7 @@ void HeaderTweaker::autoSizeCurrentCol()
 {
     if ( _currentSection >= 0 )
     {
-	setResizeMode( _currentSection,
-		       _actionAutoSizeCurrentCol->isChecked() ?
-		       QHeaderView::ResizeToContents :
-		       QHeaderView::Interactive );
+	setAutoSize( _currentSection, _actionAutoSizeCurrentCol->isChecked() );
     }
     else
 	logWarning() << "No current section" << endl;
@@ -258,13 +451,9 @@ void HeaderTweaker::autoSizeCurrentCol()
 
 void HeaderTweaker::setAllColumnsAutoSize( bool autoSize )
 {
-    QHeaderView::ResizeMode resizeMode = autoSize ?
-	QHeaderView::ResizeToContents :
-	QHeaderView::Interactive;
-
     for ( int section = 0; section < _header->count(); ++section )
     {
-	setResizeMode( section, resizeMode );
+	setAutoSize( section, autoSize );
     }
 }
 
@@ -294,6 +483,7 @@ void HeaderTweaker::showHiddenCol()
 	{
 	    logDebug() << "Showing column \"" << colName( section ) << "\"" << endl;
 	    _header->setSectionHidden( section, false );
+	    scheduleAutoSize();
 	}
 	else
 	    logError() << "Section index out of range: " << section << endl;
@@ -313,6 +503,7 @@ void HeaderTweaker::showAllHiddenColumns()
 	{
 	    logDebug() << "Showing column \"" << colName( section ) << "\"" << endl;
 	    _header->setSectionHidden( section, false );
+	    scheduleAutoSize();
 	}
     }
 }
@@ -367,12 +558,12 @@ void HeaderTweaker::readSettings()
 
 	if ( width > 0 )
 	{
-	    setResizeMode( section, QHeaderView::Interactive );
+	    setAutoSize( section, false );
 	    _header->resizeSection( section, width );
 	}
 	else
 	{
-	    setResizeMode( section, QHeaderView::ResizeToContents );
+	    setAutoSize( section, true );
 	}
     }
 
@@ -509,6 +700,7 @@ void HeaderTweaker::applyLayout( ColumnLayout * layout )
     fixupLayout( layout );
     setColumnOrder( layout->columns );
     setColumnVisibility( layout->columns );
+    scheduleAutoSize();
 }
 
 
@@ -526,17 +718,6 @@ void HeaderTweaker::fixupLayout( ColumnLayout * layout )
 }
 
 
-QHeaderView::ResizeMode HeaderTweaker::resizeMode( int section ) const
-{
-    return _header->sectionResizeMode( section );
-}
-
-void HeaderTweaker::setResizeMode( int section, QHeaderView::ResizeMode resizeMode )
-{
-    _header->setSectionResizeMode( section, resizeMode );
-}
-
-
 void HeaderTweaker::resizeToContents( QHeaderView * header )
 {
     for ( int col = 0; col < header->count(); ++col )
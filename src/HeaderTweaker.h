@@ -12,6 +12,7 @@
 
 #include <QHeaderView>
 #include <QMap>
+#include <QTimer>
 #include "DataColumns.h"
 
 class QHeaderView;
@@ -123,6 +124,28 @@ namespace QDirStat
 	 **/
 	void autoSizeCurrentCol();
 
+	/**
+	 * Resize all auto size columns to the widest content that was seen in
+	 * them so far.
+	 **/
+	void autoSizeColumns();
+
+	/**
+	 * Call autoSizeColumns() in a moment unless that is already pending.
+	 **/
+	void scheduleAutoSize();
+
+	/**
+	 * Forget the widths of the auto size columns, e.g. for a new tree.
+	 **/
+	void resetAutoSizeWidths();
+
+	/**
+	 * Notification that a section was resized. If the user did that to
+	 * an auto size column, it becomes an interactive size column.
+	 **/
+	void sectionResized( int section, int oldSize, int newSize );
+
 	/**
 	 * Read the settings for a layout.
 	 **/
@@ -195,14 +218,26 @@ namespace QDirStat
 	void addMissingColumns( DataColumnList & colList );
 
 	/**
-	 * Return the resize mode for the specified section.
+	 * Switch auto size for the specified section on or off.
+	 *
+	 * This does not use QHeaderView::ResizeToContents: With that, the
+	 * header measures the contents of all rows (up to a limit) with each
+	 * change of the layout, which happens all the time while reading a
+	 * large tree. Instead, autoSizeColumns() only measures the rows that
+	 * are currently visible, and it remembers the widest content so far.
+	 **/
+	void setAutoSize( int section, bool autoSize );
+
+	/**
+	 * Return the width of the header of 'section' with its text.
 	 **/
-	QHeaderView::ResizeMode resizeMode( int section ) const;
+	int headerTextWidth( int section ) const;
 
 	/**
-	 * Set the resize mode for the specified section.
+	 * Connect to the signals of the tree view's model if that is not
+	 * done yet.
 	 **/
-	void setResizeMode( int section, QHeaderView::ResizeMode resizeMode );
+	void connectModel();
 
 
 	//
@@ -220,6 +255,10 @@ namespace QDirStat
 	int				_currentSection;
 	QMap<QString, ColumnLayout *>	_layouts;
 	ColumnLayout *			_currentLayout;
+	QMap<int, int>			_autoSizeWidths; // widest content of the auto size sections
+	QTimer				_autoSizeTimer;
+	bool				_autoSizing;
+	QAbstractItemModel	      * _connectedModel;
 
     };	// class HeaderTweaker
 
@@ -27,10 +27,17 @@ void HistogramView::addHistogram()
     addAxes();
     addYAxisLabel();
     addXAxisLabel();
+    addHistogramBars();
+    addRangeItems();
+}
+
+
+void HistogramView::addRangeItems()
+{
     addXStartEndLabels();
     addQuartileText();
-    addHistogramBars();
     addMarkers();
+    addOverflowPanel();
 }
 
 
@@ -141,6 +148,10 @@ void HistogramView::addXStartEndLabels()
     startItem->setZValue( TextLayer );
     endItem->setZValue( TextLayer );
     endSizeItem->setZValue( TextLayer );
+
+    addRangeItem( startItem   );
+    addRangeItem( endItem     );
+    addRangeItem( endSizeItem );
 }
 
 
@@ -187,6 +198,10 @@ void HistogramView::addQuartileText()
 	q1Item->setZValue( TextLayer );
 	q3Item->setZValue( TextLayer );
 	medianItem->setZValue( TextLayer );
+
+	addRangeItem( q1Item	 );
+	addRangeItem( q3Item	 );
+	addRangeItem( medianItem );
     }
 
 
@@ -212,16 +227,13 @@ void HistogramView::addQuartileText()
 
     nTextItem->setPos( x, y );
     nTextItem->setZValue( TextLayer );
+    addRangeItem( nTextItem );
 }
 
 
 void HistogramView::addHistogramBars()
 {
     qreal barWidth = _histogramWidth / _buckets.size();
-    qreal maxVal   = _bucketMaxValue;
-
-    if ( _useLogHeightScale )
-	maxVal = log2( maxVal );
 
     for ( int i=0; i < _buckets.size(); ++i )
     {
@@ -232,18 +244,45 @@ void HistogramView::addHistogramBars()
 	rect.setHeight( -_histogramHeight );
 	rect.setWidth( barWidth );
 
-	qreal val = _buckets[i];
+	HistogramBar * bar = new HistogramBar( this, i, rect, barFillHeight( i ) );
+	CHECK_NEW( bar );
 
-	if ( _useLogHeightScale && val > 1.0 )
-	    val = log2( val );
+	_bars << bar;
+    }
+}
 
-	qreal fillHeight = maxVal == 0 ?
-	    0.0 :
-	    val / maxVal * _histogramHeight;
 
-	HistogramBar * bar = new HistogramBar( this, i, rect, fillHeight );
-	CHECK_NEW( bar );
+void HistogramView::updateHistogramBars()
+{
+    if ( _bars.size() != _buckets.size() )
+    {
+	qDeleteAll( _bars );
+	_bars.clear();
+	addHistogramBars();
+
+	return;
     }
+
+    for ( int i=0; i < _bars.size(); ++i )
+	_bars[i]->setFillHeight( barFillHeight( i ) );
+}
+
+
+qreal HistogramView::barFillHeight( int index ) const
+{
+    qreal maxVal = _bucketMaxValue;
+
+    if ( _useLogHeightScale )
+	maxVal = log2( maxVal );
+
+    qreal val = _buckets[ index ];
+
+    if ( _useLogHeightScale && val > 1.0 )
+	val = log2( val );
+
+    return maxVal == 0 ?
+	0.0 :
+	val / maxVal * _histogramHeight;
 }
 
 
@@ -295,24 +334,24 @@ void HistogramView::addMarkers()
 	    pen = _decilePen;
 
 	// logDebug() << "Adding marker for P" << i << endl;
-	new PercentileMarker( this, i, "", zeroLine, pen );
+	addRangeItem( new PercentileMarker( this, i, "", zeroLine, pen ) );
     }
 
     if ( _showQuartiles )
     {
 	if ( percentileDisplayed( 25 ) )
-	    new PercentileMarker( this, 25, tr( "Q1 (1st Quartile)" ),
-				  zeroLine, _quartilePen );
+	    addRangeItem( new PercentileMarker( this, 25, tr( "Q1 (1st Quartile)" ),
+						zeroLine, _quartilePen ) );
 
 	if ( percentileDisplayed( 75 ) )
-	    new PercentileMarker( this, 75, tr( "Q3 (3rd Quartile)" ),
-				  zeroLine, _quartilePen );
+	    addRangeItem( new PercentileMarker( this, 75, tr( "Q3 (3rd Quartile)" ),
+						zeroLine, _quartilePen ) );
     }
 
     if ( _showMedian && percentileDisplayed( 50 ) )
     {
-	new PercentileMarker( this, 50, tr( "Median" ),
-			      zeroLine, _medianPen );
+	addRangeItem( new PercentileMarker( this, 50, tr( "Median" ),
+					    zeroLine, _medianPen ) );
     }
 }
 
@@ -322,6 +361,7 @@ QPointF HistogramView::addText( const QPointF & pos, const QStringList & lines )
     QGraphicsTextItem * textItem = scene()->addText( lines.join( "\n" ) );
     textItem->setPos( pos );
     textItem->setDefaultTextColor( Qt::black );
+    addRangeItem( textItem );
 
     return QPoint( pos.x(), pos.y() + textItem->boundingRect().height() );
 }
@@ -336,6 +376,7 @@ QPointF HistogramView::addBoldText( const QPointF & pos, const QString & text )
     boldFont.setBold( true );
     textItem->setFont( boldFont );
     textItem->setDefaultTextColor( Qt::black );
+    addRangeItem( textItem );
 
     return QPoint( pos.x(), pos.y() + textItem->boundingRect().height() );
 }
@@ -32,18 +32,28 @@ HistogramBar::HistogramBar( HistogramView * parent,
     // rectangle is just for clicking. For the bar content, we create a visible
     // separate child item with the correct height.
 
-    QRectF childRect = rect;
-    childRect.setHeight( -fillHeight );
-
-    QGraphicsRectItem * filledRect = new QGraphicsRectItem( childRect, this );
-    CHECK_NEW( filledRect );
+    _filledRect = new QGraphicsRectItem( rect, this );
+    CHECK_NEW( _filledRect );
 
-    filledRect->setPen( _parentView->barPen() );
-    filledRect->setBrush( _parentView->barBrush() );
+    _filledRect->setPen( _parentView->barPen() );
+    _filledRect->setBrush( _parentView->barBrush() );
 
     // setFlags( ItemIsSelectable );
     _parentView->scene()->addItem( this );
 
+    setFillHeight( fillHeight );
+
+    setZValue( HistogramView::InvisibleBarLayer );
+    _filledRect->setZValue( HistogramView::BarLayer );
+}
+
+
+void HistogramBar::setFillHeight( qreal fillHeight )
+{
+    QRectF childRect = rect();
+    childRect.setHeight( -fillHeight );
+    _filledRect->setRect( childRect );
+
     _startVal = _parentView->bucketStart( _number );
     _endVal   = _parentView->bucketEnd  ( _number );
 
@@ -54,10 +64,7 @@ HistogramBar::HistogramBar( HistogramView * parent,
 	.arg( formatSize( _endVal ) );
 
     setToolTip( tooltip );
-    filledRect->setToolTip( tooltip );
-
-    setZValue( HistogramView::InvisibleBarLayer );
-    filledRect->setZValue( HistogramView::BarLayer );
+    _filledRect->setToolTip( tooltip );
 }
 
 
@@ -43,6 +43,13 @@ namespace QDirStat
 	 **/
 	int number() const { return _number; }
 
+	/**
+	 * Set the height of the visible bar and update the tooltip from the
+	 * current bucket of the parent view. This is used for updating the
+	 * bars in place when the buckets change, but not their number.
+	 **/
+	void setFillHeight( qreal fillHeight );
+
     protected:
 	/**
 	 * Mouse press event
@@ -51,10 +58,11 @@ namespace QDirStat
 	 **/
 	virtual void mousePressEvent( QGraphicsSceneMouseEvent * event ) Q_DECL_OVERRIDE;
 
-	HistogramView * _parentView;
-	int		_number;
-	qreal		_startVal;
-	qreal		_endVal;
+	HistogramView *	    _parentView;
+	QGraphicsRectItem * _filledRect;
+	int		    _number;
+	qreal		    _startVal;
+	qreal		    _endVal;
     };
 
 
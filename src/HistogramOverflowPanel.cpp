@@ -33,6 +33,7 @@ void HistogramView::addOverflowPanel()
 
     QGraphicsRectItem * cutoffPanel =
 	scene()->addRect( rect, QPen( Qt::NoPen ), _panelBackground );
+    addRangeItem( cutoffPanel );
 
 
     // Headline
@@ -172,6 +173,7 @@ QPointF HistogramView::addPie( const QRectF & rect,
     slices << slice1 << slice2;
 
     QGraphicsItemGroup * pie = scene()->createItemGroup( slices );
+    addRangeItem( pie );
     QPointF pieCenter = rect.center();
 
     // Figuring out the following arcane sequence took me well over 2 hours.
@@ -13,6 +13,7 @@
 #include <QResizeEvent>
 
 #include "HistogramView.h"
+#include "HistogramItems.h"
 #include "DelayedRebuilder.h"
 #include "FormatUtil.h"
 #include "Logger.h"
@@ -58,8 +59,11 @@ HistogramView::~HistogramView()
 
 void HistogramView::init()
 {
-    _histogramPanel = 0;
-    _geometryDirty  = true;
+    _histogramPanel	 = 0;
+    _geometryDirty	 = true;
+    _sceneLogHeightScale = false;
+    _bars.clear();
+    _rangeItems.clear();
 
     _bucketMaxValue	    = 0;
     _startPercentile	    = 0;    // data min
@@ -511,6 +515,10 @@ void HistogramView::rebuild()
     // ever created QGraphicsItems, which makes its sceneRect() call pretty
     // useless. Let's create a new one without those bad old memories.
 
+    _histogramPanel = 0;
+    _bars.clear();
+    _rangeItems.clear();
+
     if ( scene() )
 	delete scene();
 
@@ -527,7 +535,33 @@ void HistogramView::rebuild()
     }
 
     addHistogram();
-    addOverflowPanel();
+    _sceneLogHeightScale = _useLogHeightScale;
+
+    fitToViewport();
+}
+
+
+void HistogramView::updateRange()
+{
+    if ( _rebuilder->firstRebuild()		    ||
+	 _geometryDirty				    ||
+	 ! scene()				    ||
+	 ! _histogramPanel			    ||
+	 _sceneLogHeightScale != _useLogHeightScale ||
+	 _buckets.size() < 1			    ||
+	 _percentiles.size() != 101		       )
+    {
+	rebuild();
+	return;
+    }
+
+    logInfo() << "Updating histogram range" << endl;
+
+    qDeleteAll( _rangeItems );
+    _rangeItems.clear();
+
+    addRangeItems();
+    updateHistogramBars();
 
     fitToViewport();
 }
@@ -24,6 +24,7 @@ typedef QList<qreal> QRealList;
 namespace QDirStat
 {
     class DelayedRebuilder;
+    class HistogramBar;
 
     /**
      * Histogram widget.
@@ -344,6 +345,20 @@ namespace QDirStat
 	 **/
 	void rebuild();
 
+	/**
+	 * Update the histogram after only the start or end percentile and
+	 * the buckets changed, not the percentiles themselves: This keeps the
+	 * scene with the panel, the axes and the axis labels and only
+	 * replaces the elements that depend on the displayed range (the
+	 * start and end labels, the quartile text, the markers and the
+	 * overflow panel) and updates the bars in place.
+	 *
+	 * If anything else changed that needs a new layout (the widget
+	 * geometry, whether or not there is an overflow panel, the height
+	 * scale), this falls back to rebuild().
+	 **/
+	void updateRange();
+
 
     protected:
 
@@ -372,11 +387,36 @@ namespace QDirStat
 	void addHistogramBars();
 	void addMarkers();
 
+	/**
+	 * Update the existing bars for the current buckets or create them
+	 * again if the number of buckets changed.
+	 **/
+	void updateHistogramBars();
+
+	/**
+	 * Return the height of the visible part of bar no. 'index'.
+	 **/
+	qreal barFillHeight( int index ) const;
+
+	/**
+	 * Add range items (see updateRange()) to the scene.
+	 **/
+	void addRangeItems();
+
+	/**
+	 * Add 'item' to the items that updateRange() replaces and return it.
+	 **/
+	QGraphicsItem * addRangeItem( QGraphicsItem * item )
+	    { _rangeItems << item; return item; }
+
 	void addOverflowPanel();
 
         /**
          * Add a text item at 'pos' and return the bottom left of its bounding
          * rect.
+         *
+         * This and addBoldText() and addPie() are used for the overflow
+         * panel, so the items are range items.
          **/
 	QPointF addText( const QPointF & pos, const QStringList & lines );
 
@@ -431,6 +471,10 @@ namespace QDirStat
 	DelayedRebuilder * _rebuilder;
 	QGraphicsItem	 * _histogramPanel;
         bool               _geometryDirty;
+        bool               _sceneLogHeightScale;
+
+        QList<HistogramBar *>	_bars;
+        QList<QGraphicsItem *>	_rangeItems;	// deleted by updateRange()
 
 
 	// Statistics Data
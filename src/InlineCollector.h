@@ -0,0 +1,123 @@
+/*
+ *   File name: InlineCollector.h
+ *   Summary:	Subtree walk with a visitor that is known at compile time
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef InlineCollector_h
+#define InlineCollector_h
+
+
+#include "SubtreeCollector.h"
+#include "DirInfo.h"
+#include "FileInfoIterator.h"
+#include "TreeWalker.h"
+
+
+namespace QDirStat
+{
+    /**
+     * SubtreeCollector that walks the tree with a loop of its own that
+     * calls the methods of 'Visitor' directly instead of the virtual
+     * collectFile() and skipSubtree() for each item. That way, the compiler
+     * can inline a simple visitor (e.g. one that checks "links() > 1") into
+     * the loop over the children of each directory.
+     *
+     * 'Visitor' needs these methods:
+     *
+     *	 void visitFile( FileInfo * file )
+     *	     Called for each regular file.
+     *
+     *	 bool skip( FileInfo * dir ) const
+     *	     Return 'true' if nothing in the subtree of 'dir' can be of
+     *	     interest, judging by the summary values of 'dir'.
+     *
+     *	 Visitor partial() const
+     *	     Return an empty visitor with the same parameters for the
+     *	     partial results of another thread.
+     *
+     *	 void merge( Visitor & partial )
+     *	     Add the results of 'partial' to this one.
+     *
+     * Items that are neither regular files nor directories are not
+     * visited.
+     **/
+    template<class Visitor>
+    class InlineCollector: public SubtreeCollector
+    {
+    public:
+
+	/**
+	 * Constructor. If 'walker' is not 0, walking stops as soon as it
+	 * is cancelled.
+	 **/
+	InlineCollector( const Visitor & visitor, const TreeWalker * walker = 0 ):
+	    SubtreeCollector(),
+	    _visitor( visitor ),
+	    _walker( walker )
+	    {}
+
+	/**
+	 * Return the visitor with the results.
+	 **/
+	Visitor & visitor() { return _visitor; }
+
+
+    protected:
+
+	virtual SubtreeCollector * createPartial() const Q_DECL_OVERRIDE
+	    { return new InlineCollector( _visitor.partial(), _walker ); }
+
+	virtual void collectFile( FileInfo * file ) Q_DECL_OVERRIDE
+	    { _visitor.visitFile( file ); }
+
+	virtual bool skipSubtree( FileInfo * dir ) Q_DECL_OVERRIDE
+	    { return _visitor.skip( dir ); }
+
+	virtual bool cancelled() const Q_DECL_OVERRIDE
+	    { return _walker && _walker->cancelled(); }
+
+	virtual void merge( SubtreeCollector * partial ) Q_DECL_OVERRIDE
+	    { _visitor.merge( static_cast<InlineCollector *>( partial )->_visitor ); }
+
+	virtual void collectRecursive( FileInfo * dir ) Q_DECL_OVERRIDE;
+
+
+	Visitor		   _visitor;
+	const TreeWalker * _walker;
+    };
+
+
+    template<class Visitor>
+    void InlineCollector<Visitor>::collectRecursive( FileInfo * dir )
+    {
+	if ( cancelled() )
+	    return;
+
+	FileInfoIterator it( dir );
+
+	while ( *it )
+	{
+	    FileInfo * item = *it;
+
+	    if ( item->nodeHasChildren() )
+	    {
+		if ( ! _visitor.skip( item ) )
+		    InlineCollector::collectRecursive( item );	// no virtual call
+	    }
+	    else if ( item->isFile() )
+	    {
+		_visitor.visitFile( item );
+	    }
+
+	    ++it;
+	}
+    }
+
+}	// namespace QDirStat
+
+
+#endif	// InlineCollector_h
@@ -0,0 +1,282 @@
+/*
+ *   File name: IoUring.cpp
+ *   Summary:	Minimal io_uring wrapper for batched statx() calls
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "IoUring.h"
+
+#if HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <linux/io_uring.h>
+
+
+using namespace QDirStat;
+
+
+static int sysIoUringSetup( unsigned entries, struct io_uring_params * params )
+{
+    return (int) syscall( __NR_io_uring_setup, entries, params );
+}
+
+
+static int sysIoUringEnter( int fd, unsigned toSubmit, unsigned minComplete, unsigned flags )
+{
+    return (int) syscall( __NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0 );
+}
+
+
+static int sysIoUringRegister( int fd, unsigned opcode, void * arg, unsigned nrArgs )
+{
+    return (int) syscall( __NR_io_uring_register, fd, opcode, arg, nrArgs );
+}
+
+
+IoUring::IoUring( unsigned entries ):
+    _ringFd( -1 ),
+    _sqEntries( 0 ),
+    _sqRing( MAP_FAILED ),
+    _sqRingSize( 0 ),
+    _cqRing( MAP_FAILED ),
+    _cqRingSize( 0 ),
+    _sqes( 0 ),
+    _sqesSize( 0 )
+{
+    struct io_uring_params params;
+    memset( &params, 0, sizeof( params ) );
+
+    _ringFd = sysIoUringSetup( entries, &params );
+
+    if ( _ringFd < 0 )	// ENOSYS, or disabled with sysctl kernel.io_uring_disabled
+	return;
+
+    _sqEntries	= params.sq_entries;
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+    _cqRingSize = params.cq_off.cqes  + params.cq_entries * sizeof( struct io_uring_cqe );
+
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+
+    if ( singleMmap && _cqRingSize > _sqRingSize )
+	_sqRingSize = _cqRingSize;
+
+    _sqRing = mmap( 0, _sqRingSize, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQ_RING );
+
+    if ( _sqRing == MAP_FAILED )
+    {
+	release();
+	return;
+    }
+
+    if ( singleMmap )
+    {
+	_cqRing = _sqRing;
+    }
+    else
+    {
+	_cqRing = mmap( 0, _cqRingSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_CQ_RING );
+
+	if ( _cqRing == MAP_FAILED )
+	{
+	    release();
+	    return;
+	}
+    }
+
+    _sqesSize = params.sq_entries * sizeof( struct io_uring_sqe );
+    void * sqes = mmap( 0, _sqesSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES );
+
+    if ( sqes == MAP_FAILED )
+    {
+	release();
+	return;
+    }
+
+    _sqes = (struct io_uring_sqe *) sqes;
+
+    char * sq = (char *) _sqRing;
+    char * cq = (char *) _cqRing;
+
+    _sqHead  = (unsigned *) ( sq + params.sq_off.head	     );
+    _sqTail  = (unsigned *) ( sq + params.sq_off.tail	     );
+    _sqMask  = (unsigned *) ( sq + params.sq_off.ring_mask );
+    _sqArray = (unsigned *) ( sq + params.sq_off.array     );
+    _cqHead  = (unsigned *) ( cq + params.cq_off.head	     );
+    _cqTail  = (unsigned *) ( cq + params.cq_off.tail	     );
+    _cqMask  = (unsigned *) ( cq + params.cq_off.ring_mask );
+    _cqes    = (struct io_uring_cqe *) ( cq + params.cq_off.cqes );
+
+    if ( ! probeStatx() )
+	release();
+}
+
+
+IoUring::~IoUring()
+{
+    release();
+}
+
+
+void IoUring::release()
+{
+    if ( _sqes )
+	munmap( _sqes, _sqesSize );
+
+    if ( _cqRing != MAP_FAILED && _cqRing != _sqRing )
+	munmap( _cqRing, _cqRingSize );
+
+    if ( _sqRing != MAP_FAILED )
+	munmap( _sqRing, _sqRingSize );
+
+    if ( _ringFd >= 0 )
+	close( _ringFd );
+
+    _sqes   = 0;
+    _sqRing = MAP_FAILED;
+    _cqRing = MAP_FAILED;
+    _ringFd = -1;
+}
+
+
+bool IoUring::probeStatx()
+{
+    // IORING_REGISTER_PROBE was added in the same kernel version (5.6) as
+    // IORING_OP_STATX, so a kernel that can't do the probe can't do statx
+    // either.
+
+    size_t probeSize = sizeof( struct io_uring_probe ) +
+	256 * sizeof( struct io_uring_probe_op );
+
+    struct io_uring_probe * probe = (struct io_uring_probe *) calloc( 1, probeSize );
+
+    if ( ! probe )
+	return false;
+
+    bool supported = false;
+
+    if ( sysIoUringRegister( _ringFd, IORING_REGISTER_PROBE, probe, 256 ) == 0 )
+    {
+	supported = probe->last_op >= IORING_OP_STATX &&
+	    ( probe->ops[ IORING_OP_STATX ].flags & IO_URING_OP_SUPPORTED );
+    }
+
+    free( probe );
+
+    return supported;
+}
+
+
+bool IoUring::statxBatch( int		      dirFd,
+			  const char * const * names,
+			  int		      count,
+			  int		      flags,
+			  unsigned	      mask,
+			  struct statx *      results,
+			  int *		      errors )
+{
+    if ( ! ok() )
+	return false;
+
+    int done = 0;
+
+    while ( done < count )
+    {
+	// Fill the submission queue with as many requests as fit
+
+	unsigned tail	= *_sqTail;	// Only this thread writes the tail
+	unsigned head	= __atomic_load_n( _sqHead, __ATOMIC_ACQUIRE );
+	unsigned freeSlots = _sqEntries - ( tail - head );
+	unsigned batch	= (unsigned) ( count - done ) < freeSlots ? (unsigned) ( count - done ) : freeSlots;
+
+	for ( unsigned i = 0; i < batch; ++i )
+	{
+	    int	     no	   = done + i;
+	    unsigned index = ( tail + i ) & *_sqMask;
+	    struct io_uring_sqe * sqe = &_sqes[ index ];
+
+	    memset( sqe, 0, sizeof( *sqe ) );
+	    sqe->opcode	     = IORING_OP_STATX;
+	    sqe->fd	     = dirFd;
+	    sqe->addr	     = (uint64_t) (uintptr_t) names[ no ];
+	    sqe->len	     = mask;
+	    sqe->off	     = (uint64_t) (uintptr_t) &results[ no ];
+	    sqe->statx_flags = flags;
+	    sqe->user_data   = no;
+
+	    _sqArray[ index ] = index;
+	}
+
+	__atomic_store_n( _sqTail, tail + batch, __ATOMIC_RELEASE );
+
+
+	// Submit them and wait until all of them are completed
+
+	unsigned completed = 0;
+
+	while ( completed < batch )
+	{
+	    int result = sysIoUringEnter( _ringFd,
+					  completed == 0 ? batch : 0,
+					  batch - completed,
+					  IORING_ENTER_GETEVENTS );
+	    if ( result < 0 )
+	    {
+		if ( errno == EINTR )
+		    continue;
+
+		release();
+		return false;
+	    }
+
+	    unsigned cqHead = *_cqHead;	// Only this thread writes the head
+	    unsigned cqTail = __atomic_load_n( _cqTail, __ATOMIC_ACQUIRE );
+
+	    while ( cqHead != cqTail )
+	    {
+		struct io_uring_cqe * cqe = &_cqes[ cqHead & *_cqMask ];
+		int no = (int) cqe->user_data;
+
+		if ( no >= 0 && no < count )
+		    errors[ no ] = cqe->res < 0 ? -cqe->res : 0;
+
+		++cqHead;
+		++completed;
+	    }
+
+	    __atomic_store_n( _cqHead, cqHead, __ATOMIC_RELEASE );
+	}
+
+	done += batch;
+    }
+
+    return true;
+}
+
+
+bool IoUring::isSupported()
+{
+    static int supported = -1;	// not checked yet
+
+    if ( supported < 0 )
+    {
+	IoUring testRing( 4 );
+	supported = testRing.ok() ? 1 : 0;
+    }
+
+    return supported == 1;
+}
+
+
+#endif // HAVE_IO_URING
@@ -0,0 +1,134 @@
+/*
+ *   File name: IoUring.h
+ *   Summary:	Minimal io_uring wrapper for batched statx() calls
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef IoUring_h
+#define IoUring_h
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+// io_uring needs Linux 5.6 or later for IORING_OP_STATX; this uses the raw
+// syscalls, so there is no dependency on liburing.
+
+#define HAVE_IO_URING		0
+
+#if defined( __linux__ ) && defined( __has_include ) && defined( STATX_BASIC_STATS )
+#  if __has_include( <linux/io_uring.h> )
+#    undef  HAVE_IO_URING
+#    define HAVE_IO_URING	1
+#  endif
+#endif
+
+
+#if HAVE_IO_URING
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+
+namespace QDirStat
+{
+    /**
+     * Minimal wrapper around one io_uring instance that is used for nothing
+     * else than submitting statx() calls for all entries of a directory in
+     * one go and collecting the results.
+     *
+     * On network filesystems, each statx() is one round trip to the server;
+     * with io_uring, the kernel executes many of them concurrently, so the
+     * latency of a directory is roughly that of a few round trips rather
+     * than one per entry.
+     *
+     * An io_uring instance must not be shared between threads without
+     * locking; use one instance per thread.
+     **/
+    class IoUring
+    {
+    public:
+
+	/**
+	 * Constructor: Set up an io_uring with 'entries' submission queue
+	 * entries. Check with ok() if that was successful.
+	 **/
+	IoUring( unsigned entries = 256 );
+
+	/**
+	 * Destructor.
+	 **/
+	~IoUring();
+
+	/**
+	 * Return 'true' if the io_uring is set up and supports statx().
+	 **/
+	bool ok() const { return _ringFd >= 0; }
+
+	/**
+	 * Call statx( dirFd, names[i], flags, mask, &results[i] ) for all
+	 * 'count' names. 'errors[i]' is set to 0 for success or to the
+	 * 'errno' value of that call.
+	 *
+	 * Return 'false' if the io_uring itself failed; in that case, the
+	 * caller should fall back to synchronous statx() calls.
+	 **/
+	bool statxBatch( int		     dirFd,
+			 const char * const * names,
+			 int		     count,
+			 int		     flags,
+			 unsigned	     mask,
+			 struct statx *	     results,
+			 int *		     errors );
+
+	/**
+	 * Return 'true' if this kernel generally supports io_uring with
+	 * statx(). This creates a test instance on the first call and caches
+	 * the result.
+	 **/
+	static bool isSupported();
+
+
+    protected:
+
+	/**
+	 * Check if IORING_OP_STATX is supported by this ring.
+	 **/
+	bool probeStatx();
+
+	/**
+	 * Unmap the rings and close the ring file descriptor.
+	 **/
+	void release();
+
+
+	int		_ringFd;
+	unsigned	_sqEntries;
+
+	void *		_sqRing;
+	size_t		_sqRingSize;
+	void *		_cqRing;
+	size_t		_cqRingSize;
+	io_uring_sqe *	_sqes;
+	size_t		_sqesSize;
+
+	unsigned *	_sqHead;
+	unsigned *	_sqTail;
+	unsigned *	_sqMask;
+	unsigned *	_sqArray;
+	unsigned *	_cqHead;
+	unsigned *	_cqTail;
+	unsigned *	_cqMask;
+	io_uring_cqe *	_cqes;
+
+    };	// class IoUring
+
+}	// namespace QDirStat
+
+#endif // HAVE_IO_URING
+
+#endif // ifndef IoUring_h
@@ -0,0 +1,303 @@
+/*
+ *   File name: LineTokenizer.h
+ *   Summary:	Fast splitting and number parsing of cache file lines
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef LineTokenizer_h
+#define LineTokenizer_h
+
+
+#include <stdint.h>
+
+#include <QtGlobal>
+
+#if defined( __SSE2__ )
+#  include <emmintrin.h>
+#  define LINE_TOKENIZER_SSE2	1
+#elif defined( __aarch64__ ) && defined( __ARM_NEON )
+#  include <arm_neon.h>
+#  define LINE_TOKENIZER_NEON	1
+#endif
+
+
+namespace QDirStat
+{
+    /**
+     * Functions for the inner loop of reading a text cache file: Splitting
+     * a line into its whitespace-separated fields and parsing the numbers
+     * in them. With millions of lines, the byte-by-byte loops with
+     * isspace() and strtoll() were a large part of the time of reading a
+     * cache file.
+     *
+     * Whitespace is any byte from 1 to 0x20, i.e. blanks and all control
+     * characters; the terminating 0 byte is a field end, too. Cache files
+     * never contain control characters in names since those are
+     * URL-encoded.
+     *
+     * The scanning functions use SSE2 (which every x86_64 CPU has) or NEON
+     * on aarch64 to check 16 bytes at a time, and a plain loop on other
+     * platforms. AVX2 would need a runtime CPU check, and most fields are
+     * too short to benefit from it.
+     *
+     * The SIMD versions only use aligned 16 byte loads. Such a load never
+     * crosses a page boundary, so it can't fault even if it reads a few
+     * bytes after the terminating 0 byte (the same technique that the libc
+     * strlen() uses), but memory checkers like valgrind may complain about
+     * it.
+     **/
+    namespace LineTokenizer
+    {
+	/**
+	 * Return 'true' if 'c' is whitespace (but not the terminating 0 byte).
+	 **/
+	inline bool isBlank( char c )
+	{
+	    return c != 0 && (unsigned char) c <= 0x20;
+	}
+
+
+#if LINE_TOKENIZER_NEON
+
+	/**
+	 * Return a bit mask of a NEON compare result with 4 bits per byte.
+	 **/
+	inline uint64_t neonMask( uint8x16_t cmp )
+	{
+	    uint8x8_t narrowed = vshrn_n_u16( vreinterpretq_u16_u8( cmp ), 4 );
+
+	    return vget_lane_u64( vreinterpret_u64_u8( narrowed ), 0 );
+	}
+
+#endif
+
+
+	/**
+	 * Return the first character in 'str' that is not whitespace. This
+	 * may be the terminating 0 byte.
+	 **/
+	inline char * skipBlanks( char * str )
+	{
+#if LINE_TOKENIZER_SSE2
+
+	    uintptr_t	  offset = (uintptr_t) str & 15;
+	    const char *  chunk	 = str - offset;
+	    unsigned	  valid	 = ( 0xFFFFu << offset ) & 0xFFFFu; // ignore bytes before str
+	    const __m128i space	 = _mm_set1_epi8( 0x20 );
+	    const __m128i zero	 = _mm_setzero_si128();
+
+	    while ( true )
+	    {
+		__m128i bytes = _mm_load_si128( (const __m128i *) chunk );
+		__m128i blank = _mm_cmpeq_epi8( _mm_min_epu8( bytes, space ), bytes ); // <= 0x20
+		__m128i nul   = _mm_cmpeq_epi8( bytes, zero );
+		unsigned stop = ~_mm_movemask_epi8( _mm_andnot_si128( nul, blank ) ) & valid;
+
+		if ( stop )
+		    return (char *) chunk + __builtin_ctz( stop );
+
+		chunk += 16;
+		valid  = 0xFFFFu;
+	    }
+
+#elif LINE_TOKENIZER_NEON
+
+	    uintptr_t	     offset = (uintptr_t) str & 15;
+	    const char *     chunk  = str - offset;
+	    uint64_t	     valid  = ~0ULL << ( 4 * offset );
+	    const uint8x16_t space  = vdupq_n_u8( 0x20 );
+	    const uint8x16_t zero   = vdupq_n_u8( 0 );
+
+	    while ( true )
+	    {
+		uint8x16_t bytes = vld1q_u8( (const uint8_t *) chunk );
+		uint8x16_t blank = vandq_u8( vcleq_u8( bytes, space ),
+					     vmvnq_u8( vceqq_u8( bytes, zero ) ) );
+		uint64_t   stop	 = ~neonMask( blank ) & valid;
+
+		if ( stop )
+		    return (char *) chunk + __builtin_ctzll( stop ) / 4;
+
+		chunk += 16;
+		valid  = ~0ULL;
+	    }
+
+#else
+
+	    while ( isBlank( *str ) )
+		++str;
+
+	    return str;
+
+#endif
+	}
+
+
+	/**
+	 * Return the first whitespace character or the terminating 0 byte
+	 * in 'str'.
+	 **/
+	inline char * findBlank( char * str )
+	{
+#if LINE_TOKENIZER_SSE2
+
+	    uintptr_t	  offset = (uintptr_t) str & 15;
+	    const char *  chunk	 = str - offset;
+	    unsigned	  valid	 = ( 0xFFFFu << offset ) & 0xFFFFu;
+	    const __m128i space	 = _mm_set1_epi8( 0x20 );
+
+	    while ( true )
+	    {
+		__m128i bytes = _mm_load_si128( (const __m128i *) chunk );
+		__m128i blank = _mm_cmpeq_epi8( _mm_min_epu8( bytes, space ), bytes ); // <= 0x20, including 0
+		unsigned stop = _mm_movemask_epi8( blank ) & valid;
+
+		if ( stop )
+		    return (char *) chunk + __builtin_ctz( stop );
+
+		chunk += 16;
+		valid  = 0xFFFFu;
+	    }
+
+#elif LINE_TOKENIZER_NEON
+
+	    uintptr_t	     offset = (uintptr_t) str & 15;
+	    const char *     chunk  = str - offset;
+	    uint64_t	     valid  = ~0ULL << ( 4 * offset );
+	    const uint8x16_t space  = vdupq_n_u8( 0x20 );
+
+	    while ( true )
+	    {
+		uint8x16_t bytes = vld1q_u8( (const uint8_t *) chunk );
+		uint64_t   stop	 = neonMask( vcleq_u8( bytes, space ) ) & valid;
+
+		if ( stop )
+		    return (char *) chunk + __builtin_ctzll( stop ) / 4;
+
+		chunk += 16;
+		valid  = ~0ULL;
+	    }
+
+#else
+
+	    while ( (unsigned char) *str > 0x20 )
+		++str;
+
+	    return str;
+
+#endif
+	}
+
+
+	/**
+	 * Split 'line' into at most 'maxFields' fields separated by
+	 * whitespace and store the start of each field in 'fields'. This
+	 * overwrites the whitespace after each field with a 0 byte. Leading
+	 * and trailing whitespace is ignored. Return the number of fields.
+	 **/
+	inline int splitFields( char * line, char ** fields, int maxFields )
+	{
+	    int	   count = 0;
+	    char * pos	 = skipBlanks( line );
+
+	    while ( *pos && count < maxFields )
+	    {
+		fields[ count++ ] = pos;
+		pos = findBlank( pos );
+
+		if ( ! *pos )
+		    break;
+
+		*pos = 0;
+		pos  = skipBlanks( pos + 1 );
+	    }
+
+	    return count;
+	}
+
+
+	/**
+	 * Parse a decimal number with an optional sign in 'str'. If 'end' is
+	 * non-null, store a pointer to the first character after the number
+	 * there. Unlike strtoll(), this does not check for overflow and does
+	 * not skip leading whitespace.
+	 **/
+	inline qint64 parseDecimal( const char * str, const char ** end = 0 )
+	{
+	    bool negative = *str == '-';
+
+	    if ( negative || *str == '+' )
+		++str;
+
+	    quint64 value = 0;
+	    unsigned digit;
+
+	    while ( ( digit = (unsigned char) *str - '0' ) < 10 )
+	    {
+		value = value * 10 + digit;
+		++str;
+	    }
+
+	    if ( end )
+		*end = str;
+
+	    return negative ? - (qint64) value : (qint64) value;
+	}
+
+
+	/**
+	 * Parse a number in 'str' like strtoll() with base 0: "0x" or "0X"
+	 * for hex, a leading "0" for octal, decimal otherwise.
+	 **/
+	inline qint64 parseNumber( const char * str )
+	{
+	    bool negative = *str == '-';
+
+	    if ( negative || *str == '+' )
+		++str;
+
+	    quint64 value = 0;
+
+	    if ( str[0] == '0' && ( str[1] == 'x' || str[1] == 'X' ) )
+	    {
+		str += 2;
+
+		while ( true )
+		{
+		    unsigned c = (unsigned char) *str++;
+		    unsigned digit;
+
+		    if	    ( c - '0' < 10 )	digit = c - '0';
+		    else if ( ( c | 0x20 ) - 'a' < 6 ) digit = ( c | 0x20 ) - 'a' + 10;
+		    else break;
+
+		    value = ( value << 4 ) | digit;
+		}
+	    }
+	    else if ( str[0] == '0' )
+	    {
+		unsigned digit;
+
+		while ( ( digit = (unsigned char) *str - '0' ) < 8 )
+		{
+		    value = ( value << 3 ) | digit;
+		    ++str;
+		}
+	    }
+	    else
+	    {
+		value = (quint64) parseDecimal( str );
+	    }
+
+	    return negative ? - (qint64) value : (qint64) value;
+	}
+
+    }	// namespace LineTokenizer
+
+}	// namespace QDirStat
+
+
+#endif // ifndef LineTokenizer_h
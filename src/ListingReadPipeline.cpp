@@ -0,0 +1,554 @@
+/*
+ *   File name: ListingReadPipeline.cpp
+ *   Summary:	Multithreaded parsing of file listings and locate databases
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "ListingReadPipeline.h"
+#include "LineTokenizer.h"
+#include "ReadTrace.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+// Size of the blocks that the input thread reads and hands to the parser
+// threads
+#define LISTING_BLOCK_SIZE	( 256 * 1024 )
+
+// The start of mlocate.db and plocate.db files
+#define MLOCATE_MAGIC		"\0mlocate"
+#define PLOCATE_MAGIC		"\0plocate"
+#define LOCATE_MAGIC_SIZE	8
+
+// Program to read plocate.db files with
+#define PLOCATE_COMMAND		"plocate"
+
+
+using namespace QDirStat;
+
+
+/**
+ * Return the file type bits for the "find -printf %y" type letter 'type'
+ * or 0 if it is unknown.
+ **/
+static mode_t findTypeMode( char type )
+{
+    switch ( type )
+    {
+	case 'f': return S_IFREG;
+	case 'd': return S_IFDIR;
+	case 'l': return S_IFLNK;
+	case 'b': return S_IFBLK;
+	case 'c': return S_IFCHR;
+	case 'p': return S_IFIFO;
+	case 's': return S_IFSOCK;
+	default:  return 0;
+    }
+}
+
+
+/**
+ * Return the parent directory of absolute path 'path'.
+ **/
+static QByteArray parentPath( const QByteArray & path )
+{
+    int slash = path.lastIndexOf( '/' );
+
+    return slash > 0 ? path.left( slash ) : QByteArray( "/" );
+}
+
+
+
+
+ListingReadPipeline::ListingReadPipeline( const QString & fileName, int parserCount ):
+    CacheReadPipeline( 0, 0, parserCount ),
+    _fileName( fileName ),
+    _format( detectFormat( fileName ) ),
+    _typed( false ),
+    _process( 0 ),
+    _inputPos( 0 ),
+    _inputError( false ),
+    _lineCount( 0 ),
+    _shuttingDown( false )
+{
+    if ( _format == PlocateDb )
+    {
+	// plocate checks for each file if the user may see it, so it is
+	// setgid to be able to read the database
+
+	QString quotedName = "'" + QString( fileName ).replace( "'", "'\\''" ) + "'";
+	QString command	   = QString( PLOCATE_COMMAND " -0 -d %1 /" ).arg( quotedName );
+
+	logInfo() << "Reading " << fileName << " with " << command << endl;
+	_process = popen( command.toUtf8().constData(), "r" );
+
+	// gzclose() closes the file descriptor, pclose() the FILE
+
+	if ( _process )
+	    _gzCache = gzdopen( dup( fileno( _process ) ), "r" );
+    }
+    else if ( _format != NoListing )
+    {
+	_gzCache = gzopen( fileName.toUtf8().constData(), "r" );
+
+	if ( _gzCache && _format == FindListing )
+	{
+	    _typed = gzgetc( _gzCache ) != '/';
+	    gzrewind( _gzCache );
+	}
+    }
+
+    if ( ! _gzCache )
+	logError() << "Can't open " << fileName << ": " << formatErrno() << endl;
+}
+
+
+ListingReadPipeline::~ListingReadPipeline()
+{
+    stop();	// The threads use the data members of this class
+
+    if ( _gzCache )
+	gzclose( _gzCache );
+
+    if ( _process )
+	pclose( _process );
+}
+
+
+ListingFormat ListingReadPipeline::detectFormat( const QString & fileName )
+{
+    gzFile file = gzopen( fileName.toUtf8().constData(), "r" );
+
+    if ( ! file )
+    {
+	// plocate.db is usually only readable for the plocate group
+
+	return fileName.endsWith( "plocate.db" ) ? PlocateDb : NoListing;
+    }
+
+    char start[ LOCATE_MAGIC_SIZE ];
+    int	 len = gzread( file, start, sizeof( start ) );
+    gzclose( file );
+
+    if ( len == LOCATE_MAGIC_SIZE && memcmp( start, MLOCATE_MAGIC, LOCATE_MAGIC_SIZE ) == 0 )
+	return MlocateDb;
+
+    if ( len == LOCATE_MAGIC_SIZE && memcmp( start, PLOCATE_MAGIC, LOCATE_MAGIC_SIZE ) == 0 )
+	return PlocateDb;
+
+    // A path or a type letter and a blank, then a number or a path
+
+    if ( len >= 1 && start[0] == '/' )
+	return FindListing;
+
+    if ( len >= 3 && findTypeMode( start[0] ) && start[1] == ' ' &&
+	 ( start[2] == '/' || ( start[2] >= '0' && start[2] <= '9' ) ) )
+    {
+	return FindListing;
+    }
+
+    return NoListing;
+}
+
+
+void ListingReadPipeline::readInput()
+{
+    switch ( _format )
+    {
+	case MlocateDb:
+	    readMlocate();
+	    break;
+
+	case PlocateDb:
+	    readPaths( '\0' );
+	    break;
+
+	case FindListing:
+
+	    // Lines with a type can go to the parser threads as they are
+
+	    if ( _typed )
+		CacheReadPipeline::readInput();
+	    else
+		readPaths( '\n' );
+	    break;
+
+	case NoListing:
+	    setInputDone( true );
+	    break;
+    }
+}
+
+
+void ListingReadPipeline::readPaths( char separator )
+{
+    QByteArray pending;		// the previous path; its type is not known yet
+    QByteArray record;
+
+    while ( ! _shuttingDown && fillInput() )
+    {
+	const char * start = _input.constData() + _inputPos;
+	const char * end   = _input.constData() + _input.size();
+	const char * sep   = (const char *) memchr( start, separator, end - start );
+
+	if ( ! sep )
+	{
+	    // The rest of the record is in the next input block
+
+	    record.append( start, end - start );
+	    _inputPos = _input.size();
+	    continue;
+	}
+
+	record.append( start, sep - start );
+	_inputPos = sep - _input.constData() + 1;
+
+	addRecord( record, pending );
+	record.clear();
+    }
+
+    if ( ! record.isEmpty() )	// no separator after the last one
+	addRecord( record, pending );
+
+    if ( ! pending.isEmpty() )
+	addLine( "f " + pending );
+
+    flushLines();
+    setInputDone( _inputError );
+}
+
+
+void ListingReadPipeline::addRecord( QByteArray & record, QByteArray & pending )
+{
+    if ( record.isEmpty() || record.contains( '\n' ) )
+	return;		// A name with a newline can't be in a line
+
+    if ( record.size() > 1 && record.endsWith( '/' ) )
+	record.chop( 1 );
+
+    if ( record.at( 0 ) != '/' )
+    {
+	// Already with a type: "find -printf"
+
+	if ( ! pending.isEmpty() )
+	    addLine( "f " + pending );
+
+	pending.clear();
+	addLine( record );
+
+	return;
+    }
+
+    if ( ! _lineCount && _format == PlocateDb )
+    {
+	// The entries of a locate database start below its root
+
+	addLine( "d " + parentPath( record ) );
+    }
+
+    if ( ! pending.isEmpty() )
+    {
+	bool isDir = record.startsWith( pending + '/' ) ||
+	    ( pending == "/" && record.size() > 1 );
+
+	addLine( ( isDir ? "d " : "f " ) + pending );
+    }
+
+    pending = record;
+}
+
+
+void ListingReadPipeline::readMlocate()
+{
+    // See man mlocate.db: The magic, the size of the configuration block,
+    // the file format version, a flag, padding, the root path, the
+    // configuration block; then each directory with its time, padding, its
+    // path and its entries.
+
+    char       header[ LOCATE_MAGIC_SIZE + 8 ];
+    QByteArray root;
+
+    if ( ! readBytes( header, sizeof( header ) ) || ! readString( root ) )
+    {
+	setInputDone( true );
+	return;
+    }
+
+    const uchar * confSize = (const uchar *) header + LOCATE_MAGIC_SIZE;
+    quint32 skip = ( confSize[0] << 24 ) | ( confSize[1] << 16 ) | ( confSize[2] << 8 ) | confSize[3];
+
+    QByteArray conf( skip, 0 );
+
+    if ( skip > 0 && ! readBytes( conf.data(), skip ) )
+    {
+	setInputDone( true );
+	return;
+    }
+
+    addLine( "d " + root );
+
+    char       dirHeader[ 16 ];
+    QByteArray dir;
+    QByteArray name;
+    bool       ok = true;
+
+    while ( ok && ! _shuttingDown && fillInput() )
+    {
+	ok = readBytes( dirHeader, sizeof( dirHeader ) ) && readString( dir );
+
+	if ( dir != "/" )
+	    dir += '/';
+
+	while ( ok )
+	{
+	    char type;
+	    ok = readBytes( &type, 1 );
+
+	    if ( ! ok || type == 2 )	// end of this directory
+		break;
+
+	    ok = readString( name );
+
+	    if ( ok && ! name.contains( '\n' ) )
+		addLine( ( type == 1 ? "d " : "f " ) + dir + name );
+	}
+    }
+
+    flushLines();
+    setInputDone( ! ok || _inputError );
+}
+
+
+bool ListingReadPipeline::addLine( const QByteArray & line )
+{
+    ++_lineCount;
+    _output.append( line );
+    _output.append( '\n' );
+
+    if ( _output.size() >= LISTING_BLOCK_SIZE )
+	flushLines();
+
+    return ! _shuttingDown;
+}
+
+
+void ListingReadPipeline::flushLines()
+{
+    if ( ! _output.isEmpty() && ! _shuttingDown )
+	_shuttingDown = ! addRawBlock( _output );
+
+    _output.clear();
+}
+
+
+bool ListingReadPipeline::fillInput()
+{
+    if ( _inputPos < _input.size() )
+	return true;
+
+    _input.resize( LISTING_BLOCK_SIZE );
+    _inputPos = 0;
+
+    int len;
+
+    {
+	READ_TRACE_SCOPE( "listing read block", QString() );
+	len = readRaw( _input.data(), _input.size() );
+    }
+
+    if ( len < 0 )
+	_inputError = true;
+
+    _input.resize( qMax( len, 0 ) );
+
+    return len > 0;
+}
+
+
+bool ListingReadPipeline::readBytes( char * buf, int len )
+{
+    while ( len > 0 )
+    {
+	if ( ! fillInput() )
+	    return false;
+
+	int count = qMin( len, _input.size() - _inputPos );
+	memcpy( buf, _input.constData() + _inputPos, count );
+
+	_inputPos += count;
+	buf	  += count;
+	len	  -= count;
+    }
+
+    return true;
+}
+
+
+bool ListingReadPipeline::readString( QByteArray & str )
+{
+    str.clear();
+
+    while ( fillInput() )
+    {
+	const char * start = _input.constData() + _inputPos;
+	const char * end   = _input.constData() + _input.size();
+	const char * zero  = (const char *) memchr( start, 0, end - start );
+
+	if ( zero )
+	{
+	    str.append( start, zero - start );
+	    _inputPos = zero - _input.constData() + 1;
+
+	    return true;
+	}
+
+	str.append( start, end - start );
+	_inputPos = _input.size();
+    }
+
+    return false;
+}
+
+
+void ListingReadPipeline::parseBlock( CacheBlock * block )
+{
+    char * pos = block->data.data();	// detach: the lines are split in place
+    char * end = pos + block->data.size();
+
+    READ_TRACE_SCOPE( "listing parse block", QString::number( block->seq ) );
+    block->items.reserve( block->data.size() / 48 );
+
+    while ( pos < end )
+    {
+	char * newline = (char *) memchr( pos, '\n', end - pos );
+	char * next    = newline ? newline + 1 : end;
+
+	if ( newline )
+	    *newline = 0;
+
+	++block->lineCount;
+
+	if ( *pos != 0 )
+	{
+	    CacheItem item;
+	    item.lineNo = block->lineCount;
+
+	    parseLine( pos, item );
+	    block->items.append( item );
+	}
+
+	pos = next;
+    }
+
+    block->data.clear();	// not needed anymore
+}
+
+
+void ListingReadPipeline::parseLine( char * line, CacheItem & item )
+{
+    item.mode	     = S_IFREG;
+    item.size	     = 0;
+    item.blocks	     = -1;
+    item.mtime	     = 0;
+    item.links	     = 1;
+    item.isDir	     = false;
+    item.isAbsolute  = true;
+    item.fieldsCount = 0;	// syntax error until the path is there
+
+    char * path = line;
+
+    if ( *line != '/' )
+    {
+	// "%y [%s [%b [%n]] %T@] %p"
+
+	item.mode = findTypeMode( line[0] );
+
+	if ( ! item.mode || line[1] != ' ' )
+	    return;
+
+	qint64 numbers[ 4 ];
+	int    count = 0;
+
+	path = line + 2;
+
+	while ( *path != '/' )
+	{
+	    const char * numEnd;
+
+	    if ( count == 4 )
+		return;
+
+	    numbers[ count++ ] = LineTokenizer::parseDecimal( path, &numEnd );
+
+	    if ( numEnd == path )
+		return;
+
+	    if ( *numEnd == '.' )	// %T@ has the fraction of a second
+	    {
+		do
+		    ++numEnd;
+		while ( *numEnd >= '0' && *numEnd <= '9' );
+	    }
+
+	    if ( *numEnd != ' ' )
+		return;
+
+	    path = (char *) numEnd + 1;
+	}
+
+	switch ( count )
+	{
+	    case 0:	// only the type
+		break;
+
+	    case 2:
+		item.size   = numbers[0];
+		item.mtime  = numbers[1];
+		break;
+
+	    case 3:
+		item.size   = numbers[0];
+		item.blocks = numbers[1];
+		item.mtime  = numbers[2];
+		break;
+
+	    case 4:
+		item.size   = numbers[0];
+		item.blocks = numbers[1];
+		item.links  = numbers[2];
+		item.mtime  = numbers[3];
+		break;
+
+	    default:
+		return;
+	}
+    }
+
+    int len = strlen( path );
+
+    if ( len > 1 && path[ len - 1 ] == '/' )
+	path[ --len ] = 0;
+
+    char * slash = strrchr( path, '/' );
+
+    if ( len == 1 )	// the root directory
+    {
+	item.path = "";
+	item.name = "/";
+    }
+    else
+    {
+	item.path = slash == path ? QString( "/" ) : QString::fromUtf8( path, slash - path );
+	item.name = QString::fromUtf8( slash + 1 );
+    }
+
+    item.isDir	     = S_ISDIR( item.mode );
+    item.fieldsCount = 4;
+}
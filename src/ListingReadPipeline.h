@@ -0,0 +1,180 @@
+/*
+ *   File name: ListingReadPipeline.h
+ *   Summary:	Multithreaded parsing of file listings and locate databases
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef ListingReadPipeline_h
+#define ListingReadPipeline_h
+
+
+#include <stdio.h>	// FILE
+
+#include "CacheReadPipeline.h"
+
+
+namespace QDirStat
+{
+    /**
+     * The formats that a ListingReadPipeline can read.
+     **/
+    enum ListingFormat
+    {
+	NoListing,	// not a listing that can be read
+	FindListing,	// the output of "find /dir" or "find /dir -printf ..."
+	MlocateDb,	// an mlocate.db database of updatedb
+	PlocateDb	// a plocate.db database of updatedb
+    };
+
+
+    /**
+     * Pipeline for building a tree from a listing of files that was made
+     * without QDirStat, so there is no need for another scan of the
+     * filesystem if one of these exists anyway. The input thread brings
+     * each of them into one line per item; the parser threads turn the
+     * lines into CacheItems, so a CacheReader can add them to the tree just
+     * like the items of a cache file (see ListingReadJob).
+     *
+     * Supported are:
+     *
+     * - "find" output, optionally gzipped. Each line is either only the
+     *	 path, or it is made with
+     *
+     *	   find /dir -printf '%y %s %T@ %p\n'
+     *	   find /dir -printf '%y %s %b %T@ %p\n'
+     *	   find /dir -printf '%y %s %b %n %T@ %p\n'
+     *
+     *	 i.e. the type, the size, optionally the number of blocks and of
+     *	 links, the mtime and the path. The paths have to be absolute.
+     *
+     * - mlocate.db files. Those contain only the names and whether each
+     *	 entry is a directory.
+     *
+     * - plocate.db files. The format of those is not documented, so they
+     *	 are read with "plocate -0 -d <db> /" which has to be installed.
+     *	 They contain only the names.
+     *
+     * Without the type of an entry, it is a directory if the next path is
+     * inside it, so an empty directory becomes an empty file. Without the
+     * size, it is 0; reading the directory for real (with "refresh") gets
+     * the sizes of what is in it.
+     **/
+    class ListingReadPipeline: public CacheReadPipeline
+    {
+    public:
+
+	/**
+	 * Constructor: Open listing 'fileName'. Check ok() afterwards.
+	 *
+	 * 'parserCount' is the number of parser threads.
+	 **/
+	ListingReadPipeline( const QString & fileName, int parserCount );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~ListingReadPipeline();
+
+	/**
+	 * Return 'true' if the listing could be opened.
+	 **/
+	bool ok() const { return _gzCache != 0; }
+
+	/**
+	 * Return the format of the listing.
+	 **/
+	ListingFormat format() const { return _format; }
+
+	/**
+	 * Return the format of 'fileName' or NoListing if it is not a
+	 * listing, e.g. because it is a QDirStat cache file.
+	 **/
+	static ListingFormat detectFormat( const QString & fileName );
+
+
+    protected:
+
+	/**
+	 * Reimplemented from CacheReadPipeline.
+	 **/
+	virtual void readInput() Q_DECL_OVERRIDE;
+
+	/**
+	 * Reimplemented from CacheReadPipeline.
+	 **/
+	virtual void parseBlock( CacheBlock * block ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Parse one line into 'item'. For a syntax error, item.fieldsCount
+	 * is 0.
+	 **/
+	static void parseLine( char * line, CacheItem & item );
+
+	/**
+	 * Read a listing with 'separator' between the entries and add the
+	 * type to each entry that has only a path.
+	 **/
+	void readPaths( char separator );
+
+	/**
+	 * Add the line for one entry 'record' of readPaths(). 'pending' is
+	 * the previous entry if it is only a path since its type is known
+	 * only with the next one.
+	 **/
+	void addRecord( QByteArray & record, QByteArray & pending );
+
+	/**
+	 * Read an mlocate.db file.
+	 **/
+	void readMlocate();
+
+	/**
+	 * Add 'line' to the output of the input thread and hand it to the
+	 * parser threads when it is large enough. Return 'false' if the
+	 * pipeline is shutting down.
+	 **/
+	bool addLine( const QByteArray & line );
+
+	/**
+	 * Hand the rest of the output to the parser threads.
+	 **/
+	void flushLines();
+
+	/**
+	 * Read 'len' bytes from the input to 'buf'. Return 'false' at the
+	 * end of the input or on error.
+	 **/
+	bool readBytes( char * buf, int len );
+
+	/**
+	 * Read a string that is terminated by a 0 byte from the input.
+	 * Return 'false' at the end of the input or on error.
+	 **/
+	bool readString( QByteArray & str );
+
+	/**
+	 * Make sure that there are input bytes available. Return 'false' at
+	 * the end of the input or on error.
+	 **/
+	bool fillInput();
+
+
+	QString		_fileName;
+	ListingFormat	_format;
+	bool		_typed;		// the first line is not just a path
+	FILE *		_process;	// for plocate
+	QByteArray	_input;
+	int		_inputPos;
+	bool		_inputError;
+	QByteArray	_output;
+	qint64		_lineCount;	// lines added so far
+	bool		_shuttingDown;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef ListingReadPipeline_h
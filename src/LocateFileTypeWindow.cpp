@@ -9,10 +9,13 @@
 
 #include <algorithm>
 
+#include <QHash>
+
 #include "LocateFileTypeWindow.h"
 #include "QDirStatApp.h"        // SelectionModel
 #include "DirTree.h"
 #include "DotEntry.h"
+#include "FileNameIndex.h"
 #include "SelectionModel.h"
 #include "SettingsHelpers.h"
 #include "HeaderTweaker.h"
@@ -115,7 +118,12 @@ void LocateFileTypeWindow::populate( const QString & suffix, FileInfo * newSubtr
     // For better Performance: Disable sorting while inserting many items
     _ui->treeWidget->setSortingEnabled( false );
 
-    populateRecursive( newSubtree ? newSubtree : _subtree() );
+    FileNameIndex * index = app()->fileNameIndex();
+
+    if ( index && index->isReady() )
+	populateFromIndex( index, newSubtree ? newSubtree : _subtree() );
+    else
+	populateRecursive( newSubtree ? newSubtree : _subtree() );
 
     _ui->treeWidget->setSortingEnabled( true );
     _ui->treeWidget->sortByColumn( SSR_PathCol, Qt::AscendingOrder );
@@ -184,6 +192,46 @@ void LocateFileTypeWindow::populateRecursive( FileInfo * dir )
 }
 
 
+void LocateFileTypeWindow::populateFromIndex( FileNameIndex * index, FileInfo * subtree )
+{
+    if ( ! subtree )
+	return;
+
+    // Group the matching files by directory. Files in a dot entry belong
+    // to the dot entry's parent just like in matchingFiles().
+
+    QHash<FileInfo *, int>	counts;
+    QHash<FileInfo *, FileSize> totalSizes;
+    QList<FileInfo *>		dirs;
+
+    foreach ( FileInfo * file, index->filesWithSuffix( _searchSuffix, subtree ) )
+    {
+	FileInfo * dir = file->parent();
+
+	if ( dir && dir->isDotEntry() )
+	    dir = dir->parent();
+
+	if ( ! dir )
+	    continue;
+
+	if ( ! counts.contains( dir ) )
+	    dirs << dir;
+
+	counts[ dir ]++;
+	totalSizes[ dir ] += file->size();
+    }
+
+    foreach ( FileInfo * dir, dirs )
+    {
+	SuffixSearchResultItem * searchResultItem =
+	    new SuffixSearchResultItem( dir->url(), counts.value( dir ), totalSizes.value( dir ) );
+	CHECK_NEW( searchResultItem );
+
+	_ui->treeWidget->addTopLevelItem( searchResultItem );
+    }
+}
+
+
 FileInfoSet LocateFileTypeWindow::matchingFiles( FileInfo * item )
 {
     FileInfoSet result;
@@ -23,6 +23,7 @@ namespace QDirStat
 {
     class DirTree;
     class FileTypeStats;
+    class FileNameIndex;
     class MimeCategory;
     class SelectionModel;
 
@@ -129,6 +130,13 @@ namespace QDirStat
 	 **/
 	void populateRecursive( FileInfo * dir );
 
+	/**
+	 * Create a search result item for each directory in 'subtree' that
+	 * contains files matching the search suffix from the file name index
+	 * 'index' without traversing the tree.
+	 **/
+	void populateFromIndex( FileNameIndex * index, FileInfo * subtree );
+
 	/**
 	 * Return all direct file children matching the current search suffix.
 	 **/
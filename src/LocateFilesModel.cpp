@@ -0,0 +1,311 @@
+/*
+ *   File name: LocateFilesModel.cpp
+ *   Summary:	Data model for the "locate files" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <algorithm>
+
+#include <QHash>
+
+#include "LocateFilesModel.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Sort key for sorting by size or mtime
+     **/
+    struct ValueSortKey
+    {
+	qint64	   value;
+	FileInfo * item;
+    };
+
+
+    /**
+     * Sort key for sorting by path
+     **/
+    struct PathSortKey
+    {
+	QString	   path;
+	FileInfo * item;
+    };
+
+
+    /**
+     * Comparison functor for any type of sort key with 'member' as the key.
+     **/
+    template<typename Key, typename Value, Value Key::*member> struct SortKeyLess
+    {
+	SortKeyLess( Qt::SortOrder sortOrder ):
+	    descending( sortOrder == Qt::DescendingOrder )
+	    {}
+
+	bool operator() ( const Key & a, const Key & b ) const
+	    { return descending ? b.*member < a.*member : a.*member < b.*member; }
+
+	bool descending;
+    };
+
+    typedef SortKeyLess<ValueSortKey, qint64,  &ValueSortKey::value> ValueSortKeyLess;
+    typedef SortKeyLess<PathSortKey,  QString, &PathSortKey::path>   PathSortKeyLess;
+
+}	// namespace
+
+
+LocateFilesModel::LocateFilesModel( QObject * parent ):
+    QAbstractTableModel( parent ),
+    _tree( 0 )
+{
+
+}
+
+
+LocateFilesModel::~LocateFilesModel()
+{
+
+}
+
+
+void LocateFilesModel::setResults( const FileInfoList & results, DirTree * tree )
+{
+    beginResetModel();
+
+    if ( _tree != tree )
+    {
+	if ( _tree )
+	    disconnect( _tree, 0, this, 0 );
+
+	_tree = tree;
+
+	if ( _tree )
+	{
+	    connect( _tree, SIGNAL( deletingChild  ( FileInfo * ) ),
+		     this,  SLOT  ( deletingChild  ( FileInfo * ) ) );
+
+	    connect( _tree, SIGNAL( clearingSubtree( DirInfo * ) ),
+		     this,  SLOT  ( clearingSubtree( DirInfo * ) ) );
+
+	    connect( _tree, SIGNAL( clearing() ),
+		     this,  SLOT  ( clearing() ) );
+	}
+    }
+
+    _items.clear();
+    _items.reserve( results.size() );
+
+    foreach ( FileInfo * item, results )
+	_items << item;
+
+    endResetModel();
+}
+
+
+FileInfo * LocateFilesModel::itemAt( int row ) const
+{
+    if ( row < 0 || row >= _items.size() )
+	return 0;
+
+    return _items.at( row );
+}
+
+
+int LocateFilesModel::rowCount( const QModelIndex & parent ) const
+{
+    return parent.isValid() ? 0 : _items.size();
+}
+
+
+int LocateFilesModel::columnCount( const QModelIndex & parent ) const
+{
+    return parent.isValid() ? 0 : LocateListColumnCount;
+}
+
+
+QVariant LocateFilesModel::data( const QModelIndex & index, int role ) const
+{
+    if ( ! index.isValid() )
+	return QVariant();
+
+    FileInfo * item = itemAt( index.row() );
+
+    if ( ! item )
+	return QVariant();
+
+    switch ( role )
+    {
+	case Qt::DisplayRole:
+	    switch ( index.column() )
+	    {
+		case LocateListSizeCol:	 return formatSize( item->size() )   + " ";
+		case LocateListMTimeCol: return formatTime( item->mtime() ) + " ";
+		case LocateListPathCol:	 return item->url()		     + " ";
+		default:		 return QVariant();
+	    }
+
+	case Qt::TextAlignmentRole:
+	    if ( index.column() == LocateListSizeCol )
+		return (int) ( Qt::AlignRight | Qt::AlignVCenter );
+	    else
+		return (int) ( Qt::AlignLeft  | Qt::AlignVCenter );
+
+	default:
+	    return QVariant();
+    }
+}
+
+
+QVariant LocateFilesModel::headerData( int		 section,
+				       Qt::Orientation orientation,
+				       int		 role ) const
+{
+    if ( orientation != Qt::Horizontal || role != Qt::DisplayRole )
+	return QVariant();
+
+    switch ( section )
+    {
+	case LocateListSizeCol:	 return tr( "Size"	    );
+	case LocateListMTimeCol: return tr( "Last Modified" );
+	case LocateListPathCol:	 return tr( "Path"	    );
+	default:		 return QVariant();
+    }
+}
+
+
+void LocateFilesModel::sort( int column, Qt::SortOrder order )
+{
+    if ( column < 0 || column >= LocateListColumnCount )
+	return;
+
+    emit layoutAboutToBeChanged();
+    QVector<FileInfo *> oldItems = _items;
+
+    // Fetch the sort key of each item only once rather than for each
+    // comparison; this matters most for the path that would otherwise be
+    // built again for each comparison.
+
+    if ( column == LocateListPathCol )
+    {
+	QVector<PathSortKey> keys( _items.size() );
+
+	for ( int i = 0; i < _items.size(); ++i )
+	{
+	    keys[i].path = _items.at( i )->url();
+	    keys[i].item = _items.at( i );
+	}
+
+	std::sort( keys.begin(), keys.end(), PathSortKeyLess( order ) );
+
+	for ( int i = 0; i < keys.size(); ++i )
+	    _items[i] = keys.at( i ).item;
+    }
+    else
+    {
+	QVector<ValueSortKey> keys( _items.size() );
+
+	for ( int i = 0; i < _items.size(); ++i )
+	{
+	    FileInfo * item = _items.at( i );
+
+	    keys[i].value = column == LocateListSizeCol ? item->size() : (qint64) item->mtime();
+	    keys[i].item  = item;
+	}
+
+	std::sort( keys.begin(), keys.end(), ValueSortKeyLess( order ) );
+
+	for ( int i = 0; i < keys.size(); ++i )
+	    _items[i] = keys.at( i ).item;
+    }
+
+    updatePersistentIndexes( oldItems );
+    emit layoutChanged();
+}
+
+
+void LocateFilesModel::updatePersistentIndexes( const QVector<FileInfo *> & oldItems )
+{
+    QModelIndexList oldIndexes = persistentIndexList();
+
+    if ( oldIndexes.isEmpty() )
+	return;
+
+    QHash<FileInfo *, int> rows;
+    rows.reserve( _items.size() );
+
+    for ( int row = 0; row < _items.size(); ++row )
+	rows.insert( _items.at( row ), row );
+
+    foreach ( const QModelIndex & oldIndex, oldIndexes )
+    {
+	int row = rows.value( oldItems.value( oldIndex.row() ), -1 );
+
+	changePersistentIndex( oldIndex,
+			       row < 0 ? QModelIndex() : index( row, oldIndex.column() ) );
+    }
+}
+
+
+void LocateFilesModel::removeResults( FileInfo * subtree, bool includeSubtree )
+{
+    // Remove each contiguous range of matching rows with one
+    // beginRemoveRows() / endRemoveRows(), starting from the end so the
+    // row numbers of the remaining ranges don't change.
+
+    int row = _items.size() - 1;
+
+    while ( row >= 0 )
+    {
+	FileInfo * item = _items.at( row );
+
+	if ( ( item == subtree && ! includeSubtree ) || ! item->isInSubtree( subtree ) )
+	{
+	    --row;
+	    continue;
+	}
+
+	int last = row;
+
+	while ( row > 0 &&
+		( _items.at( row - 1 ) != subtree || includeSubtree ) &&
+		_items.at( row - 1 )->isInSubtree( subtree ) )
+	{
+	    --row;
+	}
+
+	beginRemoveRows( QModelIndex(), row, last );
+	_items.remove( row, last - row + 1 );
+	endRemoveRows();
+
+	--row;
+    }
+}
+
+
+void LocateFilesModel::deletingChild( FileInfo * child )
+{
+    removeResults( child, true );
+}
+
+
+void LocateFilesModel::clearingSubtree( DirInfo * subtree )
+{
+    removeResults( subtree, false );
+}
+
+
+void LocateFilesModel::clearing()
+{
+    clear();
+}
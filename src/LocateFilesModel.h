@@ -0,0 +1,133 @@
+/*
+ *   File name: LocateFilesModel.h
+ *   Summary:	Data model for the "locate files" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef LocateFilesModel_h
+#define LocateFilesModel_h
+
+
+#include <QAbstractTableModel>
+#include <QVector>
+
+#include "FileInfo.h"
+
+
+namespace QDirStat
+{
+    class DirInfo;
+    class DirTree;
+
+
+    /**
+     * Column numbers for the locate list
+     **/
+    enum LocateListColumns
+    {
+	LocateListSizeCol,
+	LocateListMTimeCol,
+	LocateListPathCol,
+	LocateListColumnCount
+    };
+
+
+    /**
+     * Table model for the search results of the LocateFilesWindow.
+     *
+     * This is only a vector of FileInfo pointers: Nothing is created for
+     * each result, and the path of a result (which is expensive to build)
+     * is only built when the view asks for it, i.e. only for the rows that
+     * are visible. Sorting sorts that vector in place.
+     *
+     * The model keeps track of the DirTree so it never holds pointers to
+     * items that are deleted: They are removed from the results when the
+     * DirTree announces it is about to delete them.
+     **/
+    class LocateFilesModel: public QAbstractTableModel
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	LocateFilesModel( QObject * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~LocateFilesModel();
+
+	/**
+	 * Set the results. All items are expected to be in 'tree'.
+	 **/
+	void setResults( const FileInfoList & results, DirTree * tree );
+
+	/**
+	 * Remove all results.
+	 **/
+	void clear() { setResults( FileInfoList(), 0 ); }
+
+	/**
+	 * Return the result in row 'row' or 0 if there is no such row.
+	 **/
+	FileInfo * itemAt( int row ) const;
+
+
+	// Mandatory methods inherited from QAbstractItemModel
+
+	virtual int rowCount   ( const QModelIndex & parent = QModelIndex() ) const Q_DECL_OVERRIDE;
+	virtual int columnCount( const QModelIndex & parent = QModelIndex() ) const Q_DECL_OVERRIDE;
+
+	virtual QVariant data( const QModelIndex & index, int role ) const Q_DECL_OVERRIDE;
+
+	virtual QVariant headerData( int	     section,
+				     Qt::Orientation orientation,
+				     int	     role ) const Q_DECL_OVERRIDE;
+
+	virtual void sort( int column, Qt::SortOrder order = Qt::AscendingOrder ) Q_DECL_OVERRIDE;
+
+
+    protected slots:
+
+	/**
+	 * Notifications from the DirTree.
+	 **/
+	void deletingChild( FileInfo * child );
+	void clearingSubtree( DirInfo * subtree );
+	void clearing();
+
+
+    protected:
+
+	/**
+	 * Remove all results that are in 'subtree', but not 'subtree'
+	 * itself unless 'includeSubtree' is 'true'.
+	 **/
+	void removeResults( FileInfo * subtree, bool includeSubtree );
+
+	/**
+	 * Move the persistent indexes (current item, selection) from the rows
+	 * in 'oldItems' to the rows of the same items in _items.
+	 **/
+	void updatePersistentIndexes( const QVector<FileInfo *> & oldItems );
+
+
+	//
+	// Data members
+	//
+
+	DirTree *	    _tree;
+	QVector<FileInfo *> _items;
+
+    };	// class LocateFilesModel
+
+}	// namespace QDirStat
+
+
+#endif	// LocateFilesModel_h
@@ -12,7 +12,11 @@
 #include "LocateFilesWindow.h"
 #include "QDirStatApp.h"        // SelectionModel, CleanupCollection
 #include "TreeWalker.h"
-#include "FileInfoIterator.h"
+#include "TreeWalkerRunner.h"
+#include "FileRangeIndex.h"
+#include "PkgQuery.h"
+#include "SystemFileChecker.h"
+#include "DirTree.h"
 #include "SelectionModel.h"
 #include "ActionManager.h"
 #include "CleanupCollection.h"
@@ -22,6 +26,12 @@
 #include "Logger.h"
 #include "Exception.h"
 
+
+// Maximum number of search results to look up the owning package for in
+// advance
+#define MAX_PKG_PREFETCH	1000
+
+
 using namespace QDirStat;
 
 
@@ -29,7 +39,11 @@ LocateFilesWindow::LocateFilesWindow( TreeWalker * treeWalker,
                                       QWidget    * parent ):
     QDialog( parent ),
     _ui( new Ui::LocateFilesWindow ),
+    _model( 0 ),
     _treeWalker( treeWalker ),
+    _runner( 0 ),
+    _pkgQuery( 0 ),
+    _tree( 0 ),
     _sortCol( LocateListPathCol ),
     _sortOrder( Qt::AscendingOrder )
 {
@@ -38,17 +52,26 @@ LocateFilesWindow::LocateFilesWindow( TreeWalker * treeWalker,
     CHECK_PTR( _treeWalker );
     CHECK_NEW( _ui );
     _ui->setupUi( this );
+
+    _model = new LocateFilesModel( this );
+    CHECK_NEW( _model );
+
+    _pkgQuery = new OwningPkgBatchQuery( this );
+    CHECK_NEW( _pkgQuery );
+
     initWidgets();
     readWindowSettings( this, "LocateFilesWindow" );
 
     connect( _ui->refreshButton, SIGNAL( clicked() ),
 	     this,		 SLOT  ( refresh() ) );
 
-    connect( _ui->treeWidget,	 SIGNAL( currentItemChanged( QTreeWidgetItem *,
-							     QTreeWidgetItem * ) ),
-	     this,		 SLOT  ( locateInMainWindow( QTreeWidgetItem * ) ) );
+    connect( _ui->stopButton,	 SIGNAL( clicked() ),
+	     this,		 SLOT  ( cancelSearch() ) );
+
+    connect( _ui->treeView->selectionModel(), SIGNAL( currentChanged    ( QModelIndex, QModelIndex ) ),
+	     this,				SLOT  ( locateInMainWindow( QModelIndex ) ) );
 
-    connect( _ui->treeWidget,    SIGNAL( customContextMenuRequested( const QPoint & ) ),
+    connect( _ui->treeView,      SIGNAL( customContextMenuRequested( const QPoint & ) ),
              this,               SLOT  ( itemContextMenu           ( const QPoint & ) ) );
 }
 
@@ -57,6 +80,7 @@ LocateFilesWindow::~LocateFilesWindow()
 {
     // logDebug() << "destroying" << endl;
 
+    cancelSearch();
     writeWindowSettings( this, "LocateFilesWindow" );
     delete _treeWalker;
     delete _ui;
@@ -65,7 +89,8 @@ LocateFilesWindow::~LocateFilesWindow()
 
 void LocateFilesWindow::clear()
 {
-    _ui->treeWidget->clear();
+    _model->clear();
+    _pkgQuery->cancel();
 }
 
 
@@ -73,6 +98,7 @@ void LocateFilesWindow::setTreeWalker( TreeWalker * newTreeWalker )
 {
     CHECK_PTR( newTreeWalker );
 
+    cancelSearch(); // The search thread might still be using the old one
     delete _treeWalker;
     _treeWalker = newTreeWalker;
 }
@@ -81,7 +107,6 @@ void LocateFilesWindow::setTreeWalker( TreeWalker * newTreeWalker )
 void LocateFilesWindow::refresh()
 {
     populate( _subtree() );
-    selectFirstItem();
 }
 
 
@@ -91,15 +116,12 @@ void LocateFilesWindow::initWidgets()
     font.setBold( true );
     _ui->heading->setFont( font );
 
-    _ui->treeWidget->setContextMenuPolicy( Qt::CustomContextMenu );
-    _ui->treeWidget->setColumnCount( LocateListColumnCount );
-    _ui->treeWidget->setHeaderLabels( QStringList()
-				      << tr( "Size" )
-				      << tr( "Last Modified" )
-				      << tr( "Path" )  );
-    _ui->treeWidget->header()->setStretchLastSection( false );
-    HeaderTweaker::resizeToContents( _ui->treeWidget->header() );
+    _ui->treeView->setModel( _model );
+    _ui->treeView->setContextMenuPolicy( Qt::CustomContextMenu );
+    _ui->treeView->header()->setStretchLastSection( false );
+    HeaderTweaker::resizeToContents( _ui->treeView->header() );
     addCleanupHotkeys();
+    updateSearchStatus();
 }
 
 
@@ -113,71 +135,167 @@ void LocateFilesWindow::populate( FileInfo * newSubtree )
 {
     // logDebug() << "populating with " << newSubtree << endl;
 
+    cancelSearch();
     clear();
     _subtree = newSubtree;
-    _treeWalker->prepare( _subtree() );
 
-    // For better Performance: Disable sorting while inserting many items
-    _ui->treeWidget->setSortingEnabled( false );
+    FileInfo * subtree = _subtree();
+
+    if ( ! subtree )
+	return;
+
+    connectTree( _subtree.tree() );
+
+    // Make sure the summary fields are up to date: The search thread must
+    // never trigger recalculating them while the view might do the same.
+    subtree->totalFiles();
+
+    if ( _treeWalker->prepareFromIndex( app()->fileRangeIndex(), subtree ) )
+    {
+	// No need to walk the tree
+
+	_model->setResults( *_treeWalker->results(), _tree );
+	_ui->treeView->sortByColumn( _sortCol, _sortOrder );
+	selectFirstItem();
+	updateSearchStatus();
+	prefetchOwningPkgs( *_treeWalker->results() );
+	return;
+    }
+
+    _runner = new TreeWalkerRunner( _treeWalker, subtree );
+    CHECK_NEW( _runner );
+
+    connect( _runner, SIGNAL( finished() ),
+	     this,    SLOT  ( searchFinished() ) );
 
-    populateRecursive( newSubtree ? newSubtree : _subtree() );
-    // logDebug() << "Results count: " << _ui->treeWidget->topLevelItemCount() << endl;
+    _runner->start();
+    updateSearchStatus();
+}
+
+
+void LocateFilesWindow::searchFinished()
+{
+    if ( ! _runner || sender() != _runner )
+	return; // Late signal from a search that was cancelled
+
+    if ( ! _runner->cancelled() )
+    {
+	// logDebug() << "Results count: " << _runner->results().size() << endl;
+
+	_model->setResults( _runner->results(), _tree );
+	_ui->treeView->sortByColumn( _sortCol, _sortOrder );
+	selectFirstItem();
+	prefetchOwningPkgs( _runner->results() );
+    }
 
-    _ui->treeWidget->setSortingEnabled( true );
-    _ui->treeWidget->sortByColumn( _sortCol, _sortOrder );
+    delete _runner;
+    _runner = 0;
+    updateSearchStatus();
 }
 
 
-void LocateFilesWindow::populateRecursive( FileInfo * dir )
+void LocateFilesWindow::cancelSearch()
 {
-    if ( ! dir )
+    if ( ! _runner )
 	return;
 
-    FileInfoIterator it( dir );
+    logDebug() << "Cancelling search" << endl;
 
-    while ( *it )
-    {
-	FileInfo * item = *it;
+    // Deleting the runner cancels it and waits until it is stopped. A
+    // finished() signal that might still be queued is ignored in
+    // searchFinished() because of the sender() check.
 
-        if ( _treeWalker->check( item ) )
-        {
-            LocateListItem * locateListItem =
-                new LocateListItem( item->url(), item->size(), item->mtime() );
-            CHECK_NEW( locateListItem );
+    delete _runner;
+    _runner = 0;
+    updateSearchStatus();
+}
 
-            _ui->treeWidget->addTopLevelItem( locateListItem );
-        }
 
-	if ( item->hasChildren() )
-	{
-	    populateRecursive( item );
-	}
+void LocateFilesWindow::connectTree( DirTree * tree )
+{
+    if ( tree == _tree )
+	return;
+
+    if ( _tree )
+	disconnect( _tree, 0, this, 0 );
+
+    _tree = tree;
+
+    if ( ! _tree )
+	return;
+
+    // The search thread must never see the tree while it changes. The
+    // DirTree sends those signals before it changes anything, and they are
+    // delivered directly since the DirTree lives in this thread.
 
-        ++it;
+    connect( _tree, SIGNAL( deletingChild  ( FileInfo * ) ),
+	     this,  SLOT  ( cancelSearch() ) );
+
+    connect( _tree, SIGNAL( clearingSubtree( DirInfo * ) ),
+	     this,  SLOT  ( cancelSearch() ) );
+
+    connect( _tree, SIGNAL( clearing() ),
+	     this,  SLOT  ( cancelSearch() ) );
+
+    connect( _tree, SIGNAL( startingReading() ),
+	     this,  SLOT  ( cancelSearch() ) );
+}
+
+
+void LocateFilesWindow::updateSearchStatus()
+{
+    bool searching = _runner != 0;
+
+    _ui->stopButton->setEnabled( searching );
+    _ui->refreshButton->setEnabled( ! searching );
+
+    if ( searching )
+	setCursor( Qt::BusyCursor );
+    else
+	unsetCursor();
+}
+
+
+void LocateFilesWindow::prefetchOwningPkgs( const FileInfoList & results )
+{
+    if ( ! PkgQuery::foundSupportedPkgManager() )
+	return;
+
+    QStringList paths;
+
+    foreach ( FileInfo * item, results )
+    {
+	if ( paths.size() >= MAX_PKG_PREFETCH )
+	    break;
+
+	if ( ! item->pkgInfoParent() && SystemFileChecker::isSystemFile( item ) )
+	    paths << item->url();
     }
+
+    if ( ! paths.isEmpty() )
+	_pkgQuery->request( paths );
 }
 
 
 void LocateFilesWindow::selectFirstItem()
 {
-    QTreeWidgetItem * firstItem = _ui->treeWidget->topLevelItem( 0 );
+    QModelIndex firstIndex = _model->index( 0, 0 );
 
-    if ( firstItem )
-        _ui->treeWidget->setCurrentItem( firstItem );
+    if ( firstIndex.isValid() )
+        _ui->treeView->setCurrentIndex( firstIndex );
 }
 
 
-void LocateFilesWindow::locateInMainWindow( QTreeWidgetItem * item )
+void LocateFilesWindow::locateInMainWindow( const QModelIndex & index )
 {
+    FileInfo * item = _model->itemAt( index.row() );
+
     if ( ! item )
 	return;
 
-    LocateListItem * searchResult = dynamic_cast<LocateListItem *>( item );
-    CHECK_DYNAMIC_CAST( searchResult, "LocateListItem" );
-    CHECK_PTR( _subtree.tree() );
-
-    // logDebug() << "Locating " << searchResult->path() << " in tree" << endl;
-    app()->selectionModel()->setCurrentItem( searchResult->path() );
+    // logDebug() << "Locating " << item << " in tree" << endl;
+    app()->selectionModel()->setCurrentItem( item,
+                                             true ); // select
 }
 
 
@@ -200,7 +318,7 @@ void LocateFilesWindow::itemContextMenu( const QPoint & pos )
         }
     }
 
-    menu.exec( _ui->treeWidget->mapToGlobal( pos ) );
+    menu.exec( _ui->treeView->mapToGlobal( pos ) );
 }
 
 
@@ -233,46 +351,6 @@ void LocateFilesWindow::sortByColumn( int col, Qt::SortOrder order )
     _sortCol   = col;
     _sortOrder = order;
 
-    _ui->treeWidget->sortByColumn( _sortCol, _sortOrder );
+    _ui->treeView->sortByColumn( _sortCol, _sortOrder );
     selectFirstItem();
 }
-
-
-
-
-LocateListItem::LocateListItem( const QString & path,
-                                FileSize	size,
-                                time_t          mtime ):
-    QTreeWidgetItem( QTreeWidgetItem::UserType ),
-    _path( path ),
-    _size( size ),
-    _mtime( mtime )
-{
-    setText( LocateListSizeCol,	 formatSize( _size )  + " " );
-    setText( LocateListMTimeCol, formatTime( _mtime ) + " " );
-    setText( LocateListPathCol,	 path                 + " " );
-
-    setTextAlignment( LocateListSizeCol,	 Qt::AlignRight );
-    setTextAlignment( LocateListMTimeCol,	 Qt::AlignLeft  );
-    setTextAlignment( LocateListPathCol,	 Qt::AlignLeft	);
-}
-
-
-bool LocateListItem::operator<( const QTreeWidgetItem & rawOther ) const
-{
-    // Since this is a reference, the dynamic_cast will throw a std::bad_cast
-    // exception if it fails. Not catching this here since this is a genuine
-    // error which should not be silently ignored.
-    const LocateListItem & other = dynamic_cast<const LocateListItem &>( rawOther );
-
-    int col = treeWidget() ? treeWidget()->sortColumn() : LocateListPathCol;
-
-    switch ( col )
-    {
-	case LocateListPathCol:  return path()  < other.path();
-	case LocateListSizeCol:  return size()  < other.size();
-	case LocateListMTimeCol: return mtime() < other.mtime();
-	default:	         return QTreeWidgetItem::operator<( rawOther );
-    }
-}
-
@@ -11,16 +11,20 @@
 #define LocateFilesWindow_h
 
 #include <QDialog>
-#include <QTreeWidgetItem>
+#include <QModelIndex>
 
 #include "ui_locate-files-window.h"
 #include "FileInfo.h"
+#include "LocateFilesModel.h"
 #include "Subtree.h"
 
 
 namespace QDirStat
 {
     class TreeWalker;
+    class TreeWalkerRunner;
+    class DirTree;
+    class OwningPkgBatchQuery;
 
 
     /**
@@ -33,6 +37,14 @@ namespace QDirStat
      *
      * As a next step, the user can then start cleanup actions on those files
      * from the main window - in the tree view or in the treemap view.
+     *
+     * The results are kept in a LocateFilesModel, so even a very large
+     * number of results is cheap: Only the rows that are visible are ever
+     * formatted.
+     *
+     * The search runs in a TreeWalkerRunner thread so the user interface
+     * remains responsive even for very large trees. It is cancelled before
+     * the tree changes in any way.
      **/
     class LocateFilesWindow: public QDialog
     {
@@ -94,12 +106,19 @@ namespace QDirStat
 	 * Populate the window: Use the TreeWalker to find matching tree items
 	 * in 'subtree'.
 	 *
-	 * This clears the old search results first, then searches the subtree
-	 * and populates the search result list with the items where
+	 * This clears the old search results first, then starts searching
+	 * the subtree in a separate thread. When that is finished, the
+	 * search result list is populated with the items where
 	 * TreeWalker::check() returns 'true'.
 	 **/
 	void populate( FileInfo * subtree = 0 );
 
+	/**
+	 * Cancel a running search (if there is one) and wait until it is
+	 * stopped.
+	 **/
+	void cancelSearch();
+
 	/**
 	 * Refresh (reload) all data.
 	 **/
@@ -121,13 +140,18 @@ namespace QDirStat
 	 * Locate one of the items in this list results in the main window's
 	 * tree and treemap widgets via their SelectionModel.
 	 **/
-	void locateInMainWindow( QTreeWidgetItem * item );
+	void locateInMainWindow( const QModelIndex & index );
 
         /**
          * Open a context menu for an item in the results list.
          **/
         void itemContextMenu( const QPoint & pos );
 
+	/**
+	 * Notification that the search thread is finished.
+	 **/
+	void searchFinished();
+
 
     protected:
 
@@ -154,10 +178,22 @@ namespace QDirStat
         void addCleanupHotkeys();
 
 	/**
-	 * Recursively locate directories that contain files matching the
-	 * search suffix and create a search result item for each one.
+	 * Connect to the tree's signals to cancel the search before anything
+	 * in the tree changes.
 	 **/
-	void populateRecursive( FileInfo * dir );
+	void connectTree( DirTree * tree );
+
+	/**
+	 * Update the widgets for a running or stopped search.
+	 **/
+	void updateSearchStatus();
+
+	/**
+	 * Start looking up the owning packages of the system files among
+	 * 'results' in the background, so they are already known when the
+	 * user selects one of them and the details view shows it.
+	 **/
+	void prefetchOwningPkgs( const FileInfoList & results );
 
 
 	//
@@ -165,74 +201,17 @@ namespace QDirStat
 	//
 
 	Ui::LocateFilesWindow * _ui;
+        LocateFilesModel *      _model;
         TreeWalker *            _treeWalker;
+        TreeWalkerRunner *      _runner;
+        OwningPkgBatchQuery *   _pkgQuery;
+        DirTree *               _tree;
         Subtree                 _subtree;
         int                     _sortCol;
         Qt::SortOrder           _sortOrder;
     };
 
 
-    /**
-     * Column numbers for the file type tree widget
-     **/
-    enum LocateListColumns
-    {
-	LocateListSizeCol,
-        LocateListMTimeCol,
-        LocateListPathCol,
-        LocateListColumnCount
-    };
-
-
-    /**
-     * Item class for the locate list (which is really a tree widget),
-     * representing one file with its path.
-     *
-     * Notice that this item intentionally does not store a FileInfo pointer
-     * for each search result, but its path. This is more expensive to store,
-     * and the corresponding DirInfo * has to be fetched again with
-     * DirTree::locate() (which is an expensive operation), but it is a lot
-     * safer in case the tree is modified, i.e. if the user starts cleanup
-     * operations or refreshes the tree from disk: Not only are no pointers
-     * stored that might become invalid, but the search result remains valid
-     * even after such an operation since the strings (the paths) will still
-     * match an object in the tree in most cases.
-     *
-     * In the worst case, the search result won't find the corresponding
-     * FileInfo * anymore (if that directory branch was deleted), but for sure
-     * it will not crash.
-     **/
-    class LocateListItem: public QTreeWidgetItem
-    {
-    public:
-
-	/**
-	 * Constructor.
-	 **/
-	LocateListItem( const QString & path,
-                        FileSize	size,
-                        time_t          mtime );
-
-	//
-	// Getters
-	//
-
-	QString	 path()         const { return _path;  }
-	FileSize size()         const { return _size;  }
-	time_t   mtime()        const { return _mtime; }
-
-	/**
-	 * Less-than operator for sorting.
-	 **/
-	virtual bool operator<( const QTreeWidgetItem & other ) const Q_DECL_OVERRIDE;
-
-    protected:
-
-	QString		_path;
-	FileSize	_size;
-        time_t          _mtime;
-    };
-
 } // namespace QDirStat
 
 
@@ -13,6 +13,12 @@
 #include <QFile>
 #include <QDir>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QIODevice>
+#include <QHash>
+#include <QPair>
+#include <QAtomicPointer>
 #include <QString>
 #include <QRectF>
 #include <QPointF>
@@ -30,6 +36,11 @@
 
 #define VERBOSE_ROTATE 0
 
+#define LOG_RATE_LIMIT		100	// Lines per location per second
+#define LOG_RATE_WINDOW_MSEC	1000
+#define LOG_WRITER_IDLE_MSEC	20	// Sleep time of the writer thread when idle
+#define LOG_FLUSH_TIMEOUT_MSEC	1000
+
 
 static LogSeverity toLogSeverity( QtMsgType msgType );
 
@@ -42,15 +53,206 @@ static void qt_logger( QtMsgType msgType,
 #endif
 
 
+/**
+ * One chunk of log output in the LogQueue.
+ **/
+struct LogQueueNode
+{
+    LogQueueNode( const QByteArray & data = QByteArray() ):
+	data( data ),
+	next( 0 )
+	{}
+
+    QByteArray			 data;
+    QAtomicPointer<LogQueueNode> next;
+};
+
+
+/**
+ * Lock-free queue with any number of producers (the threads that log) and
+ * one consumer (the writer thread).
+ *
+ * The head is where new nodes are added; the tail is a dummy node whose
+ * successor is the first node with any data. A producer that was
+ * interrupted between taking the head and linking its node to the old head
+ * only makes the consumer stop early; it will pick up that node next time.
+ **/
+class LogQueue
+{
+public:
+
+    LogQueue():
+	_head( new LogQueueNode() ),
+	_tail( _head.load() )
+	{}
+
+    ~LogQueue()
+    {
+	QByteArray data;
+
+	while ( take( data ) )
+	    ;
+
+	delete _tail;
+    }
+
+    void add( const QByteArray & data )
+    {
+	LogQueueNode * node = new LogQueueNode( data );
+	LogQueueNode * prev = _head.fetchAndStoreOrdered( node );
+	prev->next.storeRelease( node );
+    }
+
+    // Only for the consumer
+    bool take( QByteArray & data_ret )
+    {
+	LogQueueNode * next = _tail->next.loadAcquire();
+
+	if ( ! next )
+	    return false;
+
+	data_ret = next->data;
+	next->data.clear();	// 'next' is the new dummy node
+	delete _tail;
+	_tail = next;
+
+	return true;
+    }
+
+private:
+
+    QAtomicPointer<LogQueueNode> _head;
+    LogQueueNode *		 _tail;
+};
+
+
+/**
+ * Device for the QTextStream of each thread: Put everything that is written
+ * to it (typically one log line when the stream is flushed with 'endl')
+ * into the logger's queue.
+ **/
+class LogQueueDevice: public QIODevice
+{
+public:
+
+    LogQueueDevice( Logger * logger ):
+	_logger( logger )
+    {
+	open( QIODevice::WriteOnly );
+    }
+
+    virtual bool isSequential() const Q_DECL_OVERRIDE { return true; }
+
+protected:
+
+    virtual qint64 readData( char *, qint64 ) Q_DECL_OVERRIDE { return -1; }
+
+    virtual qint64 writeData( const char * data, qint64 len ) Q_DECL_OVERRIDE
+    {
+	_logger->enqueue( QByteArray( data, len ) );
+	return len;
+    }
+
+    Logger * _logger;
+};
+
+
+/**
+ * Device to suppress output below the log level: Since each operator<<()
+ * for QTextStream returns the QTextStream, something has to take the
+ * output; unlike /dev/null, this does not cost a system call per line.
+ **/
+class LogNullDevice: public QIODevice
+{
+public:
+
+    LogNullDevice() { open( QIODevice::WriteOnly ); }
+
+    virtual bool isSequential() const Q_DECL_OVERRIDE { return true; }
+
+protected:
+
+    virtual qint64 readData( char *, qint64 ) Q_DECL_OVERRIDE { return -1; }
+    virtual qint64 writeData( const char *, qint64 len ) Q_DECL_OVERRIDE { return len; }
+};
+
+
+/**
+ * Rate limit counters for one location in the source code.
+ **/
+struct LogSite
+{
+    LogSite(): windowStart( -1 ), count( 0 ), suppressed( 0 ) {}
+
+    qint64 windowStart;
+    int	   count;
+    int	   suppressed;
+};
+
+
+/**
+ * Everything a logger needs for each thread.
+ **/
+struct LogThreadData
+{
+    LogThreadData( Logger * logger ):
+	device( logger ),
+	stream( &device ),
+	nullStream( &nullDevice )
+    {
+	timer.start();
+    }
+
+    LogQueueDevice			device;
+    QTextStream				stream;
+    LogNullDevice			nullDevice;
+    QTextStream				nullStream;
+    QHash<QPair<QString, int>, LogSite> sites;
+    QElapsedTimer			timer;
+};
+
+
+/**
+ * Background thread that writes the log queue to the log file.
+ **/
+class LogWriter: public QThread
+{
+public:
+
+    LogWriter( Logger * logger ):
+	QThread(),
+	_logger( logger ),
+	_stop( 0 )
+	{}
+
+    void stop() { _stop.storeRelease( 1 ); }
+
+protected:
+
+    virtual void run() Q_DECL_OVERRIDE
+    {
+	while ( ! _stop.loadAcquire() )
+	{
+	    if ( ! _logger->writeQueue() )
+		msleep( LOG_WRITER_IDLE_MSEC );
+	}
+
+	_logger->writeQueue();
+    }
+
+    Logger *   _logger;
+    QAtomicInt _stop;
+};
+
+
+
+
 Logger * Logger::_defaultLogger = 0;
 
 
-Logger::Logger( const QString &filename ):
-    _logStream( stderr, QIODevice::WriteOnly ),
-    _nullStream( stderr, QIODevice::WriteOnly )
+Logger::Logger( const QString &filename )
 {
     init();
-    createNullStream();
     openLogFile( filename );
 }
 
@@ -58,12 +260,9 @@ Logger::Logger( const QString &filename ):
 Logger::Logger( const QString & rawLogDir,
 		const QString & rawFilename,
 		bool		doRotate,
-		int		logRotateCount ):
-    _logStream( stderr, QIODevice::WriteOnly ),
-    _nullStream( stderr, QIODevice::WriteOnly )
+		int		logRotateCount )
 {
     init();
-    createNullStream();
 
     QString logDir   = expandVariables( rawLogDir   );
     QString filename = expandVariables( rawFilename );
@@ -80,10 +279,18 @@ Logger::Logger( const QString & rawLogDir,
 Logger::~Logger()
 {
     if ( _logFile.isOpen() )
-    {
-	logInfo() << "-- Log End --\n" << endl;
+	log( __FILE__, __LINE__, __FUNCTION__, LogSeverityInfo ) << "-- Log End --\n" << endl;
+
+    _writer->stop();
+    _writer->wait();
+    delete _writer;
+
+    if ( _logFile.isOpen() )
 	_logFile.close();
-    }
+
+    // Don't leave a dangling pointer in this thread's stream device
+    _threadData.setLocalData( 0 );
+    delete _queue;
 
     if ( this == _defaultLogger )
     {
@@ -100,27 +307,9 @@ Logger::~Logger()
 void Logger::init()
 {
     _logLevel = LogSeverityVerbose;
-    _nullDevice.setFileName( "/dev/null" );
-}
-
-
-void Logger::createNullStream()
-{
-    // Open the null device to suppress output below the log level: This is
-    // necessary because each call to operator<<() for QTextStream returns the
-    // QTextStream, so we really need to return _nullStream (connected with
-    // /dev/null) to actually suppress anything; otherwise, it's just the
-    // logger time stamp etc. that gets suppressed, not the real logging
-    // output.
-
-    if ( _nullDevice.open( QIODevice::WriteOnly | QIODevice::Text ) )
-    {
-	_nullStream.setDevice( &_nullDevice );
-    }
-    else
-    {
-	fprintf( stderr, "ERROR: Can't open /dev/null to suppress log output\n" );
-    }
+    _pid      = (int) getpid();
+    _queue    = new LogQueue();
+    _writer   = new LogWriter( this );
 }
 
 
@@ -138,16 +327,94 @@ void Logger::openLogFile( const QString & filename )
 		setDefaultLogger();
 
 	    fprintf( stderr, "Logging to %s\n", qPrintable( filename ) );
-	    _logStream.setDevice( &_logFile );
-	    _logStream << "\n\n";
+	    enqueue( "\n\n" );
 	    log( __FILE__, __LINE__, __FUNCTION__, LogSeverityInfo )
 		<< "-- Log Start --" << endl;
 	}
 	else
 	{
 	    fprintf( stderr, "ERROR: Can't open log file %s\n", qPrintable( filename ) );
+
+	    // Log to stderr instead
+	    _logFile.open( stderr, QIODevice::WriteOnly | QIODevice::Text );
 	}
     }
+
+    if ( ! _writer->isRunning() )
+	_writer->start( QThread::LowPriority );
+}
+
+
+LogThreadData * Logger::threadData()
+{
+    LogThreadData * data = _threadData.localData();
+
+    if ( ! data )
+    {
+	data = new LogThreadData( this );
+	_threadData.setLocalData( data );
+    }
+
+    return data;
+}
+
+
+QTextStream & Logger::logStream()
+{
+    return threadData()->stream;
+}
+
+
+void Logger::enqueue( const QByteArray & data )
+{
+    _queue->add( data );
+    _enqueued.ref();
+}
+
+
+bool Logger::writeQueue()
+{
+    QByteArray data;
+    int count = 0;
+
+    while ( _queue->take( data ) )
+    {
+	_logFile.write( data );
+	++count;
+    }
+
+    if ( count == 0 )
+	return false;
+
+    _logFile.flush();
+    _written.fetchAndAddOrdered( count );
+
+    return true;
+}
+
+
+void Logger::flush()
+{
+    threadData()->stream.flush();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while ( _written.loadAcquire() != _enqueued.loadAcquire() &&
+	    timer.elapsed() < LOG_FLUSH_TIMEOUT_MSEC )
+    {
+	QThread::msleep( 1 );
+    }
+}
+
+
+void Logger::flush( Logger * logger )
+{
+    if ( ! logger )
+	logger = Logger::defaultLogger();
+
+    if ( logger )
+	logger->flush();
 }
 
 
@@ -185,9 +452,65 @@ QTextStream & Logger::log( const QString &srcFile,
 			   const QString &srcFunction,
 			   LogSeverity	  severity )
 {
+    LogThreadData * data = threadData();
+
     if ( severity < _logLevel )
-	return _nullStream;
+	return data->nullStream;
+
+    int suppressed = 0;
+
+    if ( rateLimited( data, srcFile, srcLine, suppressed ) )
+	return data->nullStream;
+
+    if ( suppressed > 0 )
+    {
+	writePrefix( data->stream, srcFile, srcLine, srcFunction, LogSeverityWarning );
+	data->stream << "(Suppressed " << suppressed << " more lines from here)" << endl;
+    }
 
+    writePrefix( data->stream, srcFile, srcLine, srcFunction, severity );
+
+    return data->stream;
+}
+
+
+bool Logger::rateLimited( LogThreadData * data,
+			  const QString & srcFile,
+			  int		  srcLine,
+			  int &		  suppressed_ret )
+{
+    suppressed_ret = 0;
+
+    if ( srcLine <= 0 ) // Qt messages etc.
+	return false;
+
+    LogSite & site = data->sites[ qMakePair( srcFile, srcLine ) ];
+    qint64    now  = data->timer.elapsed();
+
+    if ( site.windowStart < 0 || now - site.windowStart >= LOG_RATE_WINDOW_MSEC )
+    {
+	suppressed_ret	 = site.suppressed;
+	site.windowStart = now;
+	site.count	 = 0;
+	site.suppressed	 = 0;
+    }
+
+    if ( ++site.count > LOG_RATE_LIMIT )
+    {
+	++site.suppressed;
+	return true;
+    }
+
+    return false;
+}
+
+
+void Logger::writePrefix( QTextStream & stream,
+			  const QString & srcFile,
+			  int		  srcLine,
+			  const QString & srcFunction,
+			  LogSeverity	  severity )
+{
     QString sev;
 
     switch ( severity )
@@ -201,24 +524,22 @@ QTextStream & Logger::log( const QString &srcFile,
 	    // complain about unhandled enum values
     }
 
-    _logStream << Logger::timeStamp() << " "
-	       << "[" << (int) getpid() << "] "
-	       << sev << " ";
+    stream << Logger::timeStamp() << " "
+	   << "[" << _pid << "] "
+	   << sev << " ";
 
     if ( ! srcFile.isEmpty() )
     {
-	_logStream << srcFile;
+	stream << srcFile;
 
 	if ( srcLine > 0 )
-	    _logStream << ":" << srcLine;
+	    stream << ":" << srcLine;
 
-	_logStream << " ";
+	stream << " ";
 
 	if ( ! srcFunction.isEmpty() )
-	_logStream << srcFunction << "():  ";
+	stream << srcFunction << "():  ";
     }
-
-    return _logStream;
 }
 
 
@@ -256,7 +577,7 @@ void Logger::setLogLevel( Logger *logger, LogSeverity newLevel )
 
 void Logger::newline()
 {
-    _logStream << endl;
+    threadData()->stream << endl;
 }
 
 
@@ -318,6 +639,7 @@ static void qt_logger( QtMsgType msgType, const char *msg)
     if ( msgType == QtFatalMsg )
     {
 	fprintf( stderr, "FATAL: %s\n", msg );
+	Logger::flush( 0 );
 	abort();
     }
 
@@ -325,6 +647,7 @@ static void qt_logger( QtMsgType msgType, const char *msg)
 	 QString( msg ).contains( "cannot connect to X server" ) )
     {
 	fprintf( stderr, "FATAL: %s\n", msg );
+	Logger::flush( 0 );
 	exit( 1 );
     }
 }
@@ -411,12 +734,14 @@ static void qt_logger( QtMsgType msgType,
             }
 
             logInfo() << "-- Exiting --\n" << endl;
+            Logger::flush( 0 );
 	    exit( 1 ); // Don't dump core, just exit
         }
 	else
         {
             fprintf( stderr, "FATAL: %s\n", qPrintable( msg ) );
             logInfo() << "-- Aborting with core dump --\n" << endl;
+            Logger::flush( 0 );
 	    abort(); // Exit with core dump (it might contain a useful backtrace)
         }
     }
@@ -14,6 +14,8 @@
 #include <QStringList>
 #include <QFile>
 #include <QTextStream>
+#include <QAtomicInt>
+#include <QThreadStorage>
 
 
 // Intentionally not using LogDebug, LogMilestone etc. to avoid confusion
@@ -33,6 +35,18 @@ enum LogSeverity
 };
 
 
+// Compile-time log level: Log statements below this severity are compiled
+// to nothing, so not even their arguments are evaluated. Build with e.g.
+//
+//     DEFINES += LOG_MIN_SEVERITY=LogSeverityInfo
+//
+// to strip all verbose and debug logging.
+
+#ifndef LOG_MIN_SEVERITY
+#  define LOG_MIN_SEVERITY	LogSeverityVerbose
+#endif
+
+
 // Log macros for stream (QTextStream) output.
 //
 // Unlike qDebug() etc., they also record the location in the source code that
@@ -40,15 +54,28 @@ enum LogSeverity
 //
 // These macros all use the default logger. Create similar macros to use your
 // own class-specific logger.
-
-#define logVerbose()	Logger::log( 0, __FILE__, __LINE__, __FUNCTION__, LogSeverityVerbose   )
-#define logDebug()	Logger::log( 0, __FILE__, __LINE__, __FUNCTION__, LogSeverityDebug     )
-#define logInfo()	Logger::log( 0, __FILE__, __LINE__, __FUNCTION__, LogSeverityInfo      )
-#define logWarning()	Logger::log( 0, __FILE__, __LINE__, __FUNCTION__, LogSeverityWarning   )
-#define logError()	Logger::log( 0, __FILE__, __LINE__, __FUNCTION__, LogSeverityError     )
+//
+// They can only be used as a statement of their own: "if / else" is what
+// makes the compile-time log level work (without any "dangling else"
+// problems in the calling code).
+
+#define LOG_STREAM( SEVERITY )						\
+    if ( (SEVERITY) < LOG_MIN_SEVERITY ) {} else			\
+	Logger::log( 0, __FILE__, __LINE__, __FUNCTION__, (SEVERITY) )
+
+#define logVerbose()	LOG_STREAM( LogSeverityVerbose )
+#define logDebug()	LOG_STREAM( LogSeverityDebug   )
+#define logInfo()	LOG_STREAM( LogSeverityInfo    )
+#define logWarning()	LOG_STREAM( LogSeverityWarning )
+#define logError()	LOG_STREAM( LogSeverityError   )
 #define logNewline()	Logger::newline( 0 )
 
 
+class LogQueue;
+class LogWriter;
+struct LogThreadData;
+
+
 /**
  * Logging class. Use one of the macros above for stream output:
  *
@@ -61,6 +88,17 @@ enum LogSeverity
  * QByteArray, int).
  *
  * This class also redirects Qt logging (qDebug() etc.) to the same log file.
+ *
+ * Logging is asynchronous: Each thread has its own QTextStream; each log line
+ * (terminated with 'endl') is put into a lock-free queue, and a background
+ * thread writes the queue to the log file. So logging is safe from any
+ * thread, and it does not block on disk I/O.
+ *
+ * To keep a flood of messages from one place (e.g. a warning for each of
+ * millions of unreadable directories) from drowning everything else, each
+ * location in the source code may only log LOG_RATE_LIMIT lines per second
+ * in each thread; the number of suppressed lines is logged with the next
+ * line from there that is not suppressed.
  */
 class Logger
 {
@@ -123,6 +161,14 @@ public:
     void newline();
     static void newline( Logger * logger );
 
+    /**
+     * Wait until everything that was logged so far is written to the log
+     * file (but not longer than a second). Use this before exiting the
+     * program without destroying the logger, e.g. with abort().
+     */
+    void flush();
+    static void flush( Logger * logger );
+
     /**
      * Return a timestamp string in the format used in the log file:
      * "yyyy-MM-dd hh:mm:ss.zzz"
@@ -159,9 +205,10 @@ public:
     static Logger * defaultLogger() { return _defaultLogger; }
 
     /**
-     * Return the QTextStream associated with this logger. Not for general use.
+     * Return the QTextStream associated with this logger for the current
+     * thread. Not for general use.
      */
-    QTextStream & logStream() { return _logStream; }
+    QTextStream & logStream();
 
     /**
      * Return the current log level, i.e. the severity that will actually be
@@ -178,6 +225,8 @@ public:
      *
      * if ( logLevel() >= LogSeverityDebug )
      *	   logDebug() ...
+     *
+     * or set LOG_MIN_SEVERITY at compile time.
      */
     LogSeverity logLevel() const { return _logLevel; }
 
@@ -223,15 +272,36 @@ protected:
     void init();
 
     /**
-     * Create the null log stream to suppress messages below the current log
-     * level.
+     * Actually open the log file and start the writer thread.
+     **/
+    void openLogFile( const QString & filename );
+
+    /**
+     * Return the log streams etc. of the current thread. Create them if
+     * they don't exist yet.
      **/
-    void createNullStream();
+    LogThreadData * threadData();
 
     /**
-     * Actually open the log file.
+     * Write the log line prefix (time stamp, PID, severity, source
+     * location) to 'stream'.
      **/
-    void openLogFile( const QString & filename );
+    void writePrefix( QTextStream & stream,
+		      const QString & srcFile,
+		      int	      srcLine,
+		      const QString & srcFunction,
+		      LogSeverity     severity );
+
+    /**
+     * Check the rate limit for the location 'srcFile':'srcLine'. Return
+     * 'true' if the line should be suppressed. Return the number of lines
+     * that were suppressed since the last one that was not suppressed in
+     * 'suppressed_ret'.
+     **/
+    bool rateLimited( LogThreadData * data,
+		      const QString & srcFile,
+		      int	      srcLine,
+		      int &	      suppressed_ret );
 
     /**
      * Create log directory 'logDir' and return the name of the directory
@@ -261,14 +331,33 @@ protected:
     static QString oldNamePattern( const QString & filename );
 
 
+public:
+
+    // For the per-thread log devices and the writer thread
+
+    /**
+     * Add one chunk of log output to the queue.
+     **/
+    void enqueue( const QByteArray & data );
+
+    /**
+     * Write everything in the queue to the log file. Return 'true' if there
+     * was anything to write. This is only called in the writer thread.
+     **/
+    bool writeQueue();
+
+
 private:
 
-    static Logger * _defaultLogger;
-    QFile	    _logFile;
-    QTextStream	    _logStream;
-    QFile	    _nullDevice;
-    QTextStream	    _nullStream;
-    LogSeverity	    _logLevel;
+    static Logger *		    _defaultLogger;
+    QFile			    _logFile;
+    LogSeverity			    _logLevel;
+    int				    _pid;
+    LogQueue *			    _queue;
+    LogWriter *			    _writer;
+    QAtomicInt			    _enqueued;
+    QAtomicInt			    _written;
+    QThreadStorage<LogThreadData *> _threadData;
 };
 
 
@@ -21,6 +21,8 @@
 #include "ConfigDialog.h"
 #include "DataColumns.h"
 #include "DebugHelpers.h"
+#include "DirListWindow.h"
+#include "DirReadJob.h"
 #include "DirTree.h"
 #include "DirTreeCache.h"
 #include "DirTreeModel.h"
@@ -38,12 +40,16 @@
 #include "PkgManager.h"
 #include "PkgQuery.h"
 #include "QDirStatApp.h"
-#include "Refresher.h"
+#include "ReadStatsView.h"
 #include "SelectionModel.h"
+#include "SessionSnapshot.h"
 #include "Settings.h"
 #include "SettingsHelpers.h"
+#include "StallWatchdog.h"
 #include "SysUtil.h"
-#include "Trash.h"
+#include "TrashJob.h"
+#include "TreeExporter.h"
+#include "TreePatcher.h"
 #include "UnreadableDirsWindow.h"
 #include "Version.h"
 
@@ -63,9 +69,15 @@ MainWindow::MainWindow():
     _verboseSelection( false ),
     _urlInWindowTitle( false ),
     _useTreemapHover( false ),
+    _restoreSession( false ),
+    _verifySession( false ),
+    _sessionSnapshotMinutes( 0 ),
+    _sessionGeneration( 0 ),
     _statusBarTimeout( 3000 ), // millisec
     _treeLevelMapper(0),
-    _currentLayout( 0 )
+    _currentLayout( 0 ),
+    _memoryLabel( 0 ),
+    _unpkgThread( 0 )
 {
     CHECK_PTR( _ui );
 
@@ -76,15 +88,29 @@ MainWindow::MainWindow():
     readSettings();
     _updateTimer.setInterval( UPDATE_MILLISEC );
     _treeExpandTimer.setSingleShot( true );
+
+    if ( _restoreSession && _sessionSnapshotMinutes > 0 )
+    {
+	connect( &_sessionTimer, SIGNAL( timeout()		     ),
+		 this,		 SLOT  ( saveSessionInBackground() ) );
+
+	_sessionTimer.start( _sessionSnapshotMinutes * 60 * 1000 );
+    }
     _dUrl = _ui->actionDonate->iconText();
     _futureSelection.setUseRootFallback( false );
     _ui->menubar->setCornerWidget( new QLabel( MENUBAR_VERSION ) );
 
+    _memoryLabel = new QLabel( this );
+    CHECK_NEW( _memoryLabel );
+    _memoryLabel->hide();
+    _ui->statusBar->addPermanentWidget( _memoryLabel );
+
     // The first call to app() creates the QDirStatApp and with it
     // - the DirTreeModel
     // - the DirTree (owned and managed by the DirTreeModel)
-    // - the SelectionModel
-    // - the CleanupCollection.
+    // - the SelectionModel.
+    //
+    // The CleanupCollection is only created in initCleanups().
 
     _ui->dirTreeView->setModel( app()->dirTreeModel() );
     _ui->dirTreeView->setSelectionModel( app()->selectionModel() );
@@ -92,14 +118,7 @@ MainWindow::MainWindow():
     _ui->treemapView->setDirTree( app()->dirTree() );
     _ui->treemapView->setSelectionModel( app()->selectionModel() );
 
-    app()->cleanupCollection()->addToMenu   ( _ui->menuCleanup,
-                                              true ); // keepUpdated
-    app()->cleanupCollection()->addToToolBar( _ui->toolBar,
-                                              true ); // keepUpdated
-
-
-    _ui->dirTreeView->setCleanupCollection( app()->cleanupCollection() );
-    _ui->treemapView->setCleanupCollection( app()->cleanupCollection() );
+    QTimer::singleShot( 0, this, SLOT( initCleanups() ) );
 
     _ui->breadcrumbNavigator->clear();
 
@@ -127,6 +146,8 @@ MainWindow::MainWindow():
 
     toggleVerboseSelection();
     updateActions();
+
+    StallWatchdog::instance()->start();
 }
 
 
@@ -137,9 +158,13 @@ MainWindow::~MainWindow()
     if ( _currentLayout )
 	saveLayout( _currentLayout );   // see MainWindowLayout.cpp
 
+    if ( _restoreSession )
+	SessionSnapshot::save( app()->dirTree() );
+
     writeSettings();
     ExcludeRules::instance()->writeSettings();
     MimeCategorizer::instance()->writeSettings();
+    StallWatchdog::instance()->writeSettings();
 
     // Relying on the QObject hierarchy to properly clean this up resulted in a
     //	segfault; there was probably a problem in the deletion order.
@@ -147,6 +172,12 @@ MainWindow::~MainWindow()
     if ( _configDialog )
 	delete _configDialog;
 
+    if ( _unpkgThread )
+    {
+	_unpkgThread->wait();	// Deleting a running thread would crash
+	delete _unpkgThread;
+    }
+
     delete _ui->dirTreeView;
     delete _ui;
     delete _historyButtons;
@@ -198,6 +229,15 @@ void MainWindow::connectSignals()
     connect( app()->dirTree(),		 SIGNAL( aborted()	   ),
 	     this,			 SLOT  ( readingAborted()  ) );
 
+    connect( app()->dirTree(),		 SIGNAL( writeProgress( int ) ),
+	     this,			 SLOT  ( writeProgress( int ) ) );
+
+    connect( app()->dirTree(),		 SIGNAL( treeWritten( QString, bool ) ),
+	     this,			 SLOT  ( treeWritten( QString, bool ) ) );
+
+    connect( app()->dirTree(),		 SIGNAL( memoryBudgetChecked() ),
+	     this,			 SLOT  ( updateMemoryLabel()   ) );
+
     connect( app()->selectionModel(),	 SIGNAL( selectionChanged() ),
 	     this,			 SLOT  ( updateActions()    ) );
 
@@ -219,12 +259,6 @@ void MainWindow::connectSignals()
     connect( _ui->treemapView,		 SIGNAL( treemapChanged() ),
 	     this,			 SLOT  ( updateActions()  ) );
 
-    connect( app()->cleanupCollection(), SIGNAL( startingCleanup( QString ) ),
-	     this,			 SLOT  ( startingCleanup( QString ) ) );
-
-    connect( app()->cleanupCollection(), SIGNAL( cleanupFinished( int ) ),
-	     this,			 SLOT  ( cleanupFinished( int ) ) );
-
     connect( &_updateTimer,		 SIGNAL( timeout()	   ),
 	     this,			 SLOT  ( showElapsedTime() ) );
 
@@ -251,18 +285,22 @@ void MainWindow::connectSignals()
 void MainWindow::updateActions()
 {
     bool reading	     = app()->dirTree()->isBusy();
+    bool writingTree	     = app()->dirTree()->isWriting();
     FileInfo * currentItem   = app()->selectionModel()->currentItem();
     FileInfo * firstToplevel = app()->dirTree()->firstToplevel();
     bool pkgView	     = firstToplevel && firstToplevel->isPkgInfo();
 
     _ui->actionStopReading->setEnabled( reading );
-    _ui->actionRefreshAll->setEnabled	( ! reading );
+    _ui->actionRefreshAll->setEnabled	( ! reading && ! writingTree );
     _ui->actionAskReadCache->setEnabled ( ! reading );
-    _ui->actionAskWriteCache->setEnabled( ! reading );
+    _ui->actionAskWriteCache->setEnabled( ! reading && ! writingTree );
+    _ui->actionExportTree->setEnabled	( ! reading && ! writingTree && firstToplevel && ! pkgView );
+    _ui->actionCompareWithCache->setEnabled( ! reading && firstToplevel && ! pkgView );
 
     _ui->actionCopyPathToClipboard->setEnabled( currentItem );
     _ui->actionGoUp->setEnabled( currentItem && currentItem->treeLevel() > 1 );
     _ui->actionGoToToplevel->setEnabled( firstToplevel && ( ! currentItem || currentItem->treeLevel() > 1 ));
+    _ui->actionGoToLargest->setEnabled( firstToplevel );
 
     FileInfoSet selectedItems = app()->selectionModel()->selectedItems();
     FileInfo * sel	      = selectedItems.first();
@@ -272,8 +310,8 @@ void MainWindow::updateActions()
     bool pseudoDirSelected = selectedItems.containsPseudoDir();
     bool pkgSelected	   = selectedItems.containsPkg();
 
-    _ui->actionMoveToTrash->setEnabled( sel && ! pseudoDirSelected && ! pkgSelected && ! reading );
-    _ui->actionRefreshSelected->setEnabled( selSize == 1 && ! sel->isExcluded() && ! sel->isMountPoint() && ! pkgView );
+    _ui->actionMoveToTrash->setEnabled( sel && ! pseudoDirSelected && ! pkgSelected && ! reading && ! writingTree );
+    _ui->actionRefreshSelected->setEnabled( selSize == 1 && ! sel->isExcluded() && ! sel->isMountPoint() && ! pkgView && ! writingTree );
     _ui->actionContinueReadingAtMountPoint->setEnabled( oneDirSelected && sel->isMountPoint() );
     _ui->actionReadExcludedDirectory->setEnabled      ( oneDirSelected && sel->isExcluded()   );
 
@@ -282,6 +320,9 @@ void MainWindow::updateActions()
     _ui->actionFileSizeStats->setEnabled( ! reading && nothingOrOneDir );
     _ui->actionFileTypeStats->setEnabled( ! reading && nothingOrOneDir );
     _ui->actionFileAgeStats->setEnabled ( ! reading && nothingOrOneDir );
+    _ui->actionSharedExtents->setEnabled( ! reading && nothingOrOneDir );
+    _ui->actionOwnerStats->setEnabled	( ! reading && nothingOrOneDir );
+    _ui->actionShowDirList->setEnabled  ( ! reading && oneDirSelected  );
 
     bool showingTreemap = _ui->treemapView->isVisible();
 
@@ -295,6 +336,26 @@ void MainWindow::updateActions()
 }
 
 
+void MainWindow::initCleanups()
+{
+    CleanupCollection * cleanupCollection = app()->cleanupCollection();
+
+    cleanupCollection->addToMenu   ( _ui->menuCleanup,
+				     true ); // keepUpdated
+    cleanupCollection->addToToolBar( _ui->toolBar,
+				     true ); // keepUpdated
+
+    _ui->dirTreeView->setCleanupCollection( cleanupCollection );
+    _ui->treemapView->setCleanupCollection( cleanupCollection );
+
+    connect( cleanupCollection, SIGNAL( startingCleanup( QString ) ),
+	     this,		SLOT  ( startingCleanup( QString ) ) );
+
+    connect( cleanupCollection, SIGNAL( cleanupFinished( int ) ),
+	     this,		SLOT  ( cleanupFinished( int ) ) );
+}
+
+
 void MainWindow::readSettings()
 {
     QDirStat::Settings settings;
@@ -308,6 +369,8 @@ void MainWindow::readSettings()
     _urlInWindowTitle	  = settings.value( "UrlInWindowTitle"	      , false ).toBool();
     _useTreemapHover	  = settings.value( "UseTreemapHover"	      , false ).toBool();
     _layoutName		  = settings.value( "Layout"		      , "L2"  ).toString();
+    _restoreSession	  = settings.value( "RestoreSession"	      , false ).toBool();
+    _sessionSnapshotMinutes = settings.value( "SessionSnapshotMinutes", 0	  ).toInt();
 
     settings.endGroup();
 
@@ -367,6 +430,8 @@ void MainWindow::writeSettings()
     settings.setDefaultValue( "StatusBarTimeoutMillisec", _statusBarTimeout );
     settings.setDefaultValue( "UrlInWindowTitle"	, _urlInWindowTitle );
     settings.setDefaultValue( "UseTreemapHover"		, _useTreemapHover );
+    settings.setDefaultValue( "RestoreSession"		, _restoreSession );
+    settings.setDefaultValue( "SessionSnapshotMinutes"	, _sessionSnapshotMinutes );
 
     settings.endGroup();
 
@@ -402,7 +467,9 @@ void MainWindow::treemapAsSidePanel()
 
 void MainWindow::busyDisplay()
 {
-    _ui->treemapView->disable();
+    if ( ! _ui->treemapView->liveUpdates() )
+	_ui->treemapView->disable();
+
     updateActions();
 
     // If it is open, close the window that lists unreadable directories:
@@ -494,6 +561,14 @@ void MainWindow::readingFinished()
     _ui->statusBar->showMessage( tr( "Finished. Elapsed time: %1").arg( elapsedTime ), LONG_MESSAGE );
     logInfo() << "Reading finished after " << elapsedTime << endl;
 
+    if ( _verifySession )
+    {
+	// Start that only after everybody else got the finished() signal
+
+	_verifySession = false;
+	QTimer::singleShot( 0, this, SLOT( verifySession() ) );
+    }
+
     if ( app()->dirTree()->firstToplevel() &&
 	 app()->dirTree()->firstToplevel()->errSubDirCount() > 0 )
     {
@@ -512,6 +587,7 @@ void MainWindow::readingAborted()
     QString elapsedTime = formatMillisec( _stopWatch.elapsed() );
     _ui->statusBar->showMessage( tr( "Aborted. Elapsed time: %1").arg( elapsedTime ), LONG_MESSAGE );
     logInfo() << "Reading aborted after " << elapsedTime << endl;
+    _verifySession = false;
 }
 
 
@@ -524,11 +600,32 @@ void MainWindow::openUrl( const QString & url )
 	readPkg( url );
     else if ( isUnpkgUrl( url ) )
 	showUnpkgFiles( url );  // see MainWinUnpkg.cpp
+    else if ( RemoteReadJob::isRemoteUrl( url ) )
+	readRemote( url );
     else
 	openDir( url );
 }
 
 
+void MainWindow::readRemote( const QString & url )
+{
+    QString host;
+    QString path;
+
+    if ( ! RemoteReadJob::splitRemoteUrl( url, host, path ) )
+    {
+	logError() << "Bad remote URL " << url << endl;
+	_ui->statusBar->showMessage( tr( "Bad remote URL %1" ).arg( url ), LONG_MESSAGE );
+	return;
+    }
+
+    app()->dirTreeModel()->clear();
+    app()->dirTree()->readRemote( host, path );
+    updateWindowTitle( url );
+    updateActions();
+}
+
+
 void MainWindow::openDir( const QString & url )
 {
     try
@@ -585,6 +682,29 @@ void MainWindow::askOpenDir()
 }
 
 
+void MainWindow::askEstimateDir()
+{
+    QString path;
+    DirTree * tree = app()->dirTree();
+    bool crossFilesystems = tree->crossFilesystems();
+
+#if USE_CUSTOM_OPEN_DIR_DIALOG
+    path = QDirStat::OpenDirDialog::askOpenDir( &crossFilesystems, this );
+#else
+    path = QFileDialog::getExistingDirectory( this, // parent
+                                              tr("Select directory to estimate") );
+#endif
+
+    if ( ! path.isEmpty() )
+    {
+	tree->reset();
+	tree->setCrossFilesystems( crossFilesystems );
+	tree->setEstimateMode( true );
+	openUrl( path );
+    }
+}
+
+
 void MainWindow::askOpenPkg()
 {
     bool canceled;
@@ -685,15 +805,111 @@ void MainWindow::readCache( const QString & cacheFileName )
 }
 
 
+void MainWindow::readCaches( const QStringList & cacheFileNames )
+{
+    app()->dirTreeModel()->clear();
+    _historyButtons->clearHistory();
+
+    if ( ! cacheFileNames.isEmpty() )
+	app()->dirTree()->readCaches( cacheFileNames );
+}
+
+
+bool MainWindow::restoreSession()
+{
+    if ( ! _restoreSession || ! SessionSnapshot::exists() )
+	return false;
+
+    logInfo() << "Restoring the last session from " << SessionSnapshot::fileName() << endl;
+
+    readCache( SessionSnapshot::fileName() );
+    _verifySession = true;
+    updateActions();
+
+    return true;
+}
+
+
+void MainWindow::verifySession()
+{
+    if ( app()->dirTree()->verify() )
+	_ui->statusBar->showMessage( tr( "Checking for changes since the last session..." ) );
+
+    // Don't write the snapshot again right away if nothing changed
+
+    _sessionGeneration = app()->dirTree()->generation();
+}
+
+
+void MainWindow::saveSessionInBackground()
+{
+    DirTree * tree = app()->dirTree();
+
+    if ( tree->generation() == _sessionGeneration || ! SessionSnapshot::canSave( tree ) )
+	return;
+
+    if ( SessionSnapshot::startSaving( tree ) )
+	_sessionGeneration = tree->generation();
+}
+
+
+void MainWindow::updateMemoryLabel()
+{
+    const MemoryBudget & budget = app()->dirTree()->memoryBudget();
+
+    if ( ! budget.isEnabled() || budget.usedBytes() < 0 )
+    {
+	_memoryLabel->hide();
+	return;
+    }
+
+    QString text = tr( "Memory: %1 of %2" )
+	.arg( formatSize( budget.usedBytes() ) )
+	.arg( formatSize( budget.limit() ) );
+
+    if ( budget.level() == MemoryBudget::Exhausted )
+	text += tr( " (not reading more)" );
+
+    _memoryLabel->setText( text );
+    _memoryLabel->show();
+}
+
+
 void MainWindow::askReadCache()
 {
+    QStringList fileNames = QFileDialog::getOpenFileNames( this, // parent
+							   tr( "Select QDirStat cache files" ),
+							   DEFAULT_CACHE_NAME );
+    if ( ! fileNames.isEmpty() )
+	readCaches( fileNames );
+
+    updateActions();
+}
+
+
+void MainWindow::askCompareWithCache()
+{
+    FileInfo * toplevel = app()->dirTree()->firstToplevel();
+
+    if ( ! toplevel )
+	return;
+
     QString fileName = QFileDialog::getOpenFileName( this, // parent
-						     tr( "Select QDirStat cache file" ),
+						     tr( "Select QDirStat cache file to compare with" ),
 						     DEFAULT_CACHE_NAME );
-    if ( ! fileName.isEmpty() )
-	readCache( fileName );
+    if ( fileName.isEmpty() )
+	return;
 
-    updateActions();
+    if ( ! _treeDiffWindow )
+    {
+	// This deletes itself when the user closes it. The associated QPointer
+	// keeps track of that and sets the pointer to 0 when it happens.
+
+	_treeDiffWindow = new TreeDiffWindow( this );
+    }
+
+    _treeDiffWindow->show();
+    _treeDiffWindow->populate( fileName, toplevel );
 }
 
 
@@ -702,20 +918,77 @@ void MainWindow::askWriteCache()
     QString fileName = QFileDialog::getSaveFileName( this, // parent
 						     tr( "Enter name for QDirStat cache file"),
 						     DEFAULT_CACHE_NAME );
-    if ( ! fileName.isEmpty() )
+    if ( fileName.isEmpty() )
+	return;
+
+    // This continues in treeWritten()
+
+    if ( app()->dirTree()->startWritingCache( fileName ) )
     {
-	bool ok = app()->dirTree()->writeCache( fileName );
+	showProgress( tr( "Writing cache file %1..." ).arg( fileName ) );
+	updateActions();
+    }
+}
 
-	if ( ok )
-	{
-	    showProgress( tr( "Directory tree written to file %1" ).arg( fileName ) );
-	}
-	else
-	{
-	    QMessageBox::critical( this,
-				   tr( "Error" ), // Title
-				   tr( "ERROR writing cache file %1").arg( fileName ) );
-	}
+
+void MainWindow::askExportTree()
+{
+    QString csvFilter	 = tr( "CSV files (*.csv)" );
+    QString ndjsonFilter = tr( "NDJSON files (*.ndjson *.jsonl *.json)" );
+    QString selectedFilter;
+
+    QString fileName = QFileDialog::getSaveFileName( this, // parent
+						     tr( "Export the directory tree" ),
+						     "qdirstat-export.csv",
+						     csvFilter + ";;" + ndjsonFilter,
+						     &selectedFilter );
+    if ( fileName.isEmpty() )
+	return;
+
+    TreeExporter::Format format = TreeExporter::formatForFileName( fileName );
+
+    if ( selectedFilter == ndjsonFilter && ! fileName.endsWith( ".csv" ) )
+	format = TreeExporter::NdjsonFormat;
+
+    // Export the columns of the tree view in the same order
+
+    TreeExporterThread * thread =
+	new TreeExporterThread( fileName, app()->dirTree(), format,
+				DataColumns::instance()->columns() );
+    CHECK_NEW( thread );
+
+    // This continues in treeWritten()
+
+    if ( app()->dirTree()->startWriting( thread ) )
+    {
+	showProgress( tr( "Exporting to %1..." ).arg( fileName ) );
+	updateActions();
+    }
+}
+
+
+void MainWindow::writeProgress( int itemsWritten )
+{
+    _ui->statusBar->showMessage( tr( "Writing: %1 items" ).arg( itemsWritten ) );
+}
+
+
+void MainWindow::treeWritten( const QString & fileName, bool ok )
+{
+    updateActions();
+
+    if ( SessionSnapshot::finishSaving( fileName, ok ) )
+	return;
+
+    if ( ok )
+    {
+	showProgress( tr( "Directory tree written to file %1" ).arg( fileName ) );
+    }
+    else
+    {
+	QMessageBox::critical( this,
+			       tr( "Error" ), // Title
+			       tr( "ERROR writing %1").arg( fileName ) );
     }
 }
 
@@ -742,8 +1015,37 @@ void MainWindow::showProgress( const QString & text )
 
 void MainWindow::showElapsedTime()
 {
-    showProgress( tr( "Reading... %1" )
-		  .arg( formatMillisec( _stopWatch.elapsed(), false ) ) );
+    QString text = tr( "Reading... %1" )
+	.arg( formatMillisec( _stopWatch.elapsed(), false ) );
+
+    DirTree * tree = app()->dirTree();
+    tree->updateScanProgress();
+    const ScanProgress & progress = tree->scanProgress();
+
+    if ( progress.isValid() )
+    {
+	// If reading started below the top of a filesystem, not all of its
+	// inodes will be read: The progress is at least that much, the
+	// remaining time at most.
+
+	text += "  " + ( progress.isUpperBound() ? tr( "at least %1%" ) : tr( "%1%" ) )
+	    .arg( progress.percent() );
+
+	text += tr( " of %1 inodes" ).arg( progress.totalInodes() );
+
+	if ( progress.entriesPerSec() >= 0 )
+	    text += tr( ", %1/s" ).arg( progress.entriesPerSec() );
+
+	qint64 remaining = progress.remainingMillisec();
+
+	if ( remaining >= 0 )
+	{
+	    text += ", " + ( progress.isUpperBound() ? tr( "at most %1 left" ) : tr( "about %1 left" ) )
+		.arg( formatMillisec( remaining, false ) );
+	}
+    }
+
+    showProgress( text );
 }
 
 
@@ -756,6 +1058,12 @@ void MainWindow::showCurrent( FileInfo * item )
 	    .arg( item->sizePrefix() )
 	    .arg( formatSize( item->totalSize() ) );
 
+	FileSize margin = item->isDirInfo() ?
+	    app()->dirTree()->sizeEstimator()->sizeMargin( item->toDirInfo() ) : 0;
+
+	if ( margin > 0 )
+	    msg += tr( "  [Estimate: %1%2]" ).arg( QChar( 0x00B1 ) ).arg( formatSize( margin ) );
+
 	if ( item->readState() == DirPermissionDenied )
 	    msg += tr( "  [Permission Denied]" );
         else if ( item->readState() == DirError )
@@ -866,6 +1174,27 @@ void MainWindow::navigateToToplevel()
 }
 
 
+void MainWindow::navigateToLargest()
+{
+    FileInfo * item = app()->selectionModel()->currentItem();
+
+    if ( ! item )
+	item = app()->dirTree()->firstToplevel();
+
+    // The largest children are known without sorting, so this is fast
+    // even for directories with millions of children
+
+    while ( item && item->isDirInfo() && item->toDirInfo()->largestChild() )
+	item = item->toDirInfo()->largestChild();
+
+    if ( item )
+    {
+	app()->selectionModel()->setCurrentItem( item,
+						 true ); // select
+    }
+}
+
+
 void MainWindow::navigateToUrl( const QString & url )
 {
     // logDebug() << "Navigating to " << url << endl;
@@ -895,31 +1224,28 @@ void MainWindow::moveToTrash()
     OutputWindow * outputWindow = new OutputWindow( qApp->activeWindow() );
     CHECK_NEW( outputWindow );
 
-    // Prepare refresher
+    // Prepare the tree patcher: The items will be gone, so there is no
+    // need to read their parents again.
 
-    FileInfoSet refreshSet = Refresher::parents( selectedItems );
-    app()->selectionModel()->prepareRefresh( refreshSet );
-    Refresher * refresher  = new Refresher( refreshSet, this );
-    CHECK_NEW( refresher );
+    TreePatcher * treePatcher = new TreePatcher( selectedItems, this );
+    CHECK_NEW( treePatcher );
 
     connect( outputWindow, SIGNAL( lastProcessFinished( int ) ),
-	     refresher,	   SLOT	 ( refresh()		      ) );
+	     treePatcher,  SLOT	 ( patch()		      ) );
 
     outputWindow->showAfterTimeout();
 
-    // Move all selected items to trash
+    // Move all selected items to trash. The TrashJob calls
+    // outputWindow->noMoreProcesses() when it is done.
 
-    foreach ( FileInfo * item, selectedItems )
-    {
-	bool success = Trash::trash( item->path() );
+    QStringList paths;
 
-	if ( success )
-	    outputWindow->addStdout( tr( "Moved to trash: %1" ).arg( item->path() ) );
-	else
-	    outputWindow->addStderr( tr( "Move to trash failed for %1" ).arg( item->path() ) );
-    }
+    foreach ( FileInfo * item, selectedItems )
+	paths << item->path();
 
-    outputWindow->noMoreProcesses();
+    TrashJob * trashJob = new TrashJob( paths, outputWindow, this );
+    CHECK_NEW( trashJob );
+    trashJob->start();
 }
 
 
@@ -963,6 +1289,12 @@ void MainWindow::showFileSizeStats()
 }
 
 
+void MainWindow::showDirList()
+{
+    DirListWindow::populateSharedInstance( app()->selectedDirOrRoot() );
+}
+
+
 void MainWindow::showFileAgeStats()
 {
     if ( ! _fileAgeStatsWindow )
@@ -1005,6 +1337,109 @@ void MainWindow::showFilesystems()
 }
 
 
+void MainWindow::showReadStats( bool show )
+{
+    if ( ! _readStatsDock )
+    {
+	if ( ! show )
+	    return;
+
+	ReadStatsView * view = new ReadStatsView();
+	CHECK_NEW( view );
+	view->setDirTree( app()->dirTree() );
+
+	_readStatsDock = new QDockWidget( tr( "Scan Statistics" ), this );
+	CHECK_NEW( _readStatsDock );
+
+	_readStatsDock->setObjectName( "ReadStatsDock" );
+	_readStatsDock->setWidget( view );
+	addDockWidget( Qt::RightDockWidgetArea, _readStatsDock );
+
+	// Closing the dock unchecks the menu action
+
+	connect( _readStatsDock->toggleViewAction(), SIGNAL( toggled   ( bool ) ),
+		 _ui->actionShowReadStats,	     SLOT  ( setChecked( bool ) ) );
+    }
+
+    _readStatsDock->setVisible( show );
+}
+
+
+void MainWindow::showSharedExtents()
+{
+    if ( ! _sharedExtentsWindow )
+    {
+	// This deletes itself when the user closes it. The associated QPointer
+	// keeps track of that and sets the pointer to 0 when it happens.
+
+	_sharedExtentsWindow = new SharedExtentsWindow( this );
+    }
+
+    _sharedExtentsWindow->populate( app()->selectedDirOrRoot() );
+    _sharedExtentsWindow->show();
+}
+
+
+void MainWindow::showOwnerStats()
+{
+    if ( ! _ownerStatsWindow )
+    {
+	// This deletes itself when the user closes it. The associated QPointer
+	// keeps track of that and sets the pointer to 0 when it happens.
+
+	_ownerStatsWindow = new OwnerStatsWindow( this );
+    }
+
+    _ownerStatsWindow->populate( app()->selectedDirOrRoot() );
+    _ownerStatsWindow->show();
+}
+
+
+void MainWindow::showMemoryUsage()
+{
+    if ( ! _memoryUsageWindow )
+    {
+	// This deletes itself when the user closes it. The associated QPointer
+	// keeps track of that and sets the pointer to 0 when it happens.
+
+	_memoryUsageWindow = new MemoryUsageWindow( this );
+    }
+
+    _memoryUsageWindow->populate( app()->selectedDirOrRoot() );
+    _memoryUsageWindow->show();
+}
+
+
+void MainWindow::showGrowthHistory()
+{
+    if ( ! _snapshotHistoryWindow )
+    {
+	// This deletes itself when the user closes it. The associated QPointer
+	// keeps track of that and sets the pointer to 0 when it happens.
+
+	_snapshotHistoryWindow = new SnapshotHistoryWindow( this );
+    }
+
+    _snapshotHistoryWindow->populate( app()->selectedDirOrRoot() );
+    _snapshotHistoryWindow->show();
+}
+
+
+void MainWindow::showEventLoopStalls()
+{
+    if ( ! _eventLoopStallsWindow )
+    {
+	// This deletes itself when the user closes it. The associated QPointer
+	// keeps track of that and sets the pointer to 0 when it happens.
+
+	_eventLoopStallsWindow = new EventLoopStallsWindow( this );
+    }
+
+    _eventLoopStallsWindow->populate();
+    _eventLoopStallsWindow->show();
+}
+
+
 void MainWindow::showDirPermissionsWarning()
 {
     if ( _dirPermissionsWarning || ! _enableDirPermissionsWarning )
@@ -15,10 +15,17 @@
 #include <QElapsedTimer>
 #include <QTimer>
 #include <QPointer>
+#include <QDockWidget>
 
 #include "ui_main-window.h"
 #include "FileAgeStatsWindow.h"
 #include "FilesystemsWindow.h"
+#include "SharedExtentsWindow.h"
+#include "OwnerStatsWindow.h"
+#include "MemoryUsageWindow.h"
+#include "TreeDiffWindow.h"
+#include "SnapshotHistoryWindow.h"
+#include "EventLoopStallsWindow.h"
 #include "HistoryButtons.h"
 #include "DiscoverActions.h"
 #include "PanelMessage.h"
@@ -29,6 +36,7 @@
 class QCloseEvent;
 class QMouseEvent;
 class QSignalMapper;
+class QLabel;
 class TreeLayout;
 class SysCallFailedException;
 class QMenu;
@@ -40,14 +48,20 @@ namespace QDirStat
     class FileInfo;
     class DiscoverActions;
     class PkgManager;
+    class PkgFileListCache;
+    class PkgFileListCacheThread;
     class UnpkgSettings;
 }
 
 using QDirStat::FileAgeStatsWindow;
 using QDirStat::FileInfo;
 using QDirStat::FilesystemsWindow;
+using QDirStat::SharedExtentsWindow;
+using QDirStat::OwnerStatsWindow;
 using QDirStat::PanelMessage;
 using QDirStat::PkgManager;
+using QDirStat::PkgFileListCache;
+using QDirStat::PkgFileListCacheThread;
 using QDirStat::UnpkgSettings;
 
 
@@ -78,6 +92,12 @@ public slots:
      **/
     void askOpenDir();
 
+    /**
+     * Open a directory selection dialog and read the selected URL in
+     * estimate mode (see SizeEstimator).
+     **/
+    void askEstimateDir();
+
     /**
      * Open a package selection dialog and open the selected URL.
      **/
@@ -136,17 +156,49 @@ public slots:
     void readCache( const QString & cacheFileName );
 
     /**
-     * Open a file selection dialog to ask for a cache file, clear the
-     * current tree and replace it with the content of the cache file.
+     * Clear the current tree and replace it with the content of the
+     * specified cache files, each one in its own toplevel directory.
+     **/
+    void readCaches( const QStringList & cacheFileNames );
+
+    /**
+     * Read the SessionSnapshot of the last session if that is enabled and
+     * there is one and check it against the filesystem when it is read.
+     * Return 'false' if there was nothing to restore.
+     **/
+    bool restoreSession();
+
+    /**
+     * Open a file selection dialog to ask for one or more cache files,
+     * clear the current tree and replace it with their content.
      **/
     void askReadCache();
 
+    /**
+     * Open a file selection dialog to ask for a cache file and show what
+     * changed in the current tree since that cache file was written.
+     **/
+    void askCompareWithCache();
+
+    /**
+     * Clear the current tree and read remote URL 'url'
+     * ("ssh://user@host/some/path") with qdirstat-cache-writer over ssh
+     * or daemon URL 'url' ("daemon:/some/path") from qdirstat-daemon.
+     **/
+    void readRemote( const QString & url );
+
     /**
      * Open a file selection dialog and save the current tree to the selected
      * file.
      **/
     void askWriteCache();
 
+    /**
+     * Open a file selection dialog and export the current tree to the
+     * selected file as CSV or NDJSON with the columns of the tree view.
+     **/
+    void askExportTree();
+
     /**
      * Update the window title: Show "[root]" if running as root and add the
      * URL if that is configured.
@@ -199,6 +251,12 @@ public slots:
      **/
     void navigateToToplevel();
 
+    /**
+     * Follow the largest child from the current item (or from the
+     * toplevel directory) down to the bottom of the tree.
+     **/
+    void navigateToLargest();
+
     /**
      * Open the URL stored in an action's statusTip property with an external
      * browser.
@@ -247,6 +305,43 @@ protected slots:
      **/
     void readingAborted();
 
+    /**
+     * Show the progress of writing a cache file or an export in the
+     * background.
+     **/
+    void writeProgress( int itemsWritten );
+
+    /**
+     * Report the result of writing a cache file or an export in the
+     * background.
+     **/
+    void treeWritten( const QString & fileName, bool ok );
+
+    /**
+     * Start writing the SessionSnapshot in the background if the tree
+     * changed since the last time.
+     **/
+    void saveSessionInBackground();
+
+    /**
+     * Check the tree that was just restored from the SessionSnapshot
+     * against the filesystem.
+     **/
+    void verifySession();
+
+    /**
+     * Show how much of the memory budget is used in the status bar.
+     **/
+    void updateMemoryLabel();
+
+    /**
+     * Hand the file lists of the installed packages to the DirTreePkgFilter
+     * of the unpackaged files view when the thread from
+     * startReadingUnpkgFileLists() is finished, and move the packaged files
+     * that were already read to the attics.
+     **/
+    void unpkgFileListsRead();
+
     /**
      * Change display mode to "busy" (while reading a directory tree):
      * Sort tree view by read jobs, hide treemap view.
@@ -290,6 +385,14 @@ protected slots:
      **/
     void cleanupFinished( int errorCount );
 
+    /**
+     * Add the cleanups to the menu, the tool bar and the views. This is
+     * done from the event loop after the main window is shown, so reading
+     * the cleanups doesn't delay showing the window and starting to read
+     * the directory from the command line.
+     **/
+    void initCleanups();
+
     /**
      * Navigate to the specified URL, i.e. make that directory the current and
      * selected one; scroll there and open the tree branches so that URL is
@@ -317,11 +420,53 @@ protected slots:
      **/
     void showFileAgeStats();
 
+    /**
+     * Show the entries of the currently selected directory in a flat list.
+     **/
+    void showDirList();
+
     /**
      * Show detailed information about mounted filesystems in a separate window.
      **/
     void showFilesystems();
 
+    /**
+     * Show or hide the dockable panel with the performance counters of
+     * reading the directory tree.
+     **/
+    void showReadStats( bool show );
+
+    /**
+     * Show how much disk space the children of the currently selected
+     * directory use when shared extents (Btrfs, XFS reflinks) are counted
+     * only once.
+     **/
+    void showSharedExtents();
+
+    /**
+     * Show which users and groups own how much of the currently selected
+     * directory.
+     **/
+    void showOwnerStats();
+
+    /**
+     * Show how much memory the nodes of the children of the currently
+     * selected directory use.
+     **/
+    void showMemoryUsage();
+
+    /**
+     * Show how the total size of the currently selected directory changed
+     * over the snapshots in the snapshot history store.
+     **/
+    void showGrowthHistory();
+
+    /**
+     * Show the latest stalls of the event loop and which operations caused
+     * them.
+     **/
+    void showEventLoopStalls();
+
     /**
      * Change the main window layout. If no name is passed, the function tries
      * to check if the sender is a QAction and use its data().
@@ -454,11 +599,18 @@ protected:
 
     /**
      * Apply the filters to the DirTree:
-     * - Ignore all files that belong to an installed package
+     * - Ignore all files that belong to an installed package; the file
+     *   lists of the packages are added later (see unpkgFileListsRead())
      * - Ignore all file patterns ("*.pyc" etc.) the user wishes to ignore
      **/
-    void setUnpkgFilters( const UnpkgSettings & unpkgSettings,
-                          PkgManager          * pkgManager );
+    void setUnpkgFilters( const UnpkgSettings & unpkgSettings );
+
+    /**
+     * Start reading the file lists of all packages of 'pkgManager' in a
+     * separate thread while the directory tree is read. When that thread
+     * is finished, unpkgFileListsRead() is called.
+     **/
+    void startReadingUnpkgFileLists( PkgManager * pkgManager );
 
     /**
      * Parse the starting directory in the 'unpkgSettings' and remove the
@@ -491,13 +643,24 @@ private:
     QActionGroup		 * _layoutActionGroup;
     QPointer<FileAgeStatsWindow>   _fileAgeStatsWindow;
     QPointer<FilesystemsWindow>    _filesystemsWindow;
+    QPointer<SharedExtentsWindow>  _sharedExtentsWindow;
+    QPointer<OwnerStatsWindow>	   _ownerStatsWindow;
+    QPointer<MemoryUsageWindow>	   _memoryUsageWindow;
+    QPointer<TreeDiffWindow>	   _treeDiffWindow;
+    QPointer<SnapshotHistoryWindow> _snapshotHistoryWindow;
+    QPointer<EventLoopStallsWindow> _eventLoopStallsWindow;
     QPointer<PanelMessage>	   _dirPermissionsWarning;
+    QPointer<QDockWidget>	   _readStatsDock;
     QString			   _dUrl;
     QElapsedTimer		   _stopWatch;
     bool			   _enableDirPermissionsWarning;
     bool			   _verboseSelection;
     bool			   _urlInWindowTitle;
     bool			   _useTreemapHover;
+    bool			   _restoreSession;
+    bool			   _verifySession;
+    int				   _sessionSnapshotMinutes;
+    qint64			   _sessionGeneration;
     QString			   _layoutName;
     int				   _statusBarTimeout; // millisec
     QSignalMapper	       *   _treeLevelMapper;
@@ -505,6 +668,10 @@ private:
     TreeLayout *		   _currentLayout;
     QTimer			   _updateTimer;
     QTimer                         _treeExpandTimer;
+    QTimer			   _sessionTimer;
+    QLabel			 * _memoryLabel;
+    PkgFileListCacheThread	 * _unpkgThread;
+    QElapsedTimer		   _unpkgTimer;
     QDirStat::Subtree              _futureSelection;
 
 }; // class MainWindow
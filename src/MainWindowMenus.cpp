@@ -48,6 +48,7 @@ void MainWindow::connectMenuActions()
 void MainWindow::connectFileMenu()
 {
     CONNECT_ACTION( _ui->actionOpenDir,			    this, askOpenDir()	      );
+    CONNECT_ACTION( _ui->actionEstimateDir,		    this, askEstimateDir()    );
     CONNECT_ACTION( _ui->actionOpenPkg,			    this, askOpenPkg()	      );
     CONNECT_ACTION( _ui->actionShowUnpkgFiles,		    this, askShowUnpkgFiles() );
     CONNECT_ACTION( _ui->actionRefreshAll,		    this, refreshAll()	      );
@@ -56,7 +57,9 @@ void MainWindow::connectFileMenu()
     CONNECT_ACTION( _ui->actionContinueReadingAtMountPoint, this, refreshSelected()   );
     CONNECT_ACTION( _ui->actionStopReading,		    this, stopReading()	      );
     CONNECT_ACTION( _ui->actionAskWriteCache,		    this, askWriteCache()     );
+    CONNECT_ACTION( _ui->actionExportTree,		    this, askExportTree()     );
     CONNECT_ACTION( _ui->actionAskReadCache,		    this, askReadCache()      );
+    CONNECT_ACTION( _ui->actionCompareWithCache,	    this, askCompareWithCache() );
     CONNECT_ACTION( _ui->actionQuit,			    qApp, quit()	      );
 }
 
@@ -81,6 +84,9 @@ void MainWindow::connectViewMenu()
     connect( _ui->actionShowDetailsPanel, SIGNAL( toggled   ( bool ) ),
 	     _ui->fileDetailsPanel,	  SLOT	( setVisible( bool ) ) );
 
+    connect( _ui->actionShowReadStats,	  SIGNAL( toggled	( bool ) ),
+	     this,			  SLOT	( showReadStats ( bool ) ) );
+
     CONNECT_ACTION( _ui->actionLayout1,		   this, changeLayout() );
     CONNECT_ACTION( _ui->actionLayout2,		   this, changeLayout() );
     CONNECT_ACTION( _ui->actionLayout3,		   this, changeLayout() );
@@ -91,7 +97,13 @@ void MainWindow::connectViewMenu()
     _ui->actionFileTypeStats->setShortcutContext( Qt::ApplicationShortcut );
 
     CONNECT_ACTION( _ui->actionFileAgeStats,	   this, showFileAgeStats()  );
+    CONNECT_ACTION( _ui->actionShowDirList,	   this, showDirList()	     );
     CONNECT_ACTION( _ui->actionShowFilesystems,	   this, showFilesystems()   );
+    CONNECT_ACTION( _ui->actionSharedExtents,	   this, showSharedExtents() );
+    CONNECT_ACTION( _ui->actionOwnerStats,	   this, showOwnerStats()    );
+    CONNECT_ACTION( _ui->actionMemoryUsage,	   this, showMemoryUsage()   );
+    CONNECT_ACTION( _ui->actionGrowthHistory,	   this, showGrowthHistory() );
+    CONNECT_ACTION( _ui->actionEventLoopStalls,	   this, showEventLoopStalls() );
 }
 
 
@@ -160,6 +172,7 @@ void MainWindow::connectGoMenu()
     CONNECT_ACTION( _ui->actionGoForward,    _historyButtons,   historyGoForward()   );
     CONNECT_ACTION( _ui->actionGoUp,	     this,              navigateUp()         );
     CONNECT_ACTION( _ui->actionGoToToplevel, this,              navigateToToplevel() );
+    CONNECT_ACTION( _ui->actionGoToLargest,  this,              navigateToLargest()  );
 }
 
 
@@ -171,6 +184,8 @@ void MainWindow::connectDiscoverMenu()
     CONNECT_ACTION( _ui->actionDiscoverHardLinkedFiles, _discoverActions, discoverHardLinkedFiles() );
     CONNECT_ACTION( _ui->actionDiscoverBrokenSymLinks,  _discoverActions, discoverBrokenSymLinks()  );
     CONNECT_ACTION( _ui->actionDiscoverSparseFiles,     _discoverActions, discoverSparseFiles()     );
+    CONNECT_ACTION( _ui->actionDiscoverDuplicateFiles,  _discoverActions, discoverDuplicateFiles()  );
+    CONNECT_ACTION( _ui->actionDiscoverMatchingFiles,   _discoverActions, discoverMatchingFiles()   );
 }
 
 
@@ -6,15 +6,19 @@
  *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
  */
 
+#include <QElapsedTimer>
+
 #include "MainWindow.h"
 #include "QDirStatApp.h"
 #include "ShowUnpkgFilesDialog.h"
+#include "DirTree.h"
 #include "DirTreePatternFilter.h"
 #include "DirTreePkgFilter.h"
 #include "PkgManager.h"
+#include "PkgFileListCache.h"
 #include "PkgQuery.h"
 #include "ExcludeRules.h"
-#include "BusyPopup.h"
+#include "FormatUtil.h"
 #include "Exception.h"
 #include "Logger.h"
 
@@ -61,11 +65,14 @@ void MainWindow::showUnpkgFiles( const UnpkgSettings & unpkgSettings )
     }
 
     app()->dirTreeModel()->clear(); // For instant feedback
-    BusyPopup msg( tr( "Reading file lists..." ), this );
-
 
     setUnpkgExcludeRules( unpkgSettings );
-    setUnpkgFilters( unpkgSettings, pkgManager );
+    setUnpkgFilters( unpkgSettings );
+
+    // Reading the file lists of all packages may take as long as reading
+    // the directories, so do both at the same time.
+
+    startReadingUnpkgFileLists( pkgManager );
 
     // Start reading the directory
 
@@ -97,12 +104,12 @@ void MainWindow::setUnpkgExcludeRules( const UnpkgSettings & unpkgSettings )
 }
 
 
-void MainWindow::setUnpkgFilters( const UnpkgSettings & unpkgSettings,
-                                  PkgManager          * pkgManager )
+void MainWindow::setUnpkgFilters( const UnpkgSettings & unpkgSettings )
 {
-    // Filter for ignoring all files from all installed packages
+    // Filter for ignoring all files from all installed packages. It ignores
+    // nothing until it gets the file lists from unpkgFileListsRead().
 
-    DirTreeFilter * filter = new DirTreePkgFilter( pkgManager );
+    DirTreeFilter * filter = new DirTreePkgFilter( (PkgFileListCache *) 0 );
     CHECK_NEW( filter );
 
     app()->dirTree()->clearFilters();
@@ -118,6 +125,75 @@ void MainWindow::setUnpkgFilters( const UnpkgSettings & unpkgSettings,
 }
 
 
+void MainWindow::startReadingUnpkgFileLists( PkgManager * pkgManager )
+{
+    logInfo() << "Creating file list cache for " << pkgManager->name() << endl;
+
+    if ( _unpkgThread )
+    {
+	// Still reading for the last unpackaged files view: Its result is
+	// not needed anymore.
+
+	disconnect( _unpkgThread, 0, this, 0 );
+
+	if ( _unpkgThread->isFinished() )
+	    delete _unpkgThread;
+	else
+	{
+	    connect( _unpkgThread, SIGNAL( finished()	 ),
+		     _unpkgThread, SLOT  ( deleteLater() ) );
+	}
+    }
+
+    _unpkgThread = new PkgFileListCacheThread( pkgManager, PkgFileListCache::LookupGlobal );
+    CHECK_NEW( _unpkgThread );
+
+    connect( _unpkgThread, SIGNAL( finished()		 ),
+	     this,	   SLOT	 ( unpkgFileListsRead() ) );
+
+    _unpkgTimer.start();
+    _unpkgThread->start();
+    showProgress( tr( "Reading file lists..." ) );
+}
+
+
+void MainWindow::unpkgFileListsRead()
+{
+    // A queued signal from an older thread might still arrive
+
+    if ( ! _unpkgThread || ! _unpkgThread->isFinished() )
+	return;
+
+    PkgFileListCache * fileListCache = _unpkgThread->takeCache();
+    _unpkgThread->deleteLater();
+    _unpkgThread = 0;
+
+    if ( ! fileListCache )
+    {
+	logError() << "Could not read the file lists of the installed packages" << endl;
+	return;
+    }
+
+    logInfo() << "Read " << fileListCache->files().size() << " packaged files in "
+	      << formatMillisec( _unpkgTimer.elapsed() ) << endl;
+
+    DirTree *	       tree   = app()->dirTree();
+    DirTreePkgFilter * filter = tree->pkgFilter();
+
+    if ( ! filter )	// Something else was opened meanwhile
+    {
+	delete fileListCache;
+	return;
+    }
+
+    // From now on, directory reading ignores the packaged files right away;
+    // those that were already read are moved to the attics now.
+
+    filter->setFileListCache( fileListCache );
+    tree->ignoreFilteredItems( filter );
+}
+
+
 QString MainWindow::parseUnpkgStartingDir( const UnpkgSettings & unpkgSettings )
 {
     QString dir = unpkgSettings.startingDir;
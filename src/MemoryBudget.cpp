@@ -0,0 +1,61 @@
+/*
+ *   File name: MemoryBudget.cpp
+ *   Summary:	Upper limit for the memory of the program while reading
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "MemoryBudget.h"
+#include "DirReadStats.h"
+
+// Percentage of the limit from which on each level starts. Stop reading a
+// bit below the limit: The directories that are already queued still add
+// to it.
+
+#define DROP_CACHES_PERCENT	70
+#define SHRINK_PERCENT		85
+#define EXHAUSTED_PERCENT	95
+
+
+using namespace QDirStat;
+
+
+MemoryBudget::MemoryBudget():
+    _limit( 0 ),
+    _usedBytes( -1 ),
+    _level( Normal )
+{
+    // NOP
+}
+
+
+void MemoryBudget::setLimit( qint64 bytes )
+{
+    _limit = qMax( 0LL, bytes );
+    _level = Normal;
+}
+
+
+MemoryBudget::Level MemoryBudget::check()
+{
+    _level = Normal;
+
+    if ( _limit <= 0 )
+	return _level;
+
+    _usedBytes = DirReadStats::residentBytes();
+
+    if ( _usedBytes < 0 )
+	return _level;
+
+    qint64 percent = _usedBytes * 100 / _limit;
+
+    if	    ( percent >= EXHAUSTED_PERCENT   ) _level = Exhausted;
+    else if ( percent >= SHRINK_PERCENT	     ) _level = Shrink;
+    else if ( percent >= DROP_CACHES_PERCENT ) _level = DropCaches;
+
+    return _level;
+}
+
@@ -0,0 +1,92 @@
+/*
+ *   File name: MemoryBudget.h
+ *   Summary:	Upper limit for the memory of the program while reading
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef MemoryBudget_h
+#define MemoryBudget_h
+
+
+#include <QtGlobal>
+
+
+namespace QDirStat
+{
+    /**
+     * Configurable limit for the resident memory (RSS) of the program, so
+     * reading a huge tree on a shared machine doesn't end with the OOM
+     * killer. check() compares the current RSS with the limit and returns
+     * how close it is; the DirTree then gets rid of more and more to stay
+     * below it (see DirTree::checkMemoryBudget()):
+     *
+     * - DropCaches: Drop the sort caches and the treemap caches.
+     * - Shrink:     Freeze the files of cold directories and spill the files
+     *		     of the directories that are read from now on.
+     * - Exhausted:  Don't read any more subdirectories; they are marked as
+     *		     not read because of the memory budget.
+     **/
+    class MemoryBudget
+    {
+    public:
+
+	enum Level
+	{
+	    Normal,
+	    DropCaches,
+	    Shrink,
+	    Exhausted
+	};
+
+	/**
+	 * Constructor. There is no limit until setLimit() is called.
+	 **/
+	MemoryBudget();
+
+	/**
+	 * Return the limit in bytes or 0 if there is none.
+	 **/
+	qint64 limit() const { return _limit; }
+
+	/**
+	 * Set the limit in bytes. 0 means no limit.
+	 **/
+	void setLimit( qint64 bytes );
+
+	/**
+	 * Return 'true' if there is a limit.
+	 **/
+	bool isEnabled() const { return _limit > 0; }
+
+	/**
+	 * Measure the RSS of the program and return the level for it. This
+	 * is always Normal if there is no limit.
+	 **/
+	Level check();
+
+	/**
+	 * Return the level of the last check().
+	 **/
+	Level level() const { return _level; }
+
+	/**
+	 * Return the RSS of the last check() in bytes or -1 if it is not
+	 * known.
+	 **/
+	qint64 usedBytes() const { return _usedBytes; }
+
+
+    protected:
+
+	qint64 _limit;
+	qint64 _usedBytes;
+	Level  _level;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// MemoryBudget_h
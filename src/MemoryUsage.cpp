@@ -0,0 +1,104 @@
+/*
+ *   File name: MemoryUsage.cpp
+ *   Summary:	Memory accounting for subtrees of a DirTree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "MemoryUsage.h"
+#include "DirInfo.h"
+#include "DotEntry.h"
+#include "Attic.h"
+#include "PkgInfo.h"
+#include "NodeAllocator.h"
+
+
+// The header of a QString heap buffer (QArrayData: reference count, size,
+// capacity and offset) on a 64 bit system
+
+#define STRING_HEADER_SIZE	24
+
+
+using namespace QDirStat;
+
+
+void MemoryUsage::add( const MemoryUsage & other )
+{
+    nodes     += other.nodes;
+    nodeBytes += other.nodeBytes;
+    nameBytes += other.nameBytes;
+    auxBytes  += other.auxBytes;
+}
+
+
+
+
+MemoryUsageCounter::MemoryUsageCounter()
+{
+    // NOP
+}
+
+
+MemoryUsage MemoryUsageCounter::count( FileInfo * subtree )
+{
+    MemoryUsage usage;
+
+    if ( subtree )
+	add( subtree, usage );
+
+    return usage;
+}
+
+
+void MemoryUsageCounter::add( FileInfo * item, MemoryUsage & usage )
+{
+    ++usage.nodes;
+    usage.nodeBytes += nodeSize( item );
+
+    QString name = item->name();
+
+    if ( ! name.isEmpty() && ! _countedNames.contains( name.constData() ) )
+    {
+	_countedNames.insert( name.constData() );
+	usage.nameBytes += stringSize( name );
+    }
+
+    if ( ! item->isDirInfo() )
+	return;
+
+    usage.auxBytes += item->toDirInfo()->auxMemory();
+
+    for ( FileInfo * child = item->firstChild(); child; child = child->next() )
+	add( child, usage );
+
+    if ( item->dotEntry() )
+	add( item->dotEntry(), usage );
+
+    if ( item->attic() )
+	add( item->attic(), usage );
+}
+
+
+qint64 MemoryUsageCounter::nodeSize( FileInfo * item )
+{
+    size_t size = sizeof( FileInfo );
+
+    if ( item->isPkgInfo() )
+	size = sizeof( PkgInfo );
+    else if ( item->isDotEntry() )
+	size = sizeof( DotEntry );
+    else if ( item->isAttic() )
+	size = sizeof( Attic );
+    else if ( item->isDirInfo() )
+	size = sizeof( DirInfo );
+
+    return NodeAllocator::slotSize( size );
+}
+
+
+qint64 MemoryUsageCounter::stringSize( const QString & str )
+{
+    return STRING_HEADER_SIZE + ( str.capacity() + 1 ) * sizeof( QChar );
+}
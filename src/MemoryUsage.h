@@ -0,0 +1,107 @@
+/*
+ *   File name: MemoryUsage.h
+ *   Summary:	Memory accounting for subtrees of a DirTree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef MemoryUsage_h
+#define MemoryUsage_h
+
+
+#include <QSet>
+#include <QString>
+
+
+namespace QDirStat
+{
+    class FileInfo;
+
+
+    /**
+     * The memory that the nodes of a subtree use.
+     **/
+    struct MemoryUsage
+    {
+	MemoryUsage():
+	    nodes( 0 ),
+	    nodeBytes( 0 ),
+	    nameBytes( 0 ),
+	    auxBytes( 0 )
+	    {}
+
+	/**
+	 * Return the sum of all bytes.
+	 **/
+	qint64 totalBytes() const { return nodeBytes + nameBytes + auxBytes; }
+
+	/**
+	 * Add all counters of 'other'.
+	 **/
+	void add( const MemoryUsage & other );
+
+	qint64 nodes;		// FileInfo, DirInfo, DotEntry, Attic, PkgInfo
+	qint64 nodeBytes;	// the nodes in the NodeAllocator slots
+	qint64 nameBytes;	// the heap buffers of the node names
+	qint64 auxBytes;	// child vectors, sorted children etc.
+    };
+
+
+    /**
+     * Count the memory that the nodes of subtrees use: The nodes
+     * themselves with the slot sizes of the NodeAllocator, the heap buffers
+     * of their names and the additional data of directories (see
+     * DirInfo::auxMemory()).
+     *
+     * Many nodes share the buffer of the same name (see
+     * DirTree::sharedName()). Each buffer is counted only once for all
+     * subtrees that are counted with the same MemoryUsageCounter, for the
+     * first subtree that uses it.
+     *
+     * This walks the complete subtree in the GUI thread, so this takes
+     * some time for very large subtrees: About as long as sorting them.
+     **/
+    class MemoryUsageCounter
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	MemoryUsageCounter();
+
+	/**
+	 * Return the memory usage of 'subtree' including its dot entry and
+	 * attic.
+	 **/
+	MemoryUsage count( FileInfo * subtree );
+
+	/**
+	 * Return the number of bytes of the node 'item' itself.
+	 **/
+	static qint64 nodeSize( FileInfo * item );
+
+	/**
+	 * Return the number of bytes of the heap buffer of 'str'.
+	 **/
+	static qint64 stringSize( const QString & str );
+
+
+    protected:
+
+	/**
+	 * Recursively add 'item' and all its children to 'usage'.
+	 **/
+	void add( FileInfo * item, MemoryUsage & usage );
+
+
+	QSet<const void *> _countedNames;
+
+    };	// class MemoryUsageCounter
+
+}	// namespace QDirStat
+
+
+#endif // ifndef MemoryUsage_h
@@ -0,0 +1,198 @@
+/*
+ *   File name: MemoryUsageWindow.cpp
+ *   Summary:	QDirStat "memory usage" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QList>
+#include <QPair>
+
+#include "MemoryUsageWindow.h"
+#include "DirInfo.h"
+#include "DotEntry.h"
+#include "Attic.h"
+#include "NodeAllocator.h"
+#include "SettingsHelpers.h"
+#include "HeaderTweaker.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+using namespace QDirStat;
+
+
+MemoryUsageWindow::MemoryUsageWindow( QWidget * parent ):
+    QDialog( parent ),
+    _ui( new Ui::MemoryUsageWindow )
+{
+    // logDebug() << "init" << endl;
+
+    CHECK_NEW( _ui );
+    _ui->setupUi( this );
+    initWidgets();
+    readWindowSettings( this, "MemoryUsageWindow" );
+
+    connect( _ui->refreshButton, SIGNAL( clicked() ),
+	     this,		 SLOT  ( refresh() ) );
+}
+
+
+MemoryUsageWindow::~MemoryUsageWindow()
+{
+    // logDebug() << "destroying" << endl;
+
+    writeWindowSettings( this, "MemoryUsageWindow" );
+    delete _ui;
+}
+
+
+void MemoryUsageWindow::clear()
+{
+    _ui->treeWidget->clear();
+    _ui->totalLabel->clear();
+}
+
+
+void MemoryUsageWindow::refresh()
+{
+    populate( _subtree() );
+}
+
+
+void MemoryUsageWindow::initWidgets()
+{
+    QFont font = _ui->heading->font();
+    font.setBold( true );
+    _ui->heading->setFont( font );
+
+    QStringList headerLabels;
+    headerLabels << tr( "Name"	      )
+		 << tr( "Nodes"	      )
+		 << tr( "Node Memory" )
+		 << tr( "Names"	      )
+		 << tr( "Child Lists" )
+		 << tr( "Total"	      )
+		 << tr( "%"	      );
+
+    _ui->treeWidget->setColumnCount( headerLabels.size() );
+    _ui->treeWidget->setHeaderLabels( headerLabels );
+    _ui->treeWidget->setRootIsDecorated( false );
+    _ui->treeWidget->setSortingEnabled( true );
+    _ui->treeWidget->sortByColumn( MU_TotalCol, Qt::DescendingOrder );
+    _ui->treeWidget->header()->setStretchLastSection( false );
+    HeaderTweaker::resizeToContents( _ui->treeWidget->header() );
+
+    QTreeWidgetItem * headerItem = _ui->treeWidget->headerItem();
+
+    for ( int col = MU_NodesCol; col <= MU_PercentCol; ++col )
+	headerItem->setTextAlignment( col, Qt::AlignHCenter );
+
+    headerItem->setToolTip( MU_NodeBytesCol, tr( "The FileInfo, DirInfo, DotEntry and Attic objects" ) );
+    headerItem->setToolTip( MU_NameBytesCol, tr( "The names; names that are shared are only counted once" ) );
+    headerItem->setToolTip( MU_AuxBytesCol,  tr( "Child vectors, sorted children and file age summaries" ) );
+}
+
+
+void MemoryUsageWindow::reject()
+{
+    deleteLater();
+}
+
+
+void MemoryUsageWindow::populate( FileInfo * newSubtree )
+{
+    clear();
+    _subtree = newSubtree;
+
+    FileInfo * subtree = _subtree();
+
+    if ( ! subtree )
+	return;
+
+    _ui->heading->setText( tr( "Memory Usage in %1" ).arg( subtree->url() ) );
+    setCursor( Qt::BusyCursor );
+
+    // All children with the same counter, so each shared name is counted
+    // only once
+
+    MemoryUsageCounter counter;
+    QList<QPair<QString, MemoryUsage> > results;
+    MemoryUsage total;
+
+    for ( FileInfo * child = subtree->firstChild(); child; child = child->next() )
+	results << qMakePair( child->name(), counter.count( child ) );
+
+    if ( subtree->dotEntry() )
+	results << qMakePair( subtree->dotEntry()->name(), counter.count( subtree->dotEntry() ) );
+
+    if ( subtree->attic() )
+	results << qMakePair( subtree->attic()->name(), counter.count( subtree->attic() ) );
+
+    for ( int i = 0; i < results.size(); ++i )
+	total.add( results.at( i ).second );
+
+    // The subtree node itself is only part of the total
+
+    total.nodes++;
+    total.nodeBytes += MemoryUsageCounter::nodeSize( subtree );
+    total.nameBytes += MemoryUsageCounter::stringSize( subtree->name() );
+
+    if ( subtree->isDirInfo() )
+	total.auxBytes += subtree->toDirInfo()->auxMemory();
+
+    for ( int i = 0; i < results.size(); ++i )
+	new MemoryUsageItem( results.at( i ).first, results.at( i ).second, total.totalBytes(), _ui->treeWidget );
+
+    _ui->totalLabel->setText( tr( "Total: %1 in %2 nodes  All trees: %3 in node chunks" )
+			      .arg( formatSize( total.totalBytes() ) )
+			      .arg( total.nodes )
+			      .arg( formatSize( NodeAllocator::allocatedBytes() ) ) );
+    unsetCursor();
+}
+
+
+
+
+MemoryUsageItem::MemoryUsageItem( const QString	    & name,
+				  const MemoryUsage & usage,
+				  qint64	      total,
+				  QTreeWidget	    * parent ):
+    QTreeWidgetItem( parent ),
+    _usage( usage )
+{
+    QString blanks = QString( 3, ' ' ); // Enforce left margin
+    float percent = total > 0 ? 100.0 * usage.totalBytes() / total : 0.0;
+
+    setText( MU_NameCol,      name + "    " );
+    setText( MU_NodesCol,     blanks + QString::number( usage.nodes ) );
+    setText( MU_NodeBytesCol, blanks + formatSize( usage.nodeBytes    ) );
+    setText( MU_NameBytesCol, blanks + formatSize( usage.nameBytes    ) );
+    setText( MU_AuxBytesCol,  blanks + formatSize( usage.auxBytes     ) );
+    setText( MU_TotalCol,     blanks + formatSize( usage.totalBytes() ) );
+    setText( MU_PercentCol,   blanks + formatPercent( percent	      ) );
+
+    for ( int col = MU_NodesCol; col <= MU_PercentCol; ++col )
+	setTextAlignment( col, Qt::AlignRight );
+}
+
+
+bool MemoryUsageItem::operator<( const QTreeWidgetItem & rawOther ) const
+{
+    const MemoryUsageItem & other = dynamic_cast<const MemoryUsageItem &>( rawOther );
+
+    int col = treeWidget() ? treeWidget()->sortColumn() : MU_NameCol;
+
+    switch ( col )
+    {
+	case MU_NodesCol:	return usage().nodes	    < other.usage().nodes;
+	case MU_NodeBytesCol:	return usage().nodeBytes    < other.usage().nodeBytes;
+	case MU_NameBytesCol:	return usage().nameBytes    < other.usage().nameBytes;
+	case MU_AuxBytesCol:	return usage().auxBytes	    < other.usage().auxBytes;
+	case MU_TotalCol:
+	case MU_PercentCol:	return usage().totalBytes() < other.usage().totalBytes();
+	default:		return QTreeWidgetItem::operator<( rawOther );
+    }
+}
@@ -0,0 +1,155 @@
+/*
+ *   File name: MemoryUsageWindow.h
+ *   Summary:	QDirStat "memory usage" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef MemoryUsageWindow_h
+#define MemoryUsageWindow_h
+
+#include <QDialog>
+#include <QTreeWidgetItem>
+
+#include "ui_memory-usage-window.h"
+#include "MemoryUsage.h"
+#include "Subtree.h"
+
+
+namespace QDirStat
+{
+    /**
+     * Modeless dialog to display how much memory the nodes of each direct
+     * child of a directory use in QDirStat: The FileInfo / DirInfo /
+     * DotEntry / Attic nodes, their names and the child lists of the
+     * directories. This helps to decide where exclude rules would save the
+     * most memory.
+     *
+     * This walks the subtree in the GUI thread when it is populated or
+     * refreshed; it is not updated when the tree changes.
+     **/
+    class MemoryUsageWindow: public QDialog
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 *
+	 * Notice that this widget will destroy itself upon window close.
+	 *
+	 * It is advised to use a QPointer for storing a pointer to an instance
+	 * of this class. The QPointer will keep track of this window
+	 * auto-deleting itself when closed.
+	 **/
+	MemoryUsageWindow( QWidget * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~MemoryUsageWindow();
+
+	/**
+	 * Obtain the subtree from the last used URL or 0 if none was found.
+	 **/
+	const Subtree & subtree() const { return _subtree; }
+
+
+    public slots:
+
+	/**
+	 * Populate the window: Count the memory of the direct children of
+	 * 'subtree'.
+	 **/
+	void populate( FileInfo * subtree = 0 );
+
+	/**
+	 * Refresh (reload) all data.
+	 **/
+	void refresh();
+
+	/**
+	 * Reject the dialog contents, i.e. the user clicked the "Cancel" or
+	 * WM_CLOSE button. This not only closes the dialog, it also deletes
+	 * it.
+	 *
+	 * Reimplemented from QDialog.
+	 **/
+	virtual void reject() Q_DECL_OVERRIDE;
+
+
+    protected:
+
+	/**
+	 * Clear all data and widget contents.
+	 **/
+	void clear();
+
+	/**
+	 * One-time initialization of the widgets in this window.
+	 **/
+	void initWidgets();
+
+
+	//
+	// Data members
+	//
+
+	Ui::MemoryUsageWindow * _ui;
+	Subtree			_subtree;
+    };
+
+
+    /**
+     * Column numbers for the memory usage tree widget
+     **/
+    enum MemoryUsageColumns
+    {
+	MU_NameCol = 0,
+	MU_NodesCol,
+	MU_NodeBytesCol,
+	MU_NameBytesCol,
+	MU_AuxBytesCol,
+	MU_TotalCol,
+	MU_PercentCol
+    };
+
+
+    /**
+     * Item class for the memory usage list: The memory usage of one direct
+     * child of the subtree.
+     **/
+    class MemoryUsageItem: public QTreeWidgetItem
+    {
+    public:
+
+	/**
+	 * Constructor. 'total' is the memory usage of the complete subtree
+	 * for the percentage.
+	 **/
+	MemoryUsageItem( const QString	   & name,
+			 const MemoryUsage & usage,
+			 qint64		     total,
+			 QTreeWidget	   * parent );
+
+	const MemoryUsage & usage() const { return _usage; }
+
+	/**
+	 * Less-than operator for sorting.
+	 *
+	 * Reimplemented from QTreeWidgetItem.
+	 **/
+	virtual bool operator<( const QTreeWidgetItem & other ) const Q_DECL_OVERRIDE;
+
+    protected:
+
+	MemoryUsage _usage;
+    };
+
+} // namespace QDirStat
+
+
+#endif // MemoryUsageWindow_h
@@ -7,8 +7,11 @@
  */
 
 
+#include <QCoreApplication>
+
 #include "MimeCategorizer.h"
 #include "FileInfo.h"
+#include "DirTree.h"
 #include "Settings.h"
 #include "SettingsHelpers.h"
 #include "Logger.h"
@@ -18,10 +21,18 @@ using namespace QDirStat;
 
 
 MimeCategorizer * MimeCategorizer::_instance = 0;
+MimeCategorizerLoader * MimeCategorizer::_loader = 0;
 
 
 MimeCategorizer * MimeCategorizer::instance()
 {
+    if ( _loader )
+    {
+	_loader->wait();
+	delete _loader;
+	_loader = 0;
+    }
+
     if ( ! _instance )
     {
 	_instance = new MimeCategorizer();
@@ -32,9 +43,35 @@ MimeCategorizer * MimeCategorizer::instance()
 }
 
 
+void MimeCategorizer::preload()
+{
+    if ( _instance || _loader )
+	return;
+
+    _loader = new MimeCategorizerLoader();
+    CHECK_NEW( _loader );
+    _loader->start();
+}
+
+
+void MimeCategorizerLoader::run()
+{
+    MimeCategorizer * categorizer = new MimeCategorizer();
+    CHECK_NEW( categorizer );
+
+    categorizer->generation(); // Build the maps while we are at it
+
+    // instance() only uses this after waiting for this thread
+
+    categorizer->moveToThread( QCoreApplication::instance()->thread() );
+    MimeCategorizer::_instance = categorizer;
+}
+
+
 MimeCategorizer::MimeCategorizer():
     QObject( 0 ),
-    _mapsDirty( true )
+    _mapsDirty( true ),
+    _generation( 0 )
 {
     // logDebug() << "Creating MimeCategorizer" << endl;
     readSettings();
@@ -63,8 +100,44 @@ MimeCategory * MimeCategorizer::category( FileInfo * item )
 
     if ( item->isDir() || item->isDirInfo() )
 	return 0;
-    else
+
+    DirTree * tree = item->tree();
+
+    if ( ! tree )
 	return category( item->name() );
+
+    // Category IDs cached in the items of a tree are only valid for the
+    // generation of the categories they were looked up with
+
+    if ( tree->categoryGeneration() != generation() )
+	tree->clearCategoryIds( _generation );
+
+    quint8 id = item->categoryId();
+
+    if ( id == NoCategoryId )
+	return 0;
+
+    if ( id != UnknownCategoryId && id <= _categories.size() )
+	return _categories.at( id - 1 );
+
+    MimeCategory * category = this->category( item->name() );
+    int index = category ? _categories.indexOf( category ) : -1;
+
+    if ( index < 0 )
+	item->setCategoryId( NoCategoryId );
+    else if ( index + 1 < NoCategoryId )
+	item->setCategoryId( index + 1 );
+
+    return category;
+}
+
+
+int MimeCategorizer::generation()
+{
+    if ( _mapsDirty )
+	buildMaps();
+
+    return _generation;
 }
 
 
@@ -77,42 +150,16 @@ MimeCategory * MimeCategorizer::category( const QString & filename,
     if ( filename.isEmpty() )
 	return 0;
 
-    // Build suffix maps for fast lookup
+    // Build suffix tries for fast lookup
 
     if ( _mapsDirty )
 	buildMaps();
 
-    MimeCategory * category = 0;
-
-    // Find the filename suffix: Section #1
-    // (ignoring any leading '.' separator)
-    QString suffix = filename.section( '.', 1 );
-
-    while ( ! suffix.isEmpty() && ! category )
-    {
-        // logVerbose() << "Checking " << suffix << endl;
-
-	// Try case sensitive first
-
-	category = _caseSensitiveSuffixMap.value( suffix, 0 );
-
-	if ( ! category )
-	    category = _caseInsensitiveSuffixMap.value( suffix.toLower(), 0 );
+    int		   suffixStart = -1;
+    MimeCategory * category    = suffixCategory( filename, suffixStart );
 
-	if ( category ) // success
-        {
-            if ( suffix_ret )
-                *suffix_ret = suffix;
-        }
-        else
-        {
-            // No match so far? Try the next suffix. Some files might have more
-            // than one, e.g., "tar.bz2" - if there is no match for "tar.bz2",
-            // there might be one for just "bz2".
-
-            suffix = suffix.section( '.', 1 );
-        }
-    }
+    if ( category && suffix_ret )
+	*suffix_ret = filename.mid( suffixStart );
 
     if ( ! category ) // No match yet?
 	category = matchPatterns( filename );
@@ -126,21 +173,57 @@ MimeCategory * MimeCategorizer::category( const QString & filename,
 }
 
 
-MimeCategory * MimeCategorizer::matchPatterns( const QString & filename ) const
+MimeCategory * MimeCategorizer::suffixCategory( const QString & filename,
+						int	      & suffixStart ) const
 {
-    foreach ( MimeCategory * category, _categories )
+    MimeCategory * category = 0;
+    const QChar *  name	    = filename.constData();
+    int		   len	    = filename.size();
+    int		   csNode   = SuffixTrie::root();
+    int		   ciNode   = SuffixTrie::root();
+
+    // Go backwards from the end of the name through both tries at the same
+    // time. A '.' means that the part after it is a complete suffix; a
+    // longer one that is found later wins. Some files have more than one
+    // suffix, e.g., "tar.bz2": If there is no match for "tar.bz2", there
+    // might be one for just "bz2".
+
+    for ( int i = len - 1; i >= 0 && ( csNode >= 0 || ciNode >= 0 ); --i )
     {
-	if ( category )
+	QChar ch = name[ i ];
+
+	if ( ch == QLatin1Char( '.' ) && i + 1 < len )
 	{
-	    foreach ( const QRegExp & pattern, category->patternList() )
+	    // Try case sensitive first
+
+	    MimeCategory * match = csNode >= 0 ? _caseSensitiveSuffixes.category( csNode ) : 0;
+
+	    if ( ! match && ciNode >= 0 )
+		match = _caseInsensitiveSuffixes.category( ciNode );
+
+	    if ( match )
 	    {
-		if ( pattern.exactMatch( filename ) )
-		    return category;
+		category    = match;
+		suffixStart = i + 1;
 	    }
 	}
+
+	if ( csNode >= 0 )
+	    csNode = _caseSensitiveSuffixes.child( csNode, ch.unicode() );
+
+	if ( ciNode >= 0 )
+	    ciNode = _caseInsensitiveSuffixes.child( ciNode, ch.toLower().unicode() );
     }
 
-    return 0; // No match
+    return category;
+}
+
+
+MimeCategory * MimeCategorizer::matchPatterns( const QString & filename ) const
+{
+    int index = _patterns.firstMatch( filename );
+
+    return index >= 0 ? _patternCategories.at( index ) : 0;
 }
 
 
@@ -165,37 +248,45 @@ void MimeCategorizer::remove( MimeCategory * category )
 
 void MimeCategorizer::buildMaps()
 {
-    _caseInsensitiveSuffixMap.clear();
-    _caseSensitiveSuffixMap.clear();
+    _caseInsensitiveSuffixes.clear();
+    _caseSensitiveSuffixes.clear();
+    _patterns.clear();
+    _patternCategories.clear();
 
     foreach ( MimeCategory * category, _categories )
     {
 	CHECK_PTR( category );
 
-	addSuffixes( _caseInsensitiveSuffixMap, category, category->caseInsensitiveSuffixList() );
-	addSuffixes( _caseSensitiveSuffixMap,	category, category->caseSensitiveSuffixList()	);
+	addSuffixes( _caseInsensitiveSuffixes, category, category->caseInsensitiveSuffixList() );
+	addSuffixes( _caseSensitiveSuffixes,   category, category->caseSensitiveSuffixList()   );
+
+	// All patterns of all categories in one matcher; the first match
+	// wins like when trying them one by one
+
+	foreach ( const QRegExp & pattern, category->patternList() )
+	{
+	    _patterns.add( pattern );
+	    _patternCategories << category;
+	}
     }
 
     _mapsDirty = false;
+    ++_generation;
 }
 
 
-void MimeCategorizer::addSuffixes( QMap<QString, MimeCategory *> & suffixMap,
-				   MimeCategory			 * category,
-				   const QStringList		 & suffixList  )
+void MimeCategorizer::addSuffixes( SuffixTrie	       & suffixes,
+				   MimeCategory	       * category,
+				   const QStringList   & suffixList )
 {
     foreach ( const QString & suffix, suffixList )
     {
-	if ( suffixMap.contains( suffix ) )
+	if ( ! suffixes.add( suffix, category ) )
 	{
 	    logError() << "Duplicate suffix: " << suffix << " for "
-		       << suffixMap.value( suffix ) << " and " << category
+		       << suffixes.value( suffix ) << " and " << category
 		       << endl;
 	}
-	else
-	{
-	    suffixMap[ suffix ] = category;
-	}
     }
 }
 
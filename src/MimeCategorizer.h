@@ -10,14 +10,34 @@
 #define MimeCategorizer_h
 
 #include <QObject>
-#include <QMap>
+#include <QThread>
 
 #include "MimeCategory.h"
+#include "SuffixTrie.h"
+#include "MultiPatternMatcher.h"
 
 
 namespace QDirStat
 {
     class FileInfo;
+    class MimeCategorizer;
+
+
+    /**
+     * Thread that creates the MimeCategorizer singleton in the background,
+     * so reading the categories from the settings and building the lookup
+     * maps doesn't delay showing the main window.
+     **/
+    class MimeCategorizerLoader: public QThread
+    {
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+    };
+
 
     /**
      * Class to determine the MimeCategory of filenames.
@@ -34,6 +54,8 @@ namespace QDirStat
     {
 	Q_OBJECT
 
+	friend class MimeCategorizerLoader;
+
     protected:
 
 	/**
@@ -56,12 +78,29 @@ namespace QDirStat
 	 **/
 	static MimeCategorizer * instance();
 
+	/**
+	 * Start creating the singleton in a background thread. instance()
+	 * waits for that thread if it is still busy.
+	 **/
+	static void preload();
+
 	/**
 	 * Return the MimeCategory for a FileInfo item or 0 if it doesn't fit
 	 * into any of the available categories.
+	 *
+	 * The result is cached in the item (see FileInfo::categoryId()), so
+	 * looking up the same item again is cheap. The cached categories of
+	 * all items of a tree are discarded when the categories change.
 	 **/
 	MimeCategory * category( FileInfo * item );
 
+	/**
+	 * Return a number that changes whenever the categories or their
+	 * patterns change, i.e. when categories cached in FileInfo items
+	 * become invalid.
+	 **/
+	int generation();
+
 	/**
 	 * Return the MimeCategory for a filename or 0 if it doesn't fit into
 	 * any of the available categories.
@@ -98,6 +137,12 @@ namespace QDirStat
 	 **/
 	void clear();
 
+	/**
+	 * Notification that the patterns of a category were changed
+	 * directly: Rebuild the internal suffix tries with the next lookup.
+	 **/
+	void patternsChanged() { _mapsDirty = true; }
+
 
     public slots:
 
@@ -115,23 +160,34 @@ namespace QDirStat
     protected:
 
 	/**
-	 * Build the internal maps and clear the _mapsDirty flag.
+	 * Build the internal suffix tries and the pattern matcher, clear
+	 * the _mapsDirty flag and start a new generation.
 	 **/
 	void buildMaps();
 
 	/**
-	 * Add all suffixes in 'suffixList' as key to 'suffixMap' with value
-	 * 'category'.
+	 * Add all suffixes in 'suffixList' to 'suffixes' with 'category'.
+	 **/
+	void addSuffixes( SuffixTrie	    & suffixes,
+			  MimeCategory	    * category,
+			  const QStringList & suffixList );
+
+	/**
+	 * Return the category for the longest suffix of 'filename' that is
+	 * in the suffix tries, i.e., for "foo.tar.bz2", "tar.bz2" if that is
+	 * there, otherwise "bz2". Case sensitive suffixes take precedence
+	 * over case insensitive ones of the same length. Store the position
+	 * where the matching suffix starts in 'suffixStart'. Return 0 if none
+	 * matched.
 	 *
-	 * This provides a really fast map lookup for each suffix.
+	 * This does not create any substrings or lowercase copies.
 	 **/
-	void addSuffixes( QMap<QString, MimeCategory *> & suffixMap,
-			  MimeCategory			* category,
-			  const QStringList		& suffixList  );
+	MimeCategory * suffixCategory( const QString & filename,
+				       int	     & suffixStart ) const;
 
 	/**
-	 * Iterate over all categories and try all patterns until the first
-	 * match. Return the matched category or 0 if none matched.
+	 * Return the category of the first pattern of all categories that
+	 * matches 'filename' or 0 if none matched.
 	 **/
 	MimeCategory * matchPatterns( const QString & filename ) const;
 
@@ -145,12 +201,16 @@ namespace QDirStat
 	//
 
 	static MimeCategorizer *	_instance;
+	static MimeCategorizerLoader *	_loader;
 
 	bool				_mapsDirty;
+	int				_generation;
 	MimeCategoryList		_categories;
 
-	QMap<QString, MimeCategory *>	_caseInsensitiveSuffixMap;
-	QMap<QString, MimeCategory *>	_caseSensitiveSuffixMap;
+	SuffixTrie			_caseInsensitiveSuffixes;
+	SuffixTrie			_caseSensitiveSuffixes;
+	MultiPatternMatcher		_patterns;
+	QVector<MimeCategory *>		_patternCategories;	// for each pattern
 
     };	// class MimeCategorizer
 
@@ -182,6 +182,8 @@ void MimeCategoryConfigPage::save( void * value )
 
     patterns = _ui->caseSensitivePatternsTextEdit->toPlainText();
     category->addPatterns( patterns.split( "\n" ), Qt::CaseSensitive );
+
+    _categorizer->patternsChanged();
 }
 
 
@@ -7,9 +7,17 @@
  */
 
 
+#include <sys/statvfs.h>
+#include <sys/sysmacros.h>	// makedev()
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+
 #include <QFile>
 #include <QRegExp>
 #include <QFileInfo>
+#include <QThread>
 
 #include "MountPoints.h"
 #include "SysUtil.h"
@@ -17,21 +25,113 @@
 #include "Exception.h"
 
 #define LSBLK_TIMEOUT_SEC       10
+#define SIZE_INFO_TTL_MILLISEC	5000
+#define MOUNT_INFO_PATH		"/proc/self/mountinfo"
 
 using namespace QDirStat;
 
 
+namespace QDirStat
+{
+    /**
+     * Thread to get the size information of one filesystem with
+     * statvfs(). That call may block for a long time, e.g. for an NFS mount
+     * whose server is down; then the caller simply stops waiting for it.
+     **/
+    class StatfsJob: public QThread
+    {
+    public:
+
+	StatfsJob( const QString & path ):
+	    QThread(),
+	    path( path ),
+	    success( false ),
+	    totalSize( -1 ),
+	    freeSize( -1 ),
+	    availableSize( -1 ),
+	    usedInodes( -1 )
+	    {}
+
+	QString	 path;
+	bool	 success;
+	FileSize totalSize;
+	FileSize freeSize;	// For root
+	FileSize availableSize; // For non-privileged users
+	qint64	 usedInodes;	// -1 if the filesystem has no fixed inode table
+
+    protected:
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    struct statvfs fsInfo;
+
+	    if ( statvfs( path.toUtf8(), &fsInfo ) != 0 )
+		return;
+
+	    totalSize	  = (FileSize) fsInfo.f_blocks * fsInfo.f_frsize;
+	    freeSize	  = (FileSize) fsInfo.f_bfree  * fsInfo.f_frsize;
+	    availableSize = (FileSize) fsInfo.f_bavail * fsInfo.f_frsize;
+
+	    // Btrfs and others report 0 inodes
+
+	    if ( fsInfo.f_files > 0 && fsInfo.f_files >= fsInfo.f_ffree )
+		usedInodes = (qint64) ( fsInfo.f_files - fsInfo.f_ffree );
+
+	    success	  = true;
+	}
+    };
+
+}	// namespace QDirStat
+
+
+/**
+ * Replace the octal escapes ("\040" for a blank) in a field of
+ * /proc/self/mountinfo.
+ **/
+static QString unescapeMountInfo( const QByteArray & field )
+{
+    if ( ! field.contains( '\\' ) )
+	return QString::fromUtf8( field );
+
+    QByteArray result;
+    result.reserve( field.size() );
+
+    for ( int i = 0; i < field.size(); ++i )
+    {
+	if ( field.at( i ) == '\\' && i + 3 < field.size() )
+	{
+	    bool ok;
+	    int	 ch = field.mid( i + 1, 3 ).toInt( &ok, 8 );
+
+	    if ( ok )
+	    {
+		result.append( (char) ch );
+		i += 3;
+		continue;
+	    }
+	}
+
+	result.append( field.at( i ) );
+    }
+
+    return QString::fromUtf8( result );
+}
+
+
 MountPoint::MountPoint( const QString & device,
 			const QString & path,
 			const QString & filesystemType,
 			const QString & mountOptions ) :
     _device( device ),
+    _deviceId( 0 ),
     _path( path ),
     _filesystemType( filesystemType ),
-    _isDuplicate( false )
-#if HAVE_Q_STORAGE_INFO
-    , _storageInfo( 0 )
-#endif
+    _isDuplicate( false ),
+    _totalSize( -1 ),
+    _freeSize( -1 ),
+    _availableSize( -1 ),
+    _usedInodes( -1 ),
+    _sizeTimedOut( false )
 {
     _mountOptions = mountOptions.split( "," );
 }
@@ -39,10 +139,7 @@ MountPoint::MountPoint( const QString & device,
 
 MountPoint::~MountPoint()
 {
-#if HAVE_Q_STORAGE_INFO
-    if ( _storageInfo )
-        delete _storageInfo;
-#endif
+    // NOP
 }
 
 
@@ -118,71 +215,100 @@ bool MountPoint::isSnapPackage() const
 }
 
 
-#if HAVE_Q_STORAGE_INFO
+bool MountPoint::hasSizeInfo() const
+{
+    return true;
+}
+
+
+bool MountPoint::isSizeInfoFresh() const
+{
+    return _sizeInfoTimer.isValid() && ! _sizeInfoTimer.hasExpired( SIZE_INFO_TTL_MILLISEC );
+}
 
-QStorageInfo * MountPoint::storageInfo()
+
+void MountPoint::ensureSizeInfo()
 {
-    if ( ! _storageInfo )
-    {
-        if ( isNetworkMount() )
-            logDebug() << "Creating QStorageInfo for " << _path << endl;
+    if ( ! isSizeInfoFresh() )
+	MountPoints::querySizes( QList<MountPoint *>() << this );
+}
+
+
+void MountPoint::setSizeInfo( const StatfsJob * job )
+{
+    _sizeTimedOut = ( job == 0 );
 
-        _storageInfo = new QStorageInfo( _path );
-        CHECK_NEW( _storageInfo );
+    if ( job && job->success )
+    {
+	_totalSize     = job->totalSize;
+	_freeSize      = job->freeSize;
+	_availableSize = job->availableSize;
+	_usedInodes    = job->usedInodes;
+    }
+    else
+    {
+	_totalSize     = -1;
+	_freeSize      = -1;
+	_availableSize = -1;
+	_usedInodes    = -1;
     }
 
-    return _storageInfo;
+    _sizeInfoTimer.start();
 }
 
 
-bool MountPoint::hasSizeInfo() const
+FileSize MountPoint::totalSize()
 {
-    return true;
+    ensureSizeInfo();
+
+    return _totalSize;
 }
 
 
-FileSize MountPoint::totalSize()
+qint64 MountPoint::usedInodes()
 {
-    return storageInfo()->bytesTotal();
+    ensureSizeInfo();
+
+    return _usedInodes;
 }
 
 
 FileSize MountPoint::usedSize()
 {
-    return storageInfo()->bytesTotal() - storageInfo()->bytesFree();
+    ensureSizeInfo();
+
+    if ( _totalSize < 0 || _freeSize < 0 )
+	return -1;
+
+    return _totalSize - _freeSize;
 }
 
 
 FileSize MountPoint::reservedSize()
 {
-    return storageInfo()->bytesFree() - storageInfo()->bytesAvailable();
+    ensureSizeInfo();
+
+    if ( _freeSize < 0 || _availableSize < 0 )
+	return -1;
+
+    return _freeSize - _availableSize;
 }
 
 
 FileSize MountPoint::freeSizeForUser()
 {
-    return storageInfo()->bytesAvailable();
+    ensureSizeInfo();
+
+    return _availableSize;
 }
 
 
 FileSize MountPoint::freeSizeForRoot()
 {
-    return storageInfo()->bytesFree();
-}
-
-#else  // ! HAVE_Q_STORAGE_INFO
+    ensureSizeInfo();
 
-// Qt before 5.4 does not have QStorageInfo,
-// and statfs() is Linux-specific (not POSIX).
-
-bool	 MountPoint::hasSizeInfo() const { return false; }
-FileSize MountPoint::totalSize()	 { return -1; }
-FileSize MountPoint::usedSize()		 { return -1; }
-FileSize MountPoint::reservedSize()	 { return -1; }
-FileSize MountPoint::freeSizeForUser()	 { return -1; }
-FileSize MountPoint::freeSizeForRoot()   { return -1; }
-
-#endif // ! HAVE_Q_STORAGE_INFO
+    return _freeSize;
+}
 
 
 
@@ -202,7 +328,8 @@ MountPoints * MountPoints::instance()
 }
 
 
-MountPoints::MountPoints()
+MountPoints::MountPoints():
+    _mountInfoFd( -1 )
 {
     init();
 }
@@ -211,14 +338,26 @@ MountPoints::MountPoints()
 MountPoints::~MountPoints()
 {
     init();
+
+    if ( _mountInfoFd >= 0 )
+	close( _mountInfoFd );
+
+    // Any hung StatfsJobs are left alone: A QThread that is still running
+    // can't be deleted, and there is no way to interrupt statvfs().
 }
 
 
 void MountPoints::init()
 {
     qDeleteAll( _mountPointList );
+    qDeleteAll( _retiredMountPoints );
     _mountPointList.clear();
+    _retiredMountPoints.clear();
     _mountPointMap.clear();
+    _deviceIdMap.clear();
+    _sharedDeviceIds.clear();
+    _mountedDevices.clear();
+    _mountInfoLines.clear();
     _isPopulated     = false;
     _hasBtrfs	     = false;
     _checkedForBtrfs = false;
@@ -278,18 +417,19 @@ MountPoint * MountPoints::findNearestMountPoint( const QString & startPath )
 }
 
 
-bool MountPoints::isDeviceMounted( const QString & device )
+MountPoint * MountPoints::findByDeviceId( dev_t deviceId )
 {
-    // Do NOT call ensurePopulated() here: This would cause a recursion in the
-    // populating process!
+    instance()->ensurePopulated();
 
-    foreach ( MountPoint * mountPoint, instance()->_mountPointList )
-    {
-	if ( mountPoint->device() == device )
-	    return true;
-    }
+    return deviceId == 0 ? 0 : instance()->_deviceIdMap.value( deviceId, 0 );
+}
 
-    return false;
+
+bool MountPoints::hasMultipleMounts( dev_t deviceId )
+{
+    instance()->ensurePopulated();
+
+    return instance()->_sharedDeviceIds.contains( deviceId );
 }
 
 
@@ -310,12 +450,33 @@ bool MountPoints::hasBtrfs()
 void MountPoints::ensurePopulated()
 {
     if ( _isPopulated )
-	return;
+    {
+	if ( ! mountTableChanged() )
+	    return;
+
+	logInfo() << "Mount table changed" << endl;
+	_hasBtrfs	 = false;
+	_checkedForBtrfs = false;
+
+	if ( readMountInfo() )
+	    return;
+
+	// Start over with /proc/mounts or /etc/mtab
+
+	_retiredMountPoints << _mountPointList;
+	_mountPointList.clear();
+	_mountPointMap.clear();
+	_deviceIdMap.clear();
+	_sharedDeviceIds.clear();
+	_mountedDevices.clear();
+	_mountInfoLines.clear();
+	_isPopulated = false;
+    }
 
-    read( "/proc/mounts" ) || read( "/etc/mtab" );
+    readMountInfo() || read( "/proc/mounts" ) || read( "/etc/mtab" );
 
     if ( ! _isPopulated )
-	logError() << "Could not read either /proc/mounts or /etc/mtab" << endl;
+	logError() << "Could not read any of " << MOUNT_INFO_PATH << ", /proc/mounts or /etc/mtab" << endl;
 
     _isPopulated = true;
     // dumpNormalMountPoints();
@@ -372,20 +533,7 @@ bool MountPoints::read( const QString & filename )
 	MountPoint * mountPoint = new MountPoint( device, path, fsType, mountOpts );
 	CHECK_NEW( mountPoint );
 
-	if ( ( ! mountPoint->isSystemMount() ) && isDeviceMounted( device ) )
-	{
-	    mountPoint->setDuplicate();
-	    logInfo() << "Found duplicate mount of " << device << " at " << path << endl;
-	}
-
-        if ( mountPoint->isSnapPackage() )
-        {
-            QString pkgName = path.section( "/", 1, 1, QString::SectionSkipEmpty );
-            logInfo() << "Found snap package \"" << pkgName << "\" at " << path << endl;
-        }
-
-	_mountPointList << mountPoint;
-	_mountPointMap[ path ] = mountPoint;
+	addMountPoint( mountPoint );
 	++count;
 
 	line = in.readLine();
@@ -405,6 +553,209 @@ bool MountPoints::read( const QString & filename )
 }
 
 
+bool MountPoints::readMountInfo()
+{
+    if ( _mountInfoFd < 0 )
+    {
+	// Open this only once: poll() on this file descriptor reports any
+	// change of the mount table since it was opened or last polled.
+
+	_mountInfoFd = open( MOUNT_INFO_PATH, O_RDONLY | O_CLOEXEC );
+
+	if ( _mountInfoFd < 0 )
+	{
+	    logWarning() << "Can't open " << MOUNT_INFO_PATH << ": " << formatErrno() << endl;
+	    return false;
+	}
+    }
+
+    QByteArray content;
+    char buffer[ 16 * 1024 ];
+    ssize_t len = 0;
+
+    if ( lseek( _mountInfoFd, 0, SEEK_SET ) == 0 )
+    {
+	while ( ( len = ::read( _mountInfoFd, buffer, sizeof( buffer ) ) ) != 0 )
+	{
+	    if ( len < 0 )
+	    {
+		if ( errno == EINTR )
+		    continue;
+
+		break;
+	    }
+
+	    content.append( buffer, len );
+	}
+    }
+    else
+    {
+	len = -1;
+    }
+
+    if ( len < 0 || content.isEmpty() )
+    {
+	logWarning() << "Can't read " << MOUNT_INFO_PATH << ": " << formatErrno() << endl;
+	close( _mountInfoFd );
+	_mountInfoFd = -1;
+
+	return false;
+    }
+
+    // Keep the mount points whose lines did not change (including the
+    // unique mount ID); only the others are parsed again.
+
+    QHash<QByteArray, MountPoint *> oldLines = _mountInfoLines;
+    QStringList ntfsDevices;
+    bool checkedForNtfs = false;
+    int  reused = 0;
+
+    _mountPointList.clear();
+    _mountPointMap.clear();
+    _deviceIdMap.clear();
+    _sharedDeviceIds.clear();
+    _mountedDevices.clear();
+    _mountInfoLines.clear();
+
+    foreach ( const QByteArray & line, content.split( '\n' ) )
+    {
+	if ( line.isEmpty() )
+	    continue;
+
+	MountPoint * mountPoint = oldLines.take( line );
+
+	if ( mountPoint )
+	{
+	    mountPoint->setDuplicate( false );
+	    ++reused;
+	}
+	else
+	{
+	    // File format (see also "man 5 proc"):
+	    //
+	    //	 36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+	    //
+	    // Mount ID, parent ID, major:minor, root, mount point, mount
+	    // options, any number of optional fields, a separator "-", then
+	    // filesystem type, mount source, superblock options.
+
+	    QList<QByteArray> fields = line.split( ' ' );
+	    int separator = fields.indexOf( "-", 6 );
+
+	    if ( separator < 0 || fields.size() < separator + 4 )
+	    {
+		logError() << "Bad line in " << MOUNT_INFO_PATH << ": " << line << endl;
+		continue;
+	    }
+
+	    QList<QByteArray> deviceNo = fields[2].split( ':' );
+	    QString path      = unescapeMountInfo( fields[4] );
+	    QString fsType    = unescapeMountInfo( fields[ separator + 1 ] );
+	    QString device    = unescapeMountInfo( fields[ separator + 2 ] );
+	    QString mountOpts = QString::fromUtf8( fields[5] );
+
+	    // Like /proc/mounts, show the superblock options after the mount
+	    // options, but without another "rw" or "ro".
+
+	    QStringList superOpts = QString::fromUtf8( fields[ separator + 3 ] ).split( "," );
+
+	    if ( ! superOpts.isEmpty() && ( superOpts.first() == "rw" || superOpts.first() == "ro" ) )
+		superOpts.removeFirst();
+
+	    if ( ! superOpts.isEmpty() )
+		mountOpts += "," + superOpts.join( "," );
+
+	    if ( fsType == "fuseblk" )
+	    {
+		if ( ! checkedForNtfs )
+		{
+		    ntfsDevices	   = findNtfsDevices();
+		    checkedForNtfs = true;
+		}
+
+		if ( ntfsDevices.contains( device ) )
+		    fsType = "ntfs";
+	    }
+
+	    mountPoint = new MountPoint( device, path, fsType, mountOpts );
+	    CHECK_NEW( mountPoint );
+
+	    if ( deviceNo.size() == 2 )
+		mountPoint->setDeviceId( makedev( deviceNo[0].toUInt(), deviceNo[1].toUInt() ) );
+	}
+
+	addMountPoint( mountPoint );
+	_mountInfoLines[ line ] = mountPoint;
+    }
+
+    // Somebody might still have a pointer to a mount point that is gone,
+    // so don't delete it yet.
+
+    _retiredMountPoints << oldLines.values();
+
+    if ( _mountPointList.isEmpty() )
+    {
+	logWarning() << "Not a single mount point in " << MOUNT_INFO_PATH << endl;
+	return false;
+    }
+
+    logDebug() << "Read " << _mountPointList.size() << " mount points from " << MOUNT_INFO_PATH
+	       << "; " << reused << " unchanged" << endl;
+    _isPopulated = true;
+
+    return true;
+}
+
+
+void MountPoints::addMountPoint( MountPoint * mountPoint )
+{
+    QString device = mountPoint->device();
+    QString path   = mountPoint->path();
+
+    if ( ( ! mountPoint->isSystemMount() ) && isDeviceMounted( device ) )
+    {
+	mountPoint->setDuplicate();
+	logInfo() << "Found duplicate mount of " << device << " at " << path << endl;
+    }
+
+    if ( mountPoint->isSnapPackage() )
+    {
+	QString pkgName = path.section( "/", 1, 1, QString::SectionSkipEmpty );
+	logInfo() << "Found snap package \"" << pkgName << "\" at " << path << endl;
+    }
+
+    _mountPointList << mountPoint;
+    _mountPointMap[ path ] = mountPoint;
+    _mountedDevices.insert( device );
+
+    dev_t deviceId = mountPoint->deviceId();
+
+    if ( deviceId != 0 )
+    {
+	if ( _deviceIdMap.contains( deviceId ) )
+	    _sharedDeviceIds.insert( deviceId );
+	else
+	    _deviceIdMap.insert( deviceId, mountPoint );
+    }
+}
+
+
+bool MountPoints::mountTableChanged()
+{
+    if ( _mountInfoFd < 0 )
+	return false;
+
+    struct pollfd pollInfo;
+    pollInfo.fd	     = _mountInfoFd;
+    pollInfo.events  = POLLPRI;
+    pollInfo.revents = 0;
+
+    // The kernel signals a change with POLLERR | POLLPRI
+
+    return poll( &pollInfo, 1, 0 ) > 0 && ( pollInfo.revents & ( POLLERR | POLLPRI ) );
+}
+
+
 bool MountPoints::checkForBtrfs()
 {
     ensurePopulated();
@@ -469,6 +820,18 @@ QList<MountPoint *> MountPoints::normalMountPoints()
 {
     instance()->ensurePopulated();
     QList<MountPoint *> result;
+    QList<MountPoint *> autofsMountPoints;
+
+    // Checking for unmounted autofs needs their size; get all of them at
+    // once rather than one after another.
+
+    foreach ( MountPoint * mountPoint, instance()->_mountPointList )
+    {
+	if ( mountPoint->isAutofs() )
+	    autofsMountPoints << mountPoint;
+    }
+
+    querySizes( autofsMountPoints );
 
     foreach ( MountPoint * mountPoint, instance()->_mountPointList )
     {
@@ -503,13 +866,95 @@ void MountPoints::dump()
 
 void MountPoints::reload()
 {
-    instance()->clear();
-    instance()->ensurePopulated();
+    MountPoints * mountPoints = instance();
+
+    if ( mountPoints->_mountInfoFd < 0 )
+    {
+	mountPoints->init();
+    }
+    else
+    {
+	qDeleteAll( mountPoints->_retiredMountPoints );
+	mountPoints->_retiredMountPoints.clear();
+    }
+
+    mountPoints->ensurePopulated();
 }
 
 
-#if HAVE_Q_STORAGE_INFO
-  bool MountPoints::hasSizeInfo() { return true; }
-#else
-  bool MountPoints::hasSizeInfo() { return false; }
-#endif
+bool MountPoints::hasSizeInfo()
+{
+    return true;
+}
+
+
+void MountPoints::querySizes( const QList<MountPoint *> & mountPoints,
+			      int			  timeoutMillisec )
+{
+    QList<StatfsJob *> & hungJobs = instance()->_hungJobs;
+    QStringList hungPaths;
+
+    // Clean up the jobs that finally returned
+
+    for ( int i = hungJobs.size() - 1; i >= 0; --i )
+    {
+	StatfsJob * job = hungJobs.at( i );
+
+	if ( job->isFinished() )
+	{
+	    logInfo() << "Filesystem at " << job->path << " is responding again" << endl;
+	    delete hungJobs.takeAt( i );
+	}
+	else
+	{
+	    hungPaths << job->path;
+	}
+    }
+
+    QList<MountPoint *> pending;
+    QList<StatfsJob *>	jobs;
+
+    foreach ( MountPoint * mountPoint, mountPoints )
+    {
+	if ( ! mountPoint || mountPoint->isSizeInfoFresh() || pending.contains( mountPoint ) )
+	    continue;
+
+	if ( hungPaths.contains( mountPoint->path() ) )
+	{
+	    // Don't pile up more threads that are stuck in the same place
+
+	    mountPoint->setSizeInfo( 0 );
+	    continue;
+	}
+
+	StatfsJob * job = new StatfsJob( mountPoint->path() );
+	CHECK_NEW( job );
+
+	pending << mountPoint;
+	jobs	<< job;
+	job->start();
+    }
+
+    // All jobs run at the same time, so they share one deadline
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for ( int i = 0; i < jobs.size(); ++i )
+    {
+	StatfsJob * job	 = jobs.at( i );
+	qint64 remaining = qMax( (qint64) 0, timeoutMillisec - timer.elapsed() );
+
+	if ( job->wait( (unsigned long) remaining ) )
+	{
+	    pending.at( i )->setSizeInfo( job );
+	    delete job;
+	}
+	else
+	{
+	    logWarning() << "Timeout getting the size of " << job->path << endl;
+	    pending.at( i )->setSizeInfo( 0 );
+	    hungJobs << job;
+	}
+    }
+}
@@ -10,25 +10,25 @@
 #define MountPoints_h
 
 
+#include <sys/types.h>	// dev_t
+
 #include <QString>
 #include <QStringList>
 #include <QList>
 #include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QByteArray>
 #include <QTextStream>
-
-#if (QT_VERSION < QT_VERSION_CHECK( 5, 4, 0 ))
-#  define HAVE_Q_STORAGE_INFO 0
-typedef void * QStorageInfo;
-#else
-#  define HAVE_Q_STORAGE_INFO 1
-#  include <QStorageInfo>
-#endif
+#include <QElapsedTimer>
 
 #include "FileSize.h"
 
 
 namespace QDirStat
 {
+    class StatfsJob;
+
     /**
      * Helper class to represent one mount point of a Linux/Unix filesystem.
      **/
@@ -54,6 +54,17 @@ namespace QDirStat
 	 **/
 	QString device() const { return _device; }
 
+	/**
+	 * Return the device number (major and minor) of the mounted
+	 * filesystem as in st_dev from stat(), or 0 if it is not known.
+	 **/
+	dev_t deviceId() const { return _deviceId; }
+
+	/**
+	 * Set the device number of the mounted filesystem.
+	 **/
+	void setDeviceId( dev_t deviceId ) { _deviceId = deviceId; }
+
 	/**
 	 * Return the path where the device is mounted to.
 	 **/
@@ -128,17 +139,24 @@ namespace QDirStat
         bool isSnapPackage() const;
 
 	/**
-	 * Set the 'duplicate' flag. This should only be set while /proc/mounts
-	 * or /etc/mtab is being read.
+	 * Set the 'duplicate' flag. This should only be set while the mount
+	 * table is being read.
 	 **/
 	void setDuplicate( bool dup = true ) { _isDuplicate = dup; }
 
 	/**
 	 * Return 'true' if size information for this mount point is available.
-	 * This may depend on the build OS and the Qt version.
+	 * This may depend on the build OS.
 	 **/
 	bool hasSizeInfo() const;
 
+	/**
+	 * Return 'false' if getting the size information for this mount point
+	 * timed out the last time, e.g. because of a hung NFS server. The
+	 * sizes are all -1 then.
+	 **/
+	bool isResponsive() const { return ! _sizeTimedOut; }
+
 	/**
 	 * Total size of the filesystem of this mount point.
 	 * This returns -1 if no size information is available.
@@ -151,6 +169,14 @@ namespace QDirStat
 	 **/
 	FileSize usedSize();
 
+	/**
+	 * Number of used inodes of the filesystem of this mount point, i.e.
+	 * the number of files, directories and other objects on it.
+	 * This returns -1 if that is not known, e.g. for btrfs which has no
+	 * fixed number of inodes.
+	 **/
+	qint64 usedInodes();
+
 	/**
 	 * Reserved size for root for the filesystem of this mount point.
 	 * This returns -1 if no size information is available.
@@ -172,22 +198,39 @@ namespace QDirStat
 
     protected:
 
-#if HAVE_Q_STORAGE_INFO
-        /**
-         * Lazy access to the QStorageInfo for this mount.
-         **/
-        QStorageInfo * storageInfo();
-#endif
-
-	QString	    _device;
-	QString	    _path;
-	QString	    _filesystemType;
-	QStringList _mountOptions;
-	bool	    _isDuplicate;
-
-#if HAVE_Q_STORAGE_INFO
-	QStorageInfo * _storageInfo;
-#endif
+	friend class MountPoints;
+
+	/**
+	 * Make sure the size information is up to date: Get it (with a
+	 * timeout) if it was never fetched or if it is older than a few
+	 * seconds.
+	 **/
+	void ensureSizeInfo();
+
+	/**
+	 * Return 'true' if the size information was fetched (or timed out)
+	 * only a few seconds ago.
+	 **/
+	bool isSizeInfoFresh() const;
+
+	/**
+	 * Store the result of 'job' or, if 'job' is 0, mark the size query
+	 * as timed out.
+	 **/
+	void setSizeInfo( const StatfsJob * job );
+
+	QString	      _device;
+	dev_t	      _deviceId;
+	QString	      _path;
+	QString	      _filesystemType;
+	QStringList   _mountOptions;
+	bool	      _isDuplicate;
+	FileSize      _totalSize;
+	FileSize      _freeSize;		// For root
+	FileSize      _availableSize;	// For non-privileged users
+	qint64	      _usedInodes;
+	bool	      _sizeTimedOut;
+	QElapsedTimer _sizeInfoTimer;	// Invalid until the first query
     }; // class MountPoint
 
 
@@ -223,10 +266,24 @@ namespace QDirStat
 	 * Return the mount point for 'path' if there is one or 0 if there is
 	 * not. Ownership of the returned object is not transferred to the
 	 * caller, i.e. the caller should not delete it. The pointer remains
-	 * valid until the next call to clear().
+	 * valid until the next call to clear() or reload().
 	 **/
 	static MountPoint * findByPath( const QString & path );
 
+	/**
+	 * Return the first mount point of the filesystem with device number
+	 * 'deviceId' (st_dev from stat()) or 0 if there is none. This only
+	 * works if the mount table could be read from /proc/self/mountinfo.
+	 **/
+	static MountPoint * findByDeviceId( dev_t deviceId );
+
+	/**
+	 * Return 'true' if the filesystem with device number 'deviceId' is
+	 * mounted more than once, e.g. with bind mounts. In that case, only
+	 * the path tells which of its mount points is meant.
+	 **/
+	static bool hasMultipleMounts( dev_t deviceId );
+
 	/**
 	 * Find the nearest mount point upwards in the directory hierarchy
 	 * starting from 'path'. 'path' itself might be that mount point.
@@ -244,8 +301,13 @@ namespace QDirStat
 
 	/**
 	 * Ensure the mount points are populated with the content of
-	 * /proc/mounts, falling back to /etc/mtab if /proc/mounts cannot be
-	 * read.
+	 * /proc/self/mountinfo, falling back to /proc/mounts or /etc/mtab if
+	 * that cannot be read.
+	 *
+	 * If the kernel reported a change of the mount table since it was
+	 * last read, it is read again. Mount points that did not change are
+	 * kept, so pointers to them remain valid; those that are gone are
+	 * only deleted upon the next clear() or reload().
 	 **/
 	void ensurePopulated();
 
@@ -276,8 +338,23 @@ namespace QDirStat
 	 **/
 	static bool hasSizeInfo();
 
+	/**
+	 * Get the size information for all of 'mountPoints' that don't have
+	 * current size information yet, all at the same time in separate
+	 * threads. Give up on each one that takes longer than
+	 * 'timeoutMillisec' and mark it as not responsive.
+	 *
+	 * A mount point that did not respond is not queried again until that
+	 * query finally returns.
+	 **/
+	static void querySizes( const QList<MountPoint *> & mountPoints,
+				int timeoutMillisec = 2000 );
+
         /**
-         * Clear all information and reload it from disk.
+         * Make sure the information is up to date. If changes of the mount
+         * table can be watched, this only reads it again if it changed;
+         * otherwise it clears all information and reloads it from disk.
+         *
          * NOTICE: This invalidates ALL MountPoint pointers!
          **/
         static void reload();
@@ -308,6 +385,26 @@ namespace QDirStat
 	 **/
 	bool read( const QString & filename );
 
+	/**
+	 * Read /proc/self/mountinfo and populate the mount points with its
+	 * content, keeping the existing ones for lines that did not
+	 * change. Return 'true' on success, 'false' on failure.
+	 **/
+	bool readMountInfo();
+
+	/**
+	 * Add one mount point to the lists and maps and check if it is a
+	 * duplicate.
+	 **/
+	void addMountPoint( MountPoint * mountPoint );
+
+	/**
+	 * Return 'true' if the kernel reported a change of the mount table
+	 * since the last call. This is a poll() with no timeout on the open
+	 * /proc/self/mountinfo.
+	 **/
+	bool mountTableChanged();
+
 	/**
 	 * Check if any of the mount points has filesystem type "btrfs".
 	 **/
@@ -322,7 +419,8 @@ namespace QDirStat
 	/**
 	 * Return 'true' if 'device' is mounted.
 	 **/
-	bool isDeviceMounted( const QString & device );
+	bool isDeviceMounted( const QString & device ) const
+	    { return _mountedDevices.contains( device ); }
 
 	//
 	// Data members
@@ -332,9 +430,16 @@ namespace QDirStat
 
 	QList<MountPoint *>	    _mountPointList;
 	QMap<QString, MountPoint *> _mountPointMap;
+	QHash<dev_t, MountPoint *>  _deviceIdMap;
+	QSet<dev_t>		    _sharedDeviceIds;
+	QSet<QString>		    _mountedDevices;
+	QHash<QByteArray, MountPoint *> _mountInfoLines;
+	QList<MountPoint *>	    _retiredMountPoints;
+	int			    _mountInfoFd;
 	bool			    _isPopulated;
 	bool			    _hasBtrfs;
 	bool			    _checkedForBtrfs;
+	QList<StatfsJob *>	    _hungJobs;
 
     }; // class MountPoints
 
@@ -0,0 +1,266 @@
+/*
+ *   File name: MultiPatternMatcher.cpp
+ *   Summary:	Match a string against many wildcard patterns at once
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#include "MultiPatternMatcher.h"
+#include "RuleStats.h"
+
+
+using namespace QDirStat;
+
+
+// A QRegExp keeps its match state in the object, so it can't be used in more
+// than one thread at the same time; everything else in a MultiPatternMatcher
+// is read-only when matching.
+static QMutex regExpMutex;
+
+
+MultiPatternMatcher::MultiPatternMatcher()
+{
+}
+
+
+void MultiPatternMatcher::clear()
+{
+    _patterns.clear();
+    _caseSensitiveLiterals.clear();
+    _caseInsensitiveLiterals.clear();
+    _caseSensitiveIndex.clear();
+    _caseInsensitiveIndex.clear();
+    _caseSensitiveSuffixIndex.clear();
+    _caseInsensitiveSuffixIndex.clear();
+    _unanchored.clear();
+}
+
+
+void MultiPatternMatcher::add( const QRegExp & regExp )
+{
+    Pattern pattern;
+    pattern.regExp	    = regExp;
+    pattern.caseSensitivity = regExp.caseSensitivity();
+    pattern.isLiteral	    = false;
+    pattern.isSingleStar    = false;
+
+    QString source = regExp.pattern();
+    QString specialChars;
+
+    switch ( regExp.patternSyntax() )
+    {
+	case QRegExp::FixedString:
+	    pattern.isLiteral = true;
+	    break;
+
+	case QRegExp::Wildcard:
+	    specialChars = "*?[]";
+	    break;
+
+	case QRegExp::WildcardUnix:
+	    specialChars = "*?[]\\";
+	    break;
+
+	default:	// A real regexp: No prefilter
+	    break;
+    }
+
+    if ( ! specialChars.isEmpty() )
+    {
+	int first = 0;
+	int last  = source.size() - 1;
+
+	while ( first < source.size() && ! specialChars.contains( source.at( first ) ) )
+	    ++first;
+
+	while ( last >= 0 && ! specialChars.contains( source.at( last ) ) )
+	    --last;
+
+	if ( first == source.size() )
+	    pattern.isLiteral = true;
+	else
+	{
+	    pattern.prefix	 = source.left( first );
+	    pattern.suffix	 = source.mid( last + 1 );
+	    pattern.isSingleStar = first == last && source.at( first ) == '*';
+	}
+    }
+
+    if ( pattern.isLiteral )
+	pattern.prefix = source;
+
+    int index = _patterns.size();
+    _patterns << pattern;
+
+    if ( pattern.isLiteral )
+    {
+	// Only the first one of several identical literals can ever match
+
+	if ( pattern.caseSensitivity == Qt::CaseSensitive )
+	{
+	    if ( ! _caseSensitiveLiterals.contains( source ) )
+		_caseSensitiveLiterals.insert( source, index );
+	}
+	else if ( ! _caseInsensitiveLiterals.contains( source.toLower() ) )
+	{
+	    _caseInsensitiveLiterals.insert( source.toLower(), index );
+	}
+    }
+    else if ( ! pattern.prefix.isEmpty() )
+    {
+	if ( pattern.caseSensitivity == Qt::CaseSensitive )
+	    _caseSensitiveIndex[ pattern.prefix.at( 0 ).unicode() ] << index;
+	else
+	    _caseInsensitiveIndex[ pattern.prefix.at( 0 ).toLower().unicode() ] << index;
+    }
+    else if ( ! pattern.suffix.isEmpty() )
+    {
+	QChar last = pattern.suffix.at( pattern.suffix.size() - 1 );
+
+	if ( pattern.caseSensitivity == Qt::CaseSensitive )
+	    _caseSensitiveSuffixIndex[ last.unicode() ] << index;
+	else
+	    _caseInsensitiveSuffixIndex[ last.toLower().unicode() ] << index;
+    }
+    else
+    {
+	_unanchored << index;
+    }
+}
+
+
+const QVector<int> * MultiPatternMatcher::candidates( const QHash<ushort, QVector<int> > & index,
+						      ushort				   ch )
+{
+    if ( index.isEmpty() )
+	return 0;
+
+    QHash<ushort, QVector<int> >::const_iterator it = index.constFind( ch );
+
+    return it == index.constEnd() ? 0 : &it.value();
+}
+
+
+int MultiPatternMatcher::literalMatch( const QString & str ) const
+{
+    int result = _caseSensitiveLiterals.value( str, -1 );
+
+    if ( ! _caseInsensitiveLiterals.isEmpty() )
+    {
+	int index = _caseInsensitiveLiterals.value( str.toLower(), -1 );
+
+	if ( index >= 0 && ( result < 0 || index < result ) )
+	    result = index;
+    }
+
+    return result;
+}
+
+
+bool MultiPatternMatcher::matches( const Pattern & pattern, const QString & str ) const
+{
+    if ( ! str.startsWith( pattern.prefix, pattern.caseSensitivity ) ||
+	 ! str.endsWith	 ( pattern.suffix, pattern.caseSensitivity ) )
+    {
+	return false;
+    }
+
+    // The '*' matches anything, but prefix and suffix must not overlap
+
+    if ( pattern.isSingleStar )
+	return str.size() >= pattern.prefix.size() + pattern.suffix.size();
+
+    QMutexLocker locker( &regExpMutex );
+
+    return pattern.regExp.exactMatch( str );
+}
+
+
+int MultiPatternMatcher::firstMatch( const QString & str ) const
+{
+    return findFirst( str, 0 );
+}
+
+
+int MultiPatternMatcher::firstMatch( const QString &		str,
+				     const QVector<RuleStats *> & stats ) const
+{
+    return findFirst( str, RuleStats::enabled() ? &stats : 0 );
+}
+
+
+int MultiPatternMatcher::findFirst( const QString &		   str,
+				    const QVector<RuleStats *> * stats ) const
+{
+    if ( _patterns.isEmpty() )
+	return -1;
+
+    // A literal pattern only needs a hash lookup; any other pattern can
+    // only win if it was added before that one.
+
+    RuleStatsTimer literalTimer;
+    int literal = literalMatch( str );
+    int limit	= literal >= 0 ? literal : _patterns.size();
+
+    if ( stats && literal >= 0 )
+	literalTimer.add( stats->value( literal ), true );
+
+    const QVector<int> * lists[5] = { 0, 0, 0, 0, &_unanchored };
+    int pos[5] = { 0, 0, 0, 0, 0 };
+
+    if ( ! str.isEmpty() )
+    {
+	QChar first = str.at( 0 );
+	QChar last  = str.at( str.size() - 1 );
+
+	lists[0] = candidates( _caseSensitiveIndex,	    first.unicode() );
+	lists[1] = candidates( _caseInsensitiveIndex,	    first.toLower().unicode() );
+	lists[2] = candidates( _caseSensitiveSuffixIndex,   last.unicode() );
+	lists[3] = candidates( _caseInsensitiveSuffixIndex, last.toLower().unicode() );
+    }
+
+    // Try the candidates of all lists in the order in which the patterns
+    // were added: The first match wins.
+
+    while ( true )
+    {
+	int next = -1;
+	int list = -1;
+
+	for ( int i = 0; i < 5; ++i )
+	{
+	    if ( lists[i] && pos[i] < lists[i]->size() )
+	    {
+		int index = lists[i]->at( pos[i] );
+
+		if ( next < 0 || index < next )
+		{
+		    next = index;
+		    list = i;
+		}
+	    }
+	}
+
+	if ( next < 0 || next >= limit )
+	    return literal;
+
+	++pos[ list ];
+
+	if ( stats )
+	{
+	    RuleStatsTimer timer;
+
+	    if ( timer.add( stats->value( next ), matches( _patterns.at( next ), str ) ) )
+		return next;
+	}
+	else if ( matches( _patterns.at( next ), str ) )
+	{
+	    return next;
+	}
+    }
+}
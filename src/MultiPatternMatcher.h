@@ -0,0 +1,145 @@
+/*
+ *   File name: MultiPatternMatcher.h
+ *   Summary:	Match a string against many wildcard patterns at once
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef MultiPatternMatcher_h
+#define MultiPatternMatcher_h
+
+
+#include <QString>
+#include <QRegExp>
+#include <QVector>
+#include <QHash>
+
+
+namespace QDirStat
+{
+    class RuleStats;
+
+    /**
+     * Matcher for a list of patterns that finds the first one that
+     * matches a string exactly (like QRegExp::exactMatch()) without
+     * trying each one of them.
+     *
+     * For each wildcard pattern, the literal prefix (up to the first
+     * wildcard character) and the literal suffix (after the last one) are
+     * extracted when it is added. The patterns are indexed by the first
+     * character of their prefix or, if they start with a wildcard, by the
+     * last character of their suffix, so for a string, only the patterns
+     * with a matching first or last character and those that start and end
+     * with a wildcard are candidates at all. Their prefix and suffix are
+     * compared directly, and only the patterns where both fit are confirmed
+     * with the QRegExp. That is not even necessary for patterns like
+     * "*.o" or "core*" that have only one '*' and no other wildcards.
+     *
+     * Patterns without any wildcard are looked up in a hash.
+     *
+     * Patterns that are no wildcards are always tried with the QRegExp.
+     *
+     * Matching is thread-safe, i.e. several threads may call firstMatch()
+     * at the same time as long as no patterns are added.
+     **/
+    class MultiPatternMatcher
+    {
+    public:
+
+	/**
+	 * Constructor. This creates an empty matcher.
+	 **/
+	MultiPatternMatcher();
+
+	/**
+	 * Remove all patterns.
+	 **/
+	void clear();
+
+	/**
+	 * Add 'pattern'. Its index is the number of patterns added before.
+	 **/
+	void add( const QRegExp & pattern );
+
+	/**
+	 * Return the number of patterns.
+	 **/
+	int size() const { return _patterns.size(); }
+
+	/**
+	 * Return 'true' if there are no patterns.
+	 **/
+	bool isEmpty() const { return _patterns.isEmpty(); }
+
+	/**
+	 * Return the index of the first pattern that matches all of 'str'
+	 * or -1 if none matches.
+	 **/
+	int firstMatch( const QString & str ) const;
+
+	/**
+	 * Like firstMatch(), but if counting is enabled (see RuleStats),
+	 * count each pattern that is actually tried in 'stats' (one for
+	 * each pattern in the order in which they were added; 0 for those
+	 * that should not be counted) with the time that took.
+	 **/
+	int firstMatch( const QString &		     str,
+			const QVector<RuleStats *> & stats ) const;
+
+
+    protected:
+
+	/**
+	 * The implementation of firstMatch(). 'stats' may be 0.
+	 **/
+	int findFirst( const QString &		      str,
+		       const QVector<RuleStats *> * stats ) const;
+
+	struct Pattern
+	{
+	    QRegExp		regExp;
+	    QString		prefix;
+	    QString		suffix;
+	    Qt::CaseSensitivity caseSensitivity;
+	    bool		isLiteral;	// no wildcards at all
+	    bool		isSingleStar;	// prefix + '*' + suffix
+	};
+
+	/**
+	 * Return 'true' if 'str' has the prefix and suffix of 'pattern'
+	 * and matches it.
+	 **/
+	bool matches( const Pattern & pattern, const QString & str ) const;
+
+	/**
+	 * Return the candidate list for 'ch' from 'index' or 0 if there is
+	 * none.
+	 **/
+	static const QVector<int> * candidates( const QHash<ushort, QVector<int> > & index,
+						ushort					   ch );
+
+	/**
+	 * Return the index of the first literal pattern that is the same as
+	 * 'str' or -1 if there is none.
+	 **/
+	int literalMatch( const QString & str ) const;
+
+	// Data members
+
+	QVector<Pattern>		_patterns;
+	QHash<QString, int>		_caseSensitiveLiterals;
+	QHash<QString, int>		_caseInsensitiveLiterals;	// by lowercase pattern
+	QHash<ushort, QVector<int> >	_caseSensitiveIndex;		// by first character
+	QHash<ushort, QVector<int> >	_caseInsensitiveIndex;		// by lowercase first character
+	QHash<ushort, QVector<int> >	_caseSensitiveSuffixIndex;	// by last character
+	QHash<ushort, QVector<int> >	_caseInsensitiveSuffixIndex;	// by lowercase last character
+	QVector<int>			_unanchored;			// starting and ending with a wildcard
+
+    };	// class MultiPatternMatcher
+
+}	// namespace QDirStat
+
+
+#endif // ifndef MultiPatternMatcher_h
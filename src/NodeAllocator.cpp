@@ -0,0 +1,274 @@
+/*
+ *   File name: NodeAllocator.cpp
+ *   Summary:	Slab allocator for DirTree nodes
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <new>
+
+#include <QAtomicInt>
+#include <QMutex>
+
+#include "NodeAllocator.h"
+
+
+// Chunks are aligned to their size, so the chunk of any slot can be found by
+// simply masking the slot address.
+
+#define CHUNK_SIZE	( 256 * 1024 )
+#define SLOT_ALIGN	16
+#define MAX_SLOT_SIZE	512
+#define SIZE_CLASSES	( MAX_SLOT_SIZE / SLOT_ALIGN )
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    struct FreeSlot
+    {
+	FreeSlot * next;
+    };
+
+
+    /**
+     * Header at the start of each chunk.
+     **/
+    struct Chunk
+    {
+	Chunk *	   prev;	// in the list of chunks with free slots
+	Chunk *	   next;
+	FreeSlot * freeList;	// slots that were freed again
+	char *	   bumpPos;	// next slot that was never used
+	char *	   end;
+	int	   liveCount;	// number of allocated slots
+	bool	   available;	// in the list of chunks with free slots?
+    };
+
+
+    /**
+     * All chunks for one slot size.
+     **/
+    struct SizeClass
+    {
+	Chunk * available;	// chunks that have free slots
+    };
+
+
+    SizeClass	sizeClasses[ SIZE_CLASSES ];
+    int		allocatedChunks = 0;
+    QAtomicInt	concurrentUsers;
+    QMutex	allocatorMutex;
+
+
+    inline size_t headerSize()
+    {
+	return ( sizeof( Chunk ) + SLOT_ALIGN - 1 ) & ~( (size_t) SLOT_ALIGN - 1 );
+    }
+
+
+    inline bool isFull( const Chunk * chunk, size_t slotSize )
+    {
+	return ! chunk->freeList && chunk->bumpPos + slotSize > chunk->end;
+    }
+
+
+    void addAvailable( SizeClass & sizeClass, Chunk * chunk )
+    {
+	chunk->prev = 0;
+	chunk->next = sizeClass.available;
+
+	if ( sizeClass.available )
+	    sizeClass.available->prev = chunk;
+
+	sizeClass.available = chunk;
+	chunk->available    = true;
+    }
+
+
+    void removeAvailable( SizeClass & sizeClass, Chunk * chunk )
+    {
+	if ( chunk->prev )
+	    chunk->prev->next = chunk->next;
+	else
+	    sizeClass.available = chunk->next;
+
+	if ( chunk->next )
+	    chunk->next->prev = chunk->prev;
+
+	chunk->prev	 = 0;
+	chunk->next	 = 0;
+	chunk->available = false;
+    }
+
+
+    Chunk * newChunk()
+    {
+	void * mem = 0;
+
+	if ( posix_memalign( &mem, CHUNK_SIZE, CHUNK_SIZE ) != 0 )
+	    throw std::bad_alloc();
+
+	Chunk * chunk = (Chunk *) mem;
+
+	chunk->prev	 = 0;
+	chunk->next	 = 0;
+	chunk->freeList	 = 0;
+	chunk->bumpPos	 = (char *) mem + headerSize();
+	chunk->end	 = (char *) mem + CHUNK_SIZE;
+	chunk->liveCount = 0;
+	chunk->available = false;
+
+	++allocatedChunks;
+
+	return chunk;
+    }
+
+
+    void freeChunk( Chunk * chunk )
+    {
+	free( chunk );
+	--allocatedChunks;
+    }
+
+
+    void * allocateSlot( size_t size )
+    {
+	if ( size == 0 || size > MAX_SLOT_SIZE )
+	    return ::operator new( size );
+
+	size_t	    slotSize  = ( size + SLOT_ALIGN - 1 ) & ~( (size_t) SLOT_ALIGN - 1 );
+	SizeClass & sizeClass = sizeClasses[ slotSize / SLOT_ALIGN - 1 ];
+	Chunk *	    chunk     = sizeClass.available;
+
+	if ( ! chunk )
+	{
+	    chunk = newChunk();
+	    addAvailable( sizeClass, chunk );
+	}
+
+	void * slot;
+
+	if ( chunk->freeList )
+	{
+	    slot = chunk->freeList;
+	    chunk->freeList = chunk->freeList->next;
+	}
+	else
+	{
+	    slot = chunk->bumpPos;
+	    chunk->bumpPos += slotSize;
+	}
+
+	++chunk->liveCount;
+
+	if ( isFull( chunk, slotSize ) )
+	    removeAvailable( sizeClass, chunk );
+
+	return slot;
+    }
+
+
+    void deallocateSlot( void * ptr, size_t size )
+    {
+	if ( ! ptr )
+	    return;
+
+	if ( size == 0 || size > MAX_SLOT_SIZE )
+	{
+	    ::operator delete( ptr );
+	    return;
+	}
+
+	size_t	    slotSize  = ( size + SLOT_ALIGN - 1 ) & ~( (size_t) SLOT_ALIGN - 1 );
+	SizeClass & sizeClass = sizeClasses[ slotSize / SLOT_ALIGN - 1 ];
+	Chunk *	    chunk     = (Chunk *) ( (uintptr_t) ptr & ~( (uintptr_t) CHUNK_SIZE - 1 ) );
+
+	FreeSlot * slot = (FreeSlot *) ptr;
+	slot->next	= chunk->freeList;
+	chunk->freeList = slot;
+	--chunk->liveCount;
+
+	if ( ! chunk->available )
+	    addAvailable( sizeClass, chunk );
+
+	if ( chunk->liveCount == 0 )
+	{
+	    // Return the chunk to the system, but keep the last one of this size
+	    // so a program that creates and deletes one node over and over again
+	    // doesn't allocate and free a whole chunk each time.
+
+	    if ( sizeClass.available != chunk || chunk->next )
+	    {
+		removeAvailable( sizeClass, chunk );
+		freeChunk( chunk );
+	    }
+	}
+    }
+
+}	// namespace
+
+
+void * NodeAllocator::allocate( size_t size )
+{
+    if ( concurrentUsers.loadAcquire() > 0 )
+    {
+	QMutexLocker locker( &allocatorMutex );
+	return allocateSlot( size );
+    }
+
+    return allocateSlot( size );
+}
+
+
+void NodeAllocator::deallocate( void * ptr, size_t size )
+{
+    if ( concurrentUsers.loadAcquire() > 0 )
+    {
+	QMutexLocker locker( &allocatorMutex );
+	deallocateSlot( ptr, size );
+	return;
+    }
+
+    deallocateSlot( ptr, size );
+}
+
+
+void NodeAllocator::addConcurrentUser()
+{
+    concurrentUsers.ref();
+}
+
+
+void NodeAllocator::removeConcurrentUser()
+{
+    concurrentUsers.deref();
+}
+
+
+
+int NodeAllocator::chunkCount()
+{
+    return allocatedChunks;
+}
+
+
+qint64 NodeAllocator::allocatedBytes()
+{
+    return (qint64) allocatedChunks * CHUNK_SIZE;
+}
+
+
+size_t NodeAllocator::slotSize( size_t size )
+{
+    if ( size == 0 || size > MAX_SLOT_SIZE )
+	return size;
+
+    return ( size + SLOT_ALIGN - 1 ) & ~( (size_t) SLOT_ALIGN - 1 );
+}
@@ -0,0 +1,96 @@
+/*
+ *   File name: NodeAllocator.h
+ *   Summary:	Slab allocator for DirTree nodes
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef NodeAllocator_h
+#define NodeAllocator_h
+
+
+#include <stddef.h>
+#include <QtGlobal>
+
+
+namespace QDirStat
+{
+    /**
+     * Memory allocator for FileInfo, DirInfo, DotEntry, Attic and PkgInfo
+     * objects: They are created and destroyed by the million when reading
+     * or clearing a tree, so going through the general-purpose malloc() for
+     * each of them costs a lot of time, and the per-allocation overhead of
+     * malloc() adds up to a lot of memory.
+     *
+     * This allocator gets memory in large chunks and carves them up into
+     * slots of one size per chunk. A new node simply takes the next unused
+     * slot of a chunk (bump allocation) or a slot that was freed before;
+     * deleting a node only puts its slot on the free list of its chunk.
+     * When the last node of a chunk is deleted (e.g. when a subtree is
+     * cleared for a refresh), the whole chunk is returned to the system at
+     * once.
+     *
+     * The nodes still need to be destroyed one by one since they own heap
+     * data (the name, child lists); this just makes the memory management
+     * part of that cheap.
+     *
+     * This is used via FileInfo::operator new() and operator delete(), so
+     * all classes derived from FileInfo use it automatically.
+     *
+     * Nodes are normally only created and deleted in the GUI thread, so
+     * this does not lock anything. Only while another thread deletes nodes
+     * (see addConcurrentUser()), all calls are serialized with a mutex.
+     **/
+    class NodeAllocator
+    {
+    public:
+
+	/**
+	 * Allocate 'size' bytes. Larger objects than the largest slot size
+	 * are allocated with the global operator new().
+	 **/
+	static void * allocate( size_t size );
+
+	/**
+	 * Free memory that was allocated with allocate() with the same 'size'.
+	 **/
+	static void deallocate( void * ptr, size_t size );
+
+	/**
+	 * Return the number of chunks that are currently allocated.
+	 **/
+	static int chunkCount();
+
+	/**
+	 * Return the number of bytes in all chunks that are currently
+	 * allocated.
+	 **/
+	static qint64 allocatedBytes();
+
+	/**
+	 * Return the number of bytes that allocate() really uses for an
+	 * object of 'size' bytes.
+	 **/
+	static size_t slotSize( size_t size );
+
+	/**
+	 * Announce that another thread is going to delete nodes, e.g. a
+	 * discarded tree that is destroyed in the background. Until
+	 * removeConcurrentUser() is called for that thread, allocate() and
+	 * deallocate() lock a mutex.
+	 *
+	 * Call both only from the GUI thread: addConcurrentUser() before the
+	 * other thread is started, removeConcurrentUser() after it is
+	 * finished.
+	 **/
+	static void addConcurrentUser();
+	static void removeConcurrentUser();
+
+    };	// class NodeAllocator
+
+}	// namespace QDirStat
+
+
+#endif // ifndef NodeAllocator_h
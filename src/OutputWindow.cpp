@@ -9,7 +9,8 @@
 
 #include <QApplication>
 #include <QCloseEvent>
-#include <QTimer>
+#include <QDateTime>
+#include <QFile>
 
 #include "OutputWindow.h"
 #include "Settings.h"
@@ -26,22 +27,40 @@ using QDirStat::writeFontEntry;
 #define CONNECT_ACTION(ACTION, RECEIVER, RCVR_SLOT) \
     connect( (ACTION), SIGNAL( triggered() ), (RECEIVER), SLOT( RCVR_SLOT ) )
 
+// Output that is not added to the output area yet: Beyond this, the oldest
+// output is dropped. It would scroll out of the output area anyway.
+#define MAX_PENDING_CHARS	( 1024 * 1024 )
+
 
 OutputWindow::OutputWindow( QWidget * parent ):
     QDialog( parent ),
     _ui( new Ui::OutputWindow ),
+    _maxParallel( 1 ),
+    _failFast( false ),
     _showOnStderr( true ),
     _noMoreProcesses( false ),
     _closed( false ),
     _killedAll( false ),
-    _errorCount( 0 )
+    _errorCount( 0 ),
+    _logFile( 0 ),
+    _pendingChars( 0 ),
+    _skippedChars( 0 )
 {
     _ui->setupUi( this );
     logDebug() << "Creating" << endl;
     readSettings();
 
     _ui->terminal->clear();
+    _ui->terminal->setUndoRedoEnabled( false );	// Don't keep all output twice
+    _ui->terminal->document()->setMaximumBlockCount( _maxLines );
     setAutoClose( false );
+    openLogFile();
+
+    _flushTimer.setSingleShot( true );
+    _flushTimer.setInterval( _refreshInterval );
+
+    connect( &_flushTimer, SIGNAL( timeout()   ),
+	     this,	   SLOT	 ( flushText() ) );
 
     CONNECT_ACTION( _ui->actionZoomIn,	    this, zoomIn()    );
     CONNECT_ACTION( _ui->actionZoomOut,	    this, zoomOut()   );
@@ -66,6 +85,12 @@ OutputWindow::~OutputWindow()
 	qDeleteAll( _processList );
     }
 
+    // Finished, but their output was never shown
+    qDeleteAll( _finishedProcesses );
+
+    if ( _logFile )
+	delete _logFile; // This also closes it
+
     writeSettings();
     delete _ui;
 }
@@ -98,8 +123,7 @@ void OutputWindow::addProcess( Process * process )
     connect( process, SIGNAL( finished	     ( int, QProcess::ExitStatus ) ),
 	     this,    SLOT  ( processFinished( int, QProcess::ExitStatus ) ) );
 
-    if ( ! hasActiveProcess() )
-	startNextProcess();
+    startProcesses();
 }
 
 
@@ -116,9 +140,15 @@ void OutputWindow::addStdout( const QString output )
 
 
 void OutputWindow::addStderr( const QString output )
+{
+    addProcessStderr( 0, output );
+}
+
+
+void OutputWindow::addProcessStderr( Process * process, const QString & output )
 {
     _errorCount++;
-    addText( output, _stderrColor );
+    addProcessText( process, output, _stderrColor );
     logWarning() << output << ( output.endsWith( "\n" ) ? "" : "\n" );
 
     if ( _showOnStderr && ! isVisible() && ! _closed )
@@ -136,18 +166,139 @@ void OutputWindow::addText( const QString & rawText, const QColor & textColor )
     if ( ! text.endsWith( "\n" ) )
 	text += "\n";
 
+    if ( _logFile )
+	_logFile->write( text.toUtf8() );
+
+    // Merge with the previous text if possible: Each chunk will need its
+    // own insertText() call.
+
+    if ( ! _pendingText.isEmpty() && _pendingText.last().second == textColor )
+	_pendingText.last().first += text;
+    else
+	_pendingText << qMakePair( text, textColor );
+
+    _pendingChars += text.size();
+
+    while ( _pendingChars > MAX_PENDING_CHARS && _pendingText.size() > 1 )
+    {
+	int size = _pendingText.takeFirst().first.size();
+	_pendingChars -= size;
+	_skippedChars += size;
+    }
+
+    if ( ! _flushTimer.isActive() )
+	_flushTimer.start();
+}
+
+
+void OutputWindow::flushText()
+{
+    if ( _pendingText.isEmpty() )
+	return;
+
+    QTextCursor cursor( _ui->terminal->document() );
+    cursor.movePosition( QTextCursor::End );
+    cursor.beginEditBlock();
+
+    if ( _skippedChars > 0 )
+    {
+	QTextCharFormat format;
+	format.setForeground( QBrush( _commandTextColor ) );
+	cursor.insertText( tr( "[%1 characters of output skipped]" ).arg( _skippedChars ) + "\n", format );
+	_skippedChars = 0;
+    }
+
+    typedef QPair<QString, QColor> TextPair;
+
+    foreach ( const TextPair & chunk, _pendingText )
+    {
+	QTextCharFormat format;
+	format.setForeground( QBrush( chunk.second ) );
+	cursor.insertText( chunk.first, format );
+    }
+
+    cursor.endEditBlock();
+
+    _pendingText.clear();
+    _pendingChars = 0;
+
+    if ( _logFile )
+	_logFile->flush();
+
     _ui->terminal->moveCursor( QTextCursor::End );
-    QTextCursor cursor( _ui->terminal->textCursor() );
+    _ui->terminal->ensureCursorVisible();
+}
+
 
-    QTextCharFormat format;
-    format.setForeground( QBrush( textColor ) );
-    cursor.setCharFormat( format );
-    cursor.insertText( text );
+void OutputWindow::openLogFile()
+{
+    if ( _logFileName.isEmpty() )
+	return;
+
+    _logFile = new QFile( _logFileName );
+    CHECK_NEW( _logFile );
+
+    if ( ! _logFile->open( QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text ) )
+    {
+	logError() << "Can't open log file " << _logFileName << endl;
+	delete _logFile;
+	_logFile = 0;
+
+	return;
+    }
+
+    QString header = QString( "\n=== %1 ===\n" )
+	.arg( QDateTime::currentDateTime().toString( Qt::ISODate ) );
+
+    _logFile->write( header.toUtf8() );
+}
+
+
+void OutputWindow::addProcessText( Process *	    process,
+				   const QString &  text,
+				   const QColor &   textColor )
+{
+    if ( ! process || _outputOrder.isEmpty() || _outputOrder.first() == process ||
+	 ! _outputOrder.contains( process ) )
+    {
+	addText( text, textColor );
+    }
+    else
+    {
+	_heldBackOutput[ process ] << qMakePair( text, textColor );
+    }
+}
+
+
+void OutputWindow::flushOutput()
+{
+    while ( ! _outputOrder.isEmpty() )
+    {
+	Process * process = _outputOrder.first();
+
+	if ( _heldBackOutput.contains( process ) )
+	{
+	    typedef QPair<QString, QColor> TextPair;
+
+	    foreach ( const TextPair & output, _heldBackOutput.take( process ) )
+		addText( output.first, output.second );
+	}
+
+	if ( ! _finishedProcesses.contains( process ) )
+	    break;
+
+	_outputOrder.removeFirst();
+	_finishedProcesses.remove( process );
+	process->deleteLater();
+    }
 }
 
 
 void OutputWindow::clearOutput()
 {
+    _pendingText.clear();
+    _pendingChars = 0;
+    _skippedChars = 0;
     _ui->terminal->clear();
 }
 
@@ -179,7 +330,7 @@ void OutputWindow::readStdout()
     Process * process = senderProcess( __FUNCTION__ );
 
     if ( process )
-	addStdout( QString::fromUtf8( process->readAllStandardOutput() ) );
+	addProcessText( process, QString::fromUtf8( process->readAllStandardOutput() ), _stdoutColor );
 }
 
 
@@ -188,17 +339,21 @@ void OutputWindow::readStderr()
     Process * process = senderProcess( __FUNCTION__ );
 
     if ( process )
-	addStderr( QString::fromUtf8( process->readAllStandardError() ) );
+	addProcessStderr( process, QString::fromUtf8( process->readAllStandardError() ) );
 }
 
 
 void OutputWindow::processFinished( int exitCode, QProcess::ExitStatus exitStatus )
 {
+    Process * process = senderProcess( __FUNCTION__ );
+    bool failed = true;
+
     switch ( exitStatus )
     {
 	case QProcess::NormalExit:
 	    logDebug() << "Process finished normally." << endl;
-	    addCommandLine( tr( "Process finished." ) );
+	    addProcessText( process, tr( "Process finished." ), _commandTextColor );
+	    failed = exitCode != 0;
 	    break;
 
 	case QProcess::CrashExit:
@@ -211,38 +366,29 @@ void OutputWindow::processFinished( int exitCode, QProcess::ExitStatus exitStatu
 		// crashed or could not be started.
 
 		logError() << "Process crashed." << endl;
-		addStderr( tr( "Process crashed." ) );
+		addProcessStderr( process, tr( "Process crashed." ) );
 	    }
 	    else
 	    {
 		logError() << "Process crashed. Exit code: " << exitCode << endl;
-		addStderr( tr( "Process crashed. Exit code: %1" ).arg( exitCode ) );
+		addProcessStderr( process, tr( "Process crashed. Exit code: %1" ).arg( exitCode ) );
 	    }
 	    break;
     }
 
-    Process * process = senderProcess( __FUNCTION__ );
-
     if ( process )
     {
-	_processList.removeAll( process );
-
-	if ( _processList.isEmpty() && _noMoreProcesses )
-	{
-	    logDebug() << "Emitting lastProcessFinished() err: " << _errorCount << endl;
-	    emit lastProcessFinished( _errorCount );
-	}
-
-	process->deleteLater();
+	processDone( process, failed );
 	closeIfDone();
     }
 
-    startNextProcess(); // this also calls updateActions()
+    startProcesses(); // this also calls updateActions()
 }
 
 
 void OutputWindow::processError( QProcess::ProcessError error )
 {
+    Process * process = senderProcess( __FUNCTION__ );
     QString msg;
 
     switch ( error )
@@ -274,28 +420,72 @@ void OutputWindow::processError( QProcess::ProcessError error )
     if ( ! msg.isEmpty() )
     {
 	logError() << msg << endl;
-	addStderr( msg );
+	addProcessStderr( process, msg );
     }
 
-    Process * process = senderProcess( __FUNCTION__ );
+    // A crashed process is also reported via processFinished()
 
-    if ( process )
+    if ( process && error != QProcess::Crashed )
+	processDone( process, true );
+
+    startProcesses(); // this also calls updateActions()
+
+    if ( ! _showOnStderr && ! isVisible() )
+	closeIfDone();
+}
+
+
+void OutputWindow::processDone( Process * process, bool failed )
+{
+    if ( ! _processList.contains( process ) )
+	return; // Already done
+
+    _processList.removeAll( process );
+
+    if ( _outputOrder.contains( process ) )
+	_finishedProcesses.insert( process );
+    else
+	process->deleteLater();
+
+    if ( failed && _failFast )
     {
-	_processList.removeAll( process );
+	// Let the processes that are already running finish, but don't start
+	// any more.
+
+	int dropped = dropQueuedProcesses();
 
-	if ( _processList.isEmpty() && _noMoreProcesses )
+	if ( dropped > 0 )
 	{
-	    logDebug() << "Emitting lastProcessFinished() err: " << _errorCount << endl;
-	    emit lastProcessFinished( _errorCount );
+	    logWarning() << "Not starting " << dropped << " more processes after an error" << endl;
+	    addProcessStderr( process, tr( "Not starting %1 more processes after an error." ).arg( dropped ) );
 	}
+    }
 
-	process->deleteLater();
+    flushOutput();
+
+    if ( _processList.isEmpty() && _noMoreProcesses )
+    {
+	logDebug() << "Emitting lastProcessFinished() err: " << _errorCount << endl;
+	emit lastProcessFinished( _errorCount );
     }
+}
 
-    startNextProcess(); // this also calls updateActions()
 
-    if ( ! _showOnStderr && ! isVisible() )
-	closeIfDone();
+int OutputWindow::dropQueuedProcesses()
+{
+    int count = 0;
+
+    foreach ( Process * process, _processList )
+    {
+	if ( process->state() == QProcess::NotRunning && ! _outputOrder.contains( process ) )
+	{
+	    _processList.removeAll( process );
+	    process->deleteLater();
+	    ++count;
+	}
+    }
+
+    return count;
 }
 
 
@@ -371,6 +561,27 @@ void OutputWindow::killAll()
 {
     int killCount = 0;
 
+    // Show all output that was held back so far in the right order; from
+    // now on, there is no more order to keep.
+
+    foreach ( Process * process, _outputOrder )
+    {
+	if ( _heldBackOutput.contains( process ) )
+	{
+	    typedef QPair<QString, QColor> TextPair;
+
+	    foreach ( const TextPair & output, _heldBackOutput.take( process ) )
+		addText( output.first, output.second );
+	}
+
+	if ( _finishedProcesses.contains( process ) )
+	    process->deleteLater();
+    }
+
+    _outputOrder.clear();
+    _finishedProcesses.clear();
+    _heldBackOutput.clear();
+
     foreach ( Process * process, _processList )
     {
 	logInfo() << "Killing process " << process << endl;
@@ -412,11 +623,28 @@ bool OutputWindow::hasActiveProcess() const
 }
 
 
+int OutputWindow::activeProcessCount() const
+{
+    int count = 0;
+
+    foreach ( Process * process, _processList )
+    {
+	if ( process->state() == QProcess::Starting ||
+	     process->state() == QProcess::Running )
+	{
+	    ++count;
+	}
+    }
+
+    return count;
+}
+
+
 Process * OutputWindow::pickQueuedProcess()
 {
     foreach ( Process * process, _processList )
     {
-	if ( process->state() == QProcess::NotRunning )
+	if ( process->state() == QProcess::NotRunning && ! _outputOrder.contains( process ) )
 	    return process;
     }
 
@@ -430,15 +658,16 @@ Process * OutputWindow::startNextProcess()
 
     if ( process )
     {
+	_outputOrder << process;
 	QString dir = process->workingDirectory();
 
 	if ( dir != _lastWorkingDir )
 	{
-	    addCommandLine( "cd " + dir );
+	    addProcessText( process, "cd " + dir, _commandTextColor );
 	    _lastWorkingDir = dir;
 	}
 
-	addCommandLine( command( process ) );
+	addProcessText( process, command( process ), _commandTextColor );
 	logInfo() << "Starting: " << process << endl;
 
 	process->start();
@@ -451,14 +680,32 @@ Process * OutputWindow::startNextProcess()
 }
 
 
+void OutputWindow::startProcesses()
+{
+    while ( activeProcessCount() < _maxParallel )
+    {
+	if ( ! startNextProcess() )
+	    break;
+    }
+
+    updateActions();
+}
+
+
 QString OutputWindow::command( Process * process )
 {
     // The common case is to start an external command with
     //	  /bin/sh -c theRealCommand arg1 arg2 arg3 ...
     QStringList args = process->arguments();
 
-    if ( ! args.isEmpty() )
-	args.removeFirst();		// Remove the "-c"
+    if ( args.isEmpty() || args.first() != "-c" )
+    {
+	// Started directly without a shell
+
+	return ( QStringList() << process->program() << args ).join( " " );
+    }
+
+    args.removeFirst();			// Remove the "-c"
 
     if ( args.isEmpty() )		// Nothing left?
 	return process->program();	// Ok, use the program name
@@ -526,6 +773,9 @@ void OutputWindow::readSettings()
     _stderrColor	 = readColorEntry( settings, "StdErrTextColor"	 , QColor( Qt::red    ) );
     _terminalDefaultFont = readFontEntry ( settings, "TerminalFont"	 , _ui->terminal->font() );
     _defaultShowTimeout	 = settings.value( "DefaultShowTimeoutMillisec", 500 ).toInt();
+    _maxLines		 = settings.value( "MaxLines"			, 20000 ).toInt();
+    _refreshInterval	 = settings.value( "RefreshIntervalMillisec"	, 100 ).toInt();
+    _logFileName	 = settings.value( "LogFile" ).toString();
 
     settings.endGroup();
 
@@ -544,6 +794,9 @@ void OutputWindow::writeSettings()
     writeColorEntry( settings, "StdErrTextColor"   , _stderrColor	  );
     writeFontEntry ( settings, "TerminalFont"	   , _terminalDefaultFont );
     settings.setValue( "DefaultShowTimeoutMillisec", _defaultShowTimeout  );
+    settings.setValue( "MaxLines"		   , _maxLines		  );
+    settings.setValue( "RefreshIntervalMillisec"   , _refreshInterval	  );
+    settings.setValue( "LogFile"		   , _logFileName	  );
 
     settings.endGroup();
 }
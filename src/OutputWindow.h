@@ -10,7 +10,10 @@
 #define OutputWindow_h
 
 #include <QDialog>
+#include <QTimer>
 #include <QList>
+#include <QHash>
+#include <QSet>
 #include <QTextStream>
 #include <QStringList>
 
@@ -18,6 +21,7 @@
 #include "Process.h"
 
 class QCloseEvent;
+class QFile;
 using QDirStat::Process;
 
 
@@ -28,8 +32,16 @@ using QDirStat::Process;
  *
  * This class can watch more than one process: It can watch a sequence of
  * processes, such as QDirStat cleanup actions as they are invoked for each
- * selected item one after another, or even multiple processes running in
- * parallel (which may make the output a bit messy, of course).
+ * selected item one after another, or up to maxParallel() processes running
+ * in parallel. In that case, the output of each process is held back until
+ * all processes that were started before it are finished, so the output
+ * still appears in the order the processes were started.
+ *
+ * Output is not added to the output area right away, but collected and
+ * added every few milliseconds in one go, and the output area only keeps
+ * the last lines (see the "MaxLines" setting). So even processes with
+ * megabytes of output can't slow down the user interface. The complete
+ * output can be written to a log file as well (see the "LogFile" setting).
  *
  * If this dialog is created, but now shown, it will (by default) show itself
  * as soon as there is any output on stderr.
@@ -57,6 +69,29 @@ public:
      **/
     void addProcess( Process * process );
 
+    /**
+     * Return the maximum number of processes running in parallel.
+     * The default is 1, i.e. one process after another.
+     **/
+    int maxParallel() const { return _maxParallel; }
+
+    /**
+     * Set the maximum number of processes running in parallel.
+     **/
+    void setMaxParallel( int maxParallel ) { _maxParallel = qMax( 1, maxParallel ); }
+
+    /**
+     * Return 'true' if no more processes are started after a process
+     * failed (crashed or returned a non-zero exit code). The processes
+     * that are already running are not killed. The default is 'false'.
+     **/
+    bool failFast() const { return _failFast; }
+
+    /**
+     * Set if no more processes should be started after a process failed.
+     **/
+    void setFailFast( bool failFast ) { _failFast = failFast; }
+
     /**
      * Tell this dialog that no more processes will be added, so when the last
      * one is finished and the "auto close" checkbox is checked, it may close
@@ -173,6 +208,11 @@ public:
      **/
     bool hasActiveProcess() const;
 
+    /**
+     * Return the number of processes that are currently running.
+     **/
+    int activeProcessCount() const;
+
     /**
      * Get the command of the process. Since usually processes are started via
      * a shell ("/bin/sh -c theRealCommand arg1 arg2 ..."), this is typically
@@ -229,6 +269,12 @@ public slots:
 
 protected slots:
 
+    /**
+     * Add all output that was collected since the last time to the output
+     * area.
+     **/
+    void flushText();
+
     /**
      * Read output on one of the watched process's stdout channel.
      **/
@@ -303,10 +349,16 @@ protected:
 
     /**
      * Add one or more lines of text in text color 'textColor' to the output
-     * area.
+     * area. This only collects the text; it is added to the output area
+     * with the next flushText().
      **/
     void addText( const QString & text, const QColor & textColor );
 
+    /**
+     * Open the log file if one is configured.
+     **/
+    void openLogFile();
+
     /**
      * Obtain the process to use from sender(). Return 0 if this is not a
      * QProcess.
@@ -325,6 +377,41 @@ protected:
      **/
     Process * startNextProcess();
 
+    /**
+     * Start inactive processes until maxParallel() processes are running.
+     **/
+    void startProcesses();
+
+    /**
+     * Add text from 'process' (or about it) to the output area, or hold
+     * it back if any process that was started before it still runs.
+     **/
+    void addProcessText( Process * process, const QString & text, const QColor & textColor );
+
+    /**
+     * Notification that 'process' is finished: 'failed' is 'true' if it
+     * crashed, could not be started or returned a non-zero exit code.
+     * Emit lastProcessFinished() if that was the last one.
+     **/
+    void processDone( Process * process, bool failed );
+
+    /**
+     * Add stderr output from 'process' and show the window if configured.
+     * 'process' may be 0 for errors that don't belong to any process.
+     **/
+    void addProcessStderr( Process * process, const QString & output );
+
+    /**
+     * Show the output that was held back for the first processes that were
+     * started as long as they are finished, and delete them.
+     **/
+    void flushOutput();
+
+    /**
+     * Remove all processes that were not started yet. Return their number.
+     **/
+    int dropQueuedProcesses();
+
     /**
      * Zoom the terminal font by the specified factor.
      **/
@@ -337,6 +424,11 @@ protected:
 
     Ui::OutputWindow  * _ui;
     QList<Process *>	_processList;
+    QList<Process *>	_outputOrder;	// Started, but output not complete yet
+    QSet<Process *>	_finishedProcesses;
+    QHash<Process *, QList<QPair<QString, QColor> > > _heldBackOutput;
+    int			_maxParallel;
+    bool		_failFast;
     bool		_showOnStderr;
     bool		_noMoreProcesses;
     bool		_closed;
@@ -349,6 +441,14 @@ protected:
     QColor		_stderrColor;
     QFont		_terminalDefaultFont;
     int			_defaultShowTimeout;
+    int			_maxLines;
+    int			_refreshInterval;
+    QString		_logFileName;
+    QFile *		_logFile;
+    QTimer		_flushTimer;
+    QList<QPair<QString, QColor> > _pendingText;
+    int			_pendingChars;
+    int			_skippedChars;
 
 };	// class OutputWindow
 
@@ -0,0 +1,71 @@
+/*
+ *   File name: OwnerStats.cpp
+ *   Summary:	Disk usage per user and group for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "OwnerStats.h"
+
+
+using namespace QDirStat;
+
+
+void OwnerSummary::addItem( FileInfo * item, int sign )
+{
+    uint uid = item->hasUid() ? (uint) item->uid() : UNKNOWN_OWNER_ID;
+    uint gid = item->hasGid() ? (uint) item->gid() : UNKNOWN_OWNER_ID;
+
+    add( _users,  uid, sign, sign * item->size() );
+    add( _groups, gid, sign, sign * item->size() );
+}
+
+
+void OwnerSummary::add( const OwnerSummary & other, int sign )
+{
+    foreach ( const Entry & entry, other._users )
+	add( _users, entry.id, sign * entry.items, sign * entry.size );
+
+    foreach ( const Entry & entry, other._groups )
+	add( _groups, entry.id, sign * entry.items, sign * entry.size );
+}
+
+
+void OwnerSummary::add( QVector<Entry> & entries, uint id, int items, FileSize size )
+{
+    // Binary search for the entry
+
+    int first = 0;
+    int last  = entries.size();
+
+    while ( first < last )
+    {
+	int mid = ( first + last ) / 2;
+
+	if ( entries.at( mid ).id < id )
+	    first = mid + 1;
+	else
+	    last = mid;
+    }
+
+    if ( first < entries.size() && entries.at( first ).id == id )
+    {
+	Entry & entry = entries[ first ];
+	entry.items += items;
+	entry.size  += size;
+
+	if ( entry.items <= 0 )
+	    entries.remove( first );
+    }
+    else if ( items > 0 )
+    {
+	Entry entry;
+	entry.id    = id;
+	entry.items = items;
+	entry.size  = size;
+
+	entries.insert( first, entry );
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ *   File name: OwnerStats.h
+ *   Summary:	Disk usage per user and group for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef OwnerStats_h
+#define OwnerStats_h
+
+#include <QVector>
+
+#include "FileInfo.h"
+
+
+// Owner ID for items without owner information (e.g. read from a cache file)
+#define UNKNOWN_OWNER_ID	( (uint) -1 )
+
+
+namespace QDirStat
+{
+    /**
+     * Compact summary of the owners of the items in a directory subtree for
+     * DirInfo::ownerSummary(): The number and the total size of the items
+     * for each user ID and for each group ID. Only the IDs that own any
+     * items are stored, sorted by ID; most subtrees only have a handful of
+     * them.
+     *
+     * Like FileAgeSummary, the summary of a directory is the sum of the
+     * summaries of its subdirectories plus its own items, so it can be
+     * updated when items or subtrees are added or removed.
+     **/
+    class OwnerSummary
+    {
+    public:
+
+	struct Entry
+	{
+	    uint	id;
+	    int		items;
+	    FileSize	size;
+	};
+
+	/**
+	 * Add 'item' (without its children) if 'sign' is 1 or subtract it if
+	 * it is -1.
+	 **/
+	void addItem( FileInfo * item, int sign = 1 );
+
+	/**
+	 * Add all of 'other' if 'sign' is 1 or subtract it if it is -1.
+	 **/
+	void add( const OwnerSummary & other, int sign = 1 );
+
+	/**
+	 * Return the entries for the users and the groups sorted by ID.
+	 **/
+	const QVector<Entry> & users()	const { return _users;	}
+	const QVector<Entry> & groups() const { return _groups; }
+
+	/**
+	 * Return the memory used for the entries.
+	 **/
+	qint64 entriesMemory() const
+	    { return ( _users.capacity() + _groups.capacity() ) * sizeof( Entry ); }
+
+    protected:
+
+	/**
+	 * Add 'items' and 'size' to the entry for 'id' in 'entries'. Entries
+	 * that have no items left are removed.
+	 **/
+	static void add( QVector<Entry> & entries, uint id, int items, FileSize size );
+
+	QVector<Entry>	_users;
+	QVector<Entry>	_groups;
+
+    };	// class OwnerSummary
+
+}	// namespace QDirStat
+
+
+#endif // ifndef OwnerStats_h
@@ -0,0 +1,190 @@
+/*
+ *   File name: OwnerStatsWindow.cpp
+ *   Summary:	QDirStat "disk usage per owner" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <pwd.h>	// getpwuid()
+#include <grp.h>	// getgrgid()
+
+#include "OwnerStatsWindow.h"
+#include "DirInfo.h"
+#include "SettingsHelpers.h"
+#include "HeaderTweaker.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+using namespace QDirStat;
+
+
+OwnerStatsWindow::OwnerStatsWindow( QWidget * parent ):
+    QDialog( parent ),
+    _ui( new Ui::OwnerStatsWindow )
+{
+    // logDebug() << "init" << endl;
+
+    CHECK_NEW( _ui );
+    _ui->setupUi( this );
+    initWidgets();
+    readWindowSettings( this, "OwnerStatsWindow" );
+
+    connect( _ui->refreshButton, SIGNAL( clicked() ),
+	     this,		 SLOT  ( refresh() ) );
+}
+
+
+OwnerStatsWindow::~OwnerStatsWindow()
+{
+    // logDebug() << "destroying" << endl;
+
+    writeWindowSettings( this, "OwnerStatsWindow" );
+    delete _ui;
+}
+
+
+void OwnerStatsWindow::clear()
+{
+    _ui->treeWidget->clear();
+    _ui->totalLabel->clear();
+}
+
+
+void OwnerStatsWindow::initWidgets()
+{
+    QFont font = _ui->heading->font();
+    font.setBold( true );
+    _ui->heading->setFont( font );
+
+    QStringList headerLabels;
+    headerLabels << tr( "Owner" )
+		 << tr( "Type"	)
+		 << tr( "Items" )
+		 << tr( "Size"	)
+		 << tr( "%"	);
+
+    _ui->treeWidget->setColumnCount( headerLabels.size() );
+    _ui->treeWidget->setHeaderLabels( headerLabels );
+    _ui->treeWidget->setRootIsDecorated( false );
+    _ui->treeWidget->setSortingEnabled( true );
+    _ui->treeWidget->sortByColumn( OS_SizeCol, Qt::DescendingOrder );
+    _ui->treeWidget->header()->setStretchLastSection( false );
+    HeaderTweaker::resizeToContents( _ui->treeWidget->header() );
+
+    QTreeWidgetItem * headerItem = _ui->treeWidget->headerItem();
+
+    for ( int col = OS_TypeCol; col <= OS_PercentCol; ++col )
+	headerItem->setTextAlignment( col, Qt::AlignHCenter );
+}
+
+
+void OwnerStatsWindow::reject()
+{
+    deleteLater();
+}
+
+
+void OwnerStatsWindow::populate( FileInfo * newSubtree )
+{
+    _subtree = newSubtree;
+    refresh();
+}
+
+
+void OwnerStatsWindow::refresh()
+{
+    clear();
+
+    FileInfo * subtree = _subtree();
+
+    if ( ! subtree || ! subtree->isDirInfo() )
+	return;
+
+    _ui->heading->setText( tr( "Disk Usage per Owner in %1" ).arg( subtree->url() ) );
+
+    const OwnerSummary * summary = subtree->toDirInfo()->ownerSummary();
+
+    // Every item has exactly one user, so this is the total of the summary
+
+    FileSize totalSize = 0;
+
+    foreach ( const OwnerSummary::Entry & entry, summary->users() )
+	totalSize += entry.size;
+
+    foreach ( const OwnerSummary::Entry & entry, summary->users() )
+	new OwnerStatsItem( entry, false, totalSize, _ui->treeWidget );
+
+    foreach ( const OwnerSummary::Entry & entry, summary->groups() )
+	new OwnerStatsItem( entry, true, totalSize, _ui->treeWidget );
+
+    _ui->totalLabel->setText( tr( "%1 users  %2 groups  Total: %3" )
+			      .arg( summary->users().size() )
+			      .arg( summary->groups().size() )
+			      .arg( formatSize( totalSize ) ) );
+}
+
+
+
+
+OwnerStatsItem::OwnerStatsItem( const OwnerSummary::Entry & entry,
+				bool			    isGroup,
+				FileSize		    totalSize,
+				QTreeWidget		  * parent ):
+    QTreeWidgetItem( parent ),
+    _entry( entry )
+{
+    QString blanks = QString( 3, ' ' ); // Enforce left margin
+    float percent  = totalSize > 0 ? 100.0 * entry.size / totalSize : 0.0;
+
+    setText( OS_NameCol,    ownerName( entry.id, isGroup ) + "    " );
+    setText( OS_TypeCol,    blanks + ( isGroup ? QObject::tr( "group" ) : QObject::tr( "user" ) ) );
+    setText( OS_ItemsCol,   blanks + QString::number( entry.items ) );
+    setText( OS_SizeCol,    blanks + formatSize( entry.size ) );
+    setText( OS_PercentCol, blanks + formatPercent( percent ) );
+
+    for ( int col = OS_ItemsCol; col <= OS_PercentCol; ++col )
+	setTextAlignment( col, Qt::AlignRight );
+}
+
+
+QString OwnerStatsItem::ownerName( uint id, bool isGroup )
+{
+    if ( id == UNKNOWN_OWNER_ID )
+	return QObject::tr( "<unknown>" );
+
+    if ( isGroup )
+    {
+	struct group * grp = getgrgid( id );
+
+	if ( grp )
+	    return grp->gr_name;
+    }
+    else
+    {
+	struct passwd * pw = getpwuid( id );
+
+	if ( pw )
+	    return pw->pw_name;
+    }
+
+    return QString::number( id );
+}
+
+
+bool OwnerStatsItem::operator<( const QTreeWidgetItem & rawOther ) const
+{
+    const OwnerStatsItem & other = dynamic_cast<const OwnerStatsItem &>( rawOther );
+
+    int col = treeWidget() ? treeWidget()->sortColumn() : OS_SizeCol;
+
+    switch ( col )
+    {
+	case OS_ItemsCol:	return entry().items < other.entry().items;
+	case OS_SizeCol:
+	case OS_PercentCol:	return entry().size  < other.entry().size;
+	default:		return QTreeWidgetItem::operator<( rawOther );
+    }
+}
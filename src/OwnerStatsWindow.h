@@ -0,0 +1,157 @@
+/*
+ *   File name: OwnerStatsWindow.h
+ *   Summary:	QDirStat "disk usage per owner" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef OwnerStatsWindow_h
+#define OwnerStatsWindow_h
+
+#include <QDialog>
+#include <QTreeWidgetItem>
+
+#include "ui_owner-stats-window.h"
+#include "OwnerStats.h"
+#include "Subtree.h"
+
+
+namespace QDirStat
+{
+    /**
+     * Modeless dialog to display which users and which groups own how much
+     * of a subtree.
+     *
+     * This uses DirInfo::ownerSummary(), so only the first query after
+     * reading a tree needs to traverse it; the summaries are kept up to
+     * date when the tree changes, so switching to another directory in the
+     * same tree is instant.
+     **/
+    class OwnerStatsWindow: public QDialog
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 *
+	 * Notice that this widget will destroy itself upon window close.
+	 *
+	 * It is advised to use a QPointer for storing a pointer to an instance
+	 * of this class. The QPointer will keep track of this window
+	 * auto-deleting itself when closed.
+	 **/
+	OwnerStatsWindow( QWidget * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~OwnerStatsWindow();
+
+	/**
+	 * Obtain the subtree from the last used URL or 0 if none was found.
+	 **/
+	const Subtree & subtree() const { return _subtree; }
+
+
+    public slots:
+
+	/**
+	 * Populate the window: Show the owners of the items in 'subtree'.
+	 **/
+	void populate( FileInfo * subtree = 0 );
+
+	/**
+	 * Refresh (reload) all data.
+	 **/
+	void refresh();
+
+	/**
+	 * Reject the dialog contents, i.e. the user clicked the "Cancel" or
+	 * WM_CLOSE button. This not only closes the dialog, it also deletes
+	 * it.
+	 *
+	 * Reimplemented from QDialog.
+	 **/
+	virtual void reject() Q_DECL_OVERRIDE;
+
+
+    protected:
+
+	/**
+	 * Clear all data and widget contents.
+	 **/
+	void clear();
+
+	/**
+	 * One-time initialization of the widgets in this window.
+	 **/
+	void initWidgets();
+
+
+	//
+	// Data members
+	//
+
+	Ui::OwnerStatsWindow *	_ui;
+	Subtree			_subtree;
+    };
+
+
+    /**
+     * Column numbers for the owner stats tree widget
+     **/
+    enum OwnerStatsColumns
+    {
+	OS_NameCol = 0,
+	OS_TypeCol,
+	OS_ItemsCol,
+	OS_SizeCol,
+	OS_PercentCol
+    };
+
+
+    /**
+     * Item class for the owner stats list: The usage of one user or one
+     * group.
+     **/
+    class OwnerStatsItem: public QTreeWidgetItem
+    {
+    public:
+
+	/**
+	 * Constructor. 'isGroup' tells if 'entry' is for a group or a user,
+	 * 'totalSize' is the size of the complete subtree.
+	 **/
+	OwnerStatsItem( const OwnerSummary::Entry & entry,
+			bool			    isGroup,
+			FileSize		    totalSize,
+			QTreeWidget		  * parent );
+
+	const OwnerSummary::Entry & entry() const { return _entry; }
+
+	/**
+	 * Return the name of user or group 'id' or the ID as a string if
+	 * there is no such user or group.
+	 **/
+	static QString ownerName( uint id, bool isGroup );
+
+	/**
+	 * Less-than operator for sorting.
+	 *
+	 * Reimplemented from QTreeWidgetItem.
+	 **/
+	virtual bool operator<( const QTreeWidgetItem & other ) const Q_DECL_OVERRIDE;
+
+    protected:
+
+	OwnerSummary::Entry _entry;
+    };
+
+} // namespace QDirStat
+
+
+#endif // OwnerStatsWindow_h
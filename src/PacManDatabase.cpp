@@ -0,0 +1,223 @@
+/*
+ *   File name: PacManDatabase.cpp
+ *   Summary:	Direct access to the pacman local database for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+
+#include "PacManDatabase.h"
+#include "PkgFileListCache.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+#define PACMAN_LOCAL_DB_DIR	"/var/lib/pacman/local"
+
+// Maximum number of threads for reading the package directories
+#define MaxDbThreads		8
+
+
+using namespace QDirStat;
+
+
+bool PacManDatabase::isAvailable()
+{
+    QFileInfo dir( PACMAN_LOCAL_DB_DIR );
+
+    return dir.isDir() && dir.isReadable();
+}
+
+
+QStringList PacManDatabase::pkgDirs()
+{
+    return QDir( PACMAN_LOCAL_DB_DIR ).entryList( QDir::Dirs | QDir::NoDotAndDotDot );
+}
+
+
+bool PacManDatabase::readSection( const QString & fileName,
+				  const QString & section,
+				  QStringList	& values_ret )
+{
+    values_ret.clear();
+    QFile file( fileName );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+	return false;
+
+    QList<QByteArray> lines = file.readAll().split( '\n' );
+    QByteArray	      header = section.toUtf8();
+    int		      i	     = lines.indexOf( header );
+
+    if ( i < 0 )
+	return true;
+
+    for ( ++i; i < lines.size() && ! lines.at( i ).isEmpty(); ++i )
+	values_ret << QString::fromUtf8( lines.at( i ) );
+
+    return true;
+}
+
+
+bool PacManDatabase::readDesc( const QString & pkgDir, PacManDbEntry & entry_ret )
+{
+    QString	fileName = QString( PACMAN_LOCAL_DB_DIR "/%1/desc" ).arg( pkgDir );
+    QStringList name;
+    QStringList version;
+    QStringList arch;
+
+    if ( ! readSection( fileName, "%NAME%",    name    ) ||
+	 ! readSection( fileName, "%VERSION%", version ) ||
+	 ! readSection( fileName, "%ARCH%",    arch    ) ||
+	 name.isEmpty() || version.isEmpty() )
+    {
+	return false;
+    }
+
+    entry_ret.name    = name.first();
+    entry_ret.version = version.first();
+    entry_ret.arch    = arch.isEmpty() ? QString() : arch.first();
+
+    return true;
+}
+
+
+bool PacManDatabase::readFiles( const QString & pkgDir, QStringList & fileList_ret )
+{
+    QString fileName = QString( PACMAN_LOCAL_DB_DIR "/%1/files" ).arg( pkgDir );
+
+    if ( ! readSection( fileName, "%FILES%", fileList_ret ) )
+	return false;
+
+    for ( int i = 0; i < fileList_ret.size(); ++i )
+	fileList_ret[i].prepend( '/' );
+
+    return true;
+}
+
+
+QList<PacManDbThread *> PacManDatabase::readInThreads( const QStringList & dirs,
+						       bool		   readFiles )
+{
+    QList<PacManDbThread *> threads;
+
+    if ( dirs.isEmpty() )
+	return threads;
+
+    // One contiguous chunk of the package directories for each thread
+
+    int threadCount = qBound( 1, QThread::idealThreadCount(), MaxDbThreads );
+    int chunkSize   = ( dirs.size() + threadCount - 1 ) / threadCount;
+
+    for ( int start = 0; start < dirs.size(); start += chunkSize )
+    {
+	PacManDbThread * thread = new PacManDbThread( dirs.mid( start, chunkSize ), readFiles );
+	CHECK_NEW( thread );
+
+	threads << thread;
+	thread->start();
+    }
+
+    foreach ( PacManDbThread * thread, threads )
+	thread->wait();
+
+    return threads;
+}
+
+
+bool PacManDatabase::readInstalledPkg( QList<PacManDbEntry> & entries_ret )
+{
+    entries_ret.clear();
+
+    QList<PacManDbThread *> threads = readInThreads( pkgDirs(), false );
+    bool ok = ! threads.isEmpty();
+
+    foreach ( PacManDbThread * thread, threads )
+    {
+	if ( ! thread->ok() )
+	    ok = false;
+
+	entries_ret << thread->entries();
+    }
+
+    qDeleteAll( threads );
+
+    if ( ! ok )
+    {
+	logWarning() << "Reading the packages in " << PACMAN_LOCAL_DB_DIR << " failed" << endl;
+	entries_ret.clear();
+    }
+
+    return ok;
+}
+
+
+bool PacManDatabase::readFileList( const QString & name,
+				   const QString & version,
+				   QStringList	 & fileList_ret )
+{
+    return readFiles( name + "-" + version, fileList_ret );
+}
+
+
+bool PacManDatabase::readAllFileLists( PkgFileListCache * cache )
+{
+    CHECK_PTR( cache );
+
+    QList<PacManDbThread *> threads = readInThreads( pkgDirs(), true );
+    bool ok = ! threads.isEmpty();
+
+    // Fill the cache in the calling thread; PkgFileListCache is not
+    // thread-safe.
+
+    foreach ( PacManDbThread * thread, threads )
+    {
+	if ( ! thread->ok() )
+	    ok = false;
+
+	for ( int i = 0; ok && i < thread->entries().size(); ++i )
+	{
+	    const QString & pkgName = thread->entries().at( i ).name;
+
+	    foreach ( const QString & path, thread->fileLists().at( i ) )
+		cache->add( pkgName, path );
+	}
+    }
+
+    qDeleteAll( threads );
+
+    if ( ! ok )
+    {
+	logWarning() << "Reading the package file lists in " << PACMAN_LOCAL_DB_DIR << " failed" << endl;
+	cache->clear();
+    }
+
+    return ok;
+}
+
+
+void PacManDbThread::run()
+{
+    foreach ( const QString & pkgDir, _pkgDirs )
+    {
+	PacManDbEntry entry;
+	QStringList   fileList;
+
+	if ( ! PacManDatabase::readDesc( pkgDir, entry ) ||
+	     ( _readFiles && ! PacManDatabase::readFiles( pkgDir, fileList ) ) )
+	{
+	    _ok = false;
+	    return;
+	}
+
+	_entries << entry;
+
+	if ( _readFiles )
+	    _fileLists << fileList;
+    }
+}
@@ -0,0 +1,185 @@
+/*
+ *   File name: PacManDatabase.h
+ *   Summary:	Direct access to the pacman local database for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef PacManDatabase_h
+#define PacManDatabase_h
+
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QThread>
+
+
+namespace QDirStat
+{
+    class PkgFileListCache;
+    class PacManDbThread;
+
+
+    /**
+     * One installed package from the pacman local database.
+     **/
+    struct PacManDbEntry
+    {
+	QString name;
+	QString version;
+	QString arch;
+    };
+
+
+    /**
+     * Reader for the pacman local database in /var/lib/pacman/local
+     * without starting any pacman processes:
+     *
+     * There is one directory <name>-<version> for each installed package
+     * with a 'desc' file with the package name, version etc. and a 'files'
+     * file with the file list, both in sections like
+     *
+     *	   %NAME%
+     *	   zsh
+     *
+     *	   %VERSION%
+     *	   5.8-1
+     *
+     * The paths in the file list are relative to / and directories end with
+     * a '/', just like "pacman -Qlq" shows them, just without the leading
+     * '/'.
+     *
+     * The packages are read in several threads in parallel. Every method
+     * returns 'false' if something unexpected happens; the
+     * PacManPkgManager then falls back to the pacman commands.
+     **/
+    class PacManDatabase
+    {
+    public:
+
+	/**
+	 * Return 'true' if the local database directory is there and
+	 * readable.
+	 **/
+	static bool isAvailable();
+
+	/**
+	 * Read all installed packages into 'entries_ret'.
+	 *
+	 * Notice that unlike "pacman -Qn", this includes foreign packages,
+	 * i.e. packages that are not in any sync database (e.g. from the
+	 * AUR): Finding that out would need reading the sync databases, and
+	 * those packages own their files just the same.
+	 **/
+	static bool readInstalledPkg( QList<PacManDbEntry> & entries_ret );
+
+	/**
+	 * Read the file list of package 'name' with 'version' into
+	 * 'fileList_ret'.
+	 **/
+	static bool readFileList( const QString & name,
+				  const QString & version,
+				  QStringList	& fileList_ret );
+
+	/**
+	 * Read the file lists of all packages into 'cache' with the package
+	 * names as the keys.
+	 **/
+	static bool readAllFileLists( PkgFileListCache * cache );
+
+	/**
+	 * Read the 'desc' file of package directory 'pkgDir' into
+	 * 'entry_ret'.
+	 **/
+	static bool readDesc( const QString & pkgDir, PacManDbEntry & entry_ret );
+
+	/**
+	 * Read the 'files' file of package directory 'pkgDir' into
+	 * 'fileList_ret'.
+	 **/
+	static bool readFiles( const QString & pkgDir, QStringList & fileList_ret );
+
+
+    protected:
+
+	/**
+	 * Return the names of all package directories.
+	 **/
+	static QStringList pkgDirs();
+
+	/**
+	 * Read the lines of section 'section' (e.g. "%FILES%") up to the
+	 * next empty line from 'fileName' into values_ret. A section that
+	 * is not there is empty.
+	 **/
+	static bool readSection( const QString & fileName,
+				 const QString & section,
+				 QStringList   & values_ret );
+
+	/**
+	 * Start threads that read the package directories 'dirs' and return
+	 * them when they are finished.
+	 **/
+	static QList<PacManDbThread *> readInThreads( const QStringList & dirs,
+						      bool		  readFiles );
+
+    };	// class PacManDatabase
+
+
+    /**
+     * Thread for reading some of the package directories of the pacman
+     * local database for PacManDatabase.
+     **/
+    class PacManDbThread: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor for reading the 'desc' files of 'pkgDirs' and, if
+	 * 'readFiles' is 'true', also the 'files' files.
+	 **/
+	PacManDbThread( const QStringList & pkgDirs, bool readFiles ):
+	    QThread(),
+	    _pkgDirs( pkgDirs ),
+	    _readFiles( readFiles ),
+	    _ok( true )
+	    {}
+
+	/**
+	 * Return the package entries in the same order as the package
+	 * directories. This is only valid when the thread is finished.
+	 **/
+	const QList<PacManDbEntry> & entries() const { return _entries; }
+
+	/**
+	 * Return the file lists in the same order as the package
+	 * directories if 'readFiles' was set.
+	 **/
+	const QList<QStringList> & fileLists() const { return _fileLists; }
+
+	/**
+	 * Return 'false' if any package could not be read.
+	 **/
+	bool ok() const { return _ok; }
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	QStringList	     _pkgDirs;
+	bool		     _readFiles;
+	QList<PacManDbEntry> _entries;
+	QList<QStringList>   _fileLists;
+	bool		     _ok;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef PacManDatabase_h
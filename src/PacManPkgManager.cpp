@@ -7,7 +7,12 @@
  */
 
 
+#include <QElapsedTimer>
+
 #include "PacManPkgManager.h"
+#include "PacManDatabase.h"
+#include "PkgFileListCache.h"
+#include "Settings.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -15,6 +20,28 @@
 using namespace QDirStat;
 
 
+PacManPkgManager::PacManPkgManager():
+    _useDatabase( false )
+{
+    readSettings();
+}
+
+
+void PacManPkgManager::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "Pkg" );
+    _useDatabase = settings.value( "UsePacManDatabase", true ).toBool() && PacManDatabase::isAvailable();
+
+    // Write the value right back to the settings if it isn't there already:
+    // Since package manager objects are never really destroyed, this can't
+    // reliably be done in the destructor.
+
+    settings.setDefaultValue( "UsePacManDatabase", true );
+    settings.endGroup();
+}
+
+
 bool PacManPkgManager::isPrimaryPkgManager()
 {
     return tryRunCommand( "/usr/bin/pacman -Qo /usr/bin/pacman",
@@ -53,18 +80,80 @@ QString PacManPkgManager::owningPkg( const QString & path )
 }
 
 
+QMap<QString, QString> PacManPkgManager::owningPkgs( const QStringList & paths )
+{
+    QMap<QString, QString> pkgs;
+
+    if ( paths.isEmpty() )
+	return pkgs;
+
+    int exitCode = -1;
+    QString output = runCommand( "/usr/bin/pacman",
+                                 QStringList() << "-Qo" << paths,
+                                 &exitCode,
+                                 COMMAND_TIMEOUT_SEC, LOG_COMMANDS, LOG_OUTPUT,
+                                 true ); // ignoreErrCode
+
+    // One line for each path:
+    //
+    //   /usr/bin/pacman is owned by pacman 5.1.1-3
+    //   error: No package owns /usr/bin/foo
+
+    foreach ( const QString & line, output.split( "\n" ) )
+    {
+        int pos = line.indexOf( " is owned by " );
+
+        if ( pos > 0 )
+        {
+            QString pkg = line.mid( pos + 13 ).section( " ", 0, 0 );
+            pkgs.insert( line.left( pos ), pkg );
+        }
+    }
+
+    return pkgs;
+}
+
+
 PkgInfoList PacManPkgManager::installedPkg()
 {
+    // Log the time for both methods to compare them; the pacman command
+    // can be used with the UsePacManDatabase=false setting.
+
+    QElapsedTimer timer;
+    timer.start();
+    PkgInfoList pkgList;
+
+    QList<PacManDbEntry> entries;
+
+    if ( _useDatabase && PacManDatabase::readInstalledPkg( entries ) )
+    {
+        foreach ( const PacManDbEntry & entry, entries )
+        {
+            // Like with "pacman -Qn", no architecture
+
+            PkgInfo * pkg = new PkgInfo( entry.name, entry.version, "", this );
+            CHECK_NEW( pkg );
+
+            pkgList << pkg;
+        }
+
+        logDebug() << "Read " << pkgList.size() << " packages from the pacman database in "
+                   << timer.elapsed() << " millisec" << endl;
+
+        return pkgList;
+    }
+
     int exitCode = -1;
     QString output = runCommand( "/usr/bin/pacman",
                                  QStringList() << "-Qn",
                                  &exitCode );
 
-    PkgInfoList pkgList;
-
     if ( exitCode == 0 )
         pkgList = parsePkgList( output );
 
+    logDebug() << "Got " << pkgList.size() << " packages from pacman -Qn in "
+               << timer.elapsed() << " millisec" << endl;
+
     return pkgList;
 }
 
@@ -110,3 +199,41 @@ QStringList PacManPkgManager::parseFileList( const QString & output )
     return output.split( "\n" );
 }
 
+
+
+QStringList PacManPkgManager::fileList( PkgInfo * pkg )
+{
+    CHECK_PTR( pkg );
+    QStringList fileList;
+
+    if ( _useDatabase &&
+         PacManDatabase::readFileList( pkg->baseName(), pkg->version(), fileList ) )
+    {
+        return fileList;
+    }
+
+    return PkgManager::fileList( pkg );
+}
+
+
+PkgFileListCache * PacManPkgManager::createFileListCache( PkgFileListCache::LookupType lookupType )
+{
+    if ( ! _useDatabase )
+        return 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    PkgFileListCache * cache = new PkgFileListCache( this, lookupType );
+    CHECK_NEW( cache );
+
+    if ( ! PacManDatabase::readAllFileLists( cache ) )
+    {
+        delete cache;
+        return 0;
+    }
+
+    logDebug() << "file list cache finished in " << timer.elapsed() << " millisec" << endl;
+
+    return cache;
+}
@@ -24,7 +24,15 @@ namespace QDirStat
     {
     public:
 
-	PacManPkgManager() {}
+	/**
+	 * Constructor. This checks if the pacman local database can be read
+	 * directly (see PacManDatabase).
+	 **/
+	PacManPkgManager();
+
+	/**
+	 * Destructor.
+	 **/
 	virtual ~PacManPkgManager() {}
 
 	/**
@@ -61,6 +69,17 @@ namespace QDirStat
 	 **/
 	virtual QString owningPkg( const QString & path ) Q_DECL_OVERRIDE;
 
+	/**
+	 * Return the owning packages of several paths with one command.
+	 *
+	 * Reimplemented from PkgManager.
+	 *
+	 * This basically executes this command:
+	 *
+	 *   /usr/bin/pacman -Qo ${path1} ${path2} ...
+	 **/
+	virtual QMap<QString, QString> owningPkgs( const QStringList & paths ) Q_DECL_OVERRIDE;
+
 
         //-----------------------------------------------------------------
         //                     Optional Features
@@ -84,6 +103,25 @@ namespace QDirStat
          **/
         virtual PkgInfoList installedPkg();
 
+        /**
+         * Return the list of files and directories owned by a package.
+         *
+         * This reads the pacman local database directly if possible and
+         * uses the file list command only as a fallback.
+         *
+	 * Reimplemented from PkgManager.
+         **/
+        virtual QStringList fileList( PkgInfo * pkg ) Q_DECL_OVERRIDE;
+
+        /**
+         * Return 'true' if fileList() reads the pacman local database
+         * directly.
+         *
+	 * Reimplemented from PkgManager.
+         **/
+        virtual bool supportsNativeFileList() Q_DECL_OVERRIDE
+            { return _useDatabase; }
+
         /**
          * Return 'true' if this package manager supports getting the file list
          * for a package.
@@ -108,6 +146,37 @@ namespace QDirStat
          **/
         virtual QStringList parseFileList( const QString & output ) Q_DECL_OVERRIDE;
 
+        /**
+         * Return 'true' if this package manager supports building a file list
+         * cache for getting all file lists for all packages. This is only
+         * supported when reading the pacman local database directly.
+         *
+	 * Reimplemented from PkgManager.
+         **/
+        virtual bool supportsFileListCache() Q_DECL_OVERRIDE
+            { return _useDatabase; }
+
+        /**
+         * Create a file list cache with the specified lookup type for all
+         * installed packages from the pacman local database.
+         *
+         * Ownership of the cache is transferred to the caller; make sure to
+         * delete it when you are done with it.
+         *
+	 * Reimplemented from PkgManager.
+         **/
+        virtual PkgFileListCache * createFileListCache( PkgFileListCache::LookupType lookupType = PkgFileListCache::LookupByPkg ) Q_DECL_OVERRIDE;
+
+        /**
+         * Return the directory of the local database: pacman adds a
+         * subdirectory for each installed package version and removes it
+         * again when the package is updated or removed.
+         *
+	 * Reimplemented from PkgManager.
+         **/
+        virtual QStringList databaseFiles() Q_DECL_OVERRIDE
+            { return QStringList() << "/var/lib/pacman/local"; }
+
 
     protected:
 
@@ -116,6 +185,16 @@ namespace QDirStat
          **/
         PkgInfoList parsePkgList( const QString & output );
 
+        /**
+         * Read parameters from the settings file.
+         **/
+        void readSettings();
+
+
+        // Data members
+
+        bool _useDatabase;
+
     }; // class PacManPkgManager
 
 } // namespace QDirStat
@@ -99,6 +99,8 @@ PathSelectorItem * PathSelector::addMountPoint( MountPoint *  mountPoint,
 
 void PathSelector::addMountPoints( const QList<MountPoint *> & mountPoints )
 {
+    MountPoints::querySizes( mountPoints );
+
     foreach ( MountPoint * mountPoint, mountPoints )
 	addMountPoint( mountPoint );
 }
@@ -0,0 +1,126 @@
+/*
+ *   File name: PathTrie.cpp
+ *   Summary:	Compact set of paths for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "PathTrie.h"
+
+
+using namespace QDirStat;
+
+
+PathTrie::PathTrie()
+{
+    clear();
+}
+
+
+void PathTrie::clear()
+{
+    _names.clear();
+    _edges.clear();
+    _isPath.clear();
+    _isPath << false;	// root
+    _pathCount = 0;
+}
+
+
+void PathTrie::add( const QString & path )
+{
+    int node  = root();
+    int start = 0;
+
+    while ( start < path.size() )
+    {
+	int end = path.indexOf( '/', start );
+
+	if ( end < 0 )
+	    end = path.size();
+
+	if ( end > start )
+	{
+	    QString name = path.mid( start, end - start );
+	    QHash<QString, int>::const_iterator nameIt = _names.constFind( name );
+	    int nameId;
+
+	    if ( nameIt == _names.constEnd() )
+	    {
+		nameId = _names.size();
+		_names.insert( name, nameId );
+	    }
+	    else
+	    {
+		nameId = nameIt.value();
+	    }
+
+	    quint64 key = edgeKey( node, nameId );
+	    QHash<quint64, int>::const_iterator edgeIt = _edges.constFind( key );
+
+	    if ( edgeIt == _edges.constEnd() )
+	    {
+		int newNode = _isPath.size();
+		_isPath << false;
+		_edges.insert( key, newNode );
+		node = newNode;
+	    }
+	    else
+	    {
+		node = edgeIt.value();
+	    }
+	}
+
+	start = end + 1;
+    }
+
+    if ( ! _isPath.at( node ) )
+    {
+	_isPath[ node ] = true;
+	++_pathCount;
+    }
+}
+
+
+int PathTrie::child( int node, const QString & name ) const
+{
+    if ( node < 0 )
+	return -1;
+
+    QHash<QString, int>::const_iterator nameIt = _names.constFind( name );
+
+    if ( nameIt == _names.constEnd() )
+	return -1;
+
+    return _edges.value( edgeKey( node, nameIt.value() ), -1 );
+}
+
+
+int PathTrie::find( const QString & path ) const
+{
+    int node  = root();
+    int start = 0;
+
+    while ( node >= 0 && start < path.size() )
+    {
+	int end = path.indexOf( '/', start );
+
+	if ( end < 0 )
+	    end = path.size();
+
+	if ( end > start )
+	    node = child( node, path.mid( start, end - start ) );
+
+	start = end + 1;
+    }
+
+    return node;
+}
+
+
+bool PathTrie::contains( const QString & path ) const
+{
+    return isPath( find( path ) );
+}
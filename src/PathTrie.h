@@ -0,0 +1,117 @@
+/*
+ *   File name: PathTrie.h
+ *   Summary:	Compact set of paths for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef PathTrie_h
+#define PathTrie_h
+
+
+#include <QString>
+#include <QHash>
+#include <QVector>
+
+
+namespace QDirStat
+{
+    /**
+     * Set of absolute paths stored as a trie of path components: Each
+     * node is a directory or file, and all paths below the same directory
+     * share its node. Each distinct component name (like "usr", "share" or
+     * "README") is stored only once, and an edge from a node to a child
+     * node is just one hash entry of two integers. For millions of paths of
+     * installed packages, that needs much less memory than a QSet of
+     * complete path strings.
+     *
+     * Instead of looking up complete paths with contains(), callers that
+     * traverse a directory tree can look up the node of a directory once
+     * with find() and then check each of its entries with child().
+     **/
+    class PathTrie
+    {
+    public:
+
+	/**
+	 * Constructor. This creates an empty trie with just the root node
+	 * for "/".
+	 **/
+	PathTrie();
+
+	/**
+	 * Remove all paths.
+	 **/
+	void clear();
+
+	/**
+	 * Add an absolute path. Empty components (from "//" or a trailing
+	 * "/") are ignored.
+	 **/
+	void add( const QString & path );
+
+	/**
+	 * Return 'true' if 'path' was added.
+	 **/
+	bool contains( const QString & path ) const;
+
+	/**
+	 * Return the node for 'path' or -1 if there is none. There is also
+	 * a node for each parent directory of a path that was added even if
+	 * that directory itself was not added.
+	 **/
+	int find( const QString & path ) const;
+
+	/**
+	 * Return the child node of 'node' for component 'name' or -1 if
+	 * there is none. 'node' may be -1; the result is -1 then.
+	 **/
+	int child( int node, const QString & name ) const;
+
+	/**
+	 * Return 'true' if the path of 'node' was added. 'node' may be -1;
+	 * the result is 'false' then.
+	 **/
+	bool isPath( int node ) const
+	    { return node >= 0 && _isPath.at( node ); }
+
+	/**
+	 * Return the root node for "/".
+	 **/
+	static int root() { return 0; }
+
+	/**
+	 * Return the number of paths that were added.
+	 **/
+	int size() const { return _pathCount; }
+
+	/**
+	 * Return 'true' if no paths were added.
+	 **/
+	bool isEmpty() const { return _pathCount == 0; }
+
+
+    protected:
+
+	/**
+	 * Return the key in _edges for the child with name 'nameId' of
+	 * 'node'.
+	 **/
+	static quint64 edgeKey( int node, int nameId )
+	    { return ( (quint64) node << 32 ) | (quint32) nameId; }
+
+	// Data members
+
+	QHash<QString, int>	_names;		// component name -> name ID
+	QHash<quint64, int>	_edges;		// (node, name ID) -> child node
+	QVector<bool>		_isPath;	// for each node
+	int			_pathCount;
+
+    };	// class PathTrie
+
+}	// namespace QDirStat
+
+
+#endif // ifndef PathTrie_h
@@ -8,6 +8,8 @@
 
 
 #include <QPainter>
+#include <QPixmap>
+#include <QPixmapCache>
 #include <QTreeView>
 
 #include "PercentBar.h"
@@ -18,6 +20,11 @@
 
 #define MIN_PERCENT_BAR_HEIGHT  22
 
+// Geometry of a percent bar within its cell
+#define PERCENT_BAR_PEN_WIDTH	 2
+#define PERCENT_BAR_ITEM_MARGIN	 4
+#define PERCENT_BAR_EXTRA_MARGIN 4
+
 using namespace QDirStat;
 
 
@@ -192,23 +199,37 @@ QSize PercentBarDelegate::sizeHint( const QStyleOptionViewItem & option,
 
 
 
-namespace QDirStat
+namespace
 {
-    void paintPercentBar( float		 percent,
-			  QPainter *	 painter,
-			  int		 indentPixel,
-			  const QRect  & cellRect,
-			  const QColor & fillColor,
-			  const QColor & barBackground )
+    /**
+     * Return the width of the filled part of a percent bar in a cell that
+     * is 'cellWidth' pixels wide.
+     **/
+    int percentBarFillWidth( int cellWidth, int indentPixel, float percent )
     {
-	int penWidth = 2;
-	int extraMargin = 4;
-	int itemMargin = 4;
+	int w = cellWidth - 2 * PERCENT_BAR_ITEM_MARGIN - indentPixel;
+
+	return (int) ( ( w - 2 * PERCENT_BAR_PEN_WIDTH ) * percent / 100.0 );
+    }
+
+
+    /**
+     * Draw a percent bar with a filled part of 'fillWidth' pixels.
+     **/
+    void drawPercentBar( int		fillWidth,
+			 QPainter *	painter,
+			 int		indentPixel,
+			 const QRect  & cellRect,
+			 const QColor & fillColor,
+			 const QColor & barBackground )
+    {
+	int penWidth = PERCENT_BAR_PEN_WIDTH;
+	int extraMargin = PERCENT_BAR_EXTRA_MARGIN;
+	int itemMargin = PERCENT_BAR_ITEM_MARGIN;
 	int x = cellRect.x() + itemMargin;
 	int y = cellRect.y() + extraMargin;
 	int w = cellRect.width() - 2 * itemMargin;
 	int h = cellRect.height() - 2 * extraMargin;
-	int fillWidth;
 
 	painter->eraseRect( cellRect );
 	w -= indentPixel;
@@ -220,7 +241,6 @@ namespace QDirStat
 	    pen.setWidth( 0 );
 	    painter->setPen( pen );
 	    painter->setBrush( Qt::NoBrush );
-	    fillWidth = (int) ( ( w - 2 * penWidth ) * percent / 100.0);
 
 
 	    // Fill bar background.
@@ -274,6 +294,75 @@ namespace QDirStat
 	}
     }
 
+}	// namespace
+
+
+namespace QDirStat
+{
+    void paintPercentBar( float		 percent,
+			  QPainter *	 painter,
+			  int		 indentPixel,
+			  const QRect  & cellRect,
+			  const QColor & fillColor,
+			  const QColor & barBackground )
+    {
+	int fillWidth = percentBarFillWidth( cellRect.width(), indentPixel, percent );
+	const QBrush & background = painter->background();
+
+	if ( background.style() != Qt::SolidPattern || cellRect.isEmpty() )
+	{
+	    drawPercentBar( fillWidth, painter, indentPixel, cellRect,
+			    fillColor, barBackground );
+	    return;
+	}
+
+	// A tree view repaints all visible rows very often while reading,
+	// but there are only a few different bars: The percentage only
+	// matters down to the pixel. Draw each one only once into a pixmap,
+	// so painting it is just a blit.
+
+	qreal pixelRatio = 1.0;
+
+#if (QT_VERSION >= QT_VERSION_CHECK( 5, 6, 0 ))
+	if ( painter->device() )
+	    pixelRatio = painter->device()->devicePixelRatioF();
+#endif
+
+	QString key = QString( "qdirstat-percent-bar-%1-%2-%3-%4-%5-%6-%7-%8" )
+	    .arg( cellRect.width() )
+	    .arg( cellRect.height() )
+	    .arg( indentPixel )
+	    .arg( fillWidth )
+	    .arg( fillColor.rgba() )
+	    .arg( barBackground.rgba() )
+	    .arg( background.color().rgba() )
+	    .arg( pixelRatio );
+
+	QPixmap pixmap;
+
+	if ( ! QPixmapCache::find( key, &pixmap ) )
+	{
+	    QRect rect( QPoint( 0, 0 ), cellRect.size() );
+	    pixmap = QPixmap( rect.size() * pixelRatio );
+
+#if (QT_VERSION >= QT_VERSION_CHECK( 5, 6, 0 ))
+	    pixmap.setDevicePixelRatio( pixelRatio );
+#endif
+	    pixmap.fill( background.color() );
+
+	    QPainter pixmapPainter( &pixmap );
+	    pixmapPainter.setBackground( background );
+	    pixmapPainter.setPen( painter->pen() );
+	    drawPercentBar( fillWidth, &pixmapPainter, indentPixel, rect,
+			    fillColor, barBackground );
+	    pixmapPainter.end();
+
+	    QPixmapCache::insert( key, pixmap );
+	}
+
+	painter->drawPixmap( cellRect.topLeft(), pixmap );
+    }
+
 
     QColor contrastingColor( const QColor &desiredColor,
 			     const QColor &contrastColor )
@@ -15,11 +15,17 @@
 
 #define VERBOSE_SORT_THRESHOLD  50000
 
+// Number of data items above which the sketch is used by default: 16 MB for
+// the data in _data.
+#define DEFAULT_SKETCH_THRESHOLD	2000000
+
 using namespace QDirStat;
 
 
 PercentileStats::PercentileStats():
-    _sorted( false )
+    _sorted( false ),
+    _useSketch( false ),
+    _sketchThreshold( DEFAULT_SKETCH_THRESHOLD )
 {
 
 }
@@ -37,16 +43,103 @@ void PercentileStats::clear()
     // list to _data.
 
     _data = QRealList();
+    _sorted = false;
+    _selected.clear();
+    _sketch.clear();
+    _useSketch = false;
+}
+
+
+void PercentileStats::reserve( int count )
+{
+    if ( _sketchThreshold > 0 && _data.size() + count > _sketchThreshold )
+        switchToSketch();
+    else if ( ! _useSketch )
+        _data.reserve( _data.size() + count );
+}
+
+
+void PercentileStats::append( qreal value, qint64 count )
+{
+    if ( _sketchThreshold > 0 && dataSize() + count > _sketchThreshold )
+        switchToSketch();
+
+    if ( _useSketch )
+    {
+        _sketch.add( value, count );
+        return;
+    }
+
+    for ( qint64 i=0; i < count; ++i )
+        _data << value;
+
+    _sorted = false;
+    _selected.clear();
+}
+
+
+void PercentileStats::merge( const PercentileStats & other )
+{
+    if ( other._useSketch )
+    {
+        switchToSketch();
+        _sketch.merge( other._sketch );
+        return;
+    }
+
+    if ( _sketchThreshold > 0 && dataSize() + other.dataSize() > _sketchThreshold )
+        switchToSketch();
+
+    if ( _useSketch )
+    {
+        for ( int i=0; i < other._data.size(); ++i )
+            _sketch.add( other._data.at( i ) );
+    }
+    else
+    {
+        _data += other._data;
+        _sorted = false;
+        _selected.clear();
+    }
+}
+
+
+void PercentileStats::setSketchRelativeError( qreal relativeError )
+{
+    clear();
+    _sketch.setRelativeError( relativeError );
+}
+
+
+void PercentileStats::switchToSketch()
+{
+    if ( _useSketch )
+        return;
+
+    logDebug() << "Using a sketch with relative error " << _sketch.relativeError()
+               << " instead of " << _data.size() << " elements" << endl;
+
+    for ( int i=0; i < _data.size(); ++i )
+        _sketch.add( _data.at( i ) );
+
+    _data      = QRealList();
+    _sorted    = false;
+    _selected.clear();
+    _useSketch = true;
 }
 
 
 void PercentileStats::sort()
 {
+    if ( _useSketch )	// The sketch is always in order
+        return;
+
     if ( _data.size() > VERBOSE_SORT_THRESHOLD )
         logDebug() << "Sorting " << _data.size() << " elements" << endl;
 
     std::sort( _data.begin(), _data.end() );
     _sorted = true;
+    _selected.clear();
 
     if ( _data.size() > VERBOSE_SORT_THRESHOLD )
         logDebug() << "Sorting done." << endl;
@@ -55,12 +148,12 @@ void PercentileStats::sort()
 
 qreal PercentileStats::median()
 {
+    if ( _useSketch )
+        return quantile( 2, 1 );
+
     if ( _data.isEmpty() )
         return 0;
 
-    if ( ! _sorted )
-        sort();
-
     int centerPos = _data.size() / 2;
 
     // Since we are doing integer division, the center is already rounded down
@@ -69,7 +162,7 @@ qreal PercentileStats::median()
     // _data.size() is 5, we get _data[2] which is the center of
     // [0, 1, 2, 3, 4].
 
-    qreal result = _data.at( centerPos );
+    qreal result = valueAt( centerPos );
 
     if ( _data.size() % 2 == 0 ) // Even number of data
     {
@@ -79,7 +172,7 @@ qreal PercentileStats::median()
         // _data[3], and now we need to average this with _data[2] of
         // [0, 1, 2, 3, 4, 5].
 
-        result = ( result + _data.at( centerPos - 1 ) ) / 2.0;
+        result = ( result + valueAt( centerPos - 1 ) ) / 2.0;
     }
 
     return result;
@@ -88,6 +181,9 @@ qreal PercentileStats::median()
 
 qreal PercentileStats::average()
 {
+    if ( _useSketch )
+        return _sketch.count() > 0 ? _sketch.sum() / _sketch.count() : 0.0;
+
     if ( _data.isEmpty() )
         return 0.0;
 
@@ -103,31 +199,31 @@ qreal PercentileStats::average()
 
 qreal PercentileStats::min()
 {
+    if ( _useSketch )
+        return _sketch.min();
+
     if ( _data.isEmpty() )
         return 0.0;
 
-    if ( ! _sorted )
-        sort();
-
-    return _data.first();
+    return valueAt( 0 );
 }
 
 
 qreal PercentileStats::max()
 {
+    if ( _useSketch )
+        return _sketch.max();
+
     if ( _data.isEmpty() )
         return 0.0;
 
-    if ( ! _sorted )
-        sort();
-
-    return _data.last();
+    return valueAt( _data.size() - 1 );
 }
 
 
 qreal PercentileStats::quantile( int order, int number )
 {
-    if ( _data.isEmpty() )
+    if ( dataSize() == 0 )
         return 0.0;
 
     if ( number > order )
@@ -143,14 +239,19 @@ qreal PercentileStats::quantile( int order, int number )
         THROW( Exception( msg ) );
     }
 
-    if ( ! _sorted )
-        sort();
+    if ( _useSketch )
+    {
+        // Same position as below, but as a fractional rank: A position
+        // between two elements is the average of the two.
+
+        return _sketch.valueAt( (qreal) _sketch.count() * number / order - 0.5 );
+    }
 
     if ( number == 0 )
-        return _data.first();
+        return valueAt( 0 );
 
     if ( number == order )
-        return _data.last();
+        return valueAt( _data.size() - 1 );
 
     int pos = ( _data.size() * number ) / order;
 
@@ -158,14 +259,14 @@ qreal PercentileStats::quantile( int order, int number )
     // decimal place, so don't subtract 1 to compensate for starting _data with
     // index 0.
 
-    qreal result = _data.at( pos );
+    qreal result = valueAt( pos );
 
     if ( ( _data.size() * number ) % order == 0 )
     {
         // Same as in median: We hit between two elements, so use the average
         // between them.
 
-        result = ( result + _data.at( pos - 1 ) ) / 2.0;
+        result = ( result + valueAt( pos - 1 ) ) / 2.0;
     }
 
     return result;
@@ -192,10 +293,38 @@ QRealList PercentileStats::percentileSums()
     for ( int i=0; i <= 100; ++i )
         sums << 0.0;
 
-    if ( ! _sorted )
-        sort();
+    if ( _useSketch )
+    {
+        qreal percentileSize = _sketch.count() / 100.0;
+        qreal previousSum    = 0.0;
+
+        for ( int i=1; i <= 100; ++i )
+        {
+            qreal sum = _sketch.sumOfSmallest( i * percentileSize );
+            sums[ i ] = sum - previousSum;
+            previousSum = sum;
+        }
+
+        return sums;
+    }
+
+    // The data don't need to be sorted for this, just partitioned at the
+    // first index of each percentile: Then each percentile has the data
+    // items it would have if the data were sorted.
 
     qreal percentileSize = _data.size() / 100.0;
+    int   lastPercentile = 0;
+
+    for ( int i=0; i < _data.size(); ++i )
+    {
+        int percentile = qMax( 1, (int) ceil( i / percentileSize ) );
+
+        if ( percentile != lastPercentile )
+        {
+            valueAt( i );
+            lastPercentile = percentile;
+        }
+    }
 
     for ( int i=0; i < _data.size(); ++i )
     {
@@ -211,3 +340,33 @@ QRealList PercentileStats::percentileSums()
 
     return sums;
 }
+
+
+qreal PercentileStats::valueAt( int index )
+{
+    if ( _useSketch )
+        return _sketch.valueAt( index );
+
+    if ( _sorted )
+        return _data.at( index );
+
+    // Find the partition that contains 'index': Everything before a
+    // selected index is less or equal, everything after it greater or
+    // equal, so a selection only has to reorder the data between the
+    // neighbouring selected indices.
+
+    QList<int>::iterator it = std::lower_bound( _selected.begin(), _selected.end(), index );
+
+    if ( it != _selected.end() && *it == index )
+        return _data.at( index );
+
+    int start = it == _selected.begin() ? 0            : *( it - 1 ) + 1;
+    int end   = it == _selected.end()   ? _data.size() : *it;
+
+    std::nth_element( _data.begin() + start,
+                      _data.begin() + index,
+                      _data.begin() + end );
+    _selected.insert( it, index );
+
+    return _data.at( index );
+}
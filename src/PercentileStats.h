@@ -12,6 +12,8 @@
 
 #include <QList>
 
+#include "QuantileSketch.h"
+
 
 typedef QList<qreal> QRealList;
 
@@ -26,9 +28,14 @@ namespace QDirStat
      *
      * Notice that one data item (one qreal, i.e. one 64 bit double) is
      * stored for each file (or each matching file) in this object, so this is
-     * expensive in terms of memory usage. Also, since data usually need to be
-     * sorted for those calculations and sorting has at least logarithmic cost
-     * O( n * log(n) ), this also has heavy performance impact.
+     * expensive in terms of memory usage. The data are not sorted completely
+     * for calculating quantiles; see valueAt().
+     *
+     * Above a threshold of data items (sketchThreshold()), the data are
+     * moved to a QuantileSketch with constant memory usage instead, and all
+     * further data items go there, too. All results are then approximations
+     * within the sketch's relative error, except min(), max(), average()
+     * and dataSize() which remain exact. data() is empty in that case.
      **/
     class PercentileStats
     {
@@ -51,28 +58,99 @@ namespace QDirStat
 
 	/**
 	 * Sort the collected data in ascending order.
-	 * This is necessary after all collect() calls.
          *
-	 * The functions accessing results like min(), max(), median(),
-	 * quantile(), percentile() etc. all implicitly sort the data if they
-	 * are not sorted yet.
+	 * This is not necessary for the functions accessing results like
+	 * min(), max(), median(), quantile(), percentile() etc.: They only
+	 * partially sort the data as far as needed with std::nth_element()
+	 * for the data items they need, which is much faster than sorting
+	 * everything if only a few quantiles are needed. Use this only to get
+	 * all of data() sorted.
 	 **/
 	void sort();
 
+	/**
+	 * Add one data item. Derived classes should use this in their
+	 * collect() methods rather than adding to _data directly.
+	 **/
+	void append( qreal value )
+	{
+	    if ( _useSketch )
+		_sketch.add( value );
+	    else
+	    {
+		_data << value;
+		_sorted = false;
+
+		if ( ! _selected.isEmpty() )
+		    _selected.clear();
+
+		if ( _sketchThreshold > 0 && _data.size() > _sketchThreshold )
+		    switchToSketch();
+	    }
+	}
+
+	/**
+	 * Add data item 'value' 'count' times. This switches to the sketch
+	 * right away if there would be too many data items afterwards.
+	 **/
+	void append( qreal value, qint64 count );
+
+	/**
+	 * Add all data items of 'other'. This switches to the sketch if
+	 * 'other' uses it or if there are too many data items afterwards.
+	 **/
+	void merge( const PercentileStats & other );
+
+	/**
+	 * Prepare for 'count' data items: Reserve space for them in _data or
+	 * switch to the sketch right away if there will be too many.
+	 **/
+	void reserve( int count );
+
         /**
          * Return the size of the collected data, i.e. the number of data
          * points.
          **/
-        int dataSize() const { return _data.size(); }
+        int dataSize() const
+	    { return _useSketch ? (int) _sketch.count() : _data.size(); }
 
 	/**
-	 * Return a reference to the collected data.
+	 * Return a reference to the collected data. This is empty if the data
+	 * are in the sketch.
 	 **/
 	QRealList & data() { return _data; }
 
+	/**
+	 * Return 'true' if the data are in the sketch, i.e. if all results
+	 * are approximations.
+	 **/
+	bool usesSketch() const { return _useSketch; }
 
-	// All calculation functions below will sort the internal data first if
-	// they are not sorted yet. This is why they are not const.
+	/**
+	 * Return the number of data items above which the data are moved to
+	 * the sketch. 0 means never.
+	 **/
+	int sketchThreshold() const { return _sketchThreshold; }
+
+	/**
+	 * Set the number of data items above which the data are moved to the
+	 * sketch. 0 means never. This takes effect with the next data item.
+	 **/
+	void setSketchThreshold( int threshold ) { _sketchThreshold = threshold; }
+
+	/**
+	 * Set the relative error of the sketch. This clears all data.
+	 **/
+	void setSketchRelativeError( qreal relativeError );
+
+	/**
+	 * Return the relative error of the sketch.
+	 **/
+	qreal sketchRelativeError() const { return _sketch.relativeError(); }
+
+
+	// All calculation functions below partially sort the internal data as
+	// needed. This is why they are not const.
 
 	/**
 	 * Calculate the median.
@@ -129,11 +207,31 @@ namespace QDirStat
          **/
         QRealList percentileSums();
 
+	/**
+	 * Return the data item with index 'index' in the sorted data.
+	 *
+	 * Unless the data are completely sorted, this selects that item with
+	 * std::nth_element() between the nearest indices selected before, and
+	 * it remembers 'index' as selected.
+	 **/
+	qreal valueAt( int index );
+
 
     protected:
 
-	QRealList _data;
-	bool	  _sorted;
+	/**
+	 * Move all data from _data to the sketch and use the sketch from now
+	 * on.
+	 **/
+	void switchToSketch();
+
+
+	QRealList	_data;
+	bool		_sorted;
+	QList<int>	_selected;	// sorted indices that have their final item
+	QuantileSketch	_sketch;
+	bool		_useSketch;
+	int		_sketchThreshold;
     };
 
 }	// namespace QDirStat
@@ -6,7 +6,17 @@
  *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
  */
 
+#include <string.h>	// memchr(), memcmp()
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QElapsedTimer>
+
 #include "PkgFileListCache.h"
+#include "PkgManager.h"
 #include "Exception.h"
 #include "Logger.h"
 
@@ -20,6 +30,10 @@ do {									  \
 	THROW( Exception( "Cache not set up for this type of lookup" ) ); \
 } while ( false )
 
+#define DISK_CACHE_HEADER	"QDirStat package file lists 1"
+#define DISK_CACHE_DIR		"qdirstat"
+#define WRITE_CHUNK_SIZE	( 1024 * 1024 )
+
 
 
 
@@ -38,6 +52,192 @@ PkgFileListCache::~PkgFileListCache()
 }
 
 
+PkgFileListCache * PkgFileListCache::create( PkgManager * pkgManager,
+					     LookupType	  lookupType )
+{
+    CHECK_PTR( pkgManager );
+
+    QString key = databaseKey( pkgManager );
+
+    if ( key.isEmpty() ) // Nothing to check a disk cache against
+	return pkgManager->createFileListCache( lookupType );
+
+    QString fileName = diskCacheName( pkgManager );
+    QElapsedTimer timer;
+    timer.start();
+
+    PkgFileListCache * cache = new PkgFileListCache( pkgManager, lookupType );
+    CHECK_NEW( cache );
+
+    if ( cache->readDiskCache( fileName, key ) )
+    {
+	logInfo() << "Read " << fileName << " in " << timer.elapsed() << " millisec" << endl;
+	return cache;
+    }
+
+    delete cache;
+
+
+    // Also set up the lookup by package for writing the disk cache
+
+    cache = pkgManager->createFileListCache( (LookupType) ( lookupType | LookupByPkg ) );
+
+    if ( ! cache )
+	return 0;
+
+    if ( cache->writeDiskCache( fileName, key ) )
+	logInfo() << "Wrote " << fileName << endl;
+
+    if ( ! ( lookupType & LookupByPkg ) )
+    {
+	cache->_pkgFileNames.clear();
+	cache->_lookupType = lookupType;
+    }
+
+    return cache;
+}
+
+
+QString PkgFileListCache::diskCacheName( PkgManager * pkgManager )
+{
+    QString dir = QString::fromUtf8( qgetenv( "XDG_CACHE_HOME" ) );
+
+    if ( dir.isEmpty() )
+	dir = QDir::homePath() + "/.cache";
+
+    return dir + "/" + DISK_CACHE_DIR + "/pkg-file-lists-" + pkgManager->name();
+}
+
+
+QString PkgFileListCache::databaseKey( PkgManager * pkgManager )
+{
+    QStringList key;
+
+    foreach ( const QString & path, pkgManager->databaseFiles() )
+    {
+	QFileInfo fileInfo( path );
+
+	if ( fileInfo.exists() )
+	{
+	    key << QString( "%1 %2 %3" )
+		.arg( path )
+		.arg( fileInfo.lastModified().toMSecsSinceEpoch() )
+		.arg( fileInfo.size() );
+	}
+    }
+
+    return key.join( " " );
+}
+
+
+bool PkgFileListCache::readDiskCache( const QString & fileName, const QString & key )
+{
+    QFile file( fileName );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+	return false;
+
+    qint64 size = file.size();
+    const char * data = size > 0 ? (const char *) file.map( 0, size ) : 0;
+
+    if ( ! data )
+	return false;
+
+    QByteArray header = QByteArray( DISK_CACHE_HEADER "\n" ) + key.toUtf8() + "\n";
+
+    if ( size < header.size() || memcmp( data, header.constData(), header.size() ) != 0 )
+    {
+	logInfo() << "Outdated " << fileName << endl;
+	return false;
+    }
+
+    const char * pos = data + header.size();
+    const char * end = data + size;
+    QString pkgName;
+
+    while ( pos < end )
+    {
+	const char * eol = (const char *) memchr( pos, '\n', end - pos );
+
+	if ( ! eol )
+	{
+	    logError() << "Truncated " << fileName << endl;
+	    return false;
+	}
+
+	QString line = QString::fromUtf8( pos, eol - pos );
+
+	if ( ! line.startsWith( '/' ) )
+	    pkgName = line;
+	else if ( ! pkgName.isEmpty() )
+	    add( pkgName, line );
+
+	pos = eol + 1;
+    }
+
+    return true;
+}
+
+
+bool PkgFileListCache::writeDiskCache( const QString & fileName, const QString & key ) const
+{
+    CHECK_LOOKUP_TYPE( LookupByPkg );
+
+    QDir().mkpath( QFileInfo( fileName ).path() );
+    QSaveFile file( fileName ); // Only replaces the old one when complete
+
+    if ( ! file.open( QIODevice::WriteOnly ) )
+    {
+	logWarning() << "Can't open " << fileName << ": " << file.errorString() << endl;
+	return false;
+    }
+
+    QByteArray data = QByteArray( DISK_CACHE_HEADER "\n" ) + key.toUtf8() + "\n";
+    QString lastPkgName;
+
+    for ( QMultiMap<QString, QString>::const_iterator it = _pkgFileNames.constBegin();
+	  it != _pkgFileNames.constEnd();
+	  ++it )
+    {
+	const QString & path = it.value();
+
+	// Package names can't start with '/', and neither may contain a newline
+
+	if ( ! path.startsWith( '/' ) || path.contains( '\n' ) ||
+	     it.key().isEmpty() || it.key().startsWith( '/' ) || it.key().contains( '\n' ) )
+	{
+	    logWarning() << "Can't write " << it.key() << ": \"" << path << "\" to " << fileName << endl;
+	    file.cancelWriting();
+	    return false;
+	}
+
+	if ( it.key() != lastPkgName )
+	{
+	    lastPkgName = it.key();
+	    data += lastPkgName.toUtf8() + "\n";
+	}
+
+	data += path.toUtf8() + "\n";
+
+	if ( data.size() > WRITE_CHUNK_SIZE )
+	{
+	    file.write( data );
+	    data.clear();
+	}
+    }
+
+    file.write( data );
+
+    if ( ! file.commit() )
+    {
+	logWarning() << "Error writing " << fileName << ": " << file.errorString() << endl;
+	return false;
+    }
+
+    return true;
+}
+
+
 QStringList PkgFileListCache::fileList( const QString & pkgName )
 {
     CHECK_LOOKUP_TYPE( LookupByPkg );
@@ -65,6 +265,14 @@ bool PkgFileListCache::containsFile( const QString & fileName ) const
 }
 
 
+const PathTrie & PkgFileListCache::files() const
+{
+    CHECK_LOOKUP_TYPE( LookupGlobal );
+
+    return _fileNames;
+}
+
+
 void PkgFileListCache::remove( const QString & pkgName )
 {
     CHECK_LOOKUP_TYPE( LookupByPkg );
@@ -87,5 +295,37 @@ void PkgFileListCache::add( const QString & pkgName,
 	_pkgFileNames.insert( pkgName, fileName );
 
     if ( _lookupType & LookupGlobal )
-	_fileNames.insert( fileName );
+	_fileNames.add( fileName );
+}
+
+
+
+PkgFileListCacheThread::~PkgFileListCacheThread()
+{
+    delete _cache;
+}
+
+
+PkgFileListCache * PkgFileListCacheThread::takeCache()
+{
+    PkgFileListCache * cache = _cache;
+    _cache = 0;
+
+    return cache;
+}
+
+
+void PkgFileListCacheThread::run()
+{
+    CHECK_PTR( _pkgManager );
+
+    try
+    {
+	_cache = PkgFileListCache::create( _pkgManager, _lookupType );
+    }
+    catch ( const Exception & ex )
+    {
+	CAUGHT( ex );
+	_cache = 0;
+    }
 }
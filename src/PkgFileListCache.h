@@ -11,7 +11,9 @@
 
 #include <QString>
 #include <QMultiMap>
-#include <QSet>
+#include <QThread>
+
+#include "PathTrie.h"
 
 
 namespace QDirStat
@@ -55,6 +57,17 @@ namespace QDirStat
 	 **/
 	virtual ~PkgFileListCache();
 
+	/**
+	 * Create a file list cache for all installed packages like
+	 * PkgManager::createFileListCache(), but read it from a disk cache
+	 * in the user's cache directory if the package database did not
+	 * change since that was written. Otherwise write a new disk cache.
+	 *
+	 * Ownership of the cache is transferred to the caller.
+	 **/
+	static PkgFileListCache * create( PkgManager * pkgManager,
+					  LookupType   lookupType = LookupByPkg );
+
 	/**
 	 * Return the sorted file list for a package.
 	 **/
@@ -72,6 +85,14 @@ namespace QDirStat
 	 **/
 	bool containsFile( const QString & fileName ) const;
 
+	/**
+	 * Return the file names of all packages as a path trie for looking
+	 * up the entries of one directory after another without building
+	 * the complete path of each one. This is only filled for
+	 * LookupGlobal.
+	 **/
+	const PathTrie & files() const;
+
 	/**
 	 * Return 'true' if the cache is empty, 'false' if not.
 	 **/
@@ -106,11 +127,89 @@ namespace QDirStat
 
     protected:
 
+	/**
+	 * Read the disk cache 'fileName' if it was written for the package
+	 * database state 'key'. Return 'true' on success, 'false' if not.
+	 *
+	 * The disk cache is a text file: After a header line and the key
+	 * line, each line is either a package name or (starting with '/')
+	 * a path that belongs to the last package.
+	 **/
+	bool readDiskCache( const QString & fileName, const QString & key );
+
+	/**
+	 * Write this cache to the disk cache 'fileName' for the package
+	 * database state 'key'. This needs lookup type LookupByPkg.
+	 * Return 'true' on success, 'false' if not.
+	 **/
+	bool writeDiskCache( const QString & fileName, const QString & key ) const;
+
+	/**
+	 * Return the path of the disk cache for 'pkgManager'.
+	 **/
+	static QString diskCacheName( PkgManager * pkgManager );
+
+	/**
+	 * Return a key for the current state of the package database of
+	 * 'pkgManager' or an empty string if there is none.
+	 **/
+	static QString databaseKey( PkgManager * pkgManager );
+
+
 	PkgManager *		    _pkgManager;
 	LookupType		    _lookupType;
 	QMultiMap<QString, QString> _pkgFileNames;
-	QSet<QString>		    _fileNames;
+	PathTrie		    _fileNames;
+    };
+
+
+    /**
+     * Thread for creating and filling a PkgFileListCache with
+     * PkgManager::createFileListCache() while the GUI thread keeps
+     * processing events.
+     *
+     * Nothing else may use the package manager while this thread is
+     * running.
+     **/
+    class PkgFileListCacheThread: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	PkgFileListCacheThread( PkgManager *		     pkgManager,
+				PkgFileListCache::LookupType lookupType ):
+	    QThread(),
+	    _pkgManager( pkgManager ),
+	    _lookupType( lookupType ),
+	    _cache( 0 )
+	    {}
+
+	/**
+	 * Destructor. This deletes the cache unless it was taken.
+	 **/
+	virtual ~PkgFileListCacheThread();
+
+	/**
+	 * Return the cache and transfer ownership to the caller. This
+	 * returns 0 if the cache could not be created. This is only valid
+	 * when the thread is finished.
+	 **/
+	PkgFileListCache * takeCache();
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	PkgManager *		     _pkgManager;
+	PkgFileListCache::LookupType _lookupType;
+	PkgFileListCache *	     _cache;
     };
+
 }	// namespace QDirStat
 
 #endif	// PkgFileListCache_h
@@ -32,6 +32,7 @@ PkgInfo::PkgInfo( const QString & name,
     _multiArch( false )
 {
     // logDebug() << "Creating " << this << endl;
+    _nodeKind = PkgNode;
 }
 
 
@@ -51,6 +52,7 @@ PkgInfo::PkgInfo( DirTree *       tree,
     _multiArch( false )
 {
     // logDebug() << "Creating " << this << endl;
+    _nodeKind = PkgNode;
 }
 
 
@@ -27,6 +27,22 @@ PkgManager::~PkgManager()
 }
 
 
+QMap<QString, QString> PkgManager::owningPkgs( const QStringList & paths )
+{
+    QMap<QString, QString> pkgs;
+
+    foreach ( const QString & path, paths )
+    {
+	QString pkg = owningPkg( path );
+
+	if ( ! pkg.isEmpty() )
+	    pkgs.insert( path, pkg );
+    }
+
+    return pkgs;
+}
+
+
 QStringList PkgManager::fileList( PkgInfo * pkg )
 {
     QStringList fileList;
@@ -11,6 +11,7 @@
 #define PkgManager_h
 
 #include <QString>
+#include <QMap>
 
 #include "PkgInfo.h"
 #include "PkgFileListCache.h"
@@ -101,6 +102,18 @@ namespace QDirStat
 	 **/
 	virtual QString owningPkg( const QString & path ) = 0;
 
+	/**
+	 * Return the owning packages of the files or directories with full
+	 * paths 'paths': A map from each path that is owned by a package to
+	 * that package. Paths that are not owned by any package are not in
+	 * the map.
+	 *
+	 * This default implementation calls owningPkg() for each path.
+	 * Derived classes should reimplement this if the package manager
+	 * command can look up several paths in one call.
+	 **/
+	virtual QMap<QString, QString> owningPkgs( const QStringList & paths );
+
 
 	//-----------------------------------------------------------------
 	//		       Optional Features
@@ -157,6 +170,14 @@ namespace QDirStat
 	virtual QStringList parseFileList( const QString & output )
 	    { Q_UNUSED( output); return QStringList(); }
 
+	/**
+	 * Return 'true' if fileList() reads the package manager's database
+	 * directly rather than starting an external command, so it is cheap
+	 * enough to get the file lists of many packages one by one without
+	 * any background processes.
+	 **/
+	virtual bool supportsNativeFileList() { return false; }
+
 	/**
 	 * Return 'true' if this package manager supports building a file list
 	 * cache for getting all file lists for all packages.
@@ -177,6 +198,16 @@ namespace QDirStat
 	virtual PkgFileListCache * createFileListCache( PkgFileListCache::LookupType lookupType = PkgFileListCache::LookupByPkg )
 	    { Q_UNUSED( lookupType ); return 0; }
 
+	/**
+	 * Return the files or directories of the package database whose
+	 * modification times and sizes change when packages are installed,
+	 * updated or removed. PkgFileListCache::create() uses them to check
+	 * if its disk cache is still valid.
+	 *
+	 * This default implementation returns nothing, i.e. no disk cache.
+	 **/
+	virtual QStringList databaseFiles() { return QStringList(); }
+
 	/**
 	 * Return a name suitable for a detailed queries for 'pkg'.
 	 */
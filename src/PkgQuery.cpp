@@ -20,7 +20,7 @@
 #include "SysUtil.h"
 
 
-#define CACHE_SIZE		500
+#define CACHE_SIZE		5000
 #define CACHE_COST		1
 
 #define VERBOSE_PKG_QUERY	1
@@ -126,6 +126,12 @@ QString PkgQuery::owningPkg( const QString & path )
 }
 
 
+QMap<QString, QString> PkgQuery::owningPkgs( const QStringList & paths )
+{
+    return instance()->getOwningPackages( paths );
+}
+
+
 PkgInfoList PkgQuery::installedPkg()
 {
     return instance()->getInstalledPkg();
@@ -138,18 +144,28 @@ QStringList PkgQuery::fileList( PkgInfo * pkg )
 }
 
 
+bool PkgQuery::cachedOwningPkg( const QString & path, QString & pkg_ret )
+{
+    PkgQuery * query = instance();
+    QMutexLocker locker( &query->_cacheMutex );
+
+    if ( ! query->_cache.contains( path ) )
+	return false;
+
+    pkg_ret = *( query->_cache[ path ] );
+
+    return true;
+}
+
+
 QString PkgQuery::getOwningPackage( const QString & path )
 {
     QString pkg = "";
     QString foundBy;
-    bool haveResult = false;
+    bool haveResult = cachedOwningPkg( path, pkg );
 
-    if ( _cache.contains( path ) )
-    {
-	haveResult = true;
-	foundBy	   = "Cache";
-	pkg	   = *( _cache[ path ] );
-    }
+    if ( haveResult )
+	foundBy = "Cache";
 
 
     if ( ! haveResult )
@@ -170,6 +186,7 @@ QString PkgQuery::getOwningPackage( const QString & path )
 	    foundBy = "all";
 
 	// Insert package name (even if empty) into the cache
+	QMutexLocker locker( &_cacheMutex );
 	_cache.insert( path, new QString( pkg ), CACHE_COST );
     }
 
@@ -184,6 +201,70 @@ QString PkgQuery::getOwningPackage( const QString & path )
 }
 
 
+QMap<QString, QString> PkgQuery::getOwningPackages( const QStringList & paths )
+{
+    QMap<QString, QString> pkgs;
+    QStringList unknown;
+
+    foreach ( const QString & path, paths )
+    {
+	QString pkg;
+
+	if ( cachedOwningPkg( path, pkg ) )
+	    pkgs.insert( path, pkg );
+	else if ( ! pkgs.contains( path ) )
+	    unknown << path;
+    }
+
+    unknown.removeDuplicates();
+
+    for ( int start = 0; start < unknown.size(); start += OWNING_PKG_BATCH_SIZE )
+    {
+	QStringList batch = unknown.mid( start, OWNING_PKG_BATCH_SIZE );
+	QMap<QString, QString> found;
+
+	foreach ( PkgManager * pkgManager, _pkgManagers )
+	{
+	    // Ask the next package manager only for what is still unowned
+
+	    QStringList rest;
+
+	    foreach ( const QString & path, batch )
+	    {
+		if ( ! found.contains( path ) )
+		    rest << path;
+	    }
+
+	    if ( rest.isEmpty() )
+		break;
+
+	    found.unite( pkgManager->owningPkgs( rest ) );
+	}
+
+	// Insert the package names (even if empty) into the cache
+
+	QMutexLocker locker( &_cacheMutex );
+
+	foreach ( const QString & path, batch )
+	{
+	    QString pkg = found.value( path );
+	    _cache.insert( path, new QString( pkg ), CACHE_COST );
+	    pkgs.insert( path, pkg );
+	}
+    }
+
+#if VERBOSE_PKG_QUERY
+    if ( ! unknown.isEmpty() )
+    {
+	logDebug() << "Looked up the owning packages of " << unknown.size() << " paths; "
+		   << ( paths.size() - unknown.size() ) << " from the cache" << endl;
+    }
+#endif
+
+    return pkgs;
+}
+
+
 PkgInfoList PkgQuery::getInstalledPkg()
 {
     PkgInfoList pkgList;
@@ -245,3 +326,192 @@ bool PkgQuery::checkFileListSupport()
 
     return false;
 }
+
+
+
+
+void OwningPkgThread::run()
+{
+    _pkg = PkgQuery::owningPkg( _path );
+}
+
+
+void OwningPkgBatchThread::run()
+{
+    _pkgs = PkgQuery::owningPkgs( _paths );
+}
+
+
+
+
+OwningPkgQuery::OwningPkgQuery( QObject * parent ):
+    QObject( parent ),
+    _thread( 0 )
+{
+    // NOP
+}
+
+
+OwningPkgQuery::~OwningPkgQuery()
+{
+    if ( _thread )
+    {
+	_thread->wait();
+	delete _thread;
+    }
+}
+
+
+void OwningPkgQuery::request( const QString & path )
+{
+    _requestedPath = path;
+    _pendingPath.clear();
+
+    QString pkg;
+
+    if ( PkgQuery::cachedOwningPkg( path, pkg ) )
+    {
+	emit result( path, pkg );
+	return;
+    }
+
+    if ( _thread )
+	_pendingPath = path;	// Start it when the running lookup is finished
+    else
+	startLookup( path );
+}
+
+
+void OwningPkgQuery::cancel()
+{
+    _requestedPath.clear();
+    _pendingPath.clear();
+}
+
+
+void OwningPkgQuery::startLookup( const QString & path )
+{
+    _thread = new OwningPkgThread( path );
+    CHECK_NEW( _thread );
+
+    connect( _thread, SIGNAL( finished()	   ),
+	     this,    SLOT  ( lookupFinished() ) );
+
+    _thread->start();
+}
+
+
+void OwningPkgQuery::lookupFinished()
+{
+    if ( ! _thread )
+	return;
+
+    _thread->wait();
+    QString path = _thread->path();
+    QString pkg	 = _thread->pkg();
+
+    delete _thread;
+    _thread = 0;
+
+    if ( path == _requestedPath )
+	emit result( path, pkg );
+
+    if ( ! _pendingPath.isEmpty() )
+    {
+	QString nextPath = _pendingPath;
+	_pendingPath.clear();
+	startLookup( nextPath );
+    }
+}
+
+
+
+
+OwningPkgBatchQuery::OwningPkgBatchQuery( QObject * parent ):
+    QObject( parent ),
+    _thread( 0 ),
+    _cancelled( false )
+{
+    // NOP
+}
+
+
+OwningPkgBatchQuery::~OwningPkgBatchQuery()
+{
+    if ( _thread )
+    {
+	_thread->wait();
+	delete _thread;
+    }
+}
+
+
+void OwningPkgBatchQuery::request( const QStringList & paths )
+{
+    QStringList unknown;
+
+    foreach ( const QString & path, paths )
+    {
+	QString pkg;
+
+	if ( ! PkgQuery::cachedOwningPkg( path, pkg ) )
+	    unknown << path;
+    }
+
+    _pendingPaths.clear();
+
+    if ( _thread )
+    {
+	// Start it when the running lookup is finished
+
+	_cancelled    = true;
+	_pendingPaths = unknown;
+    }
+    else if ( ! unknown.isEmpty() )
+    {
+	startLookup( unknown );
+    }
+}
+
+
+void OwningPkgBatchQuery::cancel()
+{
+    _cancelled = true;
+    _pendingPaths.clear();
+}
+
+
+void OwningPkgBatchQuery::startLookup( const QStringList & paths )
+{
+    _cancelled = false;
+    _thread = new OwningPkgBatchThread( paths );
+    CHECK_NEW( _thread );
+
+    connect( _thread, SIGNAL( finished()	   ),
+	     this,    SLOT  ( lookupFinished() ) );
+
+    _thread->start( QThread::LowPriority );
+}
+
+
+void OwningPkgBatchQuery::lookupFinished()
+{
+    if ( ! _thread )
+	return;
+
+    _thread->wait();
+    QMap<QString, QString> pkgs = _thread->pkgs();
+
+    delete _thread;
+    _thread = 0;
+
+    if ( ! _cancelled )
+	emit results( pkgs );
+
+    if ( ! _pendingPaths.isEmpty() )
+    {
+	QStringList nextPaths = _pendingPaths;
+	_pendingPaths.clear();
+	startLookup( nextPaths );
+    }
+}
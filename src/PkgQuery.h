@@ -11,11 +11,19 @@
 #define PkgQuery_h
 
 #include <QString>
+#include <QStringList>
+#include <QMap>
 #include <QCache>
+#include <QMutex>
+#include <QThread>
 
 #include "PkgInfo.h"
 
 
+// Maximum number of paths for one package manager command
+#define OWNING_PKG_BATCH_SIZE	100
+
+
 namespace QDirStat
 {
     class PkgManager;
@@ -34,6 +42,24 @@ namespace QDirStat
 	 **/
 	static QString owningPkg( const QString & path );
 
+	/**
+	 * Return the owning packages of many files or directories with full
+	 * paths 'paths' at once: A map from each of the paths to its owning
+	 * package or to an empty string if it is not owned by any package.
+	 *
+	 * This is a lot faster than calling owningPkg() for each path: The
+	 * package manager commands are called only once for up to
+	 * OWNING_PKG_BATCH_SIZE paths. The results are added to the cache.
+	 **/
+	static QMap<QString, QString> owningPkgs( const QStringList & paths );
+
+	/**
+	 * Look up the owning package of 'path' only in the cache of previous
+	 * queries. Return 'true' and set 'pkg_ret' if it is there, 'false'
+	 * if not.
+	 **/
+	static bool cachedOwningPkg( const QString & path, QString & pkg_ret );
+
 	/**
 	 * Return the singleton instance of this class.
 	 **/
@@ -80,6 +106,12 @@ namespace QDirStat
 	 **/
 	QString getOwningPackage( const QString & path );
 
+	/**
+	 * Return the owning packages of many files or directories with full
+	 * paths 'paths'. See owningPkgs().
+	 **/
+	QMap<QString, QString> getOwningPackages( const QStringList & paths );
+
         /**
          * Return the list of installed packages.
          *
@@ -136,9 +168,213 @@ namespace QDirStat
 	QList <PkgManager *>	 _pkgManagers;
 	QList <PkgManager *>	 _secondaryPkgManagers;
 	QCache<QString, QString> _cache;
+	QMutex			 _cacheMutex;	// owningPkg() is also used in threads
 
     }; // class PkgQuery
 
+
+    /**
+     * Thread for one PkgQuery::owningPkg() lookup.
+     **/
+    class OwningPkgThread: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	OwningPkgThread( const QString & path ):
+	    QThread(),
+	    _path( path )
+	    {}
+
+	/**
+	 * Return the path that is looked up.
+	 **/
+	const QString & path() const { return _path; }
+
+	/**
+	 * Return the owning package. This is only valid when the thread is
+	 * finished.
+	 **/
+	const QString & pkg() const { return _pkg; }
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	QString _path;
+	QString _pkg;
+    };
+
+
+    /**
+     * Thread for one PkgQuery::owningPkgs() lookup.
+     **/
+    class OwningPkgBatchThread: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	OwningPkgBatchThread( const QStringList & paths ):
+	    QThread(),
+	    _paths( paths )
+	    {}
+
+	/**
+	 * Return the owning packages. This is only valid when the thread is
+	 * finished.
+	 **/
+	const QMap<QString, QString> & pkgs() const { return _pkgs; }
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	QStringList		_paths;
+	QMap<QString, QString>	_pkgs;
+    };
+
+
+    /**
+     * Lookup of the owning package of a file in a background thread, so
+     * the external package manager command (dpkg -S, rpm -qf, pacman -Qo)
+     * doesn't block the GUI.
+     *
+     * Only the latest request counts: A request that arrives while a
+     * lookup is running replaces any other one that is still waiting, and
+     * the result of a lookup that was overtaken by a newer request is only
+     * added to the PkgQuery cache, but not reported.
+     **/
+    class OwningPkgQuery: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	OwningPkgQuery( QObject * parent = 0 );
+
+	/**
+	 * Destructor. This waits for a running lookup.
+	 **/
+	virtual ~OwningPkgQuery();
+
+	/**
+	 * Request the owning package of 'path'. The result() signal is sent
+	 * immediately if it is already in the PkgQuery cache.
+	 **/
+	void request( const QString & path );
+
+	/**
+	 * Cancel the current request: Its result is not reported.
+	 **/
+	void cancel();
+
+    signals:
+
+	/**
+	 * Report the owning package 'pkg' of 'path' (empty if it isn't
+	 * owned by any package).
+	 **/
+	void result( const QString & path, const QString & pkg );
+
+    protected slots:
+
+	/**
+	 * Notification that the lookup thread is finished.
+	 **/
+	void lookupFinished();
+
+    protected:
+
+	/**
+	 * Start the lookup thread for 'path'.
+	 **/
+	void startLookup( const QString & path );
+
+
+	OwningPkgThread * _thread;
+	QString		  _requestedPath;	// empty if cancelled
+	QString		  _pendingPath;		// waiting for the thread
+    };
+
+
+    /**
+     * Lookup of the owning packages of many files in a background thread,
+     * e.g. to fill the PkgQuery cache for a list of search results before
+     * the user clicks on them.
+     *
+     * As with OwningPkgQuery, only the latest request counts: A new
+     * request replaces one that is still waiting, and the results of a
+     * cancelled or overtaken lookup are only added to the PkgQuery cache.
+     **/
+    class OwningPkgBatchQuery: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	OwningPkgBatchQuery( QObject * parent = 0 );
+
+	/**
+	 * Destructor. This waits for a running lookup.
+	 **/
+	virtual ~OwningPkgBatchQuery();
+
+	/**
+	 * Request the owning packages of 'paths'. Paths that are already in
+	 * the PkgQuery cache are not looked up again.
+	 **/
+	void request( const QStringList & paths );
+
+	/**
+	 * Cancel the current request: Its results are not reported.
+	 **/
+	void cancel();
+
+    signals:
+
+	/**
+	 * Report the owning packages of the requested paths that were not
+	 * in the cache: A map from each path to its owning package (empty if
+	 * it isn't owned by any package).
+	 **/
+	void results( const QMap<QString, QString> & pkgs );
+
+    protected slots:
+
+	/**
+	 * Notification that the lookup thread is finished.
+	 **/
+	void lookupFinished();
+
+    protected:
+
+	/**
+	 * Start the lookup thread for 'paths'.
+	 **/
+	void startLookup( const QStringList & paths );
+
+
+	OwningPkgBatchThread * _thread;
+	bool		       _cancelled;	// the running lookup
+	QStringList	       _pendingPaths;	// waiting for the thread
+    };
+
 } // namespace QDirStat
 
 
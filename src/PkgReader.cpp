@@ -10,12 +10,15 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <QSet>
+
 #include "PkgReader.h"
 #include "PkgQuery.h"
 #include "PkgManager.h"
 #include "PkgFileListCache.h"
 #include "DirTree.h"
 #include "ProcessStarter.h"
+#include "SpawnedProcess.h"
 #include "Settings.h"
 #include "Logger.h"
 #include "Exception.h"
@@ -66,6 +69,10 @@ void PkgReader::read( const PkgFilter & filter )
     {
 	createCachePkgReadJobs();
     }
+    else if ( pkgManager && pkgManager->supportsNativeFileList() )
+    {
+	createPkgReadJobs();
+    }
     else
     {
 	createAsyncPkgReadJobs();
@@ -191,20 +198,42 @@ void PkgReader::createCachePkgReadJobs()
     PkgManager * pkgManager = PkgQuery::primaryPkgManager();
     CHECK_PTR( pkgManager );
 
-    QSharedPointer<PkgFileListCache> fileListCache( pkgManager->createFileListCache() );
+    QSharedPointer<PkgFileListCache> fileListCache( PkgFileListCache::create( pkgManager ) );
     // The shared pointer will take care of deleting the cache when the last
     // job that uses it is destroyed.
 
     if ( ! fileListCache )
     {
 	logError() << "Creating the file list cache failed" << endl;
+	createAsyncPkgReadJobs();
 	return;
     }
 
+    QList<CachePkgReadJob *> jobs;
+
     foreach ( PkgInfo * pkg, _pkgList )
     {
 	CachePkgReadJob * job = new CachePkgReadJob( _tree, pkg, fileListCache );
 	CHECK_NEW( job );
+	_tree->addBlockedJob( job );
+	jobs << job;
+    }
+
+    // The prefetcher deletes itself when it is done; its parent is the tree
+    // in case the tree is destroyed before that.
+
+    PkgStatPrefetcher * prefetcher = new PkgStatPrefetcher( _tree, jobs );
+    CHECK_NEW( prefetcher );
+    prefetcher->start( qMax( 2, QThread::idealThreadCount() ) );
+}
+
+
+void PkgReader::createPkgReadJobs()
+{
+    foreach ( PkgInfo * pkg, _pkgList )
+    {
+	PkgReadJob * job = new PkgReadJob( _tree, pkg );
+	CHECK_NEW( job );
 	_tree->addJob( job );
     }
 }
@@ -252,13 +281,10 @@ Process * PkgReader::createReadFileListProcess( PkgInfo * pkg )
     QStringList args	 = command.split( QRegExp( "\\s+" ) );
     QString	program	 = args.takeFirst();
 
-    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-    env.insert( "LANG", "C" ); // Prevent output in translated languages
-
     Process * process = new Process();
     process->setProgram( program );
     process->setArguments( args );
-    process->setProcessEnvironment( env );
+    process->setProcessEnvironment( SpawnedProcess::processEnvironment() ); // built only once
     process->setProcessChannelMode( QProcess::MergedChannels ); // combine stdout and stderr
 
     // Intentionally NOT starting the process yet
@@ -343,6 +369,20 @@ void PkgReadJob::reportCacheStats()
 }
 
 
+void PkgReadJob::addToStatCache( const QHash<QString, struct stat> & stats )
+{
+    QHash<QString, struct stat>::const_iterator it = stats.constBegin();
+
+    while ( it != stats.constEnd() )
+    {
+        _statCache.insert( it.key(), it.value() );
+        ++it;
+    }
+
+    _lstatCalls += stats.size();
+}
+
+
 void PkgReadJob::startReading()
 {
     // logInfo() << "Reading " << _pkg << endl;
@@ -527,7 +567,29 @@ AsyncPkgReadJob::AsyncPkgReadJob( DirTree * tree,
     {
 	connect( _readFileListProcess, SIGNAL( finished		   ( int, QProcess::ExitStatus ) ),
 		 this,		       SLOT  ( readFileListFinished( int, QProcess::ExitStatus ) ) );
+
+	connect( _readFileListProcess, SIGNAL( readyRead()	   ),
+		 this,		       SLOT  ( readFileListOutput() ) );
+    }
+}
+
+
+void AsyncPkgReadJob::readFileListOutput()
+{
+    QByteArray output = _incompleteLine + _readFileListProcess->readAll();
+    int lastNewline = output.lastIndexOf( '\n' );
+
+    if ( lastNewline < 0 )
+    {
+	_incompleteLine = output;
+	return;
     }
+
+    // Parse each part of the output as it arrives: That needs only memory
+    // for this part, not for the complete output as one big string.
+
+    _incompleteLine = output.mid( lastNewline + 1 );
+    _fileList += _pkg->pkgManager()->parseFileList( QString::fromUtf8( output.constData(), lastNewline ) );
 }
 
 
@@ -555,9 +617,13 @@ void AsyncPkgReadJob::readFileListFinished( int			 exitCode,
 
     if ( ok )
     {
-	QString output = QString::fromUtf8( _readFileListProcess->readAll() );
-	_fileList      = _pkg->pkgManager()->parseFileList( output );
-	_tree->unblock( this ); // schedule this job
+	readFileListOutput();
+
+	if ( ! _incompleteLine.isEmpty() ) // Last line without a newline
+	    _fileList += _pkg->pkgManager()->parseFileList( QString::fromUtf8( _incompleteLine ) );
+
+	_incompleteLine.clear();
+	resume(); // schedule this job
 	_readFileListProcess->deleteLater();
     }
     else
@@ -585,35 +651,214 @@ CachePkgReadJob::CachePkgReadJob( DirTree * tree,
 				  PkgInfo * pkg,
 				  QSharedPointer<PkgFileListCache> fileListCache ):
     PkgReadJob( tree, pkg ),
-    _fileListCache( fileListCache )
+    _fileListCache( fileListCache ),
+    _haveFileList( false )
 {
+    // Take the file list from the cache right away so a PkgStatPrefetcher
+    // can use it before this job is started.
 
-}
-
-
-QStringList CachePkgReadJob::fileList()
-{
     if ( _fileListCache &&
 	 _fileListCache->pkgManager() == _pkg->pkgManager() )
     {
 	QString pkgName = _pkg->pkgManager()->queryName( _pkg );
-        QStringList fileList;
 
 	if ( _fileListCache->containsPkg( pkgName ) )
 	{
-            fileList = _fileListCache->fileList( pkgName );
+            _fileList = _fileListCache->fileList( pkgName );
             _fileListCache->remove( pkgName );
 	}
 	else if ( _fileListCache->containsPkg( _pkg->name() ) )
 	{
-	    fileList = _fileListCache->fileList( _pkg->name() );
+	    _fileList = _fileListCache->fileList( _pkg->name() );
             _fileListCache->remove( _pkg->name() );
 	}
 
-        return fileList;
+        _haveFileList = true;
     }
+}
+
+
+QStringList CachePkgReadJob::fileList()
+{
+    if ( _haveFileList )
+        return _fileList;
 
     logDebug() << "Falling back to the simple PkgQuery::fileList() for " << _pkg << endl;
 
     return PkgQuery::fileList( _pkg );
 }
+
+
+
+
+
+
+PkgStatPrefetcher::PkgStatPrefetcher( DirTree * tree, const QList<CachePkgReadJob *> & jobs ):
+    QObject( tree ),
+    _tree( tree ),
+    _nextBatch( 0 ),
+    _doneBatches( 0 )
+{
+    foreach ( CachePkgReadJob * job, jobs )
+    {
+        _jobs	   << job;
+        _fileLists << job->cachedFileList();	// implicitly shared
+    }
+
+    _batchCount = ( _jobs.size() + PKG_STAT_BATCH_SIZE - 1 ) / PKG_STAT_BATCH_SIZE;
+}
+
+
+PkgStatPrefetcher::~PkgStatPrefetcher()
+{
+    // Make sure the threads don't take any more batches
+
+    _nextBatch.fetchAndStoreOrdered( _batchCount );
+
+    foreach ( PkgStatThread * thread, _threads )
+    {
+        thread->wait();
+        delete thread;
+    }
+
+    qDeleteAll( _results );
+}
+
+
+void PkgStatPrefetcher::start( int threadCount )
+{
+    threadCount = qMin( threadCount, _batchCount );
+
+    logDebug() << "Prefetching file stats for " << _jobs.size() << " packages in "
+               << _batchCount << " batches with " << threadCount << " threads" << endl;
+
+    if ( _batchCount == 0 )
+    {
+        deleteLater();
+        return;
+    }
+
+    for ( int i=0; i < threadCount; ++i )
+    {
+        PkgStatThread * thread = new PkgStatThread( this );
+        CHECK_NEW( thread );
+        _threads << thread;
+        thread->start();
+    }
+}
+
+
+int PkgStatPrefetcher::takeBatch()
+{
+    int index = _nextBatch.fetchAndAddOrdered( 1 );
+
+    return index < _batchCount ? index : -1;
+}
+
+
+void PkgStatPrefetcher::addBatch( PkgStatBatch * batch )
+{
+    {
+        QMutexLocker locker( &_mutex );
+        _results << batch;
+    }
+
+    QMetaObject::invokeMethod( this, "processBatches", Qt::QueuedConnection );
+}
+
+
+void PkgStatPrefetcher::processBatches()
+{
+    QList<PkgStatBatch *> results;
+
+    {
+        QMutexLocker locker( &_mutex );
+        results = _results;
+        _results.clear();
+    }
+
+    foreach ( PkgStatBatch * batch, results )
+    {
+        int first = batch->index * PKG_STAT_BATCH_SIZE;
+        int last  = qMin( first + PKG_STAT_BATCH_SIZE, _jobs.size() );
+        bool haveJobs = false;
+
+        // The jobs might have been deleted in the meantime if the tree was
+        // cleared; then the stat cache might be gone as well.
+
+        for ( int i = first; i < last; ++i )
+        {
+            if ( _jobs.at( i ) )
+                haveJobs = true;
+        }
+
+        if ( haveJobs )
+            PkgReadJob::addToStatCache( batch->stats );
+
+        for ( int i = first; i < last; ++i )
+        {
+            if ( _jobs.at( i ) )
+                _jobs.at( i )->resume();
+        }
+
+        delete batch;
+        ++_doneBatches;
+    }
+
+    if ( _doneBatches >= _batchCount )
+    {
+        logDebug() << "Prefetching file stats done" << endl;
+        deleteLater();
+    }
+}
+
+
+
+
+
+
+void PkgStatThread::run()
+{
+    // Parent directories are shared between many packages; each thread only
+    // needs to do them once since its batches are processed in order.
+
+    QSet<QString> done;
+    int index;
+
+    while ( ( index = _prefetcher->takeBatch() ) >= 0 )
+    {
+        PkgStatBatch * batch = new PkgStatBatch;
+        CHECK_NEW( batch );
+        batch->index = index;
+
+        int first = index * PKG_STAT_BATCH_SIZE;
+        int last  = qMin( first + PKG_STAT_BATCH_SIZE, _prefetcher->_fileLists.size() );
+
+        for ( int i = first; i < last; ++i )
+        {
+            foreach ( const QString & fileListPath, _prefetcher->_fileLists.at( i ) )
+            {
+                // Use the same paths as PkgReadJob::addFile() / createItem()
+
+                QStringList components = fileListPath.split( "/", QString::SkipEmptyParts );
+                QString path;
+
+                foreach ( const QString & component, components )
+                {
+                    path += "/" + component;
+
+                    if ( done.contains( path ) )
+                        continue;
+
+                    done.insert( path );
+                    struct stat statInfo;
+
+                    if ( ::lstat( path.toUtf8(), &statInfo ) == 0 )
+                        batch->stats.insert( path, statInfo );
+                }
+            }
+        }
+
+        _prefetcher->addBatch( batch );
+    }
+}
@@ -10,6 +10,11 @@
 #define PkgReader_h
 
 #include <QMap>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QPointer>
+#include <QAtomicInt>
 #include <QSharedPointer>
 
 #include "DirReadJob.h"
@@ -18,6 +23,10 @@
 #include "Process.h"
 
 
+// Number of packages per batch of a PkgStatPrefetcher
+#define PKG_STAT_BATCH_SIZE	20
+
+
 namespace QDirStat
 {
     // Forward declarations
@@ -101,10 +110,19 @@ namespace QDirStat
 
         /**
          * Create a read job for each package to read its file list from a file
-         * list cache and add it to the read job queue.
+         * list cache and add it to the read job queue. The jobs are blocked
+         * until a PkgStatPrefetcher called lstat() for all their files.
          **/
         void createCachePkgReadJobs();
 
+        /**
+         * Create a simple read job for each package that gets its file list
+         * directly from the package manager and add it to the read job
+         * queue. This is for package managers that can read their database
+         * without starting external commands.
+         **/
+        void createPkgReadJobs();
+
         /**
          * Create a read job for each package with a background process to read
          * its file list and add it as a blocked job to the read job queue.
@@ -226,6 +244,12 @@ namespace QDirStat
          **/
         static void reportCacheStats();
 
+        /**
+         * Add the results of lstat() calls that were done in advance (in
+         * another thread) to the stat cache.
+         **/
+        static void addToStatCache( const QHash<QString, struct stat> & stats );
+
 
         // Data members
 
@@ -290,6 +314,12 @@ namespace QDirStat
         void readFileListFinished( int                  exitCode,
                                    QProcess::ExitStatus exitStatus );
 
+        /**
+         * Parse the complete lines of output that the read file list
+         * process has sent so far.
+         **/
+        void readFileListOutput();
+
 
     protected:
 
@@ -305,6 +335,7 @@ namespace QDirStat
 
         Process *   _readFileListProcess;
         QStringList _fileList;
+        QByteArray  _incompleteLine;     // Output after the last newline
 
     };  // class AsyncPkgReadJob
 
@@ -323,8 +354,11 @@ namespace QDirStat
 	 * file list below 'pkg'. This uses 'fileListCache' to get the file
 	 * list.
 	 *
-         * Create this type of job and add it as a normal job (not blocked,
-         * unlike AsyncPkgReadJob) to the read queue.
+         * The file list is taken from the cache right away.
+         *
+         * Create this type of job and add it as a blocked job to the read
+         * queue; a PkgStatPrefetcher unblocks it when all the files in its
+         * file list are in the stat cache.
          *
          * Reading is then started from the outside with startReading() when
          * the job queue picks this job.
@@ -338,6 +372,12 @@ namespace QDirStat
          **/
         virtual ~CachePkgReadJob() {}
 
+        /**
+         * Return the file list that was taken from the cache. This is empty
+         * if the cache is for a different package manager.
+         **/
+        const QStringList & cachedFileList() const { return _fileList; }
+
 
     protected:
 
@@ -352,9 +392,135 @@ namespace QDirStat
         // Data members
 
         QSharedPointer<PkgFileListCache> _fileListCache;
+        QStringList                      _fileList;
+        bool                             _haveFileList;
 
     };  // class CachePkgReadJob
 
+
+
+    class PkgStatPrefetcher;
+
+    /**
+     * Worker thread for PkgStatPrefetcher: Call lstat() for all files of one
+     * batch of packages after the other until there are no more batches.
+     **/
+    class PkgStatThread: public QThread
+    {
+    public:
+
+        /**
+         * Constructor.
+         **/
+        PkgStatThread( PkgStatPrefetcher * prefetcher ):
+            QThread(),
+            _prefetcher( prefetcher )
+            {}
+
+    protected:
+
+        /**
+         * The thread's main function.
+         *
+         * Reimplemented from QThread.
+         **/
+        virtual void run() Q_DECL_OVERRIDE;
+
+
+        PkgStatPrefetcher * _prefetcher;
+
+    };  // class PkgStatThread
+
+
+    /**
+     * The results of the lstat() calls for one batch of packages.
+     **/
+    struct PkgStatBatch
+    {
+        int                         index;
+        QHash<QString, struct stat> stats;
+    };
+
+
+    /**
+     * Class to call lstat() for the files of many CachePkgReadJobs in
+     * several threads in parallel while those jobs are still blocked.
+     *
+     * Most of the time of reading a package tree from the file list cache is
+     * spent waiting for lstat() calls, so doing them in parallel saves a lot
+     * of time with many packages, in particular on SSDs and network file
+     * systems. The jobs are divided into batches of PKG_STAT_BATCH_SIZE;
+     * whenever a batch is done, its results are added to the stat cache of
+     * the PkgReadJobs in the main thread, and the jobs of that batch are
+     * unblocked. Creating the DirTree nodes still happens in the main thread
+     * since DirTree is not thread-safe.
+     *
+     * This deletes itself when all batches are done.
+     **/
+    class PkgStatPrefetcher: public QObject
+    {
+        Q_OBJECT
+
+        friend class PkgStatThread;
+
+    public:
+
+        /**
+         * Constructor. 'jobs' are the (blocked) jobs to prefetch the file
+         * stats for.
+         **/
+        PkgStatPrefetcher( DirTree * tree, const QList<CachePkgReadJob *> & jobs );
+
+        /**
+         * Destructor. This waits for the threads to finish.
+         **/
+        virtual ~PkgStatPrefetcher();
+
+        /**
+         * Start 'threadCount' threads.
+         **/
+        void start( int threadCount );
+
+
+    protected slots:
+
+        /**
+         * Add the results of all finished batches to the stat cache and
+         * unblock their jobs. This is called in the main thread via a queued
+         * connection whenever a thread finished a batch.
+         **/
+        void processBatches();
+
+
+    protected:
+
+        /**
+         * Return the index of the next batch to process or -1 if there is
+         * none left. This is thread-safe.
+         **/
+        int takeBatch();
+
+        /**
+         * Add a finished batch and notify the main thread. This takes over
+         * ownership of 'batch'. This is thread-safe.
+         **/
+        void addBatch( PkgStatBatch * batch );
+
+
+        // Data members
+
+        DirTree *                         _tree;
+        QList<QPointer<CachePkgReadJob> > _jobs;
+        QList<QStringList>                _fileLists;
+        QList<PkgStatThread *>            _threads;
+        QAtomicInt                        _nextBatch;
+        int                               _batchCount;
+        int                               _doneBatches;
+        QMutex                            _mutex;
+        QList<PkgStatBatch *>             _results;
+
+    };  // class PkgStatPrefetcher
+
 }	// namespace QDirStat
 
 #endif // ifndef PkgReader_h
@@ -16,6 +16,8 @@
 #include "FileInfoSet.h"
 #include "SelectionModel.h"
 #include "CleanupCollection.h"
+#include "FileNameIndex.h"
+#include "FileRangeIndex.h"
 #include "MainWindow.h"
 #include "Logger.h"
 #include "Exception.h"
@@ -59,6 +61,18 @@ DirTree * QDirStatApp::dirTree() const
 }
 
 
+CleanupCollection * QDirStatApp::cleanupCollection()
+{
+    if ( ! _cleanupCollection )
+    {
+        _cleanupCollection = new CleanupCollection( _selectionModel );
+        CHECK_NEW( _cleanupCollection );
+    }
+
+    return _cleanupCollection;
+}
+
+
 QDirStatApp::QDirStatApp()
 {
     // logDebug() << "Creating app" << endl;
@@ -70,9 +84,13 @@ QDirStatApp::QDirStatApp()
     CHECK_NEW( _selectionModel );
 
     _dirTreeModel->setSelectionModel( _selectionModel );
+    _cleanupCollection = 0;
+
+    _fileNameIndex = new FileNameIndex( _dirTreeModel->tree() );
+    CHECK_NEW( _fileNameIndex );
 
-    _cleanupCollection = new CleanupCollection( _selectionModel );
-    CHECK_NEW( _cleanupCollection );
+    _fileRangeIndex = new FileRangeIndex( _dirTreeModel->tree() );
+    CHECK_NEW( _fileRangeIndex );
 }
 
 
@@ -80,6 +98,8 @@ QDirStatApp::~QDirStatApp()
 {
     // logDebug() << "Destroying app" << endl;
 
+    delete _fileRangeIndex;
+    delete _fileNameIndex;
     delete _cleanupCollection;
     delete _selectionModel;
     delete _dirTreeModel;
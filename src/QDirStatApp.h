@@ -19,6 +19,8 @@ namespace QDirStat
     class DirTree;
     class SelectionModel;
     class CleanupCollection;
+    class FileNameIndex;
+    class FileRangeIndex;
     class QDirStatApp;
     class FileInfo;
 
@@ -116,8 +118,26 @@ namespace QDirStat
          * or showing the directory in a file manager window. Most cleanup
          * actions are started as external commands, and they can be configured
          * to the user's liking with the configuration dialog.
+         *
+         * This is created upon the first call: Reading the cleanups from the
+         * settings is not needed for showing the main window.
+         **/
+        CleanupCollection * cleanupCollection();
+
+        /**
+         * Return the index of the file names in the DirTree. Check
+         * FileNameIndex::isReady() before using it: It is only built when
+         * reading the tree is finished, and it is dropped when the tree
+         * changes.
+         **/
+        FileNameIndex * fileNameIndex() const { return _fileNameIndex; }
+
+        /**
+         * Return the indexes of the file sizes and mtimes in the DirTree.
+         * Check FileRangeIndex::isReady() before using them, just like for
+         * the FileNameIndex.
          **/
-        CleanupCollection * cleanupCollection() const { return _cleanupCollection; }
+        FileRangeIndex * fileRangeIndex() const { return _fileRangeIndex; }
 
 
         //
@@ -164,6 +184,8 @@ namespace QDirStat
         DirTreeModel            * _dirTreeModel;
         SelectionModel          * _selectionModel;
         CleanupCollection       * _cleanupCollection;
+        FileNameIndex           * _fileNameIndex;
+        FileRangeIndex          * _fileRangeIndex;
 
         static QDirStatApp      * _instance;
 
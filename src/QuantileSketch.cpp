@@ -0,0 +1,230 @@
+/*
+ *   File name: QuantileSketch.cpp
+ *   Summary:	Statistics classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <math.h>	// log(), exp(), floor()
+
+#include "QuantileSketch.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+QuantileSketch::QuantileSketch( qreal relativeError )
+{
+    setRelativeError( relativeError );
+}
+
+
+void QuantileSketch::setRelativeError( qreal relativeError )
+{
+    if ( relativeError <= 0.0 || relativeError >= 1.0 )
+	THROW( Exception( QString( "Invalid relative error %1" ).arg( relativeError ) ) );
+
+    _relativeError = relativeError;
+    _logGamma	   = log( 1.0 + relativeError );
+    clear();
+}
+
+
+void QuantileSketch::clear()
+{
+    _counts = QVector<qint64>( 1, 0 );
+    _sums   = QVector<qreal>( 1, 0.0 );
+    _count  = 0;
+    _sum    = 0.0;
+    _min    = 0.0;
+    _max    = 0.0;
+}
+
+
+int QuantileSketch::bucketIndex( qreal value ) const
+{
+    if ( value < 1.0 )
+	return 0;
+
+    return 1 + (int) floor( log( value ) / _logGamma );
+}
+
+
+qreal QuantileSketch::lowerLimit( int index ) const
+{
+    if ( index == 0 )
+	return _min;
+
+    return qMax( _min, exp( ( index - 1 ) * _logGamma ) );
+}
+
+
+qreal QuantileSketch::upperLimit( int index ) const
+{
+    if ( index == 0 )
+	return qMin( _max, 1.0 );
+
+    return qMin( _max, exp( index * _logGamma ) );
+}
+
+
+void QuantileSketch::add( qreal value, qint64 count )
+{
+    if ( count <= 0 )
+	return;
+
+    int index = bucketIndex( value );
+
+    if ( index >= _counts.size() )
+    {
+	_counts.resize( index + 1 );
+	_sums.resize( index + 1 );
+    }
+
+    _counts[ index ] += count;
+    _sums[ index ]   += value * count;
+
+    if ( _count == 0 )
+    {
+	_min = value;
+	_max = value;
+    }
+    else
+    {
+	_min = qMin( _min, value );
+	_max = qMax( _max, value );
+    }
+
+    _count += count;
+    _sum   += value * count;
+}
+
+
+void QuantileSketch::merge( const QuantileSketch & other )
+{
+    if ( other._relativeError != _relativeError )
+	THROW( Exception( "Can't merge sketches with different relative errors" ) );
+
+    if ( other._count == 0 )
+	return;
+
+    if ( other._counts.size() > _counts.size() )
+    {
+	_counts.resize( other._counts.size() );
+	_sums.resize( other._sums.size() );
+    }
+
+    for ( int i=0; i < other._counts.size(); ++i )
+    {
+	_counts[ i ] += other._counts.at( i );
+	_sums[ i ]   += other._sums.at( i );
+    }
+
+    if ( _count == 0 )
+    {
+	_min = other._min;
+	_max = other._max;
+    }
+    else
+    {
+	_min = qMin( _min, other._min );
+	_max = qMax( _max, other._max );
+    }
+
+    _count += other._count;
+    _sum   += other._sum;
+}
+
+
+qreal QuantileSketch::valueAt( qreal rank ) const
+{
+    if ( _count == 0 )
+	return 0.0;
+
+    if ( rank <= 0.0 )
+	return _min;
+
+    if ( rank >= _count - 1 )
+	return _max;
+
+    qint64 before = 0;
+
+    for ( int i=0; i < _counts.size(); ++i )
+    {
+	qint64 count = _counts.at( i );
+
+	if ( before + count > rank )
+	{
+	    qreal lower = lowerLimit( i );
+	    qreal upper = upperLimit( i );
+
+	    return lower + ( upper - lower ) * ( rank - before ) / count;
+	}
+
+	before += count;
+    }
+
+    return _max;
+}
+
+
+qreal QuantileSketch::countBelow( qreal value ) const
+{
+    if ( _count == 0 || value <= _min )
+	return 0.0;
+
+    if ( value > _max )
+	return _count;
+
+    int	   index  = bucketIndex( value );
+    qint64 before = 0;
+
+    for ( int i=0; i < index; ++i )
+	before += _counts.at( i );
+
+    qreal lower = lowerLimit( index );
+    qreal upper = upperLimit( index );
+
+    if ( upper <= lower )
+	return before;
+
+    return before + _counts.at( index ) * ( value - lower ) / ( upper - lower );
+}
+
+
+qreal QuantileSketch::sumOfSmallest( qreal rank ) const
+{
+    if ( rank <= 0.0 )
+	return 0.0;
+
+    if ( rank >= _count )
+	return _sum;
+
+    qint64 before = 0;
+    qreal  sum	  = 0.0;
+
+    for ( int i=0; i < _counts.size(); ++i )
+    {
+	qint64 count = _counts.at( i );
+
+	if ( before + count >= rank )
+	{
+	    // The smallest 'part' of 'count' values evenly distributed
+	    // between 'lower' and 'upper'
+
+	    qreal part	= rank - before;
+	    qreal lower = lowerLimit( i );
+	    qreal upper = upperLimit( i );
+
+	    return sum + part * ( lower + ( upper - lower ) * part / ( 2.0 * count ) );
+	}
+
+	sum    += _sums.at( i );
+	before += count;
+    }
+
+    return _sum;
+}
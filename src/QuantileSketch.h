@@ -0,0 +1,140 @@
+/*
+ *   File name: QuantileSketch.h
+ *   Summary:	Statistics classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef QuantileSketch_h
+#define QuantileSketch_h
+
+#include <QVector>
+
+
+namespace QDirStat
+{
+    /**
+     * Approximate distribution of a large number of data values in constant
+     * memory: A histogram with logarithmic buckets where bucket i covers
+     * the values from gamma^(i-1) to gamma^i with
+     *
+     *	   gamma = 1 + relativeError.
+     *
+     * Any quantile taken from the sketch is in the same bucket as the exact
+     * data value of that rank, so it is within 'relativeError' of it. With
+     * the default relative error of 1%, the whole range of 64 bit file sizes
+     * needs about 4400 buckets.
+     *
+     * Values below 1.0 (e.g. file size 0) are all counted in one extra
+     * bucket below the first logarithmic one. The exact minimum, maximum,
+     * count and sum are kept in addition to the buckets.
+     *
+     * Within a bucket, the values are assumed to be distributed evenly for
+     * interpolating ranks and partial sums.
+     **/
+    class QuantileSketch
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	QuantileSketch( qreal relativeError = 0.01 );
+
+	/**
+	 * Remove all data, but keep the relative error.
+	 **/
+	void clear();
+
+	/**
+	 * Set the relative error. This clears all data.
+	 **/
+	void setRelativeError( qreal relativeError );
+
+	/**
+	 * Return the relative error.
+	 **/
+	qreal relativeError() const { return _relativeError; }
+
+	/**
+	 * Add data value 'value' 'count' times.
+	 **/
+	void add( qreal value, qint64 count = 1 );
+
+	/**
+	 * Add all data values of 'other' which must have the same relative
+	 * error.
+	 **/
+	void merge( const QuantileSketch & other );
+
+	/**
+	 * Return the number of data values.
+	 **/
+	qint64 count() const { return _count; }
+
+	/**
+	 * Return the exact sum of all data values.
+	 **/
+	qreal sum() const { return _sum; }
+
+	/**
+	 * Return the exact minimum.
+	 **/
+	qreal min() const { return _min; }
+
+	/**
+	 * Return the exact maximum.
+	 **/
+	qreal max() const { return _max; }
+
+	/**
+	 * Return the approximate value of (fractional) rank 'rank' from 0 for
+	 * the smallest value to count() - 1 for the largest.
+	 **/
+	qreal valueAt( qreal rank ) const;
+
+	/**
+	 * Return the approximate number of data values below 'value'.
+	 **/
+	qreal countBelow( qreal value ) const;
+
+	/**
+	 * Return the approximate sum of the 'rank' smallest data values.
+	 **/
+	qreal sumOfSmallest( qreal rank ) const;
+
+
+    protected:
+
+	/**
+	 * Return the bucket index for 'value'.
+	 **/
+	int bucketIndex( qreal value ) const;
+
+	/**
+	 * Return the lower and upper limit of the values in bucket 'index',
+	 * clamped to the exact minimum and maximum.
+	 **/
+	qreal lowerLimit( int index ) const;
+	qreal upperLimit( int index ) const;
+
+
+	// Data members
+
+	qreal		_relativeError;
+	qreal		_logGamma;
+	QVector<qint64> _counts;	// [0] for values below 1.0
+	QVector<qreal>	_sums;
+	qint64		_count;
+	qreal		_sum;
+	qreal		_min;
+	qreal		_max;
+
+    };	// class QuantileSketch
+
+}	// namespace QDirStat
+
+
+#endif // ifndef QuantileSketch_h
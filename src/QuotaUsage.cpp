@@ -0,0 +1,233 @@
+/*
+ *   File name: QuotaUsage.cpp
+ *   Summary:	Subtree totals that the filesystem keeps track of anyway
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>	// memset()
+#include <endian.h>	// le64toh()
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+
+#include "QuotaUsage.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+#ifdef __linux__
+#  include <sys/quota.h>
+#  include <linux/fs.h>		// FS_IOC_FSGETXATTR
+#  if defined( __has_include )
+#    if __has_include( <linux/btrfs.h> ) && __has_include( <linux/btrfs_tree.h> )
+#      include <linux/btrfs.h>
+#      include <linux/btrfs_tree.h>
+#      define HAVE_BTRFS_QGROUPS	1
+#    endif
+#  endif
+#endif
+
+#ifndef HAVE_BTRFS_QGROUPS
+#  define HAVE_BTRFS_QGROUPS	0
+#endif
+
+// Not in older glibc headers
+
+#ifndef PRJQUOTA
+#  define PRJQUOTA	2
+#endif
+
+
+using namespace QDirStat;
+
+
+bool QuotaUsage::isSupported( const QString & filesystemType )
+{
+#ifdef __linux__
+    return filesystemType == "xfs"  ||
+	   filesystemType == "ext4" ||
+	   filesystemType == "btrfs";
+#else
+    Q_UNUSED( filesystemType );
+    return false;
+#endif
+}
+
+
+bool QuotaUsage::subtreeUsage( const QString & path,
+			       const QString & device,
+			       const QString & filesystemType,
+			       QuotaTotals   & totals_ret )
+{
+    if ( ! isSupported( filesystemType ) )
+	return false;
+
+    int fd = ::open( path.toUtf8().constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+    if ( fd < 0 )
+	return false;
+
+    bool ok = filesystemType == "btrfs" ?
+	qgroupUsage( fd, totals_ret ) :
+	projectUsage( fd, device, totals_ret );
+
+    ::close( fd );
+
+    if ( ok )
+    {
+	logDebug() << path << ": " << formatSize( totals_ret.usedBytes )
+		   << " according to " << totals_ret.source << endl;
+    }
+
+    return ok;
+}
+
+
+bool QuotaUsage::projectUsage( int		fd,
+			       const QString & device,
+			       QuotaTotals   & totals_ret )
+{
+#if defined( __linux__ ) && defined( FS_IOC_FSGETXATTR )
+
+    struct fsxattr attr;
+
+    if ( ioctl( fd, FS_IOC_FSGETXATTR, &attr ) != 0 )
+	return false;
+
+    if ( attr.fsx_projid == 0 || ! ( attr.fsx_xflags & FS_XFLAG_PROJINHERIT ) )
+	return false;
+
+    // Only the top directory of the project, not every directory in it
+
+    int parentFd = openat( fd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+    if ( parentFd >= 0 )
+    {
+	struct fsxattr parentAttr;
+
+	bool sameProject = ioctl( parentFd, FS_IOC_FSGETXATTR, &parentAttr ) == 0 &&
+	    parentAttr.fsx_projid == attr.fsx_projid;
+
+	::close( parentFd );
+
+	if ( sameProject )
+	    return false;
+    }
+
+    struct dqblk quota;
+    memset( &quota, 0, sizeof( quota ) );
+
+    if ( quotactl( QCMD( Q_GETQUOTA, PRJQUOTA ), device.toUtf8().constData(),
+		   attr.fsx_projid, (caddr_t) &quota ) != 0 )
+    {
+	// ESRCH if project quotas are not enabled on this filesystem
+
+	logDebug() << "No project quota " << attr.fsx_projid << " on " << device
+		   << ": " << formatErrno() << endl;
+	return false;
+    }
+
+    totals_ret.usedBytes  = quota.dqb_curspace;
+    totals_ret.usedInodes = quota.dqb_curinodes;
+    totals_ret.source	  = QString( "project %1" ).arg( attr.fsx_projid );
+
+    return true;
+
+#else
+
+    Q_UNUSED( fd );
+    Q_UNUSED( device );
+    Q_UNUSED( totals_ret );
+
+    return false;
+
+#endif
+}
+
+
+bool QuotaUsage::qgroupUsage( int fd, QuotaTotals & totals_ret )
+{
+#if HAVE_BTRFS_QGROUPS
+
+    // The top directory of a subvolume always has this inode number
+
+    struct stat statInfo;
+
+    if ( fstat( fd, &statInfo ) != 0 || statInfo.st_ino != BTRFS_FIRST_FREE_OBJECTID )
+	return false;
+
+    struct btrfs_ioctl_ino_lookup_args lookup;
+    memset( &lookup, 0, sizeof( lookup ) );
+    lookup.objectid = BTRFS_FIRST_FREE_OBJECTID;
+
+    if ( ioctl( fd, BTRFS_IOC_INO_LOOKUP, &lookup ) != 0 )
+	return false;
+
+    __u64 subvolId = lookup.treeid;
+
+    // The info item of the level 0 qgroup 0/<subvolume ID> in the quota tree
+
+    struct btrfs_ioctl_search_args search;
+    memset( &search, 0, sizeof( search ) );
+
+    struct btrfs_ioctl_search_key & key = search.key;
+    key.tree_id	    = BTRFS_QUOTA_TREE_OBJECTID;
+    key.min_type    = BTRFS_QGROUP_INFO_KEY;
+    key.max_type    = BTRFS_QGROUP_INFO_KEY;
+    key.min_offset  = subvolId;
+    key.max_offset  = subvolId;
+    key.max_transid = (__u64) -1;
+    key.nr_items    = 1;
+
+    if ( ioctl( fd, BTRFS_IOC_TREE_SEARCH, &search ) != 0 )
+    {
+	// EPERM without CAP_SYS_ADMIN, ENOENT if quotas are not enabled
+
+	logDebug() << "No qgroup for subvolume " << subvolId << ": " << formatErrno() << endl;
+	return false;
+    }
+
+    if ( key.nr_items == 0 )
+	return false;
+
+    const struct btrfs_ioctl_search_header * header =
+	(const struct btrfs_ioctl_search_header *) search.buf;
+
+    if ( header->type != BTRFS_QGROUP_INFO_KEY || header->offset != subvolId )
+	return false;
+
+    const struct btrfs_qgroup_info_item * info =
+	(const struct btrfs_qgroup_info_item *) ( header + 1 );
+
+    totals_ret.usedBytes  = le64toh( info->rfer );
+    totals_ret.usedInodes = -1;
+    totals_ret.source	  = QString( "qgroup 0/%1" ).arg( subvolId );
+
+    return true;
+
+#else
+
+    Q_UNUSED( fd );
+    Q_UNUSED( totals_ret );
+
+    return false;
+
+#endif
+}
+
+
+QMap<int, QString> QuotaUsage::quotaModeMapping()
+{
+    QMap<int, QString> mapping;
+
+    mapping[ QuotaIgnore ] = "Ignore";
+    mapping[ QuotaShow	 ] = "Show";
+    mapping[ QuotaSkip	 ] = "Skip";
+
+    return mapping;
+}
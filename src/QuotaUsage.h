@@ -0,0 +1,112 @@
+/*
+ *   File name: QuotaUsage.h
+ *   Summary:	Subtree totals that the filesystem keeps track of anyway
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef QuotaUsage_h
+#define QuotaUsage_h
+
+
+#include <QString>
+#include <QMap>
+
+#include "FileSize.h"
+
+
+namespace QDirStat
+{
+    /**
+     * What to do with the totals of QuotaUsage while reading a tree.
+     **/
+    enum QuotaMode
+    {
+	QuotaIgnore,	// don't query them
+	QuotaShow,	// show them while the subtree is still being read
+	QuotaSkip	// don't read the subtree, use them as its totals
+    };
+
+
+    /**
+     * The totals of a subtree according to the filesystem.
+     **/
+    struct QuotaTotals
+    {
+	FileSize usedBytes;
+	qint64	 usedInodes;	// -1 if not known
+	QString	 source;	// "project 42", "qgroup 0/257", "filesystem"
+
+	QuotaTotals():
+	    usedBytes( 0 ),
+	    usedInodes( -1 )
+	    {}
+    };
+
+
+    /**
+     * Queries for the totals of subtrees that the filesystem keeps track
+     * of anyway, so reading them takes a few ioctl() calls instead of
+     * reading every directory:
+     *
+     *	 - The top directory of an XFS or ext4 project (a directory with the
+     *	   "project inherit" flag and another project ID than its parent):
+     *	   The usage of the project quota (quotactl() with PRJQUOTA).
+     *
+     *	 - The top directory of a btrfs subvolume if quotas are enabled:
+     *	   The referenced size of its level 0 qgroup. This needs
+     *	   CAP_SYS_ADMIN.
+     *
+     * This is only correct if a project ID is used for only one directory
+     * tree, which is the usual setup (see /etc/projects).
+     **/
+    class QuotaUsage
+    {
+    public:
+
+	/**
+	 * Return 'true' if there might be subtree totals on a filesystem of
+	 * type 'filesystemType'.
+	 **/
+	static bool isSupported( const QString & filesystemType );
+
+	/**
+	 * If directory 'path' is the top of a subtree that the filesystem
+	 * keeps track of, return its totals in 'totals_ret' and 'true'.
+	 * 'device' is the mounted device of that filesystem, something like
+	 * "/dev/sda3".
+	 **/
+	static bool subtreeUsage( const QString & path,
+				  const QString & device,
+				  const QString & filesystemType,
+				  QuotaTotals	& totals_ret );
+
+	/**
+	 * Return the enum mapping for QuotaMode.
+	 **/
+	static QMap<int, QString> quotaModeMapping();
+
+
+    protected:
+
+	/**
+	 * Return the usage of the project quota if directory 'fd' is the top
+	 * of a project.
+	 **/
+	static bool projectUsage( int		  fd,
+				  const QString & device,
+				  QuotaTotals	& totals_ret );
+
+	/**
+	 * Return the usage of the qgroup if directory 'fd' is the top of a
+	 * btrfs subvolume.
+	 **/
+	static bool qgroupUsage( int fd, QuotaTotals & totals_ret );
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// QuotaUsage_h
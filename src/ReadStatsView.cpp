@@ -0,0 +1,182 @@
+/*
+ *   File name: ReadStatsView.cpp
+ *   Summary:	Panel with live performance counters while reading a tree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QLabel>
+#include <QFormLayout>
+
+#include "ReadStatsView.h"
+#include "DirTree.h"
+#include "DirReadStats.h"
+#include "DirReadWorkerPool.h"
+#include "NodeAllocator.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+#define UPDATE_MILLISEC		1000
+
+
+using namespace QDirStat;
+
+
+ReadStatsView::ReadStatsView( QWidget * parent ):
+    QWidget( parent ),
+    _lastDirs( 0 ),
+    _lastEntries( 0 ),
+    _lastMillisec( 0 )
+{
+    QFormLayout * layout = new QFormLayout( this );
+    CHECK_NEW( layout );
+
+    _elapsedLabel     = addRow( layout, tr( "Elapsed:"	       ) );
+    _dirsLabel	      = addRow( layout, tr( "Directories:"     ) );
+    _entriesLabel     = addRow( layout, tr( "Entries:"	       ) );
+    _statLatencyLabel = addRow( layout, tr( "stat() p50 / p90 / p99:" ) );
+    _maxLatencyLabel  = addRow( layout, tr( "stat() max:"      ) );
+    _queueLabel	      = addRow( layout, tr( "Queued / blocked:" ) );
+    _workerTasksLabel = addRow( layout, tr( "Worker tasks:"    ) );
+    _memoryLabel      = addRow( layout, tr( "Tree / process:"  ) );
+
+    _timer.setInterval( UPDATE_MILLISEC );
+
+    connect( &_timer, SIGNAL( timeout()	    ),
+	     this,    SLOT  ( updateStats() ) );
+}
+
+
+ReadStatsView::~ReadStatsView()
+{
+    // NOP
+}
+
+
+QLabel * ReadStatsView::addRow( QFormLayout * layout, const QString & caption )
+{
+    QLabel * label = new QLabel( this );
+    CHECK_NEW( label );
+
+    label->setAlignment( Qt::AlignRight | Qt::AlignVCenter );
+    layout->addRow( caption, label );
+
+    return label;
+}
+
+
+void ReadStatsView::setDirTree( DirTree * tree )
+{
+    if ( _tree )
+	disconnect( _tree, 0, this, 0 );
+
+    _tree = tree;
+
+    if ( _tree )
+    {
+	connect( _tree, SIGNAL( startingReading() ),
+		 this,	SLOT  ( readingStarted()  ) );
+
+	connect( _tree, SIGNAL( finished()	  ),
+		 this,	SLOT  ( readingFinished() ) );
+
+	connect( _tree, SIGNAL( aborted()	  ),
+		 this,	SLOT  ( readingFinished() ) );
+
+	if ( _tree->isBusy() )
+	    readingStarted();
+    }
+
+    updateStats();
+}
+
+
+void ReadStatsView::readingStarted()
+{
+    _lastDirs	  = 0;
+    _lastEntries  = 0;
+    _lastMillisec = 0;
+    _timer.start();
+    updateStats();
+}
+
+
+void ReadStatsView::readingFinished()
+{
+    _timer.stop();
+    updateStats();
+}
+
+
+void ReadStatsView::updateStats()
+{
+    if ( ! _tree )
+	return;
+
+    DirReadStats * stats = _tree->readStats();
+    qint64 millisec = stats->elapsedMillisec();
+    qint64 dirs	    = stats->dirs();
+    qint64 entries  = stats->entries();
+
+    // While reading, the rates are those since the last update; afterwards
+    // the averages of the whole read.
+
+    bool   live	     = stats->isRunning();
+    qint64 interval  = live ? millisec - _lastMillisec : millisec;
+    qreal  dirRate   = 0.0;
+    qreal  entryRate = 0.0;
+
+    if ( interval > 0 )
+    {
+	dirRate	  = ( live ? dirs    - _lastDirs    : dirs    ) * 1000.0 / interval;
+	entryRate = ( live ? entries - _lastEntries : entries ) * 1000.0 / interval;
+    }
+
+    _lastDirs	  = dirs;
+    _lastEntries  = entries;
+    _lastMillisec = millisec;
+
+    _elapsedLabel->setText( formatMillisec( millisec, false ) );
+    _dirsLabel->setText   ( tr( "%1 (%2/s)" ).arg( dirs	  ).arg( qRound64( dirRate   ) ) );
+    _entriesLabel->setText( tr( "%1 (%2/s)" ).arg( entries ).arg( qRound64( entryRate ) ) );
+
+    _statLatencyLabel->setText( QString( "%1 / %2 / %3" )
+				.arg( DirReadStats::formatLatency( stats->statLatency( 50 ) ) )
+				.arg( DirReadStats::formatLatency( stats->statLatency( 90 ) ) )
+				.arg( DirReadStats::formatLatency( stats->statLatency( 99 ) ) ) );
+    _maxLatencyLabel->setText( DirReadStats::formatLatency( stats->maxStatLatency() ) );
+
+    _queueLabel->setText( QString( "%1 / %2" )
+			  .arg( _tree->queuedReadJobs() )
+			  .arg( _tree->blockedReadJobs() ) );
+
+    int pendingTasks = 0;
+    int threads	     = 0;
+
+    foreach ( DirReadWorkerPool * pool, _tree->readWorkerPools() )
+    {
+	pendingTasks += pool->pendingCount();
+	threads	     += pool->threadCount();
+    }
+
+    if ( threads > 0 )
+    {
+	_workerTasksLabel->setText( tr( "%1 in %2 threads" )
+				    .arg( pendingTasks )
+				    .arg( threads ) );
+    }
+    else
+    {
+	_workerTasksLabel->setText( tr( "no threads" ) );
+    }
+
+    qint64 rss = DirReadStats::residentBytes();
+
+    _memoryLabel->setText( QString( "%1 / %2" )
+			   .arg( formatSize( NodeAllocator::allocatedBytes() ) )
+			   .arg( rss >= 0 ? formatSize( rss ) : QString( "--" ) ) );
+}
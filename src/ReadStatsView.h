@@ -0,0 +1,106 @@
+/*
+ *   File name: ReadStatsView.h
+ *   Summary:	Panel with live performance counters while reading a tree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef ReadStatsView_h
+#define ReadStatsView_h
+
+
+#include <QWidget>
+#include <QTimer>
+#include <QPointer>
+
+
+class QLabel;
+class QFormLayout;
+
+
+namespace QDirStat
+{
+    class DirTree;
+
+    /**
+     * Small panel that shows the DirReadStats of a DirTree while it is
+     * being read: Directories and entries per second, stat() latency
+     * percentiles, the depth of the read job queue and the memory used.
+     *
+     * While the tree is busy, this is updated once per second. Afterwards
+     * it shows the totals and averages of the last read.
+     **/
+    class ReadStatsView: public QWidget
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	ReadStatsView( QWidget * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~ReadStatsView();
+
+	/**
+	 * Set the tree to show the counters of.
+	 **/
+	void setDirTree( DirTree * tree );
+
+
+    public slots:
+
+	/**
+	 * Update all values from the tree.
+	 **/
+	void updateStats();
+
+
+    protected slots:
+
+	/**
+	 * Notification that the tree started reading.
+	 **/
+	void readingStarted();
+
+	/**
+	 * Notification that the tree finished or aborted reading.
+	 **/
+	void readingFinished();
+
+
+    protected:
+
+	/**
+	 * Add a row with 'caption' to 'layout' and return the value label.
+	 **/
+	QLabel * addRow( QFormLayout * layout, const QString & caption );
+
+
+	QPointer<DirTree> _tree;
+	QTimer		  _timer;
+	qint64		  _lastDirs;
+	qint64		  _lastEntries;
+	qint64		  _lastMillisec;
+
+	QLabel *	  _elapsedLabel;
+	QLabel *	  _dirsLabel;
+	QLabel *	  _entriesLabel;
+	QLabel *	  _statLatencyLabel;
+	QLabel *	  _maxLatencyLabel;
+	QLabel *	  _queueLabel;
+	QLabel *	  _workerTasksLabel;
+	QLabel *	  _memoryLabel;
+
+    };	// class ReadStatsView
+
+}	// namespace QDirStat
+
+
+#endif // ifndef ReadStatsView_h
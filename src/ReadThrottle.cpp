@@ -0,0 +1,66 @@
+/*
+ *   File name: ReadThrottle.cpp
+ *   Summary:	Rate limit for the syscalls of reading directories
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QThread>
+
+#include "ReadThrottle.h"
+#include "Logger.h"
+
+
+#define NANOSEC_PER_SEC	    1000000000LL
+
+
+using namespace QDirStat;
+
+
+ReadThrottle::ReadThrottle():
+    _nextSlot( 0 ),
+    _rate( 0 )
+{
+    _timer.start();
+}
+
+
+void ReadThrottle::setRate( int rate )
+{
+    QMutexLocker locker( &_mutex );
+
+    if ( rate < 0 )
+	rate = 0;
+
+    if ( rate != _rate )
+	logInfo() << "Max. stat() calls per second: " << rate << endl;
+
+    _rate     = rate;
+    _nextSlot = _timer.nsecsElapsed();
+}
+
+
+void ReadThrottle::acquire( int count )
+{
+    if ( _rate <= 0 || count <= 0 )
+	return;
+
+    qint64 now;
+    qint64 slot;
+
+    {
+	QMutexLocker locker( &_mutex );
+
+	if ( _rate <= 0 )
+	    return;
+
+	now  = _timer.nsecsElapsed();
+	slot = qMax( _nextSlot, now - NANOSEC_PER_SEC );
+	_nextSlot = slot + count * NANOSEC_PER_SEC / _rate;
+    }
+
+    if ( slot > now )
+	QThread::usleep( ( slot - now ) / 1000 );
+}
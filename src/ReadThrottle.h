@@ -0,0 +1,77 @@
+/*
+ *   File name: ReadThrottle.h
+ *   Summary:	Rate limit for the syscalls of reading directories
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef ReadThrottle_h
+#define ReadThrottle_h
+
+
+#include <QMutex>
+#include <QElapsedTimer>
+
+
+namespace QDirStat
+{
+    /**
+     * Rate limit for reading directories: The stat() calls of all threads
+     * that read the same tree are spread evenly over time so they don't
+     * exceed a maximum number per second. This is for scanning a production
+     * server without hurting the latency of what it is really there for.
+     *
+     * Each stat() call reserves the next free time slot; if that is in the
+     * future, the calling thread sleeps until then. Unused time is not
+     * saved up beyond one second, so there are no big bursts after an idle
+     * period.
+     *
+     * acquire() may be called from any thread.
+     **/
+    class ReadThrottle
+    {
+    public:
+
+	/**
+	 * Constructor. Initially, there is no limit.
+	 **/
+	ReadThrottle();
+
+	/**
+	 * Return the maximum number of stat() calls per second or 0 for no
+	 * limit.
+	 **/
+	int rate() const { return _rate; }
+
+	/**
+	 * Set the maximum number of stat() calls per second. 0 means no
+	 * limit.
+	 **/
+	void setRate( int rate );
+
+	/**
+	 * Return 'true' if there is a limit.
+	 **/
+	bool isActive() const { return _rate > 0; }
+
+	/**
+	 * Wait until 'count' more stat() calls are allowed. This returns
+	 * immediately if there is no limit.
+	 **/
+	void acquire( int count = 1 );
+
+
+    protected:
+
+	QMutex		_mutex;
+	QElapsedTimer	_timer;
+	qint64		_nextSlot;	// nanosec since _timer was started
+	int		_rate;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef ReadThrottle_h
@@ -0,0 +1,325 @@
+/*
+ *   File name: ReadTrace.cpp
+ *   Summary:	Timestamped trace events of the read pipeline
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <time.h>	// clock_gettime()
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QThreadStorage>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+#include <QMap>
+#include <QFile>
+
+#include "ReadTrace.h"
+#include "Logger.h"
+
+
+// Limit for the number of events kept in memory: About 100 bytes each plus
+// their arguments. Events beyond that are only counted.
+#define MAX_EVENTS	( 4 * 1000 * 1000 )
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * One recorded event
+     **/
+    struct TraceEvent
+    {
+	const char * name;
+	char	     phase;	// 'X': complete, 'i': instant, 'C': counter
+	int	     thread;
+	qint64	     start;	// nanosec since ReadTrace::start()
+	qint64	     duration;	// nanosec; the value for counters
+	QString	     arg;
+    };
+
+
+    QMutex		 mutex;
+    QVector<TraceEvent>	 events;
+    QMap<int, QString>	 threadNames;
+    QThreadStorage<int>	 threadNumbers;
+    int			 nextThreadNo = 0;
+    qint64		 startTime    = 0;
+    qint64		 droppedCount = 0;
+    QString		 traceFileName;
+
+
+    /**
+     * Return the number of the current thread for the trace, assigning a
+     * new one if this thread didn't record anything yet.
+     *
+     * The mutex has to be locked.
+     **/
+    int currentThreadNo()
+    {
+	if ( ! threadNumbers.hasLocalData() )
+	{
+	    int threadNo = ++nextThreadNo;
+	    threadNumbers.setLocalData( threadNo );
+
+	    QCoreApplication * app = QCoreApplication::instance();
+	    bool isMainThread = app && QThread::currentThread() == app->thread();
+
+	    threadNames[ threadNo ] = isMainThread ?
+		QString( "Main thread" ) : QString( "Thread %1" ).arg( threadNo );
+	}
+
+	return threadNumbers.localData();
+    }
+
+
+    /**
+     * Add an event. The mutex has to be locked.
+     **/
+    void addEvent( const TraceEvent & event )
+    {
+	if ( events.size() < MAX_EVENTS )
+	    events << event;
+	else
+	    ++droppedCount;
+    }
+
+
+    /**
+     * Return 'str' as a quoted JSON string.
+     **/
+    QByteArray jsonString( const QString & str )
+    {
+	QByteArray utf8 = str.toUtf8();
+	QByteArray result;
+	result.reserve( utf8.size() + 2 );
+	result += '"';
+
+	for ( int i = 0; i < utf8.size(); ++i )
+	{
+	    char c = utf8.at( i );
+
+	    if ( c == '"' || c == '\\' )
+	    {
+		result += '\\';
+		result += c;
+	    }
+	    else if ( (unsigned char) c < 0x20 )
+	    {
+		result += QString( "\\u%1" ).arg( (int) c, 4, 16, QChar( '0' ) ).toLatin1();
+	    }
+	    else
+	    {
+		result += c;
+	    }
+	}
+
+	result += '"';
+
+	return result;
+    }
+
+
+    /**
+     * Return 'nanosec' as microseconds, the time unit of the trace format.
+     **/
+    QByteArray microsec( qint64 nanosec )
+    {
+	return QByteArray::number( nanosec / 1000.0, 'f', 3 );
+    }
+
+}	// namespace
+
+
+bool ReadTrace::_enabled = false;
+
+
+void ReadTrace::start( const QString & fileName )
+{
+    QMutexLocker locker( &mutex );
+
+    events.clear();
+    droppedCount  = 0;
+    traceFileName = fileName;
+    startTime	  = nanosecNow();
+    _enabled	  = true;
+
+    logInfo() << "Recording read trace events for " << fileName << endl;
+}
+
+
+bool ReadTrace::stop()
+{
+    QMutexLocker locker( &mutex );
+
+    if ( ! _enabled )
+	return false;
+
+    _enabled = false;
+
+    QFile file( traceFileName );
+
+    if ( ! file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+	logError() << "Can't open " << traceFileName << ": " << file.errorString() << endl;
+	events.clear();
+
+	return false;
+    }
+
+    file.write( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+    for ( QMap<int, QString>::const_iterator it = threadNames.constBegin();
+	  it != threadNames.constEnd();
+	  ++it )
+    {
+	file.write( "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" +
+		    QByteArray::number( it.key() ) +
+		    ",\"args\":{\"name\":" + jsonString( it.value() ) + "}},\n" );
+    }
+
+    foreach ( const TraceEvent & event, events )
+    {
+	QByteArray line;
+	line.reserve( 128 + event.arg.size() );
+
+	line += "{\"name\":\"";
+	line += event.name;
+	line += "\",\"ph\":\"";
+	line += event.phase;
+	line += "\",\"pid\":1,\"tid\":";
+	line += QByteArray::number( event.thread );
+	line += ",\"ts\":";
+	line += microsec( event.start );
+
+	switch ( event.phase )
+	{
+	    case 'X':
+		line += ",\"dur\":";
+		line += microsec( event.duration );
+		break;
+
+	    case 'i':
+		line += ",\"s\":\"t\"";
+		break;
+
+	    case 'C':
+		line += ",\"args\":{\"value\":";
+		line += QByteArray::number( event.duration );
+		line += "}";
+		break;
+	}
+
+	if ( ! event.arg.isEmpty() )
+	{
+	    line += ",\"args\":{\"arg\":";
+	    line += jsonString( event.arg );
+	    line += "}";
+	}
+
+	line += "},\n";
+	file.write( line );
+    }
+
+    // The trace format tolerates neither a trailing comma nor a missing
+    // last element, so end with a harmless metadata event.
+
+    file.write( "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"QDirStat\"}}\n"
+		"]}\n" );
+
+    bool ok = file.error() == QFileDevice::NoError;
+
+    if ( ok )
+    {
+	logInfo() << "Wrote " << events.size() << " read trace events to " << traceFileName << endl;
+    }
+    else
+    {
+	logError() << "Error writing " << traceFileName << ": " << file.errorString() << endl;
+    }
+
+    if ( droppedCount > 0 )
+	logWarning() << "Dropped " << droppedCount << " read trace events" << endl;
+
+    events.clear();
+    events.squeeze();
+
+    return ok;
+}
+
+
+qint64 ReadTrace::nanosecNow()
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return (qint64) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+void ReadTrace::complete( const char	* name,
+			  qint64	  startNanosec,
+			  const QString & arg )
+{
+    qint64 endNanosec = nanosecNow();
+    QMutexLocker locker( &mutex );
+
+    if ( ! _enabled )
+	return;
+
+    TraceEvent event;
+    event.name	   = name;
+    event.phase	   = 'X';
+    event.thread   = currentThreadNo();
+    event.start	   = startNanosec - startTime;
+    event.duration = endNanosec - startNanosec;
+    event.arg	   = arg;
+
+    addEvent( event );
+}
+
+
+void ReadTrace::instant( const char * name, const QString & arg )
+{
+    qint64 now = nanosecNow();
+    QMutexLocker locker( &mutex );
+
+    if ( ! _enabled )
+	return;
+
+    TraceEvent event;
+    event.name	   = name;
+    event.phase	   = 'i';
+    event.thread   = currentThreadNo();
+    event.start	   = now - startTime;
+    event.duration = 0;
+    event.arg	   = arg;
+
+    addEvent( event );
+}
+
+
+void ReadTrace::counter( const char * name, qint64 value )
+{
+    qint64 now = nanosecNow();
+    QMutexLocker locker( &mutex );
+
+    if ( ! _enabled )
+	return;
+
+    TraceEvent event;
+    event.name	   = name;
+    event.phase	   = 'C';
+    event.thread   = currentThreadNo();
+    event.start	   = now - startTime;
+    event.duration = value;
+
+    addEvent( event );
+}
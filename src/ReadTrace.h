@@ -0,0 +1,158 @@
+/*
+ *   File name: ReadTrace.h
+ *   Summary:	Timestamped trace events of the read pipeline
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef ReadTrace_h
+#define ReadTrace_h
+
+
+#include <QString>
+
+
+/**
+ * Record a duration event 'name' from here to the end of the current scope
+ * with the argument 'arg' (a QString, typically a path).
+ *
+ * 'arg' is only evaluated if tracing is enabled, so this is cheap enough
+ * even in the inner loops when it is disabled.
+ **/
+#define READ_TRACE_SCOPE( name, arg )					\
+    QDirStat::ReadTraceScope readTraceScope( name,			\
+					     QDirStat::ReadTrace::isEnabled() ? \
+					     QString( arg ) : QString() )
+
+/**
+ * Record an instant event 'name' with the argument 'arg'.
+ * Like with READ_TRACE_SCOPE, 'arg' is only evaluated if tracing is enabled.
+ **/
+#define READ_TRACE_INSTANT( name, arg )					\
+    do									\
+    {									\
+	if ( QDirStat::ReadTrace::isEnabled() )				\
+	    QDirStat::ReadTrace::instant( name, arg );			\
+    } while ( 0 )
+
+/**
+ * Record the current value of the counter 'name'.
+ **/
+#define READ_TRACE_COUNTER( name, value )				\
+    do									\
+    {									\
+	if ( QDirStat::ReadTrace::isEnabled() )				\
+	    QDirStat::ReadTrace::counter( name, value );		\
+    } while ( 0 )
+
+
+namespace QDirStat
+{
+    /**
+     * Recorder for timestamped events of the read pipeline: Read jobs being
+     * queued, started, blocked and unblocked, opendir(), getdents() and
+     * stat() calls, finalizeLocal(), cache file blocks being read and
+     * parsed, and model updates.
+     *
+     * The events are kept in memory while tracing is enabled and written to
+     * a JSON file in the Chrome trace event format when it is stopped; that
+     * file can be opened in chrome://tracing or https://ui.perfetto.dev .
+     *
+     * Use the READ_TRACE_* macros to record events: They check isEnabled()
+     * first, which is only a test of a static bool, so there is no
+     * measurable overhead when tracing is disabled.
+     *
+     * Recording is thread-safe. start() and stop() should be called while
+     * no directory is being read since the worker threads check
+     * isEnabled() without locking.
+     **/
+    class ReadTrace
+    {
+    public:
+
+	/**
+	 * Start recording events that will be written to 'fileName' upon
+	 * stop().
+	 **/
+	static void start( const QString & fileName );
+
+	/**
+	 * Stop recording events and write them to the file. Return 'true'
+	 * on success, 'false' on error.
+	 **/
+	static bool stop();
+
+	/**
+	 * Return 'true' if events are being recorded.
+	 **/
+	static bool isEnabled() { return _enabled; }
+
+	/**
+	 * Return a monotonic timestamp in nanoseconds.
+	 **/
+	static qint64 nanosecNow();
+
+	/**
+	 * Record a duration event 'name' that started at 'startNanosec'
+	 * and ended now.
+	 **/
+	static void complete( const char    * name,
+			      qint64	      startNanosec,
+			      const QString & arg = QString() );
+
+	/**
+	 * Record an instant event 'name'.
+	 **/
+	static void instant( const char * name, const QString & arg = QString() );
+
+	/**
+	 * Record the current value of counter 'name'.
+	 **/
+	static void counter( const char * name, qint64 value );
+
+
+    protected:
+
+	static bool _enabled;
+    };
+
+
+    /**
+     * Helper class to record a duration event for a scope.
+     * Use READ_TRACE_SCOPE() rather than this class directly.
+     **/
+    class ReadTraceScope
+    {
+    public:
+
+	/**
+	 * Constructor. 'name' has to be a string literal.
+	 **/
+	ReadTraceScope( const char * name, const QString & arg ):
+	    _name( name ),
+	    _start( ReadTrace::isEnabled() ? ReadTrace::nanosecNow() : -1 ),
+	    _arg( arg )
+	    {}
+
+	/**
+	 * Destructor: Record the event.
+	 **/
+	~ReadTraceScope()
+	    {
+		if ( _start >= 0 )
+		    ReadTrace::complete( _name, _start, _arg );
+	    }
+
+    private:
+
+	const char * _name;
+	qint64	     _start;
+	QString	     _arg;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef ReadTrace_h
@@ -11,6 +11,7 @@
 #include "DirTree.h"
 #include "DirInfo.h"
 #include "FileInfoSet.h"
+#include "StallWatchdog.h"
 #include "Logger.h"
 
 using namespace QDirStat;
@@ -39,6 +40,7 @@ void Refresher::refresh()
     {
 	logDebug() << "Refreshing " << _items.size() << " items" << endl;
 
+	StallOperation operation( "Cleanup refresh" );
 	_tree->refresh( _items );
     }
     else
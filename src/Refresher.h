@@ -24,7 +24,8 @@ namespace QDirStat
      *
      * Store a FileInfoSet and when a signal is received (typically
      * OutputWindow::lastProcessFinished()), trigger refreshing all stored
-     * subtrees.
+     * subtrees. DirTree::refresh() reduces them to disjoint subtrees that
+     * are read at the same time.
      *
      * Do not hold on to pointers to instances of this class since each
      * instance will destroy itself at the end of refresh(). On the other hand,
@@ -0,0 +1,235 @@
+/*
+ *   File name: RpmDatabase.cpp
+ *   Summary:	Direct access to the RPM database for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "RpmDatabase.h"
+#include "PkgFileListCache.h"
+#include "Logger.h"
+#include "Exception.h"
+
+#if HAVE_LIBRPM
+#  include <rpm/rpmlib.h>
+#  include <rpm/rpmts.h>
+#  include <rpm/rpmdb.h>
+#  include <rpm/header.h>
+#  include <rpm/rpmtd.h>
+#endif
+
+
+using namespace QDirStat;
+
+
+#if HAVE_LIBRPM
+
+namespace
+{
+    /**
+     * Return string tag 'tag' of header 'header' or an empty string.
+     **/
+    inline QString tagString( Header header, rpmTagVal tag )
+    {
+	const char * str = headerGetString( header, tag );
+
+	return str ? QString::fromUtf8( str ) : QString();
+    }
+
+
+    /**
+     * Return the entry for 'header'.
+     **/
+    RpmDbEntry dbEntry( Header header )
+    {
+	RpmDbEntry entry;
+	entry.name    = tagString( header, RPMTAG_NAME );
+	entry.version = tagString( header, RPMTAG_VERSION ) + "-" + tagString( header, RPMTAG_RELEASE );
+	entry.arch    = tagString( header, RPMTAG_ARCH );
+
+	if ( entry.arch == "(none)" )
+	    entry.arch.clear();
+
+	return entry;
+    }
+
+
+    /**
+     * Return the label for 'entry' like RpmPkgManager::queryName().
+     **/
+    QString pkgLabel( const RpmDbEntry & entry )
+    {
+	QString result = entry.name + "-" + entry.version;
+
+	if ( ! entry.arch.isEmpty() )
+	    result += "." + entry.arch;
+
+	return result;
+    }
+
+
+    /**
+     * Return the file list of package 'header'.
+     **/
+    QStringList headerFileList( Header header )
+    {
+	QStringList fileList;
+	rpmtd td = rpmtdNew();
+
+	if ( headerGet( header, RPMTAG_FILENAMES, td, HEADERGET_EXT ) )
+	{
+	    const char * path;
+
+	    while ( ( path = rpmtdNextString( td ) ) )
+		fileList << QString::fromUtf8( path );
+
+	    rpmtdFreeData( td );
+	}
+
+	rpmtdFree( td );
+
+	return fileList;
+    }
+
+
+    /**
+     * Create a transaction set for reading the database. Signatures and
+     * digests are not checked; the rpm command doesn't check them for
+     * queries either.
+     **/
+    rpmts createTransactionSet()
+    {
+	rpmts ts = rpmtsCreate();
+	rpmtsSetVSFlags( ts, (rpmVSFlags) ( _RPMVSF_NOSIGNATURES | _RPMVSF_NODIGESTS ) );
+
+	return ts;
+    }
+
+}	// namespace
+
+
+bool RpmDatabase::isAvailable()
+{
+    static int configRead = -1;
+
+    if ( configRead < 0 )
+    {
+	configRead = rpmReadConfigFiles( 0, 0 ) == 0 ? 1 : 0;
+
+	if ( ! configRead )
+	    logWarning() << "Can't read the RPM configuration; using the rpm command" << endl;
+    }
+
+    return configRead > 0;
+}
+
+
+bool RpmDatabase::readInstalledPkg( QList<RpmDbEntry> & entries_ret )
+{
+    entries_ret.clear();
+
+    if ( ! isAvailable() )
+	return false;
+
+    rpmts ts = createTransactionSet();
+    rpmdbMatchIterator it = rpmtsInitIterator( ts, RPMDBI_PACKAGES, 0, 0 );
+    Header header;
+
+    while ( it && ( header = rpmdbNextIterator( it ) ) )
+	entries_ret << dbEntry( header );
+
+    rpmdbFreeIterator( it );
+    rpmtsFree( ts );
+
+    logDebug() << entries_ret.size() << " installed packages in the RPM database" << endl;
+
+    return ! entries_ret.isEmpty();
+}
+
+
+bool RpmDatabase::readFileList( const QString & label,
+				QStringList   & fileList_ret )
+{
+    fileList_ret.clear();
+
+    if ( ! isAvailable() )
+	return false;
+
+    QByteArray key = label.toUtf8();
+    rpmts ts = createTransactionSet();
+    rpmdbMatchIterator it = rpmtsInitIterator( ts, (rpmDbiTagVal) RPMDBI_LABEL, key.constData(), 0 );
+    Header header = it ? rpmdbNextIterator( it ) : 0;
+
+    if ( header )
+	fileList_ret = headerFileList( header );
+
+    rpmdbFreeIterator( it );
+    rpmtsFree( ts );
+
+    return header != 0;
+}
+
+
+bool RpmDatabase::readAllFileLists( PkgFileListCache * cache )
+{
+    CHECK_PTR( cache );
+
+    if ( ! isAvailable() )
+	return false;
+
+    rpmts ts = createTransactionSet();
+    rpmdbMatchIterator it = rpmtsInitIterator( ts, RPMDBI_PACKAGES, 0, 0 );
+    Header header;
+    int pkgCount = 0;
+
+    // Only the file list of one package is in memory besides the cache at
+    // any time
+
+    while ( it && ( header = rpmdbNextIterator( it ) ) )
+    {
+	QString pkgName = pkgLabel( dbEntry( header ) );
+
+	foreach ( const QString & path, headerFileList( header ) )
+	    cache->add( pkgName, path );
+
+	++pkgCount;
+    }
+
+    rpmdbFreeIterator( it );
+    rpmtsFree( ts );
+
+    logDebug() << "Read the file lists of " << pkgCount << " packages from the RPM database" << endl;
+
+    return pkgCount > 0;
+}
+
+
+#else	// ! HAVE_LIBRPM
+
+
+bool RpmDatabase::isAvailable()
+{
+    return false;
+}
+
+
+bool RpmDatabase::readInstalledPkg( QList<RpmDbEntry> & )
+{
+    return false;
+}
+
+
+bool RpmDatabase::readFileList( const QString &, QStringList & )
+{
+    return false;
+}
+
+
+bool RpmDatabase::readAllFileLists( PkgFileListCache * )
+{
+    return false;
+}
+
+#endif	// ! HAVE_LIBRPM
@@ -0,0 +1,80 @@
+/*
+ *   File name: RpmDatabase.h
+ *   Summary:	Direct access to the RPM database for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef RpmDatabase_h
+#define RpmDatabase_h
+
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+
+namespace QDirStat
+{
+    class PkgFileListCache;
+
+
+    /**
+     * One installed package from the RPM database.
+     **/
+    struct RpmDbEntry
+    {
+	QString name;
+	QString version;	// including the release
+	QString arch;		// empty for "(none)"
+    };
+
+
+    /**
+     * Access to the RPM database with librpm without starting any rpm
+     * processes: This iterates over the package headers in the database
+     * directly, and the file lists are added to a file list cache header by
+     * header rather than collecting the output of one huge "rpm -qa"
+     * command in memory first.
+     *
+     * This is only available if QDirStat is built with librpm
+     * (HAVE_LIBRPM); otherwise isAvailable() returns 'false', and all other
+     * methods do nothing and return 'false'. The RpmPkgManager then uses
+     * the rpm command instead.
+     **/
+    class RpmDatabase
+    {
+    public:
+
+	/**
+	 * Return 'true' if this was built with librpm and the RPM
+	 * configuration could be read.
+	 **/
+	static bool isAvailable();
+
+	/**
+	 * Read all installed packages into 'entries_ret'.
+	 **/
+	static bool readInstalledPkg( QList<RpmDbEntry> & entries_ret );
+
+	/**
+	 * Read the file list of the package with 'label'
+	 * (name-version-release.arch) into 'fileList_ret'.
+	 **/
+	static bool readFileList( const QString & label,
+				  QStringList	& fileList_ret );
+
+	/**
+	 * Add the file lists of all installed packages to 'cache' with
+	 * name-version-release.arch as the package names.
+	 **/
+	static bool readAllFileLists( PkgFileListCache * cache );
+
+    };	// class RpmDatabase
+
+}	// namespace QDirStat
+
+
+#endif // ifndef RpmDatabase_h
@@ -13,6 +13,7 @@
 #include <QPointer>
 
 #include "RpmPkgManager.h"
+#include "RpmDatabase.h"
 #include "PkgFileListCache.h"
 #include "Settings.h"
 #include "MessagePanel.h"
@@ -28,8 +29,75 @@ using std::endl;
 using namespace QDirStat;
 
 
+namespace
+{
+    /**
+     * Parser for the output of "rpm -qa" with a query format for all file
+     * names that adds each line to a file list cache while the command is
+     * still running.
+     *
+     * Sample output:
+     *
+     *	   zsh-5.6-lp151.1.3.x86_64 | /bin/zsh
+     *	   zsh-5.6-lp151.1.3.x86_64 | /etc/zprofile
+     *	   zsh-5.6-lp151.1.3.x86_64 | /etc/zsh_completion.d
+     **/
+    class RpmQueryParser: public SysUtil::OutputLineHandler
+    {
+    public:
+
+	RpmQueryParser( PkgFileListCache * cache ):
+	    _cache( cache ),
+	    _lineCount( 0 )
+	    {}
+
+	virtual void handleLine( const char * line, int len ) Q_DECL_OVERRIDE
+	{
+	    ++_lineCount;
+
+	    // Only a view of the line in the read buffer, not a copy
+	    QByteArray rawLine = QByteArray::fromRawData( line, len );
+
+	    if ( rawLine.isEmpty() )
+		return;
+
+	    int sep = rawLine.indexOf( " | " );
+
+	    if ( sep < 0 || rawLine.indexOf( " | ", sep + 3 ) >= 0 )
+	    {
+		logError() << "Unexpected file list line: \"" << QString::fromUtf8( line, len ) << "\"" << endl;
+		return;
+	    }
+
+	    // All files of a package are in consecutive lines: Reuse the
+	    // package name of the previous line.
+
+	    if ( sep != _lastPkg.size() || ! rawLine.startsWith( _lastPkg ) )
+	    {
+		_lastPkg     = QByteArray( line, sep );
+		_lastPkgName = QString::fromUtf8( _lastPkg );
+	    }
+
+	    if ( ! _lastPkgName.isEmpty() && len > sep + 3 )
+		_cache->add( _lastPkgName, QString::fromUtf8( line + sep + 3, len - sep - 3 ) );
+	}
+
+	int lineCount() const { return _lineCount; }
+
+    protected:
+
+	PkgFileListCache * _cache;
+	int		   _lineCount;
+	QByteArray	   _lastPkg;
+	QString		   _lastPkgName;
+    };
+
+}	// namespace
+
+
 RpmPkgManager::RpmPkgManager():
-    _getPkgListWarningSec( 7 )
+    _getPkgListWarningSec( 7 ),
+    _useLibRpm( true )
 {
     readSettings();
 
@@ -78,8 +146,62 @@ QString RpmPkgManager::owningPkg( const QString & path )
 }
 
 
+QMap<QString, QString> RpmPkgManager::owningPkgs( const QStringList & paths )
+{
+    QMap<QString, QString> pkgs;
+
+    if ( paths.isEmpty() )
+	return pkgs;
+
+    int exitCode = -1;
+    QString output = runCommand( _rpmCommand,
+				 QStringList() << "-qf" << "--queryformat" << "%{name}\n" << paths,
+				 &exitCode,
+				 COMMAND_TIMEOUT_SEC, LOG_COMMANDS, LOG_OUTPUT,
+				 true ); // ignoreErrCode
+
+    // Normally one line for each path in the same order: The package name or
+    // an error message like "file /usr/bin/foo is not owned by any package".
+    // A path that belongs to several packages gets one line for each of
+    // them, so the lines can only be matched to the paths if there are just
+    // as many of them; otherwise ask for one path after another.
+
+    QStringList lines = output.split( "\n", QString::SkipEmptyParts );
+
+    if ( lines.size() != paths.size() )
+	return PkgManager::owningPkgs( paths );
+
+    for ( int i = 0; i < paths.size(); ++i )
+    {
+	const QString & line = lines.at( i );
+
+	if ( ! line.contains( ' ' ) )	// Package names don't contain blanks
+	    pkgs.insert( paths.at( i ), line );
+    }
+
+    return pkgs;
+}
+
+
 PkgInfoList RpmPkgManager::installedPkg()
 {
+    QList<RpmDbEntry> entries;
+
+    if ( _useLibRpm && RpmDatabase::readInstalledPkg( entries ) )
+    {
+	PkgInfoList pkgList;
+
+	foreach ( const RpmDbEntry & entry, entries )
+	{
+	    PkgInfo * pkg = new PkgInfo( entry.name, entry.version, entry.arch, this );
+	    CHECK_NEW( pkg );
+
+	    pkgList << pkg;
+	}
+
+	return pkgList;
+    }
+
     int exitCode = -1;
     QElapsedTimer timer;
     timer.start();
@@ -137,6 +259,17 @@ PkgInfoList RpmPkgManager::parsePkgList( const QString & output )
 }
 
 
+QStringList RpmPkgManager::fileList( PkgInfo * pkg )
+{
+    QStringList fileList;
+
+    if ( _useLibRpm && RpmDatabase::readFileList( queryName( pkg ), fileList ) )
+	return fileList;
+
+    return PkgManager::fileList( pkg );
+}
+
+
 QString RpmPkgManager::fileListCommand( PkgInfo * pkg )
 {
     return QString( "%1 -ql %2" )
@@ -174,51 +307,39 @@ QString RpmPkgManager::queryName( PkgInfo * pkg )
 
 PkgFileListCache * RpmPkgManager::createFileListCache( PkgFileListCache::LookupType lookupType )
 {
-    int exitCode = -1;
-    QString queryFormat = "[%{=NAME}-%{=VERSION}-%{=RELEASE}.%{=ARCH} | %{FILENAMES}\n]";
+    if ( _useLibRpm )
+    {
+	PkgFileListCache * cache = new PkgFileListCache( this, lookupType );
+	CHECK_NEW( cache );
 
-    QString output = runCommand( _rpmCommand,
-				 QStringList() << "-qa" << "--qf" << queryFormat,
-				 &exitCode,
-				 LONG_CMD_TIMEOUT_SEC );
+	if ( RpmDatabase::readAllFileLists( cache ) )
+	{
+	    logDebug() << "file list cache finished." << endl;
+	    return cache;
+	}
 
-    if ( exitCode != 0 )
-	return 0;
+	delete cache;
+    }
 
-    QStringList lines = output.split( "\n" );
-    output.clear(); // Free all that text ASAP
-    logDebug() << lines.size() << " output lines" << endl;
+    QString queryFormat = "[%{=NAME}-%{=VERSION}-%{=RELEASE}.%{=ARCH} | %{FILENAMES}\n]";
 
     PkgFileListCache * cache = new PkgFileListCache( this, lookupType );
     CHECK_NEW( cache );
 
-    // Sample output:
-    //
-    //	   zsh-5.6-lp151.1.3.x86_64 | /bin/zsh
-    //	   zsh-5.6-lp151.1.3.x86_64 | /etc/zprofile
-    //	   zsh-5.6-lp151.1.3.x86_64 | /etc/zsh_completion.d
+    RpmQueryParser parser( cache );
 
-    foreach ( const QString & line, lines )
+    if ( ! SysUtil::runCommandLines( _rpmCommand,
+				     QStringList() << "-qa" << "--qf" << queryFormat,
+				     &parser,
+				     0, // exitCode_ret
+				     LONG_CMD_TIMEOUT_SEC ) )
     {
-	if ( line.isEmpty() )
-	    continue;
-
-	QStringList fields = line.split( " | " );
-
-	if ( fields.size() != 2 )
-	{
-	    logError() << "Unexpected file list line: \"" << line << "\"" << endl;
-	}
-	else
-	{
-	    QString pkgName = fields.takeFirst();
-	    QString path    = fields.takeFirst();
-
-	    if ( ! pkgName.isEmpty() && ! path.isEmpty() )
-		cache->add( pkgName, path );
-	}
+	delete cache;
+	return 0;
     }
 
+    logDebug() << parser.lineCount() << " output lines" << endl;
+
     logDebug() << "file list cache finished." << endl;
 
     return cache;
@@ -230,12 +351,14 @@ void RpmPkgManager::readSettings()
     Settings settings;
     settings.beginGroup( "Pkg" );
     _getPkgListWarningSec = settings.value( "GetRpmPkgListWarningSec", 7 ).toInt();
+    _useLibRpm		  = settings.value( "UseLibRpm", true ).toBool() && RpmDatabase::isAvailable();
 
     // Write the value right back to the settings if it isn't there already:
     // Since package manager objects are never really destroyed, this can't
     // reliably be done in the destructor.
 
     settings.setDefaultValue( "GetRpmPkgListWarningSec", _getPkgListWarningSec );
+    settings.setDefaultValue( "UseLibRpm", true );
     settings.endGroup();
 }
 
@@ -68,6 +68,17 @@ namespace QDirStat
 	 **/
 	virtual QString owningPkg( const QString & path ) Q_DECL_OVERRIDE;
 
+	/**
+	 * Return the owning packages of several paths with one command.
+	 *
+	 * Reimplemented from PkgManager.
+	 *
+	 * This basically executes this command:
+	 *
+	 *   /usr/bin/rpm -qf --queryformat "%{name}\n" ${path1} ${path2} ...
+	 **/
+	virtual QMap<QString, QString> owningPkgs( const QStringList & paths ) Q_DECL_OVERRIDE;
+
 
 	//-----------------------------------------------------------------
 	//		       Optional Features
@@ -91,6 +102,24 @@ namespace QDirStat
 	 **/
 	virtual PkgInfoList installedPkg() Q_DECL_OVERRIDE;
 
+	/**
+	 * Return the list of files and directories owned by a package.
+	 *
+	 * This reads the RPM database with librpm if possible and uses the
+	 * file list command only as a fallback.
+	 *
+	 * Reimplemented from PkgManager.
+	 **/
+	virtual QStringList fileList( PkgInfo * pkg ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Return 'true' if fileList() reads the RPM database with librpm.
+	 *
+	 * Reimplemented from PkgManager.
+	 **/
+	virtual bool supportsNativeFileList() Q_DECL_OVERRIDE
+	    { return _useLibRpm; }
+
 	/**
 	 * Return 'true' if this package manager supports getting the file list
 	 * for a package.
@@ -135,10 +164,29 @@ namespace QDirStat
 	 * Ownership of the cache is transferred to the caller; make sure to
 	 * delete it when you are done with it.
 	 *
+	 * With librpm, this iterates over the package headers and adds their
+	 * file lists to the cache one by one.
+	 *
 	 * Reimplemented from PkgManager.
 	 **/
 	virtual PkgFileListCache * createFileListCache( PkgFileListCache::LookupType lookupType = PkgFileListCache::LookupByPkg ) Q_DECL_OVERRIDE;
 
+	/**
+	 * Return the files of the package database in the old (Berkeley DB)
+	 * and new (SQLite) formats and locations; only the ones that exist
+	 * are used.
+	 *
+	 * Reimplemented from PkgManager.
+	 **/
+	virtual QStringList databaseFiles() Q_DECL_OVERRIDE
+	    {
+		return QStringList() << "/var/lib/rpm/Packages"
+				     << "/var/lib/rpm/rpmdb.sqlite"
+				     << "/usr/lib/sysimage/rpm/Packages"
+				     << "/usr/lib/sysimage/rpm/Packages.db"
+				     << "/usr/lib/sysimage/rpm/rpmdb.sqlite";
+	    }
+
 	/**
 	 * Return a name suitable for a detailed queries for 'pkg'.
 	 *
@@ -173,6 +221,7 @@ namespace QDirStat
 
 	QString _rpmCommand;
 	int	_getPkgListWarningSec;
+	bool	_useLibRpm;
 
     }; // class RpmPkgManager
 
@@ -0,0 +1,89 @@
+/*
+ *   File name: RuleStats.cpp
+ *   Summary:	Cost counters for exclude rules and filters
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QMutexLocker>
+
+#include "RuleStats.h"
+
+
+using namespace QDirStat;
+
+
+QMutex RuleStats::_mutex;
+bool   RuleStats::_enabled = false;
+
+
+RuleStats::RuleStats():
+    _evaluations( 0 ),
+    _matches( 0 ),
+    _nanoSeconds( 0 )
+{
+    // NOP
+}
+
+
+void RuleStats::add( bool matched, qint64 nanoSeconds )
+{
+    QMutexLocker locker( &_mutex );
+
+    _evaluations++;
+    _nanoSeconds += nanoSeconds;
+
+    if ( matched )
+	_matches++;
+}
+
+
+void RuleStats::addMatch()
+{
+    QMutexLocker locker( &_mutex );
+    _matches++;
+}
+
+
+qint64 RuleStats::evaluations() const
+{
+    QMutexLocker locker( &_mutex );
+    return _evaluations;
+}
+
+
+qint64 RuleStats::matches() const
+{
+    QMutexLocker locker( &_mutex );
+    return _matches;
+}
+
+
+qint64 RuleStats::nanoSeconds() const
+{
+    QMutexLocker locker( &_mutex );
+    return _nanoSeconds;
+}
+
+
+void RuleStats::reset()
+{
+    QMutexLocker locker( &_mutex );
+
+    _evaluations = 0;
+    _matches	 = 0;
+    _nanoSeconds = 0;
+}
+
+
+QString RuleStats::toString() const
+{
+    QMutexLocker locker( &_mutex );
+
+    return QString( "%1 evaluations, %2 matches, %3 ms" )
+	.arg( _evaluations )
+	.arg( _matches )
+	.arg( _nanoSeconds / 1000000.0, 0, 'f', 3 );
+}
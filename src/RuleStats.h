@@ -0,0 +1,130 @@
+/*
+ *   File name: RuleStats.h
+ *   Summary:	Cost counters for exclude rules and filters
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef RuleStats_h
+#define RuleStats_h
+
+
+#include <QString>
+#include <QMutex>
+#include <QElapsedTimer>
+
+
+namespace QDirStat
+{
+    /**
+     * Counters for one exclude rule or filter: How often it was evaluated
+     * for a directory entry, how often it matched and how much time that
+     * took in total. With hundreds of rules, that shows which ones are
+     * expensive or never match.
+     *
+     * Counting costs some time itself, so it only happens if it is
+     * enabled (the "RuleStatistics" setting). add() may be called from
+     * any thread.
+     **/
+    class RuleStats
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	RuleStats();
+
+	/**
+	 * Count one evaluation that took 'nanoSeconds' and that matched if
+	 * 'matched' is 'true'.
+	 **/
+	void add( bool matched, qint64 nanoSeconds );
+
+	/**
+	 * Count one match without an evaluation for a rule that was
+	 * evaluated together with others.
+	 **/
+	void addMatch();
+
+	/**
+	 * Return the number of evaluations.
+	 **/
+	qint64 evaluations() const;
+
+	/**
+	 * Return the number of matches.
+	 **/
+	qint64 matches() const;
+
+	/**
+	 * Return the total time of all evaluations in nanoseconds.
+	 **/
+	qint64 nanoSeconds() const;
+
+	/**
+	 * Set all counters back to zero.
+	 **/
+	void reset();
+
+	/**
+	 * Return the counters as a text for the log or for the user.
+	 **/
+	QString toString() const;
+
+	/**
+	 * Return 'true' if counting is enabled.
+	 **/
+	static bool enabled() { return _enabled; }
+
+	/**
+	 * Enable or disable counting.
+	 **/
+	static void setEnabled( bool enabled ) { _enabled = enabled; }
+
+
+    protected:
+
+	qint64 _evaluations;
+	qint64 _matches;
+	qint64 _nanoSeconds;
+
+	static QMutex _mutex;
+	static bool   _enabled;
+    };
+
+
+    /**
+     * Stopwatch for one evaluation: Measure the time until add() only if
+     * counting is enabled.
+     **/
+    class RuleStatsTimer
+    {
+    public:
+
+	RuleStatsTimer()
+	    { if ( RuleStats::enabled() ) _timer.start(); }
+
+	/**
+	 * Count the evaluation since the constructor in 'stats' (if it is
+	 * not 0) and return 'matched'.
+	 **/
+	bool add( RuleStats * stats, bool matched )
+	{
+	    if ( stats && _timer.isValid() )
+		stats->add( matched, _timer.nsecsElapsed() );
+
+	    return matched;
+	}
+
+    protected:
+
+	QElapsedTimer _timer;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// RuleStats_h
@@ -0,0 +1,157 @@
+/*
+ *   File name: ScanCoordinator.cpp
+ *   Summary:	Distribution of a directory scan over several hosts
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "ScanCoordinator.h"
+#include "DirReadJob.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+ScanCoordinator::ScanCoordinator( DirTree * tree, const QStringList & hosts ):
+    QObject(),
+    _tree( tree ),
+    _hosts( hosts ),
+    _busy( hosts.size(), false ),
+    _failed( hosts.size(), false )
+{
+    connect( _tree, SIGNAL( deletingChild( FileInfo * ) ),
+	     this,  SLOT  ( deletingChild( FileInfo * ) ) );
+
+    logInfo() << "Distributing the scan over " << _hosts.size()
+	      << " scanners on " << _hosts.join( ", " ) << endl;
+}
+
+
+ScanCoordinator::~ScanCoordinator()
+{
+    clear();
+}
+
+
+void ScanCoordinator::addSubtree( DirInfo * dir )
+{
+    _pending << dir;
+    dispatch();
+}
+
+
+void ScanCoordinator::clear()
+{
+    foreach ( QObject * job, _running.keys() )
+	job->disconnect( this );
+
+    _running.clear();
+    _pending.clear();
+    _busy.fill( false );
+}
+
+
+void ScanCoordinator::dispatch()
+{
+    for ( int slot = 0; slot < _hosts.size() && ! _pending.isEmpty(); ++slot )
+    {
+	if ( _busy.at( slot ) || _failed.at( slot ) )
+	    continue;
+
+	DirInfo * dir  = _pending.takeFirst();
+	QString	  host = _hosts.at( slot );
+
+	RemoteReadJob * job = new RemoteReadJob( _tree, host, dir->url(), dir );
+	CHECK_NEW( job );
+
+	connect( job,  SIGNAL( destroyed   ( QObject * ) ),
+		 this, SLOT  ( jobDestroyed( QObject * ) ) );
+
+	Assignment assignment;
+	assignment.slot = slot;
+	assignment.dir	= dir;
+
+	_running.insert( job, assignment );
+	_busy[ slot ] = true;
+	_tree->addBlockedJob( job );
+    }
+
+    if ( _running.isEmpty() && ! _pending.isEmpty() )
+    {
+	// Every host failed
+
+	foreach ( DirInfo * dir, _pending )
+	    readLocally( dir );
+
+	_pending.clear();
+    }
+}
+
+
+void ScanCoordinator::jobDestroyed( QObject * job )
+{
+    if ( ! _running.contains( job ) )
+	return;
+
+    Assignment assignment = _running.take( job );
+    _busy[ assignment.slot ] = false;
+
+    if ( assignment.dir && assignment.dir->readState() == DirQueued )
+    {
+	// The scanner did not send anything, so it would most likely fail
+	// for the next subdirectory as well. This one goes to another host.
+
+	QString host = _hosts.at( assignment.slot );
+	logWarning() << "No data from " << host << " for " << assignment.dir
+		     << "; not using " << host << " any more" << endl;
+
+	for ( int slot = 0; slot < _hosts.size(); ++slot )
+	{
+	    if ( _hosts.at( slot ) == host )
+		_failed[ slot ] = true;
+	}
+
+	_pending.prepend( assignment.dir );
+    }
+
+    dispatch();
+}
+
+
+void ScanCoordinator::deletingChild( FileInfo * child )
+{
+    QMutableListIterator<DirInfo *> it( _pending );
+
+    while ( it.hasNext() )
+    {
+	if ( it.next()->isInSubtree( child ) )
+	    it.remove();
+    }
+
+    QMutableHashIterator<QObject *, Assignment> runningIt( _running );
+
+    while ( runningIt.hasNext() )
+    {
+	runningIt.next();
+
+	if ( runningIt.value().dir && runningIt.value().dir->isInSubtree( child ) )
+	    runningIt.value().dir = 0;
+    }
+}
+
+
+void ScanCoordinator::readLocally( DirInfo * dir )
+{
+    logInfo() << "Reading " << dir << " locally" << endl;
+
+    LocalDirReadJob * job = new LocalDirReadJob( _tree, dir );
+    CHECK_NEW( job );
+    job->setApplyFileChildExcludeRules( true );
+    _tree->addJob( job );
+}
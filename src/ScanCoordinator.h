@@ -0,0 +1,134 @@
+/*
+ *   File name: ScanCoordinator.h
+ *   Summary:	Distribution of a directory scan over several hosts
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef ScanCoordinator_h
+#define ScanCoordinator_h
+
+
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+#include <QList>
+#include <QHash>
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class DirInfo;
+    class FileInfo;
+
+
+    /**
+     * Coordinator that distributes reading a tree on a filesystem that is
+     * mounted on several hosts (a parallel filesystem like Lustre or GPFS,
+     * or just NFS) over those hosts:
+     *
+     * The toplevel directory is read locally. Each of its subdirectories
+     * is handed to the next idle scanner slot, which reads it with
+     * qdirstat-cache-writer over ssh (see RemoteReadJob); the cache data
+     * are added to the tree while they arrive. A slot that is finished
+     * gets the next subdirectory that is not read yet, so a fast host or
+     * one with small subtrees reads more of them.
+     *
+     * A host can be listed more than once to run several scanners on it.
+     * If a scanner fails without sending anything, its host gets no more
+     * work and the subdirectory goes to the next slot; if no host is left,
+     * the rest is read locally.
+     *
+     * Create this with DirTree::setScanHosts().
+     **/
+    class ScanCoordinator: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor. Each entry of 'hosts' is one scanner slot; it may
+	 * include a user name like "user@host".
+	 **/
+	ScanCoordinator( DirTree * tree, const QStringList & hosts );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~ScanCoordinator();
+
+	/**
+	 * Return the hosts, one entry for each scanner slot.
+	 **/
+	const QStringList & hosts() const { return _hosts; }
+
+	/**
+	 * Read subdirectory 'dir' of the toplevel directory on the next idle
+	 * host. This is called by the read job of the toplevel directory.
+	 **/
+	void addSubtree( DirInfo * dir );
+
+	/**
+	 * Forget all subdirectories that are not read yet and the running
+	 * scanners. This is called before the read jobs are deleted when
+	 * the tree is cleared or reading is aborted.
+	 **/
+	void clear();
+
+
+    protected slots:
+
+	/**
+	 * Notification that a read job of a scanner is deleted, i.e.
+	 * finished or killed: Hand the next subdirectory to its slot.
+	 **/
+	void jobDestroyed( QObject * job );
+
+	/**
+	 * Notification that 'child' is about to be deleted from the tree.
+	 **/
+	void deletingChild( FileInfo * child );
+
+
+    protected:
+
+	/**
+	 * Start a scanner for the next pending subdirectory in each idle
+	 * slot.
+	 **/
+	void dispatch();
+
+	/**
+	 * Read 'dir' locally because no host is left.
+	 **/
+	void readLocally( DirInfo * dir );
+
+
+	struct Assignment
+	{
+	    int	      slot;
+	    DirInfo * dir;		// 0 if it was deleted
+	};
+
+
+	//
+	// Data members
+	//
+
+	DirTree *		     _tree;
+	QStringList		     _hosts;
+	QVector<bool>		     _busy;	// for each slot
+	QVector<bool>		     _failed;	// for each slot
+	QList<DirInfo *>	     _pending;
+	QHash<QObject *, Assignment> _running;
+
+    };	// class ScanCoordinator
+
+}	// namespace QDirStat
+
+
+#endif	// ScanCoordinator_h
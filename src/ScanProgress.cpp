@@ -0,0 +1,138 @@
+/*
+ *   File name: ScanProgress.cpp
+ *   Summary:	Progress and remaining time of reading from inode counts
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "ScanProgress.h"
+#include "DirReadStats.h"
+#include "MountPoints.h"
+#include "Logger.h"
+
+// Minimum interval between two throughput samples; shorter ones are
+// too noisy because directories are read in bursts
+#define SAMPLE_MILLISEC		1000
+
+// Weight of the newest sample for the smoothed throughput
+#define RATE_WEIGHT		0.3
+
+// Timeout for getting the inode counts of all mount points
+#define STATFS_TIMEOUT_MILLISEC 2000
+
+
+using namespace QDirStat;
+
+
+ScanProgress::ScanProgress()
+{
+    clear();
+}
+
+
+void ScanProgress::clear()
+{
+    _totalInodes  = -1;
+    _isUpperBound = false;
+    _entries	  = 0;
+    _lastEntries  = 0;
+    _lastMillisec = 0;
+    _rate	  = -1.0;
+}
+
+
+void ScanProgress::start( const QString & url, bool crossFilesystems )
+{
+    clear();
+
+    MountPoint * top = MountPoints::findNearestMountPoint( url );
+
+    if ( ! top )
+	return;
+
+    QList<MountPoint *> mountPoints;
+    mountPoints << top;
+
+    if ( crossFilesystems )
+    {
+	QString prefix = url.endsWith( "/" ) ? url : url + "/";
+
+	foreach ( MountPoint * mountPoint, MountPoints::normalMountPoints() )
+	{
+	    if ( mountPoint != top				&&
+		 mountPoint->path().startsWith( prefix )	&&
+		 ! mountPoint->isNetworkMount() )
+	    {
+		mountPoints << mountPoint;
+	    }
+	}
+    }
+
+    MountPoints::querySizes( mountPoints, STATFS_TIMEOUT_MILLISEC );
+
+    if ( top->usedInodes() < 0 )
+    {
+	logInfo() << "No inode count for " << top->path() << "; no progress" << endl;
+	return;
+    }
+
+    _totalInodes  = 0;
+    _isUpperBound = top->path() != url;
+
+    foreach ( MountPoint * mountPoint, mountPoints )
+    {
+	if ( mountPoint->usedInodes() > 0 )
+	    _totalInodes += mountPoint->usedInodes();
+    }
+
+    logInfo() << _totalInodes << " used inodes on " << mountPoints.size() << " filesystems"
+	      << ( _isUpperBound ? " (upper bound)" : "" ) << endl;
+}
+
+
+void ScanProgress::update( const DirReadStats & stats )
+{
+    _entries = stats.entries();
+
+    qint64 millisec = stats.elapsedMillisec();
+    qint64 interval = millisec - _lastMillisec;
+
+    if ( interval < SAMPLE_MILLISEC )
+	return;
+
+    double sample = ( _entries - _lastEntries ) / (double) interval;
+    _rate = _rate < 0.0 ? sample : RATE_WEIGHT * sample + ( 1.0 - RATE_WEIGHT ) * _rate;
+
+    _lastEntries  = _entries;
+    _lastMillisec = millisec;
+}
+
+
+int ScanProgress::percent() const
+{
+    if ( ! isValid() )
+	return -1;
+
+    // Hard links and files that were created meanwhile can make it more
+
+    return (int) qMin( 99LL, _entries * 100 / _totalInodes );
+}
+
+
+qint64 ScanProgress::entriesPerSec() const
+{
+    return _rate < 0.0 ? -1 : (qint64) ( _rate * 1000.0 );
+}
+
+
+qint64 ScanProgress::remainingMillisec() const
+{
+    if ( ! isValid() || _rate <= 0.0 )
+	return -1;
+
+    qint64 remaining = qMax( 0LL, _totalInodes - _entries );
+
+    return (qint64) ( remaining / _rate );
+}
@@ -0,0 +1,115 @@
+/*
+ *   File name: ScanProgress.h
+ *   Summary:	Progress and remaining time of reading from inode counts
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef ScanProgress_h
+#define ScanProgress_h
+
+
+#include <QString>
+
+
+namespace QDirStat
+{
+    class DirReadStats;
+
+
+    /**
+     * Progress of reading a directory tree: The filesystem knows how many
+     * inodes are in use (statvfs()), and each inode is one directory
+     * entry that will be read (except for hard links). Comparing that
+     * with the number of entries read so far gives the progress, and the
+     * current throughput gives the remaining time.
+     *
+     * If the tree crosses filesystems, the used inodes of all mount points
+     * below the start directory are added up. If reading starts below the
+     * top of a filesystem, the used inodes are more than what will be
+     * read, so the progress is only a lower bound and the remaining time
+     * an upper bound (see isUpperBound()). Filesystems like btrfs don't
+     * have a fixed number of inodes; there is no progress for them.
+     **/
+    class ScanProgress
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	ScanProgress();
+
+	/**
+	 * Get the used inodes for reading 'url' and start measuring the
+	 * throughput. If 'crossFilesystems' is 'true', the mount points
+	 * below 'url' are included.
+	 **/
+	void start( const QString & url, bool crossFilesystems );
+
+	/**
+	 * Forget everything. There is no progress until the next start().
+	 **/
+	void clear();
+
+	/**
+	 * Take the number of entries read so far and the time from
+	 * 'stats'. This is meant to be called regularly while reading.
+	 **/
+	void update( const DirReadStats & stats );
+
+	/**
+	 * Return 'true' if there is a total to compare with.
+	 **/
+	bool isValid() const { return _totalInodes > 0; }
+
+	/**
+	 * Return 'true' if the total includes more than will be read.
+	 **/
+	bool isUpperBound() const { return _isUpperBound; }
+
+	/**
+	 * Return the number of used inodes or -1 if it is not known.
+	 **/
+	qint64 totalInodes() const { return _totalInodes; }
+
+	/**
+	 * Return the number of entries read at the last update().
+	 **/
+	qint64 entries() const { return _entries; }
+
+	/**
+	 * Return the progress in percent (0..99) or -1 if it is not
+	 * known. This never reaches 100% before reading is finished.
+	 **/
+	int percent() const;
+
+	/**
+	 * Return the recent throughput in entries per second or -1 if it is
+	 * not known yet.
+	 **/
+	qint64 entriesPerSec() const;
+
+	/**
+	 * Return the estimated remaining time in milliseconds or -1 if it
+	 * is not known.
+	 **/
+	qint64 remainingMillisec() const;
+
+
+    protected:
+
+	qint64	_totalInodes;
+	bool	_isUpperBound;
+	qint64	_entries;
+	qint64	_lastEntries;
+	qint64	_lastMillisec;
+	double	_rate;		// entries per millisec, smoothed
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// ScanProgress_h
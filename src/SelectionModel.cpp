@@ -39,6 +39,11 @@ SelectionModel::SelectionModel( DirTreeModel * dirTreeModel, QObject * parent ):
 
     connect( dirTreeModel->tree(), SIGNAL( clearing() ),
 	     this,		   SLOT	 ( clear()    ) );
+
+    // A model reset clears the selection without any selectionChanged()
+
+    connect( dirTreeModel, SIGNAL( modelReset()		    ),
+	     this,	   SLOT	 ( invalidateSelectedItems() ) );
 }
 
 
@@ -63,26 +68,52 @@ FileInfoSet SelectionModel::selectedItems()
 {
     if ( _selectedItemsDirty )
     {
-	// Build set of selected items from the selected model indexes
+	// Build set of selected items from the selected ranges
 
-	_selectedItems.clear();
+	_selectedItems	    = rowItems( selection() );
+	_selectedItemsDirty = false;
+    }
 
-	foreach ( const QModelIndex index, selectedIndexes() )
+    return _selectedItems;
+}
+
+
+FileInfoSet SelectionModel::rowItems( const QItemSelection & selection ) const
+{
+    FileInfoSet items;
+
+    foreach ( const QItemSelectionRange & range, selection )
+    {
+	if ( ! range.isValid() )
+	    continue;
+
+	// Only one index for each row: selectedIndexes() would return one
+	// for each column of each row
+
+	items.reserve( items.size() + range.height() );
+
+	for ( int row = range.top(); row <= range.bottom(); ++row )
 	{
+	    QModelIndex index = _dirTreeModel->index( row, 0, range.parent() );
+
 	    if ( index.isValid() )
 	    {
 		FileInfo * item = static_cast<FileInfo *>( index.internalPointer() );
 		CHECK_MAGIC( item );
 
-		// logDebug() << "Adding " << item << " col " << index.column() << " to selected items" << endl;
-		_selectedItems << item;
+		items << item;
 	    }
 	}
-
-	_selectedItemsDirty = false;
     }
 
-    return _selectedItems;
+    return items;
+}
+
+
+void SelectionModel::invalidateSelectedItems()
+{
+    _selectedItems.clear();
+    _selectedItemsDirty = true;
 }
 
 
@@ -112,10 +143,25 @@ void SelectionModel::propagateCurrentChanged( const QModelIndex & newCurrentInde
 void SelectionModel::propagateSelectionChanged( const QItemSelection & selected,
 						const QItemSelection & deselected )
 {
-    Q_UNUSED( selected );
-    Q_UNUSED( deselected );
+    if ( ! _selectedItemsDirty )
+    {
+	// Only apply what changed instead of building the set again from
+	// the complete selection: Selecting one more item in a directory
+	// where everything else is already selected would otherwise touch
+	// all of them again. The selection is already updated here, so an
+	// item that is still selected by another range stays in the set.
+
+	foreach ( FileInfo * item, rowItems( deselected ) )
+	{
+	    QModelIndex index = _dirTreeModel->modelIndex( item, 0 );
+
+	    if ( ! index.isValid() || ! isSelected( index ) )
+		_selectedItems.remove( item );
+	}
+
+	_selectedItems.unite( rowItems( selected ) );
+    }
 
-    _selectedItemsDirty = true;
     emit selectionChanged();
     emit selectionChanged( selectedItems() );
 }
@@ -261,8 +307,7 @@ void SelectionModel::prepareRefresh( const FileInfoSet & refreshSet )
 
 void SelectionModel::deletingChildNotify( FileInfo * deletedChild )
 {
-    _selectedItemsDirty = true;
-    _selectedItems.clear();
+    invalidateSelectedItems();
 
     if ( _currentItem->isInSubtree( deletedChild ) )
 	setCurrentItem( 0 );
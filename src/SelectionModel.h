@@ -208,9 +208,20 @@ namespace QDirStat
 	 **/
 	void deletingChildNotify( FileInfo *deletedChild );
 
+	/**
+	 * Build the set of selected items again from the selection the next
+	 * time it is needed.
+	 **/
+	void invalidateSelectedItems();
+
 
     protected:
 
+	/**
+	 * Return the items of the rows in 'selection'.
+	 **/
+	FileInfoSet rowItems( const QItemSelection & selection ) const;
+
 	// Data members
 
 	DirTreeModel	* _dirTreeModel;
@@ -0,0 +1,138 @@
+/*
+ *   File name: SessionSnapshot.cpp
+ *   Summary:	Binary snapshot of the tree to restore the last session
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <stdio.h>	// rename()
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+
+#include "SessionSnapshot.h"
+#include "DirTree.h"
+#include "DirTreeCache.h"
+#include "FileInfo.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+
+#define SNAPSHOT_DIR		"qdirstat"
+#define SNAPSHOT_NAME		"session.cache"
+
+
+using namespace QDirStat;
+
+
+QString SessionSnapshot::fileName()
+{
+    QString dir = QString::fromUtf8( qgetenv( "XDG_CACHE_HOME" ) );
+
+    if ( dir.isEmpty() )
+	dir = QDir::homePath() + "/.cache";
+
+    return dir + "/" + SNAPSHOT_DIR + "/" + SNAPSHOT_NAME + BINARY_CACHE_SUFFIX;
+}
+
+
+QString SessionSnapshot::tmpFileName()
+{
+    // The binary format is chosen by the suffix, so keep that
+
+    QString dir = QFileInfo( fileName() ).absolutePath();
+
+    return dir + "/" + SNAPSHOT_NAME + ".tmp" + BINARY_CACHE_SUFFIX;
+}
+
+
+bool SessionSnapshot::exists()
+{
+    return QFileInfo( fileName() ).isFile();
+}
+
+
+bool SessionSnapshot::canSave( DirTree * tree )
+{
+    if ( ! tree || tree->isBusy() || tree->isWriting() )
+	return false;
+
+    FileInfo * toplevel = tree->firstToplevel();
+
+    return toplevel && toplevel->isDirInfo() && toplevel->url().startsWith( "/" );
+}
+
+
+bool SessionSnapshot::makeDir()
+{
+    QString dir = QFileInfo( fileName() ).absolutePath();
+
+    if ( QDir().mkpath( dir ) )
+	return true;
+
+    logWarning() << "Can't create " << dir << endl;
+    return false;
+}
+
+
+bool SessionSnapshot::save( DirTree * tree )
+{
+    if ( ! canSave( tree ) || ! makeDir() )
+	return false;
+
+    if ( ! tree->writeCache( tmpFileName() ) )
+    {
+	logWarning() << "Could not write the session snapshot " << tmpFileName() << endl;
+	QFile::remove( tmpFileName() );
+
+	return false;
+    }
+
+    return replace();
+}
+
+
+bool SessionSnapshot::startSaving( DirTree * tree )
+{
+    if ( ! canSave( tree ) || ! makeDir() )
+	return false;
+
+    // This continues in finishSaving()
+
+    return tree->startWritingCache( tmpFileName() );
+}
+
+
+bool SessionSnapshot::finishSaving( const QString & writtenFile, bool ok )
+{
+    if ( writtenFile != tmpFileName() )
+	return false;
+
+    if ( ok )
+	replace();
+    else
+	QFile::remove( tmpFileName() );
+
+    return true;
+}
+
+
+bool SessionSnapshot::replace()
+{
+    QString tmpName = tmpFileName();
+    QString name    = fileName();
+
+    if ( ::rename( tmpName.toUtf8().constData(), name.toUtf8().constData() ) != 0 )
+    {
+	logWarning() << "Could not rename " << tmpName << " to " << name
+		     << ": " << formatErrno() << endl;
+	QFile::remove( tmpName );
+
+	return false;
+    }
+
+    logInfo() << "Session snapshot: " << name << endl;
+    return true;
+}
@@ -0,0 +1,99 @@
+/*
+ *   File name: SessionSnapshot.h
+ *   Summary:	Binary snapshot of the tree to restore the last session
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SessionSnapshot_h
+#define SessionSnapshot_h
+
+
+#include <QString>
+
+
+namespace QDirStat
+{
+    class DirTree;
+
+
+    /**
+     * Binary cache file of the current tree that is written when the
+     * program exits (and optionally from time to time in the background)
+     * and read again on the next start, so the last tree is back within
+     * seconds instead of being read again from disk. After reading it,
+     * the tree is checked against the filesystem like an incremental
+     * refresh (see DirTree::verify()): Only directories whose mtime
+     * changed are read again.
+     *
+     * Only trees of a local directory are saved, not package views,
+     * remote or merged trees.
+     **/
+    class SessionSnapshot
+    {
+    public:
+
+	/**
+	 * Return the name of the snapshot file:
+	 * $XDG_CACHE_HOME/qdirstat/session.cache.bin
+	 **/
+	static QString fileName();
+
+	/**
+	 * Return 'true' if there is a snapshot file.
+	 **/
+	static bool exists();
+
+	/**
+	 * Return 'true' if 'tree' can be saved: It is a local directory,
+	 * and it is not being read or written.
+	 **/
+	static bool canSave( DirTree * tree );
+
+	/**
+	 * Write the snapshot of 'tree' and wait until it is written. Return
+	 * 'true' on success.
+	 **/
+	static bool save( DirTree * tree );
+
+	/**
+	 * Start writing the snapshot of 'tree' in the background. When it
+	 * is finished, the tree sends treeWritten(); pass that on to
+	 * finishSaving(). Return 'true' if writing was started.
+	 **/
+	static bool startSaving( DirTree * tree );
+
+	/**
+	 * Handle the treeWritten() signal of a tree: Return 'false' if it
+	 * was not about the snapshot, otherwise replace the snapshot with
+	 * the file that was just written and return 'true'.
+	 **/
+	static bool finishSaving( const QString & writtenFile, bool ok );
+
+
+    protected:
+
+	/**
+	 * Return the name of the file to write the snapshot to before it is
+	 * renamed to fileName(), so nobody ever reads it half-written.
+	 **/
+	static QString tmpFileName();
+
+	/**
+	 * Create the directory of the snapshot file if necessary. Return
+	 * 'true' on success.
+	 **/
+	static bool makeDir();
+
+	/**
+	 * Rename the file that was just written to fileName().
+	 **/
+	static bool replace();
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// SessionSnapshot_h
@@ -16,6 +16,7 @@
 #include <errno.h>
 
 #include <QCoreApplication>
+#include <QMutex>
 
 #include "Settings.h"
 #include "SettingsHelpers.h"
@@ -28,12 +29,17 @@ using namespace QDirStat;
 
 QSet<QString> Settings::_usedConfigFiles;
 
+// Settings are also read in background threads while starting up
+
+static QMutex usedConfigFilesMutex;
+
 
 Settings::Settings( const QString & name ):
     QSettings( QCoreApplication::organizationName(),
 	       name.isEmpty()? QCoreApplication::applicationName() : name ),
     _name( name )
 {
+    QMutexLocker locker( &usedConfigFilesMutex );
     _usedConfigFiles << fileName();
 }
 
@@ -63,6 +69,8 @@ void Settings::fixFileOwners()
 {
     if ( SysUtil::runningWithSudo() )
     {
+        QMutexLocker locker( &usedConfigFilesMutex );
+
         foreach ( const QString & filename, _usedConfigFiles )
             fixFileOwner( filename );
     }
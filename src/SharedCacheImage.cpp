@@ -0,0 +1,179 @@
+/*
+ *   File name: SharedCacheImage.cpp
+ *   Summary:	Binary images of cache files shared between processes
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <unistd.h>
+#include <stdio.h>	// rename()
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QCryptographicHash>
+
+#include "SharedCacheImage.h"
+#include "DirTree.h"
+#include "DirTreeCache.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+#define IMAGE_NAME_PREFIX	"qdirstat-image-"
+#define SHARED_MEMORY_DIR	"/dev/shm"
+
+// Images of older versions of a cache file might still be in use by
+// other instances that read their directories on demand, so they are only
+// removed if nobody touched them for that long.
+
+#define STALE_IMAGE_HOURS	24
+
+
+using namespace QDirStat;
+
+
+QString SharedCacheImage::imageDir()
+{
+    QFileInfo shm( SHARED_MEMORY_DIR );
+
+    if ( shm.isDir() && shm.isWritable() )
+	return shm.absoluteFilePath();
+
+    return QDir::tempPath();
+}
+
+
+QString SharedCacheImage::imagePrefix( const QString & cacheFileName )
+{
+    QByteArray path = QFileInfo( cacheFileName ).absoluteFilePath().toUtf8();
+    QByteArray hash = QCryptographicHash::hash( path, QCryptographicHash::Sha1 ).toHex().left( 16 );
+
+    return imageDir() + "/" + IMAGE_NAME_PREFIX + QString::fromLatin1( hash ) + "-";
+}
+
+
+QString SharedCacheImage::imagePath( const QString & cacheFileName )
+{
+    QFileInfo fileInfo( cacheFileName );
+
+    if ( ! fileInfo.isFile() )
+	return QString();
+
+    QByteArray version = QByteArray::number( fileInfo.size() ) + " " +
+	QByteArray::number( fileInfo.lastModified().toMSecsSinceEpoch() );
+    QByteArray hash = QCryptographicHash::hash( version, QCryptographicHash::Sha1 ).toHex().left( 16 );
+
+    return imagePrefix( cacheFileName ) + QString::fromLatin1( hash ) + BINARY_CACHE_SUFFIX;
+}
+
+
+bool SharedCacheImage::isImage( const QString & fileName )
+{
+    return fileName.startsWith( imageDir() + "/" + IMAGE_NAME_PREFIX ) &&
+	fileName.endsWith( BINARY_CACHE_SUFFIX );
+}
+
+
+QString SharedCacheImage::find( const QString & cacheFileName )
+{
+    QString path = imagePath( cacheFileName );
+
+    if ( path.isEmpty() )
+	return QString();
+
+    QFileInfo image( path );
+
+    if ( ! image.isFile() || ! image.isReadable() )
+	return QString();
+
+    // Anybody can write to /dev/shm, so don't trust just any file there
+
+    uint owner = image.ownerId();
+
+    if ( owner != (uint) getuid() &&
+	 owner != 0		  &&
+	 owner != QFileInfo( cacheFileName ).ownerId() )
+    {
+	logWarning() << "Not using " << path << " owned by UID " << owner << endl;
+	return QString();
+    }
+
+    if ( ! CacheWriter::isBinaryCacheFile( path ) )
+	return QString();
+
+    return path;
+}
+
+
+bool SharedCacheImage::create( const QString & cacheFileName, DirTree * tree )
+{
+    QString path = imagePath( cacheFileName );
+
+    if ( path.isEmpty() || ! tree || ! tree->firstToplevel() )
+	return false;
+
+    // Write it under another name first so nobody reads it half-written.
+    // That name needs the binary suffix, too.
+
+    QString tmpName = path;
+    tmpName.chop( QString( BINARY_CACHE_SUFFIX ).size() );
+    tmpName += QString( ".tmp%1" ).arg( getpid() ) + BINARY_CACHE_SUFFIX;
+
+    if ( ! tree->writeCache( tmpName ) )
+    {
+	logWarning() << "Could not write the shared image of " << cacheFileName << endl;
+	QFile::remove( tmpName );
+
+	return false;
+    }
+
+    QFile::setPermissions( tmpName,
+			   QFile::ReadOwner | QFile::WriteOwner |
+			   QFile::ReadGroup | QFile::ReadOther );
+
+    if ( ::rename( tmpName.toUtf8().constData(), path.toUtf8().constData() ) != 0 )
+    {
+	logWarning() << "Could not rename " << tmpName << " to " << path
+		     << ": " << formatErrno() << endl;
+	QFile::remove( tmpName );
+
+	return false;
+    }
+
+    logInfo() << "Shared image of " << cacheFileName << ": " << path << endl;
+    removeStale( cacheFileName, path );
+
+    return true;
+}
+
+
+void SharedCacheImage::removeStale( const QString & cacheFileName,
+				    const QString & currentImage )
+{
+    QFileInfo prefix( imagePrefix( cacheFileName ) );
+    QDir      dir( prefix.absolutePath() );
+    QDateTime limit = QDateTime::currentDateTime().addSecs( -STALE_IMAGE_HOURS * 3600 );
+
+    QStringList names = dir.entryList( QStringList() << prefix.fileName() + "*" + BINARY_CACHE_SUFFIX,
+				       QDir::Files );
+
+    foreach ( const QString & name, names )
+    {
+	QFileInfo image( dir, name );
+
+	if ( image.absoluteFilePath() == currentImage ||
+	     image.ownerId() != (uint) getuid()	       ||
+	     image.lastRead() > limit		       ||
+	     image.lastModified() > limit )
+	{
+	    continue;
+	}
+
+	logInfo() << "Removing outdated shared image " << image.absoluteFilePath() << endl;
+	QFile::remove( image.absoluteFilePath() );
+    }
+}
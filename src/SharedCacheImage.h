@@ -0,0 +1,92 @@
+/*
+ *   File name: SharedCacheImage.h
+ *   Summary:	Binary images of cache files shared between processes
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SharedCacheImage_h
+#define SharedCacheImage_h
+
+
+#include <QString>
+
+
+namespace QDirStat
+{
+    class DirTree;
+
+
+    /**
+     * Binary images of text cache files in shared memory (/dev/shm), so
+     * several QDirStat instances on one host that open the same big cache
+     * file don't each pay the full cost of reading it:
+     *
+     * The first instance reads the cache file as usual and then writes the
+     * tree as a binary cache file (see doc/cache-file-format.txt) to
+     * /dev/shm. The other instances find that image and read it lazily:
+     * It is memory-mapped read-only, so all of them use the same pages,
+     * and each instance only creates the directories that its user opens.
+     *
+     * The name of the image is derived from the path, size and mtime of
+     * the cache file, so an updated cache file gets a new image. Only
+     * images that belong to the current user, to root or to the owner of
+     * the cache file are used.
+     **/
+    class SharedCacheImage
+    {
+    public:
+
+	/**
+	 * Return the name of the image of cache file 'cacheFileName' or an
+	 * empty string if that cache file does not exist.
+	 **/
+	static QString imagePath( const QString & cacheFileName );
+
+	/**
+	 * Return the name of the image of 'cacheFileName' if there is a
+	 * usable one, or an empty string if there is none.
+	 **/
+	static QString find( const QString & cacheFileName );
+
+	/**
+	 * Write 'tree' that was just read from 'cacheFileName' as the image
+	 * of that cache file and remove outdated images of it. Return
+	 * 'true' on success.
+	 **/
+	static bool create( const QString & cacheFileName, DirTree * tree );
+
+	/**
+	 * Return 'true' if 'fileName' is an image created by create().
+	 **/
+	static bool isImage( const QString & fileName );
+
+
+    protected:
+
+	/**
+	 * Return the directory for the images: /dev/shm if there is one,
+	 * the directory for temporary files otherwise.
+	 **/
+	static QString imageDir();
+
+	/**
+	 * Return the part of the image name that only depends on the path
+	 * of 'cacheFileName'.
+	 **/
+	static QString imagePrefix( const QString & cacheFileName );
+
+	/**
+	 * Remove the images of older versions of 'cacheFileName' other than
+	 * 'currentImage' that were not touched for a while.
+	 **/
+	static void removeStale( const QString & cacheFileName,
+				 const QString & currentImage );
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// SharedCacheImage_h
@@ -0,0 +1,337 @@
+/*
+ *   File name: SharedExtents.cpp
+ *   Summary:	Count extents shared by reflinks and snapshots only once
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>	// memset()
+
+#include "SharedExtents.h"
+
+#if HAVE_FIEMAP
+#  include <sys/ioctl.h>
+#  include <linux/fs.h>		// FS_IOC_FIEMAP
+#  include <linux/fiemap.h>
+#endif
+
+#include "Logger.h"
+#include "Exception.h"
+
+
+#define EXTENT_TABLE_SHARDS	16
+#define MAX_SHARED_EXTENTS	( 1024 * 1024 )	// About 50 MB
+#define EXTENTS_PER_CALL	256
+#define MAX_SCAN_THREADS	8
+
+
+using namespace QDirStat;
+
+
+void SharedExtentsTotals::add( const SharedExtentsTotals & other )
+{
+    size	+= other.size;
+    sharedSize	+= other.sharedSize;
+    diskSize	+= other.diskSize;
+    files	+= other.files;
+    unsupported += other.unsupported;
+}
+
+
+
+
+SharedExtentTable::SharedExtentTable( int maxEntries ):
+    _maxEntriesPerShard( qMax( 1, maxEntries / EXTENT_TABLE_SHARDS ) ),
+    _overflowed( 0 )
+{
+    for ( int i = 0; i < EXTENT_TABLE_SHARDS; ++i )
+    {
+	Shard * shard = new Shard;
+	CHECK_NEW( shard );
+
+	_shards << shard;
+    }
+}
+
+
+SharedExtentTable::~SharedExtentTable()
+{
+    qDeleteAll( _shards );
+}
+
+
+bool SharedExtentTable::claim( quint64 device, quint64 physical )
+{
+    ExtentKey key( device, physical );
+
+    // Extents are aligned to the filesystem block size, so the low bits of
+    // the physical offset are useless for picking a shard.
+
+    Shard * shard = _shards[ ( physical >> 12 ) % EXTENT_TABLE_SHARDS ];
+    QMutexLocker locker( &shard->mutex );
+
+    if ( shard->extents.contains( key ) )
+	return false;
+
+    if ( shard->extents.size() >= _maxEntriesPerShard )
+    {
+	if ( _overflowed.testAndSetOrdered( 0, 1 ) )
+	    logWarning() << "Shared extents table full; counting some extents more than once" << endl;
+
+	return true;
+    }
+
+    shard->extents.insert( key );
+
+    return true;
+}
+
+
+
+
+SharedExtentsWorker::SharedExtentsWorker( SharedExtentsScanner * scanner,
+					  int			 groupCount ):
+    QThread(),
+    _scanner( scanner ),
+    _totals( groupCount )
+{
+    // NOP
+}
+
+
+void SharedExtentsWorker::run()
+{
+    SharedExtentsCandidate candidate;
+
+    while ( _scanner->takeCandidate( candidate ) )
+    {
+	SharedExtentsTotals & totals = _totals[ candidate.group ];
+	++totals.files;
+
+	if ( ! scanFile( candidate.path, totals ) )
+	{
+	    // Without the extents, all we can do is counting it like
+	    // everywhere else in QDirStat.
+
+	    ++totals.unsupported;
+	    totals.size	    += candidate.allocatedSize;
+	    totals.diskSize += candidate.allocatedSize;
+	}
+    }
+}
+
+
+bool SharedExtentsWorker::scanFile( const QString & path, SharedExtentsTotals & totals )
+{
+#if HAVE_FIEMAP
+
+    int fd = open( path.toUtf8(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC );
+
+    if ( fd < 0 )
+    {
+	logDebug() << "Can't open " << path << ": " << formatErrno() << endl;
+	return false;
+    }
+
+    struct stat statInfo;
+
+    if ( fstat( fd, &statInfo ) != 0 )
+    {
+	close( fd );
+	return false;
+    }
+
+    if ( _buffer.isEmpty() )
+	_buffer.resize( sizeof( struct fiemap ) + EXTENTS_PER_CALL * sizeof( struct fiemap_extent ) );
+
+    struct fiemap * fiemap = (struct fiemap *) _buffer.data();
+    quint64 start = 0;
+    bool    last  = false;
+
+    // Add the extents only when the complete file could be mapped, so a
+    // failure halfway through does not count part of it twice.
+
+    SharedExtentsTotals fileTotals;
+
+    while ( ! last && ! _scanner->cancelled() )
+    {
+	memset( fiemap, 0, sizeof( struct fiemap ) );
+	fiemap->fm_start	= start;
+	fiemap->fm_length	= FIEMAP_MAX_OFFSET - start;
+	fiemap->fm_extent_count = EXTENTS_PER_CALL;
+
+	if ( ioctl( fd, FS_IOC_FIEMAP, fiemap ) != 0 )
+	{
+	    if ( errno != EOPNOTSUPP )
+		logDebug() << "FIEMAP failed for " << path << ": " << formatErrno() << endl;
+
+	    close( fd );
+	    return false;
+	}
+
+	if ( fiemap->fm_mapped_extents == 0 )
+	    break;
+
+	for ( quint32 i = 0; i < fiemap->fm_mapped_extents; ++i )
+	{
+	    const struct fiemap_extent & extent = fiemap->fm_extents[ i ];
+
+	    fileTotals.size += extent.fe_length;
+
+	    // Extents that are not allocated yet, that are inlined into the
+	    // metadata or whose location is unknown have no usable physical
+	    // offset; they can't be shared anyway.
+
+	    bool shared = ( extent.fe_flags & FIEMAP_EXTENT_SHARED ) &&
+		! ( extent.fe_flags & ( FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC |
+					FIEMAP_EXTENT_DATA_INLINE ) );
+
+	    if ( shared )
+	    {
+		fileTotals.sharedSize += extent.fe_length;
+
+		if ( _scanner->extentTable()->claim( statInfo.st_dev, extent.fe_physical ) )
+		    fileTotals.diskSize += extent.fe_length;
+	    }
+	    else
+	    {
+		fileTotals.diskSize += extent.fe_length;
+	    }
+
+	    if ( extent.fe_flags & FIEMAP_EXTENT_LAST )
+		last = true;
+	}
+
+	const struct fiemap_extent & lastExtent =
+	    fiemap->fm_extents[ fiemap->fm_mapped_extents - 1 ];
+
+	start = lastExtent.fe_logical + lastExtent.fe_length;
+    }
+
+    close( fd );
+
+    totals.size	      += fileTotals.size;
+    totals.sharedSize += fileTotals.sharedSize;
+    totals.diskSize   += fileTotals.diskSize;
+
+    return true;
+
+#else
+
+    Q_UNUSED( path );
+    Q_UNUSED( totals );
+
+    return false;
+
+#endif
+}
+
+
+
+
+SharedExtentsScanner::SharedExtentsScanner( const QVector<SharedExtentsCandidate> & candidates,
+					    int					    groupCount,
+					    QObject *				    parent ):
+    QObject( parent ),
+    _candidates( candidates ),
+    _nextCandidate( 0 ),
+    _cancelled( 0 ),
+    _extentTable( MAX_SHARED_EXTENTS ),
+    _totals( groupCount ),
+    _runningWorkers( 0 )
+{
+    // The worker threads read the candidates without any locking, so this
+    // vector must not share its data with the caller's vector.
+
+    _candidates.detach();
+}
+
+
+SharedExtentsScanner::~SharedExtentsScanner()
+{
+    cancel();
+
+    foreach ( SharedExtentsWorker * worker, _workers )
+	worker->wait();
+
+    qDeleteAll( _workers );
+}
+
+
+void SharedExtentsScanner::start()
+{
+    int threadCount = qBound( 1, QThread::idealThreadCount(), MAX_SCAN_THREADS );
+    threadCount	    = qMin( threadCount, _candidates.size() );
+
+    logInfo() << "Scanning the extents of " << _candidates.size() << " files"
+	      << " in " << threadCount << " threads" << endl;
+
+    if ( threadCount == 0 )
+    {
+	emit finished();
+	return;
+    }
+
+    for ( int i = 0; i < threadCount; ++i )
+    {
+	SharedExtentsWorker * worker = new SharedExtentsWorker( this, _totals.size() );
+	CHECK_NEW( worker );
+
+	connect( worker, SIGNAL( finished()	  ),
+		 this,	 SLOT  ( workerFinished() ) );
+
+	_workers << worker;
+	++_runningWorkers;
+	worker->start( QThread::LowPriority );
+    }
+}
+
+
+void SharedExtentsScanner::cancel()
+{
+    _cancelled.storeRelease( 1 );
+}
+
+
+bool SharedExtentsScanner::takeCandidate( SharedExtentsCandidate & candidate_ret )
+{
+    if ( cancelled() )
+	return false;
+
+    int index = _nextCandidate.fetchAndAddOrdered( 1 );
+
+    if ( index >= _candidates.size() )
+	return false;
+
+    candidate_ret = _candidates.at( index );
+
+    return true;
+}
+
+
+void SharedExtentsScanner::workerFinished()
+{
+    if ( --_runningWorkers > 0 )
+	return;
+
+    // All workers are finished now, so their totals can be merged without
+    // any locking.
+
+    foreach ( SharedExtentsWorker * worker, _workers )
+    {
+	for ( int i = 0; i < _totals.size(); ++i )
+	    _totals[ i ].add( worker->totals().at( i ) );
+    }
+
+    logInfo() << "Scanned the extents of " << scannedFiles() << " files"
+	      << ( cancelled() ? " (cancelled)" : "" ) << endl;
+
+    emit finished();
+}
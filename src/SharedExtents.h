@@ -0,0 +1,303 @@
+/*
+ *   File name: SharedExtents.h
+ *   Summary:	Count extents shared by reflinks and snapshots only once
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SharedExtents_h
+#define SharedExtents_h
+
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QVector>
+#include <QList>
+#include <QSet>
+#include <QPair>
+#include <QString>
+
+#include "FileInfo.h"
+
+
+// FIEMAP is Linux-only; on other platforms, the scanner simply counts the
+// allocated size of every file.
+
+#define HAVE_FIEMAP		0
+
+#if defined( __linux__ ) && defined( __has_include )
+#  if __has_include( <linux/fiemap.h> )
+#    undef  HAVE_FIEMAP
+#    define HAVE_FIEMAP		1
+#  endif
+#endif
+
+
+namespace QDirStat
+{
+    class SharedExtentsScanner;
+
+
+    /**
+     * A file to scan. The worker threads never touch the DirTree, so this
+     * holds everything they need. 'group' is the index of the totals that
+     * this file is added to.
+     **/
+    struct SharedExtentsCandidate
+    {
+	QString	 path;
+	FileSize allocatedSize;
+	int	 group;
+    };
+
+
+    /**
+     * Sizes of one group of files.
+     **/
+    struct SharedExtentsTotals
+    {
+	SharedExtentsTotals():
+	    size( 0 ),
+	    sharedSize( 0 ),
+	    diskSize( 0 ),
+	    files( 0 ),
+	    unsupported( 0 )
+	    {}
+
+	/**
+	 * Add the sizes of 'other' to this.
+	 **/
+	void add( const SharedExtentsTotals & other );
+
+	FileSize size;		// All extents
+	FileSize sharedSize;	// Extents flagged as shared with other files
+	FileSize diskSize;	// All extents, shared ones counted only once
+	int	 files;
+	int	 unsupported;	// Files where FIEMAP failed
+    };
+
+
+    /**
+     * Table of the shared extents that were already counted, identified by
+     * their device and physical offset.
+     *
+     * Only extents that the filesystem flags as shared are ever added, and
+     * the number of entries is limited to 'maxEntries', so the memory usage
+     * remains bounded even for huge snapshot-heavy filesystems. When the
+     * table is full, extents that are not in it any more are counted again,
+     * i.e. the result is no worse than without this table; overflowed()
+     * tells if that happened.
+     *
+     * The table is split into several shards with a lock of their own, so
+     * the worker threads rarely have to wait for each other.
+     **/
+    class SharedExtentTable
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	SharedExtentTable( int maxEntries );
+
+	/**
+	 * Destructor.
+	 **/
+	~SharedExtentTable();
+
+	/**
+	 * Claim the extent at 'physical' on device 'device'. Return 'true'
+	 * if it was not claimed before, i.e. if the caller should count it.
+	 *
+	 * This is thread-safe.
+	 **/
+	bool claim( quint64 device, quint64 physical );
+
+	/**
+	 * Return 'true' if the table was full at least once, so some shared
+	 * extents were counted more than once.
+	 **/
+	bool overflowed() const { return _overflowed.loadAcquire() != 0; }
+
+    protected:
+
+	typedef QPair<quint64, quint64> ExtentKey;
+
+	struct Shard
+	{
+	    QMutex	    mutex;
+	    QSet<ExtentKey> extents;
+	};
+
+	QVector<Shard *> _shards;
+	int		 _maxEntriesPerShard;
+	QAtomicInt	 _overflowed;
+
+    private:
+
+	// Disable copying: The shards are owned by this table
+	SharedExtentTable( const SharedExtentTable & );
+	SharedExtentTable & operator=( const SharedExtentTable & );
+    };
+
+
+    /**
+     * Worker thread of a SharedExtentsScanner: Take the next files from the
+     * scanner, get their extents with the FIEMAP ioctl and add them to the
+     * totals of their group.
+     **/
+    class SharedExtentsWorker: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	SharedExtentsWorker( SharedExtentsScanner * scanner, int groupCount );
+
+	/**
+	 * Return the totals of each group. Use this only after the thread is
+	 * finished.
+	 **/
+	const QVector<SharedExtentsTotals> & totals() const { return _totals; }
+
+    protected:
+
+	/**
+	 * The worker loop. This is called in the new thread.
+	 *
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	/**
+	 * Add the extents of one file to 'totals'. Return 'false' if FIEMAP
+	 * is not supported for that file.
+	 **/
+	bool scanFile( const QString & path, SharedExtentsTotals & totals );
+
+
+	SharedExtentsScanner *	     _scanner;
+	QVector<SharedExtentsTotals> _totals;
+	QByteArray		     _buffer;
+    };
+
+
+    /**
+     * Engine to find out how much disk space a set of files really uses on
+     * filesystems with copy-on-write extents like Btrfs and XFS: Extents
+     * that are shared by reflinked copies, deduplicated files or snapshots
+     * are counted only once, for the first file that was found to use them.
+     *
+     * This is opt-in since it needs an additional FIEMAP call (which may
+     * have to read filesystem metadata from disk) for each file. Several
+     * worker threads do that in parallel.
+     *
+     * The files are handed over in groups (e.g. one for each direct child
+     * of a directory) so the results can be shown for each group.
+     **/
+    class SharedExtentsScanner: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor. 'groupCount' is the number of groups; each
+	 * candidate's group has to be less than that. Call start() to start
+	 * the worker threads.
+	 **/
+	SharedExtentsScanner( const QVector<SharedExtentsCandidate> & candidates,
+			      int				      groupCount,
+			      QObject *				      parent = 0 );
+
+	/**
+	 * Destructor. This cancels the scan and waits for the worker
+	 * threads.
+	 **/
+	virtual ~SharedExtentsScanner();
+
+	/**
+	 * Start the worker threads.
+	 **/
+	void start();
+
+	/**
+	 * Request the worker threads to stop as soon as possible.
+	 **/
+	void cancel();
+
+	/**
+	 * Return 'true' if cancel() was called.
+	 **/
+	bool cancelled() const { return _cancelled.loadAcquire() != 0; }
+
+	/**
+	 * Return the totals of each group. They are only complete after
+	 * finished() was emitted.
+	 **/
+	const QVector<SharedExtentsTotals> & totals() const { return _totals; }
+
+	/**
+	 * Return 'true' if the table of shared extents was full, so some of
+	 * them were counted more than once.
+	 **/
+	bool overflowed() const { return _extentTable.overflowed(); }
+
+	/**
+	 * Return the number of files that were scanned so far and the total
+	 * number of files.
+	 **/
+	int scannedFiles() const { return qMin( _nextCandidate.loadAcquire(), totalFiles() ); }
+	int totalFiles()   const { return _candidates.size(); }
+
+
+	// For the worker threads
+
+	/**
+	 * Return the next candidate to scan in 'candidate_ret'. Return 'false'
+	 * if there is none left or the scan was cancelled.
+	 **/
+	bool takeCandidate( SharedExtentsCandidate & candidate_ret );
+
+	/**
+	 * Return the table of the shared extents that were already counted.
+	 **/
+	SharedExtentTable * extentTable() { return &_extentTable; }
+
+
+    signals:
+
+	/**
+	 * Emitted when all worker threads are finished.
+	 **/
+	void finished();
+
+
+    protected slots:
+
+	/**
+	 * Notification that a worker thread is finished.
+	 **/
+	void workerFinished();
+
+
+    protected:
+
+	QVector<SharedExtentsCandidate> _candidates;
+	QAtomicInt			_nextCandidate;
+	QAtomicInt			_cancelled;
+	SharedExtentTable		_extentTable;
+	QVector<SharedExtentsTotals>	_totals;
+	QList<SharedExtentsWorker *>	_workers;
+	int				_runningWorkers;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// SharedExtents_h
@@ -0,0 +1,371 @@
+/*
+ *   File name: SharedExtentsWindow.cpp
+ *   Summary:	QDirStat "shared extents" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QHash>
+
+#include "SharedExtentsWindow.h"
+#include "TreeWalker.h"
+#include "TreeWalkerRunner.h"
+#include "DirTree.h"
+#include "SettingsHelpers.h"
+#include "HeaderTweaker.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+using namespace QDirStat;
+
+
+SharedExtentsWindow::SharedExtentsWindow( QWidget * parent ):
+    QDialog( parent ),
+    _ui( new Ui::SharedExtentsWindow ),
+    _walker( new SharedExtentsTreeWalker() ),
+    _runner( 0 ),
+    _scanner( 0 ),
+    _tree( 0 )
+{
+    // logDebug() << "init" << endl;
+
+    CHECK_NEW( _ui );
+    CHECK_NEW( _walker );
+    _ui->setupUi( this );
+    initWidgets();
+    readWindowSettings( this, "SharedExtentsWindow" );
+
+    connect( _ui->refreshButton, SIGNAL( clicked() ),
+	     this,		 SLOT  ( refresh() ) );
+
+    connect( _ui->stopButton,	 SIGNAL( clicked() ),
+	     this,		 SLOT  ( cancelScan() ) );
+}
+
+
+SharedExtentsWindow::~SharedExtentsWindow()
+{
+    // logDebug() << "destroying" << endl;
+
+    cancelScan();
+    writeWindowSettings( this, "SharedExtentsWindow" );
+    delete _walker;
+    delete _ui;
+}
+
+
+void SharedExtentsWindow::clear()
+{
+    _ui->treeWidget->clear();
+    _ui->totalLabel->clear();
+    _groupNames.clear();
+}
+
+
+void SharedExtentsWindow::refresh()
+{
+    populate( _subtree() );
+}
+
+
+void SharedExtentsWindow::initWidgets()
+{
+    QFont font = _ui->heading->font();
+    font.setBold( true );
+    _ui->heading->setFont( font );
+
+    QStringList headerLabels;
+    headerLabels << tr( "Name"	     )
+		 << tr( "Files"	     )
+		 << tr( "Size"	     )
+		 << tr( "Shared"     )
+		 << tr( "Disk Usage" );
+
+    _ui->treeWidget->setColumnCount( headerLabels.size() );
+    _ui->treeWidget->setHeaderLabels( headerLabels );
+    _ui->treeWidget->setRootIsDecorated( false );
+    _ui->treeWidget->setSortingEnabled( true );
+    _ui->treeWidget->sortByColumn( SE_DiskSizeCol, Qt::DescendingOrder );
+    _ui->treeWidget->header()->setStretchLastSection( false );
+    HeaderTweaker::resizeToContents( _ui->treeWidget->header() );
+
+    QTreeWidgetItem * headerItem = _ui->treeWidget->headerItem();
+
+    for ( int col = SE_FilesCol; col <= SE_DiskSizeCol; ++col )
+	headerItem->setTextAlignment( col, Qt::AlignHCenter );
+
+    headerItem->setToolTip( SE_SizeCol,	      tr( "All extents of the files" ) );
+    headerItem->setToolTip( SE_SharedSizeCol, tr( "Extents that are shared with other files" ) );
+    headerItem->setToolTip( SE_DiskSizeCol,   tr( "All extents, shared ones counted only once" ) );
+
+    updateScanStatus();
+}
+
+
+void SharedExtentsWindow::reject()
+{
+    deleteLater();
+}
+
+
+void SharedExtentsWindow::populate( FileInfo * newSubtree )
+{
+    cancelScan();
+    clear();
+    _subtree = newSubtree;
+
+    FileInfo * subtree = _subtree();
+
+    if ( ! subtree )
+	return;
+
+    _ui->heading->setText( tr( "Shared Extents in %1" ).arg( subtree->url() ) );
+    connectTree( _subtree.tree() );
+
+    // Make sure the summary fields are up to date: The collecting threads
+    // must never trigger recalculating them while the view might do the same.
+    subtree->totalFiles();
+
+    _runner = new TreeWalkerRunner( _walker, subtree );
+    CHECK_NEW( _runner );
+
+    connect( _runner, SIGNAL( finished() ),
+	     this,    SLOT  ( collectFinished() ) );
+
+    _runner->start();
+    updateScanStatus();
+}
+
+
+void SharedExtentsWindow::collectFinished()
+{
+    if ( ! _runner || sender() != _runner )
+	return; // Late signal from a scan that was cancelled
+
+    bool cancelled = _runner->cancelled();
+    FileInfo * subtree = _subtree();
+
+    if ( ! cancelled && subtree )
+    {
+	// One group for each direct child of the subtree (including its dot
+	// entry); this has to be done here in the GUI thread since it uses
+	// the tree.
+
+	QHash<FileInfo *, int> groups;
+	QVector<SharedExtentsCandidate> candidates;
+	candidates.reserve( _runner->results().size() );
+
+	foreach ( FileInfo * file, _runner->results() )
+	{
+	    FileInfo * child = file;
+
+	    while ( child->parent() && child->parent() != subtree )
+		child = child->parent();
+
+	    QHash<FileInfo *, int>::const_iterator it = groups.constFind( child );
+	    int group;
+
+	    if ( it == groups.constEnd() )
+	    {
+		group = _groupNames.size();
+		groups.insert( child, group );
+		_groupNames << child->name();
+	    }
+	    else
+	    {
+		group = it.value();
+	    }
+
+	    SharedExtentsCandidate candidate;
+	    candidate.path	    = file->path();
+	    candidate.allocatedSize = file->allocatedSize();
+	    candidate.group	    = group;
+
+	    candidates << candidate;
+	}
+
+	_scanner = new SharedExtentsScanner( candidates, _groupNames.size() );
+	CHECK_NEW( _scanner );
+
+	connect( _scanner, SIGNAL( finished()	   ),
+		 this,	   SLOT	 ( scanFinished() ) );
+    }
+
+    delete _runner;
+    _runner = 0;
+
+    if ( _scanner )
+	_scanner->start();
+
+    updateScanStatus();
+}
+
+
+void SharedExtentsWindow::scanFinished()
+{
+    if ( ! _scanner || sender() != _scanner )
+	return; // Late signal from a scan that was cancelled
+
+    if ( ! _scanner->cancelled() )
+    {
+	const QVector<SharedExtentsTotals> & totals = _scanner->totals();
+	SharedExtentsTotals sum;
+
+	for ( int i = 0; i < totals.size(); ++i )
+	{
+	    new SharedExtentsItem( _groupNames.at( i ), totals.at( i ), _ui->treeWidget );
+	    sum.add( totals.at( i ) );
+	}
+
+	QString text = tr( "Size: %1  Shared: %2  Disk usage: %3" )
+	    .arg( formatSize( sum.size	     ) )
+	    .arg( formatSize( sum.sharedSize ) )
+	    .arg( formatSize( sum.diskSize   ) );
+
+	if ( sum.unsupported > 0 )
+	    text += "  " + tr( "(%1 files without extent information)" ).arg( sum.unsupported );
+
+	if ( _scanner->overflowed() )
+	    text += "  " + tr( "(approximate)" );
+
+	_ui->totalLabel->setText( text );
+    }
+
+    _scanner->deleteLater(); // We are in a slot called by its signal
+    _scanner = 0;
+    updateScanStatus();
+}
+
+
+void SharedExtentsWindow::cancelScan()
+{
+    if ( ! _runner && ! _scanner )
+	return;
+
+    logDebug() << "Cancelling scan" << endl;
+
+    // Deleting the runner or the scanner cancels it and waits until it is
+    // stopped. Signals that might still be queued are ignored because of
+    // the sender() checks.
+
+    if ( _runner )
+    {
+	delete _runner;
+	_runner = 0;
+    }
+
+    if ( _scanner )
+    {
+	delete _scanner;
+	_scanner = 0;
+    }
+
+    _ui->totalLabel->clear();
+    updateScanStatus();
+}
+
+
+void SharedExtentsWindow::cancelCollecting()
+{
+    if ( ! _runner )
+	return;
+
+    logDebug() << "Cancelling collecting the files" << endl;
+
+    delete _runner;
+    _runner = 0;
+    _ui->totalLabel->clear();
+    updateScanStatus();
+}
+
+
+void SharedExtentsWindow::connectTree( DirTree * tree )
+{
+    if ( tree == _tree )
+	return;
+
+    if ( _tree )
+	disconnect( _tree, 0, this, 0 );
+
+    _tree = tree;
+
+    if ( ! _tree )
+	return;
+
+    // The collecting threads must never see the tree while it changes. The
+    // scanner's threads don't use the tree, so they can go on.
+
+    connect( _tree, SIGNAL( deletingChild  ( FileInfo * ) ),
+	     this,  SLOT  ( cancelCollecting() ) );
+
+    connect( _tree, SIGNAL( clearingSubtree( DirInfo * ) ),
+	     this,  SLOT  ( cancelCollecting() ) );
+
+    connect( _tree, SIGNAL( clearing() ),
+	     this,  SLOT  ( cancelCollecting() ) );
+
+    connect( _tree, SIGNAL( startingReading() ),
+	     this,  SLOT  ( cancelCollecting() ) );
+}
+
+
+void SharedExtentsWindow::updateScanStatus()
+{
+    bool scanning = _runner || _scanner;
+
+    _ui->stopButton->setEnabled( scanning );
+    _ui->refreshButton->setEnabled( ! scanning );
+
+    if ( _scanner )
+	_ui->totalLabel->setText( tr( "Scanning %1 files..." ).arg( _scanner->totalFiles() ) );
+    else if ( _runner )
+	_ui->totalLabel->setText( tr( "Collecting files..." ) );
+
+    if ( scanning )
+	setCursor( Qt::BusyCursor );
+    else
+	unsetCursor();
+}
+
+
+
+
+
+
+SharedExtentsItem::SharedExtentsItem( const QString		& name,
+				      const SharedExtentsTotals & totals,
+				      QTreeWidget		* parent ):
+    QTreeWidgetItem( parent ),
+    _totals( totals )
+{
+    QString blanks = QString( 3, ' ' ); // Enforce left margin
+
+    setText( SE_NameCol,       name + "    " );
+    setText( SE_FilesCol,      blanks + QString::number( totals.files ) );
+    setText( SE_SizeCol,       blanks + formatSize( totals.size	      ) );
+    setText( SE_SharedSizeCol, blanks + formatSize( totals.sharedSize ) );
+    setText( SE_DiskSizeCol,   blanks + formatSize( totals.diskSize   ) );
+
+    for ( int col = SE_FilesCol; col <= SE_DiskSizeCol; ++col )
+	setTextAlignment( col, Qt::AlignRight );
+}
+
+
+bool SharedExtentsItem::operator<( const QTreeWidgetItem & rawOther ) const
+{
+    const SharedExtentsItem & other = dynamic_cast<const SharedExtentsItem &>( rawOther );
+
+    int col = treeWidget() ? treeWidget()->sortColumn() : SE_NameCol;
+
+    switch ( col )
+    {
+	case SE_FilesCol:	return totals().files	   < other.totals().files;
+	case SE_SizeCol:	return totals().size	   < other.totals().size;
+	case SE_SharedSizeCol:	return totals().sharedSize < other.totals().sharedSize;
+	case SE_DiskSizeCol:	return totals().diskSize   < other.totals().diskSize;
+	default:		return QTreeWidgetItem::operator<( rawOther );
+    }
+}
@@ -0,0 +1,207 @@
+/*
+ *   File name: SharedExtentsWindow.h
+ *   Summary:	QDirStat "shared extents" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SharedExtentsWindow_h
+#define SharedExtentsWindow_h
+
+#include <QDialog>
+#include <QTreeWidgetItem>
+
+#include "ui_shared-extents-window.h"
+#include "SharedExtents.h"
+#include "FileInfo.h"
+#include "Subtree.h"
+
+
+namespace QDirStat
+{
+    class SharedExtentsTreeWalker;
+    class TreeWalkerRunner;
+    class DirTree;
+
+
+    /**
+     * Modeless dialog to display how much disk space the direct children of
+     * a directory really use when extents that are shared by reflinked
+     * copies, deduplicated files or snapshots (Btrfs, XFS) are counted only
+     * once.
+     *
+     * This is done in two steps, both in other threads so the user
+     * interface remains responsive: A TreeWalkerRunner collects all files
+     * with any disk blocks in the subtree, then a SharedExtentsScanner gets
+     * their extents from the filesystem.
+     *
+     * Collecting the files is cancelled before the tree changes in any
+     * way; scanning the files goes on.
+     **/
+    class SharedExtentsWindow: public QDialog
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 *
+	 * Notice that this widget will destroy itself upon window close.
+	 *
+	 * It is advised to use a QPointer for storing a pointer to an instance
+	 * of this class. The QPointer will keep track of this window
+	 * auto-deleting itself when closed.
+	 **/
+	SharedExtentsWindow( QWidget * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~SharedExtentsWindow();
+
+	/**
+	 * Obtain the subtree from the last used URL or 0 if none was found.
+	 **/
+	const Subtree & subtree() const { return _subtree; }
+
+
+    public slots:
+
+	/**
+	 * Populate the window: Scan the extents of all files in 'subtree'.
+	 *
+	 * This clears the old results first, then starts scanning in other
+	 * threads.
+	 **/
+	void populate( FileInfo * subtree = 0 );
+
+	/**
+	 * Cancel a running scan (if there is one) and wait until it is
+	 * stopped.
+	 **/
+	void cancelScan();
+
+	/**
+	 * Cancel collecting the files from the tree (if that is still
+	 * running) and wait until it is stopped. This is called before the
+	 * tree changes.
+	 **/
+	void cancelCollecting();
+
+	/**
+	 * Refresh (reload) all data.
+	 **/
+	void refresh();
+
+	/**
+	 * Reject the dialog contents, i.e. the user clicked the "Cancel" or
+	 * WM_CLOSE button. This not only closes the dialog, it also deletes
+	 * it.
+	 *
+	 * Reimplemented from QDialog.
+	 **/
+	virtual void reject() Q_DECL_OVERRIDE;
+
+
+    protected slots:
+
+	/**
+	 * Notification that collecting the files is finished: Start the
+	 * SharedExtentsScanner.
+	 **/
+	void collectFinished();
+
+	/**
+	 * Notification that the SharedExtentsScanner is finished: Show the
+	 * results.
+	 **/
+	void scanFinished();
+
+
+    protected:
+
+	/**
+	 * Clear all data and widget contents.
+	 **/
+	void clear();
+
+	/**
+	 * One-time initialization of the widgets in this window.
+	 **/
+	void initWidgets();
+
+	/**
+	 * Connect to the tree's signals to cancel collecting the files before
+	 * anything in the tree changes.
+	 **/
+	void connectTree( DirTree * tree );
+
+	/**
+	 * Update the widgets for a running or stopped scan.
+	 **/
+	void updateScanStatus();
+
+
+	//
+	// Data members
+	//
+
+	Ui::SharedExtentsWindow *	_ui;
+	SharedExtentsTreeWalker *	_walker;
+	TreeWalkerRunner *		_runner;
+	SharedExtentsScanner *		_scanner;
+	DirTree *			_tree;
+	Subtree				_subtree;
+	QStringList			_groupNames;
+    };
+
+
+    /**
+     * Column numbers for the shared extents tree widget
+     **/
+    enum SharedExtentsColumns
+    {
+	SE_NameCol = 0,
+	SE_FilesCol,
+	SE_SizeCol,
+	SE_SharedSizeCol,
+	SE_DiskSizeCol
+    };
+
+
+    /**
+     * Item class for the shared extents list: The totals of one direct
+     * child of the subtree.
+     **/
+    class SharedExtentsItem: public QTreeWidgetItem
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	SharedExtentsItem( const QString		& name,
+			   const SharedExtentsTotals	& totals,
+			   QTreeWidget			* parent );
+
+	const SharedExtentsTotals & totals() const { return _totals; }
+
+	/**
+	 * Less-than operator for sorting.
+	 *
+	 * Reimplemented from QTreeWidgetItem.
+	 **/
+	virtual bool operator<( const QTreeWidgetItem & other ) const Q_DECL_OVERRIDE;
+
+    protected:
+
+	SharedExtentsTotals _totals;
+    };
+
+} // namespace QDirStat
+
+
+#endif // SharedExtentsWindow_h
@@ -0,0 +1,231 @@
+/*
+ *   File name: SizeEstimator.cpp
+ *   Summary:	Quick size estimates from a sample of the subdirectories
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <math.h>
+
+#include <QList>
+
+#include "SizeEstimator.h"
+#include "DirInfo.h"
+#include "DirTree.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+// z value of a 95% confidence interval of the normal distribution
+
+#define CONFIDENCE_Z	1.96
+
+
+using namespace QDirStat;
+
+
+SizeEstimator::SizeEstimator():
+    _active( false ),
+    _fullLevels( 2 ),
+    _samplePercent( 10 ),
+    _minSamples( 3 ),
+    _estimatedCount( 0 )
+{
+    // NOP
+}
+
+
+bool SizeEstimator::isSampling( const DirInfo * dir ) const
+{
+    if ( ! _active || ! dir )
+	return false;
+
+    // The toplevel is level 0; its subdirectories are all read if
+    // _fullLevels is 1 or more
+
+    const FileInfo * toplevel = dir->tree()->firstToplevel();
+    int level = 0;
+
+    for ( const FileInfo * item = dir; item && item != toplevel; item = item->parent() )
+    {
+	if ( ++level >= _fullLevels )
+	    return true;
+    }
+
+    return level >= _fullLevels;
+}
+
+
+QVector<bool> SizeEstimator::selectSample( int count ) const
+{
+    QVector<bool> sampled( count, false );
+
+    int sampleCount = (int) ceil( count * _samplePercent / 100.0 );
+    sampleCount = qBound( 1, qMax( sampleCount, _minSamples ), qMax( count, 1 ) );
+
+    for ( int i = 0; i < sampleCount && count > 0; ++i )
+	sampled[ (int) ( (qint64) i * count / sampleCount ) ] = true;
+
+    return sampled;
+}
+
+
+void SizeEstimator::markEstimated( DirInfo * dir )
+{
+    CHECK_PTR( dir );
+
+    dir->setEstimated();
+    ++_estimatedCount;
+}
+
+
+void SizeEstimator::extrapolate( DirInfo * dir )
+{
+    if ( ! dir || ( _estimatedCount == 0 && _margins.isEmpty() ) )
+	return;
+
+    _margins.clear();
+    extrapolateSubtree( dir );
+
+    logInfo() << _estimatedCount << " directories estimated from samples" << endl;
+}
+
+
+SizeEstimator::Variance SizeEstimator::extrapolateSubtree( DirInfo * dir )
+{
+    Variance variance;
+    Variance sampleVariance;
+    QList<DirInfo *> samples;
+    QList<DirInfo *> estimated;
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( ! child->isDirInfo() || child->isPseudoDir() )
+	    continue;
+
+	DirInfo * subDir = child->toDirInfo();
+
+	if ( subDir->isEstimated() )
+	{
+	    estimated << subDir;
+	    continue;
+	}
+
+	Variance childVariance = extrapolateSubtree( subDir );
+	variance.size	   += childVariance.size;
+	variance.allocated += childVariance.allocated;
+
+	// Excluded directories and mount points are not read at all, so
+	// they say nothing about their estimated siblings
+
+	if ( ! subDir->isExcluded() && ! subDir->isMountPoint() && ! subDir->readError() )
+	{
+	    samples << subDir;
+	    sampleVariance.size	     += childVariance.size;
+	    sampleVariance.allocated += childVariance.allocated;
+	}
+    }
+
+    if ( ! estimated.isEmpty() && ! samples.isEmpty() )
+    {
+	double k = samples.size();
+	double n = samples.size() + estimated.size();
+
+	double sizeSum	    = 0.0;
+	double sizeSquares  = 0.0;
+	double allocSum	    = 0.0;
+	double allocSquares = 0.0;
+	double blocksSum    = 0.0;
+	double itemsSum	    = 0.0;
+	double subDirsSum   = 0.0;
+	double filesSum	    = 0.0;
+
+	foreach ( DirInfo * sample, samples )
+	{
+	    double size	 = sample->totalSize();
+	    double alloc = sample->totalAllocatedSize();
+
+	    sizeSum	 += size;
+	    sizeSquares	 += size * size;
+	    allocSum	 += alloc;
+	    allocSquares += alloc * alloc;
+	    blocksSum	 += sample->totalBlocks();
+	    itemsSum	 += sample->totalItems();
+	    subDirsSum	 += sample->totalSubDirs();
+	    filesSum	 += sample->totalFiles();
+	}
+
+	// Sample variance; with only one sample, assume that the estimate
+	// may be off by 100%
+
+	double sizeMean	 = sizeSum  / k;
+	double allocMean = allocSum / k;
+	double sizeS2	 = k > 1 ? ( sizeSquares  - k * sizeMean  * sizeMean  ) / ( k - 1 ) : sizeMean  * sizeMean;
+	double allocS2	 = k > 1 ? ( allocSquares - k * allocMean * allocMean ) / ( k - 1 ) : allocMean * allocMean;
+
+	sizeS2	= qMax( sizeS2,	 0.0 );	// rounding errors
+	allocS2 = qMax( allocS2, 0.0 );
+
+	Variance estimateVariance;	// of one estimated directory
+	estimateVariance.size	   = sizeS2  * ( 1.0 + 1.0 / k );
+	estimateVariance.allocated = allocS2 * ( 1.0 + 1.0 / k );
+
+	foreach ( DirInfo * subDir, estimated )
+	{
+	    subDir->setEstimate( (FileSize) sizeMean,
+				 (FileSize) allocMean,
+				 (FileSize) ( blocksSum / k ),
+				 qRound( itemsSum   / k ),
+				 qRound( subDirsSum / k ),
+				 qRound( filesSum   / k ) );
+
+	    setMargin( subDir, estimateVariance );
+	}
+
+	double scale = ( n / k ) * ( n / k ) - 1.0;
+
+	variance.size	   += n * n * ( 1.0 - k / n ) * sizeS2  / k + scale * sampleVariance.size;
+	variance.allocated += n * n * ( 1.0 - k / n ) * allocS2 / k + scale * sampleVariance.allocated;
+    }
+
+    if ( ! estimated.isEmpty() || variance.size > 0.0 || variance.allocated > 0.0 )
+	setMargin( dir, variance );
+
+    return variance;
+}
+
+
+void SizeEstimator::setMargin( const DirInfo * dir, const Variance & variance )
+{
+    Margin margin;
+    margin.size	     = (FileSize) ( CONFIDENCE_Z * sqrt( variance.size	    ) );
+    margin.allocated = (FileSize) ( CONFIDENCE_Z * sqrt( variance.allocated ) );
+
+    _margins.insert( dir, margin );
+}
+
+
+void SizeEstimator::forget( FileInfo * subtree )
+{
+    if ( _margins.isEmpty() )
+	return;
+
+    QMutableHashIterator<const DirInfo *, Margin> it( _margins );
+
+    while ( it.hasNext() )
+    {
+	it.next();
+
+	if ( it.key()->isInSubtree( subtree ) )
+	    it.remove();
+    }
+}
+
+
+void SizeEstimator::clear()
+{
+    _margins.clear();
+    _estimatedCount = 0;
+}
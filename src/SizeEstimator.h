@@ -0,0 +1,199 @@
+/*
+ *   File name: SizeEstimator.h
+ *   Summary:	Quick size estimates from a sample of the subdirectories
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SizeEstimator_h
+#define SizeEstimator_h
+
+
+#include <QHash>
+#include <QVector>
+
+#include "FileSize.h"
+
+
+namespace QDirStat
+{
+    class DirInfo;
+    class FileInfo;
+
+
+    /**
+     * Estimate mode for reading a directory tree in seconds rather than
+     * hours: The top levels are read completely; below that, only a sample
+     * of the subdirectories of each directory is read, and the others
+     * become estimated directories (see DirInfo::isEstimated()) with the
+     * average totals of the sampled ones.
+     *
+     * After reading, extrapolate() fills in those averages bottom-up and
+     * calculates a 95% confidence interval for the total size of each
+     * directory that contains estimates. The variance of the total of the
+     * subdirectories of a directory with 'n' subdirectories of which 'k'
+     * were read is that of simple random sampling without replacement,
+     *
+     *	 n^2 * (1 - k/n) * s^2 / k
+     *
+     * with the sample variance s^2 of their totals, plus the variance of
+     * the sampled subdirectories themselves (if they contain estimates)
+     * scaled up by (n/k)^2.
+     *
+     * Reading an estimated directory for real (refreshing it) replaces its
+     * estimate, and the next extrapolate() uses it as one more sample for
+     * its siblings.
+     **/
+    class SizeEstimator
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	SizeEstimator();
+
+	/**
+	 * Return 'true' if subdirectories are sampled in the current read.
+	 **/
+	bool isActive() const { return _active; }
+
+	/**
+	 * Enable or disable sampling for the current read.
+	 **/
+	void setActive( bool active ) { _active = active; }
+
+	/**
+	 * Return the number of directory levels below the toplevel that are
+	 * read completely.
+	 **/
+	int fullLevels() const { return _fullLevels; }
+
+	/**
+	 * Set the number of levels that are read completely.
+	 **/
+	void setFullLevels( int levels ) { _fullLevels = levels; }
+
+	/**
+	 * Return the percentage of the subdirectories that are read below
+	 * the full levels.
+	 **/
+	int samplePercent() const { return _samplePercent; }
+
+	/**
+	 * Set the percentage of the subdirectories that are read.
+	 **/
+	void setSamplePercent( int percent ) { _samplePercent = percent; }
+
+	/**
+	 * Return the minimum number of subdirectories of each directory that
+	 * are read.
+	 **/
+	int minSamples() const { return _minSamples; }
+
+	/**
+	 * Set the minimum number of subdirectories that are read.
+	 **/
+	void setMinSamples( int count ) { _minSamples = count; }
+
+	/**
+	 * Return 'true' if only a sample of the subdirectories of 'dir'
+	 * should be read.
+	 **/
+	bool isSampling( const DirInfo * dir ) const;
+
+	/**
+	 * Select which of 'count' subdirectories to read: evenly spread over
+	 * the directory order, which is as good as random for most
+	 * filesystems. Return one flag per subdirectory.
+	 **/
+	QVector<bool> selectSample( int count ) const;
+
+	/**
+	 * Make 'dir' an estimated directory that is not read.
+	 **/
+	void markEstimated( DirInfo * dir );
+
+	/**
+	 * Fill in the totals of all estimated directories in the subtree of
+	 * 'dir' and calculate the confidence intervals. This is done after
+	 * reading is finished.
+	 **/
+	void extrapolate( DirInfo * dir );
+
+	/**
+	 * Return 'true' if the totals of 'dir' include estimates.
+	 **/
+	bool isEstimate( const DirInfo * dir ) const
+	    { return _margins.contains( dir ); }
+
+	/**
+	 * Return the half width of the 95% confidence interval of the total
+	 * size of 'dir' or 0 if it does not include estimates.
+	 **/
+	FileSize sizeMargin( const DirInfo * dir ) const
+	    { return _margins.value( dir ).size; }
+
+	/**
+	 * Return the half width of the 95% confidence interval of the total
+	 * allocated size of 'dir' or 0 if it does not include estimates.
+	 **/
+	FileSize allocatedMargin( const DirInfo * dir ) const
+	    { return _margins.value( dir ).allocated; }
+
+	/**
+	 * Forget the confidence intervals of the directories in 'subtree'
+	 * when it is deleted or cleared.
+	 **/
+	void forget( FileInfo * subtree );
+
+	/**
+	 * Forget everything.
+	 **/
+	void clear();
+
+
+    protected:
+
+	struct Variance
+	{
+	    double size;
+	    double allocated;
+
+	    Variance(): size( 0.0 ), allocated( 0.0 ) {}
+	};
+
+	struct Margin
+	{
+	    FileSize size;
+	    FileSize allocated;
+
+	    Margin(): size( 0 ), allocated( 0 ) {}
+	};
+
+	/**
+	 * Extrapolate the estimated subdirectories of 'dir' and return the
+	 * variance of its totals.
+	 **/
+	Variance extrapolateSubtree( DirInfo * dir );
+
+	/**
+	 * Store the confidence interval for 'variance' of 'dir'.
+	 **/
+	void setMargin( const DirInfo * dir, const Variance & variance );
+
+
+	bool				  _active;
+	int				  _fullLevels;
+	int				  _samplePercent;
+	int				  _minSamples;
+	int				  _estimatedCount;
+	QHash<const DirInfo *, Margin>	  _margins;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef SizeEstimator_h
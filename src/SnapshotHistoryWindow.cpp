@@ -0,0 +1,303 @@
+/*
+ *   File name: SnapshotHistoryWindow.cpp
+ *   Summary:	QDirStat "growth history" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QPainter>
+#include <QFileDialog>
+
+#include "SnapshotHistoryWindow.h"
+#include "DirTree.h"
+#include "QDirStatApp.h"
+#include "Settings.h"
+#include "SettingsHelpers.h"
+#include "HeaderTweaker.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+#define CHART_HEIGHT	150
+#define CHART_MARGIN	6
+
+using namespace QDirStat;
+
+
+SnapshotHistoryWindow::SnapshotHistoryWindow( QWidget * parent ):
+    QDialog( parent ),
+    _ui( new Ui::SnapshotHistoryWindow )
+{
+    // logDebug() << "init" << endl;
+
+    CHECK_NEW( _ui );
+    _ui->setupUi( this );
+    initWidgets();
+    readSettings();
+    readWindowSettings( this, "SnapshotHistoryWindow" );
+
+    connect( _ui->refreshButton,     SIGNAL( clicked()	   ),
+	     this,		     SLOT  ( refresh()	   ) );
+
+    connect( _ui->addSnapshotButton, SIGNAL( clicked()	   ),
+	     this,		     SLOT  ( addSnapshot() ) );
+
+    connect( _ui->storeButton,	     SIGNAL( clicked()	   ),
+	     this,		     SLOT  ( askStore()	   ) );
+}
+
+
+SnapshotHistoryWindow::~SnapshotHistoryWindow()
+{
+    // logDebug() << "destroying" << endl;
+
+    writeWindowSettings( this, "SnapshotHistoryWindow" );
+    writeSettings();
+    delete _ui;
+}
+
+
+void SnapshotHistoryWindow::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "SnapshotHistoryWindow" );
+    _storeDir = settings.value( "Store", SnapshotStore::defaultDirName() ).toString();
+    settings.endGroup();
+}
+
+
+void SnapshotHistoryWindow::writeSettings()
+{
+    Settings settings;
+    settings.beginGroup( "SnapshotHistoryWindow" );
+    settings.setValue( "Store", _storeDir );
+    settings.endGroup();
+}
+
+
+void SnapshotHistoryWindow::clear()
+{
+    _ui->treeWidget->clear();
+    _ui->storeLabel->clear();
+    _chart->setSnapshots( DirSnapshotList() );
+}
+
+
+void SnapshotHistoryWindow::initWidgets()
+{
+    QFont font = _ui->heading->font();
+    font.setBold( true );
+    _ui->heading->setFont( font );
+
+    _chart = new SnapshotChart( this );
+    CHECK_NEW( _chart );
+    _ui->verticalLayout->insertWidget( 1, _chart );
+
+    QStringList headerLabels;
+    headerLabels << tr( "Time"	     )
+		 << tr( "Total Size" )
+		 << tr( "Items"	     )
+		 << tr( "Change"     );
+
+    _ui->treeWidget->setColumnCount( headerLabels.size() );
+    _ui->treeWidget->setHeaderLabels( headerLabels );
+    _ui->treeWidget->setRootIsDecorated( false );
+    _ui->treeWidget->setSortingEnabled( true );
+    _ui->treeWidget->sortByColumn( SH_TimeCol, Qt::DescendingOrder );
+    _ui->treeWidget->header()->setStretchLastSection( false );
+    HeaderTweaker::resizeToContents( _ui->treeWidget->header() );
+
+    QTreeWidgetItem * headerItem = _ui->treeWidget->headerItem();
+
+    for ( int col = SH_SizeCol; col <= SH_ChangeCol; ++col )
+	headerItem->setTextAlignment( col, Qt::AlignHCenter );
+}
+
+
+void SnapshotHistoryWindow::reject()
+{
+    deleteLater();
+}
+
+
+void SnapshotHistoryWindow::populate( FileInfo * newSubtree )
+{
+    _subtree = newSubtree;
+    refresh();
+}
+
+
+void SnapshotHistoryWindow::refresh()
+{
+    clear();
+
+    FileInfo * subtree = _subtree();
+
+    if ( ! subtree )
+	return;
+
+    _ui->heading->setText( tr( "Growth History of %1" ).arg( subtree->url() ) );
+
+    SnapshotStore store( _storeDir );
+    DirSnapshotList snapshots = store.history( subtree->url() );
+
+    for ( int i = 0; i < snapshots.size(); ++i )
+    {
+	FileSize change = i > 0 ? snapshots.at( i ).totalSize - snapshots.at( i-1 ).totalSize : 0;
+	new SnapshotHistoryItem( snapshots.at( i ), change, _ui->treeWidget );
+    }
+
+    _chart->setSnapshots( snapshots );
+    _ui->storeLabel->setText( tr( "%1 of %2 snapshots in %3" )
+			      .arg( snapshots.size() )
+			      .arg( store.snapshotCount() )
+			      .arg( _storeDir ) );
+}
+
+
+void SnapshotHistoryWindow::addSnapshot()
+{
+    FileInfo * toplevel = app()->dirTree()->firstToplevel();
+
+    if ( ! toplevel || app()->dirTree()->isBusy() )
+	return;
+
+    setCursor( Qt::BusyCursor );
+    SnapshotStore store( _storeDir );
+
+    if ( ! store.addSnapshot( toplevel ) )
+	_ui->storeLabel->setText( tr( "Can't add a snapshot to %1" ).arg( _storeDir ) );
+    else
+	refresh();
+
+    unsetCursor();
+}
+
+
+void SnapshotHistoryWindow::askStore()
+{
+    QString dir = QFileDialog::getExistingDirectory( this, // parent
+						     tr( "Select the snapshot history store" ),
+						     _storeDir );
+    if ( ! dir.isEmpty() )
+    {
+	_storeDir = dir;
+	refresh();
+    }
+}
+
+
+
+
+SnapshotChart::SnapshotChart( QWidget * parent ):
+    QWidget( parent )
+{
+    setMinimumHeight( CHART_HEIGHT );
+    setSizePolicy( QSizePolicy::Expanding, QSizePolicy::Fixed );
+}
+
+
+void SnapshotChart::setSnapshots( const DirSnapshotList & snapshots )
+{
+    _snapshots = snapshots;
+    update();
+}
+
+
+void SnapshotChart::paintEvent( QPaintEvent * )
+{
+    QPainter painter( this );
+    painter.fillRect( rect(), palette().base() );
+
+    if ( _snapshots.size() < 2 )
+    {
+	painter.drawText( rect(), Qt::AlignCenter,
+			  tr( "Not enough snapshots for a chart" ) );
+	return;
+    }
+
+    FileSize minSize = _snapshots.first().totalSize;
+    FileSize maxSize = minSize;
+    time_t   minTime = _snapshots.first().time;
+    time_t   maxTime = _snapshots.last().time;
+
+    foreach ( const DirSnapshot & snapshot, _snapshots )
+    {
+	minSize = qMin( minSize, snapshot.totalSize );
+	maxSize = qMax( maxSize, snapshot.totalSize );
+	minTime = qMin( minTime, snapshot.time );
+	maxTime = qMax( maxTime, snapshot.time );
+    }
+
+    QFontMetrics metrics( font() );
+    int textHeight = metrics.height();
+
+    QRect chart = rect().adjusted( CHART_MARGIN, CHART_MARGIN + textHeight,
+				   -CHART_MARGIN, -CHART_MARGIN - textHeight );
+
+    double sizeRange = qMax( (FileSize) 1, maxSize - minSize );
+    double timeRange = qMax( (time_t)	1, maxTime - minTime );
+
+    QPolygonF line;
+
+    foreach ( const DirSnapshot & snapshot, _snapshots )
+    {
+	double x = chart.left()	  + chart.width()  * ( snapshot.time	  - minTime ) / timeRange;
+	double y = chart.bottom() - chart.height() * ( snapshot.totalSize - minSize ) / sizeRange;
+	line << QPointF( x, y );
+    }
+
+    painter.setPen( palette().mid().color() );
+    painter.drawRect( chart );
+
+    painter.setPen( palette().text().color() );
+    painter.drawText( rect().adjusted( CHART_MARGIN, 0, 0, 0 ), Qt::AlignLeft | Qt::AlignTop,
+		      formatSize( maxSize ) );
+    painter.drawText( rect().adjusted( CHART_MARGIN, 0, 0, 0 ), Qt::AlignLeft | Qt::AlignBottom,
+		      formatSize( minSize ) + "   " + formatTime( minTime ) );
+    painter.drawText( rect().adjusted( 0, 0, -CHART_MARGIN, 0 ), Qt::AlignRight | Qt::AlignBottom,
+		      formatTime( maxTime ) );
+
+    painter.setRenderHint( QPainter::Antialiasing );
+    painter.setPen( QPen( palette().highlight().color(), 2 ) );
+    painter.drawPolyline( line );
+}
+
+
+
+
+SnapshotHistoryItem::SnapshotHistoryItem( const DirSnapshot & snapshot,
+					  FileSize	      change,
+					  QTreeWidget	    * parent ):
+    QTreeWidgetItem( parent ),
+    _snapshot( snapshot ),
+    _change( change )
+{
+    QString blanks = QString( 3, ' ' ); // Enforce left margin
+
+    setText( SH_TimeCol,   formatTime( snapshot.time ) + "    " );
+    setText( SH_SizeCol,   blanks + formatSize( snapshot.totalSize ) );
+    setText( SH_ItemsCol,  blanks + QString::number( snapshot.totalItems ) );
+    setText( SH_ChangeCol, blanks + formatSizeDelta( change ) );
+
+    for ( int col = SH_SizeCol; col <= SH_ChangeCol; ++col )
+	setTextAlignment( col, Qt::AlignRight );
+}
+
+
+bool SnapshotHistoryItem::operator<( const QTreeWidgetItem & rawOther ) const
+{
+    const SnapshotHistoryItem & other = dynamic_cast<const SnapshotHistoryItem &>( rawOther );
+
+    int col = treeWidget() ? treeWidget()->sortColumn() : SH_TimeCol;
+
+    switch ( col )
+    {
+	case SH_SizeCol:	return snapshot().totalSize  < other.snapshot().totalSize;
+	case SH_ItemsCol:	return snapshot().totalItems < other.snapshot().totalItems;
+	case SH_ChangeCol:	return change()		     < other.change();
+	default:		return snapshot().time	     < other.snapshot().time;
+    }
+}
@@ -0,0 +1,203 @@
+/*
+ *   File name: SnapshotHistoryWindow.h
+ *   Summary:	QDirStat "growth history" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SnapshotHistoryWindow_h
+#define SnapshotHistoryWindow_h
+
+#include <QDialog>
+#include <QWidget>
+#include <QTreeWidgetItem>
+
+#include "ui_snapshot-history-window.h"
+#include "SnapshotStore.h"
+#include "Subtree.h"
+
+
+namespace QDirStat
+{
+    class SnapshotChart;
+
+
+    /**
+     * Modeless dialog to display how the total size of a directory changed
+     * over all the snapshots in a SnapshotStore: As a chart and as a list
+     * with the change since the previous snapshot.
+     **/
+    class SnapshotHistoryWindow: public QDialog
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 *
+	 * Notice that this widget will destroy itself upon window close.
+	 *
+	 * It is advised to use a QPointer for storing a pointer to an instance
+	 * of this class. The QPointer will keep track of this window
+	 * auto-deleting itself when closed.
+	 **/
+	SnapshotHistoryWindow( QWidget * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~SnapshotHistoryWindow();
+
+	/**
+	 * Obtain the subtree from the last used URL or 0 if none was found.
+	 **/
+	const Subtree & subtree() const { return _subtree; }
+
+
+    public slots:
+
+	/**
+	 * Populate the window: Show the history of directory 'subtree'.
+	 **/
+	void populate( FileInfo * subtree = 0 );
+
+	/**
+	 * Refresh (reload) all data.
+	 **/
+	void refresh();
+
+	/**
+	 * Add a snapshot of the current tree to the store.
+	 **/
+	void addSnapshot();
+
+	/**
+	 * Open a directory selection dialog for the store.
+	 **/
+	void askStore();
+
+	/**
+	 * Reject the dialog contents, i.e. the user clicked the "Cancel" or
+	 * WM_CLOSE button. This not only closes the dialog, it also deletes
+	 * it.
+	 *
+	 * Reimplemented from QDialog.
+	 **/
+	virtual void reject() Q_DECL_OVERRIDE;
+
+
+    protected:
+
+	/**
+	 * Clear all data and widget contents.
+	 **/
+	void clear();
+
+	/**
+	 * One-time initialization of the widgets in this window.
+	 **/
+	void initWidgets();
+
+	/**
+	 * Read the store directory from the settings.
+	 **/
+	void readSettings();
+
+	/**
+	 * Write the store directory to the settings.
+	 **/
+	void writeSettings();
+
+
+	//
+	// Data members
+	//
+
+	Ui::SnapshotHistoryWindow * _ui;
+	SnapshotChart *		    _chart;
+	Subtree			    _subtree;
+	QString			    _storeDir;
+    };
+
+
+    /**
+     * Simple line chart of the total size of a directory over time.
+     **/
+    class SnapshotChart: public QWidget
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	SnapshotChart( QWidget * parent = 0 );
+
+	/**
+	 * Set the snapshots to display and repaint.
+	 **/
+	void setSnapshots( const DirSnapshotList & snapshots );
+
+    protected:
+
+	/**
+	 * Reimplemented from QWidget.
+	 **/
+	virtual void paintEvent( QPaintEvent * event ) Q_DECL_OVERRIDE;
+
+	DirSnapshotList _snapshots;
+    };
+
+
+    /**
+     * Column numbers for the snapshot history tree widget
+     **/
+    enum SnapshotHistoryColumns
+    {
+	SH_TimeCol = 0,
+	SH_SizeCol,
+	SH_ItemsCol,
+	SH_ChangeCol
+    };
+
+
+    /**
+     * Item class for the snapshot history list: One snapshot of the
+     * directory.
+     **/
+    class SnapshotHistoryItem: public QTreeWidgetItem
+    {
+    public:
+
+	/**
+	 * Constructor. 'change' is the change of the total size since the
+	 * previous snapshot.
+	 **/
+	SnapshotHistoryItem( const DirSnapshot & snapshot,
+			     FileSize		 change,
+			     QTreeWidget       * parent );
+
+	const DirSnapshot & snapshot() const { return _snapshot; }
+	FileSize change() const { return _change; }
+
+	/**
+	 * Less-than operator for sorting.
+	 *
+	 * Reimplemented from QTreeWidgetItem.
+	 **/
+	virtual bool operator<( const QTreeWidgetItem & other ) const Q_DECL_OVERRIDE;
+
+    protected:
+
+	DirSnapshot _snapshot;
+	FileSize    _change;
+    };
+
+} // namespace QDirStat
+
+
+#endif // SnapshotHistoryWindow_h
@@ -0,0 +1,400 @@
+/*
+ *   File name: SnapshotStore.cpp
+ *   Summary:	On-disk history of directory sizes across many scans
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <string.h>	// memset(), memcmp()
+#include <algorithm>
+
+#include <QFile>
+#include <QDir>
+
+#include "SnapshotStore.h"
+#include "DirInfo.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Round 'offset' up to the next multiple of 8.
+     **/
+    quint64 align8( quint64 offset )
+    {
+	return ( offset + 7 ) & ~( (quint64) 7 );
+    }
+
+
+    /**
+     * Copy the content of 'array' to 'data' at offset 'offset'.
+     **/
+    template<typename T> void putArray( QByteArray & data, quint64 offset, const QVector<T> & array )
+    {
+	memcpy( data.data() + offset, array.constData(), array.size() * sizeof( T ) );
+    }
+
+
+    /**
+     * Return 'array' reordered by the indices in 'order'.
+     **/
+    template<typename T> QVector<T> reordered( const QVector<T> & array, const QVector<int> & order )
+    {
+	QVector<T> result;
+	result.reserve( array.size() );
+
+	for ( int i = 0; i < order.size(); ++i )
+	    result << array.at( order.at( i ) );
+
+	return result;
+    }
+
+
+    /**
+     * Comparison function for sorting snapshots by time.
+     **/
+    bool earlier( const DirSnapshot & a, const DirSnapshot & b )
+    {
+	return a.time < b.time;
+    }
+
+
+    /**
+     * Visitor for SnapshotStore::visitSnapshots() that looks up one path
+     * index in each snapshot.
+     **/
+    struct HistoryVisitor
+    {
+	quint32		pathIndex;
+	DirSnapshotList result;
+
+	void operator()( const uchar * record, const SnapshotHeader & header )
+	{
+	    const quint32 * indices = (const quint32 *) ( record + header.indicesOffset );
+	    const quint32 * end	    = indices + header.dirCount;
+	    const quint32 * found   = std::lower_bound( indices, end, pathIndex );
+
+	    if ( found == end || *found != pathIndex )
+		return;
+
+	    quint64 pos = found - indices;
+
+	    DirSnapshot snapshot;
+	    snapshot.time	 = header.time;
+	    snapshot.totalSize	 = ( (const qint64 *) ( record + header.sizesOffset  ) )[ pos ];
+	    snapshot.totalItems	 = ( (const qint64 *) ( record + header.itemsOffset  ) )[ pos ];
+	    snapshot.latestMtime = ( (const qint64 *) ( record + header.mtimesOffset ) )[ pos ];
+
+	    result << snapshot;
+	}
+    };
+
+
+    /**
+     * Visitor for SnapshotStore::visitSnapshots() that only counts.
+     **/
+    struct CountVisitor
+    {
+	int count;
+
+	void operator()( const uchar *, const SnapshotHeader & ) { ++count; }
+    };
+
+}	// namespace
+
+
+SnapshotStore::SnapshotStore( const QString & dirName ):
+    _dirName( dirName ),
+    _pathsRead( false )
+{
+    // NOP
+}
+
+
+QString SnapshotStore::defaultDirName()
+{
+    return QDir::homePath() + "/" + DEFAULT_SNAPSHOT_STORE;
+}
+
+
+QByteArray SnapshotStore::encodedPath( const QString & path )
+{
+    QByteArray line = path.toUtf8();
+    line.replace( '%',	"%25" );
+    line.replace( '\n', "%0A" );
+
+    return line;
+}
+
+
+QString SnapshotStore::decodedPath( const QByteArray & line )
+{
+    return QString::fromUtf8( QByteArray::fromPercentEncoding( line ) );
+}
+
+
+bool SnapshotStore::readPaths()
+{
+    if ( _pathsRead )
+	return true;
+
+    QFile file( _dirName + "/" + SNAPSHOT_PATHS_FILE );
+
+    if ( ! file.exists() )
+    {
+	_pathsRead = true;
+	return true;
+    }
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+    {
+	logError() << "Can't open " << file.fileName() << ": " << file.errorString() << endl;
+	return false;
+    }
+
+    quint32 index = 0;
+
+    while ( ! file.atEnd() )
+    {
+	QByteArray line = file.readLine();
+
+	if ( line.endsWith( '\n' ) )
+	    line.chop( 1 );
+
+	_pathIndex.insert( decodedPath( line ), index++ );
+    }
+
+    _pathsRead = true;
+
+    return true;
+}
+
+
+bool SnapshotStore::addSnapshot( FileInfo * subtree, time_t time )
+{
+    if ( ! subtree || ! subtree->isDirInfo() )
+	return false;
+
+    if ( ! QDir().mkpath( _dirName ) )
+    {
+	logError() << "Can't create " << _dirName << endl;
+	return false;
+    }
+
+    // Another process (e.g. a cron job) might have added paths in the
+    // meantime
+
+    _pathIndex.clear();
+    _pathsRead = false;
+
+    if ( ! readPaths() )
+	return false;
+
+    subtree->totalSize();	// Make sure all summaries are up to date
+
+    QList<QByteArray> newPaths;
+    collectDirs( subtree, newPaths );
+
+
+    // Sort the columns by path index
+
+    QVector<int> order( _indices.size() );
+
+    for ( int i = 0; i < order.size(); ++i )
+	order[ i ] = i;
+
+    const QVector<quint32> & indices = _indices;
+
+    std::sort( order.begin(), order.end(),
+	       [&indices]( int a, int b ) { return indices.at( a ) < indices.at( b ); } );
+
+    QVector<quint32> sortedIndices = reordered( _indices, order );
+    QVector<qint64>  sortedSizes   = reordered( _sizes,	  order );
+    QVector<qint64>  sortedItems   = reordered( _items,	  order );
+    QVector<qint64>  sortedMtimes  = reordered( _mtimes,  order );
+
+    _indices.clear();
+    _sizes.clear();
+    _items.clear();
+    _mtimes.clear();
+
+
+    // The new paths first: A snapshot must never refer to a path that isn't
+    // in the paths file.
+
+    if ( ! newPaths.isEmpty() )
+    {
+	QFile pathsFile( _dirName + "/" + SNAPSHOT_PATHS_FILE );
+	bool ok = pathsFile.open( QIODevice::WriteOnly | QIODevice::Append );
+
+	foreach ( const QByteArray & path, newPaths )
+	    ok = ok && pathsFile.write( path + '\n' ) == path.size() + 1;
+
+	if ( ! ok )
+	{
+	    logError() << "Error writing " << pathsFile.fileName() << ": " << pathsFile.errorString() << endl;
+	    _pathIndex.clear();
+	    _pathsRead = false;	// Read it again next time
+
+	    return false;
+	}
+    }
+
+
+    // The snapshot record
+
+    quint64 count = sortedIndices.size();
+
+    SnapshotHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, SNAPSHOT_MAGIC, sizeof( header.magic ) );
+
+    header.byteOrder	 = SNAPSHOT_BYTE_ORDER;
+    header.version	 = SNAPSHOT_FORMAT_VERSION;
+    header.time		 = time ? time : ::time( 0 );
+    header.dirCount	 = count;
+    header.indicesOffset = align8( sizeof( header ) );
+    header.sizesOffset	 = align8( header.indicesOffset + count * sizeof( quint32 ) );
+    header.itemsOffset	 = align8( header.sizesOffset	+ count * sizeof( qint64  ) );
+    header.mtimesOffset	 = align8( header.itemsOffset	+ count * sizeof( qint64  ) );
+    header.recordSize	 = align8( header.mtimesOffset	+ count * sizeof( qint64  ) );
+
+    QByteArray record( header.recordSize, 0 );
+    memcpy( record.data(), &header, sizeof( header ) );
+    putArray( record, header.indicesOffset, sortedIndices );
+    putArray( record, header.sizesOffset,   sortedSizes   );
+    putArray( record, header.itemsOffset,   sortedItems   );
+    putArray( record, header.mtimesOffset,  sortedMtimes  );
+
+    QFile dataFile( _dirName + "/" + SNAPSHOT_DATA_FILE );
+    bool ok = dataFile.open( QIODevice::WriteOnly | QIODevice::Append );
+    ok = ok && dataFile.write( record ) == record.size();
+
+    if ( ! ok )
+    {
+	logError() << "Error writing " << dataFile.fileName() << ": " << dataFile.errorString() << endl;
+	return false;
+    }
+
+    logInfo() << "Added a snapshot of " << count << " directories in " << subtree
+	      << " to " << _dirName << endl;
+
+    return true;
+}
+
+
+void SnapshotStore::collectDirs( FileInfo * dir, QList<QByteArray> & newPaths )
+{
+    if ( ! dir->isDirInfo() || dir->isPseudoDir() )
+	return;
+
+    QString url = dir->url();
+    quint32 index;
+
+    QHash<QString, quint32>::const_iterator it = _pathIndex.constFind( url );
+
+    if ( it != _pathIndex.constEnd() )
+    {
+	index = it.value();
+    }
+    else
+    {
+	index = _pathIndex.size();
+	_pathIndex.insert( url, index );
+	newPaths << encodedPath( url );
+    }
+
+    _indices << index;
+    _sizes   << dir->totalSize();
+    _items   << dir->totalItems();
+    _mtimes  << dir->latestMtime();
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() )
+	    collectDirs( child, newPaths );
+    }
+}
+
+
+template<typename Visitor> bool SnapshotStore::visitSnapshots( Visitor & visit )
+{
+    QFile file( _dirName + "/" + SNAPSHOT_DATA_FILE );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+	return false;
+
+    quint64 fileSize = file.size();
+    const uchar * map = fileSize > 0 ? file.map( 0, fileSize ) : 0;
+
+    if ( ! map )
+	return false;
+
+    quint64 offset = 0;
+
+    while ( offset + sizeof( SnapshotHeader ) <= fileSize )
+    {
+	SnapshotHeader header;
+	memcpy( &header, map + offset, sizeof( header ) );
+
+	bool ok = memcmp( header.magic, SNAPSHOT_MAGIC, sizeof( header.magic ) ) == 0 &&
+	    header.byteOrder == SNAPSHOT_BYTE_ORDER &&
+	    header.version   == SNAPSHOT_FORMAT_VERSION;
+
+	quint64 count = header.dirCount;
+
+	ok = ok && header.recordSize <= fileSize - offset;
+	ok = ok && ( header.recordSize & 7 ) == 0;
+	ok = ok && header.indicesOffset + count * sizeof( quint32 ) <= header.recordSize;
+	ok = ok && header.sizesOffset	+ count * sizeof( qint64  ) <= header.recordSize;
+	ok = ok && header.itemsOffset	+ count * sizeof( qint64  ) <= header.recordSize;
+	ok = ok && header.mtimesOffset	+ count * sizeof( qint64  ) <= header.recordSize;
+	ok = ok && ( ( header.indicesOffset | header.sizesOffset |
+		       header.itemsOffset   | header.mtimesOffset ) & 7 ) == 0;
+
+	if ( ! ok || header.recordSize == 0 )
+	{
+	    logError() << file.fileName() << ": Corrupt snapshot at offset " << offset << endl;
+	    break;
+	}
+
+	visit( map + offset, header );
+	offset += header.recordSize;
+    }
+
+    return true;
+}
+
+
+DirSnapshotList SnapshotStore::history( const QString & url )
+{
+    if ( ! readPaths() || ! _pathIndex.contains( url ) )
+	return DirSnapshotList();
+
+    HistoryVisitor visitor;
+    visitor.pathIndex = _pathIndex.value( url );
+    visitSnapshots( visitor );
+
+    // Snapshots imported from old cache files might have been added later
+
+    std::stable_sort( visitor.result.begin(), visitor.result.end(), earlier );
+
+    return visitor.result;
+}
+
+
+int SnapshotStore::snapshotCount()
+{
+    CountVisitor visitor;
+    visitor.count = 0;
+    visitSnapshots( visitor );
+
+    return visitor.count;
+}
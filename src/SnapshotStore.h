@@ -0,0 +1,176 @@
+/*
+ *   File name: SnapshotStore.h
+ *   Summary:	On-disk history of directory sizes across many scans
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SnapshotStore_h
+#define SnapshotStore_h
+
+
+#include <time.h>
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QVector>
+
+#include "FileInfo.h"
+
+
+#define DEFAULT_SNAPSHOT_STORE		".qdirstat-snapshots"
+#define SNAPSHOT_PATHS_FILE		"paths"
+#define SNAPSHOT_DATA_FILE		"snapshots.bin"
+
+#define SNAPSHOT_MAGIC			"QDSSNAPS"
+#define SNAPSHOT_BYTE_ORDER		0x01020304
+#define SNAPSHOT_FORMAT_VERSION		1
+
+
+namespace QDirStat
+{
+    /**
+     * Header of one snapshot in the snapshot data file. The snapshots are
+     * simply appended to that file, each one directly after the previous
+     * one.
+     *
+     * Like in a binary cache file, all data are in the byte order of the
+     * machine that wrote the file. The columns follow the header; their
+     * offsets are from the start of the header and aligned to 8 bytes.
+     * Each column has one element for each directory, sorted by the path
+     * index, so the values of one directory can be found with a binary
+     * search in the path index column.
+     **/
+    struct SnapshotHeader
+    {
+	char	magic[8];	// SNAPSHOT_MAGIC without the 0 byte
+	quint32 byteOrder;	// SNAPSHOT_BYTE_ORDER
+	quint32 version;	// SNAPSHOT_FORMAT_VERSION
+	qint64	time;		// time of the scan as time_t
+	quint64 dirCount;
+	quint64 recordSize;	// header and columns; the next snapshot follows
+	quint64 indicesOffset;	// quint32: line number in the paths file
+	quint64 sizesOffset;	// qint64:  total size
+	quint64 itemsOffset;	// qint64:  total number of items
+	quint64 mtimesOffset;	// qint64:  latest mtime in the subtree
+    };
+
+
+    /**
+     * The aggregates of one directory in one snapshot.
+     **/
+    struct DirSnapshot
+    {
+	time_t	 time;		// time of the scan
+	FileSize totalSize;
+	qint64	 totalItems;
+	time_t	 latestMtime;
+    };
+
+    typedef QList<DirSnapshot> DirSnapshotList;
+
+
+    /**
+     * Store for the history of the directory summaries (total size, number
+     * of items and latest mtime) of many scans of the same tree, e.g. from
+     * nightly runs of qdirstat-cache-writer. This is much more compact than
+     * keeping all the cache files, and the history of one directory can be
+     * retrieved without loading any complete tree.
+     *
+     * A store is a directory with two files:
+     *
+     * - SNAPSHOT_PATHS_FILE: The path of each directory that was in any
+     *	 snapshot, one per line, percent-encoded where needed. New paths are
+     *	 appended, so the line number is a stable index for each path.
+     *
+     * - SNAPSHOT_DATA_FILE: The snapshots, each one with the columns
+     *	 described in SnapshotHeader. history() memory-maps this file and only
+     *	 touches a few pages of each snapshot.
+     **/
+    class SnapshotStore
+    {
+    public:
+
+	/**
+	 * Constructor for the store in directory 'dirName'. It is created
+	 * when the first snapshot is added.
+	 **/
+	SnapshotStore( const QString & dirName );
+
+	/**
+	 * Return the directory of this store.
+	 **/
+	const QString & dirName() const { return _dirName; }
+
+	/**
+	 * Add the summaries of all directories in 'subtree' as a new snapshot
+	 * taken at 'time' (0 for now). Return 'true' on success, 'false' on
+	 * error.
+	 **/
+	bool addSnapshot( FileInfo * subtree, time_t time = 0 );
+
+	/**
+	 * Return the summaries of directory 'url' in all snapshots that
+	 * contain it, sorted by time.
+	 **/
+	DirSnapshotList history( const QString & url );
+
+	/**
+	 * Return the number of snapshots in this store.
+	 **/
+	int snapshotCount();
+
+	/**
+	 * Return the default store directory.
+	 **/
+	static QString defaultDirName();
+
+
+    protected:
+
+	/**
+	 * Read the paths file if that wasn't done yet.
+	 * Return 'true' on success or if there is no paths file yet.
+	 **/
+	bool readPaths();
+
+	/**
+	 * Add the summary of 'dir' and (recursively) its subdirectories to
+	 * the columns of a new snapshot. Paths that are not in the paths file
+	 * yet are added to 'newPaths'.
+	 **/
+	void collectDirs( FileInfo * dir, QList<QByteArray> & newPaths );
+
+	/**
+	 * Memory-map the data file and call 'visit' for each valid snapshot
+	 * header. Return 'false' if there is no data file.
+	 **/
+	template<typename Visitor> bool visitSnapshots( Visitor & visit );
+
+	/**
+	 * Return 'path' encoded for one line of the paths file and the
+	 * reverse.
+	 **/
+	static QByteArray encodedPath( const QString	& path );
+	static QString	  decodedPath( const QByteArray & line );
+
+
+	QString			_dirName;
+	QHash<QString, quint32> _pathIndex;
+	bool			_pathsRead;
+
+	// The columns of a snapshot while it is being collected
+
+	QVector<quint32>	_indices;
+	QVector<qint64>		_sizes;
+	QVector<qint64>		_items;
+	QVector<qint64>		_mtimes;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef SnapshotStore_h
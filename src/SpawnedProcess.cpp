@@ -0,0 +1,378 @@
+/*
+ *   File name: SpawnedProcess.cpp
+ *   Summary:	Lightweight external processes without QProcess
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <spawn.h>	// posix_spawn()
+#include <unistd.h>	// pipe2(), usleep()
+#include <fcntl.h>	// O_CLOEXEC
+#include <poll.h>
+#include <signal.h>
+#include <string.h>	// strncmp()
+#include <errno.h>
+#include <sys/wait.h>
+
+#include <QMutexLocker>
+#include <QFileInfo>
+#include <QRegExp>
+
+#include "SpawnedProcess.h"
+#include "Logger.h"
+
+// Size of one read() from a pipe
+#define READ_CHUNK_SIZE		65536
+
+// Interval for checking if a process exited when there is a timeout
+#define WAIT_POLL_MICROSEC	1000
+
+extern char ** environ;
+
+
+using namespace QDirStat;
+
+
+QMutex			SpawnedProcess::_envMutex;
+QList<QByteArray>	SpawnedProcess::_envStrings;
+QVector<char *>		SpawnedProcess::_env;
+QProcessEnvironment	SpawnedProcess::_processEnv;
+bool			SpawnedProcess::_haveProcessEnv = false;
+
+
+SpawnedProcess::SpawnedProcess( const QString & command, const QStringList & args ):
+    _command( command ),
+    _args( args ),
+    _mergeStderr( false ),
+    _timeoutSec( 0 ),
+    _pid( 0 ),
+    _stdoutFd( -1 ),
+    _stderrFd( -1 ),
+    _exitedNormally( false ),
+    _exitCode( -1 )
+{
+    // NOP
+}
+
+
+SpawnedProcess::~SpawnedProcess()
+{
+    closeFd( _stdoutFd );
+    closeFd( _stderrFd );
+
+    if ( _pid > 0 )
+	kill();
+}
+
+
+bool SpawnedProcess::start()
+{
+    QString path = findExecutable( _command );
+
+    if ( path.isEmpty() )
+    {
+	logError() << "Command not found: " << _command << endl;
+	return false;
+    }
+
+    int outPipe[ 2 ] = { -1, -1 };
+    int errPipe[ 2 ] = { -1, -1 };
+
+    if ( pipe2( outPipe, O_CLOEXEC ) != 0 ||
+	 ( ! _mergeStderr && pipe2( errPipe, O_CLOEXEC ) != 0 ) )
+    {
+	logError() << "pipe2() failed: " << formatErrno() << endl;
+
+	for ( int i = 0; i < 2; ++i )
+	{
+	    closeFd( outPipe[ i ] );
+	    closeFd( errPipe[ i ] );
+	}
+
+	return false;
+    }
+
+    // The pipes are close-on-exec; only the copies from dup2() are
+    // inherited by the process.
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init( &actions );
+    posix_spawn_file_actions_addopen( &actions, 0, "/dev/null", O_RDONLY, 0 );
+    posix_spawn_file_actions_adddup2( &actions, outPipe[ 1 ], 1 );
+    posix_spawn_file_actions_adddup2( &actions, _mergeStderr ? outPipe[ 1 ] : errPipe[ 1 ], 2 );
+
+    QList<QByteArray> argStrings;
+    argStrings << path.toUtf8();
+
+    foreach ( const QString & arg, _args )
+	argStrings << arg.toUtf8();
+
+    QVector<char *> argv;
+
+    for ( int i = 0; i < argStrings.size(); ++i )
+	argv << argStrings[ i ].data();
+
+    argv << 0;
+
+    int result = posix_spawn( &_pid, argv.first(), &actions, 0, argv.data(), environment() );
+    posix_spawn_file_actions_destroy( &actions );
+
+    closeFd( outPipe[ 1 ] );
+    closeFd( errPipe[ 1 ] );
+
+    if ( result != 0 )
+    {
+	errno = result;
+	logError() << "Could not start " << _command << ": " << formatErrno() << endl;
+
+	_pid = 0;
+	closeFd( outPipe[ 0 ] );
+	closeFd( errPipe[ 0 ] );
+
+	return false;
+    }
+
+    _stdoutFd = outPipe[ 0 ];
+    _stderrFd = errPipe[ 0 ];
+    _timer.start();
+
+    return true;
+}
+
+
+int SpawnedProcess::read( QByteArray & buffer )
+{
+    char chunk[ READ_CHUNK_SIZE ];
+
+    // Keep reading the standard error output, too, so the process never
+    // blocks because that pipe is full.
+
+    while ( _stdoutFd >= 0 || _stderrFd >= 0 )
+    {
+	struct pollfd fds[ 2 ];
+	int count = 0;
+
+	if ( _stdoutFd >= 0 )
+	{
+	    fds[ count ].fd	 = _stdoutFd;
+	    fds[ count ].events	 = POLLIN;
+	    fds[ count ].revents = 0;
+	    ++count;
+	}
+
+	if ( _stderrFd >= 0 )
+	{
+	    fds[ count ].fd	 = _stderrFd;
+	    fds[ count ].events	 = POLLIN;
+	    fds[ count ].revents = 0;
+	    ++count;
+	}
+
+	int result = ::poll( fds, count, remainingMillisec() );
+
+	if ( result < 0 )
+	{
+	    if ( errno == EINTR )
+		continue;
+
+	    logError() << "poll() failed: " << formatErrno() << endl;
+	    return -1;
+	}
+
+	if ( result == 0 )
+	    return -1;	// timeout
+
+	for ( int i = 0; i < count; ++i )
+	{
+	    if ( fds[ i ].revents == 0 )
+		continue;
+
+	    bool    isStdout = fds[ i ].fd == _stdoutFd;
+	    ssize_t got	     = ::read( fds[ i ].fd, chunk, sizeof( chunk ) );
+
+	    if ( got < 0 && errno == EINTR )
+		continue;
+
+	    if ( got <= 0 )	// end of output or error
+	    {
+		closeFd( isStdout ? _stdoutFd : _stderrFd );
+		continue;
+	    }
+
+	    if ( isStdout )
+	    {
+		buffer.append( chunk, got );
+		return got;
+	    }
+
+	    _stderrOutput.append( chunk, got );
+	}
+    }
+
+    return 0;
+}
+
+
+bool SpawnedProcess::waitForExit()
+{
+    while ( _pid > 0 )
+    {
+	int   status = 0;
+	pid_t result = waitpid( _pid, &status, _timeoutSec > 0 ? WNOHANG : 0 );
+
+	if ( result == _pid )
+	{
+	    setExitStatus( status );
+	    _pid = 0;
+	}
+	else if ( result < 0 )
+	{
+	    if ( errno == EINTR )
+		continue;
+
+	    logError() << "waitpid() failed: " << formatErrno() << endl;
+	    _pid = 0;
+
+	    return false;
+	}
+	else if ( remainingMillisec() == 0 )
+	{
+	    return false;
+	}
+	else
+	{
+	    usleep( WAIT_POLL_MICROSEC );
+	}
+    }
+
+    return true;
+}
+
+
+void SpawnedProcess::kill()
+{
+    if ( _pid <= 0 )
+	return;
+
+    ::kill( _pid, SIGKILL );
+
+    int status = 0;
+
+    while ( waitpid( _pid, &status, 0 ) < 0 && errno == EINTR )
+	;
+
+    setExitStatus( status );
+    _pid = 0;
+}
+
+
+void SpawnedProcess::setExitStatus( int status )
+{
+    _exitedNormally = WIFEXITED( status );
+    _exitCode	    = _exitedNormally ? WEXITSTATUS( status ) : -1;
+}
+
+
+int SpawnedProcess::remainingMillisec() const
+{
+    if ( _timeoutSec <= 0 )
+	return -1;
+
+    qint64 remaining = _timeoutSec * 1000LL - _timer.elapsed();
+
+    return (int) qMax( 0LL, remaining );
+}
+
+
+void SpawnedProcess::closeFd( int & fd )
+{
+    if ( fd >= 0 )
+    {
+	::close( fd );
+	fd = -1;
+    }
+}
+
+
+bool SpawnedProcess::needsShell( const QString & commandLine )
+{
+    static const QString metaChars( "|&;<>()$`\\\"'*?[]{}#~!\n" );
+
+    QString trimmed = commandLine.trimmed();
+
+    if ( trimmed.isEmpty() )
+	return true;
+
+    foreach ( const QChar & ch, trimmed )
+    {
+	if ( metaChars.contains( ch ) )
+	    return true;
+    }
+
+    // An assignment like "LANG=C ls" before the command
+
+    return trimmed.section( QRegExp( "\\s+" ), 0, 0 ).contains( '=' );
+}
+
+
+QString SpawnedProcess::findExecutable( const QString & name )
+{
+    if ( name.isEmpty() )
+	return QString();
+
+    if ( name.contains( '/' ) )
+	return access( name.toUtf8(), X_OK ) == 0 ? name : QString();
+
+    QStringList dirs = QString::fromUtf8( qgetenv( "PATH" ) ).split( ':', QString::SkipEmptyParts );
+
+    foreach ( const QString & dir, dirs )
+    {
+	QFileInfo fileInfo( dir + "/" + name );
+
+	if ( fileInfo.isFile() && fileInfo.isExecutable() )
+	    return fileInfo.absoluteFilePath();
+    }
+
+    return QString();
+}
+
+
+char ** SpawnedProcess::environment()
+{
+    QMutexLocker locker( &_envMutex );
+
+    if ( _env.isEmpty() )
+    {
+	for ( char ** var = environ; var && *var; ++var )
+	{
+	    if ( strncmp( *var, "LANG=", 5 ) != 0 )
+		_envStrings << QByteArray( *var );
+	}
+
+	_envStrings << QByteArray( "LANG=C" ); // Prevent output in translated languages
+
+	for ( int i = 0; i < _envStrings.size(); ++i )
+	    _env << _envStrings[ i ].data();
+
+	_env << 0;
+    }
+
+    return _env.data();
+}
+
+
+QProcessEnvironment SpawnedProcess::processEnvironment()
+{
+    QMutexLocker locker( &_envMutex );
+
+    if ( ! _haveProcessEnv )
+    {
+	_processEnv = QProcessEnvironment::systemEnvironment();
+	_processEnv.insert( "LANG", "C" ); // Prevent output in translated languages
+	_haveProcessEnv = true;
+    }
+
+    return _processEnv;
+}
@@ -0,0 +1,193 @@
+/*
+ *   File name: SpawnedProcess.h
+ *   Summary:	Lightweight external processes without QProcess
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SpawnedProcess_h
+#define SpawnedProcess_h
+
+
+#include <sys/types.h>
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVector>
+#include <QProcessEnvironment>
+
+
+namespace QDirStat
+{
+    /**
+     * External process that is started with posix_spawn() and read
+     * synchronously through pipes. This is for the many short-lived
+     * commands like package manager queries: Unlike QProcess, this
+     * doesn't need an event loop or a notifier thread, and it doesn't
+     * copy and convert the whole environment for each process. All
+     * processes get the same environment that is built only once: The
+     * environment of the program with LANG=C, so the output of the
+     * commands is never translated.
+     *
+     * Usage:
+     *
+     *	   SpawnedProcess process( "/usr/bin/rpm", args );
+     *	   process.setTimeout( 15 );
+     *
+     *	   if ( process.start() )
+     *	   {
+     *	       QByteArray output;
+     *
+     *	       while ( process.read( output ) > 0 )
+     *		   ;
+     *
+     *	       process.waitForExit();
+     *	   }
+     **/
+    class SpawnedProcess
+    {
+    public:
+
+	/**
+	 * Constructor. If 'command' does not contain a slash, it is
+	 * searched in $PATH.
+	 **/
+	SpawnedProcess( const QString & command, const QStringList & args );
+
+	/**
+	 * Destructor. This kills the process if it is still running.
+	 **/
+	~SpawnedProcess();
+
+	/**
+	 * Pass the standard error output of the process through the same
+	 * pipe as its standard output, so both are read with read().
+	 * Otherwise, it is collected separately (see stderrOutput()).
+	 * This must be called before start().
+	 **/
+	void setMergeStderr( bool merge ) { _mergeStderr = merge; }
+
+	/**
+	 * Set the time in seconds from start() after which read() and
+	 * waitForExit() give up. 0 means no timeout.
+	 **/
+	void setTimeout( int sec ) { _timeoutSec = sec; }
+
+	/**
+	 * Start the process. Return 'true' on success.
+	 **/
+	bool start();
+
+	/**
+	 * Wait until there is output of the process and append it to
+	 * 'buffer'. Return the number of bytes appended, 0 if the process
+	 * closed its output, or -1 on timeout or error.
+	 **/
+	int read( QByteArray & buffer );
+
+	/**
+	 * Wait until the process exits. Return 'false' on timeout.
+	 **/
+	bool waitForExit();
+
+	/**
+	 * Kill the process and wait until it is gone.
+	 **/
+	void kill();
+
+	/**
+	 * Return 'true' if the process exited normally, i.e. it didn't
+	 * crash and it wasn't killed.
+	 **/
+	bool exitedNormally() const { return _exitedNormally; }
+
+	/**
+	 * Return the exit code of the process or -1 if it didn't exit
+	 * normally.
+	 **/
+	int exitCode() const { return _exitCode; }
+
+	/**
+	 * Return what the process wrote to its standard error output if it
+	 * is not merged with the standard output.
+	 **/
+	const QByteArray & stderrOutput() const { return _stderrOutput; }
+
+	/**
+	 * Return 'true' if 'commandLine' needs a shell, i.e. if it has any
+	 * characters with a special meaning for the shell like quotes,
+	 * variables, wildcards, redirections or several commands. If not,
+	 * splitting it up at whitespace gives the same command and
+	 * arguments as the shell would.
+	 **/
+	static bool needsShell( const QString & commandLine );
+
+	/**
+	 * Return the full path of executable 'name' in $PATH or an empty
+	 * string if there is none. A name with a slash is returned as it is
+	 * if it is executable.
+	 **/
+	static QString findExecutable( const QString & name );
+
+	/**
+	 * Return the same environment as for a SpawnedProcess for anything
+	 * that still needs a QProcess. This is also built only once.
+	 **/
+	static QProcessEnvironment processEnvironment();
+
+
+    protected:
+
+	/**
+	 * Return the remaining time until the timeout in milliseconds for
+	 * poll(): -1 for no timeout, 0 if the time is up.
+	 **/
+	int remainingMillisec() const;
+
+	/**
+	 * Close 'fd' if it is open and set it to -1.
+	 **/
+	static void closeFd( int & fd );
+
+	/**
+	 * Store the status of the process from waitpid().
+	 **/
+	void setExitStatus( int status );
+
+	/**
+	 * Return the environment for posix_spawn(). It is built on the
+	 * first call.
+	 **/
+	static char ** environment();
+
+
+	// Data members
+
+	QString		_command;
+	QStringList	_args;
+	bool		_mergeStderr;
+	int		_timeoutSec;
+	pid_t		_pid;
+	int		_stdoutFd;
+	int		_stderrFd;
+	bool		_exitedNormally;
+	int		_exitCode;
+	QByteArray	_stderrOutput;
+	QElapsedTimer	_timer;
+
+	static QMutex		   _envMutex;
+	static QList<QByteArray>   _envStrings;
+	static QVector<char *>	   _env;
+	static QProcessEnvironment _processEnv;
+	static bool		   _haveProcessEnv;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// SpawnedProcess_h
@@ -0,0 +1,185 @@
+/*
+ *   File name: StallWatchdog.cpp
+ *   Summary:	Watchdog for stalls of the GUI event loop
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QCoreApplication>
+#include <QThread>
+
+#include "StallWatchdog.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+// Default for the "ThresholdMillisec" setting
+#define DEFAULT_STALL_THRESHOLD_MSEC	500
+
+
+using namespace QDirStat;
+
+
+StallWatchdog::StallWatchdog():
+    QObject(),
+    _enabled( true ),
+    _threshold( DEFAULT_STALL_THRESHOLD_MSEC ),
+    _longestOperation( 0 ),
+    _longestMillisec( 0 )
+{
+    readSettings();
+
+    _timer.setInterval( STALL_WATCHDOG_INTERVAL_MSEC );
+    _timer.setTimerType( Qt::PreciseTimer );
+
+    connect( &_timer, SIGNAL( timeout() ),
+	     this,    SLOT  ( tick()	) );
+}
+
+
+StallWatchdog::~StallWatchdog()
+{
+    // NOP
+}
+
+
+StallWatchdog * StallWatchdog::instance()
+{
+    static StallWatchdog * _instance = 0;
+
+    if ( ! _instance )
+    {
+	_instance = new StallWatchdog();
+	CHECK_NEW( _instance );
+    }
+
+    return _instance;
+}
+
+
+void StallWatchdog::start()
+{
+    if ( ! _enabled || _timer.isActive() )
+	return;
+
+    logInfo() << "Watching for event loop stalls over " << _threshold << " ms" << endl;
+
+    _sinceTick.start();
+    _timer.start();
+}
+
+
+void StallWatchdog::clearStalls()
+{
+    _stalls.clear();
+}
+
+
+void StallWatchdog::operationStarted( const char * name )
+{
+    _activeOperations << name;
+}
+
+
+void StallWatchdog::operationFinished( const char * name, qint64 millisec )
+{
+    int index = _activeOperations.lastIndexOf( name );
+
+    if ( index >= 0 )
+	_activeOperations.removeAt( index );
+
+    if ( millisec > _longestMillisec )
+    {
+	_longestOperation = name;
+	_longestMillisec  = millisec;
+    }
+}
+
+
+void StallWatchdog::tick()
+{
+    qint64 latency = _sinceTick.restart() - STALL_WATCHDOG_INTERVAL_MSEC;
+
+    if ( latency >= _threshold )
+    {
+	EventLoopStall stall;
+	stall.time		= QDateTime::currentDateTime();
+	stall.millisec		= latency;
+	stall.operationMillisec = 0;
+
+	if ( _longestOperation )
+	{
+	    stall.operation	    = _longestOperation;
+	    stall.operationMillisec = _longestMillisec;
+	}
+	else if ( ! _activeOperations.isEmpty() )
+	{
+	    // Still running, so this must be a nested event loop
+
+	    stall.operation = _activeOperations.last();
+	}
+
+	logWarning() << "Event loop blocked for " << latency << " ms by "
+		     << ( stall.operation.isEmpty() ? QString( "an unknown operation" ) : stall.operation )
+		     << endl;
+
+	_stalls << stall;
+
+	while ( _stalls.size() > STALL_WATCHDOG_MAX_STALLS )
+	    _stalls.removeFirst();
+
+	emit stallDetected();
+    }
+
+    _longestOperation = 0;
+    _longestMillisec  = 0;
+}
+
+
+void StallWatchdog::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "StallWatchdog" );
+    _enabled   = settings.value( "Enabled",	      true			   ).toBool();
+    _threshold = settings.value( "ThresholdMillisec", DEFAULT_STALL_THRESHOLD_MSEC ).toInt();
+    settings.endGroup();
+}
+
+
+void StallWatchdog::writeSettings()
+{
+    Settings settings;
+    settings.beginGroup( "StallWatchdog" );
+
+    // Only set these if not already in the settings: The user might have
+    // changed them in the config file.
+    settings.setDefaultValue( "Enabled",	   _enabled   );
+    settings.setDefaultValue( "ThresholdMillisec", _threshold );
+
+    settings.endGroup();
+}
+
+
+
+
+StallOperation::StallOperation( const char * name ):
+    _name( name ),
+    _guiThread( QCoreApplication::instance() &&
+		QThread::currentThread() == QCoreApplication::instance()->thread() )
+{
+    if ( _guiThread )
+    {
+	StallWatchdog::instance()->operationStarted( _name );
+	_timer.start();
+    }
+}
+
+
+StallOperation::~StallOperation()
+{
+    if ( _guiThread )
+	StallWatchdog::instance()->operationFinished( _name, _timer.elapsed() );
+}
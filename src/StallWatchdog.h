@@ -0,0 +1,202 @@
+/*
+ *   File name: StallWatchdog.h
+ *   Summary:	Watchdog for stalls of the GUI event loop
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef StallWatchdog_h
+#define StallWatchdog_h
+
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QList>
+
+
+// Interval of the watchdog timer. Anything the timer fires later than this
+// is time the event loop was blocked.
+#define STALL_WATCHDOG_INTERVAL_MSEC	100
+
+// Only this many of the latest stalls are kept
+#define STALL_WATCHDOG_MAX_STALLS	200
+
+
+namespace QDirStat
+{
+    /**
+     * One stall of the event loop.
+     **/
+    struct EventLoopStall
+    {
+	QDateTime time;			// when the event loop ran again
+	int	  millisec;		// how long it was blocked
+	QString	  operation;		// what was (probably) blocking it
+	int	  operationMillisec;	// how long that operation took
+    };
+
+    typedef QList<EventLoopStall> EventLoopStallList;
+
+
+    /**
+     * Watchdog for the latency of the event loop of the GUI thread: A timer
+     * fires every STALL_WATCHDOG_INTERVAL_MSEC, and if it fires more than
+     * the threshold later than that, the event loop was blocked for that
+     * long.
+     *
+     * The expensive high-level operations in the GUI thread (rebuilding
+     * the treemap, sorting, collecting statistics, reading a slice of a
+     * cache file, refreshing after a cleanup) are marked with a
+     * StallOperation on the stack. A stall is attributed to the longest of
+     * those that finished since the last timer tick, or to the innermost
+     * one that is still running if there is a nested event loop.
+     *
+     * A stall can only be detected when the event loop runs again, so it is
+     * logged and stored then. The latest stalls are available in stalls()
+     * for the "Event Loop Stalls" window.
+     *
+     * The threshold is the "ThresholdMillisec" setting in the
+     * "StallWatchdog" group of the config file; the watchdog can be
+     * disabled there with "Enabled".
+     *
+     * This is a singleton class; use instance() to get the instance. It
+     * must be used only in the GUI thread. Remember to call
+     * instance()->writeSettings() in an appropriate destructor.
+     **/
+    class StallWatchdog: public QObject
+    {
+	Q_OBJECT
+
+    protected:
+
+	/**
+	 * Constructor. This is a singleton class; use instance() instead.
+	 **/
+	StallWatchdog();
+
+    public:
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~StallWatchdog();
+
+	/**
+	 * Return the singleton instance of this class. The first call
+	 * creates it; that has to be in the GUI thread.
+	 **/
+	static StallWatchdog * instance();
+
+	/**
+	 * Start watching the event loop unless that is disabled in the
+	 * settings.
+	 **/
+	void start();
+
+	/**
+	 * Return 'true' if the watchdog is running.
+	 **/
+	bool isActive() const { return _timer.isActive(); }
+
+	/**
+	 * Return the threshold in milliseconds above which a late timer
+	 * tick counts as a stall.
+	 **/
+	int threshold() const { return _threshold; }
+
+	/**
+	 * Return the latest stalls, the oldest first.
+	 **/
+	const EventLoopStallList & stalls() const { return _stalls; }
+
+	/**
+	 * Forget all stalls so far.
+	 **/
+	void clearStalls();
+
+	/**
+	 * Notifications from StallOperation.
+	 **/
+	void operationStarted ( const char * name );
+	void operationFinished( const char * name, qint64 millisec );
+
+	/**
+	 * Write the settings.
+	 **/
+	void writeSettings();
+
+
+    signals:
+
+	/**
+	 * Emitted when a stall was detected and added to stalls().
+	 **/
+	void stallDetected();
+
+
+    protected slots:
+
+	/**
+	 * Timer tick: Measure how late this is.
+	 **/
+	void tick();
+
+
+    protected:
+
+	/**
+	 * Read the settings.
+	 **/
+	void readSettings();
+
+
+	//
+	// Data members
+	//
+
+	bool		     _enabled;
+	int		     _threshold;
+	QTimer		     _timer;
+	QElapsedTimer	     _sinceTick;
+	QList<const char *>  _activeOperations;
+	const char *	     _longestOperation;		// since the last tick
+	qint64		     _longestMillisec;
+	EventLoopStallList   _stalls;
+
+    };	// class StallWatchdog
+
+
+
+    /**
+     * Marker for an expensive operation in the GUI thread for the
+     * StallWatchdog. Create one on the stack for the duration of the
+     * operation:
+     *
+     *	   StallOperation operation( "Treemap rebuild" );
+     *
+     * 'name' has to be a string literal; it is stored as a pointer.
+     * Outside the GUI thread, this does nothing.
+     **/
+    class StallOperation
+    {
+    public:
+
+	StallOperation( const char * name );
+
+	~StallOperation();
+
+    protected:
+
+	const char *  _name;
+	bool	      _guiThread;
+	QElapsedTimer _timer;
+    };
+
+}	// namespace QDirStat
+
+
+#endif	// StallWatchdog_h
@@ -0,0 +1,183 @@
+/*
+ *   File name: SubtreeCollector.cpp
+ *   Summary:	Statistics classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <algorithm>
+
+#include "SubtreeCollector.h"
+#include "FileInfoIterator.h"
+#include "FileColumns.h"
+#include "DirInfo.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Minimum number of files in a subtree for each thread
+#define MIN_FILES_PER_THREAD	50000
+
+// Number of subdirectories to split the subtree into for each thread for
+// balancing the load between the threads
+#define ITEMS_PER_THREAD	8
+
+
+using namespace QDirStat;
+
+
+int SubtreeCollector::_maxThreads = 0;
+
+
+namespace
+{
+    /**
+     * Comparison function for sorting items with the most files first.
+     **/
+    bool moreFiles( FileInfo * a, FileInfo * b )
+    {
+	return a->totalFiles() > b->totalFiles();
+    }
+
+}	// namespace
+
+
+int SubtreeCollector::threadCount( FileInfo * subtree )
+{
+    int threads = _maxThreads > 0 ? _maxThreads : QThread::idealThreadCount();
+    threads = qMin( threads, subtree->totalFiles() / MIN_FILES_PER_THREAD );
+
+    return qMax( 1, threads );
+}
+
+
+void SubtreeCollector::collectSubtree( FileInfo * subtree )
+{
+    if ( ! subtree )
+	return;
+
+    if ( subtree->isFile() )
+	collectFile( subtree );
+
+    if ( subtree->hasChildren() && skipSubtree( subtree ) )
+	return;
+
+    int threads = threadCount( subtree );
+
+    if ( threads < 2 )
+    {
+	collectRecursive( subtree );
+	return;
+    }
+
+    // Split the subtree breadth-first until there are enough subdirectories
+    // for the threads. The files of the directories that are split up along
+    // the way are collected right here.
+
+    FileInfoList dirs;
+    dirs << subtree;
+    int next = 0;
+
+    while ( next < dirs.size() && dirs.size() - next < threads * ITEMS_PER_THREAD )
+    {
+	if ( cancelled() )
+	    return;
+
+	FileInfoIterator it( dirs.at( next++ ) );
+
+	while ( *it )
+	{
+	    FileInfo * item = *it;
+
+	    if ( item->hasChildren() )
+	    {
+		if ( ! skipSubtree( item ) )
+		    dirs << item;
+	    }
+	    else if ( item->isFile() )
+		collectFile( item );
+	    else
+		collectOther( item );
+
+	    ++it;
+	}
+    }
+
+    // Start with the largest subdirectories so no thread gets a large one
+    // at the very end when all others are already finished
+
+    FileInfoList items = dirs.mid( next );
+    std::sort( items.begin(), items.end(), moreFiles );
+
+    threads = qMin( threads, items.size() );
+    QAtomicInt nextItem( 0 );
+    QList<SubtreeCollectorThread *> workers;
+
+    for ( int i=0; i < threads; ++i )
+    {
+	SubtreeCollectorThread * worker = new SubtreeCollectorThread( createPartial(), items, &nextItem );
+	CHECK_NEW( worker );
+
+	workers << worker;
+	worker->start();
+    }
+
+    foreach ( SubtreeCollectorThread * worker, workers )
+    {
+	worker->wait();
+	merge( worker->partial() );
+	delete worker->partial();
+    }
+
+    qDeleteAll( workers );
+
+    logDebug() << "Collected " << subtree->totalFiles() << " files in "
+	       << workers.size() << " threads" << endl;
+}
+
+
+void SubtreeCollector::collectRecursive( FileInfo * dir )
+{
+    if ( cancelled() )
+	return;
+
+    if ( dir->isDirNode() )
+    {
+	const FileColumns * columns = dir->nodeDirInfo()->fileColumns();
+
+	if ( columns && columns->allFiles() && collectFileColumns( *columns ) )
+	    return;
+    }
+
+    FileInfoIterator it( dir );
+
+    while ( *it )
+    {
+	FileInfo * item = *it;
+
+	if ( item->nodeHasChildren() )
+	{
+	    if ( ! skipSubtree( item ) )
+		collectRecursive( item );
+	}
+	else if ( item->isFile() )
+	    collectFile( item );
+	else
+	    collectOther( item );	// symlinks, block devices etc.
+
+	++it;
+    }
+}
+
+
+void SubtreeCollectorThread::run()
+{
+    int index;
+
+    while ( ! _partial->cancelled() &&
+	    ( index = _nextItem->fetchAndAddOrdered( 1 ) ) < _items.size() )
+    {
+	_partial->collectRecursive( _items.at( index ) );
+    }
+}
@@ -0,0 +1,199 @@
+/*
+ *   File name: SubtreeCollector.h
+ *   Summary:	Statistics classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SubtreeCollector_h
+#define SubtreeCollector_h
+
+#include <QThread>
+#include <QAtomicInt>
+
+#include "FileInfo.h"
+
+
+namespace QDirStat
+{
+    class FileColumns;
+
+
+    /**
+     * Abstract base class for statistics that are collected from all the
+     * files in a subtree, optionally in several threads in parallel:
+     *
+     * The subtree is split into its subdirectories (as far down as needed
+     * to get enough of them), and each thread collects the files of one of
+     * those subdirectories after another into its own partial result from
+     * createPartial(). Finally, all partial results are merged into this
+     * object with merge().
+     *
+     * The tree must not change while collecting; the calling thread waits
+     * for the other threads.
+     **/
+    class SubtreeCollector
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	SubtreeCollector() {}
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~SubtreeCollector() {}
+
+	/**
+	 * Call collectFile() for each file in 'subtree', including 'subtree'
+	 * itself if it is a file. Use several threads if the subtree is large
+	 * enough for that to pay off.
+	 **/
+	void collectSubtree( FileInfo * subtree );
+
+	/**
+	 * Return the maximum number of threads for collectSubtree().
+	 * 0 (the default) means one for each CPU core.
+	 **/
+	static int maxThreads() { return _maxThreads; }
+
+	/**
+	 * Set the maximum number of threads for collectSubtree().
+	 * 0 means one for each CPU core, 1 means no threads.
+	 **/
+	static void setMaxThreads( int maxThreads ) { _maxThreads = maxThreads; }
+
+
+    protected:
+
+	/**
+	 * Create a new empty collector of the same kind for the partial
+	 * results of one thread. The caller takes over ownership.
+	 *
+	 * Derived classes are required to implement this.
+	 **/
+	virtual SubtreeCollector * createPartial() const = 0;
+
+	/**
+	 * Collect the data of one file. This is called in a separate thread
+	 * for partial collectors from createPartial(), so this must not
+	 * access anything but the file and this object.
+	 *
+	 * Derived classes are required to implement this.
+	 **/
+	virtual void collectFile( FileInfo * file ) = 0;
+
+	/**
+	 * Collect the data of one item that is neither a file nor a directory
+	 * with children, e.g. a symlink or a device. The same restrictions as
+	 * for collectFile() apply.
+	 *
+	 * This default implementation does nothing.
+	 **/
+	virtual void collectOther( FileInfo * /* item */ ) {}
+
+	/**
+	 * Collect the data of all files of a directory at once from its file
+	 * columns (see DirInfo::fileColumns()); all of them are regular
+	 * files. Return 'false' if that is not possible, then collectFile()
+	 * is called for each of them. The same restrictions as for
+	 * collectFile() apply.
+	 *
+	 * This default implementation returns 'false'.
+	 **/
+	virtual bool collectFileColumns( const FileColumns & /* columns */ ) { return false; }
+
+	/**
+	 * Return 'true' if collecting should stop as soon as possible. This
+	 * is checked for each directory in each thread.
+	 *
+	 * This default implementation returns 'false'.
+	 **/
+	virtual bool cancelled() const { return false; }
+
+	/**
+	 * Return 'true' if nothing in the subtree of directory 'dir' can be
+	 * of interest, e.g. because its total size is already too small for
+	 * any file in it to be large enough, so it is not collected at all.
+	 * This is checked for each directory in each thread, so the same
+	 * restrictions as for collectFile() apply.
+	 *
+	 * This default implementation returns 'false'.
+	 **/
+	virtual bool skipSubtree( FileInfo * /* dir */ ) { return false; }
+
+	/**
+	 * Merge the results of 'partial' which was created with
+	 * createPartial() into this object.
+	 *
+	 * Derived classes are required to implement this.
+	 **/
+	virtual void merge( SubtreeCollector * partial ) = 0;
+
+	/**
+	 * Call collectFile() for all files below 'dir' (and collectOther()
+	 * for all other items without children) in this thread.
+	 *
+	 * Derived classes can reimplement this with a loop of their own that
+	 * doesn't need a virtual call for each item (see InlineCollector).
+	 **/
+	virtual void collectRecursive( FileInfo * dir );
+
+	/**
+	 * Return the number of threads to use for 'subtree'.
+	 **/
+	static int threadCount( FileInfo * subtree );
+
+	static int _maxThreads;
+
+	friend class SubtreeCollectorThread;
+
+    };	// class SubtreeCollector
+
+
+    /**
+     * Thread for collecting some of the subdirectories of a subtree for
+     * SubtreeCollector::collectSubtree().
+     **/
+    class SubtreeCollectorThread: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor. The thread collects the items from 'items' with the
+	 * next index from 'nextItem' until there are no more left.
+	 **/
+	SubtreeCollectorThread( SubtreeCollector   * partial,
+				const FileInfoList & items,
+				QAtomicInt	   * nextItem ):
+	    QThread(),
+	    _partial( partial ),
+	    _items( items ),
+	    _nextItem( nextItem )
+	    {}
+
+	/**
+	 * Return the partial collector of this thread.
+	 **/
+	SubtreeCollector * partial() const { return _partial; }
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	SubtreeCollector *   _partial;
+	const FileInfoList & _items;
+	QAtomicInt	   * _nextItem;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef SubtreeCollector_h
@@ -0,0 +1,132 @@
+/*
+ *   File name: SubtreeFinalizer.cpp
+ *   Summary:	Finalizing large directory trees with several threads
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QVector>
+
+#include "SubtreeFinalizer.h"
+#include "DirInfo.h"
+#include "NodeAllocator.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Number of subtrees to split the tree into for each thread for balancing
+// the load between the threads
+#define ITEMS_PER_THREAD	8
+
+
+using namespace QDirStat;
+
+
+bool SubtreeFinalizer::finalize( DirInfo * subtree )
+{
+    if ( ! subtree )
+	return false;
+
+    int threads = QThread::idealThreadCount();
+
+    if ( threads < 2 )
+	return subtree->finalizeSubtree();
+
+    // Split the tree breadth-first until there are enough subtrees for the
+    // threads. If that already reaches the bottom of the tree, it is too
+    // small for threads to pay off.
+
+    QList<DirInfo *> dirs;
+    dirs << subtree;
+    int next = 0;
+
+    while ( next < dirs.size() && dirs.size() - next < threads * ITEMS_PER_THREAD )
+    {
+	DirInfo * dir = dirs.at( next++ );
+
+	for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+	{
+	    if ( child->isDirInfo() && ! child->isDotEntry() )
+		dirs << child->toDirInfo();
+	}
+    }
+
+    if ( next >= dirs.size() )
+	return subtree->finalizeSubtree();
+
+    QList<DirInfo *> items = dirs.mid( next );
+    threads = qMin( threads, items.size() );
+
+    // Nothing the threads do may reach the tree or the split directories
+
+    subtree->dropSortCache( true );
+
+    for ( int i=0; i < next; ++i )
+    {
+	dirs.at( i )->dropFileAgeSummaries();
+	dirs.at( i )->dropOwnerSummaries();
+    }
+
+    QVector<bool> ignoredChanged( items.size(), false );
+    QAtomicInt nextItem( 0 );
+    QList<SubtreeFinalizerThread *> workers;
+
+    for ( int i=0; i < threads; ++i )
+    {
+	SubtreeFinalizerThread * worker =
+	    new SubtreeFinalizerThread( items, &nextItem, ignoredChanged.data() );
+	CHECK_NEW( worker );
+
+	workers << worker;
+	NodeAllocator::addConcurrentUser();	// for deleting dot entries and attics
+	worker->start();
+    }
+
+    foreach ( SubtreeFinalizerThread * worker, workers )
+    {
+	worker->wait();
+	NodeAllocator::removeConcurrentUser();
+    }
+
+    qDeleteAll( workers );
+
+    for ( int i=0; i < items.size(); ++i )
+    {
+	// Ignored items are sorted last
+
+	if ( ignoredChanged.at( i ) )
+	{
+	    items.at( i )->parent()->dropSortCache();
+	    items.at( i )->parent()->dropLargestChildren();
+	}
+    }
+
+    // The split directories bottom-up: All children of a directory are
+    // after it in breadth-first order
+
+    for ( int i = next - 1; i > 0; --i )
+    {
+	DirInfo * dir = dirs.at( i );
+
+	if ( dir->finalizeContents() )
+	{
+	    dir->parent()->dropSortCache();
+	    dir->parent()->dropLargestChildren();
+	}
+    }
+
+    logDebug() << "Finalized " << items.size() << " subtrees of " << subtree
+	       << " in " << workers.size() << " threads" << endl;
+
+    return subtree->finalizeContents();
+}
+
+
+void SubtreeFinalizerThread::run()
+{
+    int index;
+
+    while ( ( index = _nextItem->fetchAndAddOrdered( 1 ) ) < _items.size() )
+	_ignoredChanged[ index ] = _items.at( index )->finalizeSubtree();
+}
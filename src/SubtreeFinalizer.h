@@ -0,0 +1,95 @@
+/*
+ *   File name: SubtreeFinalizer.h
+ *   Summary:	Finalizing large directory trees with several threads
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SubtreeFinalizer_h
+#define SubtreeFinalizer_h
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QList>
+
+
+namespace QDirStat
+{
+    class DirInfo;
+
+
+    /**
+     * Finalizing a tree after reading a cache file (cleaning up dot entries
+     * and attics, checking the 'ignored' status and calculating the summary
+     * fields of each directory) only touches each directory and its direct
+     * children, so disjoint subtrees can be finalized in parallel:
+     *
+     * The tree is split breadth-first into enough subdirectories for the
+     * threads; each thread finalizes one of those subtrees after another
+     * bottom-up, and finally the directories above them that were split up
+     * are finalized in this thread, again bottom-up.
+     *
+     * Whatever a thread would do outside of its own subtree is done here
+     * before or after: The sort caches of the whole tree and the file age
+     * and owner summaries of the split directories are dropped before the
+     * threads start, and the sort caches of the parents of the subtrees
+     * whose 'ignored' status changed are dropped after they are finished.
+     **/
+    class SubtreeFinalizer
+    {
+    public:
+
+	/**
+	 * Finalize all directories in 'subtree' bottom-up, but do not
+	 * cascade the 'ignored' status to its parent. Use several threads if
+	 * the tree is large enough. Return 'true' if the 'ignored' status of
+	 * 'subtree' itself changed.
+	 *
+	 * This is to be called in the GUI thread which waits for the other
+	 * threads.
+	 **/
+	static bool finalize( DirInfo * subtree );
+    };
+
+
+    /**
+     * Thread for finalizing some of the subtrees for
+     * SubtreeFinalizer::finalize().
+     **/
+    class SubtreeFinalizerThread: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor. The thread finalizes the subtrees from 'items' with
+	 * the next index from 'nextItem' until there are no more left and
+	 * stores in 'ignoredChanged' which ones changed their 'ignored'
+	 * status.
+	 **/
+	SubtreeFinalizerThread( const QList<DirInfo *> & items,
+				QAtomicInt	       * nextItem,
+				bool		       * ignoredChanged ):
+	    QThread(),
+	    _items( items ),
+	    _nextItem( nextItem ),
+	    _ignoredChanged( ignoredChanged )
+	    {}
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	const QList<DirInfo *> & _items;
+	QAtomicInt	       * _nextItem;
+	bool		       * _ignoredChanged;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef SubtreeFinalizer_h
@@ -0,0 +1,109 @@
+/*
+ *   File name: SuffixTrie.cpp
+ *   Summary:	Reverse trie for fast filename suffix lookup
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "SuffixTrie.h"
+
+
+using namespace QDirStat;
+
+
+SuffixTrie::SuffixTrie()
+{
+    clear();
+}
+
+
+void SuffixTrie::clear()
+{
+    Node root;
+    root.category = 0;
+
+    _nodes.clear();
+    _nodes << root;
+}
+
+
+int SuffixTrie::child( int node, ushort ch ) const
+{
+    const QVector<Edge> & edges = _nodes.at( node ).edges;
+
+    // Binary search; most nodes only have very few children
+
+    int low  = 0;
+    int high = edges.size();
+
+    while ( low < high )
+    {
+	int mid = ( low + high ) / 2;
+
+	if ( edges.at( mid ).ch < ch )
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+
+    if ( low < edges.size() && edges.at( low ).ch == ch )
+	return edges.at( low ).node;
+
+    return -1;
+}
+
+
+bool SuffixTrie::add( const QString & suffix, MimeCategory * category )
+{
+    if ( suffix.isEmpty() )
+	return false;
+
+    int node = root();
+
+    for ( int i = suffix.size() - 1; i >= 0; --i )
+    {
+	ushort ch   = suffix.at( i ).unicode();
+	int    next = child( node, ch );
+
+	if ( next < 0 )
+	{
+	    Node newNode;
+	    newNode.category = 0;
+	    _nodes << newNode;
+	    next = _nodes.size() - 1;
+
+	    QVector<Edge> & edges = _nodes[ node ].edges;
+	    int pos = 0;
+
+	    while ( pos < edges.size() && edges.at( pos ).ch < ch )
+		++pos;
+
+	    Edge edge;
+	    edge.ch   = ch;
+	    edge.node = next;
+	    edges.insert( pos, edge );
+	}
+
+	node = next;
+    }
+
+    if ( _nodes.at( node ).category )
+	return false;
+
+    _nodes[ node ].category = category;
+
+    return true;
+}
+
+
+MimeCategory * SuffixTrie::value( const QString & suffix ) const
+{
+    int node = root();
+
+    for ( int i = suffix.size() - 1; i >= 0 && node >= 0; --i )
+	node = child( node, suffix.at( i ).unicode() );
+
+    return node > 0 ? category( node ) : 0;
+}
@@ -0,0 +1,105 @@
+/*
+ *   File name: SuffixTrie.h
+ *   Summary:	Reverse trie for fast filename suffix lookup
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SuffixTrie_h
+#define SuffixTrie_h
+
+
+#include <QString>
+#include <QVector>
+
+
+namespace QDirStat
+{
+    class MimeCategory;
+
+
+    /**
+     * Trie of filename suffixes that stores each suffix backwards, i.e.
+     * starting with its last character. This way, a filename can be
+     * looked up from its end with one character at a time, and each '.'
+     * on the way marks a complete suffix that might be in the trie. That
+     * finds all matching suffixes of a name ("tar.bz2" and "bz2" for
+     * "foo.tar.bz2") in one pass without creating any substrings.
+     *
+     * Lookup works on nodes: Start with root() and go to the child for
+     * each character with child() until it returns -1.
+     **/
+    class SuffixTrie
+    {
+    public:
+
+	/**
+	 * Constructor. This creates an empty trie.
+	 **/
+	SuffixTrie();
+
+	/**
+	 * Remove all suffixes.
+	 **/
+	void clear();
+
+	/**
+	 * Add 'suffix' (without the leading '.') with 'category'. If it is
+	 * already there, keep the old category and return 'false'.
+	 **/
+	bool add( const QString & suffix, MimeCategory * category );
+
+	/**
+	 * Return the category of 'suffix' or 0 if it is not in the trie.
+	 **/
+	MimeCategory * value( const QString & suffix ) const;
+
+	/**
+	 * Return 'true' if there are no suffixes in the trie.
+	 **/
+	bool isEmpty() const { return _nodes.size() < 2; }
+
+	/**
+	 * Return the root node.
+	 **/
+	static int root() { return 0; }
+
+	/**
+	 * Return the child of 'node' for 'ch' or -1 if there is none.
+	 **/
+	int child( int node, ushort ch ) const;
+
+	/**
+	 * Return the category of the suffix that ends in 'node' or 0 if no
+	 * suffix ends there.
+	 **/
+	MimeCategory * category( int node ) const
+	    { return _nodes.at( node ).category; }
+
+
+    protected:
+
+	struct Edge
+	{
+	    ushort ch;
+	    int	   node;
+	};
+
+	struct Node
+	{
+	    MimeCategory * category;
+	    QVector<Edge>  edges;	// sorted by 'ch'
+	};
+
+	// Data members
+
+	QVector<Node> _nodes;
+
+    };	// class SuffixTrie
+
+}	// namespace QDirStat
+
+
+#endif // ifndef SuffixTrie_h
@@ -14,9 +14,19 @@
 #include <limits.h>     // PATH_MAX
 #include <sys/stat.h>   // lstat()
 #include <sys/types.h>
+#include <sys/sysmacros.h>  // major(), minor()
+#include <sys/syscall.h>    // SYS_ioprio_set
+#include <string.h>	// memchr()
+#include <sched.h>	// sched_setaffinity(), sched_getcpu()
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDir>
+#include <QMap>
 
 #include "SysUtil.h"
 #include "Process.h"
+#include "SpawnedProcess.h"
 #include "DirSaver.h"
 #include "Logger.h"
 #include "Exception.h"
@@ -90,25 +100,32 @@ QString SysUtil::runCommand( const QString &	 command,
 	return "ERROR: Command not found";
     }
 
-    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-    env.insert( "LANG", "C" ); // Prevent output in translated languages
-
-    Process process;
-    process.setProgram( command );
-    process.setArguments( args );
-    process.setProcessEnvironment( env );
-    process.setProcessChannelMode( QProcess::MergedChannels ); // combine stdout and stderr
+    SpawnedProcess process( command, args );
+    process.setMergeStderr( true ); // combine stdout and stderr
+    process.setTimeout( timeout_sec );
 
     if ( logCommand )
 	logDebug() << command << " " << args.join( " " ) << endl;
 
-    process.start();
-    bool success = process.waitForFinished( timeout_sec * 1000 );
-    QString output = QString::fromUtf8( process.readAll() );
+    if ( ! process.start() )
+	return "ERROR: Could not start command";
+
+    QByteArray rawOutput;
+    int got;
+
+    while ( ( got = process.read( rawOutput ) ) > 0 )
+	;
+
+    bool success = got == 0 && process.waitForExit();
+
+    if ( ! success )
+	process.kill();
+
+    QString output = QString::fromUtf8( rawOutput );
 
     if ( success )
     {
-	if ( process.exitStatus() == QProcess::NormalExit )
+	if ( process.exitedNormally() )
 	{
 	    if ( exitCode_ret )
 		*exitCode_ret = process.exitCode();
@@ -147,6 +164,86 @@ QString SysUtil::runCommand( const QString &	 command,
 }
 
 
+bool SysUtil::runCommandLines( const QString &	 command,
+			       const QStringList & args,
+			       OutputLineHandler * handler,
+			       int *		   exitCode_ret,
+			       int		   timeout_sec,
+			       bool		   logCommand )
+{
+    CHECK_PTR( handler );
+
+    if ( exitCode_ret )
+	*exitCode_ret = -1;
+
+    if ( ! haveCommand( command ) )
+    {
+	logInfo() << "Command not found: " << command << endl;
+	return false;
+    }
+
+    SpawnedProcess process( command, args );
+    process.setTimeout( timeout_sec );
+
+    if ( logCommand )
+	logDebug() << command << " " << args.join( " " ) << endl;
+
+    if ( ! process.start() )
+	return false;
+
+    QByteArray buffer; // Only the incomplete last line remains between reads
+    int got;
+
+    while ( ( got = process.read( buffer ) ) > 0 )
+    {
+	const char * data = buffer.constData();
+	const char * end  = data + buffer.size();
+	const char * pos  = data;
+	const char * eol;
+
+	while ( ( eol = (const char *) memchr( pos, '\n', end - pos ) ) != 0 )
+	{
+	    handler->handleLine( pos, eol - pos );
+	    pos = eol + 1;
+	}
+
+	buffer.remove( 0, pos - data );
+    }
+
+    if ( ! buffer.isEmpty() ) // Last line without a newline
+	handler->handleLine( buffer.constData(), buffer.size() );
+
+    if ( got < 0 || ! process.waitForExit() )
+    {
+	logError() << "Timeout: \"" << command << "\" args: " << args << endl;
+	process.kill();
+	return false;
+    }
+
+    if ( ! process.exitedNormally() )
+    {
+	logError() << "Command crashed: \"" << command << "\" args: " << args << endl;
+	return false;
+    }
+
+    if ( exitCode_ret )
+	*exitCode_ret = process.exitCode();
+
+    if ( process.exitCode() != 0 )
+    {
+	logError() << "Command exited with exit code "
+		   << process.exitCode() << ": "
+		   << command << "\" args: " << args
+		   << endl;
+	logDebug() << "Error output: \n" << QString::fromUtf8( process.stderrOutput() ) << endl;
+
+	return false;
+    }
+
+    return true;
+}
+
+
 void SysUtil::openInBrowser( const QString & url )
 {
     logDebug() << "Opening URL " << url << endl;
@@ -274,3 +371,183 @@ QByteArray SysUtil::readLink( const QByteArray & path )
 
     return targetBuf;
 }
+
+
+bool SysUtil::isOnRotationalDisk( const QString & path )
+{
+    struct stat statInfo;
+
+    if ( stat( path.toUtf8(), &statInfo ) != 0 )
+	return false;
+
+    QString sysDir = QString( "/sys/dev/block/%1:%2/" )
+	.arg( major( statInfo.st_dev ) )
+	.arg( minor( statInfo.st_dev ) );
+
+    // A partition has no queue of its own; it uses the one of its disk
+
+    QFile file( sysDir + "queue/rotational" );
+
+    if ( ! file.exists() )
+	file.setFileName( sysDir + "../queue/rotational" );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+	return false;
+
+    return file.readAll().trimmed() == "1";
+}
+
+
+bool SysUtil::setIdleIoPriority( bool idle )
+{
+#if defined( __linux__ ) && defined( SYS_ioprio_set )
+
+    // From linux/ioprio.h which is not in every distro's kernel headers
+
+    const int ioprioWhoProcess = 1;
+    const int ioprioClassNone  = 0;	// derived from the nice value
+    const int ioprioClassIdle  = 3;
+    const int ioprioClassShift = 13;
+
+    int ioprioClass = idle ? ioprioClassIdle : ioprioClassNone;
+
+    // For IOPRIO_WHO_PROCESS, 0 means the calling thread
+
+    if ( syscall( SYS_ioprio_set, ioprioWhoProcess, 0,
+		  ioprioClass << ioprioClassShift ) == 0 )
+    {
+	return true;
+    }
+
+    logWarning() << "ioprio_set() failed: " << formatErrno() << endl;
+    return false;
+
+#else
+
+    Q_UNUSED( idle );
+    return false;
+
+#endif
+}
+
+
+QList<QList<int> > SysUtil::numaNodeCpus()
+{
+    QMap<int, QList<int> > nodes;
+    QDir sysDir( "/sys/devices/system/node" );
+
+    foreach ( const QString & entry, sysDir.entryList( QStringList() << "node*", QDir::Dirs ) )
+    {
+	bool ok = false;
+	int nodeNo = entry.mid( 4 ).toInt( &ok );
+
+	if ( ! ok )
+	    continue;
+
+	QFile file( sysDir.filePath( entry + "/cpulist" ) );
+
+	if ( ! file.open( QIODevice::ReadOnly ) )
+	    continue;
+
+	// Something like "0-7,16-23"
+
+	QList<int> cpus;
+	QString cpuList = QString::fromLatin1( file.readAll().trimmed() );
+
+	foreach ( const QString & range, cpuList.split( ',', QString::SkipEmptyParts ) )
+	{
+	    int first = range.section( '-', 0, 0 ).toInt();
+	    int last  = range.contains( '-' ) ? range.section( '-', 1, 1 ).toInt() : first;
+
+	    for ( int cpu = first; cpu <= last; ++cpu )
+		cpus << cpu;
+	}
+
+	if ( ! cpus.isEmpty() )	// memory-only nodes have no CPUs
+	    nodes.insert( nodeNo, cpus );
+    }
+
+    return nodes.values();
+}
+
+
+QList<int> SysUtil::threadCpus()
+{
+    QList<int> cpus;
+
+#ifdef __linux__
+
+    cpu_set_t cpuSet;
+    CPU_ZERO( &cpuSet );
+
+    if ( sched_getaffinity( 0, sizeof( cpuSet ), &cpuSet ) != 0 )
+    {
+	logWarning() << "sched_getaffinity() failed: " << formatErrno() << endl;
+	return cpus;
+    }
+
+    for ( int cpu = 0; cpu < CPU_SETSIZE; ++cpu )
+    {
+	if ( CPU_ISSET( cpu, &cpuSet ) )
+	    cpus << cpu;
+    }
+
+#endif
+
+    return cpus;
+}
+
+
+bool SysUtil::setThreadCpus( const QList<int> & cpus )
+{
+#ifdef __linux__
+
+    if ( cpus.isEmpty() )
+	return false;
+
+    cpu_set_t cpuSet;
+    CPU_ZERO( &cpuSet );
+
+    foreach ( int cpu, cpus )
+    {
+	if ( cpu >= 0 && cpu < CPU_SETSIZE )
+	    CPU_SET( cpu, &cpuSet );
+    }
+
+    // For sched_setaffinity(), 0 means the calling thread
+
+    if ( sched_setaffinity( 0, sizeof( cpuSet ), &cpuSet ) == 0 )
+	return true;
+
+    logWarning() << "sched_setaffinity() failed: " << formatErrno() << endl;
+    return false;
+
+#else
+
+    Q_UNUSED( cpus );
+    return false;
+
+#endif
+}
+
+
+int SysUtil::currentNumaNode( const QList<QList<int> > & nodeCpus )
+{
+#ifdef __linux__
+
+    int cpu = sched_getcpu();
+
+    for ( int i = 0; i < nodeCpus.size(); ++i )
+    {
+	if ( nodeCpus.at( i ).contains( cpu ) )
+	    return i;
+    }
+
+#else
+
+    Q_UNUSED( nodeCpus );
+
+#endif
+
+    return -1;
+}
@@ -14,6 +14,7 @@
 
 #include <QString>
 #include <QRegExp>
+#include <QList>
 
 
 // Override these before #include
@@ -107,6 +108,40 @@ namespace QDirStat
 			    bool		logOutput     = LOG_OUTPUT,
 			    bool		ignoreErrCode = false );
 
+	/**
+	 * Receiver for the output of runCommandLines(), one line at a time.
+	 **/
+	class OutputLineHandler
+	{
+	public:
+
+	    virtual ~OutputLineHandler() {}
+
+	    /**
+	     * Handle one line of output of 'len' bytes without the newline.
+	     * 'line' points into the read buffer; it is only valid during
+	     * this call.
+	     **/
+	    virtual void handleLine( const char * line, int len ) = 0;
+	};
+
+	/**
+	 * Run a command with arguments 'args' and pass each line of its
+	 * standard output to 'handler' as soon as it arrives, so very long
+	 * outputs are never kept in memory as a whole. Return 'true' if the
+	 * command exited normally with exit code 0, 'false' if not. If
+	 * exitCode_ret is non-null, return the command's exit code there.
+	 *
+	 * Unlike runCommand(), this does not merge the standard error
+	 * output into the output; it is only logged in case of an error.
+	 **/
+	bool runCommandLines( const QString &	  command,
+			      const QStringList & args,
+			      OutputLineHandler * handler,
+			      int *		  exitCode_ret = 0,
+			      int		  timeout_sec  = COMMAND_TIMEOUT_SEC,
+			      bool		  logCommand   = LOG_COMMANDS );
+
 	/**
 	 * Return 'true' if the specified command is available and executable.
 	 **/
@@ -177,6 +212,57 @@ namespace QDirStat
          **/
         QByteArray readLink( const QByteArray & path );
 
+	/**
+	 * Return 'true' if 'path' is on a rotational disk (a hard disk as
+	 * opposed to an SSD) according to
+	 * /sys/dev/block/<major>:<minor>/queue/rotational.
+	 *
+	 * Return 'false' if that can't be determined, e.g. for network
+	 * filesystems, device mapper or non-Linux systems.
+	 **/
+	bool isOnRotationalDisk( const QString & path );
+
+	/**
+	 * Switch the calling thread to the "idle" I/O scheduling class (like
+	 * "ionice -c 3"): It only gets disk time when no other process needs
+	 * the disk. Threads that this thread starts afterwards inherit that.
+	 * With 'idle' set to 'false', switch it back to the default class.
+	 *
+	 * Return 'true' on success, 'false' if that is not supported.
+	 **/
+	bool setIdleIoPriority( bool idle = true );
+
+	/**
+	 * Return the CPUs of each NUMA node (a socket with its own memory)
+	 * according to /sys/devices/system/node/node<n>/cpulist, in the
+	 * order of the node numbers.
+	 *
+	 * Return an empty list if that can't be determined, e.g. on non-Linux
+	 * systems; a machine without NUMA has one node.
+	 **/
+	QList<QList<int> > numaNodeCpus();
+
+	/**
+	 * Return the CPUs the calling thread may run on or an empty list if
+	 * that can't be determined.
+	 **/
+	QList<int> threadCpus();
+
+	/**
+	 * Restrict the calling thread to 'cpus'. Threads that this thread
+	 * starts afterwards inherit that.
+	 *
+	 * Return 'true' on success, 'false' if that is not supported.
+	 **/
+	bool setThreadCpus( const QList<int> & cpus );
+
+	/**
+	 * Return the index in 'nodeCpus' (see numaNodeCpus()) of the node
+	 * that the calling thread is currently running on or -1 if that
+	 * can't be determined.
+	 **/
+	int currentNumaNode( const QList<QList<int> > & nodeCpus );
+
     }	// namespace SysUtil
 }	// namespace QDirStat
 
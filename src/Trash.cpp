@@ -8,6 +8,7 @@
 
 
 #include <errno.h>
+#include <fcntl.h>
 #include <QDir>
 #include <QDateTime>
 #include <QFile>
@@ -223,7 +224,9 @@ void Trash::empty()
 
 TrashDir::TrashDir( const QString & path, dev_t device ):
     _path( path ),
-    _device( device )
+    _device( device ),
+    _filesDirFd( -1 ),
+    _infoDirFd( -1 )
 {
     // logDebug() << "Created TrashDir " << path << endl;
 
@@ -233,6 +236,16 @@ TrashDir::TrashDir( const QString & path, dev_t device ):
 }
 
 
+TrashDir::~TrashDir()
+{
+    if ( _filesDirFd >= 0 )
+	close( _filesDirFd );
+
+    if ( _infoDirFd >= 0 )
+	close( _infoDirFd );
+}
+
+
 QString TrashDir::uniqueName( const QString & path )
 {
     QFileInfo file( path );
@@ -301,6 +314,89 @@ void TrashDir::createTrashInfo( const QString & path,
 }
 
 
+QString TrashDir::reserveTrashInfo( const QString &	 path,
+				    const QByteArray & deletionDate )
+{
+    if ( _filesDirFd < 0 )
+	_filesDirFd = open( filesPath().toUtf8(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+    if ( _infoDirFd < 0 )
+	_infoDirFd = open( infoPath().toUtf8(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+    if ( _filesDirFd < 0 || _infoDirFd < 0 )
+	return QString();
+
+    QFileInfo file( path );
+    QString baseName  = file.baseName();
+    QString extension = file.completeSuffix();
+
+    // Continue with the last suffix used for this name: Trashing many items
+    // with the same name would otherwise check all the previous ones again
+    // for each one.
+
+    int count = _nameCounts.value( file.fileName(), 0 );
+
+    while ( true )
+    {
+	QString name = count == 0 ? baseName : QString( "%1_%2" ).arg( baseName ).arg( count );
+
+	if ( ! extension.isEmpty() )
+	    name += "." + extension;
+
+	++count;
+	struct stat statInfo;
+
+	if ( fstatat( _filesDirFd, name.toUtf8(), &statInfo, AT_SYMLINK_NOFOLLOW ) == 0 )
+	    continue;
+
+	// Unlike uniqueName(), skip stale .trashinfo files, too: Creating the
+	// file exclusively is what reserves the name.
+
+	int fd = openat( _infoDirFd, ( name + ".trashinfo" ).toUtf8(),
+			 O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600 );
+
+	if ( fd < 0 )
+	{
+	    if ( errno == EEXIST )
+		continue;
+
+	    return QString();
+	}
+
+	_nameCounts.insert( file.fileName(), count );
+
+	QByteArray content = "[Trash Info]\nPath=" + path.toUtf8() +
+	    "\nDeletionDate=" + deletionDate + "\n";
+
+	bool success = write( fd, content.constData(), content.size() ) == content.size();
+	int  err     = errno;
+	close( fd );
+
+	if ( ! success )
+	{
+	    removeTrashInfo( name );
+	    errno = err;
+
+	    return QString();
+	}
+
+	return name;
+    }
+}
+
+
+bool TrashDir::renameInto( const QString & path, const QString & targetName )
+{
+    return renameat( AT_FDCWD, path.toUtf8(), _filesDirFd, targetName.toUtf8() ) == 0;
+}
+
+
+void TrashDir::removeTrashInfo( const QString & targetName )
+{
+    unlinkat( _infoDirFd, ( targetName + ".trashinfo" ).toUtf8(), 0 );
+}
+
+
 void TrashDir::move( const QString & path,
 		     const QString & targetName )
 {
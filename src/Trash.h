@@ -15,6 +15,7 @@
 #include <unistd.h>
 #include <QObject>
 #include <QMap>
+#include <QHash>
 
 class TrashDir;
 typedef QMap<dev_t, TrashDir *> TrashDirMap;
@@ -44,6 +45,8 @@ public:
      **/
     static bool trash( const QString & path );
 
+    // For moving many items to the trash at once, use a TrashJob.
+
     /**
      * Restore a file or directory from the trash to its original location.
      * Return 'true' on success, 'false' on error.
@@ -73,6 +76,11 @@ public:
      **/
     static dev_t device( const QString & path );
 
+    /**
+     * Return the trash dir for 'path'.
+     **/
+    TrashDir * trashDir( const QString & path );
+
 
 protected:
     /**
@@ -92,11 +100,6 @@ protected:
      **/
     static QString toplevel( const QString & path );
 
-    /**
-     * Return the trash dir for 'path'.
-     **/
-    TrashDir * trashDir( const QString & path );
-
 
     //
     // Data members
@@ -135,6 +138,11 @@ public:
      **/
     TrashDir( const QString & _path, dev_t device );
 
+    /**
+     * Destructor. This closes the directory file descriptors.
+     **/
+    virtual ~TrashDir();
+
     /**
      * Return the full path for this trash directory.
      **/
@@ -179,6 +187,29 @@ public:
      **/
     void move( const QString & path, const QString & targetName );
 
+    /**
+     * Find a unique name for 'path' in this trash dir and reserve it by
+     * exclusively creating its .trashinfo file with 'deletionDate' (in ISO
+     * format). Return the name or an empty string and set 'errno' on error.
+     *
+     * This uses the file descriptors of the "files" and "info"
+     * subdirectories that are kept open, so it is much cheaper than
+     * uniqueName() and createTrashInfo() for many items.
+     **/
+    QString reserveTrashInfo( const QString & path, const QByteArray & deletionDate );
+
+    /**
+     * Move 'path' to 'targetName' in the "files" subdirectory with
+     * renameat(). This fails with 'errno' EXDEV if both are on different
+     * filesystems. Return 'true' on success, 'false' on error.
+     **/
+    bool renameInto( const QString & path, const QString & targetName );
+
+    /**
+     * Remove the .trashinfo file for 'targetName' again.
+     **/
+    void removeTrashInfo( const QString & targetName );
+
 
 protected:
 
@@ -196,8 +227,11 @@ protected:
     // Data members
     //
 
-    QString _path;
-    dev_t   _device;
+    QString		_path;
+    dev_t		_device;
+    int			_filesDirFd;	// -1 until first needed
+    int			_infoDirFd;
+    QHash<QString, int> _nameCounts;	// Last suffix used for each name
 };
 
 
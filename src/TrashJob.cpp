@@ -0,0 +1,353 @@
+/*
+ *   File name: TrashJob.cpp
+ *   Summary:	Move many files and directories to the trash at once
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <QDir>
+#include <QDateTime>
+#include <QMap>
+
+#include "TrashJob.h"
+#include "Trash.h"
+#include "OutputWindow.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+#define COPY_BUFFER_SIZE	( 64 * 1024 )
+
+
+TrashCopyWorker::TrashCopyWorker( const QList<TrashCopyTask> & tasks ):
+    QThread(),
+    _tasks( tasks ),
+    _copied( 0 )
+{
+    // NOP
+}
+
+
+void TrashCopyWorker::run()
+{
+    foreach ( const TrashCopyTask & task, _tasks )
+    {
+	if ( ! copyRecursive( task.path, task.targetPath ) )
+	{
+	    // Leave the original alone and don't leave a partial copy behind
+
+	    removeRecursive( task.targetPath );
+	    unlink( task.trashInfoPath.toUtf8() );
+	    continue;
+	}
+
+	if ( removeRecursive( task.path ) )
+	    ++_copied;
+    }
+}
+
+
+bool TrashCopyWorker::copyRecursive( const QString & path, const QString & targetPath )
+{
+    QByteArray rawPath	     = path.toUtf8();
+    QByteArray rawTargetPath = targetPath.toUtf8();
+    struct stat statInfo;
+
+    if ( lstat( rawPath, &statInfo ) != 0 )
+    {
+	reportError( tr( "Cannot move %1 to trash" ), path );
+	return false;
+    }
+
+    if ( S_ISDIR( statInfo.st_mode ) )
+    {
+	if ( mkdir( rawTargetPath, 0700 ) != 0 )
+	{
+	    reportError( tr( "Cannot create %1" ), targetPath );
+	    return false;
+	}
+
+	QDir dir( path );
+	QStringList entries = dir.entryList( QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot );
+
+	foreach ( const QString & entry, entries )
+	{
+	    if ( ! copyRecursive( path + "/" + entry, targetPath + "/" + entry ) )
+		return false;
+	}
+
+	// Only now that all entries are there, the directory may be read-only
+	chmod( rawTargetPath, statInfo.st_mode & 07777 );
+
+	return true;
+    }
+
+    if ( S_ISLNK( statInfo.st_mode ) )
+    {
+	QByteArray linkTarget( statInfo.st_size + 1, '\0' );
+	ssize_t len = readlink( rawPath, linkTarget.data(), linkTarget.size() );
+
+	if ( len < 0 || symlink( linkTarget.left( len ), rawTargetPath ) != 0 )
+	{
+	    reportError( tr( "Cannot copy symlink %1" ), path );
+	    return false;
+	}
+
+	return true;
+    }
+
+    if ( S_ISREG( statInfo.st_mode ) )
+	return copyFile( path, targetPath, statInfo.st_mode & 07777 );
+
+    emit error( tr( "Cannot move %1 to trash on another filesystem: Not a regular file" ).arg( path ) );
+
+    return false;
+}
+
+
+bool TrashCopyWorker::copyFile( const QString & path, const QString & targetPath, mode_t mode )
+{
+    int fd = open( path.toUtf8(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC );
+
+    if ( fd < 0 )
+    {
+	reportError( tr( "Cannot open %1" ), path );
+	return false;
+    }
+
+    int targetFd = open( targetPath.toUtf8(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode );
+
+    if ( targetFd < 0 )
+    {
+	reportError( tr( "Cannot create %1" ), targetPath );
+	close( fd );
+	return false;
+    }
+
+    QByteArray buffer( COPY_BUFFER_SIZE, '\0' );
+    bool success = true;
+    ssize_t len;
+
+    while ( success && ( len = read( fd, buffer.data(), buffer.size() ) ) != 0 )
+    {
+	if ( len < 0 )
+	{
+	    if ( errno == EINTR )
+		continue;
+
+	    reportError( tr( "Cannot read %1" ), path );
+	    success = false;
+	}
+	else if ( write( targetFd, buffer.constData(), len ) != len )
+	{
+	    reportError( tr( "Cannot write %1" ), targetPath );
+	    success = false;
+	}
+    }
+
+    close( fd );
+
+    if ( close( targetFd ) != 0 && success )
+    {
+	reportError( tr( "Cannot write %1" ), targetPath );
+	success = false;
+    }
+
+    return success;
+}
+
+
+bool TrashCopyWorker::removeRecursive( const QString & path )
+{
+    QByteArray rawPath = path.toUtf8();
+    struct stat statInfo;
+
+    if ( lstat( rawPath, &statInfo ) != 0 )
+	return errno == ENOENT;
+
+    if ( S_ISDIR( statInfo.st_mode ) )
+    {
+	QDir dir( path );
+	QStringList entries = dir.entryList( QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot );
+	bool success = true;
+
+	foreach ( const QString & entry, entries )
+	{
+	    if ( ! removeRecursive( path + "/" + entry ) )
+		success = false;
+	}
+
+	if ( success && rmdir( rawPath ) != 0 )
+	{
+	    reportError( tr( "Cannot delete %1" ), path );
+	    success = false;
+	}
+
+	return success;
+    }
+
+    if ( unlink( rawPath ) != 0 )
+    {
+	reportError( tr( "Cannot delete %1" ), path );
+	return false;
+    }
+
+    return true;
+}
+
+
+void TrashCopyWorker::reportError( const QString & what, const QString & path )
+{
+    emit error( what.arg( path ) + ": " + formatErrno() );
+}
+
+
+
+
+TrashJob::TrashJob( const QStringList & paths,
+		    OutputWindow *	outputWindow,
+		    QObject *		parent ):
+    QObject( parent ),
+    _paths( paths ),
+    _outputWindow( outputWindow ),
+    _worker( 0 ),
+    _moved( 0 )
+{
+    // NOP
+}
+
+
+TrashJob::~TrashJob()
+{
+    if ( _worker )
+    {
+	_worker->wait();
+	delete _worker;
+    }
+}
+
+
+void TrashJob::start()
+{
+    logInfo() << "Moving " << _paths.size() << " items to trash" << endl;
+
+    // The same deletion date for all items: It is only needed with a
+    // precision of seconds anyway.
+
+    QByteArray deletionDate = QDateTime::currentDateTime().toString( Qt::ISODate ).toUtf8();
+    QMap<TrashDir *, QStringList> groups;
+
+    try
+    {
+	foreach ( const QString & path, _paths )
+	{
+	    TrashDir * trashDir = Trash::instance()->trashDir( path );
+
+	    if ( trashDir )
+		groups[ trashDir ] << path;
+	    else if ( _outputWindow )
+		_outputWindow->addStderr( tr( "Move to trash failed for %1" ).arg( path ) );
+	}
+    }
+    catch ( const FileException & ex )
+    {
+	CAUGHT( ex );
+
+	if ( _outputWindow )
+	    _outputWindow->addStderr( tr( "Move to trash failed: %1" ).arg( ex.what() ) );
+
+	groups.clear();
+    }
+
+    for ( QMap<TrashDir *, QStringList>::const_iterator it = groups.constBegin();
+	  it != groups.constEnd();
+	  ++it )
+    {
+	TrashDir * trashDir = it.key();
+
+	foreach ( const QString & path, it.value() )
+	{
+	    QString targetName = trashDir->reserveTrashInfo( path, deletionDate );
+
+	    if ( targetName.isEmpty() )
+	    {
+		if ( _outputWindow )
+		    _outputWindow->addStderr( tr( "Move to trash failed for %1: %2" ).arg( path ).arg( formatErrno() ) );
+
+		continue;
+	    }
+
+	    if ( trashDir->renameInto( path, targetName ) )
+	    {
+		++_moved;
+	    }
+	    else if ( errno == EXDEV )
+	    {
+		_copyTasks << TrashCopyTask( path,
+					     trashDir->filesPath() + "/" + targetName,
+					     trashDir->infoPath()  + "/" + targetName + ".trashinfo" );
+	    }
+	    else
+	    {
+		QString msg = tr( "Move to trash failed for %1: %2" ).arg( path ).arg( formatErrno() );
+		trashDir->removeTrashInfo( targetName );
+
+		if ( _outputWindow )
+		    _outputWindow->addStderr( msg );
+	    }
+	}
+    }
+
+    if ( _copyTasks.isEmpty() )
+    {
+	copyFinished();
+	return;
+    }
+
+    logInfo() << "Copying " << _copyTasks.size() << " items to trash on another filesystem" << endl;
+
+    if ( _outputWindow )
+    {
+	_outputWindow->addStdout( tr( "Copying %1 items to trash on another filesystem..." )
+				  .arg( _copyTasks.size() ) );
+    }
+
+    _worker = new TrashCopyWorker( _copyTasks );
+    CHECK_NEW( _worker );
+
+    if ( _outputWindow )
+    {
+	connect( _worker,	SIGNAL( error	 ( QString ) ),
+		 _outputWindow, SLOT  ( addStderr( QString ) ) );
+    }
+
+    connect( _worker, SIGNAL( finished()     ),
+	     this,    SLOT  ( copyFinished() ) );
+
+    _worker->start();
+}
+
+
+void TrashJob::copyFinished()
+{
+    if ( _worker )
+	_moved += _worker->copied();
+
+    logInfo() << "Moved " << _moved << " of " << _paths.size() << " items to trash" << endl;
+
+    if ( _outputWindow )
+    {
+	_outputWindow->addStdout( tr( "Moved %1 items to trash." ).arg( _moved ) );
+	_outputWindow->noMoreProcesses();
+    }
+
+    deleteLater();
+}
@@ -0,0 +1,169 @@
+/*
+ *   File name: TrashJob.h
+ *   Summary:	Move many files and directories to the trash at once
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TrashJob_h
+#define TrashJob_h
+
+
+#include <sys/types.h>
+#include <QObject>
+#include <QThread>
+#include <QPointer>
+#include <QList>
+#include <QStringList>
+
+
+class OutputWindow;
+
+
+/**
+ * One item that could not simply be renamed into its trash dir because
+ * that is on another filesystem: It has to be copied, then deleted.
+ **/
+struct TrashCopyTask
+{
+    TrashCopyTask( const QString & path,
+		   const QString & targetPath,
+		   const QString & trashInfoPath ):
+	path( path ),
+	targetPath( targetPath ),
+	trashInfoPath( trashInfoPath )
+	{}
+
+    QString path;
+    QString targetPath;
+    QString trashInfoPath;
+};
+
+
+/**
+ * Worker thread of a TrashJob: Copy items to their trash dir on another
+ * filesystem and delete the originals.
+ **/
+class TrashCopyWorker: public QThread
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Constructor.
+     **/
+    TrashCopyWorker( const QList<TrashCopyTask> & tasks );
+
+    /**
+     * Return the number of items that were moved to the trash. Use this
+     * only when this thread is finished.
+     **/
+    int copied() const { return _copied; }
+
+signals:
+
+    /**
+     * Emitted (from this thread) for error messages.
+     **/
+    void error( const QString & msg );
+
+protected:
+
+    /**
+     * Copy all items. This is called in the new thread.
+     *
+     * Reimplemented from QThread.
+     **/
+    virtual void run() Q_DECL_OVERRIDE;
+
+    /**
+     * Copy the file, directory or symlink 'path' with all its contents to
+     * 'targetPath'. Return 'true' on success, 'false' on error.
+     **/
+    bool copyRecursive( const QString & path, const QString & targetPath );
+
+    /**
+     * Copy the contents of the regular file 'path' to the new file
+     * 'targetPath' with permissions 'mode'.
+     **/
+    bool copyFile( const QString & path, const QString & targetPath, mode_t mode );
+
+    /**
+     * Delete 'path' with all its contents. Return 'true' on success, 'false'
+     * on error.
+     **/
+    bool removeRecursive( const QString & path );
+
+    /**
+     * Report an error for 'path' with the current 'errno'.
+     **/
+    void reportError( const QString & what, const QString & path );
+
+
+    QList<TrashCopyTask> _tasks;
+    int			 _copied;
+};
+
+
+/**
+ * Move a number of files and directories to the trash.
+ *
+ * Unlike calling Trash::trash() for each of them, this groups the items by
+ * their trash dir, keeps the trash dirs' "files" and "info" directories
+ * open and reserves each name in the trash dir by creating its .trashinfo
+ * file right away; then it moves the item there with renameat(). All this
+ * is done immediately in start().
+ *
+ * Only items that are on another filesystem than their trash dir are
+ * copied and then deleted, and that is done in a separate thread.
+ *
+ * Progress and errors are reported to an OutputWindow. When everything is
+ * done, OutputWindow::noMoreProcesses() is called, and this object deletes
+ * itself.
+ **/
+class TrashJob: public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Constructor. Call start() to move the items to the trash.
+     **/
+    TrashJob( const QStringList & paths,
+	      OutputWindow *	  outputWindow,
+	      QObject *		  parent = 0 );
+
+    /**
+     * Destructor. This waits for the copying thread.
+     **/
+    virtual ~TrashJob();
+
+    /**
+     * Move all items to the trash.
+     **/
+    void start();
+
+
+protected slots:
+
+    /**
+     * Notification that the copying thread is finished.
+     **/
+    void copyFinished();
+
+
+protected:
+
+    QStringList		   _paths;
+    QPointer<OutputWindow> _outputWindow;
+    QList<TrashCopyTask>   _copyTasks;
+    TrashCopyWorker *	   _worker;
+    int			   _moved;
+};
+
+
+#endif	// TrashJob_h
@@ -0,0 +1,295 @@
+/*
+ *   File name: TreeDiff.cpp
+ *   Summary:	Differences between two directory trees
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <algorithm>
+
+#include "TreeDiff.h"
+#include "DirTree.h"
+#include "DirTreeCache.h"
+#include "DirInfo.h"
+#include "DotEntry.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Minimum number of items in the new tree for each thread
+#define MIN_ITEMS_PER_THREAD	50000
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Comparison function for sorting items by name.
+     **/
+    bool lessName( FileInfo * a, FileInfo * b )
+    {
+	return a->name() < b->name();
+    }
+
+
+    /**
+     * Comparison function for sorting directory pairs with the most items
+     * first.
+     **/
+    bool moreItems( const QPair<FileInfo *, FileInfo *> & a,
+		    const QPair<FileInfo *, FileInfo *> & b )
+    {
+	return a.second->totalItems() > b.second->totalItems();
+    }
+
+}	// namespace
+
+
+TreeDiff::TreeDiff():
+    _prunedCount( 0 )
+{
+    // NOP
+}
+
+
+void TreeDiff::clear()
+{
+    _items.clear();
+    _prunedCount = 0;
+}
+
+
+void TreeDiff::compare( FileInfo * oldTree, FileInfo * newTree )
+{
+    clear();
+
+    if ( ! oldTree || ! newTree )
+	return;
+
+    _oldTreeUrl = oldTree->url();
+    _newTreeUrl = newTree->url();
+
+    // Calculate all dirty summaries now: The threads only read them.
+
+    oldTree->totalSize();
+    newTree->totalSize();
+
+    // The children of the toplevel directories are compared right here;
+    // the subdirectory pairs that are different are split up among the
+    // threads.
+
+    TreeDiffPairs pairs;
+    compareChildren( oldTree, newTree, &pairs );
+
+    int threads = qMin( QThread::idealThreadCount(),
+			newTree->totalItems() / MIN_ITEMS_PER_THREAD );
+    threads = qMin( threads, pairs.size() );
+
+    if ( threads < 2 )
+    {
+	for ( int i = 0; i < pairs.size(); ++i )
+	    compareChildren( pairs.at( i ).first, pairs.at( i ).second );
+    }
+    else
+    {
+	// Start with the largest subdirectories so no thread gets a large
+	// one at the very end when all others are already finished
+
+	std::sort( pairs.begin(), pairs.end(), moreItems );
+
+	QAtomicInt nextPair( 0 );
+	QList<TreeDiffThread *> workers;
+
+	for ( int i=0; i < threads; ++i )
+	{
+	    TreeDiff * partial = new TreeDiff();
+	    CHECK_NEW( partial );
+
+	    partial->_oldTreeUrl = _oldTreeUrl;
+	    partial->_newTreeUrl = _newTreeUrl;
+
+	    TreeDiffThread * worker = new TreeDiffThread( partial, pairs, &nextPair );
+	    CHECK_NEW( worker );
+
+	    workers << worker;
+	    worker->start();
+	}
+
+	foreach ( TreeDiffThread * worker, workers )
+	{
+	    worker->wait();
+	    _items	 += worker->partial()->_items;
+	    _prunedCount += worker->partial()->_prunedCount;
+	    delete worker->partial();
+	}
+
+	qDeleteAll( workers );
+    }
+
+    logInfo() << "Compared " << _oldTreeUrl << " with " << _newTreeUrl
+	      << " in " << qMax( threads, 1 ) << " threads: "
+	      << _items.size() << " differences, "
+	      << _prunedCount << " identical items skipped" << endl;
+}
+
+
+void TreeDiff::compareChildren( FileInfo      * oldDir,
+				FileInfo      * newDir,
+				TreeDiffPairs * split )
+{
+    FileInfoList oldChildren = sortedChildren( oldDir );
+    FileInfoList newChildren = sortedChildren( newDir );
+
+    int oldPos = 0;
+    int newPos = 0;
+
+    while ( oldPos < oldChildren.size() || newPos < newChildren.size() )
+    {
+	FileInfo * oldItem = oldPos < oldChildren.size() ? oldChildren.at( oldPos ) : 0;
+	FileInfo * newItem = newPos < newChildren.size() ? newChildren.at( newPos ) : 0;
+
+	int cmp;
+
+	if ( ! oldItem )
+	    cmp = 1;
+	else if ( ! newItem )
+	    cmp = -1;
+	else
+	    cmp = oldItem->name().compare( newItem->name() );
+
+	if ( cmp < 0 )
+	{
+	    addItem( TreeDiffRemoved, oldItem, 0 );
+	    ++oldPos;
+	}
+	else if ( cmp > 0 )
+	{
+	    addItem( TreeDiffAdded, 0, newItem );
+	    ++newPos;
+	}
+	else
+	{
+	    compareItems( oldItem, newItem, split );
+	    ++oldPos;
+	    ++newPos;
+	}
+    }
+}
+
+
+void TreeDiff::compareItems( FileInfo	   * oldItem,
+			     FileInfo	   * newItem,
+			     TreeDiffPairs * split )
+{
+    if ( oldItem->isDirInfo() != newItem->isDirInfo() )
+    {
+	// A file that became a directory or vice versa
+
+	addItem( TreeDiffRemoved, oldItem, 0 );
+	addItem( TreeDiffAdded, 0, newItem );
+	return;
+    }
+
+    if ( identical( oldItem, newItem ) )
+    {
+	++_prunedCount;
+	return;
+    }
+
+    if ( oldItem->totalSize() != newItem->totalSize() )
+	addItem( TreeDiffChanged, oldItem, newItem );
+
+    if ( newItem->isDirInfo() )
+    {
+	if ( split )
+	    *split << qMakePair( oldItem, newItem );
+	else
+	    compareChildren( oldItem, newItem );
+    }
+}
+
+
+void TreeDiff::addItem( TreeDiffChange change,
+			FileInfo *     oldItem,
+			FileInfo *     newItem )
+{
+    TreeDiffItem item;
+    item.change	 = change;
+    item.oldSize = oldItem ? oldItem->totalSize() : 0;
+    item.newSize = newItem ? newItem->totalSize() : 0;
+
+    if ( newItem )
+    {
+	item.url   = newItem->url();
+	item.isDir = newItem->isDirInfo();
+    }
+    else
+    {
+	item.url   = _newTreeUrl + oldItem->url().mid( _oldTreeUrl.size() );
+	item.isDir = oldItem->isDirInfo();
+    }
+
+    _items << item;
+}
+
+
+FileInfoList TreeDiff::sortedChildren( FileInfo * dir )
+{
+    FileInfoList children;
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+	children << child;
+
+    if ( dir->dotEntry() )
+    {
+	for ( FileInfo * child = dir->dotEntry()->firstChild(); child; child = child->next() )
+	    children << child;
+    }
+
+    std::sort( children.begin(), children.end(), lessName );
+
+    return children;
+}
+
+
+bool TreeDiff::identical( FileInfo * oldItem, FileInfo * newItem )
+{
+    if ( oldItem->totalSize() != newItem->totalSize() )
+	return false;
+
+    if ( ! newItem->isDirInfo() )
+	return true;	// Only size changes are of interest for files
+
+    return oldItem->totalItems()  == newItem->totalItems() &&
+	   oldItem->latestMtime() == newItem->latestMtime();
+}
+
+
+bool TreeDiff::readCacheFile( const QString & cacheFileName, DirTree * tree )
+{
+    CacheReader reader( cacheFileName, tree );
+
+    if ( ! reader.ok() )
+    {
+	logError() << "Can't read cache file " << cacheFileName << endl;
+	return false;
+    }
+
+    reader.read();	// The entire file
+
+    return reader.ok() && tree->firstToplevel();
+}
+
+
+
+
+void TreeDiffThread::run()
+{
+    int index;
+
+    while ( ( index = _nextPair->fetchAndAddOrdered( 1 ) ) < _pairs.size() )
+	_partial->compareChildren( _pairs.at( index ).first, _pairs.at( index ).second );
+}
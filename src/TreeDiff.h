@@ -0,0 +1,206 @@
+/*
+ *   File name: TreeDiff.h
+ *   Summary:	Differences between two directory trees
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TreeDiff_h
+#define TreeDiff_h
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QVector>
+#include <QPair>
+
+#include "FileInfo.h"
+
+
+namespace QDirStat
+{
+    class DirTree;
+
+    /**
+     * Kind of change of one item between two trees
+     **/
+    enum TreeDiffChange
+    {
+	TreeDiffAdded,		// only in the new tree
+	TreeDiffRemoved,	// only in the old tree
+	TreeDiffChanged		// in both trees with a different size
+    };
+
+
+    /**
+     * One item that is different between two trees. This does not keep
+     * any pointers to the trees, so it can be kept after they are gone.
+     **/
+    struct TreeDiffItem
+    {
+	QString		url;	// in the new tree (also for removed items)
+	TreeDiffChange	change;
+	bool		isDir;
+	FileSize	oldSize;
+	FileSize	newSize;
+
+	FileSize delta() const { return newSize - oldSize; }
+    };
+
+    typedef QVector<TreeDiffItem> TreeDiffList;
+    typedef QList<QPair<FileInfo *, FileInfo *> > TreeDiffPairs;
+
+
+    /**
+     * Comparison of two directory trees, e.g. last night's cache file and
+     * tonight's scan: Which files and subtrees were added, which were
+     * removed, and which changed their size.
+     *
+     * The children of each pair of directories are sorted by name and
+     * walked simultaneously. A subtree whose total size, number of items
+     * and latest modification time are the same in both trees is
+     * considered identical and not compared any further; with typical
+     * nightly changes, this skips almost all of the tree.
+     *
+     * Each changed directory is reported along with the changed items in
+     * it, so sorting the result by delta shows the subtrees that grew the
+     * most first.
+     *
+     * The subdirectories of the toplevel directories are compared in
+     * several threads in parallel. Neither tree must change while
+     * comparing; the calling thread waits for the other threads.
+     **/
+    class TreeDiff
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	TreeDiff();
+
+	/**
+	 * Compare the subtree 'oldTree' with 'newTree'. Their names don't
+	 * matter, only those of their descendants. All URLs in the result
+	 * are in 'newTree'.
+	 **/
+	void compare( FileInfo * oldTree, FileInfo * newTree );
+
+	/**
+	 * Return the differences found by compare().
+	 **/
+	const TreeDiffList & items() const { return _items; }
+
+	/**
+	 * Return the number of subtrees (and files) that were identical in
+	 * both trees and thus skipped.
+	 **/
+	int prunedCount() const { return _prunedCount; }
+
+	/**
+	 * Clear the results.
+	 **/
+	void clear();
+
+	/**
+	 * Read the cache file 'cacheFileName' completely into the empty
+	 * tree 'tree' in this thread, e.g. for comparing it with a tree
+	 * that is being displayed. Return 'true' on success, 'false' on
+	 * error.
+	 **/
+	static bool readCacheFile( const QString & cacheFileName, DirTree * tree );
+
+
+    protected:
+
+	/**
+	 * Compare the children of 'oldDir' with those of 'newDir'. If
+	 * 'split' is non-null, matching subdirectories that are different
+	 * are added to it rather than compared right away.
+	 **/
+	void compareChildren( FileInfo	    * oldDir,
+			      FileInfo	    * newDir,
+			      TreeDiffPairs * split = 0 );
+
+	/**
+	 * Compare 'oldItem' and 'newItem' which have the same name.
+	 **/
+	void compareItems( FileInfo	 * oldItem,
+			   FileInfo	 * newItem,
+			   TreeDiffPairs * split );
+
+	/**
+	 * Add a difference to the results.
+	 **/
+	void addItem( TreeDiffChange change,
+		      FileInfo *     oldItem,
+		      FileInfo *     newItem );
+
+	/**
+	 * Return the children of 'dir' sorted by name. The children of the
+	 * dot entry are treated like direct children since cache files
+	 * don't say which directories have a dot entry.
+	 **/
+	static FileInfoList sortedChildren( FileInfo * dir );
+
+	/**
+	 * Return 'true' if 'oldItem' and 'newItem' can be considered
+	 * identical without comparing their children.
+	 **/
+	static bool identical( FileInfo * oldItem, FileInfo * newItem );
+
+
+	TreeDiffList	_items;
+	int		_prunedCount;
+	QString		_oldTreeUrl;
+	QString		_newTreeUrl;
+
+	friend class TreeDiffThread;
+
+    };	// class TreeDiff
+
+
+    /**
+     * Thread for comparing some of the subdirectory pairs for
+     * TreeDiff::compare().
+     **/
+    class TreeDiffThread: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor. The thread compares the pairs from 'pairs' with the
+	 * next index from 'nextPair' until there are no more left and adds
+	 * the results to 'partial'.
+	 **/
+	TreeDiffThread( TreeDiff	    * partial,
+			const TreeDiffPairs & pairs,
+			QAtomicInt	    * nextPair ):
+	    QThread(),
+	    _partial( partial ),
+	    _pairs( pairs ),
+	    _nextPair( nextPair )
+	    {}
+
+	/**
+	 * Return the partial result of this thread.
+	 **/
+	TreeDiff * partial() const { return _partial; }
+
+    protected:
+
+	/**
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	TreeDiff *	      _partial;
+	const TreeDiffPairs & _pairs;
+	QAtomicInt	    * _nextPair;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef TreeDiff_h
@@ -0,0 +1,219 @@
+/*
+ *   File name: TreeDiffWindow.cpp
+ *   Summary:	QDirStat "changes since cache file" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QFileInfo>
+
+#include "TreeDiffWindow.h"
+#include "DirTree.h"
+#include "QDirStatApp.h"	// SelectionModel
+#include "SelectionModel.h"
+#include "SettingsHelpers.h"
+#include "HeaderTweaker.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+using namespace QDirStat;
+
+
+TreeDiffWindow::TreeDiffWindow( QWidget * parent ):
+    QDialog( parent ),
+    _ui( new Ui::TreeDiffWindow )
+{
+    // logDebug() << "init" << endl;
+
+    CHECK_NEW( _ui );
+    _ui->setupUi( this );
+    initWidgets();
+    readWindowSettings( this, "TreeDiffWindow" );
+
+    connect( _ui->refreshButton, SIGNAL( clicked() ),
+	     this,		 SLOT  ( refresh() ) );
+
+    connect( _ui->treeWidget,	 SIGNAL( currentItemChanged( QTreeWidgetItem *,
+							     QTreeWidgetItem * ) ),
+	     this,		 SLOT  ( selectResult	   ( QTreeWidgetItem * ) ) );
+}
+
+
+TreeDiffWindow::~TreeDiffWindow()
+{
+    // logDebug() << "destroying" << endl;
+
+    writeWindowSettings( this, "TreeDiffWindow" );
+    delete _ui;
+}
+
+
+void TreeDiffWindow::clear()
+{
+    _ui->treeWidget->clear();
+    _ui->totalLabel->clear();
+}
+
+
+void TreeDiffWindow::refresh()
+{
+    populate( _cacheFileName, _subtree() );
+}
+
+
+void TreeDiffWindow::initWidgets()
+{
+    QFont font = _ui->heading->font();
+    font.setBold( true );
+    _ui->heading->setFont( font );
+
+    QStringList headerLabels;
+    headerLabels << tr( "Path"	   )
+		 << tr( "Change"   )
+		 << tr( "Old Size" )
+		 << tr( "New Size" )
+		 << tr( "Delta"	   );
+
+    _ui->treeWidget->setColumnCount( headerLabels.size() );
+    _ui->treeWidget->setHeaderLabels( headerLabels );
+    _ui->treeWidget->setRootIsDecorated( false );
+    _ui->treeWidget->setSortingEnabled( true );
+    _ui->treeWidget->sortByColumn( TD_DeltaCol, Qt::DescendingOrder );
+    _ui->treeWidget->header()->setStretchLastSection( false );
+    HeaderTweaker::resizeToContents( _ui->treeWidget->header() );
+
+    QTreeWidgetItem * headerItem = _ui->treeWidget->headerItem();
+
+    for ( int col = TD_ChangeCol; col <= TD_DeltaCol; ++col )
+	headerItem->setTextAlignment( col, Qt::AlignHCenter );
+}
+
+
+void TreeDiffWindow::reject()
+{
+    deleteLater();
+}
+
+
+void TreeDiffWindow::populate( const QString & cacheFileName, FileInfo * newSubtree )
+{
+    clear();
+    _cacheFileName = cacheFileName;
+    _subtree	   = newSubtree;
+
+    FileInfo * subtree = _subtree();
+
+    if ( ! subtree || _cacheFileName.isEmpty() )
+	return;
+
+    setCursor( Qt::BusyCursor );
+
+    DirTree oldTree;
+
+    if ( ! TreeDiff::readCacheFile( _cacheFileName, &oldTree ) )
+    {
+	_ui->totalLabel->setText( tr( "Can't read %1" ).arg( _cacheFileName ) );
+	unsetCursor();
+	return;
+    }
+
+    FileInfo * oldSubtree = oldTree.firstToplevel();
+
+    // Compare with the same directory if the cache file is only for a part
+    // of this tree
+
+    if ( oldSubtree->url() != subtree->url() )
+    {
+	FileInfo * sameDir = _subtree.tree()->locate( oldSubtree->url() );
+
+	if ( sameDir && sameDir->isDirInfo() )
+	{
+	    _subtree = sameDir;
+	    subtree  = sameDir;
+	}
+    }
+
+    _ui->heading->setText( tr( "Changes in %1 since %2" )
+			   .arg( subtree->url() )
+			   .arg( QFileInfo( _cacheFileName ).fileName() ) );
+
+    TreeDiff diff;
+    diff.compare( oldSubtree, subtree );
+
+    foreach ( const TreeDiffItem & item, diff.items() )
+	new TreeDiffListItem( item, _ui->treeWidget );
+
+    _ui->totalLabel->setText( tr( "%1 changes  Total: %2" )
+			      .arg( diff.items().size() )
+			      .arg( formatSizeDelta( subtree->totalSize() - oldSubtree->totalSize() ) ) );
+    unsetCursor();
+}
+
+
+void TreeDiffWindow::selectResult( QTreeWidgetItem * item )
+{
+    TreeDiffListItem * diffItem = dynamic_cast<TreeDiffListItem *>( item );
+
+    if ( ! diffItem || ! _subtree.tree() || diffItem->diff().change == TreeDiffRemoved )
+	return;
+
+    FileInfo * file = _subtree.tree()->locate( diffItem->diff().url );
+
+    if ( file )
+	app()->selectionModel()->setCurrentItem( file,
+						 true ); // select
+}
+
+
+
+
+TreeDiffListItem::TreeDiffListItem( const TreeDiffItem & diff,
+				    QTreeWidget	       * parent ):
+    QTreeWidgetItem( parent ),
+    _diff( diff )
+{
+    QString blanks = QString( 3, ' ' ); // Enforce left margin
+    QString change;
+
+    switch ( diff.change )
+    {
+	case TreeDiffAdded:	change = QObject::tr( "added"	); break;
+	case TreeDiffRemoved:	change = QObject::tr( "removed" ); break;
+	case TreeDiffChanged:
+	    change = diff.delta() > 0 ? QObject::tr( "grown" ) : QObject::tr( "shrunk" );
+	    break;
+    }
+
+    QString path = diff.url;
+
+    if ( diff.isDir )
+	path += "/";
+
+    setText( TD_PathCol,    path + "    " );
+    setText( TD_ChangeCol,  blanks + change );
+    setText( TD_OldSizeCol, diff.change == TreeDiffAdded   ? QString() : blanks + formatSize( diff.oldSize ) );
+    setText( TD_NewSizeCol, diff.change == TreeDiffRemoved ? QString() : blanks + formatSize( diff.newSize ) );
+    setText( TD_DeltaCol,   blanks + formatSizeDelta( diff.delta() ) );
+
+    for ( int col = TD_OldSizeCol; col <= TD_DeltaCol; ++col )
+	setTextAlignment( col, Qt::AlignRight );
+}
+
+
+bool TreeDiffListItem::operator<( const QTreeWidgetItem & rawOther ) const
+{
+    const TreeDiffListItem & other = dynamic_cast<const TreeDiffListItem &>( rawOther );
+
+    int col = treeWidget() ? treeWidget()->sortColumn() : TD_PathCol;
+
+    switch ( col )
+    {
+	case TD_OldSizeCol:	return diff().oldSize	< other.diff().oldSize;
+	case TD_NewSizeCol:	return diff().newSize	< other.diff().newSize;
+	case TD_DeltaCol:	return diff().delta()	< other.diff().delta();
+	default:		return QTreeWidgetItem::operator<( rawOther );
+    }
+}
@@ -0,0 +1,159 @@
+/*
+ *   File name: TreeDiffWindow.h
+ *   Summary:	QDirStat "changes since cache file" window
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TreeDiffWindow_h
+#define TreeDiffWindow_h
+
+#include <QDialog>
+#include <QTreeWidgetItem>
+
+#include "ui_tree-diff-window.h"
+#include "TreeDiff.h"
+#include "Subtree.h"
+
+
+namespace QDirStat
+{
+    /**
+     * Modeless dialog to display what changed in a subtree since a cache
+     * file was written, e.g. what grew since last night's cache file: The
+     * added, removed and changed files and directories, sorted by how
+     * much they grew (see TreeDiff).
+     *
+     * The cache file is read into a separate DirTree that is only kept
+     * while comparing. The results are not updated when the tree changes.
+     **/
+    class TreeDiffWindow: public QDialog
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 *
+	 * Notice that this widget will destroy itself upon window close.
+	 *
+	 * It is advised to use a QPointer for storing a pointer to an instance
+	 * of this class. The QPointer will keep track of this window
+	 * auto-deleting itself when closed.
+	 **/
+	TreeDiffWindow( QWidget * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~TreeDiffWindow();
+
+	/**
+	 * Obtain the subtree from the last used URL or 0 if none was found.
+	 **/
+	const Subtree & subtree() const { return _subtree; }
+
+
+    public slots:
+
+	/**
+	 * Populate the window: Compare the content of cache file
+	 * 'cacheFileName' with 'subtree'.
+	 **/
+	void populate( const QString & cacheFileName, FileInfo * subtree );
+
+	/**
+	 * Refresh (reload) all data.
+	 **/
+	void refresh();
+
+	/**
+	 * Reject the dialog contents, i.e. the user clicked the "Cancel" or
+	 * WM_CLOSE button. This not only closes the dialog, it also deletes
+	 * it.
+	 *
+	 * Reimplemented from QDialog.
+	 **/
+	virtual void reject() Q_DECL_OVERRIDE;
+
+
+    protected slots:
+
+	/**
+	 * Select one of the search results in the main window's tree and
+	 * treemap widgets via their SelectionModel.
+	 **/
+	void selectResult( QTreeWidgetItem * item );
+
+
+    protected:
+
+	/**
+	 * Clear all data and widget contents.
+	 **/
+	void clear();
+
+	/**
+	 * One-time initialization of the widgets in this window.
+	 **/
+	void initWidgets();
+
+
+	//
+	// Data members
+	//
+
+	Ui::TreeDiffWindow * _ui;
+	Subtree		     _subtree;
+	QString		     _cacheFileName;
+    };
+
+
+    /**
+     * Column numbers for the tree diff tree widget
+     **/
+    enum TreeDiffColumns
+    {
+	TD_PathCol = 0,
+	TD_ChangeCol,
+	TD_OldSizeCol,
+	TD_NewSizeCol,
+	TD_DeltaCol
+    };
+
+
+    /**
+     * Item class for the tree diff list: One added, removed or changed
+     * file or directory.
+     **/
+    class TreeDiffListItem: public QTreeWidgetItem
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	TreeDiffListItem( const TreeDiffItem & diff,
+			  QTreeWidget	     * parent );
+
+	const TreeDiffItem & diff() const { return _diff; }
+
+	/**
+	 * Less-than operator for sorting.
+	 *
+	 * Reimplemented from QTreeWidgetItem.
+	 **/
+	virtual bool operator<( const QTreeWidgetItem & other ) const Q_DECL_OVERRIDE;
+
+    protected:
+
+	TreeDiffItem _diff;
+    };
+
+} // namespace QDirStat
+
+
+#endif // TreeDiffWindow_h
@@ -0,0 +1,516 @@
+/*
+ *   File name: TreeExporter.cpp
+ *   Summary:	Export a directory tree as CSV or NDJSON
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <pwd.h>	// getpwuid_r()
+#include <grp.h>	// getgrgid_r()
+#include <sys/stat.h>	// ALLPERMS, S_IS...()
+
+#include "TreeExporter.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "DotEntry.h"
+#include "Attic.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+TreeExporter::TreeExporter( Format format, const DataColumnList & columns ):
+    _format( format ),
+    _firstField( true ),
+    _ok( false )
+{
+    const DataColumnList & wanted = columns.isEmpty() ?
+	DataColumns::instance()->allColumns() : columns;
+
+    foreach ( DataColumn col, wanted )
+    {
+	if ( canExport( col ) && ! _columns.contains( col ) )
+	    _columns << col;
+    }
+
+    DataColumns::ensureNameColFirst( _columns );
+}
+
+
+void TreeExporter::prepareTree( DirTree * tree )
+{
+    if ( ! tree || ! tree->root() )
+	return;
+
+    // Everything that is exported has to be in the tree, and the summaries
+    // and the toplevel URL are calculated on demand: Do all that now, not
+    // in another thread while exporting.
+
+    tree->loadCachePlaceholders();
+
+    FileInfo * toplevel = tree->firstToplevel();
+
+    if ( toplevel )
+    {
+	toplevel->totalSize();
+	toplevel->url();
+    }
+}
+
+
+TreeExporter::Format TreeExporter::formatForFileName( const QString & fileName )
+{
+    if ( fileName.endsWith( ".json"   ) ||
+	 fileName.endsWith( ".ndjson" ) ||
+	 fileName.endsWith( ".jsonl"  ) )
+    {
+	return NdjsonFormat;
+    }
+
+    return CsvFormat;
+}
+
+
+bool TreeExporter::canExport( DataColumn col )
+{
+    return columnName( col ) != 0;
+}
+
+
+const char * TreeExporter::columnName( DataColumn col )
+{
+    switch ( col )
+    {
+	case NameCol:			return "path";
+	case SizeCol:			return "size";
+	case TotalItemsCol:		return "total_items";
+	case TotalFilesCol:		return "total_files";
+	case TotalSubDirsCol:		return "total_subdirs";
+	case LatestMTimeCol:		return "latest_mtime";
+	case OldestFileMTimeCol:	return "oldest_file_mtime";
+	case UserCol:			return "user";
+	case GroupCol:			return "group";
+	case PermissionsCol:		return "permissions";
+	case OctalPermissionsCol:	return "octal_permissions";
+
+	    // Only meaningful in the tree view
+
+	case PercentBarCol:
+	case PercentNumCol:
+	case ReadJobsCol:
+	case UndefinedCol:
+	    return 0;
+    }
+
+    return 0;
+}
+
+
+bool TreeExporter::write( const QString & fileName, FileInfo * subtree )
+{
+    _ok = false;
+    _itemsWritten.storeRelease( 0 );
+
+    if ( ! subtree )
+	return false;
+
+    _file.setFileName( fileName );
+
+    if ( ! _file.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered ) )
+    {
+	logError() << "Can't open " << fileName << ": " << _file.errorString() << endl;
+	return false;
+    }
+
+    _ok = true;
+    _buffer.clear();
+    _buffer.reserve( EXPORT_BUFFER_SIZE + 4096 );
+
+    if ( _format == CsvFormat )
+    {
+	for ( int i = 0; i < _columns.size(); ++i )
+	{
+	    if ( i > 0 )
+		_buffer += ',';
+
+	    _buffer += columnName( _columns.at( i ) );
+	}
+
+	_buffer += '\n';
+    }
+
+    // Only the URL of the subtree itself comes from the tree (it is
+    // cached there); below that, the path is built while descending.
+
+    _path = subtree->url().toUtf8();
+    writeTree( subtree );
+    flush( true );
+
+    _file.close();
+
+    if ( _ok && _file.error() != QFile::NoError )
+	_ok = false;
+
+    if ( ! _ok && ! aborted() )
+	logError() << "Error writing " << fileName << ": " << _file.errorString() << endl;
+
+    if ( aborted() )
+    {
+	_ok = false;
+	_file.remove();
+    }
+
+    _path.clear();
+    _buffer.clear();
+    _buffer.squeeze();
+
+    return _ok;
+}
+
+
+void TreeExporter::writeTree( FileInfo * item )
+{
+    if ( ! item->isPseudoDir() )
+	writeItem( item );
+
+    if ( ! item->isDirInfo() )
+	return;
+
+    // For a dot entry or an attic, _path is the path of its parent
+    // directory with the trailing slash already.
+
+    int pathLen = _path.size();
+
+    if ( ! _path.endsWith( '/' ) )
+	_path += '/';
+
+    int parentLen = _path.size();
+    FileInfo * child = item->firstChild();
+
+    while ( child && _ok && ! aborted() )
+    {
+	_path.truncate( parentLen );
+	_path += child->name().toUtf8();
+	writeTree( child );
+
+	child = child->next();
+    }
+
+    _path.truncate( parentLen );
+
+    if ( item->dotEntry() && _ok && ! aborted() )
+	writeTree( item->dotEntry() );
+
+    _path.truncate( parentLen );
+
+    if ( item->attic() && _ok && ! aborted() )
+	writeTree( item->attic() );
+
+    _path.truncate( pathLen );
+}
+
+
+void TreeExporter::writeItem( FileInfo * item )
+{
+    _firstField = true;
+
+    if ( _format == NdjsonFormat )
+	_buffer += '{';
+
+    foreach ( DataColumn col, _columns )
+    {
+	switch ( col )
+	{
+	    case NameCol:
+		appendString( col, _path );
+		break;
+
+	    case SizeCol:
+		appendNumber( col, item->totalSize() );
+		break;
+
+	    case TotalItemsCol:
+		appendNumber( col, item->isDirInfo() ? item->totalItems() : 0 );
+		break;
+
+	    case TotalFilesCol:
+		appendNumber( col, item->isDirInfo() ? item->totalFiles() : 0 );
+		break;
+
+	    case TotalSubDirsCol:
+		appendNumber( col, item->isDirInfo() ? item->totalSubDirs() : 0 );
+		break;
+
+	    case LatestMTimeCol:
+		appendNumber( col, item->latestMtime() );
+		break;
+
+	    case OldestFileMTimeCol:
+		appendNumber( col, item->oldestFileMtime() );
+		break;
+
+	    case UserCol:
+		appendString( col, item->hasUid() ? userName( item->uid() ) : QByteArray() );
+		break;
+
+	    case GroupCol:
+		appendString( col, item->hasGid() ? groupName( item->gid() ) : QByteArray() );
+		break;
+
+	    case PermissionsCol:
+		{
+		    // Like symbolicPermissions(), but without any QString
+
+		    mode_t mode = item->mode();
+		    char perm[ 10 ];
+
+		    perm[0] = S_ISDIR( mode ) ? 'd' : S_ISLNK( mode ) ? 'l' :
+			S_ISCHR( mode ) ? 'c' : S_ISBLK( mode ) ? 'b' :
+			S_ISFIFO( mode ) ? 'p' : S_ISSOCK( mode ) ? 's' : '-';
+
+		    for ( int i = 0; i < 9; ++i )
+			perm[ i+1 ] = ( mode & ( 0400 >> i ) ) ? "rwx"[ i % 3 ] : '-';
+
+		    if ( mode & S_ISUID ) perm[3] = ( mode & S_IXUSR ) ? 's' : 'S';
+		    if ( mode & S_ISGID ) perm[6] = ( mode & S_IXGRP ) ? 's' : 'S';
+		    if ( mode & S_ISVTX ) perm[9] = ( mode & S_IXOTH ) ? 't' : 'T';
+
+		    appendField( col, perm, sizeof( perm ), true );
+		}
+		break;
+
+	    case OctalPermissionsCol:
+		{
+		    mode_t mode = item->mode() & ALLPERMS;
+		    char octal[ 4 ];
+
+		    for ( int i = 3; i >= 0; --i, mode >>= 3 )
+			octal[ i ] = '0' + ( mode & 7 );
+
+		    appendField( col, octal, sizeof( octal ), true );
+		}
+		break;
+
+	    default:
+		break;
+	}
+    }
+
+    if ( _format == NdjsonFormat )
+	_buffer += '}';
+
+    _buffer += '\n';
+    _itemsWritten.fetchAndAddRelaxed( 1 );
+
+    flush();
+}
+
+
+void TreeExporter::appendField( DataColumn col, const char * text, int len, bool isString )
+{
+    if ( _format == NdjsonFormat )
+    {
+	if ( ! _firstField )
+	    _buffer += ',';
+
+	_buffer += '"';
+	_buffer += columnName( col );
+	_buffer += "\":";
+    }
+    else if ( ! _firstField )
+    {
+	_buffer += ',';
+    }
+
+    _firstField = false;
+
+    if ( isString )
+	appendQuoted( text, len );
+    else
+	_buffer.append( text, len );
+}
+
+
+void TreeExporter::appendString( DataColumn col, const QByteArray & text )
+{
+    appendField( col, text.constData(), text.size(), true );
+}
+
+
+void TreeExporter::appendNumber( DataColumn col, qint64 number )
+{
+    char   digits[ 24 ];
+    char * end = digits + sizeof( digits );
+    char * pos = end;
+    bool   negative = number < 0;
+    quint64 value   = negative ? -(quint64) number : number;
+
+    do
+    {
+	*--pos = '0' + value % 10;
+	value /= 10;
+    }
+    while ( value > 0 );
+
+    if ( negative )
+	*--pos = '-';
+
+    appendField( col, pos, end - pos, false );
+}
+
+
+void TreeExporter::appendQuoted( const char * text, int len )
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    if ( _format == NdjsonFormat )
+    {
+	// JSON string: Escape quotes, backslashes and control characters;
+	// everything else is UTF-8 already.
+
+	_buffer += '"';
+
+	for ( int i = 0; i < len; ++i )
+	{
+	    uchar c = text[ i ];
+
+	    if ( c == '"' || c == '\\' )
+	    {
+		_buffer += '\\';
+		_buffer += (char) c;
+	    }
+	    else if ( c < 0x20 )
+	    {
+		_buffer += "\\u00";
+		_buffer += hexDigits[ c >> 4 ];
+		_buffer += hexDigits[ c & 0xF ];
+	    }
+	    else
+	    {
+		_buffer += (char) c;
+	    }
+	}
+
+	_buffer += '"';
+    }
+    else
+    {
+	// CSV (RFC 4180): Quote fields with separators, quotes or line
+	// breaks and double the quotes in them.
+
+	bool needsQuotes = false;
+
+	for ( int i = 0; i < len && ! needsQuotes; ++i )
+	{
+	    char c = text[ i ];
+	    needsQuotes = c == ',' || c == '"' || c == '\n' || c == '\r';
+	}
+
+	if ( ! needsQuotes )
+	{
+	    _buffer.append( text, len );
+	    return;
+	}
+
+	_buffer += '"';
+
+	for ( int i = 0; i < len; ++i )
+	{
+	    if ( text[ i ] == '"' )
+		_buffer += '"';
+
+	    _buffer += text[ i ];
+	}
+
+	_buffer += '"';
+    }
+}
+
+
+const QByteArray & TreeExporter::userName( uint id )
+{
+    QHash<uint, QByteArray>::iterator it = _userNames.find( id );
+
+    if ( it == _userNames.end() )
+    {
+	// getpwuid() is not thread-safe, and this might run in another
+	// thread than the user interface
+
+	struct passwd	pwBuf;
+	struct passwd * pw = 0;
+	char		buf[ 4096 ];
+
+	QByteArray name;
+
+	if ( getpwuid_r( id, &pwBuf, buf, sizeof( buf ), &pw ) == 0 && pw )
+	    name = pw->pw_name;
+	else
+	    name = QByteArray::number( id );
+
+	it = _userNames.insert( id, name );
+    }
+
+    return it.value();
+}
+
+
+const QByteArray & TreeExporter::groupName( uint id )
+{
+    QHash<uint, QByteArray>::iterator it = _groupNames.find( id );
+
+    if ( it == _groupNames.end() )
+    {
+	struct group	grBuf;
+	struct group *	grp = 0;
+	char		buf[ 16384 ];	// groups with many members are big
+
+	QByteArray name;
+
+	if ( getgrgid_r( id, &grBuf, buf, sizeof( buf ), &grp ) == 0 && grp )
+	    name = grp->gr_name;
+	else
+	    name = QByteArray::number( id );
+
+	it = _groupNames.insert( id, name );
+    }
+
+    return it.value();
+}
+
+
+void TreeExporter::flush( bool force )
+{
+    if ( _buffer.isEmpty() || ( ! force && _buffer.size() < EXPORT_BUFFER_SIZE ) )
+	return;
+
+    if ( _ok && _file.write( _buffer ) != _buffer.size() )
+	_ok = false;
+
+    _buffer.resize( 0 );	// keeps the reserved capacity
+}
+
+
+
+
+TreeExporterThread::TreeExporterThread( const QString	     & fileName,
+					DirTree		     * tree,
+					Format		       format,
+					const DataColumnList & columns ):
+    TreeWriterThread(),
+    TreeExporter( format, columns ),
+    _fileName( fileName ),
+    _toplevel( 0 )
+{
+    prepareTree( tree );
+    _toplevel = tree ? tree->firstToplevel() : 0;
+}
+
+
+void TreeExporterThread::run()
+{
+    write( _fileName, _toplevel );
+}
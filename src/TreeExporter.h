@@ -0,0 +1,223 @@
+/*
+ *   File name: TreeExporter.h
+ *   Summary:	Export a directory tree as CSV or NDJSON
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TreeExporter_h
+#define TreeExporter_h
+
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+
+#include "DataColumns.h"
+#include "TreeWriterThread.h"
+
+
+// Flush the output buffer when it is bigger than this
+#define EXPORT_BUFFER_SIZE	( 1024 * 1024 )
+
+
+namespace QDirStat
+{
+    class FileInfo;
+    class DirTree;
+
+
+    /**
+     * Exporter for a directory tree to a format that other tools can read:
+     *
+     * - CSV: One header line with the column names, then one line for
+     *	 each item.
+     *
+     * - NDJSON (newline delimited JSON): One JSON object for each item per
+     *	 line, with the column names as keys.
+     *
+     * There is one row for each directory and for each file (or any other
+     * non-directory item) in the tree, but not for dot entries and attics.
+     * The columns are the model columns from DataColumns that make sense
+     * outside of the tree view; NameCol is the complete path. Times are in
+     * seconds since the epoch.
+     *
+     * The tree is written in one pass directly to a buffer that is flushed
+     * to the file in big chunks, so the time this takes is mostly what the
+     * disk needs.
+     **/
+    class TreeExporter
+    {
+    public:
+
+	enum Format
+	{
+	    CsvFormat,
+	    NdjsonFormat
+	};
+
+	/**
+	 * Constructor. If 'columns' is empty, all columns are exported.
+	 * Columns that can't be exported are ignored.
+	 **/
+	TreeExporter( Format format, const DataColumnList & columns = DataColumnList() );
+
+	/**
+	 * Export 'subtree' to file 'fileName'. Return 'true' on success,
+	 * 'false' on error or if aborted. The summaries of the subtree have
+	 * to be up to date (see prepareTree()).
+	 **/
+	bool write( const QString & fileName, FileInfo * subtree );
+
+	/**
+	 * Return 'true' if the last write() was successful.
+	 **/
+	bool ok() const { return _ok; }
+
+	/**
+	 * Return the number of items written so far. This may be called from
+	 * any thread.
+	 **/
+	int itemsWritten() const { return _itemsWritten.loadAcquire(); }
+
+	/**
+	 * Stop writing as soon as possible; the file is removed. This may be
+	 * called from any thread.
+	 **/
+	void abort() { _aborted.storeRelease( 1 ); }
+
+	/**
+	 * Return the columns that are exported.
+	 **/
+	const DataColumnList & columns() const { return _columns; }
+
+	/**
+	 * Calculate all summaries of 'tree' so exporting it does not change
+	 * anything in the tree.
+	 **/
+	static void prepareTree( DirTree * tree );
+
+	/**
+	 * Return the format for a file name: NDJSON for ".json", ".ndjson"
+	 * and ".jsonl", CSV for everything else.
+	 **/
+	static Format formatForFileName( const QString & fileName );
+
+	/**
+	 * Return 'true' if column 'col' can be exported.
+	 **/
+	static bool canExport( DataColumn col );
+
+	/**
+	 * Return the name of column 'col' in the header of a CSV file and
+	 * as the key in NDJSON.
+	 **/
+	static const char * columnName( DataColumn col );
+
+
+    protected:
+
+	/**
+	 * Write 'item' and (recursively) its children. _path is the path of
+	 * the parent directory with a trailing slash.
+	 **/
+	void writeTree( FileInfo * item );
+
+	/**
+	 * Write the row for 'item'. _path is its complete path.
+	 **/
+	void writeItem( FileInfo * item );
+
+	/**
+	 * Append one field to the current row.
+	 **/
+	void appendField( DataColumn col, const char * text, int len, bool isString );
+	void appendString( DataColumn col, const QByteArray & text );
+	void appendNumber( DataColumn col, qint64 number );
+
+	/**
+	 * Append 'text' to the buffer, quoted as needed for the format.
+	 **/
+	void appendQuoted( const char * text, int len );
+
+	/**
+	 * Return the user or group name for 'id'. The names are cached
+	 * because looking them up can be slow (NIS, LDAP).
+	 **/
+	const QByteArray & userName ( uint id );
+	const QByteArray & groupName( uint id );
+
+	/**
+	 * Write the buffer to the file if it is full enough or if 'force' is
+	 * 'true'.
+	 **/
+	void flush( bool force = false );
+
+	bool aborted() const { return _aborted.loadAcquire() != 0; }
+
+
+	Format			 _format;
+	DataColumnList		 _columns;
+	QFile			 _file;
+	QByteArray		 _buffer;
+	QByteArray		 _path;
+	bool			 _firstField;
+	bool			 _ok;
+	QAtomicInt		 _aborted;
+	QAtomicInt		 _itemsWritten;
+	QHash<uint, QByteArray>	 _userNames;
+	QHash<uint, QByteArray>	 _groupNames;
+    };
+
+
+    /**
+     * Thread for exporting a tree in the background (see
+     * DirTree::startWriting()). The constructor prepares the tree, so the
+     * thread only reads it.
+     **/
+    class TreeExporterThread: public TreeWriterThread, public TreeExporter
+    {
+    public:
+
+	/**
+	 * Constructor. Call start() to export 'tree' to 'fileName'.
+	 **/
+	TreeExporterThread( const QString	 & fileName,
+			    DirTree		 * tree,
+			    Format		   format,
+			    const DataColumnList & columns = DataColumnList() );
+
+	//
+	// Reimplemented from TreeWriterThread
+	//
+
+	virtual QString fileName() const Q_DECL_OVERRIDE { return _fileName; }
+
+	virtual int itemsWritten() const Q_DECL_OVERRIDE
+	    { return TreeExporter::itemsWritten(); }
+
+	virtual void abort() Q_DECL_OVERRIDE { TreeExporter::abort(); }
+
+	virtual bool ok() const Q_DECL_OVERRIDE { return TreeExporter::ok(); }
+
+    protected:
+
+	/**
+	 * Export the tree. This is called in the new thread.
+	 *
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+
+	QString	   _fileName;
+	FileInfo * _toplevel;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef TreeExporter_h
@@ -0,0 +1,120 @@
+/*
+ *   File name: TreePatcher.cpp
+ *   Summary:	Helper class to remove deleted items from the tree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <QVector>
+
+#include "TreePatcher.h"
+#include "Refresher.h"
+#include "DirTree.h"
+#include "FileInfo.h"
+#include "QDirStatApp.h"	// SelectionModel
+#include "SelectionModel.h"
+#include "Logger.h"
+
+using namespace QDirStat;
+
+
+TreePatcher::TreePatcher( const FileInfoSet items, QObject * parent ):
+    QObject( parent ),
+    _tree( 0 )
+{
+    // Like in the Refresher, store everything right now: By the time it is
+    // needed, the items might be gone.
+
+    if ( ! items.isEmpty() )
+	_tree = items.first()->tree();
+
+    foreach ( FileInfo * item, items )
+    {
+	_urls  << item->url();
+	_paths << ( item->isPseudoDir() ? QString() : item->path() );
+    }
+}
+
+
+void TreePatcher::patch()
+{
+    if ( ! _tree || _urls.isEmpty() )
+    {
+	logWarning() << "No items to patch" << endl;
+	this->deleteLater();
+	return;
+    }
+
+    if ( _tree->isBusy() )
+    {
+	logWarning() << "Not patching the tree: DirTree is being read" << endl;
+	this->deleteLater();
+	return;
+    }
+
+    // Check everything first: Removing items from the tree does not change
+    // what is on disk.
+
+    QVector<bool> gone( _urls.size(), true );
+    struct stat statInfo;
+
+    for ( int i = 0; i < _paths.size(); ++i )
+    {
+	if ( ! _paths.at( i ).isEmpty() )
+	    gone[ i ] = lstat( _paths.at( i ).toUtf8(), &statInfo ) != 0 && errno == ENOENT;
+    }
+
+    // Locate each item only now: The tree might have changed in the
+    // meantime, so no FileInfo pointers are kept.
+
+    int removed = 0;
+
+    for ( int i = 0; i < _urls.size(); ++i )
+    {
+	if ( gone.at( i ) )
+	{
+	    FileInfo * item = _tree->locate( _urls.at( i ), true ); // findPseudoDirs
+
+	    if ( item )
+	    {
+		_tree->deleteSubtree( item );
+		++removed;
+	    }
+	}
+    }
+
+    FileInfoSet stillThere;
+
+    for ( int i = 0; i < _urls.size(); ++i )
+    {
+	if ( ! gone.at( i ) )
+	{
+	    FileInfo * item = _tree->locate( _urls.at( i ) );
+
+	    if ( item )
+		stillThere << item;
+	}
+    }
+
+    logDebug() << "Removed " << removed << " items from the tree; "
+	       << stillThere.size() << " items still exist" << endl;
+
+    if ( ! stillThere.isEmpty() )
+    {
+	// Some of those items might have changed or be removed partially
+
+	FileInfoSet refreshSet = Refresher::parents( stillThere );
+
+	app()->selectionModel()->prepareRefresh( refreshSet );
+	_tree->refresh( refreshSet );
+    }
+
+    this->deleteLater();
+}
@@ -0,0 +1,70 @@
+/*
+ *   File name: TreePatcher.h
+ *   Summary:	Helper class to remove deleted items from the tree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TreePatcher_h
+#define TreePatcher_h
+
+#include <QObject>
+#include <QStringList>
+#include "FileInfoSet.h"
+
+
+namespace QDirStat
+{
+    class DirTree;
+
+    /**
+     * Helper class for actions whose effect on the tree is known in
+     * advance: They remove a number of items from disk, like deleting them
+     * or moving them to the trash.
+     *
+     * Rather than reading their parents again from disk with a Refresher
+     * (which can take very long for directories with millions of entries),
+     * this only checks with lstat() that each item is really gone and then
+     * removes it from the tree. Only the parents of items that still exist
+     * are read again.
+     *
+     * Like a Refresher, store a FileInfoSet and act when a signal is
+     * received (typically OutputWindow::lastProcessFinished()). This object
+     * destroys itself at the end of patch(), so give it a QObject parent to
+     * avoid a memory leak if that signal never arrives.
+     **/
+    class TreePatcher: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Create a TreePatcher for 'items' that are expected to be removed
+	 * from disk. They should be normalized, i.e. not contain any item
+	 * together with one of its ancestors.
+	 *
+	 * All items are assumed to belong to the same DirTree.
+	 **/
+	TreePatcher( const FileInfoSet items, QObject * parent );
+
+    public slots:
+
+	/**
+	 * Remove all items from the tree that are gone from disk and refresh
+	 * the parents of the others. After this is done, this object will
+	 * delete itself.
+	 **/
+	void patch();
+
+    protected:
+
+	DirTree *   _tree;
+	QStringList _urls;
+	QStringList _paths;	// Empty for pseudo dirs: Those can't be checked
+    };
+}	// namespace QDirStat
+
+#endif	// TreePatcher_h
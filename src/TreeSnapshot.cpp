@@ -0,0 +1,180 @@
+/*
+ *   File name: TreeSnapshot.cpp
+ *   Summary:	Immutable copy of a subtree for background threads
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QStringList>
+
+#include "TreeSnapshot.h"
+#include "DirInfo.h"
+#include "DotEntry.h"
+#include "Attic.h"
+#include "DirTree.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+QWeakPointer<const TreeSnapshot::Data> TreeSnapshot::_last;
+
+
+TreeSnapshot::TreeSnapshot()
+{
+    // NOP
+}
+
+
+TreeSnapshot TreeSnapshot::take( FileInfo * subtree )
+{
+    TreeSnapshot snapshot;
+
+    if ( ! subtree || ! subtree->tree() )
+	return snapshot;
+
+    DirTree * tree = subtree->tree();
+    QSharedPointer<const Data> last = _last.toStrongRef();
+
+    if ( last &&
+	 last->subtree	  == subtree &&
+	 last->tree	  == tree    &&
+	 last->generation == tree->generation() )
+    {
+	snapshot._data = last;
+	return snapshot;
+    }
+
+    Data * data = new Data;
+    CHECK_NEW( data );
+
+    data->url	     = subtree->url();
+    data->tree	     = tree;
+    data->subtree    = subtree;
+    data->generation = tree->generation();
+
+    subtree->totalSize();	// Make sure all summaries are up to date
+
+    QVector<TreeSnapshotNode> & nodes = data->nodes;
+    QVector<FileInfo *> items;	// the items of 'nodes' in the same order
+
+    nodes.reserve( subtree->totalItems() + 1 );
+    items.reserve( subtree->totalItems() + 1 );
+
+    nodes.resize( 1 );
+    items << subtree;
+    copyItem( subtree, nodes[0] );
+    nodes[0].parent = -1;
+
+    // Breadth-first: The children of each item are appended in one go, so
+    // they are consecutive.
+
+    for ( int i = 0; i < items.size(); ++i )
+    {
+	DirInfo * dir = items.at( i )->toDirInfo();
+
+	nodes[i].firstChild = items.size();
+	nodes[i].childCount = 0;
+
+	if ( ! dir )
+	    continue;
+
+	QVector<FileInfo *> children;
+
+	for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+	    children << child;
+
+	if ( dir->dotEntry() )
+	    children << dir->dotEntry();
+
+	if ( dir->attic() )
+	    children << dir->attic();
+
+	foreach ( FileInfo * child, children )
+	{
+	    TreeSnapshotNode node;
+	    copyItem( child, node );
+	    node.parent = i;
+
+	    nodes << node;
+	    items << child;
+	}
+
+	nodes[i].childCount = children.size();
+    }
+
+    logDebug() << "Snapshot of " << data->url << ": " << nodes.size() << " items" << endl;
+
+    snapshot._data = QSharedPointer<const Data>( data );
+    _last = snapshot._data;
+
+    return snapshot;
+}
+
+
+void TreeSnapshot::copyItem( FileInfo * item, TreeSnapshotNode & node )
+{
+    node.name		    = item->name();
+    node.size		    = item->size();
+    node.allocatedSize	    = item->allocatedSize();
+    node.totalSize	    = item->totalSize();
+    node.totalAllocatedSize = item->totalAllocatedSize();
+    node.totalItems	    = item->totalItems();
+    node.mtime		    = item->mtime();
+    node.latestMtime	    = item->latestMtime();
+    node.mode		    = item->mode();
+    node.links		    = item->links();
+    node.parent		    = -1;
+    node.firstChild	    = 0;
+    node.childCount	    = 0;
+    node.flags		    = 0;
+
+    if ( item->isDirInfo()  ) node.flags |= TreeSnapshotNode::IsDirInfo;
+    if ( item->isDotEntry() ) node.flags |= TreeSnapshotNode::IsDotEntry;
+    if ( item->isAttic()    ) node.flags |= TreeSnapshotNode::IsAttic;
+    if ( item->isIgnored()  ) node.flags |= TreeSnapshotNode::IsIgnored;
+    if ( item->isExcluded() ) node.flags |= TreeSnapshotNode::IsExcluded;
+    if ( item->readError()  ) node.flags |= TreeSnapshotNode::ReadError;
+}
+
+
+QString TreeSnapshot::url( int index ) const
+{
+    if ( ! _data || index < 0 || index >= _data->nodes.size() )
+	return QString();
+
+    // Collect the names up to the first item; pseudo directories are not
+    // part of the URL.
+
+    QStringList names;
+
+    while ( index > 0 )
+    {
+	const TreeSnapshotNode & item = _data->nodes.at( index );
+
+	if ( ! item.isPseudoDir() )
+	    names.prepend( item.name );
+
+	index = item.parent;
+    }
+
+    if ( names.isEmpty() )
+	return _data->url;
+
+    QString base = _data->url;
+
+    if ( ! base.endsWith( "/" ) )
+	base += "/";
+
+    return base + names.join( "/" );
+}
+
+
+bool TreeSnapshot::isCurrent( DirTree * tree ) const
+{
+    return _data && _data->tree == tree && _data->generation == tree->generation();
+}
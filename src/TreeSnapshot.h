@@ -0,0 +1,168 @@
+/*
+ *   File name: TreeSnapshot.h
+ *   Summary:	Immutable copy of a subtree for background threads
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TreeSnapshot_h
+#define TreeSnapshot_h
+
+
+#include <sys/types.h>
+#include <time.h>
+
+#include <QString>
+#include <QVector>
+#include <QSharedPointer>
+
+#include "FileSize.h"
+
+
+namespace QDirStat
+{
+    class FileInfo;
+    class DirTree;
+
+
+    /**
+     * One item of a TreeSnapshot: The data of a FileInfo (or DirInfo,
+     * DotEntry, Attic) at the time the snapshot was taken.
+     *
+     * The children of each item are consecutive in the snapshot: first the
+     * normal children, then the dot entry and then the attic, if there are
+     * any.
+     **/
+    struct TreeSnapshotNode
+    {
+	enum Flags
+	{
+	    IsDirInfo	= 0x01,
+	    IsDotEntry	= 0x02,
+	    IsAttic	= 0x04,
+	    IsIgnored	= 0x08,
+	    IsExcluded	= 0x10,
+	    ReadError	= 0x20
+	};
+
+	QString	 name;
+	FileSize size;
+	FileSize allocatedSize;
+	FileSize totalSize;
+	FileSize totalAllocatedSize;
+	int	 totalItems;
+	time_t	 mtime;
+	time_t	 latestMtime;
+	mode_t	 mode;
+	nlink_t	 links;
+	int	 parent;	// index; -1 for the first item
+	int	 firstChild;	// index
+	int	 childCount;
+	int	 flags;
+
+	bool isDirInfo()  const { return flags & IsDirInfo;  }
+	bool isDotEntry() const { return flags & IsDotEntry; }
+	bool isAttic()	  const { return flags & IsAttic;    }
+	bool isPseudoDir() const { return flags & ( IsDotEntry | IsAttic ); }
+	bool isIgnored()  const { return flags & IsIgnored;  }
+    };
+
+
+    /**
+     * Immutable copy of a subtree of a DirTree for background threads:
+     *
+     * A TreeSnapshot is taken in the main thread with take(). After that,
+     * any number of threads can traverse it without locking while the GUI
+     * keeps on changing (refreshing, cleaning up) the live tree; the
+     * snapshot doesn't refer to any FileInfo.
+     *
+     * The items are stored in one flat array in breadth-first order, so
+     * taking a snapshot is one fast pass over the subtree without any
+     * allocation per item except for the (implicitly shared) names.
+     *
+     * Copying a TreeSnapshot is cheap: All copies share the same data,
+     * which is deleted when the last copy is destroyed, no matter in which
+     * thread. take() returns the previous snapshot again as long as the tree
+     * did not change since then (see DirTree::generation()), so several
+     * background jobs started for the same tree share one snapshot.
+     **/
+    class TreeSnapshot
+    {
+    public:
+
+	/**
+	 * Constructor for an empty snapshot.
+	 **/
+	TreeSnapshot();
+
+	/**
+	 * Take a snapshot of 'subtree' and all its descendants including the
+	 * dot entries and attics. Use this only in the main thread.
+	 **/
+	static TreeSnapshot take( FileInfo * subtree );
+
+	/**
+	 * Return 'true' if this snapshot has no items.
+	 **/
+	bool isEmpty() const { return size() == 0; }
+
+	/**
+	 * Return the number of items.
+	 **/
+	int size() const { return _data ? _data->nodes.size() : 0; }
+
+	/**
+	 * Return the item with index 'index'. The first item (index 0) is
+	 * the subtree the snapshot was taken of.
+	 **/
+	const TreeSnapshotNode & node( int index ) const
+	    { return _data->nodes.at( index ); }
+
+	/**
+	 * Return the URL of the item with index 'index' like
+	 * FileInfo::url().
+	 **/
+	QString url( int index ) const;
+
+	/**
+	 * Return the generation of the tree when this snapshot was taken.
+	 **/
+	qint64 generation() const { return _data ? _data->generation : -1; }
+
+	/**
+	 * Return 'true' if 'tree' did not change since this snapshot was
+	 * taken. Use this only in the main thread.
+	 **/
+	bool isCurrent( DirTree * tree ) const;
+
+
+    protected:
+
+	struct Data
+	{
+	    QVector<TreeSnapshotNode> nodes;
+	    QString		      url;	    // of the first item
+	    const DirTree *	      tree;	    // only for comparing
+	    const FileInfo *	      subtree;	    // only for comparing
+	    qint64		      generation;
+	};
+
+	/**
+	 * Fill 'node' with the data of 'item'.
+	 **/
+	static void copyItem( FileInfo * item, TreeSnapshotNode & node );
+
+
+	QSharedPointer<const Data> _data;
+
+	// The last snapshot for sharing it as long as anybody still uses it
+
+	static QWeakPointer<const Data> _last;
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef TreeSnapshot_h
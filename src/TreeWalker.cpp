@@ -7,9 +7,17 @@
  */
 
 
+#include <algorithm>
+#include <limits>
+
+#include <QVector>
+#include <QDateTime>
+
 #include "TreeWalker.h"
-#include "FileSizeStats.h"
-#include "FileMTimeStats.h"
+#include "FileRangeIndex.h"
+#include "InlineCollector.h"
+#include "MimeCategorizer.h"
+#include "DirTree.h"
 #include "SysUtil.h"
 #include "Logger.h"
 #include "Exception.h"
@@ -20,81 +28,397 @@
 using namespace QDirStat;
 
 
-qreal TreeWalker::upperPercentileThreshold( PercentileStats & stats )
+namespace
 {
-    int percentile = 0;
+    /**
+     * Heap entry for TopFilesVisitor
+     **/
+    struct HeapEntry
+    {
+        qint64     key;
+        FileInfo * item;
+    };
 
-    if      ( stats.dataSize() <= 100 )                 percentile = 80;
-    else if ( stats.dataSize() * 0.10 <= MAX_RESULTS )  percentile = 90;
-    else if ( stats.dataSize() * 0.05 <= MAX_RESULTS )  percentile = 95;
-    else if ( stats.dataSize() * 0.01 <= MAX_RESULTS )  percentile = 99;
 
-    qreal threshold = 0.0;
+    /**
+     * Comparison function for a min-heap of HeapEntry.
+     **/
+    bool higherKey( const HeapEntry & a, const HeapEntry & b )
+    {
+        return a.key > b.key;
+    }
 
-    if ( percentile > 0 )
+
+    /**
+     * InlineCollector visitor for the files with the highest keys of a
+     * TopFilesTreeWalker (see TopFilesTreeWalker::collectTopFiles()). Each
+     * thread keeps its own heap; merging them only needs to consider the
+     * entries of the other heap.
+     **/
+    template<class Key>
+    class TopFilesVisitor
     {
-        logDebug() << "Threshold: " << percentile << ". percentile" << endl;
-        threshold = stats.percentile( percentile );
+    public:
+
+        TopFilesVisitor( int maxCount ):
+            _maxCount( maxCount )
+            {
+                _heap.reserve( maxCount );
+            }
+
+        void visitFile( FileInfo * file )
+            { add( Key::key( file ), file ); }
+
+        /**
+         * Skip 'dir' if it has no files or if the heap is full and no file
+         * below 'dir' can have a higher key than the lowest one in the
+         * heap.
+         **/
+        bool skip( FileInfo * dir ) const
+        {
+            if ( dir->totalFiles() == 0 )
+                return true;
+
+            return ! _heap.isEmpty() && _heap.size() >= _maxCount &&
+                Key::maxKeyBelow( dir ) <= _heap.first().key;
+        }
+
+        TopFilesVisitor partial() const
+            { return TopFilesVisitor( _maxCount ); }
+
+        void merge( TopFilesVisitor & partial )
+        {
+            foreach ( const HeapEntry & entry, partial._heap )
+                add( entry.key, entry.item );
+        }
+
+        /**
+         * Return the collected files, the one with the highest key first.
+         **/
+        FileInfoList results();
+
+    protected:
+
+        /**
+         * Add 'item' to the heap if there is still room or if its key is
+         * higher than the lowest one in the heap.
+         **/
+        void add( qint64 key, FileInfo * item );
+
+
+        int                _maxCount;
+        QVector<HeapEntry> _heap;     // min-heap: lowest key at the front
+    };
+
+
+    template<class Key>
+    void TopFilesVisitor<Key>::add( qint64 key, FileInfo * item )
+    {
+        if ( _heap.size() < _maxCount )
+        {
+            _heap.append( HeapEntry() );
+        }
+        else if ( key > _heap.first().key )
+        {
+            // Drop the entry with the lowest key to make room
+
+            std::pop_heap( _heap.begin(), _heap.end(), higherKey );
+        }
+        else
+        {
+            return;
+        }
+
+        _heap.last().key  = key;
+        _heap.last().item = item;
+        std::push_heap( _heap.begin(), _heap.end(), higherKey );
     }
-    else
+
+
+    template<class Key>
+    FileInfoList TopFilesVisitor<Key>::results()
     {
-        logDebug() << "Threshold: " << MAX_RESULTS << " items" << endl;
-        int index = stats.dataSize() - MAX_RESULTS;
-        threshold = stats.data().at( index );
+        // Turn the heap into a list sorted from the highest to the lowest key
+
+        std::sort_heap( _heap.begin(), _heap.end(), higherKey );
+
+        FileInfoList results;
+        results.reserve( _heap.size() );
+
+        foreach ( const HeapEntry & entry, _heap )
+            results << entry.item;
+
+        _heap.clear();
+
+        return results;
     }
 
-    return threshold;
-}
 
+    /**
+     * InlineCollector visitor for the files of a MatchingFilesTreeWalker
+     * (see MatchingFilesTreeWalker::collectMatchingFiles()).
+     **/
+    template<class Predicate>
+    class MatchingFilesVisitor
+    {
+    public:
+
+        void visitFile( FileInfo * file )
+        {
+            if ( Predicate::matches( file ) )
+                _results << file;
+        }
 
-qreal TreeWalker::lowerPercentileThreshold( PercentileStats & stats )
+        bool skip( FileInfo * dir ) const
+            { return dir->totalFiles() == 0; }
+
+        MatchingFilesVisitor partial() const
+            { return MatchingFilesVisitor(); }
+
+        void merge( MatchingFilesVisitor & partial )
+            { _results << partial._results; }
+
+        FileInfoList _results;
+    };
+
+
+    //
+    // Keys for TopFilesTreeWalker::collectTopFiles()
+    //
+
+    struct LargestFileKey
+    {
+        static qint64 key( FileInfo * file ) { return file->size(); }
+
+        // No file can be larger than the total size of its directory
+        static qint64 maxKeyBelow( FileInfo * dir ) { return dir->totalSize(); }
+    };
+
+
+    struct NewestFileKey
+    {
+        static qint64 key( FileInfo * file ) { return file->mtime(); }
+        static qint64 maxKeyBelow( FileInfo * dir ) { return dir->latestMtime(); }
+    };
+
+
+    struct OldestFileKey
+    {
+        static qint64 key( FileInfo * file ) { return -( (qint64) file->mtime() ); }
+
+        // The oldest mtime of a directory ignores files with mtime 0, so it
+        // can't be used to skip anything
+        static qint64 maxKeyBelow( FileInfo * ) { return std::numeric_limits<qint64>::max(); }
+    };
+
+
+    //
+    // Predicates for MatchingFilesTreeWalker::collectMatchingFiles()
+    //
+
+    struct HardLinkedFile
+    {
+        static bool matches( FileInfo * file ) { return file->links() > 1; }
+    };
+
+
+    struct SparseFile
+    {
+        static bool matches( FileInfo * file ) { return file->isSparseFile(); }
+    };
+
+}       // namespace
+
+
+int TreeWalker::maxResults( int dataSize ) const
 {
     int percentile = 0;
 
-    if      ( stats.dataSize() <= 100 )                 percentile = 20;
-    else if ( stats.dataSize() * 0.10 <= MAX_RESULTS )  percentile = 10;
-    else if ( stats.dataSize() * 0.05 <= MAX_RESULTS )  percentile =  5;
-    else if ( stats.dataSize() * 0.01 <= MAX_RESULTS )  percentile =  1;
-
-    qreal threshold = 0.0;
+    if      ( dataSize <= 100 )                 percentile = 20;
+    else if ( dataSize * 0.10 <= MAX_RESULTS )  percentile = 10;
+    else if ( dataSize * 0.05 <= MAX_RESULTS )  percentile =  5;
+    else if ( dataSize * 0.01 <= MAX_RESULTS )  percentile =  1;
 
     if ( percentile > 0 )
+        return qMax( 1, (int) ( (qint64) dataSize * percentile / 100 ) );
+    else
+        return MAX_RESULTS;
+}
+
+
+void TopFilesTreeWalker::prepare( FileInfo * subtree )
+{
+    _results.clear();
+    _threshold = std::numeric_limits<qint64>::max(); // check() never matches
+
+    if ( ! subtree )
+        return;
+
+    FileInfoList results = collectTop( subtree, maxResults( subtree->totalFiles() ) );
+
+    if ( cancelled() )
+        return;
+
+    setResults( results );
+    logDebug() << _results.size() << " results" << endl;
+}
+
+
+template<class Key>
+FileInfoList TopFilesTreeWalker::collectTopFiles( FileInfo * subtree, int count )
+{
+    InlineCollector< TopFilesVisitor<Key> > collector( TopFilesVisitor<Key>( count ), this );
+    collector.collectSubtree( subtree );
+
+    return collector.visitor().results();
+}
+
+
+bool TopFilesTreeWalker::prepareFromIndex( const FileRangeIndex * index,
+                                           FileInfo *             subtree )
+{
+    if ( ! index || ! index->covers( subtree ) )
+        return false;
+
+    setResults( indexResults( index, maxResults( subtree->totalFiles() ), subtree ) );
+    logDebug() << _results.size() << " results from the index" << endl;
+
+    return true;
+}
+
+
+void TopFilesTreeWalker::setResults( const FileInfoList & results )
+{
+    _results   = results;
+    _threshold = std::numeric_limits<qint64>::max();
+
+    if ( ! _results.isEmpty() )
+        _threshold = key( _results.last() );
+}
+
+
+FileInfoList LargestFilesTreeWalker::collectTop( FileInfo * subtree, int count )
+{
+    return collectTopFiles<LargestFileKey>( subtree, count );
+}
+
+
+FileInfoList LargestFilesTreeWalker::indexResults( const FileRangeIndex * index,
+                                                   int                    count,
+                                                   FileInfo *             subtree ) const
+{
+    return index->largestFiles( count, subtree );
+}
+
+
+FileInfoList NewFilesTreeWalker::collectTop( FileInfo * subtree, int count )
+{
+    return collectTopFiles<NewestFileKey>( subtree, count );
+}
+
+
+FileInfoList NewFilesTreeWalker::indexResults( const FileRangeIndex * index,
+                                               int                    count,
+                                               FileInfo *             subtree ) const
+{
+    return index->newestFiles( count, subtree );
+}
+
+
+FileInfoList OldFilesTreeWalker::collectTop( FileInfo * subtree, int count )
+{
+    return collectTopFiles<OldestFileKey>( subtree, count );
+}
+
+
+FileInfoList OldFilesTreeWalker::indexResults( const FileRangeIndex * index,
+                                               int                    count,
+                                               FileInfo *             subtree ) const
+{
+    return index->oldestFiles( count, subtree );
+}
+
+
+bool FilesFromYearTreeWalker::prepareFromIndex( const FileRangeIndex * index,
+                                                FileInfo *             subtree )
+{
+    _fromIndex = index && index->covers( subtree );
+    _results.clear();
+
+    if ( _fromIndex )
     {
-        logDebug() << "Threshold: " << percentile << ". percentile" << endl;
-        threshold = stats.percentile( percentile );
+        // FileInfo::mtimeYear() is in UTC
+
+        QDateTime from( QDate( _year,     1, 1 ), QTime( 0, 0 ), Qt::UTC );
+        QDateTime to  ( QDate( _year + 1, 1, 1 ), QTime( 0, 0 ), Qt::UTC );
+
+        _results = index->filesInMtimeRange( from.toMSecsSinceEpoch() / 1000,
+                                             to.toMSecsSinceEpoch()   / 1000,
+                                             subtree );
     }
-    else
+
+    return _fromIndex;
+}
+
+
+bool FilesFromMonthTreeWalker::prepareFromIndex( const FileRangeIndex * index,
+                                                 FileInfo *             subtree )
+{
+    _fromIndex = index && index->covers( subtree );
+    _results.clear();
+
+    if ( _fromIndex )
     {
-        logDebug() << "Threshold: " << MAX_RESULTS << " items" << endl;
-        int index = MAX_RESULTS;
-        threshold = stats.data().at( index );
+        // FileInfo::mtimeMonth() is in UTC
+
+        QDate     month( _year, _month, 1 );
+        QDateTime from( month,                QTime( 0, 0 ), Qt::UTC );
+        QDateTime to  ( month.addMonths( 1 ), QTime( 0, 0 ), Qt::UTC );
+
+        _results = index->filesInMtimeRange( from.toMSecsSinceEpoch() / 1000,
+                                             to.toMSecsSinceEpoch()   / 1000,
+                                             subtree );
     }
 
-    return threshold;
+    return _fromIndex;
 }
 
 
+void MatchingFilesTreeWalker::prepare( FileInfo * subtree )
+{
+    _results.clear();
+
+    if ( ! subtree )
+        return;
+
+    FileInfoList results = collectMatches( subtree );
+
+    if ( ! cancelled() )
+        _results = results;
+
+    logDebug() << _results.size() << " results" << endl;
+}
 
 
-void LargestFilesTreeWalker::prepare( FileInfo * subtree )
+template<class Predicate>
+FileInfoList MatchingFilesTreeWalker::collectMatchingFiles( FileInfo * subtree )
 {
+    InlineCollector< MatchingFilesVisitor<Predicate> > collector( MatchingFilesVisitor<Predicate>(), this );
+    collector.collectSubtree( subtree );
 
-    FileSizeStats stats( subtree );
-    _threshold = (FileSize) upperPercentileThreshold( stats );
+    return collector.visitor()._results;
 }
 
 
-void NewFilesTreeWalker::prepare( FileInfo * subtree )
+FileInfoList HardLinkedFilesTreeWalker::collectMatches( FileInfo * subtree )
 {
-    FileMTimeStats stats( subtree );
-    _threshold = (time_t) upperPercentileThreshold( stats );
+    return collectMatchingFiles<HardLinkedFile>( subtree );
 }
 
 
-void OldFilesTreeWalker::prepare( FileInfo * subtree )
+FileInfoList SparseFilesTreeWalker::collectMatches( FileInfo * subtree )
 {
-    FileMTimeStats stats( subtree );
-    _threshold = (time_t) lowerPercentileThreshold( stats );
+    return collectMatchingFiles<SparseFile>( subtree );
 }
 
 
@@ -104,3 +428,19 @@ bool BrokenSymLinksTreeWalker::check( FileInfo * item )
         item->isSymLink() &&
         SysUtil::isBrokenSymLink( item->url() );
 }
+
+
+bool PredicateTreeWalker::prepareFromIndex( const FileRangeIndex * /* index */,
+                                            FileInfo *             subtree )
+{
+    if ( _predicate.usesCategories() && subtree && subtree->tree() )
+    {
+        MimeCategorizer * categorizer = MimeCategorizer::instance();
+        DirTree *         tree        = subtree->tree();
+
+        if ( tree->categoryGeneration() != categorizer->generation() )
+            tree->clearCategoryIds( categorizer->generation() );
+    }
+
+    return false;
+}
@@ -10,12 +10,15 @@
 #ifndef TreeWalker_h
 #define TreeWalker_h
 
+#include <QAtomicInt>
+
 #include "FileInfo.h"
+#include "FilePredicate.h"
 
 
 namespace QDirStat
 {
-    class PercentileStats;
+    class FileRangeIndex;
 
 
     /**
@@ -31,12 +34,18 @@ namespace QDirStat
      *   - files with multiple hard links
      *   - broken symlinks
      *   - sparse files
+     *   - candidates for duplicate files
+     *   - files that may share extents with others
+     *
+     * A TreeWalkerRunner calls prepare() and check() in several threads, so
+     * check() must not change the TreeWalker, and it must be safe to call it
+     * in parallel unless checkIsThreadSafe() returns 'false'.
      **/
     class TreeWalker
     {
     public:
 
-        TreeWalker() {}
+        TreeWalker(): _cancelled( 0 ) {}
         virtual ~TreeWalker() {}
 
         /**
@@ -51,6 +60,20 @@ namespace QDirStat
          **/
         virtual void prepare( FileInfo * /* subtree */ ) {}
 
+        /**
+         * Find all matching items in 'subtree' with 'index' instead of
+         * walking the tree. Return 'true' if that was possible; results()
+         * then returns them. Return 'false' if the tree needs to be walked.
+         *
+         * This is called in the GUI thread since the index may change
+         * when items are deleted.
+         *
+         * This default implementation returns 'false'.
+         **/
+        virtual bool prepareFromIndex( const FileRangeIndex * /* index   */,
+                                       FileInfo *             /* subtree */ )
+            { return false; }
+
         /**
          * Check if 'item' fits into the category (largest / newest / oldest
          * file etc.). Return 'true' if it fits, 'false' if not.
@@ -59,95 +82,271 @@ namespace QDirStat
          **/
         virtual bool check( FileInfo * item ) = 0;
 
-    protected:
+        /**
+         * Return 'true' if check() may be called for several items in
+         * parallel, 'false' if it must only be called in one thread at a
+         * time.
+         *
+         * This default implementation returns 'true'.
+         **/
+        virtual bool checkIsThreadSafe() const { return true; }
+
+        /**
+         * Return 'true' if no item in the subtree of directory 'dir' can
+         * fit into the category, so the subtree is not walked at all. The
+         * same restrictions as for check() apply.
+         *
+         * This default implementation returns 'false'.
+         **/
+        virtual bool skipSubtree( FileInfo * /* dir */ ) { return false; }
+
+        /**
+         * Request to stop prepare() or a TreeWalkerRunner using this
+         * TreeWalker as soon as possible. This may be called from any
+         * thread.
+         **/
+        void cancel() { _cancelled.storeRelease( 1 ); }
+
+        /**
+         * Reset the cancel request from cancel().
+         **/
+        void resetCancelled() { _cancelled.storeRelease( 0 ); }
+
+        /**
+         * Return 'true' if cancel() was called.
+         **/
+        bool cancelled() const { return _cancelled.loadAcquire() != 0; }
 
         /**
-         * Calculate a data value threshold from a set of PercentileStats from
-         * an upper percentile up to the maximum value (P100).
+         * Return the complete list of matching items if prepare() already
+         * found all of them, so there is no need to walk the tree again
+         * and call check() for each item. Return 0 if it didn't.
+         *
+         * This default implementation returns 0.
          **/
-        qreal upperPercentileThreshold( PercentileStats & stats );
+        virtual const FileInfoList * results() const { return 0; }
+
+    protected:
 
         /**
-         * Calculate a data value threshold from a set of PercentileStats from
-         * an the minimum value (P0) to a lower percentile.
+         * Return the number of results to find among 'dataSize' items for
+         * the walkers that find the items with the highest or lowest values:
+         * A percentage of the items that depends on their number, but not
+         * more than a fixed number.
          **/
-        qreal lowerPercentileThreshold( PercentileStats & stats );
+        int maxResults( int dataSize ) const;
+
+
+        QAtomicInt _cancelled;
 
     };  // class TreeWalker
 
 
     /**
-     * TreeWalker to find the largest files.
+     * Abstract base class for TreeWalkers that find the files with the
+     * highest value of a sort key (e.g. the largest files).
+     *
+     * prepare() walks the tree once (in several threads for large trees)
+     * and keeps the files with the highest keys in heaps of bounded size, so
+     * this needs only one pass through the tree and no sorting of all files;
+     * the result is available with results().
+     *
+     * That walk uses an InlineCollector with the key of the derived class
+     * (see collectTop()), so there is no virtual call for each file, and
+     * subtrees whose summary values show that none of their files can get
+     * into the results any more are skipped.
      **/
-    class LargestFilesTreeWalker: public TreeWalker
+    class TopFilesTreeWalker: public TreeWalker
     {
     public:
 
+        TopFilesTreeWalker():
+            TreeWalker(),
+            _threshold( 0 )
+            {}
+
         /**
-         * Find the threshold for what is considered a "large file".
+         * Find the files with the highest keys in 'subtree'.
          **/
         virtual void prepare( FileInfo * subtree );
 
+        /**
+         * Find the files with the highest keys in 'subtree' with 'index'.
+         **/
+        virtual bool prepareFromIndex( const FileRangeIndex * index,
+                                       FileInfo *             subtree );
+
+        /**
+         * Return 'true' if 'item' is a file with a key that is at least as
+         * high as the lowest key of the results.
+         **/
         virtual bool check( FileInfo * item )
-            { return item && item->isFile() && item->size() >= _threshold; }
+            { return item && item->isFile() && key( item ) >= _threshold; }
+
+        /**
+         * Return the files found in prepare(), the one with the highest key
+         * first.
+         **/
+        virtual const FileInfoList * results() const { return &_results; }
+
+        /**
+         * Return the sort key of 'item'. Derived classes are required to
+         * implement this.
+         **/
+        virtual qint64 key( FileInfo * item ) const = 0;
 
     protected:
 
-        FileSize _threshold;
+        /**
+         * Return the 'count' files with the highest keys in 'subtree', the
+         * one with the highest key first. Derived classes are required to
+         * implement this, usually with collectTopFiles().
+         **/
+        virtual FileInfoList collectTop( FileInfo * subtree, int count ) = 0;
+
+        /**
+         * Implementation of collectTop() for 'Key', a class with the static
+         * methods
+         *
+         *   qint64 key( FileInfo * file )
+         *   qint64 maxKeyBelow( FileInfo * dir )
+         *
+         * where maxKeyBelow() returns the highest key that any file in the
+         * subtree of 'dir' can have according to its summary values.
+         **/
+        template<class Key>
+        FileInfoList collectTopFiles( FileInfo * subtree, int count );
+
+        /**
+         * Return the 'count' files with the highest keys in 'subtree' from
+         * 'index'. Derived classes are required to implement this.
+         **/
+        virtual FileInfoList indexResults( const FileRangeIndex * index,
+                                           int                    count,
+                                           FileInfo *             subtree ) const = 0;
+
+        /**
+         * Set the results and the threshold for check() from them.
+         **/
+        void setResults( const FileInfoList & results );
+
+
+        FileInfoList _results;
+        qint64       _threshold;
     };
 
 
     /**
-     * TreeWalker to find new files.
+     * TreeWalker to find the largest files.
      **/
-    class NewFilesTreeWalker: public TreeWalker
+    class LargestFilesTreeWalker: public TopFilesTreeWalker
     {
-    public:
+    protected:
 
-        /**
-         * Find the threshold for what is considered a "new file".
-         **/
-        virtual void prepare( FileInfo * subtree );
+        virtual qint64 key( FileInfo * item ) const
+            { return item->size(); }
+
+        virtual FileInfoList collectTop( FileInfo * subtree, int count );
+
+        virtual FileInfoList indexResults( const FileRangeIndex * index,
+                                           int                    count,
+                                           FileInfo *             subtree ) const;
+    };
 
-        virtual bool check( FileInfo * item )
-            { return item && item->isFile() && item->mtime() >= _threshold; }
 
+    /**
+     * TreeWalker to find new files.
+     **/
+    class NewFilesTreeWalker: public TopFilesTreeWalker
+    {
     protected:
 
-        time_t _threshold;
+        virtual qint64 key( FileInfo * item ) const
+            { return item->mtime(); }
+
+        virtual FileInfoList collectTop( FileInfo * subtree, int count );
+
+        virtual FileInfoList indexResults( const FileRangeIndex * index,
+                                           int                    count,
+                                           FileInfo *             subtree ) const;
     };
 
 
     /**
      * TreeWalker to find old files.
      **/
-    class OldFilesTreeWalker: public TreeWalker
+    class OldFilesTreeWalker: public TopFilesTreeWalker
+    {
+    protected:
+
+        virtual qint64 key( FileInfo * item ) const
+            { return -( (qint64) item->mtime() ); }
+
+        virtual FileInfoList collectTop( FileInfo * subtree, int count );
+
+        virtual FileInfoList indexResults( const FileRangeIndex * index,
+                                           int                    count,
+                                           FileInfo *             subtree ) const;
+    };
+
+
+    /**
+     * Abstract base class for TreeWalkers that find all files that fulfil
+     * a simple condition: prepare() finds them with an InlineCollector
+     * (see collectMatches()), so the condition is checked right in the
+     * loop over the tree instead of with a virtual check() call for each
+     * item; the result is available with results().
+     **/
+    class MatchingFilesTreeWalker: public TreeWalker
     {
     public:
 
         /**
-         * Find the threshold for what is considered an "old file".
+         * Find the matching files in 'subtree'.
          **/
         virtual void prepare( FileInfo * subtree );
 
-        virtual bool check( FileInfo * item )
-            { return item && item->isFile() && item->mtime() <= _threshold; }
+        /**
+         * Return the files found in prepare().
+         **/
+        virtual const FileInfoList * results() const { return &_results; }
 
     protected:
 
-        time_t _threshold;
+        /**
+         * Return all matching files in 'subtree'. Derived classes are
+         * required to implement this, usually with collectMatches().
+         **/
+        virtual FileInfoList collectMatches( FileInfo * subtree ) = 0;
+
+        /**
+         * Implementation of collectMatches() for 'Predicate', a class
+         * with a static method
+         *
+         *   bool matches( FileInfo * file )
+         *
+         * that is only called for regular files.
+         **/
+        template<class Predicate>
+        FileInfoList collectMatchingFiles( FileInfo * subtree );
+
+        FileInfoList _results;
     };
 
 
     /**
      * TreeWalker to find files with multiple hard links.
      **/
-    class HardLinkedFilesTreeWalker: public TreeWalker
+    class HardLinkedFilesTreeWalker: public MatchingFilesTreeWalker
     {
     public:
 
         virtual bool check( FileInfo * item )
             { return item && item->isFile() && item->links() > 1; }
+
+    protected:
+
+        virtual FileInfoList collectMatches( FileInfo * subtree );
     };
 
 
@@ -159,18 +358,54 @@ namespace QDirStat
     public:
 
         virtual bool check( FileInfo * item );
+
+        /**
+         * SysUtil::isBrokenSymLink() changes the current directory of the
+         * process.
+         **/
+        virtual bool checkIsThreadSafe() const { return false; }
     };
 
 
     /**
      * TreeWalker to find sparse files.
      **/
-    class SparseFilesTreeWalker: public TreeWalker
+    class SparseFilesTreeWalker: public MatchingFilesTreeWalker
     {
     public:
 
         virtual bool check( FileInfo * item )
             { return item && item->isFile() && item->isSparseFile(); }
+
+    protected:
+
+        virtual FileInfoList collectMatches( FileInfo * subtree );
+    };
+
+
+    /**
+     * TreeWalker to find the candidates for duplicate files, i.e. all
+     * non-empty files. See DuplicateFilesFinder.
+     **/
+    class DuplicateCandidatesTreeWalker: public TreeWalker
+    {
+    public:
+
+        virtual bool check( FileInfo * item )
+            { return item && item->isFile() && item->rawByteSize() > 0; }
+    };
+
+
+    /**
+     * TreeWalker to find the files that may share extents with others,
+     * i.e. all files that have any disk blocks. See SharedExtentsScanner.
+     **/
+    class SharedExtentsTreeWalker: public TreeWalker
+    {
+    public:
+
+        virtual bool check( FileInfo * item )
+            { return item && item->isFile() && item->blocks() > 0; }
     };
 
 
@@ -183,15 +418,24 @@ namespace QDirStat
 
         FilesFromYearTreeWalker( short year ):
             TreeWalker(),
-            _year( year )
+            _year( year ),
+            _fromIndex( false )
             {}
 
+        virtual bool prepareFromIndex( const FileRangeIndex * index,
+                                       FileInfo *             subtree );
+
         virtual bool check( FileInfo * item )
             { return item && item->isFile() && item->mtimeYear() == _year; }
 
+        virtual const FileInfoList * results() const
+            { return _fromIndex ? &_results : 0; }
+
     protected:
 
-        short _year;
+        short        _year;
+        bool         _fromIndex;
+        FileInfoList _results;
     };
 
 
@@ -205,9 +449,13 @@ namespace QDirStat
         FilesFromMonthTreeWalker( short year, short month ):
             TreeWalker(),
             _year( year ),
-            _month( month )
+            _month( month ),
+            _fromIndex( false )
             {}
 
+        virtual bool prepareFromIndex( const FileRangeIndex * index,
+                                       FileInfo *             subtree );
+
         virtual bool check( FileInfo * item )
             {
                 return item && item->isFile()
@@ -215,10 +463,50 @@ namespace QDirStat
                     && item->mtimeMonth() == _month;
             }
 
+        virtual const FileInfoList * results() const
+            { return _fromIndex ? &_results : 0; }
+
+    protected:
+
+        short        _year;
+        short        _month;
+        bool         _fromIndex;
+        FileInfoList _results;
+    };
+
+
+
+    /**
+     * TreeWalker to find the files that match a FilePredicate, e.g.
+     * "size > 1G and mtime < 2020". Subtrees where the predicate can't
+     * match anything (see FilePredicate::mayMatchBelow()) are skipped.
+     **/
+    class PredicateTreeWalker: public TreeWalker
+    {
+    public:
+
+        PredicateTreeWalker( const FilePredicate & predicate ):
+            TreeWalker(),
+            _predicate( predicate )
+            {}
+
+        /**
+         * This never uses the index, but it is the last chance to update
+         * the categories cached in the items in the GUI thread before the
+         * tree is walked in other threads.
+         **/
+        virtual bool prepareFromIndex( const FileRangeIndex * index,
+                                       FileInfo *             subtree );
+
+        virtual bool check( FileInfo * item )
+            { return _predicate.matches( item ); }
+
+        virtual bool skipSubtree( FileInfo * dir )
+            { return ! _predicate.mayMatchBelow( dir ); }
+
     protected:
 
-        short _year;
-        short _month;
+        FilePredicate _predicate;
     };
 
 }       // namespace QDirStat
@@ -0,0 +1,139 @@
+/*
+ *   File name: TreeWalkerRunner.cpp
+ *   Summary:	QDirStat helper class to walk a FileInfo tree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "TreeWalkerRunner.h"
+#include "TreeWalker.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+TreeWalkerCollector::TreeWalkerCollector( TreeWalker * walker ):
+    SubtreeCollector(),
+    _walker( walker )
+{
+    CHECK_PTR( _walker );
+}
+
+
+void TreeWalkerCollector::collect( FileInfo * subtree )
+{
+    if ( ! subtree )
+        return;
+
+    if ( _walker->checkIsThreadSafe() )
+    {
+        collectSubtree( subtree );
+    }
+    else
+    {
+        if ( subtree->isFile() )
+            collectFile( subtree );
+        else
+            collectRecursive( subtree );
+    }
+}
+
+
+SubtreeCollector * TreeWalkerCollector::createPartial() const
+{
+    return new TreeWalkerCollector( _walker );
+}
+
+
+void TreeWalkerCollector::collectFile( FileInfo * file )
+{
+    if ( _walker->check( file ) )
+        _results << file;
+}
+
+
+void TreeWalkerCollector::collectOther( FileInfo * item )
+{
+    if ( _walker->check( item ) )
+        _results << item;
+}
+
+
+void TreeWalkerCollector::merge( SubtreeCollector * rawPartial )
+{
+    TreeWalkerCollector * partial = dynamic_cast<TreeWalkerCollector *>( rawPartial );
+    CHECK_DYNAMIC_CAST( partial, "TreeWalkerCollector" );
+
+    _results << partial->_results;
+}
+
+
+bool TreeWalkerCollector::cancelled() const
+{
+    return _walker->cancelled();
+}
+
+
+bool TreeWalkerCollector::skipSubtree( FileInfo * dir )
+{
+    return _walker->skipSubtree( dir );
+}
+
+
+
+
+TreeWalkerRunner::TreeWalkerRunner( TreeWalker * walker, FileInfo * subtree ):
+    QThread(),
+    _walker( walker ),
+    _subtree( subtree )
+{
+    CHECK_PTR( _walker );
+    _walker->resetCancelled();
+}
+
+
+TreeWalkerRunner::~TreeWalkerRunner()
+{
+    cancel();
+    wait();
+}
+
+
+void TreeWalkerRunner::cancel()
+{
+    _walker->cancel();
+}
+
+
+bool TreeWalkerRunner::cancelled() const
+{
+    return _walker->cancelled();
+}
+
+
+void TreeWalkerRunner::run()
+{
+    _walker->prepare( _subtree );
+
+    if ( _walker->cancelled() )
+        return;
+
+    if ( _walker->results() )
+    {
+        _results = *_walker->results();
+    }
+    else
+    {
+        TreeWalkerCollector collector( _walker );
+        collector.collect( _subtree );
+
+        if ( ! _walker->cancelled() )
+            _results = collector.results();
+    }
+
+    logDebug() << _results.size() << " results" << endl;
+}
@@ -0,0 +1,125 @@
+/*
+ *   File name: TreeWalkerRunner.h
+ *   Summary:	QDirStat helper class to walk a FileInfo tree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TreeWalkerRunner_h
+#define TreeWalkerRunner_h
+
+#include <QThread>
+
+#include "FileInfo.h"
+#include "SubtreeCollector.h"
+
+
+namespace QDirStat
+{
+    class TreeWalker;
+
+
+    /**
+     * Collector for all items in a subtree where TreeWalker::check() returns
+     * 'true'. Only items without children are checked; all TreeWalkers only
+     * look for files or symlinks anyway.
+     *
+     * Each thread collects its results into a list of its own, so there is
+     * no need for any locking; the lists are simply appended when the
+     * threads are finished.
+     **/
+    class TreeWalkerCollector: public SubtreeCollector
+    {
+    public:
+
+        /**
+         * Constructor.
+         **/
+        TreeWalkerCollector( TreeWalker * walker );
+
+        /**
+         * Collect all items in 'subtree' where the TreeWalker's check() returns 'true'. This uses several
+         * threads unless the TreeWalker's check() is not thread-safe.
+         **/
+        void collect( FileInfo * subtree );
+
+        /**
+         * Return the results.
+         **/
+        const FileInfoList & results() const { return _results; }
+
+    protected:
+
+        virtual SubtreeCollector * createPartial() const Q_DECL_OVERRIDE;
+        virtual void collectFile ( FileInfo * file ) Q_DECL_OVERRIDE;
+        virtual void collectOther( FileInfo * item ) Q_DECL_OVERRIDE;
+        virtual void merge( SubtreeCollector * partial ) Q_DECL_OVERRIDE;
+        virtual bool cancelled() const Q_DECL_OVERRIDE;
+        virtual bool skipSubtree( FileInfo * dir ) Q_DECL_OVERRIDE;
+
+
+        TreeWalker * _walker;
+        FileInfoList _results;
+    };
+
+
+    /**
+     * Thread to run a TreeWalker over a subtree without blocking the thread
+     * that started it: This first calls the TreeWalker's prepare() and then
+     * collects all matching items with a TreeWalkerCollector (in several
+     * more threads) unless prepare() already found them.
+     *
+     * When finished, the QThread::finished() signal is emitted and the
+     * results are available with results().
+     *
+     * The tree must not change while this thread is running. Use cancel()
+     * and wait() before any change to the tree.
+     **/
+    class TreeWalkerRunner: public QThread
+    {
+    public:
+
+        /**
+         * Constructor. This does not take over ownership of 'walker'.
+         **/
+        TreeWalkerRunner( TreeWalker * walker, FileInfo * subtree );
+
+        /**
+         * Destructor. This cancels the thread and waits for it.
+         **/
+        virtual ~TreeWalkerRunner();
+
+        /**
+         * Request the thread to stop as soon as possible. This returns
+         * immediately; use wait() to wait until it is stopped.
+         **/
+        void cancel();
+
+        /**
+         * Return 'true' if cancel() was called.
+         **/
+        bool cancelled() const;
+
+        /**
+         * Return the results. Use this only after the thread is finished
+         * and only if it was not cancelled.
+         **/
+        const FileInfoList & results() const { return _results; }
+
+    protected:
+
+        /**
+         * Reimplemented from QThread.
+         **/
+        virtual void run() Q_DECL_OVERRIDE;
+
+        TreeWalker * _walker;
+        FileInfo *   _subtree;
+        FileInfoList _results;
+    };
+
+}       // namespace QDirStat
+
+#endif  // TreeWalkerRunner_h
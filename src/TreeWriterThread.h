@@ -0,0 +1,71 @@
+/*
+ *   File name: TreeWriterThread.h
+ *   Summary:	Base class for writing a DirTree in a background thread
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TreeWriterThread_h
+#define TreeWriterThread_h
+
+
+#include <QThread>
+#include <QString>
+
+
+namespace QDirStat
+{
+    class DirTree;
+
+    /**
+     * Abstract base class for threads that write a complete DirTree to a
+     * file in the background, like CacheWriterThread and
+     * TreeExporterThread. DirTree::startWriting() starts them and makes
+     * sure the tree does not change while they are running.
+     *
+     * Derived classes prepare the tree in their constructor (in the thread
+     * that owns the tree) so that run() only needs to read it.
+     **/
+    class TreeWriterThread: public QThread
+    {
+    public:
+
+	/**
+	 * Return the name of the file that is written.
+	 **/
+	virtual QString fileName() const = 0;
+
+	/**
+	 * Return the number of items written so far. This may be called
+	 * from any thread.
+	 **/
+	virtual int itemsWritten() const = 0;
+
+	/**
+	 * Abort writing as soon as possible. This may be called from any
+	 * thread.
+	 **/
+	virtual void abort() = 0;
+
+	/**
+	 * Return 'true' if writing was successful. This is only meaningful
+	 * when the thread is finished.
+	 **/
+	virtual bool ok() const = 0;
+
+	/**
+	 * Apply any changes to 'tree' that had to wait until writing was
+	 * finished. This is called in the thread that owns the tree after
+	 * this thread is finished.
+	 *
+	 * This default implementation does nothing.
+	 **/
+	virtual void updateTree( DirTree * tree ) { Q_UNUSED( tree ); }
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef TreeWriterThread_h
@@ -0,0 +1,475 @@
+/*
+ *   File name: TreemapLayout.cpp
+ *   Summary:	Treemap layout for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <algorithm>
+
+#include "TreemapLayout.h"
+#include "TreemapView.h"
+#include "DirInfo.h"
+#include "FileInfoIterator.h"
+#include "Exception.h"
+#include "Logger.h"
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Sort order for sortedChildren(): By size, the largest first.
+     **/
+    bool largerChild( const TreemapLayoutChild & a, const TreemapLayoutChild & b )
+    {
+	return a.size > b.size;
+    }
+
+}	// namespace
+
+
+TreemapLayout::TreemapLayout( TreemapView *  view,
+			      FileInfo *     root,
+			      const QRectF & rect ):
+    QThread(),
+    _root( root ),
+    _rect( rect ),
+    _rootOrientation( TreemapAuto ),
+    _squarify( view->squarify() ),
+    _minTileSize( view->minTileSize() ),
+    _heightScaleFactor( view->heightScaleFactor() ),
+    _maxDepth( 0 ),
+    _maxItems( 0 ),
+    _cancelled( 0 )
+{
+}
+
+
+void TreemapLayout::setLimits( int levels, int maxItems )
+{
+    _maxDepth = levels;
+    _maxItems = maxItems;
+}
+
+
+void TreemapLayout::setRootSurface( const CushionSurface & parentSurface,
+				    Orientation		   orientation )
+{
+    _rootSurface     = parentSurface;
+    _rootOrientation = orientation;
+}
+
+
+bool TreemapLayout::atLimit() const
+{
+    return isCancelled() || ( _maxItems > 0 && _items.size() >= _maxItems );
+}
+
+
+bool TreemapLayout::matches( TreemapView *  view,
+			     FileInfo *	    root,
+			     const QRectF & rect ) const
+{
+    return root			  == _root		&&
+	rect.size()		  == _rect.size()	&&
+	view->squarify()	  == _squarify		&&
+	view->minTileSize()	  == _minTileSize	&&
+	view->heightScaleFactor() == _heightScaleFactor &&
+	! isCoarse() && ! isCancelled();
+}
+
+
+void TreemapLayout::run()
+{
+    layout();
+}
+
+
+void TreemapLayout::layout()
+{
+    _items.clear();
+
+    if ( _root )
+	addItem( -1, _root, _rect, _rootSurface, _rootOrientation );
+
+    // logDebug() << _items.size() << " tiles for " << _root
+    //		  << ( isCancelled() ? " (cancelled)" : "" ) << endl;
+}
+
+
+int TreemapLayout::addItem( int			   parent,
+			    FileInfo *		   orig,
+			    const QRectF &	   rect,
+			    const CushionSurface & cushionSurface,
+			    Orientation		   orientation )
+{
+    TreemapLayoutItem item;
+    item.orig		= orig;
+    item.rect		= rect;
+    item.cushionSurface = cushionSurface;
+    item.parentSurface	= cushionSurface;
+    item.orientation	= orientation;
+    item.parent		= parent;
+    item.depth		= parent >= 0 ? _items.at( parent ).depth + 1 : 0;
+
+    _items << item;
+    int index = _items.size() - 1;
+
+    createChildren( index, orientation );
+
+    return index;
+}
+
+
+void TreemapLayout::createChildren( int index, Orientation orientation )
+{
+    if ( atLimit() )
+	return;
+
+    if ( _maxDepth > 0 && _items.at( index ).depth >= _maxDepth )
+	return;
+
+    FileInfo * orig = _items.at( index ).orig;
+
+    if ( orig->nodeTotalAllocatedSize() == 0 )	// Prevent division by zero
+	return;
+
+    // The children of a cache placeholder are not read from the cache file
+    // yet. That is only worthwhile if the treemap is zoomed in to this
+    // directory, which the TreemapView takes care of.
+
+    if ( orig->isDirNode() && orig->nodeDirInfo()->isCachePlaceholder() )
+	return;
+
+    if ( _squarify )
+	createSquarifiedChildren( index );
+    else
+	createChildrenSimple( index, orientation );
+}
+
+
+void TreemapLayout::createChildrenSimple( int index, Orientation orientation )
+{
+    QRectF	rect	 = _items.at( index ).rect;
+    FileInfo *	orig	 = _items.at( index ).orig;
+    Orientation dir	 = orientation;
+    Orientation childDir = orientation;
+
+    if ( dir == TreemapAuto )
+	dir = rect.width() > rect.height() ? TreemapHorizontal : TreemapVertical;
+
+    if ( orientation == TreemapHorizontal )  childDir = TreemapVertical;
+    if ( orientation == TreemapVertical	  )  childDir = TreemapHorizontal;
+
+    int offset	 = 0;
+    int size	 = dir == TreemapHorizontal ? rect.width() : rect.height();
+    int count	 = 0;
+    double scale = (double) size / (double) orig->nodeTotalAllocatedSize();
+
+    CushionSurface & parentSurface = _items[ index ].cushionSurface;
+    parentSurface.addRidge( childDir, parentSurface.height(), rect );
+
+    // Copy it: Adding items may move the array
+    CushionSurface cushionSurface = parentSurface;
+
+    FileSize minSize = (FileSize) ( _minTileSize / scale );
+    TreemapLayoutChildList children;
+    sortedChildren( orig, minSize, children );
+
+    for ( int i = 0; i < children.size() && ! atLimit(); ++i )
+    {
+	int childSize = 0;
+
+	childSize = (int) ( scale * children.at( i ).size );
+
+	if ( childSize >= _minTileSize )
+	{
+	    QRectF childRect;
+
+	    if ( dir == TreemapHorizontal )
+		childRect = QRectF( rect.x() + offset, rect.y(), childSize, rect.height() );
+	    else
+		childRect = QRectF( rect.x(), rect.y() + offset, rect.width(), childSize );
+
+	    int child = addItem( index, children.at( i ).orig, childRect, cushionSurface, childDir );
+
+	    _items[ child ].cushionSurface.addRidge( dir,
+						     cushionSurface.height() * _heightScaleFactor,
+						     childRect );
+	    offset += childSize;
+	}
+
+	++count;
+    }
+}
+
+
+void TreemapLayout::createSquarifiedChildren( int index )
+{
+    QRectF     rect = _items.at( index ).rect;
+    FileInfo * orig = _items.at( index ).orig;
+
+    if ( orig->nodeTotalAllocatedSize() == 0 )
+    {
+	logError()  << "Zero totalAllocatedSize()" << endl;
+	return;
+    }
+
+    double scale	= rect.width() * (double) rect.height() / orig->nodeTotalAllocatedSize();
+    FileSize minSize	= (FileSize) ( _minTileSize / scale );
+
+    // Each child's size is taken only once, and the sum of any row is just
+    // the difference of two prefix sums
+
+    TreemapLayoutChildList children;
+    sortedChildren( orig, minSize, children );
+
+    QVector<FileSize> sums( children.size() + 1 );
+    sums[ 0 ] = 0;
+
+    for ( int i = 0; i < children.size(); ++i )
+	sums[ i + 1 ] = sums.at( i ) + children.at( i ).size;
+
+    QRectF childrenRect = rect;
+    int	   begin	= 0;
+
+    while ( begin < children.size() && ! atLimit() )
+    {
+	int end = squarify( childrenRect, scale, children, sums, begin );
+
+	if ( end > begin )
+	{
+	    childrenRect = layoutRow( index, childrenRect, scale, children,
+				      begin, end, sums.at( end ) - sums.at( begin ) );
+	}
+	else	// Prevent an endless loop: Skip this child
+	{
+	    end = begin + 1;
+	}
+
+	begin = end;
+    }
+}
+
+
+void TreemapLayout::sortedChildren( FileInfo		   * orig,
+				    FileSize		     minSize,
+				    TreemapLayoutChildList & children_ret ) const
+{
+    children_ret.reserve( orig->directChildrenCount() );
+    FileInfoIterator it( orig );
+
+    while ( *it )
+    {
+	TreemapLayoutChild child;
+	child.size = (*it)->nodeTotalAllocatedSize();
+	child.orig = *it;
+
+	if ( child.size >= minSize )
+	    children_ret << child;
+
+	++it;
+    }
+
+    std::stable_sort( children_ret.begin(), children_ret.end(), largerChild );
+}
+
+
+int TreemapLayout::squarify( const QRectF		  & rect,
+			     double			    scale,
+			     const TreemapLayoutChildList & children,
+			     const QVector<FileSize>	  & sums,
+			     int			    begin )
+{
+    // logDebug() << "squarify() " << this << " " << rect << endl;
+
+    int length = qMax( rect.width(), rect.height() );
+
+    if ( length == 0 )	// Sanity check
+    {
+	logWarning()  << "Zero length" << endl;
+	return begin;
+    }
+
+    double lastWorstAspectRatio = -1.0;
+    int	   end			= begin;
+
+    // This is a bit ugly, but doing all calculations in the 'size' dimension
+    // is more efficient here since that requires only one scaling before
+    // doing all other calculations in the loop.
+    const double scaledLengthSquare = length * (double) length / scale;
+
+    while ( end < children.size() )
+    {
+	FileSize size = children.at( end ).size;
+	double	 sum  = sums.at( end + 1 ) - sums.at( begin );
+
+	if ( end > begin && sum != 0 && size != 0 )
+	{
+	    double sumSquare	    = sum * sum;
+	    double worstAspectRatio = qMax( scaledLengthSquare * children.at( begin ).size / sumSquare,
+					    sumSquare / ( scaledLengthSquare * size ) );
+
+	    if ( lastWorstAspectRatio >= 0.0 &&
+		 worstAspectRatio > lastWorstAspectRatio )
+	    {
+		// logDebug() << "Getting worse after adding " << children.at( end ).orig << endl;
+		break;
+	    }
+
+	    lastWorstAspectRatio = worstAspectRatio;
+	}
+
+	++end;
+    }
+
+    return end;
+}
+
+
+QRectF TreemapLayout::layoutRow( int			      index,
+				 const QRectF		    & rect,
+				 double			      scale,
+				 const TreemapLayoutChildList & children,
+				 int			      begin,
+				 int			      end,
+				 FileSize		      rowSum )
+{
+    if ( begin >= end )
+	return rect;
+
+    // Determine the direction in which to subdivide.
+    // We always use the longer side of the rectangle.
+    Orientation dir = rect.width() > rect.height() ? TreemapHorizontal : TreemapVertical;
+
+    // This row's primary length is the longer one.
+    int primary = qMax( rect.width(), rect.height() );
+
+    // This row's secondary length is determined by the area (the number of
+    // pixels) to be allocated for all of the row's items.
+
+    FileSize sum = rowSum;
+    int secondary = (int) ( sum * scale / primary );
+
+    if ( sum == 0 )	// Prevent division by zero.
+	return rect;
+
+    if ( secondary < _minTileSize )	// We don't want tiles that small.
+	return rect;
+
+
+    // Set up a cushion surface for this layout row:
+    // Add another ridge perpendicular to the row's direction
+    // that optically groups this row's tiles together.
+
+    CushionSurface rowCushionSurface = _items.at( index ).cushionSurface;
+
+    rowCushionSurface.addRidge( dir == TreemapHorizontal ? TreemapVertical : TreemapHorizontal,
+				rowCushionSurface.height() * _heightScaleFactor,
+				rect );
+
+    int offset = 0;
+    int remaining = primary;
+
+    for ( int i = begin; i < end; ++i )
+    {
+	int childSize = (int) ( children.at( i ).size / (double) sum * primary + 0.5 );
+
+	if ( childSize > remaining )	// Prevent overflow because of accumulated rounding errors
+	    childSize = remaining;
+
+	remaining -= childSize;
+
+	if ( childSize >= _minTileSize )
+	{
+	    QRectF childRect;
+
+	    if ( dir == TreemapHorizontal )
+		childRect = QRectF( rect.x() + offset, rect.y(), childSize, secondary );
+	    else
+		childRect = QRectF( rect.x(), rect.y() + offset, secondary, childSize );
+
+	    int child = addItem( index, children.at( i ).orig, childRect, rowCushionSurface, TreemapAuto );
+
+	    _items[ child ].cushionSurface.addRidge( dir,
+						     rowCushionSurface.height() * _heightScaleFactor,
+						     childRect );
+	    offset += childSize;
+	}
+    }
+
+
+    // Subtract the layouted area from the rectangle.
+
+    QRectF newRect;
+
+    if ( dir == TreemapHorizontal )
+	newRect = QRectF( rect.x(), rect.y() + secondary, rect.width(), rect.height() - secondary );
+    else
+	newRect = QRectF( rect.x() + secondary, rect.y(), rect.width() - secondary, rect.height() );
+
+    // logDebug() << "Left over:" << " " << newRect << " " << this << endl;
+
+    return newRect;
+}
+
+
+TreemapLayoutCache::TreemapLayoutCache( int maxLayouts ):
+    _maxLayouts( maxLayouts )
+{
+}
+
+
+TreemapLayoutCache::~TreemapLayoutCache()
+{
+    clear();
+}
+
+
+void TreemapLayoutCache::clear()
+{
+    qDeleteAll( _layouts );
+    _layouts.clear();
+}
+
+
+TreemapLayout * TreemapLayoutCache::find( TreemapView *	 view,
+					  FileInfo *	 root,
+					  const QRectF & rect )
+{
+    for ( int i = 0; i < _layouts.size(); ++i )
+    {
+	TreemapLayout * layout = _layouts.at( i );
+
+	if ( layout->matches( view, root, rect ) )
+	{
+	    _layouts.move( i, 0 );
+	    return layout;
+	}
+    }
+
+    return 0;
+}
+
+
+void TreemapLayoutCache::add( TreemapLayout * layout )
+{
+    if ( ! layout )
+	return;
+
+    if ( layout->isCoarse() || layout->isCancelled() || _maxLayouts < 1 )
+    {
+	delete layout;
+	return;
+    }
+
+    _layouts.removeAll( layout );
+    _layouts.prepend( layout );
+
+    while ( _layouts.size() > _maxLayouts )
+	delete _layouts.takeLast();
+}
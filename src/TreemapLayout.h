@@ -0,0 +1,331 @@
+/*
+ *   File name: TreemapLayout.h
+ *   Summary:	Treemap layout for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TreemapLayout_h
+#define TreemapLayout_h
+
+
+#include <QThread>
+#include <QVector>
+#include <QList>
+#include <QRectF>
+#include <QAtomicInt>
+
+#include "TreemapTile.h"
+
+
+namespace QDirStat
+{
+    class FileInfo;
+
+
+    /**
+     * One tile of a treemap layout.
+     **/
+    struct TreemapLayoutItem
+    {
+	FileInfo *	orig;
+	QRectF		rect;
+	CushionSurface	cushionSurface;
+	CushionSurface	parentSurface;	// as passed down from the parent
+	Orientation	orientation;	// for subdividing this item
+	int		parent;		// index of the parent item, -1 for the root
+	int		depth;		// 0 for the root
+    };
+
+
+    /**
+     * A child to be laid out with its size, so the layout does not need
+     * to ask the FileInfo for its size again and again.
+     **/
+    struct TreemapLayoutChild
+    {
+	FileSize   size;
+	FileInfo * orig;
+    };
+
+    typedef QVector<TreemapLayoutChild> TreemapLayoutChildList;
+
+
+    /**
+     * Layout of a treemap: The rectangles and cushion surfaces of all tiles
+     * as a plain array in the order in which the tiles are created, i.e.
+     * each parent before its children. The TreemapView creates the tiles
+     * from that.
+     *
+     * The layout can be computed in the calling thread with layout() or
+     * in a separate thread with start(); in that case, the tree must not
+     * change until the thread is finished. Cancelling only makes the
+     * thread stop early; the result is incomplete then.
+     **/
+    class TreemapLayout: public QThread
+    {
+    public:
+
+	/**
+	 * Constructor for a layout of the subtree of 'root' in 'rect' with
+	 * the layout parameters of 'view'.
+	 **/
+	TreemapLayout( TreemapView *  view,
+		       FileInfo *     root,
+		       const QRectF & rect );
+
+	/**
+	 * Limit the layout to 'levels' levels below the root and to about
+	 * 'maxItems' items for a coarse preview that is fast to compute no
+	 * matter how large the tree is. 0 means no limit.
+	 **/
+	void setLimits( int levels, int maxItems );
+
+	/**
+	 * Return 'true' if the layout is limited with setLimits().
+	 **/
+	bool isCoarse() const { return _maxDepth > 0 || _maxItems > 0; }
+
+	/**
+	 * Lay out the root like a child with 'parentSurface' and
+	 * 'orientation' from another layout rather than like the root of a
+	 * treemap. This is used to lay out a subtree again in the rectangle
+	 * of its existing tile; the cushion surfaces of all items below the
+	 * root are then the same as if the complete treemap was laid out.
+	 *
+	 * The root item's own cushion surface is not complete then; the
+	 * existing tile's surface should be used instead.
+	 **/
+	void setRootSurface( const CushionSurface & parentSurface,
+			     Orientation	    orientation );
+
+	/**
+	 * Compute the layout in the calling thread.
+	 **/
+	void layout();
+
+	/**
+	 * Stop computing the layout as soon as possible.
+	 * This may be called from any thread.
+	 **/
+	void cancel() { _cancelled.storeRelease( 1 ); }
+
+	/**
+	 * Return 'true' if cancel() was called.
+	 **/
+	bool isCancelled() const { return _cancelled.loadAcquire() != 0; }
+
+	/**
+	 * Return the root of the layout.
+	 **/
+	FileInfo * root() const { return _root; }
+
+	/**
+	 * Return the rectangle of the root.
+	 **/
+	const QRectF & rect() const { return _rect; }
+
+	/**
+	 * Return the layout items. The first one is the root.
+	 **/
+	const QVector<TreemapLayoutItem> & items() const { return _items; }
+
+	/**
+	 * Return 'true' if this is a complete layout of 'root' in a rectangle
+	 * with the size of 'rect' with the current layout parameters of
+	 * 'view', i.e. if it can be used instead of computing it again.
+	 **/
+	bool matches( TreemapView *  view,
+		      FileInfo *     root,
+		      const QRectF & rect ) const;
+
+
+    protected:
+
+	/**
+	 * Compute the layout in the thread.
+	 *
+	 * Reimplemented from QThread.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	/**
+	 * Add an item for 'orig' with 'rect' and 'cushionSurface' as a child
+	 * of item no. 'parent' and lay out its children. Return the index of
+	 * the new item.
+	 *
+	 * 'orientation' is the direction for further subdivision. 'Auto'
+	 * selects the wider direction inside 'rect'.
+	 **/
+	int addItem( int		    parent,
+		     FileInfo *		    orig,
+		     const QRectF &	    rect,
+		     const CushionSurface & cushionSurface,
+		     Orientation	    orientation );
+
+	/**
+	 * Return 'true' if no more items should be added because the layout
+	 * is cancelled or the limit from setLimits() is reached.
+	 **/
+	bool atLimit() const;
+
+	/**
+	 * Create the children of item no. 'index'.
+	 **/
+	void createChildren( int index, Orientation orientation );
+
+	/**
+	 * Create children (sub-tiles) using the simple treemap algorithm:
+	 * Alternate between horizontal and vertical subdivision in each
+	 * level. Each child will get the entire height or width, respectively,
+	 * of the specified rectangle. This algorithm is very fast, but often
+	 * results in very thin, elongated tiles.
+	 **/
+	void createChildrenSimple( int index, Orientation orientation );
+
+	/**
+	 * Create children using the "squarified treemaps" algorithm as
+	 * described by Mark Bruls, Kees Huizing, and Jarke J. van Wijk of the
+	 * TU Eindhoven, NL.
+	 *
+	 * This algorithm is not quite so simple and involves more expensive
+	 * operations, e.g., sorting the children of each node by size first,
+	 * try some variations of the layout and maybe backtrack to the
+	 * previous attempt. But it results in tiles that are much more
+	 * square-like, i.e. have more reasonable width-to-height ratios. It is
+	 * very much less likely to get thin, elongated tiles that are hard to
+	 * point at and even harder to compare visually against each other.
+	 *
+	 * This implementation includes some improvements to that basic
+	 * algorithm. For example, children below a certain size are
+	 * disregarded completely since they will not get an adequate visual
+	 * representation anyway (it would be way too small). They are
+	 * summarized in some kind of 'misc stuff' area in the parent treemap
+	 * tile - in fact, part of the parent directory's tile can be "seen
+	 * through".
+	 *
+	 * In short, a lot of small children that don't have any useful effect
+	 * for the user in finding wasted disk space are omitted from handling
+	 * and, most important, don't need to be sorted by size (which has a
+	 * cost of O(n*ln(n)) in the best case, so reducing n helps a lot).
+	 **/
+	void createSquarifiedChildren( int index );
+
+	/**
+	 * Return the children of 'orig' with a total allocated size of at
+	 * least 'minSize' in 'children_ret', sorted by that size in
+	 * descending order.
+	 **/
+	void sortedChildren( FileInfo		    * orig,
+			     FileSize		      minSize,
+			     TreemapLayoutChildList & children_ret ) const;
+
+	/**
+	 * Squarify as many children as possible: Try to squeeze the children
+	 * from no. 'begin' on into 'rect' until the aspect ratio doesn't get
+	 * better any more. Return the index after the last child of that
+	 * row, or 'begin' if 'rect' is empty.
+	 *
+	 * 'sums' are the prefix sums of the sizes of 'children', i.e.
+	 * sums[ i ] is the sum of the sizes of the first 'i' children.
+	 * 'scale' is the scaling factor between file sizes and pixels.
+	 **/
+	int squarify( const QRectF		   & rect,
+		      double			     scale,
+		      const TreemapLayoutChildList & children,
+		      const QVector<FileSize>	   & sums,
+		      int			     begin );
+
+	/**
+	 * Lay out the children from no. 'begin' to before no. 'end' with
+	 * the sum of their sizes 'rowSum' within 'rect' along its longer
+	 * side as children of item no. 'index'. Returns the new rectangle
+	 * with the layouted area subtracted.
+	 **/
+	QRectF layoutRow( int			       index,
+			  const QRectF		     & rect,
+			  double		       scale,
+			  const TreemapLayoutChildList & children,
+			  int			       begin,
+			  int			       end,
+			  FileSize		       rowSum );
+
+
+	// Data members
+
+	FileInfo *		   _root;
+	QRectF			   _rect;
+	CushionSurface		   _rootSurface;
+	Orientation		   _rootOrientation;
+	bool			   _squarify;
+	int			   _minTileSize;
+	double			   _heightScaleFactor;
+	int			   _maxDepth;
+	int			   _maxItems;
+	QAtomicInt		   _cancelled;
+	QVector<TreemapLayoutItem> _items;
+
+    };	// class TreemapLayout
+
+
+    /**
+     * Cache for the most recently used treemap layouts so zooming in and
+     * out or going back to a previous directory doesn't need to compute
+     * the layout again.
+     *
+     * A layout refers to the FileInfo nodes of the tree and to their sizes
+     * at the time it was computed, so the cache needs to be cleared
+     * whenever the tree changes.
+     **/
+    class TreemapLayoutCache
+    {
+    public:
+
+	/**
+	 * Constructor for a cache that keeps up to 'maxLayouts' layouts.
+	 **/
+	TreemapLayoutCache( int maxLayouts );
+
+	/**
+	 * Destructor. This deletes all cached layouts.
+	 **/
+	~TreemapLayoutCache();
+
+	/**
+	 * Return the cached layout that matches 'root', 'rect' and the
+	 * layout parameters of 'view' or 0 if there is none.
+	 **/
+	TreemapLayout * find( TreemapView *  view,
+			      FileInfo *     root,
+			      const QRectF & rect );
+
+	/**
+	 * Add a complete layout to the cache. The cache takes over
+	 * ownership, and it deletes the least recently used layout if it is
+	 * full. Coarse or cancelled layouts are deleted right away.
+	 **/
+	void add( TreemapLayout * layout );
+
+	/**
+	 * Delete all cached layouts.
+	 **/
+	void clear();
+
+	/**
+	 * Return 'true' if there are no cached layouts.
+	 **/
+	bool isEmpty() const { return _layouts.isEmpty(); }
+
+    protected:
+
+	QList<TreemapLayout *> _layouts;	// most recently used first
+	int		       _maxLayouts;
+
+    };	// class TreemapLayoutCache
+
+}	// namespace QDirStat
+
+
+#endif // ifndef TreemapLayout_h
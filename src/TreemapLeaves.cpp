@@ -0,0 +1,169 @@
+/*
+ *   File name: TreemapLeaves.cpp
+ *   Summary:	Compact storage of treemap file tiles for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <math.h>
+
+#include "TreemapLeaves.h"
+#include "Exception.h"
+#include "Logger.h"
+
+// Width and height of a cell of the spatial index in pixels
+#define CellSize	32
+
+
+using namespace QDirStat;
+
+
+TreemapLeaves::TreemapLeaves():
+    _cols( 0 ),
+    _rows( 0 )
+{
+}
+
+
+void TreemapLeaves::clear()
+{
+    _leaves.clear();
+    _cellStart.clear();
+    _cellLeaves.clear();
+    _cols = 0;
+    _rows = 0;
+}
+
+
+void TreemapLeaves::add( TreemapTile *		parentTile,
+			 FileInfo *		orig,
+			 const QRectF &		rect,
+			 const CushionSurface & cushionSurface )
+{
+    TreemapLeaf leaf;
+    leaf.rect		= rect;
+    leaf.orig		= orig;
+    leaf.parentTile	= parentTile;
+    leaf.tile		= 0;
+    leaf.cushionSurface = cushionSurface;
+
+    _leaves << leaf;
+    _cellStart.clear();
+}
+
+
+void TreemapLeaves::cellRange( const QRectF & rect,
+			       int	    & firstCol,
+			       int	    & lastCol,
+			       int	    & firstRow,
+			       int	    & lastRow ) const
+{
+    firstCol = qBound( 0, (int) floor( ( rect.left()   - _sceneRect.left() ) / CellSize ), _cols - 1 );
+    lastCol  = qBound( 0, (int) floor( ( rect.right()  - _sceneRect.left() ) / CellSize ), _cols - 1 );
+    firstRow = qBound( 0, (int) floor( ( rect.top()    - _sceneRect.top()  ) / CellSize ), _rows - 1 );
+    lastRow  = qBound( 0, (int) floor( ( rect.bottom() - _sceneRect.top()  ) / CellSize ), _rows - 1 );
+}
+
+
+void TreemapLeaves::buildIndex( const QRectF & sceneRect )
+{
+    _sceneRect = sceneRect;
+    _cols      = qMax( 1, (int) ceil( sceneRect.width()  / CellSize ) );
+    _rows      = qMax( 1, (int) ceil( sceneRect.height() / CellSize ) );
+
+    // First count the leaves in each cell, then store them in one array:
+    // The leaves of cell i are _cellLeaves[ _cellStart[i] ] until (not
+    // including) _cellLeaves[ _cellStart[i+1] ].
+
+    _cellStart.fill( 0, _cols * _rows + 1 );
+    int firstCol, lastCol, firstRow, lastRow;
+
+    foreach ( const TreemapLeaf & leaf, _leaves )
+    {
+	cellRange( leaf.rect, firstCol, lastCol, firstRow, lastRow );
+
+	for ( int row = firstRow; row <= lastRow; ++row )
+	{
+	    for ( int col = firstCol; col <= lastCol; ++col )
+		++_cellStart[ row * _cols + col + 1 ];
+	}
+    }
+
+    for ( int i = 1; i < _cellStart.size(); ++i )
+	_cellStart[i] += _cellStart[i-1];
+
+    _cellLeaves.resize( _cellStart.last() );
+    QVector<int> fill = _cellStart;
+
+    for ( int i = 0; i < _leaves.size(); ++i )
+    {
+	cellRange( _leaves.at( i ).rect, firstCol, lastCol, firstRow, lastRow );
+
+	for ( int row = firstRow; row <= lastRow; ++row )
+	{
+	    for ( int col = firstCol; col <= lastCol; ++col )
+		_cellLeaves[ fill[ row * _cols + col ]++ ] = i;
+	}
+    }
+
+    // logDebug() << _leaves.size() << " leaves in " << _cols << "x" << _rows
+    //		  << " cells with " << _cellLeaves.size() << " entries" << endl;
+}
+
+
+int TreemapLeaves::leafAt( const QPointF & pos ) const
+{
+    if ( _cellStart.isEmpty() || ! _sceneRect.contains( pos ) )
+	return -1;
+
+    int col  = qBound( 0, (int) ( ( pos.x() - _sceneRect.left() ) / CellSize ), _cols - 1 );
+    int row  = qBound( 0, (int) ( ( pos.y() - _sceneRect.top()  ) / CellSize ), _rows - 1 );
+    int cell = row * _cols + col;
+
+    // Leaves may overlap by a fraction of a pixel; like when painting, the
+    // last one wins.
+
+    for ( int i = _cellStart[ cell + 1 ] - 1; i >= _cellStart[ cell ]; --i )
+    {
+	int index = _cellLeaves[i];
+
+	if ( _leaves.at( index ).rect.contains( pos ) )
+	    return index;
+    }
+
+    return -1;
+}
+
+
+int TreemapLeaves::find( const FileInfo * fileInfo ) const
+{
+    if ( ! fileInfo )
+	return -1;
+
+    for ( int i = 0; i < _leaves.size(); ++i )
+    {
+	if ( _leaves.at( i ).orig == fileInfo )
+	    return i;
+    }
+
+    return -1;
+}
+
+
+TreemapTile * TreemapLeaves::createTile( int index )
+{
+    if ( index < 0 || index >= _leaves.size() )
+	return 0;
+
+    TreemapLeaf & leaf = _leaves[ index ];
+
+    if ( ! leaf.tile )
+    {
+	leaf.tile = leaf.parentTile->createLeafTile( leaf.orig, leaf.rect, leaf.cushionSurface );
+	CHECK_NEW( leaf.tile );
+    }
+
+    return leaf.tile;
+}
@@ -0,0 +1,142 @@
+/*
+ *   File name: TreemapLeaves.h
+ *   Summary:	Compact storage of treemap file tiles for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TreemapLeaves_h
+#define TreemapLeaves_h
+
+
+#include <QVector>
+#include <QRectF>
+#include <QPointF>
+
+#include "TreemapTile.h"
+
+
+namespace QDirStat
+{
+    class FileInfo;
+
+
+    /**
+     * A file tile of a treemap in single image mode: Only what is needed
+     * to render it and to create a real TreemapTile for it when needed.
+     **/
+    struct TreemapLeaf
+    {
+	QRectF		rect;
+	FileInfo *	orig;
+	TreemapTile *	parentTile;
+	TreemapTile *	tile;		// 0 until createTile() is called
+	CushionSurface	cushionSurface;
+    };
+
+
+    /**
+     * The file tiles of a treemap in single image mode with a spatial
+     * index to find the tile at a position.
+     *
+     * In single image mode, the TreemapView renders the complete treemap
+     * into one image, and only directories get a TreemapTile (a
+     * QGraphicsItem) right away: Those are much fewer than files, and they
+     * are needed for highlighting and zooming. A file tile is only stored
+     * as a TreemapLeaf; a TreemapTile is created for it only when it is
+     * clicked, selected or becomes the current item.
+     *
+     * The spatial index is a uniform grid of cells of CellSize pixels
+     * that stores the indices of the leaves that overlap each cell in one
+     * array.
+     **/
+    class TreemapLeaves
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	TreemapLeaves();
+
+	/**
+	 * Remove all leaves and the index.
+	 **/
+	void clear();
+
+	/**
+	 * Add a leaf. This invalidates the index.
+	 **/
+	void add( TreemapTile *		 parentTile,
+		  FileInfo *		 orig,
+		  const QRectF &	 rect,
+		  const CushionSurface & cushionSurface );
+
+	/**
+	 * Return the number of leaves.
+	 **/
+	int size() const { return _leaves.size(); }
+
+	/**
+	 * Return leaf no. 'index'.
+	 **/
+	const TreemapLeaf & at( int index ) const { return _leaves.at( index ); }
+
+	/**
+	 * Return all leaves.
+	 **/
+	const QVector<TreemapLeaf> & leaves() const { return _leaves; }
+
+	/**
+	 * Build the spatial index for a scene with 'sceneRect'. This needs
+	 * to be called after all leaves are added.
+	 **/
+	void buildIndex( const QRectF & sceneRect );
+
+	/**
+	 * Return the index of the leaf at scene position 'pos' or -1 if
+	 * there is none.
+	 **/
+	int leafAt( const QPointF & pos ) const;
+
+	/**
+	 * Return the index of the leaf for 'fileInfo' or -1 if there is
+	 * none.
+	 **/
+	int find( const FileInfo * fileInfo ) const;
+
+	/**
+	 * Return the TreemapTile for leaf no. 'index'. If there is none
+	 * yet, create it.
+	 **/
+	TreemapTile * createTile( int index );
+
+
+    protected:
+
+	/**
+	 * Return the range of grid cells that 'rect' overlaps.
+	 **/
+	void cellRange( const QRectF & rect,
+			int	     & firstCol,
+			int	     & lastCol,
+			int	     & firstRow,
+			int	     & lastRow ) const;
+
+	// Data members
+
+	QVector<TreemapLeaf> _leaves;
+	QRectF		     _sceneRect;
+	int		     _cols;
+	int		     _rows;
+	QVector<int>	     _cellStart;	// _cols * _rows + 1 offsets into _cellLeaves
+	QVector<int>	     _cellLeaves;	// leaf indices
+
+    };	// class TreemapLeaves
+
+}	// namespace QDirStat
+
+
+#endif // ifndef TreemapLeaves_h
@@ -12,10 +12,14 @@
 #include <QImage>
 #include <QPainter>
 #include <QGraphicsSceneMouseEvent>
+#include <QStyleOptionGraphicsItem>
 #include <QMenu>
 
 #include "TreemapTile.h"
+#include "CushionShader.h"
 #include "TreemapView.h"
+#include "DirInfo.h"
+#include "DirTree.h"
 #include "SelectionModel.h"
 #include "ActionManager.h"
 #include "CleanupCollection.h"
@@ -25,52 +29,56 @@
 using namespace QDirStat;
 
 
-TreemapTile::TreemapTile( TreemapView *	 parentView,
-			  TreemapTile *	 parentTile,
-			  FileInfo *	 orig,
-			  const QRectF & rect,
-			  Orientation	 orientation ):
+TreemapTile::TreemapTile( TreemapView *		 parentView,
+			  TreemapTile *		 parentTile,
+			  FileInfo    *		 orig,
+			  const QRectF &	 rect,
+			  const CushionSurface & cushionSurface ):
     QGraphicsRectItem( rect, parentTile ),
     _parentView( parentView ),
     _parentTile( parentTile ),
-    _orig( orig )
+    _orig( orig ),
+    _cushionSurface( cushionSurface ),
+    _orientation( TreemapAuto ),
+    _layoutSize( orig->nodeTotalAllocatedSize() )
 {
-    // logDebug() << "Creating tile without cushion for " << orig << "	" << rect << endl;
+    // logDebug() << "Creating tile for " << orig << "  " << rect << endl;
     init();
+}
 
-    if ( parentTile )
-	_cushionSurface = parentTile->cushionSurface();
 
-    createChildren( rect, orientation );
+TreemapTile::~TreemapTile()
+{
+    // NOP
 }
 
 
-TreemapTile::TreemapTile( TreemapView *		 parentView,
-			  TreemapTile *		 parentTile,
-			  FileInfo    *		 orig,
-			  const QRectF &	 rect,
-			  const CushionSurface & cushionSurface,
-			  Orientation		 orientation ):
-    QGraphicsRectItem( rect, parentTile ),
-    _parentView( parentView ),
-    _parentTile( parentTile ),
-    _orig( orig ),
-    _cushionSurface( cushionSurface )
+void TreemapTile::setLayoutOrigin( const CushionSurface & parentSurface,
+				   Orientation		  orientation )
 {
-    // logDebug() << "Creating cushioned tile for " << orig << "  " << rect << endl;
-    init();
+    _parentSurface = parentSurface;
+    _orientation   = orientation;
+}
 
-    // Intentionally not copying the parent's cushion surface!
 
-    createChildren( rect, orientation );
+void TreemapTile::updateLayoutSize()
+{
+    _layoutSize = _orig->nodeTotalAllocatedSize();
 }
 
 
-TreemapTile::~TreemapTile()
+void TreemapTile::deleteHighlighters()
 {
-    // DO NOT try to delete the _highlighter: It is owned by the TreemapView /
-    // QGraphicsScene and deleted together with all other QGraphicsItems
-    // in the TreemapView destructor.
+    foreach ( QGraphicsItem * item, childItems() )
+    {
+	TreemapTile * child = dynamic_cast<TreemapTile *>( item );
+
+	if ( child )
+	    child->deleteHighlighters();
+    }
+
+    if ( isSelected() && _parentView->selectionOverlay() )
+	_parentView->selectionOverlay()->remove( this );
 }
 
 
@@ -84,7 +92,7 @@ void TreemapTile::init()
     setBrush( QColor( 0x60, 0x60, 0x60 ) );
     setPen( Qt::NoPen );
 
-    if ( _orig->isDir() || _orig->isDotEntry() )
+    if ( _orig->isDir() || _orig->isDotEntryNode() )
     {
         if ( _parentView->useDirGradient() )
         {
@@ -103,9 +111,14 @@ void TreemapTile::init()
     }
 
     setFlags( ItemIsSelectable );
-    _highlighter = 0;
 
-    if ( ( _orig->isDir() && _orig->totalSubDirs() == 0 ) || _orig->isDotEntry() )
+    // In single image mode, the root tile paints the whole treemap; only
+    // paint the part that needs it
+
+    if ( ! _parentTile )
+	setFlag( ItemUsesExtendedStyleOption );	// for exposedRect
+
+    if ( ( _orig->isDir() && _orig->totalSubDirs() == 0 ) || _orig->isDotEntryNode() )
         setAcceptHoverEvents( true );
 
     if ( ! _parentTile )
@@ -116,285 +129,79 @@ void TreemapTile::init()
 }
 
 
-void TreemapTile::createChildren( const QRectF & rect,
-				  Orientation	 orientation )
-{
-    if ( _orig->totalAllocatedSize() == 0 )	// Prevent division by zero
-	return;
-
-    if ( _parentView->squarify() )
-	createSquarifiedChildren( rect );
-    else
-	createChildrenSimple( rect, orientation );
-}
-
-
-void TreemapTile::createChildrenSimple( const QRectF & rect,
-					Orientation    orientation )
+void TreemapTile::paint( QPainter			* painter,
+			 const QStyleOptionGraphicsItem * option,
+			 QWidget			* widget )
 {
-    Orientation dir	 = orientation;
-    Orientation childDir = orientation;
-
-    if ( dir == TreemapAuto )
-	dir = rect.width() > rect.height() ? TreemapHorizontal : TreemapVertical;
-
-    if ( orientation == TreemapHorizontal )  childDir = TreemapVertical;
-    if ( orientation == TreemapVertical	  )  childDir = TreemapHorizontal;
-
-    int offset	 = 0;
-    int size	 = dir == TreemapHorizontal ? rect.width() : rect.height();
-    int count	 = 0;
-    double scale = (double) size / (double) _orig->totalAllocatedSize();
-
-    _cushionSurface.addRidge( childDir, _cushionSurface.height(), rect );
-    FileSize minSize = (FileSize) ( _parentView->minTileSize() / scale );
-    FileInfoSortedBySizeIterator it( _orig, minSize );
-
-    while ( *it )
-    {
-	int childSize = 0;
-
-	childSize = (int) ( scale * (*it)->totalAllocatedSize() );
-
-	if ( childSize >= _parentView->minTileSize() )
-	{
-	    QRectF childRect;
-
-	    if ( dir == TreemapHorizontal )
-		childRect = QRectF( rect.x() + offset, rect.y(), childSize, rect.height() );
-	    else
-		childRect = QRectF( rect.x(), rect.y() + offset, rect.width(), childSize );
-
-	    TreemapTile * tile = new TreemapTile( _parentView, this, *it, childRect, childDir );
-	    CHECK_NEW( tile );
-
-	    tile->cushionSurface().addRidge( dir,
-					     _cushionSurface.height() * _parentView->heightScaleFactor(),
-					     childRect );
-
-	    offset += childSize;
-	}
-
-	++count;
-	++it;
-    }
-}
+    // logDebug() << this << "	 " << rect() << endl;
 
+    QSizeF size = rect().size();
 
-void TreemapTile::createSquarifiedChildren( const QRectF & rect )
-{
-    if ( _orig->totalAllocatedSize() == 0 )
-    {
-	logError()  << "Zero totalAllocatedSize()" << endl;
+    if ( size.height() < 1.0 || size.width() < 1.0 )
 	return;
-    }
-
-    double scale	= rect.width() * (double) rect.height() / _orig->totalAllocatedSize();
-    FileSize minSize	= (FileSize) ( _parentView->minTileSize() / scale );
-
-    FileInfoSortedBySizeIterator it( _orig, minSize );
-    QRectF childrenRect = rect;
-
-    while ( *it )
-    {
-	FileInfoList row = squarify( childrenRect, scale, it );
-	childrenRect = layoutRow( childrenRect, scale, row );
-    }
-}
-
-
-FileInfoList TreemapTile::squarify( const QRectF & rect,
-				    double	  scale,
-				    FileInfoSortedBySizeIterator & it )
-{
-    // logDebug() << "squarify() " << this << " " << rect << endl;
 
-    FileInfoList row;
-    int length = qMax( rect.width(), rect.height() );
-
-    if ( length == 0 )	// Sanity check
-    {
-	logWarning()  << "Zero length" << endl;
-
-	if ( *it )	// Prevent endless loop in case of error:
-	    ++it;	// Advance iterator.
-
-	return row;
-    }
-
-
-    bool   improvingAspectRatio = true;
-    double lastWorstAspectRatio = -1.0;
-    double sum			= 0;
-
-    // This is a bit ugly, but doing all calculations in the 'size' dimension
-    // is more efficient here since that requires only one scaling before
-    // doing all other calculations in the loop.
-    const double scaledLengthSquare = length * (double) length / scale;
-
-    while ( *it && improvingAspectRatio )
+    if ( _parentView->singleImage() && ( _orig->isDir() || _orig->isDotEntryNode() ) )
     {
-	sum += (*it)->totalAllocatedSize();
+	// The parent view rendered all directories and files into one
+	// image; the root tile paints it, the other directory tiles exist
+	// only for highlighting and mouse events.
 
-	if ( ! row.isEmpty() && sum != 0 && (*it)->totalAllocatedSize() != 0 )
+	if ( ! _parentTile )
 	{
-	    double sumSquare	    = sum * sum;
-	    double worstAspectRatio = qMax( scaledLengthSquare * row.first()->totalAllocatedSize() / sumSquare,
-                                            sumSquare / ( scaledLengthSquare * (*it)->totalAllocatedSize() ) );
-
-	    if ( lastWorstAspectRatio >= 0.0 &&
-		 worstAspectRatio > lastWorstAspectRatio )
-	    {
-		improvingAspectRatio = false;
-	    }
-
-	    lastWorstAspectRatio = worstAspectRatio;
+	    CushionPixmapGrid & pixmaps = _parentView->cushionPixmaps();
+	    pixmaps.draw( painter, QRect( QPoint( 0, 0 ), pixmaps.size() ), option->exposedRect );
 	}
 
-	if ( improvingAspectRatio )
+	if ( isSelected() && ! _orig->hasChildren() )
 	{
-	    // logDebug() << "Adding " << *it << " size " << (*it)->totalAllocatedSize() << endl;
-	    row.append( *it );
-	    ++it;
+	    // Like for selected files below; directories with children are
+	    // highlighted by the view's SelectionOverlay.
+
+	    QRectF selectionRect = rect();
+	    selectionRect.setSize( rect().size() - QSize( 1.0, 1.0 ) );
+	    painter->setBrush( Qt::NoBrush );
+	    painter->setPen( QPen( _parentView->selectedItemsColor(), 1 ) );
+	    painter->drawRect( selectionRect );
 	}
-	else
-	{
-	    // logDebug() << "Getting worse after adding " << *it << " size " << (*it)->totalAllocatedSize() << endl;
-	}
-    }
-
-    return row;
-}
-
-
-QRectF TreemapTile::layoutRow( const QRectF & rect,
-			       double	      scale,
-			       FileInfoList & row )
-{
-    if ( row.isEmpty() )
-	return rect;
-
-    // Determine the direction in which to subdivide.
-    // We always use the longer side of the rectangle.
-    Orientation dir = rect.width() > rect.height() ? TreemapHorizontal : TreemapVertical;
-
-    // This row's primary length is the longer one.
-    int primary = qMax( rect.width(), rect.height() );
-
-    // This row's secondary length is determined by the area (the number of
-    // pixels) to be allocated for all of the row's items.
-
-    FileSize sum = 0;
-
-    foreach ( FileInfo * item, row )
-	sum += item->totalAllocatedSize();
-
-    int secondary = (int) ( sum * scale / primary );
-
-    if ( sum == 0 )	// Prevent division by zero.
-	return rect;
-
-    if ( secondary < _parentView->minTileSize() )	// We don't want tiles that small.
-	return rect;
-
-
-    // Set up a cushion surface for this layout row:
-    // Add another ridge perpendicular to the row's direction
-    // that optically groups this row's tiles together.
-
-    CushionSurface rowCushionSurface = _cushionSurface;
-
-    rowCushionSurface.addRidge( dir == TreemapHorizontal ? TreemapVertical : TreemapHorizontal,
-				_cushionSurface.height() * _parentView->heightScaleFactor(),
-				rect );
-
-    int offset = 0;
-    int remaining = primary;
-    FileInfoList::const_iterator it  = row.constBegin();
-    FileInfoList::const_iterator end = row.constEnd();
-
-    while ( it != end )
-    {
-	int childSize = (int) ( (*it)->totalAllocatedSize() / (double) sum * primary + 0.5 );
-
-	if ( childSize > remaining )	// Prevent overflow because of accumulated rounding errors
-	    childSize = remaining;
-
-	remaining -= childSize;
-
-	if ( childSize >= _parentView->minTileSize() )
-	{
-	    QRectF childRect;
 
-	    if ( dir == TreemapHorizontal )
-		childRect = QRectF( rect.x() + offset, rect.y(), childSize, secondary );
-	    else
-		childRect = QRectF( rect.x(), rect.y() + offset, secondary, childSize );
-
-	    TreemapTile * tile = new TreemapTile( _parentView, this, *it, childRect, rowCushionSurface );
-	    CHECK_NEW( tile );
-
-	    tile->cushionSurface().addRidge( dir,
-					     rowCushionSurface.height() * _parentView->heightScaleFactor(),
-					     childRect );
-	    offset += childSize;
-	}
-
-	++it;
-    }
-
-
-    // Subtract the layouted area from the rectangle.
-
-    QRectF newRect;
-
-    if ( dir == TreemapHorizontal )
-	newRect = QRectF( rect.x(), rect.y() + secondary, rect.width(), rect.height() - secondary );
-    else
-	newRect = QRectF( rect.x() + secondary, rect.y(), rect.width() - secondary, rect.height() );
-
-    // logDebug() << "Left over:" << " " << newRect << " " << this << endl;
-
-    return newRect;
-}
-
-
-void TreemapTile::paint( QPainter			* painter,
-			 const QStyleOptionGraphicsItem * option,
-			 QWidget			* widget )
-{
-    // logDebug() << this << "	 " << rect() << endl;
-
-    QSizeF size = rect().size();
-
-    if ( size.height() < 1.0 || size.width() < 1.0 )
 	return;
+    }
 
     if ( _parentView->doCushionShading() )
     {
-	if ( _orig->isDir() || _orig->isDotEntry() )
+	if ( _orig->isDir() || _orig->isDotEntryNode() )
 	{
 	    QGraphicsRectItem::paint( painter, option, widget );
 	}
 	else
 	{
-	    if ( _cushion.isNull() )
-		_cushion = renderCushion();
-
 	    QRectF rect = QGraphicsRectItem::rect();
+	    CushionPixmapGrid & pixmaps = _parentView->cushionPixmaps();
 
-	    if ( ! _cushion.isNull() )
-		painter->drawPixmap( rect.topLeft(), _cushion );
+	    if ( ! _cushionRect.isEmpty() && ! pixmaps.isNull() )
+	    {
+		// Rendered together with all other tiles by the parent view
+
+		pixmaps.draw( painter, _cushionRect, option->exposedRect );
+	    }
+	    else
+	    {
+		if ( _cushion.isNull() )
+		    _cushion = renderCushion();
+
+		if ( ! _cushion.isNull() )
+		    painter->drawPixmap( rect.topLeft(), _cushion );
+	    }
 
 	    if ( isSelected() && ! _orig->hasChildren() )
 	    {
 		// Highlight this tile. This makes only sense if this is a leaf
 		// tile (i.e., if the corresponding FileInfo doesn't have any
 		// children), because otherwise the children will obscure this
-		// tile anyway. In that case, we have to rely on a
-		// HighlightRect to be created. But we can save some memory if
-		// we don't do that for every tile, so we draw that highlight
-		// frame manually if this is a leaf tile.
+		// tile anyway. In that case, we have to rely on the view's
+		// SelectionOverlay. But we can save some work if we don't do
+		// that for every tile, so we draw that highlight frame
+		// manually if this is a leaf tile.
 
 		QRectF selectionRect = rect;
 		selectionRect.setSize( rect.size() - QSize( 1.0, 1.0 ) );
@@ -403,25 +210,14 @@ void TreemapTile::paint( QPainter			* painter,
 		painter->drawRect( selectionRect );
 	    }
 
-	    if ( _parentView->forceCushionGrid() )
-	    {
-		// Draw a clearly visible boundary
-
-		painter->setPen( QPen( _parentView->cushionGridColor(), 1 ) );
-
-		if ( rect.x() > 0 )
-		    painter->drawLine( rect.topLeft(), rect.bottomLeft() );
-
-		if ( rect.y() > 0 )
-		    painter->drawLine( rect.topLeft(), rect.topRight() );
-	    }
+	    drawCushionGrid( _parentView, painter, rect );
 	}
     }
     else	// No cushion shading, use plain tiles
     {
 	painter->setPen( QPen( _parentView->outlineColor(), 1 ) );
 
-	if ( _orig->isDir() || _orig->isDotEntry() )
+	if ( _orig->isDir() || _orig->isDotEntryNode() )
 	{
             if ( ! _parentView->useDirGradient() )
                 setBrush( _parentView->dirFillColor() );
@@ -445,21 +241,9 @@ QPixmap TreemapTile::renderCushion()
 
     // logDebug() << endl;
 
-    double nx;
-    double ny;
-    double cosa;
-    int	   x, y;
-    int	   red, green, blue;
-
-
     // Cache some values. They are used for each loop iteration, so let's try
     // to keep multiple indirect references down.
 
-    int		ambientLight = parentView()->ambientLight();
-    double	lightX	     = parentView()->lightX();
-    double	lightY	     = parentView()->lightY();
-    double	lightZ	     = parentView()->lightZ();
-
     double	xx2	     = cushionSurface().xx2();
     double	xx1	     = cushionSurface().xx1();
     double	yy2	     = cushionSurface().yy2();
@@ -468,35 +252,25 @@ QPixmap TreemapTile::renderCushion()
     int		x0	     = rect.x();
     int		y0	     = rect.y();
 
-    QColor	color	     = parentView()->tileColor( _orig );
-    int		maxRed	     = qMax( 0, color.red()   - ambientLight );
-    int		maxGreen     = qMax( 0, color.green() - ambientLight );
-    int		maxBlue	     = qMax( 0, color.blue()  - ambientLight );
+    CushionShader::Params params = cushionParams( _parentView, _orig );
 
     QImage image( qRound( rect.width() ), qRound( rect.height() ), QImage::Format_RGB32 );
 
-    for ( y = 0; y < rect.height(); y++ )
-    {
-	for ( x = 0; x < rect.width(); x++ )
-	{
-	    nx = 2.0 * xx2 * (x+x0) + xx1;
-	    ny = 2.0 * yy2 * (y+y0) + yy1;
-	    cosa  = ( nx * lightX + ny * lightY + lightZ ) / sqrt( nx*nx + ny*ny + 1.0 );
+    // The normal vector of the cushion surface at pixel (x, y) is
+    // ( 2 * xx2 * (x+x0) + xx1, 2 * yy2 * (y+y0) + yy1, 1 ). Compute the
+    // start of each row in double to avoid cancellation for tiles far away
+    // from the origin.
 
-	    red	  = (int) ( maxRed   * cosa + 0.5 );
-	    green = (int) ( maxGreen * cosa + 0.5 );
-	    blue  = (int) ( maxBlue  * cosa + 0.5 );
+    double nx0	  = 2.0 * xx2 * x0 + xx1;
+    double nxStep = 2.0 * xx2;
+    int	   width  = qMin( image.width(), (int) ceil( rect.width() ) );
 
-	    if ( red   < 0 )	red   = 0;
-	    if ( green < 0 )	green = 0;
-	    if ( blue  < 0 )	blue  = 0;
-
-	    red	  += ambientLight;
-	    green += ambientLight;
-	    blue  += ambientLight;
+    for ( int y = 0; y < image.height() && y < rect.height(); y++ )
+    {
+	double ny = 2.0 * yy2 * (y+y0) + yy1;
 
-	    image.setPixel( x, y, qRgb( red, green, blue) );
-	}
+	CushionShader::shadeRow( (QRgb *) image.scanLine( y ), width,
+				 nx0, nxStep, ny, params );
     }
 
     if ( _parentView->ensureContrast() )
@@ -506,6 +280,146 @@ QPixmap TreemapTile::renderCushion()
 }
 
 
+CushionShader::Params TreemapTile::cushionParams( TreemapView * view, FileInfo * orig )
+{
+    int	   ambientLight = view->ambientLight();
+    QColor color	= view->tileColor( orig );
+
+    CushionShader::Params params;
+    params.lightX	= view->lightX();
+    params.lightY	= view->lightY();
+    params.lightZ	= view->lightZ();
+    params.maxRed	= qMax( 0, color.red()	 - ambientLight );
+    params.maxGreen	= qMax( 0, color.green() - ambientLight );
+    params.maxBlue	= qMax( 0, color.blue()	 - ambientLight );
+    params.ambientLight = ambientLight;
+
+    return params;
+}
+
+
+bool TreemapTile::prepareCushionJob( CushionRenderer::Job & job )
+{
+    _cushionRect = QRect();
+
+    if ( _orig->isDir() || _orig->isDotEntryNode() )
+	return false;
+
+    if ( ! prepareCushionJob( _parentView, _orig, rect(), _cushionSurface, job ) )
+	return false;
+
+    _cushionRect = job.rect;
+
+    return true;
+}
+
+
+bool TreemapTile::prepareCushionJob( TreemapView *	    view,
+				     FileInfo *		    orig,
+				     const QRectF &	    rect,
+				     const CushionSurface & cushionSurface,
+				     CushionRenderer::Job & job )
+{
+    if ( rect.width() < 1.0 || rect.height() < 1.0 )
+	return false;
+
+    job.rect   = QRect( rect.topLeft().toPoint(),
+			QSize( qRound( rect.width() ), qRound( rect.height() ) ) );
+    job.xx1    = cushionSurface.xx1();
+    job.xx2    = cushionSurface.xx2();
+    job.yy1    = cushionSurface.yy1();
+    job.yy2    = cushionSurface.yy2();
+    job.params = cushionParams( view, orig );
+
+    return true;
+}
+
+
+void TreemapTile::cushionRendered( QImage & framebuffer )
+{
+    _cushionRect &= framebuffer.rect();
+    finishCushion( _parentView, framebuffer, _cushionRect );
+}
+
+
+void TreemapTile::finishCushion( TreemapView * view,
+				 QImage &      framebuffer,
+				 const QRect & cushionRect )
+{
+    QRect rect = cushionRect & framebuffer.rect();
+
+    if ( ! rect.isEmpty() && view->ensureContrast() )
+    {
+	// Work directly on this tile's part of the framebuffer
+
+	QImage image( framebuffer.scanLine( rect.top() ) + rect.left() * sizeof( QRgb ),
+		      rect.width(),
+		      rect.height(),
+		      framebuffer.bytesPerLine(),
+		      framebuffer.format() );
+
+	ensureContrast( image );
+    }
+}
+
+
+void TreemapTile::drawCushionGrid( TreemapView *  view,
+				   QPainter *	  painter,
+				   const QRectF & rect )
+{
+    if ( view->forceCushionGrid() )
+    {
+	// Draw a clearly visible boundary
+
+	painter->setPen( QPen( view->cushionGridColor(), 1 ) );
+
+	if ( rect.x() > 0 )
+	    painter->drawLine( rect.topLeft(), rect.bottomLeft() );
+
+	if ( rect.y() > 0 )
+	    painter->drawLine( rect.topLeft(), rect.topRight() );
+    }
+}
+
+
+void TreemapTile::paintFlat( QPainter * painter )
+{
+    if ( _parentView->doCushionShading() )
+    {
+	painter->setPen( pen() );
+	painter->setBrush( brush() );
+    }
+    else
+    {
+	// Like in paint()
+
+	painter->setPen( QPen( _parentView->outlineColor(), 1 ) );
+
+	if ( _parentView->useDirGradient() )
+	    painter->setBrush( brush() );
+	else
+	    painter->setBrush( _parentView->dirFillColor() );
+    }
+
+    painter->drawRect( rect() );
+}
+
+
+TreemapTile * TreemapTile::createLeafTile( FileInfo *		  orig,
+					   const QRectF &	  rect,
+					   const CushionSurface & cushionSurface )
+{
+    TreemapTile * tile = new TreemapTile( _parentView, this, orig, rect, cushionSurface );
+    CHECK_NEW( tile );
+
+    // Only to find its part of the framebuffer
+    CushionRenderer::Job job;
+    tile->prepareCushionJob( job );
+
+    return tile;
+}
+
+
 void TreemapTile::ensureContrast( QImage & image )
 {
     if ( image.width() > 5 )
@@ -591,20 +505,14 @@ QVariant TreemapTile::itemChange( GraphicsItemChange   change,
 
 	if ( _orig->hasChildren() )
 	{
-	    if ( ! selected && _highlighter )
-		_highlighter->hide();
+	    SelectionOverlay * overlay = _parentView->selectionOverlay();
 
-	    if ( selected && this != _parentView->rootTile() ) // don't highlight the root tile
+	    if ( overlay )
 	    {
-		if ( ! _highlighter )
-		{
-		    // logDebug() << "Creating highlighter for " << this << endl;
-		    _highlighter = new SelectedItemHighlighter( this, _parentView->selectedItemsColor() );
-		    CHECK_NEW( _highlighter );
-		}
-
-		if ( ! _highlighter->isVisible() )
-		    _highlighter->show();
+		if ( selected && this != _parentView->rootTile() ) // don't highlight the root tile
+		    overlay->add( this );
+		else
+		    overlay->remove( this );
 	    }
 	}
     }
@@ -13,8 +13,10 @@
 
 #include <QGraphicsRectItem>
 #include <QRectF>
+#include <QRect>
 
 #include "FileInfoIterator.h"
+#include "CushionRenderer.h"
 
 
 class QGraphicsSceneMouseEvent;
@@ -138,32 +140,15 @@ namespace QDirStat
     public:
 
 	/**
-	 * Constructor: Create a treemap tile from 'fileinfo' that fits into a
-	 * rectangle 'rect' inside 'parent'.
-	 *
-	 * 'orientation' is the direction for further subdivision. 'Auto'
-	 * selects the wider direction inside 'rect'.
-	 **/
-	TreemapTile( TreemapView  * parentView,
-		     TreemapTile  * parentTile,
-		     FileInfo	  * orig,
-		     const QRectF & rect,
-		     Orientation    orientation = TreemapAuto );
-
-    protected:
-
-	/**
-	 * Alternate constructor: Like the above, but explicitly specify a
-	 * cushion surface rather than using the parent's.
+	 * Constructor: Create a treemap tile for 'orig' with 'rect' and
+	 * 'cushionSurface' from a TreemapLayout inside 'parentTile'.
 	 **/
 	TreemapTile( TreemapView	  * parentView,
 		     TreemapTile	  * parentTile,
 		     FileInfo		  * orig,
 		     const QRectF	  & rect,
-		     const CushionSurface & cushionSurface,
-		     Orientation	    orientation = TreemapAuto );
+		     const CushionSurface & cushionSurface );
 
-    public:
 	/**
 	 * Destructor.
 	 **/
@@ -190,73 +175,105 @@ namespace QDirStat
 	 **/
 	CushionSurface & cushionSurface() { return _cushionSurface; }
 
+	/**
+	 * Remember 'parentSurface' and 'orientation' from the layout item of
+	 * this tile so its children can be laid out again later without
+	 * laying out the parent (see TreemapLayout::setRootSurface()).
+	 **/
+	void setLayoutOrigin( const CushionSurface & parentSurface,
+			      Orientation	     orientation );
 
-    protected:
+	/**
+	 * Returns the cushion surface that the layout of this tile started
+	 * with.
+	 **/
+	const CushionSurface & parentSurface() const { return _parentSurface; }
 
 	/**
-	 * Create children (sub-tiles) of this tile.
+	 * Returns the orientation for subdividing this tile.
 	 **/
-	void createChildren( const QRectF & rect,
-			     Orientation    orientation );
+	Orientation orientation() const { return _orientation; }
 
 	/**
-	 * Create children (sub-tiles) using the simple treemap algorithm:
-	 * Alternate between horizontal and vertical subdivision in each
-	 * level. Each child will get the entire height or width, respectively,
-	 * of the specified rectangle. This algorithm is very fast, but often
-	 * results in very thin, elongated tiles.
+	 * Returns the total size of 'orig' when this tile was laid out.
 	 **/
-	void createChildrenSimple( const QRectF & rect,
-				   Orientation	  orientation );
+	FileSize layoutSize() const { return _layoutSize; }
 
 	/**
-	 * Create children using the "squarified treemaps" algorithm as
-	 * described by Mark Bruls, Kees Huizing, and Jarke J. van Wijk of the
-	 * TU Eindhoven, NL.
-	 *
-	 * This algorithm is not quite so simple and involves more expensive
-	 * operations, e.g., sorting the children of each node by size first,
-	 * try some variations of the layout and maybe backtrack to the
-	 * previous attempt. But it results in tiles that are much more
-	 * square-like, i.e. have more reasonable width-to-height ratios. It is
-	 * very much less likely to get thin, elongated tiles that are hard to
-	 * point at and even harder to compare visually against each other.
-	 *
-	 * This implementation includes some improvements to that basic
-	 * algorithm. For example, children below a certain size are
-	 * disregarded completely since they will not get an adequate visual
-	 * representation anyway (it would be way too small). They are
-	 * summarized in some kind of 'misc stuff' area in the parent treemap
-	 * tile - in fact, part of the parent directory's tile can be "seen
-	 * through".
-	 *
-	 * In short, a lot of small children that don't have any useful effect
-	 * for the user in finding wasted disk space are omitted from handling
-	 * and, most important, don't need to be sorted by size (which has a
-	 * cost of O(n*ln(n)) in the best case, so reducing n helps a lot).
+	 * Notification that the children of this tile were laid out again.
 	 **/
-	void createSquarifiedChildren( const QRectF & rect );
+	void updateLayoutSize();
 
 	/**
-	 * Squarify as many children as possible: Try to squeeze members
-	 * referred to by 'it' into 'rect' until the aspect ratio doesn't get
-	 * better any more. Returns a list of children that should be laid out
-	 * in 'rect'. Moves 'it' until there is no more improvement or 'it'
-	 * runs out of items.
+	 * Remove the highlights of this tile and all its children from the
+	 * selection overlay. It is not a child of the tiles, so this needs to
+	 * be done before deleting the tiles individually rather than with the
+	 * complete scene.
+	 **/
+	void deleteHighlighters();
+
+	/**
+	 * Set up 'job' for rendering the cushion of this tile into the
+	 * cushion framebuffer of the parent view and remember where it is
+	 * in the framebuffer. Return 'false' if this tile does not have a
+	 * cushion, i.e. if it is a directory or too small.
+	 **/
+	bool prepareCushionJob( CushionRenderer::Job & job );
+
+	/**
+	 * Notification that the cushion of this tile was rendered into
+	 * 'framebuffer' with the job from prepareCushionJob().
+	 **/
+	void cushionRendered( QImage & framebuffer );
+
+	/**
+	 * Set up 'job' for rendering the cushion of file 'orig' in
+	 * 'rect' with 'cushionSurface' in 'view'. Return 'false' if 'rect'
+	 * is too small.
 	 *
-	 * 'scale' is the scaling factor between file sizes and pixels.
+	 * This is also used for files that don't have a tile in single
+	 * image mode (see TreemapLeaves).
+	 **/
+	static bool prepareCushionJob( TreemapView *	      view,
+				       FileInfo *	      orig,
+				       const QRectF &	      rect,
+				       const CushionSurface & cushionSurface,
+				       CushionRenderer::Job & job );
+
+	/**
+	 * Finish the cushion that was rendered into 'cushionRect' of
+	 * 'framebuffer': Ensure the contrast to the neighbouring tiles if
+	 * 'view' is configured to do that.
+	 **/
+	static void finishCushion( TreemapView * view,
+				   QImage &	 framebuffer,
+				   const QRect & cushionRect );
+
+	/**
+	 * Draw the cushion grid lines at the left and top boundary of
+	 * 'rect' with 'painter' if 'view' is configured to do that.
 	 **/
-	FileInfoList squarify( const QRectF & rect,
-			       double	     scale,
-			       FileInfoSortedBySizeIterator & it   );
+	static void drawCushionGrid( TreemapView *  view,
+				     QPainter *	    painter,
+				     const QRectF & rect );
 
 	/**
-	 * Lay out all members of 'row' within 'rect' along its longer side.
-	 * Returns the new rectangle with the layouted area subtracted.
+	 * Paint this directory tile with its brush without cushion shading
+	 * with 'painter'. This is used for rendering the single image.
 	 **/
-	QRectF layoutRow( const QRectF	& rect,
-			  double	  scale,
-			  FileInfoList	& row );
+	void paintFlat( QPainter * painter );
+
+	/**
+	 * Create a tile for 'orig', which is a file that was laid out as a
+	 * child of this tile in single image mode, with its 'rect' and
+	 * 'cushionSurface' from the layout.
+	 **/
+	TreemapTile * createLeafTile( FileInfo *	     orig,
+				      const QRectF &	     rect,
+				      const CushionSurface & cushionSurface );
+
+
+    protected:
 
 	/**
 	 * Paint this tile.
@@ -334,18 +351,24 @@ namespace QDirStat
 	 **/
 	QPixmap renderCushion();
 
+	/**
+	 * Return the shading parameters for the cushion of file 'orig' in
+	 * 'view'.
+	 **/
+	static CushionShader::Params cushionParams( TreemapView * view, FileInfo * orig );
+
 	/**
 	 * Check if the contrast of the specified image is sufficient to
 	 * visually distinguish an outline at the right and bottom borders
 	 * and add a grey line there, if necessary.
 	 **/
-	void ensureContrast( QImage & image );
+	static void ensureContrast( QImage & image );
 
 	/**
 	 * Returns a color that gives a reasonable contrast to 'col': Lighter
 	 * if 'col' is dark, darker if 'col' is light.
 	 **/
-	QRgb contrastingColor( QRgb col );
+	static QRgb contrastingColor( QRgb col );
 
     private:
 
@@ -363,8 +386,11 @@ namespace QDirStat
 	TreemapTile *	_parentTile;
 	FileInfo *	_orig;
 	CushionSurface	_cushionSurface;
+	CushionSurface	_parentSurface;
+	Orientation	_orientation;
+	FileSize	_layoutSize;
 	QPixmap		_cushion;
-	HighlightRect * _highlighter;
+	QRect		_cushionRect;	// in the parent view's cushion framebuffer
 
     }; // class TreemapTile
 
@@ -8,8 +8,14 @@
 
 
 #include <QResizeEvent>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QContextMenuEvent>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
 #include <QRegExp>
 #include <QTimer>
+#include <QSet>
 
 #include "TreemapView.h"
 #include "DirTree.h"
@@ -19,13 +25,24 @@
 #include "SettingsHelpers.h"
 #include "SignalBlocker.h"
 #include "TreemapTile.h"
+#include "CushionRenderer.h"
+#include "GLCushionRenderer.h"
+#include "TreemapLeaves.h"
+#include "TreemapLayout.h"
 #include "MimeCategorizer.h"
 #include "DelayedRebuilder.h"
+#include "StallWatchdog.h"
 #include "Exception.h"
 #include "Logger.h"
 
 #define UpdateMinSize	      20
 
+// Maximum number of tiles of the coarse preview of progressive rendering
+#define ProgressiveMaxTiles   2000
+
+// Number of layouts to keep for zooming out and going back in the history
+#define MaxCachedLayouts      8
+
 using namespace QDirStat;
 
 
@@ -47,13 +64,27 @@ TreemapView::TreemapView( QWidget * parent ):
     _rootTile(0),
     _currentItem(0),
     _currentItemRect(0),
+    _selectionOverlay(0),
     _sceneMask(0),
     _newRoot(0),
+    _leaves(0),
+    _layout(0),
+    _layoutCache(0),
+    _glRenderer(0),
+    _liveUpdateTimer(0),
+    _coarseLayout(false),
     _useFixedColor(false),
-    _useDirGradient(true)
+    _useDirGradient(true),
+    _treeUpdating(false)
 {
     // logDebug() << endl;
 
+    _leaves = new TreemapLeaves();
+    CHECK_NEW( _leaves );
+
+    _layoutCache = new TreemapLayoutCache( MaxCachedLayouts );
+    CHECK_NEW( _layoutCache );
+
     readSettings();
 
     // Default values for light sources taken from Wiik / Wetering's paper
@@ -71,6 +102,12 @@ TreemapView::TreemapView( QWidget * parent ):
 
     connect( _rebuilder, SIGNAL( rebuild() ),
 	     this,	 SLOT  ( rebuildTreemapDelayed() ) );
+
+    _liveUpdateTimer = new QTimer( this );
+    CHECK_NEW( _liveUpdateTimer );
+
+    connect( _liveUpdateTimer, SIGNAL( timeout()    ),
+	     this,		SLOT  ( liveUpdate() ) );
 }
 
 
@@ -80,25 +117,36 @@ TreemapView::~TreemapView()
     // There is no settings dialog for this class because the settings are all
     // pretty obscure - strictly for experts.
     writeSettings();
+    cancelLayout();
+    delete _glRenderer;
+    delete _layoutCache;
+    delete _leaves;
 }
 
 
 void TreemapView::clear()
 {
+    cancelLayout();
+
     if ( scene() )
 	qDeleteAll( scene()->items() );
 
     _currentItem     = 0;
     _currentItemRect = 0;
+    _selectionOverlay = 0;
     _rootTile	     = 0;
     _sceneMask       = 0;
     _parentHighlightList.clear();
+    _cushionPixmaps.clear();
+    _leaves->clear();
+    _tileIndex.clear();
 }
 
 
 void TreemapView::setDirTree( DirTree * newTree )
 {
     // logDebug() << endl;
+    _layoutCache->clear();
     _tree = newTree;
 
     if ( ! _tree )
@@ -119,14 +167,55 @@ void TreemapView::setDirTree( DirTree * newTree )
     connect( _tree, SIGNAL( deletingChild   ( FileInfo * )  ),
 	     this,  SLOT  ( deleteNotify    ( FileInfo * ) ) );
 
-    connect( _tree, SIGNAL( childDeleted()   ),
-	     this,  SLOT  ( rebuildTreemap() ) );
+    connect( _tree, SIGNAL( childDeleted() ),
+	     this,  SLOT  ( childDeleted() ) );
+
+    connect( _tree, SIGNAL( startingUpdate() ),
+	     this,  SLOT  ( startingUpdate() ) );
+
+    connect( _tree, SIGNAL( updateFinished() ),
+	     this,  SLOT  ( updateFinished() ) );
 
     connect( _tree, SIGNAL( clearing() ),
 	     this,  SLOT  ( clear()    ) );
 
-    connect( _tree, SIGNAL( finished()	     ),
-	     this,  SLOT  ( rebuildTreemap() ) );
+    connect( _tree, SIGNAL( startingReading() ),
+	     this,  SLOT  ( startingReading() ) );
+
+    connect( _tree, SIGNAL( clearingSubtree( DirInfo * ) ),
+	     this,  SLOT  ( clear()			 ) );
+
+    connect( _tree, SIGNAL( aborted()	     ),
+	     this,  SLOT  ( readingAborted() ) );
+
+    // Any change of the tree makes the cached layouts invalid
+
+    connect( _tree, SIGNAL( clearing()		     ),
+	     this,  SLOT  ( invalidateLayoutCache() ) );
+
+    connect( _tree, SIGNAL( startingReading()	     ),
+	     this,  SLOT  ( invalidateLayoutCache() ) );
+
+    connect( _tree, SIGNAL( childrenAdded   ( FileInfoList ) ),
+	     this,  SLOT  ( invalidateLayoutCache() ) );
+
+    connect( _tree, SIGNAL( deletingChild   ( FileInfo * ) ),
+	     this,  SLOT  ( invalidateLayoutCache() ) );
+
+    connect( _tree, SIGNAL( clearingSubtree ( DirInfo * ) ),
+	     this,  SLOT  ( invalidateLayoutCache() ) );
+
+    connect( _tree, SIGNAL( readJobFinished ( DirInfo * ) ),
+	     this,  SLOT  ( invalidateLayoutCache() ) );
+
+    connect( _tree, SIGNAL( startingUpdate()	     ),
+	     this,  SLOT  ( invalidateLayoutCache() ) );
+
+    connect( _tree, SIGNAL( memoryPressure()	     ),
+	     this,  SLOT  ( relieveMemory() ) );
+
+    connect( _tree, SIGNAL( finished()	      ),
+	     this,  SLOT  ( readingFinished() ) );
 }
 
 
@@ -171,6 +260,11 @@ void TreemapView::readSettings()
     _heightScaleFactor	= settings.value( "HeightScaleFactor", DefaultHeightScaleFactor ).toDouble();
     _squarify		= settings.value( "Squarify"	     , true  ).toBool();
     _doCushionShading	= settings.value( "CushionShading"   , true  ).toBool();
+    _progressiveLevels	= settings.value( "ProgressiveLevels", 2     ).toInt();
+    _singleImage	= settings.value( "SingleImage"	     , false ).toBool();
+    _useOpenGL		= settings.value( "OpenGL"	     , false ).toBool();
+    _liveUpdateInterval = settings.value( "LiveUpdateInterval", 0    ).toInt();
+    _liveUpdateThreshold= settings.value( "LiveUpdateThreshold", 5   ).toInt();
     _ensureContrast	= settings.value( "EnsureContrast"   , true  ).toBool();
     _forceCushionGrid	= settings.value( "ForceCushionGrid" , false ).toBool();
     _useDirGradient	= settings.value( "UseDirGradient"   , true  ).toBool();
@@ -200,6 +294,11 @@ void TreemapView::writeSettings()
     settings.setValue( "HeightScaleFactor" , _heightScaleFactor	 );
     settings.setValue( "Squarify"	   , _squarify		 );
     settings.setValue( "CushionShading"	   , _doCushionShading	 );
+    settings.setValue( "ProgressiveLevels" , _progressiveLevels	 );
+    settings.setValue( "SingleImage"	   , _singleImage	 );
+    settings.setValue( "OpenGL"		   , _useOpenGL		 );
+    settings.setValue( "LiveUpdateInterval" , _liveUpdateInterval  );
+    settings.setValue( "LiveUpdateThreshold", _liveUpdateThreshold );
     settings.setValue( "EnsureContrast"	   , _ensureContrast	 );
     settings.setValue( "ForceCushionGrid"  , _forceCushionGrid	 );
     settings.setValue( "UseDirGradient"	   , _useDirGradient	 );
@@ -314,8 +413,12 @@ void TreemapView::rebuildTreemap()
     if ( ! root )
 	root = _rootTile ? _rootTile->orig() : _tree->firstToplevel();
 
-    rebuildTreemap( root, sceneRect().size() );
     _savedRootUrl = "";
+
+    if ( _progressiveLevels > 0 )
+	startLayout( root );
+    else
+	rebuildTreemap( root, sceneRect().size() );
 }
 
 
@@ -324,11 +427,166 @@ void TreemapView::rebuildTreemap( FileInfo *	 newRoot,
 {
     // logDebug() << endl;
 
+    StallOperation operation( "Treemap rebuild" );
+
     QSizeF newSize = newSz;
 
     if ( newSz.isEmpty() )
 	newSize = visibleSize();
 
+    QRectF rect = QRectF( 0.0, 0.0, (double) newSize.width(), (double) newSize.height() );
+
+    if ( newSize.width() >= UpdateMinSize && newSize.height() >= UpdateMinSize )
+    {
+	// The treemap contents is displayed if larger than a certain minimum
+	// visible size. This is an easy way for the user to avoid
+	// time-consuming delays when deleting a lot of files: Simply make the
+	// treemap (sub-) window very small.
+
+	if ( newRoot )
+	{
+	    if ( newRoot->isDirInfo() &&
+		 newRoot->toDirInfo()->isCachePlaceholder() &&
+		 newRoot->totalAllocatedSize() > 0 )
+	    {
+		// The children are not read from the cache file yet. That is
+		// only worthwhile if the treemap is zoomed in to this
+		// directory; the treemap is rebuilt when reading is finished.
+
+		newRoot->tree()->readCachePlaceholder( newRoot->toDirInfo() );
+	    }
+
+	    TreemapLayout * layout = _layoutCache->find( this, newRoot, rect );
+
+	    if ( ! layout )
+	    {
+		layout = new TreemapLayout( this, newRoot, rect );
+		CHECK_NEW( layout );
+
+		layout->layout();
+		_layoutCache->add( layout );
+	    }
+
+	    showLayout( *layout );
+	    return;
+	}
+    }
+    else
+    {
+	// logDebug() << "Too small - suppressing treemap contents" << endl;
+    }
+
+    showLayout( TreemapLayout( this, newRoot, rect ) );
+}
+
+
+void TreemapView::startLayout( FileInfo * newRoot )
+{
+    cancelLayout();
+
+    QSize size = visibleSize();
+
+    if ( ! newRoot || ! _tree || _tree->isBusy() ||
+	 size.width() < UpdateMinSize || size.height() < UpdateMinSize ||
+	 ( newRoot->isDirInfo() && newRoot->toDirInfo()->isCachePlaceholder() ) )
+    {
+	// Nothing to gain from a separate thread, or the tree might change
+	// while the layout is computed
+
+	rebuildTreemap( newRoot );
+	return;
+    }
+
+    // Make sure the sums are up to date: Reading them in the layout thread
+    // must not recalculate them.
+    newRoot->totalAllocatedSize();
+
+    QRectF rect = QRectF( 0.0, 0.0, (double) size.width(), (double) size.height() );
+    TreemapLayout * cachedLayout = _layoutCache->find( this, newRoot, rect );
+
+    if ( cachedLayout )
+    {
+	showLayout( *cachedLayout );
+	return;
+    }
+
+    if ( ! _rootTile && _progressiveLevels > 0 )
+    {
+	// Nothing on the screen: Show a coarse treemap right away with only
+	// a few levels and flat colors, then replace it with the complete
+	// one with cushions when that is ready.
+
+	TreemapLayout coarseLayout( this, newRoot, rect );
+	coarseLayout.setLimits( _progressiveLevels, ProgressiveMaxTiles );
+	coarseLayout.layout();
+	showLayout( coarseLayout );
+    }
+
+    // The old treemap stays on the screen until the new layout is ready.
+
+    _layout = new TreemapLayout( this, newRoot, rect );
+    CHECK_NEW( _layout );
+
+    connect( _layout, SIGNAL( finished()	),
+	     this,    SLOT  ( layoutFinished() ) );
+
+    _layout->start();
+}
+
+
+void TreemapView::cancelLayout()
+{
+    if ( _layout )
+    {
+	// logDebug() << "Cancelling treemap layout" << endl;
+
+	_layout->cancel();
+	_layout->wait();	// It must not read the tree anymore
+
+	delete _layout;
+	_layout = 0;
+    }
+}
+
+
+void TreemapView::layoutFinished()
+{
+    if ( ! _layout || sender() != _layout )	// Cancelled meanwhile?
+	return;
+
+    TreemapLayout * layout = _layout;
+    _layout = 0;
+    layout->wait();
+
+    if ( ! layout->isCancelled() )
+	showLayout( *layout );
+
+    _layoutCache->add( layout );   // This deletes it if it was cancelled
+}
+
+
+void TreemapView::invalidateLayoutCache()
+{
+    if ( ! _layoutCache->isEmpty() )
+    {
+	// logDebug() << "Clearing the treemap layout cache" << endl;
+	_layoutCache->clear();
+    }
+}
+
+
+void TreemapView::relieveMemory()
+{
+    if ( ! _layoutCache->isEmpty() )
+    {
+	logInfo() << "Dropping the treemap layout cache" << endl;
+	_layoutCache->clear();
+    }
+}
+
+
+void TreemapView::showLayout( const TreemapLayout & layout )
+{
     // Delete all old stuff.
     clear();
 
@@ -339,27 +597,14 @@ void TreemapView::rebuildTreemap( FileInfo *	 newRoot,
 	setScene( scene );
     }
 
-    QRectF rect = QRectF( 0.0, 0.0, (double) newSize.width(), (double) newSize.height() );
-    scene()->setSceneRect( rect );
+    scene()->setSceneRect( layout.rect() );
+    _coarseLayout = layout.isCoarse();
 
-    if ( newSize.width() >= UpdateMinSize && newSize.height() >= UpdateMinSize )
+    if ( ! layout.items().isEmpty() )
     {
-	// The treemap contents is displayed if larger than a certain minimum
-	// visible size. This is an easy way for the user to avoid
-	// time-consuming delays when deleting a lot of files: Simply make the
-	// treemap (sub-) window very small.
-
 	// Fill the new scene
 
-	if ( newRoot )
-	{
-	    _rootTile = new TreemapTile( this,		// parentView
-					 0,		// parentTile
-					 newRoot,	// orig
-					 rect,
-					 TreemapAuto );
-	}
-
+	createTiles( layout );
 
 	// Synchronize selection with other views
 
@@ -369,12 +614,216 @@ void TreemapView::rebuildTreemap( FileInfo *	 newRoot,
 	    updateCurrentItem( _selectionModel->currentItem() );
 	}
     }
-    else
+
+    emit treemapChanged();
+}
+
+
+void TreemapView::createTiles( const TreemapLayout & layout )
+{
+    _rootTile = addTiles( layout, 0 );
+    _leaves->buildIndex( layout.rect() );
+
+    if ( doCushionShading() || _singleImage )
+	renderFramebuffer();
+}
+
+
+TreemapTile * TreemapView::addTiles( const TreemapLayout & layout,
+				     TreemapTile *	   rootTile )
+{
+    const QVector<TreemapLayoutItem> & items = layout.items();
+    QVector<TreemapTile *> tiles( items.size() );
+    tiles[0] = rootTile;
+
+    for ( int i = rootTile ? 1 : 0; i < items.size(); ++i )
     {
-	// logDebug() << "Too small - suppressing treemap contents" << endl;
+	const TreemapLayoutItem & item = items.at( i );
+	TreemapTile * parentTile = item.parent >= 0 ? tiles.at( item.parent ) : 0;
+
+	if ( parentTile && _singleImage && ! item.orig->isDir() && ! item.orig->isDotEntry() )
+	{
+	    addLeaf( parentTile, item.orig, item.rect, item.cushionSurface );
+	}
+	else
+	{
+	    tiles[i] = new TreemapTile( this, parentTile, item.orig, item.rect, item.cushionSurface );
+	    CHECK_NEW( tiles[i] );
+
+	    tiles[i]->setLayoutOrigin( item.parentSurface, item.orientation );
+	    _tileIndex.insert( item.orig, tiles[i] );
+	}
     }
 
-    emit treemapChanged();
+    return tiles.first();
+}
+
+
+namespace
+{
+    /**
+     * Recursively collect 'tile' and its children in painting order in
+     * 'allTiles' and the cushion jobs in 'jobs' with the tiles they belong
+     * to in 'cushionTiles'.
+     **/
+    void collectTiles( TreemapTile		     * tile,
+		       QList<TreemapTile *>	     & allTiles,
+		       QList<TreemapTile *>	     & cushionTiles,
+		       QVector<CushionRenderer::Job> & jobs )
+    {
+	CushionRenderer::Job job;
+	allTiles << tile;
+
+	if ( tile->prepareCushionJob( job ) )
+	{
+	    cushionTiles << tile;
+	    jobs	 << job;
+	}
+
+	foreach ( QGraphicsItem * item, tile->childItems() )
+	{
+	    TreemapTile * child = dynamic_cast<TreemapTile *>( item );
+
+	    if ( child )
+		collectTiles( child, allTiles, cushionTiles, jobs );
+	}
+    }
+
+}	// namespace
+
+
+void TreemapView::renderFramebuffer()
+{
+    _cushionPixmaps.clear();
+
+    if ( ! _rootTile )
+	return;
+
+    QList<TreemapTile *>	  allTiles;
+    QList<TreemapTile *>	  cushionTiles;
+    QVector<CushionRenderer::Job> jobs;
+
+    collectTiles( _rootTile, allTiles, cushionTiles, jobs );
+
+    QSize  size = scene()->sceneRect().size().toSize();
+    QImage framebuffer( size, QImage::Format_RGB32 );
+
+    if ( framebuffer.isNull() )
+	return;
+
+    const QVector<TreemapLeaf> & leaves = _leaves->leaves();
+
+    if ( _singleImage )
+    {
+	// The directories first, then the files on top of them
+
+	framebuffer.fill( palette().color( QPalette::Base ) );
+	QPainter painter( &framebuffer );
+
+	foreach ( TreemapTile * tile, allTiles )
+	{
+	    if ( tile->orig()->isDir() || tile->orig()->isDotEntry() )
+		tile->paintFlat( &painter );
+	}
+
+	if ( ! doCushionShading() )
+	{
+	    painter.setPen( QPen( _outlineColor, 1 ) );
+
+	    foreach ( const TreemapLeaf & leaf, leaves )
+	    {
+		painter.setBrush( tileColor( leaf.orig ) );
+		painter.drawRect( leaf.rect );
+	    }
+	}
+    }
+
+    if ( doCushionShading() )
+    {
+	QVector<QRect> leafCushionRects;
+	leafCushionRects.reserve( leaves.size() );
+
+	foreach ( const TreemapLeaf & leaf, leaves )
+	{
+	    CushionRenderer::Job job;
+
+	    if ( TreemapTile::prepareCushionJob( this, leaf.orig, leaf.rect, leaf.cushionSurface, job ) )
+	    {
+		jobs		 << job;
+		leafCushionRects << job.rect;
+	    }
+	}
+
+	if ( ! _useOpenGL || ! glRenderer()->render( framebuffer, jobs, _singleImage ) )
+	    CushionRenderer::render( framebuffer, jobs );
+
+	foreach ( TreemapTile * tile, cushionTiles )
+	    tile->cushionRendered( framebuffer );
+
+	foreach ( const QRect & rect, leafCushionRects )
+	    TreemapTile::finishCushion( this, framebuffer, rect );
+
+	if ( _forceCushionGrid && ! leaves.isEmpty() )
+	{
+	    QPainter painter( &framebuffer );
+
+	    foreach ( const TreemapLeaf & leaf, leaves )
+		TreemapTile::drawCushionGrid( this, &painter, leaf.rect );
+	}
+    }
+
+    // Converted to pixmaps block by block when they are painted
+
+    _cushionPixmaps.setImage( framebuffer );
+}
+
+
+GLCushionRenderer * TreemapView::glRenderer()
+{
+    if ( ! _glRenderer )
+    {
+	_glRenderer = new GLCushionRenderer();
+	CHECK_NEW( _glRenderer );
+    }
+
+    return _glRenderer;
+}
+
+
+void TreemapView::addLeaf( TreemapTile *	  parentTile,
+			   FileInfo *		  orig,
+			   const QRectF &	  rect,
+			   const CushionSurface & cushionSurface )
+{
+    _leaves->add( parentTile, orig, rect, cushionSurface );
+}
+
+
+void TreemapView::createLeafTileAt( const QPoint & pos )
+{
+    if ( _singleImage && _leaves->size() > 0 )
+	_leaves->createTile( _leaves->leafAt( mapToScene( pos ) ) );
+}
+
+
+void TreemapView::mousePressEvent( QMouseEvent * event )
+{
+    createLeafTileAt( event->pos() );
+    QGraphicsView::mousePressEvent( event );
+}
+
+
+void TreemapView::wheelEvent( QWheelEvent * event )
+{
+    createLeafTileAt( event->pos() );
+    QGraphicsView::wheelEvent( event );
+}
+
+
+void TreemapView::contextMenuEvent( QContextMenuEvent * event )
+{
+    createLeafTileAt( event->pos() );
+    QGraphicsView::contextMenuEvent( event );
 }
 
 
@@ -387,7 +836,7 @@ void TreemapView::scheduleRebuildTreemap( FileInfo * newRoot )
 
 void TreemapView::rebuildTreemapDelayed()
 {
-    rebuildTreemap( _newRoot );
+    startLayout( _newRoot );
 }
 
 
@@ -428,6 +877,204 @@ void TreemapView::deleteNotify( FileInfo * )
 }
 
 
+void TreemapView::childDeleted()
+{
+    if ( ! _treeUpdating )
+	rebuildTreemap();
+}
+
+
+void TreemapView::startingReading()
+{
+    cancelLayout();
+
+    if ( _liveUpdateInterval > 0 )
+	_liveUpdateTimer->start( _liveUpdateInterval );
+}
+
+
+void TreemapView::readingFinished()
+{
+    _liveUpdateTimer->stop();
+    rebuildTreemap();
+}
+
+
+void TreemapView::readingAborted()
+{
+    if ( _liveUpdateTimer->isActive() )
+    {
+	// Otherwise the treemap was disabled during reading, and enabling
+	// it again rebuilds it.
+
+	_liveUpdateTimer->stop();
+	rebuildTreemap();
+    }
+}
+
+
+void TreemapView::liveUpdate()
+{
+    if ( ! _tree || ! _tree->firstToplevel() || ! isVisible() )
+	return;
+
+    if ( ! _rootTile )
+    {
+	rebuildTreemap( _tree->firstToplevel() );
+	return;
+    }
+
+    QList<TreemapTile *> changedTiles;
+    collectChangedTiles( _rootTile, changedTiles );
+
+    if ( changedTiles.isEmpty() )
+	return;
+
+    if ( _singleImage || changedTiles.first() == _rootTile )
+    {
+	// In single image mode, the files are rendered only into the
+	// framebuffer, so there is no way to replace only some of them.
+
+	rebuildTreemap( _rootTile->orig(), sceneRect().size() );
+	return;
+    }
+
+    // logDebug() << "Updating " << changedTiles.size() << " subtrees" << endl;
+
+    // The highlighters may refer to tiles that are about to be deleted
+
+    clearParentsHighlight();
+    clearSceneMask();
+    _currentItem = 0;
+
+    if ( _currentItemRect )
+	_currentItemRect->hide();
+
+    foreach ( TreemapTile * tile, changedTiles )
+	relayoutTile( tile );
+
+    if ( _selectionModel )
+    {
+	updateSelection( _selectionModel->selectedItems() );
+	updateCurrentItem( _selectionModel->currentItem() );
+    }
+
+    emit treemapChanged();
+}
+
+
+void TreemapView::collectChangedTiles( TreemapTile	      * tile,
+				       QList<TreemapTile *> & changedTiles )
+{
+    // Sizes only grow while reading: If the total is still the same,
+    // nothing in the subtree changed.
+
+    if ( tile->orig()->totalAllocatedSize() == tile->layoutSize() )
+	return;
+
+    if ( tileChanged( tile ) )
+    {
+	changedTiles << tile;
+	return;
+    }
+
+    foreach ( QGraphicsItem * item, tile->childItems() )
+    {
+	TreemapTile * child = dynamic_cast<TreemapTile *>( item );
+
+	if ( child && child->orig()->isDirInfo() )
+	    collectChangedTiles( child, changedTiles );
+    }
+}
+
+
+bool TreemapView::tileChanged( TreemapTile * tile )
+{
+    FileSize oldTotal  = tile->layoutSize();
+    FileSize newTotal  = tile->orig()->totalAllocatedSize();
+    double   threshold = _liveUpdateThreshold / 100.0;
+
+    if ( oldTotal <= 0 || newTotal <= 0 )
+	return oldTotal != newTotal;
+
+    // If the total changed that much, so did the share of each file
+
+    if ( qAbs( newTotal - oldTotal ) > threshold * newTotal )
+	return true;
+
+    foreach ( QGraphicsItem * item, tile->childItems() )
+    {
+	TreemapTile * child = dynamic_cast<TreemapTile *>( item );
+
+	if ( child && child->orig()->isDirInfo() )
+	{
+	    double oldShare = child->layoutSize() / (double) oldTotal;
+	    double newShare = child->orig()->totalAllocatedSize() / (double) newTotal;
+
+	    if ( qAbs( newShare - oldShare ) > threshold )
+		return true;
+	}
+    }
+
+    return false;
+}
+
+
+void TreemapView::relayoutTile( TreemapTile * tile )
+{
+    TreemapLayout layout( this, tile->orig(), tile->rect() );
+    layout.setRootSurface( tile->parentSurface(), tile->orientation() );
+    layout.layout();
+    forgetChildTiles( tile );
+
+    foreach ( QGraphicsItem * item, tile->childItems() )
+    {
+	TreemapTile * child = dynamic_cast<TreemapTile *>( item );
+
+	if ( child )
+	{
+	    child->deleteHighlighters();
+	    delete child;	// This deletes its children as well
+	}
+    }
+
+    // The new tiles render their cushions on demand; the tile itself
+    // keeps its cushion surface.
+
+    addTiles( layout, tile );
+    tile->updateLayoutSize();
+}
+
+
+void TreemapView::forgetChildTiles( TreemapTile * tile )
+{
+    foreach ( QGraphicsItem * item, tile->childItems() )
+    {
+	TreemapTile * child = dynamic_cast<TreemapTile *>( item );
+
+	if ( child )
+	{
+	    _tileIndex.remove( child->orig() );
+	    forgetChildTiles( child );
+	}
+    }
+}
+
+
+void TreemapView::startingUpdate()
+{
+    cancelLayout();
+    _treeUpdating = true;
+}
+
+
+void TreemapView::updateFinished()
+{
+    _treeUpdating = false;
+    rebuildTreemap();
+}
+
+
 void TreemapView::resizeEvent( QResizeEvent * event )
 {
     // logDebug() << endl;
@@ -558,7 +1205,12 @@ void TreemapView::updateSelection( const FileInfoSet & newSelection )
 
     // logDebug() << newSelection.size() << " items selected" << endl;
     SignalBlocker sigBlocker( this );
-    scene()->clearSelection();
+
+    // Only change the tiles whose selection really changes: With many
+    // thousands of selected items, deselecting and selecting all of them
+    // again would mean repainting them all.
+
+    QSet<TreemapTile *> newTiles;
 
     foreach ( const FileInfo * item, newSelection )
     {
@@ -566,6 +1218,20 @@ void TreemapView::updateSelection( const FileInfoSet & newSelection )
 	TreemapTile * tile = findTile( item );
 
 	if ( tile )
+	    newTiles.insert( tile );
+    }
+
+    foreach ( QGraphicsItem * item, scene()->selectedItems() )
+    {
+	TreemapTile * tile = dynamic_cast<TreemapTile *>( item );
+
+	if ( ! tile || ! newTiles.contains( tile ) )
+	    item->setSelected( false );
+    }
+
+    foreach ( TreemapTile * tile, newTiles )
+    {
+	if ( ! tile->isSelected() )
 	    tile->setSelected( true );
     }
 
@@ -623,18 +1289,32 @@ TreemapTile * TreemapView::findTile( const FileInfo * fileInfo )
     if ( ! fileInfo || ! scene() )
 	return 0;
 
-    foreach ( QGraphicsItem * graphicsItem, scene()->items() )
-    {
-	TreemapTile * tile = dynamic_cast<TreemapTile *>(graphicsItem);
+    TreemapTile * tile = _tileIndex.value( fileInfo, 0 );
 
-	if ( tile && tile->orig() == fileInfo )
-	    return tile;
-    }
+    if ( tile )
+	return tile;
+
+    // In single image mode, the file tiles are only created on demand
+
+    if ( _singleImage )
+	return _leaves->createTile( _leaves->find( fileInfo ) );
 
     return 0;
 }
 
 
+SelectionOverlay * TreemapView::selectionOverlay()
+{
+    if ( ! _selectionOverlay && scene() )
+    {
+	_selectionOverlay = new SelectionOverlay( scene(), _selectedItemsColor );
+	CHECK_NEW( _selectionOverlay );
+    }
+
+    return _selectionOverlay;
+}
+
+
 QSize TreemapView::visibleSize()
 {
     QSize size = viewport()->size();
@@ -856,6 +1536,73 @@ void CurrentItemHighlighter::highlight( TreemapTile * tile )
 
 
 
+SelectionOverlay::SelectionOverlay( QGraphicsScene * scene, const QColor & color, int lineWidth ):
+    QGraphicsItem(),
+    _sceneRect( scene->sceneRect() ),
+    _pen( color, lineWidth )
+{
+    setZValue( TileHighlightLayer );
+    setAcceptedMouseButtons( Qt::NoButton );
+    setFlag( ItemUsesExtendedStyleOption );	// for exposedRect
+    scene->addItem( this );
+}
+
+
+QRectF SelectionOverlay::outlineRect( const QRectF & rect ) const
+{
+    qreal margin = _pen.widthF();
+
+    return rect.adjusted( -margin, -margin, margin, margin );
+}
+
+
+void SelectionOverlay::add( TreemapTile * tile )
+{
+    if ( ! tile )
+	return;
+
+    QRectF rect = tile->mapRectToScene( tile->rect() );
+    _rects.insert( tile, rect );
+    update( outlineRect( rect ) );
+}
+
+
+void SelectionOverlay::remove( TreemapTile * tile )
+{
+    if ( _rects.contains( tile ) )
+	update( outlineRect( _rects.take( tile ) ) );
+}
+
+
+QRectF SelectionOverlay::boundingRect() const
+{
+    return outlineRect( _sceneRect );
+}
+
+
+QPainterPath SelectionOverlay::shape() const
+{
+    return QPainterPath();
+}
+
+
+void SelectionOverlay::paint( QPainter			     * painter,
+			      const QStyleOptionGraphicsItem * option,
+			      QWidget			     * )
+{
+    painter->setPen( _pen );
+    painter->setBrush( Qt::NoBrush );
+
+    foreach ( const QRectF & rect, _rects )
+    {
+	if ( option->exposedRect.intersects( outlineRect( rect ) ) )
+	    painter->drawRect( rect );
+    }
+}
+
+
+
+
 SceneMask::SceneMask( TreemapTile * tile, float opacity ):
     QGraphicsPathItem(),
     _tile( tile )
@@ -15,8 +15,11 @@
 #include <QGraphicsRectItem>
 #include <QGraphicsPathItem>
 #include <QList>
+#include <QHash>
+#include <QPixmap>
 
 #include "FileInfo.h"
+#include "CushionPixmapGrid.h"
 
 
 #define MinAmbientLight		   0
@@ -33,13 +36,22 @@
 
 
 class QMouseEvent;
+class QWheelEvent;
+class QContextMenuEvent;
 class QSettings;
+class QTimer;
 
 
 namespace QDirStat
 {
     class TreemapTile;
+    class TreemapLeaves;
+    class TreemapLayout;
+    class TreemapLayoutCache;
+    class GLCushionRenderer;
+    class CushionSurface;
     class HighlightRect;
+    class SelectionOverlay;
     class SceneMask;
     class DirTree;
     class SelectionModel;
@@ -125,11 +137,24 @@ namespace QDirStat
 	 * Search the treemap for a tile that corresponds to the specified
 	 * FileInfo node. Returns 0 if there is none.
 	 *
-	 * Notice: This is an expensive operation since all treemap tiles need
-	 * to be searched.
+	 * This is only a hash lookup in the tile index, so it is cheap even
+	 * for hundreds of thousands of tiles.
+	 *
+	 * In single image mode, this creates a tile for a file if there is
+	 * none yet.
 	 **/
 	TreemapTile * findTile( const FileInfo * node );
 
+	/**
+	 * Add a file tile without creating a TreemapTile for it in single
+	 * image mode. This is called when the tiles are created from a
+	 * TreemapLayout.
+	 **/
+	void addLeaf( TreemapTile *	     parentTile,
+		      FileInfo *	     orig,
+		      const QRectF &	     rect,
+		      const CushionSurface & cushionSurface );
+
 	/**
 	 * Returns a suitable color for 'file' based on a set of internal rules
 	 * (according to filename extension, MIME type or permissions).
@@ -198,7 +223,7 @@ namespace QDirStat
 
 	/**
 	 * Completely rebuild the entire treemap from the internal tree's root
-	 * on.
+	 * on. With progressive rendering, this uses startLayout().
 	 **/
 	void rebuildTreemap();
 
@@ -207,6 +232,25 @@ namespace QDirStat
 	 **/
 	void clear();
 
+	/**
+	 * Cancel computing a treemap layout in a separate thread, if there
+	 * is one, and wait until the thread is finished. This is necessary
+	 * before the tree changes.
+	 **/
+	void cancelLayout();
+
+	/**
+	 * Forget all cached layouts. This is necessary whenever the tree
+	 * changes.
+	 **/
+	void invalidateLayoutCache();
+
+	/**
+	 * Notification that memory is getting tight: Drop the cached
+	 * layouts. They are computed again when they are needed.
+	 **/
+	void relieveMemory();
+
 	/**
 	 * Disable this treemap view: Clear its contents, resize it to below
 	 * the update threshold and hide it.
@@ -287,6 +331,20 @@ namespace QDirStat
 	void rebuildTreemap( FileInfo *	    newRoot,
 			     const QSizeF & newSize = QSize() );
 
+	/**
+	 * Compute the layout of a new treemap with 'newRoot' and the visible
+	 * size in a separate thread and show it when it is ready; until
+	 * then, the old treemap stays on the screen. This cancels a layout
+	 * that is still being computed.
+	 *
+	 * If nothing is shown yet, this first shows a coarse treemap with
+	 * only a few levels (the "ProgressiveLevels" setting) and without
+	 * cushion shading.
+	 *
+	 * If the tree is busy, this is the same as rebuildTreemap().
+	 **/
+	void startLayout( FileInfo * newRoot );
+
 	/**
 	 * Schedule a rebuild of the treemap with 'newRoot'. If another rebuild
 	 * is scheduled before the timeout is over, nothing will happen until
@@ -345,8 +403,30 @@ namespace QDirStat
 
 	/**
 	 * Returns 'true' if cushion shading is to be used, 'false' if not.
+	 * The coarse preview of progressive rendering does not use cushion
+	 * shading.
+	 **/
+	bool doCushionShading() const { return _doCushionShading && ! _coarseLayout; }
+
+	/**
+	 * Returns 'true' if the complete treemap is rendered into one image
+	 * and only directories get a treemap tile right away, 'false' if
+	 * each tile paints itself.
+	 **/
+	bool singleImage() const { return _singleImage; }
+
+	/**
+	 * Returns 'true' if the cushions are rendered with OpenGL if that
+	 * is available, 'false' if always with the CPU.
 	 **/
-	bool doCushionShading() const { return _doCushionShading; }
+	bool useOpenGL() const { return _useOpenGL; }
+
+	/**
+	 * Returns 'true' if the treemap is updated periodically while the
+	 * tree is being read, 'false' if it is only built when reading is
+	 * finished.
+	 **/
+	bool liveUpdates() const { return _liveUpdateInterval > 0; }
 
         /**
          * Returns 'true' if directories should be rendered with a gradient,
@@ -382,6 +462,12 @@ namespace QDirStat
 	 **/
 	const QColor & selectedItemsColor() const { return _selectedItemsColor; }
 
+	/**
+	 * Return the overlay that highlights the selected directory tiles.
+	 * Create it if there is none yet.
+	 **/
+	SelectionOverlay * selectionOverlay();
+
 	/**
 	 * Returns the outline color to use if cushion shading is not used.
 	 **/
@@ -443,6 +529,13 @@ namespace QDirStat
 	 **/
 	double heightScaleFactor() const { return _heightScaleFactor; }
 
+	/**
+	 * Returns the pixmaps with the cushions of all tiles; they are null
+	 * if they are not rendered yet. Each tile paints its own part of
+	 * them; in single image mode, they contain the complete treemap.
+	 **/
+	CushionPixmapGrid & cushionPixmaps() { return _cushionPixmaps; }
+
 
     signals:
 
@@ -488,6 +581,56 @@ namespace QDirStat
 	 **/
 	void rebuildTreemapDelayed();
 
+	/**
+	 * Notification that the layout thread from startLayout() is
+	 * finished.
+	 **/
+	void layoutFinished();
+
+	/**
+	 * Notification that deleting children from the tree is done: Rebuild
+	 * the treemap unless the tree is being updated from filesystem
+	 * events, which may delete many children one by one.
+	 **/
+	void childDeleted();
+
+	/**
+	 * Notification that the tree is about to be updated from filesystem
+	 * events.
+	 **/
+	void startingUpdate();
+
+	/**
+	 * Notification that the tree starts reading: Cancel any layout
+	 * thread and start the live updates if configured.
+	 **/
+	void startingReading();
+
+	/**
+	 * Notification that reading the tree is finished: Stop the live
+	 * updates and rebuild the treemap.
+	 **/
+	void readingFinished();
+
+	/**
+	 * Notification that reading the tree was aborted: Stop the live
+	 * updates and rebuild the treemap if there were any.
+	 **/
+	void readingAborted();
+
+	/**
+	 * Update the treemap while the tree is being read: Lay out only the
+	 * subtrees again whose totals changed by more than the live update
+	 * threshold; the rest of the treemap stays as it is.
+	 **/
+	void liveUpdate();
+
+	/**
+	 * Notification that updating the tree from filesystem events is
+	 * finished: Rebuild the treemap.
+	 **/
+	void updateFinished();
+
     protected:
 
 	/**
@@ -499,6 +642,92 @@ namespace QDirStat
 	 **/
 	virtual void resizeEvent( QResizeEvent * event ) Q_DECL_OVERRIDE;
 
+	/**
+	 * Mouse press event: In single image mode, create the tile for the
+	 * file at the mouse position so it gets the event.
+	 *
+	 * Reimplemented from QGraphicsView.
+	 **/
+	virtual void mousePressEvent( QMouseEvent * event ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Mouse wheel event. See mousePressEvent().
+	 *
+	 * Reimplemented from QGraphicsView.
+	 **/
+	virtual void wheelEvent( QWheelEvent * event ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Context menu event. See mousePressEvent().
+	 *
+	 * Reimplemented from QGraphicsView.
+	 **/
+	virtual void contextMenuEvent( QContextMenuEvent * event ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Replace the old treemap with the tiles of 'layout'.
+	 **/
+	void showLayout( const TreemapLayout & layout );
+
+	/**
+	 * Create the tiles of 'layout' (only the directories in single image
+	 * mode) and render the framebuffer.
+	 **/
+	void createTiles( const TreemapLayout & layout );
+
+	/**
+	 * Create the tiles of 'layout' and return the tile of its root. If
+	 * 'rootTile' is non-null, that is used for the root, and only the
+	 * tiles below it are created.
+	 **/
+	TreemapTile * addTiles( const TreemapLayout & layout,
+				TreemapTile *	      rootTile );
+
+	/**
+	 * Recursively collect the topmost tiles of the subtree of 'tile'
+	 * that need to be laid out again in 'changedTiles'.
+	 **/
+	void collectChangedTiles( TreemapTile	       * tile,
+				  QList<TreemapTile *> & changedTiles );
+
+	/**
+	 * Return 'true' if the total of 'tile' or the share of any of its
+	 * directory children changed by more than the live update
+	 * threshold since 'tile' was laid out.
+	 **/
+	bool tileChanged( TreemapTile * tile );
+
+	/**
+	 * Replace the children of 'tile' with a new layout in its rectangle.
+	 **/
+	void relayoutTile( TreemapTile * tile );
+
+	/**
+	 * Remove the tiles below 'tile' (but not 'tile' itself) from the tile
+	 * index before they are deleted.
+	 **/
+	void forgetChildTiles( TreemapTile * tile );
+
+	/**
+	 * In single image mode, create the tile for the file at viewport
+	 * position 'pos' if there is none yet.
+	 **/
+	void createLeafTileAt( const QPoint & pos );
+
+	/**
+	 * Render the cushions of all tiles at once with several threads into
+	 * one framebuffer with the size of the scene and convert it to the
+	 * cushion pixmap. In single image mode, also render the directories
+	 * and the files without cushion shading there.
+	 **/
+	void renderFramebuffer();
+
+	/**
+	 * Return the OpenGL cushion renderer. Create it if there is none
+	 * yet.
+	 **/
+	GLCushionRenderer * glRenderer();
+
 
 	// Data members
 
@@ -510,18 +739,33 @@ namespace QDirStat
 	TreemapTile	    * _rootTile;
 	TreemapTile	    * _currentItem;
 	HighlightRect	    * _currentItemRect;
+	SelectionOverlay    * _selectionOverlay;
         SceneMask           * _sceneMask;
 	FileInfo	    * _newRoot;
         HighlightRectList     _parentHighlightList;
 	QString		      _savedRootUrl;
+	CushionPixmapGrid     _cushionPixmaps;
+	TreemapLeaves	    * _leaves;
+	QHash<const FileInfo *, TreemapTile *> _tileIndex;
+	TreemapLayout	    * _layout;
+	TreemapLayoutCache  * _layoutCache;
+	GLCushionRenderer   * _glRenderer;
+	QTimer		    * _liveUpdateTimer;
 
 	bool   _squarify;
 	bool   _doCushionShading;
+	bool   _singleImage;
+	bool   _useOpenGL;
+	int    _liveUpdateInterval;	// millisec, 0 for no live updates
+	int    _liveUpdateThreshold;	// percent
+	int    _progressiveLevels;
+	bool   _coarseLayout;
 	bool   _forceCushionGrid;
 	bool   _ensureContrast;
 	bool   _useFixedColor;
 	int    _minTileSize;
         bool   _useDirGradient;
+	bool   _treeUpdating;
 
 	QColor _currentItemColor;
 	QColor _selectedItemsColor;
@@ -630,19 +874,74 @@ namespace QDirStat
 
 
     /**
-     * Highlighter for the treemap view's current item.
+     * Highlighter for all selected directory tiles: One scene item on top of
+     * all tiles that paints the outlines of all of them from a list of
+     * rectangles. This cannot be done in the tile's paint() method since the
+     * tile will mostly be obscured by its children.
+     *
+     * Unlike one highlight item for each selected tile, this scales to many
+     * thousands of selected items: Selecting or deselecting a tile only
+     * changes one rectangle in the list and repaints that area.
      *
-     * This one is created on demand for each directory when the directory is
-     * selected; this cannot be done in the tile's paint() method since the
-     * tile will mostly be obscured by its children. This highlighter hovers
-     * above the children as long as the directory is selected.
+     * Selected file tiles paint their own selection frame.
      **/
-    class SelectedItemHighlighter: public HighlightRect
+    class SelectionOverlay: public QGraphicsItem
     {
     public:
-	SelectedItemHighlighter( TreemapTile * tile, const QColor & color, int lineWidth = 2 ):
-	    HighlightRect( tile, color, lineWidth )
-	    {}
+	/**
+	 * Constructor: Create the overlay for 'scene' and add it to the
+	 * scene.
+	 **/
+	SelectionOverlay( QGraphicsScene * scene, const QColor & color, int lineWidth = 2 );
+
+	/**
+	 * Highlight 'tile'.
+	 **/
+	void add( TreemapTile * tile );
+
+	/**
+	 * Remove the highlight of 'tile'.
+	 **/
+	void remove( TreemapTile * tile );
+
+	/**
+	 * Return the number of highlighted tiles.
+	 **/
+	int count() const { return _rects.size(); }
+
+	/**
+	 * Reimplemented from QGraphicsItem.
+	 **/
+	virtual QRectF boundingRect() const Q_DECL_OVERRIDE;
+
+	/**
+	 * Return an empty shape, so this never gets any mouse events or
+	 * tooltips; they belong to the tiles below.
+	 *
+	 * Reimplemented from QGraphicsItem.
+	 **/
+	virtual QPainterPath shape() const Q_DECL_OVERRIDE;
+
+	/**
+	 * Paint the outlines of the highlighted tiles in the exposed area.
+	 *
+	 * Reimplemented from QGraphicsItem.
+	 **/
+	virtual void paint( QPainter			   * painter,
+			    const QStyleOptionGraphicsItem * option,
+			    QWidget			   * widget = 0 ) Q_DECL_OVERRIDE;
+
+    protected:
+
+	/**
+	 * Return the area that the outline of 'rect' covers.
+	 **/
+	QRectF outlineRect( const QRectF & rect ) const;
+
+
+	QHash<TreemapTile *, QRectF> _rects;	// in scene coordinates
+	QRectF			     _sceneRect;
+	QPen			     _pen;
     };
 
 
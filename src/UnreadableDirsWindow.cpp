@@ -12,7 +12,7 @@
 #include "UnreadableDirsWindow.h"
 #include "QDirStatApp.h"        // SelectionModel
 #include "DirTree.h"
-#include "Attic.h"
+#include "DirInfo.h"
 #include "SelectionModel.h"
 #include "SettingsHelpers.h"
 #include "HeaderTweaker.h"
@@ -121,7 +121,7 @@ void UnreadableDirsWindow::populate( FileInfo * newSubtree )
 
     logDebug() << "Locating all unreadable dirs below " << _subtree.url() << endl;
 
-    populateRecursive( newSubtree ? newSubtree : _subtree() );
+    addErrorDirs( newSubtree ? newSubtree : _subtree() );
     _ui->treeWidget->sortByColumn( 0, Qt::AscendingOrder );
 
     int count = _ui->treeWidget->topLevelItemCount();
@@ -150,14 +150,12 @@ void UnreadableDirsWindow::populate( FileInfo * newSubtree )
 }
 
 
-void UnreadableDirsWindow::populateRecursive( FileInfo * subtree )
+void UnreadableDirsWindow::addErrorDirs( FileInfo * subtree )
 {
-    if ( ! subtree || ! subtree->isDirInfo() )
+    if ( ! subtree || ! subtree->tree() )
 	return;
 
-    DirInfo * dir = subtree->toDirInfo();
-
-    if ( dir->readError() )
+    foreach ( DirInfo * dir, subtree->tree()->errorDirs( subtree ) )
     {
 	UnreadableDirListItem * searchResultItem =
 	    new UnreadableDirListItem( dir->url(),
@@ -169,25 +167,6 @@ void UnreadableDirsWindow::populateRecursive( FileInfo * subtree )
 
 	_ui->treeWidget->addTopLevelItem( searchResultItem );
     }
-
-
-    // Recurse through any subdirectories
-
-    FileInfo * child = dir->firstChild();
-
-    while ( child )
-    {
-	if ( child->isDir() )
-	    populateRecursive( child );
-
-	child = child->next();
-    }
-
-    if ( dir->attic() )
-        populateRecursive( dir->attic() );
-
-    // No need to recurse through dot entries; they can't have any read error
-    // or any subdirectory children which might have a read error.
 }
 
 
@@ -145,10 +145,11 @@ namespace QDirStat
 	void initWidgets();
 
 	/**
-	 * Recursively find unreadable directories in a subtree and add an
-	 * entry to the tree widget for each one.
+	 * Add an entry to the tree widget for each unreadable directory in a
+	 * subtree. This uses the tree's index of directories with a read
+	 * error, so it does not need to traverse the subtree.
 	 **/
-	void populateRecursive( FileInfo * subtree );
+	void addErrorDirs( FileInfo * subtree );
 
 
 	//
@@ -0,0 +1,411 @@
+/*
+ *   File name: ZstdFile.cpp
+ *   Summary:	Reading and writing zstd-compressed cache files
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <string.h>
+
+#include <QFile>
+#include <QThread>
+
+#ifdef HAVE_ZSTD
+#  include <zstd.h>
+#endif
+
+#include "ZstdFile.h"
+#include "Logger.h"
+
+// Collect this much uncompressed data before handing it to the compressor
+#define WRITE_BUF_SIZE		( 256 * 1024 )
+
+#define ZSTD_COMPRESSION_LEVEL	3
+
+
+using namespace QDirStat;
+
+
+ZstdReader::ZstdReader( const QString & fileName ):
+    _fileName( fileName ),
+    _file( 0 ),
+    _fileEof( false ),
+    _flushPending( false ),
+    _error( false ),
+    _inPos( 0 ),
+    _inSize( 0 ),
+    _outPos( 0 ),
+    _outSize( 0 )
+{
+#ifdef HAVE_ZSTD
+    _dctx = ZSTD_createDCtx();
+
+    if ( ! _dctx )
+    {
+	_error = true;
+	return;
+    }
+
+    _file = fopen( fileName.toUtf8().constData(), "r" );
+
+    if ( ! _file )
+    {
+	logError() << "Can't open " << fileName << ": " << formatErrno() << endl;
+	return;
+    }
+
+    _in.resize ( ZSTD_DStreamInSize()  );
+    _out.resize( ZSTD_DStreamOutSize() );
+#else
+    logError() << "Can't read " << fileName << ": No zstd support" << endl;
+    _error = true;
+#endif
+}
+
+
+ZstdReader::~ZstdReader()
+{
+    if ( _file )
+	fclose( _file );
+
+#ifdef HAVE_ZSTD
+    if ( _dctx )
+	ZSTD_freeDCtx( _dctx );
+#endif
+}
+
+
+bool ZstdReader::fill()
+{
+    _outPos  = 0;
+    _outSize = 0;
+
+#ifdef HAVE_ZSTD
+    while ( ok() )
+    {
+	if ( _inPos == _inSize && ! _flushPending )
+	{
+	    if ( _fileEof )
+		return false;
+
+	    _inSize = fread( _in.data(), 1, _in.size(), _file );
+	    _inPos  = 0;
+
+	    if ( _inSize == 0 )
+	    {
+		_fileEof = true;
+
+		if ( ferror( _file ) )
+		{
+		    logError() << "Read error in " << _fileName << endl;
+		    _error = true;
+		}
+
+		return false;
+	    }
+	}
+
+	ZSTD_inBuffer  in  = { _in.constData(), _inSize, _inPos };
+	ZSTD_outBuffer out = { _out.data(), (size_t) _out.size(), 0 };
+
+	size_t result = ZSTD_decompressStream( _dctx, &out, &in );
+
+	if ( ZSTD_isError( result ) )
+	{
+	    logError() << "zstd error in " << _fileName << ": "
+		       << ZSTD_getErrorName( result ) << endl;
+	    _error = true;
+	    return false;
+	}
+
+	_inPos	      = in.pos;
+	_flushPending = out.pos == out.size;	// There might be more output
+
+	if ( out.pos > 0 )
+	{
+	    _outSize = out.pos;
+	    return true;
+	}
+    }
+#endif
+
+    return false;
+}
+
+
+char * ZstdReader::gets( char * buf, int len )
+{
+    if ( ! ok() || ! buf || len < 1 )
+	return 0;
+
+    int count = 0;
+
+    while ( count < len - 1 )
+    {
+	if ( _outPos == _outSize && ! fill() )
+	    break;
+
+	// Copy up to and including the next newline
+
+	const char * start = _out.constData() + _outPos;
+	size_t	     avail = qMin( _outSize - _outPos, (size_t) ( len - 1 - count ) );
+	const char * nl	   = (const char *) memchr( start, '\n', avail );
+	size_t	     bytes = nl ? nl - start + 1 : avail;
+
+	memcpy( buf + count, start, bytes );
+	count	+= bytes;
+	_outPos += bytes;
+
+	if ( nl )
+	    break;
+    }
+
+    buf[ count ] = 0;
+
+    return count > 0 && ! _error ? buf : 0;
+}
+
+
+int ZstdReader::read( char * buf, int len )
+{
+    if ( ! ok() || ! buf || len < 0 )
+	return -1;
+
+    int count = 0;
+
+    while ( count < len )
+    {
+	if ( _outPos == _outSize && ! fill() )
+	    break;
+
+	size_t bytes = qMin( _outSize - _outPos, (size_t) ( len - count ) );
+	memcpy( buf + count, _out.constData() + _outPos, bytes );
+	count	+= bytes;
+	_outPos += bytes;
+    }
+
+    return _error ? -1 : count;
+}
+
+
+bool ZstdReader::eof() const
+{
+    if ( ! ok() )
+	return true;
+
+    return _fileEof && ! _flushPending && _inPos == _inSize && _outPos == _outSize;
+}
+
+
+void ZstdReader::rewind()
+{
+    seek( 0 );
+}
+
+
+bool ZstdReader::seek( qint64 offset )
+{
+    if ( ! _file )
+	return false;
+
+    if ( fseeko( _file, offset, SEEK_SET ) != 0 )
+    {
+	logError() << "Can't seek in " << _fileName << ": " << formatErrno() << endl;
+	_error = true;
+	return false;
+    }
+
+    _fileEof	  = false;
+    _flushPending = false;
+    _error	  = false;
+    _inPos	  = 0;
+    _inSize	  = 0;
+    _outPos	  = 0;
+    _outSize	  = 0;
+
+#ifdef HAVE_ZSTD
+    ZSTD_DCtx_reset( _dctx, ZSTD_reset_session_only );
+#endif
+
+    return true;
+}
+
+
+bool ZstdReader::isZstdFile( const QString & fileName )
+{
+    QFile file( fileName );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+	return false;
+
+    // The zstd frame magic number 0xFD2FB528 in little endian byte order
+
+    const char magic[] = { '\x28', '\xB5', '\x2F', '\xFD' };
+
+    return file.read( sizeof( magic ) ) == QByteArray( magic, sizeof( magic ) );
+}
+
+
+bool ZstdReader::isSupported()
+{
+#ifdef HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+
+
+ZstdWriter::ZstdWriter( const QString & fileName ):
+    _fileName( fileName ),
+    _file( 0 ),
+    _error( false ),
+    _frameOpen( false )
+{
+#ifdef HAVE_ZSTD
+    _cctx = ZSTD_createCCtx();
+
+    if ( ! _cctx )
+    {
+	_error = true;
+	return;
+    }
+
+    ZSTD_CCtx_setParameter( _cctx, ZSTD_c_compressionLevel, ZSTD_COMPRESSION_LEVEL );
+
+    // This fails if libzstd was built without multithreading support;
+    // compression then simply uses this thread.
+
+    size_t result = ZSTD_CCtx_setParameter( _cctx, ZSTD_c_nbWorkers,
+					    QThread::idealThreadCount() );
+    if ( ZSTD_isError( result ) )
+	logInfo() << "No multithreaded zstd compression" << endl;
+
+    _file = fopen( fileName.toUtf8().constData(), "w" );
+
+    if ( ! _file )
+    {
+	logError() << "Can't open " << fileName << ": " << formatErrno() << endl;
+	return;
+    }
+
+    _in.reserve( WRITE_BUF_SIZE );
+    _out.resize( ZSTD_CStreamOutSize() );
+#else
+    logError() << "Can't write " << fileName << ": No zstd support" << endl;
+    _error = true;
+#endif
+}
+
+
+ZstdWriter::~ZstdWriter()
+{
+    if ( _file )
+	close();
+
+#ifdef HAVE_ZSTD
+    if ( _cctx )
+	ZSTD_freeCCtx( _cctx );
+#endif
+}
+
+
+void ZstdWriter::write( const QByteArray & data )
+{
+    if ( ! ok() )
+	return;
+
+    _in += data;
+    _frameOpen = true;
+
+    if ( _in.size() >= WRITE_BUF_SIZE )
+	compress( false );
+}
+
+
+void ZstdWriter::endFrame()
+{
+    // Don't write an empty frame if nothing was written since the last one
+
+    if ( ok() && _frameOpen )
+	compress( true );
+
+    _frameOpen = false;
+}
+
+
+void ZstdWriter::writeRaw( const QByteArray & frames )
+{
+    endFrame();
+
+    if ( ! ok() )
+	return;
+
+    if ( fwrite( frames.constData(), 1, frames.size(), _file ) != (size_t) frames.size() )
+    {
+	logError() << "Write error in " << _fileName << ": " << formatErrno() << endl;
+	_error = true;
+    }
+}
+
+
+qint64 ZstdWriter::offset()
+{
+    return _file ? (qint64) ftello( _file ) : -1;
+}
+
+
+void ZstdWriter::compress( bool finish )
+{
+#ifdef HAVE_ZSTD
+    ZSTD_inBuffer in = { _in.constData(), (size_t) _in.size(), 0 };
+    bool done = false;
+
+    while ( ! done && ! _error )
+    {
+	ZSTD_outBuffer out = { _out.data(), (size_t) _out.size(), 0 };
+	size_t remaining = ZSTD_compressStream2( _cctx, &out, &in,
+						 finish ? ZSTD_e_end : ZSTD_e_continue );
+	if ( ZSTD_isError( remaining ) )
+	{
+	    logError() << "zstd error in " << _fileName << ": "
+		       << ZSTD_getErrorName( remaining ) << endl;
+	    _error = true;
+	    break;
+	}
+
+	if ( out.pos > 0 && fwrite( out.dst, 1, out.pos, _file ) != out.pos )
+	{
+	    logError() << "Write error in " << _fileName << ": " << formatErrno() << endl;
+	    _error = true;
+	    break;
+	}
+
+	done = finish ? remaining == 0 : in.pos == in.size;
+    }
+#else
+    Q_UNUSED( finish );
+#endif
+
+    _in.resize( 0 );	// keeps the reserved capacity
+}
+
+
+bool ZstdWriter::close()
+{
+    if ( ! _file )
+	return false;
+
+    endFrame();
+
+    if ( fclose( _file ) != 0 )
+	_error = true;
+
+    _file = 0;
+
+    return ! _error;
+}
@@ -0,0 +1,204 @@
+/*
+ *   File name: ZstdFile.h
+ *   Summary:	Reading and writing zstd-compressed cache files
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef ZstdFile_h
+#define ZstdFile_h
+
+
+#include <stdio.h>
+
+#include <QString>
+#include <QByteArray>
+
+
+// HAVE_ZSTD is defined in src.pro if libzstd is found with pkg-config
+
+#ifdef HAVE_ZSTD
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+#endif
+
+
+namespace QDirStat
+{
+    /**
+     * Reader for a zstd-compressed text file with an interface similar to
+     * zlib's gzgets() / gzeof() / gzrewind().
+     *
+     * If QDirStat was built without libzstd, this can still detect a zstd
+     * file with isZstdFile(), but opening it always fails.
+     **/
+    class ZstdReader
+    {
+    public:
+
+	/**
+	 * Constructor: Open 'fileName' for reading. Check with ok() if that
+	 * was successful.
+	 **/
+	ZstdReader( const QString & fileName );
+
+	/**
+	 * Destructor. This closes the file.
+	 **/
+	~ZstdReader();
+
+	/**
+	 * Return 'true' if the file is open and there was no error.
+	 **/
+	bool ok() const { return _file && ! _error; }
+
+	/**
+	 * Read one line (including the trailing newline) of at most 'len' - 1
+	 * characters into 'buf' and terminate it with a 0 byte, just like
+	 * gzgets(). Return 'buf' or 0 if there was nothing more to read or if
+	 * there was an error.
+	 **/
+	char * gets( char * buf, int len );
+
+	/**
+	 * Read up to 'len' bytes of uncompressed data into 'buf', just like
+	 * gzread(). Return the number of bytes read, 0 at the end of the file
+	 * or -1 if there was an error.
+	 **/
+	int read( char * buf, int len );
+
+	/**
+	 * Return 'true' if the end of the file is reached.
+	 **/
+	bool eof() const;
+
+	/**
+	 * Start reading from the beginning of the file again.
+	 **/
+	void rewind();
+
+	/**
+	 * Continue reading at compressed offset 'offset' in the file. This
+	 * has to be the start of a zstd frame. Return 'false' on error.
+	 **/
+	bool seek( qint64 offset );
+
+	/**
+	 * Return 'true' if 'fileName' starts with the zstd magic number.
+	 **/
+	static bool isZstdFile( const QString & fileName );
+
+	/**
+	 * Return 'true' if QDirStat was built with zstd support.
+	 **/
+	static bool isSupported();
+
+
+    protected:
+
+	/**
+	 * Decompress the next part of the file into _out. Return 'false' if
+	 * there is no more data.
+	 **/
+	bool fill();
+
+
+	QString		_fileName;
+	FILE *		_file;
+	bool		_fileEof;
+	bool		_flushPending;
+	bool		_error;
+	QByteArray	_in;
+	size_t		_inPos;
+	size_t		_inSize;
+	QByteArray	_out;
+	size_t		_outPos;
+	size_t		_outSize;
+
+#ifdef HAVE_ZSTD
+	ZSTD_DCtx_s *	_dctx;
+#endif
+    };
+
+
+    /**
+     * Writer for a zstd-compressed file. Compression uses several threads
+     * if libzstd supports that.
+     **/
+    class ZstdWriter
+    {
+    public:
+
+	/**
+	 * Constructor: Create 'fileName' for writing. Check with ok() if that
+	 * was successful.
+	 **/
+	ZstdWriter( const QString & fileName );
+
+	/**
+	 * Destructor. This calls close() if that was not done yet.
+	 **/
+	~ZstdWriter();
+
+	/**
+	 * Return 'true' if the file is open and there was no error.
+	 **/
+	bool ok() const { return _file && ! _error; }
+
+	/**
+	 * Compress and write 'data'.
+	 **/
+	void write( const QByteArray & data );
+
+	/**
+	 * Finish the current zstd frame, so the data written so far can be
+	 * decompressed independently of what follows. The next write() starts
+	 * a new frame. Concatenated frames are a valid zstd file.
+	 **/
+	void endFrame();
+
+	/**
+	 * Write data that are already compressed (one or more complete zstd
+	 * frames) to the file. This ends the current frame first.
+	 **/
+	void writeRaw( const QByteArray & frames );
+
+	/**
+	 * Return the current offset in the (compressed) file. This is only
+	 * meaningful right after endFrame() or writeRaw().
+	 **/
+	qint64 offset();
+
+	/**
+	 * Finish the compressed stream and close the file. Return 'true' if
+	 * everything was written successfully.
+	 **/
+	bool close();
+
+
+    protected:
+
+	/**
+	 * Compress the buffered input. 'finish' ends the compressed stream.
+	 **/
+	void compress( bool finish );
+
+
+	QString		_fileName;
+	FILE *		_file;
+	bool		_error;
+	bool		_frameOpen;
+	QByteArray	_in;
+	QByteArray	_out;
+
+#ifdef HAVE_ZSTD
+	ZSTD_CCtx_s *	_cctx;
+#endif
+    };
+
+}	// namespace QDirStat
+
+
+#endif // ifndef ZstdFile_h
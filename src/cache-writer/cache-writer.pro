@@ -0,0 +1,29 @@
+# qmake .pro file for qdirstat/src/cache-writer
+#
+# This builds qdirstat-cache-writer, a program without any GUI that reads a
+# directory tree with the same classes as QDirStat itself and writes a cache
+# file. It does not need a display, so it can be run from cron jobs; it
+# replaces the old Perl script of the same name.
+#
+# It still links against the Qt widgets library because some of the classes
+# it uses are shared with the GUI (see ../core.pri), but it never creates a
+# QApplication.
+
+TEMPLATE	 = app
+
+QT		+= widgets
+MOC_DIR		 = .moc
+OBJECTS_DIR	 = .obj
+isEmpty(INSTALL_PREFIX):INSTALL_PREFIX = /usr
+
+TARGET		 = qdirstat-cache-writer
+TARGET.files	 = qdirstat-cache-writer
+TARGET.path	 = $$INSTALL_PREFIX/bin
+INSTALLS	+= TARGET
+
+QMAKE_CXXFLAGS	+=  -Wno-deprecated -Wno-deprecated-declarations
+
+
+SOURCES	  = main.cpp
+
+include(../core.pri)
@@ -0,0 +1,447 @@
+/*
+ *   File name: main.cpp
+ *   Summary:	Headless QDirStat cache writer main program
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <unistd.h>	// STDOUT_FILENO
+#include <iostream>	// cerr, cout
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QDateTime>
+
+#include "DirTree.h"
+#include "DirTreeCache.h"
+#include "DirInfo.h"
+#include "SnapshotStore.h"
+#include "TreeExporter.h"
+#include "ExcludeRules.h"
+#include "FormatUtil.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+#include "Version.h"
+
+
+using std::cerr;
+using std::cout;
+using namespace QDirStat;
+
+static const char * progName = "qdirstat-cache-writer";
+
+#define CHECKPOINT_SUFFIX	".checkpoint"
+
+
+void usage()
+{
+    cerr << "\n"
+	 << "Usage: \n"
+	 << "\n"
+	 << "  " << progName << " [-lmvdehrunbp] [-j <threads>] [-t <stats>] [-c <minutes>] [-x <export-file>] [-N <hosts>] <directory> [<cache-file-name>]\n"
+	 << "  " << progName << " -s [-lmdenb] [-j <threads>] [-t <stats>] <directory>\n"
+	 << "  " << progName << " -i [-d] -H <store> <cache-file-name> [<cache-file-name>...]\n"
+	 << "\n"
+	 << "If not specified, <cache-file-name> defaults to \"" << DEFAULT_CACHE_NAME << "\"\n"
+	 << "in <directory>.\n"
+	 << "\n"
+	 << "  -l  long format - always add full path, even for plain files\n"
+	 << "  -m  scan mounted filesystems (cross filesystem boundaries)\n"
+	 << "  -v  verbose\n"
+	 << "  -d  debug\n"
+	 << "  -e  apply the exclude rules from the QDirStat settings\n"
+	 << "  -j  number of threads for reading directories (default: automatic)\n"
+	 << "  -t  read at most <stats> directory entries per second\n"
+	 << "  -n  nice: read directories only when no other process needs the disk\n"
+	 << "      (idle I/O scheduling class)\n"
+	 << "  -b  bulk: if <directory> is the mount point of an XFS filesystem, read\n"
+	 << "      all its inodes at once rather than stat() each file (needs root)\n"
+	 << "  -p  prefix-compressed paths: write each full path as the number of\n"
+	 << "      bytes it shares with the previous one and the rest\n"
+	 << "      (cache format 1.1: smaller, but older versions of QDirStat cannot read it)\n"
+	 << "  -c  write a checkpoint to <cache-file-name>" CHECKPOINT_SUFFIX " every <minutes>\n"
+	 << "      while reading\n"
+	 << "  -r  resume reading from that checkpoint if there is one\n"
+	 << "  -u  update <cache-file-name> if it exists: take the content of each\n"
+	 << "      directory whose mtime did not change from it rather than reading it\n"
+	 << "  -N  distribute reading the subdirectories of <directory> over <hosts>\n"
+	 << "      (comma-separated, a host may be listed more than once) with\n"
+	 << "      \"" << progName << " -s\" over ssh; <directory> has to be mounted there\n"
+	 << "  -s  stream the uncompressed cache to stdout while reading\n"
+	 << "      (for \"qdirstat ssh://host/dir\")\n"
+	 << "  -H  also add the directory sizes to the snapshot history <store>\n"
+	 << "      (a directory; QDirStat uses " << DEFAULT_SNAPSHOT_STORE << " in the home directory)\n"
+	 << "  -x  also export the tree to <export-file> as CSV, or as NDJSON if it\n"
+	 << "      ends with .ndjson, .jsonl or .json\n"
+	 << "  -i  import existing cache files into the snapshot history (-H)\n"
+	 << "      with the time of each cache file\n"
+	 << "  -h  help (this usage message)\n"
+	 << "\n"
+	 << "This does not need a display, so it can be used in cron jobs.\n"
+	 << std::endl;
+}
+
+
+/**
+ * Add the directory sizes from each of the cache files 'cacheFileNames' to
+ * the snapshot history store 'storeDir' with the time of the cache file.
+ * Return the exit code for main().
+ **/
+int importSnapshots( const QStringList & cacheFileNames, const QString & storeDir )
+{
+    SnapshotStore store( storeDir );
+    int exitCode = 0;
+
+    foreach ( const QString & cacheFileName, cacheFileNames )
+    {
+	DirTree tree;
+
+	{
+	    CacheReader reader( cacheFileName, &tree );
+
+	    if ( reader.ok() )
+		reader.read();	// The entire file
+	}
+
+	// The reader finalizes the tree when it is destroyed
+
+	FileInfo * toplevel = tree.firstToplevel();
+	time_t	   time	    = QFileInfo( cacheFileName ).lastModified().toTime_t();
+
+	if ( ! toplevel || ! store.addSnapshot( toplevel, time ) )
+	{
+	    cerr << progName << ": Could not import " << qPrintable( cacheFileName ) << std::endl;
+	    exitCode = 1;
+	}
+    }
+
+    return exitCode;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    Logger logger( "/tmp/qdirstat-$USER", "qdirstat-cache-writer.log" );
+    logger.setLogLevel( LogSeverityInfo );
+    logInfo() << "qdirstat-cache-writer " << QDIRSTAT_VERSION
+	      << " built with Qt " << QT_VERSION_STR << endl;
+
+    // Set org/app name for QSettings: The exclude rules are the same as for
+    // QDirStat.
+
+    QCoreApplication::setOrganizationName( "QDirStat" );
+    QCoreApplication::setApplicationName ( "QDirStat" );
+
+    QCoreApplication qtApp( argc, argv );
+    QStringList argList = QCoreApplication::arguments();
+    argList.removeFirst(); // Remove program name
+
+    bool longFormat	  = false;
+    bool crossFilesystems = false;
+    bool verbose	  = false;
+    bool useExcludeRules  = false;
+    bool stream		  = false;
+    bool import		  = false;
+    bool resume		  = false;
+    bool update		  = false;
+    bool idleIoPriority	  = false;
+    bool bulkStat	  = false;
+    bool compactPaths	  = false;
+    int	 readThreads	  = 0;
+    int	 statRateLimit	  = 0;
+    int	 checkpointMinutes = 0;
+    QString snapshotStore;
+    QString exportFile;
+    QStringList scanHosts;
+    QStringList params;
+
+    // Single-letter options that may be combined like with getopts: "-lv"
+
+    while ( ! argList.isEmpty() )
+    {
+	QString arg = argList.takeFirst();
+
+	if ( ! arg.startsWith( "-" ) || arg == "-" )
+	{
+	    params << arg;
+	    continue;
+	}
+
+	for ( int i = 1; i < arg.size(); ++i )
+	{
+	    switch ( arg.at( i ).toLatin1() )
+	    {
+		case 'l': longFormat	   = true; break;
+		case 'm': crossFilesystems = true; break;
+		case 'v': verbose	   = true; break;
+		case 'd': logger.setLogLevel( LogSeverityDebug ); break;
+		case 'e': useExcludeRules  = true; break;
+		case 's': stream	   = true; break;
+		case 'i': import	   = true; break;
+		case 'r': resume	   = true; break;
+		case 'u': update	   = true; break;
+		case 'n': idleIoPriority   = true; break;
+		case 'b': bulkStat	   = true; break;
+		case 'p': compactPaths	   = true; break;
+
+		case 'H':
+		    if ( argList.isEmpty() )
+		    {
+			usage();
+			return 1;
+		    }
+
+		    snapshotStore = argList.takeFirst();
+		    break;
+
+		case 'x':
+		    if ( argList.isEmpty() )
+		    {
+			usage();
+			return 1;
+		    }
+
+		    exportFile = argList.takeFirst();
+		    break;
+
+		case 'N':
+		    if ( argList.isEmpty() )
+		    {
+			usage();
+			return 1;
+		    }
+
+		    scanHosts = argList.takeFirst().split( ',', QString::SkipEmptyParts );
+		    break;
+
+		case 'j':
+		    {
+			bool ok = ! argList.isEmpty();
+
+			if ( ok )
+			    readThreads = argList.takeFirst().toInt( &ok );
+
+			if ( ! ok || readThreads < 0 )
+			{
+			    usage();
+			    return 1;
+			}
+		    }
+		    break;
+
+		case 't':
+		    {
+			bool ok = ! argList.isEmpty();
+
+			if ( ok )
+			    statRateLimit = argList.takeFirst().toInt( &ok );
+
+			if ( ! ok || statRateLimit < 1 )
+			{
+			    usage();
+			    return 1;
+			}
+		    }
+		    break;
+
+		case 'c':
+		    {
+			bool ok = ! argList.isEmpty();
+
+			if ( ok )
+			    checkpointMinutes = argList.takeFirst().toInt( &ok );
+
+			if ( ! ok || checkpointMinutes < 1 )
+			{
+			    usage();
+			    return 1;
+			}
+		    }
+		    break;
+
+		case 'h':
+		    usage();
+		    return 0;
+
+		default:
+		    usage();
+		    return 1;
+	    }
+	}
+    }
+
+    if ( import )
+    {
+	if ( params.isEmpty() || snapshotStore.isEmpty() )
+	{
+	    usage();
+	    return 1;
+	}
+
+	return importSnapshots( params, snapshotStore );
+    }
+
+    // One or two parameters are required
+
+    if ( params.isEmpty() || params.size() > ( stream ? 1 : 2 ) )
+    {
+	usage();
+	return 1;
+    }
+
+    if ( stream )
+	verbose = false;	// stdout is the cache
+
+    QString dir = QFileInfo( params.first() ).absoluteFilePath();
+    QString cacheFileName = params.size() > 1 ?
+	params.at( 1 ) : dir + "/" + DEFAULT_CACHE_NAME;
+
+    if ( ! QFileInfo( dir ).isDir() )
+    {
+	cerr << progName << ": Not a directory: " << qPrintable( dir ) << std::endl;
+	return 1;
+    }
+
+    if ( useExcludeRules )
+	ExcludeRules::instance()->readSettings();
+
+    DirTree tree;
+    tree.setCrossFilesystems( crossFilesystems );
+    tree.setReadThreads( readThreads );
+    tree.setStatRateLimit( statRateLimit );
+    tree.setIdleIoPriority( idleIoPriority );
+    tree.setBulkStat( bulkStat );
+    tree.setScanHosts( scanHosts );
+    tree.setCompactCachePaths( compactPaths );
+
+    QObject::connect( &tree,  SIGNAL( finished() ),
+		      &qtApp, SLOT  ( quit()	 ) );
+
+    QObject::connect( &tree,  SIGNAL( aborted()	 ),
+		      &qtApp, SLOT  ( quit()	 ) );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if ( verbose )
+	cout << "Reading " << qPrintable( dir ) << std::endl;
+
+    CacheStreamWriter * streamWriter = 0;
+
+    if ( stream )
+    {
+	// Write each directory as soon as it is read
+
+	streamWriter = new CacheStreamWriter( STDOUT_FILENO, &tree, longFormat );
+	CHECK_NEW( streamWriter );
+    }
+
+    QString checkpoint = cacheFileName + CHECKPOINT_SUFFIX;
+
+    if ( checkpointMinutes > 0 && ! stream )
+	tree.setCheckpoint( checkpoint, checkpointMinutes * 60 );
+
+    if ( resume && ! stream && QFileInfo( checkpoint ).exists() && tree.resumeReading( checkpoint ) )
+    {
+	if ( verbose )
+	    cout << "Resuming from " << qPrintable( checkpoint ) << std::endl;
+    }
+    else if ( update && ! stream && QFileInfo( cacheFileName ).exists() )
+    {
+	if ( verbose )
+	    cout << "Updating " << qPrintable( cacheFileName ) << std::endl;
+
+	tree.rescanWithCache( dir, cacheFileName );
+    }
+    else
+    {
+	tree.startReading( dir );
+    }
+
+    if ( tree.isBusy() )
+	qtApp.exec();
+
+    if ( streamWriter )
+    {
+	bool ok = streamWriter->ok();
+	delete streamWriter;
+
+	logInfo() << "Streamed " << dir << " in " << timer.elapsed() << " millisec" << endl;
+
+	if ( useExcludeRules )
+	    Settings::fixFileOwners();
+
+	return ok && tree.root() && tree.root()->firstChild() ? 0 : 1;
+    }
+
+    FileInfo * toplevel = tree.root() ? tree.root()->firstChild() : 0;
+
+    if ( ! toplevel )
+    {
+	cerr << progName << ": Could not read " << qPrintable( dir ) << std::endl;
+	return 1;
+    }
+
+    if ( verbose )
+    {
+	cout << "Read " << toplevel->totalItems() << " items"
+	     << " with a total size of " << qPrintable( formatSize( toplevel->totalSize() ) )
+	     << " in " << qPrintable( formatMillisec( timer.elapsed() ) ) << std::endl;
+
+	cout << "Writing " << qPrintable( cacheFileName ) << std::endl;
+    }
+
+    CacheWriter writer( cacheFileName, &tree, longFormat );
+
+    if ( ! writer.ok() )
+    {
+	cerr << progName << ": Could not write " << qPrintable( cacheFileName ) << std::endl;
+	return 1;
+    }
+
+    logInfo() << "Wrote " << cacheFileName << " in " << timer.elapsed() << " millisec" << endl;
+
+    if ( resume )	// The checkpoint we resumed from is obsolete now
+	CacheCheckpoint::remove( checkpoint );
+
+    if ( ! exportFile.isEmpty() )
+    {
+	if ( verbose )
+	    cout << "Exporting to " << qPrintable( exportFile ) << std::endl;
+
+	TreeExporter exporter( TreeExporter::formatForFileName( exportFile ) );
+	TreeExporter::prepareTree( &tree );
+
+	if ( ! exporter.write( exportFile, tree.firstToplevel() ) )
+	{
+	    cerr << progName << ": Could not write " << qPrintable( exportFile ) << std::endl;
+	    return 1;
+	}
+    }
+
+    if ( ! snapshotStore.isEmpty() )
+    {
+	SnapshotStore store( snapshotStore );
+
+	if ( ! store.addSnapshot( toplevel ) )
+	{
+	    cerr << progName << ": Could not add a snapshot to " << qPrintable( snapshotStore ) << std::endl;
+	    return 1;
+	}
+    }
+
+    if ( verbose )
+	cout << "Done after " << qPrintable( formatMillisec( timer.elapsed() ) ) << std::endl;
+
+    // If running with 'sudo', don't leave any config files behind that are
+    // owned by root.
+
+    if ( useExcludeRules )
+	Settings::fixFileOwners();
+
+    return 0;
+}
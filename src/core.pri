@@ -0,0 +1,219 @@
+# qmake include file for qdirstat/src
+#
+# The classes that read, write and hold a directory tree without any
+# windows, for programs other than QDirStat itself that use them:
+#
+#     include(../core.pri)
+#
+# They still need the Qt widgets library: Some of them are shared with the
+# GUI (messages in the package manager classes, window settings).
+
+QT		+= widgets
+DEPENDPATH	+= $$PWD
+INCLUDEPATH	+= $$PWD
+LIBS		+= -lz
+
+packagesExist(libzstd) {
+    CONFIG	+= link_pkgconfig
+    PKGCONFIG	+= libzstd
+    DEFINES	+= HAVE_ZSTD
+}
+
+packagesExist(rpm) {
+    CONFIG	+= link_pkgconfig
+    PKGCONFIG	+= rpm
+    DEFINES	+= HAVE_LIBRPM
+}
+
+major_is_less_5 = $$find(QT_MAJOR_VERSION, [234])
+!isEmpty(major_is_less_5):DEFINES += 'Q_DECL_OVERRIDE=""'
+
+
+SOURCES	 +=				\
+	    $$PWD/Attic.cpp		\
+	    $$PWD/BulkInodeTable.cpp	\
+	    $$PWD/CacheReadPipeline.cpp	\
+	    $$PWD/DataColumns.cpp	\
+	    $$PWD/DebugHelpers.cpp	\
+	    $$PWD/DirFdCache.cpp	\
+	    $$PWD/DirInfo.cpp		\
+	    $$PWD/DirReadJob.cpp	\
+	    $$PWD/DirReadStats.cpp	\
+	    $$PWD/DirReadWorkerPool.cpp	\
+	    $$PWD/DirSaver.cpp		\
+	    $$PWD/DirTree.cpp		\
+	    $$PWD/DirTreeCache.cpp	\
+	    $$PWD/DirTreeFilterChain.cpp \
+	    $$PWD/DirTreePatternFilter.cpp \
+	    $$PWD/DirTreePkgFilter.cpp	\
+	    $$PWD/DirTreeWatcher.cpp	\
+	    $$PWD/DotEntry.cpp		\
+	    $$PWD/DpkgDatabase.cpp	\
+	    $$PWD/DpkgPkgManager.cpp	\
+	    $$PWD/Exception.cpp		\
+	    $$PWD/ExcludeRules.cpp	\
+	    $$PWD/FileAgeStats.cpp	\
+	    $$PWD/FileColumns.cpp	\
+	    $$PWD/FileInfo.cpp		\
+	    $$PWD/FileInfoIterator.cpp	\
+	    $$PWD/FileInfoSet.cpp	\
+	    $$PWD/FileInfoSorter.cpp	\
+	    $$PWD/FilePredicate.cpp	\
+	    $$PWD/FileRangeIndex.cpp	\
+	    $$PWD/FileSizeStats.cpp	\
+	    $$PWD/FileSpillStore.cpp	\
+	    $$PWD/FileTypeStats.cpp	\
+	    $$PWD/FormatUtil.cpp	\
+	    $$PWD/HardLinkTable.cpp	\
+	    $$PWD/IoUring.cpp		\
+	    $$PWD/ListingReadPipeline.cpp \
+	    $$PWD/Logger.cpp		\
+	    $$PWD/MessagePanel.cpp	\
+	    $$PWD/MimeCategorizer.cpp	\
+	    $$PWD/MemoryUsage.cpp	\
+	    $$PWD/MemoryBudget.cpp	\
+	    $$PWD/MimeCategory.cpp	\
+	    $$PWD/MountPoints.cpp	\
+	    $$PWD/MultiPatternMatcher.cpp \
+	    $$PWD/NodeAllocator.cpp	\
+	    $$PWD/OwnerStats.cpp	\
+	    $$PWD/PacManDatabase.cpp	\
+	    $$PWD/PacManPkgManager.cpp	\
+	    $$PWD/PanelMessage.cpp	\
+	    $$PWD/PathTrie.cpp		\
+	    $$PWD/PercentileStats.cpp	\
+	    $$PWD/PkgFileListCache.cpp	\
+	    $$PWD/PkgFilter.cpp		\
+	    $$PWD/PkgInfo.cpp		\
+	    $$PWD/PkgManager.cpp	\
+	    $$PWD/PkgQuery.cpp		\
+	    $$PWD/PkgReader.cpp		\
+	    $$PWD/Process.cpp		\
+	    $$PWD/ProcessStarter.cpp	\
+	    $$PWD/QuantileSketch.cpp	\
+	    $$PWD/QuotaUsage.cpp	\
+	    $$PWD/ReadThrottle.cpp	\
+	    $$PWD/ReadTrace.cpp		\
+	    $$PWD/RpmDatabase.cpp	\
+	    $$PWD/RpmPkgManager.cpp	\
+	    $$PWD/RuleStats.cpp	\
+	    $$PWD/ScanCoordinator.cpp	\
+	    $$PWD/ScanProgress.cpp	\
+	    $$PWD/SessionSnapshot.cpp	\
+	    $$PWD/Settings.cpp		\
+	    $$PWD/SettingsHelpers.cpp	\
+	    $$PWD/SharedCacheImage.cpp	\
+	    $$PWD/SizeEstimator.cpp	\
+	    $$PWD/SnapshotStore.cpp	\
+	    $$PWD/SpawnedProcess.cpp	\
+	    $$PWD/StallWatchdog.cpp	\
+	    $$PWD/SubtreeCollector.cpp	\
+	    $$PWD/SubtreeFinalizer.cpp	\
+	    $$PWD/SuffixTrie.cpp	\
+	    $$PWD/SysUtil.cpp		\
+	    $$PWD/TreeDiff.cpp		\
+	    $$PWD/TreeExporter.cpp	\
+	    $$PWD/TreeSnapshot.cpp	\
+	    $$PWD/TreeWalker.cpp	\
+	    $$PWD/ZstdFile.cpp
+
+
+HEADERS	 +=				\
+	    $$PWD/Attic.h		\
+	    $$PWD/BrokenLibc.h		\
+	    $$PWD/BulkInodeTable.h	\
+	    $$PWD/CacheReadPipeline.h	\
+	    $$PWD/DataColumns.h		\
+	    $$PWD/DebugHelpers.h	\
+	    $$PWD/DirFdCache.h		\
+	    $$PWD/DirInfo.h		\
+	    $$PWD/DirReadJob.h		\
+	    $$PWD/DirReadStats.h	\
+	    $$PWD/DirReadWorkerPool.h	\
+	    $$PWD/DirSaver.h		\
+	    $$PWD/DirTree.h		\
+	    $$PWD/DirTreeCache.h	\
+	    $$PWD/DirTreeFilter.h	\
+	    $$PWD/DirTreeFilterChain.h \
+	    $$PWD/DirTreePatternFilter.h \
+	    $$PWD/DirTreePkgFilter.h	\
+	    $$PWD/DirTreeWatcher.h	\
+	    $$PWD/DotEntry.h		\
+	    $$PWD/DpkgDatabase.h	\
+	    $$PWD/DpkgPkgManager.h	\
+	    $$PWD/Exception.h		\
+	    $$PWD/ExcludeRules.h	\
+	    $$PWD/FileAgeStats.h	\
+	    $$PWD/FileColumns.h	\
+	    $$PWD/FileInfo.h		\
+	    $$PWD/FileInfoIterator.h	\
+	    $$PWD/FileInfoSet.h		\
+	    $$PWD/FileInfoSorter.h	\
+	    $$PWD/FilePredicate.h	\
+	    $$PWD/FileRangeIndex.h	\
+	    $$PWD/FileSizeStats.h	\
+	    $$PWD/FileSpillStore.h	\
+	    $$PWD/FileSize.h		\
+	    $$PWD/FileTypeStats.h	\
+	    $$PWD/FormatUtil.h		\
+	    $$PWD/HardLinkTable.h	\
+	    $$PWD/InlineCollector.h	\
+	    $$PWD/IoUring.h		\
+	    $$PWD/LineTokenizer.h	\
+	    $$PWD/ListingReadPipeline.h \
+	    $$PWD/ListMover.h		\
+	    $$PWD/Logger.h		\
+	    $$PWD/MessagePanel.h	\
+	    $$PWD/MimeCategorizer.h	\
+	    $$PWD/MemoryUsage.h		\
+	    $$PWD/MemoryBudget.h	\
+	    $$PWD/MimeCategory.h	\
+	    $$PWD/MountPoints.h		\
+	    $$PWD/MultiPatternMatcher.h	\
+	    $$PWD/NodeAllocator.h	\
+	    $$PWD/OwnerStats.h		\
+	    $$PWD/PacManDatabase.h	\
+	    $$PWD/PacManPkgManager.h	\
+	    $$PWD/PanelMessage.h	\
+	    $$PWD/PathTrie.h		\
+	    $$PWD/PercentileStats.h	\
+	    $$PWD/PkgFileListCache.h	\
+	    $$PWD/PkgFilter.h		\
+	    $$PWD/PkgInfo.h		\
+	    $$PWD/PkgManager.h		\
+	    $$PWD/PkgQuery.h		\
+	    $$PWD/PkgReader.h		\
+	    $$PWD/Process.h		\
+	    $$PWD/ProcessStarter.h	\
+	    $$PWD/QuantileSketch.h	\
+	    $$PWD/QuotaUsage.h		\
+	    $$PWD/ReadThrottle.h	\
+	    $$PWD/ReadTrace.h		\
+	    $$PWD/RpmDatabase.h		\
+	    $$PWD/RpmPkgManager.h	\
+	    $$PWD/RuleStats.h		\
+	    $$PWD/ScanCoordinator.h	\
+	    $$PWD/ScanProgress.h	\
+	    $$PWD/SessionSnapshot.h	\
+	    $$PWD/Settings.h		\
+	    $$PWD/SettingsHelpers.h	\
+	    $$PWD/SharedCacheImage.h	\
+	    $$PWD/SizeEstimator.h	\
+	    $$PWD/SnapshotStore.h	\
+	    $$PWD/SpawnedProcess.h	\
+	    $$PWD/StallWatchdog.h	\
+	    $$PWD/SubtreeCollector.h	\
+	    $$PWD/SubtreeFinalizer.h	\
+	    $$PWD/SuffixTrie.h		\
+	    $$PWD/SysUtil.h		\
+	    $$PWD/TreeDiff.h		\
+	    $$PWD/TreeExporter.h	\
+	    $$PWD/TreeSnapshot.h	\
+	    $$PWD/TreeWalker.h		\
+	    $$PWD/TreeWriterThread.h	\
+	    $$PWD/Version.h		\
+	    $$PWD/ZstdFile.h
+
+
+FORMS	 +=	$$PWD/message-panel.ui	\
+		$$PWD/panel-message.ui
@@ -0,0 +1,524 @@
+/*
+ *   File name: ScanDaemon.cpp
+ *   Summary:	Daemon that keeps directory trees up to date and answers queries
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>	// memset(), memcpy()
+#include <algorithm>	// std::sort()
+
+#include <QSocketNotifier>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "ScanDaemon.h"
+#include "DirTree.h"
+#include "DirTreeCache.h"
+#include "FileInfo.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+// A client that does not read its answer for this long is dropped
+#define CLIENT_SEND_TIMEOUT_SEC		10
+
+#define VERBOSE_REQUESTS		0
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Comparison functor for sorting children by total size, the largest
+     * first.
+     **/
+    bool largerTotalSize( FileInfo * a, FileInfo * b )
+    {
+	return a->totalSize() > b->totalSize();
+    }
+
+
+    /**
+     * Fill 'addr' for Unix domain socket 'socketPath'. Return 'false' if
+     * the path is too long for it.
+     **/
+    bool socketAddress( const QString & socketPath, struct sockaddr_un & addr )
+    {
+	QByteArray path = QFile::encodeName( socketPath );
+
+	if ( path.size() >= (int) sizeof( addr.sun_path ) )
+	    return false;
+
+	memset( &addr, 0, sizeof( addr ) );
+	addr.sun_family = AF_UNIX;
+	memcpy( addr.sun_path, path.constData(), path.size() );
+
+	return true;
+    }
+
+}	// namespace
+
+
+ScanDaemon::ScanDaemon():
+    QObject(),
+    _crossFilesystems( false ),
+    _readThreads( 0 ),
+    _listenFd( -1 ),
+    _listenNotifier( 0 )
+{
+    // NOP
+}
+
+
+ScanDaemon::~ScanDaemon()
+{
+    foreach ( int fd, _clients.keys() )
+	closeClient( fd );
+
+    if ( _listenFd >= 0 )
+    {
+	delete _listenNotifier;
+	::close( _listenFd );
+	::unlink( QFile::encodeName( _socketPath ).constData() );
+    }
+
+    qDeleteAll( _trees );
+}
+
+
+QString ScanDaemon::defaultSocketPath()
+{
+    return QString( DEFAULT_DAEMON_SOCKET ).replace( "$USER", Logger::userName() );
+}
+
+
+void ScanDaemon::addTree( const QString & path )
+{
+    DirTree * tree = new DirTree();
+    CHECK_NEW( tree );
+
+    tree->setCrossFilesystems( _crossFilesystems );
+    tree->setReadThreads( _readThreads );
+
+    // The watcher starts when reading is finished
+
+    tree->setWatchTree( true );
+    _trees << tree;
+
+    logInfo() << "Reading " << path << endl;
+    tree->startReading( path );
+}
+
+
+int ScanDaemon::connectSocket( const QString & socketPath )
+{
+    struct sockaddr_un addr;
+
+    if ( ! socketAddress( socketPath, addr ) )
+    {
+	errno = ENAMETOOLONG;
+	return -1;
+    }
+
+    int fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+
+    if ( fd < 0 )
+	return -1;
+
+    if ( ::connect( fd, (struct sockaddr *) &addr, sizeof( addr ) ) < 0 )
+    {
+	int savedErrno = errno;
+	::close( fd );
+	errno = savedErrno;
+
+	return -1;
+    }
+
+    return fd;
+}
+
+
+bool ScanDaemon::listen( const QString & socketPath )
+{
+    struct sockaddr_un addr;
+
+    if ( ! socketAddress( socketPath, addr ) )
+    {
+	logError() << "Socket path too long: " << socketPath << endl;
+	return false;
+    }
+
+    QByteArray encodedPath = QFile::encodeName( socketPath );
+    QDir().mkpath( QFileInfo( socketPath ).absolutePath() );
+
+    if ( QFileInfo( socketPath ).exists() )
+    {
+	// A socket that nobody listens on is left over from a daemon that
+	// was killed
+
+	int fd = connectSocket( socketPath );
+
+	if ( fd >= 0 )
+	{
+	    ::close( fd );
+	    logError() << "Another daemon is already listening on " << socketPath << endl;
+	    return false;
+	}
+
+	logInfo() << "Removing stale socket " << socketPath << endl;
+	::unlink( encodedPath.constData() );
+    }
+
+    _listenFd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0 );
+
+    if ( _listenFd < 0 )
+    {
+	logError() << "Can't create a socket: " << formatErrno() << endl;
+	return false;
+    }
+
+    // Only the owner may ask for the trees: They might contain the names
+    // of files that other users can't see.
+
+    mode_t oldUmask = umask( 0077 );
+    int result = bind( _listenFd, (struct sockaddr *) &addr, sizeof( addr ) );
+    umask( oldUmask );
+
+    if ( result < 0 || ::listen( _listenFd, SOMAXCONN ) < 0 )
+    {
+	logError() << "Can't listen on " << socketPath << ": " << formatErrno() << endl;
+	::close( _listenFd );
+	_listenFd = -1;
+
+	return false;
+    }
+
+    _socketPath = socketPath;
+    _listenNotifier = new QSocketNotifier( _listenFd, QSocketNotifier::Read, this );
+    CHECK_NEW( _listenNotifier );
+
+    connect( _listenNotifier, SIGNAL( activated   ( int ) ),
+	     this,	      SLOT  ( acceptClient()	  ) );
+
+    logInfo() << "Listening on " << socketPath << endl;
+
+    return true;
+}
+
+
+void ScanDaemon::acceptClient()
+{
+    while ( true )
+    {
+	int fd = accept4( _listenFd, 0, 0, SOCK_CLOEXEC | SOCK_NONBLOCK );
+
+	if ( fd < 0 )
+	{
+	    if ( errno == EINTR )
+		continue;
+
+	    if ( errno != EAGAIN && errno != EWOULDBLOCK )
+		logWarning() << "accept() failed: " << formatErrno() << endl;
+
+	    return;
+	}
+
+	QSocketNotifier * notifier = new QSocketNotifier( fd, QSocketNotifier::Read, this );
+	CHECK_NEW( notifier );
+
+	connect( notifier, SIGNAL( activated  ( int ) ),
+		 this,	   SLOT  ( readRequest( int ) ) );
+
+	_clients.insert( fd, notifier );
+    }
+}
+
+
+void ScanDaemon::readRequest( int fd )
+{
+    QByteArray & request = _requests[ fd ];
+    char buf[ 1024 ];
+    bool eof = false;
+
+    while ( true )
+    {
+	ssize_t len = ::read( fd, buf, sizeof( buf ) );
+
+	if ( len > 0 )
+	{
+	    request.append( buf, len );
+	    continue;
+	}
+
+	if ( len < 0 && errno == EINTR )
+	    continue;
+
+	if ( len < 0 && errno != EAGAIN && errno != EWOULDBLOCK )
+	{
+	    closeClient( fd );
+	    return;
+	}
+
+	eof = len == 0;
+	break;
+    }
+
+    int newline = request.indexOf( '\n' );
+
+    if ( newline < 0 && ! eof )
+    {
+	if ( request.size() > MAX_DAEMON_REQUEST_LEN )
+	{
+	    logWarning() << "Dropping a client with an overlong request" << endl;
+	    closeClient( fd );
+	}
+
+	return;	 // Wait for the rest
+    }
+
+    QString line = QString::fromUtf8( newline >= 0 ? request.left( newline ) : request ).trimmed();
+
+    // The answer may take a while for a large snapshot; make sure a client
+    // that does not read it can't block the daemon forever.
+
+    int flags = fcntl( fd, F_GETFL );
+    fcntl( fd, F_SETFL, flags & ~O_NONBLOCK );
+
+    struct timeval timeout;
+    timeout.tv_sec  = CLIENT_SEND_TIMEOUT_SEC;
+    timeout.tv_usec = 0;
+    setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+
+    handleRequest( fd, line );
+    closeClient( fd );
+}
+
+
+void ScanDaemon::handleRequest( int fd, const QString & request )
+{
+#if VERBOSE_REQUESTS
+    logDebug() << "Request: " << request << endl;
+#endif
+
+    int	    space   = request.indexOf( ' ' );
+    QString command = space < 0 ? request : request.left( space );
+    QString path    = space < 0 ? QString() : QDir::cleanPath( request.mid( space + 1 ).trimmed() );
+
+    if ( command == "paths" )
+    {
+	writeAll( fd, pathsAnswer() );
+	return;
+    }
+
+    if ( command != "stat" && command != "children" && command != "snapshot" )
+    {
+	writeAll( fd, QString( "error\tUnknown request \"%1\"\n" ).arg( command ).toUtf8() );
+	return;
+    }
+
+    DirTree *  tree = 0;
+    FileInfo * item = path.startsWith( "/" ) ? locate( path, tree ) : 0;
+
+    if ( ! item )
+    {
+	writeAll( fd, QString( "error\tNot in any tree: \"%1\"\n" ).arg( path ).toUtf8() );
+	return;
+    }
+
+    if ( command == "stat" )
+    {
+	writeAll( fd, statAnswer( item ) );
+    }
+    else if ( command == "children" )
+    {
+	writeAll( fd, childrenAnswer( item ) );
+    }
+    else // "snapshot"
+    {
+	// A snapshot of a tree that is still being read would look like a
+	// complete one to the client
+
+	if ( tree->isBusy() )
+	{
+	    writeAll( fd, QString( "error\tStill reading %1\n" ).arg( path ).toUtf8() );
+	    return;
+	}
+
+	if ( ! item->isDirInfo() )
+	{
+	    writeAll( fd, QString( "error\tNot a directory: \"%1\"\n" ).arg( path ).toUtf8() );
+	    return;
+	}
+
+	CacheSnapshotWriter writer( fd, item );
+
+	if ( ! writer.ok() )
+	    logWarning() << "Snapshot of " << path << " not completely sent" << endl;
+    }
+}
+
+
+FileInfo * ScanDaemon::locate( const QString & path, DirTree *& tree_ret ) const
+{
+    foreach ( DirTree * tree, _trees )
+    {
+	FileInfo * toplevel = tree->firstToplevel();
+
+	if ( ! toplevel )
+	    continue;
+
+	QString url = toplevel->url();
+
+	if ( path == url )
+	{
+	    tree_ret = tree;
+	    return toplevel;
+	}
+
+	if ( path.startsWith( url.endsWith( "/" ) ? url : url + "/" ) )
+	{
+	    FileInfo * item = tree->locate( path );
+
+	    if ( item )
+	    {
+		tree_ret = tree;
+		return item;
+	    }
+	}
+    }
+
+    return 0;
+}
+
+
+QByteArray ScanDaemon::pathsAnswer() const
+{
+    QByteArray answer;
+
+    foreach ( DirTree * tree, _trees )
+    {
+	FileInfo * toplevel = tree->firstToplevel();
+
+	if ( ! toplevel )
+	    continue;
+
+	const char * state = tree->isBusy()    ? "reading"  :
+			     tree->watchTree() ? "watching" : "idle";
+
+	answer += QString( "%1\t%2\t%3\t%4\n" )
+	    .arg( toplevel->url() )
+	    .arg( state )
+	    .arg( toplevel->totalSize() )
+	    .arg( toplevel->totalItems() ).toUtf8();
+    }
+
+    return answer;
+}
+
+
+QByteArray ScanDaemon::statAnswer( FileInfo * item ) const
+{
+    return QString( "%1\t%2\t%3\t%4\t%5\t%6\t%7\n" )
+	.arg( item->url() )
+	.arg( item->totalSize() )
+	.arg( item->totalAllocatedSize() )
+	.arg( item->totalItems() )
+	.arg( item->totalFiles() )
+	.arg( item->totalSubDirs() )
+	.arg( (qint64) item->latestMtime() ).toUtf8();
+}
+
+
+QByteArray ScanDaemon::childrenAnswer( FileInfo * item ) const
+{
+    // The files of a directory with subdirectories are in its dot entry
+
+    QList<FileInfo *> children;
+
+    for ( FileInfo * child = item->firstChild(); child; child = child->next() )
+    {
+	if ( ! child->isPseudoDir() )
+	    children << child;
+    }
+
+    if ( item->dotEntry() )
+    {
+	for ( FileInfo * child = item->dotEntry()->firstChild(); child; child = child->next() )
+	    children << child;
+    }
+
+    std::sort( children.begin(), children.end(), largerTotalSize );
+
+    QByteArray answer;
+
+    foreach ( FileInfo * child, children )
+    {
+	const char * type = child->isDir()     ? "D" :
+			    child->isFile()    ? "F" :
+			    child->isSymLink() ? "L" : "S";
+
+	answer += QString( "%1\t%2\t%3\t%4\t%5\n" )
+	    .arg( type )
+	    .arg( child->totalSize() )
+	    .arg( child->totalItems() )
+	    .arg( (qint64) child->latestMtime() )
+	    .arg( child->name() ).toUtf8();
+    }
+
+    return answer;
+}
+
+
+void ScanDaemon::closeClient( int fd )
+{
+    // This is called from the activated() signal of the notifier
+
+    QSocketNotifier * notifier = _clients.take( fd );
+
+    if ( notifier )
+    {
+	notifier->setEnabled( false );
+	notifier->deleteLater();
+    }
+
+    _requests.remove( fd );
+    ::close( fd );
+}
+
+
+bool ScanDaemon::writeAll( int fd, const QByteArray & data )
+{
+    const char * pos  = data.constData();
+    qint64	 left = data.size();
+
+    while ( left > 0 )
+    {
+	ssize_t written = ::write( fd, pos, left );
+
+	if ( written < 0 )
+	{
+	    if ( errno == EINTR )
+		continue;
+
+	    return false;
+	}
+
+	pos  += written;
+	left -= written;
+    }
+
+    return true;
+}
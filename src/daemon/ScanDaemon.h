@@ -0,0 +1,172 @@
+/*
+ *   File name: ScanDaemon.h
+ *   Summary:	Daemon that keeps directory trees up to date and answers queries
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef ScanDaemon_h
+#define ScanDaemon_h
+
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+#include <QStringList>
+
+
+// The socket of the daemon; $USER is replaced with the user name
+#define DEFAULT_DAEMON_SOCKET	"/tmp/qdirstat-$USER/daemon.socket"
+
+// Maximum length of a request line
+#define MAX_DAEMON_REQUEST_LEN	4096
+
+
+class QSocketNotifier;
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class FileInfo;
+
+
+    /**
+     * Daemon that reads directory trees once and then keeps them up to date
+     * with the change events of the filesystem (see DirTreeWatcher), so
+     * queries about them are answered from memory without scanning again.
+     *
+     * Clients connect to a Unix domain socket and send one request line;
+     * the answer is sent back and the connection is closed:
+     *
+     *	   paths	     one line for each tree: path, state, total
+     *			     size, total items
+     *	   stat <path>	     total size, allocated size, items, files,
+     *			     subdirectories and latest mtime of <path>
+     *	   children <path>   one line for each child of <path>, the
+     *			     largest first: type, total size, total items,
+     *			     latest mtime, name
+     *	   snapshot <path>   the subtree of <path> as an uncompressed text
+     *			     cache file (see CacheSnapshotWriter)
+     *
+     * The fields of each line are separated with tabs; sizes are in bytes,
+     * times in seconds since 1970. A failed request is answered with
+     * "error", a tab and a message.
+     *
+     * Everything is done in the thread of the event loop; the trees are
+     * read with time-sliced read jobs just like in the GUI, so requests are
+     * answered while they are being read.
+     **/
+    class ScanDaemon: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	ScanDaemon();
+
+	/**
+	 * Destructor. This removes the socket.
+	 **/
+	virtual ~ScanDaemon();
+
+	/**
+	 * Options for the trees that are added after this.
+	 **/
+	void setCrossFilesystems( bool cross ) { _crossFilesystems = cross; }
+	void setReadThreads( int threads )     { _readThreads = threads; }
+
+	/**
+	 * Start reading directory 'path' and keep it up to date after that.
+	 **/
+	void addTree( const QString & path );
+
+	/**
+	 * Listen for requests on Unix domain socket 'socketPath'. Return
+	 * 'false' if that is not possible, e.g. because another daemon is
+	 * already using it.
+	 **/
+	bool listen( const QString & socketPath );
+
+	/**
+	 * Connect to the daemon on socket 'socketPath'. Return the file
+	 * descriptor of the connection or -1 on error; errno is set then.
+	 **/
+	static int connectSocket( const QString & socketPath );
+
+	/**
+	 * Return the socket path for the current user.
+	 **/
+	static QString defaultSocketPath();
+
+
+    protected slots:
+
+	/**
+	 * Accept a new client connection.
+	 **/
+	void acceptClient();
+
+	/**
+	 * Read the request of the client on 'fd' and answer it when it is
+	 * complete.
+	 **/
+	void readRequest( int fd );
+
+
+    protected:
+
+	/**
+	 * Answer 'request' on client connection 'fd'.
+	 **/
+	void handleRequest( int fd, const QString & request );
+
+	/**
+	 * Return the item for absolute path 'path' in one of the trees or 0
+	 * if there is none. 'tree_ret' is set to its tree.
+	 **/
+	FileInfo * locate( const QString & path, DirTree *& tree_ret ) const;
+
+	/**
+	 * Return the answer for the "paths", "stat" and "children" requests.
+	 **/
+	QByteArray pathsAnswer() const;
+	QByteArray statAnswer( FileInfo * item ) const;
+	QByteArray childrenAnswer( FileInfo * item ) const;
+
+	/**
+	 * Close client connection 'fd' and forget its pending request.
+	 **/
+	void closeClient( int fd );
+
+	/**
+	 * Write all of 'data' to 'fd'. Return 'false' on error.
+	 **/
+	static bool writeAll( int fd, const QByteArray & data );
+
+
+	//
+	// Data members
+	//
+
+	QList<DirTree *>		_trees;
+	bool				_crossFilesystems;
+	int				_readThreads;
+	QString				_socketPath;
+	int				_listenFd;
+	QSocketNotifier *		_listenNotifier;
+	QHash<int, QSocketNotifier *>	_clients;
+	QHash<int, QByteArray>		_requests;
+
+    };	// class ScanDaemon
+
+}	// namespace QDirStat
+
+
+#endif	// ScanDaemon_h
@@ -0,0 +1,33 @@
+# qmake .pro file for qdirstat/src/daemon
+#
+# This builds qdirstat-daemon, a program without any GUI that reads
+# directory trees once, keeps them up to date with the change events of the
+# filesystem and answers queries about them on a local socket. QDirStat can
+# open a snapshot of such a tree with a "daemon:/some/path" URL instead of
+# scanning it.
+#
+# It still links against the Qt widgets library because some of the classes
+# it uses are shared with the GUI (see ../core.pri), but it never creates a
+# QApplication.
+
+TEMPLATE	 = app
+
+QT		+= widgets
+MOC_DIR		 = .moc
+OBJECTS_DIR	 = .obj
+isEmpty(INSTALL_PREFIX):INSTALL_PREFIX = /usr
+
+TARGET		 = qdirstat-daemon
+TARGET.files	 = qdirstat-daemon
+TARGET.path	 = $$INSTALL_PREFIX/bin
+INSTALLS	+= TARGET
+
+QMAKE_CXXFLAGS	+=  -Wno-deprecated -Wno-deprecated-declarations
+
+
+SOURCES	  = main.cpp \
+	    ScanDaemon.cpp
+
+HEADERS	  = ScanDaemon.h
+
+include(../core.pri)
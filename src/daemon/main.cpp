@@ -0,0 +1,249 @@
+/*
+ *   File name: main.cpp
+ *   Summary:	QDirStat scan daemon main program
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <unistd.h>	// STDOUT_FILENO
+#include <signal.h>	// signal(), SIGPIPE
+#include <errno.h>
+#include <string.h>	// strerror()
+#include <iostream>	// cerr, cout
+
+#include <QCoreApplication>
+#include <QFileInfo>
+
+#include "ScanDaemon.h"
+#include "ExcludeRules.h"
+#include "Logger.h"
+#include "Exception.h"
+#include "Version.h"
+
+
+using std::cerr;
+using std::cout;
+using namespace QDirStat;
+
+static const char * progName = "qdirstat-daemon";
+
+
+void usage()
+{
+    cerr << "\n"
+	 << "Usage: \n"
+	 << "\n"
+	 << "  " << progName << " [-mdeh] [-j <threads>] [-S <socket>] <directory> [<directory>...]\n"
+	 << "  " << progName << " [-S <socket>] -q <request>\n"
+	 << "\n"
+	 << "Read each <directory>, keep it up to date with the change events of the\n"
+	 << "filesystem and answer requests about it on <socket>\n"
+	 << "(default: " << DEFAULT_DAEMON_SOCKET << ").\n"
+	 << "\n"
+	 << "  -m  scan mounted filesystems (cross filesystem boundaries)\n"
+	 << "  -e  apply the exclude rules from the QDirStat settings\n"
+	 << "  -j  number of threads for reading directories (default: automatic)\n"
+	 << "  -S  the socket to listen on or to send the request to\n"
+	 << "  -q  send <request> to the daemon and print the answer to stdout\n"
+	 << "  -d  debug\n"
+	 << "  -h  help (this usage message)\n"
+	 << "\n"
+	 << "Requests:\n"
+	 << "\n"
+	 << "  paths            the trees of the daemon with their state\n"
+	 << "  stat <path>      the totals of <path>\n"
+	 << "  children <path>  the children of <path>, the largest first\n"
+	 << "  snapshot <path>  <path> as an uncompressed cache file\n"
+	 << "                   (for \"qdirstat daemon:/some/path\")\n"
+	 << "\n"
+	 << "The answers have one tab-separated line each.\n"
+	 << std::endl;
+}
+
+
+/**
+ * Send 'request' to the daemon on 'socketPath' and copy its answer to
+ * stdout. Return the exit code for main().
+ **/
+int sendRequest( const QString & socketPath, const QString & request )
+{
+    int fd = ScanDaemon::connectSocket( socketPath );
+
+    if ( fd < 0 )
+    {
+	cerr << progName << ": Can't connect to " << qPrintable( socketPath )
+	     << ": " << strerror( errno ) << std::endl;
+	return 1;
+    }
+
+    QByteArray line = request.toUtf8() + '\n';
+
+    if ( ::write( fd, line.constData(), line.size() ) != line.size() )
+    {
+	cerr << progName << ": Can't send the request: " << strerror( errno ) << std::endl;
+	::close( fd );
+	return 1;
+    }
+
+    char    buf[ 64 * 1024 ];
+    ssize_t len;
+    bool    first    = true;
+    int	    exitCode = 0;
+
+    while ( ( len = ::read( fd, buf, sizeof( buf ) ) ) != 0 )
+    {
+	if ( len < 0 )
+	{
+	    if ( errno == EINTR )
+		continue;
+
+	    cerr << progName << ": Read error: " << strerror( errno ) << std::endl;
+	    exitCode = 1;
+	    break;
+	}
+
+	if ( first && len >= 6 && strncmp( buf, "error\t", 6 ) == 0 )
+	    exitCode = 1;
+
+	first = false;
+
+	if ( ! cout.write( buf, len ) )
+	{
+	    exitCode = 1;
+	    break;
+	}
+    }
+
+    cout.flush();
+    ::close( fd );
+
+    return exitCode;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    Logger logger( "/tmp/qdirstat-$USER", "qdirstat-daemon.log" );
+    logger.setLogLevel( LogSeverityInfo );
+
+    // Set org/app name for QSettings: The exclude rules are the same as for
+    // QDirStat.
+
+    QCoreApplication::setOrganizationName( "QDirStat" );
+    QCoreApplication::setApplicationName ( "QDirStat" );
+
+    QCoreApplication qtApp( argc, argv );
+    QStringList argList = QCoreApplication::arguments();
+    argList.removeFirst(); // Remove program name
+
+    bool    crossFilesystems = false;
+    bool    useExcludeRules  = false;
+    bool    query	     = false;
+    int	    readThreads	     = 0;
+    QString socketPath	     = ScanDaemon::defaultSocketPath();
+    QStringList params;
+
+    // Single-letter options that may be combined like with getopts: "-me"
+
+    while ( ! argList.isEmpty() )
+    {
+	QString arg = argList.takeFirst();
+
+	if ( ! arg.startsWith( "-" ) || arg == "-" )
+	{
+	    params << arg;
+	    continue;
+	}
+
+	for ( int i = 1; i < arg.size(); ++i )
+	{
+	    switch ( arg.at( i ).toLatin1() )
+	    {
+		case 'm': crossFilesystems = true; break;
+		case 'e': useExcludeRules  = true; break;
+		case 'q': query		   = true; break;
+		case 'd': logger.setLogLevel( LogSeverityDebug ); break;
+
+		case 'S':
+		    if ( argList.isEmpty() )
+		    {
+			usage();
+			return 1;
+		    }
+
+		    socketPath = argList.takeFirst();
+		    break;
+
+		case 'j':
+		    {
+			bool ok = ! argList.isEmpty();
+
+			if ( ok )
+			    readThreads = argList.takeFirst().toInt( &ok );
+
+			if ( ! ok || readThreads < 0 )
+			{
+			    usage();
+			    return 1;
+			}
+		    }
+		    break;
+
+		case 'h':
+		    usage();
+		    return 0;
+
+		default:
+		    usage();
+		    return 1;
+	    }
+	}
+    }
+
+    if ( params.isEmpty() )
+    {
+	usage();
+	return 1;
+    }
+
+    // A client that went away must not kill the daemon
+
+    signal( SIGPIPE, SIG_IGN );
+
+    if ( query )
+	return sendRequest( socketPath, params.join( " " ) );
+
+    logInfo() << "qdirstat-daemon " << QDIRSTAT_VERSION
+	      << " built with Qt " << QT_VERSION_STR << endl;
+
+    if ( useExcludeRules )
+	ExcludeRules::instance()->readSettings();
+
+    ScanDaemon daemon;
+    daemon.setCrossFilesystems( crossFilesystems );
+    daemon.setReadThreads( readThreads );
+
+    foreach ( const QString & param, params )
+    {
+	QString dir = QFileInfo( param ).absoluteFilePath();
+
+	if ( ! QFileInfo( dir ).isDir() )
+	{
+	    cerr << progName << ": Not a directory: " << qPrintable( dir ) << std::endl;
+	    return 1;
+	}
+
+	daemon.addTree( dir );
+    }
+
+    if ( ! daemon.listen( socketPath ) )
+    {
+	cerr << progName << ": Can't listen on " << qPrintable( socketPath )
+	     << "; see the log for details" << std::endl;
+	return 1;
+    }
+
+    return qtApp.exec();
+}
@@ -0,0 +1,217 @@
+# qmake include file for qdirstat/src
+#
+# The windows, views and dialogs of QDirStat, i.e. everything except main()
+# and the classes in core.pri (which this includes), for programs that need
+# them outside of QDirStat itself, like the treemap benchmark:
+#
+#     include(../../src/gui.pri)
+
+include(core.pri)
+
+# Optional: render treemap cushions with OpenGL if Qt is built with it.
+# Qt 6 moved the QOpenGL* classes to a separate module.
+contains(QT_CONFIG, opengl) | contains(QT_CONFIG, opengles2) {
+    greaterThan(QT_MAJOR_VERSION, 5):QT += opengl
+    DEFINES	+= HAVE_OPENGL
+}
+
+
+SOURCES	 +=				\
+	    $$PWD/QDirStatApp.cpp	\
+	    $$PWD/ActionManager.cpp	\
+	    $$PWD/AdaptiveTimer.cpp	\
+	    $$PWD/BreadcrumbNavigator.cpp \
+	    $$PWD/BucketsTableModel.cpp	\
+	    $$PWD/BusyPopup.cpp		\
+	    $$PWD/Cleanup.cpp		\
+	    $$PWD/CleanupCollection.cpp	\
+	    $$PWD/CleanupConfigPage.cpp	\
+	    $$PWD/ConfigDialog.cpp	\
+	    $$PWD/CushionPixmapGrid.cpp	\
+	    $$PWD/CushionRenderer.cpp	\
+	    $$PWD/DelayedRebuilder.cpp	\
+	    $$PWD/DeleteEngine.cpp	\
+	    $$PWD/DirListModel.cpp	\
+	    $$PWD/DirListWindow.cpp	\
+	    $$PWD/DirListingCache.cpp	\
+	    $$PWD/DirTreeModel.cpp	\
+	    $$PWD/DirTreeView.cpp	\
+	    $$PWD/DiscoverActions.cpp	\
+	    $$PWD/DuplicateFilesFinder.cpp \
+	    $$PWD/DuplicateFilesWindow.cpp \
+	    $$PWD/EventLoopStallsWindow.cpp \
+	    $$PWD/ExcludeRulesConfigPage.cpp \
+	    $$PWD/ExistingDirCompleter.cpp \
+	    $$PWD/ExistingDirValidator.cpp \
+	    $$PWD/FileAgeStatsWindow.cpp \
+	    $$PWD/FileDetailsView.cpp	\
+	    $$PWD/FileMTimeStats.cpp	\
+	    $$PWD/FileNameIndex.cpp	\
+	    $$PWD/FileSizeLabel.cpp	\
+	    $$PWD/FileSizeStatsWindow.cpp \
+	    $$PWD/FileSystemsWindow.cpp	\
+	    $$PWD/FileTypeStatsWindow.cpp \
+	    $$PWD/GeneralConfigPage.cpp	\
+	    $$PWD/GLCushionRenderer.cpp	\
+	    $$PWD/HeaderTweaker.cpp	\
+	    $$PWD/HistogramDraw.cpp	\
+	    $$PWD/HistogramItems.cpp	\
+	    $$PWD/HistogramOverflowPanel.cpp \
+	    $$PWD/HistogramView.cpp	\
+	    $$PWD/History.cpp		\
+	    $$PWD/HistoryButtons.cpp	\
+	    $$PWD/ListEditor.cpp	\
+	    $$PWD/LocateFileTypeWindow.cpp \
+	    $$PWD/LocateFilesModel.cpp	\
+	    $$PWD/LocateFilesWindow.cpp	\
+	    $$PWD/MainWindow.cpp	\
+	    $$PWD/MainWindowHelp.cpp	\
+	    $$PWD/MainWindowLayout.cpp	\
+	    $$PWD/MainWindowMenus.cpp	\
+	    $$PWD/MainWindowUnpkg.cpp	\
+	    $$PWD/MemoryUsageWindow.cpp	\
+	    $$PWD/MimeCategoryConfigPage.cpp \
+	    $$PWD/OpenDirDialog.cpp	\
+	    $$PWD/OpenPkgDialog.cpp	\
+	    $$PWD/OutputWindow.cpp	\
+	    $$PWD/OwnerStatsWindow.cpp	\
+	    $$PWD/PathSelector.cpp	\
+	    $$PWD/PercentBar.cpp	\
+	    $$PWD/PopupLabel.cpp	\
+	    $$PWD/ReadStatsView.cpp	\
+	    $$PWD/Refresher.cpp		\
+	    $$PWD/SelectionModel.cpp	\
+	    $$PWD/SharedExtents.cpp	\
+	    $$PWD/SharedExtentsWindow.cpp \
+	    $$PWD/ShowUnpkgFilesDialog.cpp \
+	    $$PWD/SizeColDelegate.cpp	\
+	    $$PWD/SnapshotHistoryWindow.cpp \
+	    $$PWD/StdCleanup.cpp	\
+	    $$PWD/Subtree.cpp		\
+	    $$PWD/SystemFileChecker.cpp	\
+	    $$PWD/Trash.cpp		\
+	    $$PWD/TrashJob.cpp		\
+	    $$PWD/TreeDiffWindow.cpp	\
+	    $$PWD/TreePatcher.cpp	\
+	    $$PWD/TreeWalkerRunner.cpp	\
+	    $$PWD/TreemapLayout.cpp	\
+	    $$PWD/TreemapLeaves.cpp	\
+	    $$PWD/TreemapTile.cpp	\
+	    $$PWD/TreemapView.cpp	\
+	    $$PWD/UnpkgSettings.cpp	\
+	    $$PWD/UnreadableDirsWindow.cpp
+
+
+HEADERS	 +=				\
+	    $$PWD/QDirStatApp.h		\
+	    $$PWD/ActionManager.h	\
+	    $$PWD/AdaptiveTimer.h	\
+	    $$PWD/BreadcrumbNavigator.h	\
+	    $$PWD/BucketsTableModel.h	\
+	    $$PWD/BusyPopup.h		\
+	    $$PWD/Cleanup.h		\
+	    $$PWD/CleanupCollection.h	\
+	    $$PWD/CleanupConfigPage.h	\
+	    $$PWD/ConfigDialog.h	\
+	    $$PWD/CushionPixmapGrid.h	\
+	    $$PWD/CushionRenderer.h	\
+	    $$PWD/CushionShader.h	\
+	    $$PWD/DelayedRebuilder.h	\
+	    $$PWD/DeleteEngine.h	\
+	    $$PWD/DirListModel.h	\
+	    $$PWD/DirListWindow.h	\
+	    $$PWD/DirListingCache.h	\
+	    $$PWD/DirTreeModel.h	\
+	    $$PWD/DirTreeView.h		\
+	    $$PWD/DiscoverActions.h	\
+	    $$PWD/DuplicateFilesFinder.h \
+	    $$PWD/DuplicateFilesWindow.h \
+	    $$PWD/EventLoopStallsWindow.h \
+	    $$PWD/ExcludeRulesConfigPage.h \
+	    $$PWD/ExistingDirCompleter.h \
+	    $$PWD/ExistingDirValidator.h \
+	    $$PWD/FileDetailsView.h	\
+	    $$PWD/FileMTimeStats.h	\
+	    $$PWD/FileNameIndex.h	\
+	    $$PWD/FileSizeLabel.h	\
+	    $$PWD/FileSizeStatsWindow.h	\
+	    $$PWD/FileSystemsWindow.h	\
+	    $$PWD/GeneralConfigPage.h	\
+	    $$PWD/GLCushionRenderer.h	\
+	    $$PWD/HeaderTweaker.h	\
+	    $$PWD/HistogramItems.h	\
+	    $$PWD/HistogramView.h	\
+	    $$PWD/ListEditor.h		\
+	    $$PWD/LocateFileTypeWindow.h \
+	    $$PWD/LocateFilesModel.h	\
+	    $$PWD/LocateFilesWindow.h	\
+	    $$PWD/MainWindow.h		\
+	    $$PWD/MemoryUsageWindow.h	\
+	    $$PWD/MimeCategoryConfigPage.h \
+	    $$PWD/OpenDirDialog.h	\
+	    $$PWD/OpenPkgDialog.h	\
+	    $$PWD/OutputWindow.h	\
+	    $$PWD/OwnerStatsWindow.h	\
+	    $$PWD/PathSelector.h	\
+	    $$PWD/PercentBar.h		\
+	    $$PWD/PopupLabel.h		\
+	    $$PWD/Qt4Compat.h		\
+	    $$PWD/ReadStatsView.h	\
+	    $$PWD/Refresher.h		\
+	    $$PWD/SelectionModel.h	\
+	    $$PWD/SharedExtents.h	\
+	    $$PWD/SharedExtentsWindow.h	\
+	    $$PWD/ShowUnpkgFilesDialog.h \
+	    $$PWD/SignalBlocker.h	\
+	    $$PWD/SizeColDelegate.h	\
+	    $$PWD/SnapshotHistoryWindow.h \
+	    $$PWD/StdCleanup.h		\
+	    $$PWD/Subtree.h		\
+	    $$PWD/SystemFileChecker.h	\
+	    $$PWD/Trash.h		\
+	    $$PWD/TrashJob.h		\
+	    $$PWD/TreeDiffWindow.h	\
+	    $$PWD/TreemapLayout.h	\
+	    $$PWD/TreemapLeaves.h	\
+	    $$PWD/TreemapTile.h		\
+	    $$PWD/UnpkgSettings.cpp	\
+	    $$PWD/UnreadableDirsWindow.h \
+	    $$PWD/FileAgeStatsWindow.h	\
+	    $$PWD/FileTypeStatsWindow.h	\
+	    $$PWD/History.h		\
+	    $$PWD/HistoryButtons.h	\
+	    $$PWD/TreePatcher.h		\
+	    $$PWD/TreeWalkerRunner.h	\
+	    $$PWD/TreemapView.h
+
+
+FORMS	 +=				\
+	    $$PWD/main-window.ui		\
+	    $$PWD/memory-usage-window.ui	\
+	    $$PWD/cleanup-config-page.ui	\
+	    $$PWD/config-dialog.ui		\
+	    $$PWD/dir-list-window.ui		\
+	    $$PWD/duplicate-files-window.ui	\
+	    $$PWD/event-loop-stalls-window.ui	\
+	    $$PWD/exclude-rules-config-page.ui	\
+	    $$PWD/file-age-stats-window.ui	\
+	    $$PWD/file-details-view.ui		\
+	    $$PWD/file-size-stats-window.ui	\
+	    $$PWD/file-type-stats-window.ui	\
+	    $$PWD/filesystems-window.ui		\
+	    $$PWD/general-config-page.ui	\
+	    $$PWD/locate-file-type-window.ui	\
+	    $$PWD/locate-files-window.ui	\
+	    $$PWD/mime-category-config-page.ui	\
+	    $$PWD/open-dir-dialog.ui		\
+	    $$PWD/open-pkg-dialog.ui		\
+	    $$PWD/output-window.ui		\
+	    $$PWD/owner-stats-window.ui		\
+	    $$PWD/shared-extents-window.ui	\
+	    $$PWD/show-unpkg-files-dialog.ui	\
+	    $$PWD/snapshot-history-window.ui	\
+	    $$PWD/tree-diff-window.ui		\
+	    $$PWD/unreadable-dirs-window.ui
+
+
+RESOURCES += $$PWD/icons.qrc
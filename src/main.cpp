@@ -10,11 +10,14 @@
 #include <iostream>	// cerr
 
 #include <QApplication>
+#include <QElapsedTimer>
 #include "QDirStatApp.h"
 #include "MainWindow.h"
 #include "DirTreeModel.h"
+#include "MimeCategorizer.h"
 #include "PkgFilter.h"
 #include "Settings.h"
+#include "ReadTrace.h"
 #include "Logger.h"
 #include "Exception.h"
 #include "Version.h"
@@ -30,11 +33,13 @@ void usage( const QStringList & argList )
     cerr << "\n"
 	 << "Usage: \n"
 	 << "\n"
-	 << "  " << progName << " [--slow-update|-s] [<directory-name>]\n"
+	 << "  " << progName << " [--slow-update|-s] [--trace <trace-file>] [<directory-name>]\n"
 	 << "  " << progName << " pkg:/pkgpattern\n"
 	 << "  " << progName << " unpkg:/dir\n"
+	 << "  " << progName << " ssh://[user@]host/dir\n"
+	 << "  " << progName << " daemon:/dir\n"
 	 << "  " << progName << " --dont-ask|-d\n"
-	 << "  " << progName << " --cache|-c <cache-file-name>\n"
+	 << "  " << progName << " --cache|-c <cache-file-name> [<cache-file-name>...]\n"
 	 << "  " << progName << " --help|-h\n"
 	 << "\n"
 	 << "\n"
@@ -46,6 +51,20 @@ void usage( const QStringList & argList )
          << "- Exact match: \"pkg:/=mypkg\"\n"
          << "- All packages: \"pkg:/\"\n"
 	 << "\n"
+	 << "ssh:// reads a directory on a remote host with qdirstat-cache-writer\n"
+	 << "which has to be installed there; ssh has to log in without a password.\n"
+	 << "daemon:/ reads a snapshot of a directory that qdirstat-daemon keeps up\n"
+	 << "to date.\n"
+	 << "\n"
+	 << "--cache with several cache files reads them all into one tree.\n"
+	 << "Instead of a cache file, it can also read the output of \"find\"\n"
+	 << "(optionally with -printf '%y %s %T@ %p\\n') or an mlocate.db or\n"
+	 << "plocate.db file.\n"
+	 << "\n"
+	 << "--trace writes timestamped events of reading directories to a JSON\n"
+	 << "file in the Chrome trace format for chrome://tracing or ui.perfetto.dev\n"
+	 << "when the program exits.\n"
+	 << "\n"
 	 << std::endl;
 
     logError() << "FATAL: Bad command line args: " << argList.join( " " ) << endl;
@@ -92,8 +111,33 @@ bool commandLineSwitch( const QString & longName,
 }
 
 
+/**
+ * Extract a command line option with a parameter from the command line and
+ * remove both from 'argList'. Return the parameter or an empty string if
+ * the option is not there.
+ **/
+QString commandLineOption( const QString & longName,
+			   QStringList	 & argList )
+{
+    int index = argList.indexOf( longName );
+
+    if ( index < 0 || index + 1 >= argList.size() )
+	return QString();
+
+    QString param = argList.at( index + 1 );
+    argList.removeAt( index + 1 );
+    argList.removeAt( index );
+    logDebug() << "Found " << longName << " " << param << endl;
+
+    return param;
+}
+
+
 int main( int argc, char *argv[] )
 {
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+
     Logger logger( "/tmp/qdirstat-$USER", "qdirstat.log" );
     logVersion();
 
@@ -105,10 +149,22 @@ int main( int argc, char *argv[] )
     QStringList argList = QCoreApplication::arguments();
     argList.removeFirst(); // Remove program name
 
+    QString traceFileName = commandLineOption( "--trace", argList );
+
+    if ( ! traceFileName.isEmpty() )
+	QDirStat::ReadTrace::start( traceFileName );
+
+    // The MIME categories are only needed for the treemap colors and the
+    // file type statistics, so read them while the main window is set up.
+
+    QDirStat::MimeCategorizer::preload();
+
     MainWindow * mainWin = new MainWindow();
     CHECK_PTR( mainWin );
     mainWin->show();
 
+    logInfo() << "Main window after " << startupTimer.elapsed() << " millisec" << endl;
+
     bool dont_ask = commandLineSwitch( "--dont-ask", "-d", argList );
 
     if ( commandLineSwitch( "--slow-update", "-s", argList ) )
@@ -116,7 +172,9 @@ int main( int argc, char *argv[] )
 
     if ( argList.isEmpty() )
     {
-        if ( ! dont_ask )
+	if ( mainWin->restoreSession() )
+	    logInfo() << "Started restoring the last session after " << startupTimer.elapsed() << " millisec" << endl;
+        else if ( ! dont_ask )
             mainWin->askOpenDir();
     }
     else
@@ -125,11 +183,11 @@ int main( int argc, char *argv[] )
 
 	if ( arg == "--cache" || arg == "-c" )
 	{
-	    if ( argList.size() == 2 )
+	    if ( argList.size() >= 2 )
 	    {
-		QString cacheFileName = argList.at(1);
-		logDebug() << "Reading cache file " << cacheFileName << endl;
-		mainWin->readCache( cacheFileName );
+		QStringList cacheFileNames = argList.mid(1);
+		logDebug() << "Reading cache files " << cacheFileNames.join( " " ) << endl;
+		mainWin->readCaches( cacheFileNames );
 	    }
 	    else
 		usage( argList );
@@ -141,6 +199,7 @@ int main( int argc, char *argv[] )
 	else if ( ! arg.isEmpty() )
 	{
             mainWin->openUrl( arg );
+            logInfo() << "Started reading after " << startupTimer.elapsed() << " millisec" << endl;
 	}
     }
 
@@ -149,6 +208,9 @@ int main( int argc, char *argv[] )
 
     delete mainWin;
 
+    if ( QDirStat::ReadTrace::isEnabled() )
+	QDirStat::ReadTrace::stop();
+
     // If running with 'sudo', this would leave all config files behind owned
     // by root which means that the real user can't write to those files
     // anymore if once invoking QDirStat with 'sudo'. Fixing the file owner for
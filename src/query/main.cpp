@@ -0,0 +1,441 @@
+/*
+ *   File name: main.cpp
+ *   Summary:	Headless queries over QDirStat cache files
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <iostream>	// cerr, cout
+#include <algorithm>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRegExp>
+
+#include "DirTree.h"
+#include "DirTreeCache.h"
+#include "DirInfo.h"
+#include "FileSizeStats.h"
+#include "FileTypeStats.h"
+#include "SubtreeCollector.h"
+#include "TreeWalker.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+#include "Version.h"
+
+
+using std::cerr;
+using std::cout;
+using namespace QDirStat;
+
+static const char * progName = "qdirstat-query";
+
+#define DEFAULT_COUNT	20
+
+
+void usage()
+{
+    cerr << "\n"
+	 << "Usage: \n"
+	 << "\n"
+	 << "  " << progName << " [-rdh] [-n <count>] [-s <subtree>] [-p <pattern>] <query> <cache-file-name> [<cache-file-name>...]\n"
+	 << "\n"
+	 << "Queries:\n"
+	 << "\n"
+	 << "  dirs    the <count> largest directories (total size)\n"
+	 << "  files   the <count> largest files\n"
+	 << "  newest  the <count> newest files\n"
+	 << "  oldest  the <count> oldest files\n"
+	 << "  types   the <count> filename suffixes that use the most disk space\n"
+	 << "  sizes   percentiles of the file sizes\n"
+	 << "  total   total size and number of the files that match <pattern>\n"
+	 << "\n"
+	 << "  -n  number of results (default: " << DEFAULT_COUNT << ")\n"
+	 << "  -s  query only <subtree> (a full path) instead of the complete tree\n"
+	 << "  -p  wildcard pattern for the file names for \"total\", e.g. \"*.iso\"\n"
+	 << "  -r  readable sizes and times instead of bytes and seconds since 1970\n"
+	 << "  -d  debug\n"
+	 << "  -h  help (this usage message)\n"
+	 << "\n"
+	 << "The results are printed to stdout with one tab-separated line each.\n"
+	 << "Several cache files are queried one after another.\n"
+	 << "This does not need a display, so it can be used in cron jobs.\n"
+	 << std::endl;
+}
+
+
+/**
+ * Collector for the total size and number of all files with a name that
+ * matches a wildcard pattern.
+ **/
+class PatternTotalCollector: public SubtreeCollector
+{
+public:
+
+    PatternTotalCollector( const QRegExp & pattern ):
+	SubtreeCollector(),
+	_pattern( pattern ),
+	_totalSize( 0 ),
+	_count( 0 )
+	{}
+
+    FileSize totalSize() const { return _totalSize; }
+    qint64   count()     const { return _count;	    }
+
+protected:
+
+    virtual SubtreeCollector * createPartial() const Q_DECL_OVERRIDE
+    {
+	// Each thread needs its own copy of the QRegExp
+
+	PatternTotalCollector * partial = new PatternTotalCollector( _pattern );
+	CHECK_NEW( partial );
+
+	return partial;
+    }
+
+    virtual void collectFile( FileInfo * file ) Q_DECL_OVERRIDE
+    {
+	if ( _pattern.exactMatch( file->name() ) )
+	{
+	    _totalSize += file->size();
+	    ++_count;
+	}
+    }
+
+    virtual void merge( SubtreeCollector * rawPartial ) Q_DECL_OVERRIDE
+    {
+	PatternTotalCollector * partial = dynamic_cast<PatternTotalCollector *>( rawPartial );
+	CHECK_DYNAMIC_CAST( partial, "PatternTotalCollector" );
+
+	_totalSize += partial->_totalSize;
+	_count	   += partial->_count;
+    }
+
+    QRegExp  _pattern;
+    FileSize _totalSize;
+    qint64   _count;
+};
+
+
+/**
+ * Output options.
+ **/
+static bool readable = false;
+
+
+QString sizeString( FileSize size )
+{
+    return readable ? formatSize( size ) : QString::number( size );
+}
+
+
+QString timeString( time_t time )
+{
+    return readable ? formatTime( time ) : QString::number( (qint64) time );
+}
+
+
+bool largerTotalSize( DirInfo * a, DirInfo * b )
+{
+    return a->totalSize() > b->totalSize();
+}
+
+
+/**
+ * Add 'dir' and all real directories below it to 'dirs'.
+ **/
+void collectDirs( DirInfo * dir, QVector<DirInfo *> & dirs )
+{
+    dirs << dir;
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() )
+	    collectDirs( child->toDirInfo(), dirs );
+    }
+}
+
+
+void queryDirs( FileInfo * subtree, int count )
+{
+    if ( ! subtree->isDirInfo() )
+	return;
+
+    QVector<DirInfo *> dirs;
+    collectDirs( subtree->toDirInfo(), dirs );
+
+    count = qMin( count, dirs.size() );
+    std::partial_sort( dirs.begin(), dirs.begin() + count, dirs.end(), largerTotalSize );
+
+    for ( int i = 0; i < count; ++i )
+    {
+	DirInfo * dir = dirs.at( i );
+
+	cout << qPrintable( sizeString( dir->totalSize() ) ) << "\t"
+	     << dir->totalItems() << "\t"
+	     << qPrintable( dir->url() ) << "\n";
+    }
+}
+
+
+void queryTopFiles( FileInfo * subtree, int count, TopFilesTreeWalker * walker )
+{
+    walker->prepare( subtree );
+    const FileInfoList * results = walker->results();
+
+    for ( int i = 0; results && i < count && i < results->size(); ++i )
+    {
+	FileInfo * file = results->at( i );
+
+	cout << qPrintable( sizeString( file->size()  ) ) << "\t"
+	     << qPrintable( timeString( file->mtime() ) ) << "\t"
+	     << qPrintable( file->url() ) << "\n";
+    }
+
+    delete walker;
+}
+
+
+void queryTypes( FileInfo * subtree, int count )
+{
+    FileTypeStats stats;
+    stats.calc( subtree );
+
+    QList<QPair<FileSize, QString> > suffixes;
+
+    for ( StringFileSizeMapIterator it = stats.suffixSumBegin();
+	  it != stats.suffixSumEnd();
+	  ++it )
+    {
+	suffixes << qMakePair( it.value(), it.key() );
+    }
+
+    std::sort( suffixes.begin(), suffixes.end() );
+    std::reverse( suffixes.begin(), suffixes.end() );
+
+    for ( int i = 0; i < count && i < suffixes.size(); ++i )
+    {
+	const QString & suffix = suffixes.at( i ).second;
+
+	cout << qPrintable( sizeString( suffixes.at( i ).first ) ) << "\t"
+	     << stats.suffixCount( suffix ) << "\t"
+	     << qPrintable( suffix == NO_SUFFIX ? QString( "<no suffix>" ) : "*." + suffix ) << "\n";
+    }
+}
+
+
+void querySizes( FileInfo * subtree )
+{
+    FileSizeStats stats( subtree );
+
+    if ( stats.dataSize() == 0 )
+	return;
+
+    cout << "files\t" << stats.dataSize() << "\n"
+	 << "min\t" << qPrintable( sizeString( stats.min() ) ) << "\n";
+
+    int percentiles[] = { 10, 25, 50, 75, 90, 99 };
+
+    for ( size_t i = 0; i < sizeof( percentiles ) / sizeof( int ); ++i )
+    {
+	cout << "p" << percentiles[ i ] << "\t"
+	     << qPrintable( sizeString( stats.percentile( percentiles[ i ] ) ) ) << "\n";
+    }
+
+    cout << "max\t"	<< qPrintable( sizeString( stats.max()	   ) ) << "\n"
+	 << "average\t" << qPrintable( sizeString( stats.average() ) ) << "\n";
+}
+
+
+void queryTotal( FileInfo * subtree, const QString & pattern )
+{
+    PatternTotalCollector collector( QRegExp( pattern, Qt::CaseSensitive, QRegExp::Wildcard ) );
+    collector.collectSubtree( subtree );
+
+    cout << qPrintable( sizeString( collector.totalSize() ) ) << "\t"
+	 << collector.count() << "\t"
+	 << qPrintable( pattern ) << "\n";
+}
+
+
+/**
+ * Read 'cacheFileName' and run 'query' over it. Return 'true' on success,
+ * 'false' on error.
+ **/
+bool runQuery( const QString & query,
+	       const QString & cacheFileName,
+	       const QString & subtreePath,
+	       const QString & pattern,
+	       int	       count )
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    DirTree tree;
+
+    {
+	CacheReader reader( cacheFileName, &tree );
+
+	if ( ! reader.ok() )
+	{
+	    cerr << progName << ": Could not read " << qPrintable( cacheFileName ) << std::endl;
+	    return false;
+	}
+
+	reader.read();	// The entire file
+    }
+
+    // The reader finalizes the tree when it is destroyed
+
+    logInfo() << "Read " << cacheFileName << " in " << timer.elapsed() << " millisec" << endl;
+
+    FileInfo * subtree = subtreePath.isEmpty() ?
+	tree.firstToplevel() : tree.locate( subtreePath );
+
+    if ( ! subtree )
+    {
+	cerr << progName << ": " << qPrintable( subtreePath.isEmpty() ? cacheFileName : subtreePath )
+	     << " not found in " << qPrintable( cacheFileName ) << std::endl;
+	return false;
+    }
+
+    timer.restart();
+
+    if	    ( query == "dirs"	) queryDirs( subtree, count );
+    else if ( query == "files"	) queryTopFiles( subtree, count, new LargestFilesTreeWalker() );
+    else if ( query == "newest" ) queryTopFiles( subtree, count, new NewFilesTreeWalker() );
+    else if ( query == "oldest" ) queryTopFiles( subtree, count, new OldFilesTreeWalker() );
+    else if ( query == "types"	) queryTypes( subtree, count );
+    else if ( query == "sizes"	) querySizes( subtree );
+    else if ( query == "total"	) queryTotal( subtree, pattern );
+
+    cout << std::flush;
+    logInfo() << "Query \"" << query << "\" took " << timer.elapsed() << " millisec" << endl;
+
+    return true;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    Logger logger( "/tmp/qdirstat-$USER", "qdirstat-query.log" );
+    logger.setLogLevel( LogSeverityInfo );
+    logInfo() << "qdirstat-query " << QDIRSTAT_VERSION
+	      << " built with Qt " << QT_VERSION_STR << endl;
+
+    // Set org/app name for QSettings: The MIME categories for the file
+    // types are the same as for QDirStat.
+
+    QCoreApplication::setOrganizationName( "QDirStat" );
+    QCoreApplication::setApplicationName ( "QDirStat" );
+
+    QCoreApplication qtApp( argc, argv );
+    QStringList argList = QCoreApplication::arguments();
+    argList.removeFirst(); // Remove program name
+
+    int		count = DEFAULT_COUNT;
+    QString	subtreePath;
+    QString	pattern;
+    QStringList params;
+
+    // Single-letter options that may be combined like with getopts: "-rd"
+
+    while ( ! argList.isEmpty() )
+    {
+	QString arg = argList.takeFirst();
+
+	if ( ! arg.startsWith( "-" ) || arg == "-" )
+	{
+	    params << arg;
+	    continue;
+	}
+
+	for ( int i = 1; i < arg.size(); ++i )
+	{
+	    switch ( arg.at( i ).toLatin1() )
+	    {
+		case 'r': readable = true; break;
+		case 'd': logger.setLogLevel( LogSeverityDebug ); break;
+
+		case 's':
+		    if ( argList.isEmpty() )
+		    {
+			usage();
+			return 1;
+		    }
+
+		    subtreePath = argList.takeFirst();
+		    break;
+
+		case 'p':
+		    if ( argList.isEmpty() )
+		    {
+			usage();
+			return 1;
+		    }
+
+		    pattern = argList.takeFirst();
+		    break;
+
+		case 'n':
+		    {
+			bool ok = ! argList.isEmpty();
+
+			if ( ok )
+			    count = argList.takeFirst().toInt( &ok );
+
+			if ( ! ok || count < 1 )
+			{
+			    usage();
+			    return 1;
+			}
+		    }
+		    break;
+
+		case 'h':
+		    usage();
+		    return 0;
+
+		default:
+		    usage();
+		    return 1;
+	    }
+	}
+    }
+
+    // The query and at least one cache file are required
+
+    QStringList queries;
+    queries << "dirs" << "files" << "newest" << "oldest" << "types" << "sizes" << "total";
+
+    if ( params.size() < 2 || ! queries.contains( params.first() ) )
+    {
+	usage();
+	return 1;
+    }
+
+    QString query = params.takeFirst();
+
+    if ( query == "total" && pattern.isEmpty() )
+	pattern = "*";
+
+    if ( subtreePath.endsWith( "/" ) && subtreePath.size() > 1 )
+	subtreePath.chop( 1 );
+
+    int exitCode = 0;
+
+    foreach ( const QString & cacheFileName, params )
+    {
+	if ( params.size() > 1 )
+	    cout << "# " << qPrintable( cacheFileName ) << "\n";
+
+	if ( ! runQuery( query, cacheFileName, subtreePath, pattern, count ) )
+	    exitCode = 1;
+    }
+
+    return exitCode;
+}
@@ -0,0 +1,29 @@
+# qmake .pro file for qdirstat/src/query
+#
+# This builds qdirstat-query, a program without any GUI that reads QDirStat
+# cache files and prints statistics about them like the largest directories
+# or the disk space used by each file type. It does not need a display, so
+# it can be run from cron jobs.
+#
+# It still links against the Qt widgets library because some of the classes
+# it uses are shared with the GUI (see ../core.pri), but it never creates a
+# QApplication.
+
+TEMPLATE	 = app
+
+QT		+= widgets
+MOC_DIR		 = .moc
+OBJECTS_DIR	 = .obj
+isEmpty(INSTALL_PREFIX):INSTALL_PREFIX = /usr
+
+TARGET		 = qdirstat-query
+TARGET.files	 = qdirstat-query
+TARGET.path	 = $$INSTALL_PREFIX/bin
+INSTALLS	+= TARGET
+
+QMAKE_CXXFLAGS	+=  -Wno-deprecated -Wno-deprecated-declarations
+
+
+SOURCES	  = main.cpp
+
+include(../core.pri)
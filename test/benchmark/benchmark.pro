@@ -0,0 +1,27 @@
+# qmake .pro file for qdirstat/test/benchmark
+#
+# This builds qdirstat-benchmark which generates a synthetic directory tree
+# and measures reading it, writing a cache file and reading that cache file.
+# It is not built by default; build it from the project toplevel dir with
+#
+#     qmake CONFIG+=benchmark
+#     make
+#
+# or just here with
+#
+#     qmake && make
+#
+# It is never installed.
+
+TEMPLATE	 = app
+
+MOC_DIR		 = .moc
+OBJECTS_DIR	 = .obj
+TARGET		 = qdirstat-benchmark
+
+QMAKE_CXXFLAGS	+=  -Wno-deprecated -Wno-deprecated-declarations
+
+
+SOURCES	  = main.cpp
+
+include(../../src/core.pri)
@@ -0,0 +1,539 @@
+/*
+ *   File name: main.cpp
+ *   Summary:	Benchmark for reading and writing directory trees
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/resource.h>	// getrusage()
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>		// cerr, cout
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#include "DirTree.h"
+#include "DirTreeCache.h"
+#include "DirInfo.h"
+#include "FileSizeStats.h"
+#include "ReadTrace.h"
+#include "Logger.h"
+#include "Exception.h"
+#include "Version.h"
+
+
+using std::cerr;
+using std::cout;
+using namespace QDirStat;
+
+static const char * progName = "qdirstat-benchmark";
+
+
+/**
+ * The shape of the synthetic directory tree.
+ **/
+struct TreeParams
+{
+    TreeParams():
+	depth( 3 ),
+	fanout( 8 ),
+	filesPerDir( 50 ),
+	minNameLen( 4 ),
+	maxNameLen( 24 ),
+	hardLinkPercent( 0 ),
+	fileSize( 0 ),
+	seed( 42 )
+	{}
+
+    int	     depth;
+    int	     fanout;
+    int	     filesPerDir;
+    int	     minNameLen;
+    int	     maxNameLen;
+    int	     hardLinkPercent;
+    FileSize fileSize;
+    quint32  seed;
+};
+
+
+/**
+ * Generator for a synthetic directory tree: 'fanout' subdirectories per
+ * directory down to 'depth' levels, 'filesPerDir' files in each directory
+ * with random name lengths, and some of them hard links to files that were
+ * created before. The files are sparse, so they don't use any disk space.
+ *
+ * The same parameters (including the seed) always create the same tree.
+ **/
+class TreeGenerator
+{
+public:
+
+    TreeGenerator( const TreeParams & params ):
+	_params( params ),
+	_random( params.seed ? params.seed : 1 ),
+	_dirs( 0 ),
+	_files( 0 ),
+	_hardLinks( 0 )
+	{}
+
+    /**
+     * Create the tree below 'path'. Return 'false' on error.
+     **/
+    bool generate( const QString & path )
+    {
+	return generateDir( path, 0 );
+    }
+
+    int dirs()	    const { return _dirs;      }
+    int files()	    const { return _files;     }
+    int hardLinks() const { return _hardLinks; }
+
+protected:
+
+    bool generateDir( const QString & path, int level )
+    {
+	for ( int i = 0; i < _params.filesPerDir; ++i )
+	{
+	    QByteArray filePath = ( path + "/" + randomName( i ) ).toUtf8();
+
+	    if ( ! _linkTarget.isEmpty() && (int) ( random() % 100 ) < _params.hardLinkPercent )
+	    {
+		if ( link( _linkTarget, filePath ) != 0 )
+		    return reportError( filePath );
+
+		++_hardLinks;
+		continue;
+	    }
+
+	    int fd = open( filePath, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644 );
+
+	    if ( fd < 0 )
+		return reportError( filePath );
+
+	    if ( _params.fileSize > 0 && ftruncate( fd, _params.fileSize ) != 0 )
+	    {
+		close( fd );
+		return reportError( filePath );
+	    }
+
+	    close( fd );
+	    ++_files;
+
+	    if ( _linkTarget.isEmpty() || random() % 16 == 0 )
+		_linkTarget = filePath;
+	}
+
+	if ( level >= _params.depth )
+	    return true;
+
+	for ( int i = 0; i < _params.fanout; ++i )
+	{
+	    QString subDir = path + "/" + randomName( i ) + ".d";
+
+	    if ( mkdir( subDir.toUtf8(), 0755 ) != 0 )
+		return reportError( subDir.toUtf8() );
+
+	    ++_dirs;
+
+	    if ( ! generateDir( subDir, level + 1 ) )
+		return false;
+	}
+
+	return true;
+    }
+
+    /**
+     * Return a random name with a length between 'minNameLen' and
+     * 'maxNameLen' (unless that is too short for the suffix) that is unique
+     * in its directory because it ends with "." and 'no'.
+     **/
+    QString randomName( int no )
+    {
+	static const char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789_-";
+
+	QString suffix = "." + QString::number( no );
+	int range = qMax( 0, _params.maxNameLen - _params.minNameLen );
+	int len	  = _params.minNameLen + ( range > 0 ? random() % ( range + 1 ) : 0 );
+	len	 -= suffix.size();
+
+	QString name;
+	name.reserve( qMax( len, 0 ) + suffix.size() );
+
+	for ( int i = 0; i < len; ++i )
+	    name += QChar( chars[ random() % ( sizeof( chars ) - 1 ) ] );
+
+	return name + suffix;
+    }
+
+    /**
+     * A simple xorshift pseudo random number generator: The same on all
+     * platforms, unlike rand().
+     **/
+    quint32 random()
+    {
+	_random ^= _random << 13;
+	_random ^= _random >> 17;
+	_random ^= _random << 5;
+
+	return _random;
+    }
+
+    bool reportError( const QByteArray & path )
+    {
+	cerr << progName << ": Can't create " << path.constData()
+	     << ": " << qPrintable( formatErrno() ) << std::endl;
+
+	return false;
+    }
+
+
+    TreeParams _params;
+    quint32    _random;
+    QByteArray _linkTarget;
+    int	       _dirs;
+    int	       _files;
+    int	       _hardLinks;
+};
+
+
+/**
+ * Return the peak resident set size of this process so far in kB.
+ **/
+static long peakRssKB()
+{
+    struct rusage usage;
+
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 )
+	return -1;
+
+    return usage.ru_maxrss; // Linux: kB
+}
+
+
+/**
+ * Wait until 'tree' has finished reading.
+ **/
+static void waitForTree( DirTree * tree )
+{
+    if ( ! tree->isBusy() )
+	return;
+
+    QEventLoop eventLoop;
+
+    QObject::connect( tree,	  SIGNAL( finished() ),
+		      &eventLoop, SLOT	( quit()     ) );
+
+    QObject::connect( tree,	  SIGNAL( aborted()  ),
+		      &eventLoop, SLOT	( quit()     ) );
+
+    eventLoop.exec();
+}
+
+
+/**
+ * Return the number of items below and including the toplevel of 'tree'.
+ **/
+static int itemCount( DirTree * tree )
+{
+    FileInfo * toplevel = tree->root() ? tree->root()->firstChild() : 0;
+
+    return toplevel ? toplevel->totalItems() + 1 : 0;
+}
+
+
+/**
+ * Mark the summaries of all directories below and including 'item' as
+ * dirty, so the next query has to calculate all of them again.
+ **/
+static void markAllDirty( FileInfo * item )
+{
+    DirInfo * dir = item->toDirInfo();
+
+    if ( ! dir )
+	return;
+
+    dir->markSummaryDirty();
+
+    if ( dir->dotEntry() )
+	markAllDirty( dir->dotEntry() );
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+	markAllDirty( child );
+}
+
+
+/**
+ * Add the duration and throughput of one benchmark to 'result'.
+ **/
+static void addTiming( QJsonObject & result,
+		       const QString & name,
+		       qint64	       millisec,
+		       int	       items )
+{
+    QJsonObject timing;
+    timing[ "millisec"	  ] = (double) millisec;
+    timing[ "items"	  ] = items;
+    timing[ "itemsPerSec" ] = millisec > 0 ? items * 1000.0 / millisec : 0.0;
+    timing[ "peakRssKB"	  ] = (double) peakRssKB();
+
+    result[ name ] = timing;
+}
+
+
+void usage()
+{
+    cerr << "\n"
+	 << "Usage: \n"
+	 << "\n"
+	 << "  " << progName << " [<option>=<value> ...]\n"
+	 << "\n"
+	 << "Generate a synthetic directory tree, then measure reading it,\n"
+	 << "recalculating its sums, collecting its file size statistics, writing a\n"
+	 << "cache file and reading that cache file. Each run writes one line of\n"
+	 << "JSON to stdout.\n"
+	 << "\n"
+	 << "Options (defaults in parentheses):\n"
+	 << "\n"
+	 << "  --depth=<n>              directory levels below the toplevel (3)\n"
+	 << "  --fanout=<n>             subdirectories per directory (8)\n"
+	 << "  --files=<n>              files per directory (50)\n"
+	 << "  --min-name-len=<n>       shortest file name (4)\n"
+	 << "  --max-name-len=<n>       longest file name (24)\n"
+	 << "  --hard-links=<percent>   files that are hard links to other files (0)\n"
+	 << "  --file-size=<bytes>      size of each (sparse) file (0)\n"
+	 << "  --seed=<n>               random seed (42)\n"
+	 << "  --threads=<n>            read threads; 0: automatic, 1: main thread only (0)\n"
+	 << "  --runs=<n>               number of runs on the same tree (3)\n"
+	 << "  --dir=<path>             where to create the tree (a temporary directory)\n"
+	 << "  --cache=<file-name>      cache file name; the suffix selects the format\n"
+	 << "                           (bench.cache.gz in that directory)\n"
+	 << "  --trace=<file-name>      write a Chrome trace of reading the tree and the\n"
+	 << "                           cache file in all runs (none)\n"
+	 << "  --file-columns=<0|1>     keep file attributes in contiguous columns (0)\n"
+	 << "  --trees=<n>              also read the tree into n trees at the same time\n"
+	 << "                           that share the read threads (1: don't)\n"
+	 << "\n"
+	 << std::endl;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    Logger logger( "/tmp/qdirstat-$USER", "qdirstat-benchmark.log" );
+    logger.setLogLevel( LogSeverityWarning );
+
+    QCoreApplication qtApp( argc, argv );
+    QStringList argList = QCoreApplication::arguments();
+    argList.removeFirst(); // Remove program name
+
+    TreeParams params;
+    int	    threads = 0;
+    int	    runs    = 3;
+    QString baseDir;
+    QString cacheFileName;
+    QString traceFileName;
+    int	    fileColumns = 0;
+    int	    trees	= 1;
+
+    foreach ( const QString & arg, argList )
+    {
+	QString name  = arg.section( '=', 0, 0 );
+	QString value = arg.section( '=', 1 );
+	bool	ok    = true;
+
+	if	( name == "--depth"	   ) params.depth	    = value.toInt( &ok );
+	else if ( name == "--fanout"	   ) params.fanout	    = value.toInt( &ok );
+	else if ( name == "--files"	   ) params.filesPerDir	    = value.toInt( &ok );
+	else if ( name == "--min-name-len" ) params.minNameLen	    = value.toInt( &ok );
+	else if ( name == "--max-name-len" ) params.maxNameLen	    = value.toInt( &ok );
+	else if ( name == "--hard-links"   ) params.hardLinkPercent = value.toInt( &ok );
+	else if ( name == "--file-size"	   ) params.fileSize	    = value.toLongLong( &ok );
+	else if ( name == "--seed"	   ) params.seed	    = value.toUInt( &ok );
+	else if ( name == "--threads"	   ) threads		    = value.toInt( &ok );
+	else if ( name == "--runs"	   ) runs		    = value.toInt( &ok );
+	else if ( name == "--dir"	   ) baseDir		    = value;
+	else if ( name == "--cache"	   ) cacheFileName	    = value;
+	else if ( name == "--trace"	   ) traceFileName	    = value;
+	else if ( name == "--file-columns" ) fileColumns	    = value.toInt( &ok );
+	else if ( name == "--trees"	   ) trees		    = value.toInt( &ok );
+	else if ( name == "--help" || name == "-h" )
+	{
+	    usage();
+	    return 0;
+	}
+	else
+	    ok = false;
+
+	if ( ! ok || value.isEmpty() )
+	{
+	    cerr << progName << ": Bad argument " << qPrintable( arg ) << std::endl;
+	    usage();
+	    return 1;
+	}
+    }
+
+    QTemporaryDir tempDir( QDir::tempPath() + "/qdirstat-benchmark-XXXXXX" );
+
+    if ( baseDir.isEmpty() )
+    {
+	if ( ! tempDir.isValid() )
+	{
+	    cerr << progName << ": Can't create a temporary directory" << std::endl;
+	    return 1;
+	}
+
+	baseDir = tempDir.path();
+    }
+
+    QString treeDir = QFileInfo( baseDir ).absoluteFilePath() + "/tree";
+
+    if ( cacheFileName.isEmpty() )
+	cacheFileName = QFileInfo( baseDir ).absoluteFilePath() + "/bench.cache.gz";
+
+    if ( mkdir( treeDir.toUtf8(), 0755 ) != 0 )
+    {
+	cerr << progName << ": Can't create " << qPrintable( treeDir )
+	     << ": " << qPrintable( formatErrno() ) << std::endl;
+	return 1;
+    }
+
+
+    // Generate the tree
+
+    QJsonObject paramsJson;
+    paramsJson[ "depth"		  ] = params.depth;
+    paramsJson[ "fanout"	  ] = params.fanout;
+    paramsJson[ "filesPerDir"	  ] = params.filesPerDir;
+    paramsJson[ "minNameLen"	  ] = params.minNameLen;
+    paramsJson[ "maxNameLen"	  ] = params.maxNameLen;
+    paramsJson[ "hardLinkPercent" ] = params.hardLinkPercent;
+    paramsJson[ "fileSize"	  ] = (double) params.fileSize;
+    paramsJson[ "seed"		  ] = (double) params.seed;
+    paramsJson[ "threads"	  ] = threads;
+    paramsJson[ "fileColumns"	  ] = fileColumns;
+    paramsJson[ "trees"		  ] = trees;
+
+    TreeGenerator generator( params );
+    QElapsedTimer timer;
+    timer.start();
+
+    if ( ! generator.generate( treeDir ) )
+	return 1;
+
+    QJsonObject generated;
+    generated[ "millisec"  ] = (double) timer.elapsed();
+    generated[ "dirs"	   ] = generator.dirs();
+    generated[ "files"	   ] = generator.files();
+    generated[ "hardLinks" ] = generator.hardLinks();
+
+
+    // The benchmark runs. The first run reads the tree with a cold dentry
+    // cache only if the caller dropped the caches in the meantime.
+
+    if ( ! traceFileName.isEmpty() )
+	ReadTrace::start( traceFileName );
+
+    for ( int run = 0; run < runs; ++run )
+    {
+	QJsonObject result;
+	result[ "version"   ] = QDIRSTAT_VERSION;
+	result[ "run"	    ] = run;
+	result[ "params"    ] = paramsJson;
+	result[ "generated" ] = generated;
+
+	{
+	    DirTree tree;
+	    tree.setReadThreads( threads );
+	    tree.setFileColumns( fileColumns != 0 );
+
+	    timer.start();
+	    tree.startReading( treeDir );
+	    waitForTree( &tree );
+	    addTiming( result, "scan", timer.elapsed(), itemCount( &tree ) );
+
+	    FileInfo * toplevel = tree.root()->firstChild();
+
+	    if ( toplevel )
+	    {
+		markAllDirty( toplevel );
+		timer.start();
+		toplevel->totalSize();
+		addTiming( result, "recalc", timer.elapsed(), itemCount( &tree ) );
+
+		timer.start();
+		FileSizeStats stats( toplevel );
+		addTiming( result, "sizeStats", timer.elapsed(), stats.dataSize() );
+	    }
+
+	    timer.start();
+	    CacheWriter writer( cacheFileName, &tree );
+	    addTiming( result, "cacheWrite", timer.elapsed(), itemCount( &tree ) );
+
+	    if ( ! writer.ok() )
+	    {
+		cerr << progName << ": Can't write " << qPrintable( cacheFileName ) << std::endl;
+		return 1;
+	    }
+
+	    result[ "cacheFileSize" ] = (double) QFileInfo( cacheFileName ).size();
+	}
+
+	if ( trees > 1 )
+	{
+	    QList<DirTree *> treeList;
+	    int items = 0;
+
+	    timer.start();
+
+	    for ( int i = 0; i < trees; ++i )
+	    {
+		DirTree * tree = new DirTree();
+		CHECK_NEW( tree );
+		tree->setReadThreads( threads );
+		tree->startReading( treeDir );
+		treeList << tree;
+	    }
+
+	    foreach ( DirTree * tree, treeList )
+	    {
+		waitForTree( tree );
+		items += itemCount( tree );
+	    }
+
+	    addTiming( result, "scanTrees", timer.elapsed(), items );
+	    qDeleteAll( treeList );
+	}
+
+	{
+	    DirTree tree;
+
+	    timer.start();
+	    tree.readCache( cacheFileName );
+	    waitForTree( &tree );
+	    addTiming( result, "cacheRead", timer.elapsed(), itemCount( &tree ) );
+	}
+
+	result[ "peakRssKB" ] = (double) peakRssKB();
+
+	cout << QJsonDocument( result ).toJson( QJsonDocument::Compact ).constData() << std::endl;
+    }
+
+    if ( ReadTrace::isEnabled() && ! ReadTrace::stop() )
+    {
+	cerr << progName << ": Can't write " << qPrintable( traceFileName ) << std::endl;
+	return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,510 @@
+/*
+ *   File name: main.cpp
+ *   Summary:	Microbenchmarks for classifying and filtering items
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <sys/resource.h>	// getrusage()
+#include <string.h>		// memcpy()
+#include <zlib.h>		// gzopen(), gzgets()
+#include <algorithm>		// std::sort()
+#include <iostream>		// cerr, cout
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#include "DirTree.h"
+#include "DirTreeCache.h"
+#include "DirTreeFilter.h"
+#include "DirTreePatternFilter.h"
+#include "DirInfo.h"
+#include "ExcludeRules.h"
+#include "FileInfoIterator.h"
+#include "FileInfoSorter.h"
+#include "FormatUtil.h"
+#include "LineTokenizer.h"
+#include "MimeCategorizer.h"
+#include "Logger.h"
+#include "Exception.h"
+#include "Version.h"
+
+
+using std::cerr;
+using std::cout;
+using namespace QDirStat;
+
+static const char * progName = "qdirstat-micro-benchmark";
+
+
+/**
+ * The items of a cache file in the form the benchmarks need them, all
+ * extracted before any measuring starts.
+ **/
+struct Corpus
+{
+    Corpus():
+	categorizer( 0 ),
+	excludeRules( 0 )
+	{}
+
+    FileInfoList	  files;	// all regular files
+    QStringList		  names;	// the names of all items
+    QStringList		  paths;	// the paths of all items
+    QList<FileInfoList>	  childLists;	// the children of each directory
+    QList<QByteArray>	  lines;	// the lines of a text cache file
+
+    MimeCategorizer *	  categorizer;
+    ExcludeRules *	  excludeRules;
+    QList<DirTreeFilter*> filters;
+};
+
+
+/**
+ * A benchmark processes all items of its part of the corpus once and
+ * returns the number of items and a checksum of the results, so the
+ * compiler can't optimize the work away.
+ **/
+typedef int (*BenchmarkFunc)( Corpus & corpus, qint64 & checksum );
+
+struct Benchmark
+{
+    const char *  name;
+    BenchmarkFunc func;
+};
+
+
+/**
+ * Collect the items of the subtree of 'dir' into 'corpus'.
+ **/
+static void collect( FileInfo * dir, Corpus & corpus )
+{
+    FileInfoList children;
+    FileInfoIterator it( dir );
+
+    while ( *it )
+    {
+	FileInfo * item = *it;
+
+	if ( ! item->isDotEntry() )
+	{
+	    children << item;
+	    corpus.names << item->name();
+	    corpus.paths << item->url();
+
+	    if ( item->isFile() )
+		corpus.files << item;
+	}
+
+	if ( item->hasChildren() )
+	    collect( item, corpus );
+
+	++it;
+    }
+
+    if ( children.size() > 1 )
+	corpus.childLists << children;
+}
+
+
+/**
+ * Write 'tree' to a temporary text cache file and read back its lines.
+ * Return 'false' on error.
+ **/
+static bool collectCacheLines( DirTree * tree, Corpus & corpus )
+{
+    QTemporaryDir tempDir;
+
+    if ( ! tempDir.isValid() )
+	return false;
+
+    QString cacheFileName = tempDir.path() + "/micro-benchmark.cache.gz";
+
+    {
+	CacheWriter writer( cacheFileName, tree );
+
+	if ( ! writer.ok() )
+	    return false;
+    }
+
+    gzFile cache = gzopen( cacheFileName.toUtf8().constData(), "r" );
+
+    if ( ! cache )
+	return false;
+
+    char buffer[ MAX_CACHE_LINE_LEN ];
+
+    while ( gzgets( cache, buffer, sizeof( buffer ) - 1 ) )
+    {
+	if ( *buffer != '#' && *buffer != '\n' )
+	    corpus.lines << QByteArray( buffer );
+    }
+
+    gzclose( cache );
+
+    return ! corpus.lines.isEmpty();
+}
+
+
+//
+// The benchmarks
+//
+
+
+static int categoryByName( Corpus & corpus, qint64 & checksum )
+{
+    foreach ( const QString & name, corpus.names )
+	checksum += (quintptr) corpus.categorizer->category( name ) & 0xFFFF;
+
+    return corpus.names.size();
+}
+
+
+static int categoryByItem( Corpus & corpus, qint64 & checksum )
+{
+    // After the first run, this is the cached category of each item
+
+    foreach ( FileInfo * file, corpus.files )
+	checksum += (quintptr) corpus.categorizer->category( file ) & 0xFFFF;
+
+    return corpus.files.size();
+}
+
+
+static int excludeRulesMatch( Corpus & corpus, qint64 & checksum )
+{
+    for ( int i = 0; i < corpus.paths.size(); ++i )
+    {
+	if ( corpus.excludeRules->match( corpus.paths.at( i ), corpus.names.at( i ) ) )
+	    ++checksum;
+    }
+
+    return corpus.paths.size();
+}
+
+
+static int patternFilterIgnore( Corpus & corpus, qint64 & checksum )
+{
+    foreach ( const QString & path, corpus.paths )
+    {
+	foreach ( DirTreeFilter * filter, corpus.filters )
+	{
+	    if ( filter->ignore( path ) )
+	    {
+		++checksum;
+		break;
+	    }
+	}
+    }
+
+    return corpus.paths.size();
+}
+
+
+/**
+ * Sort the children of each directory by 'sortCol' and return the number
+ * of items.
+ **/
+static int sortChildren( Corpus & corpus, qint64 & checksum, DataColumn sortCol )
+{
+    FileInfoSorter sorter( sortCol, Qt::AscendingOrder );
+    FileInfoList   list;
+    int		   count = 0;
+
+    foreach ( const FileInfoList & children, corpus.childLists )
+    {
+	list = children;	// Always sort the unsorted list
+	std::sort( list.begin(), list.end(), sorter );
+	checksum += (quintptr) list.first() & 0xFFFF;
+	count	 += list.size();
+    }
+
+    return count;
+}
+
+
+static int sortByName( Corpus & corpus, qint64 & checksum )
+{
+    return sortChildren( corpus, checksum, NameCol );
+}
+
+
+static int sortBySize( Corpus & corpus, qint64 & checksum )
+{
+    return sortChildren( corpus, checksum, SizeCol );
+}
+
+
+static int sortByMtime( Corpus & corpus, qint64 & checksum )
+{
+    return sortChildren( corpus, checksum, LatestMTimeCol );
+}
+
+
+static int formatSizes( Corpus & corpus, qint64 & checksum )
+{
+    foreach ( FileInfo * file, corpus.files )
+	checksum += formatSize( file->size() ).size();
+
+    return corpus.files.size();
+}
+
+
+static int splitLines( Corpus & corpus, qint64 & checksum )
+{
+    // This is what CacheReader::splitLine() does for each line; copying the
+    // line first is needed since splitting it overwrites the whitespace.
+
+    char   buffer[ MAX_CACHE_LINE_LEN ];
+    char * fields[ MAX_FIELDS_PER_LINE ];
+
+    foreach ( const QByteArray & line, corpus.lines )
+    {
+	memcpy( buffer, line.constData(), line.size() + 1 );
+	checksum += LineTokenizer::splitFields( buffer, fields, MAX_FIELDS_PER_LINE-1 );
+    }
+
+    return corpus.lines.size();
+}
+
+
+static const Benchmark benchmarks[] =
+{
+    { "categoryByName", categoryByName	    },
+    { "categoryByItem", categoryByItem	    },
+    { "excludeRules",	excludeRulesMatch   },
+    { "patternFilter",	patternFilterIgnore },
+    { "sortByName",	sortByName	    },
+    { "sortBySize",	sortBySize	    },
+    { "sortByMtime",	sortByMtime	    },
+    { "formatSize",	formatSizes	    },
+    { "splitLine",	splitLines	    },
+    { 0,		0		    }
+};
+
+
+/**
+ * Return the peak resident set size of this process so far in kB.
+ **/
+static long peakRssKB()
+{
+    struct rusage usage;
+
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 )
+	return -1;
+
+    return usage.ru_maxrss; // Linux: kB
+}
+
+
+void usage()
+{
+    cerr << "\n"
+	 << "Usage: \n"
+	 << "\n"
+	 << "  " << progName << " [<option>=<value> ...] <cache-file>\n"
+	 << "\n"
+	 << "Read a QDirStat cache file, extract the names, paths, files, directories\n"
+	 << "and cache lines of all its items, then measure each hot path of\n"
+	 << "classifying and filtering over all of them. Each run of each benchmark\n"
+	 << "writes one line of JSON to stdout.\n"
+	 << "\n"
+	 << "Benchmarks:\n"
+	 << "\n";
+
+    for ( const Benchmark * benchmark = benchmarks; benchmark->name; ++benchmark )
+	cerr << "  " << benchmark->name << "\n";
+
+    cerr << "\n"
+	 << "Options (defaults in parentheses):\n"
+	 << "\n"
+	 << "  --only=<name>[,...]      only these benchmarks (all)\n"
+	 << "  --exclude=<wildcard>[,...] exclude rules for the full path\n"
+	 << "                           (*/.git,*/node_modules/*,*/.cache/*)\n"
+	 << "  --filter=<pattern>[,...] patterns for the filters\n"
+	 << "                           (*.o,*.tmp,*~,core.*,*/build/*)\n"
+	 << "  --repeat=<n>             passes over the corpus in each run (1)\n"
+	 << "  --runs=<n>               number of runs of each benchmark (5)\n"
+	 << "\n"
+	 << std::endl;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    Logger logger( "/tmp/qdirstat-$USER", "qdirstat-micro-benchmark.log" );
+    logger.setLogLevel( LogSeverityWarning );
+
+    // Use separate settings so the benchmark never changes the user's
+    // QDirStat config.
+
+    QCoreApplication::setOrganizationName( "QDirStat" );
+    QCoreApplication::setApplicationName ( "QDirStat-micro-benchmark" );
+
+    QCoreApplication qtApp( argc, argv );
+    QStringList argList = QCoreApplication::arguments();
+    argList.removeFirst(); // Remove program name
+
+    QStringList only;
+    QStringList excludePatterns;
+    QStringList filterPatterns;
+    int		repeat = 1;
+    int		runs   = 5;
+    QString	cacheFileName;
+
+    excludePatterns << "*/.git" << "*/node_modules/*" << "*/.cache/*";
+    filterPatterns  << "*.o" << "*.tmp" << "*~" << "core.*" << "*/build/*";
+
+    foreach ( const QString & arg, argList )
+    {
+	if ( ! arg.startsWith( "-" ) )
+	{
+	    if ( ! cacheFileName.isEmpty() )
+	    {
+		usage();
+		return 1;
+	    }
+
+	    cacheFileName = arg;
+	    continue;
+	}
+
+	QString name  = arg.section( '=', 0, 0 );
+	QString value = arg.section( '=', 1 );
+	bool	ok    = true;
+
+	if	( name == "--only"    ) only		= value.split( ',', QString::SkipEmptyParts );
+	else if ( name == "--exclude" ) excludePatterns = value.split( ',', QString::SkipEmptyParts );
+	else if ( name == "--filter"  ) filterPatterns	= value.split( ',', QString::SkipEmptyParts );
+	else if ( name == "--repeat"  ) repeat		= value.toInt( &ok );
+	else if ( name == "--runs"    ) runs		= value.toInt( &ok );
+	else if ( name == "--help" || name == "-h" )
+	{
+	    usage();
+	    return 0;
+	}
+	else
+	    ok = false;
+
+	if ( ! ok || value.isEmpty() || repeat < 1 )
+	{
+	    cerr << progName << ": Bad argument " << qPrintable( arg ) << std::endl;
+	    usage();
+	    return 1;
+	}
+    }
+
+    if ( cacheFileName.isEmpty() )
+    {
+	usage();
+	return 1;
+    }
+
+
+    // Read the cache file completely
+
+    DirTree tree;
+    tree.setLazyCacheLoading( false );
+    tree.readCache( cacheFileName );
+
+    if ( tree.isBusy() )
+    {
+	QEventLoop eventLoop;
+
+	QObject::connect( &tree,      SIGNAL( finished() ),
+			  &eventLoop, SLOT  ( quit()	 ) );
+
+	QObject::connect( &tree,      SIGNAL( aborted()	 ),
+			  &eventLoop, SLOT  ( quit()	 ) );
+
+	eventLoop.exec();
+    }
+
+    if ( ! tree.root() || ! tree.root()->hasChildren() )
+    {
+	cerr << progName << ": Could not read " << qPrintable( cacheFileName ) << std::endl;
+	return 1;
+    }
+
+
+    // Extract the corpus
+
+    Corpus corpus;
+    collect( tree.root(), corpus );
+
+    if ( ! collectCacheLines( &tree, corpus ) )
+    {
+	cerr << progName << ": Could not write a temporary cache file" << std::endl;
+	return 1;
+    }
+
+    corpus.categorizer	= MimeCategorizer::instance();
+    corpus.excludeRules = new ExcludeRules( excludePatterns );
+    CHECK_NEW( corpus.excludeRules );
+
+    foreach ( const QString & pattern, filterPatterns )
+    {
+	DirTreeFilter * filter = DirTreePatternFilter::create( pattern );
+
+	if ( filter )
+	    corpus.filters << filter;
+    }
+
+    QJsonObject paramsJson;
+    paramsJson[ "cacheFile"  ] = QFileInfo( cacheFileName ).absoluteFilePath();
+    paramsJson[ "items"	     ] = corpus.paths.size();
+    paramsJson[ "files"	     ] = corpus.files.size();
+    paramsJson[ "dirs"	     ] = corpus.childLists.size();
+    paramsJson[ "cacheLines" ] = corpus.lines.size();
+    paramsJson[ "exclude"    ] = excludePatterns.join( "," );
+    paramsJson[ "filter"     ] = filterPatterns.join( "," );
+    paramsJson[ "repeat"     ] = repeat;
+
+
+    // Run the benchmarks
+
+    for ( const Benchmark * benchmark = benchmarks; benchmark->name; ++benchmark )
+    {
+	if ( ! only.isEmpty() && ! only.contains( benchmark->name ) )
+	    continue;
+
+	for ( int run = 0; run < runs; ++run )
+	{
+	    qint64 checksum = 0;
+	    qint64 items    = 0;
+
+	    QElapsedTimer timer;
+	    timer.start();
+
+	    for ( int i = 0; i < repeat; ++i )
+		items += benchmark->func( corpus, checksum );
+
+	    qint64 nsec = timer.nsecsElapsed();
+
+	    QJsonObject result;
+	    result[ "version"	] = QDIRSTAT_VERSION;
+	    result[ "benchmark" ] = benchmark->name;
+	    result[ "run"	] = run;
+	    result[ "params"	] = paramsJson;
+	    result[ "items"	] = (double) items;
+	    result[ "millisec"	] = nsec / 1000000.0;
+	    result[ "nsPerItem" ] = items > 0 ? (double) nsec / items : 0.0;
+	    result[ "checksum"	] = (double) checksum;
+	    result[ "peakRssKB" ] = (double) peakRssKB();
+
+	    cout << QJsonDocument( result ).toJson( QJsonDocument::Compact ).constData() << std::endl;
+	}
+    }
+
+    qDeleteAll( corpus.filters );
+    delete corpus.excludeRules;
+
+    return 0;
+}
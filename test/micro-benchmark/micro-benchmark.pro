@@ -0,0 +1,27 @@
+# qmake .pro file for qdirstat/test/micro-benchmark
+#
+# This builds qdirstat-micro-benchmark which reads a cache file and measures
+# the hot paths of classifying and filtering its items one by one.
+# It is not built by default; build it from the project toplevel dir with
+#
+#     qmake CONFIG+=benchmark
+#     make
+#
+# or just here with
+#
+#     qmake && make
+#
+# It is never installed.
+
+TEMPLATE	 = app
+
+MOC_DIR		 = .moc
+OBJECTS_DIR	 = .obj
+TARGET		 = qdirstat-micro-benchmark
+
+QMAKE_CXXFLAGS	+=  -Wno-deprecated -Wno-deprecated-declarations
+
+
+SOURCES	  = main.cpp
+
+include(../../src/core.pri)
@@ -0,0 +1,355 @@
+/*
+ *   File name: main.cpp
+ *   Summary:	Benchmark for treemap layout and rendering
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <sys/resource.h>	// getrusage()
+#include <iostream>		// cerr, cout
+
+#include <QApplication>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QGraphicsScene>
+#include <QPainter>
+#include <QImage>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#include "TreemapView.h"
+#include "TreemapLayout.h"
+#include "TreemapLeaves.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+#include "Version.h"
+
+
+using std::cerr;
+using std::cout;
+using namespace QDirStat;
+
+static const char * progName = "qdirstat-treemap-benchmark";
+
+
+/**
+ * TreemapView that measures the individual steps of building the treemap
+ * that TreemapView::rebuildTreemap() and TreemapView::createTiles() do in
+ * one go.
+ **/
+class BenchmarkTreemapView: public TreemapView
+{
+public:
+
+    BenchmarkTreemapView():
+	TreemapView()
+	{}
+
+    /**
+     * Build the treemap of 'root' in a scene of 'size' step by step and
+     * add the timings and counts to 'result'. If 'paint' is 'true', also
+     * paint the scene into an image like the viewport would.
+     **/
+    void measure( FileInfo * root, const QSize & size, bool paint, QJsonObject & result )
+    {
+	QElapsedTimer timer;
+	QRectF rect( 0.0, 0.0, size.width(), size.height() );
+
+	clear();
+
+	if ( ! scene() )
+	{
+	    QGraphicsScene * newScene = new QGraphicsScene( this );
+	    CHECK_NEW( newScene );
+	    setScene( newScene );
+	}
+
+	scene()->setSceneRect( rect );
+
+	timer.start();
+	TreemapLayout layout( this, root, rect );
+	layout.layout();
+	result[ "layoutMillisec" ] = (double) timer.elapsed();
+	result[ "layoutItems"	 ] = layout.items().size();
+
+	timer.start();
+	_rootTile = addTiles( layout, 0 );
+	_leaves->buildIndex( rect );
+	result[ "tilesMillisec" ] = (double) timer.elapsed();
+	result[ "tiles"		] = scene()->items().size();
+	result[ "leaves"	] = _leaves->size();
+
+	timer.start();
+
+	if ( doCushionShading() || singleImage() )
+	    renderFramebuffer();
+
+	result[ "renderMillisec" ] = (double) timer.elapsed();
+
+	if ( paint )
+	{
+	    QImage image( size, QImage::Format_RGB32 );
+	    image.fill( Qt::white );
+
+	    timer.start();
+	    QPainter painter( &image );
+	    scene()->render( &painter, QRectF( QPointF( 0.0, 0.0 ), size ), rect );
+	    painter.end();
+	    result[ "paintMillisec" ] = (double) timer.elapsed();
+	}
+    }
+};
+
+
+/**
+ * Return the peak resident set size of this process so far in kB.
+ **/
+static long peakRssKB()
+{
+    struct rusage usage;
+
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 )
+	return -1;
+
+    return usage.ru_maxrss; // Linux: kB
+}
+
+
+/**
+ * Parse a list of sizes like "1920x1080,800x600" into 'sizes'.
+ * Return 'false' if there is any syntax error.
+ **/
+static bool parseSizes( const QString & value, QList<QSize> & sizes )
+{
+    sizes.clear();
+
+    foreach ( const QString & str, value.split( ',', QString::SkipEmptyParts ) )
+    {
+	bool okWidth  = false;
+	bool okHeight = false;
+	int  width    = str.section( 'x', 0, 0 ).toInt( &okWidth  );
+	int  height   = str.section( 'x', 1	 ).toInt( &okHeight );
+
+	if ( ! okWidth || ! okHeight || width <= 0 || height <= 0 )
+	    return false;
+
+	sizes << QSize( width, height );
+    }
+
+    return ! sizes.isEmpty();
+}
+
+
+/**
+ * Parse a boolean option value.
+ **/
+static bool toBool( const QString & value, bool * ok )
+{
+    *ok = true;
+
+    if ( value == "1" || value == "true"  || value == "on"  || value == "yes" )
+	return true;
+
+    if ( value == "0" || value == "false" || value == "off" || value == "no"  )
+	return false;
+
+    *ok = false;
+
+    return false;
+}
+
+
+void usage()
+{
+    cerr << "\n"
+	 << "Usage: \n"
+	 << "\n"
+	 << "  " << progName << " [<option>=<value> ...] <cache-file>\n"
+	 << "\n"
+	 << "Read a QDirStat cache file, then measure laying out the treemap, creating\n"
+	 << "its tiles and rendering the cushions for each treemap size. This does not\n"
+	 << "need a display. Each run writes one line of JSON to stdout.\n"
+	 << "\n"
+	 << "Options (defaults in parentheses):\n"
+	 << "\n"
+	 << "  --size=<w>x<h>[,...]     treemap sizes (1920x1080)\n"
+	 << "  --cushion=<bool>         cushion shading (true)\n"
+	 << "  --ensure-contrast=<bool> outlines for very small tiles (true)\n"
+	 << "  --min-tile-size=<n>      minimum tile size in pixels (3)\n"
+	 << "  --squarify=<bool>        squarified layout (true)\n"
+	 << "  --single-image=<bool>    render all files into one image (false)\n"
+	 << "  --paint=<bool>           also paint the scene into an image (true)\n"
+	 << "  --runs=<n>               number of runs for each size (3)\n"
+	 << "\n"
+	 << std::endl;
+}
+
+
+int main( int argc, char *argv[] )
+{
+    Logger logger( "/tmp/qdirstat-$USER", "qdirstat-treemap-benchmark.log" );
+    logger.setLogLevel( LogSeverityWarning );
+
+    // No display needed unless the caller explicitly asks for one
+
+    if ( qgetenv( "QT_QPA_PLATFORM" ).isEmpty() )
+	qputenv( "QT_QPA_PLATFORM", "offscreen" );
+
+    // Use separate settings so the benchmark options never end up in the
+    // user's QDirStat config.
+
+    QCoreApplication::setOrganizationName( "QDirStat" );
+    QCoreApplication::setApplicationName ( "QDirStat-treemap-benchmark" );
+
+    QApplication qtApp( argc, argv );
+    QStringList argList = QCoreApplication::arguments();
+    argList.removeFirst(); // Remove program name
+
+    QList<QSize> sizes;
+    sizes << QSize( 1920, 1080 );
+
+    bool    cushion	   = true;
+    bool    ensureContrast = true;
+    int	    minTileSize	   = 3;
+    bool    squarify	   = true;
+    bool    singleImage	   = false;
+    bool    paint	   = true;
+    int	    runs	   = 3;
+    QString cacheFileName;
+
+    foreach ( const QString & arg, argList )
+    {
+	if ( ! arg.startsWith( "-" ) )
+	{
+	    if ( ! cacheFileName.isEmpty() )
+	    {
+		usage();
+		return 1;
+	    }
+
+	    cacheFileName = arg;
+	    continue;
+	}
+
+	QString name  = arg.section( '=', 0, 0 );
+	QString value = arg.section( '=', 1 );
+	bool	ok    = true;
+
+	if	( name == "--size"	      ) ok		= parseSizes( value, sizes );
+	else if ( name == "--cushion"	      ) cushion		= toBool( value, &ok );
+	else if ( name == "--ensure-contrast" ) ensureContrast	= toBool( value, &ok );
+	else if ( name == "--min-tile-size"   ) minTileSize	= value.toInt( &ok );
+	else if ( name == "--squarify"	      ) squarify	= toBool( value, &ok );
+	else if ( name == "--single-image"    ) singleImage	= toBool( value, &ok );
+	else if ( name == "--paint"	      ) paint		= toBool( value, &ok );
+	else if ( name == "--runs"	      ) runs		= value.toInt( &ok );
+	else if ( name == "--help" || name == "-h" )
+	{
+	    usage();
+	    return 0;
+	}
+	else
+	    ok = false;
+
+	if ( ! ok || value.isEmpty() )
+	{
+	    cerr << progName << ": Bad argument " << qPrintable( arg ) << std::endl;
+	    usage();
+	    return 1;
+	}
+    }
+
+    if ( cacheFileName.isEmpty() )
+    {
+	usage();
+	return 1;
+    }
+
+
+    // TreemapView only reads its settings in its constructor, so write them
+    // first. No OpenGL and no progressive layout: Measure the real thing.
+
+    {
+	Settings settings;
+	settings.beginGroup( "Treemaps" );
+	settings.setValue( "CushionShading"   , cushion	       );
+	settings.setValue( "EnsureContrast"   , ensureContrast );
+	settings.setValue( "MinTileSize"      , minTileSize    );
+	settings.setValue( "Squarify"	      , squarify       );
+	settings.setValue( "SingleImage"      , singleImage    );
+	settings.setValue( "OpenGL"	      , false	       );
+	settings.setValue( "ProgressiveLevels", 0	       );
+	settings.endGroup();
+    }
+
+
+    // Read the cache file completely
+
+    DirTree tree;
+    tree.setLazyCacheLoading( false );
+
+    QElapsedTimer timer;
+    timer.start();
+    tree.readCache( cacheFileName );
+
+    if ( tree.isBusy() )
+    {
+	QEventLoop eventLoop;
+
+	QObject::connect( &tree,      SIGNAL( finished() ),
+			  &eventLoop, SLOT  ( quit()	 ) );
+
+	QObject::connect( &tree,      SIGNAL( aborted()	 ),
+			  &eventLoop, SLOT  ( quit()	 ) );
+
+	eventLoop.exec();
+    }
+
+    FileInfo * toplevel = tree.root() ? tree.root()->firstChild() : 0;
+
+    if ( ! toplevel )
+    {
+	cerr << progName << ": Could not read " << qPrintable( cacheFileName ) << std::endl;
+	return 1;
+    }
+
+    QJsonObject paramsJson;
+    paramsJson[ "cacheFile"	 ] = QFileInfo( cacheFileName ).absoluteFilePath();
+    paramsJson[ "items"		 ] = toplevel->totalItems() + 1;
+    paramsJson[ "readMillisec"	 ] = (double) timer.elapsed();
+    paramsJson[ "cushion"	 ] = cushion;
+    paramsJson[ "ensureContrast" ] = ensureContrast;
+    paramsJson[ "minTileSize"	 ] = minTileSize;
+    paramsJson[ "squarify"	 ] = squarify;
+    paramsJson[ "singleImage"	 ] = singleImage;
+
+    BenchmarkTreemapView view;
+
+    foreach ( const QSize & size, sizes )
+    {
+	for ( int run = 0; run < runs; ++run )
+	{
+	    QJsonObject result;
+	    result[ "version" ] = QDIRSTAT_VERSION;
+	    result[ "run"     ] = run;
+	    result[ "params"  ] = paramsJson;
+	    result[ "width"   ] = size.width();
+	    result[ "height"  ] = size.height();
+
+	    view.measure( toplevel, size, paint, result );
+	    result[ "peakRssKB" ] = (double) peakRssKB();
+
+	    cout << QJsonDocument( result ).toJson( QJsonDocument::Compact ).constData() << std::endl;
+	}
+    }
+
+    view.clear();
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+# qmake .pro file for qdirstat/test/treemap-benchmark
+#
+# This builds qdirstat-treemap-benchmark which reads a cache file and
+# measures laying out and rendering the treemap without a display.
+# It is not built by default; build it from the project toplevel dir with
+#
+#     qmake CONFIG+=benchmark
+#     make
+#
+# or just here with
+#
+#     qmake && make
+#
+# It is never installed.
+
+TEMPLATE	 = app
+
+MOC_DIR		 = .moc
+OBJECTS_DIR	 = .obj
+TARGET		 = qdirstat-treemap-benchmark
+
+QMAKE_CXXFLAGS	+=  -Wno-deprecated -Wno-deprecated-declarations
+
+
+SOURCES	  = main.cpp
+
+include(../../src/gui.pri)